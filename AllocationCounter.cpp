@@ -0,0 +1,102 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+// every thread's allocations
+// Note: Relaxed, because the count is only ever compared on one thread after the fact and
+// doesn't order anything.
+static std::atomic<unsigned long long> gHeapAllocationCount(0);
+
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Counts the allocation and then makes it with malloc(...), which is what the default
+    operator new does.
+Parameters:
+    sizeBytes   Self-explanatory.
+Returns:
+    The memory, or 0 if there isn't any.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static void *CountedAllocate(size_t sizeBytes)
+{
+    gHeapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    return malloc((sizeBytes > 0) ? sizeBytes : 1);
+}
+
+void *operator new(size_t sizeBytes)
+{
+    void *memory = CountedAllocate(sizeBytes);
+    if (memory == 0)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void *operator new[](size_t sizeBytes)
+{
+    void *memory = CountedAllocate(sizeBytes);
+    if (memory == 0)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void *operator new(size_t sizeBytes, const std::nothrow_t &)
+{
+    return CountedAllocate(sizeBytes);
+}
+
+void *operator new[](size_t sizeBytes, const std::nothrow_t &)
+{
+    return CountedAllocate(sizeBytes);
+}
+
+void operator delete(void *memory)
+{
+    free(memory);
+}
+
+void operator delete[](void *memory)
+{
+    free(memory);
+}
+
+void operator delete(void *memory, size_t)
+{
+    free(memory);
+}
+
+void operator delete[](void *memory, size_t)
+{
+    free(memory);
+}
+
+void operator delete(void *memory, const std::nothrow_t &)
+{
+    free(memory);
+}
+
+void operator delete[](void *memory, const std::nothrow_t &)
+{
+    free(memory);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How many times operator new has been called, on any thread, since the program started.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned long long GetHeapAllocationCount()
+{
+    return gHeapAllocationCount.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+// a count of every heap allocation that the program makes, on any thread (see
+// AllocationCounter.cpp)
+// Note: AllocationCounter.cpp replaces the global operator new, so this is always counting.
+// It is one relaxed atomic add per allocation, which is nothing next to the allocation.  The
+// count is for checking that a frame in the steady state doesn't allocate (see
+// "--count-allocations" in main.cpp): compare it before and after the frame.
+unsigned long long GetHeapAllocationCount();
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <functional>
+
+// what to ask the window system for (see AppWindow::Create(...))
+struct AppWindowSettings
+{
+    const char *_title;
+    int _width;
+    int _height;
+    int _positionX;
+    int _positionY;
+    int _glMajorVersion;
+    int _glMinorVersion;
+    bool _hasDepthBuffer;       // nothing uses stencil, so there is no option for it
+    bool _isDebugContext;       // for GL_ARB_debug_output (see OpenGlErrorHandling.h)
+};
+
+// the events that the window passes along while it is polled
+typedef std::function<void(int width, int height)> AppWindowResizeHandler;
+typedef std::function<void(unsigned char key, int x, int y)> AppWindowKeyHandler;
+
+// the mouse, in window coordinates with (0,0) at the top left
+// Note: The buttons are 0 (left), 1 (middle), and 2 (right).  A wheel step is +1 away from 
+// the user and -1 toward them.
+typedef std::function<void(int button, bool isDown, int x, int y)> AppWindowMouseButtonHandler;
+typedef std::function<void(int x, int y)> AppWindowMouseMoveHandler;
+typedef std::function<void(int wheelSteps, int x, int y)> AppWindowMouseWheelHandler;
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    A window with an OpenGL context, behind an interface so that the frame loop belongs to
+    main() instead of to the window system.  The loop asks for events, draws, and swaps, in
+    that order, every time around:
+
+        while (window->PollEvents())
+        {
+            Display();
+        }
+
+    so the loop decides when a frame happens, what goes around the swap, and when to stop, and
+    it can clean up with the context still current after the last frame.
+
+    GlutAppWindow is the freeglut implementation.  Another window system (ex: GLFW, or a
+    native one) only needs these functions.
+
+    A window system can also have shared windows: more windows (ex: on other monitors) that 
+    draw with the main window's context, so that they can draw the same buffers without 
+    copying them.  The loop draws into each one between BeginSharedWindow(...) and 
+    EndSharedWindow(), which swaps it.  The default is to have none.
+
+    Note: There is only one main window, and every call is on the thread that created it.
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+class AppWindow
+{
+public:
+    virtual ~AppWindow() {}
+
+    // the context is current after Create(...) succeeds
+    virtual bool Create(const AppWindowSettings &settings) = 0;
+    virtual void Destroy() = 0;
+
+    // handles whatever happened since the last call without waiting; false when it's time to
+    // stop (see RequestClose())
+    virtual bool PollEvents() = 0;
+    virtual void SwapBuffers() = 0;
+    virtual void RequestClose() = 0;
+    virtual void Hide() = 0;
+
+    virtual int GetWidth() const = 0;
+    virtual int GetHeight() const = 0;
+
+    // false while nothing of the window can be seen (minimized, hidden, or covered), so the 
+    // loop can slow down (see FrameRateLimiter)
+    virtual bool IsVisible() const = 0;
+
+    // false if the window system has no shared windows, or couldn't make another
+    virtual bool AddSharedWindow(const AppWindowSettings &settings)
+    {
+        (void)settings;
+        return false;
+    }
+    virtual unsigned int GetSharedWindowCount() const { return 0; }
+
+    // makes the shared window the one that is drawn to, and gives its size; false if it was 
+    // closed (or there is no such window), in which case nothing was changed
+    virtual bool BeginSharedWindow(unsigned int windowIndex, int *putWidthHere, 
+        int *putHeightHere)
+    {
+        (void)windowIndex;
+        (void)putWidthHere;
+        (void)putHeightHere;
+        return false;
+    }
+
+    // swaps the shared window's buffers and makes the main window the one drawn to again
+    virtual void EndSharedWindow() {}
+
+    void SetResizeHandler(const AppWindowResizeHandler &handler) { _resizeHandler = handler; }
+    void SetKeyHandler(const AppWindowKeyHandler &handler) { _keyHandler = handler; }
+    void SetMouseButtonHandler(const AppWindowMouseButtonHandler &handler) { _mouseButtonHandler = handler; }
+    void SetMouseMoveHandler(const AppWindowMouseMoveHandler &handler) { _mouseMoveHandler = handler; }
+    void SetMouseWheelHandler(const AppWindowMouseWheelHandler &handler) { _mouseWheelHandler = handler; }
+
+protected:
+    AppWindowResizeHandler _resizeHandler;
+    AppWindowKeyHandler _keyHandler;
+    AppWindowMouseButtonHandler _mouseButtonHandler;
+    AppWindowMouseMoveHandler _mouseMoveHandler;
+    AppWindowMouseWheelHandler _mouseWheelHandler;
+};
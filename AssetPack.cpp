@@ -0,0 +1,265 @@
+#include "AssetPack.h"
+
+#include "MappedFile.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <fstream>
+#include <string.h>
+
+// identifies the file as an asset pack (see WriteAssetPack(...))
+static const unsigned int ASSET_PACK_MAGIC = 0x4b415041;   // "APAK"
+static const unsigned int ASSET_PACK_VERSION = 1;
+static const unsigned int ASSET_PACK_ALIGNMENT = 64;
+static const unsigned int ASSET_NAME_MAX_LENGTH = 112;
+
+// at the start of the pack, followed by the index
+struct AssetPackHeader
+{
+    unsigned int _magic;
+    unsigned int _version;
+    unsigned int _entryCount;
+    unsigned int _padding;
+};
+
+// one per asset, sorted by name so that FindAsset(...) can binary search them in place
+// Note: The name is null-terminated.  The offset is from the start of the pack.
+struct AssetPackEntry
+{
+    char _name[ASSET_NAME_MAX_LENGTH];
+    unsigned long long _offset;
+    unsigned long long _sizeBytes;
+};
+static_assert(sizeof(AssetPackEntry) == 128, "AssetPackEntry must be tightly packed");
+
+// the open pack, if any
+static MappedFile gAssetPackFile;
+static const AssetPackEntry *gAssetPackEntries = 0;
+static unsigned int gAssetPackEntryCount = 0;
+
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Maps the pack and checks that its index is whole: every name is terminated and in order,
+    and every asset is inside the file.  Any pack that was already open is closed first.
+Parameters:
+    packPath    Self-explanatory.
+Returns:
+    True if the pack was opened, otherwise false, in which case the assets come from the
+    disk as before.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool OpenAssetPack(const std::string &packPath)
+{
+    CloseAssetPack();
+    if (!gAssetPackFile.Open(packPath))
+    {
+        return false;
+    }
+
+    const unsigned char *packData = (const unsigned char *)gAssetPackFile.GetData();
+    size_t packSizeBytes = gAssetPackFile.GetSizeBytes();
+    AssetPackHeader header;
+    bool isValid = (packSizeBytes >= sizeof(header));
+    if (isValid)
+    {
+        memcpy(&header, packData, sizeof(header));
+        isValid = header._magic == ASSET_PACK_MAGIC && header._version == ASSET_PACK_VERSION &&
+            (sizeof(header) + ((size_t)header._entryCount * sizeof(AssetPackEntry))) <=
+            packSizeBytes;
+    }
+
+    const AssetPackEntry *entries = (const AssetPackEntry *)(packData + sizeof(header));
+    for (unsigned int entryIndex = 0; isValid && entryIndex < header._entryCount; entryIndex++)
+    {
+        const AssetPackEntry &entry = entries[entryIndex];
+        isValid = memchr(entry._name, 0, ASSET_NAME_MAX_LENGTH) != 0 &&
+            entry._offset <= packSizeBytes && entry._sizeBytes <= packSizeBytes - entry._offset;
+        if (isValid && entryIndex > 0)
+        {
+            isValid = strcmp(entries[entryIndex - 1]._name, entry._name) < 0;
+        }
+    }
+    if (!isValid)
+    {
+        LogPrintf("'%s' isn't a version %u asset pack\n", packPath.c_str(), ASSET_PACK_VERSION);
+        gAssetPackFile.Close();
+        return false;
+    }
+
+    gAssetPackEntries = entries;
+    gAssetPackEntryCount = header._entryCount;
+    LogPrintf("asset pack '%s': %u assets\n", packPath.c_str(), gAssetPackEntryCount);
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Unmaps the pack.  Every pointer that FindAsset(...) gave out goes bad.  Safe to call when
+    no pack is open.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void CloseAssetPack()
+{
+    gAssetPackEntries = 0;
+    gAssetPackEntryCount = 0;
+    gAssetPackFile.Close();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    True if there is a pack to find assets in, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool IsAssetPackOpen()
+{
+    return gAssetPackEntries != 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Looks an asset up in the open pack.
+Parameters:
+    name                The path that it was packed under.
+    putDataHere         Gets a pointer into the pack's mapping, good until CloseAssetPack().
+    putSizeBytesHere    Self-explanatory.
+Returns:
+    True if the pack has it, otherwise false (including when no pack is open).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool FindAsset(const std::string &name, const void **putDataHere, size_t *putSizeBytesHere)
+{
+    unsigned int low = 0;
+    unsigned int high = gAssetPackEntryCount;
+    while (low < high)
+    {
+        unsigned int middle = low + ((high - low) / 2);
+        int comparison = strcmp(gAssetPackEntries[middle]._name, name.c_str());
+        if (comparison == 0)
+        {
+            const unsigned char *packData = (const unsigned char *)gAssetPackFile.GetData();
+            *putDataHere = packData + gAssetPackEntries[middle]._offset;
+            *putSizeBytesHere = (size_t)gAssetPackEntries[middle]._sizeBytes;
+            return true;
+        }
+        if (comparison < 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gets an asset's bytes without reading them into memory of our own: from the open pack if
+    it has the asset, and otherwise by mapping the file of that name.
+Parameters:
+    name                Self-explanatory.
+    fileIfNotPacked     Maps the file when the pack doesn't have it.  The bytes are only good
+                        as long as it is open.
+    putDataHere         Self-explanatory.
+    putSizeBytesHere    Self-explanatory.
+Returns:
+    True if the asset was found either way, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool MapAsset(const std::string &name, MappedFile *fileIfNotPacked, const void **putDataHere,
+    size_t *putSizeBytesHere)
+{
+    if (FindAsset(name, putDataHere, putSizeBytesHere))
+    {
+        return true;
+    }
+    if (!fileIfNotPacked->Open(name))
+    {
+        return false;
+    }
+    *putDataHere = fileIfNotPacked->GetData();
+    *putSizeBytesHere = fileIfNotPacked->GetSizeBytes();
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Writes a pack of the given files, each one named by the path that it was given as, so that
+    a loader that asks for the same path finds it.  Duplicate paths are packed once.
+Parameters:
+    packPath    Self-explanatory.
+    filePaths   Self-explanatory.  Each must be shorter than 112 characters.
+Returns:
+    True if every file was packed, otherwise false, in which case the pack is left incomplete
+    and shouldn't be used.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool WriteAssetPack(const std::string &packPath, const std::vector<std::string> &filePaths)
+{
+    std::vector<std::string> names = filePaths;
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+
+    // the index is written first, so every asset is mapped before any of them are written
+    std::vector<MappedFile> files(names.size());
+    std::vector<AssetPackEntry> entries(names.size());
+    unsigned long long offset = sizeof(AssetPackHeader) + (names.size() * sizeof(AssetPackEntry));
+    for (size_t nameIndex = 0; nameIndex < names.size(); nameIndex++)
+    {
+        if (names[nameIndex].length() >= ASSET_NAME_MAX_LENGTH ||
+            !files[nameIndex].Open(names[nameIndex]))
+        {
+            LogPrintf("asset pack: can't pack '%s'\n", names[nameIndex].c_str());
+            return false;
+        }
+
+        offset = ((offset + ASSET_PACK_ALIGNMENT - 1) / ASSET_PACK_ALIGNMENT) *
+            ASSET_PACK_ALIGNMENT;
+        AssetPackEntry &entry = entries[nameIndex];
+        memset(&entry, 0, sizeof(entry));
+        memcpy(entry._name, names[nameIndex].c_str(), names[nameIndex].length());
+        entry._offset = offset;
+        entry._sizeBytes = files[nameIndex].GetSizeBytes();
+        offset += entry._sizeBytes;
+    }
+
+    std::ofstream packFile(packPath.c_str(), std::ios::binary | std::ios::trunc);
+    AssetPackHeader header;
+    header._magic = ASSET_PACK_MAGIC;
+    header._version = ASSET_PACK_VERSION;
+    header._entryCount = (unsigned int)entries.size();
+    header._padding = 0;
+    packFile.write((const char *)&header, sizeof(header));
+    packFile.write((const char *)entries.data(), entries.size() * sizeof(AssetPackEntry));
+    unsigned long long writtenBytes =
+        sizeof(AssetPackHeader) + (entries.size() * sizeof(AssetPackEntry));
+    const char padding[ASSET_PACK_ALIGNMENT] = { 0 };
+    for (size_t entryIndex = 0; entryIndex < entries.size(); entryIndex++)
+    {
+        packFile.write(padding, (std::streamsize)(entries[entryIndex]._offset - writtenBytes));
+        packFile.write((const char *)files[entryIndex].GetData(),
+            (std::streamsize)entries[entryIndex]._sizeBytes);
+        writtenBytes = entries[entryIndex]._offset + entries[entryIndex]._sizeBytes;
+    }
+    if (!packFile.good())
+    {
+        LogPrintf("asset pack: couldn't write '%s'\n", packPath.c_str());
+        return false;
+    }
+    LogPrintf("asset pack: wrote %u assets to '%s'\n", (unsigned int)entries.size(),
+        packPath.c_str());
+    return true;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+class MappedFile;
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Packs the files that startup reads (the shaders, and the images that the demo is given)
+    into one file, so that a start is one open and one mapping instead of a read per file, and
+    so that the assets no longer depend on what the working directory has in it.
+
+    The pack is a header, an index of names sorted by name, and then each file's bytes at a
+    64-byte aligned offset.  It is opened once with a MappedFile (see MappedFile.h), so an
+    asset is only read from disk when its pages are touched, and FindAsset(...) hands back a
+    pointer into the mapping with no copy.  MapAsset(...) is how the loaders get their files:
+    from the pack if it has them, and otherwise mapped from the disk by name.
+
+    Note: The pack is global, like the program registry (see ShaderProgramRegistry.h).  Open
+    it before anything is loaded, and close it after everything that was loaded from it is
+    done with the pointers that it gave out.
+    Also Note: The names are the paths that the loaders ask for (ex: "shaderParticle.comp"),
+    and they are compared as they are, so the pack must be written with the same paths.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool OpenAssetPack(const std::string &packPath);
+void CloseAssetPack();
+bool IsAssetPackOpen();
+bool FindAsset(const std::string &name, const void **putDataHere, size_t *putSizeBytesHere);
+bool MapAsset(const std::string &name, MappedFile *fileIfNotPacked, const void **putDataHere,
+    size_t *putSizeBytesHere);
+bool WriteAssetPack(const std::string &packPath, const std::vector<std::string> &filePaths);
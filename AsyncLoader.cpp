@@ -0,0 +1,291 @@
+#include "AsyncLoader.h"
+
+#include "TraceTimeline.h"
+#include "ThreadPlacement.h"
+#include "Log.h"
+
+#include <chrono>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.  Nothing is loaded until Submit(...).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+AsyncLoader::AsyncLoader() :
+    _isStopping(false),
+    _pendingCount(0)
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.  The workers must
+    be joined before the std::threads are destroyed, or the program is terminated.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+AsyncLoader::~AsyncLoader()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Starts the workers, which sleep until a load has a worker step for them.
+Parameters:
+    workerCount     0 runs every step on the GL thread (see RunGlSteps(...)).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void AsyncLoader::Init(unsigned int workerCount)
+{
+    this->Cleanup();
+    for (unsigned int workerIndex = 0; workerIndex < workerCount; workerIndex++)
+    {
+        _workers.push_back(std::thread(&AsyncLoader::WorkerLoop, this));
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Waits for the workers to finish the steps that they are on (if any), stops them, and
+    drops the loads that haven't finished.  Must be called on the GL thread, with the context
+    current, since the loads' state may own GL objects.  Safe to call more than once.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void AsyncLoader::Cleanup()
+{
+    if (!_workers.empty())
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _isStopping = true;
+        }
+        _condition.notify_all();
+        for (size_t workerIndex = 0; workerIndex < _workers.size(); workerIndex++)
+        {
+            _workers[workerIndex].join();
+        }
+        _workers.clear();
+    }
+
+    if (_pendingCount > 0)
+    {
+        LogPrintf("async loader: dropped %u unfinished loads\n", _pendingCount);
+    }
+    _workerQueue.clear();
+    _glQueue.clear();
+    _pendingCount = 0;
+    _isStopping = false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Starts a load.  Its first step is queued for a worker or for the next RunGlSteps(...),
+    whichever it is for, and returns right away.
+Parameters:
+    name    For the log.
+    steps   Run in order.  Copied, so they can go out of scope.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void AsyncLoader::Submit(const std::string &name, const std::vector<AsyncLoadStep> &steps)
+{
+    std::unique_ptr<Load> load(new Load);
+    load->_name = name;
+    load->_steps = steps;
+    load->_nextStepIndex = 0;
+    load->_isFailed = false;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _pendingCount++;
+    }
+    this->QueueNextStep(load);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Runs the loads' GL steps, in the order that they got to them, until the budget is used
+    up or there are none left.  Called once a frame on the GL thread.  The time is checked
+    after each step, so at least one step runs every frame however small the budget is, and
+    a step that takes longer than the budget by itself takes that long.
+
+    A step that wants to be called again stays at the front, so a load's upload finishes
+    before the next load's starts instead of every load's advancing a little.
+Parameters:
+    budgetMs    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void AsyncLoader::RunGlSteps(float budgetMs)
+{
+    std::chrono::high_resolution_clock::time_point start =
+        std::chrono::high_resolution_clock::now();
+    while (true)
+    {
+        std::unique_ptr<Load> load;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_glQueue.empty())
+            {
+                return;
+            }
+            load = std::move(_glQueue.front());
+            _glQueue.pop_front();
+        }
+
+        if (load->_isFailed || load->_nextStepIndex >= load->_steps.size())
+        {
+            this->FinishLoad(load);
+            continue;
+        }
+
+        // a worker step only lands here if there are no workers
+        AsyncLoadStepResult result = load->_steps[load->_nextStepIndex]._run();
+        if (result == ASYNC_LOAD_STEP_AGAIN)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _glQueue.push_front(std::move(load));
+        }
+        else
+        {
+            load->_isFailed = (result == ASYNC_LOAD_STEP_FAILED);
+            load->_nextStepIndex++;
+            this->QueueNextStep(load);
+        }
+
+        float elapsedMs = std::chrono::duration<float, std::milli>(
+            std::chrono::high_resolution_clock::now() - start).count();
+        if (elapsedMs >= budgetMs)
+        {
+            return;
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How many loads were submitted and haven't finished (or failed) yet.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int AsyncLoader::GetPendingCount() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _pendingCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    A worker thread.  Sleeps until a load's next step is a worker step, runs it, and hands
+    the load on to wherever its next step is.  A step that wants to be called again goes to
+    the back of the queue, so a long read doesn't hold up the other loads' reads.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void AsyncLoader::WorkerLoop()
+{
+    SetTraceThreadName("async loader");
+    PlaceWorkerThread();
+    while (true)
+    {
+        std::unique_ptr<Load> load;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _condition.wait(lock, [this]() { return _isStopping || !_workerQueue.empty(); });
+            if (_isStopping)
+            {
+                return;
+            }
+            load = std::move(_workerQueue.front());
+            _workerQueue.pop_front();
+        }
+
+        AsyncLoadStepResult result = load->_steps[load->_nextStepIndex]._run();
+        if (result == ASYNC_LOAD_STEP_AGAIN)
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _workerQueue.push_back(std::move(load));
+            }
+            _condition.notify_one();
+        }
+        else
+        {
+            load->_isFailed = (result == ASYNC_LOAD_STEP_FAILED);
+            load->_nextStepIndex++;
+            this->QueueNextStep(load);
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Hands a load to the workers if its next step is theirs and there are any, and otherwise
+    to the GL thread, which is also where a load goes when it is done or has failed.
+Parameters:
+    load    Moved into one of the queues.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void AsyncLoader::QueueNextStep(std::unique_ptr<Load> &load)
+{
+    bool isForWorker = !_workers.empty() && !load->_isFailed &&
+        load->_nextStepIndex < load->_steps.size() &&
+        load->_steps[load->_nextStepIndex]._thread == ASYNC_LOAD_ON_WORKER;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (isForWorker)
+        {
+            _workerQueue.push_back(std::move(load));
+        }
+        else
+        {
+            _glQueue.push_back(std::move(load));
+        }
+    }
+    if (isForWorker)
+    {
+        _condition.notify_one();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Logs how a load ended and destroys it, along with whatever state its steps captured.
+    Only called on the GL thread.
+Parameters:
+    load    Reset.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void AsyncLoader::FinishLoad(std::unique_ptr<Load> &load)
+{
+    if (load->_isFailed)
+    {
+        LogPrintf("async loader: '%s' failed after %u of %u steps\n", load->_name.c_str(),
+            (unsigned int)load->_nextStepIndex - 1, (unsigned int)load->_steps.size());
+    }
+    load.reset();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _pendingCount--;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// which thread a step of a load runs on (see AsyncLoader)
+enum AsyncLoadThread
+{
+    // file reads, decompression, parsing; no GL calls
+    ASYNC_LOAD_ON_WORKER = 0,
+
+    // buffer and texture uploads, program links; must be short (see AsyncLoader::RunGlSteps(...))
+    ASYNC_LOAD_ON_GL_THREAD,
+};
+
+// what a step says when it returns
+enum AsyncLoadStepResult
+{
+    ASYNC_LOAD_STEP_DONE = 0,
+
+    // there is more to do, and the step wants to be called again (ex: the next piece of an
+    // upload); a GL step is called again on the same frame if there is time left
+    ASYNC_LOAD_STEP_AGAIN,
+
+    // the rest of the load is skipped
+    ASYNC_LOAD_STEP_FAILED,
+};
+
+struct AsyncLoadStep
+{
+    AsyncLoadThread _thread;
+    std::function<AsyncLoadStepResult()> _run;
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Loads things (ex: a snapshot, see ParticleManager::LoadSnapshotData(...)) without stalling
+    the frame.  A load is a list of steps that run in order, each one on a worker or on the GL
+    thread.  The workers do the slow part that needs no context (reading the file, paging in
+    a mapped view, decompressing), and the GL thread does the part that does, a little at a
+    time: RunGlSteps(...) is called once a frame and runs GL steps until its time budget is
+    used up, so a big upload is spread over as many frames as it takes instead of making one
+    frame long.
+
+    A step that returns ASYNC_LOAD_STEP_AGAIN is called again, so a GL upload splits itself
+    into pieces by keeping its own offset.  The steps of a load share whatever state they
+    need by capturing it (ex: a std::shared_ptr to a struct of the load's own).
+
+    Note: A load is only ever destroyed on the GL thread (in RunGlSteps(...) or Cleanup()),
+    even if its last step ran on a worker, so the state that the steps capture may own GL
+    objects (see GlObjects.h).
+    Also Note: Without workers (see Init(...)), the worker steps run in RunGlSteps(...) too,
+    under the same budget, which is the old blocking load spread over frames.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class AsyncLoader
+{
+public:
+    AsyncLoader();
+    ~AsyncLoader();
+    void Init(unsigned int workerCount);
+    void Cleanup();
+
+    void Submit(const std::string &name, const std::vector<AsyncLoadStep> &steps);
+    void RunGlSteps(float budgetMs);
+    unsigned int GetPendingCount() const;
+
+private:
+    struct Load
+    {
+        std::string _name;
+        std::vector<AsyncLoadStep> _steps;
+        size_t _nextStepIndex;
+        bool _isFailed;
+    };
+
+    void WorkerLoop();
+    void QueueNextStep(std::unique_ptr<Load> &load);
+    void FinishLoad(std::unique_ptr<Load> &load);
+
+    std::vector<std::thread> _workers;
+    mutable std::mutex _mutex;
+    std::condition_variable _condition;
+    bool _isStopping;
+
+    // the loads whose next step is on a worker, and the ones whose next step is on the GL
+    // thread (or that are done, and are waiting for the GL thread to destroy them)
+    std::deque<std::unique_ptr<Load> > _workerQueue;
+    std::deque<std::unique_ptr<Load> > _glQueue;
+    unsigned int _pendingCount;
+};
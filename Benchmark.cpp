@@ -0,0 +1,1947 @@
+#include "Benchmark.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
+#include "glm/vec2.hpp"
+#include "glm/detail/func_geometric.hpp"    // glm::dot
+
+#include "ComputeDeviceCaps.h"
+#include "DensitySplatRenderer.h"
+#include "GpuClockMonitor.h"
+#include "GpuHardwareCounters.h"
+#include "GpuProfiler.h"
+#include "GpuScan.h"
+#include "ParticleHeatmapExporter.h"
+#include "ParticleManager.h"
+#include "ParticleSimdKernels.h"
+#include "ParticleStatsReducer.h"
+#include "ShaderProgramRegistry.h"
+
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// the time stamp counter, for the CPU kernels' rate per tick
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define BENCHMARK_HAS_TIME_STAMP_COUNTER
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCHMARK_HAS_TIME_STAMP_COUNTER
+#endif
+
+// the benchmark renders into its own framebuffer so that the window size (or whether there is
+// a visible window at all) doesn't affect the results
+static const int BENCHMARK_FRAMEBUFFER_WIDTH = 1024;
+static const int BENCHMARK_FRAMEBUFFER_HEIGHT = 1024;
+
+// enough frames for emission to fill the pool (see RunBenchmarkConfiguration(...)) and for the
+// driver to settle
+static const unsigned int BENCHMARK_WARMUP_FRAMES = 120;
+static const unsigned int BENCHMARK_MEASURED_FRAMES = 500;
+
+// how many measured frames apart the GPU's clocks are sampled, and how many more times a 
+// throttled cell of a sweep is measured (see BenchmarkSweepSettings::_retryThrottledCells)
+static const unsigned int BENCHMARK_CLOCK_SAMPLE_FRAMES = 25;
+static const unsigned int BENCHMARK_THROTTLE_RETRIES = 2;
+
+// same simulation rate as the interactive mode
+static const float BENCHMARK_STEP_SEC = 1.0f / 120.0f;
+
+// a scan is much shorter than a frame, so fewer runs are enough for stable numbers
+static const unsigned int BENCHMARK_SCAN_WARMUP_RUNS = 10;
+static const unsigned int BENCHMARK_SCAN_MEASURED_RUNS = 100;
+
+// the CPU kernels run on one thread over one big run of particles, the way that one chunk of
+// the CPU backend would if the chunks were huge; the steps are the update's usual substeps 
+// at 120Hz when the frame rate is 30Hz
+static const unsigned int BENCHMARK_CPU_KERNEL_RUNS = 20;
+static const unsigned int BENCHMARK_CPU_KERNEL_STEPS = 4;
+
+// the kernels are timed on their own, one dispatch (or a few) at a time, so they get more runs
+// than the frames do, on a pool big enough to be well past the caches
+static const unsigned int BENCHMARK_KERNEL_PARTICLES = 2000000;
+static const unsigned int BENCHMARK_KERNEL_WARMUP_RUNS = 5;
+static const unsigned int BENCHMARK_KERNEL_MEASURED_RUNS = 30;
+static const char *BENCHMARK_KERNEL_HEATMAP_PATH = "benchmarkHeatmap.raw";
+
+// the kernel table's inputs (see MakeBenchmarkParticles(...)); "uniform" and "clustered" 
+// are half alive, spread over the window or bunched up within 0.1 of the emitter's center
+enum BenchmarkDistribution
+{
+    BENCHMARK_DISTRIBUTION_UNIFORM = 0,
+    BENCHMARK_DISTRIBUTION_CLUSTERED,
+    BENCHMARK_DISTRIBUTION_ALL_DEAD,
+    BENCHMARK_DISTRIBUTION_ALL_ALIVE,
+    BENCHMARK_DISTRIBUTION_COUNT,
+};
+static const char *BENCHMARK_DISTRIBUTION_NAMES[] = 
+{ 
+    "uniform", "clustered", "all_dead", "all_alive" 
+};
+
+// one row of the particle table or one cell of a sweep
+struct BenchmarkConfiguration
+{
+    unsigned int _numParticles;
+    ParticleLayout _layout;
+    ParticleBufferAccess _bufferAccess;
+    unsigned int _particlesPerInvocation;
+    unsigned int _workGroupSize;
+    BenchmarkPrimitive _primitive;
+    float _pointSize;
+    unsigned int _warmupFrames;
+    unsigned int _measuredFrames;
+
+    // GL_ALL_BARRIER_BITS after the update instead of the targeted bits (see 
+    // ParticleManager::SetFullMemoryBarrier(...))
+    bool _useFullMemoryBarrier;
+
+    // the sweep's hardware counters and their scopes, or 0 to not sample them
+    GpuHardwareCounters *_counters;
+    unsigned int _updateCounterScopeId;
+    unsigned int _renderCounterScopeId;
+
+    // the sweep's clock monitor, or 0 to not sample the clocks
+    GpuClockMonitor *_clocks;
+};
+
+// what MeasureBenchmarkConfiguration(...) found; the CPU times are per frame, and the counters 
+// are empty if they weren't sampled
+struct BenchmarkMeasurement
+{
+    double _cpuSubmitMs;
+    double _wallMsPerFrame;
+    GpuProfilerStats _updateStats;
+    GpuProfilerStats _renderStats;
+    unsigned int _droppedSampleCount;
+    std::vector<double> _updateCounters;
+    std::vector<double> _renderCounters;
+
+    // the measured frames' clocks, which are empty if they weren't sampled
+    GpuClockWindow _clockWindow;
+};
+
+// the names in the sweep's report and on the command line (see SetBenchmarkSweepAxis(...)), 
+// in the order of the enums
+static const char *BENCHMARK_LAYOUT_NAMES[] = 
+{
+    "interleaved", "soa", "half_float", "fixed_point"
+};
+static const char *BENCHMARK_PRIMITIVE_NAMES[] = { "points", "quads", "octagons" };
+
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Creates a framebuffer object with a single RGBA8 color renderbuffer and binds it for
+    drawing.
+Parameters:
+    width               Self-explanatory.
+    height              Self-explanatory.
+    putFramebufferHere  The framebuffer ID.
+    putRenderbufferHere The color renderbuffer ID.
+Returns:
+    True if the framebuffer is complete, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-10-2016)
+-----------------------------------------------------------------------------------------------*/
+static bool CreateOffscreenFramebuffer(int width, int height, GLuint *putFramebufferHere,
+    GLuint *putRenderbufferHere)
+{
+    glGenRenderbuffers(1, putRenderbufferHere);
+    glBindRenderbuffer(GL_RENDERBUFFER, *putRenderbufferHere);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, putFramebufferHere);
+    glBindFramebuffer(GL_FRAMEBUFFER, *putFramebufferHere);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER,
+        *putRenderbufferHere);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        printf("benchmark framebuffer incomplete: 0x%x\n", status);
+        return false;
+    }
+
+    glViewport(0, 0, width, height);
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Runs a single benchmark configuration.  The emission quota is scaled with the particle 
+    count so that every configuration reaches a full pool within the warmup instead of the 
+    small configurations being full and the large ones nearly empty.
+Parameters:
+    config          Self-explanatory.
+    putMeasurementHere  Self-explanatory.
+Returns:
+    True if the configuration could be set up, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-10-2016)
+-----------------------------------------------------------------------------------------------*/
+static bool MeasureBenchmarkConfiguration(const BenchmarkConfiguration &config, 
+    BenchmarkMeasurement *putMeasurementHere)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+
+    // configurations with the same layout share the same programs
+    GLuint particleProgramId = 0;
+    // Note: The fixed-point layout has no vertex attributes, so its points are pulled.
+    if (config._primitive == BENCHMARK_PRIMITIVE_POINTS && 
+        config._layout == PARTICLE_LAYOUT_FIXED_POINT)
+    {
+        particleProgramId = AcquireRenderProgram("shaderParticle.vert", "shaderParticle.frag", 
+            ParticleManager::GetRenderShaderDefines(config._layout));
+    }
+    else if (config._primitive == BENCHMARK_PRIMITIVE_POINTS)
+    {
+        particleProgramId = AcquireRenderProgram();
+    }
+    else
+    {
+        particleProgramId = AcquireRenderProgram("shaderParticle.vert", 
+            "shaderParticleQuad.frag", ParticleManager::GetQuadRenderShaderDefines(config._layout));
+    }
+    GLuint computeProgramId = AcquireComputeProgram(
+        ParticleManager::GetComputeShaderDefines(config._layout, config._workGroupSize));
+    if (particleProgramId == 0 || computeProgramId == 0)
+    {
+        ReleaseProgram(particleProgramId);
+        ReleaseProgram(computeProgramId);
+        return false;
+    }
+
+    unsigned int maxParticlesEmittedPerFrame = config._numParticles / 50;
+    ParticleManager particleManager;
+    particleManager.SetParticleBufferAccess(config._bufferAccess);
+    particleManager.SetParticlesPerInvocation(config._particlesPerInvocation);
+    particleManager.Init(particleProgramId,
+        computeProgramId,
+        config._numParticles,
+        maxParticlesEmittedPerFrame,
+        glm::vec2(+0.3f, +0.3f),
+        1.1f,
+        0.05f,
+        0.6f,
+        config._layout);
+    ReleaseProgram(particleProgramId);
+    ReleaseProgram(computeProgramId);
+    particleManager.SetPointSize(config._pointSize);
+    particleManager.SetQuadShape((config._primitive == BENCHMARK_PRIMITIVE_OCTAGON_QUADS) ? 
+        PARTICLE_QUAD_SHAPE_OCTAGON : PARTICLE_QUAD_SHAPE_SQUARE);
+    particleManager.SetFullMemoryBarrier(config._useFullMemoryBarrier);
+
+    GpuProfiler profiler;
+    profiler.Init(0);
+    unsigned int updateScopeId = profiler.AddScope("update");
+    unsigned int renderScopeId = profiler.AddScope("render");
+
+    for (unsigned int frameCount = 0; frameCount < config._warmupFrames; frameCount++)
+    {
+        glClear(GL_COLOR_BUFFER_BIT);
+        particleManager.UpdateSteps(BENCHMARK_STEP_SEC, 1);
+        particleManager.Render(0.0f);
+    }
+    glFinish();
+
+    // the counters are per cell, and the warm-up's shouldn't count
+    GpuHardwareCounters *counters = config._counters;
+    if (counters != 0)
+    {
+        counters->ResetAverages();
+    }
+
+    // CPU submission time is measured per frame; wall time is measured over the whole run
+    // (with a glFinish() at the end so that the GPU work is included) so that it reflects
+    // throughput rather than just how fast the driver queues commands
+    double cpuSubmitMsTotal = 0.0;
+    Clock::time_point runStart = Clock::now();
+    if (config._clocks != 0)
+    {
+        config._clocks->BeginWindow();
+    }
+    for (unsigned int frameCount = 0; frameCount < config._measuredFrames; frameCount++)
+    {
+        Clock::time_point frameStart = Clock::now();
+        if (config._clocks != 0 && (frameCount % BENCHMARK_CLOCK_SAMPLE_FRAMES) == 0)
+        {
+            config._clocks->SampleWindow();
+        }
+
+        glClear(GL_COLOR_BUFFER_BIT);
+        profiler.BeginScope(updateScopeId);
+        if (counters != 0)
+        {
+            counters->BeginScope(config._updateCounterScopeId);
+        }
+        particleManager.UpdateSteps(BENCHMARK_STEP_SEC, 1);
+        if (counters != 0)
+        {
+            counters->EndScope(config._updateCounterScopeId);
+        }
+        profiler.EndScope(updateScopeId);
+        profiler.BeginScope(renderScopeId);
+        if (counters != 0)
+        {
+            counters->BeginScope(config._renderCounterScopeId);
+        }
+        particleManager.Render(0.0f);
+        if (counters != 0)
+        {
+            counters->EndScope(config._renderCounterScopeId);
+        }
+        profiler.EndScope(renderScopeId);
+        profiler.EndFrame();
+        if (counters != 0)
+        {
+            counters->EndFrame();
+        }
+
+        std::chrono::duration<double, std::milli> submitMs = Clock::now() - frameStart;
+        cpuSubmitMsTotal += submitMs.count();
+    }
+    glFinish();
+    std::chrono::duration<double, std::milli> runMs = Clock::now() - runStart;
+
+    // everything is finished, so collect the frames that are still in the profiler's ring
+    profiler.EndFrame();
+    profiler.EndFrame();
+    if (counters != 0)
+    {
+        counters->EndFrame();
+        counters->EndFrame();
+    }
+
+    unsigned int measuredFrames = (config._measuredFrames > 0) ? config._measuredFrames : 1;
+    putMeasurementHere->_cpuSubmitMs = cpuSubmitMsTotal / measuredFrames;
+    putMeasurementHere->_wallMsPerFrame = runMs.count() / measuredFrames;
+    GpuProfilerStats noStats = {};
+    putMeasurementHere->_updateStats = noStats;
+    putMeasurementHere->_renderStats = noStats;
+    profiler.GetStats(updateScopeId, &putMeasurementHere->_updateStats);
+    profiler.GetStats(renderScopeId, &putMeasurementHere->_renderStats);
+    putMeasurementHere->_droppedSampleCount = profiler.GetDroppedSampleCount();
+    GpuClockWindow noClocks = {};
+    putMeasurementHere->_clockWindow = noClocks;
+    if (config._clocks != 0)
+    {
+        config._clocks->GetWindow(&putMeasurementHere->_clockWindow);
+    }
+    putMeasurementHere->_updateCounters.clear();
+    putMeasurementHere->_renderCounters.clear();
+    if (counters != 0)
+    {
+        counters->GetAverages(config._updateCounterScopeId, 
+            &putMeasurementHere->_updateCounters);
+        counters->GetAverages(config._renderCounterScopeId, 
+            &putMeasurementHere->_renderCounters);
+    }
+
+    profiler.Cleanup();
+    particleManager.Cleanup();
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Runs a single configuration of the particle table (see MeasureBenchmarkConfiguration(...))
+    with the default work group size and prints its CSV row.
+Parameters:
+    numParticles    Self-explanatory.
+    layout          Self-explanatory.
+    bufferAccess    See ParticleManager::SetParticleBufferAccess(...).
+    particlesPerInvocation  See ParticleManager::SetParticlesPerInvocation(...).
+    primitive       Point sprites or one of the instanced quad shapes.
+    pointSize       See ParticleManager::SetPointSize(...).
+Returns:
+    True if the configuration could be set up, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-10-2016)
+-----------------------------------------------------------------------------------------------*/
+static bool RunBenchmarkConfiguration(unsigned int numParticles, ParticleLayout layout, 
+    ParticleBufferAccess bufferAccess, unsigned int particlesPerInvocation, 
+    BenchmarkPrimitive primitive, float pointSize)
+{
+    BenchmarkConfiguration config;
+    config._numParticles = numParticles;
+    config._layout = layout;
+    config._bufferAccess = bufferAccess;
+    config._particlesPerInvocation = particlesPerInvocation;
+    config._workGroupSize = ParticleManager::DEFAULT_WORK_GROUP_SIZE;
+    config._primitive = primitive;
+    config._pointSize = pointSize;
+    config._warmupFrames = BENCHMARK_WARMUP_FRAMES;
+    config._measuredFrames = BENCHMARK_MEASURED_FRAMES;
+    config._useFullMemoryBarrier = false;
+    config._counters = 0;
+    config._updateCounterScopeId = 0;
+    config._renderCounterScopeId = 0;
+    config._clocks = 0;
+
+    BenchmarkMeasurement measurement;
+    if (!MeasureBenchmarkConfiguration(config, &measurement))
+    {
+        return false;
+    }
+
+    const GpuProfilerStats &updateStats = measurement._updateStats;
+    const GpuProfilerStats &renderStats = measurement._renderStats;
+    printf("%u,%d,%d,%u,%d,%.1f,%u,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%u\n",
+        numParticles,
+        (int)layout,
+        (int)bufferAccess,
+        particlesPerInvocation,
+        (int)primitive,
+        pointSize,
+        BENCHMARK_MEASURED_FRAMES,
+        measurement._cpuSubmitMs,
+        measurement._wallMsPerFrame,
+        updateStats._minMs, updateStats._avgMs, updateStats._p99Ms,
+        renderStats._minMs, renderStats._avgMs, renderStats._p99Ms,
+        measurement._droppedSampleCount);
+    fflush(stdout);
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Runs the same configuration with the targeted barrier after the update (see 
+    ParticleManager::GetUpdateBarrierBits()) and with GL_ALL_BARRIER_BITS, one right after 
+    the other, and prints a CSV row for each in the barrier table.  The barrier is issued 
+    inside the update's profiler scope, and what it costs is mostly the stall before the 
+    next pass, so both the update and the render columns are of interest.
+Parameters:
+    numParticles    Self-explanatory.
+Returns:
+    True if both configurations could be set up, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static bool RunBarrierBenchmarkConfiguration(unsigned int numParticles)
+{
+    BenchmarkConfiguration config;
+    config._numParticles = numParticles;
+    config._layout = PARTICLE_LAYOUT_SOA;
+    config._bufferAccess = PARTICLE_BUFFER_ACCESS_GPU_ONLY;
+    config._particlesPerInvocation = 1;
+    config._workGroupSize = ParticleManager::DEFAULT_WORK_GROUP_SIZE;
+    config._primitive = BENCHMARK_PRIMITIVE_POINTS;
+    config._pointSize = 1.0f;
+    config._warmupFrames = BENCHMARK_WARMUP_FRAMES;
+    config._measuredFrames = BENCHMARK_MEASURED_FRAMES;
+    config._counters = 0;
+    config._updateCounterScopeId = 0;
+    config._renderCounterScopeId = 0;
+    config._clocks = 0;
+
+    for (int fullIndex = 0; fullIndex < 2; fullIndex++)
+    {
+        config._useFullMemoryBarrier = (fullIndex != 0);
+        BenchmarkMeasurement measurement;
+        if (!MeasureBenchmarkConfiguration(config, &measurement))
+        {
+            return false;
+        }
+
+        const GpuProfilerStats &updateStats = measurement._updateStats;
+        const GpuProfilerStats &renderStats = measurement._renderStats;
+        printf("%u,%s,%u,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%u\n",
+            numParticles,
+            config._useFullMemoryBarrier ? "all" : "targeted",
+            BENCHMARK_MEASURED_FRAMES,
+            measurement._wallMsPerFrame,
+            updateStats._minMs, updateStats._avgMs, updateStats._p99Ms,
+            renderStats._minMs, renderStats._avgMs, renderStats._p99Ms,
+            measurement._droppedSampleCount);
+        fflush(stdout);
+    }
+
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Times GpuScan::ExclusiveScan(...) on an array of the given length and prints one CSV row
+    in the scan table.  The last run's output is read back and checked against a scan on the
+    CPU, so a fast but wrong variant shows up as unverified rather than as a win.
+
+    Like the kernel table's rows (see RunKernelBenchmarks(...)), the bandwidth counts the 
+    compulsory traffic: every element read once and written once.
+Parameters:
+    numElements     Self-explanatory.
+    useSubgroups    See GpuScan::GetScanShaderDefines(...).
+    copyGbPerSec    The device's copy bandwidth (see MeasureCopyBandwidth(...)).
+Returns:
+    True if the scan could be set up and its output was correct, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+static bool RunScanBenchmarkConfiguration(unsigned int numElements, bool useSubgroups, 
+    double copyGbPerSec)
+{
+    GLuint scanProgramId = AcquireComputeProgram(
+        GpuScan::GetScanShaderDefines(GpuScan::DEFAULT_WORK_GROUP_SIZE, useSubgroups),
+        "shaderScan.comp");
+    if (scanProgramId == 0)
+    {
+        return false;
+    }
+
+    GpuScan scan;
+    scan.Init(scanProgramId);
+    ReleaseProgram(scanProgramId);
+
+    // small values so that the sums of 16 million of them still fit in 32 bits
+    std::vector<GLuint> input(numElements);
+    for (unsigned int elementIndex = 0; elementIndex < numElements; elementIndex++)
+    {
+        input[elementIndex] = elementIndex % 7;
+    }
+
+    GLuint bufferIds[2] = { 0, 0 };
+    glGenBuffers(2, bufferIds);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, bufferIds[0]);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, numElements * sizeof(GLuint), input.data(), 0);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, bufferIds[1]);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, numElements * sizeof(GLuint), 0, 0);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    GpuProfiler profiler;
+    profiler.Init(0);
+    unsigned int scanScopeId = profiler.AddScope("scan");
+
+    // the first run also makes the scan's buffers for the tiles' totals
+    for (unsigned int runCount = 0; runCount < BENCHMARK_SCAN_WARMUP_RUNS; runCount++)
+    {
+        scan.ExclusiveScan(bufferIds[0], bufferIds[1], numElements);
+    }
+    glFinish();
+
+    for (unsigned int runCount = 0; runCount < BENCHMARK_SCAN_MEASURED_RUNS; runCount++)
+    {
+        profiler.BeginScope(scanScopeId);
+        scan.ExclusiveScan(bufferIds[0], bufferIds[1], numElements);
+        profiler.EndScope(scanScopeId);
+        profiler.EndFrame();
+    }
+    glFinish();
+    profiler.EndFrame();
+    profiler.EndFrame();
+
+    GpuProfilerStats scanStats = {};
+    profiler.GetStats(scanScopeId, &scanStats);
+
+    // the scan's writes are shader storage writes
+    std::vector<GLuint> output(numElements);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, bufferIds[1]);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, numElements * sizeof(GLuint), output.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    bool verified = true;
+    GLuint runningSum = 0;
+    for (unsigned int elementIndex = 0; elementIndex < numElements; elementIndex++)
+    {
+        if (output[elementIndex] != runningSum)
+        {
+            verified = false;
+            break;
+        }
+        runningSum += input[elementIndex];
+    }
+
+    // elements per second from the average, which is what a frame budget cares about
+    double gigaElementsPerSec = 0.0;
+    double gbPerSec = 0.0;
+    if (scanStats._avgMs > 0.0f)
+    {
+        gigaElementsPerSec = (numElements / (scanStats._avgMs / 1000.0)) / 1e9;
+        gbPerSec = gigaElementsPerSec * 2.0 * sizeof(GLuint);
+    }
+
+    printf("%u,%d,%u,%u,%.4f,%.4f,%.4f,%.3f,%d,%.2f,%.1f\n",
+        numElements,
+        useSubgroups ? 1 : 0,
+        GpuScan::DEFAULT_WORK_GROUP_SIZE,
+        BENCHMARK_SCAN_MEASURED_RUNS,
+        scanStats._minMs, scanStats._avgMs, scanStats._p99Ms,
+        gigaElementsPerSec,
+        verified ? 1 : 0,
+        gbPerSec,
+        (copyGbPerSec > 0.0) ? (100.0 * gbPerSec / copyGbPerSec) : 0.0);
+    fflush(stdout);
+
+    profiler.Cleanup();
+    scan.Cleanup();
+    DeleteGlBuffers(2, bufferIds);
+    return verified;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    What the SIMD kernels are measured against: the CPU backend's loop as it would be written 
+    in the obvious way, with glm and an array of Particle structures.  Otherwise the same as 
+    the scalar kernel (see ParticleSimdKernels.cpp).
+Parameters:
+    particles       Self-explanatory.
+    particleCount   Self-explanatory.
+    step            See ParticleSimdKernel.
+    deadMask        Same.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+static void StepGlmParticles(Particle *particles, unsigned int particleCount, 
+    const ParticleSimdStep &step, unsigned int *deadMask)
+{
+    memset(deadMask, 0, ((particleCount + 31) / 32) * sizeof(unsigned int));
+    glm::vec2 center(step._centerX, step._centerY);
+    for (unsigned int particleIndex = 0; particleIndex < particleCount; particleIndex++)
+    {
+        Particle &p = particles[particleIndex];
+        if (p._isActive == 0)
+        {
+            continue;
+        }
+
+        bool isAlive = true;
+        for (unsigned int stepIndex = 0; isAlive && stepIndex < step._stepCount; stepIndex++)
+        {
+            p._position += p._velocity * step._stepSec;
+            glm::vec2 centerToParticle = p._position - center;
+            p._age += step._agePerStep;
+            isAlive = (glm::dot(centerToParticle, centerToParticle) <= step._radiusSqr) && 
+                (p._age < 1.0f);
+        }
+        if (!isAlive)
+        {
+            p._isActive = 0;
+            p._age = 0.0f;
+            deadMask[particleIndex / 32] |= (1u << (particleIndex % 32));
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.  0 if there is no time stamp counter.
+
+    Note: The time stamp counter ticks at a fixed rate on every CPU from the last ten years, 
+    whatever the clock speed is at the moment, so a tick is not a core cycle.  It is still 
+    steadier than wall time for comparing the kernels with each other on the same machine.
+Parameters: None
+Returns:
+    The time stamp counter.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+static unsigned long long GetTimeStampTicks()
+{
+#ifdef BENCHMARK_HAS_TIME_STAMP_COUNTER
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Times every SIMD kernel that this CPU supports (see ParticleSimdKernels.h) and the glm loop
+    that they replace (see StepGlmParticles(...)) on the same particles, and prints one CSV row 
+    each in the CPU kernel table.  Every run starts from the same particles, and the last run's
+    particles and dead masks are checked against the glm loop's bit for bit.
+
+    Note: The particles are made up with a fixed seed rather than with rand() so that every 
+    machine runs the same ones.  About 9 in 10 are active, and their ages and speeds are 
+    spread out so that some of them leave the circle or expire during the steps.
+Parameters:
+    numParticles    Self-explanatory.
+Returns:
+    True if every kernel matched the glm loop, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+static bool RunCpuKernelBenchmarkConfiguration(unsigned int numParticles)
+{
+    ParticleSimdStep step;
+    step._centerX = 0.3f;
+    step._centerY = 0.3f;
+    step._radiusSqr = 1.1f * 1.1f;
+    step._stepSec = BENCHMARK_STEP_SEC;
+    step._agePerStep = BENCHMARK_STEP_SEC / 4.0f;
+    step._stepCount = BENCHMARK_CPU_KERNEL_STEPS;
+
+    // a linear congruential generator (the constants are Numerical Recipes')
+    std::vector<Particle> startingParticles(numParticles);
+    unsigned int seed = 12345;
+    for (unsigned int particleIndex = 0; particleIndex < numParticles; particleIndex++)
+    {
+        float random[6];
+        for (int randomIndex = 0; randomIndex < 6; randomIndex++)
+        {
+            seed = (seed * 1664525u) + 1013904223u;
+            random[randomIndex] = (seed >> 8) / 16777216.0f;
+        }
+        Particle &p = startingParticles[particleIndex];
+        p._position = glm::vec2(step._centerX, step._centerY) + 
+            (glm::vec2(random[0], random[1]) * 2.0f - 1.0f) * 0.75f;
+        p._velocity = (glm::vec2(random[2], random[3]) * 2.0f - 1.0f) * 2.0f;
+        p._age = random[4];
+        p._isActive = (random[5] < 0.9f) ? 1 : 0;
+    }
+
+    // the glm loop goes first, since every other row's speedup is against it
+    unsigned int maskWordCount = (numParticles + 31) / 32;
+    std::vector<unsigned int> glmDeadMask(maskWordCount);
+    std::vector<Particle> glmParticles;
+    double glmSec = 0.0;
+    unsigned long long glmTicks = 0;
+    for (unsigned int runCount = 0; runCount < BENCHMARK_CPU_KERNEL_RUNS; runCount++)
+    {
+        glmParticles = startingParticles;
+        std::chrono::high_resolution_clock::time_point start = 
+            std::chrono::high_resolution_clock::now();
+        unsigned long long startTicks = GetTimeStampTicks();
+        StepGlmParticles(glmParticles.data(), numParticles, step, glmDeadMask.data());
+        glmTicks += GetTimeStampTicks() - startTicks;
+        glmSec += std::chrono::duration<double>(
+            std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    double particleSteps = (double)numParticles * BENCHMARK_CPU_KERNEL_STEPS * 
+        BENCHMARK_CPU_KERNEL_RUNS;
+    printf("glm,1,%u,%u,%u,%.4f,%.4f,%.3f,1\n",
+        numParticles,
+        BENCHMARK_CPU_KERNEL_STEPS,
+        BENCHMARK_CPU_KERNEL_RUNS,
+        (glmSec * 1e9) / particleSteps,
+        (glmTicks > 0) ? (particleSteps / glmTicks) : 0.0,
+        1.0);
+    fflush(stdout);
+
+    std::vector<float> positionsX(numParticles);
+    std::vector<float> positionsY(numParticles);
+    std::vector<float> velocitiesX(numParticles);
+    std::vector<float> velocitiesY(numParticles);
+    std::vector<float> ages(numParticles);
+    std::vector<int> isActive(numParticles);
+    std::vector<unsigned int> deadMask(maskWordCount);
+    ParticleSimdArrays arrays;
+    arrays._positionsX = positionsX.data();
+    arrays._positionsY = positionsY.data();
+    arrays._velocitiesX = velocitiesX.data();
+    arrays._velocitiesY = velocitiesY.data();
+    arrays._ages = ages.data();
+    arrays._isActive = isActive.data();
+
+    bool allVerified = true;
+    for (int levelIndex = 0; levelIndex < PARTICLE_SIMD_LEVEL_COUNT; levelIndex++)
+    {
+        ParticleSimdLevel level = (ParticleSimdLevel)levelIndex;
+        if (!IsParticleSimdLevelSupported(level))
+        {
+            continue;
+        }
+
+        ParticleSimdKernel kernel = GetParticleSimdKernel(level);
+        double kernelSec = 0.0;
+        unsigned long long kernelTicks = 0;
+        for (unsigned int runCount = 0; runCount < BENCHMARK_CPU_KERNEL_RUNS; runCount++)
+        {
+            for (unsigned int particleIndex = 0; particleIndex < numParticles; particleIndex++)
+            {
+                const Particle &p = startingParticles[particleIndex];
+                positionsX[particleIndex] = p._position.x;
+                positionsY[particleIndex] = p._position.y;
+                velocitiesX[particleIndex] = p._velocity.x;
+                velocitiesY[particleIndex] = p._velocity.y;
+                ages[particleIndex] = p._age;
+                isActive[particleIndex] = p._isActive;
+            }
+
+            std::chrono::high_resolution_clock::time_point start = 
+                std::chrono::high_resolution_clock::now();
+            unsigned long long startTicks = GetTimeStampTicks();
+            kernel(arrays, 0, numParticles, step, deadMask.data());
+            kernelTicks += GetTimeStampTicks() - startTicks;
+            kernelSec += std::chrono::duration<double>(
+                std::chrono::high_resolution_clock::now() - start).count();
+        }
+
+        bool verified = (deadMask == glmDeadMask);
+        for (unsigned int particleIndex = 0; verified && particleIndex < numParticles; 
+            particleIndex++)
+        {
+            const Particle &p = glmParticles[particleIndex];
+            verified = (positionsX[particleIndex] == p._position.x) && 
+                (positionsY[particleIndex] == p._position.y) && 
+                (ages[particleIndex] == p._age) && 
+                (isActive[particleIndex] == p._isActive);
+        }
+        allVerified = allVerified && verified;
+
+        printf("%s,%u,%u,%u,%u,%.4f,%.4f,%.3f,%d\n",
+            GetParticleSimdLevelName(level),
+            GetParticleSimdLaneCount(level),
+            numParticles,
+            BENCHMARK_CPU_KERNEL_STEPS,
+            BENCHMARK_CPU_KERNEL_RUNS,
+            (kernelSec * 1e9) / particleSteps,
+            (kernelTicks > 0) ? (particleSteps / kernelTicks) : 0.0,
+            (kernelSec > 0.0) ? (glmSec / kernelSec) : 0.0,
+            verified ? 1 : 0);
+        fflush(stdout);
+    }
+    return allVerified;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Makes a pool of particles in one of the kernel table's shapes (see 
+    BenchmarkDistribution).  Same generator as the CPU kernels' particles, so every machine 
+    gets the same ones.
+Parameters:
+    numParticles    Self-explanatory.
+    distribution    Self-explanatory.
+    center          The emitter's center, which the clustered particles are bunched around.
+    putLiveCountHere    How many of the particles are active.
+Returns:
+    The particles.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static std::vector<Particle> MakeBenchmarkParticles(unsigned int numParticles, 
+    BenchmarkDistribution distribution, const glm::vec2 &center, 
+    unsigned int *putLiveCountHere)
+{
+    std::vector<Particle> particles(numParticles);
+    unsigned int liveCount = 0;
+    unsigned int seed = 12345;
+    for (unsigned int particleIndex = 0; particleIndex < numParticles; particleIndex++)
+    {
+        float random[6];
+        for (int randomIndex = 0; randomIndex < 6; randomIndex++)
+        {
+            seed = (seed * 1664525u) + 1013904223u;
+            random[randomIndex] = (seed >> 8) / 16777216.0f;
+        }
+
+        Particle &p = particles[particleIndex];
+        p._position = glm::vec2(random[0], random[1]) * 2.0f - 1.0f;
+        p._velocity = (glm::vec2(random[2], random[3]) * 2.0f - 1.0f) * 0.5f;
+        p._age = random[4];
+        p._isActive = (random[5] < 0.5f) ? 1 : 0;
+        if (distribution == BENCHMARK_DISTRIBUTION_CLUSTERED)
+        {
+            // squaring the spread bunches them up even more toward the middle
+            glm::vec2 spread = glm::vec2(random[0], random[1]) * 2.0f - 1.0f;
+            p._position = center + (spread * glm::abs(spread) * 0.1f);
+        }
+        else if (distribution == BENCHMARK_DISTRIBUTION_ALL_DEAD)
+        {
+            p._position = glm::vec2(0.0f);
+            p._velocity = glm::vec2(0.0f);
+            p._age = 0.0f;
+            p._isActive = 0;
+        }
+        else if (distribution == BENCHMARK_DISTRIBUTION_ALL_ALIVE)
+        {
+            p._isActive = 1;
+        }
+        liveCount += (p._isActive != 0) ? 1 : 0;
+    }
+
+    *putLiveCountHere = liveCount;
+    return particles;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Times one kernel on its own.  Before every run, the input is put back the way that it 
+    started (outside of the timed scope), so every run sees the same input no matter what the
+    last run did to it.
+Parameters:
+    prepare     Resets the kernel's input.  Not timed.
+    kernel      Issues the kernel.  Timed with a GPU profiler scope.
+    putStatsHere    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static void TimeBenchmarkKernel(const std::function<void()> &prepare, 
+    const std::function<void()> &kernel, GpuProfilerStats *putStatsHere)
+{
+    GpuProfiler profiler;
+    profiler.Init(0);
+    unsigned int kernelScopeId = profiler.AddScope("kernel");
+    for (unsigned int runCount = 0; runCount < BENCHMARK_KERNEL_WARMUP_RUNS; runCount++)
+    {
+        prepare();
+        kernel();
+    }
+    glFinish();
+
+    for (unsigned int runCount = 0; runCount < BENCHMARK_KERNEL_MEASURED_RUNS; runCount++)
+    {
+        prepare();
+        profiler.BeginScope(kernelScopeId);
+        kernel();
+        profiler.EndScope(kernelScopeId);
+        profiler.EndFrame();
+    }
+    glFinish();
+    profiler.EndFrame();
+    profiler.EndFrame();
+
+    GpuProfilerStats noStats = {};
+    *putStatsHere = noStats;
+    profiler.GetStats(kernelScopeId, putStatsHere);
+    profiler.Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Prints one row of the kernel table.  The rate is the kernel's compulsory traffic (the 
+    bytes that it can't avoid reading or writing at least once, see RunKernelBenchmarks(...)) 
+    over its average time, so it is a lower bound on the bandwidth that it really used.
+Parameters:
+    kernelName      Self-explanatory.
+    distribution    Self-explanatory.
+    numParticles    Self-explanatory.
+    liveCount       Self-explanatory.
+    bytesMoved      The compulsory traffic.
+    copyGbPerSec    The device's copy bandwidth (see MeasureCopyBandwidth(...)).
+    stats           Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static void PrintKernelBenchmarkRow(const char *kernelName, const char *distributionName, 
+    unsigned int numParticles, unsigned int liveCount, double bytesMoved, double copyGbPerSec,
+    const GpuProfilerStats &stats)
+{
+    double gbPerSec = (stats._avgMs > 0.0f) ? (bytesMoved / (stats._avgMs / 1000.0)) / 1e9 : 0.0;
+    printf("%s,%s,%u,%u,%u,%.4f,%.4f,%.4f,%.2f,%.2f,%.1f\n",
+        kernelName,
+        distributionName,
+        numParticles,
+        liveCount,
+        BENCHMARK_KERNEL_MEASURED_RUNS,
+        stats._minMs, stats._avgMs, stats._p99Ms,
+        bytesMoved / (1024.0 * 1024.0),
+        gbPerSec,
+        (copyGbPerSec > 0.0) ? (100.0 * gbPerSec / copyGbPerSec) : 0.0);
+    fflush(stdout);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Measures how fast the GPU can copy one buffer into another, which stands in for the 
+    device's memory bandwidth in the kernel table.  OpenGL has no way to ask for the 
+    theoretical bandwidth, and a big copy gets close to what the memory can really do, so 
+    "percent of copy" is how far a kernel is from the roofline that it could actually reach.
+Parameters: None
+Returns:
+    GB/s, counting both the read and the write, or 0 if the copy couldn't be timed.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static double MeasureCopyBandwidth()
+{
+    const GLsizeiptr copySizeBytes = 128 * 1024 * 1024;
+    GLuint bufferIds[2] = { 0, 0 };
+    glGenBuffers(2, bufferIds);
+    for (int bufferIndex = 0; bufferIndex < 2; bufferIndex++)
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, bufferIds[bufferIndex]);
+        glBufferStorage(GL_COPY_WRITE_BUFFER, copySizeBytes, 0, 0);
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, bufferIds[0]);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, bufferIds[1]);
+
+    GpuProfilerStats copyStats;
+    TimeBenchmarkKernel([]() {}, [copySizeBytes]()
+    {
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, copySizeBytes);
+    }, &copyStats);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    DeleteGlBuffers(2, bufferIds);
+    if (copyStats._avgMs <= 0.0f)
+    {
+        return 0.0;
+    }
+    return ((2.0 * copySizeBytes) / (copyStats._avgMs / 1000.0)) / 1e9;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Times each of the GPU's particle kernels on its own, on every input distribution, and 
+    prints one CSV row each in the kernel table.  The update is run 4 ways: with no emission 
+    ("update"), with a full emission quota ("update_emit", so the difference is the emit 
+    pass), with the same quota sent out by the update itself ("update_emit_fused", see 
+    ParticleManager::SetFusedEmitUpdate(...)), and with the compacted list of live particles 
+    ("update_live_list").  Then the sort
+    (see ParticleManager::SortParticles()), the stats reduction (see ParticleStatsReducer), the
+    heatmap's histogram (see ParticleHeatmapExporter), and the density splat (see 
+    DensitySplatRenderer), each on a pool whose live list was made by one update with no 
+    emission.
+
+    The compulsory traffic, with S bytes per particle, N particles, and L live ones, is 
+    counted as: the update reads every particle and writes the live ones (N*S + L*S), plus 
+    S for each emitted one; the live list update reads and writes only the live ones and 
+    their indices (2*L*S + 4*L); the sort reads and writes every particle twice (the scratch
+    copy and the gather) and each (key, slot) pair once (4*N*S + 16*N); the reduction and 
+    the histogram read every particle once (N*S, plus 8 bytes per bin for the histogram); 
+    and the splat reads the live particles and their indices, and clears and resolves its 
+    image (L*(S + 4) + 8 bytes per pixel).
+
+    Note: The emitter's radius is bigger than the window, so no particle leaves it during 
+    the runs and the live count stays what the distribution made.
+Parameters:
+    copyGbPerSec    The device's copy bandwidth (see MeasureCopyBandwidth(...)).
+Returns:
+    True if every kernel could be set up, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static bool RunKernelBenchmarks(double copyGbPerSec)
+{
+    const unsigned int numParticles = BENCHMARK_KERNEL_PARTICLES;
+    const ParticleLayout layout = PARTICLE_LAYOUT_SOA;
+    const glm::vec2 center(+0.3f, +0.3f);
+    const ParticleLayoutDescriptor &layoutDescriptor = GetParticleLayoutDescriptor(layout);
+    double particleBytes = 0.0;
+    for (unsigned int bufferIndex = 0; bufferIndex < GetParticleBufferCount(layoutDescriptor);
+        bufferIndex++)
+    {
+        particleBytes += Std430BufferStride(layoutDescriptor, bufferIndex);
+    }
+
+    GLuint particleProgramId = AcquireRenderProgram();
+    // the same program as the demo's, which can also fuse the emit into the update, which is 
+    // only turned on for its own row
+    ParticleKernelVariant kernelVariant = ParticleManager::GetDefaultKernelVariant();
+    kernelVariant._atomicAggregation = ParticleManager::GetBestAtomicAggregation();
+    kernelVariant._hasFusedEmitUpdate = true;
+    GLuint computeProgramId = AcquireComputeProgram(ParticleManager::GetComputeShaderDefines(
+        layout, ParticleManager::DEFAULT_WORK_GROUP_SIZE, kernelVariant));
+    GLuint sortProgramId = AcquireComputeProgram(ParticleManager::GetSortShaderDefines(layout));
+    GLuint statsProgramId = AcquireComputeProgram(
+        ParticleStatsReducer::GetStatsShaderDefines(layout));
+    GLuint heatmapProgramId = AcquireComputeProgram(
+        ParticleHeatmapExporter::GetHeatmapShaderDefines(layout));
+    GLuint splatProgramId = AcquireComputeProgram(
+        DensitySplatRenderer::GetSplatShaderDefines(layout, 
+        ParticleManager::DEFAULT_WORK_GROUP_SIZE));
+    GLuint resolveProgramId = AcquireRenderProgram("shaderDensityResolve.vert", 
+        "shaderDensityResolve.frag");
+    const GLuint programIds[] = { particleProgramId, computeProgramId, sortProgramId, 
+        statsProgramId, heatmapProgramId, splatProgramId, resolveProgramId };
+    const unsigned int numPrograms = sizeof(programIds) / sizeof(programIds[0]);
+    bool hasPrograms = true;
+    for (unsigned int programIndex = 0; programIndex < numPrograms; programIndex++)
+    {
+        hasPrograms = hasPrograms && (programIds[programIndex] != 0);
+    }
+    if (!hasPrograms)
+    {
+        for (unsigned int programIndex = 0; programIndex < numPrograms; programIndex++)
+        {
+            ReleaseProgram(programIds[programIndex]);
+        }
+        return false;
+    }
+
+    ParticleManager particleManager;
+    particleManager.Init(particleProgramId, computeProgramId, numParticles, 0, center, 4.0f, 
+        0.05f, 0.6f, layout);
+    ParticleStatsReducer statsReducer;
+    statsReducer.Init(statsProgramId);
+    statsReducer.SetInterval(1);
+    ParticleHeatmapExporter heatmapExporter;
+    heatmapExporter.Init(heatmapProgramId);
+    DensitySplatRenderer splatRenderer;
+    splatRenderer.Init(splatProgramId, resolveProgramId, BENCHMARK_FRAMEBUFFER_WIDTH, 
+        BENCHMARK_FRAMEBUFFER_HEIGHT);
+    for (unsigned int programIndex = 0; programIndex < numPrograms; programIndex++)
+    {
+        ReleaseProgram(programIds[programIndex]);
+    }
+
+    ParticleSortRequest sortRequest;
+    sortRequest._key = PARTICLE_SORT_KEY_MORTON;
+    sortRequest._depthDirection = glm::vec2(0.0f, 1.0f);
+    sortRequest._backToFront = false;
+    sortRequest._updatesBetweenSorts = 1000000;
+
+    ParticleEmitter emitter = particleManager.GetEmitters()[0];
+    unsigned int emitCount = numParticles / 50;
+    for (int distributionIndex = 0; distributionIndex < BENCHMARK_DISTRIBUTION_COUNT; 
+        distributionIndex++)
+    {
+        BenchmarkDistribution distribution = (BenchmarkDistribution)distributionIndex;
+        const char *distributionName = BENCHMARK_DISTRIBUTION_NAMES[distributionIndex];
+        unsigned int liveCount = 0;
+        std::vector<Particle> particles = 
+            MakeBenchmarkParticles(numParticles, distribution, center, &liveCount);
+        double n = numParticles;
+        double l = liveCount;
+        double s = particleBytes;
+
+        // the update with and without emission, and with the live list
+        std::function<void()> loadParticles = [&]() 
+        { 
+            particleManager.LoadParticles(particles); 
+        };
+        std::function<void()> update = [&]() 
+        { 
+            particleManager.UpdateSteps(BENCHMARK_STEP_SEC, 1); 
+        };
+        GpuProfilerStats stats;
+        TimeBenchmarkKernel(loadParticles, update, &stats);
+        PrintKernelBenchmarkRow("update", distributionName, numParticles, liveCount, 
+            (n * s) + (l * s), copyGbPerSec, stats);
+
+        emitter._maxParticlesEmittedPerFrame = emitCount;
+        particleManager.SetEmitter(0, emitter);
+        TimeBenchmarkKernel(loadParticles, update, &stats);
+        double emittedCount = (emitCount < (n - l)) ? emitCount : (n - l);
+        PrintKernelBenchmarkRow("update_emit", distributionName, numParticles, liveCount, 
+            (n * s) + ((l + emittedCount) * s), copyGbPerSec, stats);
+
+        // the same compulsory traffic, so the two rows' rates compare directly
+        particleManager.SetFusedEmitUpdate(true);
+        TimeBenchmarkKernel(loadParticles, update, &stats);
+        PrintKernelBenchmarkRow("update_emit_fused", distributionName, numParticles, liveCount,
+            (n * s) + ((l + emittedCount) * s), copyGbPerSec, stats);
+        particleManager.SetFusedEmitUpdate(false);
+        emitter._maxParticlesEmittedPerFrame = 0;
+        particleManager.SetEmitter(0, emitter);
+
+        particleManager.SetLiveUpdateList(true);
+        TimeBenchmarkKernel(loadParticles, update, &stats);
+        PrintKernelBenchmarkRow("update_live_list", distributionName, numParticles, 
+            liveCount, (2.0 * l * s) + (4.0 * l), copyGbPerSec, stats);
+        particleManager.SetLiveUpdateList(false);
+
+        // everything after this reads the live list and the draw command, which one update 
+        // makes
+        std::function<void()> loadAndUpdate = [&]()
+        {
+            particleManager.LoadParticles(particles);
+            particleManager.UpdateSteps(BENCHMARK_STEP_SEC, 1);
+        };
+
+        particleManager.SetParticleSort(sortProgramId, sortRequest);
+        TimeBenchmarkKernel(loadAndUpdate, [&]() { particleManager.SortParticles(); }, &stats);
+        PrintKernelBenchmarkRow("sort", distributionName, numParticles, liveCount, 
+            (4.0 * n * s) + (16.0 * n), copyGbPerSec, stats);
+        particleManager.ClearParticleSort();
+
+        TimeBenchmarkKernel(loadAndUpdate, [&]() { statsReducer.Update(numParticles); }, 
+            &stats);
+        PrintKernelBenchmarkRow("reduction", distributionName, numParticles, liveCount, 
+            n * s, copyGbPerSec, stats);
+
+        // the histogram is only made when an export is due, so every run is made due; the 
+        // exports themselves go to a scratch file that is deleted at the end
+        // Note: An export with no free slot is dropped without a dispatch, so the glFinish()
+        // in the reset lets the writer thread keep up.
+        const int heatmapSize = 256;
+        heatmapExporter.Start(BENCHMARK_KERNEL_HEATMAP_PATH, heatmapSize, heatmapSize, 0.0f, 
+            glm::vec2(-1.0f, -1.0f), glm::vec2(+1.0f, +1.0f));
+        float heatmapTimeSec = 0.0f;
+        TimeBenchmarkKernel([&]() { loadAndUpdate(); glFinish(); }, [&]()
+        {
+            heatmapTimeSec += 1.0f;
+            heatmapExporter.RecordFrame(numParticles, heatmapTimeSec);
+        }, &stats);
+        heatmapExporter.Stop();
+        remove(BENCHMARK_KERNEL_HEATMAP_PATH);
+        PrintKernelBenchmarkRow("histogram", distributionName, numParticles, liveCount, 
+            (n * s) + (8.0 * heatmapSize * heatmapSize), copyGbPerSec, stats);
+
+        double pixelCount = (double)BENCHMARK_FRAMEBUFFER_WIDTH * BENCHMARK_FRAMEBUFFER_HEIGHT;
+        TimeBenchmarkKernel(loadAndUpdate, [&]() { splatRenderer.Render(0.0f, numParticles); }, 
+            &stats);
+        PrintKernelBenchmarkRow("splat", distributionName, numParticles, liveCount, 
+            (l * (s + 4.0)) + (8.0 * pixelCount), copyGbPerSec, stats);
+    }
+
+    splatRenderer.Cleanup();
+    heatmapExporter.Cleanup();
+    statsReducer.Cleanup();
+    particleManager.Cleanup();
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Runs every benchmark configuration into an offscreen framebuffer and prints the results as
+    CSV.  See Benchmark.h.
+Parameters: None
+Returns:
+    0 if every configuration ran, otherwise 1.  Suitable for returning from main(...).
+Exception:  Safe
+Creator:    John Cox (8-10-2016)
+-----------------------------------------------------------------------------------------------*/
+int RunBenchmark()
+{
+    GLuint framebufferId = 0;
+    GLuint renderbufferId = 0;
+    if (!CreateOffscreenFramebuffer(BENCHMARK_FRAMEBUFFER_WIDTH, BENCHMARK_FRAMEBUFFER_HEIGHT,
+        &framebufferId, &renderbufferId))
+    {
+        return 1;
+    }
+
+    // no depth in the offscreen framebuffer, and nothing here needs it
+    DisableGlCapability(GL_DEPTH_TEST);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
+    // the point sprite rows must honor the point size too, or the quads would be compared 
+    // against 1-pixel points
+    glEnable(GL_PROGRAM_POINT_SIZE);
+
+    printf("# renderer: %s\n", (const char *)glGetString(GL_RENDERER));
+    printf("# version: %s\n", (const char *)glGetString(GL_VERSION));
+    printf("particles,layout,buffer_access,particles_per_invocation,primitive,point_size,frames,cpu_submit_ms,wall_ms_per_frame,"
+        "gpu_update_min_ms,gpu_update_avg_ms,gpu_update_p99_ms,"
+        "gpu_render_min_ms,gpu_render_avg_ms,gpu_render_p99_ms,dropped_samples\n");
+
+    const unsigned int particleCounts[] = { 20000, 600000, 2000000, 8000000 };
+    unsigned int numConfigurations = sizeof(particleCounts) / sizeof(particleCounts[0]);
+    int result = 0;
+
+    // immutable storage versus the old mutable storage, back to back at every count, so the 
+    // effect on the compute pass can be read straight off of neighboring rows
+    const ParticleBufferAccess bufferAccesses[] = 
+    { 
+        PARTICLE_BUFFER_ACCESS_GPU_ONLY, 
+        PARTICLE_BUFFER_ACCESS_MUTABLE 
+    };
+    unsigned int numBufferAccesses = sizeof(bufferAccesses) / sizeof(bufferAccesses[0]);
+    for (unsigned int configIndex = 0; configIndex < numConfigurations; configIndex++)
+    {
+        for (unsigned int accessIndex = 0; accessIndex < numBufferAccesses; accessIndex++)
+        {
+            if (!RunBenchmarkConfiguration(particleCounts[configIndex], PARTICLE_LAYOUT_SOA, 
+                bufferAccesses[accessIndex], 1, BENCHMARK_PRIMITIVE_POINTS, 1.0f))
+            {
+                printf("# configuration with %u particles failed\n", particleCounts[configIndex]);
+                result = 1;
+            }
+        }
+    }
+
+    // work coarsening versus one particle per work item, at a count large enough for the 
+    // number of work groups to matter
+    const unsigned int particlesPerInvocation[] = { 1, 2, 4, 8, 16 };
+    unsigned int numCoarsenings = sizeof(particlesPerInvocation) / sizeof(particlesPerInvocation[0]);
+    for (unsigned int coarseningIndex = 0; coarseningIndex < numCoarsenings; coarseningIndex++)
+    {
+        if (!RunBenchmarkConfiguration(2000000, PARTICLE_LAYOUT_SOA, 
+            PARTICLE_BUFFER_ACCESS_GPU_ONLY, particlesPerInvocation[coarseningIndex], 
+            BENCHMARK_PRIMITIVE_POINTS, 1.0f))
+        {
+            printf("# configuration with %u particles per invocation failed\n", 
+                particlesPerInvocation[coarseningIndex]);
+            result = 1;
+        }
+    }
+
+    // point sprites versus instanced quads versus instanced octagons as the particles get 
+    // bigger; points win while they are small, and the quads' fill savings show up once 
+    // fragments cost more than vertices
+    const float pointSizes[] = { 2.0f, 8.0f, 32.0f };
+    unsigned int numPointSizes = sizeof(pointSizes) / sizeof(pointSizes[0]);
+    const BenchmarkPrimitive primitives[] = 
+    {
+        BENCHMARK_PRIMITIVE_POINTS,
+        BENCHMARK_PRIMITIVE_SQUARE_QUADS,
+        BENCHMARK_PRIMITIVE_OCTAGON_QUADS
+    };
+    unsigned int numPrimitives = sizeof(primitives) / sizeof(primitives[0]);
+    for (unsigned int sizeIndex = 0; sizeIndex < numPointSizes; sizeIndex++)
+    {
+        for (unsigned int primitiveIndex = 0; primitiveIndex < numPrimitives; primitiveIndex++)
+        {
+            if (!RunBenchmarkConfiguration(600000, PARTICLE_LAYOUT_SOA, 
+                PARTICLE_BUFFER_ACCESS_GPU_ONLY, 1, primitives[primitiveIndex], 
+                pointSizes[sizeIndex]))
+            {
+                printf("# configuration with primitive %d and point size %.1f failed\n", 
+                    (int)primitives[primitiveIndex], pointSizes[sizeIndex]);
+                result = 1;
+            }
+        }
+    }
+
+    // the targeted barrier after the update against GL_ALL_BARRIER_BITS, back to back at 
+    // every count of the particle table
+    printf("# update barrier\n");
+    printf("particles,barrier,frames,wall_ms_per_frame,"
+        "gpu_update_min_ms,gpu_update_avg_ms,gpu_update_p99_ms,"
+        "gpu_render_min_ms,gpu_render_avg_ms,gpu_render_p99_ms,dropped_samples\n");
+    for (unsigned int configIndex = 0; configIndex < numConfigurations; configIndex++)
+    {
+        if (!RunBarrierBenchmarkConfiguration(particleCounts[configIndex]))
+        {
+            printf("# barrier configuration with %u particles failed\n", 
+                particleCounts[configIndex]);
+            result = 1;
+        }
+    }
+
+    // the scan on its own, in another table since its columns have nothing to do with 
+    // particles; shared memory and subgroups back to back at every length
+    // Note: The copy rate is the roofline that the scan and the kernel table are measured 
+    // against.
+    double copyGbPerSec = MeasureCopyBandwidth();
+    printf("# copy bandwidth: %.1f GB/s\n", copyGbPerSec);
+    printf("# scan\n");
+    printf("elements,subgroups,work_group_size,runs,gpu_min_ms,gpu_avg_ms,gpu_p99_ms,"
+        "gelements_per_sec,verified,gb_per_sec,percent_of_copy\n");
+    bool canUseSubgroups = GpuScan::IsSubgroupScanSupported();
+    const unsigned int scanLengths[] = { 1 << 20, 1 << 21, 1 << 22, 1 << 23, 1 << 24 };
+    unsigned int numScanLengths = sizeof(scanLengths) / sizeof(scanLengths[0]);
+    for (unsigned int lengthIndex = 0; lengthIndex < numScanLengths; lengthIndex++)
+    {
+        for (int subgroupIndex = 0; subgroupIndex < (canUseSubgroups ? 2 : 1); subgroupIndex++)
+        {
+            if (!RunScanBenchmarkConfiguration(scanLengths[lengthIndex], subgroupIndex != 0, 
+                copyGbPerSec))
+            {
+                printf("# scan of %u elements (subgroups %d) failed\n", 
+                    scanLengths[lengthIndex], subgroupIndex);
+                result = 1;
+            }
+        }
+    }
+
+    // each GPU particle kernel on its own, on each kind of input
+    printf("# gpu kernels\n");
+    printf("kernel,distribution,particles,live,runs,gpu_min_ms,gpu_avg_ms,gpu_p99_ms,"
+        "compulsory_mb,gb_per_sec,percent_of_copy\n");
+    if (!RunKernelBenchmarks(copyGbPerSec))
+    {
+        printf("# gpu kernels failed\n");
+        result = 1;
+    }
+
+    // the CPU backend's kernels on their own, in another table; no OpenGL at all
+    printf("# cpu kernels\n");
+    printf("kernel,lanes,particles,steps,runs,ns_per_particle_step,particle_steps_per_tick,"
+        "speedup_vs_glm,verified\n");
+    const unsigned int kernelParticleCounts[] = { 100000, 2000000 };
+    unsigned int numKernelParticleCounts = 
+        sizeof(kernelParticleCounts) / sizeof(kernelParticleCounts[0]);
+    for (unsigned int countIndex = 0; countIndex < numKernelParticleCounts; countIndex++)
+    {
+        if (!RunCpuKernelBenchmarkConfiguration(kernelParticleCounts[countIndex]))
+        {
+            printf("# cpu kernels with %u particles didn't match the glm loop\n", 
+                kernelParticleCounts[countIndex]);
+            result = 1;
+        }
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &framebufferId);
+    glDeleteRenderbuffers(1, &renderbufferId);
+    return result;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    A sweep over the counts of the particle table with every layout, 3 work group sizes, and
+    points against quads, compared with nothing and written to sweep.csv.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+BenchmarkSweepSettings GetDefaultBenchmarkSweepSettings()
+{
+    BenchmarkSweepSettings settings;
+    settings._particleCounts = { 20000, 600000, 2000000 };
+    settings._layouts = { PARTICLE_LAYOUT_INTERLEAVED, PARTICLE_LAYOUT_SOA, 
+        PARTICLE_LAYOUT_HALF_FLOAT };
+    settings._workGroupSizes = { 64, 128, 256 };
+    settings._primitives = { BENCHMARK_PRIMITIVE_POINTS, BENCHMARK_PRIMITIVE_SQUARE_QUADS };
+    settings._warmupFrames = BENCHMARK_WARMUP_FRAMES;
+    settings._measuredFrames = BENCHMARK_MEASURED_FRAMES;
+    settings._reportPath = "sweep.csv";
+    settings._regressionThreshold = 0.1f;
+    settings._sampleHardwareCounters = false;
+    settings._retryThrottledCells = false;
+    settings._stabilizeTimeoutSec = 0;
+    return settings;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Finds a name in a table of names.
+Parameters:
+    names       Self-explanatory.
+    nameCount   Self-explanatory.
+    name        Self-explanatory.
+Returns:
+    The name's index, or -1 if it isn't in the table.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static int FindBenchmarkName(const char *names[], int nameCount, const std::string &name)
+{
+    for (int nameIndex = 0; nameIndex < nameCount; nameIndex++)
+    {
+        if (name == names[nameIndex])
+        {
+            return nameIndex;
+        }
+    }
+    return -1;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Replaces one axis of the sweep's grid, or one of its other settings, from an assignment 
+    on the command line.  The axes are lists:
+
+        counts=20000,600000
+        layouts=interleaved,soa,half_float,fixed_point
+        work_groups=64,128,256,512,1024
+        primitives=points,quads,octagons
+
+    and the rest are single values: "warmup=120", "frames=500", "report=sweep.csv", 
+    "baseline=baseline.csv", and "threshold=0.1".  "counters=default" adds the hardware 
+    counters to the report, and "counters=l3,occupancy" adds only the ones with those words 
+    in their names (see GpuHardwareCounters::SetCounterFilter(...)).  "throttle=discard" 
+    measures a throttled cell again instead of only flagging it ("throttle=flag"), and 
+    "stabilize=60" runs the GPU for up to 60 seconds until its clocks settle before the first 
+    cell.
+Parameters:
+    assignment  Self-explanatory.
+    settings    The setting is only changed if the whole assignment could be read.
+Returns:
+    True if the assignment was understood, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool SetBenchmarkSweepAxis(const std::string &assignment, BenchmarkSweepSettings *settings)
+{
+    size_t equalsAt = assignment.find('=');
+    if (equalsAt == std::string::npos)
+    {
+        return false;
+    }
+    std::string name = assignment.substr(0, equalsAt);
+    std::string value = assignment.substr(equalsAt + 1);
+    if (name == "report")
+    {
+        settings->_reportPath = value;
+        return true;
+    }
+    else if (name == "baseline")
+    {
+        settings->_baselinePath = value;
+        return true;
+    }
+    else if (name == "threshold")
+    {
+        settings->_regressionThreshold = (float)atof(value.c_str());
+        return settings->_regressionThreshold >= 0.0f;
+    }
+    else if (name == "counters")
+    {
+        settings->_sampleHardwareCounters = true;
+        settings->_hardwareCounterFilter = (value == "default") ? "" : value;
+        return true;
+    }
+    else if (name == "throttle")
+    {
+        if (value != "flag" && value != "discard")
+        {
+            return false;
+        }
+        settings->_retryThrottledCells = (value == "discard");
+        return true;
+    }
+    else if (name == "stabilize")
+    {
+        int timeoutSec = atoi(value.c_str());
+        if (timeoutSec < 0)
+        {
+            return false;
+        }
+        settings->_stabilizeTimeoutSec = (unsigned int)timeoutSec;
+        return true;
+    }
+
+    // everything else is a list of whole numbers or of names
+    std::vector<unsigned int> numbers;
+    std::vector<int> nameIndices;
+    std::stringstream valueStream(value);
+    std::string item;
+    while (std::getline(valueStream, item, ','))
+    {
+        if (name == "layouts")
+        {
+            nameIndices.push_back(FindBenchmarkName(BENCHMARK_LAYOUT_NAMES, 4, item));
+        }
+        else if (name == "primitives")
+        {
+            nameIndices.push_back(FindBenchmarkName(BENCHMARK_PRIMITIVE_NAMES, 3, item));
+        }
+        else
+        {
+            int number = atoi(item.c_str());
+            if (number <= 0)
+            {
+                return false;
+            }
+            numbers.push_back((unsigned int)number);
+        }
+        if (!nameIndices.empty() && nameIndices.back() < 0)
+        {
+            return false;
+        }
+    }
+    if (numbers.empty() && nameIndices.empty())
+    {
+        return false;
+    }
+
+    if (name == "counts")
+    {
+        settings->_particleCounts = numbers;
+    }
+    else if (name == "work_groups")
+    {
+        settings->_workGroupSizes = numbers;
+    }
+    else if (name == "warmup" && numbers.size() == 1)
+    {
+        settings->_warmupFrames = numbers[0];
+    }
+    else if (name == "frames" && numbers.size() == 1)
+    {
+        settings->_measuredFrames = numbers[0];
+    }
+    else if (name == "layouts")
+    {
+        settings->_layouts.clear();
+        for (size_t index = 0; index < nameIndices.size(); index++)
+        {
+            settings->_layouts.push_back((ParticleLayout)nameIndices[index]);
+        }
+    }
+    else if (name == "primitives")
+    {
+        settings->_primitives.clear();
+        for (size_t index = 0; index < nameIndices.size(); index++)
+        {
+            settings->_primitives.push_back((BenchmarkPrimitive)nameIndices[index]);
+        }
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Reads the GPU frame time of every cell of an earlier sweep's report.  The columns are 
+    found by their names in the header, so a report with more columns (or in a different 
+    order) still reads.
+Parameters:
+    filePath            Self-explanatory.
+    putBaselineHere     Keyed by "particles,layout,work_group_size,primitive".
+Returns:
+    True if the file was a sweep report, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static bool LoadBenchmarkBaseline(const std::string &filePath, 
+    std::map<std::string, double> *putBaselineHere)
+{
+    std::ifstream baselineFile(filePath.c_str());
+    if (!baselineFile.is_open())
+    {
+        return false;
+    }
+
+    const char *keyColumnNames[] = { "particles", "layout", "work_group_size", "primitive" };
+    int keyColumns[4] = { -1, -1, -1, -1 };
+    int timeColumn = -1;
+    bool hasHeader = false;
+    std::string line;
+    while (std::getline(baselineFile, line))
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        std::vector<std::string> fields;
+        std::stringstream lineStream(line);
+        std::string field;
+        while (std::getline(lineStream, field, ','))
+        {
+            fields.push_back(field);
+        }
+
+        if (!hasHeader)
+        {
+            hasHeader = true;
+            for (int fieldIndex = 0; fieldIndex < (int)fields.size(); fieldIndex++)
+            {
+                int keyIndex = FindBenchmarkName(keyColumnNames, 4, fields[fieldIndex]);
+                if (keyIndex >= 0)
+                {
+                    keyColumns[keyIndex] = fieldIndex;
+                }
+                if (fields[fieldIndex] == "gpu_frame_avg_ms")
+                {
+                    timeColumn = fieldIndex;
+                }
+            }
+            for (int keyIndex = 0; keyIndex < 4; keyIndex++)
+            {
+                if (keyColumns[keyIndex] < 0)
+                {
+                    return false;
+                }
+            }
+            if (timeColumn < 0)
+            {
+                return false;
+            }
+            continue;
+        }
+
+        std::string key;
+        bool isComplete = (timeColumn < (int)fields.size());
+        for (int keyIndex = 0; isComplete && keyIndex < 4; keyIndex++)
+        {
+            isComplete = (keyColumns[keyIndex] < (int)fields.size());
+            if (isComplete)
+            {
+                key += (keyIndex > 0) ? "," : "";
+                key += fields[keyColumns[keyIndex]];
+            }
+        }
+        if (isComplete)
+        {
+            (*putBaselineHere)[key] = atof(fields[timeColumn].c_str());
+        }
+    }
+    return hasHeader;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Runs every cell of a parameter sweep's grid (see BenchmarkSweepSettings) into an 
+    offscreen framebuffer, and writes one CSV row per cell to the report and to stdout.  This 
+    is for picking the configuration for a GPU, and for catching performance regressions: 
+    with a baseline (the report of an earlier run), each cell's GPU frame time (the update's 
+    and the render's averages) is compared with the baseline's, and a cell that is slower by 
+    more than the threshold is reported as "regressed".
+
+    With the hardware counters (see BenchmarkSweepSettings::_sampleHardwareCounters), each 
+    row also has the update's and the render's counters, averaged over the measured frames, 
+    so a change in time comes with the change in what the GPU was doing (ex: less memory 
+    traffic, or more occupancy) that explains it.
+
+    Each row also has the GPU's lowest and average graphics clock, its hottest temperature, 
+    and its average power over the measured frames (see GpuClockMonitor.h), and how many of 
+    the samples were throttled.  A throttled cell's time says more about the GPU's cooling 
+    than about the code, so its status is "throttled" and it isn't counted as a regression 
+    (with "throttle=discard", it is measured again first, in case the GPU has cooled off).  
+    Where the clocks can't be read, those columns are empty.
+
+    Note: A work group size that the device doesn't support is skipped rather than failed, 
+    so the same grid can be run on every GPU.  A cell that the baseline doesn't have is 
+    "new", and one that is faster by more than the threshold is "improved".
+Parameters:
+    settings    Self-explanatory.
+Returns:
+    0 if every cell ran and none of them regressed, otherwise 1.  Suitable for returning from 
+    main(...), so that a script can fail on a regression.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+int RunBenchmarkSweep(const BenchmarkSweepSettings &settings)
+{
+    std::map<std::string, double> baseline;
+    if (!settings._baselinePath.empty() && 
+        !LoadBenchmarkBaseline(settings._baselinePath, &baseline))
+    {
+        printf("# couldn't read the baseline '%s'\n", settings._baselinePath.c_str());
+        return 1;
+    }
+
+    FILE *reportFile = fopen(settings._reportPath.c_str(), "w");
+    if (reportFile == 0)
+    {
+        printf("# couldn't open the report '%s'\n", settings._reportPath.c_str());
+        return 1;
+    }
+
+    GLuint framebufferId = 0;
+    GLuint renderbufferId = 0;
+    if (!CreateOffscreenFramebuffer(BENCHMARK_FRAMEBUFFER_WIDTH, BENCHMARK_FRAMEBUFFER_HEIGHT,
+        &framebufferId, &renderbufferId))
+    {
+        fclose(reportFile);
+        return 1;
+    }
+    DisableGlCapability(GL_DEPTH_TEST);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glEnable(GL_PROGRAM_POINT_SIZE);
+
+    // the report starts with the GPU that it was measured on, since a baseline is only 
+    // meaningful on the same GPU and driver
+    std::string header = "particles,layout,work_group_size,primitive,frames,cpu_submit_ms,"
+        "wall_ms_per_frame,gpu_update_avg_ms,gpu_update_p99_ms,gpu_render_avg_ms,"
+        "gpu_render_p99_ms,gpu_frame_avg_ms,baseline_gpu_frame_avg_ms,change_percent,status,"
+        "gpu_clock_min_mhz,gpu_clock_avg_mhz,gpu_temp_max_c,gpu_power_avg_w,throttled_samples";
+    GpuClockMonitor clocks;
+    bool hasClocks = clocks.Init();
+
+    // the counters go after everything else, so that the baseline's columns are where they 
+    // always were; the driver's names can have commas in them, which the CSV can't
+    GpuHardwareCounters counters;
+    unsigned int updateCounterScopeId = 0;
+    unsigned int renderCounterScopeId = 0;
+    bool hasCounters = false;
+    if (settings._sampleHardwareCounters)
+    {
+        counters.SetCounterFilter(settings._hardwareCounterFilter);
+        hasCounters = counters.Init(0);
+        updateCounterScopeId = counters.AddScope("update");
+        renderCounterScopeId = counters.AddScope("render");
+        const char *scopeNames[2] = { "update", "render" };
+        for (int scopeIndex = 0; scopeIndex < 2; scopeIndex++)
+        {
+            for (unsigned int counterIndex = 0; counterIndex < counters.GetCounterCount(); 
+                counterIndex++)
+            {
+                std::string counterName = counters.GetCounterName(counterIndex);
+                for (size_t charIndex = 0; charIndex < counterName.size(); charIndex++)
+                {
+                    counterName[charIndex] = 
+                        (counterName[charIndex] == ',') ? ';' : counterName[charIndex];
+                }
+                header += std::string(",") + scopeNames[scopeIndex] + ":" + counterName;
+            }
+        }
+    }
+    FILE *outputs[2] = { stdout, reportFile };
+    for (int outputIndex = 0; outputIndex < 2; outputIndex++)
+    {
+        fprintf(outputs[outputIndex], "# renderer: %s\n", (const char *)glGetString(GL_RENDERER));
+        fprintf(outputs[outputIndex], "# version: %s\n", (const char *)glGetString(GL_VERSION));
+        if (settings._sampleHardwareCounters)
+        {
+            fprintf(outputs[outputIndex], "# counters: %s\n", counters.GetBackendName());
+        }
+        fprintf(outputs[outputIndex], "# clocks: %s\n", clocks.GetBackendName());
+        fprintf(outputs[outputIndex], "%s\n", header.c_str());
+    }
+
+    unsigned int cellCount = 0;
+    unsigned int failedCount = 0;
+    unsigned int regressedCount = 0;
+    unsigned int throttledCount = 0;
+    bool isStabilized = !hasClocks || settings._stabilizeTimeoutSec == 0;
+    for (size_t countIndex = 0; countIndex < settings._particleCounts.size(); countIndex++)
+    {
+        for (size_t layoutIndex = 0; layoutIndex < settings._layouts.size(); layoutIndex++)
+        {
+            for (size_t sizeIndex = 0; sizeIndex < settings._workGroupSizes.size(); sizeIndex++)
+            {
+                for (size_t primitiveIndex = 0; primitiveIndex < settings._primitives.size(); 
+                    primitiveIndex++)
+                {
+                    BenchmarkConfiguration config;
+                    config._numParticles = settings._particleCounts[countIndex];
+                    config._layout = settings._layouts[layoutIndex];
+                    config._bufferAccess = PARTICLE_BUFFER_ACCESS_GPU_ONLY;
+                    config._particlesPerInvocation = 1;
+                    config._workGroupSize = settings._workGroupSizes[sizeIndex];
+                    config._primitive = settings._primitives[primitiveIndex];
+                    config._pointSize = 2.0f;
+                    config._warmupFrames = settings._warmupFrames;
+                    config._measuredFrames = settings._measuredFrames;
+                    config._useFullMemoryBarrier = false;
+                    config._counters = hasCounters ? &counters : 0;
+                    config._updateCounterScopeId = updateCounterScopeId;
+                    config._renderCounterScopeId = renderCounterScopeId;
+                    config._clocks = hasClocks ? &clocks : 0;
+
+                    char key[128];
+                    snprintf(key, sizeof(key), "%u,%s,%u,%s", config._numParticles, 
+                        BENCHMARK_LAYOUT_NAMES[config._layout], config._workGroupSize, 
+                        BENCHMARK_PRIMITIVE_NAMES[config._primitive]);
+                    if (!IsComputeWorkGroupSizeSupported(config._workGroupSize))
+                    {
+                        printf("# %s: work group size not supported, skipped\n", key);
+                        continue;
+                    }
+
+                    // the first cell that can run is the load that the clocks settle 
+                    // under, a short measurement at a time
+                    if (!isStabilized)
+                    {
+                        BenchmarkConfiguration loadConfig = config;
+                        loadConfig._warmupFrames = 0;
+                        loadConfig._measuredFrames = BENCHMARK_CLOCK_SAMPLE_FRAMES;
+                        loadConfig._counters = 0;
+                        loadConfig._clocks = 0;
+                        std::function<void()> runLoad = [&loadConfig]()
+                        {
+                            BenchmarkMeasurement ignored;
+                            MeasureBenchmarkConfiguration(loadConfig, &ignored);
+                        };
+                        clocks.WaitForStableClocks(runLoad, settings._stabilizeTimeoutSec);
+                        isStabilized = true;
+                    }
+
+                    cellCount++;
+                    BenchmarkMeasurement measurement;
+                    bool isMeasured = MeasureBenchmarkConfiguration(config, &measurement);
+                    for (unsigned int retryCount = 0; isMeasured && 
+                        settings._retryThrottledCells && retryCount < BENCHMARK_THROTTLE_RETRIES &&
+                        measurement._clockWindow._throttledSampleCount > 0; retryCount++)
+                    {
+                        printf("# %s: throttled, measuring again\n", key);
+                        isMeasured = MeasureBenchmarkConfiguration(config, &measurement);
+                    }
+                    if (!isMeasured)
+                    {
+                        printf("# %s: failed\n", key);
+                        failedCount++;
+                        continue;
+                    }
+                    const GpuClockWindow &clockWindow = measurement._clockWindow;
+                    bool isThrottled = clockWindow._throttledSampleCount > 0;
+
+                    double gpuFrameMs = 
+                        measurement._updateStats._avgMs + measurement._renderStats._avgMs;
+                    double baselineMs = 0.0;
+                    double changePercent = 0.0;
+                    const char *status = "new";
+                    std::map<std::string, double>::const_iterator found = baseline.find(key);
+                    if (found != baseline.end() && found->second > 0.0)
+                    {
+                        baselineMs = found->second;
+                        changePercent = ((gpuFrameMs / baselineMs) - 1.0) * 100.0;
+                        double thresholdPercent = settings._regressionThreshold * 100.0;
+                        status = "ok";
+                        if (changePercent > thresholdPercent && !isThrottled)
+                        {
+                            status = "regressed";
+                            regressedCount++;
+                        }
+                        else if (changePercent < -thresholdPercent)
+                        {
+                            status = "improved";
+                        }
+                    }
+
+                    if (isThrottled)
+                    {
+                        status = "throttled";
+                        throttledCount++;
+                    }
+
+                    // what couldn't be read is an empty column, so that a spreadsheet 
+                    // doesn't average it in
+                    char clockColumns[96] = ",,,,";
+                    if (clockWindow._sampleCount > 0)
+                    {
+                        char temperatureColumn[16] = "";
+                        char powerColumn[16] = "";
+                        if (clockWindow._maxTemperatureC >= 0.0f)
+                        {
+                            snprintf(temperatureColumn, sizeof(temperatureColumn), "%.0f", 
+                                clockWindow._maxTemperatureC);
+                        }
+                        if (clockWindow._avgPowerW >= 0.0f)
+                        {
+                            snprintf(powerColumn, sizeof(powerColumn), "%.1f", 
+                                clockWindow._avgPowerW);
+                        }
+                        snprintf(clockColumns, sizeof(clockColumns), "%.0f,%.0f,%s,%s,%u/%u", 
+                            clockWindow._minGraphicsClockMhz, clockWindow._avgGraphicsClockMhz, 
+                            temperatureColumn, powerColumn, clockWindow._throttledSampleCount, 
+                            clockWindow._sampleCount);
+                    }
+
+                    // a cell that the counters missed still gets its columns, empty
+                    std::string counterColumns;
+                    for (unsigned int counterIndex = 0; hasCounters && 
+                        counterIndex < 2 * counters.GetCounterCount(); counterIndex++)
+                    {
+                        unsigned int counterCount = counters.GetCounterCount();
+                        const std::vector<double> &values = (counterIndex < counterCount) ? 
+                            measurement._updateCounters : measurement._renderCounters;
+                        char column[32] = ",";
+                        if (!values.empty())
+                        {
+                            snprintf(column, sizeof(column), ",%.4g", 
+                                values[counterIndex % counterCount]);
+                        }
+                        counterColumns += column;
+                    }
+
+                    for (int outputIndex = 0; outputIndex < 2; outputIndex++)
+                    {
+                        fprintf(outputs[outputIndex], 
+                            "%s,%u,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.1f,%s,%s%s\n",
+                            key,
+                            config._measuredFrames,
+                            measurement._cpuSubmitMs,
+                            measurement._wallMsPerFrame,
+                            measurement._updateStats._avgMs, measurement._updateStats._p99Ms,
+                            measurement._renderStats._avgMs, measurement._renderStats._p99Ms,
+                            gpuFrameMs,
+                            baselineMs,
+                            changePercent,
+                            status,
+                            clockColumns,
+                            counterColumns.c_str());
+                        fflush(outputs[outputIndex]);
+                    }
+                }
+            }
+        }
+    }
+
+    printf("# sweep: %u cells, %u failed, %u regressed by more than %.0f%%, %u throttled\n", 
+        cellCount, failedCount, regressedCount, settings._regressionThreshold * 100.0f, 
+        throttledCount);
+    fclose(reportFile);
+    counters.Cleanup();
+    clocks.Cleanup();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &framebufferId);
+    glDeleteRenderbuffers(1, &renderbufferId);
+    return (failedCount > 0 || regressedCount > 0) ? 1 : 0;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "Particle.h"
+
+#include <string>
+#include <vector>
+
+// how the particles are drawn (see ParticleManager::GetQuadRenderShaderDefines(...))
+// Note: Printed as a number in the "primitive" column, and by name in the sweep's report.
+enum BenchmarkPrimitive
+{
+    BENCHMARK_PRIMITIVE_POINTS = 0,
+    BENCHMARK_PRIMITIVE_SQUARE_QUADS,
+    BENCHMARK_PRIMITIVE_OCTAGON_QUADS,
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The grid of a parameter sweep (see RunBenchmarkSweep(...)): every particle count with 
+    every layout, work group size, and primitive.  Each axis can be set from the command line
+    with SetBenchmarkSweepAxis(...), and the ones that aren't set keep the defaults from 
+    GetDefaultBenchmarkSweepSettings().
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+struct BenchmarkSweepSettings
+{
+    std::vector<unsigned int> _particleCounts;
+    std::vector<ParticleLayout> _layouts;
+    std::vector<unsigned int> _workGroupSizes;
+    std::vector<BenchmarkPrimitive> _primitives;
+    unsigned int _warmupFrames;
+    unsigned int _measuredFrames;
+
+    // the report is CSV, and a report from an earlier run can be the baseline of a later one
+    std::string _reportPath;
+    std::string _baselinePath;
+
+    // a cell regressed if its GPU frame time is more than this fraction over the baseline's 
+    // (ex: 0.1 for 10%)
+    float _regressionThreshold;
+
+    // if set, the update's and the render's hardware counters (see GpuHardwareCounters.h) 
+    // are added to the report, 2 columns per counter that passes the filter
+    bool _sampleHardwareCounters;
+    std::string _hardwareCounterFilter;
+
+    // every cell's GPU clocks, temperature, and power (see GpuClockMonitor.h) are in the 
+    // report; a cell whose samples were throttled is reported as "throttled" and isn't 
+    // counted as a regression, and if this is set, it is measured again first, up to twice, 
+    // in case the GPU has cooled off
+    bool _retryThrottledCells;
+
+    // if not 0, the GPU is run until its clocks settle, for at most this many seconds, 
+    // before the first cell
+    unsigned int _stabilizeTimeoutSec;
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    A reproducible, windowless measurement of the particle pipeline.  For each of a fixed list
+    of particle counts, a fresh ParticleManager is initialized, warmed up until its emission has
+    reached a steady state, and then run for a fixed number of Update(...)/Render(...) frames
+    into an offscreen framebuffer.  GPU time per pass (from timer queries) and CPU time are
+    printed to stdout as CSV, one row per configuration, so the output can be collected
+    straight into a spreadsheet or a regression log.
+
+    After the particle table comes one headed "# update barrier" that runs each of its 
+    particle counts with the targeted barrier after the update and with GL_ALL_BARRIER_BITS 
+    (see ParticleManager::SetFullMemoryBarrier(...)).
+
+    Then comes a table, headed "# scan", of GpuScan's exclusive scan (see GpuScan.h) on its 
+    own at 1 to 16 million elements, with and without subgroups.
+    Each row says whether that scan's output matched a scan on the CPU.  Right before it, the 
+    GPU's buffer copy rate is measured, and the scan and the next table give their bandwidth 
+    as a percentage of that.
+
+    The next table, headed "# gpu kernels", is each of the particle kernels on its own 
+    (update, emit, the emit fused into the update, the live list, sort, stats reduction, 
+    heatmap histogram, and density splat) on synthetic pools that are spread out, clustered, 
+    all dead, and all alive, so it shows which kernels are memory bound and how far they are 
+    from the copy rate.
+
+    The last table, headed "# cpu kernels", is the CPU backend's SIMD kernels (see 
+    ParticleSimdKernels.h) on one thread against a plain glm loop over an array of Particle 
+    structures, in nanoseconds per particle per step and particle steps per time stamp tick 
+    (0 where there is no time stamp counter).  Each row says whether the kernel's results 
+    matched the glm loop's exactly.
+
+    The caller must have already created an OpenGL 4.4 context and loaded the functions.  The
+    window can (and should) be hidden; nothing is drawn to it.
+Creator:    John Cox (8-10-2016)
+-----------------------------------------------------------------------------------------------*/
+int RunBenchmark();
+
+BenchmarkSweepSettings GetDefaultBenchmarkSweepSettings();
+bool SetBenchmarkSweepAxis(const std::string &assignment, BenchmarkSweepSettings *settings);
+int RunBenchmarkSweep(const BenchmarkSweepSettings &settings);
@@ -0,0 +1,353 @@
+#include "BloomFilter.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
+#include "ShaderProgramRegistry.h"
+#include "GpuMemoryLedger.h"
+#include "OpenGlErrorHandling.h"
+#include "Log.h"
+
+// must match the BLOOM_STAGE_* defines in shaderBloom.comp
+enum BloomStage
+{
+    BLOOM_STAGE_DOWNSAMPLE = 0,
+    BLOOM_STAGE_BLUR,
+    BLOOM_STAGE_UPSAMPLE,
+};
+
+// must match WORK_GROUP_SIZE in shaderBloom.comp
+static const int BLOOM_WORK_GROUP_SIZE = 64;
+
+// levels smaller than this on either side are too small to blur
+static const int MIN_LEVEL_SIZE = 8;
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+BloomFilter::BloomFilter() :
+    _bloomProgramId(0),
+    _unifLocBloomStage(0),
+    _unifLocLevel(0),
+    _unifLocBlurDirection(0),
+    _unifLocThreshold(0),
+    _chainTextureId(0),
+    _blurTextureId(0),
+    _sourceWidth(0),
+    _sourceHeight(0),
+    _levelCount(0),
+    _threshold(0.5f)
+{
+    for (int level = 0; level < MAX_LEVELS; level++)
+    {
+        _levelWidths[level] = 0;
+        _levelHeights[level] = 0;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+BloomFilter::~BloomFilter()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes a reference to the bloom program (see ShaderProgramRegistry.h).  The mip chain isn't
+    created until the first Apply(...), when the image's size is known.  The caller may
+    release their own reference after this returns.
+Parameters:
+    bloomProgramId  shaderBloom.comp.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void BloomFilter::Init(unsigned int bloomProgramId)
+{
+    this->Cleanup();
+    if (bloomProgramId == 0)
+    {
+        LogPrintf("the bloom filter needs its program\n");
+        return;
+    }
+
+    _bloomProgramId = bloomProgramId;
+    AddProgramReference(_bloomProgramId);
+    this->LoadProgramInterface();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Releases the program and deletes the mip chain.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void BloomFilter::Cleanup()
+{
+    this->DeleteChain();
+    ReleaseProgram(_bloomProgramId);
+    _bloomProgramId = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Switches to a rebuilt program (see ShaderProgramRegistry.h).
+Parameters:
+    oldProgramId    Self-explanatory.  Programs that this filter doesn't use are ignored.
+    newProgramId    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void BloomFilter::ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId)
+{
+    if (oldProgramId == 0 || newProgramId == 0 || _bloomProgramId != oldProgramId)
+    {
+        return;
+    }
+
+    AddProgramReference(newProgramId);
+    ReleaseProgram(_bloomProgramId);
+    _bloomProgramId = newProgramId;
+    this->LoadProgramInterface();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets how bright a pixel must be to glow.  Can be changed at any time.
+Parameters:
+    threshold   Only the brightness over this (on each channel) glows.  With an 8-bit image,
+                nothing is over 1, so it should be less than that.  Negative is treated as 0.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void BloomFilter::SetThreshold(float threshold)
+{
+    _threshold = (threshold < 0.0f) ? 0.0f : threshold;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Makes the glow for an image and leaves it in GetTextureId()'s level 0, ready to be
+    sampled.  Re-creates the chain first if the image changed size.
+Parameters:
+    sourceTextureId     The image.  It is read with a linear filter at level 0.
+    sourceWidth         Self-explanatory.
+    sourceHeight        Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void BloomFilter::Apply(unsigned int sourceTextureId, int sourceWidth, int sourceHeight)
+{
+    if (_bloomProgramId == 0 || sourceTextureId == 0)
+    {
+        return;
+    }
+    if (sourceWidth != _sourceWidth || sourceHeight != _sourceHeight)
+    {
+        this->InitChain(sourceWidth, sourceHeight);
+    }
+    if (_levelCount == 0)
+    {
+        return;
+    }
+    GlDebugGroup bloomGroup("bloom");
+
+    UseGlProgram(_bloomProgramId);
+    glUniform1f(_unifLocThreshold, _threshold);
+    glActiveTexture(GL_TEXTURE0 + BLOOM_SOURCE_TEXTURE_UNIT);
+
+    // down the chain, each level from the one above it (level 0 from the image)
+    for (int level = 0; level < _levelCount; level++)
+    {
+        glBindTexture(GL_TEXTURE_2D, (level == 0) ? sourceTextureId : _chainTextureId);
+        glBindImageTexture(BLOOM_DESTINATION_IMAGE_UNIT, _chainTextureId, level, GL_FALSE, 0,
+            GL_WRITE_ONLY, GL_RGBA16F);
+        this->DispatchBloomStage(BLOOM_STAGE_DOWNSAMPLE, level, 0, 1);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // blur every level, across into the blur texture and then down back into the chain
+    for (int level = 0; level < _levelCount; level++)
+    {
+        glBindImageTexture(BLOOM_BLUR_SOURCE_IMAGE_UNIT, _chainTextureId, level, GL_FALSE, 0,
+            GL_READ_ONLY, GL_RGBA16F);
+        glBindImageTexture(BLOOM_DESTINATION_IMAGE_UNIT, _blurTextureId, level, GL_FALSE, 0,
+            GL_WRITE_ONLY, GL_RGBA16F);
+        this->DispatchBloomStage(BLOOM_STAGE_BLUR, level, 0, 1);
+
+        glBindImageTexture(BLOOM_BLUR_SOURCE_IMAGE_UNIT, _blurTextureId, level, GL_FALSE, 0,
+            GL_READ_ONLY, GL_RGBA16F);
+        glBindImageTexture(BLOOM_DESTINATION_IMAGE_UNIT, _chainTextureId, level, GL_FALSE, 0,
+            GL_WRITE_ONLY, GL_RGBA16F);
+        this->DispatchBloomStage(BLOOM_STAGE_BLUR, level, 1, 0);
+    }
+
+    // back up the chain, smallest first, so that level 0 collects all of them
+    glBindTexture(GL_TEXTURE_2D, _chainTextureId);
+    for (int level = _levelCount - 2; level >= 0; level--)
+    {
+        glBindImageTexture(BLOOM_DESTINATION_IMAGE_UNIT, _chainTextureId, level, GL_FALSE, 0,
+            GL_READ_WRITE, GL_RGBA16F);
+        this->DispatchBloomStage(BLOOM_STAGE_UPSAMPLE, level, 0, 1);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    UseGlProgram(0);
+
+    // the upscale reads it through a sampler
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The chain's texture, with the glow in level 0 after Apply(...), or 0 before the first
+    Apply(...).  Sample it with textureLod(..., 0).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int BloomFilter::GetTextureId() const
+{
+    return _chainTextureId;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.  Called at initialization and after a hot reload.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void BloomFilter::LoadProgramInterface()
+{
+    _unifLocBloomStage = glGetUniformLocation(_bloomProgramId, "uBloomStage");
+    _unifLocLevel = glGetUniformLocation(_bloomProgramId, "uLevel");
+    _unifLocBlurDirection = glGetUniformLocation(_bloomProgramId, "uBlurDirection");
+    _unifLocThreshold = glGetUniformLocation(_bloomProgramId, "uThreshold");
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    (Re)creates the chain for an image of the given size: level 0 is half of it, each level
+    after that is half of the last, and it stops at MAX_LEVELS or when a level would be
+    smaller than MIN_LEVEL_SIZE.  Both textures are RGBA16F, so the glow can go past 1 and
+    doesn't band, and the chain's levels are filtered for the downsample and the upsample.
+Parameters:
+    sourceWidth     Self-explanatory.
+    sourceHeight    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void BloomFilter::InitChain(int sourceWidth, int sourceHeight)
+{
+    this->DeleteChain();
+    _sourceWidth = sourceWidth;
+    _sourceHeight = sourceHeight;
+
+    int width = sourceWidth / 2;
+    int height = sourceHeight / 2;
+    while (_levelCount < MAX_LEVELS && width >= MIN_LEVEL_SIZE && height >= MIN_LEVEL_SIZE)
+    {
+        _levelWidths[_levelCount] = width;
+        _levelHeights[_levelCount] = height;
+        _levelCount++;
+        width /= 2;
+        height /= 2;
+    }
+    if (_levelCount == 0)
+    {
+        // a minimized window, or something close to it
+        return;
+    }
+
+    unsigned long long chainSizeBytes = 
+        GetGlTextureSizeBytes(GL_RGBA16F, _levelWidths[0], _levelHeights[0], _levelCount);
+    glGenTextures(1, &_chainTextureId);
+    glBindTexture(GL_TEXTURE_2D, _chainTextureId);
+    glTexStorage2D(GL_TEXTURE_2D, _levelCount, GL_RGBA16F, _levelWidths[0], _levelHeights[0]);
+    RecordGpuAllocation(GPU_MEMORY_TEXTURE, _chainTextureId, chainSizeBytes, "bloom");
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // only ever read with imageLoad(...)
+    glGenTextures(1, &_blurTextureId);
+    glBindTexture(GL_TEXTURE_2D, _blurTextureId);
+    glTexStorage2D(GL_TEXTURE_2D, _levelCount, GL_RGBA16F, _levelWidths[0], _levelHeights[0]);
+    RecordGpuAllocation(GPU_MEMORY_TEXTURE, _blurTextureId, chainSizeBytes, "bloom");
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.  Apply(...) makes a new chain the next time it runs.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void BloomFilter::DeleteChain()
+{
+    if (_chainTextureId != 0)
+    {
+        ForgetGpuAllocation(GPU_MEMORY_TEXTURE, _chainTextureId);
+        glDeleteTextures(1, &_chainTextureId);
+        _chainTextureId = 0;
+    }
+    if (_blurTextureId != 0)
+    {
+        ForgetGpuAllocation(GPU_MEMORY_TEXTURE, _blurTextureId);
+        glDeleteTextures(1, &_blurTextureId);
+        _blurTextureId = 0;
+    }
+    _sourceWidth = 0;
+    _sourceHeight = 0;
+    _levelCount = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Runs one stage over every texel of a level and puts up a barrier for the next stage, which
+    reads what this one wrote.
+Parameters:
+    stage       One of the BLOOM_STAGE_* values.
+    level       The mip level that is written.
+    alongAxis   0 to run a work group along each row and 1 for each column (the vertical
+                blur).
+    acrossAxis  The other one.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void BloomFilter::DispatchBloomStage(int stage, int level, int alongAxis, int acrossAxis)
+{
+    int sizes[2] = { _levelWidths[level], _levelHeights[level] };
+    glUniform1i(_unifLocBloomStage, stage);
+    glUniform1i(_unifLocLevel, level);
+    glUniform2i(_unifLocBlurDirection, (alongAxis == 0) ? 1 : 0, (alongAxis == 0) ? 0 : 1);
+    glDispatchCompute((sizes[alongAxis] + BLOOM_WORK_GROUP_SIZE - 1) / BLOOM_WORK_GROUP_SIZE,
+        sizes[acrossAxis], 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+}
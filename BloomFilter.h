@@ -0,0 +1,68 @@
+#pragma once
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    A glow around the bright parts of the scaled render target's image (see
+    ScaledRenderTarget::SetBloom(...)), made entirely in compute (see shaderBloom.comp).
+
+    The image is downsampled into a short mip chain that starts at half of its size (only the
+    brightness over a threshold goes into the first level), each level is blurred with a
+    separable Gaussian, and then the levels are added back up the chain, smallest first, so
+    level 0 ends up with a wide, smooth glow.  The upscale adds level 0 to the image.
+
+    The blurs load a row (or column) of texels into shared memory once and every invocation in
+    the work group reads its neighbors from there, so each texel is fetched about once per
+    blur instead of once per tap.  Everything runs at half resolution or less, so at 1080p the
+    whole chain is about 0.7 million RGBA16F texels, touched 4 times each (downsample, 2 blurs,
+    upsample), which is well under a millisecond on anything that can run the demo.
+
+    Note: The chain is (re)created whenever the image changes size, so the render scale and the
+    window size can change freely.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class BloomFilter
+{
+public:
+    BloomFilter();
+    ~BloomFilter();
+    void Init(unsigned int bloomProgramId);
+    void Cleanup();
+    void ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId);
+
+    void SetThreshold(float threshold);
+    void Apply(unsigned int sourceTextureId, int sourceWidth, int sourceHeight);
+    unsigned int GetTextureId() const;
+
+    // more levels make a wider glow for very little extra, since each one is a quarter of the
+    // last, but past this the smallest ones are only a few texels across at 1080p
+    static const int MAX_LEVELS = 5;
+
+private:
+    void LoadProgramInterface();
+    void InitChain(int sourceWidth, int sourceHeight);
+    void DeleteChain();
+    void DispatchBloomStage(int stage, int level, int alongAxis, int acrossAxis);
+
+    unsigned int _bloomProgramId;
+    unsigned int _unifLocBloomStage;
+    unsigned int _unifLocLevel;
+    unsigned int _unifLocBlurDirection;
+    unsigned int _unifLocThreshold;
+
+    // Note: The units must match shaderBloom.comp.  The image units start after the SDF
+    // boundary's (see ParticleBoundarySdf.h).
+    static const unsigned int BLOOM_SOURCE_TEXTURE_UNIT = 0;
+    static const unsigned int BLOOM_BLUR_SOURCE_IMAGE_UNIT = 6;
+    static const unsigned int BLOOM_DESTINATION_IMAGE_UNIT = 7;
+
+    // the chain is in _chainTextureId's mip levels, and the horizontal blur goes through the
+    // same level of _blurTextureId on its way back
+    unsigned int _chainTextureId;
+    unsigned int _blurTextureId;
+    int _sourceWidth;
+    int _sourceHeight;
+    int _levelCount;
+    int _levelWidths[MAX_LEVELS];
+    int _levelHeights[MAX_LEVELS];
+    float _threshold;
+};
@@ -0,0 +1,164 @@
+#include "Camera2D.h"
+
+// zoomed out far enough to see well past the emitters, and in far enough that a handful of
+// particles fill the window
+static const float MIN_ZOOM = 0.25f;
+static const float MAX_ZOOM = 4096.0f;
+
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Starts out showing all of window space, just like there was no camera.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+Camera2D::Camera2D() :
+    _center(0.0f, 0.0f),
+    _zoom(1.0f),
+    _windowWidth(1),
+    _windowHeight(1)
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Goes back to showing all of window space.  Keeps the window size.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void Camera2D::Reset()
+{
+    _center = glm::vec2(0.0f, 0.0f);
+    _zoom = 1.0f;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The pans and zooms are in pixels, so the camera needs to know how many there are.  The
+    window should call this whenever it is resized.
+Parameters:
+    widthPixels     Self-explanatory.  Values below 1 are treated as 1.
+    heightPixels    Self-explanatory.  Values below 1 are treated as 1.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void Camera2D::SetWindowSize(int widthPixels, int heightPixels)
+{
+    _windowWidth = (widthPixels > 0) ? widthPixels : 1;
+    _windowHeight = (heightPixels > 0) ? heightPixels : 1;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Moves the view so that whatever was under a pixel is now under the pixel that is this far
+    from it (ex: the mouse's movement during a drag).
+Parameters:
+    deltaXPixels    Positive is to the right.
+    deltaYPixels    Positive is down, like window coordinates.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void Camera2D::Pan(float deltaXPixels, float deltaYPixels)
+{
+    // a pixel is 2 / window size in clip space, and clip space is window space times the zoom
+    _center.x -= (2.0f * deltaXPixels / _windowWidth) / _zoom;
+    _center.y += (2.0f * deltaYPixels / _windowHeight) / _zoom;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Zooms in or out while keeping whatever is under the given pixel (ex: the mouse) where it
+    is.
+Parameters:
+    zoomFactor  Greater than 1 zooms in and less than 1 zooms out.  The zoom is clamped to
+                [MIN_ZOOM, MAX_ZOOM].
+    windowX     Window coordinates, with (0,0) at the top left.
+    windowY     Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void Camera2D::ZoomAt(float zoomFactor, int windowX, int windowY)
+{
+    glm::vec2 anchor = this->WindowToWorld(windowX, windowY);
+    _zoom *= zoomFactor;
+    _zoom = (_zoom < MIN_ZOOM) ? MIN_ZOOM : ((_zoom > MAX_ZOOM) ? MAX_ZOOM : _zoom);
+
+    // put the anchor back under the same pixel at the new zoom
+    glm::vec2 anchorDrift = anchor - this->WindowToWorld(windowX, windowY);
+    _center += anchorDrift;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    windowX     Window coordinates, with (0,0) at the top left.
+    windowY     Self-explanatory.
+Returns:
+    The point in window space (where the particles are) that is under that pixel.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+glm::vec2 Camera2D::WindowToWorld(int windowX, int windowY) const
+{
+    // the center of the pixel
+    glm::vec2 clipPos;
+    clipPos.x = ((2.0f * (windowX + 0.5f)) / _windowWidth) - 1.0f;
+    clipPos.y = 1.0f - ((2.0f * (windowY + 0.5f)) / _windowHeight);
+    return _center + (clipPos / _zoom);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.  Depth is left alone.
+Parameters: None
+Returns:
+    The transform from window space to clip space (see ViewParameters).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+glm::mat4 Camera2D::GetViewProjection() const
+{
+    // glm is column major, so [3] is the translation
+    glm::mat4 viewProjection(1.0f);
+    viewProjection[0][0] = _zoom;
+    viewProjection[1][1] = _zoom;
+    viewProjection[3][0] = -_center.x * _zoom;
+    viewProjection[3][1] = -_center.y * _zoom;
+    return viewProjection;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The point in window space at the middle of the window.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+glm::vec2 Camera2D::GetCenter() const
+{
+    return _center;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How many times larger than window space things are drawn.  1 is no zoom.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+float Camera2D::GetZoom() const
+{
+    return _zoom;
+}
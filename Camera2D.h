@@ -0,0 +1,36 @@
+#pragma once
+
+#include "glm/mat4x4.hpp"
+#include "glm/vec2.hpp"
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    A pan and zoom camera over the simulation's window space.  The window shows a square of
+    window space that is 2 / zoom across, centered on the camera's center, so a zoom of 1
+    centered on the origin shows exactly what the demo always showed.
+
+    Pans are in pixels so that a mouse drag moves the particles under the cursor along with it,
+    and zooms are about a pixel so that the particle under the cursor stays under it.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class Camera2D
+{
+public:
+    Camera2D();
+
+    void Reset();
+    void SetWindowSize(int widthPixels, int heightPixels);
+    void Pan(float deltaXPixels, float deltaYPixels);
+    void ZoomAt(float zoomFactor, int windowX, int windowY);
+
+    glm::vec2 WindowToWorld(int windowX, int windowY) const;
+    glm::mat4 GetViewProjection() const;
+    glm::vec2 GetCenter() const;
+    float GetZoom() const;
+
+private:
+    glm::vec2 _center;
+    float _zoom;
+    int _windowWidth;
+    int _windowHeight;
+};
@@ -0,0 +1,265 @@
+#include "ComputeDeviceCaps.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "Log.h"
+
+#include <string.h>     // strcmp
+
+#ifdef WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+// the limits don't change for the life of the context, so they are only asked for once
+// Note: One per thread, like the context that they were asked of (see MultiGpuSimulation.h).
+static thread_local ComputeDeviceCaps gComputeDeviceCaps;
+static thread_local bool gHaveComputeDeviceCaps = false;
+
+// GL_KHR_shader_subgroup's queries
+static const GLenum SUBGROUP_SUPPORTED_STAGES = 0x9533;
+static const GLenum SUBGROUP_SUPPORTED_FEATURES = 0x9534;
+
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Asks the driver for the compute limits the first time that it is called, and hands back
+    the same values after that.  Needs a current context.
+Parameters: None
+Returns:
+    A const reference to the limits.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+const ComputeDeviceCaps &GetComputeDeviceCaps()
+{
+    if (gHaveComputeDeviceCaps)
+    {
+        return gComputeDeviceCaps;
+    }
+
+    for (unsigned int dimension = 0; dimension < 3; dimension++)
+    {
+        GLint maxCount = 0;
+        GLint maxSize = 0;
+        glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, dimension, &maxCount);
+        glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_SIZE, dimension, &maxSize);
+
+        // the spec's minimums, in case the query failed
+        gComputeDeviceCaps._maxWorkGroupCount[dimension] = (maxCount > 0) ? maxCount : 65535;
+        gComputeDeviceCaps._maxWorkGroupSize[dimension] =
+            (maxSize > 0) ? maxSize : ((dimension < 2) ? 1024 : 64);
+    }
+
+    // Note: This version of glload calls GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS by its old name.
+    GLint maxInvocations = 0;
+    GLint maxSharedMemory = 0;
+    glGetIntegerv(GL_MAX_COMPUTE_LOCAL_INVOCATIONS, &maxInvocations);
+    glGetIntegerv(GL_MAX_COMPUTE_SHARED_MEMORY_SIZE, &maxSharedMemory);
+    gComputeDeviceCaps._maxWorkGroupInvocations = (maxInvocations > 0) ? maxInvocations : 1024;
+    gComputeDeviceCaps._maxSharedMemoryBytes = (maxSharedMemory > 0) ? maxSharedMemory : 32768;
+
+    gHaveComputeDeviceCaps = true;
+    return gComputeDeviceCaps;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void PrintComputeDeviceCaps()
+{
+    const ComputeDeviceCaps &caps = GetComputeDeviceCaps();
+    LogPrintf("max compute work group counts: x = %u, y = %u, z = %u\n",
+        caps._maxWorkGroupCount[0], caps._maxWorkGroupCount[1], caps._maxWorkGroupCount[2]);
+    LogPrintf("max compute work group sizes: x = %u, y = %u, z = %u\n",
+        caps._maxWorkGroupSize[0], caps._maxWorkGroupSize[1], caps._maxWorkGroupSize[2]);
+    LogPrintf("max compute work group invocations = %u\n", caps._maxWorkGroupInvocations);
+    LogPrintf("max compute shared memory = %u bytes\n", caps._maxSharedMemoryBytes);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Every compute shader here is 1D, so both the size in X and the total invocations limit
+    the work group size.
+Parameters:
+    workGroupSizeX  A "local_size_x".
+Returns:
+    True if a compute shader with that work group size can run on this device.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+bool IsComputeWorkGroupSizeSupported(unsigned int workGroupSizeX)
+{
+    const ComputeDeviceCaps &caps = GetComputeDeviceCaps();
+    return workGroupSizeX > 0 &&
+        workGroupSizeX <= caps._maxWorkGroupSize[0] &&
+        workGroupSizeX <= caps._maxWorkGroupInvocations;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Splits a 1D work group count into X and Y so that neither is over the device's limit.
+    Under the X limit, it is left alone (Y = 1).  Over it, there are as few rows as it takes
+    and the groups are spread evenly across them, so the last row wastes less than one
+    group per row.  The shader must flatten the dispatch back into one index
+    (gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x) and skip the work items past
+    the end.
+
+    Note: The limit in Y is at least 65535 as well, so this covers over 4 billion work groups,
+    which is more than any count that fits in a 32-bit index.  If it is somehow still too
+    many, Y is clamped and the problem is printed rather than letting the dispatch fail.
+Parameters:
+    numWorkGroups           The total work groups that a 1D dispatch would use.  0 is
+                            treated as 1.
+    putNumWorkGroupsXHere   Self-explanatory.
+    putNumWorkGroupsYHere   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void GetComputeDispatchSize(unsigned int numWorkGroups, unsigned int *putNumWorkGroupsXHere,
+    unsigned int *putNumWorkGroupsYHere)
+{
+    const ComputeDeviceCaps &caps = GetComputeDeviceCaps();
+    if (numWorkGroups == 0)
+    {
+        numWorkGroups = 1;
+    }
+
+    unsigned int maxX = caps._maxWorkGroupCount[0];
+    if (numWorkGroups <= maxX)
+    {
+        *putNumWorkGroupsXHere = numWorkGroups;
+        *putNumWorkGroupsYHere = 1;
+        return;
+    }
+
+    unsigned int numRows = (numWorkGroups + maxX - 1) / maxX;
+    if (numRows > caps._maxWorkGroupCount[1])
+    {
+        LogPrintf("%u work groups won't fit in a 2D dispatch; clamped to %u rows\n",
+            numWorkGroups, caps._maxWorkGroupCount[1]);
+        numRows = caps._maxWorkGroupCount[1];
+        *putNumWorkGroupsXHere = maxX;
+        *putNumWorkGroupsYHere = numRows;
+        return;
+    }
+
+    *putNumWorkGroupsXHere = (numWorkGroups + numRows - 1) / numRows;
+    *putNumWorkGroupsYHere = numRows;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    For the shaders with "grid-stride" loops (ex: UpdateParticles() in shaderParticle.comp),
+    which cover everything with however many work groups they are given.  Fewer groups than
+    asked for just means that each work item goes around the loop more times.
+Parameters:
+    numWorkGroups   The work groups that a 1D dispatch would ideally use.  0 is treated as 1.
+Returns:
+    The number of work groups in X that is both within the device's limit and non-zero.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ClampComputeDispatchSizeX(unsigned int numWorkGroups)
+{
+    const ComputeDeviceCaps &caps = GetComputeDeviceCaps();
+    if (numWorkGroups == 0)
+    {
+        return 1;
+    }
+    return (numWorkGroups > caps._maxWorkGroupCount[0]) ?
+        caps._maxWorkGroupCount[0] : numWorkGroups;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Looks up a GL function that this version of glload doesn't know about (ex: one from an 
+    extension that is newer than it).  Needs a current context, and the extension must be in 
+    its list (see IsGlExtensionSupported(...)), or the address may be one that does nothing.
+
+    Note: glload's own loader isn't exposed, so this goes to the window system the same way 
+    that it does.  Outside of Windows, the loader is found in whatever GL library the process 
+    already has, GLX first and then EGL (see EglHeadlessWindow.h), so nothing new is linked.
+Parameters:
+    functionName    The full name (ex: "glBufferPageCommitmentARB").
+Returns:
+    The function's address, or 0 if there isn't one.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void *GetGlFunctionAddress(const char *functionName)
+{
+#ifdef WIN32
+    return (void *)wglGetProcAddress(functionName);
+#else
+    typedef void *(*GetProcAddressProc)(const char *);
+    GetProcAddressProc getProcAddress = 
+        (GetProcAddressProc)dlsym(RTLD_DEFAULT, "glXGetProcAddressARB");
+    if (getProcAddress == 0)
+    {
+        getProcAddress = (GetProcAddressProc)dlsym(RTLD_DEFAULT, "eglGetProcAddress");
+    }
+    return (getProcAddress != 0) ? getProcAddress(functionName) : 0;
+#endif
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Looks for an extension in the context's list.  Needs a current context.
+Parameters:
+    extensionName   The full name (ex: "GL_KHR_shader_subgroup").
+Returns:
+    True if the context has the extension, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+bool IsGlExtensionSupported(const char *extensionName)
+{
+    // core profiles only list extensions one at a time
+    GLint extensionCount = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    for (GLint extensionIndex = 0; extensionIndex < extensionCount; extensionIndex++)
+    {
+        const char *name = (const char *)glGetStringi(GL_EXTENSIONS, extensionIndex);
+        if (name != 0 && strcmp(name, extensionName) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Checks for GL_KHR_shader_subgroup in compute shaders with the given operations.  The
+    extension is listed wherever any stage has any of them, so the stages and features have to
+    be asked for separately.  Needs a current context.
+Parameters:
+    neededFeatures  KhrSubgroupFeature bits, OR'd together.
+Returns:
+    True if compute shaders can use all of those operations, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+bool IsKhrSubgroupSupported(unsigned int neededFeatures)
+{
+    if (!IsGlExtensionSupported("GL_KHR_shader_subgroup"))
+    {
+        return false;
+    }
+
+    GLint supportedStages = 0;
+    GLint supportedFeatures = 0;
+    glGetIntegerv(SUBGROUP_SUPPORTED_STAGES, &supportedStages);
+    glGetIntegerv(SUBGROUP_SUPPORTED_FEATURES, &supportedFeatures);
+    return (supportedStages & GL_COMPUTE_SHADER_BIT) != 0 &&
+        ((unsigned int)supportedFeatures & neededFeatures) == neededFeatures;
+}
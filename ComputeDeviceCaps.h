@@ -0,0 +1,42 @@
+#pragma once
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The device's compute shader limits, queried once per context.
+
+    The limit that matters most is the work group count.  OpenGL only guarantees 65535 work
+    groups in each dimension, so at 256 work items per group, a single 1D dispatch tops out a
+    little under 17 million work items.  Past that, glDispatchCompute(...) fails with
+    GL_INVALID_VALUE and nothing runs, which looks exactly like particles that never move.
+    GetComputeDispatchSize(...) splits a work group count into a 2D dispatch that stays within
+    the limits, and the shaders flatten it back into a single index.
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+struct ComputeDeviceCaps
+{
+    unsigned int _maxWorkGroupCount[3];
+    unsigned int _maxWorkGroupSize[3];
+    unsigned int _maxWorkGroupInvocations;
+    unsigned int _maxSharedMemoryBytes;
+};
+
+// GL_KHR_shader_subgroup's feature bits (see IsKhrSubgroupSupported(...))
+// Note: This version of glload is older than the extension.
+enum KhrSubgroupFeature
+{
+    KHR_SUBGROUP_FEATURE_BASIC = 0x00000001,
+    KHR_SUBGROUP_FEATURE_VOTE = 0x00000002,
+    KHR_SUBGROUP_FEATURE_ARITHMETIC = 0x00000004,
+    KHR_SUBGROUP_FEATURE_BALLOT = 0x00000008,
+    KHR_SUBGROUP_FEATURE_SHUFFLE = 0x00000010,
+};
+
+const ComputeDeviceCaps &GetComputeDeviceCaps();
+void PrintComputeDeviceCaps();
+bool IsComputeWorkGroupSizeSupported(unsigned int workGroupSizeX);
+void GetComputeDispatchSize(unsigned int numWorkGroups, unsigned int *putNumWorkGroupsXHere,
+    unsigned int *putNumWorkGroupsYHere);
+unsigned int ClampComputeDispatchSizeX(unsigned int numWorkGroups);
+bool IsGlExtensionSupported(const char *extensionName);
+void *GetGlFunctionAddress(const char *functionName);
+bool IsKhrSubgroupSupported(unsigned int neededFeatures);
@@ -0,0 +1,710 @@
+#include "DensitySplatRenderer.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
+#include "ShaderProgramRegistry.h"
+#include "GpuMemoryLedger.h"
+#include "ComputeDeviceCaps.h"
+#include "OpenGlErrorHandling.h"
+#include "Log.h"
+
+#include <stdio.h>
+
+// must match the SPLAT_STAGE_* defines in shaderParticle.comp
+enum SplatStage
+{
+    SPLAT_STAGE_DIRECT = 0,
+    SPLAT_STAGE_COUNT_TILES,
+    SPLAT_STAGE_SCAN_TILES,
+    SPLAT_STAGE_SCATTER,
+    SPLAT_STAGE_ACCUMULATE_TILES,
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    windowSize          The window's width or height in pixels.
+    resolutionScale     See DensitySplatRenderer::SetResolutionScale(...).
+Returns:
+    The density image's width or height.  At least 1 unless the window is 0 (minimized).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static int ScaleImageSize(int windowSize, float resolutionScale)
+{
+    if (windowSize <= 0)
+    {
+        return windowSize;
+    }
+    int imageSize = (int)((windowSize * resolutionScale) + 0.5f);
+    return (imageSize > 0) ? imageSize : 1;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+DensitySplatRenderer::DensitySplatRenderer() :
+    _splatProgramId(0),
+    _resolveProgramId(0),
+    _splatWorkGroupSizeX(ParticleManager::DEFAULT_WORK_GROUP_SIZE),
+    _unifLocSplatExtrapolationSec(0),
+    _unifLocSplatStage(0),
+    _unifLocTileSize(0),
+    _unifLocTileCountX(0),
+    _unifLocTileCountY(0),
+    _unifLocResolveExposure(0),
+    _unifLocResolveResolutionScale(0),
+    _exposure(0.1f),
+    _emptyVaoId(0),
+    _densityTextureId(0),
+    _width(0),
+    _height(0),
+    _windowWidth(0),
+    _windowHeight(0),
+    _resolutionScale(1.0f),
+    _lodStride(1),
+    _useTileBinning(true),
+    _tileSize(0),
+    _tileCountX(0),
+    _tileCountY(0),
+    _tileCountBufferId(0),
+    _tileOffsetBufferId(0),
+    _tileCursorBufferId(0),
+    _binnedPixelBufferId(0),
+    _binnedPixelCapacity(0)
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+DensitySplatRenderer::~DensitySplatRenderer()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes a reference to the 2 programs (see ShaderProgramRegistry.h) and creates the density 
+    image.  The caller may release their own references after this returns.
+Parameters:
+    splatProgramId      shaderParticle.comp generated with GetSplatShaderDefines(...).  Must be
+                        built for the same particle layout as the particle manager's program.
+    resolveProgramId    shaderDensityResolve.vert and shaderDensityResolve.frag.
+    width               The window's width in pixels.
+    height              The window's height in pixels.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void DensitySplatRenderer::Init(unsigned int splatProgramId, unsigned int resolveProgramId,
+    int width, int height)
+{
+    this->Cleanup();
+
+    _splatProgramId = splatProgramId;
+    _resolveProgramId = resolveProgramId;
+    AddProgramReference(_splatProgramId);
+    AddProgramReference(_resolveProgramId);
+    this->LoadProgramInterfaces();
+
+    glGenVertexArrays(1, &_emptyVaoId);
+    _windowWidth = width;
+    _windowHeight = height;
+    this->InitDensityImage(ScaleImageSize(width, _resolutionScale), 
+        ScaleImageSize(height, _resolutionScale));
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Switches to a rebuilt program (see ParticleManager::ReplaceProgram(...)).
+Parameters:
+    oldProgramId    Self-explanatory.  Programs that this renderer doesn't use are ignored.
+    newProgramId    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void DensitySplatRenderer::ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId)
+{
+    if (oldProgramId == 0 || newProgramId == 0)
+    {
+        return;
+    }
+
+    bool isReplaced = false;
+    if (_splatProgramId == oldProgramId)
+    {
+        AddProgramReference(newProgramId);
+        ReleaseProgram(_splatProgramId);
+        _splatProgramId = newProgramId;
+        isReplaced = true;
+    }
+    if (_resolveProgramId == oldProgramId)
+    {
+        AddProgramReference(newProgramId);
+        ReleaseProgram(_resolveProgramId);
+        _resolveProgramId = newProgramId;
+        isReplaced = true;
+    }
+
+    if (isReplaced)
+    {
+        this->LoadProgramInterfaces();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Looks up both programs' uniforms and the splat program's work group size.  Called by 
+    Init(...) and whenever a program is replaced.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void DensitySplatRenderer::LoadProgramInterfaces()
+{
+    _unifLocSplatExtrapolationSec = glGetUniformLocation(_splatProgramId, "uExtrapolationSec");
+    _unifLocSplatStage = glGetUniformLocation(_splatProgramId, "uSplatStage");
+    _unifLocTileSize = glGetUniformLocation(_splatProgramId, "uTileSize");
+    _unifLocTileCountX = glGetUniformLocation(_splatProgramId, "uTileCountX");
+    _unifLocTileCountY = glGetUniformLocation(_splatProgramId, "uTileCountY");
+    _unifLocResolveExposure = glGetUniformLocation(_resolveProgramId, "uExposure");
+    _unifLocResolveResolutionScale = glGetUniformLocation(_resolveProgramId, 
+        "uResolutionScale");
+
+    // same as ParticleManager::Init(...); the dispatch must match the program
+    GLint programWorkGroupSize[3] = { 0, 0, 0 };
+    glGetProgramiv(_splatProgramId, GL_COMPUTE_LOCAL_WORK_SIZE, programWorkGroupSize);
+    _splatWorkGroupSizeX = (programWorkGroupSize[0] > 0) ?
+        programWorkGroupSize[0] : ParticleManager::DEFAULT_WORK_GROUP_SIZE;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Releases the programs and deletes the density image, the tile buffers, and the VAO.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void DensitySplatRenderer::Cleanup()
+{
+    if (_splatProgramId != 0)
+    {
+        ReleaseProgram(_splatProgramId);
+        _splatProgramId = 0;
+    }
+    if (_resolveProgramId != 0)
+    {
+        ReleaseProgram(_resolveProgramId);
+        _resolveProgramId = 0;
+    }
+    if (_emptyVaoId != 0)
+    {
+        DeleteGlVertexArrays(1, &_emptyVaoId);
+        _emptyVaoId = 0;
+    }
+    if (_densityTextureId != 0)
+    {
+        ForgetGpuAllocation(GPU_MEMORY_TEXTURE, _densityTextureId);
+        glDeleteTextures(1, &_densityTextureId);
+        _densityTextureId = 0;
+    }
+    _width = 0;
+    _height = 0;
+
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _tileCountBufferId);
+    DeleteGlBuffers(1, &_tileCountBufferId);
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _tileOffsetBufferId);
+    DeleteGlBuffers(1, &_tileOffsetBufferId);
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _tileCursorBufferId);
+    DeleteGlBuffers(1, &_tileCursorBufferId);
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _binnedPixelBufferId);
+    DeleteGlBuffers(1, &_binnedPixelBufferId);
+    _tileCountBufferId = 0;
+    _tileOffsetBufferId = 0;
+    _tileCursorBufferId = 0;
+    _binnedPixelBufferId = 0;
+    _binnedPixelCapacity = 0;
+    _tileSize = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Re-creates the density image at the new window size.  Does nothing if the size didn't
+    change.
+Parameters:
+    width   The window's width in pixels.
+    height  The window's height in pixels.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void DensitySplatRenderer::Resize(int width, int height)
+{
+    _windowWidth = width;
+    _windowHeight = height;
+    int imageWidth = ScaleImageSize(width, _resolutionScale);
+    int imageHeight = ScaleImageSize(height, _resolutionScale);
+    if (_splatProgramId == 0 || (imageWidth == _width && imageHeight == _height))
+    {
+        return;
+    }
+
+    this->InitDensityImage(imageWidth, imageHeight);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Splats every live particle into the density image and resolves it to the window.
+Parameters:
+    extrapolationSec    Same as for ParticleManager::Render(...).
+    maxParticleCount    The size of the particle pool.  The splat pass reads the real number of
+                        live particles from the draw command, but the dispatch is sized on the
+                        CPU, so it is sized for all of them.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void DensitySplatRenderer::Render(float extrapolationSec, unsigned int maxParticleCount)
+{
+    if (!this->Splat(extrapolationSec, maxParticleCount))
+    {
+        return;
+    }
+    GlDebugGroup resolveGroup("density resolve");
+
+    // the exposure is for a particle in a pixel of the window (see GetDensityScale())
+    UseGlProgram(_resolveProgramId);
+    float scaleX = (_windowWidth > 0) ? ((float)_width / (float)_windowWidth) : 1.0f;
+    float scaleY = (_windowHeight > 0) ? ((float)_height / (float)_windowHeight) : 1.0f;
+    glUniform1f(_unifLocResolveExposure, _exposure * this->GetDensityScale());
+    glUniform2f(_unifLocResolveResolutionScale, scaleX, scaleY);
+    BindGlVertexArray(_emptyVaoId);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    BindGlVertexArray(0);
+    UseGlProgram(0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Splats every live particle into the density image, and leaves it there for whatever reads
+    it next.  The image is bound to image unit DENSITY_IMAGE_UNIT, and the barriers for 
+    reading it with image loads or texture fetches are already up.
+Parameters:
+    extrapolationSec    Same as for ParticleManager::Render(...).
+    maxParticleCount    Same as for Render(...).
+Returns:
+    False if there is no image to splat into (ex: the window is minimized), otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool DensitySplatRenderer::Splat(float extrapolationSec, unsigned int maxParticleCount)
+{
+    if (_splatProgramId == 0 || _densityTextureId == 0)
+    {
+        return false;
+    }
+    GlDebugGroup splatGroup("density splat");
+
+    glBindImageTexture(DENSITY_IMAGE_UNIT, _densityTextureId, 0, GL_FALSE, 0, GL_READ_WRITE,
+        GL_R32UI);
+
+    // the update wrote the particles and the live indices with shader storage writes, and its
+    // barrier only covers what the raster path reads, so the splat needs its own
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    UseGlProgram(_splatProgramId);
+    glUniform1f(_unifLocSplatExtrapolationSec, extrapolationSec);
+
+    // the window might be too big to bin (see InitTileBuffers())
+    if (_useTileBinning && _tileSize != 0)
+    {
+        this->RenderTileBinned(maxParticleCount);
+    }
+    else
+    {
+        this->RenderDirect(maxParticleCount);
+    }
+
+    // whatever reads the image next reads it in a shader, and the splat's image writes are not 
+    // ordered with the next frame's glClearTexImage(...) without the texture update bit
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.  The image is GL_R32UI, and is only valid to read between a Splat(...) 
+    and the next one.
+Parameters: None
+Returns:
+    The density texture, or 0 if there isn't one (ex: the window is minimized).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int DensitySplatRenderer::GetDensityTextureId() const
+{
+    return _densityTextureId;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The density image's width in pixels.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+int DensitySplatRenderer::GetWidth() const
+{
+    return _width;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The density image's height in pixels.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+int DensitySplatRenderer::GetHeight() const
+{
+    return _height;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    What a pixel's count is multiplied by to make it particles per pixel of the window, so 
+    that whatever is drawn from the image looks about the same at any resolution scale and 
+    level of detail: a smaller image has more particles in each pixel, and a thinned out draw 
+    has fewer.
+Parameters: None
+Returns:
+    See Description.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+float DensitySplatRenderer::GetDensityScale() const
+{
+    float scaleX = (_windowWidth > 0) ? ((float)_width / (float)_windowWidth) : 1.0f;
+    float scaleY = (_windowHeight > 0) ? ((float)_height / (float)_windowHeight) : 1.0f;
+    return scaleX * scaleY * _lodStride;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The original splat: clears the image and adds 1 to a pixel with a global image atomic for 
+    every particle.  Expects the splat program to be in use.
+Parameters:
+    maxParticleCount    See Render(...).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void DensitySplatRenderer::RenderDirect(unsigned int maxParticleCount)
+{
+    // the image is cleared by the GPU; no CPU-side zeroes are uploaded
+    // Note: The clear is a regular GL command, so the image atomics after it need no barrier.
+    GLuint zero = 0;
+    glClearTexImage(_densityTextureId, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+    glUniform1i(_unifLocSplatStage, SPLAT_STAGE_DIRECT);
+    // the shader loops, so past the device's limit in X, each work item takes more particles
+    GLuint numWorkGroupsX = ClampComputeDispatchSizeX(
+        (maxParticleCount + _splatWorkGroupSizeX - 1) / _splatWorkGroupSizeX);
+    glDispatchCompute(numWorkGroupsX, 1, 1);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Bins the particles into tiles and accumulates each tile in shared memory (see the class 
+    description).  Expects the splat program to be in use.
+Parameters:
+    maxParticleCount    See Render(...).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void DensitySplatRenderer::RenderTileBinned(unsigned int maxParticleCount)
+{
+    if (maxParticleCount > _binnedPixelCapacity)
+    {
+        this->InitBinnedPixelBuffer(maxParticleCount);
+    }
+
+    // the counts are added to, so they start at 0 every frame
+    // Note: Every pixel is written by the accumulate stage, so unlike the direct splat, the 
+    // image itself doesn't need a clear.
+    GLuint zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _tileCountBufferId);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // bound every frame because ParticleManager is free to use these binding points too
+    BindGlShaderStorageBuffer(TILE_COUNT_BUFFER_BINDING, _tileCountBufferId);
+    BindGlShaderStorageBuffer(TILE_OFFSET_BUFFER_BINDING, _tileOffsetBufferId);
+    BindGlShaderStorageBuffer(TILE_CURSOR_BUFFER_BINDING, _tileCursorBufferId);
+    BindGlShaderStorageBuffer(BINNED_PIXEL_BUFFER_BINDING, _binnedPixelBufferId);
+
+    glUniform1i(_unifLocTileSize, _tileSize);
+    glUniform1i(_unifLocTileCountX, _tileCountX);
+    glUniform1i(_unifLocTileCountY, _tileCountY);
+
+    // the count and scatter stages are one particle per work item because each work group 
+    // builds its own histogram
+    // Note: So they can't loop like the direct splat, and a pool that needs more work groups 
+    // than the device allows in X is split into a 2D dispatch instead.
+    unsigned int numParticleWorkGroupsX = 0;
+    unsigned int numParticleWorkGroupsY = 0;
+    GetComputeDispatchSize((maxParticleCount + _splatWorkGroupSizeX - 1) / _splatWorkGroupSizeX, 
+        &numParticleWorkGroupsX, &numParticleWorkGroupsY);
+
+    glUniform1i(_unifLocSplatStage, SPLAT_STAGE_COUNT_TILES);
+    glDispatchCompute(numParticleWorkGroupsX, numParticleWorkGroupsY, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    glUniform1i(_unifLocSplatStage, SPLAT_STAGE_SCAN_TILES);
+    glDispatchCompute(1, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    glUniform1i(_unifLocSplatStage, SPLAT_STAGE_SCATTER);
+    glDispatchCompute(numParticleWorkGroupsX, numParticleWorkGroupsY, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    glUniform1i(_unifLocSplatStage, SPLAT_STAGE_ACCUMULATE_TILES);
+    glDispatchCompute(_tileCountX, _tileCountY, 1);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets how bright a single particle is.  See shaderDensityResolve.frag for the tone map.  Can
+    be changed at any time.
+Parameters:
+    exposure    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void DensitySplatRenderer::SetExposure(float exposure)
+{
+    _exposure = exposure;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Makes the density image a fraction of the window's size on each axis, and the resolve 
+    stretches it over the window.  The splat's cost goes with the particles, but the clear, 
+    the tiles, and the resolve go with the pixels, so a smaller image is a cheaper splat for a 
+    blockier picture.  The exposure is scaled along with it so that the picture stays about 
+    as bright.  Can be changed at any time after Init(...).
+Parameters:
+    resolutionScale     Clamped to [1/8, 1].  1 is a pixel of the image for every pixel of 
+                        the window.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void DensitySplatRenderer::SetResolutionScale(float resolutionScale)
+{
+    _resolutionScale = (resolutionScale < 0.125f) ? 0.125f : 
+        ((resolutionScale > 1.0f) ? 1.0f : resolutionScale);
+    this->Resize(_windowWidth, _windowHeight);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The splat goes over the particle manager's live indices, so when the manager only draws 1 
+    in every so many particles (see ParticleManager::SetLevelOfDetail(...)), so does the 
+    splat.  This scales the exposure by as much to make up for the rest.  Set it before every 
+    Render(...) (see ParticleManager::GetLodStride()).
+Parameters:
+    lodStride   Self-explanatory.  0 is treated as 1.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void DensitySplatRenderer::SetLodStride(unsigned int lodStride)
+{
+    _lodStride = (lodStride > 0) ? lodStride : 1;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Switches between the tile binned splat (the default) and the direct splat with one global 
+    atomic per particle, for A/B timing.  Can be changed at any time.
+Parameters:
+    useTileBinning  Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void DensitySplatRenderer::SetTileBinning(bool useTileBinning)
+{
+    _useTileBinning = useTileBinning;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    layout          Must be the particle manager's layout.
+    workGroupSize   Self-explanatory.
+Returns:
+    The defines to give to AcquireComputeProgram(...) for the splat program.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+std::string DensitySplatRenderer::GetSplatShaderDefines(ParticleLayout layout,
+    unsigned int workGroupSize)
+{
+    return ParticleManager::GetComputeShaderDefines(layout, workGroupSize) +
+        "#define PARTICLE_SPLAT_PASS\n";
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    (Re)creates the density texture with immutable storage.  A 32-bit unsigned integer per
+    pixel is the only single-channel format that imageAtomicAdd(...) works on everywhere.
+Parameters:
+    width   Self-explanatory.
+    height  Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void DensitySplatRenderer::InitDensityImage(int width, int height)
+{
+    if (_densityTextureId != 0)
+    {
+        ForgetGpuAllocation(GPU_MEMORY_TEXTURE, _densityTextureId);
+        glDeleteTextures(1, &_densityTextureId);
+        _densityTextureId = 0;
+    }
+
+    // a minimized window reports 0x0
+    _width = width;
+    _height = height;
+    if (width <= 0 || height <= 0)
+    {
+        return;
+    }
+
+    glGenTextures(1, &_densityTextureId);
+    glBindTexture(GL_TEXTURE_2D, _densityTextureId);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32UI, width, height);
+    RecordGpuAllocation(GPU_MEMORY_TEXTURE, _densityTextureId, 
+        GetGlTextureSizeBytes(GL_R32UI, width, height), "density splat image");
+
+    // integer textures can't be filtered, and it's only ever read with imageLoad(...), but an
+    // incomplete texture may still trip up some drivers
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    this->InitTileBuffers();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Picks a tile size for the current image size and (re)creates the per-tile buffers.  If the 
+    image is too big for even the largest tiles, the tile size is left at 0 and Render(...) 
+    falls back to the direct splat.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void DensitySplatRenderer::InitTileBuffers()
+{
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _tileCountBufferId);
+    DeleteGlBuffers(1, &_tileCountBufferId);
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _tileOffsetBufferId);
+    DeleteGlBuffers(1, &_tileOffsetBufferId);
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _tileCursorBufferId);
+    DeleteGlBuffers(1, &_tileCursorBufferId);
+    _tileCountBufferId = 0;
+    _tileOffsetBufferId = 0;
+    _tileCursorBufferId = 0;
+    _tileSize = 0;
+    _tileCountX = 0;
+    _tileCountY = 0;
+    if (_width <= 0 || _height <= 0)
+    {
+        return;
+    }
+
+    for (unsigned int tileSize = MIN_TILE_SIZE; tileSize <= MAX_TILE_SIZE; tileSize *= 2)
+    {
+        unsigned int tileCountX = (_width + tileSize - 1) / tileSize;
+        unsigned int tileCountY = (_height + tileSize - 1) / tileSize;
+        if (tileCountX * tileCountY <= MAX_BIN_TILES)
+        {
+            _tileSize = tileSize;
+            _tileCountX = tileCountX;
+            _tileCountY = tileCountY;
+            break;
+        }
+    }
+    if (_tileSize == 0)
+    {
+        LogPrintf("%dx%d is too big to bin into tiles; using the direct splat\n", _width, _height);
+        return;
+    }
+
+    // GPU-only; the counts are cleared with glClearBufferData(...), which immutable storage 
+    // allows without GL_DYNAMIC_STORAGE_BIT, and the rest are written by the shader
+    GLsizeiptr tileBufferSizeBytes = _tileCountX * _tileCountY * sizeof(GLuint);
+    glGenBuffers(1, &_tileCountBufferId);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _tileCountBufferId);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, tileBufferSizeBytes, 0, 0);
+    RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "density splat tiles");
+    glGenBuffers(1, &_tileOffsetBufferId);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _tileOffsetBufferId);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, tileBufferSizeBytes, 0, 0);
+    RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "density splat tiles");
+    glGenBuffers(1, &_tileCursorBufferId);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _tileCursorBufferId);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, tileBufferSizeBytes, 0, 0);
+    RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "density splat tiles");
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    (Re)creates the buffer that the scatter stage writes each particle's pixel to.  It must 
+    have room for every particle because every particle might be alive and on screen.
+Parameters:
+    maxParticleCount    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void DensitySplatRenderer::InitBinnedPixelBuffer(unsigned int maxParticleCount)
+{
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _binnedPixelBufferId);
+    DeleteGlBuffers(1, &_binnedPixelBufferId);
+    _binnedPixelBufferId = 0;
+    glGenBuffers(1, &_binnedPixelBufferId);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _binnedPixelBufferId);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, maxParticleCount * sizeof(GLuint), 0, 0);
+    RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "density splat binned pixels");
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    _binnedPixelCapacity = maxParticleCount;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "ParticleManager.h"
+
+#include <string>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    An alternative to ParticleManager::Render(...) for very dense clouds.  Most particles cover
+    less than a pixel, so the point pipeline spends its time blending many fragments into the
+    same pixels.  This renderer instead has a compute shader add 1 to a 32-bit unsigned integer
+    image for every particle (imageAtomicAdd(...)), and then a fullscreen pass turns the counts
+    into brightness.  Neither pass goes near the rasterizer's blending hardware, and the cost
+    is one atomic per particle plus one read per pixel.
+
+    The splat program is shaderParticle.comp built with PARTICLE_SPLAT_PASS defined (see
+    GetSplatShaderDefines(...)), so it loads particles with the same storage layout code as the
+    update.  It reads the particle buffers, the live index buffer, and the draw count through
+    the shader storage bindings that ParticleManager set up, so it must run after the update
+    and while that particle manager is alive.
+
+    The image is the size of the window (or a fraction of it; see SetResolutionScale(...)), 
+    so Resize(...) must be called from the reshape callback.  Splat(...) fills it without the 
+    resolve, for passes that draw it some other way (see DensitySurfaceRenderer.h).
+
+    Note: By default the particles are binned into screen tiles first (see SetTileBinning(...)).
+    A single global atomic per particle serializes badly when the cloud is concentrated near
+    the emitter, which is exactly what the emitter produces.  Binning counts the particles per
+    tile, prefix sums the counts into ranges, scatters each particle's pixel into its tile's
+    range, and then gives each tile a work group that adds up its pixels in shared memory and
+    writes each pixel once.  Every global atomic in that chain is once per work group and tile
+    rather than once per particle.
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+class DensitySplatRenderer
+{
+public:
+    DensitySplatRenderer();
+    ~DensitySplatRenderer();
+    void Init(unsigned int splatProgramId, unsigned int resolveProgramId, int width, int height);
+    void Cleanup();
+    void Resize(int width, int height);
+    void ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId);
+
+    void Render(float extrapolationSec, unsigned int maxParticleCount);
+    bool Splat(float extrapolationSec, unsigned int maxParticleCount);
+    unsigned int GetDensityTextureId() const;
+    int GetWidth() const;
+    int GetHeight() const;
+    float GetDensityScale() const;
+    void SetExposure(float exposure);
+    void SetTileBinning(bool useTileBinning);
+    void SetResolutionScale(float resolutionScale);
+    void SetLodStride(unsigned int lodStride);
+
+    static std::string GetSplatShaderDefines(ParticleLayout layout,
+        unsigned int workGroupSize = ParticleManager::DEFAULT_WORK_GROUP_SIZE);
+
+private:
+    void LoadProgramInterfaces();
+    void InitDensityImage(int width, int height);
+    void InitTileBuffers();
+    void InitBinnedPixelBuffer(unsigned int maxParticleCount);
+    void RenderDirect(unsigned int maxParticleCount);
+    void RenderTileBinned(unsigned int maxParticleCount);
+
+    unsigned int _splatProgramId;
+    unsigned int _resolveProgramId;
+    unsigned int _splatWorkGroupSizeX;
+    unsigned int _unifLocSplatExtrapolationSec;
+    unsigned int _unifLocSplatStage;
+    unsigned int _unifLocTileSize;
+    unsigned int _unifLocTileCountX;
+    unsigned int _unifLocTileCountY;
+    unsigned int _unifLocResolveExposure;
+    unsigned int _unifLocResolveResolutionScale;
+    float _exposure;
+
+    // the fullscreen triangle has no vertex attributes, but the core profile still needs a VAO
+    // bound to draw
+    unsigned int _emptyVaoId;
+
+    // density is an r32ui texture bound as image unit 0 by both passes
+    static const unsigned int DENSITY_IMAGE_UNIT = 0;
+    unsigned int _densityTextureId;
+    int _width;
+    int _height;
+
+    // the image is this fraction of the window's size on each axis
+    int _windowWidth;
+    int _windowHeight;
+    float _resolutionScale;
+
+    // every particle in the image stands for this many (see SetLodStride(...))
+    unsigned int _lodStride;
+
+    // tile binning
+    // Note: The tile histograms and the per-tile density both live in the shader's shared 
+    // scratch array (SHARED_SCRATCH_SIZE in shaderParticle.comp), so the tile count and the 
+    // tile size are both limited by it.  The tiles start at 16x16 and grow until there are few
+    // enough of them.  The bindings continue from ParticleManager's.
+    static const unsigned int MAX_BIN_TILES = 2048;
+    static const unsigned int MIN_TILE_SIZE = 16;
+    static const unsigned int MAX_TILE_SIZE = 64;
+    static const unsigned int TILE_COUNT_BUFFER_BINDING = 8;
+    static const unsigned int TILE_OFFSET_BUFFER_BINDING = 9;
+    static const unsigned int TILE_CURSOR_BUFFER_BINDING = 10;
+    static const unsigned int BINNED_PIXEL_BUFFER_BINDING = 11;
+    bool _useTileBinning;
+    unsigned int _tileSize;
+    unsigned int _tileCountX;
+    unsigned int _tileCountY;
+    unsigned int _tileCountBufferId;
+    unsigned int _tileOffsetBufferId;
+    unsigned int _tileCursorBufferId;
+    unsigned int _binnedPixelBufferId;
+    unsigned int _binnedPixelCapacity;
+};
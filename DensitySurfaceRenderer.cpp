@@ -0,0 +1,405 @@
+#include "DensitySurfaceRenderer.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
+#include "ShaderProgramRegistry.h"
+#include "GpuMemoryLedger.h"
+#include "OpenGlErrorHandling.h"
+#include "Log.h"
+
+// must match the SURFACE_STAGE_* defines in shaderDensitySurface.comp
+enum SurfaceStage
+{
+    SURFACE_STAGE_BLUR = 0,
+    SURFACE_STAGE_CONTOUR,
+};
+
+// must match WORK_GROUP_SIZE in shaderDensitySurface.comp
+static const int SURFACE_WORK_GROUP_SIZE = 64;
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+DensitySurfaceRenderer::DensitySurfaceRenderer() :
+    _surfaceProgramId(0),
+    _shadeProgramId(0),
+    _contourProgramId(0),
+    _unifLocSurfaceStage(0),
+    _unifLocBlurDirection(0),
+    _unifLocDensityScale(0),
+    _unifLocContourThreshold(0),
+    _unifLocShadeThreshold(0),
+    _unifLocShadeInverseViewportSize(0),
+    _threshold(1.0f),
+    _emptyVaoId(0),
+    _blurTextureId(0),
+    _fieldTextureId(0),
+    _width(0),
+    _height(0),
+    _contourDrawBufferId(0),
+    _contourVertexBufferId(0)
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+DensitySurfaceRenderer::~DensitySurfaceRenderer()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes a reference to the programs (see ShaderProgramRegistry.h).  The targets aren't made
+    until the first Render(...), when the density image's size is known.  The caller may
+    release their own references after this returns.
+Parameters:
+    surfaceProgramId    shaderDensitySurface.comp.
+    shadeProgramId      shaderDensityResolve.vert (the fullscreen triangle) with
+                        shaderDensitySurface.frag.
+    contourProgramId    shaderDensityContour.vert with shaderParticle.frag, or 0 to draw the
+                        surface without the contour lines.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void DensitySurfaceRenderer::Init(unsigned int surfaceProgramId, unsigned int shadeProgramId,
+    unsigned int contourProgramId)
+{
+    this->Cleanup();
+    if (surfaceProgramId == 0 || shadeProgramId == 0)
+    {
+        LogPrintf("the density surface needs its blur and shading programs\n");
+        return;
+    }
+
+    _surfaceProgramId = surfaceProgramId;
+    _shadeProgramId = shadeProgramId;
+    _contourProgramId = contourProgramId;
+    AddProgramReference(_surfaceProgramId);
+    AddProgramReference(_shadeProgramId);
+    if (_contourProgramId != 0)
+    {
+        AddProgramReference(_contourProgramId);
+    }
+    this->LoadProgramInterfaces();
+    glGenVertexArrays(1, &_emptyVaoId);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Releases the programs and deletes the targets, the contour buffers, and the VAO.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void DensitySurfaceRenderer::Cleanup()
+{
+    this->DeleteTargets();
+    if (_emptyVaoId != 0)
+    {
+        DeleteGlVertexArrays(1, &_emptyVaoId);
+        _emptyVaoId = 0;
+    }
+    ReleaseProgram(_surfaceProgramId);
+    ReleaseProgram(_shadeProgramId);
+    if (_contourProgramId != 0)
+    {
+        ReleaseProgram(_contourProgramId);
+    }
+    _surfaceProgramId = 0;
+    _shadeProgramId = 0;
+    _contourProgramId = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Switches to a rebuilt program (see ShaderProgramRegistry.h).
+Parameters:
+    oldProgramId    Self-explanatory.  Programs that this renderer doesn't use are ignored.
+    newProgramId    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void DensitySurfaceRenderer::ReplaceProgram(unsigned int oldProgramId,
+    unsigned int newProgramId)
+{
+    if (oldProgramId == 0 || newProgramId == 0)
+    {
+        return;
+    }
+
+    unsigned int *programIds[3] = { &_surfaceProgramId, &_shadeProgramId, &_contourProgramId };
+    bool isReplaced = false;
+    for (unsigned int programIndex = 0; programIndex < 3; programIndex++)
+    {
+        if (*programIds[programIndex] == oldProgramId)
+        {
+            AddProgramReference(newProgramId);
+            ReleaseProgram(*programIds[programIndex]);
+            *programIds[programIndex] = newProgramId;
+            isReplaced = true;
+        }
+    }
+
+    if (isReplaced)
+    {
+        this->LoadProgramInterfaces();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Looks up the programs' uniforms.  Called by Init(...) and whenever a program is replaced.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void DensitySurfaceRenderer::LoadProgramInterfaces()
+{
+    _unifLocSurfaceStage = glGetUniformLocation(_surfaceProgramId, "uSurfaceStage");
+    _unifLocBlurDirection = glGetUniformLocation(_surfaceProgramId, "uBlurDirection");
+    _unifLocDensityScale = glGetUniformLocation(_surfaceProgramId, "uDensityScale");
+    _unifLocContourThreshold = glGetUniformLocation(_surfaceProgramId, "uThreshold");
+    _unifLocShadeThreshold = glGetUniformLocation(_shadeProgramId, "uThreshold");
+    _unifLocShadeInverseViewportSize = glGetUniformLocation(_shadeProgramId,
+        "uInverseViewportSize");
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets where the surface is.  The field is in particles per pixel of the window, after the
+    blur, so a lower threshold puts the surface further out from the particles and joins up
+    the sparser parts of the body, and a higher one only covers where they are packed in.  Can
+    be changed at any time.
+Parameters:
+    threshold   Greater than 0.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void DensitySurfaceRenderer::SetThreshold(float threshold)
+{
+    if (threshold <= 0.0f)
+    {
+        LogPrintf("the density surface's threshold must be greater than 0\n");
+        return;
+    }
+    _threshold = threshold;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Blurs the splat's density image into the field, contours it if there is a contour program,
+    and shades the surface over the whole viewport.  The splat must have just been made (see
+    DensitySplatRenderer::Splat(...)).
+Parameters:
+    splat   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void DensitySurfaceRenderer::Render(const DensitySplatRenderer &splat)
+{
+    if (_surfaceProgramId == 0 || splat.GetDensityTextureId() == 0)
+    {
+        return;
+    }
+    if (splat.GetWidth() != _width || splat.GetHeight() != _height || _fieldTextureId == 0)
+    {
+        this->InitTargets(splat.GetWidth(), splat.GetHeight());
+    }
+    if (_fieldTextureId == 0)
+    {
+        return;
+    }
+    GlDebugGroup surfaceGroup("density surface");
+
+    // the rows' blur reads the counts and the columns' blur reads the rows'
+    UseGlProgram(_surfaceProgramId);
+    glUniform1f(_unifLocDensityScale, splat.GetDensityScale());
+    glUniform1f(_unifLocContourThreshold, _threshold);
+    glBindImageTexture(DENSITY_IMAGE_UNIT, splat.GetDensityTextureId(), 0, GL_FALSE, 0,
+        GL_READ_ONLY, GL_R32UI);
+    glBindImageTexture(SURFACE_DESTINATION_IMAGE_UNIT, _blurTextureId, 0, GL_FALSE, 0,
+        GL_WRITE_ONLY, GL_R16F);
+    this->DispatchSurfaceStage(SURFACE_STAGE_BLUR, _width, _height, 0);
+    glBindImageTexture(SURFACE_SOURCE_IMAGE_UNIT, _blurTextureId, 0, GL_FALSE, 0,
+        GL_READ_ONLY, GL_R16F);
+    glBindImageTexture(SURFACE_DESTINATION_IMAGE_UNIT, _fieldTextureId, 0, GL_FALSE, 0,
+        GL_WRITE_ONLY, GL_R16F);
+    this->DispatchSurfaceStage(SURFACE_STAGE_BLUR, _height, _width, 1);
+
+    if (_contourProgramId != 0)
+    {
+        // the vertex count starts at 0 every frame, and the rest of the command stays as
+        // InitTargets(...) made it
+        GLuint zero = 0;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, _contourDrawBufferId);
+        glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, 0, sizeof(GLuint),
+            GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        // bound every frame because other passes are free to use these binding points too
+        BindGlShaderStorageBuffer(CONTOUR_DRAW_BUFFER_BINDING, _contourDrawBufferId);
+        BindGlShaderStorageBuffer(CONTOUR_VERTEX_BUFFER_BINDING, _contourVertexBufferId);
+        glBindImageTexture(SURFACE_SOURCE_IMAGE_UNIT, _fieldTextureId, 0, GL_FALSE, 0,
+            GL_READ_ONLY, GL_R16F);
+        this->DispatchSurfaceStage(SURFACE_STAGE_CONTOUR, _width - 1, _height - 1, 0);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+    }
+
+    GLint viewport[4] = { 0, 0, 0, 0 };
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    UseGlProgram(_shadeProgramId);
+    glUniform1f(_unifLocShadeThreshold, _threshold);
+    glUniform2f(_unifLocShadeInverseViewportSize,
+        (viewport[2] > 0) ? (1.0f / viewport[2]) : 1.0f,
+        (viewport[3] > 0) ? (1.0f / viewport[3]) : 1.0f);
+    glActiveTexture(GL_TEXTURE0 + SURFACE_FIELD_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, _fieldTextureId);
+    BindGlVertexArray(_emptyVaoId);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    if (_contourProgramId != 0)
+    {
+        UseGlProgram(_contourProgramId);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _contourDrawBufferId);
+        glDrawArraysIndirect(GL_LINES, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+    BindGlVertexArray(0);
+    UseGlProgram(0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Runs a stage of the surface program with a work group for every WORK_GROUP_SIZE texels of
+    a row (or column, for the columns' blur), and waits for its image writes.
+Parameters:
+    stage       A SurfaceStage.
+    alongSize   The texels along the axis that each work group goes along.
+    acrossSize  The texels along the other one.
+    alongAxis   0 for the rows, 1 for the columns.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void DensitySurfaceRenderer::DispatchSurfaceStage(int stage, int alongSize, int acrossSize,
+    int alongAxis)
+{
+    glUniform1i(_unifLocSurfaceStage, stage);
+    glUniform2i(_unifLocBlurDirection, (alongAxis == 0) ? 1 : 0, (alongAxis == 0) ? 0 : 1);
+    glDispatchCompute((alongSize + SURFACE_WORK_GROUP_SIZE - 1) / SURFACE_WORK_GROUP_SIZE,
+        acrossSize, 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    (Re)creates the blur targets at the density image's size, and the contour buffers if
+    there is a contour program.  The targets are R16F, which has room for thousands of
+    particles per pixel and is filtered by everything, and linearly filtered, since the
+    shading stretches the field over the window.
+Parameters:
+    width   Self-explanatory.
+    height  Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void DensitySurfaceRenderer::InitTargets(int width, int height)
+{
+    this->DeleteTargets();
+
+    // the contours need at least a cell
+    _width = width;
+    _height = height;
+    if (_width < 2 || _height < 2)
+    {
+        return;
+    }
+
+    unsigned int *textureIds[2] = { &_blurTextureId, &_fieldTextureId };
+    for (unsigned int targetIndex = 0; targetIndex < 2; targetIndex++)
+    {
+        glGenTextures(1, textureIds[targetIndex]);
+        glBindTexture(GL_TEXTURE_2D, *textureIds[targetIndex]);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_R16F, _width, _height);
+        RecordGpuAllocation(GPU_MEMORY_TEXTURE, *textureIds[targetIndex],
+            GetGlTextureSizeBytes(GL_R16F, _width, _height), "density surface");
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    if (_contourProgramId == 0)
+    {
+        return;
+    }
+
+    // a glDrawArraysIndirect(...) command of no vertices and 1 instance, which the marching
+    // squares pass adds its vertices to, and room for the most vertices that it can make
+    // Note: GPU-only, like the density splat's tile buffers.  The count is cleared with
+    // glClearBufferSubData(...), which immutable storage allows without
+    // GL_DYNAMIC_STORAGE_BIT.
+    GLuint drawCommand[4] = { 0, 1, 0, 0 };
+    glGenBuffers(1, &_contourDrawBufferId);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _contourDrawBufferId);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof(drawCommand), drawCommand, 0);
+    RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "density surface contours");
+    GLsizeiptr vertexBufferSizeBytes =
+        (GLsizeiptr)(_width - 1) * (_height - 1) * 4 * (2 * sizeof(float));
+    glGenBuffers(1, &_contourVertexBufferId);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _contourVertexBufferId);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, vertexBufferSizeBytes, 0, 0);
+    RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "density surface contours");
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.  The next Render(...) makes them again.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void DensitySurfaceRenderer::DeleteTargets()
+{
+    unsigned int *textureIds[2] = { &_blurTextureId, &_fieldTextureId };
+    for (unsigned int targetIndex = 0; targetIndex < 2; targetIndex++)
+    {
+        if (*textureIds[targetIndex] != 0)
+        {
+            ForgetGpuAllocation(GPU_MEMORY_TEXTURE, *textureIds[targetIndex]);
+            glDeleteTextures(1, textureIds[targetIndex]);
+            *textureIds[targetIndex] = 0;
+        }
+    }
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _contourDrawBufferId);
+    DeleteGlBuffers(1, &_contourDrawBufferId);
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _contourVertexBufferId);
+    DeleteGlBuffers(1, &_contourVertexBufferId);
+    _contourDrawBufferId = 0;
+    _contourVertexBufferId = 0;
+    _width = 0;
+    _height = 0;
+}
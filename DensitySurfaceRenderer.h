@@ -0,0 +1,92 @@
+#pragma once
+
+#include "DensitySplatRenderer.h"
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Draws the particles as a liquid surface instead of as points, for the fluid modes (ex:
+    "--sph"), where what matters is the shape of the body of particles and not the particles
+    themselves.
+
+    The density splat (see DensitySplatRenderer::Splat(...)) counts the particles in a
+    low-resolution image, a separable Gaussian blur in compute (see
+    shaderDensitySurface.comp) spreads each count into a smooth field, like the sum of the
+    particles' metaballs, and then a fullscreen pass thresholds the field into a surface and
+    shades it with a normal from the field's gradient.  The field is filtered up to the
+    window, so the surface's edge is smooth even though the image is a fraction of its size.
+
+    After the splat, which is an atomic per particle, everything here goes with the number of
+    pixels: the blur goes over the low-resolution image twice, and the shading reads 5 texels
+    per window pixel.  A million particles cost the same to blur and shade as a thousand.
+
+    Optionally (see Init(...)), a marching squares pass turns the same field into contour
+    lines at the threshold, which are drawn over the surface with one indirect draw whose
+    vertex count the compute shader writes, so the CPU never learns how many there are.
+
+    Note: The field and the contours are in the density image's pixels, which are in the
+    window's clip space, so this follows the camera like the splat does.  The targets are
+    (re)created whenever the density image changes size.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class DensitySurfaceRenderer
+{
+public:
+    DensitySurfaceRenderer();
+    ~DensitySurfaceRenderer();
+    void Init(unsigned int surfaceProgramId, unsigned int shadeProgramId,
+        unsigned int contourProgramId);
+    void Cleanup();
+    void ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId);
+
+    void SetThreshold(float threshold);
+    void Render(const DensitySplatRenderer &splat);
+
+private:
+    void LoadProgramInterfaces();
+    void InitTargets(int width, int height);
+    void DeleteTargets();
+    void DispatchSurfaceStage(int stage, int alongSize, int acrossSize, int alongAxis);
+
+    unsigned int _surfaceProgramId;
+    unsigned int _shadeProgramId;
+    unsigned int _contourProgramId;
+    unsigned int _unifLocSurfaceStage;
+    unsigned int _unifLocBlurDirection;
+    unsigned int _unifLocDensityScale;
+    unsigned int _unifLocContourThreshold;
+    unsigned int _unifLocShadeThreshold;
+    unsigned int _unifLocShadeInverseViewportSize;
+    float _threshold;
+
+    // the fullscreen triangle has no vertex attributes, and neither do the contours, but the
+    // core profile still needs a VAO bound to draw
+    unsigned int _emptyVaoId;
+
+    // Note: The units must match shaderDensitySurface.comp.  The density image is where the
+    // splat left it.  The others are shared with the field bake and the SDF boundary's
+    // passes (see ParticleFieldTexture.h and ParticleBoundarySdf.h), which bind their own
+    // before every dispatch, like this does.
+    static const unsigned int DENSITY_IMAGE_UNIT = 0;
+    static const unsigned int SURFACE_DESTINATION_IMAGE_UNIT = 1;
+    static const unsigned int SURFACE_SOURCE_IMAGE_UNIT = 2;
+
+    // the shading samples the field on this unit while it draws
+    // Note: Must match "uSurfaceField" in shaderDensitySurface.frag.
+    static const unsigned int SURFACE_FIELD_TEXTURE_UNIT = 0;
+
+    // the blur across the rows goes into the first, and the blur down the columns goes from
+    // there into the second, which is the field that is shaded and contoured
+    unsigned int _blurTextureId;
+    unsigned int _fieldTextureId;
+    int _width;
+    int _height;
+
+    // the contour segments' end points (2 per segment, and at most 2 segments per cell) and
+    // the indirect draw that the marching squares pass counts them into
+    // Note: The bindings must match shaderDensitySurface.comp and shaderDensityContour.vert.
+    // They come after the spatial queries' (see ParticleSpatialQuery.h).
+    static const unsigned int CONTOUR_DRAW_BUFFER_BINDING = 63;
+    static const unsigned int CONTOUR_VERTEX_BUFFER_BINDING = 64;
+    unsigned int _contourDrawBufferId;
+    unsigned int _contourVertexBufferId;
+};
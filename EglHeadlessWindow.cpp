@@ -0,0 +1,395 @@
+#include "EglHeadlessWindow.h"
+
+#include "GlStateCache.h"
+#include "Log.h"
+
+// Windows has no EGL outside of ANGLE, which is GLES only, so it gets the stubs
+#if !defined(WIN32) && !defined(EGL_HEADLESS_DISABLED)
+#define EGL_HEADLESS_HAS_EGL
+#endif
+
+#ifdef EGL_HEADLESS_HAS_EGL
+// Build note: Also need to link libEGL.
+// Build note: Without this, Mesa's eglplatform.h pulls in the X11 headers, which a server
+// doesn't need to have.
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.  There is no context until Create(...).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+EglHeadlessWindow::EglHeadlessWindow() :
+    _display(0),
+    _context(0),
+    _surface(0),
+    _deviceIndex(0),
+    _width(0),
+    _height(0),
+    _hasSentSize(false),
+    _isCloseRequested(false)
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Destroy() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+EglHeadlessWindow::~EglHeadlessWindow()
+{
+    this->Destroy();
+}
+
+#ifdef EGL_HEADLESS_HAS_EGL
+// more GPUs than any one machine has
+static const EGLint EGL_HEADLESS_MAX_DEVICES = 16;
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Finds a display on one of the GPUs that EGL knows of, without a window system.
+Parameters:
+    deviceIndex     0 for the first GPU.
+Returns:
+    The display, or EGL_NO_DISPLAY if the driver can't list its devices or doesn't have that
+    many.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+static EGLDisplay GetDeviceDisplay(unsigned int deviceIndex)
+{
+    PFNEGLQUERYDEVICESEXTPROC queryDevices =
+        (PFNEGLQUERYDEVICESEXTPROC)eglGetProcAddress("eglQueryDevicesEXT");
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (queryDevices == 0 || getPlatformDisplay == 0)
+    {
+        return EGL_NO_DISPLAY;
+    }
+
+    EGLDeviceEXT devices[EGL_HEADLESS_MAX_DEVICES];
+    EGLint deviceCount = 0;
+    if (!queryDevices(EGL_HEADLESS_MAX_DEVICES, devices, &deviceCount) ||
+        deviceCount <= (EGLint)deviceIndex)
+    {
+        return EGL_NO_DISPLAY;
+    }
+    return getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, devices[deviceIndex], 0);
+}
+#endif
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Makes the context and a pbuffer to draw into, and makes them current.
+Parameters:
+    settings    The title and position are for windows and are ignored.
+Returns:
+    False if EGL couldn't make an OpenGL context of the version that was asked for (or this
+    build has no EGL), otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+bool EglHeadlessWindow::Create(const AppWindowSettings &settings)
+{
+#ifdef EGL_HEADLESS_HAS_EGL
+    this->Destroy();
+
+    EGLDisplay display = GetDeviceDisplay(_deviceIndex);
+    EGLint majorVersion = 0;
+    EGLint minorVersion = 0;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &majorVersion, &minorVersion))
+    {
+        // the default display is the first GPU, so it is no good for any other
+        if (_deviceIndex != 0)
+        {
+            LogPrintf("headless: no EGL display for GPU %u\n", _deviceIndex);
+            return false;
+        }
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, &majorVersion, &minorVersion))
+        {
+            LogPrintf("headless: no EGL display\n");
+            return false;
+        }
+    }
+    _display = display;
+    LogPrintf("headless: EGL %d.%d, %s\n", majorVersion, minorVersion,
+        eglQueryString(display, EGL_VENDOR));
+
+    // desktop OpenGL, not GLES
+    if (!eglBindAPI(EGL_OPENGL_API))
+    {
+        LogPrintf("headless: EGL can't make desktop OpenGL contexts\n");
+        this->Destroy();
+        return false;
+    }
+
+    const EGLint configAttributes[] =
+    {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 0,
+        EGL_DEPTH_SIZE, settings._hasDepthBuffer ? 24 : 0,
+        EGL_NONE,
+    };
+    EGLConfig config = 0;
+    EGLint configCount = 0;
+    if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) ||
+        configCount < 1)
+    {
+        LogPrintf("headless: no EGL config with a pbuffer\n");
+        this->Destroy();
+        return false;
+    }
+
+    const EGLint surfaceAttributes[] =
+    {
+        EGL_WIDTH, settings._width,
+        EGL_HEIGHT, settings._height,
+        EGL_NONE,
+    };
+    _surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+    if (_surface == EGL_NO_SURFACE)
+    {
+        LogPrintf("headless: couldn't create a %dx%d pbuffer\n", settings._width,
+            settings._height);
+        _surface = 0;
+        this->Destroy();
+        return false;
+    }
+
+    // Note: The EGL 1.5 names, which are the same values as EGL_KHR_create_context's.
+    const EGLint contextAttributes[] =
+    {
+        EGL_CONTEXT_MAJOR_VERSION, settings._glMajorVersion,
+        EGL_CONTEXT_MINOR_VERSION, settings._glMinorVersion,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_CONTEXT_OPENGL_DEBUG, settings._isDebugContext ? EGL_TRUE : EGL_FALSE,
+        EGL_NONE,
+    };
+    _context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    if (_context == EGL_NO_CONTEXT)
+    {
+        LogPrintf("headless: couldn't create an OpenGL %d.%d core context\n",
+            settings._glMajorVersion, settings._glMinorVersion);
+        _context = 0;
+        this->Destroy();
+        return false;
+    }
+    if (!eglMakeCurrent(display, _surface, _surface, _context))
+    {
+        LogPrintf("headless: couldn't make the context current\n");
+        this->Destroy();
+        return false;
+    }
+
+    // a new context has GL's defaults, whatever the thread's last one had bound
+    InvalidateGlStateCache();
+
+    _width = settings._width;
+    _height = settings._height;
+    _hasSentSize = false;
+    _isCloseRequested = false;
+    return true;
+#else
+    LogPrintf("headless: this build has no EGL (%dx%d asked for)\n", settings._width,
+        settings._height);
+    return false;
+#endif
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Releases the context, the pbuffer, and the display.  Safe to call more than once.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void EglHeadlessWindow::Destroy()
+{
+#ifdef EGL_HEADLESS_HAS_EGL
+    if (_display == 0)
+    {
+        return;
+    }
+
+    eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (_context != 0)
+    {
+        eglDestroyContext(_display, _context);
+    }
+    if (_surface != 0)
+    {
+        eglDestroySurface(_display, _surface);
+    }
+    eglTerminate(_display);
+#endif
+    _display = 0;
+    _context = 0;
+    _surface = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    There are no events, except that the first call passes the pbuffer's size to the resize
+    handler like a window's first reshape would.
+Parameters: None
+Returns:
+    False once RequestClose() is called or if there is no context, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+bool EglHeadlessWindow::PollEvents()
+{
+    if (_context == 0 || _isCloseRequested)
+    {
+        return false;
+    }
+    if (!_hasSentSize)
+    {
+        _hasSentSize = true;
+        if (_resizeHandler)
+        {
+            _resizeHandler(_width, _height);
+        }
+    }
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    A pbuffer has nothing to swap to, so this is where the frame's commands are sent off.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void EglHeadlessWindow::SwapBuffers()
+{
+#ifdef EGL_HEADLESS_HAS_EGL
+    if (_surface != 0)
+    {
+        eglSwapBuffers(_display, _surface);
+    }
+#endif
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Has the next PollEvents() say that it's time to stop.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void EglHeadlessWindow::RequestClose()
+{
+    _isCloseRequested = true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Does nothing.  There is nothing to see.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void EglHeadlessWindow::Hide()
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The pbuffer's width in pixels.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+int EglHeadlessWindow::GetWidth() const
+{
+    return _width;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The pbuffer's height in pixels.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+int EglHeadlessWindow::GetHeight() const
+{
+    return _height;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Always true.  Nothing can see the pbuffer, but a headless run is offscreen on purpose, so 
+    it shouldn't be slowed down like a minimized window.
+Parameters: None
+Returns:    True
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool EglHeadlessWindow::IsVisible() const
+{
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Picks the GPU that Create(...) makes the context on.  Must be called before Create(...).
+Parameters:
+    deviceIndex     0 (the default) for the first GPU, and so on up to GetDeviceCount() - 1.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void EglHeadlessWindow::SetDeviceIndex(unsigned int deviceIndex)
+{
+    _deviceIndex = deviceIndex;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Asks EGL how many GPUs it can make contexts on, without making one.
+Parameters: None
+Returns:
+    The number of GPUs, or 0 if this build has no EGL or the driver can't list its devices.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int EglHeadlessWindow::GetDeviceCount()
+{
+#ifdef EGL_HEADLESS_HAS_EGL
+    PFNEGLQUERYDEVICESEXTPROC queryDevices =
+        (PFNEGLQUERYDEVICESEXTPROC)eglGetProcAddress("eglQueryDevicesEXT");
+    EGLDeviceEXT devices[EGL_HEADLESS_MAX_DEVICES];
+    EGLint deviceCount = 0;
+    if (queryDevices == 0 || !queryDevices(EGL_HEADLESS_MAX_DEVICES, devices, &deviceCount))
+    {
+        return 0;
+    }
+    return (unsigned int)deviceCount;
+#else
+    return 0;
+#endif
+}
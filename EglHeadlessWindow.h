@@ -0,0 +1,58 @@
+#pragma once
+
+#include "AppWindow.h"
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    An OpenGL context without a window or a window system (see AppWindow.h), for GPU servers
+    and CI machines that have no display.  EGL picks the GPU directly through
+    EGL_EXT_platform_device when the driver has it, or else its default display (ex: Mesa's
+    surfaceless platform), and the frames are drawn into a pbuffer surface the size of the
+    window that there would have been.  Everything else, compute included, is the same as
+    with a window.
+
+    There are no events, so the loop runs until RequestClose() (ex: main()'s frame count).
+    The resize handler is called once, with the pbuffer's size, on the first PollEvents().
+
+    Note: Only built where there is an EGL to link (see EGL_HEADLESS_HAS_EGL in the .cpp).
+    Elsewhere, Create(...) says so and fails.
+    Also Note: glload finds the GL functions through the window system's usual
+    GetProcAddress(...), and the vendor drivers hand out the same functions through it
+    whichever API made the context.
+    Also Also Note: SetDeviceIndex(...) picks a GPU other than the first, so that there can be
+    a context on each GPU of a machine (see MultiGpuSimulation.h).
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+class EglHeadlessWindow : public AppWindow
+{
+public:
+    EglHeadlessWindow();
+    virtual ~EglHeadlessWindow();
+
+    virtual bool Create(const AppWindowSettings &settings);
+    virtual void Destroy();
+
+    virtual bool PollEvents();
+    virtual void SwapBuffers();
+    virtual void RequestClose();
+    virtual void Hide();
+
+    virtual int GetWidth() const;
+    virtual int GetHeight() const;
+    virtual bool IsVisible() const;
+
+    void SetDeviceIndex(unsigned int deviceIndex);
+    static unsigned int GetDeviceCount();
+
+private:
+    // Note: EGL's handles are pointers, so these are stored as void * to keep EGL out of the
+    // header.
+    void *_display;
+    void *_context;
+    void *_surface;
+    unsigned int _deviceIndex;
+    int _width;
+    int _height;
+    bool _hasSentSize;
+    bool _isCloseRequested;
+};
@@ -0,0 +1,250 @@
+#include "FrameArena.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlFenceSync.h"
+
+// how long BeginFrame() waits for an old frame before it takes the slot anyway
+// Note: The slot is SLOT_COUNT frames old by then, so the wait is only ever reached when the
+// GPU is far behind, and the frame pacer will have held the CPU back before that.
+static const GLuint64 FRAME_ARENA_FENCE_TIMEOUT_NS = 1000000000;
+
+// the slots start this big if Init(...) isn't called
+static const size_t DEFAULT_FRAME_ARENA_SLOT_SIZE_BYTES = 64 * 1024;
+
+// each thread with a context has its own (see GetFrameArena())
+static thread_local FrameArena gFrameArena;
+
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Ensures that the arena starts out of a frame and with no memory.  The slots get their
+    memory the first time that they are rewound.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+FrameArena::FrameArena() :
+    _currentSlot(SLOT_COUNT - 1),
+    _isInFrame(false),
+    _highWaterBytes(DEFAULT_FRAME_ARENA_SLOT_SIZE_BYTES),
+    _overflowCount(0)
+{
+    for (unsigned int slotIndex = 0; slotIndex < SLOT_COUNT; slotIndex++)
+    {
+        _slots[slotIndex]._sizeBytes = 0;
+        _slots[slotIndex]._usedBytes = 0;
+        _slots[slotIndex]._overflowBytes = 0;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets how big each slot starts, so that a frame path that is known to need more doesn't
+    have to overflow a few times to get there.  Must be called out of a frame.
+Parameters:
+    slotSizeBytes   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void FrameArena::Init(size_t slotSizeBytes)
+{
+    this->Cleanup();
+    _highWaterBytes = slotSizeBytes;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives back every slot's memory and fence.  Needs the context to still be current.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void FrameArena::Cleanup()
+{
+    for (unsigned int slotIndex = 0; slotIndex < SLOT_COUNT; slotIndex++)
+    {
+        Slot &slot = _slots[slotIndex];
+        slot._memory.reset();
+        slot._sizeBytes = 0;
+        slot._usedBytes = 0;
+        slot._overflowBlocks.clear();
+        slot._overflowBytes = 0;
+        slot._fence.Reset();
+    }
+    _currentSlot = SLOT_COUNT - 1;
+    _isInFrame = false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Moves on to the next slot and rewinds it, once the frame that last used it is done on the
+    GPU.  Everything allocated in that frame goes bad.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void FrameArena::BeginFrame()
+{
+    _currentSlot = (_currentSlot + 1) % SLOT_COUNT;
+    Slot &slot = _slots[_currentSlot];
+    WaitForGlFence(slot._fence, FRAME_ARENA_FENCE_TIMEOUT_NS, "frame arena slot");
+    slot._fence.Reset();
+    this->RewindSlot(&slot);
+    _isInFrame = true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Fences the frame's slot so that it isn't rewound until the GPU is done with the frame.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void FrameArena::EndFrame()
+{
+    if (!_isInFrame)
+    {
+        return;
+    }
+    _slots[_currentSlot]._fence = InsertGlFence();
+    _isInFrame = false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    True if between BeginFrame() and EndFrame(), otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool FrameArena::IsInFrame() const
+{
+    return _isInFrame;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes memory from the frame's slot, or from the heap if the slot is full.
+Parameters:
+    sizeBytes   Self-explanatory.
+    alignment   A power of 2 up to 16.
+Returns:
+    Uninitialized memory that is good until this slot is rewound SLOT_COUNT frames from now,
+    or 0 if not in a frame.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void *FrameArena::Allocate(size_t sizeBytes, size_t alignment)
+{
+    if (!_isInFrame)
+    {
+        return 0;
+    }
+
+    Slot &slot = _slots[_currentSlot];
+    size_t offset = (slot._usedBytes + alignment - 1) & ~(alignment - 1);
+    if (offset + sizeBytes <= slot._sizeBytes)
+    {
+        slot._usedBytes = offset + sizeBytes;
+        return slot._memory.get() + offset;
+    }
+
+    // new[] of unsigned char is aligned for any fundamental type, which covers the 16
+    _overflowCount++;
+    slot._overflowBlocks.push_back(std::unique_ptr<unsigned char[]>(
+        new unsigned char[sizeBytes > 0 ? sizeBytes : 1]));
+    slot._overflowBytes += sizeBytes + alignment;
+    return slot._overflowBlocks.back().get();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How big the current slot is, not counting what it overflowed into.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+size_t FrameArena::GetSlotSizeBytes() const
+{
+    return _slots[_currentSlot]._sizeBytes;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The most that any frame has needed (or the size that Init(...) asked for, if more), which
+    is how big every slot grows to.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+size_t FrameArena::GetHighWaterBytes() const
+{
+    return _highWaterBytes;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How many allocations had to go to the heap, since the arena was made.  It stops going up
+    once the slots have grown to fit the frame.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int FrameArena::GetOverflowCount() const
+{
+    return _overflowCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives back the slot's overflow and grows it to the high water mark if the last frame (in
+    any slot) needed more than it has.
+Parameters:
+    slot    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void FrameArena::RewindSlot(Slot *slot)
+{
+    size_t neededBytes = slot->_usedBytes + slot->_overflowBytes;
+    if (neededBytes > _highWaterBytes)
+    {
+        _highWaterBytes = neededBytes;
+    }
+    slot->_overflowBlocks.clear();
+    slot->_overflowBytes = 0;
+    slot->_usedBytes = 0;
+    if (slot->_sizeBytes < _highWaterBytes)
+    {
+        slot->_memory.reset(new unsigned char[_highWaterBytes]);
+        slot->_sizeBytes = _highWaterBytes;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    A reference to the calling thread's arena.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+FrameArena &GetFrameArena()
+{
+    return gFrameArena;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "GlObjects.h"
+
+#include <memory>
+#include <vector>
+#include <stddef.h>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    A bump allocator for the CPU data that only lives for a frame (ex: a copy of the draw
+    commands that the CPU backend counts up, or anything else that a frame packs up before it
+    hands it to GL), so that the frame path doesn't allocate from the heap every frame.
+
+    There is one slot of memory per frame in flight.  BeginFrame() moves on to the next slot,
+    waits for the fence of the frame that last used it, and rewinds it; allocating is then an
+    aligned bump; EndFrame() fences the slot.  Nothing is freed on its own, and nothing needs
+    to be, since the whole slot is rewound at once.  A frame that needs more than its slot
+    has gets the rest from the heap, and the slot grows to the most that any frame has used
+    the next time it is rewound, so after a few frames the arena settles and a frame makes no
+    heap allocations at all (see GetHeapAllocationCount() in AllocationCounter.h).
+
+    Note: The fence isn't for the memory itself, which GL copies out of as it is called, but
+    for pointers into it that are handed on to work that finishes later (ex: a command list
+    that the next frame executes), which are good until the frame's fence is signaled.
+    Also Note: Only for the thread that owns the context.  Each thread with a context has its
+    own arena (see GetFrameArena()), like the memory ledger (see GpuMemoryLedger.h).
+    Allocate(...) gives 0 outside of a frame, so code that is also run without frames (ex:
+    the benchmarks) keeps a fallback of its own.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class FrameArena
+{
+public:
+    FrameArena();
+    void Init(size_t slotSizeBytes);
+    void Cleanup();
+
+    void BeginFrame();
+    void EndFrame();
+    bool IsInFrame() const;
+
+    void *Allocate(size_t sizeBytes, size_t alignment = 16);
+
+    // uninitialized, like the rest of the arena
+    template <typename ElementType>
+    ElementType *AllocateArray(size_t count)
+    {
+        return (ElementType *)this->Allocate(count * sizeof(ElementType),
+            alignof(ElementType));
+    }
+
+    size_t GetSlotSizeBytes() const;
+    size_t GetHighWaterBytes() const;
+    unsigned int GetOverflowCount() const;
+
+    // as many as the frame pacer allows (see FramePacer::MAX_FRAMES_IN_FLIGHT) less the one
+    // that the CPU is on
+    static const unsigned int SLOT_COUNT = 3;
+
+private:
+    // what one frame allocates from
+    // Note: The overflow blocks are only for the frame that outgrew the slot, and are given
+    // back when the slot is next rewound.
+    struct Slot
+    {
+        std::unique_ptr<unsigned char[]> _memory;
+        size_t _sizeBytes;
+        size_t _usedBytes;
+        std::vector<std::unique_ptr<unsigned char[]>> _overflowBlocks;
+        size_t _overflowBytes;
+        GlFence _fence;
+    };
+
+    void RewindSlot(Slot *slot);
+
+    Slot _slots[SLOT_COUNT];
+    unsigned int _currentSlot;
+    bool _isInFrame;
+    size_t _highWaterBytes;
+    unsigned int _overflowCount;
+};
+
+FrameArena &GetFrameArena();
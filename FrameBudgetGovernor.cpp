@@ -0,0 +1,209 @@
+#include "FrameBudgetGovernor.h"
+
+// the ladder of levels, from the demo as it was set up to the cheapest that the governor will
+// go, each a little cheaper than the last
+// Note: The level of detail is first because the drawn particles make up for the rest (see
+// ParticleLodSettings), so it is the hardest to see.  Fewer emitted particles and fewer
+// simulation steps change what the simulation does, so they are last.
+struct GovernorLevel
+{
+    float _emissionScale;
+    unsigned int _lodStride;
+    float _stepRateScale;
+    float _resolutionScale;
+};
+static const GovernorLevel GOVERNOR_LEVELS[] =
+{
+    { 1.00f, 1, 1.00f, 1.00f },
+    { 1.00f, 2, 1.00f, 1.00f },
+    { 1.00f, 2, 1.00f, 0.75f },
+    { 1.00f, 4, 1.00f, 0.50f },
+    { 0.50f, 4, 1.00f, 0.50f },
+    { 0.50f, 8, 0.75f, 0.50f },
+    { 0.25f, 8, 0.50f, 0.50f },
+};
+static const unsigned int GOVERNOR_LEVEL_COUNT =
+    sizeof(GOVERNOR_LEVELS) / sizeof(GOVERNOR_LEVELS[0]);
+
+// how much of each new frame's time goes into the smoothed time
+static const float SMOOTHING = 0.2f;
+
+// it turns down as soon as the budget is missed for a handful of frames in a row, but it only
+// turns back up after a second of frames that would have fit even with a fair bit more work
+static const unsigned int FRAMES_OVER_TO_TURN_DOWN = 6;
+static const unsigned int FRAMES_UNDER_TO_TURN_UP = 60;
+static const float TURN_UP_FRACTION = 0.7f;
+
+// the GPU profiler's results are a few frames late (see GpuProfiler.h), and the level of
+// detail takes a few more updates to show up in them
+static const unsigned int SETTLE_FRAMES = 10;
+
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.  Defaults to a 60Hz frame and a 120Hz simulation.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+FrameBudgetGovernor::FrameBudgetGovernor() :
+    _budgetMs(16.0f),
+    _baseStepsPerSecond(120),
+    _smoothedMs(0.0f),
+    _hasSample(false),
+    _level(0),
+    _overBudgetFrames(0),
+    _underBudgetFrames(0),
+    _settleFrames(0)
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets the budget and goes back to level 0.
+Parameters:
+    budgetMs            How much GPU time the update and the render may take together each
+                        frame.  Leave room for the rest of the frame (ex: 12ms of a 16.7ms
+                        frame at 60Hz).
+    baseStepsPerSecond  The simulation rate that the demo was set up with.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void FrameBudgetGovernor::Init(float budgetMs, unsigned int baseStepsPerSecond)
+{
+    _budgetMs = budgetMs;
+    _baseStepsPerSecond = baseStepsPerSecond;
+    _smoothedMs = 0.0f;
+    _hasSample = false;
+    _level = 0;
+    _overBudgetFrames = 0;
+    _underBudgetFrames = 0;
+    _settleFrames = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes a frame's GPU times and moves a level down or up if they have been over or under
+    the budget for long enough.  Call it once a frame.
+Parameters:
+    updateMs    The update's most recent GPU time.
+    renderMs    The render's most recent GPU time.  0 on frames that weren't drawn.
+Returns:
+    True if the level changed, in which case the caller should apply GetKnobs().
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool FrameBudgetGovernor::Update(float updateMs, float renderMs)
+{
+    float frameMs = updateMs + renderMs;
+    _smoothedMs = _hasSample ? (_smoothedMs + ((frameMs - _smoothedMs) * SMOOTHING)) : frameMs;
+    _hasSample = true;
+    if (_settleFrames > 0)
+    {
+        _settleFrames--;
+        return false;
+    }
+
+    _overBudgetFrames = (_smoothedMs > _budgetMs) ? (_overBudgetFrames + 1) : 0;
+    _underBudgetFrames = (_smoothedMs < (_budgetMs * TURN_UP_FRACTION)) ?
+        (_underBudgetFrames + 1) : 0;
+
+    unsigned int newLevel = _level;
+    if (_overBudgetFrames >= FRAMES_OVER_TO_TURN_DOWN && (_level + 1) < GOVERNOR_LEVEL_COUNT)
+    {
+        newLevel = _level + 1;
+    }
+    else if (_underBudgetFrames >= FRAMES_UNDER_TO_TURN_UP && _level > 0)
+    {
+        newLevel = _level - 1;
+    }
+    if (newLevel == _level)
+    {
+        return false;
+    }
+
+    _level = newLevel;
+    _overBudgetFrames = 0;
+    _underBudgetFrames = 0;
+    _settleFrames = SETTLE_FRAMES;
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    See Init(...).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+float FrameBudgetGovernor::GetBudgetMs() const
+{
+    return _budgetMs;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The smoothed update and render time that the governor compares with the budget.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+float FrameBudgetGovernor::GetSmoothedMs() const
+{
+    return _smoothedMs;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    0 is the demo as it was set up, and each level after it is cheaper.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int FrameBudgetGovernor::GetLevel() const
+{
+    return _level;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The number of levels, level 0 included.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int FrameBudgetGovernor::GetLevelCount() const
+{
+    return GOVERNOR_LEVEL_COUNT;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The knobs for the current level.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+FrameBudgetKnobs FrameBudgetGovernor::GetKnobs() const
+{
+    const GovernorLevel &level = GOVERNOR_LEVELS[_level];
+    FrameBudgetKnobs knobs;
+    knobs._emissionScale = level._emissionScale;
+    knobs._lodStride = level._lodStride;
+    knobs._stepsPerSecond = (unsigned int)((_baseStepsPerSecond * level._stepRateScale) + 0.5f);
+    knobs._stepsPerSecond = (knobs._stepsPerSecond > 0) ? knobs._stepsPerSecond : 1;
+    knobs._resolutionScale = level._resolutionScale;
+    return knobs;
+}
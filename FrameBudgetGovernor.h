@@ -0,0 +1,67 @@
+#pragma once
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The settings that the frame budget governor turns down when the GPU can't keep up (see
+    FrameBudgetGovernor).  Each one is relative to what the demo was set up with, so 1 (or
+    the full step rate) is no change.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+struct FrameBudgetKnobs
+{
+    // multiplies every emitter's _maxParticlesEmittedPerFrame
+    float _emissionScale;
+
+    // see ParticleManager::SetLevelOfDetail(...)
+    unsigned int _lodStride;
+
+    // the simulation clock's steps per second (see SimulationClock::SetStepSec(...)); fewer
+    // steps cover the same simulated time with less work
+    unsigned int _stepsPerSecond;
+
+    // see ScaledRenderTarget::SetScale(...) and DensitySplatRenderer::SetResolutionScale(...)
+    float _resolutionScale;
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Holds the frame rate by turning the simulation's and the draw's knobs down when the GPU's
+    recent update and render times add up to more than the frame's budget, and back up when
+    there is room again.  The knobs go down a fixed ladder of levels, cheapest loss first: the
+    level of detail, then the draw resolution, then the emission rate, then the simulation
+    rate.  Level 0 is the demo as it was set up.
+
+    Every frame's times are smoothed before they are compared with the budget, and a level
+    only changes after the times have been over (or well under) the budget for a while, with
+    a wider margin for going back up than for going down.  After a change, the governor waits
+    for the GPU profiler's results to catch up with it (they are a few frames late) before it
+    changes anything again.  Without all of that, a level that is right at the budget would
+    go up and down every few frames.
+
+    Note: This only decides.  Putting the knobs into effect is up to the caller (see
+    ApplyGovernorKnobs(...) in main.cpp), so it makes no GL calls.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class FrameBudgetGovernor
+{
+public:
+    FrameBudgetGovernor();
+    void Init(float budgetMs, unsigned int baseStepsPerSecond);
+    bool Update(float updateMs, float renderMs);
+
+    float GetBudgetMs() const;
+    float GetSmoothedMs() const;
+    unsigned int GetLevel() const;
+    unsigned int GetLevelCount() const;
+    FrameBudgetKnobs GetKnobs() const;
+
+private:
+    float _budgetMs;
+    unsigned int _baseStepsPerSecond;
+    float _smoothedMs;
+    bool _hasSample;
+    unsigned int _level;
+    unsigned int _overBudgetFrames;
+    unsigned int _underBudgetFrames;
+    unsigned int _settleFrames;
+};
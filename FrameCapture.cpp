@@ -0,0 +1,424 @@
+#include "FrameCapture.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
+#include "GlFenceSync.h"
+#include "Log.h"
+
+#ifdef WIN32
+// the CRT's names for these
+#define popen _popen
+#define pclose _pclose
+#else
+#include <signal.h>     // signal, SIGPIPE
+#endif
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.  Nothing is captured until Start(...).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+FrameCapture::FrameCapture() :
+    _width(0),
+    _height(0),
+    _isY4m(false),
+    _output(0),
+    _bufferId(0),
+    _mappedPixels(0),
+    _slotSizeBytes(0),
+    _capturedFrames(0),
+    _droppedFrames(0),
+    _isStopping(false)
+{
+    for (unsigned int slotIndex = 0; slotIndex < CAPTURE_SLOTS; slotIndex++)
+    {
+        _fences[slotIndex] = 0;
+        _slotStates[slotIndex] = CAPTURE_SLOT_FREE;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Stop() in the event that the user forgot to call it themselves.  The writer must be
+    joined before the std::thread is destroyed, or the program is terminated.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+FrameCapture::~FrameCapture()
+{
+    this->Stop();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Opens the output, makes the ring of pixel buffers, and starts the writer.
+Parameters:
+    width           The framebuffer's size in pixels.
+    height          Self-explanatory.
+    outputPath      ".y4m" is written directly, and anything else is encoded by ffmpeg.
+    framesPerSec    The video's frame rate.  Frames are captured as they are drawn, so this
+                    is what they are played back at and not how often they are taken.
+Returns:
+    False if the output couldn't be opened, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+bool FrameCapture::Start(int width, int height, const std::string &outputPath,
+    unsigned int framesPerSec)
+{
+    this->Stop();
+    if (width <= 0 || height <= 0 || framesPerSec == 0)
+    {
+        return false;
+    }
+
+    std::string extension = (outputPath.size() > 4) ? outputPath.substr(outputPath.size() - 4) : "";
+    _isY4m = (extension == ".y4m");
+    if (_isY4m)
+    {
+        _output = fopen(outputPath.c_str(), "wb");
+        if (_output != 0)
+        {
+            fprintf(_output, "YUV4MPEG2 W%d H%d F%u:1 Ip A1:1 C444\n", width, height,
+                framesPerSec);
+        }
+    }
+    else
+    {
+        // Note: OpenGL's rows start at the bottom, so ffmpeg flips them.
+        std::string command = "ffmpeg -y -loglevel error -f rawvideo -pix_fmt rgba -s " +
+            std::to_string(width) + "x" + std::to_string(height) + " -r " +
+            std::to_string(framesPerSec) + " -i - -vf vflip -pix_fmt yuv420p \"" + outputPath +
+            "\"";
+#ifndef WIN32
+        // if ffmpeg isn't there or quits, the writes fail instead of killing the program
+        signal(SIGPIPE, SIG_IGN);
+        _output = popen(command.c_str(), "w");
+#else
+        _output = popen(command.c_str(), "wb");
+#endif
+    }
+    if (_output == 0)
+    {
+        LogPrintf("frame capture: couldn't open '%s'\n", outputPath.c_str());
+        return false;
+    }
+
+    _width = width;
+    _height = height;
+    _slotSizeBytes = (size_t)width * height * 4;
+    _capturedFrames = 0;
+    _droppedFrames = 0;
+
+    // Note: Coherent, so once a slot's fence is signaled, the writer can read it with no
+    // barrier and no unmapping.
+    GLbitfield storageFlags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &_bufferId);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, _bufferId);
+    glBufferStorage(GL_PIXEL_PACK_BUFFER, _slotSizeBytes * CAPTURE_SLOTS, 0, storageFlags);
+    _mappedPixels = (unsigned char *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+        _slotSizeBytes * CAPTURE_SLOTS, storageFlags);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    _isStopping = false;
+    _writerThread = std::thread(&FrameCapture::WriterLoop, this);
+    LogPrintf("frame capture: %dx%d to '%s'\n", width, height, outputPath.c_str());
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Waits for the frames that were already read to be written, stops the writer, and closes
+    the output.  Safe to call more than once.
+
+    Note: This one waits on the GPU, since the frames in flight would otherwise be lost.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void FrameCapture::Stop()
+{
+    if (_output == 0)
+    {
+        return;
+    }
+
+    this->HandOffFinishedSlots(true);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _isStopping = true;
+    }
+    _condition.notify_all();
+    _writerThread.join();
+
+    if (_isY4m)
+    {
+        fclose(_output);
+    }
+    else
+    {
+        pclose(_output);
+    }
+    _output = 0;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, _bufferId);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    DeleteGlBuffers(1, &_bufferId);
+    _bufferId = 0;
+    _mappedPixels = 0;
+    for (unsigned int slotIndex = 0; slotIndex < CAPTURE_SLOTS; slotIndex++)
+    {
+        _slotStates[slotIndex] = CAPTURE_SLOT_FREE;
+    }
+    _readySlots.clear();
+
+    LogPrintf("frame capture: stopped after %u frames (%u dropped)\n", _capturedFrames,
+        _droppedFrames);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    True if Start(...) was called and Stop() hasn't been since, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+bool FrameCapture::IsCapturing() const
+{
+    return _output != 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The width of the frames that are being captured, in pixels.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+int FrameCapture::GetWidth() const
+{
+    return _width;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The height of the frames that are being captured, in pixels.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+int FrameCapture::GetHeight() const
+{
+    return _height;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Hands the finished frames to the writer and starts reading this one, from the bottom
+    left of the framebuffer that is bound for reading (the back buffer unless something else
+    was bound).  Call after the frame is drawn and before the swap.  Never waits.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void FrameCapture::CaptureFrame()
+{
+    if (_output == 0)
+    {
+        return;
+    }
+
+    this->HandOffFinishedSlots(false);
+
+    unsigned int freeSlot = CAPTURE_SLOTS;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (unsigned int slotIndex = 0; slotIndex < CAPTURE_SLOTS; slotIndex++)
+        {
+            if (_slotStates[slotIndex] == CAPTURE_SLOT_FREE)
+            {
+                freeSlot = slotIndex;
+                _slotStates[slotIndex] = CAPTURE_SLOT_READING;
+                break;
+            }
+        }
+    }
+    if (freeSlot == CAPTURE_SLOTS)
+    {
+        _droppedFrames++;
+        return;
+    }
+
+    // Note: The rows are tightly packed, which RGBA always is with the default alignment.
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, _bufferId);
+    glReadPixels(0, 0, _width, _height, GL_RGBA, GL_UNSIGNED_BYTE,
+        (void *)(freeSlot * _slotSizeBytes));
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    _fences[freeSlot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    _readingSlots.push_back(freeSlot);
+    _capturedFrames++;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The frames that were read since Start(...), whether or not they have been written yet.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int FrameCapture::GetCapturedFrameCount() const
+{
+    return _capturedFrames;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The frames that were skipped since Start(...) because there was no free slot.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int FrameCapture::GetDroppedFrameCount() const
+{
+    return _droppedFrames;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Passes the slots whose reads are done to the writer, oldest first, so that the frames stay
+    in order.  Stops at the first one that isn't done.
+Parameters:
+    waitForGpu  If true, waits for every slot instead of stopping.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void FrameCapture::HandOffFinishedSlots(bool waitForGpu)
+{
+    bool handedOff = false;
+    while (!_readingSlots.empty())
+    {
+        unsigned int slotIndex = _readingSlots.front();
+        GLsync slotFence = (GLsync)_fences[slotIndex];
+        if (!waitForGpu && !IsGlFenceSignaled(slotFence))
+        {
+            break;
+        }
+        WaitForGlFence(slotFence, GL_FENCE_WAIT_FOREVER, "frame capture readback");
+
+        glDeleteSync(slotFence);
+        _fences[slotIndex] = 0;
+        _readingSlots.pop_front();
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _slotStates[slotIndex] = CAPTURE_SLOT_WRITING;
+            _readySlots.push_back(slotIndex);
+        }
+        handedOff = true;
+    }
+    if (handedOff)
+    {
+        _condition.notify_all();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The writer thread.  Writes the ready slots in order until it is told to stop, and after
+    that, until there are none left.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void FrameCapture::WriterLoop()
+{
+    while (true)
+    {
+        unsigned int slotIndex = 0;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _condition.wait(lock, [this]() { return _isStopping || !_readySlots.empty(); });
+            if (_readySlots.empty())
+            {
+                // stopping, and everything has been written
+                return;
+            }
+            slotIndex = _readySlots.front();
+            _readySlots.pop_front();
+        }
+
+        this->WriteFrame(_mappedPixels + (slotIndex * _slotSizeBytes));
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _slotStates[slotIndex] = CAPTURE_SLOT_FREE;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Writes one frame to the output.  For Y4M, the pixels are flipped to top-down and
+    converted to BT.601 studio-range YUV, one whole plane after another.
+
+    Note: Runs on the writer thread.
+Parameters:
+    rgbaPixels  The frame as read, bottom row first.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void FrameCapture::WriteFrame(const unsigned char *rgbaPixels)
+{
+    if (!_isY4m)
+    {
+        fwrite(rgbaPixels, 1, _slotSizeBytes, _output);
+        return;
+    }
+
+    size_t planeSize = (size_t)_width * _height;
+    if (!_yuvPlanes.Allocate(planeSize * 3))
+    {
+        return;
+    }
+    unsigned char *yPlane = _yuvPlanes.GetData();
+    unsigned char *uPlane = yPlane + planeSize;
+    unsigned char *vPlane = uPlane + planeSize;
+    for (int y = 0; y < _height; y++)
+    {
+        const unsigned char *sourceRow = rgbaPixels + ((size_t)(_height - 1 - y) * _width * 4);
+        size_t destRow = (size_t)y * _width;
+        for (int x = 0; x < _width; x++)
+        {
+            int r = sourceRow[(x * 4) + 0];
+            int g = sourceRow[(x * 4) + 1];
+            int b = sourceRow[(x * 4) + 2];
+            int luma = 16 + (((66 * r) + (129 * g) + (25 * b) + 128) >> 8);
+            int blueDiff = 128 + (((-38 * r) - (74 * g) + (112 * b) + 128) >> 8);
+            int redDiff = 128 + (((112 * r) - (94 * g) - (18 * b) + 128) >> 8);
+            yPlane[destRow + x] = (unsigned char)luma;
+            uPlane[destRow + x] = (unsigned char)blueDiff;
+            vPlane[destRow + x] = (unsigned char)redDiff;
+        }
+    }
+
+    fputs("FRAME\n", _output);
+    fwrite(_yuvPlanes.GetData(), 1, _yuvPlanes.GetSizeBytes(), _output);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "LargeHostBuffer.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdio.h>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Records the frames that are drawn to a video without holding up the render thread.
+
+    Every captured frame is read into one of a ring of pixel pack buffers with glReadPixels(...)
+    (which only queues a copy on the GPU) and fenced.  A few frames later, once its fence has
+    been signaled, the slot is handed to a writer thread that converts and writes it out,
+    straight from the persistently mapped buffer, and gives the slot back when it's done.  If
+    there is no free slot when a frame comes along (the GPU or the writer has fallen behind),
+    the frame is dropped and counted rather than waited on.
+
+    The output is picked by the file name: ".y4m" is written directly as a YUV4MPEG2 stream
+    (4:4:4, so nothing is lost to chroma subsampling), and anything else is piped to ffmpeg's
+    stdin as raw RGBA for it to encode, so ffmpeg must be on the path.
+
+    Note: The size is fixed when the capture starts.  Call Stop() and Start(...) again if the
+    window is resized.
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+class FrameCapture
+{
+public:
+    FrameCapture();
+    ~FrameCapture();
+    bool Start(int width, int height, const std::string &outputPath, unsigned int framesPerSec);
+    void Stop();
+
+    bool IsCapturing() const;
+    int GetWidth() const;
+    int GetHeight() const;
+    void CaptureFrame();
+    unsigned int GetCapturedFrameCount() const;
+    unsigned int GetDroppedFrameCount() const;
+
+private:
+    enum SlotState
+    {
+        CAPTURE_SLOT_FREE = 0,
+        CAPTURE_SLOT_READING,       // waiting on the GPU
+        CAPTURE_SLOT_WRITING,       // with the writer thread
+    };
+
+    void HandOffFinishedSlots(bool waitForGpu);
+    void WriterLoop();
+    void WriteFrame(const unsigned char *rgbaPixels);
+
+    // 3 frames of GPU latency, plus 1 for the writer; a 1080p frame is 8MB, so this is about
+    // 32MB at that size
+    static const unsigned int CAPTURE_SLOTS = 4;
+
+    int _width;
+    int _height;
+    bool _isY4m;
+    FILE *_output;
+    unsigned int _bufferId;
+    unsigned char *_mappedPixels;
+    size_t _slotSizeBytes;
+    void *_fences[CAPTURE_SLOTS];
+
+    // the slots that are reading, in the order that they were read into
+    std::deque<unsigned int> _readingSlots;
+    unsigned int _capturedFrames;
+    unsigned int _droppedFrames;
+
+    // the writer takes slots off of the ready queue, and gives them back by setting them free
+    // Note: The render thread only changes a slot from free to reading and from reading to
+    // writing, and the writer only changes it from writing to free.
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::thread _writerThread;
+    std::deque<unsigned int> _readySlots;
+    SlotState _slotStates[CAPTURE_SLOTS];
+    bool _isStopping;
+
+    // only the writer touches this
+    LargeHostBuffer _yuvPlanes;
+};
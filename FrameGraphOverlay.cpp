@@ -0,0 +1,254 @@
+#include "FrameGraphOverlay.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
+#include "ShaderProgramRegistry.h"
+#include "ViewParameters.h"
+
+// the graph's rectangle in window coordinates
+static const float GRAPH_LEFT = -0.95f;
+static const float GRAPH_RIGHT = -0.25f;
+static const float GRAPH_BOTTOM = -0.95f;
+static const float GRAPH_TOP = -0.55f;
+
+// a horizontal line is drawn at this frame time (60 frames per second) for reference
+static const float FRAME_BUDGET_MS = 1000.0f / 60.0f;
+
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-14-2016)
+-----------------------------------------------------------------------------------------------*/
+FrameGraphOverlay::FrameGraphOverlay() :
+    _programId(0),
+    _vaoId(0),
+    _vertexBufferId(0),
+    _viewBufferId(0),
+    _unifLocExtrapolationSec(0),
+    _unifLocColorMode(0),
+    _graphMaxMs(1.0f),
+    _nextSample(0),
+    _sampleCount(0)
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-14-2016)
+-----------------------------------------------------------------------------------------------*/
+FrameGraphOverlay::~FrameGraphOverlay()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Creates the vertex buffer and VAO for the graph.
+Parameters:
+    programId   A program built from shaderParticle.vert and shaderParticle.frag by the 
+                program registry.  This object takes its own reference and releases it in 
+                Cleanup(), so it can be the same program that the particle manager uses.
+    numFrames   How many frames the graph shows.
+    graphMaxMs  The frame time at the top of the graph.  Longer frames are clamped.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-14-2016)
+-----------------------------------------------------------------------------------------------*/
+void FrameGraphOverlay::Init(unsigned int programId, unsigned int numFrames, float graphMaxMs)
+{
+    this->Cleanup();
+
+    _programId = programId;
+    AddProgramReference(_programId);
+    _graphMaxMs = graphMaxMs;
+    _samplesMs.assign(numFrames, 0.0f);
+    _nextSample = 0;
+    _sampleCount = 0;
+    _points.resize(numFrames + 2);
+    _unifLocExtrapolationSec = glGetUniformLocation(_programId, "uExtrapolationSec");
+    _unifLocColorMode = glGetUniformLocation(_programId, "uColorMode");
+
+    glGenVertexArrays(1, &_vaoId);
+    BindGlVertexArray(_vaoId);
+
+    glGenBuffers(1, &_vertexBufferId);
+    glBindBuffer(GL_ARRAY_BUFFER, _vertexBufferId);
+    glBufferData(GL_ARRAY_BUFFER, _points.size() * sizeof(glm::vec2), 0, GL_STREAM_DRAW);
+
+    // position only; velocity and "is active" use their current (not array) values
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void *)0);
+
+    BindGlVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // window space straight through, and nothing to cull
+    ViewParameters view = {};
+    view._viewProjection = glm::mat4(1.0f);
+    glGenBuffers(1, &_viewBufferId);
+    glBindBuffer(GL_UNIFORM_BUFFER, _viewBufferId);
+    glBufferStorage(GL_UNIFORM_BUFFER, sizeof(view), &view, 0);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Releases the program and deletes the vertex buffer and VAO.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-14-2016)
+-----------------------------------------------------------------------------------------------*/
+void FrameGraphOverlay::Cleanup()
+{
+    if (_programId != 0)
+    {
+        ReleaseProgram(_programId);
+        _programId = 0;
+    }
+    if (_vaoId != 0)
+    {
+        DeleteGlVertexArrays(1, &_vaoId);
+        _vaoId = 0;
+    }
+    if (_vertexBufferId != 0)
+    {
+        DeleteGlBuffers(1, &_vertexBufferId);
+        _vertexBufferId = 0;
+    }
+    if (_viewBufferId != 0)
+    {
+        DeleteGlBuffers(1, &_viewBufferId);
+        _viewBufferId = 0;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Switches to a rebuilt program (see ParticleManager::ReplaceProgram(...)).
+Parameters:
+    oldProgramId    Self-explanatory.  Any other program is ignored.
+    newProgramId    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void FrameGraphOverlay::ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId)
+{
+    if (oldProgramId == 0 || newProgramId == 0 || _programId != oldProgramId)
+    {
+        return;
+    }
+
+    AddProgramReference(newProgramId);
+    ReleaseProgram(_programId);
+    _programId = newProgramId;
+    _unifLocExtrapolationSec = glGetUniformLocation(_programId, "uExtrapolationSec");
+    _unifLocColorMode = glGetUniformLocation(_programId, "uColorMode");
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Adds a frame time to the graph, replacing the oldest one once the graph is full.
+Parameters:
+    frameMs     Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-14-2016)
+-----------------------------------------------------------------------------------------------*/
+void FrameGraphOverlay::AddSample(float frameMs)
+{
+    if (_samplesMs.empty())
+    {
+        return;
+    }
+
+    _samplesMs[_nextSample] = frameMs;
+    _nextSample = (_nextSample + 1) % _samplesMs.size();
+    if (_sampleCount < _samplesMs.size())
+    {
+        _sampleCount++;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Uploads the graph's points and draws them as a line strip, then draws the frame budget
+    line.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-14-2016)
+-----------------------------------------------------------------------------------------------*/
+void FrameGraphOverlay::Render()
+{
+    if (_vaoId == 0 || _sampleCount < 2)
+    {
+        return;
+    }
+
+    // oldest first, left to right
+    unsigned int numFrames = _samplesMs.size();
+    unsigned int oldestSample = (_nextSample + numFrames - _sampleCount) % numFrames;
+    float xStep = (GRAPH_RIGHT - GRAPH_LEFT) / (numFrames - 1);
+    float yScale = (GRAPH_TOP - GRAPH_BOTTOM) / _graphMaxMs;
+    for (unsigned int pointIndex = 0; pointIndex < _sampleCount; pointIndex++)
+    {
+        float frameMs = _samplesMs[(oldestSample + pointIndex) % numFrames];
+        if (frameMs > _graphMaxMs)
+        {
+            frameMs = _graphMaxMs;
+        }
+        _points[pointIndex] = glm::vec2(GRAPH_LEFT + (pointIndex * xStep),
+            GRAPH_BOTTOM + (frameMs * yScale));
+    }
+
+    float budgetY = GRAPH_BOTTOM + (FRAME_BUDGET_MS * yScale);
+    if (budgetY > GRAPH_TOP)
+    {
+        budgetY = GRAPH_TOP;
+    }
+    _points[_sampleCount] = glm::vec2(GRAPH_LEFT, budgetY);
+    _points[_sampleCount + 1] = glm::vec2(GRAPH_RIGHT, budgetY);
+
+    glBindBuffer(GL_ARRAY_BUFFER, _vertexBufferId);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, (_sampleCount + 2) * sizeof(glm::vec2), _points.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    UseGlProgram(_programId);
+    glUniform1f(_unifLocExtrapolationSec, 0.0f);
+
+    // the particle manager may have left the program on its speed palette, and the graph's 
+    // points have no velocity anyway
+    glUniform1i(_unifLocColorMode, 0);
+
+    // the vertex shader hides inactive vertices, so make every point "active"
+    // Note: This is the current value of a generic attribute, not VAO state, but the particle
+    // VAO always has this attribute enabled, so it never sees this value.
+    glVertexAttribI1i(2, 1);
+    glVertexAttrib2f(1, 0.0f, 0.0f);
+
+    // no draw group scaling either (see drawGroupStyle in shaderParticle.vert)
+    glVertexAttrib2f(3, 1.0f, 1.0f);
+
+    // the camera's view goes back afterwards so that anything that runs before the particle 
+    // manager's next update or draw (ex: the density splat) still sees it
+    GLint cameraViewBufferId = 0;
+    glGetIntegeri_v(GL_UNIFORM_BUFFER_BINDING, VIEW_PARAMETERS_BINDING, &cameraViewBufferId);
+    glBindBufferBase(GL_UNIFORM_BUFFER, VIEW_PARAMETERS_BINDING, _viewBufferId);
+
+    BindGlVertexArray(_vaoId);
+    glDrawArrays(GL_LINE_STRIP, 0, _sampleCount);
+    glDrawArrays(GL_LINES, _sampleCount, 2);
+    BindGlVertexArray(0);
+    UseGlProgram(0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, VIEW_PARAMETERS_BINDING, (GLuint)cameraViewBufferId);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "glm/vec2.hpp"
+
+#include <vector>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Draws a line graph of the last N frame times in the bottom-left corner of the window so
+    that hitches are visible while the demo runs.
+
+    It uses the particle render program as-is: every point of the graph is a vertex with a
+    position in attribute 0 and no velocity.  The "is active" attribute is left disabled and
+    its current value is set to 1 when drawing, so the vertex shader passes the points right
+    through.  The graph is drawn through an identity view of its own, so it stays in the corner
+    however the camera moves (see ViewParameters.h).
+
+    Note: The samples are copied into the vertex buffer oldest first every frame.  That's a
+    few kilobytes, so it isn't worth anything fancier.
+Creator:    John Cox (8-14-2016)
+-----------------------------------------------------------------------------------------------*/
+class FrameGraphOverlay
+{
+public:
+    FrameGraphOverlay();
+    ~FrameGraphOverlay();
+    void Init(unsigned int programId, unsigned int numFrames, float graphMaxMs);
+    void Cleanup();
+    void ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId);
+
+    void AddSample(float frameMs);
+    void Render();
+
+private:
+    unsigned int _programId;
+    unsigned int _vaoId;
+    unsigned int _vertexBufferId;
+    unsigned int _viewBufferId;
+    unsigned int _unifLocExtrapolationSec;
+    unsigned int _unifLocColorMode;
+    float _graphMaxMs;
+
+    // a ring of the most recent frame times
+    std::vector<float> _samplesMs;
+    unsigned int _nextSample;
+    unsigned int _sampleCount;
+
+    // the graph's points plus the 2 points of the budget line
+    std::vector<glm::vec2> _points;
+};
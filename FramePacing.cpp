@@ -0,0 +1,564 @@
+#include "FramePacing.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlFenceSync.h"
+#include "Log.h"
+
+// the swap interval is set through the window system, not OpenGL, so its extensions are loaded
+// separately (see SetSwapInterval(...))
+#ifdef WIN32
+#include "glload/include/glload/wgl_all.h"
+#include "glload/include/glload/wgl_load.h"
+
+// timeBeginPeriod(...) (see FrameRateLimiter)
+#include <mmsystem.h>
+#pragma comment(lib, "winmm.lib")
+#else
+// Build note: Newer GL/glx.h headers include their own glxext.h unless told not to, and it 
+// clashes with glload's.
+#define GLX_GLXEXT_LEGACY
+#include "glload/include/glload/glx_all.h"
+#include "glload/include/glload/glx_load.h"
+#endif
+
+#include <chrono>
+#include <thread>
+
+const float FrameRateLimiter::SLEEP_MARGIN_MS = 2.0f;
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Loads the window system's extensions for the current context, once.
+Parameters: None
+Returns:
+    False if the loader didn't load anything, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+static bool LoadWindowSystemExtensions()
+{
+    static bool isLoaded = false;
+    static bool isLoadGood = false;
+    if (!isLoaded)
+    {
+        isLoaded = true;
+#ifdef WIN32
+        isLoadGood = (wgl_LoadFunctions(wglGetCurrentDC()) != wgl_LOAD_FAILED);
+#else
+        Display *display = glXGetCurrentDisplay();
+        isLoadGood = (display != 0) &&
+            (glx_LoadFunctions(display, DefaultScreen(display)) != glx_LOAD_FAILED);
+#endif
+    }
+    return isLoadGood;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets how the current context's buffer swaps wait for the display, through
+    wglSwapIntervalEXT(...) or glXSwapIntervalEXT(...).  Adaptive vsync is a negative interval,
+    which needs the "swap control tear" extension; without it, this falls back to plain vsync.
+
+    Note: Must be called with the window's context current.  Some drivers let the control
+    panel override this, and the driver default isn't set at all, so it only lasts until the
+    window is made again.
+Parameters:
+    mode    Self-explanatory.
+Returns:
+    False if the window system can't set the swap interval, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+bool SetSwapInterval(SwapIntervalMode mode)
+{
+    if (mode == SWAP_INTERVAL_DRIVER_DEFAULT)
+    {
+        return true;
+    }
+    if (!LoadWindowSystemExtensions())
+    {
+        LogPrintf("swap interval: couldn't load the window system's extensions\n");
+        return false;
+    }
+
+    int interval = (mode == SWAP_INTERVAL_IMMEDIATE) ? 0 : 1;
+#ifdef WIN32
+    bool hasSwapControl = (wglext_EXT_swap_control != 0);
+    bool hasSwapControlTear = (wglext_EXT_swap_control_tear != 0);
+#else
+    bool hasSwapControl = (glXext_EXT_swap_control != 0);
+    bool hasSwapControlTear = (glXext_EXT_swap_control_tear != 0);
+#endif
+    if (mode == SWAP_INTERVAL_ADAPTIVE)
+    {
+        if (hasSwapControlTear)
+        {
+            interval = -1;
+        }
+        else
+        {
+            LogPrintf("swap interval: no adaptive vsync; using vsync\n");
+        }
+    }
+
+#ifdef WIN32
+    if (!hasSwapControl)
+    {
+        LogPrintf("swap interval: WGL_EXT_swap_control isn't supported\n");
+        return false;
+    }
+    return wglSwapIntervalEXT(interval) != FALSE;
+#else
+    if (hasSwapControl)
+    {
+        glXSwapIntervalEXT(glXGetCurrentDisplay(), glXGetCurrentDrawable(), interval);
+        return true;
+    }
+
+    // Note: The older SGI extension can't turn vsync off (0 is an error).
+    if (glXext_SGI_swap_control != 0 && interval != 0)
+    {
+        return glXSwapIntervalSGI(1) == 0;
+    }
+    LogPrintf("swap interval: GLX_EXT_swap_control isn't supported\n");
+    return false;
+#endif
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    mode    Self-explanatory.
+Returns:
+    A short name to print.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+const char *GetSwapIntervalModeName(SwapIntervalMode mode)
+{
+    switch (mode)
+    {
+    case SWAP_INTERVAL_DRIVER_DEFAULT: return "driver default";
+    case SWAP_INTERVAL_IMMEDIATE: return "immediate";
+    case SWAP_INTERVAL_VSYNC: return "vsync";
+    case SWAP_INTERVAL_ADAPTIVE: return "adaptive vsync";
+    default:
+        return "unknown";
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.  The steady clock instead of the high resolution one, which may be the
+    wall clock and jump.
+Parameters: None
+Returns:
+    Milliseconds since some fixed point, the same for every thread.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+double GetPacingClockMs()
+{
+    return std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.  There is no cap until Init(...).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+FramePacer::FramePacer() :
+    _oldestFence(0),
+    _fenceCount(0),
+    _maxFramesInFlight(0),
+    _lastWaitMs(0.0f),
+    _lastInputLatencyMs(0.0f)
+{
+    for (unsigned int fenceIndex = 0; fenceIndex < MAX_FRAMES_IN_FLIGHT; fenceIndex++)
+    {
+        _fences[fenceIndex] = 0;
+        _fenceInputTimesMs[fenceIndex] = 0.0;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+FramePacer::~FramePacer()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    maxFramesInFlight   See SetMaxFramesInFlight(...).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void FramePacer::Init(unsigned int maxFramesInFlight)
+{
+    this->Cleanup();
+    this->SetMaxFramesInFlight(maxFramesInFlight);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Deletes the fences.  Safe to call more than once.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void FramePacer::Cleanup()
+{
+    this->DeleteFences();
+    _maxFramesInFlight = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Changes the cap.  Can be changed at any time; the fences for the frames that are already
+    in flight are kept, so lowering the cap waits for them at the next frame.
+Parameters:
+    maxFramesInFlight   0 is no cap.  More than MAX_FRAMES_IN_FLIGHT is MAX_FRAMES_IN_FLIGHT.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void FramePacer::SetMaxFramesInFlight(unsigned int maxFramesInFlight)
+{
+    if (maxFramesInFlight > MAX_FRAMES_IN_FLIGHT)
+    {
+        maxFramesInFlight = MAX_FRAMES_IN_FLIGHT;
+    }
+    _maxFramesInFlight = maxFramesInFlight;
+    if (_maxFramesInFlight == 0)
+    {
+        this->DeleteFences();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The cap, or 0 for none.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int FramePacer::GetMaxFramesInFlight() const
+{
+    return _maxFramesInFlight;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Waits until the GPU is far enough along that another frame can start without going over
+    the cap.  Call at the very start of the frame.  The frames that are already done are
+    checked off first, without waiting, for their input's latency.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void FramePacer::WaitForFrameSlot()
+{
+    _lastWaitMs = 0.0f;
+    _lastInputLatencyMs = 0.0f;
+    while (_fenceCount > 0)
+    {
+        if (!IsGlFenceSignaled(_fences[_oldestFence]))
+        {
+            break;
+        }
+        this->RetireOldestFence();
+    }
+    if (_maxFramesInFlight == 0 || _fenceCount < _maxFramesInFlight)
+    {
+        return;
+    }
+
+    std::chrono::high_resolution_clock::time_point waitStart =
+        std::chrono::high_resolution_clock::now();
+    while (_fenceCount >= _maxFramesInFlight)
+    {
+        // the CPU is as far ahead as it is allowed to be, so this is meant to block, but it is
+        // still a stall, and it shows up in the stall stats with the rest
+        WaitForGlFence(_fences[_oldestFence], GL_FENCE_WAIT_FOREVER, "frame pacing");
+        this->RetireOldestFence();
+    }
+    _lastWaitMs = std::chrono::duration<float, std::milli>(
+        std::chrono::high_resolution_clock::now() - waitStart).count();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Fences off the frame.  Call right after the buffer swap, so that the fence is signaled
+    when the GPU has finished the whole frame.
+Parameters:
+    inputTimeMs     When the newest input that the frame used happened, on
+                    GetPacingClockMs()'s clock, or 0 if it didn't use any new input.  A frame
+                    with input is fenced off even without a cap, to measure its latency.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void FramePacer::EndFrame(double inputTimeMs)
+{
+    if (_maxFramesInFlight == 0 && inputTimeMs <= 0.0)
+    {
+        return;
+    }
+
+    // WaitForFrameSlot() keeps the ring from filling up with the cap in place, but the cap
+    // could have been lowered in between
+    if (_fenceCount == MAX_FRAMES_IN_FLIGHT)
+    {
+        glDeleteSync((GLsync)_fences[_oldestFence]);
+        _fences[_oldestFence] = 0;
+        _oldestFence = (_oldestFence + 1) % MAX_FRAMES_IN_FLIGHT;
+        _fenceCount--;
+    }
+    unsigned int newestFence = (_oldestFence + _fenceCount) % MAX_FRAMES_IN_FLIGHT;
+    _fences[newestFence] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    _fenceInputTimesMs[newestFence] = inputTimeMs;
+    _fenceCount++;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How many milliseconds the last WaitForFrameSlot() waited for the GPU.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+float FramePacer::GetLastWaitMs() const
+{
+    return _lastWaitMs;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How many milliseconds it was from the newest input to its frame being done on the GPU, for
+    the frames that the last WaitForFrameSlot() saw finish, or 0 if none of them had input.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+float FramePacer::GetLastInputLatencyMs() const
+{
+    return _lastInputLatencyMs;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Deletes the oldest fence, whose frame is done, and measures its input's latency if it had
+    any.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void FramePacer::RetireOldestFence()
+{
+    glDeleteSync((GLsync)_fences[_oldestFence]);
+    if (_fenceInputTimesMs[_oldestFence] > 0.0)
+    {
+        _lastInputLatencyMs = (float)(GetPacingClockMs() - _fenceInputTimesMs[_oldestFence]);
+    }
+    _fences[_oldestFence] = 0;
+    _fenceInputTimesMs[_oldestFence] = 0.0;
+    _oldestFence = (_oldestFence + 1) % MAX_FRAMES_IN_FLIGHT;
+    _fenceCount--;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void FramePacer::DeleteFences()
+{
+    for (unsigned int fenceIndex = 0; fenceIndex < MAX_FRAMES_IN_FLIGHT; fenceIndex++)
+    {
+        if (_fences[fenceIndex] != 0)
+        {
+            glDeleteSync((GLsync)_fences[fenceIndex]);
+            _fences[fenceIndex] = 0;
+        }
+        _fenceInputTimesMs[fenceIndex] = 0.0;
+    }
+    _oldestFence = 0;
+    _fenceCount = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.  There is no cap until Init(...).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+FrameRateLimiter::FrameRateLimiter() :
+    _activePeriodMs(0.0f),
+    _idlePeriodMs(0.0f),
+    _nextDeadlineMs(0.0),
+    _lastSleepMs(0.0f),
+    _hasRaisedTimerResolution(false)
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+FrameRateLimiter::~FrameRateLimiter()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets the rates and, on Windows, raises the timer's resolution.
+Parameters:
+    activeFps   The cap while the window can be seen.  0 is no cap.
+    idleFps     The cap while it can't.  0 is the same as the active cap.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void FrameRateLimiter::Init(float activeFps, float idleFps)
+{
+    this->Cleanup();
+    _activePeriodMs = (activeFps > 0.0f) ? (1000.0f / activeFps) : 0.0f;
+    _idlePeriodMs = (idleFps > 0.0f) ? (1000.0f / idleFps) : _activePeriodMs;
+#ifdef WIN32
+    if (_activePeriodMs > 0.0f || _idlePeriodMs > 0.0f)
+    {
+        _hasRaisedTimerResolution = (timeBeginPeriod(1) == TIMERR_NOERROR);
+    }
+#endif
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Removes the cap and puts the timer's resolution back.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void FrameRateLimiter::Cleanup()
+{
+#ifdef WIN32
+    if (_hasRaisedTimerResolution)
+    {
+        timeEndPeriod(1);
+    }
+#endif
+    _hasRaisedTimerResolution = false;
+    _activePeriodMs = 0.0f;
+    _idlePeriodMs = 0.0f;
+    _nextDeadlineMs = 0.0;
+    _lastSleepMs = 0.0f;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    True if either rate is capped.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool FrameRateLimiter::IsEnabled() const
+{
+    return _activePeriodMs > 0.0f || _idlePeriodMs > 0.0f;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sleeps until this frame's deadline and sets the next one.  Call once per frame, at the
+    start of the frame, so that the frame's input and animation are from after the sleep.
+Parameters:
+    isIdle  True to use the idle rate.  A switch to the faster rate takes effect on this
+            frame, so the first frame after the window is seen again isn't held back by
+            the idle rate's deadline.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void FrameRateLimiter::WaitForNextFrame(bool isIdle)
+{
+    float periodMs = isIdle ? _idlePeriodMs : _activePeriodMs;
+    _lastSleepMs = 0.0f;
+    if (periodMs <= 0.0f)
+    {
+        _nextDeadlineMs = 0.0;
+        return;
+    }
+
+    double nowMs = GetPacingClockMs();
+    if (_nextDeadlineMs == 0.0 || nowMs - _nextDeadlineMs > periodMs)
+    {
+        _nextDeadlineMs = nowMs;
+    }
+    else if (_nextDeadlineMs - nowMs > periodMs)
+    {
+        _nextDeadlineMs = nowMs + periodMs;
+    }
+
+    double remainingMs = _nextDeadlineMs - nowMs;
+    if (remainingMs > SLEEP_MARGIN_MS)
+    {
+        std::this_thread::sleep_for(
+            std::chrono::duration<double, std::milli>(remainingMs - SLEEP_MARGIN_MS));
+    }
+    while (GetPacingClockMs() < _nextDeadlineMs)
+    {
+        std::this_thread::yield();
+    }
+    _lastSleepMs = (float)(GetPacingClockMs() - nowMs);
+    _nextDeadlineMs += periodMs;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How long the last WaitForNextFrame(...) slept and yielded, in milliseconds.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+float FrameRateLimiter::GetLastSleepMs() const
+{
+    return _lastSleepMs;
+}
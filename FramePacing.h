@@ -0,0 +1,122 @@
+#pragma once
+
+// how the buffer swap lines up with the display's refresh (see SetSwapInterval(...))
+enum SwapIntervalMode
+{
+    SWAP_INTERVAL_DRIVER_DEFAULT = 0,   // whatever the driver's control panel says
+    SWAP_INTERVAL_IMMEDIATE,            // swap as soon as the frame is done, and maybe tear
+    SWAP_INTERVAL_VSYNC,                // wait for the next refresh
+    SWAP_INTERVAL_ADAPTIVE,             // vsync, but swap right away if the refresh was missed
+    SWAP_INTERVAL_MODE_COUNT,
+};
+
+bool SetSwapInterval(SwapIntervalMode mode);
+const char *GetSwapIntervalModeName(SwapIntervalMode mode);
+
+// a steady clock for stamping input (see FramePacer::EndFrame(...)), in milliseconds from an 
+// arbitrary start
+double GetPacingClockMs();
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Caps how many frames the CPU can get ahead of the GPU.  Drivers queue up to a few frames
+    of commands (3 is common) before they block the swap, and every frame of queue is a frame
+    between reading the keyboard and seeing the result.  With a cap, a fence is put in after
+    every swap, and the next frame doesn't start until there are fewer than the cap's worth of
+    frames that the GPU hasn't finished.
+
+    A cap of 1 is the lowest latency: the CPU starts a frame after the GPU is done with the
+    last one, so they don't overlap at all.  2 gives back most of the overlap for one frame of
+    latency.  0 is no cap, which leaves it to the driver and is the most throughput.
+
+    Note: The wait is at the start of the frame, not after the swap, so the frame's input and
+    animation are from as late as possible.
+
+    The same fences measure the input's latency: a frame that used new input is fenced off
+    with the time of that input, even without a cap, and when the fence is seen to be done,
+    the input-to-GPU-done time is GetLastInputLatencyMs().  The display still has to scan the
+    frame out after that (up to another refresh with vsync), so the light comes a little
+    later, but everything that this program controls is in it.
+    Also Note: The fences are only checked at the start of each frame, so a latency can be up
+    to a frame long.  With a cap of 1, the wait catches the fence as it is signaled.
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+class FramePacer
+{
+public:
+    FramePacer();
+    ~FramePacer();
+    void Init(unsigned int maxFramesInFlight);
+    void Cleanup();
+
+    void SetMaxFramesInFlight(unsigned int maxFramesInFlight);
+    unsigned int GetMaxFramesInFlight() const;
+    void WaitForFrameSlot();
+    void EndFrame(double inputTimeMs = 0.0);
+    float GetLastWaitMs() const;
+    float GetLastInputLatencyMs() const;
+
+    // more than this is no different from leaving it to the driver
+    static const unsigned int MAX_FRAMES_IN_FLIGHT = 4;
+
+private:
+    void RetireOldestFence();
+    void DeleteFences();
+
+    // a ring of the fences after the swaps that the GPU may not be done with, oldest first
+    // Note: GLsync is a pointer, so these are stored as void * to keep OpenGL out of the
+    // header.
+    void *_fences[MAX_FRAMES_IN_FLIGHT];
+
+    // the time of the input that each fenced frame used, or 0 if it didn't have any new input
+    double _fenceInputTimesMs[MAX_FRAMES_IN_FLIGHT];
+    unsigned int _oldestFence;
+    unsigned int _fenceCount;
+    unsigned int _maxFramesInFlight;
+    float _lastWaitMs;
+    float _lastInputLatencyMs;
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Caps the frame rate by sleeping until each frame's deadline, for machines where the power
+    and the heat matter more than the frame rate (ex: a kiosk that runs all day).  Vsync
+    also caps it, but only at the display's rate, and the driver often spins in the swap
+    while it waits.  This sleeps the thread instead, so the CPU idles between frames.
+
+    There are 2 rates: the active one, and a much lower idle one for when nothing can see the
+    frames (see AppWindow::IsVisible()).  The deadlines are a fixed period apart, not a
+    period after each frame ends, so the rate doesn't drift down by the frame's own time.  A
+    frame that is more than a period late starts the deadlines over from now instead of
+    rushing the next frames to catch up.
+
+    Note: The OS wakes a sleeping thread late by up to its timer's resolution, so this
+    sleeps until SLEEP_MARGIN_MS before the deadline and yields for the rest.  On Windows,
+    the timer's resolution is raised to 1ms between Init(...) and Cleanup(), since its
+    default of 15.6ms is longer than a frame.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class FrameRateLimiter
+{
+public:
+    FrameRateLimiter();
+    ~FrameRateLimiter();
+    void Init(float activeFps, float idleFps);
+    void Cleanup();
+
+    bool IsEnabled() const;
+    void WaitForNextFrame(bool isIdle);
+    float GetLastSleepMs() const;
+
+    // how long before the deadline the sleep ends (see the class description)
+    static const float SLEEP_MARGIN_MS;
+
+private:
+    float _activePeriodMs;
+    float _idlePeriodMs;
+
+    // on GetPacingClockMs()'s clock, or 0 before the first frame
+    double _nextDeadlineMs;
+    float _lastSleepMs;
+    bool _hasRaisedTimerResolution;
+};
@@ -0,0 +1,224 @@
+#include "FramePrepPipeline.h"
+
+#include "TraceTimeline.h"
+#include "ThreadPlacement.h"
+
+#include <chrono>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.  Nothing is prepared until Init(...).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+FramePrepPipeline::FramePrepPipeline() :
+    _nextOutputIndex(0),
+    _hasPendingInput(false),
+    _isPreparing(false),
+    _hasPreparedOutput(false),
+    _isStopping(false),
+    _lastWaitMs(0.0f)
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.  The worker must
+    be joined before the std::thread is destroyed, or the program is terminated.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+FramePrepPipeline::~FramePrepPipeline()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Starts the worker, which sleeps until the first Submit(...).
+Parameters:
+    prep                Fills in a frame's output from its input.  Runs on the worker.
+    useWorkerThread     False runs the prep function on the thread that calls Submit(...).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void FramePrepPipeline::Init(const PrepFunction &prep, bool useWorkerThread)
+{
+    this->Cleanup();
+    _prep = prep;
+    if (useWorkerThread)
+    {
+        _worker = std::thread(&FramePrepPipeline::WorkerLoop, this);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Waits for the worker to finish the frame that it is on (if any) and stops it.  Safe to
+    call more than once.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void FramePrepPipeline::Cleanup()
+{
+    if (_worker.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _isStopping = true;
+        }
+        _condition.notify_all();
+        _worker.join();
+    }
+
+    _nextOutputIndex = 0;
+    _hasPendingInput = false;
+    _isPreparing = false;
+    _hasPreparedOutput = false;
+    _isStopping = false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Starts preparing the next frame.  Returns right away unless there is no worker.
+
+    Note: If the frame before it was never taken, this one replaces it.
+Parameters:
+    input   Copied, so it can go out of scope.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void FramePrepPipeline::Submit(const FramePrepInput &input)
+{
+    if (!_prep)
+    {
+        return;
+    }
+
+    if (!_worker.joinable())
+    {
+        _prep(input, &_outputs[_nextOutputIndex]);
+        _hasPreparedOutput = true;
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _pendingInput = input;
+        _hasPendingInput = true;
+    }
+    _condition.notify_all();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Waits for the last submitted frame to be prepared and hands it over.  The output stays
+    valid until the next Submit(...) after this, since the worker writes the other one in the
+    meantime.
+
+    Note: How long this waited is kept for GetLastWaitMs().  If it is more than a fraction of
+    a millisecond, the worker is the slow part of the frame and not the GPU.
+Parameters: None
+Returns:
+    The prepared frame, or 0 if nothing was submitted since the last one was taken (ex: the
+    first frame).
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+const FramePrepOutput *FramePrepPipeline::TakePrepared()
+{
+    _lastWaitMs = 0.0f;
+    if (!_worker.joinable())
+    {
+        if (!_hasPreparedOutput)
+        {
+            return 0;
+        }
+    }
+    else
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (!_hasPendingInput && !_isPreparing && !_hasPreparedOutput)
+        {
+            return 0;
+        }
+
+        std::chrono::high_resolution_clock::time_point waitStart =
+            std::chrono::high_resolution_clock::now();
+        _condition.wait(lock,
+            [this]() { return _hasPreparedOutput && !_hasPendingInput && !_isPreparing; });
+        _lastWaitMs = std::chrono::duration<float, std::milli>(
+            std::chrono::high_resolution_clock::now() - waitStart).count();
+    }
+
+    const FramePrepOutput *output = &_outputs[_nextOutputIndex];
+    _nextOutputIndex = (_nextOutputIndex + 1) % 2;
+    _hasPreparedOutput = false;
+    return output;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How many milliseconds the last TakePrepared() waited for the worker.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+float FramePrepPipeline::GetLastWaitMs() const
+{
+    return _lastWaitMs;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The worker thread.  Sleeps until there is an input, prepares it into the output that the
+    GL thread isn't holding, and says that it's done.
+
+    Note: The output index can only change in TakePrepared(), which waits for this to finish,
+    so it is safe to write to the output outside of the lock.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void FramePrepPipeline::WorkerLoop()
+{
+    SetTraceThreadName("frame prep");
+    PlaceWorkerThread();
+    while (true)
+    {
+        FramePrepInput input;
+        unsigned int outputIndex = 0;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _condition.wait(lock, [this]() { return _isStopping || _hasPendingInput; });
+            if (_isStopping)
+            {
+                return;
+            }
+            input = _pendingInput;
+            outputIndex = _nextOutputIndex;
+            _hasPendingInput = false;
+            _isPreparing = true;
+        }
+
+        _prep(input, &_outputs[outputIndex]);
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _isPreparing = false;
+            _hasPreparedOutput = true;
+        }
+        _condition.notify_all();
+    }
+}
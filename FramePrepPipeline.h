@@ -0,0 +1,93 @@
+#pragma once
+
+#include "GlCommandList.h"
+#include "FrameStatsLog.h"
+#include "SceneConfig.h"
+
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// what the worker is given to prepare a frame (see FramePrepPipeline::Submit(...))
+struct FramePrepInput
+{
+    unsigned int _frameIndex;       // the frame that the parameters are for
+    float _simulationTimeSec;       // where the simulation clock got to on the frame before it
+
+    // the frame before that one, whose buffer swap (and so its whole time) is done by now
+    bool _hasFinishedSample;
+    FrameSample _finishedSample;
+};
+
+// the parameters that the GL thread needs to issue a frame, worked out ahead of time
+// Note: The emitters' changes are recorded as commands (see GlCommandList.h), one list per
+// task that the prep split its work into, so the GL thread only executes them in order.  The
+// lists are reset and recorded again every frame, and keep their memory.
+struct FramePrepOutput
+{
+    unsigned int _frameIndex;
+    std::vector<GlCommandList> _commandLists;
+
+    // the scene file was saved, and this is what it holds now (see SceneConfig.h)
+    bool _hasSceneConfig;
+    SceneConfig _sceneConfig;
+
+    bool _hasFrameGraphSample;
+    float _frameGraphSampleMs;
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Moves the CPU's share of a frame off of the GL thread so that it overlaps with the GPU.
+    Display() hands the worker the inputs for the next frame right before it swaps buffers,
+    and the worker prepares that frame (emitter animation, processing the last finished
+    frame's counts, stats logging) while the GL thread is blocked in the swap and the GPU is
+    busy with the current frame.  The next Display() takes the result and only has GL calls
+    left to make.
+
+    The outputs are double buffered: the worker writes one while the GL thread reads the
+    other, and they trade when the GL thread takes a finished frame.  So the GL thread must be
+    done with the output that it was given by the time it submits the next input, which
+    Display() is because it submits at the end of the frame.
+
+    Note: The prep function runs on the worker and must not make GL calls.  Everything that it
+    touches other than its input and output must be its own (ex: a copy of the emitter table).
+    Also Note: Without a worker (see Init(...)), Submit(...) runs the prep function on the
+    calling thread, which is the old single-threaded frame for A/B timing.
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+class FramePrepPipeline
+{
+public:
+    typedef std::function<void(const FramePrepInput &, FramePrepOutput *)> PrepFunction;
+
+    FramePrepPipeline();
+    ~FramePrepPipeline();
+    void Init(const PrepFunction &prep, bool useWorkerThread);
+    void Cleanup();
+
+    void Submit(const FramePrepInput &input);
+    const FramePrepOutput *TakePrepared();
+    float GetLastWaitMs() const;
+
+private:
+    void WorkerLoop();
+
+    PrepFunction _prep;
+    FramePrepOutput _outputs[2];
+    unsigned int _nextOutputIndex;
+
+    // the GL thread waits on the condition for the worker to finish, and the worker waits on
+    // it for the next input
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::thread _worker;
+    FramePrepInput _pendingInput;
+    bool _hasPendingInput;
+    bool _isPreparing;
+    bool _hasPreparedOutput;
+    bool _isStopping;
+    float _lastWaitMs;
+};
@@ -0,0 +1,267 @@
+#include "FrameStatsLog.h"
+#include "Log.h"
+
+#include <chrono>
+#include <math.h>       // sqrt, fabsf
+
+// how long the writer thread sleeps between drains
+// Note: Short enough that the ring never gets close to full, long enough that the thread is
+// asleep nearly all the time.
+static const unsigned int WRITER_SLEEP_MS = 100;
+
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-14-2016)
+-----------------------------------------------------------------------------------------------*/
+FrameStatsLog::FrameStatsLog() :
+    _writeIndex(0),
+    _readIndex(0),
+    _isRunning(false),
+    _csvFile(0),
+    _droppedSamples(0),
+    _jitterFrameCount(0),
+    _frameTimeMeanMs(0.0),
+    _frameTimeSquaredDeviationSum(0.0),
+    _frameTimeChangeSumMs(0.0),
+    _previousFrameTimeMs(0.0f),
+    _worstFrameTimeMs(0.0f)
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.  The writer thread
+    must be joined before the std::thread is destroyed, or the program is terminated.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-14-2016)
+-----------------------------------------------------------------------------------------------*/
+FrameStatsLog::~FrameStatsLog()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Opens the CSV file, writes the header, and starts the writer thread.
+Parameters:
+    csvFilePath     Overwritten if it exists.
+Returns:
+    True if the file could be opened, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-14-2016)
+-----------------------------------------------------------------------------------------------*/
+bool FrameStatsLog::Init(const std::string &csvFilePath)
+{
+    this->Cleanup();
+
+    _csvFile = fopen(csvFilePath.c_str(), "w");
+    if (_csvFile == 0)
+    {
+        LogPrintf("could not open frame stats log '%s'\n", csvFilePath.c_str());
+        return false;
+    }
+    fprintf(_csvFile, 
+        "frame,pacing_wait_ms,cpu_display_ms,swap_ms,particles_alive,particles_emitted,"
+        "render_scale,stats_live,mean_speed,max_speed,bounds_min_x,bounds_min_y,bounds_max_x,"
+        "bounds_max_y,input_latency_ms,table_upload_bytes\n");
+
+    _writeIndex = 0;
+    _readIndex = 0;
+    _droppedSamples = 0;
+    _jitterFrameCount = 0;
+    _frameTimeMeanMs = 0.0;
+    _frameTimeSquaredDeviationSum = 0.0;
+    _frameTimeChangeSumMs = 0.0;
+    _previousFrameTimeMs = 0.0f;
+    _worstFrameTimeMs = 0.0f;
+    _isRunning = true;
+    _writerThread = std::thread(&FrameStatsLog::WriterThreadLoop, this);
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Stops the writer thread, writes out whatever is left in the ring, and closes the file.  
+    Logs the frame time's jitter over the whole run on the way out.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-14-2016)
+-----------------------------------------------------------------------------------------------*/
+void FrameStatsLog::Cleanup()
+{
+    _isRunning = false;
+    if (_writerThread.joinable())
+    {
+        _writerThread.join();
+    }
+
+    if (_csvFile != 0)
+    {
+        this->DrainToFile();
+        fclose(_csvFile);
+        _csvFile = 0;
+
+        if (_jitterFrameCount > 1)
+        {
+            double deviationMs = sqrt(_frameTimeSquaredDeviationSum / (_jitterFrameCount - 1));
+            LogPrintf("frame stats: %u frames, %.3fms average, %.3fms standard deviation, "
+                "%.3fms average change from one frame to the next, %.3fms worst\n", 
+                _jitterFrameCount, _frameTimeMeanMs, deviationMs, 
+                _frameTimeChangeSumMs / (_jitterFrameCount - 1), _worstFrameTimeMs);
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Adds a sample to the ring.  Only call this from one thread (the render thread).
+Parameters:
+    sample  Self-explanatory.
+Returns:
+    True if the sample was added, false if the log isn't running or the ring was full.
+Exception:  Safe
+Creator:    John Cox (8-14-2016)
+-----------------------------------------------------------------------------------------------*/
+bool FrameStatsLog::Push(const FrameSample &sample)
+{
+    if (_csvFile == 0)
+    {
+        return false;
+    }
+
+    // only this thread writes the write index, so a relaxed load is enough; the read index
+    // needs "acquire" so that the writer thread is known to be done with the slot before it
+    // is overwritten
+    unsigned int writeIndex = _writeIndex.load(std::memory_order_relaxed);
+    unsigned int readIndex = _readIndex.load(std::memory_order_acquire);
+    if (writeIndex - readIndex >= RING_SIZE)
+    {
+        _droppedSamples++;
+        return false;
+    }
+
+    _ring[writeIndex & (RING_SIZE - 1)] = sample;
+
+    // "release" so that the sample is visible to the writer thread before the index is
+    _writeIndex.store(writeIndex + 1, std::memory_order_release);
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The number of samples that were dropped because the ring was full.
+Exception:  Safe
+Creator:    John Cox (8-14-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int FrameStatsLog::GetDroppedSampleCount() const
+{
+    return _droppedSamples;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The writer thread.  Drains the ring, flushes the file, and sleeps until the log is stopped.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-14-2016)
+-----------------------------------------------------------------------------------------------*/
+void FrameStatsLog::WriterThreadLoop()
+{
+    while (_isRunning)
+    {
+        this->DrainToFile();
+        std::this_thread::sleep_for(std::chrono::milliseconds(WRITER_SLEEP_MS));
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Writes every sample that is in the ring to the file.  Only call this from one thread at a
+    time (the writer thread, or Cleanup() after the writer thread has been joined).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-14-2016)
+-----------------------------------------------------------------------------------------------*/
+void FrameStatsLog::DrainToFile()
+{
+    // "acquire" pairs with the "release" in Push(...)
+    unsigned int readIndex = _readIndex.load(std::memory_order_relaxed);
+    unsigned int writeIndex = _writeIndex.load(std::memory_order_acquire);
+    if (readIndex == writeIndex)
+    {
+        return;
+    }
+
+    for (; readIndex != writeIndex; readIndex++)
+    {
+        const FrameSample &sample = _ring[readIndex & (RING_SIZE - 1)];
+        fprintf(_csvFile, 
+            "%u,%.4f,%.4f,%.4f,%u,%u,%.3f,%u,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%u\n",
+            sample._frameIndex,
+            sample._pacingWaitMs,
+            sample._cpuDisplayMs,
+            sample._swapMs,
+            sample._particlesAlive,
+            sample._particlesEmitted,
+            sample._renderScale,
+            sample._statsLiveCount,
+            sample._meanSpeed,
+            sample._maxSpeed,
+            sample._boundsMinX,
+            sample._boundsMinY,
+            sample._boundsMaxX,
+            sample._boundsMaxY,
+            sample._inputLatencyMs,
+            sample._tableUploadBytes);
+
+        this->AddToJitter(sample);
+
+        // hand the slot back as soon as it has been copied out
+        _readIndex.store(readIndex + 1, std::memory_order_release);
+    }
+    fflush(_csvFile);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Adds a frame's time (the pacing wait, the CPU's part, and the swap, which together are 
+    the time from one frame's start to the next) to the running mean and variance (Welford's
+    method, which doesn't lose precision over a long run), and how much it changed from the 
+    frame before.  The change is the jitter that shows up as stutter: a steady 20ms is 
+    smooth, and 10ms and 30ms in turns isn't, although both average 20ms.
+Parameters:
+    sample  Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void FrameStatsLog::AddToJitter(const FrameSample &sample)
+{
+    float frameTimeMs = sample._pacingWaitMs + sample._cpuDisplayMs + sample._swapMs;
+    _jitterFrameCount++;
+    double deviationBefore = frameTimeMs - _frameTimeMeanMs;
+    _frameTimeMeanMs += deviationBefore / _jitterFrameCount;
+    _frameTimeSquaredDeviationSum += deviationBefore * (frameTimeMs - _frameTimeMeanMs);
+    if (_jitterFrameCount > 1)
+    {
+        _frameTimeChangeSumMs += fabsf(frameTimeMs - _previousFrameTimeMs);
+    }
+    _previousFrameTimeMs = frameTimeMs;
+    if (frameTimeMs > _worstFrameTimeMs)
+    {
+        _worstFrameTimeMs = frameTimeMs;
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <stdio.h>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    One frame's worth of timing and particle counts.
+Creator:    John Cox (8-14-2016)
+-----------------------------------------------------------------------------------------------*/
+struct FrameSample
+{
+    unsigned int _frameIndex;
+    float _pacingWaitMs;        // waiting for a frame slot before Display() (see FramePacer)
+    float _cpuDisplayMs;        // Display() up to, but not including, the buffer swap
+    float _swapMs;              // AppWindow::SwapBuffers() by itself
+    unsigned int _particlesAlive;
+    unsigned int _particlesEmitted;
+    float _renderScale;         // the draw's size over the window's (see ScaledRenderTarget)
+
+    // the latest GPU reduction over the whole pool (see ParticleStatsReducer), which only 
+    // changes every so many frames
+    unsigned int _statsLiveCount;
+    float _meanSpeed;
+    float _maxSpeed;
+    float _boundsMinX;
+    float _boundsMinY;
+    float _boundsMaxX;
+    float _boundsMaxY;
+
+    // from the mouse moving to the frame that used it being done on the GPU, or 0 if no frame 
+    // with new mouse input was seen to finish (see FramePacer::GetLastInputLatencyMs())
+    float _inputLatencyMs;
+
+    // the emitter and force field table entries that the last update uploaded (see 
+    // ParticleManager::GetTableUploadBytes())
+    unsigned int _tableUploadBytes;
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Logs a FrameSample for every frame to a CSV file without putting any file I/O on the
+    render thread.
+
+    The render thread pushes samples into a fixed-size ring, and a background thread drains the
+    ring to the file every so often.  The ring is single-producer single-consumer, so the only
+    synchronization it needs is an atomic read index and an atomic write index; pushing is a
+    copy and an atomic store, and never blocks.  If the writer thread falls so far behind that
+    the ring fills up, new samples are dropped (and counted) rather than waited on.
+Creator:    John Cox (8-14-2016)
+-----------------------------------------------------------------------------------------------*/
+class FrameStatsLog
+{
+public:
+    FrameStatsLog();
+    ~FrameStatsLog();
+    bool Init(const std::string &csvFilePath);
+    void Cleanup();
+
+    bool Push(const FrameSample &sample);
+    unsigned int GetDroppedSampleCount() const;
+
+private:
+    void WriterThreadLoop();
+    void DrainToFile();
+    void AddToJitter(const FrameSample &sample);
+
+    // a power of 2 so that the indices can wrap with a mask; at 60 frames per second this is
+    // about a minute of frames
+    static const unsigned int RING_SIZE = 4096;
+    FrameSample _ring[RING_SIZE];
+
+    // only the render thread writes _writeIndex and only the writer thread writes _readIndex
+    // Note: They count up forever (and wrap at 2^32, which the unsigned math handles) and are
+    // masked when indexing the ring.
+    std::atomic<unsigned int> _writeIndex;
+    std::atomic<unsigned int> _readIndex;
+    std::atomic<bool> _isRunning;
+    std::thread _writerThread;
+    FILE *_csvFile;
+    unsigned int _droppedSamples;
+
+    // the frame time's spread, which Cleanup() logs so that runs can be compared without 
+    // going through the file (ex: with and without the thread placement, see 
+    // ThreadPlacement.h)
+    // Note: Only the writer thread touches these until Cleanup() has joined it.
+    unsigned int _jitterFrameCount;
+    double _frameTimeMeanMs;
+    double _frameTimeSquaredDeviationSum;
+    double _frameTimeChangeSumMs;
+    float _previousFrameTimeMs;
+    float _worstFrameTimeMs;
+};
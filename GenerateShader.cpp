@@ -1,113 +1,893 @@
 #include "GenerateShader.h"
 
 #include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
+#include "ShaderBinaryCache.h"
+#include "AssetPack.h"
+#include "MappedFile.h"
+#include "ComputeDeviceCaps.h"
+#include "Log.h"
+#include "TraceTimeline.h"
 
 // for making program from shader collection
 #include <string>
-#include <fstream>
-#include <sstream>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <set>
+#include <stdio.h>
+
+// every program built since startup (see GetShaderBuildRecords())
+// Note: Per thread, so that the contexts on other GPUs (see MultiGpuSimulation.h) don't add 
+// to the startup report's builds while it reads them.
+static thread_local std::vector<ShaderBuildRecord> gShaderBuildRecords;
+
+// every shader file that has been read, and what each file that was loaded expanded to (see 
+// ReadShaderSource(...))
+// Note: Shared by every thread, since the files are the same for every context, so they are 
+// behind the mutex.
+struct ExpandedShaderSource
+{
+    std::string _source;
+    std::vector<std::string> _dependencies;
+};
+static std::mutex gShaderSourceMutex;
+static std::map<std::string, std::string> gShaderFileContents;
+static std::map<std::string, ExpandedShaderSource> gExpandedShaderSources;
+
+// GL_ARB_gl_spirv's (see LoadSpirvComputeProgram(...))
+// Note: This version of glload is older than the extension, so the function is looked up by 
+// hand (see GetGlFunctionAddress(...)).
+static const GLenum SHADER_BINARY_FORMAT_SPIR_V_ARB = 0x9551;
+typedef void (CODEGEN_FUNCPTR *SpecializeShaderArbProc)(GLuint shader, 
+    const GLchar *entryPoint, GLuint constantCount, const GLuint *constantIndices, 
+    const GLuint *constantValues);
 
 
 /*-----------------------------------------------------------------------------------------------
 Description:
-    Encapsulates the creation of an OpenGL GPU program, including the compilation and linking of
-    shaders.  It tries to cover all the basics and the error reporting and is as self-contained
-    as possible, only returning a program ID when it is finished.
+    Reads one line of a defines block as '#define NAME "file"', which is how a variant names a 
+    file for a '#include NAME' line (see ExpandDefinedIncludes(...)).
+Parameters:
+    shaderDefines   Self-explanatory.
+    lineStart       Where the line starts.
+    lineEnd         Just past the end of the line.
+    putNameHere     Self-explanatory.
+    putFilePathHere Self-explanatory.
+Returns:
+    True if the line defines a name as a file name in quotes, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static bool ParseFileDefine(const std::string &shaderDefines, size_t lineStart, size_t lineEnd,
+    std::string *putNameHere, std::string *putFilePathHere)
+{
+    size_t firstChar = shaderDefines.find_first_not_of(" \t", lineStart);
+    if (firstChar >= lineEnd || shaderDefines.compare(firstChar, 7, "#define") != 0)
+    {
+        return false;
+    }
+    size_t nameStart = shaderDefines.find_first_not_of(" \t", firstChar + 7);
+    size_t nameEnd = shaderDefines.find_first_of(" \t\n", nameStart);
+    size_t pathStart = shaderDefines.find('"', nameEnd);
+    size_t pathEnd = (pathStart < lineEnd) ? 
+        shaderDefines.find('"', pathStart + 1) : std::string::npos;
+    if (nameStart >= lineEnd || nameEnd >= lineEnd || pathEnd >= lineEnd)
+    {
+        return false;
+    }
+    *putNameHere = shaderDefines.substr(nameStart, nameEnd - nameStart);
+    *putFilePathHere = shaderDefines.substr(pathStart + 1, pathEnd - pathStart - 1);
+    return true;
+}
 
-    In particular, this one loads the vertex and fragment parts of the shader program.
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    shaderDefines   Self-explanatory.
+    macroName       Self-explanatory.
+Returns:
+    The file that the defines give the name, or an empty string if they don't define it as a 
+    file name.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static std::string FindDefinedIncludePath(const std::string &shaderDefines, 
+    const std::string &macroName)
+{
+    size_t lineStart = 0;
+    while (lineStart < shaderDefines.length())
+    {
+        size_t lineEnd = shaderDefines.find('\n', lineStart);
+        lineEnd = (lineEnd == std::string::npos) ? shaderDefines.length() : lineEnd + 1;
+        std::string name;
+        std::string filePath;
+        if (ParseFileDefine(shaderDefines, lineStart, lineEnd, &name, &filePath) && 
+            name == macroName)
+        {
+            return filePath;
+        }
+        lineStart = lineEnd;
+    }
+    return std::string();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Replaces each '#include NAME' line of an expanded shader with the file that the variant's 
+    defines name (ex: '#define CUSTOM_UPDATE "swirl.glsl"'), expanded the same way as any 
+    other shader file (see ReadShaderSource(...)), so one shader can take code that only some 
+    of its variants have, and each of those variants is a program of its own in the registry 
+    and the binary cache.  A name that the defines don't have is left out, like a block of 
+    "#ifdef" that is off.  The path is relative to the working directory.
+
+    The expansion left a "#line" directive after each of these lines (see 
+    ExpandShaderIncludes(...)), so the lines after it keep their numbers either way, and the 
+    spliced file gets the next source string number after the expansion's.
+Parameters:
+    shaderSource    The expanded shader.
+    shaderDefines   Self-explanatory.
+Returns:
+    A copy of the shader with the lines replaced.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static std::string ExpandDefinedIncludes(const std::string &shaderSource, 
+    const std::string &shaderDefines)
+{
+    // the quoted includes were all expanded already, so nearly every shader leaves here
+    if (shaderSource.find("#include") == std::string::npos)
+    {
+        return shaderSource;
+    }
+
+    // every file in the expansion after the first starts with "#line 1 <its number>"
+    unsigned int nextSourceStringNumber = 1;
+    for (size_t linePos = shaderSource.find("\n#line 1 "); linePos != std::string::npos; 
+        linePos = shaderSource.find("\n#line 1 ", linePos + 1))
+    {
+        nextSourceStringNumber++;
+    }
+
+    std::string result;
+    size_t lineStart = 0;
+    while (lineStart < shaderSource.length())
+    {
+        size_t lineEnd = shaderSource.find('\n', lineStart);
+        lineEnd = (lineEnd == std::string::npos) ? shaderSource.length() : lineEnd + 1;
+        size_t firstChar = shaderSource.find_first_not_of(" \t", lineStart);
+        bool isInclude = firstChar < lineEnd && 
+            shaderSource.compare(firstChar, 8, "#include") == 0;
+        if (!isInclude)
+        {
+            result.append(shaderSource, lineStart, lineEnd - lineStart);
+            lineStart = lineEnd;
+            continue;
+        }
+
+        size_t nameStart = shaderSource.find_first_not_of(" \t", firstChar + 8);
+        size_t nameEnd = shaderSource.find_first_of(" \t\r\n", nameStart);
+        nameEnd = (nameEnd == std::string::npos) ? shaderSource.length() : nameEnd;
+        std::string macroName = (nameStart < lineEnd) ? 
+            shaderSource.substr(nameStart, nameEnd - nameStart) : std::string();
+        std::string includePath = FindDefinedIncludePath(shaderDefines, macroName);
+        if (includePath.empty())
+        {
+            result += "\n";
+        }
+        else
+        {
+            std::string includeSource = ReadShaderSource(includePath);
+            if (includeSource.empty())
+            {
+                LogPrintf("'%s' (%s) is missing or empty\n", includePath.c_str(), 
+                    macroName.c_str());
+            }
+            result += "#line 1 " + std::to_string(nextSourceStringNumber++) + "\n";
+            result += includeSource + "\n";
+        }
+        lineStart = lineEnd;
+    }
+    return result;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    shaderDefines       Self-explanatory.
+    putDependenciesHere Gets every file that the defines name for a '#include NAME' line (see
+                        ExpandDefinedIncludes(...)), and every file that they include, added 
+                        to the end.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void AddDefinedIncludeDependencies(const std::string &shaderDefines, 
+    std::vector<std::string> *putDependenciesHere)
+{
+    size_t lineStart = 0;
+    while (lineStart < shaderDefines.length())
+    {
+        size_t lineEnd = shaderDefines.find('\n', lineStart);
+        lineEnd = (lineEnd == std::string::npos) ? shaderDefines.length() : lineEnd + 1;
+        std::string name;
+        std::string filePath;
+        if (ParseFileDefine(shaderDefines, lineStart, lineEnd, &name, &filePath))
+        {
+            std::vector<std::string> includeDependencies;
+            ReadShaderSource(filePath, &includeDependencies);
+            putDependenciesHere->insert(putDependenciesHere->end(), 
+                includeDependencies.begin(), includeDependencies.end());
+        }
+        lineStart = lineEnd;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    GLSL requires that "#version" is the first thing in the shader, so any "#define" statements 
+    that customize a shader need to go immediately after it.  This also adds a "#line" 
+    directive so that the compiler's error messages still refer to the line numbers in the 
+    shader file.
+
+    The '#include NAME' lines are expanded first, with the files that the defines name (see 
+    ExpandDefinedIncludes(...)).
+Parameters:
+    shaderSource    The contents of the shader file.
+    shaderDefines   One or more lines of "#define" statements, each ending in a newline.
+Returns:
+    A copy of the shader source with the defines inserted.
+Exception:  Safe
+Creator:    John Cox (8-2-2016)
+-----------------------------------------------------------------------------------------------*/
+std::string InsertShaderDefines(const std::string &unexpandedSource, 
+    const std::string &shaderDefines)
+{
+    std::string shaderSource = ExpandDefinedIncludes(unexpandedSource, shaderDefines);
+    if (shaderDefines.empty())
+    {
+        return shaderSource;
+    }
+
+    // if there is no version line, then the defines can go first
+    size_t versionPos = shaderSource.find("#version");
+    if (versionPos == std::string::npos)
+    {
+        return shaderDefines + "#line 1\n" + shaderSource;
+    }
+
+    size_t endOfVersionLine = shaderSource.find('\n', versionPos);
+    if (endOfVersionLine == std::string::npos)
+    {
+        // nothing but the version line
+        return shaderSource + "\n" + shaderDefines;
+    }
+
+    // count the lines up to and including the version line so that "#line" can tell the 
+    // compiler what the next line of the original file is
+    int nextLineNumber = 2;
+    for (size_t charIndex = 0; charIndex < versionPos; charIndex++)
+    {
+        if (shaderSource[charIndex] == '\n')
+        {
+            nextLineNumber++;
+        }
+    }
+
+    std::string result = shaderSource.substr(0, endOfVersionLine + 1);
+    result += shaderDefines;
+    result += "#line " + std::to_string(nextLineNumber) + "\n";
+    result += shaderSource.substr(endOfVersionLine + 1);
+    return result;
+}
+
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    start   Self-explanatory.
+Returns:
+    The milliseconds from then until now.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+static float MillisecondsSince(const std::chrono::high_resolution_clock::time_point &start)
+{
+    return std::chrono::duration<float, std::milli>(
+        std::chrono::high_resolution_clock::now() - start).count();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    One line per define is too much for the timing line, so this puts them all on one.
+Parameters:
+    shaderDefines   Self-explanatory.
+Returns:
+    The defines with spaces instead of newlines.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+static std::string GetDefinesOnOneLine(const std::string &shaderDefines)
+{
+    std::string definesOnOneLine = shaderDefines;
+    for (size_t charIndex = 0; charIndex < definesOnOneLine.length(); charIndex++)
+    {
+        if (definesOnOneLine[charIndex] == '\n')
+        {
+            definesOnOneLine[charIndex] = ' ';
+        }
+    }
+    return definesOnOneLine;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Reads a whole file into a string, from the asset pack if it has the file (see 
+    AssetPack.h), and otherwise from the disk.
+Parameters:
+    filePath    Self-explanatory.
+Returns:
+    The file's contents, or an empty string if it couldn't be read.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+static std::string ReadShaderFile(const std::string &filePath)
+{
+    // Note: The file is mapped and copied once, straight into the string, instead of being 
+    // streamed into a stringstream and copied out of it again.  The copy has to stay because 
+    // the includes and defines are spliced into it.
+    MappedFile shaderFile;
+    const void *shaderData = 0;
+    size_t shaderSizeBytes = 0;
+    if (!MapAsset(filePath, &shaderFile, &shaderData, &shaderSizeBytes))
+    {
+        return std::string();
+    }
+    return std::string((const char *)shaderData, shaderSizeBytes);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Adds a file's contents to the expansion, with each of its '#include "file"' lines replaced 
+    by that file's contents, and so on down.  An included file's path is relative to the file 
+    that includes it.  A file that has already been included is left out the next time, like 
+    "#pragma once", which also stops a file from including itself.
+
+    The "#line" directives around each included file give it its own source string number 
+    (its index in the dependencies), so the compiler's errors say which file and which line 
+    of it: "2(14)" is line 14 of the third file in the dependencies.
+
+    Note: The caller must hold gShaderSourceMutex.  A file that hasn't been read yet is read 
+    here.
+Parameters:
+    filePath            Self-explanatory.
+    putDependenciesHere Gets every file in the expansion, with the first one first.
+    putSourceHere       The expansion is appended to this.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static void ExpandShaderIncludes(const std::string &filePath, 
+    std::vector<std::string> *putDependenciesHere, std::string *putSourceHere)
+{
+    std::map<std::string, std::string>::iterator fileItr = gShaderFileContents.find(filePath);
+    if (fileItr == gShaderFileContents.end())
+    {
+        fileItr = gShaderFileContents.insert(
+            std::make_pair(filePath, ReadShaderFile(filePath))).first;
+    }
+    const std::string &fileContents = fileItr->second;
+    unsigned int sourceStringNumber = (unsigned int)putDependenciesHere->size();
+    putDependenciesHere->push_back(filePath);
+
+    size_t lastSlash = filePath.find_last_of("/\\");
+    std::string directory = 
+        (lastSlash == std::string::npos) ? std::string() : filePath.substr(0, lastSlash + 1);
+    size_t lineStart = 0;
+    unsigned int lineNumber = 1;
+    while (lineStart < fileContents.length())
+    {
+        size_t lineEnd = fileContents.find('\n', lineStart);
+        lineEnd = (lineEnd == std::string::npos) ? fileContents.length() : lineEnd + 1;
+        size_t firstChar = fileContents.find_first_not_of(" \t", lineStart);
+        bool isInclude = firstChar < lineEnd && 
+            fileContents.compare(firstChar, 8, "#include") == 0;
+        if (!isInclude)
+        {
+            putSourceHere->append(fileContents, lineStart, lineEnd - lineStart);
+        }
+        else
+        {
+            size_t nameStart = fileContents.find('"', firstChar);
+            size_t nameEnd = (nameStart < lineEnd) ? 
+                fileContents.find('"', nameStart + 1) : std::string::npos;
+            if (nameStart == std::string::npos || nameStart >= lineEnd)
+            {
+                // '#include NAME' takes its file from a variant's defines, so it is left for 
+                // InsertShaderDefines(...), with the line number to pick up from after it
+                putSourceHere->append(fileContents, lineStart, lineEnd - lineStart);
+                if (fileContents[lineEnd - 1] != '\n')
+                {
+                    putSourceHere->append("\n");
+                }
+                putSourceHere->append("#line " + std::to_string(lineNumber + 1) + " " + 
+                    std::to_string(sourceStringNumber) + "\n");
+            }
+            else if (nameEnd == std::string::npos || nameEnd >= lineEnd)
+            {
+                LogPrintf("%s(%u): an include needs a file name in quotes\n", 
+                    filePath.c_str(), lineNumber);
+            }
+            else
+            {
+                std::string includePath = directory + 
+                    fileContents.substr(nameStart + 1, nameEnd - nameStart - 1);
+                bool isIncluded = false;
+                for (size_t depIndex = 0; depIndex < putDependenciesHere->size(); depIndex++)
+                {
+                    isIncluded = isIncluded || (*putDependenciesHere)[depIndex] == includePath;
+                }
+                if (!isIncluded)
+                {
+                    putSourceHere->append("#line 1 " + 
+                        std::to_string(putDependenciesHere->size()) + "\n");
+                    ExpandShaderIncludes(includePath, putDependenciesHere, putSourceHere);
+                    if (gShaderFileContents[includePath].empty())
+                    {
+                        LogPrintf("%s(%u): '%s' is missing or empty\n", filePath.c_str(), 
+                            lineNumber, includePath.c_str());
+                    }
+                    putSourceHere->append("\n#line " + std::to_string(lineNumber + 1) + " " + 
+                        std::to_string(sourceStringNumber) + "\n");
+                }
+            }
+        }
+        lineStart = lineEnd;
+        lineNumber++;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gets a shader file with its includes expanded (see ExpandShaderIncludes(...)).  The files 
+    are only read the first time, and the expansion is kept, so the other variants of the same
+    shader cost a lookup.
+Parameters:
+    filePath            Self-explanatory.
+    putDependenciesHere Optional.  Gets every file that went into it, with this one first.
+Returns:
+    The expanded source, or an empty string if the file couldn't be read.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+std::string ReadShaderSource(const std::string &filePath, 
+    std::vector<std::string> *putDependenciesHere)
+{
+    std::lock_guard<std::mutex> lock(gShaderSourceMutex);
+    std::map<std::string, ExpandedShaderSource>::iterator found = 
+        gExpandedShaderSources.find(filePath);
+    if (found == gExpandedShaderSources.end())
+    {
+        ExpandedShaderSource expanded;
+        ExpandShaderIncludes(filePath, &expanded._dependencies, &expanded._source);
+        found = gExpandedShaderSources.insert(std::make_pair(filePath, expanded)).first;
+    }
+    if (putDependenciesHere != 0)
+    {
+        *putDependenciesHere = found->second._dependencies;
+    }
+    return found->second._source;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Replaces a file's contents, as if it had been read again, and drops every expansion that 
+    used it, so that the next ReadShaderSource(...) of them is rebuilt from the new contents 
+    without reading any of the files that didn't change.
+Parameters:
+    filePath        Self-explanatory.
+    fileContents    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void UpdateShaderFile(const std::string &filePath, const std::string &fileContents)
+{
+    std::lock_guard<std::mutex> lock(gShaderSourceMutex);
+    gShaderFileContents[filePath] = fileContents;
+    std::map<std::string, ExpandedShaderSource>::iterator expandedItr = 
+        gExpandedShaderSources.begin();
+    while (expandedItr != gExpandedShaderSources.end())
+    {
+        const std::vector<std::string> &dependencies = expandedItr->second._dependencies;
+        bool isAffected = false;
+        for (size_t depIndex = 0; depIndex < dependencies.size(); depIndex++)
+        {
+            isAffected = isAffected || dependencies[depIndex] == filePath;
+        }
+        if (isAffected)
+        {
+            expandedItr = gExpandedShaderSources.erase(expandedItr);
+        }
+        else
+        {
+            ++expandedItr;
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Lists every shader file that has been read, includes and all, so that they can be packed 
+    (see WriteAssetPack(...)).
 Parameters: None
 Returns:
-    The OpenGL ID of the GPU program.
+    The files' paths, as they were asked for.
 Exception:  Safe
-Creator:    John Cox (2-13-2016)
+Creator:    John Cox (8-17-2016)
 -----------------------------------------------------------------------------------------------*/
-unsigned int GenerateVertexShaderProgram()
-{
-    // hard-coded ignoring possible errors like a boss
-
-    // load up the vertex shader and compile it
-    // Note: After retrieving the file's contents, dump the stringstream's contents into a 
-    // single std::string.  Do this because, in order to provide the data for shader 
-    // compilation, pointers are needed.  The std::string that the stringstream::str() function 
-    // returns is a copy of the data, not a reference or pointer to it, so it will go bad as 
-    // soon as the std::string object disappears.  To deal with it, copy the data into a 
-    // temporary string.
-    //std::ifstream shaderFile("shaderGeometry.vert");
-    std::ifstream shaderFile("shaderParticle.vert");
-    std::stringstream shaderData;
-    shaderData << shaderFile.rdbuf();
-    shaderFile.close();
-    std::string tempFileContents = shaderData.str();
-    GLuint vertShaderId = glCreateShader(GL_VERTEX_SHADER);
-    const GLchar *vertBytes[] = { tempFileContents.c_str() };
-    const GLint vertStrLengths[] = { (int)tempFileContents.length() };
-    glShaderSource(vertShaderId, 1, vertBytes, vertStrLengths);
-    glCompileShader(vertShaderId);
+std::vector<std::string> GetLoadedShaderFiles()
+{
+    std::lock_guard<std::mutex> lock(gShaderSourceMutex);
+    std::vector<std::string> filePaths;
+    std::map<std::string, std::string>::const_iterator fileItr = gShaderFileContents.begin();
+    for (; fileItr != gShaderFileContents.end(); ++fileItr)
+    {
+        filePaths.push_back(fileItr->first);
+    }
+    return filePaths;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Compiles one stage of a program and checks how it went.  On failure, the whole info log is 
+    printed and the shader is deleted.
+Parameters:
+    shaderType  GL_VERTEX_SHADER, etc.
+    source      Self-explanatory.
+    stageName   For the error message.
+    putMsHere   Gets how long the compile took, including the status query.
+Returns:
+    The OpenGL ID of the compiled shader, or 0 if it failed.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+static GLuint CompileShaderStage(GLenum shaderType, const std::string &source, 
+    const char *stageName, float *putMsHere)
+{
+    std::chrono::high_resolution_clock::time_point compileStart = 
+        std::chrono::high_resolution_clock::now();
+    GLuint shaderId = glCreateShader(shaderType);
+    const GLchar *bytes[] = { source.c_str() };
+    const GLint strLengths[] = { (int)source.length() };
+    glShaderSource(shaderId, 1, bytes, strLengths);
+    glCompileShader(shaderId);
     // alternately (if you are willing to include and link in glutil, boost, and glm), call 
     // glutil::CompileShader(GL_VERTEX_SHADER, shaderData.str());
 
     GLint isCompiled = 0;
-    glGetShaderiv(vertShaderId, GL_COMPILE_STATUS, &isCompiled);
+    glGetShaderiv(shaderId, GL_COMPILE_STATUS, &isCompiled);
+    *putMsHere = MillisecondsSince(compileStart);
     if (isCompiled == GL_FALSE)
     {
-        GLchar errLog[128];
-        GLsizei *logLen = 0;
-        glGetShaderInfoLog(vertShaderId, 128, logLen, errLog);
-        printf("vertex shader failed: '%s'\n", errLog);
-        glDeleteShader(vertShaderId);
+        LogPrintf("%s shader failed:\n%s\n", stageName, GetShaderInfoLog(shaderId).c_str());
+        glDeleteShader(shaderId);
         return 0;
     }
+    return shaderId;
+}
 
-    // load up the fragment shader and compiler it
-    //shaderFile.open("shaderGeometry.frag");
-    shaderFile.open("shaderParticle.frag");
-    shaderData.str(std::string());      // because stringstream::clear() only clears error flags
-    shaderData.clear();                 // clear any error flags that may have popped up
-    shaderData << shaderFile.rdbuf();
-    shaderFile.close();
-    tempFileContents = shaderData.str();
-    GLuint fragShaderId = glCreateShader(GL_FRAGMENT_SHADER);
-    const GLchar *fragBytes[] = { tempFileContents.c_str() };
-    const GLint fragStrLengths[] = { (int)tempFileContents.length() };
-    glShaderSource(fragShaderId, 1, fragBytes, fragStrLengths);
-    glCompileShader(fragShaderId);
-
-    glGetShaderiv(fragShaderId, GL_COMPILE_STATUS, &isCompiled);
-    if (isCompiled == GL_FALSE)
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Links the compiled stages into a new program, then cleans up the stages.  On failure, the 
+    whole info log is printed and the program is deleted.
+Parameters:
+    shaderIds       The compiled stages.
+    shaderCount     Self-explanatory.
+    description     For the error message.
+    putMsHere       Gets how long the link took, including the status query.
+Returns:
+    The OpenGL ID of the linked program, or 0 if it failed.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+static GLuint LinkShaderStages(const GLuint *shaderIds, unsigned int shaderCount, 
+    const std::string &description, float *putMsHere)
+{
+    std::chrono::high_resolution_clock::time_point linkStart = 
+        std::chrono::high_resolution_clock::now();
+    GLuint programId = glCreateProgram();
+    if (glext_ARB_get_program_binary)
     {
-        GLchar errLog[128];
-        GLsizei *logLen = 0;
-        glGetShaderInfoLog(fragShaderId, 128, logLen, errLog);
-        printf("fragment shader failed: '%s'\n", errLog);
-        glDeleteShader(vertShaderId);
-        glDeleteShader(fragShaderId);
-        return 0;
+        // must be set before linking or the driver may not keep the binary around
+        glProgramParameteri(programId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    for (unsigned int shaderIndex = 0; shaderIndex < shaderCount; shaderIndex++)
+    {
+        glAttachShader(programId, shaderIds[shaderIndex]);
     }
-
-    GLuint programId = glCreateProgram();
-    glAttachShader(programId, vertShaderId);
-    glAttachShader(programId, fragShaderId);
     glLinkProgram(programId);
 
     // the program contains binary, linked versions of the shaders, so clean up the compile 
     // objects
     // Note: Shader objects need to be un-linked before they can be deleted.  This is ok because
     // the program safely contains the shaders in binary form.
-    glDetachShader(programId, vertShaderId);
-    glDetachShader(programId, fragShaderId);
-    glDeleteShader(vertShaderId);
-    glDeleteShader(fragShaderId);
+    for (unsigned int shaderIndex = 0; shaderIndex < shaderCount; shaderIndex++)
+    {
+        glDetachShader(programId, shaderIds[shaderIndex]);
+        glDeleteShader(shaderIds[shaderIndex]);
+    }
 
     // check if the program was built ok
     GLint isLinked = 0;
     glGetProgramiv(programId, GL_LINK_STATUS, &isLinked);
+    *putMsHere = MillisecondsSince(linkStart);
     if (isLinked == GL_FALSE)
     {
-        printf("program didn't compile\n");
-        glDeleteProgram(programId);
+        LogPrintf("program '%s' didn't link:\n%s\n", description.c_str(), 
+            GetProgramInfoLog(programId).c_str());
+        DeleteGlProgram(programId);
+        return 0;
+    }
+    return programId;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Builds a compute program from the variant's offline-compiled SPIR-V module, if it has one 
+    (see LoadSpirvModule(...)), so that the driver skips its GLSL front end.  The variant's 
+    defines were already in the source that was compiled, so the module is specialized with 
+    no constants.
+
+    The particle manager and everything else look up their uniforms and blocks by name, and 
+    GL_ARB_gl_spirv leaves it to the driver whether a module's names are kept, so a program 
+    whose names didn't survive is thrown away and the variant is compiled from GLSL instead.
+Parameters:
+    source          The source with its defines already inserted.
+    putRecordHere   Gets the compile and link times, and whether it was from SPIR-V.
+Returns:
+    The OpenGL ID of the linked program, or 0 if there is no module, the driver can't take it,
+    or it failed.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static GLuint LoadSpirvComputeProgram(const std::string &source, 
+    ShaderBuildRecord *putRecordHere)
+{
+    std::string spirvKey = MakeSpirvKey(source);
+    std::vector<char> spirvModule;
+    if (!LoadSpirvModule(spirvKey, &spirvModule) || 
+        !IsGlExtensionSupported("GL_ARB_gl_spirv"))
+    {
+        return 0;
+    }
+    SpecializeShaderArbProc specializeShader = 
+        (SpecializeShaderArbProc)GetGlFunctionAddress("glSpecializeShaderARB");
+    if (specializeShader == 0)
+    {
+        return 0;
+    }
+
+    std::chrono::high_resolution_clock::time_point compileStart = 
+        std::chrono::high_resolution_clock::now();
+    GLuint shaderId = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderBinary(1, &shaderId, SHADER_BINARY_FORMAT_SPIR_V_ARB, spirvModule.data(), 
+        (GLsizei)spirvModule.size());
+    specializeShader(shaderId, "main", 0, 0, 0);
+    GLint isCompiled = 0;
+    glGetShaderiv(shaderId, GL_COMPILE_STATUS, &isCompiled);
+    putRecordHere->_computeCompileMs = MillisecondsSince(compileStart);
+    if (isCompiled == GL_FALSE)
+    {
+        LogPrintf("SPIR-V module %s didn't specialize, so it will be compiled from GLSL:\n%s\n", 
+            spirvKey.c_str(), GetShaderInfoLog(shaderId).c_str());
+        glDeleteShader(shaderId);
+        return 0;
+    }
+
+    GLuint programId = LinkShaderStages(&shaderId, 1, putRecordHere->_description, 
+        &putRecordHere->_linkMs);
+    if (programId == 0)
+    {
+        return 0;
+    }
+
+    // every compute program here has at least one buffer or uniform, and a name to find it by
+    GLint uniformCount = 0;
+    GLint blockCount = 0;
+    glGetProgramInterfaceiv(programId, GL_UNIFORM, GL_ACTIVE_RESOURCES, &uniformCount);
+    glGetProgramInterfaceiv(programId, GL_SHADER_STORAGE_BLOCK, GL_ACTIVE_RESOURCES, 
+        &blockCount);
+    GLchar name[64] = { 0 };
+    GLsizei nameLength = 0;
+    if (uniformCount > 0)
+    {
+        glGetProgramResourceName(programId, GL_UNIFORM, 0, sizeof(name), &nameLength, name);
+    }
+    else if (blockCount > 0)
+    {
+        glGetProgramResourceName(programId, GL_SHADER_STORAGE_BLOCK, 0, sizeof(name), 
+            &nameLength, name);
+    }
+    if (nameLength <= 0)
+    {
+        LogPrintf("SPIR-V module %s has no names on this driver, so it will be compiled from "
+            "GLSL\n", spirvKey.c_str());
+        DeleteGlProgram(programId);
+        putRecordHere->_computeCompileMs = 0.0f;
+        putRecordHere->_linkMs = 0.0f;
         return 0;
     }
 
+    putRecordHere->_isFromSpirv = true;
+    return programId;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Keeps the record of a build and prints it on one line.
+Parameters:
+    record  Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+static void RecordShaderBuild(const ShaderBuildRecord &record)
+{
+    const char *howBuilt = record._isFromCache ? "cached" : 
+        (record._isFromSpirv ? "from SPIR-V" : "compiled");
+    LogPrintf("shader build '%s': %s, read %.2fms, cache %.2fms, vert %.2fms, frag %.2fms, "
+        "comp %.2fms, link %.2fms\n", record._description.c_str(), 
+        !record._isBuilt ? "failed" : howBuilt,
+        record._fileReadMs, record._cacheLoadMs, record._vertexCompileMs, 
+        record._fragmentCompileMs, record._computeCompileMs, record._linkMs);
+    gShaderBuildRecords.push_back(record);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gets a shader's whole info log.  The log's length is asked for first, so nothing is cut 
+    off, no matter how many errors a driver reports.
+Parameters:
+    shaderId    Self-explanatory.
+Returns:
+    The log, or an empty string if there isn't one.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+std::string GetShaderInfoLog(unsigned int shaderId)
+{
+    GLint logLength = 0;
+    glGetShaderiv(shaderId, GL_INFO_LOG_LENGTH, &logLength);
+    if (logLength <= 0)
+    {
+        return std::string();
+    }
+
+    // the length includes the null terminator
+    std::vector<GLchar> errLog(logLength, 0);
+    glGetShaderInfoLog(shaderId, logLength, 0, errLog.data());
+    return std::string(errLog.data());
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Same as GetShaderInfoLog(...), but for a program's link log.
+Parameters:
+    programId   Self-explanatory.
+Returns:
+    The log, or an empty string if there isn't one.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+std::string GetProgramInfoLog(unsigned int programId)
+{
+    GLint logLength = 0;
+    glGetProgramiv(programId, GL_INFO_LOG_LENGTH, &logLength);
+    if (logLength <= 0)
+    {
+        return std::string();
+    }
+
+    std::vector<GLchar> errLog(logLength, 0);
+    glGetProgramInfoLog(programId, logLength, 0, errLog.data());
+    return std::string(errLog.data());
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.  Includes builds that failed and programs that came from the cache.
+Parameters: None
+Returns:
+    How long every program built since startup took, in the order that they were built.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+const std::vector<ShaderBuildRecord> &GetShaderBuildRecords()
+{
+    return gShaderBuildRecords;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Encapsulates the creation of an OpenGL GPU program, including the compilation and linking of
+    shaders.  It tries to cover all the basics and the error reporting and is as self-contained
+    as possible, only returning a program ID when it is finished.
+
+    In particular, this one loads the vertex and fragment parts of the shader program.
+
+    If a binary of the same program was saved by a previous run (see ShaderBinaryCache.h), it 
+    is loaded instead of compiling.  Either way, how long each stage took is recorded (see 
+    GetShaderBuildRecords()).
+Parameters:
+    vertFilePath        Self-explanatory.
+    fragFilePath        Self-explanatory.
+    vertShaderDefines   Optional "#define" statements to insert after the vertex shader's 
+                        "#version" line.
+Returns:
+    The OpenGL ID of the GPU program, or 0 if it failed to build.
+Exception:  Safe
+Creator:    John Cox (2-13-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int GenerateVertexShaderProgram(const std::string &vertFilePath, 
+    const std::string &fragFilePath, const std::string &vertShaderDefines)
+{
+    TRACE_SCOPE("GenerateVertexShaderProgram");
+    ShaderBuildRecord record = ShaderBuildRecord();
+    record._description = vertFilePath + " + " + fragFilePath;
+    if (!vertShaderDefines.empty())
+    {
+        record._description += " (" + GetDefinesOnOneLine(vertShaderDefines) + ")";
+    }
+
+    // the fragment shader is read up front as well because the cache key covers both stages
+    std::chrono::high_resolution_clock::time_point readStart = 
+        std::chrono::high_resolution_clock::now();
+    std::string vertFileContents = InsertShaderDefines(ReadShaderSource(vertFilePath), 
+        vertShaderDefines);
+    std::string fragFileContents = ReadShaderSource(fragFilePath);
+    record._fileReadMs = MillisecondsSince(readStart);
+
+    // a warm start skips compilation entirely
+    std::chrono::high_resolution_clock::time_point cacheStart = 
+        std::chrono::high_resolution_clock::now();
+    std::string cacheKey = MakeProgramCacheKey(vertFileContents + fragFileContents);
+    GLuint cachedProgramId = LoadCachedProgramBinary(cacheKey);
+    record._cacheLoadMs = MillisecondsSince(cacheStart);
+    if (cachedProgramId != 0)
+    {
+        record._isBuilt = true;
+        record._isFromCache = true;
+        RecordShaderBuild(record);
+        return cachedProgramId;
+    }
+
+    GLuint shaderIds[2] = { 0, 0 };
+    shaderIds[0] = CompileShaderStage(GL_VERTEX_SHADER, vertFileContents, "vertex", 
+        &record._vertexCompileMs);
+    if (shaderIds[0] != 0)
+    {
+        shaderIds[1] = CompileShaderStage(GL_FRAGMENT_SHADER, fragFileContents, "fragment", 
+            &record._fragmentCompileMs);
+    }
+    if (shaderIds[0] == 0 || shaderIds[1] == 0)
+    {
+        glDeleteShader(shaderIds[0]);
+        RecordShaderBuild(record);
+        return 0;
+    }
+
+    GLuint programId = LinkShaderStages(shaderIds, 2, record._description, &record._linkMs);
+    record._isBuilt = (programId != 0);
+    RecordShaderBuild(record);
+    if (programId != 0)
+    {
+        SaveProgramBinary(programId, cacheKey);
+    }
+
     // done here
     return programId;
 }
@@ -119,62 +899,171 @@ Description:
     as possible, only returning a program ID when it is finished.
 
     In particular, this one loads the compute.
-Parameters: None
+
+    If a binary of the same program variant was saved by a previous run (see 
+    ShaderBinaryCache.h), it is loaded instead of compiling.  Either way, how long each stage 
+    took is recorded (see GetShaderBuildRecords()).
+Parameters:
+    shaderDefines   Optional "#define" statements to insert after the "#version" line.  Used 
+                    to select compute shader variants (ex: the particle storage layout).
+    compFilePath    Self-explanatory.
 Returns:
-    The OpenGL ID of the GPU program.
+    The OpenGL ID of the GPU program, or 0 if it failed to build.
 Exception:  Safe
 Creator:    John Cox (7-30-2016)
 -----------------------------------------------------------------------------------------------*/
-unsigned int GenerateComputeShaderProgram()
+unsigned int GenerateComputeShaderProgram(const std::string &shaderDefines, 
+    const std::string &compFilePath)
 {
-    // hard-coded ignoring possible errors like a boss
+    TRACE_SCOPE("GenerateComputeShaderProgram");
+    PendingShaderProgram pending;
+    BeginComputeShaderProgram(shaderDefines, compFilePath, &pending);
+    return FinishComputeShaderProgram(&pending);
+}
 
-    std::ifstream shaderFile("shaderParticle.comp");
-    std::stringstream shaderData;
-    shaderData << shaderFile.rdbuf();
-    shaderFile.close();
-    std::string tempFileContents = shaderData.str();
-    GLuint compShaderId = glCreateShader(GL_COMPUTE_SHADER);
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The first half of GenerateComputeShaderProgram(...).  Reads the file and either loads the 
+    program from the binary cache or hands the compile and the link to the driver, without 
+    asking how either went.  The link is issued right behind the compile, since a failed 
+    compile just makes the link fail too, and FinishComputeShaderProgram(...) looks at the 
+    compile first.
+Parameters:
+    shaderDefines   Same as for GenerateComputeShaderProgram(...).
+    compFilePath    Same as for GenerateComputeShaderProgram(...).
+    putPendingHere  Self-explanatory.  Must be given to FinishComputeShaderProgram(...).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void BeginComputeShaderProgram(const std::string &shaderDefines, 
+    const std::string &compFilePath, PendingShaderProgram *putPendingHere)
+{
+    ShaderBuildRecord &record = putPendingHere->_record;
+    record = ShaderBuildRecord();
+    record._description = compFilePath;
+    if (!shaderDefines.empty())
+    {
+        record._description += " (" + GetDefinesOnOneLine(shaderDefines) + ")";
+    }
+    putPendingHere->_shaderId = 0;
+    putPendingHere->_programId = 0;
+
+    std::chrono::high_resolution_clock::time_point readStart = 
+        std::chrono::high_resolution_clock::now();
+    std::string tempFileContents = InsertShaderDefines(ReadShaderSource(compFilePath), 
+        shaderDefines);
+    record._fileReadMs = MillisecondsSince(readStart);
+    DumpShaderSource(MakeSpirvKey(tempFileContents), tempFileContents);
+
+    // the key is made from the source after the defines are inserted, so each variant gets its 
+    // own cache entry
+    std::chrono::high_resolution_clock::time_point cacheStart = 
+        std::chrono::high_resolution_clock::now();
+    putPendingHere->_cacheKey = MakeProgramCacheKey(tempFileContents);
+    GLuint cachedProgramId = LoadCachedProgramBinary(putPendingHere->_cacheKey);
+    record._cacheLoadMs = MillisecondsSince(cacheStart);
+    if (cachedProgramId != 0)
+    {
+        record._isBuilt = true;
+        record._isFromCache = true;
+        putPendingHere->_programId = cachedProgramId;
+        return;
+    }
+
+    // a cold start on a new driver can still skip the GLSL (see ShaderBinaryCache.h)
+    GLuint spirvProgramId = LoadSpirvComputeProgram(tempFileContents, &record);
+    if (spirvProgramId != 0)
+    {
+        record._isBuilt = true;
+        SaveProgramBinary(spirvProgramId, putPendingHere->_cacheKey);
+        putPendingHere->_programId = spirvProgramId;
+        return;
+    }
+
+    putPendingHere->_compileStart = std::chrono::high_resolution_clock::now();
+    GLuint shaderId = glCreateShader(GL_COMPUTE_SHADER);
     const GLchar *bytes[] = { tempFileContents.c_str() };
     const GLint strLengths[] = { (int)tempFileContents.length() };
-    glShaderSource(compShaderId, 1, bytes, strLengths);
-    glCompileShader(compShaderId);
+    glShaderSource(shaderId, 1, bytes, strLengths);
+    glCompileShader(shaderId);
+
+    GLuint programId = glCreateProgram();
+    if (glext_ARB_get_program_binary)
+    {
+        // must be set before linking or the driver may not keep the binary around
+        glProgramParameteri(programId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glAttachShader(programId, shaderId);
+    glLinkProgram(programId);
+    putPendingHere->_shaderId = shaderId;
+    putPendingHere->_programId = programId;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The second half of GenerateComputeShaderProgram(...).  Waits for the compile and the link 
+    (if the driver isn't done with them already), prints the log if either failed, records the
+    build, and saves a new program to the binary cache.
+
+    Note: The compile's time runs from BeginComputeShaderProgram(...) to here, so it includes 
+    whatever the caller did in between, and the link's is only what was left of it by the time
+    that the compile was done.
+Parameters:
+    pending     From BeginComputeShaderProgram(...).  Finished with afterward.
+Returns:
+    The OpenGL ID of the GPU program, or 0 if it failed to build.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int FinishComputeShaderProgram(PendingShaderProgram *pending)
+{
+    ShaderBuildRecord &record = pending->_record;
+    GLuint shaderId = pending->_shaderId;
+    GLuint programId = pending->_programId;
+    pending->_shaderId = 0;
+    pending->_programId = 0;
+    if (shaderId == 0)
+    {
+        // from the cache, or the file couldn't be made into a shader at all
+        RecordShaderBuild(record);
+        return programId;
+    }
 
     GLint isCompiled = 0;
-    glGetShaderiv(compShaderId, GL_COMPILE_STATUS, &isCompiled);
+    glGetShaderiv(shaderId, GL_COMPILE_STATUS, &isCompiled);
+    record._computeCompileMs = MillisecondsSince(pending->_compileStart);
+    std::chrono::high_resolution_clock::time_point linkStart = 
+        std::chrono::high_resolution_clock::now();
     if (isCompiled == GL_FALSE)
     {
-        GLchar errLog[128];
-        GLsizei *logLen = 0;
-        glGetShaderInfoLog(compShaderId, 128, logLen, errLog);
-        printf("compute shader failed: '%s'\n", errLog);
-        glDeleteShader(compShaderId);
-        return 0;
+        LogPrintf("compute shader failed:\n%s\n", GetShaderInfoLog(shaderId).c_str());
     }
 
-    GLuint programId = glCreateProgram();
-    glAttachShader(programId, compShaderId);
-    glLinkProgram(programId);
-
-    // the program contains binary, linked versions of the shaders, so clean up the compile 
-    // objects
     // Note: Shader objects need to be un-linked before they can be deleted.  This is ok because
     // the program safely contains the shaders in binary form.
-    glDetachShader(programId, compShaderId);
-    glDeleteShader(compShaderId);
+    glDetachShader(programId, shaderId);
+    glDeleteShader(shaderId);
 
-    // check if the program was built ok
     GLint isLinked = 0;
     glGetProgramiv(programId, GL_LINK_STATUS, &isLinked);
-    if (isLinked == GL_FALSE)
+    record._linkMs = MillisecondsSince(linkStart);
+    if (isCompiled == GL_FALSE || isLinked == GL_FALSE)
     {
-        printf("compute program didn't compile\n");
-        glDeleteProgram(programId);
+        if (isCompiled != GL_FALSE)
+        {
+            LogPrintf("program '%s' didn't link:\n%s\n", record._description.c_str(), 
+                GetProgramInfoLog(programId).c_str());
+        }
+        DeleteGlProgram(programId);
+        RecordShaderBuild(record);
         return 0;
     }
 
+    record._isBuilt = true;
+    RecordShaderBuild(record);
+    SaveProgramBinary(programId, pending->_cacheKey);
+
     // done here
     return programId;
 }
-
-
@@ -1,5 +1,82 @@
 #pragma once
 
-// this is a "barebones" program, so the file names are hard-coded
-unsigned int GenerateVertexShaderProgram();
-unsigned int GenerateComputeShaderProgram();
+#include <string>
+#include <vector>
+#include <chrono>
+
+// how long one program took to build, for the startup timings
+// Note: A stage's time runs from handing its source to the driver until its status comes back,
+// because drivers are free to put off the real work until someone asks.  Stages that weren't 
+// built (ex: a program that came from the binary cache) are 0.
+struct ShaderBuildRecord
+{
+    std::string _description;
+    bool _isBuilt;
+    bool _isFromCache;
+    bool _isFromSpirv;
+    float _fileReadMs;
+    float _cacheLoadMs;
+    float _vertexCompileMs;
+    float _fragmentCompileMs;
+    float _computeCompileMs;
+    float _linkMs;
+};
+
+// this is a "barebones" program, so the file names default to the particle shaders
+// Note: The density resolve pass (see DensitySplatRenderer.h) gives its own vertex and fragment
+// shader files, and the scan (see GpuScan.h) gives its own compute shader file.
+// Note: The compute shader can be given a block of "#define" statements, such as the one that 
+// selects the particle storage layout.  It is inserted immediately after the "#version" line.  
+// The vertex shader (not the fragment shader) can be given one too (ex: vertex pulling; see 
+// ParticleManager::GetRenderShaderDefines(...)).
+unsigned int GenerateVertexShaderProgram(const std::string &vertFilePath = "shaderParticle.vert",
+    const std::string &fragFilePath = "shaderParticle.frag", 
+    const std::string &vertShaderDefines = "");
+unsigned int GenerateComputeShaderProgram(const std::string &shaderDefines = "", 
+    const std::string &compFilePath = "shaderParticle.comp");
+
+// a compute program that has been handed to the driver but not asked about yet
+// Note: Drivers compile on threads of their own (GL_ARB_parallel_shader_compile, or just 
+// a threaded driver), but only until someone asks for the status, which waits for it.  
+// BeginComputeShaderProgram(...) starts the compile and the link and returns, so the CPU can 
+// go do something else, and FinishComputeShaderProgram(...) does the asking.  A program that 
+// was in the binary cache is already finished when it begins.
+struct PendingShaderProgram
+{
+    std::string _cacheKey;
+    unsigned int _shaderId;
+    unsigned int _programId;
+    ShaderBuildRecord _record;
+    std::chrono::high_resolution_clock::time_point _compileStart;
+};
+void BeginComputeShaderProgram(const std::string &shaderDefines, 
+    const std::string &compFilePath, PendingShaderProgram *putPendingHere);
+unsigned int FinishComputeShaderProgram(PendingShaderProgram *pending);
+
+// also used to rebuild compute variants from new source (see ShaderHotReload.h)
+// Note: A variant can also splice a file of its own into the shader, with a '#include NAME' 
+// line in the shader and a '#define NAME "file"' in its defines (ex: a custom update, see 
+// ParticleKernelVariant::_customUpdateFilePath).  The hot reloader watches those files too 
+// (see AddDefinedIncludeDependencies(...)).
+std::string InsertShaderDefines(const std::string &unexpandedSource, 
+    const std::string &shaderDefines);
+void AddDefinedIncludeDependencies(const std::string &shaderDefines, 
+    std::vector<std::string> *putDependenciesHere);
+
+// shader files can share code with '#include "file"' lines, which the loader expands (see 
+// ReadShaderSource(...))
+// Note: Every file is read once and every expansion is kept, so the variants of one shader 
+// don't read or assemble it again.  The hot reloader hands in the files that changed (see 
+// UpdateShaderFile(...)), which drops the expansions that used them, so only the programs that
+// include a changed file are rebuilt.
+std::string ReadShaderSource(const std::string &filePath, 
+    std::vector<std::string> *putDependenciesHere = 0);
+void UpdateShaderFile(const std::string &filePath, const std::string &fileContents);
+std::vector<std::string> GetLoadedShaderFiles();
+
+// the whole info log, however long, for printing build failures
+std::string GetShaderInfoLog(unsigned int shaderId);
+std::string GetProgramInfoLog(unsigned int programId);
+
+// every program built since startup, in order
+const std::vector<ShaderBuildRecord> &GetShaderBuildRecords();
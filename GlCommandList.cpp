@@ -0,0 +1,352 @@
+#include "GlCommandList.h"
+
+#include "glload/include/glload/gl_4_4.h"
+
+#include <string.h>
+
+// what each packet does (see GlCommandList::Execute())
+enum GlCommandType
+{
+    GL_COMMAND_BUFFER_SUB_DATA = 0,
+    GL_COMMAND_PROGRAM_UNIFORM_1F,
+    GL_COMMAND_PROGRAM_UNIFORM_2F,
+    GL_COMMAND_PROGRAM_UNIFORM_MATRIX4,
+    GL_COMMAND_CALL,
+};
+
+// at the start of every packet
+// Note: The size is the whole packet's, header included, so that Execute() can step over it.
+struct GlCommandHeader
+{
+    unsigned int _type;
+    unsigned int _sizeBytes;
+};
+
+// every packet starts on this, so that the values in it can be read in place
+// Note: Also the alignment of the arena's memory from operator new on every platform that
+// this builds for.
+static const size_t GL_COMMAND_ALIGNMENT = 16;
+static const size_t GL_COMMAND_HEADER_SIZE =
+    ((sizeof(GlCommandHeader) + GL_COMMAND_ALIGNMENT - 1) / GL_COMMAND_ALIGNMENT) *
+    GL_COMMAND_ALIGNMENT;
+
+// the values of each kind of packet, which come right after the header
+struct BufferSubDataCommand
+{
+    unsigned int _bufferId;
+    size_t _offsetBytes;
+    size_t _sizeBytes;
+    // followed by the bytes
+};
+
+struct ProgramUniformCommand
+{
+    unsigned int _programId;
+    int _location;
+    float _values[16];
+};
+
+struct CallCommand
+{
+    GlCommandList::CallFunction _function;
+    // followed by the arguments
+};
+static const size_t CALL_COMMAND_SIZE =
+    ((sizeof(CallCommand) + GL_COMMAND_ALIGNMENT - 1) / GL_COMMAND_ALIGNMENT) *
+    GL_COMMAND_ALIGNMENT;
+static const size_t BUFFER_SUB_DATA_COMMAND_SIZE =
+    ((sizeof(BufferSubDataCommand) + GL_COMMAND_ALIGNMENT - 1) / GL_COMMAND_ALIGNMENT) *
+    GL_COMMAND_ALIGNMENT;
+
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Ensures that the list starts empty.  The arena grows on the first recordings.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+GlCommandList::GlCommandList() :
+    _usedBytes(0),
+    _commandCount(0)
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Forgets every command, but keeps the arena's memory for the next recording.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GlCommandList::Reset()
+{
+    _usedBytes = 0;
+    _commandCount = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Records a glBufferSubData(...) of a copy of the data, so the caller's memory can be
+    reused as soon as this returns.
+Parameters:
+    bufferId        Self-explanatory.
+    offsetBytes     Self-explanatory.
+    data            Self-explanatory.
+    sizeBytes       Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GlCommandList::RecordBufferSubData(unsigned int bufferId, size_t offsetBytes,
+    const void *data, size_t sizeBytes)
+{
+    unsigned char *payload =
+        this->AddCommand(GL_COMMAND_BUFFER_SUB_DATA, BUFFER_SUB_DATA_COMMAND_SIZE + sizeBytes);
+    BufferSubDataCommand command;
+    command._bufferId = bufferId;
+    command._offsetBytes = offsetBytes;
+    command._sizeBytes = sizeBytes;
+    memcpy(payload, &command, sizeof(command));
+    memcpy(payload + BUFFER_SUB_DATA_COMMAND_SIZE, data, sizeBytes);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Records a glProgramUniform1f(...), which doesn't need the program to be in use.
+Parameters:
+    programId   Self-explanatory.
+    location    Self-explanatory.
+    value       Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GlCommandList::RecordProgramUniform1f(unsigned int programId, int location, float value)
+{
+    ProgramUniformCommand command;
+    command._programId = programId;
+    command._location = location;
+    command._values[0] = value;
+    memcpy(this->AddCommand(GL_COMMAND_PROGRAM_UNIFORM_1F, sizeof(command)), &command,
+        sizeof(command));
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Records a glProgramUniform2f(...).
+Parameters:
+    programId   Self-explanatory.
+    location    Self-explanatory.
+    x           Self-explanatory.
+    y           Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GlCommandList::RecordProgramUniform2f(unsigned int programId, int location, float x,
+    float y)
+{
+    ProgramUniformCommand command;
+    command._programId = programId;
+    command._location = location;
+    command._values[0] = x;
+    command._values[1] = y;
+    memcpy(this->AddCommand(GL_COMMAND_PROGRAM_UNIFORM_2F, sizeof(command)), &command,
+        sizeof(command));
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Records a glProgramUniformMatrix4fv(...) of one matrix.
+Parameters:
+    programId           Self-explanatory.
+    location            Self-explanatory.
+    columnMajorValues   16 floats, as glm lays them out.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GlCommandList::RecordProgramUniformMatrix4(unsigned int programId, int location,
+    const float *columnMajorValues)
+{
+    ProgramUniformCommand command;
+    command._programId = programId;
+    command._location = location;
+    memcpy(command._values, columnMajorValues, sizeof(command._values));
+    memcpy(this->AddCommand(GL_COMMAND_PROGRAM_UNIFORM_MATRIX4, sizeof(command)), &command,
+        sizeof(command));
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Records a call of the function with a copy of the arguments.  Usually reached through the
+    typed RecordCall<...>(...).
+Parameters:
+    function            Called on the GL thread with a pointer to the copy.
+    arguments           Self-explanatory.
+    argumentSizeBytes   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GlCommandList::RecordCall(CallFunction function, const void *arguments,
+    size_t argumentSizeBytes)
+{
+    unsigned char *payload =
+        this->AddCommand(GL_COMMAND_CALL, CALL_COMMAND_SIZE + argumentSizeBytes);
+    CallCommand command;
+    command._function = function;
+    memcpy(payload, &command, sizeof(command));
+    memcpy(payload + CALL_COMMAND_SIZE, arguments, argumentSizeBytes);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Makes the recorded calls in the order that they were recorded.  Must be called on the GL
+    thread.  The list is left as it is, so it can be executed again or reset.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GlCommandList::Execute() const
+{
+    size_t commandOffset = 0;
+    while (commandOffset < _usedBytes)
+    {
+        const unsigned char *packet = _arena.data() + commandOffset;
+        GlCommandHeader header;
+        memcpy(&header, packet, sizeof(header));
+        const unsigned char *payload = packet + GL_COMMAND_HEADER_SIZE;
+        switch (header._type)
+        {
+        case GL_COMMAND_BUFFER_SUB_DATA:
+        {
+            const BufferSubDataCommand *command = (const BufferSubDataCommand *)payload;
+            glBindBuffer(GL_COPY_WRITE_BUFFER, command->_bufferId);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)command->_offsetBytes,
+                (GLsizeiptr)command->_sizeBytes, payload + BUFFER_SUB_DATA_COMMAND_SIZE);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            break;
+        }
+        case GL_COMMAND_PROGRAM_UNIFORM_1F:
+        {
+            const ProgramUniformCommand *command = (const ProgramUniformCommand *)payload;
+            glProgramUniform1f(command->_programId, command->_location, command->_values[0]);
+            break;
+        }
+        case GL_COMMAND_PROGRAM_UNIFORM_2F:
+        {
+            const ProgramUniformCommand *command = (const ProgramUniformCommand *)payload;
+            glProgramUniform2f(command->_programId, command->_location, command->_values[0],
+                command->_values[1]);
+            break;
+        }
+        case GL_COMMAND_PROGRAM_UNIFORM_MATRIX4:
+        {
+            const ProgramUniformCommand *command = (const ProgramUniformCommand *)payload;
+            glProgramUniformMatrix4fv(command->_programId, command->_location, 1, GL_FALSE,
+                command->_values);
+            break;
+        }
+        case GL_COMMAND_CALL:
+        {
+            const CallCommand *command = (const CallCommand *)payload;
+            command->_function(payload + CALL_COMMAND_SIZE);
+            break;
+        }
+        default:
+            break;
+        }
+        commandOffset += header._sizeBytes;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The number of commands that have been recorded since the last Reset().
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int GlCommandList::GetCommandCount() const
+{
+    return _commandCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How much of the arena the recorded commands take up, headers and padding included.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+size_t GlCommandList::GetSizeBytes() const
+{
+    return _usedBytes;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Puts a packet's header at the end of the arena and makes room for its values after it,
+    growing the arena if it has to.  The next packet starts at the next aligned byte.
+Parameters:
+    commandType         One of the GL_COMMAND_* values.
+    payloadSizeBytes    Self-explanatory.
+Returns:
+    A pointer to where the values go.  Only good until the next command is added, since the
+    arena may move when it grows.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned char *GlCommandList::AddCommand(unsigned int commandType, size_t payloadSizeBytes)
+{
+    size_t packetSizeBytes = GL_COMMAND_HEADER_SIZE + payloadSizeBytes;
+    packetSizeBytes = ((packetSizeBytes + GL_COMMAND_ALIGNMENT - 1) / GL_COMMAND_ALIGNMENT) *
+        GL_COMMAND_ALIGNMENT;
+    if (_usedBytes + packetSizeBytes > _arena.size())
+    {
+        // doubling, so a frame's worth of recording settles after a few frames
+        size_t arenaSizeBytes = (_arena.size() > 0) ? _arena.size() : 4096;
+        while (arenaSizeBytes < _usedBytes + packetSizeBytes)
+        {
+            arenaSizeBytes *= 2;
+        }
+        _arena.resize(arenaSizeBytes);
+    }
+
+    unsigned char *packet = _arena.data() + _usedBytes;
+    GlCommandHeader header;
+    header._type = commandType;
+    header._sizeBytes = (unsigned int)packetSizeBytes;
+    memcpy(packet, &header, sizeof(header));
+    _usedBytes += packetSizeBytes;
+    _commandCount++;
+    return packet + GL_COMMAND_HEADER_SIZE;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Executes lists that were recorded in parallel, one after another in the order that they
+    are in, which is the order that a single thread would have recorded them in if each one
+    was a contiguous part of the work.
+Parameters:
+    commandLists    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ExecuteGlCommandLists(const std::vector<GlCommandList> &commandLists)
+{
+    for (size_t listIndex = 0; listIndex < commandLists.size(); listIndex++)
+    {
+        commandLists[listIndex].Execute();
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+#include <type_traits>
+#include <stddef.h>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    A list of GL work that is recorded on any thread and executed later on the GL thread, so
+    that the CPU's share of a frame (working out the new values, packing them up) can be split
+    across threads while every GL call still comes from the one thread that owns the context.
+
+    The commands are small packets in one linear arena: a header and then the command's values
+    inline, uploads included, so recording never allocates once the arena has grown to a
+    frame's worth and Reset() keeps that memory for the next frame.  Execute() walks the
+    packets in the order that they were recorded.  Work that is split across threads records
+    into one list per task and executes the lists in task order (see ExecuteGlCommandLists(...)),
+    so the order is the same however the tasks were scheduled.
+
+    Besides the GL commands, a packet can call a function with a copy of a value (see
+    RecordCall(...)), for the work that goes through a class instead of straight to GL (ex:
+    ParticleManager::SetEmitter(...)).
+
+    Note: A list is only ever touched by one thread at a time: the one recording it, and then
+    the GL thread.  Handing it over is the caller's job (ex: FramePrepPipeline's handoff).
+    Also Note: Buffer and program names are recorded as they are, so the objects must still be
+    alive when the list is executed.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class GlCommandList
+{
+public:
+    typedef void (*CallFunction)(const void *arguments);
+
+    GlCommandList();
+    void Reset();
+
+    void RecordBufferSubData(unsigned int bufferId, size_t offsetBytes, const void *data,
+        size_t sizeBytes);
+    void RecordProgramUniform1f(unsigned int programId, int location, float value);
+    void RecordProgramUniform2f(unsigned int programId, int location, float x, float y);
+    void RecordProgramUniformMatrix4(unsigned int programId, int location,
+        const float *columnMajorValues);
+    void RecordCall(CallFunction function, const void *arguments, size_t argumentSizeBytes);
+
+    // calls Function with a copy of the arguments when the list is executed
+    // Note: The copy is a memcpy(...), so the type can't own anything.  That is checked as
+    // having nothing to destroy, since glm's vectors have copy constructors of their own and
+    // so aren't "trivially copyable", though they are only floats.
+    template <typename ArgumentType, void (*Function)(const ArgumentType &)>
+    void RecordCall(const ArgumentType &arguments)
+    {
+        static_assert(std::is_trivially_destructible<ArgumentType>::value,
+            "recorded arguments are copied as bytes");
+        this->RecordCall(&CallWithArguments<ArgumentType, Function>, &arguments,
+            sizeof(arguments));
+    }
+
+    void Execute() const;
+    unsigned int GetCommandCount() const;
+    size_t GetSizeBytes() const;
+
+private:
+    template <typename ArgumentType, void (*Function)(const ArgumentType &)>
+    static void CallWithArguments(const void *arguments)
+    {
+        Function(*(const ArgumentType *)arguments);
+    }
+
+    unsigned char *AddCommand(unsigned int commandType, size_t payloadSizeBytes);
+
+    // the packets, back to back, and how much of the arena this frame has used
+    // Note: The arena isn't cleared, only rewound, so its memory is kept from frame to frame.
+    std::vector<unsigned char> _arena;
+    size_t _usedBytes;
+    unsigned int _commandCount;
+};
+
+void ExecuteGlCommandLists(const std::vector<GlCommandList> &commandLists);
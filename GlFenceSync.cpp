@@ -0,0 +1,312 @@
+#include "GlFenceSync.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "Log.h"
+#include "TraceTimeline.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+// a wait that goes on this long is logged, even if it has longer to go, and a wait without
+// a timeout is logged again every time it goes on this much longer
+// Note: 1 second, in nanoseconds.  A frame or two behind is a stall; this far behind, the GPU
+// has most likely hung or been lost.
+static const unsigned long long GL_FENCE_REPORT_INTERVAL_NS = 1000000000;
+
+// every wait counts itself, so the count is atomic; a stall has already blocked, so its stats
+// can take a lock
+// Note: The waits themselves are per thread (a fence belongs to its context), but the stats
+// are for the whole program, like the heap allocation count (see AllocationCounter.h).
+static std::atomic<unsigned long long> gFenceWaitCount(0);
+static std::mutex gFenceStallMutex;
+static GlFenceStallStats gFenceStallStats = { 0, 0, 0, 0, 0, 0, 0 };
+
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Adds the outcome of a wait that didn't find its fence already signaled to the stall stats.
+Parameters:
+    name        What the wait was for.
+    stallNs     How long the wait blocked.
+    result      What it came to.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static void RecordGlFenceStall(const char *name, unsigned long long stallNs,
+    GlFenceWaitResult result)
+{
+    std::lock_guard<std::mutex> lock(gFenceStallMutex);
+    gFenceStallStats._stallCount++;
+    gFenceStallStats._stallNs += stallNs;
+    if (stallNs >= gFenceStallStats._maxStallNs)
+    {
+        gFenceStallStats._maxStallNs = stallNs;
+        gFenceStallStats._maxStallName = name;
+    }
+    if (result == GL_FENCE_TIMED_OUT)
+    {
+        gFenceStallStats._timeoutCount++;
+    }
+    else if (result == GL_FENCE_WAIT_FAILED)
+    {
+        gFenceStallStats._failedCount++;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Checks whether the GPU has gotten to the fence yet, without waiting for it.
+
+    Note: Doesn't flush.  The fence has to have been flushed by something else (ex: the
+    buffer swap, or a wait on a later fence), or else polling it could go on forever.  That is
+    always the case for a readback that is polled once a frame.
+Parameters:
+    fence   May be empty, which counts as signaled.
+Returns:
+    True if the commands before the fence are done, otherwise false.  A fence that GL fails
+    to check is taken as signaled, since waiting longer won't help.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool IsGlFenceSignaled(void *fence)
+{
+    if (fence == 0)
+    {
+        return true;
+    }
+
+    GLenum waitResult = glClientWaitSync((GLsync)fence, 0, 0);
+    return (waitResult != GL_TIMEOUT_EXPIRED);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Blocks until the GPU gets to the fence or the time runs out.
+
+    The fence is polled first, with the flush bit so that it is sure to reach the GPU, and a
+    fence that is already signaled costs nothing more.  Otherwise the wait is a stall: it is
+    timed, added to the stall stats, and put on the trace under the given name.  A wait that
+    goes on for long (see GL_FENCE_REPORT_INTERVAL_NS) is logged while it waits, and one that
+    runs out of time or fails is logged when it gives up.
+Parameters:
+    fence       May be empty, which counts as signaled.
+    timeoutNs   How long to wait at most, or GL_FENCE_WAIT_FOREVER.
+    name        What the wait is for, for the log and the trace.  Must be a string literal.
+Returns:
+    What the wait came to.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+GlFenceWaitResult WaitForGlFence(void *fence, unsigned long long timeoutNs, const char *name)
+{
+    gFenceWaitCount++;
+    if (fence == 0)
+    {
+        return GL_FENCE_SIGNALED;
+    }
+
+    GLsync sync = (GLsync)fence;
+    GLenum waitResult = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (waitResult == GL_ALREADY_SIGNALED || waitResult == GL_CONDITION_SATISFIED)
+    {
+        return GL_FENCE_SIGNALED;
+    }
+
+    long long traceBeginNs = IsTracing() ? GetTraceTimeNs() : -1;
+    std::chrono::steady_clock::time_point stallStart = std::chrono::steady_clock::now();
+    unsigned long long waitedNs = 0;
+    unsigned long long nextReportNs = GL_FENCE_REPORT_INTERVAL_NS;
+
+    // waits in steps so that a long wait is reported while it is still going
+    while (waitResult == GL_TIMEOUT_EXPIRED && waitedNs < timeoutNs)
+    {
+        unsigned long long stepNs = nextReportNs - waitedNs;
+        if (timeoutNs - waitedNs < stepNs)
+        {
+            stepNs = timeoutNs - waitedNs;
+        }
+        waitResult = glClientWaitSync(sync, 0, stepNs);
+        waitedNs = (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - stallStart).count();
+
+        if (waitResult == GL_TIMEOUT_EXPIRED && waitedNs >= nextReportNs &&
+            waitedNs < timeoutNs)
+        {
+            LogErrorPrintf("gpu fence: still waiting on %s after %.0f ms\n", name,
+                waitedNs / 1000000.0);
+            nextReportNs = waitedNs + GL_FENCE_REPORT_INTERVAL_NS;
+        }
+    }
+
+    GlFenceWaitResult result = GL_FENCE_SIGNALED;
+    if (waitResult == GL_TIMEOUT_EXPIRED)
+    {
+        result = GL_FENCE_TIMED_OUT;
+        LogErrorPrintf("gpu fence: gave up on %s after %.3f ms\n", name, waitedNs / 1000000.0);
+    }
+    else if (waitResult == GL_WAIT_FAILED)
+    {
+        result = GL_FENCE_WAIT_FAILED;
+        LogErrorPrintf("gpu fence: the wait on %s failed\n", name);
+    }
+
+    RecordGlFenceStall(name, waitedNs, result);
+    if (traceBeginNs >= 0)
+    {
+        TraceCpuEvent(name, traceBeginNs);
+    }
+    return result;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    putStatsHere    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GetGlFenceStallStats(GlFenceStallStats *putStatsHere)
+{
+    if (putStatsHere == 0)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(gFenceStallMutex);
+    *putStatsHere = gFenceStallStats;
+    putStatsHere->_waitCount = gFenceWaitCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Starts the stall stats over, so that the next ones are only for what comes after.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ResetGlFenceStallStats()
+{
+    std::lock_guard<std::mutex> lock(gFenceStallMutex);
+    GlFenceStallStats emptyStats = { 0, 0, 0, 0, 0, 0, 0 };
+    gFenceStallStats = emptyStats;
+    gFenceWaitCount = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Ensures that the ring starts with no slots.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+GlFenceRing::GlFenceRing() :
+    _nextSlot(0),
+    _name("fence ring")
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives the ring its slots, none of them fenced.  Any fences from before are deleted.
+Parameters:
+    slotCount   At least 1.
+    name        What the ring is for, for the log and the trace.  Must be a string literal.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GlFenceRing::Init(unsigned int slotCount, const char *name)
+{
+    _fences.clear();
+    _fences.resize(slotCount);
+    _nextSlot = 0;
+    _name = name;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Deletes the fences.  They may still be pending, which is fine.  Must be called while the
+    context is still current.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GlFenceRing::Cleanup()
+{
+    _fences.clear();
+    _nextSlot = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Waits until the GPU is done with what was last fenced in the next slot.  The caller fills
+    in that slot, issues the commands that use it, and then calls FenceSlot(...).
+
+    Note: With a slot for each frame in flight, this almost never actually waits, and when it
+    does, the stall is counted (see WaitForGlFence(...)).  A slot can't be handed out before
+    the GPU is done with it, so this waits for as long as it takes and keeps logging while it
+    does.
+Parameters: None
+Returns:
+    The slot that is now free to write.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int GlFenceRing::AcquireSlot()
+{
+    unsigned int slotIndex = _nextSlot;
+    WaitForGlFence(_fences[slotIndex], GL_FENCE_WAIT_FOREVER, _name);
+    _fences[slotIndex].Reset();
+    return slotIndex;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Fences the slot after the commands that use it and moves the ring on to the next slot.
+Parameters:
+    slotIndex   From AcquireSlot().
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GlFenceRing::FenceSlot(unsigned int slotIndex)
+{
+    _fences[slotIndex] = InsertGlFence();
+    _nextSlot = (slotIndex + 1) % _fences.size();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Checks whether the GPU is done with what was last fenced in the slot, without waiting.
+Parameters:
+    slotIndex   Self-explanatory.
+Returns:
+    True if the slot is free (or was never fenced), otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool GlFenceRing::IsSlotReady(unsigned int slotIndex) const
+{
+    return IsGlFenceSignaled(_fences[slotIndex]);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    Self-explanatory.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int GlFenceRing::GetSlotCount() const
+{
+    return (unsigned int)_fences.size();
+}
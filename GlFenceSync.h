@@ -0,0 +1,85 @@
+#pragma once
+
+#include "GlObjects.h"
+
+#include <vector>
+
+// what a wait on a fence came to
+enum GlFenceWaitResult
+{
+    GL_FENCE_SIGNALED = 0,
+    GL_FENCE_TIMED_OUT,
+    GL_FENCE_WAIT_FAILED,
+};
+
+// a timeout for WaitForGlFence(...) that never runs out
+// Note: The wait still logs once it has gone on for long enough to be a problem (see
+// GlFenceSync.cpp), so a GPU that has hung doesn't hang the program silently.
+const unsigned long long GL_FENCE_WAIT_FOREVER = ~0ULL;
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    What the fence waits have cost the CPU since the stats were last reset.  A stall is a wait
+    on a fence that wasn't signaled yet when it was first polled, so a wait that didn't stall
+    cost nothing but the poll.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+struct GlFenceStallStats
+{
+    unsigned long long _waitCount;
+    unsigned long long _stallCount;
+    unsigned long long _stallNs;
+    unsigned long long _maxStallNs;
+    const char *_maxStallName;
+    unsigned long long _timeoutCount;
+    unsigned long long _failedCount;
+};
+
+// the one place that the program waits on the GPU with glClientWaitSync(...) (see
+// GlFenceSync.cpp)
+// Note: IsGlFenceSignaled(...) only polls and never blocks, so it is for readbacks that take
+// what is ready and come back for the rest later.  WaitForGlFence(...) blocks, and every time
+// that it has to, the stall is counted, is put on the trace (see TraceTimeline.h), and, if it
+// runs out of time or fails, is logged.  The GPU profiler prints the stall stats with its own
+// (see GpuProfiler::PrintStats()).
+// Also Note: The fence is the GLsync as a void pointer (a GlFence converts to one), so the
+// header stays free of OpenGL.  An empty fence counts as signaled, so a slot that was never
+// fenced is ready.  The name must be a string literal, since only the pointer is kept.
+bool IsGlFenceSignaled(void *fence);
+GlFenceWaitResult WaitForGlFence(void *fence, unsigned long long timeoutNs, const char *name);
+void GetGlFenceStallStats(GlFenceStallStats *putStatsHere);
+void ResetGlFenceStallStats();
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    A fence for each slot of a ring of memory that the CPU writes and the GPU reads (or the
+    other way around), such as a persistently mapped buffer with a part for each frame in
+    flight.
+
+    AcquireSlot(...) gives the next slot once the GPU is done with what was last fenced in
+    it, and FenceSlot(...) fences the slot after the commands that use it and moves the ring
+    on.  A slot that is acquired and then not fenced (ex: a pass that found nothing to do) is
+    given out again next time.  IsSlotReady(...) polls a slot without waiting, for a ring
+    that is read back from.
+
+    Note: Only for the thread that owns the context, like the fences themselves.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class GlFenceRing
+{
+public:
+    GlFenceRing();
+    void Init(unsigned int slotCount, const char *name);
+    void Cleanup();
+
+    unsigned int AcquireSlot();
+    void FenceSlot(unsigned int slotIndex);
+    bool IsSlotReady(unsigned int slotIndex) const;
+    unsigned int GetSlotCount() const;
+
+private:
+    // moves, but doesn't copy, like the fences
+    std::vector<GlFence> _fences;
+    unsigned int _nextSlot;
+    const char *_name;
+};
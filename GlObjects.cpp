@@ -0,0 +1,210 @@
+#include "GlObjects.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
+#include "ShaderProgramRegistry.h"
+#include "GpuMemoryLedger.h"
+
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Also takes the buffer out of the GPU memory ledger (see GpuMemoryLedger.h).  0 is ignored.
+Parameters:
+    bufferId    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void DeleteGlBuffer(unsigned int bufferId)
+{
+    if (bufferId != 0)
+    {
+        ForgetGpuAllocation(GPU_MEMORY_BUFFER, bufferId);
+        DeleteGlBuffers(1, &bufferId);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.  0 is ignored.
+Parameters:
+    vaoId   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void DeleteGlVertexArray(unsigned int vaoId)
+{
+    if (vaoId != 0)
+    {
+        DeleteGlVertexArrays(1, &vaoId);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Also takes the texture out of the GPU memory ledger (see GpuMemoryLedger.h).  0 is
+    ignored.
+Parameters:
+    textureId   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void DeleteGlTexture(unsigned int textureId)
+{
+    if (textureId != 0)
+    {
+        ForgetGpuAllocation(GPU_MEMORY_TEXTURE, textureId);
+        glDeleteTextures(1, &textureId);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.  0 is ignored.
+Parameters:
+    queryId     Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void DeleteGlQuery(unsigned int queryId)
+{
+    if (queryId != 0)
+    {
+        glDeleteQueries(1, &queryId);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Deletes a GLsync.  A fence that the GPU hasn't gotten to yet is fine to delete; it just
+    can't be waited on anymore.  0 is ignored.
+Parameters:
+    fence   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void DeleteGlFence(void *fence)
+{
+    if (fence != 0)
+    {
+        glDeleteSync((GLsync)fence);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives back one reference to a program in the program registry, which deletes the program
+    if it was the last one (see ReleaseProgram(...)).  0 is ignored.
+Parameters:
+    programId   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ReleaseGlProgram(unsigned int programId)
+{
+    ReleaseProgram(programId);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    A new buffer name.  Like glGenBuffers(...), there is no storage until it is first bound
+    and given some.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+GlBuffer GenerateGlBuffer()
+{
+    GLuint bufferId = 0;
+    glGenBuffers(1, &bufferId);
+    return GlBuffer(bufferId);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    A new vertex array object name.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+GlVertexArray GenerateGlVertexArray()
+{
+    GLuint vaoId = 0;
+    glGenVertexArrays(1, &vaoId);
+    return GlVertexArray(vaoId);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    A new texture name.  Like glGenTextures(...), it has no target until it is first bound.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+GlTexture GenerateGlTexture()
+{
+    GLuint textureId = 0;
+    glGenTextures(1, &textureId);
+    return GlTexture(textureId);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    A new query object name.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+GlQuery GenerateGlQuery()
+{
+    GLuint queryId = 0;
+    glGenQueries(1, &queryId);
+    return GlQuery(queryId);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Puts a fence into the command stream after everything that has been issued so far.
+Parameters: None
+Returns:
+    The fence, which is signaled when the GPU has finished those commands.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+GlFence InsertGlFence()
+{
+    return GlFence(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes a reference to a program in the program registry (see AddProgramReference(...)),
+    so the caller's own reference can be released right away.
+Parameters:
+    programId   May be 0, which gives an empty handle.
+Returns:
+    A handle that holds the new reference.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+GlProgram ReferenceGlProgram(unsigned int programId)
+{
+    if (programId != 0)
+    {
+        AddProgramReference(programId);
+    }
+    return GlProgram(programId);
+}
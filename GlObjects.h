@@ -0,0 +1,116 @@
+#pragma once
+
+// the functions that give each kind of handle back to OpenGL
+// Note: They are defined in GlObjects.cpp so that the large OpenGL header stays out of here,
+// and each one ignores a handle of 0, like glDelete*(...) does.
+void DeleteGlBuffer(unsigned int bufferId);
+void DeleteGlVertexArray(unsigned int vaoId);
+void DeleteGlTexture(unsigned int textureId);
+void DeleteGlQuery(unsigned int queryId);
+void DeleteGlFence(void *fence);
+void ReleaseGlProgram(unsigned int programId);
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Owns a single OpenGL object and gives it back when it goes out of scope.  It can be moved,
+    which hands the object over and leaves this one empty, but not copied, so two owners can
+    never delete the same object.  An empty handle is 0 and deletes nothing, so a member that
+    was never set up is safe to clean up.
+
+    The handle converts to the plain ID (or GLsync, stored as a void pointer), so it can be
+    handed straight to the GL functions that use the object.  Only the functions that create
+    or delete the object need to know that it is a handle.
+
+    Note: Meant to be used through the typedefs below.  Needs the context that made the object
+    to still be current when it is deleted.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+template <typename HandleType, void (*DeleteHandle)(HandleType)>
+class GlHandle
+{
+public:
+    GlHandle() :
+        _handle(0)
+    {
+    }
+
+    // takes over an object that someone else created
+    explicit GlHandle(HandleType handle) :
+        _handle(handle)
+    {
+    }
+
+    GlHandle(GlHandle &&other) :
+        _handle(other._handle)
+    {
+        other._handle = 0;
+    }
+
+    ~GlHandle()
+    {
+        DeleteHandle(_handle);
+    }
+
+    GlHandle &operator=(GlHandle &&other)
+    {
+        if (this != &other)
+        {
+            DeleteHandle(_handle);
+            _handle = other._handle;
+            other._handle = 0;
+        }
+        return *this;
+    }
+
+    operator HandleType() const
+    {
+        return _handle;
+    }
+
+    HandleType Get() const
+    {
+        return _handle;
+    }
+
+    // deletes the object that this had (if any) and takes over the new one (if any)
+    void Reset(HandleType handle = 0)
+    {
+        if (handle != _handle)
+        {
+            DeleteHandle(_handle);
+            _handle = handle;
+        }
+    }
+
+    // gives up the object without deleting it, and the caller owns it from then on
+    HandleType Release()
+    {
+        HandleType handle = _handle;
+        _handle = 0;
+        return handle;
+    }
+
+private:
+    // no copies; there is only one object to delete
+    GlHandle(const GlHandle &);
+    GlHandle &operator=(const GlHandle &);
+
+    HandleType _handle;
+};
+
+typedef GlHandle<unsigned int, DeleteGlBuffer> GlBuffer;
+typedef GlHandle<unsigned int, DeleteGlVertexArray> GlVertexArray;
+typedef GlHandle<unsigned int, DeleteGlTexture> GlTexture;
+typedef GlHandle<unsigned int, DeleteGlQuery> GlQuery;
+typedef GlHandle<void *, DeleteGlFence> GlFence;
+
+// holds one reference to a program in the program registry (see ShaderProgramRegistry.h)
+// instead of the program itself, so the program is only deleted when its last holder lets go
+typedef GlHandle<unsigned int, ReleaseGlProgram> GlProgram;
+
+GlBuffer GenerateGlBuffer();
+GlVertexArray GenerateGlVertexArray();
+GlTexture GenerateGlTexture();
+GlQuery GenerateGlQuery();
+GlFence InsertGlFence();
+GlProgram ReferenceGlProgram(unsigned int programId);
@@ -0,0 +1,535 @@
+#include "GlStateCache.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "Log.h"
+
+// bindings past this many aren't shadowed and always go through
+// Note: GL 4.4 only promises 8 in the compute stage, and the shaders here stay under 64.
+static const unsigned int SHADOWED_STORAGE_BINDING_COUNT = 64;
+
+// what this thread's context has bound, as far as this file knows
+// Note: "Unknown" is kept apart from 0, because 0 is a real value that can be skipped too.
+struct GlStateShadow
+{
+    bool _isProgramKnown;
+    unsigned int _programId;
+    bool _isVaoKnown;
+    unsigned int _vaoId;
+    bool _isStorageBindingKnown[SHADOWED_STORAGE_BINDING_COUNT];
+    unsigned int _storageBufferIds[SHADOWED_STORAGE_BINDING_COUNT];
+    int _isBlendEnabled;        // -1 for unknown
+    int _isDepthTestEnabled;    // -1 for unknown
+    bool _isBlendFuncKnown;
+    unsigned int _blendSourceFactor;
+    unsigned int _blendDestinationFactor;
+};
+
+static thread_local GlStateShadow gGlStateShadow;
+static thread_local bool gIsGlStateShadowValid = false;
+static thread_local bool gIsGlStateCacheEnabled = true;
+static thread_local unsigned long long gIssuedCallCount = 0;
+static thread_local unsigned long long gRedundantCallCount = 0;
+
+// see SetGlDeleteCheckEnabled(...)
+// Note: Only the first few are logged, so a bug that does it every frame doesn't flood the log.
+static const unsigned long long MAX_LOGGED_BAD_DELETES = 16;
+static thread_local bool gIsGlDeleteCheckEnabled = false;
+static thread_local unsigned long long gBadDeleteCount = 0;
+
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives the calling thread's shadow, reset to "unknown" the first time.
+Parameters: None
+Returns:
+    A reference to the thread's shadow.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static GlStateShadow &GetShadow()
+{
+    if (!gIsGlStateShadowValid)
+    {
+        InvalidateGlStateCache();
+    }
+    return gGlStateShadow;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Counts a call that is about to be skipped or made.  A redundant call is counted as one
+    whether or not it is skipped.
+Parameters:
+    isRedundant     True if the state is already what the call would set it to.
+Returns:
+    True if the call must be made.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static bool CountCall(bool isRedundant)
+{
+    if (isRedundant)
+    {
+        gRedundantCallCount++;
+        if (gIsGlStateCacheEnabled)
+        {
+            return false;
+        }
+    }
+    gIssuedCallCount++;
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Counts a delete of a name that isn't a live object, and logs the first few.
+Parameters:
+    kindName    Ex: "buffer".
+    objectId    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static void CountBadGlDelete(const char *kindName, unsigned int objectId)
+{
+    gBadDeleteCount++;
+    if (gBadDeleteCount <= MAX_LOGGED_BAD_DELETES)
+    {
+        LogErrorPrintf("deleted %s %u, which isn't a live object (deleted twice?)\n",
+            kindName, objectId);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives the shadow of a capability that is shadowed.
+Parameters:
+    capability  Self-explanatory.
+Returns:
+    A pointer to the shadow, or 0 if the capability isn't shadowed.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static int *GetCapabilityShadow(unsigned int capability)
+{
+    if (capability == GL_BLEND)
+    {
+        return &GetShadow()._isBlendEnabled;
+    }
+    if (capability == GL_DEPTH_TEST)
+    {
+        return &GetShadow()._isDepthTestEnabled;
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Forgets everything that the calling thread's shadow knows, so that every next call goes
+    through.  Call it when a context is made current, and after anything that changes the
+    state without going through here.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void InvalidateGlStateCache()
+{
+    GlStateShadow &shadow = gGlStateShadow;
+    shadow._isProgramKnown = false;
+    shadow._programId = 0;
+    shadow._isVaoKnown = false;
+    shadow._vaoId = 0;
+    for (unsigned int binding = 0; binding < SHADOWED_STORAGE_BINDING_COUNT; binding++)
+    {
+        shadow._isStorageBindingKnown[binding] = false;
+        shadow._storageBufferIds[binding] = 0;
+    }
+    shadow._isBlendEnabled = -1;
+    shadow._isDepthTestEnabled = -1;
+    shadow._isBlendFuncKnown = false;
+    shadow._blendSourceFactor = 0;
+    shadow._blendDestinationFactor = 0;
+    gIsGlStateShadowValid = true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Turns the skipping on or off for the calling thread.  The shadow is still kept up to date
+    either way, so the cache can be turned back on at any time, and the counts say how many
+    calls would have been skipped.
+Parameters:
+    isEnabled   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void SetGlStateCacheEnabled(bool isEnabled)
+{
+    gIsGlStateCacheEnabled = isEnabled;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    True if redundant calls are being skipped on the calling thread, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool IsGlStateCacheEnabled()
+{
+    return gIsGlStateCacheEnabled;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    glUseProgram(...), unless the program is already in use.
+Parameters:
+    programId   Self-explanatory.  0 for none.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void UseGlProgram(unsigned int programId)
+{
+    GlStateShadow &shadow = GetShadow();
+    if (CountCall(shadow._isProgramKnown && shadow._programId == programId))
+    {
+        glUseProgram(programId);
+        shadow._isProgramKnown = true;
+        shadow._programId = programId;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    glBindVertexArray(...), unless the vertex array is already bound.
+Parameters:
+    vaoId   Self-explanatory.  0 for none.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void BindGlVertexArray(unsigned int vaoId)
+{
+    GlStateShadow &shadow = GetShadow();
+    if (CountCall(shadow._isVaoKnown && shadow._vaoId == vaoId))
+    {
+        glBindVertexArray(vaoId);
+        shadow._isVaoKnown = true;
+        shadow._vaoId = vaoId;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    glBindBufferBase(...) on the shader storage target, unless the whole buffer is already
+    bound there.
+
+    Note: A skipped call doesn't bind the buffer to the generic GL_SHADER_STORAGE_BUFFER target
+    either, like glBindBufferBase(...) would have.  Code that uses that target binds it with
+    glBindBuffer(...) first.
+Parameters:
+    binding     Self-explanatory.
+    bufferId    Self-explanatory.  0 for none.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void BindGlShaderStorageBuffer(unsigned int binding, unsigned int bufferId)
+{
+    GlStateShadow &shadow = GetShadow();
+    bool isShadowed = binding < SHADOWED_STORAGE_BINDING_COUNT;
+    if (CountCall(isShadowed && shadow._isStorageBindingKnown[binding] &&
+        shadow._storageBufferIds[binding] == bufferId))
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, bufferId);
+        if (isShadowed)
+        {
+            shadow._isStorageBindingKnown[binding] = true;
+            shadow._storageBufferIds[binding] = bufferId;
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    glBindBufferRange(...) on the shader storage target.  Ranges are always bound, and the
+    binding is unknown afterwards, so the next whole buffer bound there goes through.
+Parameters:
+    binding     Self-explanatory.
+    bufferId    Self-explanatory.
+    offset      Self-explanatory.
+    sizeBytes   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void BindGlShaderStorageBufferRange(unsigned int binding, unsigned int bufferId,
+    long long offset, long long sizeBytes)
+{
+    GlStateShadow &shadow = GetShadow();
+    CountCall(false);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, bufferId, (GLintptr)offset,
+        (GLsizeiptr)sizeBytes);
+    if (binding < SHADOWED_STORAGE_BINDING_COUNT)
+    {
+        shadow._isStorageBindingKnown[binding] = false;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    glEnable(...), unless the capability is shadowed and already enabled.
+Parameters:
+    capability  Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void EnableGlCapability(unsigned int capability)
+{
+    int *shadow = GetCapabilityShadow(capability);
+    if (CountCall(shadow != 0 && *shadow == 1))
+    {
+        glEnable(capability);
+        if (shadow != 0)
+        {
+            *shadow = 1;
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    glDisable(...), unless the capability is shadowed and already disabled.
+Parameters:
+    capability  Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void DisableGlCapability(unsigned int capability)
+{
+    int *shadow = GetCapabilityShadow(capability);
+    if (CountCall(shadow != 0 && *shadow == 0))
+    {
+        glDisable(capability);
+        if (shadow != 0)
+        {
+            *shadow = 0;
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    glIsEnabled(...), answered from the shadow when it knows, so that code that saves and
+    restores a capability doesn't make the driver sync for it.
+Parameters:
+    capability  Self-explanatory.
+Returns:
+    True if the capability is enabled, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool IsGlCapabilityEnabled(unsigned int capability)
+{
+    int *shadow = GetCapabilityShadow(capability);
+    if (shadow != 0 && *shadow >= 0)
+    {
+        return *shadow == 1;
+    }
+    bool isEnabled = glIsEnabled(capability) == GL_TRUE;
+    if (shadow != 0)
+    {
+        *shadow = isEnabled ? 1 : 0;
+    }
+    return isEnabled;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    glBlendFunc(...), unless the factors are already set.
+Parameters:
+    sourceFactor        Self-explanatory.
+    destinationFactor   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void SetGlBlendFunc(unsigned int sourceFactor, unsigned int destinationFactor)
+{
+    GlStateShadow &shadow = GetShadow();
+    if (CountCall(shadow._isBlendFuncKnown && shadow._blendSourceFactor == sourceFactor &&
+        shadow._blendDestinationFactor == destinationFactor))
+    {
+        glBlendFunc(sourceFactor, destinationFactor);
+        shadow._isBlendFuncKnown = true;
+        shadow._blendSourceFactor = sourceFactor;
+        shadow._blendDestinationFactor = destinationFactor;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    glBlendFunci(...), which is never skipped.  Once the draw buffers have different factors,
+    there is no one blend function to shadow, so the next SetGlBlendFunc(...) is always made.
+Parameters:
+    drawBuffer          Self-explanatory.
+    sourceFactor        Self-explanatory.
+    destinationFactor   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void SetGlBlendFunci(unsigned int drawBuffer, unsigned int sourceFactor,
+    unsigned int destinationFactor)
+{
+    GlStateShadow &shadow = GetShadow();
+    CountCall(false);
+    glBlendFunci(drawBuffer, sourceFactor, destinationFactor);
+    shadow._isBlendFuncKnown = false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    glDeleteProgram(...), and forgets the program if it is the one in use.  GL keeps using a
+    deleted program until another is used, so the shadow can't skip the next use of a program
+    that gets the same name.
+Parameters:
+    programId   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void DeleteGlProgram(unsigned int programId)
+{
+    if (gIsGlDeleteCheckEnabled && programId != 0 && !glIsProgram(programId))
+    {
+        CountBadGlDelete("program", programId);
+    }
+    GlStateShadow &shadow = GetShadow();
+    if (programId != 0 && shadow._programId == programId)
+    {
+        shadow._isProgramKnown = false;
+    }
+    glDeleteProgram(programId);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    glDeleteVertexArrays(...).  GL unbinds a deleted vertex array, so the shadow does too.
+Parameters:
+    count   Self-explanatory.
+    vaoIds  Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void DeleteGlVertexArrays(int count, const unsigned int *vaoIds)
+{
+    GlStateShadow &shadow = GetShadow();
+    for (int index = 0; index < count; index++)
+    {
+        if (vaoIds[index] != 0 && shadow._vaoId == vaoIds[index])
+        {
+            shadow._vaoId = 0;
+        }
+        if (gIsGlDeleteCheckEnabled && vaoIds[index] != 0 && !glIsVertexArray(vaoIds[index]))
+        {
+            CountBadGlDelete("vertex array", vaoIds[index]);
+        }
+    }
+    glDeleteVertexArrays(count, vaoIds);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    glDeleteBuffers(...).  GL unbinds a deleted buffer from every binding of this context, so
+    the shadow does too.
+Parameters:
+    count       Self-explanatory.
+    bufferIds   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void DeleteGlBuffers(int count, const unsigned int *bufferIds)
+{
+    GlStateShadow &shadow = GetShadow();
+    for (int index = 0; index < count; index++)
+    {
+        if (gIsGlDeleteCheckEnabled && bufferIds[index] != 0 && !glIsBuffer(bufferIds[index]))
+        {
+            CountBadGlDelete("buffer", bufferIds[index]);
+        }
+        for (unsigned int binding = 0; bufferIds[index] != 0 &&
+            binding < SHADOWED_STORAGE_BINDING_COUNT; binding++)
+        {
+            if (shadow._storageBufferIds[binding] == bufferIds[index])
+            {
+                shadow._storageBufferIds[binding] = 0;
+            }
+        }
+    }
+    glDeleteBuffers(count, bufferIds);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    How many of the calls that went through here on the calling thread were made and how many
+    were redundant, since the thread started.  With the cache on, the redundant ones are the
+    ones that were skipped.
+Parameters:
+    putIssuedCountHere      Self-explanatory.
+    putRedundantCountHere   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GetGlStateCacheCounts(unsigned long long *putIssuedCountHere,
+    unsigned long long *putRedundantCountHere)
+{
+    *putIssuedCountHere = gIssuedCallCount;
+    *putRedundantCountHere = gRedundantCallCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Has the calling thread's deletes check that each name is a live object before deleting
+    it.  GL ignores the delete of a name that isn't one, so a Cleanup() that runs twice, or
+    two owners of one object, go unnoticed until the name is handed out again and the second
+    delete takes someone else's object with it.  This catches the second delete when it
+    happens instead.
+
+    Note: Each check is a glIs*(...) call, which is cheap but not free, so it is meant for
+    the soak test (see SoakMonitor.h) and not for every run.  A name that was generated and
+    never bound isn't an object yet, so deleting one is counted too.
+Parameters:
+    isEnabled   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void SetGlDeleteCheckEnabled(bool isEnabled)
+{
+    gIsGlDeleteCheckEnabled = isEnabled;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How many deletes on the calling thread were of a name that wasn't a live object, since
+    the check was turned on.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned long long GetBadGlDeleteCount()
+{
+    return gBadDeleteCount;
+}
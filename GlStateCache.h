@@ -0,0 +1,41 @@
+#pragma once
+
+// a shadow of the GL state that every pass sets again and again: the program, the vertex
+// array, the shader storage buffer bindings, and blending and depth testing (see
+// GlStateCache.cpp)
+// Note: A call that would set what is already set is skipped, so a pass can say everything
+// that it needs without paying the driver's validation for what the pass before it left
+// behind.  It only works if every change goes through here, so the rest of the program never
+// calls the GL functions that these wrap, and the deletes go through here as well so that a
+// new object that reuses a deleted one's name isn't taken for it.
+// Also Note: Each thread with a context has its own shadow (see MultiGpuSimulation.h), and
+// InvalidateGlStateCache() must be called when a thread's context is made current, since a
+// new context starts with GL's defaults and not with what was shadowed.  Turning the cache off
+// (SetGlStateCacheEnabled(...)) passes every call through, which is how to measure what it
+// saves.
+void InvalidateGlStateCache();
+void SetGlStateCacheEnabled(bool isEnabled);
+bool IsGlStateCacheEnabled();
+
+void UseGlProgram(unsigned int programId);
+void BindGlVertexArray(unsigned int vaoId);
+void BindGlShaderStorageBuffer(unsigned int binding, unsigned int bufferId);
+void BindGlShaderStorageBufferRange(unsigned int binding, unsigned int bufferId,
+    long long offset, long long sizeBytes);
+void EnableGlCapability(unsigned int capability);
+void DisableGlCapability(unsigned int capability);
+bool IsGlCapabilityEnabled(unsigned int capability);
+void SetGlBlendFunc(unsigned int sourceFactor, unsigned int destinationFactor);
+void SetGlBlendFunci(unsigned int drawBuffer, unsigned int sourceFactor,
+    unsigned int destinationFactor);
+
+void DeleteGlProgram(unsigned int programId);
+void DeleteGlVertexArrays(int count, const unsigned int *vaoIds);
+void DeleteGlBuffers(int count, const unsigned int *bufferIds);
+
+void GetGlStateCacheCounts(unsigned long long *putIssuedCountHere,
+    unsigned long long *putRedundantCountHere);
+
+// the deletes can check that they are deleting something (see SetGlDeleteCheckEnabled(...))
+void SetGlDeleteCheckEnabled(bool isEnabled);
+unsigned long long GetBadGlDeleteCount();
@@ -0,0 +1,601 @@
+#include "GlutAppWindow.h"
+
+// Build note: Must be included after OpenGL code (in this case, glload).
+// Build note: Also need to link freeglut/lib/freeglutD.lib.  However, the linker will try to
+// find "freeglut.lib" (note the lack of "D") instead unless the following preprocessor
+// directives are set either here or in the source-building command line (VS has a
+// "Preprocessor" section under "C/C++" for preprocessor definitions).
+// Build note: Also need to link winmm.lib (VS seems to know where it is, so don't put in an
+// "Additional Library Directories" entry).
+#include "glload/include/glload/gl_4_4.h"
+#define FREEGLUT_STATIC
+#define _LIB
+#define FREEGLUT_LIB_PRAGMAS 0
+#include "freeglut/include/GL/freeglut.h"
+
+// this linking approach is very useful for portable, crude, barebones demo code, but it is
+// better to link through the project building properties
+#pragma comment(lib, "freeglut/lib/freeglutD.lib")
+#ifdef WIN32
+#pragma comment(lib, "winmm.lib")               // Windows-specific; freeglut needs it
+#endif
+
+GlutAppWindow *GlutAppWindow::_current = 0;
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Starts up glut.  There is no window until Create(...).
+Parameters:
+    argc    (From main(...)) For glutInit(...), which removes the arguments that it knows.
+    argv    (From main(...)) Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+GlutAppWindow::GlutAppWindow(int *argc, char *argv[]) :
+    _windowId(0),
+    _width(0),
+    _height(0),
+    _isCloseRequested(false),
+    _isVisible(false)
+{
+    glutInit(argc, argv);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Destroy() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+GlutAppWindow::~GlutAppWindow()
+{
+    this->Destroy();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Makes the window and its context, and hooks up the callbacks.
+
+    Note: Closing the window doesn't end the program (GLUT_ACTION_CONTINUE_EXECUTION), so
+    PollEvents() can say so and let the loop clean up.
+Parameters:
+    settings    Self-explanatory.
+Returns:
+    False if there already is a window or glut couldn't make one, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+bool GlutAppWindow::Create(const AppWindowSettings &settings)
+{
+    if (_current != 0)
+    {
+        return false;
+    }
+
+    // the alpha, depth, and stencil buffers are only allocated if something will use them
+    // Note: Nothing blends with or reads back the window's alpha, nothing uses stencil, and at
+    // high resolutions a depth buffer that is never tested is a lot of wasted memory and clear
+    // bandwidth.
+    unsigned int displayMode = GLUT_DOUBLE | GLUT_RGB;
+    if (settings._hasDepthBuffer)
+    {
+        displayMode |= GLUT_DEPTH;
+    }
+    glutInitDisplayMode(displayMode);
+    glutInitContextVersion(settings._glMajorVersion, settings._glMinorVersion);
+    glutInitContextProfile(GLUT_CORE_PROFILE);
+    if (settings._isDebugContext)
+    {
+        glutInitContextFlags(GLUT_DEBUG);
+    }
+
+    glutInitWindowSize(settings._width, settings._height);
+    glutInitWindowPosition(settings._positionX, settings._positionY);
+    _windowId = glutCreateWindow(settings._title);
+    if (_windowId <= 0)
+    {
+        _windowId = 0;
+        return false;
+    }
+
+    _current = this;
+    _width = settings._width;
+    _height = settings._height;
+    _isCloseRequested = false;
+    _isVisible = true;
+    glutSetOption(GLUT_ACTION_ON_WINDOW_CLOSE, GLUT_ACTION_CONTINUE_EXECUTION);
+
+    // Note: freeglut won't show a window without a display callback, even though the loop
+    // does the drawing.
+    glutDisplayFunc(GlutAppWindow::OnDisplay);
+    glutReshapeFunc(GlutAppWindow::OnReshape);
+    glutKeyboardFunc(GlutAppWindow::OnKeyboard);
+    glutMouseFunc(GlutAppWindow::OnMouse);
+    glutMotionFunc(GlutAppWindow::OnMouseMotion);
+    glutPassiveMotionFunc(GlutAppWindow::OnMouseMotion);
+    glutMouseWheelFunc(GlutAppWindow::OnMouseWheel);
+    glutCloseFunc(GlutAppWindow::OnClose);
+    glutWindowStatusFunc(GlutAppWindow::OnWindowStatus);
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Destroys the window, and the context with it, unless the close button already did.  Safe
+    to call more than once.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void GlutAppWindow::Destroy()
+{
+    if (_current != this)
+    {
+        return;
+    }
+
+    // the main window's context goes with it, so the shared windows go first
+    for (size_t sharedIndex = 0; sharedIndex < _sharedWindows.size(); sharedIndex++)
+    {
+        if (_sharedWindows[sharedIndex]._windowId != 0)
+        {
+            glutDestroyWindow(_sharedWindows[sharedIndex]._windowId);
+        }
+    }
+    _sharedWindows.clear();
+
+    if (_windowId != 0)
+    {
+        glutDestroyWindow(_windowId);
+        _windowId = 0;
+    }
+
+    // freeglut puts off destroying windows until it handles events
+    glutMainLoopEvent();
+    _current = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Runs the glut callbacks that are due (resizes, key presses, the close button) and
+    returns without waiting for anything.
+Parameters: None
+Returns:
+    False if the window was closed or RequestClose() was called, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+bool GlutAppWindow::PollEvents()
+{
+    if (_windowId == 0 || _isCloseRequested)
+    {
+        return false;
+    }
+    glutMainLoopEvent();
+
+    // the callbacks leave whichever window they were for as the one that is drawn to
+    if (!_sharedWindows.empty() && _windowId != 0)
+    {
+        glutSetWindow(_windowId);
+    }
+    return !_isCloseRequested;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void GlutAppWindow::SwapBuffers()
+{
+    if (_windowId != 0)
+    {
+        glutSwapBuffers();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Has the next PollEvents() say that it's time to stop.  The window stays until Destroy().
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void GlutAppWindow::RequestClose()
+{
+    _isCloseRequested = true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.  The context still works.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void GlutAppWindow::Hide()
+{
+    if (_windowId != 0)
+    {
+        glutSetWindow(_windowId);
+        glutHideWindow();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The size that the window was made with, or the last size that it was given, in pixels.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+int GlutAppWindow::GetWidth() const
+{
+    return _width;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    See GetWidth().
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+int GlutAppWindow::GetHeight() const
+{
+    return _height;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.  A minimized window is either hidden or 0x0, depending on the window 
+    system.
+Parameters: None
+Returns:
+    False if the window is hidden, minimized, or entirely covered by other windows.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool GlutAppWindow::IsVisible() const
+{
+    return _windowId != 0 && _isVisible && _width > 0 && _height > 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Makes another window with the main window's context (see GlutAppWindow.h) and the same 
+    pixel format, which the context needs.  It passes its key presses along like the main 
+    window, but not the mouse, whose coordinates would be in the wrong window, and its 
+    resizes are only kept for BeginSharedWindow(...).
+Parameters:
+    settings    The title, size, and position.  The rest are the main window's.
+Returns:
+    False if there is no main window or glut couldn't make one, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool GlutAppWindow::AddSharedWindow(const AppWindowSettings &settings)
+{
+    if (_current != this || _windowId == 0)
+    {
+        return false;
+    }
+
+    glutSetOption(GLUT_RENDERING_CONTEXT, GLUT_USE_CURRENT_CONTEXT);
+    glutInitWindowSize(settings._width, settings._height);
+    glutInitWindowPosition(settings._positionX, settings._positionY);
+    int windowId = glutCreateWindow(settings._title);
+    glutSetOption(GLUT_RENDERING_CONTEXT, GLUT_CREATE_NEW_CONTEXT);
+    if (windowId <= 0)
+    {
+        glutSetWindow(_windowId);
+        return false;
+    }
+
+    // the callbacks are set on the window that was just made
+    glutDisplayFunc(GlutAppWindow::OnDisplay);
+    glutReshapeFunc(GlutAppWindow::OnReshape);
+    glutKeyboardFunc(GlutAppWindow::OnKeyboard);
+    glutCloseFunc(GlutAppWindow::OnClose);
+    glutWindowStatusFunc(GlutAppWindow::OnWindowStatus);
+
+    SharedWindow sharedWindow;
+    sharedWindow._windowId = windowId;
+    sharedWindow._width = settings._width;
+    sharedWindow._height = settings._height;
+    sharedWindow._isVisible = true;
+    _sharedWindows.push_back(sharedWindow);
+    glutSetWindow(_windowId);
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.  Closed windows still count, so the indices don't move.
+Parameters: None
+Returns:
+    Self-explanatory.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int GlutAppWindow::GetSharedWindowCount() const
+{
+    return (unsigned int)_sharedWindows.size();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Makes the context current on the shared window, so that the default framebuffer is its.  
+    Call EndSharedWindow() after drawing.
+Parameters:
+    windowIndex     In the order they were added.
+    putWidthHere    Self-explanatory.
+    putHeightHere   Self-explanatory.
+Returns:
+    False if the window was closed, is hidden or minimized, or doesn't exist, in which case 
+    the main window is still the one drawn to.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool GlutAppWindow::BeginSharedWindow(unsigned int windowIndex, int *putWidthHere, 
+    int *putHeightHere)
+{
+    if (windowIndex >= _sharedWindows.size())
+    {
+        return false;
+    }
+    const SharedWindow &sharedWindow = _sharedWindows[windowIndex];
+    if (sharedWindow._windowId == 0 || !sharedWindow._isVisible || sharedWindow._width <= 0 || 
+        sharedWindow._height <= 0)
+    {
+        return false;
+    }
+
+    glutSetWindow(sharedWindow._windowId);
+    *putWidthHere = sharedWindow._width;
+    *putHeightHere = sharedWindow._height;
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Swaps the shared window that BeginSharedWindow(...) made current, and goes back to the 
+    main window.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GlutAppWindow::EndSharedWindow()
+{
+    if (_windowId == 0 || glutGetWindow() == _windowId)
+    {
+        return;
+    }
+    glutSwapBuffers();
+    glutSetWindow(_windowId);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    windowId    From glutGetWindow().
+Returns:
+    The shared window, or 0 if the ID is the main window's or a closed one's.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+GlutAppWindow::SharedWindow *GlutAppWindow::FindSharedWindow(int windowId)
+{
+    for (size_t sharedIndex = 0; sharedIndex < _sharedWindows.size(); sharedIndex++)
+    {
+        if (windowId != 0 && _sharedWindows[sharedIndex]._windowId == windowId)
+        {
+            return &_sharedWindows[sharedIndex];
+        }
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Does nothing.  The loop draws (see AppWindow.h).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void GlutAppWindow::OnDisplay()
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Keeps the size for GetWidth() and GetHeight() and passes the resize along.
+Parameters:
+    width   In pixels.
+    height  Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void GlutAppWindow::OnReshape(int width, int height)
+{
+    if (_current == 0)
+    {
+        return;
+    }
+    SharedWindow *sharedWindow = _current->FindSharedWindow(glutGetWindow());
+    if (sharedWindow != 0)
+    {
+        sharedWindow->_width = width;
+        sharedWindow->_height = height;
+        return;
+    }
+    _current->_width = width;
+    _current->_height = height;
+    if (_current->_resizeHandler)
+    {
+        _current->_resizeHandler(width, height);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Passes the key press along.
+Parameters:
+    key     The ASCII code of the key that was pressed (ex: ESC key is 27)
+    x       The horizontal viewport coordinates of the mouse's current position.
+    y       The vertical window coordinates of the mouse's current position
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void GlutAppWindow::OnKeyboard(unsigned char key, int x, int y)
+{
+    if (_current != 0 && _current->_keyHandler)
+    {
+        _current->_keyHandler(key, x, y);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Passes a mouse button press or release along.
+Parameters:
+    button  GLUT_LEFT_BUTTON (0), GLUT_MIDDLE_BUTTON (1), or GLUT_RIGHT_BUTTON (2).  Some 
+            systems also report the wheel as buttons 3 and 4, which go to the wheel handler 
+            instead.
+    state   GLUT_DOWN or GLUT_UP.
+    x       Window coordinates of the mouse.
+    y       Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GlutAppWindow::OnMouse(int button, int state, int x, int y)
+{
+    if (_current == 0)
+    {
+        return;
+    }
+
+    if (button == 3 || button == 4)
+    {
+        // one step per click of the wheel, which comes as a press and a release
+        if (state == GLUT_DOWN)
+        {
+            OnMouseWheel(0, (button == 3) ? +1 : -1, x, y);
+        }
+        return;
+    }
+
+    if (_current->_mouseButtonHandler)
+    {
+        _current->_mouseButtonHandler(button, state == GLUT_DOWN, x, y);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Passes the mouse's movement along, whether or not a button is down.
+Parameters:
+    x   Window coordinates of the mouse.
+    y   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GlutAppWindow::OnMouseMotion(int x, int y)
+{
+    if (_current != 0 && _current->_mouseMoveHandler)
+    {
+        _current->_mouseMoveHandler(x, y);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Passes a step of the mouse wheel along.
+Parameters:
+    wheel       Which wheel.  Ignored.
+    direction   +1 away from the user, -1 toward them.
+    x           Window coordinates of the mouse.
+    y           Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GlutAppWindow::OnMouseWheel(int wheel, int direction, int x, int y)
+{
+    (void)wheel;
+    if (_current != 0 && _current->_mouseWheelHandler)
+    {
+        _current->_mouseWheelHandler(direction, x, y);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The close button.  freeglut is about to destroy the window, so it is forgotten here and
+    Destroy() doesn't try again.  A shared window's close button only closes it.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void GlutAppWindow::OnClose()
+{
+    SharedWindow *sharedWindow = (_current != 0) ? 
+        _current->FindSharedWindow(glutGetWindow()) : 0;
+    if (sharedWindow != 0)
+    {
+        sharedWindow->_windowId = 0;
+    }
+    else if (_current != 0)
+    {
+        _current->_isCloseRequested = true;
+        _current->_windowId = 0;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Keeps whether any of the window can be seen for IsVisible().
+Parameters:
+    state   GLUT_HIDDEN, GLUT_FULLY_RETAINED, GLUT_PARTIALLY_RETAINED, or GLUT_FULLY_COVERED.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GlutAppWindow::OnWindowStatus(int state)
+{
+    if (_current == 0)
+    {
+        return;
+    }
+    bool isVisible = (state == GLUT_FULLY_RETAINED || state == GLUT_PARTIALLY_RETAINED);
+    SharedWindow *sharedWindow = _current->FindSharedWindow(glutGetWindow());
+    if (sharedWindow != 0)
+    {
+        sharedWindow->_isVisible = isVisible;
+    }
+    else
+    {
+        _current->_isVisible = isVisible;
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "AppWindow.h"
+
+#include <vector>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The freeglut window (see AppWindow.h).  Instead of handing the loop to glutMainLoop(), it
+    calls glutMainLoopEvent() once per PollEvents(), which runs whatever callbacks are due and
+    returns.  The callbacks are routed to the handlers from AppWindow.
+
+    Note: GLUT's callbacks are plain functions, so they find the window through a static
+    pointer, which is why there can only be one of these at a time.
+    Also Note: freeglut destroys the window as soon as the close button is pressed, before
+    the loop hears of it, so after a close that way, the context is already gone when the
+    loop ends.  RequestClose() (ex: ESC) doesn't have that problem.
+    Also Also Note: The shared windows are made with GLUT_USE_CURRENT_CONTEXT, so they don't 
+    just share the main window's buffers but use its very context, and the VAOs and 
+    framebuffers (which contexts don't share) work in them too.  Closing one only closes it.
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+class GlutAppWindow : public AppWindow
+{
+public:
+    GlutAppWindow(int *argc, char *argv[]);
+    virtual ~GlutAppWindow();
+
+    virtual bool Create(const AppWindowSettings &settings);
+    virtual void Destroy();
+
+    virtual bool PollEvents();
+    virtual void SwapBuffers();
+    virtual void RequestClose();
+    virtual void Hide();
+
+    virtual int GetWidth() const;
+    virtual int GetHeight() const;
+    virtual bool IsVisible() const;
+
+    virtual bool AddSharedWindow(const AppWindowSettings &settings);
+    virtual unsigned int GetSharedWindowCount() const;
+    virtual bool BeginSharedWindow(unsigned int windowIndex, int *putWidthHere, 
+        int *putHeightHere);
+    virtual void EndSharedWindow();
+
+private:
+    struct SharedWindow
+    {
+        int _windowId;
+        int _width;
+        int _height;
+        bool _isVisible;
+    };
+    SharedWindow *FindSharedWindow(int windowId);
+
+    static void OnDisplay();
+    static void OnReshape(int width, int height);
+    static void OnKeyboard(unsigned char key, int x, int y);
+    static void OnMouse(int button, int state, int x, int y);
+    static void OnMouseMotion(int x, int y);
+    static void OnMouseWheel(int wheel, int direction, int x, int y);
+    static void OnClose();
+    static void OnWindowStatus(int state);
+
+    static GlutAppWindow *_current;
+
+    int _windowId;
+    int _width;
+    int _height;
+    bool _isCloseRequested;
+    bool _isVisible;
+    std::vector<SharedWindow> _sharedWindows;
+};
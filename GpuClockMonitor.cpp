@@ -0,0 +1,767 @@
+#include "GpuClockMonitor.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "Log.h"
+
+#include <stdio.h>
+#include <string.h>     // strstr
+#include <chrono>
+
+#ifdef WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+const float GpuClockMonitor::THROTTLE_CLOCK_FRACTION = 0.9f;
+
+// the parts of NVML that are used, from nvml.h, which isn't included so that nothing has to be
+// installed to build this
+// Note: Every function returns an nvmlReturn_t, which is 0 for success.
+typedef int (*NvmlInitProc)();
+typedef int (*NvmlShutdownProc)();
+typedef int (*NvmlDeviceGetCountProc)(unsigned int *deviceCount);
+typedef int (*NvmlDeviceGetHandleByIndexProc)(unsigned int index, void **device);
+typedef int (*NvmlDeviceGetNameProc)(void *device, char *name, unsigned int length);
+typedef int (*NvmlDeviceGetClockInfoProc)(void *device, int clockType, unsigned int *clockMhz);
+typedef int (*NvmlDeviceGetTemperatureProc)(void *device, int sensorType,
+    unsigned int *temperatureC);
+typedef int (*NvmlDeviceGetPowerUsageProc)(void *device, unsigned int *milliwatts);
+typedef int (*NvmlDeviceGetThrottleReasonsProc)(void *device, unsigned long long *reasons);
+static const int NVML_CLOCK_GRAPHICS = 0;
+static const int NVML_CLOCK_MEM = 2;
+static const int NVML_TEMPERATURE_GPU = 0;
+
+// the throttle reasons that mean the GPU was held back: the software power cap (0x4), the
+// hardware slowdown (0x8), the software and hardware thermal slowdowns (0x20 and 0x40), and
+// the power brake (0x80)
+// Note: Idle (0x1), the application clocks (0x2), and sync boost (0x10) aren't throttling.
+static const unsigned long long NVML_THROTTLED_REASONS = 0x4 | 0x8 | 0x20 | 0x40 | 0x80;
+
+// how many samples WaitForStableClocks(...) holds up against each other, how far apart they
+// are, and how much they may differ and still be stable
+static const unsigned int STABLE_SAMPLE_COUNT = 6;
+static const double STABLE_SAMPLE_INTERVAL_SEC = 0.5;
+static const float STABLE_CLOCK_SPREAD = 0.02f;
+static const float STABLE_TEMPERATURE_RISE_C = 1.0f;
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Loads a library by the first of its names that loads.
+Parameters:
+    names       Self-explanatory.
+    nameCount   Self-explanatory.
+Returns:
+    The library, or 0 if none of them loaded.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static void *LoadSharedLibrary(const char *names[], int nameCount)
+{
+    for (int nameIndex = 0; nameIndex < nameCount; nameIndex++)
+    {
+#ifdef WIN32
+        void *library = (void *)LoadLibraryA(names[nameIndex]);
+#else
+        void *library = dlopen(names[nameIndex], RTLD_NOW | RTLD_LOCAL);
+#endif
+        if (library != 0)
+        {
+            return library;
+        }
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    library         From LoadSharedLibrary(...).
+    functionName    Self-explanatory.
+Returns:
+    The function's address, or 0 if the library doesn't have it.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static void *GetSharedLibraryFunction(void *library, const char *functionName)
+{
+#ifdef WIN32
+    return (void *)GetProcAddress((HMODULE)library, functionName);
+#else
+    return dlsym(library, functionName);
+#endif
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    library     From LoadSharedLibrary(...).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static void FreeSharedLibrary(void *library)
+{
+#ifdef WIN32
+    FreeLibrary((HMODULE)library);
+#else
+    dlclose(library);
+#endif
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Reads the number at the start of a small text file, like the ones in sysfs.
+Parameters:
+    filePath        Self-explanatory.
+    putNumberHere   Self-explanatory.
+Returns:
+    False if the file couldn't be read or doesn't start with a number.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static bool ReadFileNumber(const std::string &filePath, double *putNumberHere)
+{
+    FILE *numberFile = fopen(filePath.c_str(), "r");
+    if (numberFile == 0)
+    {
+        return false;
+    }
+    bool hasNumber = fscanf(numberFile, "%lf", putNumberHere) == 1;
+    fclose(numberFile);
+    return hasNumber;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Reads the current level of one of amdgpu's clock tables (ex: pp_dpm_sclk), whose lines
+    are like "1: 1800Mhz *", with a '*' on the one in use.
+Parameters:
+    filePath        Self-explanatory.
+    putClockHere    In MHz.
+Returns:
+    False if the file couldn't be read or no level is marked.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static bool ReadDpmClock(const std::string &filePath, float *putClockHere)
+{
+    FILE *dpmFile = fopen(filePath.c_str(), "r");
+    if (dpmFile == 0)
+    {
+        return false;
+    }
+    bool hasClock = false;
+    char line[128];
+    while (!hasClock && fgets(line, sizeof(line), dpmFile) != 0)
+    {
+        unsigned int level = 0;
+        float clockMhz = 0.0f;
+        if (strchr(line, '*') != 0 && sscanf(line, "%u: %f", &level, &clockMhz) == 2)
+        {
+            *putClockHere = clockMhz;
+            hasClock = true;
+        }
+    }
+    fclose(dpmFile);
+    return hasClock;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.  There is no backend until Init().
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+GpuClockMonitor::GpuClockMonitor() :
+    _backend(BACKEND_NONE),
+    _nvmlLibrary(0),
+    _nvmlDevice(0),
+    _nvmlShutdown(0),
+    _nvmlGetClockInfo(0),
+    _nvmlGetTemperature(0),
+    _nvmlGetPowerUsage(0),
+    _nvmlGetThrottleReasons(0),
+    _steadyGraphicsClockMhz(0.0f),
+    _highestGraphicsClockMhz(0.0f)
+{
+    this->BeginWindow();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+GpuClockMonitor::~GpuClockMonitor()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Picks the backend for the current context's GPU (see the class description).
+Parameters: None
+Returns:
+    False if there is no backend for this GPU on this platform, in which case every sample
+    fails and the windows are empty.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool GpuClockMonitor::Init()
+{
+    this->Cleanup();
+    const char *vendor = (const char *)glGetString(GL_VENDOR);
+    if (vendor == 0)
+    {
+        return false;
+    }
+
+    bool hasBackend = false;
+    if (strstr(vendor, "NVIDIA") != 0)
+    {
+        hasBackend = this->InitNvml();
+    }
+    else if (strstr(vendor, "AMD") != 0 || strstr(vendor, "ATI") != 0)
+    {
+        hasBackend = this->InitSysfs("0x1002");
+    }
+    else if (strstr(vendor, "Intel") != 0)
+    {
+        hasBackend = this->InitSysfs("0x8086");
+    }
+
+    if (!hasBackend)
+    {
+        LogPrintf("GPU clocks: nothing to read them with for '%s'\n", vendor);
+    }
+    return hasBackend;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Lets go of NVML, if it was loaded, and forgets the backend.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GpuClockMonitor::Cleanup()
+{
+    if (_nvmlLibrary != 0)
+    {
+        if (_nvmlShutdown != 0)
+        {
+            ((NvmlShutdownProc)_nvmlShutdown)();
+        }
+        FreeSharedLibrary(_nvmlLibrary);
+        _nvmlLibrary = 0;
+    }
+    _nvmlDevice = 0;
+    _nvmlShutdown = 0;
+    _nvmlGetClockInfo = 0;
+    _nvmlGetTemperature = 0;
+    _nvmlGetPowerUsage = 0;
+    _nvmlGetThrottleReasons = 0;
+    _sysfsDevicePath.clear();
+    _sysfsCardPath.clear();
+    _sysfsHwmonPath.clear();
+    _steadyGraphicsClockMhz = 0.0f;
+    _highestGraphicsClockMhz = 0.0f;
+    _backend = BACKEND_NONE;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    True if Init() found a backend.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool GpuClockMonitor::HasBackend() const
+{
+    return _backend != BACKEND_NONE;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    "nvml", "sysfs", or "none", for the report's header.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+const char *GpuClockMonitor::GetBackendName() const
+{
+    switch (_backend)
+    {
+    case BACKEND_NVML: return "nvml";
+    case BACKEND_SYSFS: return "sysfs";
+    default: return "none";
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Reads the clocks, temperature, and power now.
+Parameters:
+    putSampleHere   Self-explanatory.  What can't be read is -1.
+Returns:
+    False if there is no backend or it couldn't read the graphics clock.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool GpuClockMonitor::Sample(GpuClockSample *putSampleHere)
+{
+    putSampleHere->_graphicsClockMhz = -1.0f;
+    putSampleHere->_memoryClockMhz = -1.0f;
+    putSampleHere->_temperatureC = -1.0f;
+    putSampleHere->_powerW = -1.0f;
+    putSampleHere->_throttleReasons = 0;
+
+    bool hasSample = false;
+    if (_backend == BACKEND_NVML)
+    {
+        hasSample = this->SampleNvml(putSampleHere);
+    }
+    else if (_backend == BACKEND_SYSFS)
+    {
+        hasSample = this->SampleSysfs(putSampleHere);
+    }
+    if (hasSample && putSampleHere->_graphicsClockMhz > _highestGraphicsClockMhz)
+    {
+        _highestGraphicsClockMhz = putSampleHere->_graphicsClockMhz;
+    }
+    return hasSample;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory (see the class description for how each backend decides).
+Parameters:
+    sample  From Sample(...).
+Returns:
+    True if the GPU was held back when the sample was taken.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool GpuClockMonitor::IsThrottled(const GpuClockSample &sample) const
+{
+    if (_backend == BACKEND_NVML)
+    {
+        return (sample._throttleReasons & NVML_THROTTLED_REASONS) != 0;
+    }
+
+    float referenceMhz = (_steadyGraphicsClockMhz > 0.0f) ?
+        _steadyGraphicsClockMhz : _highestGraphicsClockMhz;
+    return sample._graphicsClockMhz > 0.0f &&
+        sample._graphicsClockMhz < referenceMhz * THROTTLE_CLOCK_FRACTION;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Starts a new measurement window.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GpuClockMonitor::BeginWindow()
+{
+    _windowSampleCount = 0;
+    _windowThrottledCount = 0;
+    _windowMinClockMhz = 0.0f;
+    _windowClockSumMhz = 0.0;
+    _windowClockCount = 0;
+    _windowMaxTemperatureC = -1.0f;
+    _windowPowerSumW = 0.0;
+    _windowPowerCount = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes a sample and adds it to the window.  Does nothing if there is no backend.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GpuClockMonitor::SampleWindow()
+{
+    GpuClockSample sample;
+    if (!this->Sample(&sample))
+    {
+        return;
+    }
+
+    _windowSampleCount++;
+    if (this->IsThrottled(sample))
+    {
+        _windowThrottledCount++;
+    }
+    if (_windowClockCount == 0 || sample._graphicsClockMhz < _windowMinClockMhz)
+    {
+        _windowMinClockMhz = sample._graphicsClockMhz;
+    }
+    _windowClockSumMhz += sample._graphicsClockMhz;
+    _windowClockCount++;
+    if (sample._temperatureC > _windowMaxTemperatureC)
+    {
+        _windowMaxTemperatureC = sample._temperatureC;
+    }
+    if (sample._powerW >= 0.0f)
+    {
+        _windowPowerSumW += sample._powerW;
+        _windowPowerCount++;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sums up the window's samples.
+Parameters:
+    putWindowHere   Self-explanatory.  What was never read is -1, and everything is 0 if
+                    there were no samples.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GpuClockMonitor::GetWindow(GpuClockWindow *putWindowHere) const
+{
+    putWindowHere->_sampleCount = _windowSampleCount;
+    putWindowHere->_throttledSampleCount = _windowThrottledCount;
+    putWindowHere->_minGraphicsClockMhz = _windowMinClockMhz;
+    putWindowHere->_avgGraphicsClockMhz = (_windowClockCount > 0) ?
+        (float)(_windowClockSumMhz / _windowClockCount) : 0.0f;
+    putWindowHere->_maxTemperatureC = _windowMaxTemperatureC;
+    putWindowHere->_avgPowerW = (_windowPowerCount > 0) ?
+        (float)(_windowPowerSumW / _windowPowerCount) : -1.0f;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Runs a fixed workload until the graphics clock has settled and the temperature has
+    stopped climbing, so that the first measurements aren't taken at a cold GPU's boost
+    clock and the last ones at a hot GPU's sustained clock.  The clock that it settles at is
+    what the later samples are held up against (see IsThrottled(...)).
+
+    It is stable when the last STABLE_SAMPLE_COUNT samples, STABLE_SAMPLE_INTERVAL_SEC
+    apart, are within STABLE_CLOCK_SPREAD of each other and the temperature rose by less
+    than STABLE_TEMPERATURE_RISE_C over them.
+Parameters:
+    runWorkload     Runs one frame of the workload.  It is called over and over.
+    timeoutSec      How long to give it before going on anyway.
+Returns:
+    True if the clocks settled, false if it timed out or there is no backend.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool GpuClockMonitor::WaitForStableClocks(const std::function<void()> &runWorkload,
+    double timeoutSec)
+{
+    typedef std::chrono::steady_clock Clock;
+    if (_backend == BACKEND_NONE)
+    {
+        return false;
+    }
+
+    GpuClockSample recent[STABLE_SAMPLE_COUNT];
+    unsigned int sampleCount = 0;
+    Clock::time_point start = Clock::now();
+    Clock::time_point lastSampleTime = start;
+    while (std::chrono::duration<double>(Clock::now() - start).count() < timeoutSec)
+    {
+        runWorkload();
+        if (std::chrono::duration<double>(Clock::now() - lastSampleTime).count() <
+            STABLE_SAMPLE_INTERVAL_SEC)
+        {
+            continue;
+        }
+        lastSampleTime = Clock::now();
+
+        // the oldest sample drops off the front
+        GpuClockSample sample;
+        if (!this->Sample(&sample))
+        {
+            return false;
+        }
+        for (unsigned int sampleIndex = 1; sampleIndex < STABLE_SAMPLE_COUNT; sampleIndex++)
+        {
+            recent[sampleIndex - 1] = recent[sampleIndex];
+        }
+        recent[STABLE_SAMPLE_COUNT - 1] = sample;
+        sampleCount++;
+        if (sampleCount < STABLE_SAMPLE_COUNT)
+        {
+            continue;
+        }
+
+        float minClockMhz = recent[0]._graphicsClockMhz;
+        float maxClockMhz = recent[0]._graphicsClockMhz;
+        float clockSumMhz = 0.0f;
+        for (unsigned int sampleIndex = 0; sampleIndex < STABLE_SAMPLE_COUNT; sampleIndex++)
+        {
+            float clockMhz = recent[sampleIndex]._graphicsClockMhz;
+            minClockMhz = (clockMhz < minClockMhz) ? clockMhz : minClockMhz;
+            maxClockMhz = (clockMhz > maxClockMhz) ? clockMhz : maxClockMhz;
+            clockSumMhz += clockMhz;
+        }
+        float temperatureRiseC =
+            recent[STABLE_SAMPLE_COUNT - 1]._temperatureC - recent[0]._temperatureC;
+        if (maxClockMhz - minClockMhz <= maxClockMhz * STABLE_CLOCK_SPREAD &&
+            temperatureRiseC < STABLE_TEMPERATURE_RISE_C)
+        {
+            _steadyGraphicsClockMhz = clockSumMhz / STABLE_SAMPLE_COUNT;
+            LogPrintf("GPU clocks: stable at %.0fMHz and %.0fC after %.1f seconds\n",
+                _steadyGraphicsClockMhz, recent[STABLE_SAMPLE_COUNT - 1]._temperatureC,
+                std::chrono::duration<double>(Clock::now() - start).count());
+            return true;
+        }
+    }
+
+    LogPrintf("GPU clocks: still not stable after %.0f seconds; going on anyway\n", timeoutSec);
+    return false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Loads NVML and finds the device whose name is in GL_RENDERER, or the first one if none
+    of them are, for a machine with one NVIDIA GPU.
+Parameters: None
+Returns:
+    False if NVML couldn't be loaded or has no devices.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool GpuClockMonitor::InitNvml()
+{
+#ifdef WIN32
+    const char *libraryNames[] =
+    {
+        "nvml.dll", "C:\\Program Files\\NVIDIA Corporation\\NVSMI\\nvml.dll"
+    };
+#else
+    const char *libraryNames[] = { "libnvidia-ml.so.1", "libnvidia-ml.so" };
+#endif
+    _nvmlLibrary = LoadSharedLibrary(libraryNames, 2);
+    if (_nvmlLibrary == 0)
+    {
+        return false;
+    }
+
+    NvmlInitProc nvmlInit = (NvmlInitProc)GetSharedLibraryFunction(_nvmlLibrary, "nvmlInit_v2");
+    NvmlDeviceGetCountProc getCount = (NvmlDeviceGetCountProc)GetSharedLibraryFunction(
+        _nvmlLibrary, "nvmlDeviceGetCount_v2");
+    NvmlDeviceGetHandleByIndexProc getHandle =
+        (NvmlDeviceGetHandleByIndexProc)GetSharedLibraryFunction(_nvmlLibrary,
+        "nvmlDeviceGetHandleByIndex_v2");
+    NvmlDeviceGetNameProc getName = (NvmlDeviceGetNameProc)GetSharedLibraryFunction(
+        _nvmlLibrary, "nvmlDeviceGetName");
+    _nvmlShutdown = GetSharedLibraryFunction(_nvmlLibrary, "nvmlShutdown");
+    _nvmlGetClockInfo = GetSharedLibraryFunction(_nvmlLibrary, "nvmlDeviceGetClockInfo");
+    _nvmlGetTemperature = GetSharedLibraryFunction(_nvmlLibrary, "nvmlDeviceGetTemperature");
+    _nvmlGetPowerUsage = GetSharedLibraryFunction(_nvmlLibrary, "nvmlDeviceGetPowerUsage");
+    _nvmlGetThrottleReasons = GetSharedLibraryFunction(_nvmlLibrary,
+        "nvmlDeviceGetCurrentClocksThrottleReasons");
+    if (nvmlInit == 0 || getCount == 0 || getHandle == 0 || _nvmlGetClockInfo == 0 ||
+        nvmlInit() != 0)
+    {
+        // nothing to shut down if it didn't start
+        _nvmlShutdown = 0;
+        this->Cleanup();
+        return false;
+    }
+
+    unsigned int deviceCount = 0;
+    getCount(&deviceCount);
+    const char *renderer = (const char *)glGetString(GL_RENDERER);
+    for (unsigned int deviceIndex = 0; deviceIndex < deviceCount; deviceIndex++)
+    {
+        void *device = 0;
+        char deviceName[96] = "";
+        if (getHandle(deviceIndex, &device) != 0)
+        {
+            continue;
+        }
+        if (_nvmlDevice == 0)
+        {
+            _nvmlDevice = device;
+        }
+        if (getName != 0 && getName(device, deviceName, sizeof(deviceName)) == 0 &&
+            renderer != 0 && strstr(renderer, deviceName) != 0)
+        {
+            _nvmlDevice = device;
+            break;
+        }
+    }
+    if (_nvmlDevice == 0)
+    {
+        this->Cleanup();
+        return false;
+    }
+
+    _backend = BACKEND_NVML;
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Finds the first DRM card of the given PCI vendor, and its hwmon directory if it has one.
+Parameters:
+    pciVendorId     As it is in sysfs (ex: "0x1002").
+Returns:
+    False if there is no such card, or it has no clock to read, or this isn't Linux.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool GpuClockMonitor::InitSysfs(const char *pciVendorId)
+{
+#ifdef WIN32
+    (void)pciVendorId;
+    return false;
+#else
+    for (unsigned int cardIndex = 0; cardIndex < 16; cardIndex++)
+    {
+        char cardPath[64];
+        snprintf(cardPath, sizeof(cardPath), "/sys/class/drm/card%u/", cardIndex);
+        std::string devicePath = std::string(cardPath) + "device/";
+        FILE *vendorFile = fopen((devicePath + "vendor").c_str(), "r");
+        if (vendorFile == 0)
+        {
+            continue;
+        }
+        char vendor[16] = "";
+        bool isVendor = fscanf(vendorFile, "%15s", vendor) == 1 && strcmp(vendor, pciVendorId) == 0;
+        fclose(vendorFile);
+        if (!isVendor)
+        {
+            continue;
+        }
+
+        _sysfsCardPath = cardPath;
+        _sysfsDevicePath = devicePath;
+        for (unsigned int hwmonIndex = 0; hwmonIndex < 16; hwmonIndex++)
+        {
+            char hwmonPath[64];
+            snprintf(hwmonPath, sizeof(hwmonPath), "hwmon/hwmon%u/", hwmonIndex);
+            double ignored = 0.0;
+            if (ReadFileNumber(devicePath + hwmonPath + "temp1_input", &ignored))
+            {
+                _sysfsHwmonPath = devicePath + hwmonPath;
+                break;
+            }
+        }
+
+        _backend = BACKEND_SYSFS;
+        GpuClockSample sample;
+        if (this->SampleSysfs(&sample))
+        {
+            return true;
+        }
+        this->Cleanup();
+    }
+    return false;
+#endif
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Reads a sample from NVML.
+Parameters:
+    putSampleHere   Self-explanatory.  What can't be read is left alone.
+Returns:
+    False if the graphics clock couldn't be read.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool GpuClockMonitor::SampleNvml(GpuClockSample *putSampleHere)
+{
+    unsigned int value = 0;
+    NvmlDeviceGetClockInfoProc getClockInfo = (NvmlDeviceGetClockInfoProc)_nvmlGetClockInfo;
+    if (getClockInfo(_nvmlDevice, NVML_CLOCK_GRAPHICS, &value) != 0)
+    {
+        return false;
+    }
+    putSampleHere->_graphicsClockMhz = (float)value;
+    if (getClockInfo(_nvmlDevice, NVML_CLOCK_MEM, &value) == 0)
+    {
+        putSampleHere->_memoryClockMhz = (float)value;
+    }
+    if (_nvmlGetTemperature != 0 && ((NvmlDeviceGetTemperatureProc)_nvmlGetTemperature)(
+        _nvmlDevice, NVML_TEMPERATURE_GPU, &value) == 0)
+    {
+        putSampleHere->_temperatureC = (float)value;
+    }
+    if (_nvmlGetPowerUsage != 0 &&
+        ((NvmlDeviceGetPowerUsageProc)_nvmlGetPowerUsage)(_nvmlDevice, &value) == 0)
+    {
+        putSampleHere->_powerW = value / 1000.0f;
+    }
+    unsigned long long reasons = 0;
+    if (_nvmlGetThrottleReasons != 0 &&
+        ((NvmlDeviceGetThrottleReasonsProc)_nvmlGetThrottleReasons)(_nvmlDevice, &reasons) == 0)
+    {
+        putSampleHere->_throttleReasons = reasons;
+    }
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Reads a sample from sysfs.  amdgpu has its clock tables in the device directory, and
+    i915 has its actual frequency in the card directory.  The temperature (millidegrees) and
+    the power (microwatts) are from hwmon, if there is one.
+Parameters:
+    putSampleHere   Self-explanatory.  What can't be read is left alone.
+Returns:
+    False if the graphics clock couldn't be read.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool GpuClockMonitor::SampleSysfs(GpuClockSample *putSampleHere)
+{
+    double number = 0.0;
+    float clockMhz = 0.0f;
+    if (ReadDpmClock(_sysfsDevicePath + "pp_dpm_sclk", &clockMhz))
+    {
+        putSampleHere->_graphicsClockMhz = clockMhz;
+    }
+    else if (ReadFileNumber(_sysfsCardPath + "gt_act_freq_mhz", &number))
+    {
+        putSampleHere->_graphicsClockMhz = (float)number;
+    }
+    else
+    {
+        return false;
+    }
+    if (ReadDpmClock(_sysfsDevicePath + "pp_dpm_mclk", &clockMhz))
+    {
+        putSampleHere->_memoryClockMhz = clockMhz;
+    }
+
+    if (!_sysfsHwmonPath.empty())
+    {
+        if (ReadFileNumber(_sysfsHwmonPath + "temp1_input", &number))
+        {
+            putSampleHere->_temperatureC = (float)(number / 1000.0);
+        }
+        if (ReadFileNumber(_sysfsHwmonPath + "power1_average", &number) ||
+            ReadFileNumber(_sysfsHwmonPath + "power1_input", &number))
+        {
+            putSampleHere->_powerW = (float)(number / 1000000.0);
+        }
+    }
+    return true;
+}
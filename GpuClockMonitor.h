@@ -0,0 +1,123 @@
+#pragma once
+
+#include <string>
+#include <functional>
+
+// what the GPU was running at when it was sampled
+// Note: A value that the backend can't read is -1.  The throttle reasons are NVML's
+// (nvmlClocksThrottleReasons), and are 0 for the other backends, which go by the clock alone
+// (see GpuClockMonitor::IsThrottled(...)).
+struct GpuClockSample
+{
+    float _graphicsClockMhz;
+    float _memoryClockMhz;
+    float _temperatureC;
+    float _powerW;
+    unsigned long long _throttleReasons;
+};
+
+// a measurement window's samples, summed up (see GpuClockMonitor::BeginWindow())
+struct GpuClockWindow
+{
+    unsigned int _sampleCount;
+    unsigned int _throttledSampleCount;
+    float _minGraphicsClockMhz;
+    float _avgGraphicsClockMhz;
+    float _maxTemperatureC;
+    float _avgPowerW;
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Reads the GPU's clocks, temperature, and power while the benchmark runs, so that a
+    measurement taken while the GPU was throttling (too hot, or over its power limit) can be
+    told apart from a real change in the code.  On a fleet of machines, or on one machine
+    that has been running for a while, the same build can be 10-30% slower for no other
+    reason.
+
+    The backend goes by the GL_VENDOR of the current context:
+        - NVIDIA: NVML, loaded at run time from the driver (nvml.dll or libnvidia-ml.so.1),
+          so nothing is linked and a machine without it just has no backend.  NVML says why
+          the clocks are down, so a sample is throttled if any of the thermal, power, or
+          hardware slowdown reasons are set.
+        - AMD and Intel on Linux: the kernel driver's sysfs files (amdgpu's hwmon and
+          pp_dpm_sclk, and i915's gt_act_freq_mhz).  These don't say why, so a sample is
+          throttled if its graphics clock is under THROTTLE_CLOCK_FRACTION of the steady
+          clock that WaitForStableClocks(...) found, or of the highest one seen.
+    AMD's ADL and Intel's tools on Windows aren't used, so there is no backend there.
+
+    Between BeginWindow() and GetWindow(...), each SampleWindow() adds a sample to the window,
+    so the benchmark can call it every so many frames and then annotate the measurement with
+    the window's lowest and average clock, its hottest temperature, and how many of its
+    samples were throttled.
+
+    Note: The files and the NVML calls take microseconds, but they aren't free, so sample
+    every several frames and not every frame.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class GpuClockMonitor
+{
+public:
+    GpuClockMonitor();
+    ~GpuClockMonitor();
+    bool Init();
+    void Cleanup();
+
+    bool HasBackend() const;
+    const char *GetBackendName() const;
+    bool Sample(GpuClockSample *putSampleHere);
+    bool IsThrottled(const GpuClockSample &sample) const;
+
+    void BeginWindow();
+    void SampleWindow();
+    void GetWindow(GpuClockWindow *putWindowHere) const;
+
+    bool WaitForStableClocks(const std::function<void()> &runWorkload, double timeoutSec);
+
+    // see the class description
+    static const float THROTTLE_CLOCK_FRACTION;
+
+private:
+    bool InitNvml();
+    bool InitSysfs(const char *pciVendorId);
+    bool SampleNvml(GpuClockSample *putSampleHere);
+    bool SampleSysfs(GpuClockSample *putSampleHere);
+
+    enum Backend
+    {
+        BACKEND_NONE = 0,
+        BACKEND_NVML,
+        BACKEND_SYSFS,
+    };
+    Backend _backend;
+
+    // NVML's library and the functions that are used from it, as void pointers so that the
+    // header stays free of it (see GpuClockMonitor.cpp)
+    void *_nvmlLibrary;
+    void *_nvmlDevice;
+    void *_nvmlShutdown;
+    void *_nvmlGetClockInfo;
+    void *_nvmlGetTemperature;
+    void *_nvmlGetPowerUsage;
+    void *_nvmlGetThrottleReasons;
+
+    // the card's sysfs directory (ex: "/sys/class/drm/card0/device/") and its hwmon directory,
+    // which may be empty
+    std::string _sysfsDevicePath;
+    std::string _sysfsCardPath;
+    std::string _sysfsHwmonPath;
+
+    // what a sample's clock is held up against, for the backends that can't say why
+    float _steadyGraphicsClockMhz;
+    float _highestGraphicsClockMhz;
+
+    // the window's sums
+    unsigned int _windowSampleCount;
+    unsigned int _windowThrottledCount;
+    float _windowMinClockMhz;
+    double _windowClockSumMhz;
+    unsigned int _windowClockCount;
+    float _windowMaxTemperatureC;
+    double _windowPowerSumW;
+    unsigned int _windowPowerCount;
+};
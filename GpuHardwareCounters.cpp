@@ -0,0 +1,832 @@
+#include "GpuHardwareCounters.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "ComputeDeviceCaps.h"
+#include "Log.h"
+
+#include <ctype.h>
+#include <string.h>
+
+// GL_INTEL_performance_query's
+// Note: This version of glload is older than the extension, so the functions are looked up by
+// hand (see GetGlFunctionAddress(...)).
+static const GLuint PERFQUERY_DONOT_FLUSH_INTEL = 0x83F9;
+static const GLuint PERFQUERY_COUNTER_DATA_UINT32_INTEL = 0x94F8;
+static const GLuint PERFQUERY_COUNTER_DATA_UINT64_INTEL = 0x94F9;
+static const GLuint PERFQUERY_COUNTER_DATA_FLOAT_INTEL = 0x94FA;
+static const GLuint PERFQUERY_COUNTER_DATA_DOUBLE_INTEL = 0x94FB;
+static const GLuint PERFQUERY_COUNTER_DATA_BOOL32_INTEL = 0x94FC;
+typedef void (CODEGEN_FUNCPTR *GetFirstPerfQueryIdIntelProc)(GLuint *queryId);
+typedef void (CODEGEN_FUNCPTR *GetNextPerfQueryIdIntelProc)(GLuint queryId,
+    GLuint *nextQueryId);
+typedef void (CODEGEN_FUNCPTR *GetPerfQueryInfoIntelProc)(GLuint queryId,
+    GLuint queryNameLength, GLchar *queryName, GLuint *dataSize, GLuint *noCounters,
+    GLuint *noInstances, GLuint *capsMask);
+typedef void (CODEGEN_FUNCPTR *GetPerfCounterInfoIntelProc)(GLuint queryId, GLuint counterId,
+    GLuint counterNameLength, GLchar *counterName, GLuint counterDescLength,
+    GLchar *counterDesc, GLuint *counterOffset, GLuint *counterDataSize,
+    GLuint *counterTypeEnum, GLuint *counterDataTypeEnum, GLuint64 *rawCounterMaxValue);
+typedef void (CODEGEN_FUNCPTR *CreatePerfQueryIntelProc)(GLuint queryId, GLuint *queryHandle);
+typedef void (CODEGEN_FUNCPTR *PerfQueryHandleIntelProc)(GLuint queryHandle);
+typedef void (CODEGEN_FUNCPTR *GetPerfQueryDataIntelProc)(GLuint queryHandle, GLuint flags,
+    GLsizei dataSize, GLvoid *data, GLuint *bytesWritten);
+static GetFirstPerfQueryIdIntelProc gGetFirstPerfQueryIdIntel = 0;
+static GetNextPerfQueryIdIntelProc gGetNextPerfQueryIdIntel = 0;
+static GetPerfQueryInfoIntelProc gGetPerfQueryInfoIntel = 0;
+static GetPerfCounterInfoIntelProc gGetPerfCounterInfoIntel = 0;
+static CreatePerfQueryIntelProc gCreatePerfQueryIntel = 0;
+static PerfQueryHandleIntelProc gDeletePerfQueryIntel = 0;
+static PerfQueryHandleIntelProc gBeginPerfQueryIntel = 0;
+static PerfQueryHandleIntelProc gEndPerfQueryIntel = 0;
+static GetPerfQueryDataIntelProc gGetPerfQueryDataIntel = 0;
+
+// the words that the counters' names are matched against if SetCounterFilter(...) isn't
+// called: memory traffic, cache hits, occupancy, and how busy the ALUs are, in the words that
+// AMD's and Intel's counters use for them
+static const char *DEFAULT_COUNTER_FILTER =
+    "bandwidth,throughput,hit,occupancy,wave,alu,busy,eu active,eu stall";
+
+// the longest counter or group name that is kept
+static const unsigned int MAX_COUNTER_NAME_LENGTH = 256;
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+GpuHardwareCounters::GpuHardwareCounters() :
+    _backend(GPU_HARDWARE_COUNTER_BACKEND_NONE),
+    _intelQueryId(0),
+    _intelDataSize(0),
+    _countingScopeId(-1),
+    _frameIndex(0),
+    _printIntervalFrames(0),
+    _droppedSamples(0)
+{
+    this->SetCounterFilter(DEFAULT_COUNTER_FILTER);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+GpuHardwareCounters::~GpuHardwareCounters()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets the words that Init(...) looks for in the counters' names.  A counter is kept if its
+    name has any of them in it, ignoring case.  Call before Init(...).
+Parameters:
+    commaSeparatedWords     Ex: "l3,occupancy".  Empty keeps the default list (memory
+                            throughput, cache hits, occupancy, and ALU utilization).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GpuHardwareCounters::SetCounterFilter(const std::string &commaSeparatedWords)
+{
+    std::string words =
+        commaSeparatedWords.empty() ? DEFAULT_COUNTER_FILTER : commaSeparatedWords;
+    _filterWords.clear();
+    size_t wordStart = 0;
+    while (wordStart <= words.size())
+    {
+        size_t wordEnd = words.find(',', wordStart);
+        if (wordEnd == std::string::npos)
+        {
+            wordEnd = words.size();
+        }
+        std::string word = words.substr(wordStart, wordEnd - wordStart);
+        for (size_t charIndex = 0; charIndex < word.size(); charIndex++)
+        {
+            word[charIndex] = (char)tolower((unsigned char)word[charIndex]);
+        }
+        if (!word.empty())
+        {
+            _filterWords.push_back(word);
+        }
+        wordStart = wordEnd + 1;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Finds the driver's counter extension and selects the counters that pass the filter (see
+    SetCounterFilter(...)).  Needs a current context.
+Parameters:
+    printIntervalFrames     PrintStats() will be called automatically every this many frames,
+                            and the averages reset after.  0 to never print.
+Returns:
+    True if there are counters to sample, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool GpuHardwareCounters::Init(unsigned int printIntervalFrames)
+{
+    this->Cleanup();
+    _printIntervalFrames = printIntervalFrames;
+
+    if (glext_AMD_performance_monitor)
+    {
+        _backend = GPU_HARDWARE_COUNTER_BACKEND_AMD_PERFORMANCE_MONITOR;
+        this->SelectAmdCounters();
+    }
+    else if (IsGlExtensionSupported("GL_INTEL_performance_query"))
+    {
+        gGetFirstPerfQueryIdIntel =
+            (GetFirstPerfQueryIdIntelProc)GetGlFunctionAddress("glGetFirstPerfQueryIdINTEL");
+        gGetNextPerfQueryIdIntel =
+            (GetNextPerfQueryIdIntelProc)GetGlFunctionAddress("glGetNextPerfQueryIdINTEL");
+        gGetPerfQueryInfoIntel =
+            (GetPerfQueryInfoIntelProc)GetGlFunctionAddress("glGetPerfQueryInfoINTEL");
+        gGetPerfCounterInfoIntel =
+            (GetPerfCounterInfoIntelProc)GetGlFunctionAddress("glGetPerfCounterInfoINTEL");
+        gCreatePerfQueryIntel =
+            (CreatePerfQueryIntelProc)GetGlFunctionAddress("glCreatePerfQueryINTEL");
+        gDeletePerfQueryIntel =
+            (PerfQueryHandleIntelProc)GetGlFunctionAddress("glDeletePerfQueryINTEL");
+        gBeginPerfQueryIntel =
+            (PerfQueryHandleIntelProc)GetGlFunctionAddress("glBeginPerfQueryINTEL");
+        gEndPerfQueryIntel =
+            (PerfQueryHandleIntelProc)GetGlFunctionAddress("glEndPerfQueryINTEL");
+        gGetPerfQueryDataIntel =
+            (GetPerfQueryDataIntelProc)GetGlFunctionAddress("glGetPerfQueryDataINTEL");
+        if (gGetFirstPerfQueryIdIntel != 0 && gGetNextPerfQueryIdIntel != 0 &&
+            gGetPerfQueryInfoIntel != 0 && gGetPerfCounterInfoIntel != 0 &&
+            gCreatePerfQueryIntel != 0 && gDeletePerfQueryIntel != 0 &&
+            gBeginPerfQueryIntel != 0 && gEndPerfQueryIntel != 0 &&
+            gGetPerfQueryDataIntel != 0)
+        {
+            _backend = GPU_HARDWARE_COUNTER_BACKEND_INTEL_PERFORMANCE_QUERY;
+            this->SelectIntelCounters();
+        }
+    }
+
+    if (_counters.empty())
+    {
+        LogPrintf("gpu counters: %s\n", (_backend == GPU_HARDWARE_COUNTER_BACKEND_NONE) ?
+            "the driver has no counter extension" : "no counters matched the filter");
+        _backend = GPU_HARDWARE_COUNTER_BACKEND_NONE;
+        return false;
+    }
+
+    LogPrintf("gpu counters: %u from %s\n", (unsigned int)_counters.size(),
+        this->GetBackendName());
+    for (size_t counterIndex = 0; counterIndex < _counters.size(); counterIndex++)
+    {
+        LogPrintf("    %s\n", _counters[counterIndex]._name.c_str());
+    }
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Deletes every scope's monitors or queries and forgets the counters.  Must be called while
+    the OpenGL context is still alive.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GpuHardwareCounters::Cleanup()
+{
+    for (size_t scopeIndex = 0; scopeIndex < _scopes.size(); scopeIndex++)
+    {
+        Scope &scope = _scopes[scopeIndex];
+        if (_backend == GPU_HARDWARE_COUNTER_BACKEND_AMD_PERFORMANCE_MONITOR)
+        {
+            glDeletePerfMonitorsAMD(FRAMES_IN_FLIGHT, scope._handles);
+        }
+        else if (_backend == GPU_HARDWARE_COUNTER_BACKEND_INTEL_PERFORMANCE_QUERY)
+        {
+            for (unsigned int slot = 0; slot < FRAMES_IN_FLIGHT; slot++)
+            {
+                gDeletePerfQueryIntel(scope._handles[slot]);
+            }
+        }
+    }
+    _scopes.clear();
+    _counters.clear();
+    _backend = GPU_HARDWARE_COUNTER_BACKEND_NONE;
+    _intelQueryId = 0;
+    _intelDataSize = 0;
+    _countingScopeId = -1;
+    _frameIndex = 0;
+    _droppedSamples = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Creates a new named scope and its ring of monitors or queries.  Without counters, the
+    scope is still made, so that the IDs don't depend on the driver, but it never counts.
+Parameters:
+    name    Used when printing.  Ex: "update", "render".
+Returns:
+    The ID to give to BeginScope(...) and EndScope(...).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int GpuHardwareCounters::AddScope(const std::string &name)
+{
+    Scope scope;
+    scope._name = name;
+    for (unsigned int slot = 0; slot < FRAMES_IN_FLIGHT; slot++)
+    {
+        scope._handles[slot] = 0;
+        scope._issued[slot] = false;
+    }
+    scope._sums.resize(_counters.size(), 0.0);
+    scope._sampleCount = 0;
+
+    if (_backend == GPU_HARDWARE_COUNTER_BACKEND_AMD_PERFORMANCE_MONITOR)
+    {
+        glGenPerfMonitorsAMD(FRAMES_IN_FLIGHT, scope._handles);
+        for (unsigned int slot = 0; slot < FRAMES_IN_FLIGHT; slot++)
+        {
+            for (size_t counterIndex = 0; counterIndex < _counters.size(); counterIndex++)
+            {
+                GLuint counterId = _counters[counterIndex]._counterIdOrSize;
+                glSelectPerfMonitorCountersAMD(scope._handles[slot], GL_TRUE,
+                    _counters[counterIndex]._groupOrOffset, 1, &counterId);
+            }
+        }
+    }
+    else if (_backend == GPU_HARDWARE_COUNTER_BACKEND_INTEL_PERFORMANCE_QUERY)
+    {
+        for (unsigned int slot = 0; slot < FRAMES_IN_FLIGHT; slot++)
+        {
+            gCreatePerfQueryIntel(_intelQueryId, &scope._handles[slot]);
+        }
+    }
+
+    _scopes.push_back(scope);
+    return (unsigned int)(_scopes.size() - 1);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Starts counting for the scope, unless another scope is already counting.
+Parameters:
+    scopeId     From AddScope(...).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GpuHardwareCounters::BeginScope(unsigned int scopeId)
+{
+    if (scopeId >= _scopes.size() || _counters.empty() || _countingScopeId >= 0)
+    {
+        return;
+    }
+
+    unsigned int handle = _scopes[scopeId]._handles[_frameIndex % FRAMES_IN_FLIGHT];
+    if (_backend == GPU_HARDWARE_COUNTER_BACKEND_AMD_PERFORMANCE_MONITOR)
+    {
+        glBeginPerfMonitorAMD(handle);
+    }
+    else
+    {
+        gBeginPerfQueryIntel(handle);
+    }
+    _countingScopeId = (int)scopeId;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Stops counting for the scope, if it was the one counting.
+Parameters:
+    scopeId     From AddScope(...).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GpuHardwareCounters::EndScope(unsigned int scopeId)
+{
+    if (_countingScopeId != (int)scopeId)
+    {
+        return;
+    }
+
+    unsigned int slot = _frameIndex % FRAMES_IN_FLIGHT;
+    unsigned int handle = _scopes[scopeId]._handles[slot];
+    if (_backend == GPU_HARDWARE_COUNTER_BACKEND_AMD_PERFORMANCE_MONITOR)
+    {
+        glEndPerfMonitorAMD(handle);
+    }
+    else
+    {
+        gEndPerfQueryIntel(handle);
+    }
+    _scopes[scopeId]._issued[slot] = true;
+    _countingScopeId = -1;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Collects the counters of the oldest frame in the ring without waiting on the GPU, then
+    advances to the next frame.  Call once per frame after everything has been submitted.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GpuHardwareCounters::EndFrame()
+{
+    if (_counters.empty())
+    {
+        return;
+    }
+
+    unsigned int oldestSlot = (_frameIndex + 1) % FRAMES_IN_FLIGHT;
+    for (size_t scopeIndex = 0; scopeIndex < _scopes.size(); scopeIndex++)
+    {
+        Scope &scope = _scopes[scopeIndex];
+        if (!scope._issued[oldestSlot])
+        {
+            continue;
+        }
+        scope._issued[oldestSlot] = false;
+
+        bool isCollected = (_backend == GPU_HARDWARE_COUNTER_BACKEND_AMD_PERFORMANCE_MONITOR) ?
+            this->CollectAmdSample(scope._handles[oldestSlot], &_sampleValues) :
+            this->CollectIntelSample(scope._handles[oldestSlot], &_sampleValues);
+        if (!isCollected)
+        {
+            _droppedSamples++;
+            continue;
+        }
+        for (size_t counterIndex = 0; counterIndex < _counters.size(); counterIndex++)
+        {
+            scope._sums[counterIndex] += _sampleValues[counterIndex];
+        }
+        scope._sampleCount++;
+    }
+
+    _frameIndex++;
+    if (_printIntervalFrames > 0 && (_frameIndex % _printIntervalFrames) == 0)
+    {
+        this->PrintStats();
+        this->ResetAverages();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    Where the counters come from, or GPU_HARDWARE_COUNTER_BACKEND_NONE if there are none.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+GpuHardwareCounterBackend GpuHardwareCounters::GetBackend() const
+{
+    return _backend;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The extension that the counters come from, or "none".
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+const char *GpuHardwareCounters::GetBackendName() const
+{
+    if (_backend == GPU_HARDWARE_COUNTER_BACKEND_AMD_PERFORMANCE_MONITOR)
+    {
+        return "GL_AMD_performance_monitor";
+    }
+    else if (_backend == GPU_HARDWARE_COUNTER_BACKEND_INTEL_PERFORMANCE_QUERY)
+    {
+        return "GL_INTEL_performance_query";
+    }
+    return "none";
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The number of counters that Init(...) selected.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int GpuHardwareCounters::GetCounterCount() const
+{
+    return (unsigned int)_counters.size();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    counterIndex    Less than GetCounterCount().
+Returns:
+    The counter's name as the driver gave it; for AMD, prefixed by its group.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+const std::string &GpuHardwareCounters::GetCounterName(unsigned int counterIndex) const
+{
+    return _counters[counterIndex]._name;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Averages each counter of the scope over its samples since the last reset.
+Parameters:
+    scopeId             From AddScope(...).
+    putAveragesHere     One per counter, in the order of GetCounterName(...).
+Returns:
+    False if the scope doesn't exist or has no samples, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool GpuHardwareCounters::GetAverages(unsigned int scopeId,
+    std::vector<double> *putAveragesHere) const
+{
+    if (scopeId >= _scopes.size() || _scopes[scopeId]._sampleCount == 0)
+    {
+        return false;
+    }
+
+    const Scope &scope = _scopes[scopeId];
+    putAveragesHere->resize(_counters.size());
+    for (size_t counterIndex = 0; counterIndex < _counters.size(); counterIndex++)
+    {
+        (*putAveragesHere)[counterIndex] = scope._sums[counterIndex] / scope._sampleCount;
+    }
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Starts every scope's averages over.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GpuHardwareCounters::ResetAverages()
+{
+    for (size_t scopeIndex = 0; scopeIndex < _scopes.size(); scopeIndex++)
+    {
+        Scope &scope = _scopes[scopeIndex];
+        for (size_t counterIndex = 0; counterIndex < scope._sums.size(); counterIndex++)
+        {
+            scope._sums[counterIndex] = 0.0;
+        }
+        scope._sampleCount = 0;
+    }
+    _droppedSamples = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Prints each counter's average in every scope that has samples, a line per counter.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GpuHardwareCounters::PrintStats() const
+{
+    std::vector<double> averages;
+    for (unsigned int scopeId = 0; scopeId < _scopes.size(); scopeId++)
+    {
+        if (!this->GetAverages(scopeId, &averages))
+        {
+            continue;
+        }
+        for (size_t counterIndex = 0; counterIndex < _counters.size(); counterIndex++)
+        {
+            LogPrintf("hw  %-10s %-48s %16.2f\n", _scopes[scopeId]._name.c_str(),
+                _counters[counterIndex]._name.c_str(), averages[counterIndex]);
+        }
+    }
+    if (_droppedSamples > 0)
+    {
+        LogPrintf("gpu counters: %u samples dropped\n", _droppedSamples);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Goes through every group of AMD counters and keeps the ones that pass the filter, up to
+    the most that the group can have active at once.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GpuHardwareCounters::SelectAmdCounters()
+{
+    GLint groupCount = 0;
+    glGetPerfMonitorGroupsAMD(&groupCount, 0, 0);
+    if (groupCount <= 0)
+    {
+        return;
+    }
+    std::vector<GLuint> groups(groupCount);
+    glGetPerfMonitorGroupsAMD(0, groupCount, groups.data());
+
+    char groupName[MAX_COUNTER_NAME_LENGTH];
+    char counterName[MAX_COUNTER_NAME_LENGTH];
+    for (GLint groupIndex = 0; groupIndex < groupCount; groupIndex++)
+    {
+        GLuint group = groups[groupIndex];
+        GLint counterCount = 0;
+        GLint maxActiveCounters = 0;
+        glGetPerfMonitorCountersAMD(group, &counterCount, &maxActiveCounters, 0, 0);
+        if (counterCount <= 0)
+        {
+            continue;
+        }
+        std::vector<GLuint> counterIds(counterCount);
+        glGetPerfMonitorCountersAMD(group, &counterCount, &maxActiveCounters, counterCount,
+            counterIds.data());
+
+        GLsizei nameLength = 0;
+        glGetPerfMonitorGroupStringAMD(group, MAX_COUNTER_NAME_LENGTH, &nameLength, groupName);
+        GLint activeCounters = 0;
+        for (GLint counterIndex = 0; counterIndex < counterCount &&
+            activeCounters < maxActiveCounters && _counters.size() < MAX_COUNTERS;
+            counterIndex++)
+        {
+            GLuint counterId = counterIds[counterIndex];
+            glGetPerfMonitorCounterStringAMD(group, counterId, MAX_COUNTER_NAME_LENGTH,
+                &nameLength, counterName);
+            std::string name = std::string(groupName) + "." + counterName;
+            if (!this->IsCounterNameWanted(name))
+            {
+                continue;
+            }
+
+            GLuint counterType = 0;
+            glGetPerfMonitorCounterInfoAMD(group, counterId, GL_COUNTER_TYPE_AMD, &counterType);
+            Counter counter;
+            counter._name = name;
+            counter._groupOrOffset = group;
+            counter._counterIdOrSize = counterId;
+            counter._dataType = counterType;
+            _counters.push_back(counter);
+            activeCounters++;
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Intel's counters come in fixed sets (queries), and only one set can be sampled at a
+    time, so this picks the set with the most counters that pass the filter and keeps those.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GpuHardwareCounters::SelectIntelCounters()
+{
+    char queryName[MAX_COUNTER_NAME_LENGTH];
+    char counterName[MAX_COUNTER_NAME_LENGTH];
+    char counterDescription[MAX_COUNTER_NAME_LENGTH];
+    std::vector<Counter> queryCounters;
+    std::string selectedQueryName;
+
+    // query IDs start at 1, and 0 is the end of the list
+    GLuint queryId = 0;
+    gGetFirstPerfQueryIdIntel(&queryId);
+    while (queryId != 0)
+    {
+        GLuint dataSize = 0;
+        GLuint counterCount = 0;
+        GLuint instanceCount = 0;
+        GLuint capsMask = 0;
+        gGetPerfQueryInfoIntel(queryId, MAX_COUNTER_NAME_LENGTH, queryName, &dataSize,
+            &counterCount, &instanceCount, &capsMask);
+
+        queryCounters.clear();
+        for (GLuint counterId = 1; counterId <= counterCount &&
+            queryCounters.size() < MAX_COUNTERS; counterId++)
+        {
+            GLuint offset = 0;
+            GLuint counterDataSize = 0;
+            GLuint counterType = 0;
+            GLuint counterDataType = 0;
+            GLuint64 rawMaxValue = 0;
+            gGetPerfCounterInfoIntel(queryId, counterId, MAX_COUNTER_NAME_LENGTH, counterName,
+                MAX_COUNTER_NAME_LENGTH, counterDescription, &offset, &counterDataSize,
+                &counterType, &counterDataType, &rawMaxValue);
+            if (!this->IsCounterNameWanted(counterName) ||
+                offset + counterDataSize > dataSize)
+            {
+                continue;
+            }
+
+            Counter counter;
+            counter._name = counterName;
+            counter._groupOrOffset = offset;
+            counter._counterIdOrSize = counterDataSize;
+            counter._dataType = counterDataType;
+            queryCounters.push_back(counter);
+        }
+        if (queryCounters.size() > _counters.size())
+        {
+            _counters = queryCounters;
+            _intelQueryId = queryId;
+            _intelDataSize = dataSize;
+            selectedQueryName = queryName;
+        }
+
+        GLuint nextQueryId = 0;
+        gGetNextPerfQueryIdIntel(queryId, &nextQueryId);
+        queryId = nextQueryId;
+    }
+
+    if (!_counters.empty())
+    {
+        LogPrintf("gpu counters: from the \"%s\" query\n", selectedQueryName.c_str());
+        _intelData.resize(_intelDataSize);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    counterName     Self-explanatory.
+Returns:
+    True if the name has any of the filter's words in it, ignoring case, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool GpuHardwareCounters::IsCounterNameWanted(const std::string &counterName) const
+{
+    std::string lowerName = counterName;
+    for (size_t charIndex = 0; charIndex < lowerName.size(); charIndex++)
+    {
+        lowerName[charIndex] = (char)tolower((unsigned char)lowerName[charIndex]);
+    }
+    for (size_t wordIndex = 0; wordIndex < _filterWords.size(); wordIndex++)
+    {
+        if (lowerName.find(_filterWords[wordIndex]) != std::string::npos)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Reads an AMD monitor's results if they are ready.  They are a list of (group, counter,
+    value) entries, where the value is 1 or 2 words long depending on the counter's type, so
+    each is matched back to the counter that it belongs to.
+Parameters:
+    handle          The monitor.
+    putValuesHere   One per counter.
+Returns:
+    False if the GPU isn't done with the monitor, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool GpuHardwareCounters::CollectAmdSample(unsigned int handle,
+    std::vector<double> *putValuesHere)
+{
+    GLuint isAvailable = 0;
+    glGetPerfMonitorCounterDataAMD(handle, GL_PERFMON_RESULT_AVAILABLE_AMD, sizeof(GLuint),
+        &isAvailable, 0);
+    if (isAvailable == 0)
+    {
+        return false;
+    }
+
+    GLuint resultBytes = 0;
+    glGetPerfMonitorCounterDataAMD(handle, GL_PERFMON_RESULT_SIZE_AMD, sizeof(GLuint),
+        &resultBytes, 0);
+    _amdData.resize(resultBytes / sizeof(GLuint));
+    GLint bytesWritten = 0;
+    glGetPerfMonitorCounterDataAMD(handle, GL_PERFMON_RESULT_AMD, resultBytes,
+        _amdData.data(), &bytesWritten);
+
+    putValuesHere->assign(_counters.size(), 0.0);
+    size_t wordCount = (size_t)bytesWritten / sizeof(GLuint);
+    size_t wordIndex = 0;
+    while (wordIndex + 2 < wordCount)
+    {
+        GLuint group = _amdData[wordIndex];
+        GLuint counterId = _amdData[wordIndex + 1];
+        wordIndex += 2;
+
+        size_t counterIndex = 0;
+        while (counterIndex < _counters.size() &&
+            (_counters[counterIndex]._groupOrOffset != group ||
+            _counters[counterIndex]._counterIdOrSize != counterId))
+        {
+            counterIndex++;
+        }
+        GLuint counterType = (counterIndex < _counters.size()) ?
+            _counters[counterIndex]._dataType : GL_UNSIGNED_INT;
+
+        double value = 0.0;
+        if (counterType == GL_UNSIGNED_INT64_AMD)
+        {
+            if (wordIndex + 1 >= wordCount)
+            {
+                break;
+            }
+            unsigned long long bigValue = 0;
+            memcpy(&bigValue, &_amdData[wordIndex], sizeof(bigValue));
+            value = (double)bigValue;
+            wordIndex += 2;
+        }
+        else if (counterType == GL_FLOAT || counterType == GL_PERCENTAGE_AMD)
+        {
+            float floatValue = 0.0f;
+            memcpy(&floatValue, &_amdData[wordIndex], sizeof(floatValue));
+            value = floatValue;
+            wordIndex += 1;
+        }
+        else
+        {
+            value = (double)_amdData[wordIndex];
+            wordIndex += 1;
+        }
+
+        if (counterIndex < _counters.size())
+        {
+            (*putValuesHere)[counterIndex] = value;
+        }
+    }
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Reads an Intel query's results if they are ready, without flushing.  They are one block,
+    with each counter's value at its own offset.
+Parameters:
+    handle          The query.
+    putValuesHere   One per counter.
+Returns:
+    False if the GPU isn't done with the query, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool GpuHardwareCounters::CollectIntelSample(unsigned int handle,
+    std::vector<double> *putValuesHere)
+{
+    GLuint bytesWritten = 0;
+    gGetPerfQueryDataIntel(handle, PERFQUERY_DONOT_FLUSH_INTEL, (GLsizei)_intelDataSize,
+        _intelData.data(), &bytesWritten);
+    if (bytesWritten == 0)
+    {
+        return false;
+    }
+
+    putValuesHere->assign(_counters.size(), 0.0);
+    for (size_t counterIndex = 0; counterIndex < _counters.size(); counterIndex++)
+    {
+        const Counter &counter = _counters[counterIndex];
+        const unsigned char *valueBytes = &_intelData[counter._groupOrOffset];
+        double value = 0.0;
+        if (counter._dataType == PERFQUERY_COUNTER_DATA_UINT32_INTEL ||
+            counter._dataType == PERFQUERY_COUNTER_DATA_BOOL32_INTEL)
+        {
+            unsigned int smallValue = 0;
+            memcpy(&smallValue, valueBytes, sizeof(smallValue));
+            value = (double)smallValue;
+        }
+        else if (counter._dataType == PERFQUERY_COUNTER_DATA_UINT64_INTEL)
+        {
+            unsigned long long bigValue = 0;
+            memcpy(&bigValue, valueBytes, sizeof(bigValue));
+            value = (double)bigValue;
+        }
+        else if (counter._dataType == PERFQUERY_COUNTER_DATA_FLOAT_INTEL)
+        {
+            float floatValue = 0.0f;
+            memcpy(&floatValue, valueBytes, sizeof(floatValue));
+            value = floatValue;
+        }
+        else if (counter._dataType == PERFQUERY_COUNTER_DATA_DOUBLE_INTEL)
+        {
+            memcpy(&value, valueBytes, sizeof(value));
+        }
+        (*putValuesHere)[counterIndex] = value;
+    }
+    return true;
+}
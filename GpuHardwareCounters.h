@@ -0,0 +1,118 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// which vendor extension the counters come from (see GpuHardwareCounters::Init(...))
+enum GpuHardwareCounterBackend
+{
+    GPU_HARDWARE_COUNTER_BACKEND_NONE = 0,
+    GPU_HARDWARE_COUNTER_BACKEND_AMD_PERFORMANCE_MONITOR,
+    GPU_HARDWARE_COUNTER_BACKEND_INTEL_PERFORMANCE_QUERY,
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Samples the GPU's own hardware counters over named scopes, like GpuProfiler does with
+    timestamps.  A time says that a kernel got slower or faster, but not why; the counters
+    say where it is spending its time: how much memory it moves, how often the caches hit,
+    how full the shader cores are kept (occupancy), and how busy their ALUs are.  With them
+    next to the time, an optimization can show that the bottleneck moved, and not just that
+    the number went down.
+
+    The counters come from the driver's vendor extension, whichever one it has:
+    GL_AMD_performance_monitor (AMD, and Mesa's radeonsi and nouveau) or
+    GL_INTEL_performance_query (Intel).  Both have hundreds of counters with names that
+    differ by vendor and by generation, so Init(...) keeps the ones whose names have any of
+    a list of words in them (see SetCounterFilter(...)), up to MAX_COUNTERS.  NVIDIA's
+    counters are only in its separate Perf SDK, which isn't part of this build.  A driver with
+    neither extension has no counters, and every call is then harmless and does nothing.
+
+    The results come back through a ring of frames in flight, like GpuProfiler's, and a
+    frame that the GPU hasn't finished is dropped instead of waited on.  Only one scope can
+    count at a time, since neither extension lets its queries nest, so a scope that begins
+    inside another one that is counting isn't sampled that frame.
+
+    Note: The counters' values are averaged per sample, whatever they are, so a percentage
+    stays a percentage and a count is per scope per frame.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class GpuHardwareCounters
+{
+public:
+    GpuHardwareCounters();
+    ~GpuHardwareCounters();
+    void SetCounterFilter(const std::string &commaSeparatedWords);
+    bool Init(unsigned int printIntervalFrames);
+    void Cleanup();
+
+    unsigned int AddScope(const std::string &name);
+    void BeginScope(unsigned int scopeId);
+    void EndScope(unsigned int scopeId);
+    void EndFrame();
+
+    GpuHardwareCounterBackend GetBackend() const;
+    const char *GetBackendName() const;
+    unsigned int GetCounterCount() const;
+    const std::string &GetCounterName(unsigned int counterIndex) const;
+    bool GetAverages(unsigned int scopeId, std::vector<double> *putAveragesHere) const;
+    void ResetAverages();
+    void PrintStats() const;
+
+    // more than this is more than a line of a report can hold, and the vendors limit how many
+    // can be active at once anyway
+    static const unsigned int MAX_COUNTERS = 16;
+
+private:
+    void SelectAmdCounters();
+    void SelectIntelCounters();
+    bool IsCounterNameWanted(const std::string &counterName) const;
+    bool CollectAmdSample(unsigned int handle, std::vector<double> *putValuesHere);
+    bool CollectIntelSample(unsigned int handle, std::vector<double> *putValuesHere);
+
+    // the same ring depth as GpuProfiler's
+    static const unsigned int FRAMES_IN_FLIGHT = 3;
+
+    // a counter that was selected; for AMD, its group and counter IDs and value type, and for
+    // Intel, where its value is in the query's data and the value's type
+    struct Counter
+    {
+        std::string _name;
+        unsigned int _groupOrOffset;
+        unsigned int _counterIdOrSize;
+        unsigned int _dataType;
+    };
+
+    struct Scope
+    {
+        std::string _name;
+
+        // an AMD monitor or an Intel query for each frame in the ring
+        unsigned int _handles[FRAMES_IN_FLIGHT];
+        bool _issued[FRAMES_IN_FLIGHT];
+
+        std::vector<double> _sums;
+        unsigned int _sampleCount;
+    };
+
+    GpuHardwareCounterBackend _backend;
+    std::vector<std::string> _filterWords;
+    std::vector<Counter> _counters;
+    std::vector<Scope> _scopes;
+
+    // Intel's counters all belong to one query, whose results are one block of this size
+    unsigned int _intelQueryId;
+    unsigned int _intelDataSize;
+    std::vector<unsigned char> _intelData;
+
+    // AMD's results and each sample's values, reused so that collecting them doesn't
+    // allocate every frame
+    std::vector<unsigned int> _amdData;
+    std::vector<double> _sampleValues;
+
+    // the scope that is counting, or -1 if none is
+    int _countingScopeId;
+    unsigned int _frameIndex;
+    unsigned int _printIntervalFrames;
+    unsigned int _droppedSamples;
+};
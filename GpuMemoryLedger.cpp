@@ -0,0 +1,396 @@
+#include "GpuMemoryLedger.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "ComputeDeviceCaps.h"
+#include "Log.h"
+
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+
+// GL_NVX_gpu_memory_info's and GL_ATI_meminfo's queries, in KB
+// Note: This version of glload has neither.  NVX's "current available" already leaves out
+// what has been allocated, and ATI's free memory is 4 values, of which the first is the total.
+static const GLenum GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX = 0x9048;
+static const GLenum GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX = 0x9049;
+static const GLenum VBO_FREE_MEMORY_ATI = 0x87FB;
+
+// the category must be a string literal, since only the pointer is kept
+struct GpuAllocation
+{
+    unsigned long long _sizeBytes;
+    const char *_category;
+};
+
+// Note: One ledger per thread, since each thread that draws has its own context on its own
+// GPU (see MultiGpuSimulation.h), and object names are only unique within a context.
+typedef std::pair<int, unsigned int> GpuObjectKey;
+static thread_local std::map<GpuObjectKey, GpuAllocation> gGpuAllocations;
+static thread_local unsigned long long gGpuMemoryUsed = 0;
+static thread_local unsigned long long gGpuMemoryBudget = 0;
+
+// the extensions don't change for the life of the context, so they are only looked for once
+enum GpuMemoryQuery
+{
+    GPU_MEMORY_QUERY_UNKNOWN = 0,
+    GPU_MEMORY_QUERY_NONE,
+    GPU_MEMORY_QUERY_NVX,
+    GPU_MEMORY_QUERY_ATI,
+};
+static thread_local GpuMemoryQuery gGpuMemoryQuery = GPU_MEMORY_QUERY_UNKNOWN;
+
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Adds an object's storage to the ledger.  An object that was already in it (ex: a buffer
+    that was re-specified with glBufferData(...)) is replaced, not counted twice.
+Parameters:
+    type        Self-explanatory.
+    objectId    The GL name.  0 is ignored.
+    sizeBytes   Self-explanatory.
+    category    What the object is for (ex: "particles").  Must be a string literal.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void RecordGpuAllocation(GpuMemoryObjectType type, unsigned int objectId,
+    unsigned long long sizeBytes, const char *category)
+{
+    if (objectId == 0)
+    {
+        return;
+    }
+
+    ForgetGpuAllocation(type, objectId);
+    GpuAllocation allocation = { sizeBytes, category };
+    gGpuAllocations[GpuObjectKey((int)type, objectId)] = allocation;
+    gGpuMemoryUsed += sizeBytes;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Records whichever buffer is bound to the target at whatever size the driver says that it
+    has, so that the call site doesn't have to repeat the size that it just allocated.
+Parameters:
+    target      GL_SHADER_STORAGE_BUFFER, GL_ARRAY_BUFFER, GL_DRAW_INDIRECT_BUFFER,
+                GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, or GL_UNIFORM_BUFFER.
+    category    Same as for RecordGpuAllocation(...).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void RecordBoundGlBufferAllocation(unsigned int target, const char *category)
+{
+    GLenum bindingQuery = 0;
+    switch (target)
+    {
+    case GL_SHADER_STORAGE_BUFFER: bindingQuery = GL_SHADER_STORAGE_BUFFER_BINDING; break;
+    case GL_ARRAY_BUFFER: bindingQuery = GL_ARRAY_BUFFER_BINDING; break;
+    case GL_DRAW_INDIRECT_BUFFER: bindingQuery = GL_DRAW_INDIRECT_BUFFER_BINDING; break;
+    case GL_COPY_READ_BUFFER: bindingQuery = GL_COPY_READ_BUFFER_BINDING; break;
+    case GL_COPY_WRITE_BUFFER: bindingQuery = GL_COPY_WRITE_BUFFER_BINDING; break;
+    case GL_UNIFORM_BUFFER: bindingQuery = GL_UNIFORM_BUFFER_BINDING; break;
+    default:
+        LogPrintf("GPU memory ledger can't record a buffer on target 0x%x\n", target);
+        return;
+    }
+
+    GLint bufferId = 0;
+    GLint64 sizeBytes = 0;
+    glGetIntegerv(bindingQuery, &bufferId);
+    glGetBufferParameteri64v(target, GL_BUFFER_SIZE, &sizeBytes);
+    RecordGpuAllocation(GPU_MEMORY_BUFFER, (unsigned int)bufferId,
+        (unsigned long long)sizeBytes, category);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes an object's storage back out of the ledger.  Objects that were never recorded are
+    ignored, so every delete can call this.
+Parameters:
+    type        Self-explanatory.
+    objectId    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ForgetGpuAllocation(GpuMemoryObjectType type, unsigned int objectId)
+{
+    std::map<GpuObjectKey, GpuAllocation>::iterator found =
+        gGpuAllocations.find(GpuObjectKey((int)type, objectId));
+    if (found != gGpuAllocations.end())
+    {
+        gGpuMemoryUsed -= found->second._sizeBytes;
+        gGpuAllocations.erase(found);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The size of a 2D texture or renderbuffer with the given number of mip levels, for the
+    formats that this program uses.  Anything else is counted at 4 bytes per texel.
+Parameters:
+    internalFormat  Ex: GL_RGBA16F.
+    width           Of level 0.
+    height          Of level 0.
+    levelCount      Self-explanatory.
+Returns:
+    The bytes that the texels take up, without any padding that the driver may add.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned long long GetGlTextureSizeBytes(unsigned int internalFormat, int width, int height,
+    int levelCount)
+{
+    unsigned long long bytesPerTexel = 4;
+    switch (internalFormat)
+    {
+    case GL_R8:
+    case GL_R8UI:
+        bytesPerTexel = 1;
+        break;
+    case GL_R16F:
+    case GL_RGB565:
+        bytesPerTexel = 2;
+        break;
+    case GL_RGB8:
+        bytesPerTexel = 3;
+        break;
+    case GL_RGBA16F:
+        bytesPerTexel = 8;
+        break;
+    default:
+        break;
+    }
+
+    unsigned long long sizeBytes = 0;
+    for (int level = 0; level < levelCount && width > 0 && height > 0; level++)
+    {
+        sizeBytes += bytesPerTexel * (unsigned long long)width * (unsigned long long)height;
+        width = (width > 1) ? (width / 2) : 1;
+        height = (height > 1) ? (height / 2) : 1;
+    }
+    return sizeBytes;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The total of everything in the ledger, in bytes.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned long long GetGpuMemoryUsed()
+{
+    return gGpuMemoryUsed;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Caps the total that WouldExceedGpuMemoryBudget(...) allows.
+Parameters:
+    budgetBytes     0 for no budget, in which case only the device's free memory (if it can
+                    be asked for) limits it.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void SetGpuMemoryBudget(unsigned long long budgetBytes)
+{
+    gGpuMemoryBudget = budgetBytes;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The budget in bytes, or 0 if there isn't one.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned long long GetGpuMemoryBudget()
+{
+    return gGpuMemoryBudget;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Asks the driver how much video memory is free, through GL_NVX_gpu_memory_info or
+    GL_ATI_meminfo.  Core OpenGL has no such query, so other drivers can't say.  Needs a
+    current context.
+Parameters:
+    putAvailableBytesHere   Self-explanatory.
+    putTotalBytesHere       May be 0.  ATI's extension has no total, so it gets 0 there.
+Returns:
+    True if the driver said, otherwise false and nothing is written.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool QueryGpuMemoryAvailable(unsigned long long *putAvailableBytesHere,
+    unsigned long long *putTotalBytesHere)
+{
+    if (gGpuMemoryQuery == GPU_MEMORY_QUERY_UNKNOWN)
+    {
+        gGpuMemoryQuery = GPU_MEMORY_QUERY_NONE;
+        if (IsGlExtensionSupported("GL_NVX_gpu_memory_info"))
+        {
+            gGpuMemoryQuery = GPU_MEMORY_QUERY_NVX;
+        }
+        else if (IsGlExtensionSupported("GL_ATI_meminfo"))
+        {
+            gGpuMemoryQuery = GPU_MEMORY_QUERY_ATI;
+        }
+    }
+
+    if (gGpuMemoryQuery == GPU_MEMORY_QUERY_NVX)
+    {
+        GLint availableKb = 0;
+        GLint totalKb = 0;
+        glGetIntegerv(GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &availableKb);
+        glGetIntegerv(GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX, &totalKb);
+        *putAvailableBytesHere = (unsigned long long)availableKb * 1024;
+        if (putTotalBytesHere != 0)
+        {
+            *putTotalBytesHere = (unsigned long long)totalKb * 1024;
+        }
+        return true;
+    }
+    else if (gGpuMemoryQuery == GPU_MEMORY_QUERY_ATI)
+    {
+        GLint freeMemory[4] = { 0, 0, 0, 0 };
+        glGetIntegerv(VBO_FREE_MEMORY_ATI, freeMemory);
+        *putAvailableBytesHere = (unsigned long long)freeMemory[0] * 1024;
+        if (putTotalBytesHere != 0)
+        {
+            *putTotalBytesHere = 0;
+        }
+        return true;
+    }
+    return false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Checks an allocation against the budget and, if the driver can say (see
+    QueryGpuMemoryAvailable(...)), against the device's free memory.  Without either, nothing
+    is over.  Call it before making the allocation.
+Parameters:
+    additionalBytes     What is about to be allocated on top of what the ledger has now.
+Returns:
+    True if the allocation would go over, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool WouldExceedGpuMemoryBudget(unsigned long long additionalBytes)
+{
+    if (gGpuMemoryBudget > 0 && gGpuMemoryUsed + additionalBytes > gGpuMemoryBudget)
+    {
+        return true;
+    }
+
+    unsigned long long availableBytes = 0;
+    if (QueryGpuMemoryAvailable(&availableBytes, 0) && additionalBytes > availableBytes)
+    {
+        return true;
+    }
+    return false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    glBufferData(...) and friends don't return anything, so running out of memory only shows
+    up as GL_OUT_OF_MEMORY in the error flags, and everything after it quietly works on
+    objects with no storage.  This empties the flags after a batch of allocations and says so
+    if any of them was out of memory.
+
+    Note: The debug callback (see OpenGlErrorHandling.cpp) only runs in debug builds, so this
+    is the only check that a release build has.  It stalls on the driver, so it only belongs
+    after allocations, not in the frame loop.
+Parameters:
+    what    Named in the message (ex: "particle manager").
+Returns:
+    True if an allocation ran out of memory, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool CheckGlOutOfMemory(const char *what)
+{
+    bool isOutOfMemory = false;
+    GLenum error = glGetError();
+    while (error != GL_NO_ERROR)
+    {
+        if (error == GL_OUT_OF_MEMORY)
+        {
+            isOutOfMemory = true;
+        }
+        error = glGetError();
+    }
+
+    if (isOutOfMemory)
+    {
+        LogErrorPrintf("%s: GPU out of memory with %.1fMB in the ledger\n", what,
+            gGpuMemoryUsed / (1024.0 * 1024.0));
+    }
+    return isOutOfMemory;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Prints the ledger's total, its total for each category (largest first), the budget, and
+    the device's free memory if the driver can say.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void PrintGpuMemoryReport()
+{
+    std::map<std::string, unsigned long long> categoryBytes;
+    std::map<GpuObjectKey, GpuAllocation>::const_iterator iter = gGpuAllocations.begin();
+    for (; iter != gGpuAllocations.end(); ++iter)
+    {
+        categoryBytes[iter->second._category] += iter->second._sizeBytes;
+    }
+    typedef std::multimap<unsigned long long, std::string, std::greater<unsigned long long> >
+        SortedCategories;
+    SortedCategories sorted;
+    std::map<std::string, unsigned long long>::const_iterator categoryIter =
+        categoryBytes.begin();
+    for (; categoryIter != categoryBytes.end(); ++categoryIter)
+    {
+        sorted.insert(std::make_pair(categoryIter->second, categoryIter->first));
+    }
+
+    const double bytesPerMb = 1024.0 * 1024.0;
+    LogPrintf("GPU memory: %.1fMB in %u objects\n", gGpuMemoryUsed / bytesPerMb,
+        (unsigned int)gGpuAllocations.size());
+    SortedCategories::const_iterator sortedIter = sorted.begin();
+    for (; sortedIter != sorted.end(); ++sortedIter)
+    {
+        LogPrintf("    %-28s %9.2fMB\n", sortedIter->second.c_str(),
+            sortedIter->first / bytesPerMb);
+    }
+    if (gGpuMemoryBudget > 0)
+    {
+        LogPrintf("GPU memory budget: %.1fMB\n", gGpuMemoryBudget / bytesPerMb);
+    }
+
+    unsigned long long availableBytes = 0;
+    unsigned long long totalBytes = 0;
+    if (QueryGpuMemoryAvailable(&availableBytes, &totalBytes))
+    {
+        if (totalBytes > 0)
+        {
+            LogPrintf("GPU memory free on the device: %.1fMB of %.1fMB\n",
+                availableBytes / bytesPerMb, totalBytes / bytesPerMb);
+        }
+        else
+        {
+            LogPrintf("GPU memory free on the device: %.1fMB\n", availableBytes / bytesPerMb);
+        }
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+// a running total of the GPU memory that this program has asked for (see GpuMemoryLedger.cpp)
+// Note: Every buffer, texture, and renderbuffer that is given storage is recorded under its
+// name along with its size and what it is for, and is forgotten when it is deleted, so the
+// total is what is alive right now.  The driver may round the sizes up and keeps memory of its
+// own, so this is a lower bound, but it is the part that grows with the particle count.
+// Also Note: A budget (SetGpuMemoryBudget(...)) caps the total.  Nothing stops a GL call from
+// going over it; the code that makes the big allocations asks WouldExceedGpuMemoryBudget(...)
+// first and refuses or shrinks instead.  Each thread with a context has its own ledger and
+// budget (see MultiGpuSimulation.h), like the GL calls themselves.
+enum GpuMemoryObjectType
+{
+    GPU_MEMORY_BUFFER = 0,
+    GPU_MEMORY_TEXTURE,
+    GPU_MEMORY_RENDERBUFFER,
+};
+
+void RecordGpuAllocation(GpuMemoryObjectType type, unsigned int objectId,
+    unsigned long long sizeBytes, const char *category);
+void RecordBoundGlBufferAllocation(unsigned int target, const char *category);
+void ForgetGpuAllocation(GpuMemoryObjectType type, unsigned int objectId);
+unsigned long long GetGlTextureSizeBytes(unsigned int internalFormat, int width, int height,
+    int levelCount = 1);
+unsigned long long GetGpuMemoryUsed();
+
+void SetGpuMemoryBudget(unsigned long long budgetBytes);
+unsigned long long GetGpuMemoryBudget();
+bool QueryGpuMemoryAvailable(unsigned long long *putAvailableBytesHere,
+    unsigned long long *putTotalBytesHere);
+bool WouldExceedGpuMemoryBudget(unsigned long long additionalBytes);
+bool CheckGlOutOfMemory(const char *what);
+void PrintGpuMemoryReport();
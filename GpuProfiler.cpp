@@ -0,0 +1,644 @@
+#include "GpuProfiler.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlFenceSync.h"
+#include "ComputeDeviceCaps.h"
+#include "Log.h"
+#include "TraceTimeline.h"
+
+#include <algorithm>
+#include <stdio.h>
+
+// from GL_ARB_pipeline_statistics_query, which is newer than the GL 4.4 header, in 
+// GpuPipelineStatistic's order
+static const GLenum PIPELINE_STATISTIC_TARGETS[GPU_PIPELINE_STATISTIC_COUNT] =
+{
+    0x82F0,     // GL_VERTEX_SHADER_INVOCATIONS_ARB
+    0x82F6,     // GL_CLIPPING_INPUT_PRIMITIVES_ARB
+    0x82F7,     // GL_CLIPPING_OUTPUT_PRIMITIVES_ARB
+    0x82F4,     // GL_FRAGMENT_SHADER_INVOCATIONS_ARB
+    0x82F5,     // GL_COMPUTE_SHADER_INVOCATIONS_ARB
+};
+
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.  Nothing is allocated until Init(...).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-8-2016)
+-----------------------------------------------------------------------------------------------*/
+GpuProfiler::GpuProfiler() :
+    _countingScopeId(-1),
+    _frameIndex(0),
+    _printIntervalFrames(0),
+    _droppedSamples(0),
+    _isInitialized(false)
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-8-2016)
+-----------------------------------------------------------------------------------------------*/
+GpuProfiler::~GpuProfiler()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Records how often the stats should be printed.  Scopes can be added after this.
+Parameters:
+    printIntervalFrames     PrintStats() will be called automatically every this many frames.
+                            0 means never; use GetStats(...) instead.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-8-2016)
+-----------------------------------------------------------------------------------------------*/
+void GpuProfiler::Init(unsigned int printIntervalFrames)
+{
+    _printIntervalFrames = printIntervalFrames;
+    _frameIndex = 0;
+    _droppedSamples = 0;
+    _countingScopeId = -1;
+    _isInitialized = true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Deletes every scope's query objects.  Must be called while the OpenGL context is still
+    alive.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-8-2016)
+-----------------------------------------------------------------------------------------------*/
+void GpuProfiler::Cleanup()
+{
+    if (!_isInitialized)
+    {
+        return;
+    }
+
+    for (size_t scopeIndex = 0; scopeIndex < _scopes.size(); scopeIndex++)
+    {
+        Scope &scope = _scopes[scopeIndex];
+        glDeleteQueries(FRAMES_IN_FLIGHT, scope._beginQueryIds);
+        glDeleteQueries(FRAMES_IN_FLIGHT, scope._endQueryIds);
+        if (scope._hasPipelineStatistics)
+        {
+            for (unsigned int slot = 0; slot < FRAMES_IN_FLIGHT; slot++)
+            {
+                glDeleteQueries(GPU_PIPELINE_STATISTIC_COUNT, scope._statisticQueryIds[slot]);
+            }
+        }
+    }
+    _scopes.clear();
+    _countingScopeId = -1;
+    _isInitialized = false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Creates a new named scope and its ring of timestamp queries.
+Parameters:
+    name    Used when printing.  Ex: "update", "render".
+Returns:
+    The ID to give to BeginScope(...) and EndScope(...).
+Exception:  Safe
+Creator:    John Cox (8-8-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int GpuProfiler::AddScope(const std::string &name)
+{
+    Scope scope;
+    scope._name = name;
+    scope._traceName = InternTraceName(name);
+    glGenQueries(FRAMES_IN_FLIGHT, scope._beginQueryIds);
+    glGenQueries(FRAMES_IN_FLIGHT, scope._endQueryIds);
+    for (unsigned int slot = 0; slot < FRAMES_IN_FLIGHT; slot++)
+    {
+        scope._issued[slot] = false;
+        scope._statisticsIssued[slot] = false;
+        for (unsigned int statistic = 0; statistic < GPU_PIPELINE_STATISTIC_COUNT; statistic++)
+        {
+            scope._statisticQueryIds[slot][statistic] = 0;
+        }
+    }
+    scope._samplesMs.reserve(SAMPLE_WINDOW_SIZE);
+    scope._nextSample = 0;
+    scope._lastMs = 0.0f;
+    scope._iterationCount = 0;
+    scope._hasPipelineStatistics = false;
+    for (unsigned int statistic = 0; statistic < GPU_PIPELINE_STATISTIC_COUNT; statistic++)
+    {
+        scope._lastStatistics[statistic] = 0;
+        scope._statisticSums[statistic] = 0;
+    }
+    scope._statisticSampleCount = 0;
+    scope._pixelCount = 0;
+
+    _scopes.push_back(scope);
+    return (unsigned int)(_scopes.size() - 1);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Tells the profiler that the scope brackets a loop of this many iterations (ex: a solver's 
+    relaxation passes), so PrintStats() also prints its average time per iteration.  The 
+    stats themselves stay per scope.
+Parameters:
+    scopeId         From AddScope(...).
+    iterationCount  Self-explanatory.  0 (the default) prints no per-iteration time.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GpuProfiler::SetScopeIterationCount(unsigned int scopeId, unsigned int iterationCount)
+{
+    if (scopeId >= _scopes.size())
+    {
+        return;
+    }
+    _scopes[scopeId]._iterationCount = iterationCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Has the scope count its pipeline statistics (see GpuPipelineStatistic) along with its 
+    time, which PrintStats() prints and GetPipelineStatistics(...) returns.  Only one scope 
+    can count at a time, so a scope that begins inside another counting scope only gets its 
+    time for that frame.
+Parameters:
+    scopeId     From AddScope(...).
+Returns:
+    False if the driver doesn't have GL_ARB_pipeline_statistics_query or the scope doesn't 
+    exist, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool GpuProfiler::EnablePipelineStatistics(unsigned int scopeId)
+{
+    if (scopeId >= _scopes.size())
+    {
+        return false;
+    }
+    if (!IsGlExtensionSupported("GL_ARB_pipeline_statistics_query"))
+    {
+        LogPrintf("gpu profiler: no GL_ARB_pipeline_statistics_query; '%s' only gets times\n", 
+            _scopes[scopeId]._name.c_str());
+        return false;
+    }
+
+    Scope &scope = _scopes[scopeId];
+    if (!scope._hasPipelineStatistics)
+    {
+        for (unsigned int slot = 0; slot < FRAMES_IN_FLIGHT; slot++)
+        {
+            glGenQueries(GPU_PIPELINE_STATISTIC_COUNT, scope._statisticQueryIds[slot]);
+        }
+        scope._hasPipelineStatistics = true;
+    }
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Tells the profiler how many pixels the scope draws to, so PrintStats() also prints its 
+    fragment shader invocations per pixel, which is the average overdraw.  Set it whenever 
+    the size of what the scope draws to changes.
+Parameters:
+    scopeId     From AddScope(...).
+    pixelCount  Self-explanatory.  0 (the default) prints no overdraw.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GpuProfiler::SetScopePixelCount(unsigned int scopeId, unsigned long long pixelCount)
+{
+    if (scopeId >= _scopes.size())
+    {
+        return;
+    }
+    _scopes[scopeId]._pixelCount = pixelCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Records a GPU timestamp when the GPU reaches this point in the command stream, and starts 
+    counting the scope's pipeline statistics if it has them and no other scope is counting.
+Parameters:
+    scopeId     From AddScope(...).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-8-2016)
+-----------------------------------------------------------------------------------------------*/
+void GpuProfiler::BeginScope(unsigned int scopeId)
+{
+    if (scopeId >= _scopes.size())
+    {
+        return;
+    }
+
+    unsigned int slot = _frameIndex % FRAMES_IN_FLIGHT;
+    Scope &scope = _scopes[scopeId];
+    glQueryCounter(scope._beginQueryIds[slot], GL_TIMESTAMP);
+    if (scope._hasPipelineStatistics && _countingScopeId < 0)
+    {
+        for (unsigned int statistic = 0; statistic < GPU_PIPELINE_STATISTIC_COUNT; statistic++)
+        {
+            glBeginQuery(PIPELINE_STATISTIC_TARGETS[statistic], 
+                scope._statisticQueryIds[slot][statistic]);
+        }
+        _countingScopeId = (int)scopeId;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Records a GPU timestamp when the GPU reaches this point in the command stream and marks the
+    scope as having run this frame.
+Parameters:
+    scopeId     From AddScope(...).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-8-2016)
+-----------------------------------------------------------------------------------------------*/
+void GpuProfiler::EndScope(unsigned int scopeId)
+{
+    if (scopeId >= _scopes.size())
+    {
+        return;
+    }
+
+    unsigned int slot = _frameIndex % FRAMES_IN_FLIGHT;
+    glQueryCounter(_scopes[scopeId]._endQueryIds[slot], GL_TIMESTAMP);
+    _scopes[scopeId]._issued[slot] = true;
+    if (_countingScopeId == (int)scopeId)
+    {
+        for (unsigned int statistic = 0; statistic < GPU_PIPELINE_STATISTIC_COUNT; statistic++)
+        {
+            glEndQuery(PIPELINE_STATISTIC_TARGETS[statistic]);
+        }
+        _scopes[scopeId]._statisticsIssued[slot] = true;
+        _countingScopeId = -1;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Collects the results of the oldest frame in the ring (FRAMES_IN_FLIGHT - 1 frames ago)
+    without waiting on the GPU, then advances to the next frame.  Call once per frame after
+    everything has been submitted.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-8-2016)
+-----------------------------------------------------------------------------------------------*/
+void GpuProfiler::EndFrame()
+{
+    unsigned int oldestSlot = (_frameIndex + 1) % FRAMES_IN_FLIGHT;
+    for (size_t scopeIndex = 0; scopeIndex < _scopes.size(); scopeIndex++)
+    {
+        Scope &scope = _scopes[scopeIndex];
+        if (scope._statisticsIssued[oldestSlot])
+        {
+            this->CollectPipelineStatistics(&scope, oldestSlot);
+        }
+        if (!scope._issued[oldestSlot])
+        {
+            continue;
+        }
+        scope._issued[oldestSlot] = false;
+
+        // the end query is always issued after the begin query, so if it is done, both are
+        GLint isAvailable = GL_FALSE;
+        glGetQueryObjectiv(scope._endQueryIds[oldestSlot], GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+        if (isAvailable == GL_FALSE)
+        {
+            // don't stall; just lose this one
+            _droppedSamples++;
+            continue;
+        }
+
+        GLuint64 beginNs = 0;
+        GLuint64 endNs = 0;
+        glGetQueryObjectui64v(scope._beginQueryIds[oldestSlot], GL_QUERY_RESULT, &beginNs);
+        glGetQueryObjectui64v(scope._endQueryIds[oldestSlot], GL_QUERY_RESULT, &endNs);
+        float elapsedMs = (float)(endNs - beginNs) / 1000000.0f;
+        scope._lastMs = elapsedMs;
+        TraceGpuEvent(scope._traceName, beginNs, endNs);
+
+        if (scope._samplesMs.size() < SAMPLE_WINDOW_SIZE)
+        {
+            scope._samplesMs.push_back(elapsedMs);
+        }
+        else
+        {
+            scope._samplesMs[scope._nextSample] = elapsedMs;
+        }
+        scope._nextSample = (scope._nextSample + 1) % SAMPLE_WINDOW_SIZE;
+    }
+
+    _frameIndex++;
+    if (_printIntervalFrames > 0 && (_frameIndex % _printIntervalFrames) == 0)
+    {
+        this->PrintStats();
+
+        // the driver messages, the fence stalls, and the pipeline statistics are counted per 
+        // print
+        _driverMessages.clear();
+        ResetGlFenceStallStats();
+        for (size_t scopeIndex = 0; scopeIndex < _scopes.size(); scopeIndex++)
+        {
+            Scope &scope = _scopes[scopeIndex];
+            for (unsigned int statistic = 0; statistic < GPU_PIPELINE_STATISTIC_COUNT; 
+                statistic++)
+            {
+                scope._statisticSums[statistic] = 0;
+            }
+            scope._statisticSampleCount = 0;
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Adds up the scope's pipeline statistics from the given frame in the ring, or drops them 
+    without stalling if the GPU isn't done with them yet.
+Parameters:
+    scope   Self-explanatory.
+    slot    The frame in the ring whose queries were issued.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void GpuProfiler::CollectPipelineStatistics(Scope *scope, unsigned int slot)
+{
+    scope->_statisticsIssued[slot] = false;
+
+    // the queries end together, so if the last is done, they all are
+    GLint isAvailable = GL_FALSE;
+    glGetQueryObjectiv(scope->_statisticQueryIds[slot][GPU_PIPELINE_STATISTIC_COUNT - 1], 
+        GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+    if (isAvailable == GL_FALSE)
+    {
+        _droppedSamples++;
+        return;
+    }
+
+    for (unsigned int statistic = 0; statistic < GPU_PIPELINE_STATISTIC_COUNT; statistic++)
+    {
+        GLuint64 count = 0;
+        glGetQueryObjectui64v(scope->_statisticQueryIds[slot][statistic], GL_QUERY_RESULT, 
+            &count);
+        scope->_lastStatistics[statistic] = count;
+        scope->_statisticSums[statistic] += count;
+    }
+    scope->_statisticSampleCount++;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calculates min, average, and 99th percentile over the scope's rolling window of samples.
+Parameters:
+    scopeId         From AddScope(...).
+    putStatsHere    Self-explanatory.
+Returns:
+    False if the scope doesn't exist or has no samples yet, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-8-2016)
+-----------------------------------------------------------------------------------------------*/
+bool GpuProfiler::GetStats(unsigned int scopeId, GpuProfilerStats *putStatsHere) const
+{
+    if (scopeId >= _scopes.size() || putStatsHere == 0)
+    {
+        return false;
+    }
+
+    const Scope &scope = _scopes[scopeId];
+    if (scope._samplesMs.empty())
+    {
+        return false;
+    }
+
+    // sort a copy; the window is small and this is not called every frame
+    std::vector<float> sorted = scope._samplesMs;
+    std::sort(sorted.begin(), sorted.end());
+
+    float sum = 0.0f;
+    for (size_t sampleIndex = 0; sampleIndex < sorted.size(); sampleIndex++)
+    {
+        sum += sorted[sampleIndex];
+    }
+
+    size_t p99Index = (sorted.size() * 99) / 100;
+    if (p99Index >= sorted.size())
+    {
+        p99Index = sorted.size() - 1;
+    }
+
+    putStatsHere->_minMs = sorted.front();
+    putStatsHere->_avgMs = sum / sorted.size();
+    putStatsHere->_p99Ms = sorted[p99Index];
+    putStatsHere->_lastMs = scope._lastMs;
+    putStatsHere->_sampleCount = (unsigned int)sorted.size();
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    scopeId             From AddScope(...).
+    putStatisticsHere   Self-explanatory.
+Returns:
+    False if the scope doesn't exist or has no pipeline statistics since the last print, 
+    otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool GpuProfiler::GetPipelineStatistics(unsigned int scopeId, 
+    GpuPipelineStatistics *putStatisticsHere) const
+{
+    if (scopeId >= _scopes.size() || putStatisticsHere == 0)
+    {
+        return false;
+    }
+
+    const Scope &scope = _scopes[scopeId];
+    if (scope._statisticSampleCount == 0)
+    {
+        return false;
+    }
+    for (unsigned int statistic = 0; statistic < GPU_PIPELINE_STATISTIC_COUNT; statistic++)
+    {
+        putStatisticsHere->_lastCounts[statistic] = scope._lastStatistics[statistic];
+        putStatisticsHere->_avgCounts[statistic] = 
+            (double)scope._statisticSums[statistic] / scope._statisticSampleCount;
+    }
+    putStatisticsHere->_sampleCount = scope._statisticSampleCount;
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The number of scopes created with AddScope(...).
+Exception:  Safe
+Creator:    John Cox (8-8-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int GpuProfiler::GetScopeCount() const
+{
+    return (unsigned int)_scopes.size();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    scopeId     From AddScope(...).  Must be valid.
+Returns:
+    A const reference to the scope's name.
+Exception:  Safe
+Creator:    John Cox (8-8-2016)
+-----------------------------------------------------------------------------------------------*/
+const std::string &GpuProfiler::GetScopeName(unsigned int scopeId) const
+{
+    return _scopes[scopeId]._name;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Samples are dropped when the GPU is more than FRAMES_IN_FLIGHT frames behind.  A growing
+    count means that the ring should be deeper.
+Parameters: None
+Returns:
+    The total number of samples dropped since Init(...).
+Exception:  Safe
+Creator:    John Cox (8-8-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int GpuProfiler::GetDroppedSampleCount() const
+{
+    return _droppedSamples;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Records a performance warning from the driver (GL_DEBUG_TYPE_PERFORMANCE_ARB) to print 
+    with the next stats.  The same message usually comes every frame, so it is printed once 
+    with a count.
+Parameters:
+    messageId   The driver's ID for the message.
+    text        Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void GpuProfiler::AddDriverMessage(unsigned int messageId, const std::string &text)
+{
+    for (size_t messageIndex = 0; messageIndex < _driverMessages.size(); messageIndex++)
+    {
+        if (_driverMessages[messageIndex]._id == messageId)
+        {
+            _driverMessages[messageIndex]._count++;
+            return;
+        }
+    }
+
+    DriverMessage message;
+    message._id = messageId;
+    message._text = text;
+    message._count = 1;
+    _driverMessages.push_back(message);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Prints one line per scope with its rolling stats, and the average per frame of its 
+    pipeline statistics if it has them, then the CPU's stalls on GPU fences and the driver's 
+    performance warnings since the last print.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-8-2016)
+-----------------------------------------------------------------------------------------------*/
+void GpuProfiler::PrintStats() const
+{
+    for (unsigned int scopeId = 0; scopeId < _scopes.size(); scopeId++)
+    {
+        GpuProfilerStats stats;
+        if (this->GetStats(scopeId, &stats))
+        {
+            LogPrintf("gpu %-10s min %7.3f ms, avg %7.3f ms, p99 %7.3f ms (%u samples)\n",
+                _scopes[scopeId]._name.c_str(), stats._minMs, stats._avgMs, stats._p99Ms,
+                stats._sampleCount);
+            unsigned int iterationCount = _scopes[scopeId]._iterationCount;
+            if (iterationCount > 0)
+            {
+                LogPrintf("gpu %-10s avg %7.3f ms per iteration (%u iterations)\n",
+                    _scopes[scopeId]._name.c_str(), stats._avgMs / iterationCount,
+                    iterationCount);
+            }
+        }
+
+        GpuPipelineStatistics statistics;
+        if (this->GetPipelineStatistics(scopeId, &statistics))
+        {
+            const double *counts = statistics._avgCounts;
+            LogPrintf("gpu %-10s %.0f VS, %.0f FS, %.0f CS invocations; "
+                "%.0f of %.0f primitives clipped in\n", _scopes[scopeId]._name.c_str(), 
+                counts[GPU_PIPELINE_VERTEX_SHADER_INVOCATIONS], 
+                counts[GPU_PIPELINE_FRAGMENT_SHADER_INVOCATIONS], 
+                counts[GPU_PIPELINE_COMPUTE_SHADER_INVOCATIONS], 
+                counts[GPU_PIPELINE_CLIPPING_OUTPUT_PRIMITIVES], 
+                counts[GPU_PIPELINE_CLIPPING_INPUT_PRIMITIVES]);
+
+            // fragments per pixel is the average overdraw, and fragments per primitive is how 
+            // big the primitives are on screen
+            double fragments = counts[GPU_PIPELINE_FRAGMENT_SHADER_INVOCATIONS];
+            unsigned long long pixelCount = _scopes[scopeId]._pixelCount;
+            double primitives = counts[GPU_PIPELINE_CLIPPING_OUTPUT_PRIMITIVES];
+            if (pixelCount > 0 && primitives > 0.0)
+            {
+                LogPrintf("gpu %-10s %.2f fragments per pixel, %.2f per primitive\n", 
+                    _scopes[scopeId]._name.c_str(), fragments / pixelCount, 
+                    fragments / primitives);
+            }
+        }
+    }
+
+    if (_droppedSamples > 0)
+    {
+        LogPrintf("gpu profiler: %u samples dropped\n", _droppedSamples);
+    }
+
+    // the time that the CPU spent waiting on the GPU's fences (see GlFenceSync.h)
+    GlFenceStallStats fenceStats;
+    GetGlFenceStallStats(&fenceStats);
+    if (fenceStats._stallCount > 0)
+    {
+        LogPrintf("gpu fence stalls: %llu of %llu waits, %.3f ms total, worst %.3f ms (%s)\n",
+            fenceStats._stallCount, fenceStats._waitCount, fenceStats._stallNs / 1000000.0,
+            fenceStats._maxStallNs / 1000000.0, fenceStats._maxStallName);
+    }
+    if (fenceStats._timeoutCount > 0 || fenceStats._failedCount > 0)
+    {
+        LogPrintf("gpu fence stalls: %llu timed out, %llu failed\n", fenceStats._timeoutCount,
+            fenceStats._failedCount);
+    }
+
+    for (size_t messageIndex = 0; messageIndex < _driverMessages.size(); messageIndex++)
+    {
+        const DriverMessage &message = _driverMessages[messageIndex];
+        LogPrintf("gpu driver performance warning %u (x%u): %s\n", message._id, message._count, 
+            message._text.c_str());
+    }
+}
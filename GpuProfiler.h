@@ -0,0 +1,164 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Summary of the recent GPU times of a single profiler scope, in milliseconds.
+Creator:    John Cox (8-8-2016)
+-----------------------------------------------------------------------------------------------*/
+struct GpuProfilerStats
+{
+    float _minMs;
+    float _avgMs;
+    float _p99Ms;
+    float _lastMs;
+    unsigned int _sampleCount;
+};
+
+// the pipeline statistics that a scope can count (see GpuProfiler::EnablePipelineStatistics(...))
+// Note: Must match the query targets in GpuProfiler.cpp.
+enum GpuPipelineStatistic
+{
+    GPU_PIPELINE_VERTEX_SHADER_INVOCATIONS = 0,
+    GPU_PIPELINE_CLIPPING_INPUT_PRIMITIVES,
+    GPU_PIPELINE_CLIPPING_OUTPUT_PRIMITIVES,
+    GPU_PIPELINE_FRAGMENT_SHADER_INVOCATIONS,
+    GPU_PIPELINE_COMPUTE_SHADER_INVOCATIONS,
+    GPU_PIPELINE_STATISTIC_COUNT,
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The pipeline statistics of a single profiler scope: the last frame's counts, and the 
+    average per frame since the stats were last printed.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+struct GpuPipelineStatistics
+{
+    unsigned long long _lastCounts[GPU_PIPELINE_STATISTIC_COUNT];
+    double _avgCounts[GPU_PIPELINE_STATISTIC_COUNT];
+    unsigned int _sampleCount;
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Measures how long the GPU spends on named chunks of work ("scopes") by bracketing them with
+    GL_TIMESTAMP queries.  Timestamps rather than GL_TIME_ELAPSED are used so that scopes can
+    nest and overlap.
+
+    Query results are not available until the GPU gets around to running the commands, and
+    asking for them early stalls the CPU until it does.  To avoid that, every scope has a ring
+    of query pairs, one for each frame in flight.  EndFrame() advances the ring and collects
+    the results from the oldest frame, which the GPU has almost certainly finished by then.  If
+    it hasn't, then that sample is dropped rather than waited on.
+
+    Each scope keeps a rolling window of its most recent times for min/avg/p99 stats.
+
+    The driver's performance warnings are printed with the stats, since they usually explain
+    a slow scope, rather than to stderr as they come in (see AddDriverMessage(...)).  So are
+    the times that the CPU stalled on a fence (see GlFenceSync.h), which are the other side of
+    a GPU that is behind.
+
+    A scope can also count what the pipeline did inside it (see EnablePipelineStatistics(...)):
+    how many vertex and fragment shader invocations there were and how many primitives went
+    into and out of the clipper.  Those say which stage a slow scope is spending its time in,
+    which a time alone can't: a draw with many more fragments than pixels is fragment and
+    blend bound, so fewer or smaller particles help and culling doesn't, while one whose
+    clipper throws most of its primitives away is the other way around.
+Creator:    John Cox (8-8-2016)
+-----------------------------------------------------------------------------------------------*/
+class GpuProfiler
+{
+public:
+    GpuProfiler();
+    ~GpuProfiler();
+    void Init(unsigned int printIntervalFrames);
+    void Cleanup();
+
+    unsigned int AddScope(const std::string &name);
+    void SetScopeIterationCount(unsigned int scopeId, unsigned int iterationCount);
+    void BeginScope(unsigned int scopeId);
+    void EndScope(unsigned int scopeId);
+    void EndFrame();
+
+    bool EnablePipelineStatistics(unsigned int scopeId);
+    void SetScopePixelCount(unsigned int scopeId, unsigned long long pixelCount);
+
+    bool GetStats(unsigned int scopeId, GpuProfilerStats *putStatsHere) const;
+    bool GetPipelineStatistics(unsigned int scopeId, 
+        GpuPipelineStatistics *putStatisticsHere) const;
+    unsigned int GetScopeCount() const;
+    const std::string &GetScopeName(unsigned int scopeId) const;
+    unsigned int GetDroppedSampleCount() const;
+    void AddDriverMessage(unsigned int messageId, const std::string &text);
+    void PrintStats() const;
+
+private:
+    // 3 frames in flight is enough that results are always ready on the drivers I've tried
+    static const unsigned int FRAMES_IN_FLIGHT = 3;
+    static const unsigned int SAMPLE_WINDOW_SIZE = 256;
+
+    struct Scope
+    {
+        std::string _name;
+
+        // the same name, kept for as long as the trace needs it (see InternTraceName(...))
+        const char *_traceName;
+
+        // begin and end timestamp query IDs for each frame in the ring
+        unsigned int _beginQueryIds[FRAMES_IN_FLIGHT];
+        unsigned int _endQueryIds[FRAMES_IN_FLIGHT];
+
+        // whether the scope was actually run in that frame (so a scope that is skipped on some
+        // frames doesn't report stale results)
+        bool _issued[FRAMES_IN_FLIGHT];
+
+        // rolling window of results
+        std::vector<float> _samplesMs;
+        unsigned int _nextSample;
+        float _lastMs;
+
+        // the iterations of a loop that the scope brackets, so the stats can also be printed 
+        // per iteration (see SetScopeIterationCount(...)); 0 if it isn't a loop
+        unsigned int _iterationCount;
+
+        // a query per pipeline statistic for each frame in the ring, if they are enabled, and 
+        // the counts since the last print
+        // Note: Statistics queries can't nest like timestamps, so a scope only counts if no 
+        // other scope is counting when it begins (see _countingScopeId).
+        bool _hasPipelineStatistics;
+        unsigned int _statisticQueryIds[FRAMES_IN_FLIGHT][GPU_PIPELINE_STATISTIC_COUNT];
+        bool _statisticsIssued[FRAMES_IN_FLIGHT];
+        unsigned long long _lastStatistics[GPU_PIPELINE_STATISTIC_COUNT];
+        unsigned long long _statisticSums[GPU_PIPELINE_STATISTIC_COUNT];
+        unsigned int _statisticSampleCount;
+
+        // the pixels that the scope draws to, so the fragments can be printed per pixel (see 
+        // SetScopePixelCount(...)); 0 if it doesn't draw
+        unsigned long long _pixelCount;
+    };
+
+    void CollectPipelineStatistics(Scope *scope, unsigned int slot);
+
+    std::vector<Scope> _scopes;
+
+    // the driver's performance warnings (see TakeDebugPerformanceMessages(...)), grouped by 
+    // message ID and counted until the next print
+    struct DriverMessage
+    {
+        unsigned int _id;
+        std::string _text;
+        unsigned int _count;
+    };
+    std::vector<DriverMessage> _driverMessages;
+
+    // the scope whose statistics queries are active, or -1 if none are
+    int _countingScopeId;
+
+    unsigned int _frameIndex;
+    unsigned int _printIntervalFrames;
+    unsigned int _droppedSamples;
+    bool _isInitialized;
+};
@@ -0,0 +1,424 @@
+#include "GpuScan.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
+#include "ShaderProgramRegistry.h"
+#include "ComputeDeviceCaps.h"
+#include "GpuMemoryLedger.h"
+#include "RenderPassGraph.h"
+#include "Log.h"
+
+// must match the SCAN_STAGE_* defines in shaderScan.comp
+enum ScanStage
+{
+    SCAN_STAGE_TILES = 0,
+    SCAN_STAGE_ADD_TILE_OFFSETS,
+};
+
+// the tiles' totals of every scan, in one buffer that every GpuScan shares (see
+// InitLevelBuffers(...))
+// Note: The totals only live for the length of one ExclusiveScan(...), and scans run one at a
+// time on the GL thread, so no two scans ever need them at once, and the buffer is only as big
+// as the biggest scan's instead of the sum of all of them.
+static GLuint gScanScratchBufferId = 0;
+static size_t gScanScratchSizeBytes = 0;
+static unsigned int gScanScratchUserCount = 0;
+
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    elementCount    The length of the array being scanned.
+    level           0 is the array itself, 1 is its tiles' totals, and so on.
+    tileSize        Self-explanatory.
+Returns:
+    The number of elements at that level.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+static unsigned int GetLevelElementCount(unsigned int elementCount, unsigned int level,
+    unsigned int tileSize)
+{
+    for (unsigned int levelIndex = 0; levelIndex < level; levelIndex++)
+    {
+        elementCount = (elementCount + tileSize - 1) / tileSize;
+    }
+    return elementCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+GpuScan::GpuScan() :
+    _scanProgramId(0),
+    _scanWorkGroupSizeX(DEFAULT_WORK_GROUP_SIZE),
+    _unifLocScanStage(0),
+    _unifLocScanElementCount(0),
+    _unifLocScanWriteTileSums(0),
+    _elementCapacity(0),
+    _isScratchUser(false)
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+GpuScan::~GpuScan()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes a reference to the scan program (see ShaderProgramRegistry.h).  The caller may
+    release their own reference after this returns.
+Parameters:
+    scanProgramId   shaderScan.comp generated with GetScanShaderDefines(...).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void GpuScan::Init(unsigned int scanProgramId)
+{
+    this->Cleanup();
+
+    _scanProgramId = scanProgramId;
+    AddProgramReference(_scanProgramId);
+    this->LoadProgramInterface();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Releases the program and its share of the tile totals' buffer, which is deleted when the
+    last scan lets go of it.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void GpuScan::Cleanup()
+{
+    if (_scanProgramId != 0)
+    {
+        ReleaseProgram(_scanProgramId);
+        _scanProgramId = 0;
+    }
+
+    if (_isScratchUser)
+    {
+        _isScratchUser = false;
+        gScanScratchUserCount--;
+        if (gScanScratchUserCount == 0)
+        {
+            ForgetGpuAllocation(GPU_MEMORY_BUFFER, gScanScratchBufferId);
+            DeleteGlBuffers(1, &gScanScratchBufferId);
+            gScanScratchBufferId = 0;
+            gScanScratchSizeBytes = 0;
+        }
+    }
+    _levelSumOffsets.clear();
+    _levelSumSizes.clear();
+    _elementCapacity = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Switches to a rebuilt program (see ParticleManager::ReplaceProgram(...)).  The new program
+    may have a different work group size, and so a different tile size, so the tile total
+    buffers are made again on the next scan.
+Parameters:
+    oldProgramId    Self-explanatory.  Any other program is ignored.
+    newProgramId    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void GpuScan::ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId)
+{
+    if (oldProgramId == 0 || newProgramId == 0 || _scanProgramId != oldProgramId)
+    {
+        return;
+    }
+
+    AddProgramReference(newProgramId);
+    ReleaseProgram(_scanProgramId);
+    _scanProgramId = newProgramId;
+    this->LoadProgramInterface();
+    _elementCapacity = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Writes the exclusive prefix sum of the input array to the output array.  Waits for earlier
+    shader storage writes before it starts and makes its own visible to shader storage reads
+    when it is done.  Other kinds of reads (ex: an indirect draw from the output) still need
+    their own barrier.
+Parameters:
+    inputBufferId   The elements to sum, starting at the start of the buffer.  Not changed,
+                    unless it is also the output.
+    outputBufferId  Must have room for elementCount elements.  May be the input buffer.
+    elementCount    0 does nothing.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void GpuScan::ExclusiveScan(unsigned int inputBufferId, unsigned int outputBufferId,
+    unsigned int elementCount)
+{
+    if (_scanProgramId == 0 || elementCount == 0)
+    {
+        return;
+    }
+    if (elementCount > _elementCapacity)
+    {
+        this->InitLevelBuffers(elementCount);
+    }
+
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    UseGlProgram(_scanProgramId);
+
+    // down through the levels: each one is scanned on its own and its tiles' totals become the
+    // next level, which is scanned in place, until a level fits in a single tile
+    unsigned int tileSize = this->GetTileSize();
+    unsigned int levelCount = 0;
+    unsigned int levelElementCount = elementCount;
+    BindGlShaderStorageBuffer(GPU_SCAN_INPUT_BINDING, inputBufferId);
+    BindGlShaderStorageBuffer(GPU_SCAN_OUTPUT_BINDING, outputBufferId);
+    while (levelElementCount > tileSize)
+    {
+        GLintptr levelSumOffset = _levelSumOffsets[levelCount];
+        GLsizeiptr levelSumSize = _levelSumSizes[levelCount];
+        BindGlShaderStorageBufferRange(GPU_SCAN_TILE_SUM_BINDING,
+            gScanScratchBufferId, levelSumOffset, levelSumSize);
+        this->DispatchScanStage(SCAN_STAGE_TILES, levelElementCount, true);
+
+        BindGlShaderStorageBufferRange(GPU_SCAN_INPUT_BINDING,
+            gScanScratchBufferId, levelSumOffset, levelSumSize);
+        BindGlShaderStorageBufferRange(GPU_SCAN_OUTPUT_BINDING,
+            gScanScratchBufferId, levelSumOffset, levelSumSize);
+        levelElementCount = (levelElementCount + tileSize - 1) / tileSize;
+        levelCount++;
+    }
+    this->DispatchScanStage(SCAN_STAGE_TILES, levelElementCount, false);
+
+    // and back up, adding each level's scanned totals to the tiles of the level before it
+    while (levelCount > 0)
+    {
+        levelCount--;
+        if (levelCount == 0)
+        {
+            BindGlShaderStorageBuffer(GPU_SCAN_OUTPUT_BINDING, outputBufferId);
+        }
+        else
+        {
+            BindGlShaderStorageBufferRange(GPU_SCAN_OUTPUT_BINDING,
+                gScanScratchBufferId, _levelSumOffsets[levelCount - 1],
+                _levelSumSizes[levelCount - 1]);
+        }
+        BindGlShaderStorageBufferRange(GPU_SCAN_TILE_SUM_BINDING,
+            gScanScratchBufferId, _levelSumOffsets[levelCount], _levelSumSizes[levelCount]);
+        this->DispatchScanStage(SCAN_STAGE_ADD_TILE_OFFSETS,
+            GetLevelElementCount(elementCount, levelCount, tileSize), false);
+    }
+
+    UseGlProgram(0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How many elements a single work group scans.  An array of up to this many takes a single
+    dispatch.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int GpuScan::GetTileSize() const
+{
+    return _scanWorkGroupSizeX * 2;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Checks for GL_KHR_shader_subgroup with the basic and arithmetic operations in compute
+    shaders, which the SCAN_USE_SUBGROUPS variant of shaderScan.comp needs.  Needs a current
+    context.
+Parameters: None
+Returns:
+    True if GetScanShaderDefines(..., true) will build on this device, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+bool GpuScan::IsSubgroupScanSupported()
+{
+    return IsKhrSubgroupSupported(KHR_SUBGROUP_FEATURE_BASIC | KHR_SUBGROUP_FEATURE_ARITHMETIC);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    workGroupSize   Self-explanatory.  The tile is twice this.
+    useSubgroups    Scans each tile with subgroup operations instead of in shared memory.  Only
+                    if IsSubgroupScanSupported().
+Returns:
+    The defines to give to AcquireComputeProgram(..., "shaderScan.comp") for the scan program.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+std::string GpuScan::GetScanShaderDefines(unsigned int workGroupSize, bool useSubgroups)
+{
+    std::string defines = "#define WORK_GROUP_SIZE_X " + std::to_string(workGroupSize) + "\n";
+    if (useSubgroups)
+    {
+        defines += "#define SCAN_USE_SUBGROUPS\n";
+    }
+    return defines;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Looks up the scan program's uniforms and work group size.  Called by Init(...) and
+    whenever the program is replaced.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void GpuScan::LoadProgramInterface()
+{
+    _unifLocScanStage = glGetUniformLocation(_scanProgramId, "uScanStage");
+    _unifLocScanElementCount = glGetUniformLocation(_scanProgramId, "uScanElementCount");
+    _unifLocScanWriteTileSums = glGetUniformLocation(_scanProgramId, "uScanWriteTileSums");
+
+    // same as ParticleManager::Init(...); the dispatch must match the program
+    GLint programWorkGroupSize[3] = { 0, 0, 0 };
+    glGetProgramiv(_scanProgramId, GL_COMPUTE_LOCAL_WORK_SIZE, programWorkGroupSize);
+    _scanWorkGroupSizeX = (programWorkGroupSize[0] > 0) ?
+        programWorkGroupSize[0] : DEFAULT_WORK_GROUP_SIZE;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Lays out the tile totals of every level that an array of this length needs in the shared
+    scratch buffer, and grows the buffer if this scan needs more than any scan before it.
+    GPU-only; the scan writes them and reads them back.
+
+    The scan's passes are described to a RenderPassGraph with the levels as transient buffers,
+    so the layout is the graph's (see RenderPassGraph::Compile()).  Every level is live from
+    its tiles' pass down the up-sweep until its offsets are added back on the way down, so
+    the levels of one scan all need their own bytes; the saving is across scans.
+
+    Note: The buffer keeps its name when it grows, so the other scans' layouts are still good.
+    The contents don't need to survive, since every scan writes its totals before reading them.
+Parameters:
+    elementCount    The longest array that will be scanned.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void GpuScan::InitLevelBuffers(unsigned int elementCount)
+{
+    _levelSumOffsets.clear();
+    _levelSumSizes.clear();
+
+    // the same passes as ExclusiveScan(...), up the levels and back down
+    RenderPassGraph graph;
+    unsigned int input = graph.AddResource("input");
+    unsigned int output = graph.AddResource("output");
+    graph.MarkOutput(output);
+    std::vector<unsigned int> levels;
+    unsigned int tileSize = this->GetTileSize();
+    unsigned int levelElementCount = elementCount;
+    while (levelElementCount > tileSize)
+    {
+        levelElementCount = (levelElementCount + tileSize - 1) / tileSize;
+        _levelSumSizes.push_back(levelElementCount * sizeof(GLuint));
+        levels.push_back(graph.AddTransientBuffer("tile totals", _levelSumSizes.back()));
+
+        unsigned int tiles = graph.AddPass("scan tiles");
+        if (levels.size() == 1)
+        {
+            graph.AddAccess(tiles, input, RENDER_GRAPH_ACCESS_SHADER_STORAGE_READ);
+            graph.AddAccess(tiles, output, RENDER_GRAPH_ACCESS_SHADER_STORAGE_WRITE);
+        }
+        else
+        {
+            graph.AddAccess(tiles, levels[levels.size() - 2],
+                RENDER_GRAPH_ACCESS_SHADER_STORAGE_WRITE);
+        }
+        graph.AddAccess(tiles, levels.back(), RENDER_GRAPH_ACCESS_SHADER_STORAGE_WRITE);
+    }
+    for (size_t levelIndex = levels.size(); levelIndex > 0; levelIndex--)
+    {
+        unsigned int addOffsets = graph.AddPass("add tile offsets");
+        graph.AddAccess(addOffsets, levels[levelIndex - 1],
+            RENDER_GRAPH_ACCESS_SHADER_STORAGE_READ);
+        graph.AddAccess(addOffsets, (levelIndex == 1) ? output : levels[levelIndex - 2],
+            RENDER_GRAPH_ACCESS_SHADER_STORAGE_WRITE);
+    }
+    graph.Compile();
+    for (size_t levelIndex = 0; levelIndex < levels.size(); levelIndex++)
+    {
+        _levelSumOffsets.push_back(graph.GetTransientBufferOffset(levels[levelIndex]));
+    }
+    size_t scratchSizeBytes = graph.GetTransientHeapSizeBytes();
+
+    if (!_isScratchUser)
+    {
+        _isScratchUser = true;
+        gScanScratchUserCount++;
+    }
+    if (scratchSizeBytes > gScanScratchSizeBytes)
+    {
+        if (gScanScratchBufferId == 0)
+        {
+            glGenBuffers(1, &gScanScratchBufferId);
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, gScanScratchBufferId);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, scratchSizeBytes, 0, GL_DYNAMIC_COPY);
+        RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "scan scratch");
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        gScanScratchSizeBytes = scratchSizeBytes;
+    }
+    _elementCapacity = elementCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Runs one stage of the scan program, which must be in use, over one level, and waits for
+    its writes.  One work group per tile, so a level with more tiles than the device allows in
+    X is split into a 2D dispatch.
+Parameters:
+    stage           One of the SCAN_STAGE_* values.
+    elementCount    The length of the level.
+    writeTileSums   True if there is a next level for the tiles' totals to go to.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void GpuScan::DispatchScanStage(int stage, unsigned int elementCount, bool writeTileSums)
+{
+    unsigned int tileSize = this->GetTileSize();
+    unsigned int numWorkGroupsX = 0;
+    unsigned int numWorkGroupsY = 0;
+    GetComputeDispatchSize((elementCount + tileSize - 1) / tileSize, &numWorkGroupsX,
+        &numWorkGroupsY);
+    glUniform1i(_unifLocScanStage, stage);
+    glUniform1ui(_unifLocScanElementCount, elementCount);
+    glUniform1ui(_unifLocScanWriteTileSums, writeTileSums ? 1 : 0);
+    glDispatchCompute(numWorkGroupsX, numWorkGroupsY, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
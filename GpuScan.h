@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    An exclusive prefix sum (scan) of an array of 32-bit unsigned integers in a shader storage
+    buffer, on the GPU: every output element is the sum of the input elements before it.  This
+    is the step that turns counts into ranges, so anything that buckets items on the GPU (ex:
+    the neighbor grid's cells; see ParticleNeighborGrid.h) needs one.
+
+    The scan program is shaderScan.comp (see GetScanShaderDefines(...)).  Each work group scans
+    a tile of 2 elements per work item in shared memory with the work-efficient Blelloch scan,
+    or, where GL_KHR_shader_subgroup is available, with subgroup prefix sums in registers.  An
+    array of any length is handled by scanning the tiles' totals the same way, one level per
+    multiple of the tile size, and then adding each tile's offset back in, so an array of 16
+    million elements in 512-element tiles takes 3 levels and 5 dispatches.  The buffers for
+    the tiles' totals are made the first time that they are needed and kept for next time, in
+    one scratch buffer that every scan shares, since no two scans ever run at once.
+
+    Note: The scan binds its buffers to GPU_SCAN_*_BINDING, which come after everything that
+    the particle passes use, so it can run between them without disturbing their bindings.  It
+    does change the program in use.
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+class GpuScan
+{
+public:
+    GpuScan();
+    ~GpuScan();
+    void Init(unsigned int scanProgramId);
+    void Cleanup();
+    void ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId);
+
+    void ExclusiveScan(unsigned int inputBufferId, unsigned int outputBufferId,
+        unsigned int elementCount);
+    unsigned int GetTileSize() const;
+
+    static const unsigned int DEFAULT_WORK_GROUP_SIZE = 256;
+    static bool IsSubgroupScanSupported();
+    static std::string GetScanShaderDefines(unsigned int workGroupSize = DEFAULT_WORK_GROUP_SIZE,
+        bool useSubgroups = false);
+
+private:
+    void LoadProgramInterface();
+    void InitLevelBuffers(unsigned int elementCount);
+    void DispatchScanStage(int stage, unsigned int elementCount, bool writeTileSums);
+
+    unsigned int _scanProgramId;
+    unsigned int _scanWorkGroupSizeX;
+    unsigned int _unifLocScanStage;
+    unsigned int _unifLocScanElementCount;
+    unsigned int _unifLocScanWriteTileSums;
+
+    // a range of tile totals in the shared scratch buffer for every level but the last, which
+    // fits in a single tile
+    // Note: Must match shaderScan.comp.
+    static const unsigned int GPU_SCAN_INPUT_BINDING = 22;
+    static const unsigned int GPU_SCAN_OUTPUT_BINDING = 23;
+    static const unsigned int GPU_SCAN_TILE_SUM_BINDING = 24;
+    std::vector<size_t> _levelSumOffsets;
+    std::vector<size_t> _levelSumSizes;
+    unsigned int _elementCapacity;
+    bool _isScratchUser;
+};
@@ -0,0 +1,326 @@
+#include "InputEventLog.h"
+
+#include "Log.h"
+
+#include <string.h>     // memset
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+InputEventLog::InputEventLog() :
+    _output(0),
+    _recordedEventCount(0),
+    _nextEvent(0),
+    _isReplaying(false)
+{
+    memset(&_header, 0, sizeof(_header));
+    _startSceneConfig = GetDefaultSceneConfig();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+InputEventLog::~InputEventLog()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Creates the file and writes its header.  Everything that is recorded from now on is
+    appended to it.
+Parameters:
+    filePath    Self-explanatory.
+    header              What the session started with.  The magic, version, and SceneConfig
+                        size are filled in here.
+    startSceneConfig    Self-explanatory.
+Returns:
+    False if the file couldn't be created, in which case nothing is recorded.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool InputEventLog::StartRecording(const std::string &filePath,
+    const InputEventLogHeader &header, const SceneConfig &startSceneConfig)
+{
+    this->Cleanup();
+    _output = fopen(filePath.c_str(), "wb");
+    if (_output == 0)
+    {
+        LogErrorPrintf("input log: can't create '%s'\n", filePath.c_str());
+        return false;
+    }
+
+    _header = header;
+    _header._magic = INPUT_EVENT_LOG_MAGIC;
+    _header._version = INPUT_EVENT_LOG_VERSION;
+    _header._sceneConfigBytes = sizeof(SceneConfig);
+    _startSceneConfig = startSceneConfig;
+    fwrite(&_header, 1, sizeof(_header), _output);
+    fwrite(&_startSceneConfig, 1, sizeof(_startSceneConfig), _output);
+    LogPrintf("input log: recording to '%s'\n", filePath.c_str());
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Reads a recorded file's header and every one of its events.
+Parameters:
+    filePath    Self-explanatory.
+Returns:
+    False if the file couldn't be read or isn't a log that this build can replay, in which
+    case the reason is logged and there is nothing to replay.  A file that ends partway
+    through an event (ex: the recording crashed) replays up to that event.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool InputEventLog::OpenReplay(const std::string &filePath)
+{
+    this->Cleanup();
+    FILE *input = fopen(filePath.c_str(), "rb");
+    if (input == 0)
+    {
+        LogErrorPrintf("input log: can't open '%s'\n", filePath.c_str());
+        return false;
+    }
+
+    InputEventLogHeader header;
+    if (fread(&header, 1, sizeof(header), input) != sizeof(header) ||
+        header._magic != INPUT_EVENT_LOG_MAGIC || header._version != INPUT_EVENT_LOG_VERSION)
+    {
+        LogErrorPrintf("input log: '%s' isn't an input log of version %u\n", filePath.c_str(),
+            INPUT_EVENT_LOG_VERSION);
+        fclose(input);
+        return false;
+    }
+    if (header._sceneConfigBytes != sizeof(SceneConfig) ||
+        fread(&_startSceneConfig, 1, sizeof(SceneConfig), input) != sizeof(SceneConfig))
+    {
+        // the scene config changes couldn't be read back
+        LogErrorPrintf("input log: '%s' was recorded by a build with a different scene "
+            "config\n", filePath.c_str());
+        fclose(input);
+        return false;
+    }
+
+    InputEvent event;
+    while (fread(&event._record, 1, sizeof(event._record), input) == sizeof(event._record))
+    {
+        if (event._record._type == INPUT_EVENT_SCENE_CONFIG)
+        {
+            if (event._record._payloadBytes != sizeof(SceneConfig) ||
+                fread(&event._sceneConfig, 1, sizeof(SceneConfig), input) !=
+                sizeof(SceneConfig))
+            {
+                LogErrorPrintf("input log: '%s' is cut off after %u events\n",
+                    filePath.c_str(), (unsigned int)_events.size());
+                break;
+            }
+        }
+        else if (event._record._payloadBytes > 0)
+        {
+            // from a later version that kept the same format; skip what this one can't use
+            fseek(input, event._record._payloadBytes, SEEK_CUR);
+        }
+        _events.push_back(event);
+    }
+    fclose(input);
+
+    _header = header;
+    _nextEvent = 0;
+    _isReplaying = true;
+    LogPrintf("input log: replaying %u events over %u frames from '%s'\n",
+        (unsigned int)_events.size(), this->GetFrameCount(), filePath.c_str());
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Closes the recording, if there is one, or forgets the replay.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void InputEventLog::Cleanup()
+{
+    if (_output != 0)
+    {
+        fclose(_output);
+        _output = 0;
+        LogPrintf("input log: recorded %u events\n", _recordedEventCount);
+    }
+    _recordedEventCount = 0;
+    _events.clear();
+    _nextEvent = 0;
+    _isReplaying = false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    True between a successful StartRecording(...) and Cleanup().
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool InputEventLog::IsRecording() const
+{
+    return _output != 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    True between a successful OpenReplay(...) and Cleanup(), even after the last event was
+    taken.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool InputEventLog::IsReplaying() const
+{
+    return _isReplaying;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The header of the file that is being recorded or replayed.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+const InputEventLogHeader &InputEventLog::GetHeader() const
+{
+    return _header;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The scene that the recorded session started with, overrides and all.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+const SceneConfig &InputEventLog::GetStartSceneConfig() const
+{
+    return _startSceneConfig;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How many frames the recorded session ran, or if the recording was cut off before its
+    end, up to and including the frame of its last event.  0 if it has no events.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int InputEventLog::GetFrameCount() const
+{
+    if (_events.empty())
+    {
+        return 0;
+    }
+    const InputEventRecord &lastRecord = _events.back()._record;
+    return (lastRecord._type == INPUT_EVENT_END) ?
+        lastRecord._frameIndex : lastRecord._frameIndex + 1;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Appends an event with no payload.  Does nothing if there is no recording.
+Parameters:
+    frameIndex  The frame that the event is applied at the top of.
+    type        Self-explanatory.
+    value0-3    See InputEventType.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void InputEventLog::Record(unsigned int frameIndex, InputEventType type, int value0,
+    int value1, int value2, int value3)
+{
+    if (_output == 0)
+    {
+        return;
+    }
+
+    InputEventRecord record;
+    record._frameIndex = frameIndex;
+    record._type = (unsigned short)type;
+    record._payloadBytes = 0;
+    record._values[0] = value0;
+    record._values[1] = value1;
+    record._values[2] = value2;
+    record._values[3] = value3;
+    fwrite(&record, 1, sizeof(record), _output);
+    _recordedEventCount++;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Appends a scene config change.  Does nothing if there is no recording.
+Parameters:
+    frameIndex  The frame that the change is applied at the top of.
+    config      The whole config that was put into effect, overrides and all.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void InputEventLog::RecordSceneConfig(unsigned int frameIndex, const SceneConfig &config)
+{
+    if (_output == 0)
+    {
+        return;
+    }
+
+    InputEventRecord record;
+    memset(&record, 0, sizeof(record));
+    record._frameIndex = frameIndex;
+    record._type = (unsigned short)INPUT_EVENT_SCENE_CONFIG;
+    record._payloadBytes = (unsigned short)sizeof(SceneConfig);
+    fwrite(&record, 1, sizeof(record), _output);
+    fwrite(&config, 1, sizeof(config), _output);
+    _recordedEventCount++;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Hands out the replay's events in order, up to and including the ones for the given frame.
+    Call it until it returns false at the top of every frame.
+Parameters:
+    frameIndex      The frame that is starting.
+    putEventHere    Self-explanatory.
+Returns:
+    False if the next event is for a later frame, or there are no more.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool InputEventLog::TakeEvent(unsigned int frameIndex, InputEvent *putEventHere)
+{
+    if (_nextEvent >= _events.size() || _events[_nextEvent]._record._frameIndex > frameIndex)
+    {
+        return false;
+    }
+
+    *putEventHere = _events[_nextEvent];
+    _nextEvent++;
+    return true;
+}
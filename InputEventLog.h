@@ -0,0 +1,105 @@
+#pragma once
+
+#include "SceneConfig.h"
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+// the file format of InputEventLog, in the byte order of the machine that recorded it
+// Note: The file header is followed by the SceneConfig that the session started with, and then
+// by the events in the order that they happened, each one an InputEventRecord and then
+// _payloadBytes bytes of payload.  Only a scene config change has a payload, which is the
+// SceneConfig that was put into effect, so _sceneConfigBytes in the header says whether a
+// replay was built with the same one.
+static const unsigned int INPUT_EVENT_LOG_MAGIC = 0x54504e49;   // "INPT" in the file
+static const unsigned int INPUT_EVENT_LOG_VERSION = 1;
+
+enum InputEventType
+{
+    INPUT_EVENT_KEY = 1,            // key, x, y
+    INPUT_EVENT_MOUSE_BUTTON,       // button, is down, x, y
+    INPUT_EVENT_MOUSE_MOVE,         // x, y
+    INPUT_EVENT_MOUSE_WHEEL,        // wheel steps, x, y
+    INPUT_EVENT_RESIZE,             // width, height
+    INPUT_EVENT_SCENE_CONFIG,       // the SceneConfig is the payload
+    INPUT_EVENT_END,                // none; stamped with the number of frames that ran
+};
+
+struct InputEventLogHeader
+{
+    unsigned int _magic;
+    unsigned int _version;
+    unsigned int _sceneConfigBytes;         // sizeof(SceneConfig)
+    unsigned int _isDeterministic;
+    unsigned int _randomSeed;
+};
+
+struct InputEventRecord
+{
+    unsigned int _frameIndex;               // the frame that the event is applied at the top of
+    unsigned short _type;                   // an InputEventType
+    unsigned short _payloadBytes;
+    int _values[4];                         // see InputEventType
+};
+
+struct InputEvent
+{
+    InputEventRecord _record;
+    SceneConfig _sceneConfig;               // only for INPUT_EVENT_SCENE_CONFIG
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Records the demo's input (keys, mouse buttons, moves, and the wheel, window resizes, and
+    the scene config changes that were put into effect) with the frame that each one was
+    applied at, along with the scene that the session started with, and plays it back so that an interactive session can be run again exactly,
+    with or without a window.  With "--deterministic", the simulation only depends on its
+    seed and what it was told to do, so a session that someone recorded in the field replays
+    bit for bit on another machine, and its performance can be profiled at leisure.
+
+    Recording appends a fixed 24-byte record per event (and the SceneConfig after a config
+    change) through stdio's buffer, so it costs the frame nothing that can be measured.  The
+    replay reads the whole file at Open(...) and hands out each frame's events with
+    TakeEvent(...), so there is no file access while it runs either.
+
+    Note: Events are stamped with the frame that they are applied at, not with the time, since
+    a replay runs at whatever speed it runs.  The caller stamps them with the index of the
+    next frame to run, and the replay applies them right before that frame.  The recording
+    ends with INPUT_EVENT_END, so that the replay stops after the same number of frames.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class InputEventLog
+{
+public:
+    InputEventLog();
+    ~InputEventLog();
+    bool StartRecording(const std::string &filePath, const InputEventLogHeader &header,
+        const SceneConfig &startSceneConfig);
+    bool OpenReplay(const std::string &filePath);
+    void Cleanup();
+
+    bool IsRecording() const;
+    bool IsReplaying() const;
+    const InputEventLogHeader &GetHeader() const;
+    const SceneConfig &GetStartSceneConfig() const;
+    unsigned int GetFrameCount() const;
+
+    void Record(unsigned int frameIndex, InputEventType type, int value0, int value1 = 0,
+        int value2 = 0, int value3 = 0);
+    void RecordSceneConfig(unsigned int frameIndex, const SceneConfig &config);
+    bool TakeEvent(unsigned int frameIndex, InputEvent *putEventHere);
+
+private:
+    InputEventLogHeader _header;
+    SceneConfig _startSceneConfig;
+
+    // recording
+    FILE *_output;
+    unsigned int _recordedEventCount;
+
+    // replaying
+    std::vector<InputEvent> _events;
+    size_t _nextEvent;
+    bool _isReplaying;
+};
@@ -0,0 +1,389 @@
+#include "LargeHostBuffer.h"
+
+#include "Log.h"
+
+#include <atomic>
+#include <stdlib.h>
+#include <stdio.h>
+
+#ifdef WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+// off by default (see LargeHostBuffer.h)
+static std::atomic<bool> gIsLargePagesEnabled(false);
+
+// for LogLargePageUse(), since a fallback is otherwise silent
+// Note: The buffers are allocated on several threads (ex: the trajectory recorder's writer).
+static std::atomic<unsigned int> gLargePageAllocationCount(0);
+static std::atomic<unsigned long long> gLargePageBytes(0);
+static std::atomic<unsigned int> gFallbackAllocationCount(0);
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The OS's large page size in bytes, or 0 if it doesn't have large pages.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static size_t GetLargePageSize()
+{
+#ifdef WIN32
+    return (size_t)GetLargePageMinimum();
+#elif defined(__linux__)
+    // Note: MAP_HUGETLB without a size flag takes the default huge page size, which is 2MB
+    // on x86-64 unless the kernel was booted with another.
+    return 2 * 1024 * 1024;
+#else
+    return 0;
+#endif
+}
+
+#ifdef WIN32
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Windows only hands out large pages to a process that has turned on the "Lock pages in
+    memory" privilege in its token, and it can only turn on a privilege that the user was
+    given.
+Parameters: None
+Returns:
+    False if the user doesn't have the privilege, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static bool EnableLockMemoryPrivilege()
+{
+    HANDLE tokenHandle = 0;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY,
+        &tokenHandle))
+    {
+        return false;
+    }
+    TOKEN_PRIVILEGES privileges;
+    privileges.PrivilegeCount = 1;
+    privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+    bool isEnabled = LookupPrivilegeValueA(0, "SeLockMemoryPrivilege",
+        &privileges.Privileges[0].Luid) &&
+        AdjustTokenPrivileges(tokenHandle, FALSE, &privileges, 0, 0, 0) &&
+        GetLastError() == ERROR_SUCCESS;
+    CloseHandle(tokenHandle);
+    return isEnabled;
+}
+#endif
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.  There is no memory until Allocate(...).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+LargeHostBuffer::LargeHostBuffer() :
+    _data(0),
+    _sizeBytes(0),
+    _capacityBytes(0),
+    _allocationKind(ALLOCATION_NONE)
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Free() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+LargeHostBuffer::~LargeHostBuffer()
+{
+    this->Free();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Makes the buffer the given size.  The memory is kept if there is already enough of it,
+    and otherwise it is freed and allocated again, on large pages if they are on and the
+    buffer is at least one large page.  The size is rounded up to a whole number of pages
+    for the OS, but only the size that was asked for is reported.
+Parameters:
+    sizeBytes   0 keeps the memory and makes the buffer empty.
+Returns:
+    False if there wasn't enough memory (the buffer is then empty), otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool LargeHostBuffer::Allocate(size_t sizeBytes)
+{
+    if (sizeBytes <= _capacityBytes)
+    {
+        _sizeBytes = sizeBytes;
+        return true;
+    }
+    this->Free();
+
+    size_t largePageSize = GetLargePageSize();
+    if (!gIsLargePagesEnabled || largePageSize == 0 || sizeBytes < largePageSize)
+    {
+        _data = (unsigned char *)malloc(sizeBytes);
+        if (_data == 0)
+        {
+            return false;
+        }
+        _sizeBytes = sizeBytes;
+        _capacityBytes = sizeBytes;
+        _allocationKind = ALLOCATION_HEAP;
+        return true;
+    }
+
+    size_t roundedSizeBytes = ((sizeBytes + largePageSize - 1) / largePageSize) * largePageSize;
+#ifdef WIN32
+    void *data = VirtualAlloc(0, roundedSizeBytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+        PAGE_READWRITE);
+    _allocationKind = ALLOCATION_LARGE_PAGES;
+    if (data == 0)
+    {
+        data = VirtualAlloc(0, roundedSizeBytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        _allocationKind = ALLOCATION_PAGES;
+    }
+#elif defined(__linux__)
+    void *data = mmap(0, roundedSizeBytes, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    _allocationKind = ALLOCATION_LARGE_PAGES;
+    if (data == MAP_FAILED)
+    {
+        // the reserved pool is empty (or there is none), so ordinary pages it is, which the
+        // kernel may still back with huge pages as it finds them
+        data = mmap(0, roundedSizeBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+            -1, 0);
+        _allocationKind = ALLOCATION_PAGES;
+        if (data == MAP_FAILED)
+        {
+            data = 0;
+        }
+        else
+        {
+            madvise(data, roundedSizeBytes, MADV_HUGEPAGE);
+        }
+    }
+#else
+    void *data = 0;
+#endif
+    if (data == 0)
+    {
+        _allocationKind = ALLOCATION_NONE;
+        return false;
+    }
+
+    if (_allocationKind == ALLOCATION_LARGE_PAGES)
+    {
+        gLargePageAllocationCount++;
+        gLargePageBytes += roundedSizeBytes;
+    }
+    else
+    {
+        gFallbackAllocationCount++;
+    }
+    _data = (unsigned char *)data;
+    _sizeBytes = sizeBytes;
+    _capacityBytes = roundedSizeBytes;
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Makes the buffer the size of a whole file and reads the file into it with one read,
+    instead of mapping it (see MappedFile.h), which takes a page fault for every 4KB of the
+    file as it is touched.
+Parameters:
+    filePath    Self-explanatory.
+Returns:
+    False if the file couldn't be read (the buffer is then empty), otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool LargeHostBuffer::ReadFile(const std::string &filePath)
+{
+    _sizeBytes = 0;
+    FILE *file = fopen(filePath.c_str(), "rb");
+    if (file == 0)
+    {
+        LogPrintf("couldn't open '%s'\n", filePath.c_str());
+        return false;
+    }
+
+    // Note: Large files are the point, so the size is taken past 2GB where the OS allows.
+#ifdef WIN32
+    bool isSized = (_fseeki64(file, 0, SEEK_END) == 0);
+    long long fileSizeBytes = isSized ? _ftelli64(file) : -1;
+    isSized = isSized && (_fseeki64(file, 0, SEEK_SET) == 0);
+#else
+    bool isSized = (fseeko(file, 0, SEEK_END) == 0);
+    long long fileSizeBytes = isSized ? (long long)ftello(file) : -1;
+    isSized = isSized && (fseeko(file, 0, SEEK_SET) == 0);
+#endif
+    bool isRead = isSized && fileSizeBytes > 0 && this->Allocate((size_t)fileSizeBytes) &&
+        fread(_data, 1, (size_t)fileSizeBytes, file) == (size_t)fileSizeBytes;
+    fclose(file);
+    if (!isRead)
+    {
+        LogPrintf("couldn't read '%s'\n", filePath.c_str());
+        _sizeBytes = 0;
+    }
+    return isRead;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives the memory back, however it was allocated.  Safe to call more than once.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void LargeHostBuffer::Free()
+{
+    if (_allocationKind == ALLOCATION_HEAP)
+    {
+        free(_data);
+    }
+    else if (_allocationKind != ALLOCATION_NONE)
+    {
+#ifdef WIN32
+        VirtualFree(_data, 0, MEM_RELEASE);
+#elif defined(__linux__)
+        munmap(_data, _capacityBytes);
+#endif
+    }
+    _data = 0;
+    _sizeBytes = 0;
+    _capacityBytes = 0;
+    _allocationKind = ALLOCATION_NONE;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The start of the buffer, or 0 if nothing has been allocated.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned char *LargeHostBuffer::GetData()
+{
+    return _data;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The start of the buffer, or 0 if nothing has been allocated.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+const unsigned char *LargeHostBuffer::GetData() const
+{
+    return _data;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The size that the last Allocate(...) asked for.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+size_t LargeHostBuffer::GetSizeBytes() const
+{
+    return _sizeBytes;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    True if the OS gave this buffer large pages (as opposed to transparent huge pages, which
+    it may or may not have), otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool LargeHostBuffer::IsOnLargePages() const
+{
+    return _allocationKind == ALLOCATION_LARGE_PAGES;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Turns large pages on or off for the buffers that are allocated after this.  On Windows,
+    this also turns on the privilege that they need, and leaves them off if the user doesn't
+    have it.
+Parameters:
+    isEnabled   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void LargeHostBuffer::EnableLargePages(bool isEnabled)
+{
+#ifdef WIN32
+    if (isEnabled && !EnableLockMemoryPrivilege())
+    {
+        LogPrintf("large pages: the user doesn't have the \"Lock pages in memory\" privilege, "
+            "so the buffers use ordinary pages\n");
+        isEnabled = false;
+    }
+#endif
+    if (isEnabled && GetLargePageSize() == 0)
+    {
+        LogPrintf("large pages: not supported on this OS\n");
+        isEnabled = false;
+    }
+    gIsLargePagesEnabled = isEnabled;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    True if EnableLargePages(...) turned them on, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool LargeHostBuffer::IsLargePagesEnabled()
+{
+    return gIsLargePagesEnabled;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Logs how many buffers got large pages and how many fell back, so that a run that was
+    meant to use them can tell whether it did (ex: the pool that the administrator set aside
+    was too small).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void LargeHostBuffer::LogLargePageUse()
+{
+    if (!gIsLargePagesEnabled)
+    {
+        return;
+    }
+    LogPrintf("large pages: %u buffers (%lluMB) on large pages, %u fell back to ordinary "
+        "pages\n", gLargePageAllocationCount.load(),
+        gLargePageBytes.load() / (1024 * 1024), gFallbackAllocationCount.load());
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <string>
+#include <stddef.h>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    A buffer of bytes on the CPU for the big bulk copies (ex: staging a whole particle pool
+    for ParticleManager::LoadParticles(...), reading one back, encoding a trajectory frame),
+    which can be on the OS's large pages.  A buffer of hundreds of megabytes on 4KB pages
+    takes a page fault the first time each page is touched and misses the TLB on nearly every
+    page after that, and on 2MB pages (or Windows' large pages) both are 512 times fewer.
+
+    Large pages are off until EnableLargePages(...), since they are a limited resource that
+    is set aside by the administrator (Linux's vm.nr_hugepages, Windows' "Lock pages in
+    memory" privilege).  When they are on, a buffer tries them first (MAP_HUGETLB or
+    VirtualAlloc(...) with MEM_LARGE_PAGES) and falls back to ordinary pages, which on Linux
+    are still offered to transparent huge pages (madvise(MADV_HUGEPAGE)).  A buffer smaller
+    than a large page is always an ordinary allocation.
+
+    Note: Allocate(...) doesn't keep the contents, unlike std::vector::resize(...), since
+    every user overwrites the whole buffer.  It keeps the memory if it is already big enough.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class LargeHostBuffer
+{
+public:
+    LargeHostBuffer();
+    ~LargeHostBuffer();
+    bool Allocate(size_t sizeBytes);
+    bool ReadFile(const std::string &filePath);
+    void Free();
+
+    unsigned char *GetData();
+    const unsigned char *GetData() const;
+    size_t GetSizeBytes() const;
+    bool IsOnLargePages() const;
+
+    static void EnableLargePages(bool isEnabled);
+    static bool IsLargePagesEnabled();
+    static void LogLargePageUse();
+
+private:
+    // no copies; there is only one allocation to free
+    LargeHostBuffer(const LargeHostBuffer &);
+    LargeHostBuffer &operator=(const LargeHostBuffer &);
+
+    // how the memory was allocated, which is how it must be freed
+    enum AllocationKind
+    {
+        ALLOCATION_NONE = 0,
+        ALLOCATION_HEAP,
+        ALLOCATION_PAGES,
+        ALLOCATION_LARGE_PAGES,
+    };
+
+    unsigned char *_data;
+    size_t _sizeBytes;
+    size_t _capacityBytes;
+    AllocationKind _allocationKind;
+};
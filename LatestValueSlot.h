@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Hands the newest value from one thread to another without a lock, where only the newest
+    one matters (ex: where the mouse is).  The writer never waits and never fails, and the
+    reader gets the last value that was published before it looked, or knows that there
+    hasn't been a new one.  Values in between are simply replaced.
+
+    It is a triple buffer.  The writer fills its own buffer and swaps it with the middle one,
+    marking the middle as new.  The reader swaps its own buffer with the middle one only if
+    the middle is new.  The swaps are single atomic exchanges of the middle's index, so the
+    two sides never touch the same buffer at the same time.
+
+    Note: One writer thread and one reader thread.  The writer and the reader may be the same
+    thread.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+template<typename T>
+class LatestValueSlot
+{
+public:
+    LatestValueSlot() :
+        _writeIndex(0),
+        _middle(1),
+        _readIndex(2)
+    {
+    }
+
+    // the writer's side; replaces whatever the reader hasn't taken yet
+    void Publish(const T &value)
+    {
+        _buffers[_writeIndex] = value;
+        unsigned int oldMiddle = _middle.exchange(_writeIndex | NEW_VALUE_BIT,
+            std::memory_order_acq_rel);
+        _writeIndex = oldMiddle & INDEX_MASK;
+    }
+
+    // the reader's side; false, and nothing copied, if nothing was published since last time
+    bool TakeLatest(T *putValueHere)
+    {
+        if ((_middle.load(std::memory_order_relaxed) & NEW_VALUE_BIT) == 0)
+        {
+            return false;
+        }
+        unsigned int oldMiddle = _middle.exchange(_readIndex, std::memory_order_acq_rel);
+        _readIndex = oldMiddle & INDEX_MASK;
+        *putValueHere = _buffers[_readIndex];
+        return true;
+    }
+
+private:
+    // no copies; the two sides hold on to it
+    LatestValueSlot(const LatestValueSlot &);
+    LatestValueSlot &operator=(const LatestValueSlot &);
+
+    static const unsigned int INDEX_MASK = 3;
+    static const unsigned int NEW_VALUE_BIT = 4;
+
+    T _buffers[3];
+
+    // each side's own buffer, which only that side touches
+    unsigned int _writeIndex;
+    std::atomic<unsigned int> _middle;
+    unsigned int _readIndex;
+};
@@ -0,0 +1,246 @@
+#include "Log.h"
+
+#include "MpscRing.h"
+
+#include <atomic>
+#include <chrono>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+// one piece of a line (or a few lines) of output
+// Note: Most output fits in one entry.  Longer output (ex: a shader's info log) is split across
+// as many entries as it takes, and they are printed back to back.
+static const unsigned int LOG_ENTRY_MAX_LENGTH = 512;
+struct LogEntry
+{
+    bool _isError;
+    char _text[LOG_ENTRY_MAX_LENGTH];
+};
+
+// about half a megabyte, which is more than a whole startup's worth of output
+static const unsigned int LOG_RING_SIZE = 1024;
+static MpscRing<LogEntry, LOG_RING_SIZE> gLogRing;
+
+// the writer thread sleeps this long between drains
+// Note: Short enough that the output still looks live, long enough that the thread is asleep 
+// nearly all the time.
+static const unsigned int LOG_WRITER_SLEEP_MS = 20;
+static std::atomic<bool> gIsLogRunning(false);
+static std::thread gLogWriterThread;
+static unsigned int gReportedDroppedLines = 0;
+
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Prints every entry in the ring, plus a note if any lines were dropped since the last time.  
+    Only call this from one thread at a time (the writer thread, or CleanupLog() after the 
+    writer thread has been joined).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+static void DrainLog()
+{
+    LogEntry entry;
+    bool printedOut = false;
+    bool printedError = false;
+    while (gLogRing.TryPop(&entry))
+    {
+        fputs(entry._text, entry._isError ? stderr : stdout);
+        printedOut = printedOut || !entry._isError;
+        printedError = printedError || entry._isError;
+    }
+
+    unsigned int droppedLines = gLogRing.GetDroppedItemCount();
+    if (droppedLines != gReportedDroppedLines)
+    {
+        fprintf(stderr, "log: %u line(s) dropped\n", droppedLines - gReportedDroppedLines);
+        gReportedDroppedLines = droppedLines;
+        printedError = true;
+    }
+
+    if (printedOut)
+    {
+        fflush(stdout);
+    }
+    if (printedError)
+    {
+        fflush(stderr);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The writer thread.  Drains the ring and sleeps until the log is stopped.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+static void LogWriterThreadLoop()
+{
+    while (gIsLogRunning)
+    {
+        DrainLog();
+        std::this_thread::sleep_for(std::chrono::milliseconds(LOG_WRITER_SLEEP_MS));
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Formats the text and either queues it for the writer thread or, if the log isn't running, 
+    prints it right away.  Only text longer than an entry allocates.
+Parameters:
+    isError     Self-explanatory.
+    format      printf(...) style.
+    args        Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+static void LogFormatted(bool isError, const char *format, va_list args)
+{
+    // vsnprintf(...) uses up the argument list, so keep a copy in case it needs a second try
+    va_list argsCopy;
+    va_copy(argsCopy, args);
+
+    LogEntry entry;
+    entry._isError = isError;
+    int textLength = vsnprintf(entry._text, LOG_ENTRY_MAX_LENGTH, format, args);
+    if (textLength < 0)
+    {
+        va_end(argsCopy);
+        return;
+    }
+
+    if (!gIsLogRunning)
+    {
+        // same output, just synchronous
+        if ((unsigned int)textLength < LOG_ENTRY_MAX_LENGTH)
+        {
+            fputs(entry._text, isError ? stderr : stdout);
+        }
+        else
+        {
+            vfprintf(isError ? stderr : stdout, format, argsCopy);
+        }
+        va_end(argsCopy);
+        return;
+    }
+
+    if ((unsigned int)textLength < LOG_ENTRY_MAX_LENGTH)
+    {
+        gLogRing.TryPush(entry);
+        va_end(argsCopy);
+        return;
+    }
+
+    // too long for one entry, so split it
+    std::vector<char> longText(textLength + 1, 0);
+    vsnprintf(longText.data(), longText.size(), format, argsCopy);
+    va_end(argsCopy);
+    unsigned int maxChunkLength = LOG_ENTRY_MAX_LENGTH - 1;
+    for (unsigned int textStart = 0; textStart < (unsigned int)textLength; 
+        textStart += maxChunkLength)
+    {
+        unsigned int chunkLength = (unsigned int)textLength - textStart;
+        if (chunkLength > maxChunkLength)
+        {
+            chunkLength = maxChunkLength;
+        }
+        memcpy(entry._text, longText.data() + textStart, chunkLength);
+        entry._text[chunkLength] = 0;
+        gLogRing.TryPush(entry);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Starts the writer thread.  From here until CleanupLog(), logging doesn't print on the 
+    calling thread.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void InitLog()
+{
+    if (gIsLogRunning)
+    {
+        return;
+    }
+
+    gIsLogRunning = true;
+    gLogWriterThread = std::thread(LogWriterThreadLoop);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Stops the writer thread and prints whatever is left in the ring.  Logging prints right 
+    away after this.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void CleanupLog()
+{
+    gIsLogRunning = false;
+    if (gLogWriterThread.joinable())
+    {
+        gLogWriterThread.join();
+    }
+    DrainLog();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    printf(...) to stdout without blocking on it.  Safe from any thread.
+Parameters:
+    format  printf(...) style, followed by its arguments.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void LogPrintf(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    LogFormatted(false, format, args);
+    va_end(args);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Same as LogPrintf(...), but to stderr.
+Parameters:
+    format  printf(...) style, followed by its arguments.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void LogErrorPrintf(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    LogFormatted(true, format, args);
+    va_end(args);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How many lines have been dropped because the ring was full.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int GetDroppedLogLineCount()
+{
+    return gLogRing.GetDroppedItemCount();
+}
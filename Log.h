@@ -0,0 +1,14 @@
+#pragma once
+
+// console output that never blocks the caller (see Log.cpp)
+// Note: LogPrintf(...) goes to stdout and LogErrorPrintf(...) to stderr, both with printf(...)
+// formatting.  Between InitLog() and CleanupLog(), they format the line into a lock-free ring
+// and return, and a writer thread does the actual printing.  Before InitLog() and after 
+// CleanupLog(), they print right away, so nothing is lost at startup or shutdown.
+// Also Note: Lines are never waited on.  If the writer thread is so far behind that the ring 
+// is full, the line is dropped and counted, and the count is printed when there is room.
+void InitLog();
+void CleanupLog();
+void LogPrintf(const char *format, ...);
+void LogErrorPrintf(const char *format, ...);
+unsigned int GetDroppedLogLineCount();
@@ -0,0 +1,194 @@
+#include "MappedFile.h"
+
+#include "Log.h"
+
+#ifdef WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.  There is no file until Open(...).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+MappedFile::MappedFile() :
+    _data(0),
+    _sizeBytes(0),
+    _fileHandle(0),
+    _mappingHandle(0),
+    _fileDescriptor(-1)
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Close() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+MappedFile::~MappedFile()
+{
+    this->Close();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Maps the whole file, read-only.  Any file that was already open is closed first.
+Parameters:
+    filePath    Self-explanatory.
+Returns:
+    False if the file couldn't be opened or mapped, or if it is empty, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+bool MappedFile::Open(const std::string &filePath)
+{
+    this->Close();
+
+#ifdef WIN32
+    HANDLE fileHandle = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, 0,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+    {
+        LogPrintf("couldn't open '%s'\n", filePath.c_str());
+        return false;
+    }
+    _fileHandle = fileHandle;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+    {
+        LogPrintf("'%s' is empty\n", filePath.c_str());
+        this->Close();
+        return false;
+    }
+
+    HANDLE mappingHandle = CreateFileMappingA(fileHandle, 0, PAGE_READONLY, 0, 0, 0);
+    if (mappingHandle == 0)
+    {
+        LogPrintf("couldn't map '%s'\n", filePath.c_str());
+        this->Close();
+        return false;
+    }
+    _mappingHandle = mappingHandle;
+
+    _data = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if (_data == 0)
+    {
+        LogPrintf("couldn't map '%s'\n", filePath.c_str());
+        this->Close();
+        return false;
+    }
+    _sizeBytes = (size_t)fileSize.QuadPart;
+#else
+    _fileDescriptor = open(filePath.c_str(), O_RDONLY);
+    if (_fileDescriptor < 0)
+    {
+        LogPrintf("couldn't open '%s'\n", filePath.c_str());
+        return false;
+    }
+
+    struct stat fileStatus;
+    if (fstat(_fileDescriptor, &fileStatus) != 0 || fileStatus.st_size == 0)
+    {
+        LogPrintf("'%s' is empty\n", filePath.c_str());
+        this->Close();
+        return false;
+    }
+
+    void *data = mmap(0, (size_t)fileStatus.st_size, PROT_READ, MAP_PRIVATE, _fileDescriptor,
+        0);
+    if (data == MAP_FAILED)
+    {
+        LogPrintf("couldn't map '%s'\n", filePath.c_str());
+        this->Close();
+        return false;
+    }
+
+    // the whole file is about to be read, so start reading it now
+    madvise(data, (size_t)fileStatus.st_size, MADV_WILLNEED);
+    _data = data;
+    _sizeBytes = (size_t)fileStatus.st_size;
+#endif
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Unmaps the view and closes the file.  Safe to call more than once.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void MappedFile::Close()
+{
+#ifdef WIN32
+    if (_data != 0)
+    {
+        UnmapViewOfFile(_data);
+    }
+    if (_mappingHandle != 0)
+    {
+        CloseHandle((HANDLE)_mappingHandle);
+    }
+    if (_fileHandle != 0)
+    {
+        CloseHandle((HANDLE)_fileHandle);
+    }
+#else
+    if (_data != 0)
+    {
+        munmap((void *)_data, _sizeBytes);
+    }
+    if (_fileDescriptor >= 0)
+    {
+        close(_fileDescriptor);
+    }
+#endif
+    _data = 0;
+    _sizeBytes = 0;
+    _fileHandle = 0;
+    _mappingHandle = 0;
+    _fileDescriptor = -1;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The start of the view, or 0 if there is no file open.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+const void *MappedFile::GetData() const
+{
+    return _data;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The size of the file, or 0 if there is no file open.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+size_t MappedFile::GetSizeBytes() const
+{
+    return _sizeBytes;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <stddef.h>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    A read-only view of a whole file through the OS's virtual memory (MapViewOfFile(...) on
+    Windows, mmap(...) elsewhere).  Nothing is read when the file is opened; the pages are
+    read as they are touched, and handing the view straight to the driver (ex:
+    glBufferStorage(...)) skips the copy into a buffer of our own.
+
+    Note: The view is only good until Close() or the destructor.
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+    bool Open(const std::string &filePath);
+    void Close();
+
+    const void *GetData() const;
+    size_t GetSizeBytes() const;
+
+private:
+    // no copies; there is only one view to close
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+
+    const void *_data;
+    size_t _sizeBytes;
+
+    // Note: Windows' handles are pointers, so they are stored as void * to keep windows.h out
+    // of the header.  Elsewhere, _fileDescriptor is used instead.
+    void *_fileHandle;
+    void *_mappingHandle;
+    int _fileDescriptor;
+};
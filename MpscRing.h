@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    A fixed-size, lock-free queue that any number of threads can push into and one thread pops 
+    out of.  Used where the pushing thread must never block or allocate: a GL debug callback, 
+    which the driver may call from any of its threads, or the render thread.
+
+    Every slot has a sequence number that says whose turn it is.  A producer claims a slot by 
+    advancing the shared push position with a compare-and-swap, copies its item in, and then 
+    publishes it by bumping that slot's sequence.  The consumer only takes a slot once its 
+    sequence says that it was published, and hands it back by bumping the sequence a whole lap 
+    ahead.  Nothing ever waits: a full ring makes the push fail (and count a drop) instead.
+
+    Note: CAPACITY must be a power of 2 so that the positions can wrap with a mask.  They count 
+    up forever and wrap at 2^32, which the unsigned math handles.
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+template<typename T, unsigned int CAPACITY>
+class MpscRing
+{
+public:
+    MpscRing() :
+        _pushPosition(0),
+        _popPosition(0),
+        _droppedItems(0)
+    {
+        static_assert((CAPACITY & (CAPACITY - 1)) == 0, "MpscRing capacity must be a power of 2");
+        for (unsigned int slotIndex = 0; slotIndex < CAPACITY; slotIndex++)
+        {
+            _slots[slotIndex]._sequence.store(slotIndex, std::memory_order_relaxed);
+        }
+    }
+
+    // safe from any thread; returns false (and counts a drop) if the ring is full
+    bool TryPush(const T &item)
+    {
+        Slot *slot = 0;
+        unsigned int position = _pushPosition.load(std::memory_order_relaxed);
+        while (true)
+        {
+            slot = &_slots[position & (CAPACITY - 1)];
+            unsigned int sequence = slot->_sequence.load(std::memory_order_acquire);
+            int lag = (int)(sequence - position);
+            if (lag == 0)
+            {
+                // the slot is free for this position; claim it unless another producer did
+                if (_pushPosition.compare_exchange_weak(position, position + 1, 
+                    std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (lag < 0)
+            {
+                // the consumer hasn't handed this slot back from the last lap yet
+                _droppedItems.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            else
+            {
+                // another producer got here first
+                position = _pushPosition.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot->_item = item;
+
+        // "release" so that the item is visible to the consumer before the sequence is
+        slot->_sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // only call from the one consumer thread; returns false if there is nothing to pop
+    bool TryPop(T *putItemHere)
+    {
+        unsigned int position = _popPosition.load(std::memory_order_relaxed);
+        Slot &slot = _slots[position & (CAPACITY - 1)];
+        unsigned int sequence = slot._sequence.load(std::memory_order_acquire);
+        if ((int)(sequence - (position + 1)) < 0)
+        {
+            return false;
+        }
+
+        *putItemHere = slot._item;
+        slot._sequence.store(position + CAPACITY, std::memory_order_release);
+        _popPosition.store(position + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // true if a pop would probably find something; only the consumer's answer is exact
+    bool IsEmpty() const
+    {
+        return _pushPosition.load(std::memory_order_relaxed) == 
+            _popPosition.load(std::memory_order_relaxed);
+    }
+
+    unsigned int GetDroppedItemCount() const
+    {
+        return _droppedItems.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Slot
+    {
+        std::atomic<unsigned int> _sequence;
+        T _item;
+    };
+
+    Slot _slots[CAPACITY];
+    std::atomic<unsigned int> _pushPosition;
+    std::atomic<unsigned int> _popPosition;
+    std::atomic<unsigned int> _droppedItems;
+};
@@ -0,0 +1,535 @@
+#include "MultiGpuSimulation.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
+#include "GlFenceSync.h"
+#include "EglHeadlessWindow.h"
+#include "FrameArena.h"
+#include "GpuMemoryLedger.h"
+#include "OpenGlErrorHandling.h"
+#include "ParticleManager.h"
+#include "ShaderProgramRegistry.h"
+#include "Log.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <string.h>
+#include <thread>
+
+// must match the binding of uImage in shaderMultiGpuComposite.frag
+static const unsigned int COMPOSITE_TEXTURE_UNIT = 0;
+
+// RGBA, 16-bit floats
+static const unsigned int SHARD_BYTES_PER_PIXEL = 8;
+
+// how long a shard waits on a readback before it gives up on that frame's image
+static const GLuint64 SHARD_READBACK_TIMEOUT_NS = 1000000000;
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Everything about one of the other GPUs.  The display's thread writes the frame requests
+    and reads the images, the shard's thread does the opposite, and both only touch those
+    under the mutex.  The texture belongs to the display's context and everything else that
+    is GL belongs to the shard's.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+struct MultiGpuShard
+{
+    unsigned int _deviceIndex;
+    unsigned int _randomSeed;
+    std::thread _thread;
+    std::mutex _mutex;
+    std::condition_variable _condition;
+
+    // set by the shard once its context and particles are ready (or couldn't be)
+    bool _isStarted;
+    bool _isStartGood;
+
+    // the frame that the display asked for; the steps add up until the shard takes them
+    bool _hasPendingFrame;
+    unsigned int _pendingSteps;
+    float _stepSec;
+    glm::mat4 _viewProjection;
+    bool _isCulled;
+    bool _isStopping;
+
+    // the newest finished image, and how many there have been
+    std::vector<unsigned char> _image;
+    unsigned int _imageCount;
+
+    // the display's copy of the image
+    unsigned int _uploadedImageCount;
+    GLuint _textureId;
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The shard's thread.  Makes a context on the shard's GPU, a ParticleManager with a whole
+    pool, a half float framebuffer, and 2 pixel buffers to read it back through, and says
+    whether that worked.  Then, for every frame that the display asks for: runs the steps,
+    draws, starts reading the image back, and hands over the last frame's image, whose
+    readback has had a frame to finish.  Everything is torn down on the same thread at the
+    end, with the context still current.
+Parameters:
+    shard       Self-explanatory.
+    settings    A copy, since the thread outlives the call that started it.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static void RunMultiGpuShard(MultiGpuShard *shard, MultiGpuShardSettings settings)
+{
+    EglHeadlessWindow window;
+    window.SetDeviceIndex(shard->_deviceIndex);
+    AppWindowSettings windowSettings;
+    windowSettings._title = "particle shard";
+    windowSettings._width = settings._width;
+    windowSettings._height = settings._height;
+    windowSettings._positionX = 0;
+    windowSettings._positionY = 0;
+    windowSettings._glMajorVersion = 4;
+    windowSettings._glMinorVersion = 4;
+    windowSettings._hasDepthBuffer = false;
+    windowSettings._isDebugContext = false;
+    bool isGood = window.Create(windowSettings);
+
+    ParticleManager particleManager;
+    GLuint framebufferId = 0;
+    GLuint colorTextureId = 0;
+    GLuint packBufferIds[2] = { 0, 0 };
+    GLsync fences[2] = { 0, 0 };
+    size_t imageSizeBytes = (size_t)settings._width * settings._height * SHARD_BYTES_PER_PIXEL;
+    if (isGood)
+    {
+        GLuint renderProgramId = settings._useQuads ?
+            AcquireRenderProgram("shaderParticle.vert", "shaderParticleQuad.frag",
+            ParticleManager::GetQuadRenderShaderDefines(settings._layout)) :
+            AcquireRenderProgram();
+        GLuint computeProgramId = AcquireComputeProgram(
+            ParticleManager::GetComputeShaderDefines(settings._layout));
+        isGood = (renderProgramId != 0 && computeProgramId != 0);
+        if (isGood)
+        {
+            const ParticleEmitter &emitter = settings._emitter;
+            particleManager.SetDeterministic(false, shard->_randomSeed);
+            particleManager.Init(renderProgramId, computeProgramId, settings._particleCount,
+                emitter._maxParticlesEmittedPerFrame, emitter._center, emitter._radius,
+                emitter._velocityMin, emitter._velocityMax, settings._layout);
+            ParticleEmitter withLifetime = particleManager.GetEmitters()[0];
+            withLifetime._lifetimeSec = emitter._lifetimeSec;
+            particleManager.SetEmitter(0, withLifetime);
+            particleManager.SetSubstepsPerDispatch(4);
+            particleManager.SetPointSize(settings._pointSize);
+            particleManager.SetParticleBrightness(settings._brightness);
+            particleManager.SetViewportSize(settings._width, settings._height);
+        }
+        ReleaseProgram(renderProgramId);
+        ReleaseProgram(computeProgramId);
+    }
+    if (isGood)
+    {
+        glGenTextures(1, &colorTextureId);
+        glBindTexture(GL_TEXTURE_2D, colorTextureId);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA16F, settings._width, settings._height);
+        RecordGpuAllocation(GPU_MEMORY_TEXTURE, colorTextureId,
+            GetGlTextureSizeBytes(GL_RGBA16F, settings._width, settings._height),
+            "multi-GPU shard image");
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glGenFramebuffers(1, &framebufferId);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebufferId);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+            colorTextureId, 0);
+        isGood = (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+
+        glGenBuffers(2, packBufferIds);
+        for (int bufferIndex = 0; bufferIndex < 2; bufferIndex++)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, packBufferIds[bufferIndex]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, imageSizeBytes, 0, GL_STREAM_READ);
+            RecordBoundGlBufferAllocation(GL_PIXEL_PACK_BUFFER, "multi-GPU shard readback");
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        // the display's additive blending (see main.cpp's Init())
+        DisableGlCapability(GL_DEPTH_TEST);
+        EnableGlCapability(GL_BLEND);
+        SetGlBlendFunc(GL_ONE, GL_ONE);
+        glEnable(GL_PROGRAM_POINT_SIZE);
+        glViewport(0, 0, settings._width, settings._height);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(shard->_mutex);
+        shard->_isStarted = true;
+        shard->_isStartGood = isGood;
+    }
+    shard->_condition.notify_all();
+
+    unsigned int frameCount = 0;
+    while (isGood)
+    {
+        unsigned int numSteps = 0;
+        float stepSec = 0.0f;
+        glm::mat4 viewProjection;
+        bool isCulled = false;
+        {
+            std::unique_lock<std::mutex> lock(shard->_mutex);
+            shard->_condition.wait(lock,
+                [shard]() { return shard->_isStopping || shard->_hasPendingFrame; });
+            if (shard->_isStopping)
+            {
+                break;
+            }
+            numSteps = shard->_pendingSteps;
+            stepSec = shard->_stepSec;
+            viewProjection = shard->_viewProjection;
+            isCulled = shard->_isCulled;
+            shard->_pendingSteps = 0;
+            shard->_hasPendingFrame = false;
+        }
+
+        GetFrameArena().BeginFrame();
+        particleManager.SetView(viewProjection, isCulled);
+        particleManager.UpdateSteps(stepSec, numSteps);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebufferId);
+        glClear(GL_COLOR_BUFFER_BIT);
+        particleManager.Render(0.0f);
+
+        // this frame's readback starts now and finishes while the next frame is simulated
+        unsigned int current = frameCount % 2;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, packBufferIds[current]);
+        glReadPixels(0, 0, settings._width, settings._height, GL_RGBA, GL_HALF_FLOAT, 0);
+        fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        GetFrameArena().EndFrame();
+
+        unsigned int previous = 1 - current;
+        if (fences[previous] != 0)
+        {
+            GlFenceWaitResult waitResult = WaitForGlFence(fences[previous],
+                SHARD_READBACK_TIMEOUT_NS, "shard readback");
+            glDeleteSync(fences[previous]);
+            fences[previous] = 0;
+            if (waitResult == GL_FENCE_SIGNALED)
+            {
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, packBufferIds[previous]);
+                const void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, imageSizeBytes,
+                    GL_MAP_READ_BIT);
+                if (pixels != 0)
+                {
+                    std::unique_lock<std::mutex> lock(shard->_mutex);
+                    shard->_image.resize(imageSizeBytes);
+                    memcpy(shard->_image.data(), pixels, imageSizeBytes);
+                    shard->_imageCount++;
+                }
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        frameCount++;
+    }
+
+    // the context is only there if it was made
+    if (window.GetWidth() > 0)
+    {
+        for (int bufferIndex = 0; bufferIndex < 2; bufferIndex++)
+        {
+            if (fences[bufferIndex] != 0)
+            {
+                glDeleteSync(fences[bufferIndex]);
+            }
+            ForgetGpuAllocation(GPU_MEMORY_BUFFER, packBufferIds[bufferIndex]);
+        }
+        DeleteGlBuffers(2, packBufferIds);
+        glDeleteFramebuffers(1, &framebufferId);
+        ForgetGpuAllocation(GPU_MEMORY_TEXTURE, colorTextureId);
+        glDeleteTextures(1, &colorTextureId);
+        particleManager.Cleanup();
+        CleanupShaderProgramRegistry();
+        GetFrameArena().Cleanup();
+    }
+    window.Destroy();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+MultiGpuSimulation::MultiGpuSimulation() :
+    _compositeProgramId(0),
+    _unifLocInverseViewportSize(-1),
+    _emptyVaoId(0)
+{
+    _settings = MultiGpuShardSettings();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+MultiGpuSimulation::~MultiGpuSimulation()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How many GPUs there are to split the particles across, the display's included, or 0 if
+    there is no way to tell (see EglHeadlessWindow::GetDeviceCount()).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int MultiGpuSimulation::GetDeviceCount()
+{
+    return EglHeadlessWindow::GetDeviceCount();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Starts a shard on each of the GPUs after the display's, one at a time (see the header),
+    and makes the display's textures for their images.  Blocks until every shard has its
+    particles, which is about as long as the display's own startup.
+Parameters:
+    compositeProgramId  Draws a shard's image over the display's particles (see
+                        shaderMultiGpuComposite.frag).  A reference is taken, like
+                        ParticleManager does.
+    shardCount          How many GPUs other than the display's to use.
+    settings            What each of them simulates.
+Returns:
+    False if any shard couldn't start, in which case none are left running, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool MultiGpuSimulation::Init(unsigned int compositeProgramId, unsigned int shardCount,
+    const MultiGpuShardSettings &settings)
+{
+    this->Cleanup();
+    _settings = settings;
+    _compositeProgramId = compositeProgramId;
+    AddProgramReference(_compositeProgramId);
+    _unifLocInverseViewportSize =
+        glGetUniformLocation(_compositeProgramId, "uInverseViewportSize");
+    glGenVertexArrays(1, &_emptyVaoId);
+
+    for (unsigned int shardIndex = 0; shardIndex < shardCount; shardIndex++)
+    {
+        MultiGpuShard *shard = new MultiGpuShard();
+        shard->_deviceIndex = shardIndex + 1;
+        shard->_randomSeed = (shardIndex + 1) * 7919;
+        shard->_isStarted = false;
+        shard->_isStartGood = false;
+        shard->_hasPendingFrame = false;
+        shard->_pendingSteps = 0;
+        shard->_stepSec = 0.0f;
+        shard->_isCulled = false;
+        shard->_isStopping = false;
+        shard->_imageCount = 0;
+        shard->_uploadedImageCount = 0;
+        shard->_textureId = 0;
+        glGenTextures(1, &shard->_textureId);
+        glBindTexture(GL_TEXTURE_2D, shard->_textureId);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA16F, settings._width, settings._height);
+        RecordGpuAllocation(GPU_MEMORY_TEXTURE, shard->_textureId,
+            GetGlTextureSizeBytes(GL_RGBA16F, settings._width, settings._height),
+            "multi-GPU composite");
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        _shards.push_back(shard);
+
+        shard->_thread = std::thread(RunMultiGpuShard, shard, settings);
+        bool isStartGood = false;
+        {
+            std::unique_lock<std::mutex> lock(shard->_mutex);
+            shard->_condition.wait(lock, [shard]() { return shard->_isStarted; });
+            isStartGood = shard->_isStartGood;
+        }
+        if (!isStartGood)
+        {
+            LogPrintf("multi-GPU: couldn't start a shard on GPU %u\n", shard->_deviceIndex);
+            this->Cleanup();
+            return false;
+        }
+    }
+
+    LogPrintf("multi-GPU: %u more GPUs with %u particles each\n", shardCount,
+        settings._particleCount);
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Stops every shard's thread, which tears down its own context, and deletes the display's
+    side.  Safe to call whether or not Init(...) was.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void MultiGpuSimulation::Cleanup()
+{
+    for (size_t shardIndex = 0; shardIndex < _shards.size(); shardIndex++)
+    {
+        MultiGpuShard *shard = _shards[shardIndex];
+        {
+            std::unique_lock<std::mutex> lock(shard->_mutex);
+            shard->_isStopping = true;
+        }
+        shard->_condition.notify_all();
+        if (shard->_thread.joinable())
+        {
+            shard->_thread.join();
+        }
+        ForgetGpuAllocation(GPU_MEMORY_TEXTURE, shard->_textureId);
+        glDeleteTextures(1, &shard->_textureId);
+        delete shard;
+    }
+    _shards.clear();
+
+    if (_emptyVaoId != 0)
+    {
+        DeleteGlVertexArrays(1, &_emptyVaoId);
+        _emptyVaoId = 0;
+    }
+    ReleaseProgram(_compositeProgramId);
+    _compositeProgramId = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Asks every shard for a frame: the steps that the display just ran, and the view to draw
+    them with.  Doesn't wait for anything (see the header).
+Parameters:
+    stepSec         Self-explanatory.
+    numSteps        May be 0, and the shards still draw (ex: the camera moved).
+    viewProjection  See ParticleManager::SetView(...).
+    isCulled        See ParticleManager::SetView(...).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void MultiGpuSimulation::Update(float stepSec, unsigned int numSteps,
+    const glm::mat4 &viewProjection, bool isCulled)
+{
+    for (size_t shardIndex = 0; shardIndex < _shards.size(); shardIndex++)
+    {
+        MultiGpuShard *shard = _shards[shardIndex];
+        {
+            std::unique_lock<std::mutex> lock(shard->_mutex);
+            shard->_hasPendingFrame = true;
+            shard->_pendingSteps += numSteps;
+            shard->_stepSec = stepSec;
+            shard->_viewProjection = viewProjection;
+            shard->_isCulled = isCulled;
+        }
+        shard->_condition.notify_all();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Uploads each shard's image if there is a new one, and adds all of them to whatever is
+    bound for drawing, over the whole viewport.  Call it right after the display's particles
+    are drawn, into the same target.
+
+    Note: Blending is turned on (additively) and the depth test off for the draws, and they
+    are put back the way that they were.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void MultiGpuSimulation::Composite()
+{
+    if (_shards.empty())
+    {
+        return;
+    }
+    GlDebugGroup compositeGroup("multi-GPU composite");
+
+    GLint viewport[4] = { 0, 0, 1, 1 };
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    GLboolean isBlendEnabled = IsGlCapabilityEnabled(GL_BLEND);
+    GLboolean isDepthTestEnabled = IsGlCapabilityEnabled(GL_DEPTH_TEST);
+    EnableGlCapability(GL_BLEND);
+    SetGlBlendFunc(GL_ONE, GL_ONE);
+    DisableGlCapability(GL_DEPTH_TEST);
+
+    UseGlProgram(_compositeProgramId);
+    glUniform2f(_unifLocInverseViewportSize, 1.0f / viewport[2], 1.0f / viewport[3]);
+    glActiveTexture(GL_TEXTURE0 + COMPOSITE_TEXTURE_UNIT);
+    BindGlVertexArray(_emptyVaoId);
+    for (size_t shardIndex = 0; shardIndex < _shards.size(); shardIndex++)
+    {
+        MultiGpuShard *shard = _shards[shardIndex];
+        glBindTexture(GL_TEXTURE_2D, shard->_textureId);
+        {
+            std::unique_lock<std::mutex> lock(shard->_mutex);
+            if (shard->_imageCount != shard->_uploadedImageCount && !shard->_image.empty())
+            {
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, _settings._width, _settings._height,
+                    GL_RGBA, GL_HALF_FLOAT, shard->_image.data());
+                shard->_uploadedImageCount = shard->_imageCount;
+            }
+        }
+
+        // nothing to add until the shard's first image is in
+        if (shard->_uploadedImageCount > 0)
+        {
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+    }
+    BindGlVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    UseGlProgram(0);
+
+    if (!isBlendEnabled)
+    {
+        DisableGlCapability(GL_BLEND);
+    }
+    if (isDepthTestEnabled)
+    {
+        EnableGlCapability(GL_DEPTH_TEST);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How many GPUs other than the display's are simulating particles.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int MultiGpuSimulation::GetShardCount() const
+{
+    return (unsigned int)_shards.size();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The size of all of the shards' pools together, not counting the display's.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned long long MultiGpuSimulation::GetShardParticleCount() const
+{
+    return (unsigned long long)_shards.size() * _settings._particleCount;
+}
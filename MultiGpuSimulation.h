@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Particle.h"
+#include "ParticleEmitter.h"
+#include "glm/mat4x4.hpp"
+
+#include <vector>
+
+struct MultiGpuShard;
+
+// what every other GPU simulates and draws (see MultiGpuSimulation::Init(...))
+// Note: Each GPU has a whole pool of this many particles and an emitter like this one, so the
+// particle count and the emission go up with every GPU that is added.
+struct MultiGpuShardSettings
+{
+    unsigned int _particleCount;
+    ParticleLayout _layout;
+    ParticleEmitter _emitter;
+    float _pointSize;
+    float _brightness;
+    bool _useQuads;
+
+    // the size of the image that each GPU draws, which is stretched over the viewport
+    int _width;
+    int _height;
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Splits the particles across the machine's GPUs.  The display's GPU keeps its own
+    ParticleManager (main()'s), and every other GPU gets a shard: a thread with its own
+    headless context on that GPU (see EglHeadlessWindow::SetDeviceIndex(...)), its own
+    ParticleManager, and its own pool.  Contexts on different GPUs can't share anything, so
+    each shard draws its particles into a half float image, reads it back through a pair of
+    pixel buffers, and the display's thread uploads the newest image from each shard and adds
+    it over its own particles (see Composite()).
+
+    The particles are drawn with additive blending, which doesn't care about order, so adding
+    the shards' images gives the same picture as drawing every particle into one target, and
+    the half float images keep the dim ones from rounding away first.
+
+    Update(...) only hands each shard the frame's steps and view and doesn't wait.  A shard
+    that falls behind runs the steps that piled up all at once, so the simulation time stays
+    the same on every GPU, and the display draws its last image until there is a new one.  A
+    shard's image is 1 or 2 frames behind the display's own particles.
+
+    Note: Each thread has its own program registry and memory ledger (see
+    ShaderProgramRegistry.h and GpuMemoryLedger.h), since the contexts don't share objects.
+    The shards are started one at a time so that they don't write the same shader binary
+    cache files at once.
+    Also Note: Only the additive render mode can be composited this way (depth tested
+    particles would need the shards' depth too).  The shards are set up once from the scene,
+    so later changes to the display's emitters don't reach them, and each shard's emitter
+    gets its own random seed so that the GPUs don't all emit the same particles.
+    Also Also Note: The GPUs are EGL's devices (EGL_EXT_device_enumeration), and the display
+    is taken to be the first of them, so this needs EGL and a driver with GL dispatch by
+    context (ex: libglvnd).  WGL_NV_gpu_affinity and WGL_AMD_gpu_association aren't
+    implemented, so Windows only has the display's GPU.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class MultiGpuSimulation
+{
+public:
+    MultiGpuSimulation();
+    ~MultiGpuSimulation();
+    static unsigned int GetDeviceCount();
+    bool Init(unsigned int compositeProgramId, unsigned int shardCount,
+        const MultiGpuShardSettings &settings);
+    void Cleanup();
+
+    void Update(float stepSec, unsigned int numSteps, const glm::mat4 &viewProjection,
+        bool isCulled);
+    void Composite();
+    unsigned int GetShardCount() const;
+    unsigned long long GetShardParticleCount() const;
+
+private:
+    std::vector<MultiGpuShard *> _shards;
+    MultiGpuShardSettings _settings;
+    unsigned int _compositeProgramId;
+    int _unifLocInverseViewportSize;
+    unsigned int _emptyVaoId;
+};
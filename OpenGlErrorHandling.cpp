@@ -1,67 +1,425 @@
 #include "OpenGlErrorHandling.h"
 
-#include <string>
-#include <stdio.h>
+#include "MpscRing.h"
+#include "Log.h"
+
+#include <set>
+#include <string.h>
+
+// performance messages wait here for the render thread so that they can go to the profiler; 
+// everything else goes straight to the log, which has its own writer thread
+// Note: 256 messages is far more than a frame's worth, even from a chatty driver.  Anything 
+// past that is dropped and counted rather than waited on.
+static const unsigned int DEBUG_RING_SIZE = 256;
+static MpscRing<DebugMessage, DEBUG_RING_SIZE> gDebugPerformanceRing;
+
+// the filter, which is handed to the driver so that filtered messages never reach the 
+// callback at all
+static GLenum gDebugMinimumSeverity = GL_DEBUG_SEVERITY_LOW_ARB;
+static std::set<GLenum> gDisabledDebugTypes;
+static bool gIsDebugOutputInitialized = false;
+
 
 /*-----------------------------------------------------------------------------------------------
 Description:
-    Rather than calling glGetError(...) every time I make an OpenGL call, I register this
-    function as the debug callback.  If an error or any OpenGL message in general pops up, this
-    prints it to stderr.  I can turn it on and off by enabling and disabling the "#define DEBUG" 
-    statement in main(...).
+    Self-explanatory.
 Parameters:
-    Unknown.  The function pointer is provided to glDebugMessageCallbackARB(...), and that
-    function is responsible for calling this one as it sees fit.
-Returns:    None
+    source  Self-explanatory.
+Returns:
+    A name for the debug message source.
 Exception:  Safe
-Creator:    John Cox (2014)
+Creator:    John Cox (8-15-2016)
 -----------------------------------------------------------------------------------------------*/
-void APIENTRY DebugFunc(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
-    const GLchar* message, const GLvoid* userParam)
+static const char *GetDebugSourceName(GLenum source)
 {
-    std::string srcName;
     switch (source)
     {
-    case GL_DEBUG_SOURCE_API_ARB: srcName = "API"; break;
-    case GL_DEBUG_SOURCE_WINDOW_SYSTEM_ARB: srcName = "Window System"; break;
-    case GL_DEBUG_SOURCE_SHADER_COMPILER_ARB: srcName = "Shader Compiler"; break;
-    case GL_DEBUG_SOURCE_THIRD_PARTY_ARB: srcName = "Third Party"; break;
-    case GL_DEBUG_SOURCE_APPLICATION_ARB: srcName = "Application"; break;
-    case GL_DEBUG_SOURCE_OTHER_ARB: srcName = "Other"; break;
+    case GL_DEBUG_SOURCE_API_ARB: return "API";
+    case GL_DEBUG_SOURCE_WINDOW_SYSTEM_ARB: return "Window System";
+    case GL_DEBUG_SOURCE_SHADER_COMPILER_ARB: return "Shader Compiler";
+    case GL_DEBUG_SOURCE_THIRD_PARTY_ARB: return "Third Party";
+    case GL_DEBUG_SOURCE_APPLICATION_ARB: return "Application";
+    case GL_DEBUG_SOURCE_OTHER_ARB: return "Other";
     default:
-        srcName = "UNKNOWN SOURCE";
-        break;
+        return "UNKNOWN SOURCE";
     }
+}
 
-    std::string errorType;
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    type    Self-explanatory.
+Returns:
+    A name for the debug message type.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+static const char *GetDebugTypeName(GLenum type)
+{
     switch (type)
     {
-    case GL_DEBUG_TYPE_ERROR_ARB: errorType = "Error"; break;
-    case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR_ARB: errorType = "Deprecated Functionality"; break;
-    case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR_ARB: errorType = "Undefined Behavior"; break;
-    case GL_DEBUG_TYPE_PORTABILITY_ARB: errorType = "Portability"; break;
-    case GL_DEBUG_TYPE_PERFORMANCE_ARB: errorType = "Performance"; break;
-    case GL_DEBUG_TYPE_OTHER_ARB: errorType = "Other"; break;
+    case GL_DEBUG_TYPE_ERROR_ARB: return "Error";
+    case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR_ARB: return "Deprecated Functionality";
+    case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR_ARB: return "Undefined Behavior";
+    case GL_DEBUG_TYPE_PORTABILITY_ARB: return "Portability";
+    case GL_DEBUG_TYPE_PERFORMANCE_ARB: return "Performance";
+    case GL_DEBUG_TYPE_OTHER_ARB: return "Other";
     default:
-        errorType = "UNKNOWN ERROR TYPE";
-        break;
+        return "UNKNOWN ERROR TYPE";
     }
+}
 
-    std::string typeSeverity;
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    severity    Self-explanatory.
+Returns:
+    A name for the debug message severity.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+static const char *GetDebugSeverityName(GLenum severity)
+{
     switch (severity)
     {
-    case GL_DEBUG_SEVERITY_HIGH_ARB: typeSeverity = "High"; break;
-    case GL_DEBUG_SEVERITY_MEDIUM_ARB: typeSeverity = "Medium"; break;
-    case GL_DEBUG_SEVERITY_LOW_ARB: typeSeverity = "Low"; break;
+    case GL_DEBUG_SEVERITY_HIGH_ARB: return "High";
+    case GL_DEBUG_SEVERITY_MEDIUM_ARB: return "Medium";
+    case GL_DEBUG_SEVERITY_LOW_ARB: return "Low";
+    case GL_DEBUG_SEVERITY_NOTIFICATION: return "Notification";
     default:
-        typeSeverity = "UNKNOWN SEVERITY";
-        break;
-    }
-    
-    fprintf(stderr, "DebugFunc: length = '%d', id = '%u', userParam = '%x'\n", length, id, (unsigned int)userParam);
-    fprintf(stderr, "%s from %s,\t%s priority\nMessage: %s\n",
-        errorType.c_str(), srcName.c_str(), typeSeverity.c_str(), message);
-    fprintf(stderr, "\n");  // separate this error from the next thing that prints
+        return "UNKNOWN SEVERITY";
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Hands the current filter to the driver.  Everything is turned on, then the severities 
+    below the minimum are turned off, then the disabled types are turned off.  Each call to 
+    glDebugMessageControlARB(...) only changes the messages that match it, so the order 
+    matters.
+
+    Note: The ARB extension doesn't know about the "notification" severity that OpenGL 4.3 
+    added, but the driver that makes a 4.4 context does, and some drivers send one for nearly 
+    every buffer allocation.  They are treated as the lowest severity.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+static void ApplyDebugMessageControl()
+{
+    if (!gIsDebugOutputInitialized)
+    {
+        return;
+    }
+
+    glDebugMessageControlARB(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, 0, GL_TRUE);
+
+    // lowest to highest
+    const GLenum severities[] = 
+    {
+        GL_DEBUG_SEVERITY_NOTIFICATION,
+        GL_DEBUG_SEVERITY_LOW_ARB,
+        GL_DEBUG_SEVERITY_MEDIUM_ARB,
+        GL_DEBUG_SEVERITY_HIGH_ARB,
+    };
+    for (unsigned int severityIndex = 0; severityIndex < 4; severityIndex++)
+    {
+        if (severities[severityIndex] == gDebugMinimumSeverity)
+        {
+            break;
+        }
+        glDebugMessageControlARB(GL_DONT_CARE, GL_DONT_CARE, severities[severityIndex], 0, 0, 
+            GL_FALSE);
+    }
+
+    std::set<GLenum>::const_iterator itr = gDisabledDebugTypes.begin();
+    for (; itr != gDisabledDebugTypes.end(); itr++)
+    {
+        glDebugMessageControlARB(GL_DONT_CARE, *itr, GL_DONT_CARE, 0, 0, GL_FALSE);
+    }
+
+    // every debug group push and pop is echoed as a message, which is only noise in the log
+    glDebugMessageControlARB(GL_DONT_CARE, GL_DEBUG_TYPE_PUSH_GROUP, GL_DONT_CARE, 0, 0, 
+        GL_FALSE);
+    glDebugMessageControlARB(GL_DONT_CARE, GL_DEBUG_TYPE_POP_GROUP, GL_DONT_CARE, 0, 0, 
+        GL_FALSE);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Registers DebugFunc(...) as the debug callback, and hands the filter to the driver.  Does 
+    nothing without GL_ARB_debug_output.
+Parameters:
+    isSynchronous       See SetDebugOutputSynchronous(...).
+    minimumSeverity     See SetDebugMinimumSeverity(...).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void InitDebugOutput(bool isSynchronous, GLenum minimumSeverity)
+{
+    if (!glext_ARB_debug_output)
+    {
+        LogPrintf("no GL_ARB_debug_output; debug output is off\n");
+        return;
+    }
+    CleanupDebugOutput();
+
+    gIsDebugOutputInitialized = true;
+    gDebugMinimumSeverity = minimumSeverity;
+    ApplyDebugMessageControl();
+    SetDebugOutputSynchronous(isSynchronous);
+    glDebugMessageCallbackARB(DebugFunc, 0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Unregisters the callback.  Performance messages that nobody took are thrown away.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void CleanupDebugOutput()
+{
+    if (gIsDebugOutputInitialized)
+    {
+        glDebugMessageCallbackARB(0, 0);
+        gIsDebugOutputInitialized = false;
+    }
+
+    DebugMessage message;
+    while (gDebugPerformanceRing.TryPop(&message))
+    {
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Asynchronous output lets the driver report messages whenever, and from whichever thread, 
+    it likes, so it doesn't slow down the GL calls.  Synchronous output reports each message 
+    inside the GL call that caused it, so a breakpoint in DebugFunc(...) shows the offending 
+    call, but every GL call pays for it.
+Parameters:
+    isSynchronous   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void SetDebugOutputSynchronous(bool isSynchronous)
+{
+    if (!gIsDebugOutputInitialized)
+    {
+        return;
+    }
+
+    if (isSynchronous)
+    {
+        glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS_ARB);
+    }
+    else
+    {
+        glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS_ARB);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Filters out every message below the given severity.  The driver does the filtering, so the
+    filtered messages cost nothing.
+Parameters:
+    minimumSeverity     GL_DEBUG_SEVERITY_NOTIFICATION, GL_DEBUG_SEVERITY_LOW_ARB, 
+                        GL_DEBUG_SEVERITY_MEDIUM_ARB, or GL_DEBUG_SEVERITY_HIGH_ARB.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void SetDebugMinimumSeverity(GLenum minimumSeverity)
+{
+    gDebugMinimumSeverity = minimumSeverity;
+    ApplyDebugMessageControl();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Turns one type of message (GL_DEBUG_TYPE_PORTABILITY_ARB, etc.) on or off, whatever its 
+    severity.
+Parameters:
+    type        Self-explanatory.
+    isEnabled   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void SetDebugMessageTypeEnabled(GLenum type, bool isEnabled)
+{
+    if (isEnabled)
+    {
+        gDisabledDebugTypes.erase(type);
+    }
+    else
+    {
+        gDisabledDebugTypes.insert(type);
+    }
+    ApplyDebugMessageControl();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The lowest severity that isn't filtered out.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+GLenum GetDebugMinimumSeverity()
+{
+    return gDebugMinimumSeverity;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes every performance message that has come in since the last call.  Only call this from
+    one thread (the render thread, once per frame).  With no messages waiting, this is a 
+    couple of atomic loads.
+Parameters:
+    putMessagesHere     The messages are added to the end.
+Returns:
+    How many messages were taken.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int TakeDebugPerformanceMessages(std::vector<DebugMessage> *putMessagesHere)
+{
+    unsigned int messageCount = 0;
+    DebugMessage message;
+    while (gDebugPerformanceRing.TryPop(&message))
+    {
+        putMessagesHere->push_back(message);
+        messageCount++;
+    }
+    return messageCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How many performance messages were dropped because the ring was full.  Other messages 
+    that were dropped are counted by the log (see GetDroppedLogLineCount()).
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int GetDroppedDebugMessageCount()
+{
+    return gDebugPerformanceRing.GetDroppedItemCount();
+}
+
+#ifdef GL_DEBUG_MARKERS_ENABLED
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Starts a named group of GL commands, which frame capture tools show as a node with the 
+    commands under it, and which they time as a unit.  Groups nest.  Prefer GlDebugGroup, 
+    which pops the group at the end of the scope.
+Parameters:
+    name    Self-explanatory.  Copied by the driver.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void PushGlDebugGroup(const char *name)
+{
+    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Ends the group that the last PushGlDebugGroup(...) started.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void PopGlDebugGroup()
+{
+    glPopDebugGroup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Names a GL object in frame capture tools and in debug messages.
+
+    Note: A name from glGen*(...) isn't an object until it is first bound, so label it after 
+    that.
+Parameters:
+    identifier  GL_BUFFER, GL_PROGRAM, GL_TEXTURE, and so on.
+    objectId    Self-explanatory.  0 is ignored.
+    label       Self-explanatory.  Copied by the driver.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void LabelGlObject(GLenum identifier, GLuint objectId, const char *label)
+{
+    if (objectId != 0)
+    {
+        glObjectLabel(identifier, objectId, -1, label);
+    }
+}
+#endif
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Rather than calling glGetError(...) every time I make an OpenGL call, I register this
+    function as the debug callback (see InitDebugOutput(...)).  It used to format and print the
+    message right here, but the driver calls it inside of GL calls (or on its own threads), so 
+    now it only copies the message into a lock-free queue.  Performance messages go to their 
+    own queue for the profiler, and everything else is formatted into the log's queue (see 
+    LogErrorPrintf(...)).  Nothing here blocks or allocates.
+Parameters:
+    Unknown.  The function pointer is provided to glDebugMessageCallbackARB(...), and that
+    function is responsible for calling this one as it sees fit.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (2014)
+-----------------------------------------------------------------------------------------------*/
+void APIENTRY DebugFunc(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+    const GLchar* message, const GLvoid* userParam)
+{
+    DebugMessage copied;
+    copied._source = source;
+    copied._type = type;
+    copied._severity = severity;
+    copied._id = id;
+
+    // the length doesn't include the null terminator, and some drivers give a negative length
+    // for a null terminated message
+    size_t textLength = (length < 0) ? strlen(message) : (size_t)length;
+    if (textLength > DEBUG_MESSAGE_MAX_LENGTH - 1)
+    {
+        textLength = DEBUG_MESSAGE_MAX_LENGTH - 1;
+    }
+    memcpy(copied._text, message, textLength);
+    copied._text[textLength] = 0;
+
+    if (type == GL_DEBUG_TYPE_PERFORMANCE_ARB)
+    {
+        gDebugPerformanceRing.TryPush(copied);
+    }
+    else
+    {
+        LogErrorPrintf("%s from %s,\t%s priority (id %u)\nMessage: %s\n\n",
+            GetDebugTypeName(type), GetDebugSourceName(source), 
+            GetDebugSeverityName(severity), id, copied._text);
+    }
+
+    // not used; this is mostly to get rid of an "unreferenced parameter" warning
+    (void)userParam;
 }
 
 //
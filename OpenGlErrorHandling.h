@@ -2,5 +2,68 @@
 
 #include "glload/include/glload/gl_4_4.h"
 
+#include <vector>
+
+// one GL debug message, copied out of the debug callback
+// Note: The text is cut off at a fixed length so that the callback never allocates.
+static const unsigned int DEBUG_MESSAGE_MAX_LENGTH = 256;
+struct DebugMessage
+{
+    GLenum _source;
+    GLenum _type;
+    GLenum _severity;
+    GLuint _id;
+    char _text[DEBUG_MESSAGE_MAX_LENGTH];
+};
+
+// debug output (see OpenGlErrorHandling.cpp)
+// Note: InitDebugOutput(...) needs a context made with GLUT_DEBUG.  By default the driver 
+// calls DebugFunc(...) whenever it likes, from whichever thread it likes, and DebugFunc(...) 
+// only copies the message into a queue.  Most go to the log (see Log.h), but performance 
+// messages wait for TakeDebugPerformanceMessages(...) so that they can go to the profiler.  Synchronous output calls DebugFunc(...) inside the GL call that caused the 
+// message, which is slower but puts the message on the offending call's stack.
+void InitDebugOutput(bool isSynchronous, GLenum minimumSeverity = GL_DEBUG_SEVERITY_LOW_ARB);
+void CleanupDebugOutput();
+void SetDebugOutputSynchronous(bool isSynchronous);
+void SetDebugMinimumSeverity(GLenum minimumSeverity);
+void SetDebugMessageTypeEnabled(GLenum type, bool isEnabled);
+GLenum GetDebugMinimumSeverity();
+unsigned int TakeDebugPerformanceMessages(std::vector<DebugMessage> *putMessagesHere);
+unsigned int GetDroppedDebugMessageCount();
+
+// debug groups and object labels, so that frame capture tools (RenderDoc, Nsight, RGP) show 
+// the passes and the objects by name instead of as anonymous dispatches and draws
+// Note: Only in debug builds, or in a release build with GL_DEBUG_MARKERS defined so that it 
+// can be profiled with them.  Otherwise these are empty and compile to nothing.
+#if defined(_DEBUG) || defined(GL_DEBUG_MARKERS)
+#define GL_DEBUG_MARKERS_ENABLED
+void PushGlDebugGroup(const char *name);
+void PopGlDebugGroup();
+void LabelGlObject(GLenum identifier, GLuint objectId, const char *label);
+#else
+inline void PushGlDebugGroup(const char *) {}
+inline void PopGlDebugGroup() {}
+inline void LabelGlObject(GLenum, GLuint, const char *) {}
+#endif
+
+// pushes a debug group for the rest of the scope, so that early returns still pop it
+class GlDebugGroup
+{
+public:
+    explicit GlDebugGroup(const char *name)
+    {
+        PushGlDebugGroup(name);
+    }
+
+    ~GlDebugGroup()
+    {
+        PopGlDebugGroup();
+    }
+
+private:
+    GlDebugGroup(const GlDebugGroup &);
+    GlDebugGroup &operator=(const GlDebugGroup &);
+};
+
 void APIENTRY DebugFunc(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
-    const GLchar* message, const GLvoid* userParam);
\ No newline at end of file
+    const GLchar* message, const GLvoid* userParam);
@@ -0,0 +1,297 @@
+#include "OverdrawVisualizer.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
+#include "ShaderProgramRegistry.h"
+#include "GpuMemoryLedger.h"
+#include "OpenGlErrorHandling.h"
+#include "Log.h"
+
+// must match the binding of uOverdrawCount in shaderOverdrawHeat.frag
+static const unsigned int OVERDRAW_COUNT_TEXTURE_UNIT = 0;
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+OverdrawVisualizer::OverdrawVisualizer() :
+    _heatProgramId(0),
+    _unifLocMaxOverdraw(0),
+    _maxOverdraw(32.0f),
+    _emptyVaoId(0),
+    _framebufferId(0),
+    _countTextureId(0),
+    _width(0),
+    _height(0),
+    _previousFramebufferId(0),
+    _wasBlendEnabled(false),
+    _wasDepthTestEnabled(false),
+    _isActive(false)
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+OverdrawVisualizer::~OverdrawVisualizer()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes a reference to the heat map program (see ShaderProgramRegistry.h).  The target isn't
+    made until the first Begin(), when the viewport's size is known.  The caller may release
+    their own reference after this returns.
+Parameters:
+    heatProgramId   shaderDensityResolve.vert (the fullscreen triangle) with
+                    shaderOverdrawHeat.frag.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void OverdrawVisualizer::Init(unsigned int heatProgramId)
+{
+    this->Cleanup();
+    if (heatProgramId == 0)
+    {
+        LogPrintf("the overdraw visualizer needs its heat map program\n");
+        return;
+    }
+
+    _heatProgramId = heatProgramId;
+    AddProgramReference(_heatProgramId);
+    _unifLocMaxOverdraw = glGetUniformLocation(_heatProgramId, "uMaxOverdraw");
+    glGenVertexArrays(1, &_emptyVaoId);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Releases the program and deletes the target and the VAO.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void OverdrawVisualizer::Cleanup()
+{
+    this->DeleteTarget();
+    if (_emptyVaoId != 0)
+    {
+        DeleteGlVertexArrays(1, &_emptyVaoId);
+        _emptyVaoId = 0;
+    }
+    ReleaseProgram(_heatProgramId);
+    _heatProgramId = 0;
+    _isActive = false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Switches to a rebuilt program (see ShaderProgramRegistry.h).
+Parameters:
+    oldProgramId    Self-explanatory.  Programs that this visualizer doesn't use are ignored.
+    newProgramId    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void OverdrawVisualizer::ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId)
+{
+    if (oldProgramId == 0 || newProgramId == 0 || _heatProgramId != oldProgramId)
+    {
+        return;
+    }
+
+    AddProgramReference(newProgramId);
+    ReleaseProgram(_heatProgramId);
+    _heatProgramId = newProgramId;
+    _unifLocMaxOverdraw = glGetUniformLocation(_heatProgramId, "uMaxOverdraw");
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets the overdraw that the heat map shows as white.  Anything more is white too.
+Parameters:
+    maxOverdraw     Self-explanatory.  Clamped to at least 2, since 1 is blue.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void OverdrawVisualizer::SetMaxOverdraw(float maxOverdraw)
+{
+    _maxOverdraw = (maxOverdraw < 2.0f) ? 2.0f : maxOverdraw;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Redirects the draw into the count target, clears it to 0, and has every fragment add to
+    it (1, 1).  The depth test is turned off, since every fragment counts, and End() puts it
+    and the blending back the way they were.
+
+    The target is (re)created first if the viewport's size has changed since the last frame.
+Parameters: None
+Returns:
+    False if there is no heat map program or the target couldn't be made, in which case
+    nothing was changed and the draw goes to the frame as it would without this.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool OverdrawVisualizer::Begin()
+{
+    if (_heatProgramId == 0 || _isActive)
+    {
+        return false;
+    }
+
+    GLint viewport[4] = { 0, 0, 0, 0 };
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    if (viewport[2] != _width || viewport[3] != _height || _framebufferId == 0)
+    {
+        this->InitTarget(viewport[2], viewport[3]);
+    }
+    if (_framebufferId == 0)
+    {
+        return false;
+    }
+
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &_previousFramebufferId);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _framebufferId);
+    glViewport(0, 0, _width, _height);
+    _isActive = true;
+
+    float zeros[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    glClearBufferfv(GL_COLOR, 0, zeros);
+
+    _wasBlendEnabled = IsGlCapabilityEnabled(GL_BLEND);
+    _wasDepthTestEnabled = IsGlCapabilityEnabled(GL_DEPTH_TEST);
+    EnableGlCapability(GL_BLEND);
+    DisableGlCapability(GL_DEPTH_TEST);
+    glBlendEquation(GL_FUNC_ADD);
+    SetGlBlendFunc(GL_ONE, GL_ONE);
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Puts back the framebuffer and the viewport that Begin() found and draws the heat map over
+    them.  Does nothing if Begin() didn't redirect the draw.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void OverdrawVisualizer::End()
+{
+    if (!_isActive)
+    {
+        return;
+    }
+    _isActive = false;
+    GlDebugGroup heatGroup("overdraw heat map");
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, (GLuint)_previousFramebufferId);
+    glViewport(0, 0, _width, _height);
+
+    // the heat map replaces whatever it covers
+    DisableGlCapability(GL_BLEND);
+    UseGlProgram(_heatProgramId);
+    glUniform1f(_unifLocMaxOverdraw, _maxOverdraw);
+    glActiveTexture(GL_TEXTURE0 + OVERDRAW_COUNT_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, _countTextureId);
+    BindGlVertexArray(_emptyVaoId);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    BindGlVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    UseGlProgram(0);
+
+    if (_wasBlendEnabled)
+    {
+        EnableGlCapability(GL_BLEND);
+    }
+    if (_wasDepthTestEnabled)
+    {
+        EnableGlCapability(GL_DEPTH_TEST);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    (Re)creates the count target and its framebuffer at the given size.  It isn't filtered,
+    since the heat map reads it a texel per pixel.
+Parameters:
+    width   Self-explanatory.
+    height  Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void OverdrawVisualizer::InitTarget(int width, int height)
+{
+    this->DeleteTarget();
+
+    // a minimized window reports 0x0
+    _width = width;
+    _height = height;
+    if (_width <= 0 || _height <= 0)
+    {
+        return;
+    }
+
+    glGenTextures(1, &_countTextureId);
+    glBindTexture(GL_TEXTURE_2D, _countTextureId);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32F, _width, _height);
+    RecordGpuAllocation(GPU_MEMORY_TEXTURE, _countTextureId,
+        GetGlTextureSizeBytes(GL_R32F, _width, _height), "overdraw");
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &_framebufferId);
+    glBindFramebuffer(GL_FRAMEBUFFER, _framebufferId);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+        _countTextureId, 0);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        LogPrintf("overdraw: framebuffer incomplete (0x%x); drawing without it\n", status);
+        this->DeleteTarget();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.  The next Begin() makes them again.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void OverdrawVisualizer::DeleteTarget()
+{
+    if (_framebufferId != 0)
+    {
+        glDeleteFramebuffers(1, &_framebufferId);
+        _framebufferId = 0;
+    }
+    if (_countTextureId != 0)
+    {
+        ForgetGpuAllocation(GPU_MEMORY_TEXTURE, _countTextureId);
+        glDeleteTextures(1, &_countTextureId);
+        _countTextureId = 0;
+    }
+    _width = 0;
+    _height = 0;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Shows where the particles are drawn over each other, and how many times, as a heat map in
+    place of the particles.  The pipeline statistics (see
+    GpuProfiler::EnablePipelineStatistics(...)) say how many fragments a draw cost on average;
+    this says where they went.
+
+    Between Begin() and End(), the particles are drawn with a render program built with
+    shaderParticleOverdraw.frag, which writes 1 for every fragment, into an offscreen R32F
+    target that adds them up.  Every fragment is counted, including those that the usual
+    fragment shaders would discard, since they cost the same.  End() then colors each pixel
+    by its count on a log scale (see shaderOverdrawHeat.frag), from blue for 1 through green
+    and yellow to white at the maximum (see SetMaxOverdraw(...)), and leaves the pixels that
+    nothing landed on alone.
+
+    Note: The counts are floats instead of integers because blending doesn't apply to integer
+    targets.  Adding 1s is exact up to 2^24, which is far more overdraw than any pixel gets.
+
+    The target is made the size of the viewport that Begin() finds, like the weighted OIT
+    renderer's (see WeightedOitRenderer.h), and is only re-created when that size changes.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class OverdrawVisualizer
+{
+public:
+    OverdrawVisualizer();
+    ~OverdrawVisualizer();
+    void Init(unsigned int heatProgramId);
+    void Cleanup();
+    void ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId);
+
+    void SetMaxOverdraw(float maxOverdraw);
+    bool Begin();
+    void End();
+
+private:
+    void InitTarget(int width, int height);
+    void DeleteTarget();
+
+    unsigned int _heatProgramId;
+    unsigned int _unifLocMaxOverdraw;
+    float _maxOverdraw;
+
+    // the fullscreen triangle has no vertex attributes, but the core profile still needs a VAO
+    // bound to draw
+    unsigned int _emptyVaoId;
+
+    unsigned int _framebufferId;
+    unsigned int _countTextureId;
+    int _width;
+    int _height;
+
+    // what Begin() found, for End() to put back
+    int _previousFramebufferId;
+    bool _wasBlendEnabled;
+    bool _wasDepthTestEnabled;
+
+    // true between a Begin() that redirected the draw and its End()
+    bool _isActive;
+};
@@ -1,27 +1,219 @@
 #pragma once
 
-#include "glm/vec4.hpp"
+#include "glm/vec2.hpp"
+#include "ParticleLayoutDescriptor.h"
+
+#include <cstddef>  // offsetof
 
 /*-----------------------------------------------------------------------------------------------
 Description:
     This is a simple structure that says where a particle is, where it is going, and whether it
     has gone out of bounds ("is active" flag).  That flag also serves to prevent all particles
     from going out all at once upon creation by letting the "particle updater" regulate how many
-    are emitted every frame.
+    are emitted every frame.  A particle whose emitter has a lifetime also expires when its age
+    reaches 1 (see ParticleEmitter::_lifetimeSec).
 Creator:    John Cox (7-2-2016)
 -----------------------------------------------------------------------------------------------*/
 struct Particle
 {
-    // even though this is a 2D program, I wasn't able to figure out the byte misalignments 
-    // between C++ and GLSL (every variable is aligned on a 16byte boundry, but adding 2-float 
-    // padding to glm::vec2 didn't work and the compute shader just didn't send any particles 
-    // anywhere), so I just used glm::vec4 
-    // Note: Yes, I did take care of the byte offset in the vertex attrib pointer.
-    glm::vec4 _position;
-    glm::vec4 _velocity;
+    // the GLSL "Particle" structure is generated from PARTICLE_FIELDS below, and this must 
+    // match it under std430 layout rules
+    // Note: The original version used glm::vec4 for both of these because vec2 padding 
+    // "didn't work".  That was because the shader buffer was declared without a layout 
+    // qualifier, so it got std140 rules, which round the array stride of a structure up to 
+    // 16 bytes.  Under std430, a vec2 is aligned on an 8-byte boundary, the int follows 
+    // immediately after, and the structure itself is aligned to its largest member (8 bytes), 
+    // so a single int of padding at the end makes it 24 bytes on both sides.  The 
+    // static_asserts below work the offsets out from the field list and check them.  The age 
+    // now lives in what was that padding.
+    glm::vec2 _position;
+    glm::vec2 _velocity;
 
     // Note: Booleans cannot be uploaded to the shader 
     // (https://www.opengl.org/sdk/docs/man/html/glVertexAttribPointer.xhtml), so send the 
-    // "is active" flag as an integer.  It is understood 
-    int _isActive; float iBuffer[3];
+    // "is active" flag as an integer.
+    int _isActive;
+
+    // how much of its emitter's lifetime the particle has lived, from 0 when it is emitted to 
+    // 1 when it expires; stays 0 if the emitter has no lifetime
+    float _age;
+};
+
+// the GPU-side form of "Particle", from which the GLSL structure is generated (see 
+// GetGlslMembersDefine(...))
+// Note: The age has no vertex attribute because the vertex shader doesn't use it.
+static constexpr ParticleFieldDescriptor PARTICLE_FIELDS[] =
+{
+    { "_position", PARTICLE_FIELD_VEC2, 0 },
+    { "_velocity", PARTICLE_FIELD_VEC2, 1 },
+    { "_isActive", PARTICLE_FIELD_INT, 2 },
+    { "_age", PARTICLE_FIELD_FLOAT, -1 },
+};
+
+static constexpr ParticleLayoutDescriptor PARTICLE_INTERLEAVED_LAYOUT =
+{
+    "PARTICLE_MEMBERS", PARTICLE_FIELDS, sizeof(PARTICLE_FIELDS) / sizeof(PARTICLE_FIELDS[0]), 
+    false
+};
+
+// std430 offsets of the GLSL structure, member by member
+static_assert(offsetof(Particle, _position) == Std430FieldOffset(PARTICLE_INTERLEAVED_LAYOUT, 0), 
+    "Particle::_position must be at its std430 offset");
+static_assert(offsetof(Particle, _velocity) == Std430FieldOffset(PARTICLE_INTERLEAVED_LAYOUT, 1), 
+    "Particle::_velocity must be at its std430 offset");
+static_assert(offsetof(Particle, _isActive) == Std430FieldOffset(PARTICLE_INTERLEAVED_LAYOUT, 2), 
+    "Particle::_isActive must be at its std430 offset");
+static_assert(offsetof(Particle, _age) == Std430FieldOffset(PARTICLE_INTERLEAVED_LAYOUT, 3), 
+    "Particle::_age must be at its std430 offset");
+static_assert(sizeof(Particle) == Std430StructStride(PARTICLE_INTERLEAVED_LAYOUT), 
+    "Particle must match the std430 array stride");
+static_assert(sizeof(Particle) == 24, "Particle is expected to be 24 bytes");
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The GPU-side form of a particle in the half-precision layout.  Position and velocity are 
+    each two 16-bit floats packed into a single 32-bit unsigned integer (GLSL's 
+    packHalf2x16(...) and glm::packHalf2x16(...) agree on the bit layout: X in the low 16 bits, 
+    Y in the high 16 bits).  That is 12 bytes per particle instead of 24.
+
+    The age is in the high 16 bits of the "is active" flag, as a 16-bit fraction (see 
+    PackParticleFlags(...) in shaderParticle.comp), and the flag is in bit 0.
+
+    Window space is [-1,+1], where a half float has 10 bits of mantissa, so close to the edge of
+    the window a position is only precise to about 1/2048.  Per-frame movement of less than half
+    of that rounds away, so keep (minimum velocity * delta time) above ~0.0003 when using this 
+    layout or slow particles will stall.
+Creator:    John Cox (8-5-2016)
+-----------------------------------------------------------------------------------------------*/
+struct PackedHalfParticle
+{
+    unsigned int _position;
+    unsigned int _velocity;
+    int _isActive;
+};
+
+static constexpr ParticleFieldDescriptor PACKED_HALF_PARTICLE_FIELDS[] =
+{
+    { "_position", PARTICLE_FIELD_HALF2, 0 },
+    { "_velocity", PARTICLE_FIELD_HALF2, 1 },
+    { "_isActive", PARTICLE_FIELD_INT, 2 },
+};
+
+static constexpr ParticleLayoutDescriptor PARTICLE_HALF_FLOAT_LAYOUT =
+{
+    "PACKED_HALF_PARTICLE_MEMBERS", PACKED_HALF_PARTICLE_FIELDS, 
+    sizeof(PACKED_HALF_PARTICLE_FIELDS) / sizeof(PACKED_HALF_PARTICLE_FIELDS[0]), false
 };
+
+static_assert(offsetof(PackedHalfParticle, _position) == 
+    Std430FieldOffset(PARTICLE_HALF_FLOAT_LAYOUT, 0), 
+    "PackedHalfParticle::_position must be at its std430 offset");
+static_assert(offsetof(PackedHalfParticle, _velocity) == 
+    Std430FieldOffset(PARTICLE_HALF_FLOAT_LAYOUT, 1), 
+    "PackedHalfParticle::_velocity must be at its std430 offset");
+static_assert(offsetof(PackedHalfParticle, _isActive) == 
+    Std430FieldOffset(PARTICLE_HALF_FLOAT_LAYOUT, 2), 
+    "PackedHalfParticle::_isActive must be at its std430 offset");
+static_assert(sizeof(PackedHalfParticle) == Std430StructStride(PARTICLE_HALF_FLOAT_LAYOUT), 
+    "PackedHalfParticle must match the std430 array stride");
+
+// the structure of arrays layout: tightly packed positions, velocities, and flags, in that 
+// order, each in its own buffer
+// Note: The flags are the "is active" flag in bit 0 and the age in the high 16 bits (see 
+// PackParticleFlags(...) in shaderParticle.comp).
+static constexpr ParticleFieldDescriptor PARTICLE_SOA_FIELDS[] =
+{
+    { "_position", PARTICLE_FIELD_VEC2, 0 },
+    { "_velocity", PARTICLE_FIELD_VEC2, 1 },
+    { "_flags", PARTICLE_FIELD_INT, 2 },
+};
+
+static constexpr ParticleLayoutDescriptor PARTICLE_SOA_LAYOUT =
+{
+    0, PARTICLE_SOA_FIELDS, sizeof(PARTICLE_SOA_FIELDS) / sizeof(PARTICLE_SOA_FIELDS[0]), true
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The GPU-side form of a particle in the fixed-point layout, which is 8 bytes, a third of 
+    the interleaved layout and two thirds of the half float one.
+
+    The position is two signed 16-bit integers in 1.15 fixed point (X in the low 16 bits, Y in 
+    the high 16 bits), so it covers [-1,+1) in even steps of 1/32768, which is finer than a 
+    half float everywhere past 1/16 from the center.  The other word is the "is active" flag 
+    in bit 0, the age in bits 1-9 as a fraction of 511, and the velocity's X and Y in bits 
+    10-20 and 21-31 as signed 11-bit integers of 1/256ths of the window per second, so the 
+    velocity is limited to about 4 windows per second on each axis.  An inactive particle is 
+    stored with that word 0.
+
+    The compute shader moves the particle in integer steps of the position grid (see 
+    StepPosition(...) in shaderParticle.comp), so the move rounds the same way on every GPU, 
+    and a slow particle still moves, where a half float position would round its steps away.  
+    The forces are still float math.  Velocity and age changes that are smaller than a step 
+    of their own grids aren't lost either: they are rounded up or down at random, in 
+    proportion, when they are stored, so they are right on average.
+
+    Note: There is no vertex fetch format for these, so the render programs must pull the 
+    particles (see ParticleManager::GetRenderShaderDefines(...)).
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+struct PackedFixedParticle
+{
+    unsigned int _position;
+    unsigned int _motion;
+};
+
+static constexpr ParticleFieldDescriptor PACKED_FIXED_PARTICLE_FIELDS[] =
+{
+    { "_position", PARTICLE_FIELD_UINT, -1 },
+    { "_motion", PARTICLE_FIELD_UINT, -1 },
+};
+
+static constexpr ParticleLayoutDescriptor PARTICLE_FIXED_POINT_LAYOUT =
+{
+    "PACKED_FIXED_PARTICLE_MEMBERS", PACKED_FIXED_PARTICLE_FIELDS, 
+    sizeof(PACKED_FIXED_PARTICLE_FIELDS) / sizeof(PACKED_FIXED_PARTICLE_FIELDS[0]), false
+};
+
+static_assert(offsetof(PackedFixedParticle, _position) == 
+    Std430FieldOffset(PARTICLE_FIXED_POINT_LAYOUT, 0), 
+    "PackedFixedParticle::_position must be at its std430 offset");
+static_assert(offsetof(PackedFixedParticle, _motion) == 
+    Std430FieldOffset(PARTICLE_FIXED_POINT_LAYOUT, 1), 
+    "PackedFixedParticle::_motion must be at its std430 offset");
+static_assert(sizeof(PackedFixedParticle) == Std430StructStride(PARTICLE_FIXED_POINT_LAYOUT), 
+    "PackedFixedParticle must match the std430 array stride");
+static_assert(sizeof(PackedFixedParticle) == 8, "PackedFixedParticle is expected to be 8 bytes");
+
+// the CPU's conversions to and from the fixed-point layout, for uploads and readbacks
+// Note: These round to the nearest step instead of at random like the compute shader.
+PackedFixedParticle PackFixedParticle(const Particle &p);
+Particle UnpackFixedParticle(const PackedFixedParticle &packed);
+
+static_assert(Std430BufferStride(PARTICLE_SOA_LAYOUT, 0) == sizeof(glm::vec2) &&
+    Std430BufferStride(PARTICLE_SOA_LAYOUT, 1) == sizeof(glm::vec2) &&
+    Std430BufferStride(PARTICLE_SOA_LAYOUT, 2) == sizeof(int), 
+    "The structure of arrays layout must match std::vector<glm::vec2> and std::vector<int>");
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    How the particles are stored on the GPU.  The "Particle" structure above is always used on 
+    the CPU side to generate the initial particle data, but it can be uploaded as is 
+    (interleaved) or split into separate, tightly packed arrays of 2D position, 2D velocity, and 
+    flags (structure of arrays).  The structure of arrays layout is 20 bytes per particle 
+    instead of 24, and each shader stage only pulls in the arrays that it reads.  The half 
+    float layout is interleaved, but with 16-bit position and velocity (see 
+    PackedHalfParticle), for 12 bytes per particle.  The fixed-point layout is interleaved 
+    with integer position and velocity (see PackedFixedParticle), for 8 bytes per particle.
+Creator:    John Cox (8-3-2016)
+-----------------------------------------------------------------------------------------------*/
+enum ParticleLayout
+{
+    PARTICLE_LAYOUT_INTERLEAVED = 0,
+    PARTICLE_LAYOUT_SOA,
+    PARTICLE_LAYOUT_HALF_FLOAT,
+    PARTICLE_LAYOUT_FIXED_POINT,
+};
+
+// the descriptor of each layout (see ParticleLayoutDescriptor.h)
+const ParticleLayoutDescriptor &GetParticleLayoutDescriptor(ParticleLayout layout);
@@ -0,0 +1,243 @@
+#include "ParticleArena.h"
+#include "Log.h"
+
+#include <stdio.h>
+
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.  The arena is empty until Init(...).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleArena::ParticleArena() :
+    _capacity(0)
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Forgets every allocation and makes the whole pool one free range.
+Parameters:
+    capacity    The number of particles in the pool.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleArena::Init(unsigned int capacity)
+{
+    _capacity = capacity;
+    _allocations.clear();
+    _freeBlocks.clear();
+    if (capacity > 0)
+    {
+        ParticleArenaBlock wholePool = { 0, capacity };
+        _freeBlocks.push_back(wholePool);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes a range out of the first free range that is big enough.
+Parameters:
+    count           Must be at least 1.
+    putFirstHere    Where the range starts.  Only written on success.
+Returns:
+    True if there was a free range big enough, otherwise false.  See Compact() for when there 
+    is enough free space but it is in pieces.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleArena::Allocate(unsigned int count, unsigned int *putFirstHere)
+{
+    if (count == 0)
+    {
+        return false;
+    }
+
+    for (size_t blockIndex = 0; blockIndex < _freeBlocks.size(); blockIndex++)
+    {
+        ParticleArenaBlock &block = _freeBlocks[blockIndex];
+        if (block._count < count)
+        {
+            continue;
+        }
+
+        unsigned int first = block._first;
+        block._first += count;
+        block._count -= count;
+        if (block._count == 0)
+        {
+            _freeBlocks.erase(_freeBlocks.begin() + blockIndex);
+        }
+        _allocations[first] = count;
+        *putFirstHere = first;
+        return true;
+    }
+    return false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives a range back and merges it with any free range that it touches.
+Parameters:
+    first   Where the range starts, as Allocate(...) or Compact() gave it.
+Returns:
+    True if there was such an allocation, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleArena::Free(unsigned int first)
+{
+    std::map<unsigned int, unsigned int>::iterator allocation = _allocations.find(first);
+    if (allocation == _allocations.end())
+    {
+        LogPrintf("particle arena has no allocation at %u\n", first);
+        return false;
+    }
+    ParticleArenaBlock freed = { first, allocation->second };
+    _allocations.erase(allocation);
+
+    // the first free range that starts after the freed one
+    size_t nextIndex = 0;
+    while (nextIndex < _freeBlocks.size() && _freeBlocks[nextIndex]._first < freed._first)
+    {
+        nextIndex++;
+    }
+
+    bool touchesPrevious = nextIndex > 0 && 
+        (_freeBlocks[nextIndex - 1]._first + _freeBlocks[nextIndex - 1]._count) == freed._first;
+    bool touchesNext = nextIndex < _freeBlocks.size() && 
+        (freed._first + freed._count) == _freeBlocks[nextIndex]._first;
+    if (touchesPrevious && touchesNext)
+    {
+        _freeBlocks[nextIndex - 1]._count += freed._count + _freeBlocks[nextIndex]._count;
+        _freeBlocks.erase(_freeBlocks.begin() + nextIndex);
+    }
+    else if (touchesPrevious)
+    {
+        _freeBlocks[nextIndex - 1]._count += freed._count;
+    }
+    else if (touchesNext)
+    {
+        _freeBlocks[nextIndex]._first = freed._first;
+        _freeBlocks[nextIndex]._count += freed._count;
+    }
+    else
+    {
+        _freeBlocks.insert(_freeBlocks.begin() + nextIndex, freed);
+    }
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Slides every allocation toward the start of the pool, in order, so that they are packed 
+    together and all the free space is a single range at the end.  Allocations only ever move 
+    down, so the moves can be done in the order given, each one a chunked copy within the same 
+    buffer (see ParticleManager::MoveParticleRange(...)).
+Parameters: None
+Returns:
+    The allocations that moved, in the order that they must be copied.  Allocations that were 
+    already in place are left out.  Each allocation is known by its new first particle from 
+    now on.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+std::vector<ParticleArenaMove> ParticleArena::Compact()
+{
+    std::vector<ParticleArenaMove> moves;
+    std::map<unsigned int, unsigned int> packedAllocations;
+    unsigned int nextFirst = 0;
+    std::map<unsigned int, unsigned int>::const_iterator allocation = _allocations.begin();
+    for (; allocation != _allocations.end(); allocation++)
+    {
+        if (allocation->first != nextFirst)
+        {
+            ParticleArenaMove move = { allocation->first, nextFirst, allocation->second };
+            moves.push_back(move);
+        }
+        packedAllocations[nextFirst] = allocation->second;
+        nextFirst += allocation->second;
+    }
+
+    _allocations.swap(packedAllocations);
+    _freeBlocks.clear();
+    if (nextFirst < _capacity)
+    {
+        ParticleArenaBlock tail = { nextFirst, _capacity - nextFirst };
+        _freeBlocks.push_back(tail);
+    }
+    return moves;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The number of particles in the pool.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleArena::GetCapacity() const
+{
+    return _capacity;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The number of particles that aren't allocated, whether or not they are in one piece.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleArena::GetFreeCount() const
+{
+    unsigned int freeCount = 0;
+    for (size_t blockIndex = 0; blockIndex < _freeBlocks.size(); blockIndex++)
+    {
+        freeCount += _freeBlocks[blockIndex]._count;
+    }
+    return freeCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The size of the largest allocation that would succeed without compacting.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleArena::GetLargestFreeBlock() const
+{
+    unsigned int largest = 0;
+    for (size_t blockIndex = 0; blockIndex < _freeBlocks.size(); blockIndex++)
+    {
+        if (_freeBlocks[blockIndex]._count > largest)
+        {
+            largest = _freeBlocks[blockIndex]._count;
+        }
+    }
+    return largest;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The free ranges, sorted by where they start, with no two touching.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+const std::vector<ParticleArenaBlock> &ParticleArena::GetFreeBlocks() const
+{
+    return _freeBlocks;
+}
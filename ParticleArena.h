@@ -0,0 +1,58 @@
+#pragma once
+
+#include <map>
+#include <vector>
+
+// a range of the particle pool
+struct ParticleArenaBlock
+{
+    unsigned int _first;
+    unsigned int _count;
+};
+
+// a range that ParticleArena::Compact() moved; the caller copies the particles to match
+struct ParticleArenaMove
+{
+    unsigned int _sourceFirst;
+    unsigned int _destinationFirst;
+    unsigned int _count;
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Hands out ranges of a particle pool of fixed size.  This only does the bookkeeping on the 
+    CPU.  The pool itself is the particle manager's buffers, which are created once at the full
+    capacity, so creating and destroying short-lived particle systems never creates or 
+    deletes a buffer (see ParticleWorld).
+
+    The free ranges are kept in a list sorted by where they start, and a freed range is merged 
+    with the free ranges on either side of it.  Allocation takes the first free range that is 
+    big enough.  When there is enough free space in total but no single free range is big 
+    enough, Compact() slides every allocation down to the start of the pool so that all the 
+    free space is in one range at the end.
+
+    Note: A buddy allocator would make merging cheaper, but it rounds every allocation up to a
+    power of 2, and with a few dozen systems at most, walking the free list costs nothing.
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+class ParticleArena
+{
+public:
+    ParticleArena();
+    void Init(unsigned int capacity);
+    bool Allocate(unsigned int count, unsigned int *putFirstHere);
+    bool Free(unsigned int first);
+    std::vector<ParticleArenaMove> Compact();
+
+    unsigned int GetCapacity() const;
+    unsigned int GetFreeCount() const;
+    unsigned int GetLargestFreeBlock() const;
+    const std::vector<ParticleArenaBlock> &GetFreeBlocks() const;
+
+private:
+    unsigned int _capacity;
+    std::vector<ParticleArenaBlock> _freeBlocks;
+
+    // first particle -> particle count
+    std::map<unsigned int, unsigned int> _allocations;
+};
@@ -0,0 +1,431 @@
+#include "ParticleBoundarySdf.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
+#include "ShaderProgramRegistry.h"
+#include "TextureCompression.h"
+#include "Log.h"
+
+// must match the JUMP_FLOOD_STAGE_* defines in shaderJumpFlood.comp
+enum JumpFloodStage
+{
+    JUMP_FLOOD_STAGE_SEED = 0,
+    JUMP_FLOOD_STAGE_FLOOD,
+    JUMP_FLOOD_STAGE_RESOLVE,
+};
+
+// must match "local_size_x" and "local_size_y" in shaderJumpFlood.comp
+static const int JUMP_FLOOD_WORK_GROUP_SIZE = 16;
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleBoundarySdf::ParticleBoundarySdf() :
+    _jumpFloodProgramId(0),
+    _unifLocJumpFloodStage(0),
+    _unifLocJumpStep(0),
+    _unifLocTexelSize(0),
+    _solidMaskTextureId(0),
+    _distanceTextureId(0),
+    _compressedDistanceTextureId(0),
+    _distanceScale(1.0f),
+    _width(0),
+    _height(0),
+    _minCorner(-1.0f, -1.0f),
+    _maxCorner(+1.0f, +1.0f)
+{
+    _seedTextureIds[0] = 0;
+    _seedTextureIds[1] = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleBoundarySdf::~ParticleBoundarySdf()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes a reference to the jump flood program (see ShaderProgramRegistry.h) and creates the
+    textures.  There is no shape until SetShape(...), so the distances start out as 0
+    everywhere, which doesn't stop any particle.  The caller may release their own reference
+    after this returns.
+Parameters:
+    jumpFloodProgramId  shaderJumpFlood.comp.
+    width               The texels across.  The boundary can't have details smaller than a
+                        texel, so 256 is about right for a 500-pixel window.
+    height              Self-explanatory.
+    minCorner           Where the field's lower left corner is in window coordinates.
+    maxCorner           Where the field's upper right corner is.  Must be greater than
+                        minCorner on both axes.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleBoundarySdf::Init(unsigned int jumpFloodProgramId, int width, int height,
+    const glm::vec2 &minCorner, const glm::vec2 &maxCorner)
+{
+    this->Cleanup();
+    if (jumpFloodProgramId == 0)
+    {
+        LogPrintf("the SDF boundary needs its jump flood program\n");
+        return;
+    }
+    if (width <= 0 || height <= 0 || width > 32767 || height > 32767)
+    {
+        // the seeds are stored as 16-bit texel coordinates
+        LogPrintf("SDF boundary must be between 1x1 and 32767x32767 texels, not %dx%d\n",
+            width, height);
+        return;
+    }
+    if (maxCorner.x <= minCorner.x || maxCorner.y <= minCorner.y)
+    {
+        LogPrintf("SDF boundary bounds are empty: (%f, %f) to (%f, %f)\n",
+            minCorner.x, minCorner.y, maxCorner.x, maxCorner.y);
+        return;
+    }
+
+    _jumpFloodProgramId = jumpFloodProgramId;
+    AddProgramReference(_jumpFloodProgramId);
+    this->LoadProgramInterface();
+
+    _width = width;
+    _height = height;
+    _minCorner = minCorner;
+    _maxCorner = maxCorner;
+
+    // the mask and the seeds are only ever read with imageLoad(...), but an incomplete texture
+    // may still trip up some drivers (same as DensitySplatRenderer::InitDensityImage(...))
+    glGenTextures(1, &_solidMaskTextureId);
+    glBindTexture(GL_TEXTURE_2D, _solidMaskTextureId);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_R8UI, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenTextures(2, _seedTextureIds);
+    for (int seedIndex = 0; seedIndex < 2; seedIndex++)
+    {
+        glBindTexture(GL_TEXTURE_2D, _seedTextureIds[seedIndex]);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RG16I, width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+
+    // the update samples this one, so it's filtered, and past the edges the edge carries on
+    glGenTextures(1, &_distanceTextureId);
+    glBindTexture(GL_TEXTURE_2D, _distanceTextureId);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_R16F, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    GLfloat zero = 0.0f;
+    glClearTexImage(_distanceTextureId, 0, GL_RED, GL_FLOAT, &zero);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Releases the program and deletes the textures.  A particle manager that was given the
+    distance field must be told first (see ParticleManager::ClearSdfBoundary()).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleBoundarySdf::Cleanup()
+{
+    if (_jumpFloodProgramId != 0)
+    {
+        ReleaseProgram(_jumpFloodProgramId);
+        _jumpFloodProgramId = 0;
+    }
+
+    glDeleteTextures(1, &_solidMaskTextureId);
+    glDeleteTextures(2, _seedTextureIds);
+    glDeleteTextures(1, &_distanceTextureId);
+    glDeleteTextures(1, &_compressedDistanceTextureId);
+    _solidMaskTextureId = 0;
+    _seedTextureIds[0] = 0;
+    _seedTextureIds[1] = 0;
+    _distanceTextureId = 0;
+    _compressedDistanceTextureId = 0;
+    _distanceScale = 1.0f;
+    _width = 0;
+    _height = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Switches to a rebuilt program (see ParticleManager::ReplaceProgram(...)).  The distance
+    field isn't made again until the next SetShape(...).
+Parameters:
+    oldProgramId    Self-explanatory.  Programs that this boundary doesn't use are ignored.
+    newProgramId    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleBoundarySdf::ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId)
+{
+    if (oldProgramId == 0 || newProgramId == 0 || _jumpFloodProgramId != oldProgramId)
+    {
+        return;
+    }
+
+    AddProgramReference(newProgramId);
+    ReleaseProgram(_jumpFloodProgramId);
+    _jumpFloodProgramId = newProgramId;
+    this->LoadProgramInterface();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Uploads the shape and makes the distance field from it on the GPU.  Call it again whenever
+    the shape changes.  A compressed copy from before is dropped, so a particle manager that
+    was given it must be given GetTextureId() again.
+Parameters:
+    solidMask   One byte per texel, row by row from the min corner, X first.  Nonzero is solid
+                (particles stay out of it) and 0 is open.  Must be exactly width * height.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleBoundarySdf::SetShape(const std::vector<unsigned char> &solidMask)
+{
+    if (_jumpFloodProgramId == 0)
+    {
+        return;
+    }
+    if (solidMask.size() != (size_t)(_width * _height))
+    {
+        LogPrintf("SDF boundary is %dx%d, so its mask needs %d texels, not %u\n", _width,
+            _height, _width * _height, (unsigned int)solidMask.size());
+        return;
+    }
+    glDeleteTextures(1, &_compressedDistanceTextureId);
+    _compressedDistanceTextureId = 0;
+    _distanceScale = 1.0f;
+
+    // rows of bytes aren't necessarily 4-byte aligned
+    glBindTexture(GL_TEXTURE_2D, _solidMaskTextureId);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, _width, _height, GL_RED_INTEGER, GL_UNSIGNED_BYTE,
+        solidMask.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    UseGlProgram(_jumpFloodProgramId);
+    glUniform2f(_unifLocTexelSize, (_maxCorner.x - _minCorner.x) / _width,
+        (_maxCorner.y - _minCorner.y) / _height);
+    glBindImageTexture(SOLID_MASK_IMAGE_UNIT, _solidMaskTextureId, 0, GL_FALSE, 0,
+        GL_READ_ONLY, GL_R8UI);
+    glBindImageTexture(DISTANCE_FIELD_IMAGE_UNIT, _distanceTextureId, 0, GL_FALSE, 0,
+        GL_WRITE_ONLY, GL_R16F);
+
+    // the seeds go into the first seed texture, and every flood pass reads the texture that
+    // the last one wrote and writes the other one
+    int source = 1;
+    int destination = 0;
+    glBindImageTexture(SEED_SOURCE_IMAGE_UNIT, _seedTextureIds[source], 0, GL_FALSE, 0,
+        GL_READ_ONLY, GL_RG16I);
+    glBindImageTexture(SEED_DESTINATION_IMAGE_UNIT, _seedTextureIds[destination], 0, GL_FALSE,
+        0, GL_WRITE_ONLY, GL_RG16I);
+    this->DispatchJumpFloodStage(JUMP_FLOOD_STAGE_SEED);
+
+    // the first jump is half of the larger side, rounded up to a power of 2
+    int jumpStep = 1;
+    int largerSide = (_width > _height) ? _width : _height;
+    while (jumpStep * 2 < largerSide)
+    {
+        jumpStep *= 2;
+    }
+    for (; jumpStep >= 1; jumpStep /= 2)
+    {
+        source = destination;
+        destination = 1 - source;
+        glBindImageTexture(SEED_SOURCE_IMAGE_UNIT, _seedTextureIds[source], 0, GL_FALSE, 0,
+            GL_READ_ONLY, GL_RG16I);
+        glBindImageTexture(SEED_DESTINATION_IMAGE_UNIT, _seedTextureIds[destination], 0,
+            GL_FALSE, 0, GL_WRITE_ONLY, GL_RG16I);
+        glUniform1i(_unifLocJumpStep, jumpStep);
+        this->DispatchJumpFloodStage(JUMP_FLOOD_STAGE_FLOOD);
+    }
+
+    glBindImageTexture(SEED_SOURCE_IMAGE_UNIT, _seedTextureIds[destination], 0, GL_FALSE, 0,
+        GL_READ_ONLY, GL_RG16I);
+    this->DispatchJumpFloodStage(JUMP_FLOOD_STAGE_RESOLVE);
+    UseGlProgram(0);
+
+    // the update reads it through a sampler
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Reads the distances back and compresses them to BC4 on the CPU (see
+    TextureCompression.h).  GetTextureId() is the compressed copy from then on, and the
+    particle manager must be given GetDistanceScale() along with it.  Waits for the GPU to
+    finish the distances, so it is for load time, after the last SetShape(...).
+Parameters: None
+Returns:
+    False if there is no distance field or the copy couldn't be made, in which case the
+    uncompressed field is still there.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleBoundarySdf::Compress()
+{
+    if (_distanceTextureId == 0)
+    {
+        return false;
+    }
+    glDeleteTextures(1, &_compressedDistanceTextureId);
+    _compressedDistanceTextureId = 0;
+    _distanceScale = 1.0f;
+
+    // the resolve wrote the distances with image stores
+    glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+    std::vector<float> distances((size_t)_width * _height);
+    glBindTexture(GL_TEXTURE_2D, _distanceTextureId);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RED, GL_FLOAT, distances.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    _compressedDistanceTextureId = CreateSignedRgtcTexture(distances.data(), _width, _height,
+        1, &_distanceScale);
+    return (_compressedDistanceTextureId != 0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The distance field for ParticleManager::SetSdfBoundary(...), or 0 if Init(...) failed.
+    The compressed copy if there is one (see Compress()).
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleBoundarySdf::GetTextureId() const
+{
+    return (_compressedDistanceTextureId != 0) ? _compressedDistanceTextureId :
+        _distanceTextureId;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    What the samples of GetTextureId() must be multiplied by to be window units: the
+    largest distance for a compressed copy, and otherwise 1.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+float ParticleBoundarySdf::GetDistanceScale() const
+{
+    return _distanceScale;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The texels across the field.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+int ParticleBoundarySdf::GetWidth() const
+{
+    return _width;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The texels up the field.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+int ParticleBoundarySdf::GetHeight() const
+{
+    return _height;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The corner given to Init(...).
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+const glm::vec2 &ParticleBoundarySdf::GetMinCorner() const
+{
+    return _minCorner;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The corner given to Init(...).
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+const glm::vec2 &ParticleBoundarySdf::GetMaxCorner() const
+{
+    return _maxCorner;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Looks up the jump flood program's uniforms.  Called by Init(...) and whenever the program
+    is replaced.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleBoundarySdf::LoadProgramInterface()
+{
+    _unifLocJumpFloodStage = glGetUniformLocation(_jumpFloodProgramId, "uJumpFloodStage");
+    _unifLocJumpStep = glGetUniformLocation(_jumpFloodProgramId, "uJumpStep");
+    _unifLocTexelSize = glGetUniformLocation(_jumpFloodProgramId, "uTexelSize");
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Runs one stage over every texel and puts up a barrier for the next stage, which reads what
+    this one wrote.
+Parameters:
+    stage   One of the JUMP_FLOOD_STAGE_* values.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleBoundarySdf::DispatchJumpFloodStage(int stage)
+{
+    glUniform1i(_unifLocJumpFloodStage, stage);
+    glDispatchCompute((_width + JUMP_FLOOD_WORK_GROUP_SIZE - 1) / JUMP_FLOOD_WORK_GROUP_SIZE,
+        (_height + JUMP_FLOOD_WORK_GROUP_SIZE - 1) / JUMP_FLOOD_WORK_GROUP_SIZE, 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "glm/vec2.hpp"
+
+#include <vector>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    A boundary of any shape for the particles, as a signed distance field: a 2D texture of the
+    distance from each texel to the nearest edge of the solid parts, negative inside them.  The
+    update kernel samples it at each particle's position (see
+    ParticleManager::SetSdfBoundary(...)), and a particle that is inside the solid is either
+    recycled or pushed back out along the field's gradient and bounced.  That is a few texture
+    fetches per particle no matter how complicated the shape is.
+
+    The shape is given as a mask of solid texels (see SetShape(...)), and the distances are
+    made from it on the GPU with the jump flood algorithm (see shaderJumpFlood.comp): a pass to
+    find the solid texels at the edges and then log2(size) passes that spread the nearest edge
+    to every texel.  A 256x256 field is 10 dispatches, so it's cheap, but it only needs to be
+    done when the shape changes.
+
+    Note: The distances are R16F, which is plenty for window units, and they are filtered, so
+    the boundary is smooth between texels.  Corners that are sharper than a texel get rounded.
+
+    A boundary that doesn't change can be compressed to BC4 after SetShape(...) (see
+    Compress()), which is a quarter of the bytes per fetch.  The distances are then only good
+    to about 1/127th of the largest of them per block, but the surface is where the sign
+    changes, and the blocks along it have small ranges, so it moves by much less than that.
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+class ParticleBoundarySdf
+{
+public:
+    ParticleBoundarySdf();
+    ~ParticleBoundarySdf();
+    void Init(unsigned int jumpFloodProgramId, int width, int height,
+        const glm::vec2 &minCorner, const glm::vec2 &maxCorner);
+    void Cleanup();
+    void ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId);
+
+    void SetShape(const std::vector<unsigned char> &solidMask);
+    bool Compress();
+
+    unsigned int GetTextureId() const;
+    float GetDistanceScale() const;
+    int GetWidth() const;
+    int GetHeight() const;
+    const glm::vec2 &GetMinCorner() const;
+    const glm::vec2 &GetMaxCorner() const;
+
+private:
+    void LoadProgramInterface();
+    void DispatchJumpFloodStage(int stage);
+
+    unsigned int _jumpFloodProgramId;
+    unsigned int _unifLocJumpFloodStage;
+    unsigned int _unifLocJumpStep;
+    unsigned int _unifLocTexelSize;
+
+    // Note: The image units must match shaderJumpFlood.comp.  They start after the density
+    // splat's and the field bake's (see DensitySplatRenderer.h and ParticleFieldTexture.h).
+    static const unsigned int SOLID_MASK_IMAGE_UNIT = 2;
+    static const unsigned int SEED_SOURCE_IMAGE_UNIT = 3;
+    static const unsigned int SEED_DESTINATION_IMAGE_UNIT = 4;
+    static const unsigned int DISTANCE_FIELD_IMAGE_UNIT = 5;
+    unsigned int _solidMaskTextureId;
+    unsigned int _seedTextureIds[2];
+    unsigned int _distanceTextureId;
+
+    // a BC4 copy of the distances, which stands in for them until the next SetShape(...)
+    // (see Compress())
+    unsigned int _compressedDistanceTextureId;
+    float _distanceScale;
+    int _width;
+    int _height;
+    glm::vec2 _minCorner;
+    glm::vec2 _maxCorner;
+};
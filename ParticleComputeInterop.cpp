@@ -0,0 +1,368 @@
+#include "ParticleComputeInterop.h"
+
+// glload first, so that the SDKs' own includes of GL/gl.h are skipped
+#include "glload/include/glload/gl_4_4.h"
+#include "Log.h"
+
+#include <string.h>
+#include <string>
+
+// CUDA wins if both are asked for; there is only one set of buffers to share
+#if defined(PARTICLE_INTEROP_CUDA)
+// Build note: Also need the CUDA toolkit's include directory and cudart to link.
+#include <cuda_runtime.h>
+#include <cuda_gl_interop.h>
+#elif defined(PARTICLE_INTEROP_OPENCL)
+// Build note: Also need an OpenCL SDK's include directory and OpenCL to link.
+#ifdef __APPLE__
+#include <OpenCL/cl_gl.h>
+#else
+#include <CL/cl_gl.h>
+#endif
+#endif
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleComputeInterop::ParticleComputeInterop() :
+    _stream(0),
+    _bufferCount(0),
+    _hasGlEvent(false),
+    _isAcquired(false),
+    _isInitialized(false)
+{
+    memset(_bufferIds, 0, sizeof(_bufferIds));
+    memset(_resources, 0, sizeof(_resources));
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleComputeInterop::~ParticleComputeInterop()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The API that this build was compiled with (see PARTICLE_INTEROP_CUDA and
+    PARTICLE_INTEROP_OPENCL in the header), or PARTICLE_INTEROP_API_NONE.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleInteropApi ParticleComputeInterop::GetApi()
+{
+#if defined(PARTICLE_INTEROP_CUDA)
+    return PARTICLE_INTEROP_API_CUDA;
+#elif defined(PARTICLE_INTEROP_OPENCL)
+    return PARTICLE_INTEROP_API_OPENCL;
+#else
+    return PARTICLE_INTEROP_API_NONE;
+#endif
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes the stream or queue that the external kernels run on, and for OpenCL, checks
+    whether its device can sync with GL on its own (cl_khr_gl_event).
+Parameters:
+    stream  CUDA: a cudaStream_t, or 0 for the default stream.  OpenCL: a cl_command_queue,
+            which must not be 0.  Either way, it belongs to the caller and must outlive this
+            object or be replaced.
+Returns:
+    False if this build has no interop or the queue is no good, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleComputeInterop::Init(void *stream)
+{
+    this->Cleanup();
+    _stream = stream;
+    _hasGlEvent = false;
+
+#if defined(PARTICLE_INTEROP_CUDA)
+    _isInitialized = true;
+#elif defined(PARTICLE_INTEROP_OPENCL)
+    cl_command_queue queue = (cl_command_queue)_stream;
+    cl_device_id device = 0;
+    if (queue == 0 || clGetCommandQueueInfo(queue, CL_QUEUE_DEVICE, sizeof(device), &device,
+        0) != CL_SUCCESS)
+    {
+        LogErrorPrintf("particle interop: no OpenCL command queue\n");
+        return false;
+    }
+    size_t extensionsSize = 0;
+    clGetDeviceInfo(device, CL_DEVICE_EXTENSIONS, 0, 0, &extensionsSize);
+    std::string extensions(extensionsSize, '\0');
+    clGetDeviceInfo(device, CL_DEVICE_EXTENSIONS, extensionsSize, &extensions[0], 0);
+    if (extensions.find("cl_khr_gl_sharing") == std::string::npos)
+    {
+        LogErrorPrintf("particle interop: the OpenCL device can't share GL buffers\n");
+        return false;
+    }
+    _hasGlEvent = (extensions.find("cl_khr_gl_event") != std::string::npos);
+    _isInitialized = true;
+#else
+    LogErrorPrintf("particle interop: built without CUDA or OpenCL\n");
+#endif
+    return _isInitialized;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Releases the buffers, if they are still acquired, and unregisters them.  The GL buffers
+    themselves belong to whoever registered them.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleComputeInterop::Cleanup()
+{
+    this->UnregisterBuffers();
+    _stream = 0;
+    _hasGlEvent = false;
+    _isInitialized = false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Registers the GL buffers with the other API, replacing any that were registered before.
+    This is the expensive part, so it is only done when the buffers change (see
+    IsRegistered(...)).
+Parameters:
+    bufferIds   Self-explanatory.
+    bufferCount At most PARTICLE_INTEROP_MAX_BUFFERS.
+Returns:
+    False if any of them couldn't be registered, in which case none are, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleComputeInterop::RegisterBuffers(const unsigned int *bufferIds,
+    unsigned int bufferCount)
+{
+    this->UnregisterBuffers();
+    if (!_isInitialized || bufferCount > PARTICLE_INTEROP_MAX_BUFFERS)
+    {
+        return false;
+    }
+
+    for (unsigned int bufferIndex = 0; bufferIndex < bufferCount; bufferIndex++)
+    {
+        _bufferIds[bufferIndex] = bufferIds[bufferIndex];
+        bool isRegistered = false;
+#if defined(PARTICLE_INTEROP_CUDA)
+        cudaGraphicsResource *resource = 0;
+        cudaError_t result = cudaGraphicsGLRegisterBuffer(&resource, bufferIds[bufferIndex],
+            cudaGraphicsRegisterFlagsNone);
+        isRegistered = (result == cudaSuccess);
+        if (!isRegistered)
+        {
+            LogErrorPrintf("particle interop: cudaGraphicsGLRegisterBuffer failed: %s\n",
+                cudaGetErrorString(result));
+        }
+        _resources[bufferIndex] = resource;
+#elif defined(PARTICLE_INTEROP_OPENCL)
+        cl_context context = 0;
+        clGetCommandQueueInfo((cl_command_queue)_stream, CL_QUEUE_CONTEXT, sizeof(context),
+            &context, 0);
+        cl_int result = CL_SUCCESS;
+        cl_mem memory = clCreateFromGLBuffer(context, CL_MEM_READ_WRITE,
+            bufferIds[bufferIndex], &result);
+        isRegistered = (result == CL_SUCCESS);
+        if (!isRegistered)
+        {
+            LogErrorPrintf("particle interop: clCreateFromGLBuffer failed: %d\n", result);
+        }
+        _resources[bufferIndex] = memory;
+#endif
+        _bufferCount = bufferIndex + 1;
+        if (!isRegistered)
+        {
+            _resources[bufferIndex] = 0;
+            this->UnregisterBuffers();
+            return false;
+        }
+    }
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    bufferIds   Self-explanatory.
+    bufferCount Self-explanatory.
+Returns:
+    True if exactly these buffers are registered, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleComputeInterop::IsRegistered(const unsigned int *bufferIds,
+    unsigned int bufferCount) const
+{
+    if (bufferCount != _bufferCount || bufferCount == 0)
+    {
+        return false;
+    }
+    for (unsigned int bufferIndex = 0; bufferIndex < bufferCount; bufferIndex++)
+    {
+        if (_bufferIds[bufferIndex] != bufferIds[bufferIndex])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Releases the buffers if they are acquired, then unregisters them.  Must be called before
+    the GL buffers are deleted.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleComputeInterop::UnregisterBuffers()
+{
+    if (_isAcquired)
+    {
+        this->Release();
+    }
+    for (unsigned int bufferIndex = 0; bufferIndex < _bufferCount; bufferIndex++)
+    {
+        if (_resources[bufferIndex] != 0)
+        {
+#if defined(PARTICLE_INTEROP_CUDA)
+            cudaGraphicsUnregisterResource((cudaGraphicsResource *)_resources[bufferIndex]);
+#elif defined(PARTICLE_INTEROP_OPENCL)
+            clReleaseMemObject((cl_mem)_resources[bufferIndex]);
+#endif
+        }
+        _resources[bufferIndex] = 0;
+        _bufferIds[bufferIndex] = 0;
+    }
+    _bufferCount = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Hands the registered buffers over to the other API.  GL must not touch them until
+    Release().  See the header for how each API syncs with the GL commands before this.
+Parameters:
+    putBuffersHere  One per registered buffer: CUDA's device pointers, or OpenCL's cl_mems.
+Returns:
+    False if nothing is registered or the other API refused, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleComputeInterop::Acquire(void **putBuffersHere)
+{
+    if (_bufferCount == 0 || _isAcquired)
+    {
+        return false;
+    }
+
+#if defined(PARTICLE_INTEROP_CUDA)
+    cudaStream_t stream = (cudaStream_t)_stream;
+    cudaGraphicsResource_t *resources = (cudaGraphicsResource_t *)_resources;
+    cudaError_t result = cudaGraphicsMapResources((int)_bufferCount, resources, stream);
+    if (result != cudaSuccess)
+    {
+        LogErrorPrintf("particle interop: cudaGraphicsMapResources failed: %s\n",
+            cudaGetErrorString(result));
+        return false;
+    }
+    for (unsigned int bufferIndex = 0; bufferIndex < _bufferCount; bufferIndex++)
+    {
+        size_t sizeBytes = 0;
+        cudaGraphicsResourceGetMappedPointer(&putBuffersHere[bufferIndex], &sizeBytes,
+            resources[bufferIndex]);
+    }
+    _isAcquired = true;
+#elif defined(PARTICLE_INTEROP_OPENCL)
+    if (!_hasGlEvent)
+    {
+        glFinish();
+    }
+    cl_int result = clEnqueueAcquireGLObjects((cl_command_queue)_stream, _bufferCount,
+        (const cl_mem *)_resources, 0, 0, 0);
+    if (result != CL_SUCCESS)
+    {
+        LogErrorPrintf("particle interop: clEnqueueAcquireGLObjects failed: %d\n", result);
+        return false;
+    }
+    for (unsigned int bufferIndex = 0; bufferIndex < _bufferCount; bufferIndex++)
+    {
+        putBuffersHere[bufferIndex] = _resources[bufferIndex];
+    }
+    _isAcquired = true;
+#else
+    (void)putBuffersHere;
+#endif
+    return _isAcquired;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Hands the buffers back to GL after the external kernels, which must all have been issued
+    on the stream or queue by now.  See the header for how each API syncs with the GL commands
+    after this.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleComputeInterop::Release()
+{
+    if (!_isAcquired)
+    {
+        return;
+    }
+
+#if defined(PARTICLE_INTEROP_CUDA)
+    cudaGraphicsUnmapResources((int)_bufferCount, (cudaGraphicsResource_t *)_resources,
+        (cudaStream_t)_stream);
+#elif defined(PARTICLE_INTEROP_OPENCL)
+    clEnqueueReleaseGLObjects((cl_command_queue)_stream, _bufferCount,
+        (const cl_mem *)_resources, 0, 0, 0);
+    // the implicit sync only covers a release that has been sent to the device
+    if (_hasGlEvent)
+    {
+        clFlush((cl_command_queue)_stream);
+    }
+    else
+    {
+        clFinish((cl_command_queue)_stream);
+    }
+#endif
+    _isAcquired = false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The stream or queue that was given to Init(...).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void *ParticleComputeInterop::GetStream() const
+{
+    return _stream;
+}
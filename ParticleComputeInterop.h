@@ -0,0 +1,99 @@
+#pragma once
+
+#include "Particle.h"
+
+#include <functional>
+
+// which compute API this build shares the particle buffers with (see
+// ParticleComputeInterop::GetApi())
+enum ParticleInteropApi
+{
+    PARTICLE_INTEROP_API_NONE = 0,
+    PARTICLE_INTEROP_API_CUDA,
+    PARTICLE_INTEROP_API_OPENCL,
+};
+
+// the particle buffers as an external kernel sees them, once per UpdateSteps(...) (see
+// ParticleManager::SetExternalKernel(...))
+// Note: The buffers are in the manager's layout, like a readback (see ParticleReadbackFrame):
+// a Particle, PackedHalfParticle, or PackedFixedParticle per particle in _buffers[0], or for
+// the structure-of-arrays layout, positions, velocities, and flags in [0], [1], and [2].  With
+// CUDA, each one is a device pointer and _stream is the cudaStream_t to launch on.  With
+// OpenCL, each one is a cl_mem and _stream is the cl_command_queue.  They are only good for
+// the duration of the callback, and the kernels must be enqueued on _stream.
+// Also Note: The particles have already been updated for this call's steps, and the kernel
+// may change their positions and velocities.  It must not change the "is active" flags, since
+// the dead stacks and the draw lists were already built from them.
+static const unsigned int PARTICLE_INTEROP_MAX_BUFFERS = 3;
+struct ParticleInteropFrame
+{
+    ParticleLayout _layout;
+    unsigned int _particleCount;
+    float _stepSec;
+    unsigned int _numSteps;
+    unsigned int _bufferCount;
+    void *_buffers[PARTICLE_INTEROP_MAX_BUFFERS];
+    size_t _bufferSizesBytes[PARTICLE_INTEROP_MAX_BUFFERS];
+    void *_stream;
+};
+typedef std::function<void(const ParticleInteropFrame &)> ParticleInteropKernel;
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Shares OpenGL buffers with CUDA (cudaGraphicsGLRegisterBuffer(...)) or OpenCL
+    (clCreateFromGLBuffer(...)), so that another API's kernels can work on the particles in
+    place, with no copy through host memory and no second copy of the pool.  ParticleManager
+    does the registering and the acquire and release around each external kernel (see
+    ParticleManager::SetExternalKernel(...)); this only knows about buffers.
+
+    Synchronization:
+    - CUDA: Mapping waits for the GL commands that were issued before it, and unmapping makes
+      the GL commands issued after it wait for the work on the stream, so there is no
+      glFinish() either way.
+    - OpenCL: With cl_khr_gl_event, the acquire and the release sync with GL the same way.
+      Without it, the spec leaves it to the application, so GL is finished before the acquire
+      and the queue is finished after the release.
+
+    Note: Which API is built in is picked at compile time with PARTICLE_INTEROP_CUDA or
+    PARTICLE_INTEROP_OPENCL, since each needs its own SDK to build and its own library to link.
+    With neither, Init(...) says so and fails, like EglHeadlessWindow without EGL.
+    Also Note: The GL context must be current on the calling thread for all of it, and for
+    OpenCL, the queue's context must have been created with cl_khr_gl_sharing against that GL
+    context.  CUDA uses whichever CUDA context is current, which should be on the GL context's
+    GPU.
+    Also Note: Vulkan isn't one of the APIs.  GL can import memory from Vulkan
+    (GL_EXT_memory_object) but can't export its own buffers to it, so Vulkan would have to own
+    the pool and everything that reads it, which is a whole second ParticleManager (its own
+    queues, heaps, pipeline cache, and SPIR-V builds of the kernels) rather than an API to
+    share buffers with, and this tree has none of the SDK, loader, or shader toolchain that
+    it would need.  The GL path's answers to the same problems are the program binary cache
+    (see ShaderBinaryCache.h) and the narrowed barriers (see ParticleManager.cpp).
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class ParticleComputeInterop
+{
+public:
+    ParticleComputeInterop();
+    ~ParticleComputeInterop();
+    static ParticleInteropApi GetApi();
+    bool Init(void *stream);
+    void Cleanup();
+
+    bool RegisterBuffers(const unsigned int *bufferIds, unsigned int bufferCount);
+    bool IsRegistered(const unsigned int *bufferIds, unsigned int bufferCount) const;
+    void UnregisterBuffers();
+    bool Acquire(void **putBuffersHere);
+    void Release();
+    void *GetStream() const;
+
+private:
+    // Note: CUDA's resources and OpenCL's handles are pointers, so these are stored as void *
+    // to keep both SDKs out of the header.
+    void *_stream;
+    unsigned int _bufferIds[PARTICLE_INTEROP_MAX_BUFFERS];
+    void *_resources[PARTICLE_INTEROP_MAX_BUFFERS];
+    unsigned int _bufferCount;
+    bool _hasGlEvent;
+    bool _isAcquired;
+    bool _isInitialized;
+};
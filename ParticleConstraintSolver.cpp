@@ -0,0 +1,600 @@
+#include "ParticleConstraintSolver.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
+#include "ShaderProgramRegistry.h"
+#include "GpuMemoryLedger.h"
+#include "ComputeDeviceCaps.h"
+#include "OpenGlErrorHandling.h"
+#include "Log.h"
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.  No constraints, 8 iterations at full stiffness, and
+    2-pixel ribbons.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleConstraintSolver::ParticleConstraintSolver() :
+    _solverProgramId(0),
+    _solverWorkGroupSizeX(ParticleManager::DEFAULT_WORK_GROUP_SIZE),
+    _unifLocConstraintFirst(0),
+    _unifLocConstraintCount(0),
+    _unifLocConstraintParticleCount(0),
+    _unifLocConstraintDeltaSec(0),
+    _unifLocConstraintStiffness(0),
+    _ribbonProgramId(0),
+    _unifLocRibbonExtrapolationSec(0),
+    _unifLocRibbonWidth(0),
+    _unifLocRibbonBrightness(0),
+    _unifLocRibbonViewportSize(0),
+    _emptyVaoId(0),
+    _iterationCount(8),
+    _stiffness(1.0f),
+    _ribbonWidthPixels(2.0f),
+    _ribbonBrightness(1.0f),
+    _viewportWidth(1),
+    _viewportHeight(1),
+    _areConstraintsUploaded(false),
+    _maxParticleIndex(0),
+    _constraintBufferId(0),
+    _ribbonSegmentBufferId(0)
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleConstraintSolver::~ParticleConstraintSolver()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes a reference to both programs (see ShaderProgramRegistry.h).  The buffers are
+    created by the first Solve(...) or RenderRibbons(...) after the constraints change.  The
+    caller may release their own references after this returns.  The constraints that were
+    already added are kept.
+Parameters:
+    solverProgramId     shaderParticle.comp generated with GetConstraintShaderDefines(...).
+                        Must be built for the same particle layout as the particle manager's
+                        program.
+    ribbonProgramId     shaderParticle.vert generated with GetRibbonRenderShaderDefines(...),
+                        and shaderParticle.frag.  0 draws no ribbons.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleConstraintSolver::Init(unsigned int solverProgramId, unsigned int ribbonProgramId)
+{
+    this->Cleanup();
+    if (solverProgramId == 0)
+    {
+        LogPrintf("the constraint solver needs its solver program\n");
+        return;
+    }
+
+    // same as the neighbor grid; these come after everything else's
+    GLint maxBindings = 0;
+    glGetIntegerv(GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS, &maxBindings);
+    if (maxBindings <= (GLint)RIBBON_SEGMENT_BUFFER_BINDING)
+    {
+        LogPrintf("the constraint solver needs %u shader storage bindings, but there are only "
+            "%d\n", RIBBON_SEGMENT_BUFFER_BINDING + 1, maxBindings);
+        return;
+    }
+
+    _solverProgramId = solverProgramId;
+    AddProgramReference(_solverProgramId);
+    _ribbonProgramId = ribbonProgramId;
+    if (_ribbonProgramId != 0)
+    {
+        AddProgramReference(_ribbonProgramId);
+    }
+    this->LoadProgramInterfaces();
+    glGenVertexArrays(1, &_emptyVaoId);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Releases the programs and deletes the buffers.  The constraints are kept, and are
+    uploaded again after the next Init(...).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleConstraintSolver::Cleanup()
+{
+    if (_solverProgramId != 0)
+    {
+        ReleaseProgram(_solverProgramId);
+        _solverProgramId = 0;
+    }
+    if (_ribbonProgramId != 0)
+    {
+        ReleaseProgram(_ribbonProgramId);
+        _ribbonProgramId = 0;
+    }
+    if (_emptyVaoId != 0)
+    {
+        DeleteGlVertexArrays(1, &_emptyVaoId);
+        _emptyVaoId = 0;
+    }
+
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _constraintBufferId);
+    DeleteGlBuffers(1, &_constraintBufferId);
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _ribbonSegmentBufferId);
+    DeleteGlBuffers(1, &_ribbonSegmentBufferId);
+    _constraintBufferId = 0;
+    _ribbonSegmentBufferId = 0;
+    _areConstraintsUploaded = false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Switches to a rebuilt program (see ParticleManager::ReplaceProgram(...)).
+Parameters:
+    oldProgramId    Self-explanatory.  Programs that this solver doesn't use are ignored.
+    newProgramId    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleConstraintSolver::ReplaceProgram(unsigned int oldProgramId,
+    unsigned int newProgramId)
+{
+    if (oldProgramId == 0 || newProgramId == 0)
+    {
+        return;
+    }
+
+    if (_solverProgramId == oldProgramId)
+    {
+        AddProgramReference(newProgramId);
+        ReleaseProgram(_solverProgramId);
+        _solverProgramId = newProgramId;
+        this->LoadProgramInterfaces();
+    }
+    else if (_ribbonProgramId == oldProgramId)
+    {
+        AddProgramReference(newProgramId);
+        ReleaseProgram(_ribbonProgramId);
+        _ribbonProgramId = newProgramId;
+        this->LoadProgramInterfaces();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Links 2 particles.  The constraints are colored and uploaded again by the next
+    Solve(...), so adding them every frame is slow.
+Parameters:
+    particleA   An index into the particle pool.
+    particleB   Another one.  A constraint from a particle to itself is ignored.
+    restLength  How far apart the 2 particles are held, in window units.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleConstraintSolver::AddConstraint(unsigned int particleA, unsigned int particleB,
+    float restLength)
+{
+    if (particleA == particleB)
+    {
+        LogPrintf("a particle can't be constrained to itself (%u)\n", particleA);
+        return;
+    }
+
+    ParticleConstraint constraint;
+    constraint._particleA = particleA;
+    constraint._particleB = particleB;
+    constraint._restLength = (restLength > 0.0f) ? restLength : 0.0f;
+    _constraints.push_back(constraint);
+    _maxParticleIndex = (particleA > _maxParticleIndex) ? particleA : _maxParticleIndex;
+    _maxParticleIndex = (particleB > _maxParticleIndex) ? particleB : _maxParticleIndex;
+    _areConstraintsUploaded = false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Links the particles one after another into a chain, with a constraint between each pair
+    of neighbors, and draws the chain as a ribbon.
+Parameters:
+    particleIndices     Indices into the particle pool, in the order that they are linked.
+    particleCount       At least 2.
+    restLength          The length of each link, in window units.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleConstraintSolver::AddChain(const unsigned int *particleIndices,
+    unsigned int particleCount, float restLength)
+{
+    if (particleIndices == 0 || particleCount < 2)
+    {
+        LogPrintf("a chain needs at least 2 particles, not %u\n", particleCount);
+        return;
+    }
+
+    for (unsigned int link = 0; link + 1 < particleCount; link++)
+    {
+        this->AddConstraint(particleIndices[link], particleIndices[link + 1], restLength);
+
+        // the ends of the chain are their own neighbors, which points their tangents along
+        // the end segments
+        unsigned int previous = (link > 0) ? (link - 1) : link;
+        unsigned int next = (link + 2 < particleCount) ? (link + 2) : (link + 1);
+        _ribbonSegments.push_back(particleIndices[previous]);
+        _ribbonSegments.push_back(particleIndices[link]);
+        _ribbonSegments.push_back(particleIndices[link + 1]);
+        _ribbonSegments.push_back(particleIndices[next]);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Removes every constraint and ribbon.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleConstraintSolver::ClearConstraints()
+{
+    _constraints.clear();
+    _ribbonSegments.clear();
+    _batchFirsts.clear();
+    _batchCounts.clear();
+    _maxParticleIndex = 0;
+    _areConstraintsUploaded = false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets how hard the constraints are solved.  Can be changed at any time.
+Parameters:
+    iterationCount  How many times per Solve(...) every batch is run.  More makes a long
+                    chain stretch less, since a correction travels one link per iteration.
+                    0 turns the solver off.
+    stiffness       The fraction of each constraint's error that one iteration takes away.
+                    1 is rigid; less is springy.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleConstraintSolver::SetSolver(unsigned int iterationCount, float stiffness)
+{
+    _iterationCount = iterationCount;
+    _stiffness = (stiffness < 0.0f) ? 0.0f : ((stiffness > 1.0f) ? 1.0f : stiffness);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets how the ribbons are drawn.  Can be changed at any time.
+Parameters:
+    widthPixels     Self-explanatory.  Like the particles' point size, it stays the same at
+                    any zoom.
+    brightness      Scales the ribbons' color, like ParticleManager::SetParticleBrightness(...).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleConstraintSolver::SetRibbonStyle(float widthPixels, float brightness)
+{
+    _ribbonWidthPixels = (widthPixels > 0.0f) ? widthPixels : 0.0f;
+    _ribbonBrightness = brightness;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Tells the ribbons how big a pixel is.  Must be called whenever the window is resized.
+Parameters:
+    widthPixels     Self-explanatory.
+    heightPixels    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleConstraintSolver::SetViewportSize(int widthPixels, int heightPixels)
+{
+    _viewportWidth = (widthPixels > 0) ? widthPixels : 1;
+    _viewportHeight = (heightPixels > 0) ? heightPixels : 1;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How many batches each iteration dispatches, as of the last time that the constraints
+    were uploaded (the first Solve(...) after they change).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleConstraintSolver::GetColorCount() const
+{
+    return (unsigned int)_batchCounts.size();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Moves every constrained pair of active particles toward their rest length, and changes
+    their velocities to match.  Must be called after the update, like the neighbor grid's
+    interactions.
+Parameters:
+    deltaTimeSec        How much simulation time the change in velocity is for.  0 does
+                        nothing.
+    maxParticleCount    The size of the particle pool.  Constraints on particles past it are
+                        skipped.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleConstraintSolver::Solve(float deltaTimeSec, unsigned int maxParticleCount)
+{
+    if (_solverProgramId == 0 || deltaTimeSec <= 0.0f || _iterationCount == 0)
+    {
+        return;
+    }
+    if (!_areConstraintsUploaded)
+    {
+        this->UploadConstraints();
+    }
+    if (_batchCounts.empty())
+    {
+        return;
+    }
+    GlDebugGroup solveGroup("constraint solve");
+
+    BindGlShaderStorageBuffer(CONSTRAINT_BUFFER_BINDING, _constraintBufferId);
+    UseGlProgram(_solverProgramId);
+    glUniform1ui(_unifLocConstraintParticleCount, maxParticleCount);
+    glUniform1f(_unifLocConstraintDeltaSec, deltaTimeSec);
+    glUniform1f(_unifLocConstraintStiffness, _stiffness);
+
+    // one work item per constraint of the batch; no 2 of them share a particle, so they can
+    // write the particles without atomics, and the barrier lets the next batch see them
+    for (unsigned int iteration = 0; iteration < _iterationCount; iteration++)
+    {
+        for (size_t batchIndex = 0; batchIndex < _batchCounts.size(); batchIndex++)
+        {
+            unsigned int numWorkGroups =
+                (_batchCounts[batchIndex] + _solverWorkGroupSizeX - 1) / _solverWorkGroupSizeX;
+            unsigned int numWorkGroupsX = 0;
+            unsigned int numWorkGroupsY = 0;
+            GetComputeDispatchSize(numWorkGroups, &numWorkGroupsX, &numWorkGroupsY);
+            glUniform1ui(_unifLocConstraintFirst, _batchFirsts[batchIndex]);
+            glUniform1ui(_unifLocConstraintCount, _batchCounts[batchIndex]);
+            glDispatchCompute(numWorkGroupsX, numWorkGroupsY, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+    }
+    UseGlProgram(0);
+
+    // same as the neighbor grid's interactions
+    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT |
+        GL_BUFFER_UPDATE_BARRIER_BIT);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Draws every chain as a ribbon: each segment is a quad of 2 triangles, widened across the
+    chain's direction at each end, so neighboring segments meet without a gap.  A segment
+    with an inactive particle isn't drawn.
+
+    Note: Must be called after ParticleManager::Render(...), whose particle buffers and view
+    (see ViewParameters.h) it uses where that left them bound.
+Parameters:
+    extrapolationSec    Same as for ParticleManager::Render(...), so that the ribbons stay
+                        on the particles.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleConstraintSolver::RenderRibbons(float extrapolationSec)
+{
+    if (_ribbonProgramId == 0 || _ribbonSegments.empty() || _ribbonWidthPixels <= 0.0f)
+    {
+        return;
+    }
+    if (!_areConstraintsUploaded)
+    {
+        this->UploadConstraints();
+    }
+    GlDebugGroup ribbonGroup("constraint ribbons");
+
+    UseGlProgram(_ribbonProgramId);
+    glUniform1f(_unifLocRibbonExtrapolationSec, extrapolationSec);
+    glUniform1f(_unifLocRibbonWidth, _ribbonWidthPixels);
+    glUniform1f(_unifLocRibbonBrightness, _ribbonBrightness);
+    glUniform2f(_unifLocRibbonViewportSize, (float)_viewportWidth, (float)_viewportHeight);
+    BindGlShaderStorageBuffer(RIBBON_SEGMENT_BUFFER_BINDING, _ribbonSegmentBufferId);
+
+    // 6 vertices per segment, which pull their particles themselves
+    BindGlVertexArray(_emptyVaoId);
+    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)((_ribbonSegments.size() / 4) * 6));
+    BindGlVertexArray(0);
+    UseGlProgram(0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    layout          Must be the particle manager's layout.
+    workGroupSize   Self-explanatory.
+Returns:
+    The defines to give to AcquireComputeProgram(...) for the solver program.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+std::string ParticleConstraintSolver::GetConstraintShaderDefines(ParticleLayout layout,
+    unsigned int workGroupSize)
+{
+    return ParticleManager::GetComputeShaderDefines(layout, workGroupSize) +
+        "#define PARTICLE_CONSTRAINT_PASS\n";
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The defines for the ribbon program, which is a vertex pulling render program (see
+    ParticleManager::GetRenderShaderDefines(...)) that pulls the chains' particles by the
+    segment instead of by the live index.
+Parameters:
+    layout  Must be the particle manager's layout.
+Returns:
+    A string of "#define" statements for AcquireRenderProgram(...).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+std::string ParticleConstraintSolver::GetRibbonRenderShaderDefines(ParticleLayout layout)
+{
+    return "#define PARTICLE_RIBBONS\n" + ParticleManager::GetRenderShaderDefines(layout);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Looks up both programs' uniforms and the solver's work group size.  Called by Init(...)
+    and whenever a program is replaced.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleConstraintSolver::LoadProgramInterfaces()
+{
+    _unifLocConstraintFirst = glGetUniformLocation(_solverProgramId, "uConstraintFirst");
+    _unifLocConstraintCount = glGetUniformLocation(_solverProgramId, "uConstraintCount");
+    _unifLocConstraintParticleCount =
+        glGetUniformLocation(_solverProgramId, "uConstraintParticleCount");
+    _unifLocConstraintDeltaSec = glGetUniformLocation(_solverProgramId, "uConstraintDeltaSec");
+    _unifLocConstraintStiffness =
+        glGetUniformLocation(_solverProgramId, "uConstraintStiffness");
+
+    // same as ParticleManager::Init(...); the dispatch must match the program
+    GLint programWorkGroupSize[3] = { 0, 0, 0 };
+    glGetProgramiv(_solverProgramId, GL_COMPUTE_LOCAL_WORK_SIZE, programWorkGroupSize);
+    _solverWorkGroupSizeX = (programWorkGroupSize[0] > 0) ?
+        programWorkGroupSize[0] : ParticleManager::DEFAULT_WORK_GROUP_SIZE;
+
+    if (_ribbonProgramId != 0)
+    {
+        _unifLocRibbonExtrapolationSec =
+            glGetUniformLocation(_ribbonProgramId, "uExtrapolationSec");
+        _unifLocRibbonWidth = glGetUniformLocation(_ribbonProgramId, "uRibbonWidth");
+        _unifLocRibbonBrightness = glGetUniformLocation(_ribbonProgramId, "uParticleBrightness");
+        _unifLocRibbonViewportSize = glGetUniformLocation(_ribbonProgramId, "uViewportSize");
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Colors the constraints, so that no 2 of the same color share a particle, and uploads
+    them in color order, along with the ribbons' segments.
+
+    The coloring is greedy: each constraint takes the lowest color that neither of its
+    particles has yet.  That is at most one more color than the most constraints on any one
+    particle, and for chains it is 2.  A constraint that would need more than MAX_COLORS is
+    left out, and that is printed.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleConstraintSolver::UploadConstraints()
+{
+    _batchFirsts.clear();
+    _batchCounts.clear();
+
+    // the colors that each particle is already in, a bit each
+    std::vector<unsigned int> particleColorMasks(
+        _constraints.empty() ? 0 : (_maxParticleIndex + 1), 0);
+    std::vector<unsigned int> constraintColors(_constraints.size(), MAX_COLORS);
+    unsigned int colorCounts[MAX_COLORS] = { 0 };
+    unsigned int droppedCount = 0;
+    for (size_t constraintIndex = 0; constraintIndex < _constraints.size(); constraintIndex++)
+    {
+        const ParticleConstraint &constraint = _constraints[constraintIndex];
+        unsigned int usedColors = particleColorMasks[constraint._particleA] |
+            particleColorMasks[constraint._particleB];
+        unsigned int color = 0;
+        while (color < MAX_COLORS && (usedColors & (1u << color)) != 0)
+        {
+            color++;
+        }
+        if (color == MAX_COLORS)
+        {
+            droppedCount++;
+            continue;
+        }
+
+        constraintColors[constraintIndex] = color;
+        colorCounts[color]++;
+        particleColorMasks[constraint._particleA] |= (1u << color);
+        particleColorMasks[constraint._particleB] |= (1u << color);
+    }
+    if (droppedCount > 0)
+    {
+        LogPrintf("%u constraints were left out; their particles already had %u colors\n",
+            droppedCount, MAX_COLORS);
+    }
+
+    // a counting sort by color, which keeps each color's constraints in the order they were
+    // added
+    unsigned int colorStarts[MAX_COLORS] = { 0 };
+    unsigned int sortedCount = 0;
+    for (unsigned int color = 0; color < MAX_COLORS; color++)
+    {
+        colorStarts[color] = sortedCount;
+        if (colorCounts[color] > 0)
+        {
+            _batchFirsts.push_back(sortedCount);
+            _batchCounts.push_back(colorCounts[color]);
+        }
+        sortedCount += colorCounts[color];
+    }
+    std::vector<ParticleConstraint> sortedConstraints(sortedCount);
+    for (size_t constraintIndex = 0; constraintIndex < _constraints.size(); constraintIndex++)
+    {
+        unsigned int color = constraintColors[constraintIndex];
+        if (color < MAX_COLORS)
+        {
+            sortedConstraints[colorStarts[color]++] = _constraints[constraintIndex];
+        }
+    }
+
+    // the buffers are only written here, so they are remade instead of resized
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _constraintBufferId);
+    DeleteGlBuffers(1, &_constraintBufferId);
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _ribbonSegmentBufferId);
+    DeleteGlBuffers(1, &_ribbonSegmentBufferId);
+    _constraintBufferId = 0;
+    _ribbonSegmentBufferId = 0;
+    if (sortedCount > 0)
+    {
+        glGenBuffers(1, &_constraintBufferId);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, _constraintBufferId);
+        glBufferStorage(GL_SHADER_STORAGE_BUFFER, sortedCount * sizeof(ParticleConstraint),
+            sortedConstraints.data(), 0);
+        RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particle constraints");
+    }
+    if (!_ribbonSegments.empty())
+    {
+        glGenBuffers(1, &_ribbonSegmentBufferId);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, _ribbonSegmentBufferId);
+        glBufferStorage(GL_SHADER_STORAGE_BUFFER, _ribbonSegments.size() * sizeof(GLuint),
+            _ribbonSegments.data(), 0);
+        RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particle constraint ribbons");
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    _areConstraintsUploaded = true;
+}
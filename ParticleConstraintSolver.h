@@ -0,0 +1,124 @@
+#pragma once
+
+#include "ParticleManager.h"
+
+#include <string>
+#include <vector>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    A distance constraint between 2 particles of the pool: the solver moves them toward (or
+    away from) each other until they are the rest length apart.
+    Note: Must match "ParticleConstraint" in shaderParticle.comp under std430 (3 4-byte
+    members, so no padding).
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+struct ParticleConstraint
+{
+    unsigned int _particleA;
+    unsigned int _particleB;
+    float _restLength;
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Links particles of the pool with distance constraints (ex: ropes and ribbons, which are
+    chains of them) and solves them on the GPU after every update, and draws the chains as
+    ribbons.
+
+    The constraints are solved with Gauss-Seidel passes: each one moves both of its particles
+    and sees what the ones before it did.  To run that in parallel without atomics, the
+    constraints are colored on the CPU so that no 2 constraints of the same color share a
+    particle, and each color is a dispatch of its own (a "batch"), with a barrier between
+    them.  A chain needs only 2 colors (the even links and the odd links).  The coloring is
+    greedy, and redone whenever the constraints change, which is expected to be rare.
+
+    Each correction also changes the particles' velocities by the distance that they were
+    moved over the time step, like position-based dynamics, so a rope swings instead of
+    snapping back and forth.  A constraint with an inactive particle does nothing, and a
+    particle that is emitted again is pulled back into its chain.
+
+    The solver program is shaderParticle.comp built with PARTICLE_CONSTRAINT_PASS defined (see
+    GetConstraintShaderDefines(...)), so, like the neighbor grid (see ParticleNeighborGrid.h),
+    it reads and writes the particles through the particle manager's bindings and must run
+    after the update.  The ribbon program is shaderParticle.vert built with
+    PARTICLE_RIBBONS (see GetRibbonRenderShaderDefines(...)), which pulls both ends of every
+    chain segment and widens it into a quad.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class ParticleConstraintSolver
+{
+public:
+    ParticleConstraintSolver();
+    ~ParticleConstraintSolver();
+    void Init(unsigned int solverProgramId, unsigned int ribbonProgramId);
+    void Cleanup();
+    void ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId);
+
+    void AddConstraint(unsigned int particleA, unsigned int particleB, float restLength);
+    void AddChain(const unsigned int *particleIndices, unsigned int particleCount,
+        float restLength);
+    void ClearConstraints();
+    void SetSolver(unsigned int iterationCount, float stiffness);
+    void SetRibbonStyle(float widthPixels, float brightness);
+    void SetViewportSize(int widthPixels, int heightPixels);
+    unsigned int GetColorCount() const;
+
+    void Solve(float deltaTimeSec, unsigned int maxParticleCount);
+    void RenderRibbons(float extrapolationSec);
+
+    static std::string GetConstraintShaderDefines(ParticleLayout layout,
+        unsigned int workGroupSize = ParticleManager::DEFAULT_WORK_GROUP_SIZE);
+    static std::string GetRibbonRenderShaderDefines(ParticleLayout layout);
+
+    // the coloring keeps a bit per color for every particle
+    static const unsigned int MAX_COLORS = 32;
+
+private:
+    void LoadProgramInterfaces();
+    void UploadConstraints();
+
+    unsigned int _solverProgramId;
+    unsigned int _solverWorkGroupSizeX;
+    unsigned int _unifLocConstraintFirst;
+    unsigned int _unifLocConstraintCount;
+    unsigned int _unifLocConstraintParticleCount;
+    unsigned int _unifLocConstraintDeltaSec;
+    unsigned int _unifLocConstraintStiffness;
+
+    unsigned int _ribbonProgramId;
+    unsigned int _unifLocRibbonExtrapolationSec;
+    unsigned int _unifLocRibbonWidth;
+    unsigned int _unifLocRibbonBrightness;
+    unsigned int _unifLocRibbonViewportSize;
+    unsigned int _emptyVaoId;
+
+    unsigned int _iterationCount;
+    float _stiffness;
+    float _ribbonWidthPixels;
+    float _ribbonBrightness;
+    int _viewportWidth;
+    int _viewportHeight;
+
+    // what the caller added, in the order that they added it, and the chains' segments, each
+    // the particle before it, its 2 ends, and the particle after it (an end if there isn't
+    // one), for the ribbons' tangents
+    std::vector<ParticleConstraint> _constraints;
+    std::vector<unsigned int> _ribbonSegments;
+    bool _areConstraintsUploaded;
+
+    // the constraints on the GPU are in color order, and each color's batch is a range of them
+    std::vector<unsigned int> _batchFirsts;
+    std::vector<unsigned int> _batchCounts;
+
+    // the highest particle index that a constraint refers to, which sizes the coloring's
+    // per-particle masks
+    unsigned int _maxParticleIndex;
+
+    // Note: The bindings must match shaderParticle.comp and shaderParticle.vert.  They come
+    // after the neighbor grid's DEM buffers (see ParticleNeighborGrid.h).
+    static const unsigned int CONSTRAINT_BUFFER_BINDING = 59;
+    static const unsigned int RIBBON_SEGMENT_BUFFER_BINDING = 60;
+    unsigned int _constraintBufferId;
+    unsigned int _ribbonSegmentBufferId;
+};
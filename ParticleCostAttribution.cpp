@@ -0,0 +1,353 @@
+#include "ParticleCostAttribution.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
+#include "GlFenceSync.h"
+#include "GpuMemoryLedger.h"
+#include "Log.h"
+
+#include <algorithm>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.  Nothing is counted until Init(...).  Defaults to a sample
+    every 60 updates, which is every half second at 120Hz.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleCostAttribution::ParticleCostAttribution() :
+    _maxEmitterCount(0),
+    _mappedReadback(0),
+    _nextSlot(0),
+    _interval(60),
+    _updatesSinceSample(0),
+    _stepsSinceSample(0),
+    _hasCosts(false)
+{
+    for (unsigned int slotIndex = 0; slotIndex < COST_READBACK_SLOTS; slotIndex++)
+    {
+        _slotStepCounts[slotIndex] = 0;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleCostAttribution::~ParticleCostAttribution()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Creates the counters, cleared, and the readback ring.
+Parameters:
+    maxEmitterCount     The most emitters that the particle manager will have.  The ones past
+                        it aren't counted.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleCostAttribution::Init(unsigned int maxEmitterCount)
+{
+    this->Cleanup();
+    if (maxEmitterCount == 0)
+    {
+        return;
+    }
+
+    GLint maxBindings = 0;
+    glGetIntegerv(GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS, &maxBindings);
+    if (maxBindings <= (GLint)EMITTER_STEP_COUNT_BUFFER_BINDING)
+    {
+        LogPrintf("the cost attribution needs %u shader storage bindings, but there are only "
+            "%d\n", EMITTER_STEP_COUNT_BUFFER_BINDING + 1, maxBindings);
+        return;
+    }
+
+    _maxEmitterCount = maxEmitterCount;
+    GLsizeiptr countBytes = _maxEmitterCount * sizeof(GLuint);
+    _countBufferId = GenerateGlBuffer();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _countBufferId);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, countBytes, 0, 0);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, 0);
+    RecordGpuAllocation(GPU_MEMORY_BUFFER, _countBufferId, countBytes, "cost attribution");
+
+    GLbitfield storageFlags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    GLsizeiptr readbackBytes = COST_READBACK_SLOTS * countBytes;
+    _readbackBufferId = GenerateGlBuffer();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _readbackBufferId);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, readbackBytes, 0, storageFlags);
+    _mappedReadback = (const unsigned int *)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0,
+        readbackBytes, storageFlags);
+    RecordGpuAllocation(GPU_MEMORY_BUFFER, _readbackBufferId, readbackBytes,
+        "cost attribution");
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Deletes the buffers and fences.  The last costs are forgotten.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleCostAttribution::Cleanup()
+{
+    for (unsigned int slotIndex = 0; slotIndex < COST_READBACK_SLOTS; slotIndex++)
+    {
+        _fences[slotIndex].Reset();
+        _slotStepCounts[slotIndex] = 0;
+    }
+    if (_countBufferId != 0)
+    {
+        ForgetGpuAllocation(GPU_MEMORY_BUFFER, _countBufferId);
+        _countBufferId.Reset();
+    }
+    if (_readbackBufferId != 0)
+    {
+        ForgetGpuAllocation(GPU_MEMORY_BUFFER, _readbackBufferId);
+        _readbackBufferId.Reset();
+    }
+    _mappedReadback = 0;
+    _maxEmitterCount = 0;
+    _nextSlot = 0;
+    _updatesSinceSample = 0;
+    _stepsSinceSample = 0;
+    _latestStepsPerUpdate.clear();
+    _hasCosts = false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets how many updates each sample adds up.  More is steadier and costs a copy less often.
+Parameters:
+    updatesPerSample    0 is treated as 1.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleCostAttribution::SetInterval(unsigned int updatesPerSample)
+{
+    _interval = (updatesPerSample > 0) ? updatesPerSample : 1;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Binds the counters for the update.  Call right before the particle manager's update.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleCostAttribution::BeginUpdate()
+{
+    if (_countBufferId == 0)
+    {
+        return;
+    }
+    BindGlShaderStorageBuffer(EMITTER_STEP_COUNT_BUFFER_BINDING, _countBufferId);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Picks up any samples that the GPU has finished, and if one is due and a slot is free,
+    copies the counters into it and clears them.  Call right after the particle manager's
+    update.
+Parameters:
+    numSteps    The update steps that it ran (see ParticleManager::UpdateSteps(...)).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleCostAttribution::EndUpdate(unsigned int numSteps)
+{
+    if (_mappedReadback == 0)
+    {
+        return;
+    }
+
+    this->CollectFinishedSlots();
+
+    _stepsSinceSample += numSteps;
+    _updatesSinceSample++;
+    if (_updatesSinceSample < _interval || _stepsSinceSample == 0)
+    {
+        return;
+    }
+    if (_fences[_nextSlot] != 0)
+    {
+        // the GPU is more than a ring behind; keep counting rather than wait
+        return;
+    }
+
+    // the update's atomics must land before the copy reads them
+    unsigned int slotIndex = _nextSlot;
+    GLsizeiptr countBytes = _maxEmitterCount * sizeof(GLuint);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_COPY_READ_BUFFER, _countBufferId);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, _readbackBufferId);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, slotIndex * countBytes,
+        countBytes);
+    glClearBufferData(GL_COPY_READ_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, 0);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    // the CPU reads the slot through the persistent mapping once the fence has signaled
+    glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+    _fences[slotIndex] = InsertGlFence();
+    _slotStepCounts[slotIndex] = _stepsSinceSample;
+    _nextSlot = (_nextSlot + 1) % COST_READBACK_SLOTS;
+    _updatesSinceSample = 0;
+    _stepsSinceSample = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    putStepsHere    Each emitter's particle steps per update step, in the latest sample that
+                    the GPU has finished.
+Returns:
+    False if no sample has finished yet, in which case putStepsHere is left alone.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleCostAttribution::GetLatestStepsPerUpdate(std::vector<double> *putStepsHere) const
+{
+    if (!_hasCosts)
+    {
+        return false;
+    }
+
+    *putStepsHere = _latestStepsPerUpdate;
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Prints the costliest emitters, and the costliest systems if there is more than one, with
+    their shares of the particle steps and of the update's time.
+Parameters:
+    firstEmitterOfEachSystem    Where each system's emitters start, in order, so that each
+                                system runs up to the next one's first (see
+                                ParticleManager::GetDrawGroupFirstEmitters()).  Empty or 1
+                                prints no systems.
+    updateMs                    The update's average GPU time, which is split by the shares.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleCostAttribution::PrintReport(
+    const std::vector<unsigned int> &firstEmitterOfEachSystem, float updateMs) const
+{
+    if (!_hasCosts)
+    {
+        return;
+    }
+
+    double totalSteps = 0.0;
+    for (size_t emitterIndex = 0; emitterIndex < _latestStepsPerUpdate.size(); emitterIndex++)
+    {
+        totalSteps += _latestStepsPerUpdate[emitterIndex];
+    }
+    if (totalSteps <= 0.0)
+    {
+        return;
+    }
+
+    // (cost, index) pairs, costliest first
+    std::vector<std::pair<double, unsigned int> > rows;
+    for (size_t emitterIndex = 0; emitterIndex < _latestStepsPerUpdate.size(); emitterIndex++)
+    {
+        rows.push_back(std::make_pair(_latestStepsPerUpdate[emitterIndex],
+            (unsigned int)emitterIndex));
+    }
+    std::sort(rows.begin(), rows.end(), std::greater<std::pair<double, unsigned int> >());
+    for (size_t rowIndex = 0; rowIndex < rows.size() && rowIndex < REPORT_ROW_COUNT; rowIndex++)
+    {
+        double share = rows[rowIndex].first / totalSteps;
+        if (share <= 0.0)
+        {
+            break;
+        }
+        LogPrintf("cost emitter %-3u %5.1f%% %12.0f particle steps per step, ~%.3f ms\n",
+            rows[rowIndex].second, share * 100.0, rows[rowIndex].first, share * updateMs);
+    }
+
+    if (firstEmitterOfEachSystem.size() <= 1)
+    {
+        return;
+    }
+    rows.clear();
+    for (size_t systemIndex = 0; systemIndex < firstEmitterOfEachSystem.size(); systemIndex++)
+    {
+        size_t emitterEnd = (systemIndex + 1 < firstEmitterOfEachSystem.size()) ?
+            firstEmitterOfEachSystem[systemIndex + 1] : _latestStepsPerUpdate.size();
+        emitterEnd = std::min(emitterEnd, _latestStepsPerUpdate.size());
+        double systemSteps = 0.0;
+        for (size_t emitterIndex = firstEmitterOfEachSystem[systemIndex];
+            emitterIndex < emitterEnd; emitterIndex++)
+        {
+            systemSteps += _latestStepsPerUpdate[emitterIndex];
+        }
+        rows.push_back(std::make_pair(systemSteps, (unsigned int)systemIndex));
+    }
+    std::sort(rows.begin(), rows.end(), std::greater<std::pair<double, unsigned int> >());
+    for (size_t rowIndex = 0; rowIndex < rows.size() && rowIndex < REPORT_ROW_COUNT; rowIndex++)
+    {
+        double share = rows[rowIndex].first / totalSteps;
+        if (share <= 0.0)
+        {
+            break;
+        }
+        LogPrintf("cost system  %-3u %5.1f%% %12.0f particle steps per step, ~%.3f ms\n",
+            rows[rowIndex].second, share * 100.0, rows[rowIndex].first, share * updateMs);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes the newest slot whose fence has signaled as the latest costs and frees every
+    finished slot.  Never waits.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleCostAttribution::CollectFinishedSlots()
+{
+    // oldest first, so the newest finished one is the one that sticks
+    for (unsigned int slotOffset = 0; slotOffset < COST_READBACK_SLOTS; slotOffset++)
+    {
+        unsigned int slotIndex = (_nextSlot + slotOffset) % COST_READBACK_SLOTS;
+        if (_fences[slotIndex] == 0)
+        {
+            continue;
+        }
+
+        if (!IsGlFenceSignaled(_fences[slotIndex]))
+        {
+            // the later ones can't be done either
+            break;
+        }
+
+        const unsigned int *counts = _mappedReadback + (slotIndex * _maxEmitterCount);
+        double stepCount = (double)_slotStepCounts[slotIndex];
+        _latestStepsPerUpdate.resize(_maxEmitterCount);
+        for (unsigned int emitterIndex = 0; emitterIndex < _maxEmitterCount; emitterIndex++)
+        {
+            _latestStepsPerUpdate[emitterIndex] = counts[emitterIndex] / stepCount;
+        }
+        _hasCosts = true;
+        _fences[slotIndex].Reset();
+    }
+}
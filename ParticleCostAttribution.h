@@ -0,0 +1,75 @@
+#pragma once
+
+#include "GlObjects.h"
+
+#include <vector>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Says which emitters, and which systems of emitters, the update is spending its time on.
+    Once many emitters share one batched dispatch (see ParticleWorld.h), the GPU profiler's
+    update scope can only time all of them together, so this splits that time up by what
+    each emitter's particles did in it.
+
+    With a program built with ParticleKernelVariant::_hasCostAttribution, the update counts
+    every particle that it integrates into its emitter's counter, with the same aggregated
+    atomics as the dead stacks, so one atomic per work group or subgroup covers every
+    particle of an emitter in it.  Every so many updates (see SetInterval(...)), the counters
+    are copied into a ring of persistently mapped slots with a fence each, like the stats
+    reducer's (see ParticleStatsReducer.h), and cleared, and the CPU reads them on a later
+    frame without waiting.  Each emitter's share of the particle steps is its share of the
+    update's time, as near as anything short of timing it alone can say, since the update's
+    cost goes with the particles that it integrates.
+
+    PrintReport(...) prints the costliest emitters and systems next to the GPU timings, with
+    each one's share of the update's time in milliseconds, so that whoever made an effect can
+    find out that it is the expensive one.
+
+    Note: The particles that a split or CPU backend updates on the CPU (see
+    ParticleManager::SetSimulationBackend(...)) aren't counted, and neither are the sleeping
+    ones, which cost next to nothing.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class ParticleCostAttribution
+{
+public:
+    ParticleCostAttribution();
+    ~ParticleCostAttribution();
+    void Init(unsigned int maxEmitterCount);
+    void Cleanup();
+
+    void SetInterval(unsigned int updatesPerSample);
+    void BeginUpdate();
+    void EndUpdate(unsigned int numSteps);
+    bool GetLatestStepsPerUpdate(std::vector<double> *putStepsHere) const;
+    void PrintReport(const std::vector<unsigned int> &firstEmitterOfEachSystem,
+        float updateMs) const;
+
+    // the most emitters and systems that a report prints
+    static const unsigned int REPORT_ROW_COUNT = 8;
+
+private:
+    void CollectFinishedSlots();
+
+    // Note: The binding must match shaderParticle.comp.  It comes after the density surface's
+    // contours (see DensitySurfaceRenderer.h).
+    static const unsigned int EMITTER_STEP_COUNT_BUFFER_BINDING = 65;
+    GlBuffer _countBufferId;
+    unsigned int _maxEmitterCount;
+
+    // 3 frames of GPU latency, plus 1 for the one that is being written
+    static const unsigned int COST_READBACK_SLOTS = 4;
+    GlBuffer _readbackBufferId;
+    const unsigned int *_mappedReadback;
+    GlFence _fences[COST_READBACK_SLOTS];
+    unsigned int _slotStepCounts[COST_READBACK_SLOTS];
+    unsigned int _nextSlot;
+
+    // the update steps that the counters have added up since they were last copied
+    unsigned int _interval;
+    unsigned int _updatesSinceSample;
+    unsigned int _stepsSinceSample;
+
+    std::vector<double> _latestStepsPerUpdate;
+    bool _hasCosts;
+};
@@ -0,0 +1,978 @@
+#include "ParticleDomainShard.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "StreamSockets.h"
+#include "ComputeDeviceCaps.h"
+#include "GlStateCache.h"
+#include "GlFenceSync.h"
+#include "GpuMemoryLedger.h"
+#include "OpenGlErrorHandling.h"
+#include "ThreadPlacement.h"
+#include "TraceTimeline.h"
+#include "Log.h"
+
+#include <chrono>
+#include <stdlib.h>     // atoi
+#include <string.h>     // memcpy
+
+// the front of each batch on the wire, and then _recordCount ParticleInjectionRecords
+// Note: Both are nothing but 32-bit words, and every word goes over the wire in network byte 
+// order (see WriteWireWords(...)), so nodes of either endianness can be neighbors.
+struct ParticleMigrationBatchHeader
+{
+    unsigned int _magic;
+    unsigned int _fromNode;
+    unsigned int _batchIndex;
+    unsigned int _recordCount;
+};
+
+static const size_t MIGRATION_HEADER_WORDS = 
+    sizeof(ParticleMigrationBatchHeader) / sizeof(unsigned int);
+static const size_t MIGRATION_RECORD_WORDS = 
+    sizeof(ParticleInjectionRecord) / sizeof(unsigned int);
+static_assert(sizeof(float) == sizeof(unsigned int), "the records' floats must be 32-bit words");
+
+static const unsigned int PARTICLE_MIGRATION_MAGIC = 0x5247494D;   // "MIGR"
+
+// must match the front of MigrationBuffer in shaderParticle.comp: the two counts and padding
+// up to the first record
+static const size_t MIGRATION_SLOT_HEADER_BYTES = 16;
+
+// how often to try node i + 1 again while it isn't up yet
+static const double MIGRATION_CONNECT_RETRY_SEC = 0.5;
+
+// how long the network thread waits for something to do, so that it sees Cleanup() soon
+static const long MIGRATION_POLL_MICROSECONDS = 2000;
+
+// arrivals that are waiting for the injection ring, in frames' worth of migrants, beyond which
+// they are dropped
+static const unsigned int MIGRATION_MAX_QUEUED_FRAMES = 8;
+
+// the most records in one batch on the wire; a bigger queue goes out in several batches, and 
+// a neighbor that claims a bigger batch is dropped
+// Note: A fixed limit rather than _maxMigrantsPerFrame, since the neighbors' settings may 
+// differ.  1MB of records.
+static const unsigned int MIGRATION_MAX_BATCH_RECORDS = 65536;
+
+// how far the received bytes may get ahead of the parsing, beyond which the rest is left in
+// the socket until the whole batches have been taken out; a few of the biggest batches
+static const size_t MIGRATION_MAX_RECEIVED_BYTES = 4 * (sizeof(ParticleMigrationBatchHeader) +
+    (MIGRATION_MAX_BATCH_RECORDS * sizeof(ParticleInjectionRecord)));
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Copies 32-bit words (unsigned integers or floats) into a send buffer in network byte 
+    order.
+Parameters:
+    words       Self-explanatory.  Need not be aligned.
+    wordCount   Self-explanatory.
+    putBytesHere    Room for 4 bytes per word.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static void WriteWireWords(const void *words, size_t wordCount, unsigned char *putBytesHere)
+{
+    const unsigned char *wordBytes = (const unsigned char *)words;
+    for (size_t wordIndex = 0; wordIndex < wordCount; wordIndex++)
+    {
+        unsigned int word = 0;
+        memcpy(&word, wordBytes + (wordIndex * sizeof(word)), sizeof(word));
+        word = htonl(word);
+        memcpy(putBytesHere + (wordIndex * sizeof(word)), &word, sizeof(word));
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Undoes WriteWireWords(...).
+Parameters:
+    bytes       4 bytes per word, in network byte order.
+    wordCount   Self-explanatory.
+    putWordsHere    Room for the words.  Need not be aligned.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static void ReadWireWords(const unsigned char *bytes, size_t wordCount, void *putWordsHere)
+{
+    unsigned char *wordBytes = (unsigned char *)putWordsHere;
+    for (size_t wordIndex = 0; wordIndex < wordCount; wordIndex++)
+    {
+        unsigned int word = 0;
+        memcpy(&word, bytes + (wordIndex * sizeof(word)), sizeof(word));
+        word = ntohl(word);
+        memcpy(wordBytes + (wordIndex * sizeof(word)), &word, sizeof(word));
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    A single node with no neighbors, over the whole window, with arrivals going to the first
+    emitter.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleDomainSettings GetDefaultParticleDomainSettings()
+{
+    ParticleDomainSettings settings;
+    settings._nodeIndex = 0;
+    settings._worldMinCorner = glm::vec2(-1.0f, -1.0f);
+    settings._worldMaxCorner = glm::vec2(+1.0f, +1.0f);
+    settings._inboundEmitterIndex = 0;
+    settings._maxMigrantsPerFrame = 16384;
+    return settings;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.  Nothing migrates until Init(...).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleDomainShard::ParticleDomainShard() :
+    _migrationWorkGroupSizeX(ParticleManager::DEFAULT_WORK_GROUP_SIZE),
+    _unifLocMigrationParticleCount(0),
+    _unifLocMigrationEmitterCount(0),
+    _unifLocMigrationCapacity(0),
+    _unifLocMigrationMinX(0),
+    _unifLocMigrationMaxX(0),
+    _unifLocMigrateLeft(0),
+    _unifLocMigrateRight(0),
+    _settings(GetDefaultParticleDomainSettings()),
+    _inboundRing(0),
+    _regionMinX(0.0f),
+    _regionMaxX(0.0f),
+    _isActive(false),
+    _mapped(0),
+    _slotSizeBytes(0),
+    _slotStrideBytes(0),
+    _nextSlot(0),
+    _isStopping(false),
+    _batchIndex(0),
+    _sentCount(0),
+    _receivedCount(0),
+    _droppedCount(0)
+{
+    for (unsigned int side = 0; side < MIGRATION_SIDE_COUNT; side++)
+    {
+        _isLinkUp[side] = false;
+        _links[side]._socket = -1;
+        _links[side]._sentBytes = 0;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.  The network
+    thread must be joined before the std::thread is destroyed, or the program is terminated.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleDomainShard::~ParticleDomainShard()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Works out this node's slab, makes the readback ring, and starts the network thread, which
+    starts listening for the left neighbor and connecting to the right one.
+Parameters:
+    migrationProgramId  shaderParticle.comp generated with GetMigrationShaderDefines(...).
+                        Must be built for the same particle layout as the particle manager's
+                        program.  A reference is taken (see ShaderProgramRegistry.h).
+    settings            Needs at least 2 addresses, and one for this node.
+    inboundRing         Where the neighbors' particles are injected.  Must be the particle
+                        manager's (see ParticleManager::SetInjectionRing(...)) and outlive
+                        this.
+Returns:
+    False if any of that is missing or the device doesn't have enough shader storage
+    bindings, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleDomainShard::Init(unsigned int migrationProgramId,
+    const ParticleDomainSettings &settings, ParticleInjectionRing *inboundRing)
+{
+    this->Cleanup();
+    unsigned int nodeCount = (unsigned int)settings._nodeAddresses.size();
+    if (migrationProgramId == 0 || inboundRing == 0 || nodeCount < 2 ||
+        settings._nodeIndex >= nodeCount || settings._maxMigrantsPerFrame == 0 ||
+        settings._worldMaxCorner.x <= settings._worldMinCorner.x)
+    {
+        LogPrintf("domain shard: needs its program, the injection ring, and node %u of at "
+            "least 2\n", settings._nodeIndex);
+        return false;
+    }
+
+    // the binding comes after everyone else's
+    GLint maxBindings = 0;
+    glGetIntegerv(GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS, &maxBindings);
+    if (maxBindings <= (GLint)MIGRATION_BUFFER_BINDING)
+    {
+        LogPrintf("the domain shard needs %u shader storage bindings, but there are only "
+            "%d\n", MIGRATION_BUFFER_BINDING + 1, maxBindings);
+        return false;
+    }
+
+    if (!StartStreamSockets())
+    {
+        LogPrintf("domain shard: couldn't start the socket library\n");
+        return false;
+    }
+
+    _settings = settings;
+    _inboundRing = inboundRing;
+
+    // the last slab ends exactly at the edge, whatever the rounding did to the others
+    float slabWidth = (settings._worldMaxCorner.x - settings._worldMinCorner.x) / nodeCount;
+    _regionMinX = settings._worldMinCorner.x + (slabWidth * settings._nodeIndex);
+    _regionMaxX = (settings._nodeIndex + 1 == nodeCount) ? settings._worldMaxCorner.x :
+        settings._worldMinCorner.x + (slabWidth * (settings._nodeIndex + 1));
+
+    _migrationProgramId = ReferenceGlProgram(migrationProgramId);
+    this->LoadProgramInterface();
+
+    // each slot is bound as a range, so it must start on the storage buffer offset alignment
+    GLint offsetAlignment = 0;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+    if (offsetAlignment <= 0)
+    {
+        offsetAlignment = 256;
+    }
+    _slotSizeBytes = MIGRATION_SLOT_HEADER_BYTES + ((size_t)MIGRATION_SIDE_COUNT *
+        settings._maxMigrantsPerFrame * sizeof(ParticleInjectionRecord));
+    _slotStrideBytes = ((_slotSizeBytes + offsetAlignment - 1) / offsetAlignment) *
+        offsetAlignment;
+
+    // Note: Coherent, so once a slot's fence is signaled, it can be read with no barrier and
+    // no unmapping.
+    GLbitfield storageFlags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    _migrationBufferId = GenerateGlBuffer();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _migrationBufferId);
+    LabelGlObject(GL_BUFFER, _migrationBufferId, "particle migration ring");
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, MIGRATION_SLOTS * _slotStrideBytes, 0,
+        storageFlags);
+    RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particle migration ring");
+    _mapped = (const unsigned char *)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0,
+        MIGRATION_SLOTS * _slotStrideBytes, storageFlags);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    if (_mapped == 0)
+    {
+        LogPrintf("failed to map the particle migration ring\n");
+        _migrationBufferId.Reset();
+        _migrationProgramId.Reset();
+        StopStreamSockets();
+        return false;
+    }
+
+    _isActive = true;
+    _isStopping = false;
+    _nextSlot = 0;
+    _batchIndex = 0;
+    _sentCount = 0;
+    _receivedCount = 0;
+    _droppedCount = 0;
+    _networkThread = std::thread(&ParticleDomainShard::NetworkLoop, this);
+    LogPrintf("domain shard: node %u of %u, x from %.3f to %.3f\n", settings._nodeIndex,
+        nodeCount, _regionMinX, _regionMaxX);
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Stops the network thread, hangs up on the neighbors, and deletes the readback ring.  The
+    particles that are in flight are lost.  Safe to call more than once.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleDomainShard::Cleanup()
+{
+    if (!_isActive)
+    {
+        return;
+    }
+
+    _isStopping = true;
+    _networkThread.join();
+    _isActive = false;
+
+    // deleting a buffer unmaps it
+    for (unsigned int slotIndex = 0; slotIndex < MIGRATION_SLOTS; slotIndex++)
+    {
+        _slotFences[slotIndex].Reset();
+    }
+    _readingSlots.clear();
+    _migrationBufferId.Reset();
+    _mapped = 0;
+    _migrationProgramId.Reset();
+    for (unsigned int side = 0; side < MIGRATION_SIDE_COUNT; side++)
+    {
+        _outbound[side].clear();
+    }
+    _arrivals.clear();
+    _inboundRing = 0;
+    StopStreamSockets();
+
+    LogPrintf("domain shard: %llu particles sent, %llu received, %llu dropped\n",
+        _sentCount.load(), _receivedCount.load(), _droppedCount.load());
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Switches to a rebuilt program (see ParticleManager::ReplaceProgram(...)).
+Parameters:
+    oldProgramId    Self-explanatory.  Programs that this shard doesn't use are ignored.
+    newProgramId    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleDomainShard::ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId)
+{
+    if (oldProgramId == 0 || newProgramId == 0 || _migrationProgramId != oldProgramId)
+    {
+        return;
+    }
+
+    _migrationProgramId = ReferenceGlProgram(newProgramId);
+    this->LoadProgramInterface();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    True if Init(...) succeeded and Cleanup() hasn't been called since, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleDomainShard::IsActive() const
+{
+    return _isActive;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Queues the particles of the slots that the GPU has finished with for the neighbors, and
+    then writes out and kills the particles that have left the slab this frame.  Call after
+    everything that moves the particles is done for the frame.  Never waits.
+
+    Only runs with the GPU backend and outside of deterministic and fused emit runs, like the
+    merge (see ParticleNeighborGrid::MergeDenseCells(...)), since it kills particles on the
+    GPU between updates.
+Parameters:
+    particleManager     The manager whose pool this node simulates.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleDomainShard::MigrateParticles(ParticleManager &particleManager)
+{
+    if (!_isActive)
+    {
+        return;
+    }
+    this->ReadFinishedSlots();
+
+    if (particleManager.GetSimulationBackend() != PARTICLE_SIMULATION_BACKEND_GPU ||
+        particleManager.IsDeterministic() || particleManager.IsFusedEmitUpdateActive())
+    {
+        return;
+    }
+
+    // a side whose link is down or whose last frames haven't gone out yet keeps its particles
+    bool isMigrating[MIGRATION_SIDE_COUNT];
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (unsigned int side = 0; side < MIGRATION_SIDE_COUNT; side++)
+        {
+            isMigrating[side] = _isLinkUp[side] &&
+                _outbound[side].size() < _settings._maxMigrantsPerFrame;
+        }
+    }
+    if (!isMigrating[MIGRATION_SIDE_LEFT] && !isMigrating[MIGRATION_SIDE_RIGHT])
+    {
+        return;
+    }
+
+    // the slots are used in turn, so if the next one is still being read, they all are
+    unsigned int slotIndex = _nextSlot;
+    if (_slotFences[slotIndex] != 0)
+    {
+        return;
+    }
+    _nextSlot = (_nextSlot + 1) % MIGRATION_SLOTS;
+
+    // Note: The clear is a command on the buffer, so it needs no barrier before the dispatch.
+    GLintptr slotOffset = (GLintptr)(slotIndex * _slotStrideBytes);
+    GLuint zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _migrationBufferId);
+    glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, slotOffset,
+        MIGRATION_SLOT_HEADER_BYTES, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    BindGlShaderStorageBufferRange(MIGRATION_BUFFER_BINDING, _migrationBufferId, slotOffset,
+        _slotSizeBytes);
+
+    unsigned int maxParticleCount = particleManager.GetMaxParticleCount();
+    unsigned int numWorkGroups =
+        (maxParticleCount + _migrationWorkGroupSizeX - 1) / _migrationWorkGroupSizeX;
+    unsigned int numWorkGroupsX = 0;
+    unsigned int numWorkGroupsY = 0;
+    GetComputeDispatchSize(numWorkGroups, &numWorkGroupsX, &numWorkGroupsY);
+    UseGlProgram(_migrationProgramId);
+    glUniform1ui(_unifLocMigrationParticleCount, maxParticleCount);
+    glUniform1ui(_unifLocMigrationEmitterCount,
+        (unsigned int)particleManager.GetEmitters().size());
+    glUniform1ui(_unifLocMigrationCapacity, _settings._maxMigrantsPerFrame);
+    glUniform1f(_unifLocMigrationMinX, _regionMinX);
+    glUniform1f(_unifLocMigrationMaxX, _regionMaxX);
+    glUniform1ui(_unifLocMigrateLeft, isMigrating[MIGRATION_SIDE_LEFT] ? 1 : 0);
+    glUniform1ui(_unifLocMigrateRight, isMigrating[MIGRATION_SIDE_RIGHT] ? 1 : 0);
+    if (numWorkGroupsX > 0)
+    {
+        glDispatchCompute(numWorkGroupsX, numWorkGroupsY, 1);
+    }
+    UseGlProgram(0);
+
+    // the mapping is read once the fence has signaled, and the dead stacks and the active
+    // mask are read by the next emit pass, same as the merge
+    glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT |
+        GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+    _slotFences[slotIndex] = InsertGlFence();
+    _readingSlots.push_back(slotIndex);
+    particleManager.InvalidateUpdateList();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The particles that were handed to the network since Init(...).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned long long ParticleDomainShard::GetSentCount() const
+{
+    return _sentCount.load();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The particles that the neighbors sent since Init(...), whether or not they have been
+    injected yet.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned long long ParticleDomainShard::GetReceivedCount() const
+{
+    return _receivedCount.load();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The particles that were lost since Init(...), on a link that dropped or because the
+    injection ring stayed full.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned long long ParticleDomainShard::GetDroppedCount() const
+{
+    return _droppedCount.load();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Puts the migration pass's #define after the particle layout's (see
+    ParticleManager::GetComputeShaderDefines(...)).
+Parameters:
+    layout          Must be the particle manager's.
+    workGroupSize   Self-explanatory.
+Returns:
+    A block of #defines for GenerateComputeShaderProgram(...).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+std::string ParticleDomainShard::GetMigrationShaderDefines(ParticleLayout layout,
+    unsigned int workGroupSize)
+{
+    return ParticleManager::GetComputeShaderDefines(layout, workGroupSize) +
+        "#define PARTICLE_MIGRATION_PASS\n";
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Looks up the migration program's uniforms and work group size.  Called by Init(...) and
+    whenever the program is replaced.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleDomainShard::LoadProgramInterface()
+{
+    _unifLocMigrationParticleCount = glGetUniformLocation(_migrationProgramId,
+        "uMigrationParticleCount");
+    _unifLocMigrationEmitterCount = glGetUniformLocation(_migrationProgramId,
+        "uMigrationEmitterCount");
+    _unifLocMigrationCapacity = glGetUniformLocation(_migrationProgramId,
+        "uMigrationCapacity");
+    _unifLocMigrationMinX = glGetUniformLocation(_migrationProgramId, "uMigrationMinX");
+    _unifLocMigrationMaxX = glGetUniformLocation(_migrationProgramId, "uMigrationMaxX");
+    _unifLocMigrateLeft = glGetUniformLocation(_migrationProgramId, "uMigrateLeft");
+    _unifLocMigrateRight = glGetUniformLocation(_migrationProgramId, "uMigrateRight");
+
+    // same as ParticleManager::Init(...); the stride must match the program
+    GLint programWorkGroupSize[3] = { 0, 0, 0 };
+    glGetProgramiv(_migrationProgramId, GL_COMPUTE_LOCAL_WORK_SIZE, programWorkGroupSize);
+    _migrationWorkGroupSizeX = (programWorkGroupSize[0] > 0) ?
+        programWorkGroupSize[0] : ParticleManager::DEFAULT_WORK_GROUP_SIZE;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Queues the particles of every slot whose fence has signaled for the network thread,
+    oldest first, so that they go out in the order that they left.  Stops at the first slot
+    that isn't done.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleDomainShard::ReadFinishedSlots()
+{
+    while (!_readingSlots.empty())
+    {
+        unsigned int slotIndex = _readingSlots.front();
+        if (!IsGlFenceSignaled(_slotFences[slotIndex]))
+        {
+            break;
+        }
+        _slotFences[slotIndex].Reset();
+        _readingSlots.pop_front();
+
+        const unsigned char *slot = _mapped + (slotIndex * _slotStrideBytes);
+        const unsigned int *counts = (const unsigned int *)slot;
+        const ParticleInjectionRecord *records =
+            (const ParticleInjectionRecord *)(slot + MIGRATION_SLOT_HEADER_BYTES);
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (unsigned int side = 0; side < MIGRATION_SIDE_COUNT; side++)
+        {
+            // the counts keep going past the capacity (see MigrateParticles() in
+            // shaderParticle.comp)
+            unsigned int count = (counts[side] < _settings._maxMigrantsPerFrame) ?
+                counts[side] : _settings._maxMigrantsPerFrame;
+            const ParticleInjectionRecord *sideRecords =
+                records + (side * _settings._maxMigrantsPerFrame);
+            _outbound[side].insert(_outbound[side].end(), sideRecords, sideRecords + count);
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The network thread.  Keeps the links to the neighbors up, sends each side's queued
+    particles as one batch as soon as the last one has gone out, and injects whatever comes
+    in, until it is told to stop.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleDomainShard::NetworkLoop()
+{
+    SetTraceThreadName("domain shard network");
+    PlaceWorkerThread();
+
+    // node 0 has no left neighbor to listen for
+    long long listenSocket = -1;
+    if (_settings._nodeIndex > 0)
+    {
+        const std::string &address = _settings._nodeAddresses[_settings._nodeIndex];
+        size_t colonIndex = address.rfind(':');
+        unsigned short port = (colonIndex == std::string::npos) ? 0 :
+            (unsigned short)atoi(address.c_str() + colonIndex + 1);
+        listenSocket = (port == 0) ? -1 : ListenOnStreamPort(port, 1);
+        if (listenSocket == -1)
+        {
+            LogPrintf("domain shard: couldn't listen on '%s'\n", address.c_str());
+        }
+    }
+
+    double nextConnectSec = 0.0;
+    while (!_isStopping)
+    {
+        this->ConnectLinks(listenSocket, &nextConnectSec);
+
+        // the GL thread's queue is only taken once the last batch is out, so a slow link
+        // leaves it full and the GL thread stops migrating to that side
+        for (unsigned int side = 0; side < MIGRATION_SIDE_COUNT; side++)
+        {
+            Link &link = _links[side];
+            if (link._socket == -1 || !link._pendingSend.empty())
+            {
+                continue;
+            }
+            {
+                // whatever doesn't fit in one batch goes back to the front of the queue
+                std::lock_guard<std::mutex> lock(_mutex);
+                _sendRecords.swap(_outbound[side]);
+                if (_sendRecords.size() > MIGRATION_MAX_BATCH_RECORDS)
+                {
+                    _outbound[side].insert(_outbound[side].begin(),
+                        _sendRecords.begin() + MIGRATION_MAX_BATCH_RECORDS, _sendRecords.end());
+                    _sendRecords.resize(MIGRATION_MAX_BATCH_RECORDS);
+                }
+            }
+            if (_sendRecords.empty())
+            {
+                continue;
+            }
+
+            ParticleMigrationBatchHeader header;
+            header._magic = PARTICLE_MIGRATION_MAGIC;
+            header._fromNode = _settings._nodeIndex;
+            header._batchIndex = _batchIndex++;
+            header._recordCount = (unsigned int)_sendRecords.size();
+            size_t recordBytes = _sendRecords.size() * sizeof(ParticleInjectionRecord);
+            link._pendingSend.resize(sizeof(header) + recordBytes);
+            WriteWireWords(&header, MIGRATION_HEADER_WORDS, link._pendingSend.data());
+            WriteWireWords(_sendRecords.data(), _sendRecords.size() * MIGRATION_RECORD_WORDS,
+                link._pendingSend.data() + sizeof(header));
+            link._sentBytes = 0;
+            _sentCount += _sendRecords.size();
+            _sendRecords.clear();
+        }
+
+        // wait until there is something to read or room to send, or a little while
+        fd_set readSockets;
+        fd_set writeSockets;
+        FD_ZERO(&readSockets);
+        FD_ZERO(&writeSockets);
+        long long maxSocket = -1;
+        if (listenSocket != -1)
+        {
+            FD_SET((StreamSocket)listenSocket, &readSockets);
+            maxSocket = listenSocket;
+        }
+        for (unsigned int side = 0; side < MIGRATION_SIDE_COUNT; side++)
+        {
+            const Link &link = _links[side];
+            if (link._socket == -1)
+            {
+                continue;
+            }
+            FD_SET((StreamSocket)link._socket, &readSockets);
+            if (!link._pendingSend.empty())
+            {
+                FD_SET((StreamSocket)link._socket, &writeSockets);
+            }
+            maxSocket = (link._socket > maxSocket) ? link._socket : maxSocket;
+        }
+        timeval timeout;
+        timeout.tv_sec = 0;
+        timeout.tv_usec = MIGRATION_POLL_MICROSECONDS;
+        if (maxSocket != -1)
+        {
+            select((int)maxSocket + 1, &readSockets, &writeSockets, 0, &timeout);
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(MIGRATION_POLL_MICROSECONDS));
+        }
+
+        for (unsigned int side = 0; side < MIGRATION_SIDE_COUNT; side++)
+        {
+            if (_links[side]._socket != -1 &&
+                (!this->SendPending(side) || !this->ReceivePending(side)))
+            {
+                this->CloseLink(side);
+            }
+        }
+        this->InjectArrivals();
+    }
+
+    for (unsigned int side = 0; side < MIGRATION_SIDE_COUNT; side++)
+    {
+        this->CloseLink(side);
+    }
+    CloseStreamSocket(listenSocket);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes the left neighbor if it is waiting to connect, and tries the right one if it is
+    time to.  A second left neighbor is turned away.
+
+    Note: Runs on the network thread.  The connect waits on the network, but only until the
+    right neighbor answers or refuses, which is quick on the networks that this is for.
+Parameters:
+    listenSocket    For the left neighbor, or -1 for none.
+    nextConnectSec  When to try the right neighbor again.  Updated.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleDomainShard::ConnectLinks(long long listenSocket, double *nextConnectSec)
+{
+    if (listenSocket != -1)
+    {
+        StreamSocket acceptedSocket = accept((StreamSocket)listenSocket, 0, 0);
+        long long acceptedSocketId = (long long)acceptedSocket;
+        if (acceptedSocketId != -1)
+        {
+            if (_links[MIGRATION_SIDE_LEFT]._socket != -1 ||
+                !SetStreamSocketNonBlocking(acceptedSocketId))
+            {
+                LogPrintf("domain shard: turned a second left neighbor away\n");
+                CloseStreamSocket(acceptedSocketId);
+            }
+            else
+            {
+                SetStreamSocketNoDelay(acceptedSocketId);
+                _links[MIGRATION_SIDE_LEFT]._socket = acceptedSocketId;
+                _isLinkUp[MIGRATION_SIDE_LEFT] = true;
+                LogPrintf("domain shard: node %u connected\n", _settings._nodeIndex - 1);
+            }
+        }
+    }
+
+    unsigned int rightNode = _settings._nodeIndex + 1;
+    double nowSec = GetStreamTimeSec();
+    if (rightNode >= _settings._nodeAddresses.size() ||
+        _links[MIGRATION_SIDE_RIGHT]._socket != -1 || nowSec < *nextConnectSec)
+    {
+        return;
+    }
+    *nextConnectSec = nowSec + MIGRATION_CONNECT_RETRY_SEC;
+    long long connectedSocket = ConnectStreamSocket(_settings._nodeAddresses[rightNode]);
+    if (connectedSocket == -1)
+    {
+        return;
+    }
+    if (!SetStreamSocketNonBlocking(connectedSocket))
+    {
+        CloseStreamSocket(connectedSocket);
+        return;
+    }
+    SetStreamSocketNoDelay(connectedSocket);
+    _links[MIGRATION_SIDE_RIGHT]._socket = connectedSocket;
+    _isLinkUp[MIGRATION_SIDE_RIGHT] = true;
+    LogPrintf("domain shard: connected to node %u\n", rightNode);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Hangs up on a neighbor, and counts the particles that were on their way to it as dropped.
+    The GL thread stops migrating to that side until the link is back.  Safe to call more
+    than once.
+
+    Note: Runs on the network thread.
+Parameters:
+    side    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleDomainShard::CloseLink(unsigned int side)
+{
+    Link &link = _links[side];
+    if (link._socket == -1)
+    {
+        return;
+    }
+
+    _isLinkUp[side] = false;
+    CloseStreamSocket(link._socket);
+    link._socket = -1;
+    if (link._pendingSend.size() > sizeof(ParticleMigrationBatchHeader))
+    {
+        _droppedCount += (link._pendingSend.size() - sizeof(ParticleMigrationBatchHeader)) /
+            sizeof(ParticleInjectionRecord);
+    }
+    link._pendingSend.clear();
+    link._sentBytes = 0;
+    link._received.clear();
+
+    // and whatever was queued since
+    std::lock_guard<std::mutex> lock(_mutex);
+    _droppedCount += _outbound[side].size();
+    _outbound[side].clear();
+    LogPrintf("domain shard: lost the link to the %s neighbor\n",
+        (side == MIGRATION_SIDE_LEFT) ? "left" : "right");
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sends as much of a neighbor's batch as the socket will take.
+
+    Note: Runs on the network thread.
+Parameters:
+    side    Self-explanatory.
+Returns:
+    False if the neighbor hung up, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleDomainShard::SendPending(unsigned int side)
+{
+    Link &link = _links[side];
+    while (link._sentBytes < link._pendingSend.size())
+    {
+        size_t remainingBytes = link._pendingSend.size() - link._sentBytes;
+        int sentBytes = (int)send((StreamSocket)link._socket,
+            (const char *)link._pendingSend.data() + link._sentBytes, (int)remainingBytes,
+            MSG_NOSIGNAL);
+        if (sentBytes > 0)
+        {
+            link._sentBytes += (size_t)sentBytes;
+        }
+        else
+        {
+            return IsStreamSocketWouldBlock();
+        }
+    }
+
+    // ready for the next batch
+    link._pendingSend.clear();
+    link._sentBytes = 0;
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Reads what a neighbor has sent, up to MIGRATION_MAX_RECEIVED_BYTES of it, and queues the 
+    particles of every whole batch in it for injection.
+
+    Note: Runs on the network thread.
+Parameters:
+    side    Self-explanatory.
+Returns:
+    False if the neighbor hung up or sent something that isn't a batch (or a batch that is too
+    big), otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleDomainShard::ReceivePending(unsigned int side)
+{
+    Link &link = _links[side];
+    unsigned char buffer[64 * 1024];
+    while (link._received.size() < MIGRATION_MAX_RECEIVED_BYTES)
+    {
+        int receivedBytes = (int)recv((StreamSocket)link._socket, (char *)buffer,
+            (int)sizeof(buffer), 0);
+        if (receivedBytes > 0)
+        {
+            link._received.insert(link._received.end(), buffer, buffer + receivedBytes);
+        }
+        else if (receivedBytes < 0 && IsStreamSocketWouldBlock())
+        {
+            break;
+        }
+        else
+        {
+            // 0 is an orderly hang up
+            return false;
+        }
+    }
+
+    size_t consumedBytes = 0;
+    while (link._received.size() - consumedBytes >= sizeof(ParticleMigrationBatchHeader))
+    {
+        ParticleMigrationBatchHeader header;
+        ReadWireWords(link._received.data() + consumedBytes, MIGRATION_HEADER_WORDS, &header);
+        if (header._magic != PARTICLE_MIGRATION_MAGIC)
+        {
+            LogPrintf("domain shard: the %s neighbor sent something that isn't a batch\n",
+                (side == MIGRATION_SIDE_LEFT) ? "left" : "right");
+            return false;
+        }
+        if (header._recordCount > MIGRATION_MAX_BATCH_RECORDS)
+        {
+            LogPrintf("domain shard: the %s neighbor sent a batch of %u particles, which is "
+                "more than any node sends\n", (side == MIGRATION_SIDE_LEFT) ? "left" : "right",
+                header._recordCount);
+            return false;
+        }
+        size_t batchBytes = sizeof(header) +
+            ((size_t)header._recordCount * sizeof(ParticleInjectionRecord));
+        if (link._received.size() - consumedBytes < batchBytes)
+        {
+            break;
+        }
+
+        const unsigned char *recordBytes = link._received.data() + consumedBytes + sizeof(header);
+        for (unsigned int recordIndex = 0; recordIndex < header._recordCount; recordIndex++)
+        {
+            ParticleInjectionRecord record;
+            ReadWireWords(recordBytes + (recordIndex * sizeof(record)), MIGRATION_RECORD_WORDS,
+                &record);
+            _arrivals.push_back(record);
+        }
+        _receivedCount += header._recordCount;
+        consumedBytes += batchBytes;
+    }
+    link._received.erase(link._received.begin(), link._received.begin() + consumedBytes);
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Writes the queued arrivals into as many injection ring slots as it can get.  Whatever
+    doesn't fit waits for the next loop, unless the queue has grown past what a few frames'
+    worth of migrants could ever need, and then the oldest are dropped.
+
+    Note: Runs on the network thread.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleDomainShard::InjectArrivals()
+{
+    while (!_arrivals.empty())
+    {
+        unsigned int slotIndex = 0;
+        ParticleInjectionRecord *records = _inboundRing->BeginWrite(&slotIndex);
+        if (records == 0)
+        {
+            break;
+        }
+        unsigned int recordsPerSlot = _inboundRing->GetRecordsPerSlot();
+        unsigned int recordCount = (_arrivals.size() < recordsPerSlot) ?
+            (unsigned int)_arrivals.size() : recordsPerSlot;
+        for (unsigned int recordIndex = 0; recordIndex < recordCount; recordIndex++)
+        {
+            records[recordIndex] = _arrivals[recordIndex];
+        }
+        _arrivals.erase(_arrivals.begin(), _arrivals.begin() + recordCount);
+        _inboundRing->EndWrite(slotIndex, _settings._inboundEmitterIndex, recordCount);
+    }
+
+    size_t maxQueued = (size_t)MIGRATION_MAX_QUEUED_FRAMES * MIGRATION_SIDE_COUNT *
+        _settings._maxMigrantsPerFrame;
+    if (_arrivals.size() > maxQueued)
+    {
+        size_t dropCount = _arrivals.size() - maxQueued;
+        _arrivals.erase(_arrivals.begin(), _arrivals.begin() + dropCount);
+        _droppedCount += dropCount;
+    }
+}
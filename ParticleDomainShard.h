@@ -0,0 +1,155 @@
+#pragma once
+
+#include "ParticleManager.h"
+#include "ParticleInjectionRing.h"
+#include "GlObjects.h"
+
+#include "glm/vec2.hpp"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+// where this process sits in a distributed run (see ParticleDomainShard)
+struct ParticleDomainSettings
+{
+    unsigned int _nodeIndex;
+    std::vector<std::string> _nodeAddresses;    // every node's "host:port", left to right
+    glm::vec2 _worldMinCorner;                  // the rectangle that the nodes split up
+    glm::vec2 _worldMaxCorner;
+    unsigned int _inboundEmitterIndex;          // whose range of the pool arrivals go into
+    unsigned int _maxMigrantsPerFrame;          // per side
+};
+
+ParticleDomainSettings GetDefaultParticleDomainSettings();
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    One node of a simulation that is split across machines.  The world is cut into as many
+    slabs along X as there are nodes, and each node simulates its own slab with its own
+    particle pool, so the particle count grows with the node count.  A particle that leaves
+    through a side that has a neighbor is handed to that neighbor over TCP, and the renderer
+    puts the nodes' streams back together (see ParticleStreamGather).
+
+    Every frame, MigrateParticles(...) dispatches a pass of the migration program that writes
+    the particles that have left into one slot of a ring of persistently mapped buffers and
+    kills them, and fences the slot.  Once a slot's fence has signaled, its particles are
+    queued for the network thread, which sends them in batches and injects whatever its
+    neighbors send into the pool through the injection ring (see ParticleInjectionRing.h).
+    Nothing on the GL thread waits: a frame with no free slot skips the migration, and a side
+    whose link is down or whose queue is still full keeps its particles, so they leave on a
+    later frame instead.
+
+    Node i listens on the port of its own address for node i - 1, and connects to node i + 1
+    (and keeps trying until it can), so the nodes can be started in any order.
+
+    The migration program is shaderParticle.comp built with PARTICLE_MIGRATION_PASS defined
+    (see GetMigrationShaderDefines(...)).  Like the heatmap exporter, it reads the particle
+    buffers through the shader storage bindings that ParticleManager set up.
+
+    Note: A record only has a position and a velocity, so an arrival starts over at age 0 in
+    the inbound emitter's range of the pool.  Arrivals that find that emitter's dead stack
+    empty, and particles in flight on a link that drops, are lost.
+    Also Note: There are no halo particles, so interactions (see ParticleNeighborGrid.h), 
+    gravity (see ParticleGravityTree.h), and ropes (see ParticleConstraintSolver.h) wouldn't 
+    reach across the slab boundaries.  main.cpp refuses "--shard" with any of them.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class ParticleDomainShard
+{
+public:
+    ParticleDomainShard();
+    ~ParticleDomainShard();
+    bool Init(unsigned int migrationProgramId, const ParticleDomainSettings &settings,
+        ParticleInjectionRing *inboundRing);
+    void Cleanup();
+    void ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId);
+    bool IsActive() const;
+
+    void MigrateParticles(ParticleManager &particleManager);
+    unsigned long long GetSentCount() const;
+    unsigned long long GetReceivedCount() const;
+    unsigned long long GetDroppedCount() const;
+
+    static std::string GetMigrationShaderDefines(ParticleLayout layout,
+        unsigned int workGroupSize = ParticleManager::DEFAULT_WORK_GROUP_SIZE);
+
+private:
+    // no copies; there is only one of each connection
+    ParticleDomainShard(const ParticleDomainShard &);
+    ParticleDomainShard &operator=(const ParticleDomainShard &);
+
+    enum MigrationSide
+    {
+        MIGRATION_SIDE_LEFT = 0,
+        MIGRATION_SIDE_RIGHT,
+        MIGRATION_SIDE_COUNT,
+    };
+
+    // the network thread's side of a neighbor
+    struct Link
+    {
+        long long _socket;
+        std::vector<unsigned char> _pendingSend;
+        size_t _sentBytes;
+        std::vector<unsigned char> _received;
+    };
+
+    void LoadProgramInterface();
+    void ReadFinishedSlots();
+    void NetworkLoop();
+    void ConnectLinks(long long listenSocket, double *nextConnectSec);
+    void CloseLink(unsigned int side);
+    bool SendPending(unsigned int side);
+    bool ReceivePending(unsigned int side);
+    void InjectArrivals();
+
+    GlProgram _migrationProgramId;
+    unsigned int _migrationWorkGroupSizeX;
+    unsigned int _unifLocMigrationParticleCount;
+    unsigned int _unifLocMigrationEmitterCount;
+    unsigned int _unifLocMigrationCapacity;
+    unsigned int _unifLocMigrationMinX;
+    unsigned int _unifLocMigrationMaxX;
+    unsigned int _unifLocMigrateLeft;
+    unsigned int _unifLocMigrateRight;
+
+    ParticleDomainSettings _settings;
+    ParticleInjectionRing *_inboundRing;
+    float _regionMinX;
+    float _regionMaxX;
+    bool _isActive;
+
+    // the readback ring
+    // Note: The binding continues from ParticleNeighborGrid's and must match
+    // shaderParticle.comp.  3 slots is as many frames as the driver keeps in flight.
+    static const unsigned int MIGRATION_BUFFER_BINDING = 71;
+    static const unsigned int MIGRATION_SLOTS = 3;
+    GlBuffer _migrationBufferId;
+    const unsigned char *_mapped;
+    size_t _slotSizeBytes;
+    size_t _slotStrideBytes;
+    GlFence _slotFences[MIGRATION_SLOTS];
+    std::deque<unsigned int> _readingSlots;
+    unsigned int _nextSlot;
+
+    // handed from the GL thread to the network thread
+    std::mutex _mutex;
+    std::vector<ParticleInjectionRecord> _outbound[MIGRATION_SIDE_COUNT];
+    std::atomic<bool> _isLinkUp[MIGRATION_SIDE_COUNT];
+
+    // only the network thread touches these
+    std::thread _networkThread;
+    std::atomic<bool> _isStopping;
+    Link _links[MIGRATION_SIDE_COUNT];
+    std::vector<ParticleInjectionRecord> _sendRecords;
+    std::deque<ParticleInjectionRecord> _arrivals;
+    unsigned int _batchIndex;
+
+    std::atomic<unsigned long long> _sentCount;
+    std::atomic<unsigned long long> _receivedCount;
+    std::atomic<unsigned long long> _droppedCount;
+};
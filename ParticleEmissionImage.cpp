@@ -0,0 +1,495 @@
+#include "ParticleEmissionImage.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
+#include "ShaderProgramRegistry.h"
+#include "ComputeDeviceCaps.h"
+#include "GpuMemoryLedger.h"
+#include "GlObjects.h"
+#include "Log.h"
+#include "MappedFile.h"
+#include "AssetPack.h"
+
+#include <stdio.h>
+#include <ctype.h>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleEmissionImage::ParticleEmissionImage() :
+    _weightProgramId(0),
+    _weightWorkGroupSizeX(256),
+    _unifLocWeightPixelCount(0),
+    _unifLocWeightWidth(0),
+    _unifLocWeightThreshold(0),
+    _uploadedTextureId(0),
+    _cdfBufferId(0),
+    _cdfCapacity(0),
+    _width(0),
+    _height(0)
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleEmissionImage::~ParticleEmissionImage()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes a reference to the weight program and sets up the scan (see ShaderProgramRegistry.h).
+    The caller may release their own references after this returns.  Nothing is allocated
+    until there is an image.
+Parameters:
+    weightProgramId     shaderParticle.comp generated with GetWeightShaderDefines(...).
+    scanProgramId       shaderScan.comp generated with GpuScan::GetScanShaderDefines(...).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleEmissionImage::Init(unsigned int weightProgramId, unsigned int scanProgramId)
+{
+    this->Cleanup();
+    if (weightProgramId == 0 || scanProgramId == 0)
+    {
+        LogPrintf("emission image needs both the weight and the scan programs\n");
+        return;
+    }
+
+    // the device only has to have 8 binding points, and the weights' comes after everyone else's
+    GLint maxBindings = 0;
+    glGetIntegerv(GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS, &maxBindings);
+    if (maxBindings <= (GLint)EMISSION_WEIGHT_BUFFER_BINDING)
+    {
+        LogPrintf("the emission image needs %u shader storage bindings, but there are only %d\n",
+            EMISSION_WEIGHT_BUFFER_BINDING + 1, maxBindings);
+        return;
+    }
+
+    _weightProgramId = weightProgramId;
+    AddProgramReference(_weightProgramId);
+    this->LoadProgramInterface();
+    _scan.Init(scanProgramId);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Releases the programs and deletes the CDF and the uploaded texture.  A particle manager
+    that was given the CDF must be told first (see ParticleManager::ClearEmissionImage()).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleEmissionImage::Cleanup()
+{
+    if (_weightProgramId != 0)
+    {
+        ReleaseProgram(_weightProgramId);
+        _weightProgramId = 0;
+    }
+    _scan.Cleanup();
+
+    DeleteGlTexture(_uploadedTextureId);
+    DeleteGlBuffer(_cdfBufferId);
+    _uploadedTextureId = 0;
+    _cdfBufferId = 0;
+    _cdfCapacity = 0;
+    _width = 0;
+    _height = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Switches to a rebuilt program (see ParticleManager::ReplaceProgram(...)).  The CDF that
+    was already built is kept; it is only rebuilt when the image is set again.
+Parameters:
+    oldProgramId    Self-explanatory.  Programs that this image doesn't use are ignored.
+    newProgramId    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleEmissionImage::ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId)
+{
+    _scan.ReplaceProgram(oldProgramId, newProgramId);
+    if (oldProgramId == 0 || newProgramId == 0 || _weightProgramId != oldProgramId)
+    {
+        return;
+    }
+
+    AddProgramReference(newProgramId);
+    ReleaseProgram(_weightProgramId);
+    _weightProgramId = newProgramId;
+    this->LoadProgramInterface();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Builds the CDF from a texture: a pixel's weight is its luminance times its alpha, so
+    black and transparent pixels never spawn anything, and the brighter the pixel, the more
+    particles start there.
+
+    Note: The texture is read with texelFetch(...), so it must be complete at level 0 and have
+    a format that a sampler2D can read (ex: GL_RGBA8, or GL_R8, whose missing channels read as
+    0, 0, 1).
+Parameters:
+    textureId   A 2D texture.  It still belongs to the caller, and isn't needed after this
+                returns.
+    width       The texture's size at level 0.
+    height      Self-explanatory.
+    threshold   Luminances at or below this are dark (ex: 0.1 to ignore a noisy background).
+Returns:
+    True if the CDF was built, false if there was no program or no room for it.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleEmissionImage::SetImage(unsigned int textureId, int width, int height,
+    float threshold)
+{
+    if (_weightProgramId == 0 || textureId == 0)
+    {
+        return false;
+    }
+    if (width <= 0 || height <= 0 || width > 4096 || height > 4096)
+    {
+        // the weights are at most 255, so more pixels than this could overflow the total
+        LogPrintf("emission image must be from 1x1 to 4096x4096, not %dx%d\n", width, height);
+        return false;
+    }
+
+    // one per pixel and one more for the total
+    // Note: Immutable storage, and it only grows, same as the neighbor grid's.
+    unsigned int pixelCount = (unsigned int)(width * height);
+    unsigned int cdfCount = pixelCount + 1;
+    if (cdfCount > _cdfCapacity)
+    {
+        unsigned long long sizeBytes = (unsigned long long)cdfCount * sizeof(unsigned int);
+        if (WouldExceedGpuMemoryBudget(sizeBytes))
+        {
+            LogPrintf("no room in the GPU memory budget for a %dx%d emission image\n", width,
+                height);
+            return false;
+        }
+
+        DeleteGlBuffer(_cdfBufferId);
+        glGenBuffers(1, &_cdfBufferId);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, _cdfBufferId);
+        glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeBytes, 0, 0);
+        RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "emission image");
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        _cdfCapacity = cdfCount;
+    }
+    _width = width;
+    _height = height;
+
+    // bound every time because the particle passes are free to use these too
+    glActiveTexture(GL_TEXTURE0 + EMISSION_WEIGHT_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, textureId);
+    glActiveTexture(GL_TEXTURE0);
+    BindGlShaderStorageBuffer(EMISSION_WEIGHT_BUFFER_BINDING, _cdfBufferId);
+
+    UseGlProgram(_weightProgramId);
+    glUniform1ui(_unifLocWeightPixelCount, pixelCount);
+    glUniform1ui(_unifLocWeightWidth, (unsigned int)width);
+    glUniform1f(_unifLocWeightThreshold, threshold);
+
+    // one work item per pixel, plus the total's
+    unsigned int numWorkGroupsX = 0;
+    unsigned int numWorkGroupsY = 0;
+    GetComputeDispatchSize((cdfCount + _weightWorkGroupSizeX - 1) / _weightWorkGroupSizeX,
+        &numWorkGroupsX, &numWorkGroupsY);
+    glDispatchCompute(numWorkGroupsX, numWorkGroupsY, 1);
+    UseGlProgram(0);
+
+    glActiveTexture(GL_TEXTURE0 + EMISSION_WEIGHT_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+
+    // the weights become the CDF where they are; the scan puts its own barrier in first
+    _scan.ExclusiveScan(_cdfBufferId, _cdfBufferId, cdfCount);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Uploads the pixels into a texture of this object's own and builds the CDF from it (see
+    SetImage(...)).  The texture is kept so that uploading an image of the same size again
+    doesn't make a new one.
+Parameters:
+    width       Self-explanatory.
+    height      Self-explanatory.
+    rgbaPixels  4 bytes per pixel, row by row from the bottom, X first.  Must be exactly
+                width * height * 4.
+    threshold   See SetImage(...).
+Returns:
+    True if the CDF was built.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleEmissionImage::UploadImage(int width, int height,
+    const std::vector<unsigned char> &rgbaPixels, float threshold)
+{
+    if (_weightProgramId == 0 || width <= 0 || height <= 0)
+    {
+        return false;
+    }
+    if (rgbaPixels.size() != (size_t)width * (size_t)height * 4)
+    {
+        LogPrintf("emission image is %dx%d, so it needs %d bytes, not %u\n", width, height,
+            width * height * 4, (unsigned int)rgbaPixels.size());
+        return false;
+    }
+
+    if (_uploadedTextureId == 0 || width != _width || height != _height)
+    {
+        DeleteGlTexture(_uploadedTextureId);
+        glGenTextures(1, &_uploadedTextureId);
+        glBindTexture(GL_TEXTURE_2D, _uploadedTextureId);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+        RecordGpuAllocation(GPU_MEMORY_TEXTURE, _uploadedTextureId,
+            GetGlTextureSizeBytes(GL_RGBA8, width, height), "emission image");
+    }
+    glBindTexture(GL_TEXTURE_2D, _uploadedTextureId);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE,
+        rgbaPixels.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    return this->SetImage(_uploadedTextureId, width, height, threshold);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The CDF for ParticleManager::SetEmissionImage(...), or 0 if there is no image yet.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleEmissionImage::GetCdfBufferId() const
+{
+    return (_width > 0) ? _cdfBufferId : 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The width of the image that the CDF was built from, or 0 if there is none.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+int ParticleEmissionImage::GetWidth() const
+{
+    return _width;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The height of the image that the CDF was built from, or 0 if there is none.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+int ParticleEmissionImage::GetHeight() const
+{
+    return _height;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    LoadNetpbmFile(...)'s fgetc(...) over a mapped file.
+Parameters:
+    bytes           Self-explanatory.
+    sizeBytes       Self-explanatory.
+    position        The next byte to read.  Advanced past it.
+Returns:
+    The byte, or EOF if there are no more.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static int NextNetpbmByte(const unsigned char *bytes, size_t sizeBytes, size_t *position)
+{
+    if (*position >= sizeBytes)
+    {
+        return EOF;
+    }
+    int c = bytes[*position];
+    *position += 1;
+    return c;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Reads a binary PGM (P5) or PPM (P6) file with 8-bit channels.  These are the formats that
+    every image tool can save and that need no library to read, which is all that a mask
+    needs.  Gray is copied into red, green, and blue, and alpha is always opaque.
+
+    Note: The file's first row is the top of the image, and GL's is the bottom, so the rows
+    are flipped on the way in.
+Parameters:
+    filePath            Self-explanatory.
+    putWidthHere        Self-explanatory.
+    putHeightHere       Self-explanatory.
+    putRgbaPixelsHere   Cleared and filled for UploadImage(...).
+Returns:
+    True if the file was read, false if it couldn't be opened or isn't one of those formats.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleEmissionImage::LoadNetpbmFile(const std::string &filePath, int *putWidthHere,
+    int *putHeightHere, std::vector<unsigned char> *putRgbaPixelsHere)
+{
+    // parsed where it is mapped (or where it is in the asset pack), so the pixels are copied
+    // once, straight into the RGBA rows
+    MappedFile file;
+    const void *fileData = 0;
+    size_t fileSizeBytes = 0;
+    if (!MapAsset(filePath, &file, &fileData, &fileSizeBytes))
+    {
+        LogPrintf("could not open emission image '%s'\n", filePath.c_str());
+        return false;
+    }
+    const unsigned char *bytes = (const unsigned char *)fileData;
+    size_t position = 0;
+
+    // the header is "P5" or "P6", then the width, height, and max value, separated by
+    // whitespace and comments that run from '#' to the end of the line
+    char magic[3] = { 0, 0, 0 };
+    int headerValues[3] = { 0, 0, 0 };
+    bool isValid = fileSizeBytes >= 2 && bytes[0] == 'P' && (bytes[1] == '5' || bytes[1] == '6');
+    if (isValid)
+    {
+        magic[0] = (char)bytes[0];
+        magic[1] = (char)bytes[1];
+        position = 2;
+    }
+    for (int valueIndex = 0; isValid && valueIndex < 3; valueIndex++)
+    {
+        int c = NextNetpbmByte(bytes, fileSizeBytes, &position);
+        while (c == '#' || isspace(c))
+        {
+            if (c == '#')
+            {
+                while (c != '\n' && c != EOF)
+                {
+                    c = NextNetpbmByte(bytes, fileSizeBytes, &position);
+                }
+            }
+            c = NextNetpbmByte(bytes, fileSizeBytes, &position);
+        }
+        if (!isdigit(c))
+        {
+            isValid = false;
+            break;
+        }
+        while (isdigit(c) && headerValues[valueIndex] < 65536)
+        {
+            headerValues[valueIndex] = (headerValues[valueIndex] * 10) + (c - '0');
+            c = NextNetpbmByte(bytes, fileSizeBytes, &position);
+        }
+
+        // exactly one whitespace character follows the max value, and then the pixels start
+        if (valueIndex == 2 && !isspace(c))
+        {
+            isValid = false;
+        }
+    }
+
+    int width = headerValues[0];
+    int height = headerValues[1];
+    if (!isValid || width <= 0 || height <= 0 || width > 4096 || height > 4096 ||
+        headerValues[2] != 255)
+    {
+        LogPrintf("emission image '%s' must be an 8-bit binary PGM or PPM up to 4096x4096\n",
+            filePath.c_str());
+        return false;
+    }
+
+    int channelCount = (magic[1] == '5') ? 1 : 3;
+    size_t rowSizeBytes = (size_t)width * channelCount;
+    const unsigned char *pixels = bytes + position;
+    if ((fileSizeBytes - position) < (rowSizeBytes * height))
+    {
+        LogPrintf("emission image '%s' ended before all of its %dx%d pixels\n",
+            filePath.c_str(), width, height);
+        return false;
+    }
+
+    putRgbaPixelsHere->assign((size_t)width * height * 4, 255);
+    for (int row = 0; row < height; row++)
+    {
+        const unsigned char *source = &pixels[(size_t)(height - 1 - row) * rowSizeBytes];
+        unsigned char *destination = &(*putRgbaPixelsHere)[(size_t)row * width * 4];
+        for (int x = 0; x < width; x++)
+        {
+            for (int channel = 0; channel < 3; channel++)
+            {
+                destination[(x * 4) + channel] =
+                    source[(x * channelCount) + ((channelCount == 1) ? 0 : channel)];
+            }
+        }
+    }
+
+    *putWidthHere = width;
+    *putHeightHere = height;
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.  The weights don't touch the particles, so they don't care about the
+    particle layout.
+Parameters:
+    workGroupSize   Self-explanatory.
+Returns:
+    The defines to give to AcquireComputeProgram(...) for the weight program.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+std::string ParticleEmissionImage::GetWeightShaderDefines(unsigned int workGroupSize)
+{
+    return "#define WORK_GROUP_SIZE_X " + std::to_string(workGroupSize) + "\n" +
+        "#define PARTICLE_EMISSION_WEIGHT_PASS\n";
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Looks up the weight program's uniforms and work group size.  Called by Init(...) and
+    whenever the program is replaced.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleEmissionImage::LoadProgramInterface()
+{
+    _unifLocWeightPixelCount = glGetUniformLocation(_weightProgramId,
+        "uEmissionWeightPixelCount");
+    _unifLocWeightWidth = glGetUniformLocation(_weightProgramId, "uEmissionWeightWidth");
+    _unifLocWeightThreshold = glGetUniformLocation(_weightProgramId, "uEmissionWeightThreshold");
+
+    // same as ParticleManager::Init(...); the dispatch must match the program
+    GLint programWorkGroupSize[3] = { 0, 0, 0 };
+    glGetProgramiv(_weightProgramId, GL_COMPUTE_LOCAL_WORK_SIZE, programWorkGroupSize);
+    _weightWorkGroupSizeX = (programWorkGroupSize[0] > 0) ? programWorkGroupSize[0] : 256;
+}
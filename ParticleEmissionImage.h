@@ -0,0 +1,73 @@
+#pragma once
+
+#include "GpuScan.h"
+
+#include <string>
+#include <vector>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    An emission source of any shape: an image whose bright pixels are where particles start
+    (ex: a logo or a mask), for the emitters whose spawn shape is PARTICLE_SPAWN_IMAGE (see
+    ParticleManager::SetEmissionImage(...)).
+
+    The image is made into a CDF once, on the GPU: a pass of the weight program writes each
+    pixel's luminance as a whole number, and an in-place scan (see GpuScan.h) sums them up, so
+    that each pixel owns a range of numbers as wide as it is bright.  The emit pass then picks a
+    random number and binary searches for the pixel that owns it, which is log2(pixels) loads
+    per particle however complicated the shape is, and nothing for the pixels that are dark.
+
+    The weight program is shaderParticle.comp built with PARTICLE_EMISSION_WEIGHT_PASS defined
+    (see GetWeightShaderDefines(...)).  It reads the image through a sampler, so the image can
+    be any texture that GL can fetch from (see SetImage(...)), or pixels from the CPU (see
+    UploadImage(...)).
+
+    Note: The CDF is a GLuint per pixel, plus one for the total.  A 1024x1024 image is 4MB.
+    The CDF is only rebuilt when the image is set, so an image that changes every frame costs a
+    pass and a scan every frame.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class ParticleEmissionImage
+{
+public:
+    ParticleEmissionImage();
+    ~ParticleEmissionImage();
+    void Init(unsigned int weightProgramId, unsigned int scanProgramId);
+    void Cleanup();
+    void ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId);
+
+    bool SetImage(unsigned int textureId, int width, int height, float threshold = 0.0f);
+    bool UploadImage(int width, int height, const std::vector<unsigned char> &rgbaPixels,
+        float threshold = 0.0f);
+
+    unsigned int GetCdfBufferId() const;
+    int GetWidth() const;
+    int GetHeight() const;
+
+    static bool LoadNetpbmFile(const std::string &filePath, int *putWidthHere,
+        int *putHeightHere, std::vector<unsigned char> *putRgbaPixelsHere);
+    static std::string GetWeightShaderDefines(unsigned int workGroupSize = 256);
+
+private:
+    void LoadProgramInterface();
+
+    unsigned int _weightProgramId;
+    unsigned int _weightWorkGroupSizeX;
+    unsigned int _unifLocWeightPixelCount;
+    unsigned int _unifLocWeightWidth;
+    unsigned int _unifLocWeightThreshold;
+    GpuScan _scan;
+
+    // Note: The texture unit and the binding must match shaderParticle.comp.  The binding is the
+    // same one that the particle manager reads the CDF at, after the heatmap's (see
+    // ParticleHeatmapExporter.h).
+    static const unsigned int EMISSION_WEIGHT_TEXTURE_UNIT = 3;
+    static const unsigned int EMISSION_WEIGHT_BUFFER_BINDING = 41;
+
+    // the texture from UploadImage(...); one from SetImage(...) belongs to the caller
+    unsigned int _uploadedTextureId;
+    unsigned int _cdfBufferId;
+    unsigned int _cdfCapacity;
+    int _width;
+    int _height;
+};
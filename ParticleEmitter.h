@@ -0,0 +1,202 @@
+#pragma once
+
+#include "glm/vec2.hpp"
+
+#include <cstddef>
+
+// where an emitter's particles start
+// Note: Must match the SPAWN_SHAPE_* defines in shaderParticle.comp.
+enum ParticleSpawnShape
+{
+    // within 0.1 of the center (see SPAWN_RADIUS in shaderParticle.comp)
+    PARTICLE_SPAWN_DISK = 0,
+
+    // somewhere in the particle manager's emission image, in proportion to its brightness 
+    // (see ParticleManager::SetEmissionImage(...)), or the disk without one
+    PARTICLE_SPAWN_IMAGE,
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Describes one emitter: where its particles come from, how fast they go, how far they can
+    get and how long they can live before they are recycled, how many can be emitted each 
+    frame, and how many particles it owns.
+
+    With a lifetime, no particle is out for longer than that, so the pool only needs 
+    (emission quota per update) * (updates per second) * (lifetime) particles for the emitter 
+    to never run dry, instead of enough to cover the slowest particle's trip out of bounds.
+
+    ParticleManager gives each emitter its own contiguous range of the particle pool and
+    uploads the whole table to a shader storage buffer, so a single dispatch updates (and a
+    single draw call draws) the particles of every emitter.  The compute shader finds which
+    emitter a particle belongs to from the particle's index, so the emitters don't cost any
+    per-particle memory.
+
+    Note: This structure is uploaded as-is into a std430 buffer and must match the
+    "ParticleEmitter" structure in shaderParticle.comp.
+Creator:    John Cox (8-13-2016)
+-----------------------------------------------------------------------------------------------*/
+struct ParticleEmitter
+{
+    glm::vec2 _center;      // window coordinates (X and Y bounded by [-1,+1])
+    float _radius;          // particles farther than this from the center are recycled
+    float _velocityMin;
+    float _velocityMax;
+    unsigned int _maxParticlesEmittedPerFrame;
+    unsigned int _particleCount;
+
+    // set by ParticleManager::Init(...); the index of the emitter's first particle in the pool
+    unsigned int _firstParticle;
+
+    // particles that have been out this long are recycled even if they are in bounds; 0 for 
+    // no limit
+    float _lifetimeSec;
+
+    // a ParticleSpawnShape
+    unsigned int _spawnShape;
+};
+
+static_assert(offsetof(ParticleEmitter, _center) == 0, "ParticleEmitter must match std430");
+static_assert(offsetof(ParticleEmitter, _radius) == 8, "ParticleEmitter must match std430");
+static_assert(offsetof(ParticleEmitter, _firstParticle) == 28, "ParticleEmitter must match std430");
+static_assert(offsetof(ParticleEmitter, _lifetimeSec) == 32, "ParticleEmitter must match std430");
+static_assert(sizeof(ParticleEmitter) == 40, "ParticleEmitter must match std430");
+
+// how an emitter moves (see ParticleEmitterPath)
+// Note: Must match the EMITTER_PATH_* defines in shaderParticle.comp.
+enum ParticleEmitterPathType
+{
+    // stays at its center
+    PARTICLE_EMITTER_PATH_NONE = 0,
+
+    // each axis is a sine wave of its own frequency and phase
+    PARTICLE_EMITTER_PATH_LISSAJOUS,
+
+    // a closed Catmull-Rom spline through a run of the manager's path points, which passes 
+    // through every one of them and is smooth at each
+    PARTICLE_EMITTER_PATH_SPLINE,
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Moves an emitter over time without the CPU touching the emitter table (see 
+    ParticleManager::SetEmitterPaths(...)).  The path is an offset from the emitter's center 
+    that the compute shader works out from the simulation time, so the emitter's disk (and 
+    the bounds that its particles are recycled at) go along with it, and each particle that 
+    it emits starts where the emitter was at the moment within the frame that it came out.
+
+    Lissajous:  offset = _amplitude * sin((_angularFrequency * time) + _phase) on each axis.  
+                A ratio of 1:2 between the frequencies is a figure 8, and equal frequencies 
+                with phases a quarter turn apart are an ellipse.
+    Spline:     _pointCount offsets, starting at _firstPoint in the manager's path points, 
+                gone around once every _periodSec.  _phase.x is how far around the loop it 
+                starts (0 to 1), so that emitters can share a loop without being on top of 
+                each other.
+
+    Note: This structure is uploaded as-is into a std430 buffer and must match the 
+    "ParticleEmitterPath" structure in shaderParticle.comp.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+struct ParticleEmitterPath
+{
+    glm::vec2 _amplitude;           // Lissajous only
+    glm::vec2 _angularFrequency;    // Lissajous only; radians per second
+    glm::vec2 _phase;               // radians for a Lissajous, X in laps for a spline
+    unsigned int _type;             // a ParticleEmitterPathType
+    unsigned int _firstPoint;       // spline only
+    unsigned int _pointCount;       // spline only
+    float _periodSec;               // spline only
+};
+
+static_assert(offsetof(ParticleEmitterPath, _phase) == 16, "ParticleEmitterPath must match std430");
+static_assert(offsetof(ParticleEmitterPath, _type) == 24, "ParticleEmitterPath must match std430");
+static_assert(offsetof(ParticleEmitterPath, _periodSec) == 36, "ParticleEmitterPath must match std430");
+static_assert(sizeof(ParticleEmitterPath) == 40, "ParticleEmitterPath must match std430");
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    How often an emitter's particles are integrated (see 
+    ParticleManager::SetEmitterUpdateSlices(...)).  They are integrated on 1 in every _period 
+    update dispatches, the ones where (dispatch + _phase) is a multiple of _period, and then 
+    by _period steps at once, so they keep up with the others.  Spreading the phases out 
+    keeps the same number of particles integrated on every dispatch.
+
+    Note: This structure is uploaded as-is into a std430 buffer and must match the 
+    "EmitterUpdateSlice" structure in shaderParticle.comp.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+struct ParticleEmitterSlice
+{
+    unsigned int _period;           // 0 and 1 both integrate every time
+    unsigned int _phase;
+};
+
+static_assert(sizeof(ParticleEmitterSlice) == 8, "ParticleEmitterSlice must match std430");
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    A one-time emission of many particles at once, on an event (ex: an explosion), on top of 
+    the emitter's usual rate (see ParticleManager::TriggerBurst(...)).  The particles come off 
+    of the emitter's dead stack like any others, so a burst can't take more than the emitter 
+    has left, and they live and die by the emitter's rules (radius and lifetime).
+
+    Note: This structure is copied as-is into a std430 buffer and must match the 
+    "ParticleBurst" structure in shaderParticle.comp.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+struct ParticleBurst
+{
+    glm::vec2 _offset;              // from the emitter's center, wherever that is right now
+    float _radius;                  // the particles start within this far of the offset
+    unsigned int _emitterIndex;
+    float _velocityMin;
+    float _velocityMax;
+    unsigned int _count;            // at most this many; fewer if the dead stack runs out
+    unsigned int _padding;
+};
+
+static_assert(offsetof(ParticleBurst, _emitterIndex) == 12, "ParticleBurst must match std430");
+static_assert(offsetof(ParticleBurst, _count) == 24, "ParticleBurst must match std430");
+static_assert(sizeof(ParticleBurst) == 32, "ParticleBurst must match std430");
+
+// which deaths set off a sub-emitter (see ParticleSubEmitter); bits, so both can
+// Note: Must match the SUB_EMITTER_ON_* defines in shaderParticle.comp.
+enum ParticleSubEmitterTrigger
+{
+    // outlived the emitter's lifetime
+    PARTICLE_SUB_EMITTER_ON_EXPIRED = 1,
+
+    // left the emitter's radius, or was recycled by an SDF boundary or a segment
+    PARTICLE_SUB_EMITTER_ON_LEFT_BOUNDS = 2,
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Children for an emitter's particles when they die (ex: fireworks), from another emitter's 
+    dead stack (see ParticleManager::SetSubEmitters(...)).  The update appends each death that 
+    the trigger covers to a list on the GPU, and the next update's first pass sends out 
+    _childCount children from where each one died, with some of its velocity.
+
+    The children belong to the child emitter, so they live and die by its radius and lifetime,
+    and they are only there if its dead stack has them.  A child emitter is normally given an 
+    emission rate of 0 and a radius that covers wherever its parents may die.  It may have a 
+    sub-emitter of its own, so the children can have children one update later.
+
+    Note: This structure is uploaded as-is into a std430 buffer and must match the 
+    "ParticleSubEmitter" structure in shaderParticle.comp.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+struct ParticleSubEmitter
+{
+    unsigned int _childEmitterIndex;
+    unsigned int _childCount;       // per death; 0 for none
+    unsigned int _triggers;         // ParticleSubEmitterTrigger bits
+    float _inheritVelocity;         // how much of the parent's velocity each child starts with
+    float _velocityMin;             // plus a random direction at a speed in this range
+    float _velocityMax;
+    float _radius;                  // the children start within this far of the parent
+    unsigned int _padding;
+};
+
+static_assert(offsetof(ParticleSubEmitter, _inheritVelocity) == 12, "ParticleSubEmitter must match std430");
+static_assert(sizeof(ParticleSubEmitter) == 32, "ParticleSubEmitter must match std430");
@@ -0,0 +1,402 @@
+#include "ParticleFieldTexture.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
+#include "ShaderProgramRegistry.h"
+#include "ComputeDeviceCaps.h"
+#include "TextureCompression.h"
+#include "Log.h"
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleFieldTexture::ParticleFieldTexture() :
+    _bakeProgramId(0),
+    _bakeWorkGroupSizeX(256),
+    _unifLocBakeMinCorner(0),
+    _unifLocBakeTexelSize(0),
+    _unifLocBakeForceFieldCount(0),
+    _textureId(0),
+    _compressedTextureId(0),
+    _valueScale(1.0f),
+    _bakeForceFieldBufferId(0),
+    _bakeForceFieldCapacity(0),
+    _width(0),
+    _height(0),
+    _minCorner(-1.0f, -1.0f),
+    _maxCorner(+1.0f, +1.0f)
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleFieldTexture::~ParticleFieldTexture()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Creates the texture, filled with 0s, and takes a reference to the bake program (see
+    ShaderProgramRegistry.h).  The caller may release their own reference after this returns.
+Parameters:
+    bakeProgramId   shaderParticle.comp generated with GetBakeShaderDefines(...).  May be 0 if
+                    the texture will only be filled with Upload(...).
+    width           The texels across.  A field that changes slowly needs few; 128 is plenty
+                    for a handful of attractors over the window.
+    height          Self-explanatory.
+    minCorner       Where the texture's lower left corner is in window coordinates.
+    maxCorner       Where the texture's upper right corner is.  Must be greater than minCorner
+                    on both axes.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleFieldTexture::Init(unsigned int bakeProgramId, int width, int height,
+    const glm::vec2 &minCorner, const glm::vec2 &maxCorner)
+{
+    this->Cleanup();
+    if (width <= 0 || height <= 0)
+    {
+        LogPrintf("field texture must have at least 1 texel, not %dx%d\n", width, height);
+        return;
+    }
+    if (maxCorner.x <= minCorner.x || maxCorner.y <= minCorner.y)
+    {
+        LogPrintf("field texture bounds are empty: (%f, %f) to (%f, %f)\n",
+            minCorner.x, minCorner.y, maxCorner.x, maxCorner.y);
+        return;
+    }
+
+    // the device only has to have 8 binding points, and the bake's comes after everyone else's
+    GLint maxBindings = 0;
+    glGetIntegerv(GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS, &maxBindings);
+    if (bakeProgramId != 0 && maxBindings <= (GLint)FIELD_BAKE_FORCE_FIELD_BUFFER_BINDING)
+    {
+        LogPrintf("the field texture bake needs %u shader storage bindings, but there are only %d\n",
+            FIELD_BAKE_FORCE_FIELD_BUFFER_BINDING + 1, maxBindings);
+        bakeProgramId = 0;
+    }
+
+    _width = width;
+    _height = height;
+    _minCorner = minCorner;
+    _maxCorner = maxCorner;
+
+    // linear filtering is the whole point; past the edges, the edge texels carry on
+    glGenTextures(1, &_textureId);
+    glBindTexture(GL_TEXTURE_2D, _textureId);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RG16F, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    this->Upload(std::vector<glm::vec2>(width * height, glm::vec2(0.0f, 0.0f)));
+
+    if (bakeProgramId != 0)
+    {
+        _bakeProgramId = bakeProgramId;
+        AddProgramReference(_bakeProgramId);
+        this->LoadProgramInterface();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Releases the bake program and deletes the texture and the bake's buffer.  A particle
+    manager that was given the texture must be told first (see
+    ParticleManager::ClearFieldTexture()).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleFieldTexture::Cleanup()
+{
+    if (_bakeProgramId != 0)
+    {
+        ReleaseProgram(_bakeProgramId);
+        _bakeProgramId = 0;
+    }
+
+    glDeleteTextures(1, &_textureId);
+    glDeleteTextures(1, &_compressedTextureId);
+    DeleteGlBuffers(1, &_bakeForceFieldBufferId);
+    _textureId = 0;
+    _compressedTextureId = 0;
+    _valueScale = 1.0f;
+    _bakeForceFieldBufferId = 0;
+    _bakeForceFieldCapacity = 0;
+    _width = 0;
+    _height = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Switches to a rebuilt program (see ParticleManager::ReplaceProgram(...)).
+Parameters:
+    oldProgramId    Self-explanatory.  Programs that this texture doesn't use are ignored.
+    newProgramId    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleFieldTexture::ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId)
+{
+    if (oldProgramId == 0 || newProgramId == 0 || _bakeProgramId != oldProgramId)
+    {
+        return;
+    }
+
+    AddProgramReference(newProgramId);
+    ReleaseProgram(_bakeProgramId);
+    _bakeProgramId = newProgramId;
+    this->LoadProgramInterface();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Fills the texture from the CPU.  The texels are converted to half floats on the way in.
+    A compressed copy from before is dropped (see Compress()).
+Parameters:
+    texels      Row by row from the min corner, X first.  Must be exactly width * height.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleFieldTexture::Upload(const std::vector<glm::vec2> &texels)
+{
+    if (_textureId == 0)
+    {
+        return;
+    }
+    if (texels.size() != (size_t)(_width * _height))
+    {
+        LogPrintf("field texture is %dx%d, so it needs %d texels, not %u\n", _width, _height,
+            _width * _height, (unsigned int)texels.size());
+        return;
+    }
+    glDeleteTextures(1, &_compressedTextureId);
+    _compressedTextureId = 0;
+    _valueScale = 1.0f;
+
+    // glm::vec2 is 2 tightly packed floats
+    glBindTexture(GL_TEXTURE_2D, _textureId);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, _width, _height, GL_RG, GL_FLOAT, texels.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Fills the texture on the GPU with the sum of the force fields' accelerations at each
+    texel's center.  Cheap enough to do every frame for fields that move, though it only
+    needs to be done when they change.  Same as Upload(...), a compressed copy from before is
+    dropped.
+
+    Note: The velocity is 0 at every texel, so the drag fields have no effect here.  They
+    depend on each particle's own velocity, so they belong in ParticleManager::
+    SetForceFields(...).
+Parameters:
+    forceFields     Self-explanatory.  May be empty, which clears the texture to 0.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleFieldTexture::Bake(const std::vector<ParticleForceField> &forceFields)
+{
+    if (_bakeProgramId == 0 || _textureId == 0)
+    {
+        return;
+    }
+    glDeleteTextures(1, &_compressedTextureId);
+    _compressedTextureId = 0;
+    _valueScale = 1.0f;
+
+    // Note: Mutable storage, and it only grows, same as the particle manager's force fields.
+    unsigned int forceFieldCount = (unsigned int)forceFields.size();
+    if (_bakeForceFieldBufferId == 0 || forceFieldCount > _bakeForceFieldCapacity)
+    {
+        _bakeForceFieldCapacity = (forceFieldCount > 0) ? forceFieldCount : 1;
+        DeleteGlBuffers(1, &_bakeForceFieldBufferId);
+        glGenBuffers(1, &_bakeForceFieldBufferId);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, _bakeForceFieldBufferId);
+        glBufferData(GL_SHADER_STORAGE_BUFFER,
+            _bakeForceFieldCapacity * sizeof(ParticleForceField), 0, GL_DYNAMIC_DRAW);
+    }
+    if (forceFieldCount > 0)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, _bakeForceFieldBufferId);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+            forceFieldCount * sizeof(ParticleForceField), forceFields.data());
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // bound every bake because other passes are free to use these binding points too
+    BindGlShaderStorageBuffer(FIELD_BAKE_FORCE_FIELD_BUFFER_BINDING, _bakeForceFieldBufferId);
+    glBindImageTexture(FIELD_BAKE_IMAGE_UNIT, _textureId, 0, GL_FALSE, 0, GL_WRITE_ONLY,
+        GL_RG16F);
+
+    glm::vec2 texelSize = (_maxCorner - _minCorner) / glm::vec2((float)_width, (float)_height);
+    UseGlProgram(_bakeProgramId);
+    glUniform2f(_unifLocBakeMinCorner, _minCorner.x, _minCorner.y);
+    glUniform2f(_unifLocBakeTexelSize, texelSize.x, texelSize.y);
+    glUniform1ui(_unifLocBakeForceFieldCount, forceFieldCount);
+
+    // one work item per texel
+    unsigned int texelCount = (unsigned int)(_width * _height);
+    unsigned int numWorkGroupsX = 0;
+    unsigned int numWorkGroupsY = 0;
+    GetComputeDispatchSize((texelCount + _bakeWorkGroupSizeX - 1) / _bakeWorkGroupSizeX,
+        &numWorkGroupsX, &numWorkGroupsY);
+    glDispatchCompute(numWorkGroupsX, numWorkGroupsY, 1);
+    UseGlProgram(0);
+
+    // the update reads it through a sampler
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Reads the texture back and compresses it to BC5 on the CPU (see TextureCompression.h).
+    GetTextureId() is the compressed copy from then on, and the particle manager must be given
+    GetValueScale() along with it.  Waits for the GPU to finish the texture, so it is for load
+    time, once the field is final.
+Parameters: None
+Returns:
+    False if there is no texture or the copy couldn't be made, in which case the uncompressed
+    texture is still there.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleFieldTexture::Compress()
+{
+    if (_textureId == 0)
+    {
+        return false;
+    }
+    glDeleteTextures(1, &_compressedTextureId);
+    _compressedTextureId = 0;
+    _valueScale = 1.0f;
+
+    // a bake writes the texture with image stores
+    glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+    std::vector<glm::vec2> texels((size_t)_width * _height);
+    glBindTexture(GL_TEXTURE_2D, _textureId);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RG, GL_FLOAT, texels.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // glm::vec2 is 2 tightly packed floats
+    _compressedTextureId = CreateSignedRgtcTexture(&texels[0].x, _width, _height, 2,
+        &_valueScale);
+    return (_compressedTextureId != 0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The texture for ParticleManager::SetFieldTexture(...), or 0 if Init(...) failed.  The
+    compressed copy if there is one (see Compress()).
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleFieldTexture::GetTextureId() const
+{
+    return (_compressedTextureId != 0) ? _compressedTextureId : _textureId;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    What the samples of GetTextureId() must be multiplied by: the largest magnitude among the
+    texels for a compressed copy, and otherwise 1.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+float ParticleFieldTexture::GetValueScale() const
+{
+    return _valueScale;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The corner given to Init(...).
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+const glm::vec2 &ParticleFieldTexture::GetMinCorner() const
+{
+    return _minCorner;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The corner given to Init(...).
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+const glm::vec2 &ParticleFieldTexture::GetMaxCorner() const
+{
+    return _maxCorner;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.  The bake doesn't touch the particles, so it doesn't care about the
+    particle layout.
+Parameters:
+    workGroupSize   Self-explanatory.
+Returns:
+    The defines to give to AcquireComputeProgram(...) for the bake program.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+std::string ParticleFieldTexture::GetBakeShaderDefines(unsigned int workGroupSize)
+{
+    return "#define WORK_GROUP_SIZE_X " + std::to_string(workGroupSize) + "\n" +
+        "#define PARTICLE_FIELD_BAKE_PASS\n";
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Looks up the bake program's uniforms and work group size.  Called by Init(...) and
+    whenever the program is replaced.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleFieldTexture::LoadProgramInterface()
+{
+    _unifLocBakeMinCorner = glGetUniformLocation(_bakeProgramId, "uBakeMinCorner");
+    _unifLocBakeTexelSize = glGetUniformLocation(_bakeProgramId, "uBakeTexelSize");
+    _unifLocBakeForceFieldCount = glGetUniformLocation(_bakeProgramId, "uBakeForceFieldCount");
+
+    // same as ParticleManager::Init(...); the dispatch must match the program
+    GLint programWorkGroupSize[3] = { 0, 0, 0 };
+    glGetProgramiv(_bakeProgramId, GL_COMPUTE_LOCAL_WORK_SIZE, programWorkGroupSize);
+    _bakeWorkGroupSizeX = (programWorkGroupSize[0] > 0) ? programWorkGroupSize[0] : 256;
+}
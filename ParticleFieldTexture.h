@@ -0,0 +1,79 @@
+#pragma once
+
+#include "ParticleForceField.h"
+#include "glm/vec2.hpp"
+
+#include <string>
+#include <vector>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    A 2D field of accelerations (or velocities) in an RG16F texture for the update kernel to
+    sample at each particle's position (see ParticleManager::SetFieldTexture(...)).  The
+    texture unit filters bilinearly between the texels, so however complicated the field is,
+    it costs each particle one texture fetch.
+
+    The texture can be filled from the CPU with Upload(...) (ex: a field from a fluid solver or
+    from a file), or baked on the GPU from a table of analytic force fields with Bake(...),
+    which evaluates them once per texel instead of once per particle.  A 128x128 texture is
+    16,384 evaluations, against 600,000 in the update.
+
+    The bake program is shaderParticle.comp built with PARTICLE_FIELD_BAKE_PASS defined (see
+    GetBakeShaderDefines(...)), so it evaluates the fields with the same code as the update.
+
+    Note: Half floats have about 3 significant digits, which is plenty for forces that get
+    multiplied by a time step, but the field can't resolve anything smaller than a texel, so
+    a deep, narrow well is better left as a ParticleForceField.
+
+    A field that doesn't change can be compressed to BC5 after it is filled (see Compress()),
+    which is a quarter of the bytes per fetch, at about 7 steps between each 4x4 block's
+    smallest and largest values.
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+class ParticleFieldTexture
+{
+public:
+    ParticleFieldTexture();
+    ~ParticleFieldTexture();
+    void Init(unsigned int bakeProgramId, int width, int height, const glm::vec2 &minCorner,
+        const glm::vec2 &maxCorner);
+    void Cleanup();
+    void ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId);
+
+    void Upload(const std::vector<glm::vec2> &texels);
+    void Bake(const std::vector<ParticleForceField> &forceFields);
+    bool Compress();
+
+    unsigned int GetTextureId() const;
+    float GetValueScale() const;
+    const glm::vec2 &GetMinCorner() const;
+    const glm::vec2 &GetMaxCorner() const;
+
+    static std::string GetBakeShaderDefines(unsigned int workGroupSize = 256);
+
+private:
+    void LoadProgramInterface();
+
+    unsigned int _bakeProgramId;
+    unsigned int _bakeWorkGroupSizeX;
+    unsigned int _unifLocBakeMinCorner;
+    unsigned int _unifLocBakeTexelSize;
+    unsigned int _unifLocBakeForceFieldCount;
+
+    // Note: The image unit and the binding must match shaderParticle.comp.  The binding comes
+    // after the scan's (see GpuScan.h), so a bake can run between any of the other passes.
+    static const unsigned int FIELD_BAKE_IMAGE_UNIT = 1;
+    static const unsigned int FIELD_BAKE_FORCE_FIELD_BUFFER_BINDING = 25;
+    unsigned int _textureId;
+
+    // a BC5 copy of the texture, which stands in for it until the next Upload(...) or
+    // Bake(...) (see Compress())
+    unsigned int _compressedTextureId;
+    float _valueScale;
+    unsigned int _bakeForceFieldBufferId;
+    unsigned int _bakeForceFieldCapacity;
+    int _width;
+    int _height;
+    glm::vec2 _minCorner;
+    glm::vec2 _maxCorner;
+};
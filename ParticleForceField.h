@@ -0,0 +1,77 @@
+#pragma once
+
+#include "glm/vec2.hpp"
+
+#include <cstddef>
+
+// what a force field does to the particles (see ParticleForceField)
+// Note: Must match the FORCE_FIELD_* defines in shaderParticle.comp.
+enum ParticleForceFieldType
+{
+    // pulls toward the center with a strength that falls off with the square of the distance
+    // (a gravity well); a negative strength pushes away instead
+    PARTICLE_FORCE_FIELD_ATTRACTOR = 0,
+
+    // pushes around the center, counterclockwise for a positive strength, with a strength
+    // that falls off with the distance
+    PARTICLE_FORCE_FIELD_VORTEX,
+
+    // the same push everywhere, along the direction
+    PARTICLE_FORCE_FIELD_WIND,
+
+    // slows particles down in proportion to their speed (ex: a thick fluid)
+    PARTICLE_FORCE_FIELD_LINEAR_DRAG,
+
+    // slows particles down in proportion to the square of their speed (ex: air)
+    PARTICLE_FORCE_FIELD_QUADRATIC_DRAG,
+};
+
+// what the texels of a field texture are (see ParticleManager::SetFieldTexture(...))
+// Note: Must match the FIELD_TEXTURE_MODE_* defines in shaderParticle.comp.
+enum ParticleFieldTextureMode
+{
+    // added to the particle's velocity every second, times the response
+    PARTICLE_FIELD_TEXTURE_ACCELERATION = 0,
+
+    // the velocity of a flow that carries the particles along; the particle accelerates toward
+    // it by the difference times the response, so a strong response follows the flow exactly
+    // and a weak one drifts into it
+    PARTICLE_FIELD_TEXTURE_VELOCITY,
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Describes one force field: an acceleration that the compute shader adds to every active
+    particle's velocity on every update step.  ParticleManager uploads the whole table to a
+    shader storage buffer (see ParticleManager::SetForceFields(...)), and the update kernel
+    loops over it, so changing the forces doesn't need a new program.
+
+    The fields are global, not per emitter.  Every particle reads the same descriptors, so
+    they stay in the cache, and a table of a few dozen fields costs arithmetic rather than
+    memory bandwidth.
+
+    Note: This structure is uploaded as-is into a std430 buffer and must match the
+    "ForceField" structure in shaderParticle.comp.
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+struct ParticleForceField
+{
+    glm::vec2 _center;      // attractors and vortices; window coordinates
+    glm::vec2 _direction;   // wind only; doesn't need to be normalized (the length scales it)
+
+    // window units per second squared; for the drags, per second (linear) or per window unit
+    // (quadratic)
+    float _strength;
+
+    // attractors and vortices: the distance under which the pull stops growing, so particles
+    // that pass through the center don't get flung out at enormous speed
+    float _softeningRadius;
+
+    unsigned int _type;     // a ParticleForceFieldType
+    unsigned int _padding;
+};
+
+static_assert(offsetof(ParticleForceField, _center) == 0, "ParticleForceField must match std430");
+static_assert(offsetof(ParticleForceField, _strength) == 16, "ParticleForceField must match std430");
+static_assert(offsetof(ParticleForceField, _type) == 24, "ParticleForceField must match std430");
+static_assert(sizeof(ParticleForceField) == 32, "ParticleForceField must match std430");
@@ -0,0 +1,457 @@
+#include "ParticleGravityTree.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
+#include "ShaderProgramRegistry.h"
+#include "GpuMemoryLedger.h"
+#include "ComputeDeviceCaps.h"
+#include "Log.h"
+
+// must match the GRAVITY_STAGE_* defines in shaderParticle.comp
+enum GravityTreeStage
+{
+    GRAVITY_STAGE_KEYS = 0,
+    GRAVITY_STAGE_SORT_LOCAL,
+    GRAVITY_STAGE_SORT_GLOBAL,
+    GRAVITY_STAGE_GATHER,
+    GRAVITY_STAGE_HIERARCHY,
+    GRAVITY_STAGE_REFIT,
+    GRAVITY_STAGE_ATTRACT,
+};
+
+// must match "GravityNode" in shaderParticle.comp: 2 vec4s and an ivec2, std430, so the
+// struct is padded out to a multiple of a vec4
+static const unsigned int GRAVITY_TREE_NODE_SIZE_BYTES = 48;
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.  The Morton codes cover the window ([-1,+1] on both axes).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleGravityTree::ParticleGravityTree() :
+    _treeProgramId(0),
+    _treeWorkGroupSizeX(ParticleManager::DEFAULT_WORK_GROUP_SIZE),
+    _unifLocGravityStage(0),
+    _unifLocGravityParticleCount(0),
+    _unifLocGravitySortCount(0),
+    _unifLocGravitySortK(0),
+    _unifLocGravitySortJ(0),
+    _unifLocGravityBoundsMin(0),
+    _unifLocGravityBoundsInverseSize(0),
+    _unifLocGravityDeltaSec(0),
+    _unifLocGravityStrength(0),
+    _unifLocGravitySofteningSqr(0),
+    _unifLocGravityOpeningAngleSqr(0),
+    _minCorner(-1.0f, -1.0f),
+    _maxCorner(+1.0f, +1.0f),
+    _strength(1e-7f),
+    _softening(0.01f),
+    _openingAngle(0.5f),
+    _isTreeBuilt(false),
+    _pairBufferId(0),
+    _leafBufferId(0),
+    _nodeBufferId(0),
+    _parentBufferId(0),
+    _visitCountBufferId(0),
+    _countBufferId(0),
+    _sortCapacity(0)
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleGravityTree::~ParticleGravityTree()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes a reference to the tree program (see ShaderProgramRegistry.h).  The buffers are
+    created by the first Build(...), which knows the pool size.  The caller may release their
+    own reference after this returns.
+Parameters:
+    treeProgramId   shaderParticle.comp generated with GetGravityTreeShaderDefines(...).  Must
+                    be built for the same particle layout as the particle manager's program.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleGravityTree::Init(unsigned int treeProgramId)
+{
+    this->Cleanup();
+    if (treeProgramId == 0)
+    {
+        LogPrintf("the gravity tree needs its tree program\n");
+        return;
+    }
+
+    // same as the neighbor grid; these come after everything else's
+    GLint maxBindings = 0;
+    glGetIntegerv(GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS, &maxBindings);
+    if (maxBindings <= (GLint)GRAVITY_COUNT_BUFFER_BINDING)
+    {
+        LogPrintf("the gravity tree needs %u shader storage bindings, but there are only %d\n",
+            GRAVITY_COUNT_BUFFER_BINDING + 1, maxBindings);
+        return;
+    }
+
+    _treeProgramId = treeProgramId;
+    AddProgramReference(_treeProgramId);
+    this->LoadProgramInterface();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Releases the program and deletes the tree buffers.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleGravityTree::Cleanup()
+{
+    if (_treeProgramId != 0)
+    {
+        ReleaseProgram(_treeProgramId);
+        _treeProgramId = 0;
+    }
+
+    unsigned int *bufferIds[6] = { &_pairBufferId, &_leafBufferId, &_nodeBufferId,
+        &_parentBufferId, &_visitCountBufferId, &_countBufferId };
+    for (int bufferIndex = 0; bufferIndex < 6; bufferIndex++)
+    {
+        ForgetGpuAllocation(GPU_MEMORY_BUFFER, *bufferIds[bufferIndex]);
+        DeleteGlBuffers(1, bufferIds[bufferIndex]);
+        *bufferIds[bufferIndex] = 0;
+    }
+    _sortCapacity = 0;
+    _isTreeBuilt = false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Switches to a rebuilt program (see ParticleManager::ReplaceProgram(...)).
+Parameters:
+    oldProgramId    Self-explanatory.  Programs that this tree doesn't use are ignored.
+    newProgramId    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleGravityTree::ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId)
+{
+    if (oldProgramId == 0 || newProgramId == 0 || _treeProgramId != oldProgramId)
+    {
+        return;
+    }
+
+    AddProgramReference(newProgramId);
+    ReleaseProgram(_treeProgramId);
+    _treeProgramId = newProgramId;
+    this->LoadProgramInterface();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets the region that the Morton codes cover.  Particles outside of it still pull and are
+    pulled, but they are clamped to its edges for the sort, so the tree around them is
+    lopsided and the walk costs more.
+Parameters:
+    minCorner   Self-explanatory.
+    maxCorner   Must be greater than the min corner on both axes.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleGravityTree::SetBounds(const glm::vec2 &minCorner, const glm::vec2 &maxCorner)
+{
+    if (maxCorner.x <= minCorner.x || maxCorner.y <= minCorner.y)
+    {
+        LogPrintf("gravity tree bounds are empty: (%f, %f) to (%f, %f)\n",
+            minCorner.x, minCorner.y, maxCorner.x, maxCorner.y);
+        return;
+    }
+
+    _minCorner = minCorner;
+    _maxCorner = maxCorner;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets how the particles pull on each other.  Can be changed at any time.
+Parameters:
+    strength        The pull of one particle on another 1 unit away, in window units per
+                    second squared.  With hundreds of thousands of particles, this needs to
+                    be tiny.
+    softening       A distance that is added (squared) to every distance (squared), so that
+                    particles that pass close by don't fling each other away.  Must be at
+                    least 0.
+    openingAngle    A node pulls as one mass if its size is less than this times how far away
+                    its center of mass is.  0 opens every node, which is exact but is all
+                    pairs; 0.5 is the usual trade.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleGravityTree::SetGravity(float strength, float softening, float openingAngle)
+{
+    if (softening < 0.0f || openingAngle < 0.0f)
+    {
+        LogPrintf("gravity softening (%f) and opening angle (%f) must be at least 0\n",
+            softening, openingAngle);
+        return;
+    }
+
+    _strength = strength;
+    _softening = softening;
+    _openingAngle = openingAngle;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Builds the tree over every active particle.  Must be called after the particles have moved
+    this frame and before ApplyGravity(...).
+Parameters:
+    maxParticleCount    The size of the particle pool.  The dispatches are sized on the CPU,
+                        so they cover all of it, and the inactive particles are skipped on the
+                        GPU, which is the only one that knows how many are active.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleGravityTree::Build(unsigned int maxParticleCount)
+{
+    _isTreeBuilt = false;
+    if (_treeProgramId == 0 || maxParticleCount == 0)
+    {
+        return;
+    }
+
+    // a power of 2 keys, and no fewer than one block, same as the particle sort
+    unsigned int blockSize = _treeWorkGroupSizeX * 2;
+    unsigned int sortCount = blockSize;
+    while (sortCount < maxParticleCount)
+    {
+        sortCount <<= 1;
+    }
+    if (sortCount > _sortCapacity)
+    {
+        this->InitTreeBuffers(sortCount);
+    }
+
+    // the update wrote the particles with shader storage writes, and the last frame's walk
+    // must be done before the tree is overwritten
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    // the active count and the refit's visits are added to, so they start at 0 every frame
+    GLuint zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _countBufferId);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _visitCountBufferId);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // bound every frame because other passes are free to use these binding points too
+    BindGlShaderStorageBuffer(GRAVITY_PAIR_BUFFER_BINDING, _pairBufferId);
+    BindGlShaderStorageBuffer(GRAVITY_LEAF_BUFFER_BINDING, _leafBufferId);
+    BindGlShaderStorageBuffer(GRAVITY_NODE_BUFFER_BINDING, _nodeBufferId);
+    BindGlShaderStorageBuffer(GRAVITY_PARENT_BUFFER_BINDING, _parentBufferId);
+    BindGlShaderStorageBuffer(GRAVITY_VISIT_COUNT_BUFFER_BINDING, _visitCountBufferId);
+    BindGlShaderStorageBuffer(GRAVITY_COUNT_BUFFER_BINDING, _countBufferId);
+
+    glm::vec2 boundsSize = _maxCorner - _minCorner;
+    UseGlProgram(_treeProgramId);
+    glUniform1ui(_unifLocGravityParticleCount, maxParticleCount);
+    glUniform1ui(_unifLocGravitySortCount, sortCount);
+    glUniform2f(_unifLocGravityBoundsMin, _minCorner.x, _minCorner.y);
+    glUniform2f(_unifLocGravityBoundsInverseSize, 1.0f / boundsSize.x, 1.0f / boundsSize.y);
+
+    unsigned int numKeyWorkGroups = sortCount / _treeWorkGroupSizeX;
+    unsigned int numBlockWorkGroups = sortCount / blockSize;
+    this->DispatchTreeStage(GRAVITY_STAGE_KEYS, numKeyWorkGroups);
+
+    // same as ParticleManager::SortParticles(): every block from scratch, then each bigger
+    // sequence is the global compare distances down to a block followed by the rest of them
+    // in shared memory
+    glUniform1ui(_unifLocGravitySortK, 0);
+    this->DispatchTreeStage(GRAVITY_STAGE_SORT_LOCAL, numBlockWorkGroups);
+    for (unsigned int k = blockSize * 2; k <= sortCount; k <<= 1)
+    {
+        glUniform1ui(_unifLocGravitySortK, k);
+        for (unsigned int j = k / 2; j >= blockSize; j /= 2)
+        {
+            glUniform1ui(_unifLocGravitySortJ, j);
+            this->DispatchTreeStage(GRAVITY_STAGE_SORT_GLOBAL, numBlockWorkGroups);
+        }
+        this->DispatchTreeStage(GRAVITY_STAGE_SORT_LOCAL, numBlockWorkGroups);
+    }
+
+    // the rest are one active particle (or internal node) per work item
+    unsigned int numParticleWorkGroups =
+        (maxParticleCount + _treeWorkGroupSizeX - 1) / _treeWorkGroupSizeX;
+    this->DispatchTreeStage(GRAVITY_STAGE_GATHER, numParticleWorkGroups);
+    this->DispatchTreeStage(GRAVITY_STAGE_HIERARCHY, numParticleWorkGroups);
+    this->DispatchTreeStage(GRAVITY_STAGE_REFIT, numParticleWorkGroups);
+    UseGlProgram(0);
+
+    _isTreeBuilt = true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Has every active particle feel the pull of all of the others (see SetGravity(...)), by
+    changing its velocity.  Uses the tree from the last Build(...), which must have been this
+    frame.
+Parameters:
+    deltaTimeSec        How much simulation time the change in velocity is for.  0 does
+                        nothing.
+    maxParticleCount    Same as for Build(...).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleGravityTree::ApplyGravity(float deltaTimeSec, unsigned int maxParticleCount)
+{
+    if (!_isTreeBuilt || deltaTimeSec <= 0.0f || maxParticleCount > _sortCapacity)
+    {
+        return;
+    }
+
+    UseGlProgram(_treeProgramId);
+    glUniform1f(_unifLocGravityDeltaSec, deltaTimeSec);
+    glUniform1f(_unifLocGravityStrength, _strength);
+    glUniform1f(_unifLocGravitySofteningSqr, _softening * _softening);
+    glUniform1f(_unifLocGravityOpeningAngleSqr, _openingAngle * _openingAngle);
+
+    // one work item per active particle, in Morton order, so that the work items in a group
+    // walk mostly the same nodes
+    this->DispatchTreeStage(GRAVITY_STAGE_ATTRACT,
+        (maxParticleCount + _treeWorkGroupSizeX - 1) / _treeWorkGroupSizeX);
+    UseGlProgram(0);
+
+    // same as the neighbor grid's interactions
+    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT |
+        GL_BUFFER_UPDATE_BARRIER_BIT);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    layout          Must be the particle manager's layout.
+    workGroupSize   Self-explanatory.
+Returns:
+    The defines to give to AcquireComputeProgram(...) for the tree program.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+std::string ParticleGravityTree::GetGravityTreeShaderDefines(ParticleLayout layout,
+    unsigned int workGroupSize)
+{
+    return ParticleManager::GetComputeShaderDefines(layout, workGroupSize) +
+        "#define PARTICLE_GRAVITY_TREE_PASS\n";
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Looks up the tree program's uniforms and work group size.  Called by Init(...) and
+    whenever the program is replaced.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleGravityTree::LoadProgramInterface()
+{
+    _unifLocGravityStage = glGetUniformLocation(_treeProgramId, "uGravityStage");
+    _unifLocGravityParticleCount = glGetUniformLocation(_treeProgramId, "uGravityParticleCount");
+    _unifLocGravitySortCount = glGetUniformLocation(_treeProgramId, "uGravitySortCount");
+    _unifLocGravitySortK = glGetUniformLocation(_treeProgramId, "uGravitySortK");
+    _unifLocGravitySortJ = glGetUniformLocation(_treeProgramId, "uGravitySortJ");
+    _unifLocGravityBoundsMin = glGetUniformLocation(_treeProgramId, "uGravityBoundsMin");
+    _unifLocGravityBoundsInverseSize =
+        glGetUniformLocation(_treeProgramId, "uGravityBoundsInverseSize");
+    _unifLocGravityDeltaSec = glGetUniformLocation(_treeProgramId, "uGravityDeltaSec");
+    _unifLocGravityStrength = glGetUniformLocation(_treeProgramId, "uGravityStrength");
+    _unifLocGravitySofteningSqr = glGetUniformLocation(_treeProgramId, "uGravitySofteningSqr");
+    _unifLocGravityOpeningAngleSqr =
+        glGetUniformLocation(_treeProgramId, "uGravityOpeningAngleSqr");
+
+    // same as ParticleManager::Init(...); the dispatch and the sort's block size must match
+    // the program
+    GLint programWorkGroupSize[3] = { 0, 0, 0 };
+    glGetProgramiv(_treeProgramId, GL_COMPUTE_LOCAL_WORK_SIZE, programWorkGroupSize);
+    _treeWorkGroupSizeX = (programWorkGroupSize[0] > 0) ?
+        programWorkGroupSize[0] : ParticleManager::DEFAULT_WORK_GROUP_SIZE;
+
+    // the blocks are sized for the old work group size
+    _isTreeBuilt = false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    (Re)creates the tree's buffers for a sort of the given size.  Every particle in the pool
+    could be active, so there is room for a leaf per key and an internal node per key but one.
+Parameters:
+    sortCount   A power of 2, at least the pool size.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleGravityTree::InitTreeBuffers(unsigned int sortCount)
+{
+    // GPU-only, like the neighbor grid's buffers
+    unsigned int internalNodeCount = sortCount - 1;
+    unsigned int *bufferIds[6] = { &_pairBufferId, &_leafBufferId, &_nodeBufferId,
+        &_parentBufferId, &_visitCountBufferId, &_countBufferId };
+    size_t bufferSizes[6] = {
+        (size_t)sortCount * 2 * sizeof(GLuint),
+        (size_t)sortCount * sizeof(glm::vec2),
+        (size_t)internalNodeCount * GRAVITY_TREE_NODE_SIZE_BYTES,
+        (size_t)(internalNodeCount + sortCount) * sizeof(GLint),
+        (size_t)internalNodeCount * sizeof(GLuint),
+        sizeof(GLuint),
+    };
+    for (int bufferIndex = 0; bufferIndex < 6; bufferIndex++)
+    {
+        ForgetGpuAllocation(GPU_MEMORY_BUFFER, *bufferIds[bufferIndex]);
+        DeleteGlBuffers(1, bufferIds[bufferIndex]);
+        glGenBuffers(1, bufferIds[bufferIndex]);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, *bufferIds[bufferIndex]);
+        glBufferStorage(GL_SHADER_STORAGE_BUFFER, bufferSizes[bufferIndex], 0, 0);
+        RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "gravity tree");
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    _sortCapacity = sortCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Runs one stage and puts up a barrier for the next stage, which reads what this one wrote.
+Parameters:
+    stage           One of the GRAVITY_STAGE_* values.
+    numWorkGroups   Split into rows if there are more than the device allows in X (see
+                    GetComputeDispatchSize(...)).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleGravityTree::DispatchTreeStage(int stage, unsigned int numWorkGroups)
+{
+    unsigned int numWorkGroupsX = 0;
+    unsigned int numWorkGroupsY = 0;
+    GetComputeDispatchSize(numWorkGroups, &numWorkGroupsX, &numWorkGroupsY);
+    glUniform1i(_unifLocGravityStage, stage);
+    glDispatchCompute(numWorkGroupsX, numWorkGroupsY, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "ParticleManager.h"
+#include "glm/vec2.hpp"
+
+#include <string>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Barnes-Hut gravity between every pair of active particles, built on the GPU every frame.
+    All pairs would be hundreds of billions of pulls per frame at 600,000 particles; with the
+    tree, a particle feels the far ones a whole node at a time, and it costs about
+    log2(particle count) node visits instead.
+
+    The tree is built the same way as the segment BVH's (see ParticleSegmentBvh.h): the active
+    particles are sorted by the Morton codes of their positions, every internal node finds its
+    range of the sorted list and its split from the codes, and then each node's box, mass, and
+    center of mass are filled in from the leaves up.  Then every particle walks the tree from
+    the root without a stack (the nodes know their parents), and a node that is small enough
+    for how far away it is (see SetGravity(...)) pulls as one mass at its center of mass.
+
+    The tree program is shaderParticle.comp built with PARTICLE_GRAVITY_TREE_PASS defined (see
+    GetGravityTreeShaderDefines(...)), so, like the neighbor grid (see ParticleNeighborGrid.h),
+    it reads and writes the particles through the particle manager's bindings and must run
+    after the update.
+
+    The build is 5 + m * (m + 3) / 2 dispatches, where m is log2(n / block size) for the pool
+    rounded up to a power of 2 (n) and the sort's shared memory block, like the particle sort
+    (see ParticleManager::SortParticles()).  That is about 80 for 600,000 particles, plus one
+    for the pull.
+
+    Note: The masses are all 1, since the particles don't have one of their own.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class ParticleGravityTree
+{
+public:
+    ParticleGravityTree();
+    ~ParticleGravityTree();
+    void Init(unsigned int treeProgramId);
+    void Cleanup();
+    void ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId);
+
+    void SetBounds(const glm::vec2 &minCorner, const glm::vec2 &maxCorner);
+    void SetGravity(float strength, float softening, float openingAngle);
+
+    void Build(unsigned int maxParticleCount);
+    void ApplyGravity(float deltaTimeSec, unsigned int maxParticleCount);
+
+    static std::string GetGravityTreeShaderDefines(ParticleLayout layout,
+        unsigned int workGroupSize = ParticleManager::DEFAULT_WORK_GROUP_SIZE);
+
+private:
+    void LoadProgramInterface();
+    void InitTreeBuffers(unsigned int sortCount);
+    void DispatchTreeStage(int stage, unsigned int numWorkGroups);
+
+    unsigned int _treeProgramId;
+    unsigned int _treeWorkGroupSizeX;
+    unsigned int _unifLocGravityStage;
+    unsigned int _unifLocGravityParticleCount;
+    unsigned int _unifLocGravitySortCount;
+    unsigned int _unifLocGravitySortK;
+    unsigned int _unifLocGravitySortJ;
+    unsigned int _unifLocGravityBoundsMin;
+    unsigned int _unifLocGravityBoundsInverseSize;
+    unsigned int _unifLocGravityDeltaSec;
+    unsigned int _unifLocGravityStrength;
+    unsigned int _unifLocGravitySofteningSqr;
+    unsigned int _unifLocGravityOpeningAngleSqr;
+
+    // the Morton codes cover [min corner, max corner]
+    glm::vec2 _minCorner;
+    glm::vec2 _maxCorner;
+    float _strength;
+    float _softening;
+    float _openingAngle;
+    bool _isTreeBuilt;
+
+    // Note: The bindings must match shaderParticle.comp.  They come after the neighbor grid's
+    // (see ParticleNeighborGrid.h).
+    static const unsigned int GRAVITY_PAIR_BUFFER_BINDING = 51;
+    static const unsigned int GRAVITY_LEAF_BUFFER_BINDING = 52;
+    static const unsigned int GRAVITY_NODE_BUFFER_BINDING = 53;
+    static const unsigned int GRAVITY_PARENT_BUFFER_BINDING = 54;
+    static const unsigned int GRAVITY_VISIT_COUNT_BUFFER_BINDING = 55;
+    static const unsigned int GRAVITY_COUNT_BUFFER_BINDING = 56;
+    unsigned int _pairBufferId;
+    unsigned int _leafBufferId;
+    unsigned int _nodeBufferId;
+    unsigned int _parentBufferId;
+    unsigned int _visitCountBufferId;
+    unsigned int _countBufferId;
+
+    // the sort count that the buffers were made for
+    unsigned int _sortCapacity;
+};
@@ -0,0 +1,586 @@
+#include "ParticleHeatmapExporter.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
+#include "GlFenceSync.h"
+#include "ShaderProgramRegistry.h"
+#include "GpuMemoryLedger.h"
+#include "Log.h"
+
+#include <string.h>     // memcpy, memset
+
+// how many work groups stride through the pool, and so how many shared histograms are merged
+// Note: Enough to fill a big GPU several times over, and few enough that the merge, at up to
+// HEATMAP_MAX_SHARED_BINS atomics each, is a small part of the pass.
+static const unsigned int HEATMAP_WORK_GROUPS = 256;
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.  Nothing is exported until Init(...) and Start(...).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleHeatmapExporter::ParticleHeatmapExporter() :
+    _heatmapProgramId(0),
+    _heatmapWorkGroupSizeX(ParticleManager::DEFAULT_WORK_GROUP_SIZE),
+    _unifLocHeatmapParticleCount(0),
+    _unifLocHeatmapSize(0),
+    _unifLocHeatmapMinCorner(0),
+    _unifLocHeatmapCellsPerUnit(0),
+    _unifLocHeatmapIsPrivatized(0),
+    _binBufferId(0),
+    _isExporting(false),
+    _isNpy(false),
+    _rawOutput(0),
+    _width(0),
+    _height(0),
+    _intervalSec(1.0f),
+    _nextExportSec(0.0f),
+    _minCorner(-1.0f, -1.0f),
+    _maxCorner(+1.0f, +1.0f),
+    _readbackBufferId(0),
+    _mappedReadback(0),
+    _slotSizeBytes(0),
+    _exportedCount(0),
+    _droppedCount(0),
+    _isStopping(false)
+{
+    for (unsigned int slotIndex = 0; slotIndex < HEATMAP_SLOTS; slotIndex++)
+    {
+        _fences[slotIndex] = 0;
+        _slotStates[slotIndex] = HEATMAP_SLOT_FREE;
+        _slotExportIndexes[slotIndex] = 0;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.  The writer must
+    be joined before the std::thread is destroyed, or the program is terminated.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleHeatmapExporter::~ParticleHeatmapExporter()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes a reference to the heatmap program (see ShaderProgramRegistry.h).  The caller may
+    release their own reference after this returns.
+Parameters:
+    heatmapProgramId    shaderParticle.comp generated with GetHeatmapShaderDefines(...).  Must
+                        be built for the same particle layout as the particle manager's
+                        program.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleHeatmapExporter::Init(unsigned int heatmapProgramId)
+{
+    this->Cleanup();
+    if (heatmapProgramId == 0)
+    {
+        LogPrintf("the heatmap exporter needs its program\n");
+        return;
+    }
+
+    // the binding comes after everyone else's
+    GLint maxBindings = 0;
+    glGetIntegerv(GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS, &maxBindings);
+    if (maxBindings <= (GLint)HEATMAP_BUFFER_BINDING)
+    {
+        LogPrintf("the heatmap exporter needs %u shader storage bindings, but there are "
+            "only %d\n", HEATMAP_BUFFER_BINDING + 1, maxBindings);
+        return;
+    }
+
+    _heatmapProgramId = heatmapProgramId;
+    AddProgramReference(_heatmapProgramId);
+    this->LoadProgramInterface();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Stops any exporting and releases the program.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleHeatmapExporter::Cleanup()
+{
+    this->Stop();
+    if (_heatmapProgramId != 0)
+    {
+        ReleaseProgram(_heatmapProgramId);
+        _heatmapProgramId = 0;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Switches to a rebuilt program (see ParticleManager::ReplaceProgram(...)).
+Parameters:
+    oldProgramId    Self-explanatory.  Programs that this exporter doesn't use are ignored.
+    newProgramId    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleHeatmapExporter::ReplaceProgram(unsigned int oldProgramId,
+    unsigned int newProgramId)
+{
+    if (oldProgramId == 0 || newProgramId == 0 || _heatmapProgramId != oldProgramId)
+    {
+        return;
+    }
+
+    AddProgramReference(newProgramId);
+    ReleaseProgram(_heatmapProgramId);
+    _heatmapProgramId = newProgramId;
+    this->LoadProgramInterface();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Makes the histogram and the ring of readback slots, opens the raw file if it is one, and
+    starts the writer.  The first export is on the first RecordFrame(...).
+Parameters:
+    outputPath  Ends in ".npy" for a NumPy file per export, and anything else for one file of
+                raw float32 grids.  Files are overwritten if they exist.
+    width       The histogram's cells across.
+    height      The histogram's cells up.
+    intervalSec Simulation time between exports.
+    minCorner   The rectangle that the histogram covers, in window space.  Particles outside
+    maxCorner   it aren't counted.
+Returns:
+    False if there is no program, the sizes are bad, or the raw file couldn't be opened,
+    otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleHeatmapExporter::Start(const std::string &outputPath, int width, int height,
+    float intervalSec, const glm::vec2 &minCorner, const glm::vec2 &maxCorner)
+{
+    this->Stop();
+    if (_heatmapProgramId == 0 || width <= 0 || height <= 0 ||
+        maxCorner.x <= minCorner.x || maxCorner.y <= minCorner.y)
+    {
+        return false;
+    }
+
+    _isNpy = outputPath.size() > 4 &&
+        outputPath.compare(outputPath.size() - 4, 4, ".npy") == 0;
+    if (!_isNpy)
+    {
+        _rawOutput = fopen(outputPath.c_str(), "wb");
+        if (_rawOutput == 0)
+        {
+            LogPrintf("heatmap exporter: couldn't open '%s'\n", outputPath.c_str());
+            return false;
+        }
+    }
+
+    _outputPath = outputPath;
+    _width = width;
+    _height = height;
+    _intervalSec = (intervalSec > 0.0f) ? intervalSec : 0.0f;
+    _nextExportSec = 0.0f;
+    _minCorner = minCorner;
+    _maxCorner = maxCorner;
+    _slotSizeBytes = (size_t)width * (size_t)height * sizeof(GLuint);
+    _exportedCount = 0;
+    _droppedCount = 0;
+
+    glGenBuffers(1, &_binBufferId);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _binBufferId);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, _slotSizeBytes, 0, 0);
+    RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "heatmap exporter");
+    BindGlShaderStorageBuffer(HEATMAP_BUFFER_BINDING, _binBufferId);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // Note: Coherent, so once a slot's fence is signaled, the writer can read it with no
+    // barrier and no unmapping.
+    GLbitfield storageFlags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &_readbackBufferId);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, _readbackBufferId);
+    glBufferStorage(GL_COPY_WRITE_BUFFER, _slotSizeBytes * HEATMAP_SLOTS, 0, storageFlags);
+    RecordBoundGlBufferAllocation(GL_COPY_WRITE_BUFFER, "heatmap exporter readback");
+    _mappedReadback = (const unsigned int *)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0,
+        _slotSizeBytes * HEATMAP_SLOTS, storageFlags);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    _floatCells.resize((size_t)width * (size_t)height);
+
+    _isExporting = true;
+    _isStopping = false;
+    _writerThread = std::thread(&ParticleHeatmapExporter::WriterLoop, this);
+    LogPrintf("heatmap exporter: %dx%d every %.2f seconds to '%s'\n", width, height,
+        _intervalSec, outputPath.c_str());
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Waits for the exports that were already read to be written, stops the writer, and closes
+    the raw file.  Safe to call more than once.
+
+    Note: This one waits on the GPU, since the exports in flight would otherwise be lost.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleHeatmapExporter::Stop()
+{
+    if (!_isExporting)
+    {
+        return;
+    }
+
+    this->HandOffFinishedSlots(true);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _isStopping = true;
+    }
+    _condition.notify_all();
+    _writerThread.join();
+    _isExporting = false;
+
+    if (_rawOutput != 0)
+    {
+        fclose(_rawOutput);
+        _rawOutput = 0;
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, _readbackBufferId);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _readbackBufferId);
+    DeleteGlBuffers(1, &_readbackBufferId);
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _binBufferId);
+    DeleteGlBuffers(1, &_binBufferId);
+    _readbackBufferId = 0;
+    _binBufferId = 0;
+    _mappedReadback = 0;
+    for (unsigned int slotIndex = 0; slotIndex < HEATMAP_SLOTS; slotIndex++)
+    {
+        _slotStates[slotIndex] = HEATMAP_SLOT_FREE;
+    }
+    _readySlots.clear();
+    _floatCells.clear();
+
+    LogPrintf("heatmap exporter: stopped after %u exports (%u dropped)\n", _exportedCount,
+        _droppedCount);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    True if Start(...) was called and Stop() hasn't been since, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleHeatmapExporter::IsExporting() const
+{
+    return _isExporting;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Hands the finished exports to the writer, and then, if it is time for another one, bins
+    the particles as the last update left them and starts reading the histogram back.  Call
+    after the updates (and anything else that moves the particles) are done for the frame.
+    Never waits.
+Parameters:
+    particleCount   The particle manager's pool size.
+    timeSec         The simulation's time, which paces the exports.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleHeatmapExporter::RecordFrame(unsigned int particleCount, float timeSec)
+{
+    if (!_isExporting)
+    {
+        return;
+    }
+
+    this->HandOffFinishedSlots(false);
+    if (timeSec < _nextExportSec)
+    {
+        return;
+    }
+
+    // from now rather than from the last export, so a stall doesn't set off a burst of them
+    _nextExportSec = timeSec + _intervalSec;
+
+    unsigned int freeSlot = HEATMAP_SLOTS;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (unsigned int slotIndex = 0; slotIndex < HEATMAP_SLOTS; slotIndex++)
+        {
+            if (_slotStates[slotIndex] == HEATMAP_SLOT_FREE)
+            {
+                freeSlot = slotIndex;
+                _slotStates[slotIndex] = HEATMAP_SLOT_READING;
+                break;
+            }
+        }
+    }
+    if (freeSlot == HEATMAP_SLOTS)
+    {
+        _droppedCount++;
+        return;
+    }
+    _slotExportIndexes[freeSlot] = _exportedCount;
+
+    // Note: The clear is a command on the buffer, like the copy below, so it needs no
+    // barrier before the dispatch.
+    GLuint zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _binBufferId);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT,
+        &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    unsigned int binCount = (unsigned int)(_width * _height);
+    unsigned int workGroupsNeeded =
+        (particleCount + _heatmapWorkGroupSizeX - 1) / _heatmapWorkGroupSizeX;
+    unsigned int numWorkGroupsX = (workGroupsNeeded < HEATMAP_WORK_GROUPS) ?
+        workGroupsNeeded : HEATMAP_WORK_GROUPS;
+    glm::vec2 cellsPerUnit = glm::vec2((float)_width, (float)_height) / (_maxCorner - _minCorner);
+    UseGlProgram(_heatmapProgramId);
+    glUniform1ui(_unifLocHeatmapParticleCount, particleCount);
+    glUniform2ui(_unifLocHeatmapSize, (GLuint)_width, (GLuint)_height);
+    glUniform2f(_unifLocHeatmapMinCorner, _minCorner.x, _minCorner.y);
+    glUniform2f(_unifLocHeatmapCellsPerUnit, cellsPerUnit.x, cellsPerUnit.y);
+    glUniform1ui(_unifLocHeatmapIsPrivatized, (binCount <= HEATMAP_MAX_SHARED_BINS) ? 1 : 0);
+    if (numWorkGroupsX > 0)
+    {
+        glDispatchCompute(numWorkGroupsX, 1, 1);
+    }
+    UseGlProgram(0);
+
+    // the copy reads what the pass wrote
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_COPY_READ_BUFFER, _binBufferId);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, _readbackBufferId);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0,
+        freeSlot * _slotSizeBytes, _slotSizeBytes);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    _fences[freeSlot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    _readingSlots.push_back(freeSlot);
+    _exportedCount++;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The histograms that were read since Start(...), whether or not they have been written
+    yet.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleHeatmapExporter::GetExportedCount() const
+{
+    return _exportedCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The exports that were skipped since Start(...) because there was no free slot.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleHeatmapExporter::GetDroppedCount() const
+{
+    return _droppedCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Puts the heatmap pass's #define after the particle layout's (see
+    ParticleManager::GetComputeShaderDefines(...)).
+Parameters:
+    layout          Must be the particle manager's.
+    workGroupSize   Self-explanatory.
+Returns:
+    A block of #defines for GenerateComputeShaderProgram(...).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+std::string ParticleHeatmapExporter::GetHeatmapShaderDefines(ParticleLayout layout,
+    unsigned int workGroupSize)
+{
+    return ParticleManager::GetComputeShaderDefines(layout, workGroupSize) +
+        "#define PARTICLE_HEATMAP_PASS\n";
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Looks up the heatmap program's uniforms and work group size.  Called by Init(...) and
+    whenever the program is replaced.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleHeatmapExporter::LoadProgramInterface()
+{
+    _unifLocHeatmapParticleCount = glGetUniformLocation(_heatmapProgramId,
+        "uHeatmapParticleCount");
+    _unifLocHeatmapSize = glGetUniformLocation(_heatmapProgramId, "uHeatmapSize");
+    _unifLocHeatmapMinCorner = glGetUniformLocation(_heatmapProgramId, "uHeatmapMinCorner");
+    _unifLocHeatmapCellsPerUnit = glGetUniformLocation(_heatmapProgramId,
+        "uHeatmapCellsPerUnit");
+    _unifLocHeatmapIsPrivatized = glGetUniformLocation(_heatmapProgramId,
+        "uHeatmapIsPrivatized");
+
+    // same as ParticleManager::Init(...); the stride must match the program
+    GLint programWorkGroupSize[3] = { 0, 0, 0 };
+    glGetProgramiv(_heatmapProgramId, GL_COMPUTE_LOCAL_WORK_SIZE, programWorkGroupSize);
+    _heatmapWorkGroupSizeX = (programWorkGroupSize[0] > 0) ?
+        programWorkGroupSize[0] : ParticleManager::DEFAULT_WORK_GROUP_SIZE;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Passes the slots whose reads are done to the writer, oldest first, so that the exports
+    stay in order.  Stops at the first one that isn't done.
+Parameters:
+    waitForGpu  If true, waits for every slot instead of stopping.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleHeatmapExporter::HandOffFinishedSlots(bool waitForGpu)
+{
+    bool handedOff = false;
+    while (!_readingSlots.empty())
+    {
+        unsigned int slotIndex = _readingSlots.front();
+        GLsync slotFence = (GLsync)_fences[slotIndex];
+        if (!waitForGpu && !IsGlFenceSignaled(slotFence))
+        {
+            break;
+        }
+        WaitForGlFence(slotFence, GL_FENCE_WAIT_FOREVER, "heatmap readback");
+
+        glDeleteSync(slotFence);
+        _fences[slotIndex] = 0;
+        _readingSlots.pop_front();
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _slotStates[slotIndex] = HEATMAP_SLOT_WRITING;
+            _readySlots.push_back(slotIndex);
+        }
+        handedOff = true;
+    }
+    if (handedOff)
+    {
+        _condition.notify_all();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The writer thread.  Writes the ready slots in order until it is told to stop, and after
+    that, until there are none left.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleHeatmapExporter::WriterLoop()
+{
+    while (true)
+    {
+        unsigned int slotIndex = 0;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _condition.wait(lock, [this]() { return _isStopping || !_readySlots.empty(); });
+            if (_readySlots.empty())
+            {
+                // stopping, and everything has been written
+                return;
+            }
+            slotIndex = _readySlots.front();
+            _readySlots.pop_front();
+        }
+
+        this->WriteHeatmap(slotIndex);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _slotStates[slotIndex] = HEATMAP_SLOT_FREE;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Turns one histogram's counts into floats and writes them, either to their own NumPy file
+    (version 1.0: the magic string, the version, a little-endian 16-bit header length, and a
+    Python dictionary padded with spaces so that the data starts on a 64-byte boundary) or to
+    the end of the raw file.
+
+    Note: Runs on the writer thread.
+Parameters:
+    slotIndex   The slot that the histogram was read into.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleHeatmapExporter::WriteHeatmap(unsigned int slotIndex)
+{
+    const unsigned int *counts = _mappedReadback + (slotIndex * (size_t)_width * _height);
+    size_t cellCount = _floatCells.size();
+    for (size_t cellIndex = 0; cellIndex < cellCount; cellIndex++)
+    {
+        _floatCells[cellIndex] = (float)counts[cellIndex];
+    }
+
+    if (!_isNpy)
+    {
+        fwrite(_floatCells.data(), sizeof(float), cellCount, _rawOutput);
+        return;
+    }
+
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), "_%06u.npy", _slotExportIndexes[slotIndex]);
+    std::string filePath = _outputPath.substr(0, _outputPath.size() - 4) + suffix;
+    FILE *npyFile = fopen(filePath.c_str(), "wb");
+    if (npyFile == 0)
+    {
+        LogPrintf("heatmap exporter: couldn't open '%s'\n", filePath.c_str());
+        return;
+    }
+
+    // the 10 bytes before the dictionary, the dictionary, and the padding end in a newline
+    char header[128];
+    memset(header, ' ', sizeof(header));
+    int dictionaryLength = snprintf(header + 10, sizeof(header) - 10,
+        "{'descr': '<f4', 'fortran_order': False, 'shape': (%d, %d), }", _height, _width);
+    size_t headerSize = (10 + (size_t)dictionaryLength + 1 + 63) & ~(size_t)63;
+    header[10 + dictionaryLength] = ' ';
+    header[headerSize - 1] = '\n';
+    unsigned short dictionarySize = (unsigned short)(headerSize - 10);
+    memcpy(header, "\x93NUMPY\x01\x00", 8);
+    header[8] = (char)(dictionarySize & 0xFF);
+    header[9] = (char)(dictionarySize >> 8);
+    fwrite(header, 1, headerSize, npyFile);
+    fwrite(_floatCells.data(), sizeof(float), cellCount, npyFile);
+    fclose(npyFile);
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "ParticleManager.h"
+
+#include "glm/vec2.hpp"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdio.h>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Exports a 2D histogram of where the particles are (how many are in each cell of a grid
+    over a rectangle of window space) every so often, for analytics that want occupancy and
+    not positions.  A 256x256 histogram is 256KB, where 8 million raw positions would be 64MB.
+
+    A pass of the heatmap program bins every active particle into a buffer of counts on the
+    GPU.  If the grid is small enough to fit in shared memory (HEATMAP_MAX_SHARED_BINS), each
+    work group counts into its own copy there first and merges it into the buffer with one
+    global atomic per non-empty bin; otherwise every particle goes straight to a global
+    atomic, which is spread across enough bins that it doesn't contend much.  Either way, a
+    fixed number of work groups stride through the whole pool, so there are only that many
+    merges.  The counts are copied into a ring of persistently mapped slots and fenced, and a
+    writer thread turns them into 32-bit floats and writes them out once the fence has
+    signaled.  Like the trajectory recorder, an export with no free slot is dropped and
+    counted rather than waited on.
+
+    The output is a file per export if the path ends in ".npy" (NumPy's format, with the
+    export's index before the extension: "heatmap.npy" becomes "heatmap_000000.npy" and so
+    on), and one file of raw float32 grids, one after another, otherwise.  Either way, each
+    grid is height rows of width cells, and the first row is the bottom of the rectangle.
+
+    The heatmap program is shaderParticle.comp built with PARTICLE_HEATMAP_PASS defined (see
+    GetHeatmapShaderDefines(...)), so it loads particles with the same storage layout code as
+    the update.  It reads the particle buffers through the shader storage bindings that
+    ParticleManager set up, so it must run after the update and while that particle manager
+    is alive.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class ParticleHeatmapExporter
+{
+public:
+    ParticleHeatmapExporter();
+    ~ParticleHeatmapExporter();
+    void Init(unsigned int heatmapProgramId);
+    void Cleanup();
+    void ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId);
+
+    bool Start(const std::string &outputPath, int width, int height, float intervalSec,
+        const glm::vec2 &minCorner, const glm::vec2 &maxCorner);
+    void Stop();
+    bool IsExporting() const;
+    void RecordFrame(unsigned int particleCount, float timeSec);
+    unsigned int GetExportedCount() const;
+    unsigned int GetDroppedCount() const;
+
+    static std::string GetHeatmapShaderDefines(ParticleLayout layout,
+        unsigned int workGroupSize = ParticleManager::DEFAULT_WORK_GROUP_SIZE);
+
+    // must match HEATMAP_MAX_SHARED_BINS in shaderParticle.comp; 16KB of shared memory, which
+    // is half of the least that GL 4.3 guarantees (ex: 64x64)
+    static const unsigned int HEATMAP_MAX_SHARED_BINS = 4096;
+
+private:
+    enum SlotState
+    {
+        HEATMAP_SLOT_FREE = 0,
+        HEATMAP_SLOT_READING,       // waiting on the GPU
+        HEATMAP_SLOT_WRITING,       // with the writer thread
+    };
+
+    void LoadProgramInterface();
+    void HandOffFinishedSlots(bool waitForGpu);
+    void WriterLoop();
+    void WriteHeatmap(unsigned int slotIndex);
+
+    unsigned int _heatmapProgramId;
+    unsigned int _heatmapWorkGroupSizeX;
+    unsigned int _unifLocHeatmapParticleCount;
+    unsigned int _unifLocHeatmapSize;
+    unsigned int _unifLocHeatmapMinCorner;
+    unsigned int _unifLocHeatmapCellsPerUnit;
+    unsigned int _unifLocHeatmapIsPrivatized;
+
+    // the counts
+    // Note: The binding continues from ParticleStatsReducer's and must match
+    // shaderParticle.comp.
+    static const unsigned int HEATMAP_BUFFER_BINDING = 40;
+    unsigned int _binBufferId;
+
+    // a second between exports leaves plenty of time, so there is no need for more
+    static const unsigned int HEATMAP_SLOTS = 3;
+    std::string _outputPath;
+    bool _isExporting;
+    bool _isNpy;
+    FILE *_rawOutput;
+    int _width;
+    int _height;
+    float _intervalSec;
+    float _nextExportSec;
+    glm::vec2 _minCorner;
+    glm::vec2 _maxCorner;
+    unsigned int _readbackBufferId;
+    const unsigned int *_mappedReadback;
+    size_t _slotSizeBytes;
+    void *_fences[HEATMAP_SLOTS];
+    std::deque<unsigned int> _readingSlots;
+    unsigned int _exportedCount;
+    unsigned int _droppedCount;
+
+    // same handoff as FrameCapture's
+    // Note: The export indexes are set by the render thread before the slot is handed off,
+    // and only read by the writer after.
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::thread _writerThread;
+    std::deque<unsigned int> _readySlots;
+    SlotState _slotStates[HEATMAP_SLOTS];
+    unsigned int _slotExportIndexes[HEATMAP_SLOTS];
+    bool _isStopping;
+
+    // only the writer touches this
+    std::vector<float> _floatCells;
+};
@@ -0,0 +1,412 @@
+#include "ParticleInjectionRing.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "ComputeDeviceCaps.h"
+#include "GlFenceSync.h"
+#include "GpuMemoryLedger.h"
+#include "OpenGlErrorHandling.h"
+#include "Log.h"
+
+#include <string.h>     // memcpy
+
+// the front of each slot, which is the indirect dispatch of the scatter pass
+// Note: Must match InjectionSlotBuffer in shaderParticle.comp.  The first 3 are a
+// DispatchIndirectCommand, and the padding puts the records on a 16-byte boundary.
+struct InjectionSlotHeader
+{
+    unsigned int _numGroupsX;
+    unsigned int _numGroupsY;
+    unsigned int _numGroupsZ;
+    unsigned int _recordCount;
+    unsigned int _emitterIndex;
+    unsigned int _padding[3];
+};
+static_assert(sizeof(InjectionSlotHeader) == 32, "InjectionSlotHeader must match std430");
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.  Nothing is mapped until Init(...).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleInjectionRing::ParticleInjectionRing() :
+    _mapped(0),
+    _slotStrideBytes(0),
+    _slotCount(0),
+    _recordsPerSlot(0),
+    _nextWriteSlot(0),
+    _nextTakeSlot(0),
+    _injectedRecords(0),
+    _droppedRecords(0),
+    _refusedWrites(0)
+{
+    for (unsigned int slotIndex = 0; slotIndex < MAX_SLOT_COUNT; slotIndex++)
+    {
+        _slotStates[slotIndex].store(SLOT_FREE, std::memory_order_relaxed);
+        _slotEmitterIndexes[slotIndex] = 0;
+        _slotRecordCounts[slotIndex] = 0;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleInjectionRing::~ParticleInjectionRing()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Creates and maps the ring.  Must be called on the GL thread before any producer starts.
+Parameters:
+    slotCount       Up to MAX_SLOT_COUNT.  At least a frame's worth of producers' slots for
+                    each frame in flight, or the producers are refused while the GPU catches
+                    up.
+    recordsPerSlot  Self-explanatory.  Each slot is 16 bytes a record.
+Returns:
+    False if the arguments are out of range or the buffer couldn't be mapped.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleInjectionRing::Init(unsigned int slotCount, unsigned int recordsPerSlot)
+{
+    this->Cleanup();
+    if (slotCount == 0 || slotCount > MAX_SLOT_COUNT || recordsPerSlot == 0)
+    {
+        LogPrintf("injection ring must have 1 to %u slots and at least 1 record a slot, not "
+            "%u and %u\n", MAX_SLOT_COUNT, slotCount, recordsPerSlot);
+        return false;
+    }
+
+    // each slot is bound as a range, so it must start on the storage buffer offset alignment
+    GLint offsetAlignment = 0;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+    if (offsetAlignment <= 0)
+    {
+        offsetAlignment = 256;
+    }
+    size_t slotSize = sizeof(InjectionSlotHeader) +
+        ((size_t)recordsPerSlot * sizeof(ParticleInjectionRecord));
+    _slotStrideBytes = ((slotSize + offsetAlignment - 1) / offsetAlignment) * offsetAlignment;
+    _slotCount = slotCount;
+    _recordsPerSlot = recordsPerSlot;
+
+    GLbitfield storageFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    _bufferId = GenerateGlBuffer();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _bufferId);
+    LabelGlObject(GL_BUFFER, _bufferId, "particle injection ring");
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, _slotCount * _slotStrideBytes, 0, storageFlags);
+    RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particle injection ring");
+    _mapped = (unsigned char *)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0,
+        _slotCount * _slotStrideBytes, storageFlags);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    if (_mapped == 0)
+    {
+        LogPrintf("failed to map the particle injection ring\n");
+        this->Cleanup();
+        return false;
+    }
+
+    _slotFences.resize(_slotCount);
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Deletes the ring.  The producers must be stopped, and a particle manager that was given
+    the ring must be told first (see ParticleManager::SetInjectionRing(...)).  Safe to call
+    more than once.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleInjectionRing::Cleanup()
+{
+    // deleting a buffer unmaps it
+    _bufferId.Reset();
+    _mapped = 0;
+    _slotFences.clear();
+    for (unsigned int slotIndex = 0; slotIndex < MAX_SLOT_COUNT; slotIndex++)
+    {
+        _slotStates[slotIndex].store(SLOT_FREE, std::memory_order_relaxed);
+    }
+    _slotCount = 0;
+    _recordsPerSlot = 0;
+    _nextWriteSlot = 0;
+    _nextTakeSlot = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes a free slot for a producer to fill.  Never blocks.
+Parameters:
+    putSlotIndexHere    The slot to give to EndWrite(...).
+Returns:
+    Where to write up to GetRecordsPerSlot() records, or 0 (and the refusal is counted) if
+    every slot is busy or there is no ring.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleInjectionRecord *ParticleInjectionRing::BeginWrite(unsigned int *putSlotIndexHere)
+{
+    if (_mapped == 0)
+    {
+        return 0;
+    }
+
+    unsigned int start = _nextWriteSlot.fetch_add(1, std::memory_order_relaxed);
+    for (unsigned int offset = 0; offset < _slotCount; offset++)
+    {
+        unsigned int slotIndex = (start + offset) % _slotCount;
+        unsigned int expected = SLOT_FREE;
+        if (_slotStates[slotIndex].compare_exchange_strong(expected, SLOT_WRITING,
+            std::memory_order_acquire))
+        {
+            *putSlotIndexHere = slotIndex;
+            return (ParticleInjectionRecord *)(_mapped + (slotIndex * _slotStrideBytes) +
+                sizeof(InjectionSlotHeader));
+        }
+    }
+
+    _refusedWrites.fetch_add(1, std::memory_order_relaxed);
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Hands a slot from BeginWrite(...) over to the next update.
+Parameters:
+    slotIndex       Self-explanatory.
+    emitterIndex    Whose range of the pool the records go into.
+    recordCount     Clamped to GetRecordsPerSlot().  0 gives the slot back unused.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleInjectionRing::EndWrite(unsigned int slotIndex, unsigned int emitterIndex,
+    unsigned int recordCount)
+{
+    if (slotIndex >= _slotCount)
+    {
+        return;
+    }
+    if (recordCount == 0)
+    {
+        _slotStates[slotIndex].store(SLOT_FREE, std::memory_order_release);
+        return;
+    }
+
+    _slotEmitterIndexes[slotIndex] = emitterIndex;
+    _slotRecordCounts[slotIndex] = (recordCount < _recordsPerSlot) ? recordCount :
+        _recordsPerSlot;
+    _slotStates[slotIndex].store(SLOT_READY, std::memory_order_release);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The most that a slot from BeginWrite(...) holds.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleInjectionRing::GetRecordsPerSlot() const
+{
+    return _recordsPerSlot;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How many records have been dispatched to the GPU since the program started, including
+    any that the GPU found no room for.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned long long ParticleInjectionRing::GetInjectedRecordCount() const
+{
+    return _injectedRecords.load(std::memory_order_relaxed);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How many records were handed over and then dropped on the CPU, because the particle
+    manager couldn't inject them (see ParticleManager::SetInjectionRing(...)).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned long long ParticleInjectionRing::GetDroppedRecordCount() const
+{
+    return _droppedRecords.load(std::memory_order_relaxed);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How many times BeginWrite(...) found every slot busy.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned long long ParticleInjectionRing::GetRefusedWriteCount() const
+{
+    return _refusedWrites.load(std::memory_order_relaxed);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Frees every dispatched slot whose fence has been passed.  Only polls.  Called by the
+    particle manager before it takes the ready slots.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleInjectionRing::ReclaimSlots()
+{
+    for (unsigned int slotIndex = 0; slotIndex < _slotCount; slotIndex++)
+    {
+        if (_slotStates[slotIndex].load(std::memory_order_relaxed) == SLOT_IN_FLIGHT &&
+            IsGlFenceSignaled(_slotFences[slotIndex]))
+        {
+            _slotFences[slotIndex].Reset();
+            _slotStates[slotIndex].store(SLOT_FREE, std::memory_order_release);
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes the next slot that a producer handed over and fills in its header, which is the
+    scatter pass's indirect dispatch: as many work groups as the records need, up to the
+    device's limit in X, beyond which the shader loops.
+Parameters:
+    workGroupSize       The compute program's, in X.
+    putSlotIndexHere    To give to FenceSlot(...) or DropSlot(...).
+Returns:
+    False if no slot is ready.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleInjectionRing::TakeReadySlot(unsigned int workGroupSize,
+    unsigned int *putSlotIndexHere)
+{
+    for (unsigned int offset = 0; offset < _slotCount; offset++)
+    {
+        unsigned int slotIndex = (_nextTakeSlot + offset) % _slotCount;
+        unsigned int expected = SLOT_READY;
+        if (!_slotStates[slotIndex].compare_exchange_strong(expected, SLOT_TAKEN,
+            std::memory_order_acquire))
+        {
+            continue;
+        }
+
+        InjectionSlotHeader header;
+        header._numGroupsX = ClampComputeDispatchSizeX(
+            (_slotRecordCounts[slotIndex] + workGroupSize - 1) / workGroupSize);
+        header._numGroupsY = 1;
+        header._numGroupsZ = 1;
+        header._recordCount = _slotRecordCounts[slotIndex];
+        header._emitterIndex = _slotEmitterIndexes[slotIndex];
+        header._padding[0] = 0;
+        header._padding[1] = 0;
+        header._padding[2] = 0;
+        memcpy(_mapped + (slotIndex * _slotStrideBytes), &header, sizeof(header));
+
+        _nextTakeSlot = (slotIndex + 1) % _slotCount;
+        *putSlotIndexHere = slotIndex;
+        return true;
+    }
+    return false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Fences a slot after the dispatch that reads it.  ReclaimSlots() frees it once the GPU is
+    past the fence.
+Parameters:
+    slotIndex   From TakeReadySlot(...).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleInjectionRing::FenceSlot(unsigned int slotIndex)
+{
+    _slotFences[slotIndex] = InsertGlFence();
+    _injectedRecords.fetch_add(_slotRecordCounts[slotIndex], std::memory_order_relaxed);
+    _slotStates[slotIndex].store(SLOT_IN_FLIGHT, std::memory_order_relaxed);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives a slot back without dispatching it, for a manager that can't inject right now.
+Parameters:
+    slotIndex   From TakeReadySlot(...).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleInjectionRing::DropSlot(unsigned int slotIndex)
+{
+    _droppedRecords.fetch_add(_slotRecordCounts[slotIndex], std::memory_order_relaxed);
+    _slotStates[slotIndex].store(SLOT_FREE, std::memory_order_release);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The ring's buffer, or 0 before Init(...).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleInjectionRing::GetBufferId() const
+{
+    return _bufferId;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    slotIndex   Self-explanatory.
+Returns:
+    Where the slot starts in the buffer, which is also where its indirect dispatch is.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+size_t ParticleInjectionRing::GetSlotOffset(unsigned int slotIndex) const
+{
+    return slotIndex * _slotStrideBytes;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The size of a slot, including the padding to the storage buffer offset alignment.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+size_t ParticleInjectionRing::GetSlotStrideBytes() const
+{
+    return _slotStrideBytes;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "GlObjects.h"
+#include "glm/vec2.hpp"
+
+#include <atomic>
+#include <vector>
+#include <stddef.h>
+
+// a particle from outside of the simulation (ex: a sensor's reading, another service's output)
+// Note: Must match ParticleInjectionRecord in shaderParticle.comp (std430).
+struct ParticleInjectionRecord
+{
+    glm::vec2 _position;    // the same space as ParticleEmitter::_center
+    glm::vec2 _velocity;    // per second
+};
+
+static_assert(sizeof(ParticleInjectionRecord) == 16, "ParticleInjectionRecord must match std430");
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Streams particles into the pool from any number of producer threads (see
+    ParticleManager::SetInjectionRing(...)).  The ring is one persistently mapped buffer of
+    slots, each a header and room for a fixed number of records.  A producer takes a free slot
+    with BeginWrite(), writes its records straight into the mapping, and hands it over with
+    EndWrite(...).  Every update dispatches one scatter pass per slot that was handed over,
+    which pops the records' pool slots from the emitter's dead stack, the same as a burst, and
+    fences the slot, and the slot is free again once the GPU is past the fence.
+
+    Nothing is allocated after Init(...), and nothing waits: a producer that finds every slot
+    busy is refused (and counted), and the GL thread only polls the fences.  With 8 slots of
+    64K records and 3 frames in flight, that is over a million particles a frame.
+
+    Note: The records go through no copy on the CPU.  The mapping is coherent, and a slot's
+    state is stored with release order after its records, so they are visible to the dispatch
+    that the GL thread issues once it sees the state.
+    Also Note: A record that finds the emitter's dead stack empty is dropped on the GPU, like
+    an emission over the emitter's capacity.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class ParticleInjectionRing
+{
+public:
+    ParticleInjectionRing();
+    ~ParticleInjectionRing();
+    bool Init(unsigned int slotCount, unsigned int recordsPerSlot);
+    void Cleanup();
+
+    // any thread
+    ParticleInjectionRecord *BeginWrite(unsigned int *putSlotIndexHere);
+    void EndWrite(unsigned int slotIndex, unsigned int emitterIndex, unsigned int recordCount);
+    unsigned int GetRecordsPerSlot() const;
+    unsigned long long GetInjectedRecordCount() const;
+    unsigned long long GetDroppedRecordCount() const;
+    unsigned long long GetRefusedWriteCount() const;
+
+    // the GL thread's, for the particle manager
+    void ReclaimSlots();
+    bool TakeReadySlot(unsigned int workGroupSize, unsigned int *putSlotIndexHere);
+    void FenceSlot(unsigned int slotIndex);
+    void DropSlot(unsigned int slotIndex);
+    unsigned int GetBufferId() const;
+    size_t GetSlotOffset(unsigned int slotIndex) const;
+    size_t GetSlotStrideBytes() const;
+
+    static const unsigned int MAX_SLOT_COUNT = 32;
+
+private:
+    // no copies; there is only one mapping
+    ParticleInjectionRing(const ParticleInjectionRing &);
+    ParticleInjectionRing &operator=(const ParticleInjectionRing &);
+
+    // a slot goes around in this order
+    enum SlotState
+    {
+        SLOT_FREE = 0,
+        SLOT_WRITING,       // a producer has it
+        SLOT_READY,         // handed over, waiting for the next update
+        SLOT_TAKEN,         // the update is dispatching it
+        SLOT_IN_FLIGHT,     // dispatched, waiting for its fence
+    };
+
+    GlBuffer _bufferId;
+    unsigned char *_mapped;
+    size_t _slotStrideBytes;
+    unsigned int _slotCount;
+    unsigned int _recordsPerSlot;
+
+    // the producers write a slot's emitter and count before they store its state, and only
+    // the GL thread touches the fences
+    std::atomic<unsigned int> _slotStates[MAX_SLOT_COUNT];
+    unsigned int _slotEmitterIndexes[MAX_SLOT_COUNT];
+    unsigned int _slotRecordCounts[MAX_SLOT_COUNT];
+    std::vector<GlFence> _slotFences;
+
+    // where the producers and the GL thread start looking, so the slots are used in turn
+    std::atomic<unsigned int> _nextWriteSlot;
+    unsigned int _nextTakeSlot;
+
+    std::atomic<unsigned long long> _injectedRecords;
+    std::atomic<unsigned long long> _droppedRecords;
+    std::atomic<unsigned long long> _refusedWrites;
+};
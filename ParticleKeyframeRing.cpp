@@ -0,0 +1,326 @@
+#include "ParticleKeyframeRing.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
+#include "GpuMemoryLedger.h"
+#include "Log.h"
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.  Nothing is kept until Init(...).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleKeyframeRing::ParticleKeyframeRing() :
+    _manager(0),
+    _bufferId(0),
+    _slotSizeBytes(0),
+    _updatesPerKeyframe(0),
+    _nextSlotIndex(0),
+    _logStartIndex(0),
+    _updateCount(0)
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleKeyframeRing::~ParticleKeyframeRing()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Makes the buffer of keyframes, sized for the manager's state as it is now, and starts
+    logging.  The first keyframe is captured after the first updatesPerKeyframe updates.
+Parameters:
+    manager             Must outlive this, or at least Cleanup().
+    keyframeCount       How many keyframes the ring holds, so how far back a rewind can go
+                        is about keyframeCount * updatesPerKeyframe updates.
+    updatesPerKeyframe  More is less memory for the same history but a longer replay.
+Returns:
+    False if the manager can't capture keyframes or the buffer would go over the GPU memory
+    budget, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleKeyframeRing::Init(ParticleManager *manager, unsigned int keyframeCount,
+    unsigned int updatesPerKeyframe)
+{
+    this->Cleanup();
+    if (manager == 0 || keyframeCount == 0 || updatesPerKeyframe == 0)
+    {
+        return false;
+    }
+
+    size_t slotSizeBytes = manager->GetKeyframeSizeBytes();
+    unsigned long long bufferBytes = (unsigned long long)slotSizeBytes * keyframeCount;
+    if (WouldExceedGpuMemoryBudget(bufferBytes))
+    {
+        LogPrintf("keyframe ring: %u keyframes of %.1fMB would go over the GPU memory budget\n",
+            keyframeCount, slotSizeBytes / (1024.0 * 1024.0));
+        return false;
+    }
+
+    glGenBuffers(1, &_bufferId);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, _bufferId);
+    glBufferStorage(GL_COPY_WRITE_BUFFER, (GLsizeiptr)bufferBytes, 0, 0);
+    RecordBoundGlBufferAllocation(GL_COPY_WRITE_BUFFER, "keyframe ring");
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    if (CheckGlOutOfMemory("keyframe ring"))
+    {
+        this->Cleanup();
+        return false;
+    }
+
+    _manager = manager;
+    _slotSizeBytes = slotSizeBytes;
+    _updatesPerKeyframe = updatesPerKeyframe;
+    _keyframes.resize(keyframeCount);
+    this->Clear();
+    LogPrintf("keyframe ring: %u keyframes of %.1fMB, every %u updates\n", keyframeCount,
+        slotSizeBytes / (1024.0 * 1024.0), updatesPerKeyframe);
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Deletes the buffer and the history.  Safe to call more than once.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleKeyframeRing::Cleanup()
+{
+    if (_bufferId != 0)
+    {
+        ForgetGpuAllocation(GPU_MEMORY_BUFFER, _bufferId);
+        DeleteGlBuffers(1, &_bufferId);
+        _bufferId = 0;
+    }
+    _manager = 0;
+    _slotSizeBytes = 0;
+    _updatesPerKeyframe = 0;
+    _keyframes.clear();
+    this->Clear();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Forgets the history but keeps the buffer, for when the state is replaced with one that
+    didn't come from these updates (ex: a snapshot was loaded), which a replay would get
+    wrong.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleKeyframeRing::Clear()
+{
+    _capturedSlots.clear();
+    _capturedUpdateIndexes.clear();
+    _nextSlotIndex = 0;
+    _updateLog.clear();
+    _logStartIndex = 0;
+    _updateCount = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Logs an update that the manager just ran and captures a keyframe if one is due.  Must
+    be called after every ParticleManager::UpdateSteps(...) that should be rewindable, with
+    the same arguments, including the ones with no steps, so that the count stays in step.
+Parameters:
+    stepSec     Self-explanatory.
+    numSteps    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleKeyframeRing::RecordUpdate(float stepSec, unsigned int numSteps)
+{
+    if (_bufferId == 0)
+    {
+        return;
+    }
+
+    // before the first keyframe there is nothing to replay from, so nothing is worth logging
+    _updateCount++;
+    if (_capturedSlots.empty())
+    {
+        _logStartIndex = _updateCount;
+    }
+    else
+    {
+        LoggedUpdate update;
+        update._stepSec = stepSec;
+        update._numSteps = numSteps;
+        _updateLog.push_back(update);
+    }
+
+    if ((_updateCount % _updatesPerKeyframe) == 0)
+    {
+        this->CaptureNextKeyframe();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes the simulation back by the given number of updates, or as far as the history goes
+    if that is less.  The history after that point is dropped, so the next update goes on
+    from there.
+Parameters:
+    updatesBack             Self-explanatory.
+    putSecondsRemovedHere   How much simulation time was taken back, for the app's clock.
+                            Optional.
+Returns:
+    False if there is no keyframe to go back to or it couldn't be restored, in which case
+    nothing changed, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleKeyframeRing::Rewind(unsigned int updatesBack, float *putSecondsRemovedHere)
+{
+    if (putSecondsRemovedHere != 0)
+    {
+        *putSecondsRemovedHere = 0.0f;
+    }
+    if (_bufferId == 0 || _capturedSlots.empty() || updatesBack == 0)
+    {
+        return false;
+    }
+
+    unsigned long long targetIndex = (updatesBack < _updateCount - _capturedUpdateIndexes[0]) ?
+        _updateCount - updatesBack : _capturedUpdateIndexes[0];
+
+    // the newest keyframe at or before the target
+    size_t keyframeIndex = _capturedSlots.size() - 1;
+    while (_capturedUpdateIndexes[keyframeIndex] > targetIndex)
+    {
+        keyframeIndex--;
+    }
+    unsigned int slotIndex = _capturedSlots[keyframeIndex];
+    if (!_manager->RestoreKeyframe(_bufferId, _keyframes[slotIndex]))
+    {
+        this->Clear();
+        return false;
+    }
+
+    // replay from the keyframe up to the target
+    size_t firstReplayed = (size_t)(_capturedUpdateIndexes[keyframeIndex] - _logStartIndex);
+    size_t endReplayed = (size_t)(targetIndex - _logStartIndex);
+    for (size_t logIndex = firstReplayed; logIndex < endReplayed; logIndex++)
+    {
+        _manager->UpdateSteps(_updateLog[logIndex]._stepSec, _updateLog[logIndex]._numSteps);
+    }
+
+    // the updates after the target never happened now
+    float secondsRemoved = 0.0f;
+    while (_updateLog.size() > endReplayed)
+    {
+        secondsRemoved += _updateLog.back()._stepSec * _updateLog.back()._numSteps;
+        _updateLog.pop_back();
+    }
+    _capturedSlots.resize(keyframeIndex + 1);
+    _capturedUpdateIndexes.resize(keyframeIndex + 1);
+    _nextSlotIndex = (slotIndex + 1) % (unsigned int)_keyframes.size();
+    _updateCount = targetIndex;
+    if (putSecondsRemovedHere != 0)
+    {
+        *putSecondsRemovedHere = secondsRemoved;
+    }
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    True if Init(...) succeeded and Cleanup() hasn't been called since.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleKeyframeRing::IsEnabled() const
+{
+    return (_bufferId != 0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How many updates back Rewind(...) can go right now.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleKeyframeRing::GetRewindableUpdateCount() const
+{
+    if (_capturedSlots.empty())
+    {
+        return 0;
+    }
+    return (unsigned int)(_updateCount - _capturedUpdateIndexes[0]);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Captures the state into the next slot, over the oldest keyframe once the ring is full,
+    and drops the log entries that only the overwritten keyframe could replay.
+Parameters: None
+Returns:
+    False if the state no longer fits a slot, in which case the history is dropped,
+    otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleKeyframeRing::CaptureNextKeyframe()
+{
+    if (_manager->GetKeyframeSizeBytes() > _slotSizeBytes)
+    {
+        if (!_capturedSlots.empty())
+        {
+            LogPrintf("keyframe ring: the particle state outgrew the keyframes; "
+                "the history was dropped\n");
+        }
+        unsigned long long updateCount = _updateCount;
+        this->Clear();
+        _updateCount = updateCount;
+        _logStartIndex = updateCount;
+        return false;
+    }
+
+    if (_capturedSlots.size() == _keyframes.size())
+    {
+        _capturedSlots.pop_front();
+        _capturedUpdateIndexes.pop_front();
+        unsigned long long newLogStartIndex = _capturedUpdateIndexes.empty() ?
+            _updateCount : _capturedUpdateIndexes[0];
+        while (_logStartIndex < newLogStartIndex)
+        {
+            _updateLog.pop_front();
+            _logStartIndex++;
+        }
+    }
+
+    unsigned int slotIndex = _nextSlotIndex;
+    if (!_manager->CaptureKeyframe(_bufferId, slotIndex * _slotSizeBytes,
+        &_keyframes[slotIndex]))
+    {
+        return false;
+    }
+    _capturedSlots.push_back(slotIndex);
+    _capturedUpdateIndexes.push_back(_updateCount);
+    _nextSlotIndex = (slotIndex + 1) % (unsigned int)_keyframes.size();
+    return true;
+}
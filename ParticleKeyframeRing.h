@@ -0,0 +1,72 @@
+#pragma once
+
+#include "ParticleManager.h"
+
+#include <vector>
+#include <deque>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Keeps the last few seconds of the simulation on the GPU so that it can be rewound right
+    away.  Every so many updates, the whole particle state is copied into the next slot of a
+    ring of keyframes in one buffer (see ParticleManager::CaptureKeyframe(...)), which is a
+    copy within video memory and never comes back to the CPU, and every update in between is
+    logged by its step size and step count.  Rewinding restores the newest keyframe at or
+    before the time that was asked for and runs the logged updates again, back to back and
+    without drawing, to get to exactly that update.
+
+    The keyframes are exact copies and not quantized, so that the replay from one is the
+    same as the first run (in "--deterministic" mode, see ParticleManager::SetDeterministic(...)).
+    A smaller layout (ex: PARTICLE_LAYOUT_HALF_FLOAT) makes smaller keyframes along with
+    everything else.
+
+    Note: Only the particle manager's state is kept.  Whatever the app changes between
+    updates (the emitters that it animates, the fluid grid) isn't, so the replay runs with
+    the emitters as they were in the keyframe.
+    Also Note: A keyframe that no longer fits the state (ex: the pool was resized) drops the
+    whole history, since none of it could be restored.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class ParticleKeyframeRing
+{
+public:
+    ParticleKeyframeRing();
+    ~ParticleKeyframeRing();
+    bool Init(ParticleManager *manager, unsigned int keyframeCount,
+        unsigned int updatesPerKeyframe);
+    void Cleanup();
+    void Clear();
+
+    void RecordUpdate(float stepSec, unsigned int numSteps);
+    bool Rewind(unsigned int updatesBack, float *putSecondsRemovedHere);
+    bool IsEnabled() const;
+    unsigned int GetRewindableUpdateCount() const;
+
+private:
+    // an update as it was run, to run it again
+    struct LoggedUpdate
+    {
+        float _stepSec;
+        unsigned int _numSteps;
+    };
+
+    bool CaptureNextKeyframe();
+
+    ParticleManager *_manager;
+    unsigned int _bufferId;
+    size_t _slotSizeBytes;
+    unsigned int _updatesPerKeyframe;
+
+    // one per slot, and the oldest first (as slot indexes) with the update that each was
+    // captured after
+    std::vector<ParticleKeyframe> _keyframes;
+    std::deque<unsigned int> _capturedSlots;
+    std::deque<unsigned long long> _capturedUpdateIndexes;
+    unsigned int _nextSlotIndex;
+
+    // every update since the oldest keyframe; _logStartIndex is the update count that the
+    // first one came after
+    std::deque<LoggedUpdate> _updateLog;
+    unsigned long long _logStartIndex;
+    unsigned long long _updateCount;
+};
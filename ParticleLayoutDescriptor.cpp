@@ -0,0 +1,239 @@
+#include "ParticleLayoutDescriptor.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "Particle.h"
+
+#include <cmath>    // floorf
+
+// the fixed-point layout's steps (see PackedFixedParticle in Particle.h)
+// Note: Must match shaderParticle.comp and shaderParticle.vert.
+static const float FIXED_POSITION_SCALE = 32768.0f;
+static const float FIXED_VELOCITY_SCALE = 256.0f;
+static const int FIXED_VELOCITY_MAX = 1023;
+static const float FIXED_AGE_SCALE = 511.0f;
+
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    type    Self-explanatory.
+Returns:
+    The GLSL type that the field is declared as in a shader storage buffer.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static const char *GetGlslTypeName(ParticleFieldType type)
+{
+    switch (type)
+    {
+    case PARTICLE_FIELD_INT: return "int";
+    case PARTICLE_FIELD_FLOAT: return "float";
+    case PARTICLE_FIELD_VEC2: return "vec2";
+    case PARTICLE_FIELD_HALF2: return "uint";
+    case PARTICLE_FIELD_UINT: return "uint";
+    default:
+        return "int";
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Generates the members of the layout's GLSL structure as a single "#define" line, which the
+    shaders expand inside the structure declaration (ex: "struct Particle { PARTICLE_MEMBERS };"
+    in shaderParticle.comp).
+
+    A macro instead of the structure itself because the shader loader inserts the defines right
+    after the "#version" line (see InsertShaderDefines(...)), which is before the "#extension"
+    lines, and only preprocessor lines are allowed there.
+Parameters:
+    layout  Self-explanatory.
+Returns:
+    The "#define" line, or an empty string for a structure of arrays.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+std::string GetGlslMembersDefine(const ParticleLayoutDescriptor &layout)
+{
+    if (layout._glslMembersDefine == 0)
+    {
+        return "";
+    }
+
+    std::string define = std::string("#define ") + layout._glslMembersDefine;
+    for (unsigned int fieldIndex = 0; fieldIndex < layout._fieldCount; fieldIndex++)
+    {
+        const ParticleFieldDescriptor &field = layout._fields[fieldIndex];
+        define += std::string(" ") + GetGlslTypeName(field._type) + " " + field._name + ";";
+    }
+    define += "\n";
+    return define;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Points the currently bound VAO's attributes at the particle buffers, one attribute per
+    field that has an attribute index.  The offsets and strides are the std430 ones from the
+    descriptor, so they are the same as the compute shader's.
+
+    Note: The VAO records the buffer that was bound to GL_ARRAY_BUFFER when each attribute
+    pointer was specified, so each field's buffer is bound before its attribute.
+Parameters:
+    layout      Self-explanatory.
+    bufferIds   One buffer per GetParticleBufferCount(...), in order.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void DescribeParticleAttributes(const ParticleLayoutDescriptor &layout,
+    const unsigned int *bufferIds)
+{
+    for (unsigned int fieldIndex = 0; fieldIndex < layout._fieldCount; fieldIndex++)
+    {
+        const ParticleFieldDescriptor &field = layout._fields[fieldIndex];
+        if (field._attributeIndex < 0)
+        {
+            continue;
+        }
+
+        unsigned int bufferIndex = layout._isStructureOfArrays ? fieldIndex : 0;
+        GLsizei bytesPerStep = Std430BufferStride(layout, bufferIndex);
+        size_t bufferStartOffset = Std430FieldOffset(layout, fieldIndex);
+        GLuint attributeIndex = field._attributeIndex;
+        glBindBuffer(GL_ARRAY_BUFFER, bufferIds[bufferIndex]);
+        glEnableVertexAttribArray(attributeIndex);
+        switch (field._type)
+        {
+        case PARTICLE_FIELD_INT:
+            // Note: This is an integer in the vertex shader, so use the "I" version of the
+            // attribute pointer call.  glVertexAttribPointer(...) would convert it to a float.
+            glVertexAttribIPointer(attributeIndex, 1, GL_INT, bytesPerStep,
+                (void *)bufferStartOffset);
+            break;
+        case PARTICLE_FIELD_FLOAT:
+            glVertexAttribPointer(attributeIndex, 1, GL_FLOAT, GL_FALSE, bytesPerStep,
+                (void *)bufferStartOffset);
+            break;
+        case PARTICLE_FIELD_VEC2:
+            glVertexAttribPointer(attributeIndex, 2, GL_FLOAT, GL_FALSE, bytesPerStep,
+                (void *)bufferStartOffset);
+            break;
+        case PARTICLE_FIELD_HALF2:
+            // OpenGL converts the halves during vertex fetch, so the shader still gets a vec2
+            glVertexAttribPointer(attributeIndex, 2, GL_HALF_FLOAT, GL_FALSE, bytesPerStep,
+                (void *)bufferStartOffset);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    layout  Self-explanatory.
+Returns:
+    The descriptor of that layout (see Particle.h).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+const ParticleLayoutDescriptor &GetParticleLayoutDescriptor(ParticleLayout layout)
+{
+    switch (layout)
+    {
+    case PARTICLE_LAYOUT_SOA: return PARTICLE_SOA_LAYOUT;
+    case PARTICLE_LAYOUT_HALF_FLOAT: return PARTICLE_HALF_FLOAT_LAYOUT;
+    case PARTICLE_LAYOUT_FIXED_POINT: return PARTICLE_FIXED_POINT_LAYOUT;
+    default:
+        return PARTICLE_INTERLEAVED_LAYOUT;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Rounds the value to the nearest step of a fixed-point grid and clamps it to the given 
+    range.
+Parameters:
+    value       Self-explanatory.
+    scale       Steps per 1.
+    minSteps    Self-explanatory.
+    maxSteps    Self-explanatory.
+Returns:
+    The value in steps.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static int ToFixedSteps(float value, float scale, int minSteps, int maxSteps)
+{
+    float steps = floorf((value * scale) + 0.5f);
+    if (steps < (float)minSteps)
+    {
+        return minSteps;
+    }
+    if (steps > (float)maxSteps)
+    {
+        return maxSteps;
+    }
+    return (int)steps;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Packs the particle into the fixed-point layout's 8 bytes (see PackedFixedParticle in 
+    Particle.h), the same as StoreParticle(...) in shaderParticle.comp, except that the 
+    velocity and the age are rounded to their nearest steps.
+Parameters:
+    p   Self-explanatory.
+Returns:
+    The packed particle.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+PackedFixedParticle PackFixedParticle(const Particle &p)
+{
+    PackedFixedParticle packed;
+    unsigned int x = (unsigned int)ToFixedSteps(p._position.x, FIXED_POSITION_SCALE, -32768, 32767);
+    unsigned int y = (unsigned int)ToFixedSteps(p._position.y, FIXED_POSITION_SCALE, -32768, 32767);
+    packed._position = (x & 0xFFFF) | (y << 16);
+    packed._motion = 0;
+    if (p._isActive != 0)
+    {
+        unsigned int velocityX = (unsigned int)ToFixedSteps(p._velocity.x, FIXED_VELOCITY_SCALE, 
+            -FIXED_VELOCITY_MAX, FIXED_VELOCITY_MAX);
+        unsigned int velocityY = (unsigned int)ToFixedSteps(p._velocity.y, FIXED_VELOCITY_SCALE, 
+            -FIXED_VELOCITY_MAX, FIXED_VELOCITY_MAX);
+        unsigned int age = (unsigned int)ToFixedSteps(p._age, FIXED_AGE_SCALE, 0, 511);
+        packed._motion = 1 | (age << 1) | ((velocityX & 0x7FF) << 10) | 
+            ((velocityY & 0x7FF) << 21);
+    }
+    return packed;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The reverse of PackFixedParticle(...), and the same as LoadParticle(...) in 
+    shaderParticle.comp.
+Parameters:
+    packed  Self-explanatory.
+Returns:
+    The particle.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+Particle UnpackFixedParticle(const PackedFixedParticle &packed)
+{
+    // the shifts sign-extend because the halves and the 11-bit fields are moved to the top of 
+    // a signed integer first
+    Particle p;
+    int x = (int)(packed._position << 16) >> 16;
+    int y = (int)packed._position >> 16;
+    int velocityX = (int)(packed._motion << 11) >> 21;
+    int velocityY = (int)packed._motion >> 21;
+    p._position = glm::vec2((float)x, (float)y) / FIXED_POSITION_SCALE;
+    p._velocity = glm::vec2((float)velocityX, (float)velocityY) / FIXED_VELOCITY_SCALE;
+    p._isActive = (int)(packed._motion & 1);
+    p._age = (float)((packed._motion >> 1) & 0x1FF) / FIXED_AGE_SCALE;
+    return p;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <string>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The types that a member of a GPU-side particle can have.  Each one has a single GLSL type,
+    a single std430 size and alignment, and (if it is a vertex attribute) a single way of
+    being fetched.
+
+    The half float pair is a GLSL uint that holds two 16-bit floats (see PackedHalfParticle in
+    Particle.h), so the compute shader unpacks it, but vertex fetch reads it as 2 GL_HALF_FLOAT
+    items and the vertex shader gets a vec2.  A plain uint holds whatever its layout packs 
+    into it and has no vertex fetch format (see PackedFixedParticle in Particle.h).
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+enum ParticleFieldType
+{
+    PARTICLE_FIELD_INT = 0,
+    PARTICLE_FIELD_FLOAT,
+    PARTICLE_FIELD_VEC2,
+    PARTICLE_FIELD_HALF2,
+    PARTICLE_FIELD_UINT,
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    One member of a GPU-side particle.  The name is the member's name on both sides (the C++
+    structure and the generated GLSL structure), and the attribute index is the "location" of
+    the vertex shader input that it feeds, or -1 if it doesn't feed one.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+struct ParticleFieldDescriptor
+{
+    const char *_name;
+    ParticleFieldType _type;
+    int _attributeIndex;
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Everything that the C++ side, the shaders, and the VAO need to agree on about how the
+    particles are stored on the GPU.  The member offsets and the array stride aren't written
+    down anywhere; they are worked out from the field list with the std430 rules (see the
+    Std430*(...) functions below), at compile time, so that Particle.h can check the C++
+    structures against them with static_assert and ParticleManager can point the vertex
+    attributes with them.  The GLSL structure is generated from the same list (see
+    GetGlslMembersDefine(...)), so there is no hand-written copy to fall out of step.
+
+    An interleaved layout is one buffer of structures.  A structure of arrays layout is one
+    tightly packed buffer per field, in field order, and has no GLSL structure.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+struct ParticleLayoutDescriptor
+{
+    // the GLSL macro that the shaders expand inside the structure, or 0 for a structure of
+    // arrays
+    const char *_glslMembersDefine;
+    const ParticleFieldDescriptor *_fields;
+    unsigned int _fieldCount;
+    bool _isStructureOfArrays;
+};
+
+// std430 size of a single field, which is also the array stride of an array of them
+constexpr unsigned int Std430FieldSize(ParticleFieldType type)
+{
+    return (type == PARTICLE_FIELD_VEC2) ? 8 : 4;
+}
+
+// std430 aligns a vector of 2 items on twice the item size and a scalar on its own size
+constexpr unsigned int Std430FieldAlignment(ParticleFieldType type)
+{
+    return (type == PARTICLE_FIELD_VEC2) ? 8 : 4;
+}
+
+constexpr unsigned int AlignStd430Offset(unsigned int offset, unsigned int alignment)
+{
+    return ((offset + alignment - 1) / alignment) * alignment;
+}
+
+// the field goes right after the one before it, rounded up to its own alignment
+// Note: Written as one expression of recursion because constexpr functions are limited to a
+// single return statement in Visual Studio 2015.
+constexpr unsigned int Std430FieldOffset(const ParticleLayoutDescriptor &layout,
+    unsigned int fieldIndex)
+{
+    return layout._isStructureOfArrays ? 0 :
+        AlignStd430Offset((fieldIndex == 0) ? 0 :
+        (Std430FieldOffset(layout, fieldIndex - 1) +
+        Std430FieldSize(layout._fields[fieldIndex - 1]._type)),
+        Std430FieldAlignment(layout._fields[fieldIndex]._type));
+}
+
+// a structure is aligned to its most strictly aligned member
+constexpr unsigned int Std430StructAlignment(const ParticleLayoutDescriptor &layout,
+    unsigned int fieldCount)
+{
+    return (fieldCount == 0) ? 1 :
+        ((Std430FieldAlignment(layout._fields[fieldCount - 1]._type) >
+        Std430StructAlignment(layout, fieldCount - 1)) ?
+        Std430FieldAlignment(layout._fields[fieldCount - 1]._type) :
+        Std430StructAlignment(layout, fieldCount - 1));
+}
+
+// the array stride of the structure, which is the end of the last member rounded up to the
+// structure's alignment
+// Note: Only meaningful for an interleaved layout.  A structure of arrays has a stride per
+// field (see Std430FieldSize(...)).
+constexpr unsigned int Std430StructStride(const ParticleLayoutDescriptor &layout)
+{
+    return AlignStd430Offset(Std430FieldOffset(layout, layout._fieldCount - 1) +
+        Std430FieldSize(layout._fields[layout._fieldCount - 1]._type),
+        Std430StructAlignment(layout, layout._fieldCount));
+}
+
+// how many bytes each particle takes in each of the layout's buffers
+constexpr unsigned int Std430BufferStride(const ParticleLayoutDescriptor &layout,
+    unsigned int bufferIndex)
+{
+    return layout._isStructureOfArrays ?
+        Std430FieldSize(layout._fields[bufferIndex]._type) : Std430StructStride(layout);
+}
+
+constexpr unsigned int GetParticleBufferCount(const ParticleLayoutDescriptor &layout)
+{
+    return layout._isStructureOfArrays ? layout._fieldCount : 1;
+}
+
+std::string GetGlslMembersDefine(const ParticleLayoutDescriptor &layout);
+void DescribeParticleAttributes(const ParticleLayoutDescriptor &layout,
+    const unsigned int *bufferIds);
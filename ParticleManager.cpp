@@ -1,14 +1,260 @@
 #include "ParticleManager.h"
 
-#include "glm/detail/func_geometric.hpp"    // glm::dot
+#include "glm/detail/func_geometric.hpp"    // glm::dot, glm::length
+#include "glm/detail/func_packing.hpp"      // glm::packHalf2x16
 #include "RandomToast.h"
 #include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
+#include "ShaderProgramRegistry.h"
+#include "ComputeDeviceCaps.h"
+#include "Log.h"
+#include "MappedFile.h"
+#include "AssetPack.h"
+#include "OpenGlErrorHandling.h"
+#include "TraceTimeline.h"
+#include "GpuMemoryLedger.h"
+#include "RenderPassGraph.h"
+#include "FrameArena.h"
+#include "GlFenceSync.h"
+
+#include <string.h>     // memcpy, memcmp
+#include <stdio.h>      // the snapshot file
+#include <math.h>       // sqrtf
+#include <chrono>
+#include <sstream>
+#include <iomanip>      // std::setprecision
+#include <utility>      // std::move
+
+// the layout that glMultiDrawElementsIndirect(...) expects to find in the 
+// GL_DRAW_INDIRECT_BUFFER
+// Note: The compute shader's "DrawCommand" must match this.  It increments _count once for 
+// each live particle that it appends to its draw group's range of the live index buffer.
+struct DrawElementsIndirectCommand
+{
+    unsigned int _count;
+    unsigned int _instanceCount;
+    unsigned int _firstIndex;
+    int _baseVertex;
+    unsigned int _baseInstance;
+};
+
+// the draw command buffer starts with the emit pass's count and the number of draw groups, 
+// and then has one draw command per draw group
+// Note: The indirect draw is given the offset of the first command, so the header can be used
+// for other things.  Must match DrawCommandBuffer in shaderParticle.comp.
+struct DrawCommandBufferHeader
+{
+    unsigned int _emittedCount;
+    unsigned int _drawGroupCount;
+};
+static_assert(sizeof(DrawElementsIndirectCommand) == 20, "DrawElementsIndirectCommand must match std430");
+
+// the layout that glMultiDrawArraysIndirect(...) expects (see RenderQuads())
+// Note: The count is the quad's corners and the instance count is the draw group's live 
+// count, copied out of the group's DrawElementsIndirectCommand on the GPU.
+struct DrawArraysIndirectCommand
+{
+    unsigned int _count;
+    unsigned int _instanceCount;
+    unsigned int _first;
+    unsigned int _baseInstance;
+};
+static_assert(sizeof(DrawArraysIndirectCommand) == 16, "DrawArraysIndirectCommand must be tightly packed");
+static_assert(sizeof(DrawCommandBufferHeader) == 8, "DrawCommandBufferHeader must match std430");
+
+// GL_ARB_sparse_buffer's (see PARTICLE_BUFFER_ACCESS_SPARSE)
+// Note: This version of glload is older than the extension, so the function is looked up by 
+// hand (see GetGlFunctionAddress(...)).  One per thread, like the context that it came from.
+static const GLbitfield SPARSE_STORAGE_BIT_ARB = 0x0400;
+static const GLenum SPARSE_BUFFER_PAGE_SIZE_ARB = 0x82F8;
+typedef void (CODEGEN_FUNCPTR *BufferPageCommitmentArbProc)(GLenum target, GLintptr offset, 
+    GLsizeiptr size, GLboolean commit);
+static thread_local BufferPageCommitmentArbProc gBufferPageCommitmentArb = 0;
+
+// GL_ARB_bindless_texture's (see SetBindlessTextures(...)), looked up the same way
+typedef GLuint64 (CODEGEN_FUNCPTR *GetTextureHandleArbProc)(GLuint texture);
+typedef void (CODEGEN_FUNCPTR *TextureHandleResidencyArbProc)(GLuint64 handle);
+typedef void (CODEGEN_FUNCPTR *UniformHandleui64ArbProc)(GLint location, GLuint64 value);
+static thread_local GetTextureHandleArbProc gGetTextureHandleArb = 0;
+static thread_local TextureHandleResidencyArbProc gMakeTextureHandleResidentArb = 0;
+static thread_local TextureHandleResidencyArbProc gMakeTextureHandleNonResidentArb = 0;
+static thread_local UniformHandleui64ArbProc gUniformHandleui64Arb = 0;
+
+// the per-step simulation parameters
+// Note: Must match the std140 "SimulationParameters" uniform block in shaderParticle.comp.  
+// Everything is 4 bytes, and the end is padded to a multiple of 16 bytes the way std140 rounds 
+// a block.  The emitters and the force fields have their own buffers (see ParticleEmitter.h 
+// and ParticleForceField.h).
+struct SimulationParameters
+{
+    float _deltaTimeSec;
+    unsigned int _maxParticleCount;
+    unsigned int _emitterCount;
+    unsigned int _randomSeed;
+    unsigned int _frameIndex;
+    unsigned int _passType;
+    unsigned int _rebuildEmitterIndex;
+    unsigned int _forceFieldCount;
+    unsigned int _substepCount;
+    unsigned int _updateParticleEnd;
+    unsigned int _cpuEmittedCount;
+    unsigned int _isDeterministic;
+    unsigned int _emitStepIndex;
+    unsigned int _updateListMode;
+    unsigned int _updateListParticlesPerWorkGroup;
+    unsigned int _updateListMaxWorkGroups;
+    unsigned int _persistentEmitChunks;
+    float _simulationTimeSec;
+    float _emitSpanSec;
+    unsigned int _pointerFlags;
+    glm::vec2 _pointerPosition;
+    float _pointerAttractorStrength;
+    unsigned int _pointerEmitterIndex;
+    unsigned int _isSubFrameEmission;
+    unsigned int _padding[3];
+};
+
+// what a dispatch of the compute program does
+// Note: Must match the PASS_* defines in shaderParticle.comp.
+enum SimulationPass
+{
+    SIMULATION_PASS_UPDATE = 0,
+    SIMULATION_PASS_EMIT,
+    SIMULATION_PASS_REBUILD_DEAD_STACK,
+    SIMULATION_PASS_APPEND_CPU_LIVE,
+    SIMULATION_PASS_REBUILD_ACTIVE_MASK,
+    SIMULATION_PASS_PERSISTENT,
+    SIMULATION_PASS_BURST,
+    SIMULATION_PASS_SUB_EMIT,
+    SIMULATION_PASS_INJECT,
+    SIMULATION_PASS_CULL_DRAW_GROUPS,
+};
+
+// what the update pass does with the update lists (see ParticleManager::SetLiveUpdateList(...))
+// Note: Must match the UPDATE_LIST_* defines in shaderParticle.comp.
+enum UpdateListMode
+{
+    UPDATE_LIST_OFF = 0,
+
+    // covers the whole pool and appends the particles that are still alive to a new list
+    UPDATE_LIST_BUILD,
+
+    // covers the last list, with glDispatchComputeIndirect(...), and appends to a new one
+    UPDATE_LIST_USE,
+};
+
+// how the update pass sends out new particles (see ParticleManager::SetFusedEmitUpdate(...))
+// Note: Must match the FUSED_EMIT_* defines in shaderParticle.comp.
+enum FusedEmitMode
+{
+    // the emit pass does it, and the update pushes onto the dead stacks
+    FUSED_EMIT_OFF = 0,
+
+    // neither, for the update's dispatches after the first one
+    FUSED_EMIT_SKIP,
+
+    // the update sends out the dead particles that fit in their emitters' quotas
+    FUSED_EMIT_ON,
+};
+
+// the front of each update list buffer, which is the indirect dispatch that covers the list
+// Note: Must match UpdateListInBuffer and UpdateListOutBuffer in shaderParticle.comp.  The 
+// first 3 are a DispatchIndirectCommand.
+struct UpdateListHeader
+{
+    unsigned int _numGroupsX;
+    unsigned int _numGroupsY;
+    unsigned int _numGroupsZ;
+    unsigned int _count;
+};
+static_assert(sizeof(UpdateListHeader) == 16, "UpdateListHeader must match std430");
+
+// the front of each slot of the burst queue, which is the indirect dispatch of the burst pass 
+// (see ParticleManager::TriggerBurst(...))
+// Note: Must match BurstQueueBuffer in shaderParticle.comp.  The first 3 are a 
+// DispatchIndirectCommand.
+struct BurstQueueHeader
+{
+    unsigned int _numGroupsX;
+    unsigned int _numGroupsY;
+    unsigned int _numGroupsZ;
+    unsigned int _burstCount;
+};
+static_assert(sizeof(BurstQueueHeader) == 16, "BurstQueueHeader must match std430");
+
+// the front of the death list, which is the indirect dispatch of the sub-emitter pass (see 
+// ParticleManager::SetSubEmitters(...))
+// Note: Must match DeathEventBuffer in shaderParticle.comp.  The first 3 are a 
+// DispatchIndirectCommand.  Each death after it is 24 bytes.
+struct DeathListHeader
+{
+    unsigned int _numGroupsX;
+    unsigned int _numGroupsY;
+    unsigned int _numGroupsZ;
+    unsigned int _count;
+};
+static_assert(sizeof(DeathListHeader) == 16, "DeathListHeader must match std430");
+static const unsigned int DEATH_EVENT_SIZE_BYTES = 24;
+// which stage of the sort program runs (see SortParticles())
+// Note: Must match the SORT_STAGE_* defines in shaderParticle.comp.
+enum SortStage
+{
+    SORT_STAGE_KEYS = 0,
+    SORT_STAGE_LOCAL,
+    SORT_STAGE_GLOBAL,
+    SORT_STAGE_GATHER,
+    SORT_STAGE_LIVE_INDICES,
+    SORT_STAGE_INIT_IDS,
+};
+static_assert(offsetof(SimulationParameters, _frameIndex) == 16, "SimulationParameters must match std140");
+static_assert(offsetof(SimulationParameters, _pointerPosition) == 80, 
+    "SimulationParameters must match std140");
+static_assert(offsetof(SimulationParameters, _isSubFrameEmission) == 96, 
+    "SimulationParameters must match std140");
+static_assert(sizeof(SimulationParameters) == 112, "SimulationParameters must match std140");
+
+// what the pointer is doing (see ParticleManager::PublishPointerInput(...))
+// Note: Must match the POINTER_* defines in shaderParticle.comp.
+enum ParticlePointerFlags
+{
+    PARTICLE_POINTER_EMITTING = 1,
+    PARTICLE_POINTER_ATTRACTING = 2,
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Fills in the pointer's part of a parameter block.  Every pass's block has it, because every
+    pass that loads an emitter moves the pointer's emitter.
+Parameters:
+    input           Self-explanatory.
+    emitterIndex    The pointer's emitter, or -1 for none.
+    parameters      Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static void SetPointerParameters(const ParticlePointerInput &input, int emitterIndex, 
+    SimulationParameters *parameters)
+{
+    parameters->_pointerFlags = 0;
+    if (input._isEmitting)
+    {
+        parameters->_pointerFlags |= PARTICLE_POINTER_EMITTING;
+    }
+    if (input._attractorStrength != 0.0f)
+    {
+        parameters->_pointerFlags |= PARTICLE_POINTER_ATTRACTING;
+    }
+    parameters->_pointerPosition = input._position;
+    parameters->_pointerAttractorStrength = input._attractorStrength;
+    parameters->_pointerEmitterIndex = (emitterIndex >= 0) ? (unsigned int)emitterIndex : ~0u;
+}
 
 
 /*-----------------------------------------------------------------------------------------------
 Description:
-    An empty constructor.  It exists because I didn't know if anything had to go in it, and then
-    I kept it around even when everything was moved to the Init(...) method.
+    Sets the particle buffer access mode and the particles per invocation to their defaults.  
+    Everything else is set in Init(...).
 Parameters: None
 Returns:    None
 Exception:  Safe
@@ -16,7 +262,162 @@ Creator:    John Cox (7-26-2016)
 -----------------------------------------------------------------------------------------------*/
 ParticleManager::ParticleManager()
 {
+    // must be set before Init(...), so it can't be left to Init(...)
+    _bufferAccess = PARTICLE_BUFFER_ACCESS_GPU_ONLY;
+    _sparsePageSizeBytes = 0;
+    _particlesPerInvocation = 1;
+    _substepsPerDispatch = 1;
+    _pointSize = 1.0f;
+    _particleBrightness = 1.0f;
+    _particleOpacity = 1.0f;
+    _viewportMask = 1;
+    _isVertexPulling = false;
+    _isQuadRendering = false;
+    _quadShape = PARTICLE_QUAD_SHAPE_SQUARE;
+    _viewportWidth = 1;
+    _viewportHeight = 1;
+    _colorMode = PARTICLE_COLOR_MODE_FLAT;
+    _speedPaletteSize = 0;
+    _paletteMaxSpeed = 0.0f;
+    _fastPointSizeScale = 1.0f;
+    _isBindlessTextures = false;
+    _fieldTextureHandle = 0;
+    _sdfBoundaryTextureHandle = 0;
+    _speedPaletteTextureHandle = 0;
+    _isFlipbookRendering = false;
+    _flipbookFrameWidth = 0;
+    _flipbookFrameHeight = 0;
+    _flipbookFrameCount = 0;
+    _flipbookLevelCount = 0;
+    _flipbookCycles = 1.0f;
+    _isDoubleBufferedRendering = false;
+    _renderCopyIndex = -1;
+    _renderCopyLagSec = 0.0f;
+    _renderCopyParticleCount = 0;
+
+    // the whole window and nothing culled, the same as before there was a camera
+    _viewProjection = glm::mat4(1.0f);
+    _isViewCulled = false;
+    _uploadedView = ViewParameters();
+    _uploadedView._viewProjection = glm::mat4(0.0f);
+    _isDrawGroupCulled = false;
+    _lodSettings._mode = PARTICLE_LOD_OFF;
+    _lodSettings._fixedStride = 1;
+    _lodSettings._maxParticlesPerPixel = 1.0f;
+    _lodSettings._renderBudgetMs = 0.0f;
+    _lodSettings._maxStride = 1;
+    _lodSettings._scalesPointSize = false;
+    _lodStride = 1;
+    _lodSettleUpdates = 0;
+    _lastRenderMs = 0.0f;
+    _updateAmortization = 1;
+    _amortizationPhase = 0;
+    _renderScale = 1.0f;
+    _poolParticleCapacity = 0;
+    _emitterCapacity = 0;
+    _drawGroupCapacity = 0;
+    _forceFieldCapacity = 0;
+    _dirtyEmitterFirst = 0;
+    _dirtyEmitterEnd = 0;
+    _dirtyForceFieldFirst = 0;
+    _dirtyForceFieldEnd = 0;
+    _pendingTableUploadBytes = 0;
+    _lastTableUploadBytes = 0;
+    _fieldTextureId = 0;
+    _fieldTextureMin = glm::vec2(-1.0f, -1.0f);
+    _fieldTextureMax = glm::vec2(+1.0f, +1.0f);
+    _fieldTextureMode = PARTICLE_FIELD_TEXTURE_ACCELERATION;
+    _fieldTextureResponse = 1.0f;
+    _fieldTextureScale = 1.0f;
+    _sdfBoundaryTextureId = 0;
+    _sdfBoundaryMin = glm::vec2(-1.0f, -1.0f);
+    _sdfBoundaryMax = glm::vec2(+1.0f, +1.0f);
+    _sdfBoundaryTexelSize = glm::vec2(1.0f, 1.0f);
+    _sdfBoundaryMode = PARTICLE_SDF_BOUNDARY_KILL;
+    _sdfBoundaryRestitution = 0.0f;
+    _sdfBoundaryScale = 1.0f;
+    _segmentBvhSegmentBufferId = 0;
+    _segmentBvhNodeBufferId = 0;
+    _segmentBvhSegmentCount = 0;
+    _segmentBvhMode = PARTICLE_SEGMENT_BVH_KILL;
+    _segmentBvhRestitution = 0.0f;
+    _emissionImageCdfBufferId = 0;
+    _emissionImageWidth = 0;
+    _emissionImageHeight = 0;
+    _emissionImageMin = glm::vec2(-1.0f, -1.0f);
+    _emissionImageMax = glm::vec2(+1.0f, +1.0f);
+    _emitterPathCapacity = 0;
+    _emitterPathPointCapacity = 0;
+    _emitterSliceCapacity = 0;
+    _subEmitterMaxChildren = 0;
+    _subEmitterCapacity = 0;
+    _sleepSpeed = 0.0f;
+    _sleepRestUpdates = 30;
+    _hasLowDiscrepancyEmission = false;
+    _cpuEmissionSequenceIndex = 0;
+    _pointerInput._position = glm::vec2(0.0f, 0.0f);
+    _pointerInput._isEmitting = false;
+    _pointerInput._attractorStrength = 0.0f;
+    _pointerInput._timeMs = 0.0;
+    _pointerEmitterIndex = -1;
+    _appliedPointerInputTimeMs = 0.0;
+
+    // must be chosen before Init(...), like the buffer access (see SetSimulationBackend(...))
+    _simulationBackend = PARTICLE_SIMULATION_BACKEND_GPU;
+    _cpuWorkerCount = 0;
+    _cpuSimdLevel = PARTICLE_SIMD_SCALAR;
+    _cpuSimdKernel = 0;
+    _mappedCpuUpload = 0;
+    _cpuFirstEmitter = 0;
+    _cpuFirstParticle = 0;
+    _splitProfiler = 0;
+    _splitGpuScopeId = 0;
+    _splitUpdatesSinceMove = 0;
+    _splitSampleCount = 0;
+    _splitGpuMsSum = 0.0f;
+    _splitCpuMsSum = 0.0f;
+    _splitLastCpuMs = 0.0f;
+    _interop = 0;
+
+    // Init(...) doesn't change it (see SetLiveUpdateList(...))
+    _useUpdateList = true;
+    _isUpdateListStale = true;
+    _updateListIndex = 0;
+    _hasPersistentKernel = false;
+
+    // chosen before or after Init(...) (see SetPersistentThreads(...))
+    _persistentWorkGroupCount = 0;
+
+    // same (see SetFusedEmitUpdate(...))
+    _isFusedEmitUpdate = false;
+    _areDeadStacksStale = false;
+    _unifLocFusedEmitMode = -1;
 
+    // also chosen before Init(...) (see SetDeterministic(...))
+    _isDeterministic = false;
+    _randomSeed = 0;
+    _emitStepCounter = 0;
+    _simulationTimeSec = 0.0;
+
+    // SetForceFields(...) may come before Init(...), and this says whether there is anything to
+    // upload to yet
+    _mappedParameters = 0;
+    _burstQueueSlotStride = 0;
+    _mappedBurstQueue = 0;
+    _hasBurstKernel = false;
+    _injectionRing = 0;
+    _hasInjectionKernel = false;
+
+    // can be set up any time after Init(...), and Cleanup() checks it
+    _sortWorkGroupSizeX = DEFAULT_WORK_GROUP_SIZE;
+    _updatesSinceSort = 0;
+    _sortPairCapacity = 0;
+    _sortScratchSizeBytes = 0;
+    _particleIdCount = 0;
+    _isReadingBackIds = false;
+    _readbackIdOffset = 0;
+    _mappedReadback = 0;
+    _mappedSnapshot = 0;
 }
 
 /*-----------------------------------------------------------------------------------------------
@@ -34,10 +435,12 @@ ParticleManager::~ParticleManager()
 
 /*-----------------------------------------------------------------------------------------------
 Description:
-    As the name suggests, this deletes the shader program, vertex buffer, and VAO associated 
-    with this object.  Is called in the constructor in the event that someone forgot to call it 
-    explicitly.  This method exists so that the user can reset it without deleting the actual 
-    object (??why would you want to do this??) .
+    As the name suggests, this releases the shader programs and deletes the buffers and VAO 
+    associated with this object.  The programs are shared through the program registry, so 
+    they are only deleted if this was the last reference to them.  Is called in the 
+    constructor in the event that someone forgot to call it explicitly.  This method exists so 
+    that the user can reset it without deleting the actual object (??why would you want to do 
+    this??) .
 Parameters: None
 Returns:    None
 Exception:  Safe
@@ -45,18 +448,108 @@ Creator:    John Cox (7-26-2016)
 -----------------------------------------------------------------------------------------------*/
 void ParticleManager::Cleanup()
 {
-    glDeleteProgram(_programId);
-    glDeleteProgram(_computeProgramId);
-    glDeleteBuffers(1, &_shaderBufferId);
-    glDeleteVertexArrays(1, &_vaoId);
+    // Cleanup() runs again from the destructor, and the handles are empty after a reset, so 
+    // nothing is released twice, and nothing at all if Init(...) never ran
+    // Note: The other compute API has to let go of the particle buffers before they go.
+    if (_interop != 0)
+    {
+        _interop->UnregisterBuffers();
+    }
+    _programId.Reset();
+    _computeProgramId.Reset();
+    for (unsigned int bufferIndex = 0; bufferIndex < MAX_PARTICLE_BUFFERS; bufferIndex++)
+    {
+        _particleBufferIds[bufferIndex].Reset();
+        _mappedParticleBuffers[bufferIndex] = 0;
+        _committedParticlePages[bufferIndex].clear();
+    }
+    _loadStaging.Free();
+    _emitterBufferId.Reset();
+    _forceFieldBufferId.Reset();
+    _forceFieldCapacity = 0;
+    _dirtyEmitterFirst = 0;
+    _dirtyEmitterEnd = 0;
+    _dirtyForceFieldFirst = 0;
+    _dirtyForceFieldEnd = 0;
+    _pendingTableUploadBytes = 0;
+    _lastTableUploadBytes = 0;
+    _emitterPathBufferId.Reset();
+    _emitterPathPointBufferId.Reset();
+    _emitterPathCapacity = 0;
+    _emitterPathPointCapacity = 0;
+    _emitterSliceBufferId.Reset();
+    _emitterSliceCapacity = 0;
+    _subEmitterBufferId.Reset();
+    _subEmitterCapacity = 0;
+    _deathEventBufferId.Reset();
+    _sleepMaskBufferId.Reset();
+    _restCountBufferId.Reset();
+    _deadCountBufferId.Reset();
+    _deadIndexBufferId.Reset();
+    _liveIndexBufferId.Reset();
+    _updateListBufferIds[0].Reset();
+    _updateListBufferIds[1].Reset();
+    _activeMaskBufferId.Reset();
+    _persistentQueueBufferId.Reset();
+    _drawCommandBufferId.Reset();
+    _drawGroupStyleBufferId.Reset();
+    _drawGroupBoundsBufferId.Reset();
+    _quadCommandBufferId.Reset();
+    this->ReleaseRenderCopies();
+    _isDoubleBufferedRendering = false;
+
+    // a handle has to let go before its texture does
+    this->ReleaseBindlessTextures();
+    _isBindlessTextures = false;
+    _speedPaletteTextureId.Reset();
+    _speedPaletteSize = 0;
+    _flipbookTextureId.Reset();
+    _flipbookFrameCount = 0;
+
+    // the field texture, the SDF boundary, the segment BVH, and the emission image belong to 
+    // whoever set them
+    _fieldTextureId = 0;
+    _sdfBoundaryTextureId = 0;
+    _segmentBvhSegmentBufferId = 0;
+    _segmentBvhNodeBufferId = 0;
+    _segmentBvhSegmentCount = 0;
+    _emissionImageCdfBufferId = 0;
+    _emissionImageWidth = 0;
+    _emissionImageHeight = 0;
+    _vaoId.Reset();
+
+    // the fences may still be pending, but deleting them is fine; deleting the buffer also 
+    // releases the persistent mapping
+    _parameterFenceRing.Cleanup();
+    _parameterBufferId.Reset();
+    _viewBufferId.Reset();
+    _mappedParameters = 0;
+    _burstQueueBufferId.Reset();
+    _mappedBurstQueue = 0;
+    _pendingBursts.clear();
+    _injectionRing = 0;
+
+    for (unsigned int slotIndex = 0; slotIndex < COUNT_READBACK_SLOTS; slotIndex++)
+    {
+        _countReadbackFences[slotIndex].Reset();
+    }
+    _countReadbackBufferId.Reset();
+    _mappedCountReadback = 0;
+
+    // a snapshot that was started just before shutting down is still finished
+    this->ClearParticleReadback();
+    this->FinishSnapshot(true);
+    this->ClearParticleSort();
+    _particleIdBufferId.Reset();
+    _particleSlotBufferId.Reset();
+    _particleIdCount = 0;
+    this->CleanupCpuSimulation();
 }
 
 /*-----------------------------------------------------------------------------------------------
 Description:
-    Records the program ID, the maximum number of particles to be emitted per frame, and the 
-    emitter center.  Re-sizes the internal collection of particles to accomodate the specified 
-    number.  Calculates the boundary at which particles become invalid based on the provided 
-    radius.  Calculates the velocity delta from the provided min and max velocities.
+    A convenience for a manager with a single emitter that owns every particle.  See the other 
+    Init(...).
 Parameters: 
     programId       The shader program must be constructed prior to this.
     computeProgramId    Same issue.
@@ -66,6 +559,8 @@ Parameters:
     radius          In window coords.  
     minVelocity     In window coords.
     maxVelocity     In window coords.
+    layout          How the particles are stored on the GPU.  Must be the same layout that the 
+                    compute shader was generated with (see GetComputeShaderDefines(...)).
 Returns:    None
 Exception:  Safe
 Creator:    John Cox (7-26-2016)
@@ -77,238 +572,9075 @@ void ParticleManager::Init(unsigned int programId,
     const glm::vec2 center,
     float radius,
     float minVelocity,
-    float maxVelocity)
+    float maxVelocity,
+    ParticleLayout layout)
+{
+    ParticleEmitter emitter;
+    emitter._center = center;
+    emitter._radius = radius;
+    emitter._velocityMin = minVelocity;
+    emitter._velocityMax = maxVelocity;
+    emitter._maxParticlesEmittedPerFrame = maxParticlesEmittedPerFrame;
+    emitter._particleCount = numParticles;
+    emitter._firstParticle = 0;
+    emitter._lifetimeSec = 0.0f;
+    emitter._spawnShape = PARTICLE_SPAWN_DISK;
+
+    std::vector<ParticleEmitter> emitters(1, emitter);
+    this->Init(programId, computeProgramId, emitters, layout);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Records the program IDs and the emitters, gives each emitter its own contiguous range of the
+    particle pool (in the order given), sizes the pool to hold all of them, and creates the GPU 
+    buffers.  However many emitters there are, Update(...) is a single dispatch and Render() is 
+    a single draw call.
+Parameters: 
+    programId       The shader program must be constructed prior to this, and must come from 
+                    the program registry (see ShaderProgramRegistry.h).  This object takes its 
+                    own reference, so the caller may release theirs after this returns.
+    computeProgramId    Same issue.  May be 0 with the CPU backend (see 
+                        SetSimulationBackend(...)).
+    emitters        At least one.  The "first particle" of each is filled in here.
+    layout          How the particles are stored on the GPU.  Must be the same layout that the 
+                    compute shader was generated with (see GetComputeShaderDefines(...)).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-13-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::Init(unsigned int programId,
+    unsigned int computeProgramId,
+    const std::vector<ParticleEmitter> &emitters,
+    ParticleLayout layout)
 {
-    _programId = programId;
-    _computeProgramId = computeProgramId;
-    _allParticles.resize(numParticles);
-    _sizeBytes = sizeof(Particle) * numParticles;
+    if (emitters.empty())
+    {
+        LogPrintf("particle manager needs at least one emitter\n");
+        return;
+    }
+
+    _emitters = emitters;
+    unsigned int numParticles = 0;
+    for (size_t emitterIndex = 0; emitterIndex < _emitters.size(); emitterIndex++)
+    {
+        _emitters[emitterIndex]._firstParticle = numParticles;
+        numParticles += _emitters[emitterIndex]._particleCount;
+    }
+
+    // the rest of the pool, if any, is left unused for SetEmitterTable(...)
+    unsigned int emitterParticleCount = numParticles;
+    if (numParticles < _poolParticleCapacity)
+    {
+        numParticles = _poolParticleCapacity;
+    }
+    if (_emitterCapacity < _emitters.size())
+    {
+        _emitterCapacity = (unsigned int)_emitters.size();
+    }
+
+    // the emit and rebuild passes dispatch one row of work groups per emitter
+    // Note: The limit is at least 65535, so this is only a sanity check, but a dispatch over 
+    // the limit does nothing at all, and that would be a lot harder to track down.  The CPU 
+    // backend doesn't dispatch anything.
+    unsigned int maxEmitters = GetComputeDeviceCaps()._maxWorkGroupCount[1];
+    if (_simulationBackend != PARTICLE_SIMULATION_BACKEND_CPU && _emitterCapacity > maxEmitters)
+    {
+        LogPrintf("particle manager can have at most %u emitters on this device, not %u\n", 
+            maxEmitters, _emitterCapacity);
+        return;
+    }
+
+    // a pool that won't fit is refused here rather than found out about halfway through, 
+    // from buffers with no storage (see GpuMemoryLedger.h)
+    // Note: main.cpp shrinks the pool to fit the budget before it gets this far.
+    // Note: Sparse particle buffers only commit the emitters' ranges, so the rest of the 
+    // pool's particles aren't held against the budget, only its indices.
+    _sparsePageSizeBytes = 0;
+    if (_bufferAccess == PARTICLE_BUFFER_ACCESS_SPARSE)
+    {
+        GLint pageSizeBytes = 0;
+        if (_simulationBackend == PARTICLE_SIMULATION_BACKEND_GPU && 
+            IsGlExtensionSupported("GL_ARB_sparse_buffer"))
+        {
+            gBufferPageCommitmentArb = (BufferPageCommitmentArbProc)
+                GetGlFunctionAddress("glBufferPageCommitmentARB");
+            glGetIntegerv(SPARSE_BUFFER_PAGE_SIZE_ARB, &pageSizeBytes);
+        }
+        if (gBufferPageCommitmentArb == 0 || pageSizeBytes <= 0)
+        {
+            LogPrintf("sparse particle buffers need GL_ARB_sparse_buffer and the GPU backend; "
+                "the whole pool will be committed\n");
+            _bufferAccess = PARTICLE_BUFFER_ACCESS_GPU_ONLY;
+        }
+        else
+        {
+            _sparsePageSizeBytes = (size_t)pageSizeBytes;
+        }
+    }
+    unsigned int maxPoolParticleCount = GetMaxPoolParticleCount(layout);
+    if (numParticles > maxPoolParticleCount)
+    {
+        LogErrorPrintf("particle manager can't address %u particles in one buffer; the most "
+            "for this layout is %u\n", numParticles, maxPoolParticleCount);
+        return;
+    }
+    unsigned long long estimatedBytes = EstimateGpuMemory(numParticles, layout);
+    if (_sparsePageSizeBytes > 0)
+    {
+        unsigned long long unusedIndexBytes = 
+            (numParticles - emitterParticleCount) * 4ull * sizeof(GLuint);
+        estimatedBytes = EstimateGpuMemory(emitterParticleCount, layout) + unusedIndexBytes;
+    }
+    if (WouldExceedGpuMemoryBudget(estimatedBytes))
+    {
+        LogErrorPrintf("particle manager needs about %.1fMB for %u particles, which won't fit "
+            "in the GPU memory budget\n", estimatedBytes / (1024.0 * 1024.0), numParticles);
+        return;
+    }
+
+    _layout = layout;
+    _programId = ReferenceGlProgram(programId);
+    _computeProgramId = ReferenceGlProgram(computeProgramId);
+
+    // every particle starts out inactive and zeroed
+    // Note: This used to call ResetParticle(...) on every particle, which was single-threaded 
+    // random number generation over the whole array at startup.  The compute shader now gives 
+    // each particle a fresh position and velocity when it is emitted, and nothing reads an 
+    // inactive particle's position or velocity, so that work was thrown away.
+    // Also Note: There also used to be a CPU-side copy of every particle, kept for the life of 
+    // the manager and only ever used for the initial upload and for its size.  The particle 
+    // buffers are now zeroed on the GPU (see AllocateParticleBuffer(...)), so host memory no 
+    // longer grows with the particle count and only the count is kept.
+    _maxParticleCount = numParticles;
     _drawStyle = GL_POINTS;
-    _maxParticlesEmittedPerFrame = maxParticlesEmittedPerFrame;
-    _center = center;
-    _radiusSqr = radius * radius;   // because only radius squared is used during update
-    _velocityMin = minVelocity;
-    _velocityDelta = maxVelocity - minVelocity;
+    _maxEmitterQuota = this->GetMaxEmitterQuota();
+    _updateBarrierBits = this->GetUpdateBarrierBits();
+    _useFullMemoryBarrier = false;
+    _parameterFrameIndex = 0;
 
-    // start all particles at the emission orign
-    for (size_t particleCount = 0; particleCount < _allParticles.size(); particleCount++)
+    // the seeds are spread by the golden ratio so that seeds 1 and 2 aren't the same run one 
+    // step apart
+    // Note: The CPU and split backends pop dead stacks in whatever order their threads get 
+    // there, so only the GPU backend can be deterministic.
+    _stepCounter = _randomSeed * 0x9e3779b9u;
+    _emitStepCounter = 0;
+    _simulationTimeSec = 0.0;
+    if (_isDeterministic && _simulationBackend != PARTICLE_SIMULATION_BACKEND_GPU)
     {
-        // pointer arithmetic will do
-        this->ResetParticle(_allParticles.data() + particleCount);
+        LogPrintf("the deterministic mode needs the GPU backend, so it is off\n");
+        _isDeterministic = false;
     }
 
-    _unifLocDeltaTimeSec = glGetUniformLocation(_computeProgramId, "uDeltaTimeSec");
-    _unifLocRadiusSqr = glGetUniformLocation(_computeProgramId, "uRadiusSqr");
-    _unifLocEmitterCenter = glGetUniformLocation(_computeProgramId, "uEmitterCenter");
-    _unifLocMaxParticlesEmittedPerFrame = glGetUniformLocation(_computeProgramId, "uMmaxParticlesEmittedPerFrame");
-    _unifLocMaxParticleCount = glGetUniformLocation(_computeProgramId, "uMaxParticleCount");
+    this->LoadProgramInterfaces();
 
-    glUseProgram(_computeProgramId);
-    
-    glUniform1f(_unifLocRadiusSqr, _radiusSqr);
-    glUniform1ui(_unifLocMaxParticlesEmittedPerFrame, maxParticlesEmittedPerFrame);
-    glUniform1ui(_unifLocMaxParticleCount, numParticles);
-
-    // feeding vectors into uniforms requires an array, or at least they need to be contiguous 
-    // in memory, and I would rather explicitly spell out an array than assume the value order 
-    // in a 3rd party struct
-    float centerArr[4] = { center.x, center.y, 0.0f, 0.0f };
-    glUniform2fv(_unifLocEmitterCenter, 1, centerArr);
+    UseGlProgram(_computeProgramId);
+    this->InitParameterBuffer();
+    this->InitBurstQueueBuffer();
+    this->InitViewBuffer();
     
-    //??why are these work group counts all undefined??
-    int workGroupCount[3];
-    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 0, &workGroupCount[0]);
-    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 1, &workGroupCount[1]);
-    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 2, &workGroupCount[2]);
-    printf("max global (total) work group counts: x = %d, y = %d, z = %d\n", workGroupCount[0], 
-        workGroupCount[1], workGroupCount[2]);
-
-    int workGroupSize[3];
-    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_SIZE, 0, &workGroupCount[0]);
-    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_SIZE, 1, &workGroupCount[1]);
-    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_SIZE, 2, &workGroupCount[2]);
-    printf("max global (total) work group sizes: x = %d, y = %d, z = %d\n", workGroupSize[0],
-        workGroupSize[1], workGroupSize[2]);
-
-    int workGroupInvocations = 0;
-    // ??why is GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS, which is in the lists at https://www.opengl.org/wiki/GLAPI/glGet, bute  undefined, but GL_MAX_COMPUTE_LOCAL_INVOCATIONS, which is not in the lists on that website, is defined? are they the same thing??
-    glGetIntegerv(GL_MAX_COMPUTE_LOCAL_INVOCATIONS, &workGroupInvocations);
-    printf("max local invocations = %d\n", workGroupInvocations);
-
-    glUseProgram(0);
-
-    // no program binding needed 
-    // Note: Using a "shader storage buffer" because, unlike the vertex array buffer, this same buffer can be used for both the compute shader and the vertex shader.
-    _shaderBufferId = 0;
-    glGenBuffers(1, &_shaderBufferId);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _shaderBufferId);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, _allParticles.size() * sizeof(Particle), _allParticles.data(), GL_STATIC_DRAW);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, _shaderBufferId);  // ??the hey does this do??
-
-    // now set up the vertex array indices for the drawing shader
+    // the limits that the dispatches in Update(...) are split to fit (see ComputeDeviceCaps.h)
+    PrintComputeDeviceCaps();
+
+    UseGlProgram(0);
+
+    // the emitter table
+    // Note: Mutable storage because SetEmitter(...) can change an emitter between frames.  
+    // Sized for the emitter capacity so that SetEmitterTable(...) never has to re-create it.
+    _emitterBufferId = GenerateGlBuffer();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _emitterBufferId);
+    LabelGlObject(GL_BUFFER, _emitterBufferId, "particle emitters");
+    glBufferData(GL_SHADER_STORAGE_BUFFER, _emitterCapacity * sizeof(ParticleEmitter), 0, 
+        GL_DYNAMIC_DRAW);
+    RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particle emitters");
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, _emitters.size() * sizeof(ParticleEmitter), 
+        _emitters.data());
+    _pendingTableUploadBytes += (unsigned int)(_emitters.size() * sizeof(ParticleEmitter));
+    BindGlShaderStorageBuffer(EMITTER_BUFFER_BINDING, _emitterBufferId);
+
+    // the force fields may have been set before Init(...), and there is a buffer even without 
+    // any so that the binding always has one
+    this->SetForceFields(_forceFields);
+
+    // likewise for the emitter paths, but without any, the update doesn't read their buffers
+    this->SetEmitterPaths(_emitterPaths, _emitterPathPoints);
+    this->SetEmitterUpdateSlices(_emitterSlices);
+    this->SetSubEmitters(_subEmitters);
+
+    // the dead stacks, one per emitter (see DeadCountBuffer in shaderParticle.comp)
+    // Note: Every particle starts out inactive, so every stack starts out full.  Each emitter's
+    // stack lives in its own range of the particle pool, and that range holds exactly the 
+    // indices of the emitter's particles, so the initial stacks together are just 0, 1, 2...
+    std::vector<GLint> deadCounts(_emitterCapacity, 0);
+    for (size_t emitterIndex = 0; emitterIndex < _emitters.size(); emitterIndex++)
+    {
+        deadCounts[emitterIndex] = (GLint)_emitters[emitterIndex]._particleCount;
+    }
+    _deadCountBufferId = GenerateGlBuffer();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _deadCountBufferId);
+    LabelGlObject(GL_BUFFER, _deadCountBufferId, "particle dead counts");
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, deadCounts.size() * sizeof(GLint), 
+        deadCounts.data(), 0);
+    RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particle dead counts");
+    BindGlShaderStorageBuffer(DEAD_COUNT_BUFFER_BINDING, _deadCountBufferId);
+
+    std::vector<GLuint> deadIndices(numParticles);
+    for (unsigned int particleIndex = 0; particleIndex < numParticles; particleIndex++)
+    {
+        deadIndices[particleIndex] = particleIndex;
+    }
+    _deadIndexBufferId = GenerateGlBuffer();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _deadIndexBufferId);
+    LabelGlObject(GL_BUFFER, _deadIndexBufferId, "particle dead indices");
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, deadIndices.size() * sizeof(GLuint), 
+        deadIndices.data(), 0);
+    RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particle dead indices");
+    BindGlShaderStorageBuffer(DEAD_INDEX_BUFFER_BINDING, _deadIndexBufferId);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // stream compaction output
+    // Note: The compute shader appends the index of every particle that is still active after 
+    // the update to its draw group's range of the live index buffer and counts them in that 
+    // group's draw command's "count".  Render() then draws those indices with 
+    // glMultiDrawElementsIndirect(...), so the number of vertex shader invocations follows the
+    // number of live particles instead of the capacity.  The live index buffer MUST be at 
+    // least as big as the particle count because every particle might be alive at once.
+    _liveIndexBufferId = GenerateGlBuffer();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _liveIndexBufferId);
+    LabelGlObject(GL_BUFFER, _liveIndexBufferId, "particle live indices");
+    glBufferData(GL_SHADER_STORAGE_BUFFER, numParticles * sizeof(GLuint), 0, GL_DYNAMIC_COPY);
+    RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particle live indices");
+    BindGlShaderStorageBuffer(LIVE_INDEX_BUFFER_BINDING, _liveIndexBufferId);
+
+    // the update lists, which are sized like the live index buffer
+    // Note: The first update builds one from the whole pool (see UpdateSteps(...)).
+    for (unsigned int listIndex = 0; listIndex < 2; listIndex++)
+    {
+        _updateListBufferIds[listIndex] = GenerateGlBuffer();
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, _updateListBufferIds[listIndex]);
+        LabelGlObject(GL_BUFFER, _updateListBufferIds[listIndex], "particle update list");
+        glBufferData(GL_SHADER_STORAGE_BUFFER, 
+            sizeof(UpdateListHeader) + (numParticles * sizeof(GLuint)), 0, GL_DYNAMIC_COPY);
+        RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particle update list");
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    _updateListIndex = 0;
+    _isUpdateListStale = true;
+
+    // every particle starts out inactive, so the mask starts out 0
+    // Note: Mutable storage so that Resize(...) can re-specify it like the live index buffer.
+    GLuint zero = 0;
+    _activeMaskBufferId = GenerateGlBuffer();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _activeMaskBufferId);
+    LabelGlObject(GL_BUFFER, _activeMaskBufferId, "particle active mask");
+    glBufferData(GL_SHADER_STORAGE_BUFFER, ((numParticles + 31) / 32) * sizeof(GLuint), 0, 
+        GL_DYNAMIC_COPY);
+    RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particle active mask");
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, 
+        &zero);
+    BindGlShaderStorageBuffer(ACTIVE_MASK_BUFFER_BINDING, _activeMaskBufferId);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // a PARTICLE_SLEEP program's sleep flags (the same shape as the active mask) and rest 
+    // counts, which start out all awake
+    if (_unifLocSleepSpeedSqr != (unsigned int)-1)
+    {
+        _sleepMaskBufferId = GenerateGlBuffer();
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, _sleepMaskBufferId);
+        LabelGlObject(GL_BUFFER, _sleepMaskBufferId, "particle sleep mask");
+        glBufferData(GL_SHADER_STORAGE_BUFFER, ((numParticles + 31) / 32) * sizeof(GLuint), 0, 
+            GL_DYNAMIC_COPY);
+        RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particle sleep mask");
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, 
+            &zero);
+        _restCountBufferId = GenerateGlBuffer();
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, _restCountBufferId);
+        LabelGlObject(GL_BUFFER, _restCountBufferId, "particle rest counts");
+        glBufferData(GL_SHADER_STORAGE_BUFFER, numParticles * sizeof(GLuint), 0, 
+            GL_DYNAMIC_COPY);
+        RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particle rest counts");
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, 
+            &zero);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    // the persistent-threads kernel's queue is just its next chunk and its count of finished 
+    // emit chunks, which are zeroed before every dispatch
+    _persistentQueueBufferId = GenerateGlBuffer();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _persistentQueueBufferId);
+    LabelGlObject(GL_BUFFER, _persistentQueueBufferId, "particle persistent queue");
+    glBufferData(GL_SHADER_STORAGE_BUFFER, 2 * sizeof(GLuint), 0, GL_DYNAMIC_COPY);
+    RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particle persistent queue");
+    BindGlShaderStorageBuffer(PERSISTENT_QUEUE_BUFFER_BINDING, _persistentQueueBufferId);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // Note: Sized for the draw group capacity, like the emitter table.
+    if (_drawGroupCapacity < _drawGroupFirstEmitters.size())
+    {
+        _drawGroupCapacity = (unsigned int)_drawGroupFirstEmitters.size();
+    }
+    if (_drawGroupCapacity == 0)
+    {
+        _drawGroupCapacity = 1;
+    }
+    this->InitDrawGroups();
+    DrawCommandBufferHeader drawCommandHeader = { 0, (unsigned int)_drawGroupLiveCounts.size() };
+    GLsizeiptr commandBytes = _drawCommandResetData.size() * sizeof(GLuint);
+    GLsizeiptr commandCapacityBytes = _drawGroupCapacity * sizeof(DrawElementsIndirectCommand);
+    _drawCommandBufferId = GenerateGlBuffer();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _drawCommandBufferId);
+    LabelGlObject(GL_BUFFER, _drawCommandBufferId, "particle draw commands");
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(drawCommandHeader) + commandCapacityBytes, 0, 
+        GL_DYNAMIC_COPY);
+    RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particle draw commands");
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(drawCommandHeader), &drawCommandHeader);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(drawCommandHeader), commandBytes, 
+        _drawCommandResetData.data());
+    BindGlShaderStorageBuffer(DRAW_COMMAND_BUFFER_BINDING, _drawCommandBufferId);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    this->InitCountReadbackBuffer();
+
+    // a DRAW_GROUP_CULLING program's bounds, one uvec4 per group, which every step clears 
+    // (see ClearDrawGroupBounds())
+    if (_unifLocDrawGroupCulled != (unsigned int)-1)
+    {
+        _drawGroupBoundsBufferId = GenerateGlBuffer();
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, _drawGroupBoundsBufferId);
+        LabelGlObject(GL_BUFFER, _drawGroupBoundsBufferId, "particle draw group bounds");
+        glBufferData(GL_SHADER_STORAGE_BUFFER, _drawGroupCapacity * 4 * sizeof(GLuint), 0, 
+            GL_DYNAMIC_COPY);
+        RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particle draw group bounds");
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    // only a quad render program uses these, but they are small, and a program that is 
+    // replaced later (see ReplaceProgram(...)) may turn out to be one
+    _quadCommandData.resize(_drawGroupCapacity * 
+        (sizeof(DrawArraysIndirectCommand) / sizeof(GLuint)));
+    _quadCommandBufferId = GenerateGlBuffer();
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _quadCommandBufferId);
+    LabelGlObject(GL_BUFFER, _quadCommandBufferId, "particle quad draw commands");
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, _drawGroupCapacity * sizeof(DrawArraysIndirectCommand), 
+        0, GL_DYNAMIC_DRAW);
+    RecordBoundGlBufferAllocation(GL_DRAW_INDIRECT_BUFFER, "particle quad draw commands");
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    // the quads are sized in pixels, so they need the viewport until the window says otherwise
+    // (see SetViewportSize(...))
+    GLint viewport[4] = { 0, 0, 0, 0 };
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    this->SetViewportSize(viewport[2], viewport[3]);
+
+    // now set up the particle buffers and the vertex array indices for the drawing shader
     // Note: MUST bind the program beforehand or else the VAO binding will blow up.  It won't 
     // spit out an error but will rather silently bind to whatever program is currently bound, 
     // even if it is the undefined program 0.
-    glUseProgram(programId);
-    glGenVertexArrays(1, &_vaoId);
-    glBindVertexArray(_vaoId);
-    glBindBuffer(GL_ARRAY_BUFFER, _shaderBufferId);
-    // do NOT call glBufferData(...) because info was already loaded
-
-    // position appears first in structure and so is attribute 0 
-    // velocity appears second and is attribute 1
-    // "is active" flag is third and is attribute 2
-    unsigned int vertexArrayIndex = 0;
-    unsigned int bufferStartOffset = 0;
-
-    unsigned int bytesPerStep = sizeof(Particle);
-
-    // position
-    GLenum itemType = GL_FLOAT;
-    unsigned int numItems = sizeof(Particle::_position) / sizeof(float);
-    glEnableVertexAttribArray(vertexArrayIndex);
-    glVertexAttribPointer(vertexArrayIndex, numItems, itemType, GL_FALSE, bytesPerStep, (void *)bufferStartOffset);
-
-    // velocity
-    itemType = GL_FLOAT;
-    numItems = sizeof(Particle::_velocity) / sizeof(float);
-    bufferStartOffset += sizeof(Particle::_position);
-    vertexArrayIndex++;
-    glEnableVertexAttribArray(vertexArrayIndex);
-    glVertexAttribPointer(vertexArrayIndex, numItems, itemType, GL_FALSE, bytesPerStep, (void *)bufferStartOffset);
-
-    // "is active" flag
-    itemType = GL_INT;
-    numItems = sizeof(Particle::_isActive) / sizeof(int);
-    bufferStartOffset += sizeof(Particle::_velocity);
-    vertexArrayIndex++;
-    glEnableVertexAttribArray(vertexArrayIndex);
-    glVertexAttribPointer(vertexArrayIndex, numItems, itemType, GL_FALSE, bytesPerStep, (void *)bufferStartOffset);
+    UseGlProgram(programId);
+    _vaoId = GenerateGlVertexArray();
+    BindGlVertexArray(_vaoId);
+
+    this->InitParticleBuffers();
+
+    // one style per draw group, picked by the draw command's "base instance"
+    // Note: Every command draws 1 instance (or 0 if the group is hidden), so with a divisor of
+    // 1, every vertex of a command reads the style at its base instance.
+    _drawGroupStyleBufferId = GenerateGlBuffer();
+    glBindBuffer(GL_ARRAY_BUFFER, _drawGroupStyleBufferId);
+    LabelGlObject(GL_BUFFER, _drawGroupStyleBufferId, "particle draw group styles");
+    glBufferData(GL_ARRAY_BUFFER, _drawGroupCapacity * sizeof(glm::vec2), 0, GL_DYNAMIC_DRAW);
+    RecordBoundGlBufferAllocation(GL_ARRAY_BUFFER, "particle draw group styles");
+    glBufferSubData(GL_ARRAY_BUFFER, 0, _drawGroupStyles.size() * sizeof(glm::vec2), 
+        _drawGroupStyles.data());
+    glEnableVertexAttribArray(DRAW_GROUP_STYLE_ATTRIBUTE);
+    glVertexAttribPointer(DRAW_GROUP_STYLE_ATTRIBUTE, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), 
+        (void *)0);
+    glVertexAttribDivisor(DRAW_GROUP_STYLE_ATTRIBUTE, 1);
+
+    // the VAO remembers the element array binding, so the live indices are used automatically 
+    // whenever the VAO is bound
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _liveIndexBufferId);
+
+    // the same live indices, one per instance, for a quad render program
+    // Note: Each command's "base instance" is its group's first index, so instance i of a 
+    // group reads its i'th live index.
+    glBindBuffer(GL_ARRAY_BUFFER, _liveIndexBufferId);
+    glVertexAttribIPointer(QUAD_PARTICLE_INDEX_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof(GLuint), 
+        (void *)0);
+    glVertexAttribDivisor(QUAD_PARTICLE_INDEX_ATTRIBUTE, 1);
+    this->ApplyVertexPulling();
 
     // cleanup
-    glBindVertexArray(0);   // unbind this BEFORE the array
+    BindGlVertexArray(0);   // unbind this BEFORE the array
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glUseProgram(0);    // always last
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    UseGlProgram(0);    // always last
+
+    // none of the allocations above say whether they worked, so the error flags are the only
+    // way to know, and a manager with missing buffers is worse than none
+    if (CheckGlOutOfMemory("particle manager"))
+    {
+        this->Cleanup();
+        _maxParticleCount = 0;
+        return;
+    }
+
+    // needs the particle buffers' sizes and the draw group capacity
+    if (_simulationBackend != PARTICLE_SIMULATION_BACKEND_GPU)
+    {
+        this->InitCpuSimulation();
+    }
 }
 
 /*-----------------------------------------------------------------------------------------------
 Description:
-    Checks if each particle is out of bounds, and if so, resets it.  If the quota for emitted 
-    particles hasn't been reached yet, then the particle is sent back out again.  Lastly, if the 
-    particle is active, then its position is updated with its velocity and the provided delta 
-    time.
-Parameters:
-    deltatimeSec        Self-explanatory
+    Creates the uniform buffer that feeds the compute shader's "SimulationParameters" block.
+
+    The buffer is immutable (glBufferStorage(...)) and mapped once, persistently and coherently,
+    so writing a step's parameters is just a memcpy(...) into the mapped pointer.  There are no 
+    glUniform*(...) calls for the driver to validate, and adding more parameters later doesn't 
+    add more API calls.
+
+    The buffer holds PARAMETER_FRAMES_IN_FLIGHT frames of PARAMETER_BLOCKS_PER_FRAME blocks 
+    each, one for the emit pass and one per update step.  The CPU can be writing one frame while the GPU is still 
+    reading the previous ones, and a fence per frame keeps the CPU from overwriting a frame that
+    the GPU hasn't finished with (see UpdateSteps(...)).
+Parameters: None
 Returns:    None
 Exception:  Safe
-Creator:    John Cox (7-4-2016)
+Creator:    John Cox (8-12-2016)
 -----------------------------------------------------------------------------------------------*/
-void ParticleManager::Update(float deltaTimeSec)
+void ParticleManager::InitParameterBuffer()
 {
-    // bind before attempting to send any uniforms or starting to compute stuff
-    glUseProgram(_computeProgramId);
-    glUniform1f(_unifLocDeltaTimeSec, deltaTimeSec);
+    // each block must start on the uniform buffer offset alignment for glBindBufferRange(...)
+    GLint offsetAlignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+    if (offsetAlignment <= 0)
+    {
+        offsetAlignment = 256;
+    }
+    unsigned int blockSize = sizeof(SimulationParameters);
+    _parameterBlockStride = ((blockSize + offsetAlignment - 1) / offsetAlignment) * offsetAlignment;
 
-    // the work groups specified here MUST (??you sure??) match the values specified by 
-    // "local_size_x", "local_size_y", and "local_size_z" in the compute shader's input layout
-    GLuint numWorkGroupsX = (_allParticles.size() / 256) + 1;
-    GLuint numWorkGroupsY = 1;
-    GLuint numWorkGroupsZ = 1;
-    glDispatchCompute(numWorkGroupsX, numWorkGroupsY, numWorkGroupsZ);
+    unsigned int totalBlocks = PARAMETER_FRAMES_IN_FLIGHT * PARAMETER_BLOCKS_PER_FRAME;
+    GLbitfield storageFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    _parameterBufferId = GenerateGlBuffer();
+    glBindBuffer(GL_UNIFORM_BUFFER, _parameterBufferId);
+    LabelGlObject(GL_BUFFER, _parameterBufferId, "particle simulation parameters");
+    glBufferStorage(GL_UNIFORM_BUFFER, totalBlocks * _parameterBlockStride, 0, storageFlags);
+    RecordBoundGlBufferAllocation(GL_UNIFORM_BUFFER, "particle simulation parameters");
+    _mappedParameters = glMapBufferRange(GL_UNIFORM_BUFFER, 0, 
+        totalBlocks * _parameterBlockStride, storageFlags);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    if (_mappedParameters == 0)
+    {
+        LogPrintf("failed to map the simulation parameter buffer\n");
+    }
+
+    _parameterFenceRing.Init(PARAMETER_FRAMES_IN_FLIGHT, "parameter ring");
+}
 
-    // tell the GPU:
-    // (1) Accesses to the shader buffer after this call will reflect writes prior to the 
-    // barrier.  This is only available in OpenGL 4.3 or higher.
-    // (2) Vertex data sourced from buffer objects after the barrier will reflect data written 
-    // by shaders prior to the barrier.  The affected buffer(s) is determined by the buffers 
-    // that were bound for the vertex attributes.  In this case, that means GL_ARRAY_BUFFER.
-    //glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
-    glMemoryBarrier(GL_ALL_BARRIER_BITS);
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Creates the burst queue (see TriggerBurst(...)): PARAMETER_FRAMES_IN_FLIGHT slots of a 
+    header and room for MAX_BURSTS_PER_UPDATE bursts, persistently mapped for writing like the 
+    parameter buffer.  A slot is only written after the parameter frame that shares its index 
+    has been waited on, so the parameter fences cover it too.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::InitBurstQueueBuffer()
+{
+    // each slot is bound as a range, so it must start on the storage buffer offset alignment
+    GLint offsetAlignment = 0;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+    if (offsetAlignment <= 0)
+    {
+        offsetAlignment = 256;
+    }
+    unsigned int slotSize = sizeof(BurstQueueHeader) + 
+        (MAX_BURSTS_PER_UPDATE * sizeof(ParticleBurst));
+    _burstQueueSlotStride = ((slotSize + offsetAlignment - 1) / offsetAlignment) * 
+        offsetAlignment;
 
-    glUseProgram(0);
+    GLbitfield storageFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    _burstQueueBufferId = GenerateGlBuffer();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _burstQueueBufferId);
+    LabelGlObject(GL_BUFFER, _burstQueueBufferId, "particle burst queue");
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, 
+        PARAMETER_FRAMES_IN_FLIGHT * _burstQueueSlotStride, 0, storageFlags);
+    RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particle burst queue");
+    _mappedBurstQueue = glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, 
+        PARAMETER_FRAMES_IN_FLIGHT * _burstQueueSlotStride, storageFlags);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    if (_mappedBurstQueue == 0)
+    {
+        LogPrintf("failed to map the particle burst queue\n");
+    }
+    _pendingBursts.reserve(MAX_BURSTS_PER_UPDATE);
 }
 
-void ParticleManager::Render()
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Creates the uniform buffer that feeds the "ViewParameters" block in the render program and 
+    the compute shader (see SetView(...)) and fills it with the current view.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::InitViewBuffer()
 {
-    glUseProgram(_programId);
-    glBindVertexArray(_vaoId);
-    glDrawArrays(_drawStyle, 0, _allParticles.size());
-    glUseProgram(0);
+    _viewBufferId = GenerateGlBuffer();
+    glBindBuffer(GL_UNIFORM_BUFFER, _viewBufferId);
+    LabelGlObject(GL_BUFFER, _viewBufferId, "particle view");
+    glBufferStorage(GL_UNIFORM_BUFFER, sizeof(ViewParameters), 0, GL_DYNAMIC_STORAGE_BIT);
+    RecordBoundGlBufferAllocation(GL_UNIFORM_BUFFER, "particle view");
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    // anything that isn't a valid view, so the first upload always happens
+    _uploadedView = ViewParameters();
+    _uploadedView._viewProjection = glm::mat4(0.0f);
+    this->UploadView();
 }
 
 /*-----------------------------------------------------------------------------------------------
 Description:
-    Checks if the provided particle has gone outside the circle.
-Parameters:
-    p   A const reference to a Particle object.
-Returns:
-    True if the particle's position is outside the circle's boundaries, otherwise false.
-    Exception:  Safe
-Creator:    John Cox (7-2-2016)
+    Creates the buffer that the live particle counts and the emitted count are copied into 
+    after every update so that the CPU can read them without stalling (see 
+    GetParticleCounts(...)).  Each slot holds the header and room for as many commands as there 
+    can be draw groups (see SetPoolCapacity(...)), so it must come after the draw group 
+    capacity is known.
+
+    Like the parameter buffer, this is a ring of slots with a fence each.  The counts are copied
+    into the next slot on the GPU's timeline, and the CPU only reads a slot after its fence has 
+    signaled, which is normally a couple of frames later.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-14-2016)
 -----------------------------------------------------------------------------------------------*/
-bool ParticleManager::OutOfBounds(const Particle &p) const
+void ParticleManager::InitCountReadbackBuffer()
 {
-    glm::vec4 centerToParticle = p._position - glm::vec4(_center, 0.0f, 0.0f);
-    float distSqr = glm::dot(centerToParticle, centerToParticle);
-    if (distSqr > _radiusSqr)
+    GLbitfield storageFlags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    _countReadbackSlotSizeBytes = sizeof(DrawCommandBufferHeader) + 
+        (_drawGroupCapacity * sizeof(DrawElementsIndirectCommand));
+    GLsizeiptr bufferSize = COUNT_READBACK_SLOTS * _countReadbackSlotSizeBytes;
+    _countReadbackBufferId = GenerateGlBuffer();
+    glBindBuffer(GL_COPY_WRITE_BUFFER, _countReadbackBufferId);
+    LabelGlObject(GL_BUFFER, _countReadbackBufferId, "particle count readback");
+    glBufferStorage(GL_COPY_WRITE_BUFFER, bufferSize, 0, storageFlags);
+    RecordBoundGlBufferAllocation(GL_COPY_WRITE_BUFFER, "particle count readback");
+    _mappedCountReadback = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, bufferSize, storageFlags);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    for (unsigned int slotIndex = 0; slotIndex < COUNT_READBACK_SLOTS; slotIndex++)
     {
-        return true;
+        _countReadbackFences[slotIndex].Reset();
     }
-    else
+    _countReadbackIndex = 0;
+    _latestLiveCount = 0;
+    _latestEmittedCount = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Checks the draw groups that were given to SetDrawGroups(...) against the emitters and 
+    builds each group's draw command.  A group covers its emitters' particles, which are 
+    consecutive in the pool, so its command's "first index" is its first particle, and its 
+    range of the live index buffer is the same as its range of the pool.  Anything that 
+    doesn't describe a valid set of groups falls back to a single group of every emitter, which
+    draws exactly like the single glDrawElementsIndirect(...) that this replaced.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::InitDrawGroups()
+{
+    bool groupsAreValid = !_drawGroupFirstEmitters.empty() && _drawGroupFirstEmitters[0] == 0;
+    for (size_t groupIndex = 1; groupsAreValid && groupIndex < _drawGroupFirstEmitters.size(); 
+        groupIndex++)
     {
-        return false;
+        groupsAreValid = 
+            _drawGroupFirstEmitters[groupIndex] > _drawGroupFirstEmitters[groupIndex - 1] &&
+            _drawGroupFirstEmitters[groupIndex] < _emitters.size();
+    }
+    if (_drawGroupFirstEmitters.size() > _drawGroupCapacity)
+    {
+        groupsAreValid = false;
+    }
+    if (!groupsAreValid)
+    {
+        if (_drawGroupFirstEmitters.size() > 1)
+        {
+            LogPrintf("draw groups must start at emitter 0, increase, and fit the capacity; "
+                "drawing as one group\n");
+        }
+        _drawGroupFirstEmitters.assign(1, 0);
     }
 
+    unsigned int numGroups = (unsigned int)_drawGroupFirstEmitters.size();
+    _drawGroupStyles.assign(numGroups, glm::vec2(1.0f, 1.0f));
+    _drawGroupLiveCounts.assign(numGroups, 0);
+    _drawGroupCulledSinceSec.assign(numGroups, -1.0);
+    _drawCommandResetData.clear();
+    for (unsigned int groupIndex = 0; groupIndex < numGroups; groupIndex++)
+    {
+        const ParticleEmitter &firstEmitter = _emitters[_drawGroupFirstEmitters[groupIndex]];
+        DrawElementsIndirectCommand command = { 0, 1, firstEmitter._firstParticle, 0, groupIndex };
+        const GLuint *commandWords = (const GLuint *)&command;
+        _drawCommandResetData.insert(_drawCommandResetData.end(), commandWords, 
+            commandWords + (sizeof(command) / sizeof(GLuint)));
+    }
 }
 
 /*-----------------------------------------------------------------------------------------------
 Description:
-    Sets the given particle's starting position and velocity.  Does NOT alter the "is active"
-    flag.  That flag is altered during Update(...).
-Parameters:
-    resetThis   Self-explanatory.
+    Looks up the render program's uniforms and the compute program's work group size.  Called 
+    by Init(...) and whenever a program is replaced.
+Parameters: None
 Returns:    None
 Exception:  Safe
-Creator:    John Cox (7-2-2016)
+Creator:    John Cox (8-15-2016)
 -----------------------------------------------------------------------------------------------*/
-void ParticleManager::ResetParticle(Particle *resetThis) const
+void ParticleManager::LoadProgramInterfaces()
 {
-    // Note: The hard-coded mod100 is just to prevent the random axis magnitudes from 
-    // getting too crazy different from each other.
-    float newX = (float)(RandomPosAndNeg() % 100);
-    float newY = (float)(RandomPosAndNeg() % 100);
-    glm::vec2 randomVector = glm::normalize(glm::vec2(newX, newY));
-    
-    // hard-coded region of radius 0.1f in window space
-    float radiusVariation = RandomOnRange0to1() * 0.1f; 
+    _unifLocExtrapolationSec = glGetUniformLocation(_programId, "uExtrapolationSec");
+    _unifLocPointSize = glGetUniformLocation(_programId, "uPointSize");
+    _unifLocParticleBrightness = glGetUniformLocation(_programId, "uParticleBrightness");
+    _unifLocParticleOpacity = glGetUniformLocation(_programId, "uParticleOpacity");
+    _unifLocViewportMask = glGetUniformLocation(_programId, "uViewportMask");
+    _unifLocColorMode = glGetUniformLocation(_programId, "uColorMode");
+    _unifLocPaletteMaxSpeed = glGetUniformLocation(_programId, "uPaletteMaxSpeed");
+    _unifLocFastPointSizeScale = glGetUniformLocation(_programId, "uFastPointSizeScale");
+    _unifLocSpeedPalette = glGetUniformLocation(_programId, "uSpeedPalette");
+
+    // only the vertex pulling build of shaderParticle.vert has any shader storage blocks
+    GLint renderStorageBlockCount = 0;
+    glGetProgramInterfaceiv(_programId, GL_SHADER_STORAGE_BLOCK, GL_ACTIVE_RESOURCES, 
+        &renderStorageBlockCount);
+    _isVertexPulling = (renderStorageBlockCount > 0);
+
+    // only the quad build has the particle index attribute
+    _isQuadRendering = (glGetAttribLocation(_programId, "quadParticleIndex") >= 0);
+    _unifLocQuadCornerCount = glGetUniformLocation(_programId, "uQuadCornerCount");
+    _unifLocViewportSize = glGetUniformLocation(_programId, "uViewportSize");
+
+    // only the flipbook build samples a texture array
+    _unifLocFlipbook = glGetUniformLocation(_programId, "uFlipbook");
+    _isFlipbookRendering = (_unifLocFlipbook != (unsigned int)-1);
+    _unifLocFlipbookFrameCount = glGetUniformLocation(_programId, "uFlipbookFrameCount");
+    _unifLocFlipbookCycles = glGetUniformLocation(_programId, "uFlipbookCycles");
+    _unifLocFlipbookFrameSize = glGetUniformLocation(_programId, "uFlipbookFrameSize");
+    _unifLocFlipbookMaxLod = glGetUniformLocation(_programId, "uFlipbookMaxLod");
+
+    // the CPU backend may not have a compute program at all, and a query on program 0 is an 
+    // error
+    if (_computeProgramId == 0)
+    {
+        _unifLocFieldTexture = -1;
+        _unifLocFieldTextureMin = -1;
+        _unifLocFieldTextureInverseSize = -1;
+        _unifLocFieldTextureMode = -1;
+        _unifLocFieldTextureResponse = -1;
+        _unifLocFieldTextureScale = -1;
+        _unifLocSdfBoundaryTexture = -1;
+        _unifLocSdfBoundaryMin = -1;
+        _unifLocSdfBoundaryInverseSize = -1;
+        _unifLocSdfBoundaryTexelSize = -1;
+        _unifLocSdfBoundaryMode = -1;
+        _unifLocSdfBoundaryRestitution = -1;
+        _unifLocSdfBoundaryScale = -1;
+        _unifLocSegmentBvhSegmentCount = -1;
+        _unifLocSegmentBvhMode = -1;
+        _unifLocSegmentBvhRestitution = -1;
+        _unifLocEmissionImagePixelCount = -1;
+        _unifLocEmissionImageWidth = -1;
+        _unifLocEmissionImageMin = -1;
+        _unifLocEmissionImageTexelSize = -1;
+        _unifLocEmitterPathCount = -1;
+        _unifLocEmitterSliceCount = -1;
+        _unifLocSubEmitterCount = -1;
+        _unifLocSubEmitterMaxChildren = -1;
+        _unifLocMaxDeathEvents = -1;
+        _unifLocSleepSpeedSqr = -1;
+        _unifLocSleepRestUpdates = -1;
+        _unifLocDrawGroupCulled = -1;
+        _unifLocUpdateAmortization = -1;
+        _unifLocAmortizationPhase = -1;
+        _unifLocFusedEmitMode = -1;
+        _hasPersistentKernel = false;
+        _hasBurstKernel = false;
+        _hasInjectionKernel = false;
+        _workGroupSizeX = DEFAULT_WORK_GROUP_SIZE;
+        return;
+    }
+
+    // only a FIELD_TEXTURE build of the compute program has these (see ParticleKernelVariant)
+    _unifLocFieldTexture = glGetUniformLocation(_computeProgramId, "uFieldTexture");
+    _unifLocFieldTextureMin = glGetUniformLocation(_computeProgramId, "uFieldTextureMin");
+    _unifLocFieldTextureInverseSize = glGetUniformLocation(_computeProgramId, 
+        "uFieldTextureInverseSize");
+    _unifLocFieldTextureMode = glGetUniformLocation(_computeProgramId, "uFieldTextureMode");
+    _unifLocFieldTextureResponse = glGetUniformLocation(_computeProgramId, 
+        "uFieldTextureResponse");
+    _unifLocFieldTextureScale = glGetUniformLocation(_computeProgramId, "uFieldTextureScale");
+
+    // likewise for SDF_BOUNDARY
+    _unifLocSdfBoundaryTexture = glGetUniformLocation(_computeProgramId, "uSdfBoundary");
+    _unifLocSdfBoundaryMin = glGetUniformLocation(_computeProgramId, "uSdfBoundaryMin");
+    _unifLocSdfBoundaryInverseSize = glGetUniformLocation(_computeProgramId, 
+        "uSdfBoundaryInverseSize");
+    _unifLocSdfBoundaryTexelSize = glGetUniformLocation(_computeProgramId, 
+        "uSdfBoundaryTexelSize");
+    _unifLocSdfBoundaryMode = glGetUniformLocation(_computeProgramId, "uSdfBoundaryMode");
+    _unifLocSdfBoundaryRestitution = glGetUniformLocation(_computeProgramId, 
+        "uSdfBoundaryRestitution");
+    _unifLocSdfBoundaryScale = glGetUniformLocation(_computeProgramId, "uSdfBoundaryScale");
 
-    resetThis->_position = glm::vec4(_center + (randomVector * radiusVariation), 0.0f, 0.0f);
-    resetThis->_velocity = glm::vec4(this->GetNewVelocityVector(), 0.0f, 0.0f);
+    // and for SEGMENT_BVH
+    _unifLocSegmentBvhSegmentCount = glGetUniformLocation(_computeProgramId, 
+        "uSegmentBvhSegmentCount");
+    _unifLocSegmentBvhMode = glGetUniformLocation(_computeProgramId, "uSegmentBvhMode");
+    _unifLocSegmentBvhRestitution = glGetUniformLocation(_computeProgramId, 
+        "uSegmentBvhRestitution");
+
+    // and for EMISSION_IMAGE
+    _unifLocEmissionImagePixelCount = glGetUniformLocation(_computeProgramId, 
+        "uEmissionImagePixelCount");
+    _unifLocEmissionImageWidth = glGetUniformLocation(_computeProgramId, 
+        "uEmissionImageWidth");
+    _unifLocEmissionImageMin = glGetUniformLocation(_computeProgramId, "uEmissionImageMin");
+    _unifLocEmissionImageTexelSize = glGetUniformLocation(_computeProgramId, 
+        "uEmissionImageTexelSize");
+
+    // and for EMITTER_PATHS
+    _unifLocEmitterPathCount = glGetUniformLocation(_computeProgramId, "uEmitterPathCount");
+
+    // and for EMITTER_TIME_SLICING
+    _unifLocEmitterSliceCount = glGetUniformLocation(_computeProgramId, "uEmitterSliceCount");
+
+    // and for SUB_EMITTERS
+    _unifLocSubEmitterCount = glGetUniformLocation(_computeProgramId, "uSubEmitterCount");
+    _unifLocSubEmitterMaxChildren = glGetUniformLocation(_computeProgramId, 
+        "uSubEmitterMaxChildren");
+    _unifLocMaxDeathEvents = glGetUniformLocation(_computeProgramId, "uMaxDeathEvents");
+
+    // and for PARTICLE_SLEEP
+    _unifLocSleepSpeedSqr = glGetUniformLocation(_computeProgramId, "uSleepSpeedSqr");
+    _unifLocSleepRestUpdates = glGetUniformLocation(_computeProgramId, "uSleepRestUpdates");
+
+    // and for DRAW_GROUP_CULLING
+    _unifLocDrawGroupCulled = glGetUniformLocation(_computeProgramId, "uIsDrawGroupCulled");
+
+    // and for the update's amortization
+    _unifLocUpdateAmortization = glGetUniformLocation(_computeProgramId, "uUpdateAmortization");
+    _unifLocAmortizationPhase = glGetUniformLocation(_computeProgramId, "uAmortizationPhase");
+
+    // and the FUSED_EMIT_UPDATE build can emit in the update
+    _unifLocFusedEmitMode = glGetUniformLocation(_computeProgramId, "uFusedEmitMode");
+
+    // and the PERSISTENT_THREADS build has the queue
+    _hasPersistentKernel = (glGetProgramResourceIndex(_computeProgramId, 
+        GL_SHADER_STORAGE_BLOCK, "PersistentQueueBuffer") != GL_INVALID_INDEX);
+
+    // and the PARTICLE_BURSTS build has the burst queue
+    _hasBurstKernel = (glGetProgramResourceIndex(_computeProgramId, 
+        GL_SHADER_STORAGE_BLOCK, "BurstQueueBuffer") != GL_INVALID_INDEX);
+
+    // and the PARTICLE_INJECTION build has the injection ring's slot
+    _hasInjectionKernel = (glGetProgramResourceIndex(_computeProgramId, 
+        GL_SHADER_STORAGE_BLOCK, "InjectionSlotBuffer") != GL_INVALID_INDEX);
+
+    // the work group size was chosen when the compute shader was generated (see 
+    // GetComputeShaderDefines(...)), and the dispatch must use the same one
+    // Note: This version of glload calls GL_COMPUTE_WORK_GROUP_SIZE by its old name, 
+    // GL_COMPUTE_LOCAL_WORK_SIZE (same value), just like GL_MAX_COMPUTE_LOCAL_INVOCATIONS in 
+    // ComputeDeviceCaps.cpp.
+    GLint programWorkGroupSize[3] = { 0, 0, 0 };
+    glGetProgramiv(_computeProgramId, GL_COMPUTE_LOCAL_WORK_SIZE, programWorkGroupSize);
+    _workGroupSizeX = (programWorkGroupSize[0] > 0) ? 
+        programWorkGroupSize[0] : DEFAULT_WORK_GROUP_SIZE;
 }
 
 /*-----------------------------------------------------------------------------------------------
 Description:
-    Generates a new velocity vector between the previously provided minimum and maximum values 
-    and in the provided direction.
+    Turns the VAO's particle attributes (position, velocity, and "is active") off for a vertex 
+    pulling render program and on for the other one.  A disabled attribute isn't fetched at 
+    all, but it keeps its buffer, offset, and stride, so Resize(...) can still re-point it and 
+    a later program can turn it back on.  The live index buffer is needed either way.  Only 
+    the attributes that the layout has are turned on (none, for the fixed-point layout), since 
+    an attribute without a buffer can't be drawn from.
+
+    A quad render program also swaps the draw group style attribute for the particle index 
+    attribute (see RenderQuads()).
+
+    Note: The VAO must be bound prior to calling this.
 Parameters: None
-Returns:    
-    A 2D vector whose magnitude is between the initialized "min" and "max" values and whose
-    direction is random.
+Returns:    None
 Exception:  Safe
-Creator:    John Cox (7-2-2016)
+Creator:    John Cox (8-15-2016)
 -----------------------------------------------------------------------------------------------*/
-glm::vec2 ParticleManager::GetNewVelocityVector() const
+void ParticleManager::ApplyVertexPulling()
 {
-    // this demo particle "manager" emits in a circle, so get a random 2D direction
-    // Note: The hard-coded mod100 is just to prevent the random axis magnitudes from 
-    // getting too crazy different from each other.
-    float newX = (float)(RandomPosAndNeg() % 100);
-    float newY = (float)(RandomPosAndNeg() % 100);
-    glm::vec2 randomVelocityVector = glm::normalize(glm::vec2(newX, newY));
-    
-    // randomize between the min and max velocities to get a little variation
-    float velocityVariation = RandomOnRange0to1() * _velocityDelta;
-    float velocityMagnitude = _velocityMin + velocityVariation;
+    const ParticleLayoutDescriptor &layoutDescriptor = GetParticleLayoutDescriptor(_layout);
+    for (unsigned int fieldIndex = 0; fieldIndex < layoutDescriptor._fieldCount; fieldIndex++)
+    {
+        int attributeIndex = layoutDescriptor._fields[fieldIndex]._attributeIndex;
+        if (attributeIndex < 0)
+        {
+            continue;
+        }
+        if (_isVertexPulling)
+        {
+            glDisableVertexAttribArray(attributeIndex);
+        }
+        else
+        {
+            glEnableVertexAttribArray(attributeIndex);
+        }
+    }
 
-    return randomVelocityVector * velocityMagnitude;
+    if (_isQuadRendering)
+    {
+        glDisableVertexAttribArray(DRAW_GROUP_STYLE_ATTRIBUTE);
+        glEnableVertexAttribArray(QUAD_PARTICLE_INDEX_ATTRIBUTE);
+    }
+    else
+    {
+        glEnableVertexAttribArray(DRAW_GROUP_STYLE_ATTRIBUTE);
+        glDisableVertexAttribArray(QUAD_PARTICLE_INDEX_ATTRIBUTE);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Creates the data store for the particle buffer that is currently bound to 
+    GL_SHADER_STORAGE_BUFFER according to the access mode (see SetParticleBufferAccess(...)).
+
+    The compute shader rewrites the particles every frame and, by default, the CPU never looks 
+    at them again, so the default is immutable storage (glBufferStorage(...)) with no access 
+    flags at all.  That tells the driver that the buffer will only ever be touched by the GPU, 
+    which lets it put the buffer in the fastest memory, and that the size never changes, which 
+    lets it skip the reallocation checks when the buffer is bound.
+    
+    If CPU readback is requested, the storage is instead readable and persistently, coherently 
+    mapped for the life of the buffer, and the pointer is kept in _mappedParticleBuffers.
+
+    The old mutable storage (glBufferData(...)) is kept around for A/B comparisons.  Its usage 
+    hint used to be GL_STATIC_DRAW, which was wrong both ways: the data is not static and it is
+    not drawn from CPU data.  GL_DYNAMIC_COPY (GPU writes, GPU reads) is the honest hint.
+
+    Whatever the access mode, the storage is created empty and then zeroed on the GPU with 
+    glClearBufferSubData(...), which every kind of storage allows.  Every particle starts out 
+    inactive and zeroed, so there is no initial data to upload and no CPU-side array to build 
+    it in.
+Parameters:
+    bufferIndex     Index into _particleBufferIds.  Only used for the mapped pointer.
+    sizeBytes       Self-explanatory.  A multiple of 4.
+    firstZeroedByte Everything from here to the end is zeroed.  Resize(...) copies the kept 
+                    particles over the start, so it only needs the tail zeroed.  A multiple
+                    of 4.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-12-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::AllocateParticleBuffer(unsigned int bufferIndex, size_t sizeBytes, 
+    size_t firstZeroedByte)
+{
+    // the buffers are registered as a set, and they are registered again on the next update
+    if (_interop != 0)
+    {
+        _interop->UnregisterBuffers();
+    }
+    _mappedParticleBuffers[bufferIndex] = 0;
+    if (_bufferAccess == PARTICLE_BUFFER_ACCESS_MUTABLE)
+    {
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeBytes, 0, GL_DYNAMIC_COPY);
+    }
+    else if (_bufferAccess == PARTICLE_BUFFER_ACCESS_CPU_READBACK)
+    {
+        GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeBytes, 0, flags);
+        _mappedParticleBuffers[bufferIndex] = 
+            glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, sizeBytes, flags);
+    }
+    else if (_bufferAccess == PARTICLE_BUFFER_ACCESS_SPARSE)
+    {
+        // only the address range, rounded up to whole pages, and then only the pages that the 
+        // emitters cover get memory, which they are zeroed with
+        // Note: Resize(...) copies the kept particles over the start afterwards, and the 
+        // copies to the pages that no emitter covers are dropped, which is fine because 
+        // nothing there was alive.
+        size_t pageCount = (sizeBytes + _sparsePageSizeBytes - 1) / _sparsePageSizeBytes;
+        glBufferStorage(GL_SHADER_STORAGE_BUFFER, pageCount * _sparsePageSizeBytes, 0, 
+            SPARSE_STORAGE_BIT_ARB);
+        GLint bufferId = 0;
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_BINDING, &bufferId);
+        RecordGpuAllocation(GPU_MEMORY_BUFFER, (unsigned int)bufferId, 0, "particles");
+        _committedParticlePages[bufferIndex].assign(pageCount, 0);
+        size_t stride = this->GetParticleBufferStride(bufferIndex);
+        for (size_t emitterIndex = 0; emitterIndex < _emitters.size(); emitterIndex++)
+        {
+            const ParticleEmitter &emitter = _emitters[emitterIndex];
+            this->CommitParticleBufferPages(bufferIndex, (unsigned int)bufferId, 
+                emitter._firstParticle * stride, 
+                (emitter._firstParticle + emitter._particleCount) * stride);
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, bufferId);
+        return;
+    }
+    else
+    {
+        glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeBytes, 0, 0);
+    }
+    RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particles");
+
+    // the sizes of every layout's items are multiples of 4 bytes
+    if (firstZeroedByte < sizeBytes)
+    {
+        GLuint zero = 0;
+        glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, firstZeroedByte, 
+            sizeBytes - firstZeroedByte, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives memory to the pages of a sparse particle buffer (see PARTICLE_BUFFER_ACCESS_SPARSE) 
+    that a range of it touches and that don't have any yet, and zeroes them, since a zeroed 
+    particle is an inactive one.  Runs of pages are committed with one call.  Leaves the 
+    buffer bound to GL_SHADER_STORAGE_BUFFER.
+Parameters:
+    bufferIndex     Index into _committedParticlePages.
+    bufferId        The buffer itself, which is not in _particleBufferIds yet while Resize(...)
+                    makes it.
+    firstByte       Self-explanatory.
+    endByte         One past the last byte.  Clamped to the buffer.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::CommitParticleBufferPages(unsigned int bufferIndex, unsigned int bufferId,
+    size_t firstByte, size_t endByte)
+{
+    std::vector<unsigned char> &committedPages = _committedParticlePages[bufferIndex];
+    if (_sparsePageSizeBytes == 0 || firstByte >= endByte)
+    {
+        return;
+    }
+    size_t firstPage = firstByte / _sparsePageSizeBytes;
+    size_t endPage = (endByte + _sparsePageSizeBytes - 1) / _sparsePageSizeBytes;
+    if (endPage > committedPages.size())
+    {
+        endPage = committedPages.size();
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, bufferId);
+    GLuint zero = 0;
+    bool isChanged = false;
+    size_t pageIndex = firstPage;
+    while (pageIndex < endPage)
+    {
+        if (committedPages[pageIndex] != 0)
+        {
+            pageIndex++;
+            continue;
+        }
+        size_t runEnd = pageIndex;
+        while (runEnd < endPage && committedPages[runEnd] == 0)
+        {
+            committedPages[runEnd] = 1;
+            runEnd++;
+        }
+        GLintptr runOffset = (GLintptr)(pageIndex * _sparsePageSizeBytes);
+        GLsizeiptr runBytes = (GLsizeiptr)((runEnd - pageIndex) * _sparsePageSizeBytes);
+        gBufferPageCommitmentArb(GL_SHADER_STORAGE_BUFFER, runOffset, runBytes, GL_TRUE);
+        glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, runOffset, runBytes, 
+            GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        isChanged = true;
+        pageIndex = runEnd;
+    }
+
+    // the ledger has the memory that is committed, not the address range
+    if (isChanged)
+    {
+        size_t committedCount = 0;
+        for (size_t page = 0; page < committedPages.size(); page++)
+        {
+            committedCount += committedPages[page];
+        }
+        RecordGpuAllocation(GPU_MEMORY_BUFFER, bufferId, 
+            (unsigned long long)committedCount * _sparsePageSizeBytes, "particles");
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Makes sure that every particle buffer has memory behind a range of particles (see 
+    CommitParticleBufferPages(...)).  Does nothing unless the buffers are sparse.
+Parameters:
+    firstParticle   Self-explanatory.
+    particleCount   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::CommitParticlePages(unsigned int firstParticle, unsigned int particleCount)
+{
+    if (_sparsePageSizeBytes == 0)
+    {
+        return;
+    }
+    for (unsigned int bufferIndex = 0; bufferIndex < _particleBufferCount; bufferIndex++)
+    {
+        size_t stride = this->GetParticleBufferStride(bufferIndex);
+        this->CommitParticleBufferPages(bufferIndex, _particleBufferIds[bufferIndex], 
+            firstParticle * stride, ((size_t)firstParticle + particleCount) * stride);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Fits the memory of sparse particle buffers to the emitters' ranges, as they are after a 
+    resize or a new emitter table: the pages that they cover are committed (see 
+    CommitParticlePages(...)) and the pages that none of them cover are given back.  Does 
+    nothing unless the buffers are sparse.
+
+    Note: The pages that are given back only ever had inactive particles, or particles that 
+    were moved out of them (see MoveParticleRange(...)).  Nothing reads a particle there 
+    without first finding it in the active mask, except for the passes that rebuild the mask 
+    and the dead stacks.  The extension leaves what they read there undefined, and the 
+    drivers that have it read zeros, which are inactive particles.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::UpdateParticlePageCommitment()
+{
+    if (_sparsePageSizeBytes == 0)
+    {
+        return;
+    }
+    for (size_t emitterIndex = 0; emitterIndex < _emitters.size(); emitterIndex++)
+    {
+        this->CommitParticlePages(_emitters[emitterIndex]._firstParticle, 
+            _emitters[emitterIndex]._particleCount);
+    }
+
+    for (unsigned int bufferIndex = 0; bufferIndex < _particleBufferCount; bufferIndex++)
+    {
+        std::vector<unsigned char> &committedPages = _committedParticlePages[bufferIndex];
+        std::vector<unsigned char> isPageUsed(committedPages.size(), 0);
+        size_t stride = this->GetParticleBufferStride(bufferIndex);
+        for (size_t emitterIndex = 0; emitterIndex < _emitters.size(); emitterIndex++)
+        {
+            const ParticleEmitter &emitter = _emitters[emitterIndex];
+            if (emitter._particleCount == 0)
+            {
+                continue;
+            }
+            size_t firstPage = (emitter._firstParticle * stride) / _sparsePageSizeBytes;
+            size_t endPage = (((size_t)emitter._firstParticle + emitter._particleCount) * 
+                stride + _sparsePageSizeBytes - 1) / _sparsePageSizeBytes;
+            for (size_t page = firstPage; page < endPage && page < isPageUsed.size(); page++)
+            {
+                isPageUsed[page] = 1;
+            }
+        }
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, _particleBufferIds[bufferIndex]);
+        size_t committedCount = 0;
+        for (size_t page = 0; page < committedPages.size(); page++)
+        {
+            if (committedPages[page] != 0 && isPageUsed[page] == 0)
+            {
+                gBufferPageCommitmentArb(GL_SHADER_STORAGE_BUFFER, 
+                    (GLintptr)(page * _sparsePageSizeBytes), (GLsizeiptr)_sparsePageSizeBytes, 
+                    GL_FALSE);
+                committedPages[page] = 0;
+            }
+            committedCount += committedPages[page];
+        }
+        RecordGpuAllocation(GPU_MEMORY_BUFFER, _particleBufferIds[bufferIndex], 
+            (unsigned long long)committedCount * _sparsePageSizeBytes, "particles");
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Creates the zeroed shader storage buffers of the current layout, binds each one to its own 
+    shader storage binding point (0, 1, 2, in order), and describes the particles to the 
+    currently bound VAO.  Everything about the layout comes from its descriptor (see 
+    Particle.h), so a new layout only needs a new field list.
+
+    Using "shader storage buffers" because, unlike the vertex array buffer, the same buffer 
+    can be used for both the compute shader and the vertex shader.  The interleaved layout is 
+    one buffer of "Particle" structures, the half float layout is one buffer of 12-byte 
+    "PackedHalfParticle" structures, the fixed-point layout is one buffer of 8-byte 
+    "PackedFixedParticle" structures, and the structure of arrays layout is one buffer each of 
+    positions, velocities, and flags (20 bytes per particle instead of 24), so that each shader 
+    stage only pulls in the arrays that it reads.
+
+    A zeroed particle is an inactive one in every layout (a half float +0 is all zero bits, 
+    and so is a fixed-point 0), so the GPU clear works for all of them.
+
+    Note: The VAO and the drawing program must be bound prior to calling this.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-3-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::InitParticleBuffers()
+{
+    static_assert(GetParticleBufferCount(PARTICLE_SOA_LAYOUT) <= MAX_PARTICLE_BUFFERS, 
+        "Every layout's buffers must fit in _particleBufferIds");
+    const ParticleLayoutDescriptor &layoutDescriptor = GetParticleLayoutDescriptor(_layout);
+    _particleBufferCount = GetParticleBufferCount(layoutDescriptor);
+
+    GLuint bufferIds[MAX_PARTICLE_BUFFERS] = { 0 };
+    for (unsigned int bufferIndex = 0; bufferIndex < _particleBufferCount; bufferIndex++)
+    {
+        _particleBufferIds[bufferIndex] = GenerateGlBuffer();
+        bufferIds[bufferIndex] = _particleBufferIds[bufferIndex];
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, bufferIds[bufferIndex]);
+        LabelGlObject(GL_BUFFER, bufferIds[bufferIndex], "particles");
+        this->AllocateParticleBuffer(bufferIndex, 
+            (size_t)_maxParticleCount * this->GetParticleBufferStride(bufferIndex));
+        BindGlShaderStorageBuffer(bufferIndex, bufferIds[bufferIndex]);
+    }
+
+    // position is attribute 0, velocity is attribute 1, and the "is active" flag is 
+    // attribute 2 in every layout that has attributes, so the vertex shader doesn't need to 
+    // know the difference
+    // Note: The fixed-point layout has none, so it is only drawn by vertex pulling.
+    DescribeParticleAttributes(layoutDescriptor, bufferIds);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Selects the layout in shaderParticle.comp and shaderParticle.vert.  The interleaved layout 
+    is the shaders' default, so it has no define of its own.
+
+    The shaders' particle structures are generated from the layout descriptors (see 
+    GetGlslMembersDefine(...)).  The compute shader always works on a "Particle", whatever the 
+    storage, so its members always go in, along with the storage structure's members if the 
+    layout has a different one.
+Parameters:
+    layout  Self-explanatory.
+Returns:
+    The "#define" lines.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+static std::string GetLayoutShaderDefines(ParticleLayout layout)
+{
+    std::string defines = GetGlslMembersDefine(PARTICLE_INTERLEAVED_LAYOUT);
+    switch (layout)
+    {
+    case PARTICLE_LAYOUT_SOA: 
+        defines += "#define PARTICLE_LAYOUT_SOA\n";
+        break;
+    case PARTICLE_LAYOUT_HALF_FLOAT: 
+        defines += "#define PARTICLE_LAYOUT_HALF_FLOAT\n";
+        defines += GetGlslMembersDefine(PARTICLE_HALF_FLOAT_LAYOUT);
+        break;
+    case PARTICLE_LAYOUT_FIXED_POINT: 
+        defines += "#define PARTICLE_LAYOUT_FIXED_POINT\n";
+        defines += GetGlslMembersDefine(PARTICLE_FIXED_POINT_LAYOUT);
+        break;
+    default:
+        break;
+    }
+    return defines;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The compute shader reads and writes particles in whatever layout it was compiled for, so it 
+    has to be generated with the "#define" statements that match the layout that this manager 
+    is initialized with.  The work group size is also chosen here (see WorkGroupTuner.h).
+Parameters:
+    layout      The layout that will be given to Init(...).
+    workGroupSize   The compute shader's "local_size_x".  Must be within the device's limits.
+Returns:
+    A string of "#define" statements for AcquireComputeProgram(...).
+Exception:  Safe
+Creator:    John Cox (8-3-2016)
+-----------------------------------------------------------------------------------------------*/
+std::string ParticleManager::GetComputeShaderDefines(ParticleLayout layout, 
+    unsigned int workGroupSize)
+{
+    return GetComputeShaderDefines(layout, workGroupSize, GetDefaultKernelVariant());
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Same as the other GetComputeShaderDefines(...), plus whatever the variant bakes into the 
+    program (see ParticleKernelVariant).  Nothing is added for the parts of the variant that 
+    are left at their defaults, so the default variant gives exactly the same program (and 
+    cache entry) as the other overload.
+Parameters:
+    layout          The layout that will be given to Init(...).
+    workGroupSize   The compute shader's "local_size_x".  Must be within the device's limits.
+    variant         Self-explanatory.
+Returns:
+    A string of "#define" statements for AcquireComputeProgram(...).
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+std::string ParticleManager::GetComputeShaderDefines(ParticleLayout layout, 
+    unsigned int workGroupSize, const ParticleKernelVariant &variant)
+{
+    std::string defines = GetLayoutShaderDefines(layout);
+    defines += "#define WORK_GROUP_SIZE_X " + std::to_string(workGroupSize) + "\n";
+
+    if (variant._hasFixedEmitter)
+    {
+        // exponent notation with every digit so that each value is a float literal with all of
+        // its bits
+        const ParticleEmitter &emitter = variant._fixedEmitter;
+        std::ostringstream fixedEmitterDefines;
+        fixedEmitterDefines << std::scientific << std::setprecision(9);
+        fixedEmitterDefines << "#define FIXED_EMITTER\n";
+        fixedEmitterDefines << "#define FIXED_EMITTER_CENTER_X " << emitter._center.x << "\n";
+        fixedEmitterDefines << "#define FIXED_EMITTER_CENTER_Y " << emitter._center.y << "\n";
+        fixedEmitterDefines << "#define FIXED_EMITTER_RADIUS " << emitter._radius << "\n";
+        fixedEmitterDefines << "#define FIXED_EMITTER_VELOCITY_MIN " << emitter._velocityMin << 
+            "\n";
+        fixedEmitterDefines << "#define FIXED_EMITTER_VELOCITY_MAX " << emitter._velocityMax << 
+            "\n";
+        defines += fixedEmitterDefines.str();
+    }
+    if (variant._hasSingleDrawGroup)
+    {
+        defines += "#define SINGLE_DRAW_GROUP\n";
+    }
+    if (!variant._respawnParticles)
+    {
+        defines += "#define NO_RESPAWN\n";
+    }
+    if (variant._hasUnrolledForceFields)
+    {
+        defines += "#define UNROLLED_FORCE_FIELD_COUNT " + 
+            std::to_string(variant._unrolledForceFieldCount) + "\n";
+    }
+    if (variant._hasFieldTexture)
+    {
+        defines += "#define FIELD_TEXTURE\n";
+    }
+    if (variant._integrator == PARTICLE_INTEGRATOR_EXPLICIT_EULER)
+    {
+        defines += "#define INTEGRATOR_EXPLICIT_EULER\n";
+    }
+    else if (variant._integrator == PARTICLE_INTEGRATOR_VELOCITY_VERLET)
+    {
+        defines += "#define INTEGRATOR_VELOCITY_VERLET\n";
+    }
+    if (variant._hasSdfBoundary)
+    {
+        defines += "#define SDF_BOUNDARY\n";
+    }
+    if (variant._hasSegmentBvh)
+    {
+        defines += "#define SEGMENT_BVH\n";
+    }
+    if (variant._hasEmissionImage)
+    {
+        defines += "#define EMISSION_IMAGE\n";
+    }
+    if (variant._hasEmitterPaths)
+    {
+        defines += "#define EMITTER_PATHS\n";
+    }
+    if (variant._hasEmitterTimeSlicing)
+    {
+        defines += "#define EMITTER_TIME_SLICING\n";
+    }
+    if (variant._hasPointerInput)
+    {
+        defines += "#define POINTER_INPUT\n";
+    }
+    if (variant._hasBursts)
+    {
+        defines += "#define PARTICLE_BURSTS\n";
+    }
+    if (variant._hasSubEmitters)
+    {
+        defines += "#define SUB_EMITTERS\n";
+    }
+    if (variant._hasInjection)
+    {
+        defines += "#define PARTICLE_INJECTION\n";
+    }
+    if (variant._hasDrawGroupCulling)
+    {
+        defines += "#define DRAW_GROUP_CULLING\n";
+    }
+    if (variant._hasSleep)
+    {
+        defines += "#define PARTICLE_SLEEP\n";
+    }
+    if (variant._hasCostAttribution)
+    {
+        defines += "#define PARTICLE_COST_ATTRIBUTION\n";
+    }
+    if (variant._hasLowDiscrepancyEmission)
+    {
+        defines += "#define LOW_DISCREPANCY_EMISSION\n";
+    }
+    if (variant._hasPersistentThreads)
+    {
+        defines += "#define PERSISTENT_THREADS\n";
+    }
+    if (variant._hasFusedEmitUpdate && variant._respawnParticles)
+    {
+        defines += "#define FUSED_EMIT_UPDATE\n";
+    }
+    if (!variant._customUpdateFilePath.empty())
+    {
+        defines += "#define CUSTOM_UPDATE \"" + variant._customUpdateFilePath + "\"\n";
+    }
+    switch (variant._atomicAggregation)
+    {
+    case PARTICLE_ATOMICS_WORK_GROUP: defines += "#define ATOMICS_WORK_GROUP\n"; break;
+    case PARTICLE_ATOMICS_KHR_SUBGROUP: defines += "#define ATOMICS_KHR_SUBGROUP\n"; break;
+    case PARTICLE_ATOMICS_NV_THREAD_GROUP: defines += "#define ATOMICS_NV_THREAD_GROUP\n"; break;
+    case PARTICLE_ATOMICS_AMD_BALLOT: defines += "#define ATOMICS_AMD_BALLOT\n"; break;
+    default:
+        break;
+    }
+    return defines;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    A variant that bakes nothing into the program: any number of emitters, draw groups, and 
+    force fields, all read from their buffers, particles respawn, and every particle makes its 
+    own atomics.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleKernelVariant ParticleManager::GetDefaultKernelVariant()
+{
+    ParticleKernelVariant variant;
+    variant._hasFixedEmitter = false;
+    variant._fixedEmitter._center = glm::vec2(0.0f, 0.0f);
+    variant._fixedEmitter._radius = 0.0f;
+    variant._fixedEmitter._velocityMin = 0.0f;
+    variant._fixedEmitter._velocityMax = 0.0f;
+    variant._fixedEmitter._maxParticlesEmittedPerFrame = 0;
+    variant._fixedEmitter._particleCount = 0;
+    variant._fixedEmitter._firstParticle = 0;
+    variant._fixedEmitter._lifetimeSec = 0.0f;
+    variant._fixedEmitter._spawnShape = PARTICLE_SPAWN_DISK;
+    variant._hasSingleDrawGroup = false;
+    variant._respawnParticles = true;
+    variant._atomicAggregation = PARTICLE_ATOMICS_PER_ITEM;
+    variant._hasUnrolledForceFields = false;
+    variant._unrolledForceFieldCount = 0;
+    variant._hasFieldTexture = false;
+    variant._integrator = PARTICLE_INTEGRATOR_SEMI_IMPLICIT_EULER;
+    variant._hasSdfBoundary = false;
+    variant._hasSegmentBvh = false;
+    variant._hasEmissionImage = false;
+    variant._hasEmitterPaths = false;
+    variant._hasEmitterTimeSlicing = false;
+    variant._hasPointerInput = false;
+    variant._hasBursts = false;
+    variant._hasSubEmitters = false;
+    variant._hasInjection = false;
+    variant._hasDrawGroupCulling = false;
+    variant._hasSleep = false;
+    variant._hasCostAttribution = false;
+    variant._hasLowDiscrepancyEmission = false;
+    variant._hasPersistentThreads = false;
+    variant._hasFusedEmitUpdate = false;
+    variant._customUpdateFilePath.clear();
+    return variant;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Checks for the extensions that each subgroup flavor of ParticleAtomicAggregation is 
+    written against.  Needs a current context.
+Parameters:
+    aggregation     Self-explanatory.
+Returns:
+    True if a compute program with that aggregation will build on this device, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleManager::IsAtomicAggregationSupported(ParticleAtomicAggregation aggregation)
+{
+    switch (aggregation)
+    {
+    case PARTICLE_ATOMICS_PER_ITEM:
+    case PARTICLE_ATOMICS_WORK_GROUP:
+        return true;
+    case PARTICLE_ATOMICS_KHR_SUBGROUP:
+        return IsKhrSubgroupSupported(KHR_SUBGROUP_FEATURE_BASIC | 
+            KHR_SUBGROUP_FEATURE_BALLOT | KHR_SUBGROUP_FEATURE_SHUFFLE);
+    case PARTICLE_ATOMICS_NV_THREAD_GROUP:
+        return IsGlExtensionSupported("GL_NV_shader_thread_group") &&
+            IsGlExtensionSupported("GL_NV_shader_thread_shuffle");
+    case PARTICLE_ATOMICS_AMD_BALLOT:
+        return IsGlExtensionSupported("GL_AMD_shader_ballot") &&
+            IsGlExtensionSupported("GL_ARB_shader_ballot") &&
+            IsGlExtensionSupported("GL_ARB_gpu_shader_int64");
+    default:
+        return false;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The cross-vendor subgroup extension if the driver has it, then the vendors' own, and 
+    shared memory if none of them are there.  Needs a current context.
+Parameters: None
+Returns:
+    The aggregation to put in a ParticleKernelVariant.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleAtomicAggregation ParticleManager::GetBestAtomicAggregation()
+{
+    const ParticleAtomicAggregation preferredOrder[] =
+    {
+        PARTICLE_ATOMICS_KHR_SUBGROUP,
+        PARTICLE_ATOMICS_NV_THREAD_GROUP,
+        PARTICLE_ATOMICS_AMD_BALLOT,
+    };
+    unsigned int numPreferred = sizeof(preferredOrder) / sizeof(preferredOrder[0]);
+    for (unsigned int preferredIndex = 0; preferredIndex < numPreferred; preferredIndex++)
+    {
+        if (IsAtomicAggregationSupported(preferredOrder[preferredIndex]))
+        {
+            return preferredOrder[preferredIndex];
+        }
+    }
+    return PARTICLE_ATOMICS_WORK_GROUP;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The defines for a render program that pulls the particles out of the shader storage 
+    buffers with gl_VertexID instead of taking them as vertex attributes (see 
+    PARTICLE_VERTEX_PULLING in shaderParticle.vert).  The indexed draw already turns the live 
+    indices into gl_VertexID, so nothing else about the draw changes, and a new particle 
+    layout only needs a new load function in the shaders instead of new VAO code.
+
+    Note: The program must not be shared with anything that draws with its own VAO (ex: the 
+    frame graph), because it ignores the particle attributes.
+
+    Also Note: The fixed-point layout has no vertex attributes (see PackedFixedParticle in 
+    Particle.h), so it can only be drawn by a program built with these.
+Parameters:
+    layout  The layout that will be given to Init(...).
+Returns:
+    A string of "#define" statements for AcquireRenderProgram(...).
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+std::string ParticleManager::GetRenderShaderDefines(ParticleLayout layout)
+{
+    return "#define PARTICLE_VERTEX_PULLING\n" + GetLayoutShaderDefines(layout);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The defines for a vertex pulling render program (see GetRenderShaderDefines(...)) that 
+    draws each particle as an instance of a shared quad instead of as a point sprite (see 
+    PARTICLE_QUADS in shaderParticle.vert).  Point sprites are clamped to GL_POINT_SIZE_RANGE 
+    and are always square, so large particles are either capped or spend most of their 
+    fragments on corners that the fragment shader throws away.  A quad has no size limit, and 
+    SetQuadShape(...) can trade it for an octagon that fits the particle more tightly.
+
+    The program must be built with shaderParticleQuad.frag, which gives the particle its round
+    shape.
+
+    Where GL_ARB_shader_draw_parameters is supported, each corner takes its draw group's style 
+    by gl_DrawIDARB, which is the group's command in RenderQuads()'s multi-draw, instead of 
+    binary searching the draw commands for it.  That search is log2(groups) loads for every 
+    corner of every particle, so this keeps the cost of a draw the same however many groups 
+    there are.
+
+    Note: Needs a GL context to check for the extension.
+    Also Note: The draw ID only picks the style.  The pool is one buffer per particle buffer 
+    (see GetMaxPoolParticleCount(...)), so there are no chunks for it to pick a buffer 
+    binding from, and there is no bindless (NV_shader_buffer_load) path.
+Parameters:
+    layout  The layout that will be given to Init(...).
+Returns:
+    A string of "#define" statements for AcquireRenderProgram(...).
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+std::string ParticleManager::GetQuadRenderShaderDefines(ParticleLayout layout)
+{
+    std::string defines = "#define PARTICLE_QUADS\n";
+    if (IsGlExtensionSupported("GL_ARB_shader_draw_parameters"))
+    {
+        defines += "#define PARTICLE_DRAW_PARAMETERS\n";
+    }
+    return defines + GetRenderShaderDefines(layout);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The defines for a vertex pulling or quad render program (see GetRenderShaderDefines(...) 
+    and GetQuadRenderShaderDefines(...)) that textures each particle with a frame of a 
+    flipbook (see SetFlipbook(...)).  The frame is picked from the particle's age, which is 
+    only in the particle buffers, so the attribute build can't draw one.
+
+    The vertex shader picks the frame and the mip level once per particle, and the fragment 
+    shader only does the lookup (see PARTICLE_FLIPBOOK in shaderParticle.vert).  The level is 
+    the one whose texels are about the size of the particle's pixels, so small particles read 
+    a few texels of a small level instead of scattering over the biggest one, which keeps the 
+    texture cache hit rate up however many there are.
+
+    The program must be built with shaderParticleFlipbook.frag.
+Parameters:
+    layout      The layout that will be given to Init(...).
+    useQuads    True to draw instanced quads, false to draw point sprites.
+Returns:
+    A string of "#define" statements for AcquireRenderProgram(...).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+std::string ParticleManager::GetFlipbookRenderShaderDefines(ParticleLayout layout, 
+    bool useQuads)
+{
+    std::string defines = "#define PARTICLE_FLIPBOOK\n";
+    if (useQuads)
+    {
+        return defines + GetQuadRenderShaderDefines(layout);
+    }
+    return defines + GetRenderShaderDefines(layout);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The defines for a point sprite render program that antialiases the particles' edges in 
+    the fragment shader instead of with MSAA (see PARTICLE_SMOOTH_POINTS in 
+    shaderParticle.vert).  A hard point sprite is a square that snaps from one pixel to the 
+    next, so a slow particle crawls in steps and a small one flickers.  MSAA would fix the 
+    edges, but at 4x it stores, blends, and resolves 4 samples for every pixel of the frame. 
+    Here each particle is a circle whose edge fades over a pixel (its coverage of the pixel),
+    which costs a smoothstep per fragment and nothing per pixel of the frame.
+
+    The program must be built with shaderParticleSmooth.frag, which computes the coverage, 
+    and it is meant for additive blending, which adds up the partly covered pixels the same 
+    way it adds up the particles.
+
+    Note: A small particle is spread over at least 1.5 pixels, dimmed to keep its light, so 
+    it moves smoothly between pixels too.
+Parameters:
+    layout              The layout that will be given to Init(...).
+    useVertexPulling    True for the vertex pulling build (see GetRenderShaderDefines(...)), 
+                        false for the attribute build.
+Returns:
+    A string of "#define" statements for AcquireRenderProgram(...).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+std::string ParticleManager::GetSmoothPointRenderShaderDefines(ParticleLayout layout, 
+    bool useVertexPulling)
+{
+    std::string defines = "#define PARTICLE_SMOOTH_POINTS\n";
+    if (useVertexPulling)
+    {
+        return defines + GetRenderShaderDefines(layout);
+    }
+    return defines;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The defines for the sort program (see SetParticleSort(...)), which is built from 
+    shaderParticle.comp just like the simulation so that it shares the storage layout code.
+Parameters:
+    layout  The layout that will be given to Init(...).
+Returns:
+    A string of "#define" statements for AcquireComputeProgram(...).
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+std::string ParticleManager::GetSortShaderDefines(ParticleLayout layout)
+{
+    return GetComputeShaderDefines(layout) + "#define PARTICLE_SORT_PASS\n";
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The GPU memory that Init(...) will allocate for a pool of the given size: the particle 
+    buffers, the dead indices, the live indices, both update lists, and the active mask.  
+    Everything else that it allocates is sized by the emitters and draw groups, and is small 
+    enough to leave out.  Optional features (ex: the sort, the particle IDs, the readback) are 
+    extra, and are checked against the budget when they are turned on.
+
+    Lets the caller pick a pool and layout that fit the GPU memory budget before it builds 
+    any programs for them (see GpuMemoryLedger.h).
+Parameters:
+    particleCount   Self-explanatory.
+    layout          Self-explanatory.
+Returns:
+    The estimate in bytes.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned long long ParticleManager::EstimateGpuMemory(unsigned int particleCount, 
+    ParticleLayout layout)
+{
+    const ParticleLayoutDescriptor &layoutDescriptor = GetParticleLayoutDescriptor(layout);
+    unsigned long long bytesPerParticle = 0;
+    for (unsigned int bufferIndex = 0; bufferIndex < GetParticleBufferCount(layoutDescriptor); 
+        bufferIndex++)
+    {
+        bytesPerParticle += Std430BufferStride(layoutDescriptor, bufferIndex);
+    }
+
+    // a dead index, a live index, and an entry in each of the two update lists
+    bytesPerParticle += 4 * sizeof(GLuint);
+    unsigned long long activeMaskBytes = ((particleCount + 31ull) / 32) * sizeof(GLuint);
+    return (bytesPerParticle * particleCount) + activeMaskBytes + 
+        (2 * sizeof(UpdateListHeader));
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The largest pool that Init(...) and Resize(...) will take for the given layout.  Every 
+    particle buffer, and the dead indices, the live indices, and the update lists, is a single 
+    SSBO that the shader indexes with a 32-bit uint, so the pool is capped by whichever of 
+    them hits GL_MAX_SHADER_STORAGE_BLOCK_SIZE first.  It is also capped at 2^31, so that an 
+    index plus a whole dispatch's worth of threads (the grid-stride loops, the "round up" 
+    work group counts) never wraps around 2^32.
+
+    Note: Needs a GL context.  GL only promises 2^27 bytes for a block, and that is what it 
+    falls back to if the query fails, though most desktop drivers allow the whole buffer.
+    Also Note: This is a hard limit.  The pool isn't split into chunks of buffers with a 
+    dispatch and a draw per chunk, so a bigger pool is refused by Init(...) and Resize(...) 
+    rather than spread out, and the particle counts and indices stay 32-bit.
+Parameters:
+    layout  Self-explanatory.
+Returns:
+    The most particles that one pool can hold.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleManager::GetMaxPoolParticleCount(ParticleLayout layout)
+{
+    GLint64 maxBlockSizeBytes = 0;
+    glGetInteger64v(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &maxBlockSizeBytes);
+    if (maxBlockSizeBytes <= 0)
+    {
+        maxBlockSizeBytes = 1ll << 27;
+    }
+
+    // the update lists have a header in front of their indices
+    const ParticleLayoutDescriptor &layoutDescriptor = GetParticleLayoutDescriptor(layout);
+    unsigned long long largestStride = sizeof(GLuint);
+    for (unsigned int bufferIndex = 0; bufferIndex < GetParticleBufferCount(layoutDescriptor); 
+        bufferIndex++)
+    {
+        unsigned long long stride = Std430BufferStride(layoutDescriptor, bufferIndex);
+        largestStride = (stride > largestStride) ? stride : largestStride;
+    }
+    unsigned long long maxParticleCount = 
+        ((unsigned long long)maxBlockSizeBytes - sizeof(UpdateListHeader)) / largestStride;
+
+    const unsigned long long maxAddressableCount = 1ull << 31;
+    if (maxParticleCount > maxAddressableCount)
+    {
+        maxParticleCount = maxAddressableCount;
+    }
+    return (unsigned int)maxParticleCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sends out up to each emitter's quota of inactive particles, then moves every active 
+    particle by its velocity and the provided delta time.  Particles that go out of bounds are 
+    deactivated and wait for a later emission.  A single step of UpdateSteps(...).
+Parameters:
+    deltatimeSec        Self-explanatory
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (7-4-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::Update(float deltaTimeSec)
+{
+    this->UpdateSteps(deltaTimeSec, 1);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Runs the emit pass once and then several fixed-length simulation steps back to back.  The 
+    program binding and the emit pass happen once, so all the dispatches go out in a single 
+    stream of commands with only the minimal barriers between them.  The parameters for each 
+    pass are written straight into the mapped parameter buffer.  Emission is per call, not per 
+    step, so the emission rate doesn't change with the number of steps.  Each step rebuilds the 
+    list of live particles, so the draw always uses the list from the last step.
+
+    With more than 1 substep per dispatch (see SetSubstepsPerDispatch(...)), the steps are 
+    batched, and each dispatch runs several of them on each particle without going back to 
+    memory.  The results are the same as one dispatch per step.
+
+    With the split backend (see SetSimulationBackend(...)), the dispatches only cover the GPU's
+    emitters, and once they are sent, the CPU's threads update the rest of the emitters while 
+    the GPU works on its share (see UpdateSplitCpuParticles(...)).
+Parameters:
+    stepSec     The simulation time of each step.
+    numSteps    Self-explanatory.  0 does nothing.  Clamped to MAX_UPDATE_STEPS dispatches 
+                because every dispatch needs its own parameter block.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-9-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::UpdateSteps(float stepSec, unsigned int numSteps)
+{
+    if (numSteps == 0)
+    {
+        return;
+    }
+    GlDebugGroup updateGroup("ParticleManager update");
+
+    if (_mappedParameters == 0)
+    {
+        return;
+    }
+
+    // the update's stream compaction does the culling and the level of detail
+    this->UpdateLodStride();
+    this->UploadView();
+    this->UpdateEmissionQuotas(stepSec * numSteps);
+
+    // even on the CPU, so that the tables are current if the backend changes
+    this->FlushDirtyTables();
+
+    if (_simulationBackend == PARTICLE_SIMULATION_BACKEND_CPU)
+    {
+        _simulationTimeSec += (double)stepSec * numSteps;
+        _pendingBursts.clear();
+        this->DropReadyInjections();
+        this->UpdateStepsOnCpu(stepSec, numSteps);
+        return;
+    }
+
+    // moves the split, if it is due, before this update's frame slot is taken, because moving 
+    // an emitter to the GPU rebuilds its dead stack with a pass of its own
+    bool isSplit = (_simulationBackend == PARTICLE_SIMULATION_BACKEND_SPLIT);
+    if (isSplit)
+    {
+        this->BalanceSplitSimulation();
+    }
+
+    // the fused emit leaves the dead stacks behind, so they are rebuilt once it stops
+    bool useFusedEmit = this->IsFusedEmitUpdateActive();
+    if (_areDeadStacksStale && !useFusedEmit)
+    {
+        this->RebuildDeadStacks(0, (unsigned int)_emitters.size());
+    }
+    _areDeadStacksStale = useFusedEmit;
+
+    // every dispatch gets its own parameter block, and there are only so many per frame
+    unsigned int numDispatches = (numSteps + _substepsPerDispatch - 1) / _substepsPerDispatch;
+    if (numDispatches > MAX_UPDATE_STEPS)
+    {
+        numDispatches = MAX_UPDATE_STEPS;
+        numSteps = MAX_UPDATE_STEPS * _substepsPerDispatch;
+    }
+
+    // before anything is dispatched, so that the copy is of what the last update left
+    if (_isDoubleBufferedRendering && !isSplit)
+    {
+        this->CopyRenderState(stepSec * numSteps);
+    }
+
+    unsigned int frameSlot = this->AcquireParameterFrameSlot();
+
+    SimulationParameters parameters;
+    parameters._deltaTimeSec = stepSec;
+    parameters._maxParticleCount = _maxParticleCount;
+    parameters._emitterCount = (unsigned int)_emitters.size();
+    parameters._frameIndex = _parameterFrameIndex;
+    parameters._rebuildEmitterIndex = 0;
+    parameters._forceFieldCount = (unsigned int)_forceFields.size();
+    parameters._substepCount = 1;
+    parameters._updateParticleEnd = isSplit ? _cpuFirstParticle : _maxParticleCount;
+    parameters._cpuEmittedCount = 0;
+    parameters._isDeterministic = _isDeterministic ? 1 : 0;
+    parameters._emitStepIndex = _emitStepCounter++;
+
+    // the update lists only know the GPU's particles, so the split backend's dispatches cover 
+    // the GPU's part of the pool every time, and the list is rebuilt without it
+    // Note: The first dispatch builds the list from the whole pool if something else moved the
+    // particles since the last update (ex: a resize or a sort).
+    // Note: The persistent-threads kernel and the fused emit cover the whole pool with the 
+    // active mask instead, since they have to come across the dead particles.
+    bool usePersistentThreads = this->IsPersistentThreadsActive();
+    UpdateListMode firstUpdateListMode = UPDATE_LIST_OFF;
+    if (_useUpdateList && !isSplit && !usePersistentThreads && !useFusedEmit)
+    {
+        firstUpdateListMode = _isUpdateListStale ? UPDATE_LIST_BUILD : UPDATE_LIST_USE;
+        _isUpdateListStale = false;
+    }
+    else
+    {
+        _isUpdateListStale = true;
+    }
+    parameters._updateListMode = firstUpdateListMode;
+    parameters._updateListParticlesPerWorkGroup = _workGroupSizeX * _particlesPerInvocation;
+    parameters._updateListMaxWorkGroups = GetComputeDeviceCaps()._maxWorkGroupCount[0];
+    parameters._persistentEmitChunks = 0;
+
+    // the emitter paths are where they were at the start of the update, and the particles 
+    // that are emitted now came out over the time that it covers
+    // Note: A float is still within a millisecond after a few hours.  The clock itself is a 
+    // double, so it doesn't drift.
+    parameters._simulationTimeSec = (float)_simulationTimeSec;
+    parameters._emitSpanSec = stepSec * numSteps;
+    parameters._isSubFrameEmission = _emissionRates.empty() ? 0 : 1;
+    _simulationTimeSec += (double)stepSec * numSteps;
+
+    // the newest pointer input goes in as late as it can, so it is in the very next dispatch
+    _appliedPointerInputTimeMs = 0.0;
+    if (_pointerInputSlot.TakeLatest(&_pointerInput))
+    {
+        _appliedPointerInputTimeMs = _pointerInput._timeMs;
+    }
+    SetPointerParameters(_pointerInput, _pointerEmitterIndex, &parameters);
+
+    // bind before starting to compute stuff
+    UseGlProgram(_computeProgramId);
+    if (_unifLocFieldTextureResponse != (unsigned int)-1)
+    {
+        // only sampled by the update passes, but it doesn't change between steps
+        // Note: Without a texture, a response of 0 turns the sample off without a new program.
+        glm::vec2 fieldSize = _fieldTextureMax - _fieldTextureMin;
+        glUniform2f(_unifLocFieldTextureMin, _fieldTextureMin.x, _fieldTextureMin.y);
+        glUniform2f(_unifLocFieldTextureInverseSize, 1.0f / fieldSize.x, 1.0f / fieldSize.y);
+        glUniform1i(_unifLocFieldTextureMode, _fieldTextureMode);
+        glUniform1f(_unifLocFieldTextureResponse, 
+            (_fieldTextureId != 0) ? _fieldTextureResponse : 0.0f);
+        glUniform1f(_unifLocFieldTextureScale, _fieldTextureScale);
+
+        // the uniform is set either way, since the program may be shared with a manager that 
+        // binds its texture the other way
+        if (_fieldTextureHandle != 0)
+        {
+            gUniformHandleui64Arb(_unifLocFieldTexture, _fieldTextureHandle);
+        }
+        else
+        {
+            glUniform1i(_unifLocFieldTexture, FIELD_TEXTURE_UNIT);
+            glActiveTexture(GL_TEXTURE0 + FIELD_TEXTURE_UNIT);
+            glBindTexture(GL_TEXTURE_2D, _fieldTextureId);
+            glActiveTexture(GL_TEXTURE0);
+        }
+    }
+    if (_unifLocSdfBoundaryMode != (unsigned int)-1)
+    {
+        // Note: Without a texture, every sample is 0, which is on the surface but not in the 
+        // solid, so nothing is stopped.
+        glm::vec2 boundarySize = _sdfBoundaryMax - _sdfBoundaryMin;
+        glUniform2f(_unifLocSdfBoundaryMin, _sdfBoundaryMin.x, _sdfBoundaryMin.y);
+        glUniform2f(_unifLocSdfBoundaryInverseSize, 1.0f / boundarySize.x, 1.0f / boundarySize.y);
+        glUniform2f(_unifLocSdfBoundaryTexelSize, _sdfBoundaryTexelSize.x, 
+            _sdfBoundaryTexelSize.y);
+        glUniform1i(_unifLocSdfBoundaryMode, _sdfBoundaryMode);
+        glUniform1f(_unifLocSdfBoundaryRestitution, _sdfBoundaryRestitution);
+        glUniform1f(_unifLocSdfBoundaryScale, _sdfBoundaryScale);
+        if (_sdfBoundaryTextureHandle != 0)
+        {
+            gUniformHandleui64Arb(_unifLocSdfBoundaryTexture, _sdfBoundaryTextureHandle);
+        }
+        else
+        {
+            glUniform1i(_unifLocSdfBoundaryTexture, SDF_BOUNDARY_TEXTURE_UNIT);
+            glActiveTexture(GL_TEXTURE0 + SDF_BOUNDARY_TEXTURE_UNIT);
+            glBindTexture(GL_TEXTURE_2D, _sdfBoundaryTextureId);
+            glActiveTexture(GL_TEXTURE0);
+        }
+    }
+    if (_unifLocSegmentBvhSegmentCount != (unsigned int)-1)
+    {
+        // Note: Without a BVH, a count of 0 skips the traversal, so the buffers aren't read.
+        glUniform1ui(_unifLocSegmentBvhSegmentCount, _segmentBvhSegmentCount);
+        glUniform1i(_unifLocSegmentBvhMode, _segmentBvhMode);
+        glUniform1f(_unifLocSegmentBvhRestitution, _segmentBvhRestitution);
+        BindGlShaderStorageBuffer(SEGMENT_BVH_SEGMENT_BUFFER_BINDING, _segmentBvhSegmentBufferId);
+        BindGlShaderStorageBuffer(SEGMENT_BVH_NODE_BUFFER_BINDING, _segmentBvhNodeBufferId);
+    }
+    if (_unifLocEmissionImagePixelCount != (unsigned int)-1)
+    {
+        // Note: Without an image, a count of 0 spawns in the disk, so the CDF isn't read.
+        glm::vec2 imageSize = _emissionImageMax - _emissionImageMin;
+        unsigned int pixelCount = (_emissionImageCdfBufferId != 0) ? 
+            (unsigned int)(_emissionImageWidth * _emissionImageHeight) : 0;
+        glUniform1ui(_unifLocEmissionImagePixelCount, pixelCount);
+        glUniform1ui(_unifLocEmissionImageWidth, (unsigned int)_emissionImageWidth);
+        glUniform2f(_unifLocEmissionImageMin, _emissionImageMin.x, _emissionImageMin.y);
+        glUniform2f(_unifLocEmissionImageTexelSize, 
+            (pixelCount > 0) ? imageSize.x / _emissionImageWidth : 0.0f, 
+            (pixelCount > 0) ? imageSize.y / _emissionImageHeight : 0.0f);
+        BindGlShaderStorageBuffer(EMISSION_IMAGE_CDF_BUFFER_BINDING, _emissionImageCdfBufferId);
+    }
+    if (_unifLocEmitterPathCount != (unsigned int)-1)
+    {
+        // Note: Without paths, a count of 0 leaves every emitter at its center, so the 
+        // buffers aren't read.
+        glUniform1ui(_unifLocEmitterPathCount, (unsigned int)_emitterPaths.size());
+        BindGlShaderStorageBuffer(EMITTER_PATH_BUFFER_BINDING, _emitterPathBufferId);
+        BindGlShaderStorageBuffer(EMITTER_PATH_POINT_BUFFER_BINDING, _emitterPathPointBufferId);
+    }
+    if (_unifLocEmitterSliceCount != (unsigned int)-1)
+    {
+        // Note: Without slices, a count of 0 integrates every emitter every time, so the 
+        // buffer isn't read.
+        glUniform1ui(_unifLocEmitterSliceCount, (unsigned int)_emitterSlices.size());
+        BindGlShaderStorageBuffer(EMITTER_SLICE_BUFFER_BINDING, _emitterSliceBufferId);
+    }
+    if (_unifLocSleepSpeedSqr != (unsigned int)-1)
+    {
+        // Note: A speed of 0 puts nothing to sleep and wakes whatever is asleep as it comes up.
+        // The pointer's pull moves every particle, so nothing sleeps while it is on.  0 rest 
+        // updates tells the shader that there are no buffers (the program was replaced by one 
+        // with sleep after Init(...)), so it doesn't touch them at all.
+        bool hasSleepBuffers = _sleepMaskBufferId != 0;
+        bool isSleepOn = _sleepSpeed > 0.0f && hasSleepBuffers && 
+            (parameters._pointerFlags & PARTICLE_POINTER_ATTRACTING) == 0;
+        glUniform1f(_unifLocSleepSpeedSqr, isSleepOn ? (_sleepSpeed * _sleepSpeed) : 0.0f);
+        glUniform1ui(_unifLocSleepRestUpdates, hasSleepBuffers ? _sleepRestUpdates : 0);
+        BindGlShaderStorageBuffer(SLEEP_MASK_BUFFER_BINDING, _sleepMaskBufferId);
+        BindGlShaderStorageBuffer(REST_COUNT_BUFFER_BINDING, _restCountBufferId);
+    }
+    bool useDrawGroupCulling = this->IsDrawGroupCullingActive();
+    if (_unifLocDrawGroupCulled != (unsigned int)-1)
+    {
+        // Note: Set every time, since the program may be shared with a manager that doesn't 
+        // cull.  0 doesn't touch the bounds, so a program without its buffer still runs.
+        glUniform1ui(_unifLocDrawGroupCulled, useDrawGroupCulling ? 1 : 0);
+        BindGlShaderStorageBuffer(DRAW_GROUP_BOUNDS_BUFFER_BINDING, _drawGroupBoundsBufferId);
+    }
+    glUniform1ui(_unifLocUpdateAmortization, _updateAmortization);
+    bool hasSubEmitters = _unifLocSubEmitterCount != (unsigned int)-1 && 
+        _deathEventBufferId != 0 && !_isDeterministic && !useFusedEmit;
+    if (_unifLocSubEmitterCount != (unsigned int)-1)
+    {
+        // Note: Without sub-emitters (or in the deterministic mode or with the fused emit, 
+        // which have no dead stacks to take the children from), a count of 0 records no 
+        // deaths.
+        glUniform1ui(_unifLocSubEmitterCount, 
+            hasSubEmitters ? (unsigned int)_subEmitters.size() : 0);
+        glUniform1ui(_unifLocSubEmitterMaxChildren, _subEmitterMaxChildren);
+        glUniform1ui(_unifLocMaxDeathEvents, MAX_DEATH_EVENTS);
+        BindGlShaderStorageBuffer(SUB_EMITTER_BUFFER_BINDING, _subEmitterBufferId);
+        BindGlShaderStorageBuffer(DEATH_EVENT_BUFFER_BINDING, _deathEventBufferId);
+    }
+
+    // only the GPU's part of the split, so that the balancer can compare it with the CPU's
+    bool isProfilingSplit = isSplit && _splitProfiler != 0;
+    if (isProfilingSplit)
+    {
+        _splitProfiler->BeginScope(_splitGpuScopeId);
+    }
+
+    // reset the emitted count
+    // Note: Any shader writes to it from the last call finished before the barrier at the end 
+    // of the last call.
+    GLuint zeroEmitted = 0;
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _drawCommandBufferId);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, offsetof(DrawCommandBufferHeader, _emittedCount), 
+        sizeof(GLuint), &zeroEmitted);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    // the emit pass comes first and is once per call, so the emission rate doesn't change with 
+    // the number of steps
+    // Note: One work item per particle that the emitter with the largest quota may emit, and 
+    // one row of work groups per emitter.  See EmitParticles() in shaderParticle.comp.  A 
+    // quota over the device's limit in X gives each work item several particles instead.
+    unsigned int blockOffset = (frameSlot * PARAMETER_BLOCKS_PER_FRAME) * _parameterBlockStride;
+    parameters._passType = SIMULATION_PASS_EMIT;
+    parameters._randomSeed = _stepCounter++;
+    memcpy((unsigned char *)_mappedParameters + blockOffset, &parameters, sizeof(parameters));
+    glBindBufferRange(GL_UNIFORM_BUFFER, PARAMETER_BLOCK_BINDING, _parameterBufferId, 
+        blockOffset, sizeof(parameters));
+    GLuint numGpuEmitters = isSplit ? _cpuFirstEmitter : (GLuint)_emitters.size();
+    if (firstUpdateListMode != UPDATE_LIST_OFF)
+    {
+        BindGlShaderStorageBuffer(UPDATE_LIST_IN_BUFFER_BINDING, 
+            _updateListBufferIds[_updateListIndex]);
+    }
+
+    // the children of the last update's deaths go out first, and the list starts over for 
+    // this update's deaths
+    // Note: The update appended to the list with atomics, and the dispatch reads its header 
+    // as a command, and the header is then overwritten.
+    if (hasSubEmitters && _subEmitterMaxChildren > 0)
+    {
+        GlDebugGroup subEmitGroup("sub-emitters");
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | 
+            GL_BUFFER_UPDATE_BARRIER_BIT);
+        SimulationParameters subEmitParameters = parameters;
+        subEmitParameters._passType = SIMULATION_PASS_SUB_EMIT;
+        subEmitParameters._randomSeed = _stepCounter++;
+        unsigned int subEmitBlockOffset = ((frameSlot * PARAMETER_BLOCKS_PER_FRAME) + 
+            PARAMETER_BLOCKS_PER_FRAME - 2) * _parameterBlockStride;
+        memcpy((unsigned char *)_mappedParameters + subEmitBlockOffset, &subEmitParameters, 
+            sizeof(subEmitParameters));
+        glBindBufferRange(GL_UNIFORM_BUFFER, PARAMETER_BLOCK_BINDING, _parameterBufferId, 
+            subEmitBlockOffset, sizeof(subEmitParameters));
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, _deathEventBufferId);
+        glDispatchComputeIndirect(0);
+        DeathListHeader emptyDeathList = { 0, 1, 1, 0 };
+        glBufferSubData(GL_DISPATCH_INDIRECT_BUFFER, 0, sizeof(emptyDeathList), 
+            &emptyDeathList);
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        glBindBufferRange(GL_UNIFORM_BUFFER, PARAMETER_BLOCK_BINDING, _parameterBufferId, 
+            blockOffset, sizeof(parameters));
+    }
+
+    // the bursts go out before the emit pass, so that they get first pick of the dead stacks
+    // Note: The dispatch is sized by the queue's own header, one row of work groups per burst 
+    // and as wide as the biggest, so it costs the GPU what the bursts are worth and the CPU a 
+    // copy of each record.  The emit pass pops the same dead stacks, so it waits for this one.
+    unsigned int burstCount = this->WriteBurstQueue(frameSlot);
+    if (burstCount > 0)
+    {
+        GlDebugGroup burstGroup("bursts");
+        SimulationParameters burstParameters = parameters;
+        burstParameters._passType = SIMULATION_PASS_BURST;
+        burstParameters._randomSeed = _stepCounter++;
+        unsigned int burstBlockOffset = ((frameSlot * PARAMETER_BLOCKS_PER_FRAME) + 
+            PARAMETER_BLOCKS_PER_FRAME - 1) * _parameterBlockStride;
+        memcpy((unsigned char *)_mappedParameters + burstBlockOffset, &burstParameters, 
+            sizeof(burstParameters));
+        glBindBufferRange(GL_UNIFORM_BUFFER, PARAMETER_BLOCK_BINDING, _parameterBufferId, 
+            burstBlockOffset, sizeof(burstParameters));
+        GLintptr slotOffset = frameSlot * _burstQueueSlotStride;
+        BindGlShaderStorageBufferRange(BURST_QUEUE_BUFFER_BINDING, 
+            _burstQueueBufferId, slotOffset, _burstQueueSlotStride);
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, _burstQueueBufferId);
+        glDispatchComputeIndirect(slotOffset);
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        glBindBufferRange(GL_UNIFORM_BUFFER, PARAMETER_BLOCK_BINDING, _parameterBufferId, 
+            blockOffset, sizeof(parameters));
+    }
+
+    // the streamed particles go out after the bursts, and before the emit pass for the same 
+    // reason (see SetInjectionRing(...))
+    // Note: One indirect dispatch per slot, sized by the header that TakeReadySlot(...) wrote,
+    // so the records are read where the producer wrote them.  The slots are taken at most 
+    // once around the ring, so a producer that keeps refilling can't hold up the update.
+    if (_injectionRing != 0 && 
+        (!_hasInjectionKernel || _isDeterministic || useFusedEmit))
+    {
+        this->DropReadyInjections();
+    }
+    else if (_injectionRing != 0)
+    {
+        GlDebugGroup injectionGroup("injection");
+        _injectionRing->ReclaimSlots();
+        unsigned int injectionBlockOffset = ((frameSlot * PARAMETER_BLOCKS_PER_FRAME) + 
+            PARAMETER_BLOCKS_PER_FRAME - 3) * _parameterBlockStride;
+        unsigned int slotIndex = 0;
+        unsigned int takenCount = 0;
+        while (takenCount < ParticleInjectionRing::MAX_SLOT_COUNT && 
+            _injectionRing->TakeReadySlot(_workGroupSizeX, &slotIndex))
+        {
+            if (takenCount == 0)
+            {
+                SimulationParameters injectionParameters = parameters;
+                injectionParameters._passType = SIMULATION_PASS_INJECT;
+                injectionParameters._randomSeed = _stepCounter++;
+                memcpy((unsigned char *)_mappedParameters + injectionBlockOffset, 
+                    &injectionParameters, sizeof(injectionParameters));
+                glBindBufferRange(GL_UNIFORM_BUFFER, PARAMETER_BLOCK_BINDING, 
+                    _parameterBufferId, injectionBlockOffset, sizeof(injectionParameters));
+                glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, _injectionRing->GetBufferId());
+            }
+            GLintptr slotOffset = _injectionRing->GetSlotOffset(slotIndex);
+            BindGlShaderStorageBufferRange(INJECTION_SLOT_BUFFER_BINDING, 
+                _injectionRing->GetBufferId(), slotOffset, 
+                _injectionRing->GetSlotStrideBytes());
+            glDispatchComputeIndirect(slotOffset);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+            _injectionRing->FenceSlot(slotIndex);
+            takenCount++;
+        }
+        if (takenCount > 0)
+        {
+            glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+            glBindBufferRange(GL_UNIFORM_BUFFER, PARAMETER_BLOCK_BINDING, _parameterBufferId, 
+                blockOffset, sizeof(parameters));
+        }
+    }
+
+    PushGlDebugGroup(usePersistentThreads ? "persistent threads" : "emit");
+    if (usePersistentThreads)
+    {
+        // the emit pass, every step of the update, and the compaction in one dispatch, with 
+        // the steps done as substeps (see RunPersistentThreads() in shaderParticle.comp)
+        // Note: There is only one update, so the draw commands are only reset once, and the 
+        // step loop below is skipped.  The queue starts over, and like the emitted count, 
+        // the last call's atomics on it finished before the barrier at the end of that call.
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _drawCommandBufferId);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawCommandBufferHeader), 
+            _drawCommandResetData.size() * sizeof(GLuint), _drawCommandResetData.data());
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        if (useDrawGroupCulling)
+        {
+            this->ClearDrawGroupBounds();
+        }
+        GLuint zeroQueue[2] = { 0, 0 };
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, _persistentQueueBufferId);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zeroQueue), zeroQueue);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        parameters._passType = SIMULATION_PASS_PERSISTENT;
+        parameters._substepCount = numSteps;
+        parameters._persistentEmitChunks = 
+            (_maxEmitterQuota + _workGroupSizeX - 1) / _workGroupSizeX;
+        memcpy((unsigned char *)_mappedParameters + blockOffset, &parameters, sizeof(parameters));
+
+        // no more work groups than there are chunks, so none of them start up just to quit
+        GLuint numChunks = (parameters._persistentEmitChunks * numGpuEmitters) + 
+            ((_maxParticleCount + _workGroupSizeX - 1) / _workGroupSizeX);
+        GLuint numPersistentWorkGroups = (numChunks < _persistentWorkGroupCount) ? 
+            numChunks : _persistentWorkGroupCount;
+        glUniform1ui(_unifLocAmortizationPhase, _amortizationPhase++);
+        if (_unifLocFusedEmitMode != (unsigned int)-1)
+        {
+            glUniform1ui(_unifLocFusedEmitMode, FUSED_EMIT_OFF);
+        }
+        glDispatchCompute(ClampComputeDispatchSizeX(numPersistentWorkGroups), 1, 1);
+        numDispatches = 0;
+    }
+    else if (useFusedEmit)
+    {
+        // the update's first dispatch sends the particles out instead (see 
+        // SetFusedEmitUpdate(...)), and the dead counts are the numbers that it hands out 
+        // against the quotas, which start over every update
+        // Note: Like the emitted count, the last call's atomics on them finished before the 
+        // barrier at the end of that call.
+        GLint zero = 0;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, _deadCountBufferId);
+        glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32I, 0, 
+            _emitters.size() * sizeof(GLint), GL_RED_INTEGER, GL_INT, &zero);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+    else if (_maxEmitterQuota > 0 && numGpuEmitters > 0)
+    {
+        GLuint numEmitWorkGroupsX = ClampComputeDispatchSizeX(
+            (_maxEmitterQuota + _workGroupSizeX - 1) / _workGroupSizeX);
+        glDispatchCompute(numEmitWorkGroupsX, numGpuEmitters, 1);
+    }
+    PopGlDebugGroup();
+
+    // the update pass reads the particles that were just emitted and pushes onto the same dead 
+    // stacks, and its indirect dispatch is the update list that the emit pass appended to
+    glMemoryBarrier((firstUpdateListMode == UPDATE_LIST_USE) ? 
+        (GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT) : GL_SHADER_STORAGE_BARRIER_BIT);
+    parameters._passType = SIMULATION_PASS_UPDATE;
+
+    // the work groups specified here MUST match the values specified by "local_size_x", 
+    // "local_size_y", and "local_size_z" in the compute shader's input layout
+    // Note: Rounds up, so only the last work group is partly empty, and there is no extra work 
+    // group when the particle count divides evenly.  The shader loops over the particles, so 
+    // dispatching fewer work groups gives each work item more particles.
+    // Also Note: That same loop is why a pool that needs more work groups than the device 
+    // allows in X is simply clamped to the limit rather than split into more dispatches.  
+    // OpenGL only promises 65535, which is ~16.7 million particles at 256 per group.
+    // Also Note: A split with every emitter on the CPU still dispatches one work group, which 
+    // does nothing but keeps the dispatch valid.
+    GLuint numParticles = (parameters._updateParticleEnd > 0) ? parameters._updateParticleEnd : 1;
+    GLuint particlesPerWorkGroup = _workGroupSizeX * _particlesPerInvocation;
+    GLuint numWorkGroupsX = ClampComputeDispatchSizeX(
+        (numParticles + particlesPerWorkGroup - 1) / particlesPerWorkGroup);
+    GLuint numWorkGroupsY = 1;
+    GLuint numWorkGroupsZ = 1;
+
+    // Note: Each step also compacts the live particles into the draw lists (and the update 
+    // list), so there is no separate compaction pass to mark.
+    PushGlDebugGroup("update steps");
+    for (unsigned int dispatchCount = 0; dispatchCount < numDispatches; dispatchCount++)
+    {
+        if (dispatchCount > 0)
+        {
+            // the next step reads the particles, the dead stacks, and the draw command that the
+            // previous step wrote, and the draw command is about to be overwritten by 
+            // glBufferSubData(...)
+            // Note: The update list that the previous step wrote is this one's indirect 
+            // dispatch.
+            GLbitfield stepBarrierBits = 
+                GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT;
+            if (firstUpdateListMode != UPDATE_LIST_OFF)
+            {
+                stepBarrierBits |= GL_COMMAND_BARRIER_BIT;
+                parameters._updateListMode = UPDATE_LIST_USE;
+            }
+            glMemoryBarrier(stepBarrierBits);
+        }
+
+        // start a new list of live particles for every draw group
+        // Note: The shader only changes each command's "count", but the whole command array 
+        // is rewritten because it is a single small upload either way (20 bytes per group) 
+        // and it also carries any visibility change (see SetDrawGroupVisible(...)).  The 
+        // emitted count in the header is reset before the emit pass.
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _drawCommandBufferId);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawCommandBufferHeader), 
+            _drawCommandResetData.size() * sizeof(GLuint), _drawCommandResetData.data());
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        if (useDrawGroupCulling)
+        {
+            this->ClearDrawGroupBounds();
+        }
+
+        // respawned particles draw their random numbers from (particle index, step), so every 
+        // step needs a new seed or the same particle would respawn the same way every time
+        parameters._randomSeed = _stepCounter++;
+
+        // the last dispatch gets whatever steps are left over
+        unsigned int stepsDone = dispatchCount * _substepsPerDispatch;
+        parameters._substepCount = ((numSteps - stepsDone) < _substepsPerDispatch) ? 
+            (numSteps - stepsDone) : _substepsPerDispatch;
+
+        // the mapping is coherent, so the write is visible to any command issued after it
+        // Note: Block 0 of the frame was the emit pass.
+        blockOffset = 
+            ((frameSlot * PARAMETER_BLOCKS_PER_FRAME) + dispatchCount + 1) * _parameterBlockStride;
+        memcpy((unsigned char *)_mappedParameters + blockOffset, &parameters, sizeof(parameters));
+        glBindBufferRange(GL_UNIFORM_BUFFER, PARAMETER_BLOCK_BINDING, _parameterBufferId, 
+            blockOffset, sizeof(parameters));
+
+        // the next runs of the particles that aren't drawn take their turn
+        // Note: A counter of its own rather than the random seed, which the burst and 
+        // sub-emitter passes also take from, because the runs must come up in turn.
+        glUniform1ui(_unifLocAmortizationPhase, _amortizationPhase++);
+
+        // only the first step emits, so the quotas are per update either way
+        // Note: Set every time, since the program may be shared with a manager that doesn't 
+        // fuse.
+        if (_unifLocFusedEmitMode != (unsigned int)-1)
+        {
+            FusedEmitMode fusedEmitMode = FUSED_EMIT_OFF;
+            if (useFusedEmit)
+            {
+                fusedEmitMode = (dispatchCount == 0 && _maxEmitterQuota > 0) ? 
+                    FUSED_EMIT_ON : FUSED_EMIT_SKIP;
+            }
+            glUniform1ui(_unifLocFusedEmitMode, fusedEmitMode);
+        }
+
+        if (parameters._updateListMode == UPDATE_LIST_OFF)
+        {
+            glDispatchCompute(numWorkGroupsX, numWorkGroupsY, numWorkGroupsZ);
+            continue;
+        }
+
+        // this step reads one list and starts the other one over, and the next step trades 
+        // them
+        // Note: An empty list is a dispatch of 0 work groups, which is legal and does nothing.
+        GLuint inListBufferId = _updateListBufferIds[_updateListIndex];
+        GLuint outListBufferId = _updateListBufferIds[1 - _updateListIndex];
+        UpdateListHeader emptyListHeader = { 0, 1, 1, 0 };
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, outListBufferId);
+        glBufferSubData(GL_DISPATCH_INDIRECT_BUFFER, 0, sizeof(emptyListHeader), 
+            &emptyListHeader);
+        BindGlShaderStorageBuffer(UPDATE_LIST_IN_BUFFER_BINDING, inListBufferId);
+        BindGlShaderStorageBuffer(UPDATE_LIST_OUT_BUFFER_BINDING, outListBufferId);
+        if (parameters._updateListMode == UPDATE_LIST_USE)
+        {
+            glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, inListBufferId);
+            glDispatchComputeIndirect(0);
+        }
+        else
+        {
+            glDispatchCompute(numWorkGroupsX, numWorkGroupsY, numWorkGroupsZ);
+        }
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+        _updateListIndex = 1 - _updateListIndex;
+    }
+    PopGlDebugGroup();
+
+    if (isProfilingSplit)
+    {
+        _splitProfiler->EndScope(_splitGpuScopeId);
+    }
+    if (isSplit)
+    {
+        // the CPU's particles are copied in after the last step reset the draw commands, so 
+        // their live indices can be appended to the same commands
+        // Note: The copies are ordinary GL commands, but the last step's atomics on the draw 
+        // commands are shader writes, so this pass needs the barrier to see them.
+        // Also Note: The flush sends the GPU's dispatches off before the CPU gets busy, or the
+        // driver might hold on to them and the two sides wouldn't run at the same time.
+        glFlush();
+        GlDebugGroup appendGroup("append CPU particles");
+        parameters._cpuEmittedCount = 
+            this->UpdateSplitCpuParticles(stepSec, numSteps, frameSlot);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        parameters._passType = SIMULATION_PASS_APPEND_CPU_LIVE;
+        blockOffset = ((frameSlot * PARAMETER_BLOCKS_PER_FRAME) + numDispatches + 1) * 
+            _parameterBlockStride;
+        memcpy((unsigned char *)_mappedParameters + blockOffset, &parameters, sizeof(parameters));
+        glBindBufferRange(GL_UNIFORM_BUFFER, PARAMETER_BLOCK_BINDING, _parameterBufferId, 
+            blockOffset, sizeof(parameters));
+        GLuint numCpuParticles = _maxParticleCount - _cpuFirstParticle;
+        GLuint numAppendWorkGroupsX = ClampComputeDispatchSizeX(
+            (numCpuParticles + _workGroupSizeX - 1) / _workGroupSizeX);
+        glDispatchCompute((numAppendWorkGroupsX > 0) ? numAppendWorkGroupsX : 1, 1, 1);
+    }
+    if (useDrawGroupCulling)
+    {
+        // the groups whose bounds are off the screen are taken out of the draw, one work item 
+        // per group, once the last step (and the CPU's particles) finished growing the bounds
+        // Note: A command that is zeroed here is only zeroed in the GPU's copy, so the next 
+        // step's reset brings it back, and a group that comes back on the screen is drawn 
+        // again right away.
+        GlDebugGroup cullGroup("cull draw groups");
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        parameters._passType = SIMULATION_PASS_CULL_DRAW_GROUPS;
+        blockOffset = ((frameSlot * PARAMETER_BLOCKS_PER_FRAME) + 
+            PARAMETER_BLOCKS_PER_FRAME - 4) * _parameterBlockStride;
+        memcpy((unsigned char *)_mappedParameters + blockOffset, &parameters, sizeof(parameters));
+        glBindBufferRange(GL_UNIFORM_BUFFER, PARAMETER_BLOCK_BINDING, _parameterBufferId, 
+            blockOffset, sizeof(parameters));
+        GLuint numDrawGroups = (GLuint)_drawGroupLiveCounts.size();
+        glDispatchCompute((numDrawGroups + _workGroupSizeX - 1) / _workGroupSizeX, 1, 1);
+    }
+
+    // marks when the GPU is done with this frame's parameters
+    _parameterFenceRing.FenceSlot(frameSlot);
+    _parameterFrameIndex++;
+
+    // only wait on the caches that the consumers of the compute shader's writes actually read 
+    // (see GetUpdateBarrierBits())
+    // Note: GL_ALL_BARRIER_BITS also flushes texture, image, and framebuffer caches that this 
+    // pipeline never touches.  It is only kept around for A/B comparisons.
+    if (_useFullMemoryBarrier)
+    {
+        glMemoryBarrier(GL_ALL_BARRIER_BITS);
+    }
+    else
+    {
+        glMemoryBarrier(_updateBarrierBits);
+    }
+    this->RunExternalKernel(stepSec, numSteps);
+
+    PushGlDebugGroup("readback");
+    this->CopyCountsForReadback();
+    this->CopyParticlesForReadback();
+    this->FinishSnapshot(false);
+    PopGlDebugGroup();
+    if (_sortProgramId != 0)
+    {
+        _updatesSinceSort++;
+    }
+
+    // the program is left in use instead of unbinding it; the next pass to want a program 
+    // binds its own, and the state cache skips the bind when it is this one again (see 
+    // GlStateCache.h)
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Waits until the GPU is done with the last frame that used the next frame's part of the 
+    parameter buffer.  The caller fills in that part, dispatches, and then fences it and 
+    advances _parameterFrameIndex.
+
+    Note: With 3 frames in flight, this almost never actually waits, and when it does, the 
+    stall is counted (see GlFenceRing::AcquireSlot()).
+Parameters: None
+Returns:
+    The frame slot of the parameter buffer that is now free to write.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleManager::AcquireParameterFrameSlot()
+{
+    return _parameterFenceRing.AcquireSlot();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Changes the size of the particle pool without re-creating anything else.  The programs, 
+    the VAO, the parameter ring, and the readback rings are kept, and nothing is generated on 
+    the CPU.
+
+    The pool grows and shrinks at the end, so the change goes to the last emitter (for a 
+    manager with one emitter, that is the whole pool).  Each particle buffer is replaced by a 
+    new immutable buffer of the new size, the particles that are kept are copied across with 
+    glCopyBufferSubData(...), and only the new tail is zeroed.  The VAO's vertex buffer 
+    bindings are pointed at the new buffers in place.
+
+    The last emitter's dead stack is rebuilt on the GPU from its particles' "is active" flags 
+    (see RebuildDeadStack() in shaderParticle.comp), which works the same way whether the pool 
+    grew (the new, inactive particles are pushed) or shrank (indices past the end are gone).
+    Particles that were alive past the new end are simply dropped.
+
+    Note: Must be called between frames, not between UpdateSteps(...) and Render(...).
+Parameters:
+    newParticleCount    Must leave the last emitter at least one particle.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::Resize(unsigned int newParticleCount)
+{
+    if (_simulationBackend != PARTICLE_SIMULATION_BACKEND_GPU)
+    {
+        LogPrintf("Resize(...) isn't supported by the CPU or split particle backends\n");
+        return;
+    }
+    if (_mappedParameters == 0 || _emitters.empty())
+    {
+        return;
+    }
+
+    unsigned int lastEmitterIndex = (unsigned int)_emitters.size() - 1;
+    ParticleEmitter &lastEmitter = _emitters[lastEmitterIndex];
+    if (newParticleCount <= lastEmitter._firstParticle)
+    {
+        LogPrintf("can't resize to %u particles; the last emitter starts at particle %u\n", 
+            newParticleCount, lastEmitter._firstParticle);
+        return;
+    }
+    if (newParticleCount == _maxParticleCount)
+    {
+        return;
+    }
+
+    unsigned int maxPoolParticleCount = GetMaxPoolParticleCount(_layout);
+    if (newParticleCount > maxPoolParticleCount)
+    {
+        LogErrorPrintf("can't resize to %u particles; the most that one buffer can address "
+            "is %u\n", newParticleCount, maxPoolParticleCount);
+        return;
+    }
+
+    // the new buffers are made before the old ones go, so for a moment there are both
+    unsigned long long estimatedBytes = EstimateGpuMemory(newParticleCount, _layout);
+    if (newParticleCount > _maxParticleCount && WouldExceedGpuMemoryBudget(estimatedBytes))
+    {
+        LogErrorPrintf("can't resize to %u particles; another %.1fMB won't fit in the GPU "
+            "memory budget\n", newParticleCount, estimatedBytes / (1024.0 * 1024.0));
+        return;
+    }
+
+    // the copies below read what the last update's shader wrote, and the barrier at the end of
+    // UpdateSteps(...) (GL_BUFFER_UPDATE_BARRIER_BIT) already covers that
+    unsigned int keptParticleCount = 
+        (newParticleCount < _maxParticleCount) ? newParticleCount : _maxParticleCount;
+
+    // the VAO's attributes are re-pointed with the separate vertex buffer binding API
+    // Note: glVertexAttribPointer(...) is defined as setting the attribute's format, binding 
+    // the attribute to the binding point with the same index, and binding the buffer there with
+    // the pointer as the offset, so the offset and stride can be read back from the binding 
+    // point and only the buffer needs replacing.
+    BindGlVertexArray(_vaoId);
+    GLint attributeBufferIds[3] = { 0, 0, 0 };
+    for (GLuint attributeIndex = 0; attributeIndex < 3; attributeIndex++)
+    {
+        glGetVertexAttribiv(attributeIndex, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, 
+            &attributeBufferIds[attributeIndex]);
+    }
+
+    for (unsigned int bufferIndex = 0; bufferIndex < _particleBufferCount; bufferIndex++)
+    {
+        unsigned int stride = this->GetParticleBufferStride(bufferIndex);
+        GLuint oldBufferId = _particleBufferIds[bufferIndex];
+        GlBuffer newBuffer = GenerateGlBuffer();
+        GLuint newBufferId = newBuffer;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, newBufferId);
+        LabelGlObject(GL_BUFFER, newBufferId, "particles");
+        this->AllocateParticleBuffer(bufferIndex, (size_t)newParticleCount * stride, 
+            (size_t)keptParticleCount * stride);
+
+        glBindBuffer(GL_COPY_READ_BUFFER, oldBufferId);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_SHADER_STORAGE_BUFFER, 0, 0, 
+            (GLsizeiptr)keptParticleCount * stride);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        BindGlShaderStorageBuffer(bufferIndex, newBufferId);
+
+        for (GLuint attributeIndex = 0; attributeIndex < 3; attributeIndex++)
+        {
+            if ((GLuint)attributeBufferIds[attributeIndex] == oldBufferId)
+            {
+                GLint64 offset = 0;
+                GLint bindingStride = 0;
+                glGetInteger64i_v(GL_VERTEX_BINDING_OFFSET, attributeIndex, &offset);
+                glGetIntegeri_v(GL_VERTEX_BINDING_STRIDE, attributeIndex, &bindingStride);
+                glBindVertexBuffer(attributeIndex, newBufferId, (GLintptr)offset, bindingStride);
+            }
+        }
+
+        // the driver keeps the old storage around until the GPU is done with it
+        _particleBufferIds[bufferIndex] = std::move(newBuffer);
+    }
+    BindGlVertexArray(0);
+
+    // the render copies are made again at the new size by the next update
+    this->ReleaseRenderCopies();
+
+    // the live indices are rebuilt every update, so the contents don't need to be kept
+    // Note: Re-specifying the storage of the same buffer keeps it bound to the shader storage 
+    // binding point, to the VAO's element array binding, and to the quad particle index 
+    // attribute.
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _liveIndexBufferId);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, newParticleCount * sizeof(GLuint), 0, GL_DYNAMIC_COPY);
+    RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particle live indices");
+
+    // so are the update lists, which are rebuilt after the dead stack (see RebuildDeadStacks(...))
+    for (unsigned int listIndex = 0; listIndex < 2; listIndex++)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, _updateListBufferIds[listIndex]);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, 
+            sizeof(UpdateListHeader) + (newParticleCount * sizeof(GLuint)), 0, GL_DYNAMIC_COPY);
+        RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particle update list");
+    }
+
+    // and the active mask, which is rebuilt along with the dead stack
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _activeMaskBufferId);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, ((newParticleCount + 31) / 32) * sizeof(GLuint), 0, 
+        GL_DYNAMIC_COPY);
+    RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particle active mask");
+
+    // the other emitters' dead stacks are kept as-is, and the last emitter's is rebuilt below
+    GlBuffer newDeadIndexBuffer = GenerateGlBuffer();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, newDeadIndexBuffer);
+    LabelGlObject(GL_BUFFER, newDeadIndexBuffer, "particle dead indices");
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, newParticleCount * sizeof(GLuint), 0, 0);
+    RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particle dead indices");
+    if (lastEmitter._firstParticle > 0)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, _deadIndexBufferId);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_SHADER_STORAGE_BUFFER, 0, 0, 
+            lastEmitter._firstParticle * sizeof(GLuint));
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+    _deadIndexBufferId = std::move(newDeadIndexBuffer);
+    BindGlShaderStorageBuffer(DEAD_INDEX_BUFFER_BINDING, _deadIndexBufferId);
+
+    lastEmitter._particleCount = newParticleCount - lastEmitter._firstParticle;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _emitterBufferId);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, lastEmitterIndex * sizeof(ParticleEmitter), 
+        sizeof(ParticleEmitter), &lastEmitter);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    _pendingTableUploadBytes += sizeof(ParticleEmitter);
+
+    // a sparse pool's new tail has memory behind it now that the last emitter covers it
+    _maxParticleCount = newParticleCount;
+    this->UpdateParticlePageCommitment();
+    this->RebuildDeadStacks(lastEmitterIndex, 1);
+
+    // the ID tables are sized for the pool, and the particles that are kept may have IDs past 
+    // the new end, so the IDs start over
+    if (_particleIdBufferId != 0)
+    {
+        this->InitParticleIds();
+    }
+
+    // a readback range past the new end can't be copied any more
+    if (_readbackBufferId != 0 && 
+        _readbackRequest._firstParticle + _readbackRequest._particleCount > _maxParticleCount)
+    {
+        LogPrintf("particle readback range is past the resized pool; readback stopped\n");
+        this->ClearParticleReadback();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Switches to a rebuilt program (see ShaderHotReload.h).  If the old program is this 
+    manager's render or compute program, this takes a reference to the new one, releases the 
+    old one, and looks up the uniforms and work group size again, since any of them may have 
+    changed.  The buffers are bound by binding point, so nothing else needs to change.
+
+    Note: Must be called between frames, not between UpdateSteps(...) and Render(...).
+Parameters:
+    oldProgramId    Self-explanatory.  Programs that this manager doesn't use are ignored.
+    newProgramId    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId)
+{
+    if (oldProgramId == 0 || newProgramId == 0)
+    {
+        return;
+    }
+
+    bool isReplaced = false;
+    if (_programId == oldProgramId)
+    {
+        _programId = ReferenceGlProgram(newProgramId);
+        isReplaced = true;
+    }
+    if (_computeProgramId == oldProgramId)
+    {
+        _computeProgramId = ReferenceGlProgram(newProgramId);
+        isReplaced = true;
+    }
+
+    if (_sortProgramId != 0 && _sortProgramId == oldProgramId)
+    {
+        _sortProgramId = ReferenceGlProgram(newProgramId);
+        this->LoadSortProgramInterface();
+    }
+
+    if (isReplaced)
+    {
+        this->LoadProgramInterfaces();
+        BindGlVertexArray(_vaoId);
+        this->ApplyVertexPulling();
+        for (unsigned int copyIndex = 0; copyIndex < 2; copyIndex++)
+        {
+            if (_renderCopyVaoIds[copyIndex] != 0)
+            {
+                BindGlVertexArray(_renderCopyVaoIds[copyIndex]);
+                this->ApplyVertexPulling();
+            }
+        }
+        BindGlVertexArray(0);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Empties the dead stacks of a run of emitters and has the compute program push every 
+    inactive particle of those emitters back on (see RebuildDeadStack() in 
+    shaderParticle.comp).  One dispatch covers every emitter in the run, with a row of work 
+    groups per emitter, just like the emit pass.  Used whenever emitters' ranges change.
+Parameters:
+    firstEmitterIndex   Self-explanatory.
+    emitterCount        Self-explanatory.  0 does nothing.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::RebuildDeadStacks(unsigned int firstEmitterIndex, unsigned int emitterCount)
+{
+    if (emitterCount == 0)
+    {
+        return;
+    }
+
+    // whatever changed the dead stacks changed which particles are alive too, so the next 
+    // update builds a new update list (see SetLiveUpdateList(...)), and the rebuild pass 
+    // finds the dead particles with the active mask
+    _isUpdateListStale = true;
+    this->RebuildActiveMask();
+
+    // the new stacks start empty and the rebuild pass pushes onto them
+    GLint zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _deadCountBufferId);
+    glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32I, firstEmitterIndex * sizeof(GLint), 
+        emitterCount * sizeof(GLint), GL_RED_INTEGER, GL_INT, &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    unsigned int largestEmitter = 0;
+    for (unsigned int emitterOffset = 0; emitterOffset < emitterCount; emitterOffset++)
+    {
+        unsigned int particleCount = _emitters[firstEmitterIndex + emitterOffset]._particleCount;
+        largestEmitter = (particleCount > largestEmitter) ? particleCount : largestEmitter;
+    }
+
+    // the rebuild is a pass of the compute program like any other, so it takes a frame slot 
+    // of the parameter ring
+    unsigned int frameSlot = this->AcquireParameterFrameSlot();
+    SimulationParameters parameters;
+    parameters._deltaTimeSec = 0.0f;
+    parameters._maxParticleCount = _maxParticleCount;
+    parameters._emitterCount = (unsigned int)_emitters.size();
+    parameters._randomSeed = _stepCounter;
+    parameters._frameIndex = _parameterFrameIndex;
+    parameters._passType = SIMULATION_PASS_REBUILD_DEAD_STACK;
+    parameters._rebuildEmitterIndex = firstEmitterIndex;
+    parameters._forceFieldCount = (unsigned int)_forceFields.size();
+    parameters._substepCount = 1;
+    parameters._updateParticleEnd = _maxParticleCount;
+    parameters._cpuEmittedCount = 0;
+    parameters._isDeterministic = _isDeterministic ? 1 : 0;
+    parameters._emitStepIndex = _emitStepCounter;
+    parameters._simulationTimeSec = (float)_simulationTimeSec;
+    parameters._emitSpanSec = 0.0f;
+    parameters._isSubFrameEmission = 0;
+    SetPointerParameters(_pointerInput, _pointerEmitterIndex, &parameters);
+    unsigned int blockOffset = (frameSlot * PARAMETER_BLOCKS_PER_FRAME) * _parameterBlockStride;
+    memcpy((unsigned char *)_mappedParameters + blockOffset, &parameters, sizeof(parameters));
+
+    GlDebugGroup rebuildGroup("ParticleManager rebuild dead stacks");
+    UseGlProgram(_computeProgramId);
+    glBindBufferRange(GL_UNIFORM_BUFFER, PARAMETER_BLOCK_BINDING, _parameterBufferId, 
+        blockOffset, sizeof(parameters));
+    if (largestEmitter > 0)
+    {
+        GLuint numWorkGroupsX = ClampComputeDispatchSizeX(
+            (largestEmitter + _workGroupSizeX - 1) / _workGroupSizeX);
+        glDispatchCompute(numWorkGroupsX, emitterCount, 1);
+    }
+    _parameterFenceRing.FenceSlot(frameSlot);
+    _parameterFrameIndex++;
+
+    // the next emit pass pops from the rebuilt stacks
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets every bit of the active mask from the particles' "is active" flags (see 
+    RebuildActiveMask() in shaderParticle.comp).  The emit pass and the update keep the mask 
+    up to date as particles come and go, so this is only needed when something else changed 
+    the particles: a copy between ranges or a resize (through RebuildDeadStacks(...)), a 
+    snapshot, or a sort.
+
+    Note: The mask is only for the compute program's passes, so the CPU backend doesn't keep 
+    it, and the split backend's last pass updates the bits of the CPU's particles.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::RebuildActiveMask()
+{
+    if (_computeProgramId == 0 || _mappedParameters == 0 || _activeMaskBufferId == 0)
+    {
+        return;
+    }
+
+    // like the dead stack rebuild, this takes a frame slot of the parameter ring
+    unsigned int frameSlot = this->AcquireParameterFrameSlot();
+    SimulationParameters parameters;
+    parameters._deltaTimeSec = 0.0f;
+    parameters._maxParticleCount = _maxParticleCount;
+    parameters._emitterCount = (unsigned int)_emitters.size();
+    parameters._randomSeed = _stepCounter;
+    parameters._frameIndex = _parameterFrameIndex;
+    parameters._passType = SIMULATION_PASS_REBUILD_ACTIVE_MASK;
+    parameters._rebuildEmitterIndex = 0;
+    parameters._forceFieldCount = (unsigned int)_forceFields.size();
+    parameters._substepCount = 1;
+    parameters._updateParticleEnd = _maxParticleCount;
+    parameters._cpuEmittedCount = 0;
+    parameters._isDeterministic = _isDeterministic ? 1 : 0;
+    parameters._emitStepIndex = _emitStepCounter;
+    parameters._simulationTimeSec = (float)_simulationTimeSec;
+    parameters._emitSpanSec = 0.0f;
+    parameters._isSubFrameEmission = 0;
+    SetPointerParameters(_pointerInput, _pointerEmitterIndex, &parameters);
+    parameters._updateListMode = UPDATE_LIST_OFF;
+    parameters._updateListParticlesPerWorkGroup = _workGroupSizeX;
+    parameters._updateListMaxWorkGroups = 1;
+    parameters._persistentEmitChunks = 0;
+    unsigned int blockOffset = (frameSlot * PARAMETER_BLOCKS_PER_FRAME) * _parameterBlockStride;
+    memcpy((unsigned char *)_mappedParameters + blockOffset, &parameters, sizeof(parameters));
+
+    // the particles may have just been copied in by GL commands, and those are done before the
+    // dispatch reads them, but an update or a sort's writes need the barrier
+    GlDebugGroup rebuildGroup("ParticleManager rebuild active mask");
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    UseGlProgram(_computeProgramId);
+    glBindBufferRange(GL_UNIFORM_BUFFER, PARAMETER_BLOCK_BINDING, _parameterBufferId, 
+        blockOffset, sizeof(parameters));
+    GLuint wordCount = (_maxParticleCount + 31) / 32;
+    GLuint numWorkGroupsX = ClampComputeDispatchSizeX(
+        (wordCount + _workGroupSizeX - 1) / _workGroupSizeX);
+    glDispatchCompute(numWorkGroupsX, 1, 1);
+    _parameterFenceRing.FenceSlot(frameSlot);
+    _parameterFrameIndex++;
+
+    // the next pass reads the mask
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // whatever moved the particles around moved them out from under their sleep flags
+    this->WakeAllParticles();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets aside room in the pool, the emitter table, and the draw commands so that 
+    SetEmitterTable(...) can lay out different emitters later without creating any buffers.  
+    Must be called before Init(...) to have any effect.  By default, there is exactly enough 
+    room for what Init(...) is given.
+
+    Note: The update pass covers the whole pool, unused parts included.  Unused particles are 
+    inactive, so each one costs a load and nothing else.
+Parameters:
+    particleCapacity    The size of the pool.  At least the emitters given to Init(...).
+    emitterCapacity     The most emitters there will ever be at once.
+    drawGroupCapacity   The most draw groups there will ever be at once.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetPoolCapacity(unsigned int particleCapacity, 
+    unsigned int emitterCapacity, unsigned int drawGroupCapacity)
+{
+    _poolParticleCapacity = particleCapacity;
+    _emitterCapacity = emitterCapacity;
+    _drawGroupCapacity = drawGroupCapacity;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Replaces every emitter and draw group at once, with the emitters at the ranges of the pool
+    that the caller chose (ex: by a ParticleArena).  The ranges may leave gaps.  The particles
+    themselves are left alone, so the caller clears or moves them beforehand (see 
+    ClearParticleRange(...) and MoveParticleRange(...)), and then every dead stack is rebuilt 
+    from the particles' flags in one dispatch.  Nothing is created or deleted, only uploaded 
+    into the room that SetPoolCapacity(...) set aside.
+
+    Draw group styles and visibility go back to their defaults because the groups may not be 
+    the same groups any more.
+
+    Note: Must be called between frames, not between UpdateSteps(...) and Render(...).  The 
+    live counts are read back a couple of updates late, so GetDrawGroupLiveCount(...) may 
+    report the old groups' counts for that long.
+Parameters:
+    emitters        Sorted by first particle, not overlapping, and within the pool, with 
+                    their "first particle" filled in.  The particles in the gaps must be 
+                    inactive.  If there are none, a single idle emitter with no particles 
+                    takes their place so that the shader always has an emitter to find.
+    firstEmitterOfEachGroup     See SetDrawGroups(...).
+Returns:
+    True if the table was replaced, otherwise false (and nothing changed).
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleManager::SetEmitterTable(const std::vector<ParticleEmitter> &emitters, 
+    const std::vector<unsigned int> &firstEmitterOfEachGroup)
+{
+    if (_mappedParameters == 0)
+    {
+        return false;
+    }
+    if (_simulationBackend != PARTICLE_SIMULATION_BACKEND_GPU)
+    {
+        LogPrintf("SetEmitterTable(...) isn't supported by the CPU or split particle backends\n");
+        return false;
+    }
+    if (emitters.size() > _emitterCapacity)
+    {
+        LogPrintf("%u emitters won't fit the emitter capacity of %u\n", 
+            (unsigned int)emitters.size(), _emitterCapacity);
+        return false;
+    }
+    unsigned int previousEnd = 0;
+    for (size_t emitterIndex = 0; emitterIndex < emitters.size(); emitterIndex++)
+    {
+        const ParticleEmitter &emitter = emitters[emitterIndex];
+        if (emitter._firstParticle < previousEnd || 
+            emitter._firstParticle + emitter._particleCount > _maxParticleCount)
+        {
+            LogPrintf("emitter %u's range overlaps another emitter or is outside the pool\n", 
+                (unsigned int)emitterIndex);
+            return false;
+        }
+        previousEnd = emitter._firstParticle + emitter._particleCount;
+    }
+
+    if (emitters.empty())
+    {
+        ParticleEmitter idleEmitter;
+        idleEmitter._center = glm::vec2(0.0f, 0.0f);
+        idleEmitter._radius = 0.0f;
+        idleEmitter._velocityMin = 0.0f;
+        idleEmitter._velocityMax = 0.0f;
+        idleEmitter._maxParticlesEmittedPerFrame = 0;
+        idleEmitter._particleCount = 0;
+        idleEmitter._firstParticle = 0;
+        idleEmitter._lifetimeSec = 0.0f;
+        idleEmitter._spawnShape = PARTICLE_SPAWN_DISK;
+        _emitters.assign(1, idleEmitter);
+        _drawGroupFirstEmitters.assign(1, 0);
+    }
+    else
+    {
+        _emitters = emitters;
+        _drawGroupFirstEmitters = firstEmitterOfEachGroup;
+    }
+    _maxEmitterQuota = this->GetMaxEmitterQuota();
+    this->InitDrawGroups();
+
+    // the whole table went up, so nothing that was marked before is left to upload
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _emitterBufferId);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, _emitters.size() * sizeof(ParticleEmitter), 
+        _emitters.data());
+    _pendingTableUploadBytes += (unsigned int)(_emitters.size() * sizeof(ParticleEmitter));
+    _dirtyEmitterFirst = 0;
+    _dirtyEmitterEnd = 0;
+
+    // the next update rewrites the commands anyway, but Render() before then must not use 
+    // the old groups' ranges
+    DrawCommandBufferHeader drawCommandHeader = { 0, (unsigned int)_drawGroupLiveCounts.size() };
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _drawCommandBufferId);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(drawCommandHeader), &drawCommandHeader);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(drawCommandHeader), 
+        _drawCommandResetData.size() * sizeof(GLuint), _drawCommandResetData.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, _drawGroupStyleBufferId);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, _drawGroupStyles.size() * sizeof(glm::vec2), 
+        _drawGroupStyles.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // a sparse pool follows the new ranges before their dead stacks are read from them
+    this->UpdateParticlePageCommitment();
+    this->RebuildDeadStacks(0, (unsigned int)_emitters.size());
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Zeroes a range of every particle buffer, which makes those particles inactive.  Used when a
+    range of the pool stops belonging to an emitter, so that nothing is left alive in it.
+Parameters:
+    firstParticle   Self-explanatory.
+    particleCount   Clamped to the pool.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::ClearParticleRange(unsigned int firstParticle, unsigned int particleCount)
+{
+    if (_simulationBackend != PARTICLE_SIMULATION_BACKEND_GPU)
+    {
+        LogPrintf("ClearParticleRange(...) isn't supported by the CPU or split particle "
+            "backends\n");
+        return;
+    }
+    if (firstParticle >= _maxParticleCount)
+    {
+        return;
+    }
+    if (particleCount > _maxParticleCount - firstParticle)
+    {
+        particleCount = _maxParticleCount - firstParticle;
+    }
+
+    GLuint zero = 0;
+    for (unsigned int bufferIndex = 0; bufferIndex < _particleBufferCount; bufferIndex++)
+    {
+        size_t stride = this->GetParticleBufferStride(bufferIndex);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, _particleBufferIds[bufferIndex]);
+        glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, firstParticle * stride, 
+            particleCount * stride, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Copies a range of particles to another place in the pool, in every particle buffer.  The 
+    ranges may overlap.  glCopyBufferSubData(...) doesn't allow overlapping copies within one 
+    buffer, so an overlapping move is done in chunks no bigger than the distance moved, in 
+    the order that doesn't overwrite anything before it has been copied (front to back when 
+    moving down, like memmove(...)).  Nothing is allocated.
+
+    The source range is left as it was, and the dead stacks still refer to the old indices, so
+    the caller follows this with ClearParticleRange(...) on whatever the source range no longer
+    shares with anything and SetEmitterTable(...) with the new ranges.
+Parameters:
+    sourceFirst         Self-explanatory.
+    destinationFirst    Self-explanatory.
+    particleCount       Both ranges must be within the pool.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::MoveParticleRange(unsigned int sourceFirst, unsigned int destinationFirst,
+    unsigned int particleCount)
+{
+    if (sourceFirst == destinationFirst || particleCount == 0)
+    {
+        return;
+    }
+    if (_simulationBackend != PARTICLE_SIMULATION_BACKEND_GPU)
+    {
+        LogPrintf("MoveParticleRange(...) isn't supported by the CPU or split particle backends\n");
+        return;
+    }
+    if (sourceFirst + particleCount > _maxParticleCount || 
+        destinationFirst + particleCount > _maxParticleCount)
+    {
+        LogPrintf("can't move particles outside of the pool\n");
+        return;
+    }
+
+    // a sparse pool's destination may not have had memory behind it yet
+    this->CommitParticlePages(destinationFirst, particleCount);
+
+    bool movingDown = destinationFirst < sourceFirst;
+    unsigned int distance = movingDown ? 
+        (sourceFirst - destinationFirst) : (destinationFirst - sourceFirst);
+    unsigned int chunkSize = (distance < particleCount) ? distance : particleCount;
+    unsigned int chunkCount = (particleCount + chunkSize - 1) / chunkSize;
+
+    // the copies read what the last update's shader wrote, and the barrier at the end of 
+    // UpdateSteps(...) (GL_BUFFER_UPDATE_BARRIER_BIT) already covers that
+    for (unsigned int bufferIndex = 0; bufferIndex < _particleBufferCount; bufferIndex++)
+    {
+        GLintptr stride = this->GetParticleBufferStride(bufferIndex);
+        glBindBuffer(GL_COPY_READ_BUFFER, _particleBufferIds[bufferIndex]);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, _particleBufferIds[bufferIndex]);
+        for (unsigned int chunkIndex = 0; chunkIndex < chunkCount; chunkIndex++)
+        {
+            // front to back when moving down, back to front when moving up
+            unsigned int chunkOffset = movingDown ? 
+                (chunkIndex * chunkSize) : ((chunkCount - 1 - chunkIndex) * chunkSize);
+            unsigned int thisChunk = particleCount - chunkOffset;
+            thisChunk = (thisChunk < chunkSize) ? thisChunk : chunkSize;
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 
+                (sourceFirst + chunkOffset) * stride, (destinationFirst + chunkOffset) * stride, 
+                thisChunk * stride);
+        }
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Collects the counts from any readback slots that the GPU has finished with, then copies this
+    update's counts into the next slot and fences it.  The copy comes after the barrier at the 
+    end of the update (GL_BUFFER_UPDATE_BARRIER_BIT covers copies), so it sees the shader's 
+    writes.
+
+    If the slot that is about to be reused still hasn't signaled, then the GPU is more than 
+    COUNT_READBACK_SLOTS updates behind, and that slot's counts are skipped rather than waited 
+    on.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-14-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::CopyCountsForReadback()
+{
+    if (_mappedCountReadback == 0)
+    {
+        return;
+    }
+
+    // oldest first so that the latest counts are the newest that are ready
+    for (unsigned int slotOffset = 0; slotOffset < COUNT_READBACK_SLOTS; slotOffset++)
+    {
+        unsigned int slotIndex = (_countReadbackIndex + slotOffset) % COUNT_READBACK_SLOTS;
+        if (_countReadbackFences[slotIndex] == 0)
+        {
+            continue;
+        }
+
+        if (IsGlFenceSignaled(_countReadbackFences[slotIndex]))
+        {
+            const unsigned char *slotBytes = (const unsigned char *)_mappedCountReadback + 
+                (slotIndex * _countReadbackSlotSizeBytes);
+            const DrawCommandBufferHeader *slotHeader = 
+                (const DrawCommandBufferHeader *)slotBytes;
+            const DrawElementsIndirectCommand *slotCommands = 
+                (const DrawElementsIndirectCommand *)(slotBytes + sizeof(DrawCommandBufferHeader));
+            _latestLiveCount = 0;
+            for (size_t groupIndex = 0; groupIndex < _drawGroupLiveCounts.size(); groupIndex++)
+            {
+                _drawGroupLiveCounts[groupIndex] = slotCommands[groupIndex]._count;
+                _latestLiveCount += slotCommands[groupIndex]._count;
+
+                // a group that was culled has no instances even though it isn't hidden (see 
+                // SetDrawGroupCulling(...)), and the clock keeps running until it isn't
+                const DrawElementsIndirectCommand *resetCommand = 
+                    (const DrawElementsIndirectCommand *)&_drawCommandResetData[
+                    groupIndex * (sizeof(DrawElementsIndirectCommand) / sizeof(GLuint))];
+                bool isCulled = _isDrawGroupCulled && resetCommand->_instanceCount > 0 && 
+                    slotCommands[groupIndex]._instanceCount == 0;
+                if (!isCulled)
+                {
+                    _drawGroupCulledSinceSec[groupIndex] = -1.0;
+                }
+                else if (_drawGroupCulledSinceSec[groupIndex] < 0.0)
+                {
+                    _drawGroupCulledSinceSec[groupIndex] = _simulationTimeSec;
+                }
+            }
+            _latestEmittedCount = slotHeader->_emittedCount;
+            _countReadbackFences[slotIndex].Reset();
+        }
+    }
+
+    unsigned int slotIndex = _countReadbackIndex;
+    _countReadbackFences[slotIndex].Reset();
+
+    glBindBuffer(GL_COPY_READ_BUFFER, _drawCommandBufferId);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, _countReadbackBufferId);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 
+        slotIndex * _countReadbackSlotSizeBytes, _countReadbackSlotSizeBytes);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    _countReadbackFences[slotIndex] = InsertGlFence();
+    _countReadbackIndex = (_countReadbackIndex + 1) % COUNT_READBACK_SLOTS;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gets the most recent live particle count and emitted count that the GPU has finished.  
+    These lag a couple of updates behind, but reading them never stalls.
+Parameters:
+    putLiveCountHere        The number of particles drawn at the end of that update, every 
+                            draw group together.
+    putEmittedCountHere     The number of particles emitted in that update.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-14-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::GetParticleCounts(unsigned int *putLiveCountHere, 
+    unsigned int *putEmittedCountHere) const
+{
+    *putLiveCountHere = _latestLiveCount;
+    *putEmittedCountHere = _latestEmittedCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Starts copying a range of the particles back to the CPU after every so many updates and 
+    handing each copy to the callback once the GPU has finished it.  Replaces any readback that
+    was already set up.  Must be called after Init(...).
+
+    Like the count readback, this is a ring of persistently mapped staging slots with a fence 
+    each.  glCopyBufferSubData(...) copies the range of each particle buffer into a slot on the
+    GPU's timeline, and the callback is only run for a slot after its fence has signaled, 
+    which is normally 2 or 3 updates later.  Nothing ever waits on the GPU.  If every slot is 
+    still in flight when the next readback is due, that readback is skipped and counted (see 
+    GetSkippedReadbackCount()).
+
+    The callback is run from within UpdateSteps(...).
+Parameters:
+    request     The range is clamped to the pool.
+    callback    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetParticleReadback(const ParticleReadbackRequest &request, 
+    const ParticleReadbackCallback &callback)
+{
+    this->ClearParticleReadback();
+
+    unsigned int numParticles = _maxParticleCount;
+    if (request._firstParticle >= numParticles || !callback)
+    {
+        LogPrintf("particle readback: nothing to read\n");
+        return;
+    }
+
+    _readbackRequest = request;
+    unsigned int maxCount = numParticles - request._firstParticle;
+    if (_readbackRequest._particleCount == 0 || _readbackRequest._particleCount > maxCount)
+    {
+        _readbackRequest._particleCount = maxCount;
+    }
+    if (_readbackRequest._updatesBetweenReadbacks == 0)
+    {
+        _readbackRequest._updatesBetweenReadbacks = 1;
+    }
+    _readbackCallback = callback;
+
+    static_assert(MAX_PARTICLE_BUFFERS == PARTICLE_READBACK_MAX_BUFFERS, 
+        "ParticleReadbackFrame must have room for every particle buffer");
+
+    // pack the range of every particle buffer into each slot
+    // Note: Each range starts on a 16-byte boundary so that the CPU can read the vec2s without
+    // any misaligned loads.
+    _readbackSlotSizeBytes = 0;
+    for (unsigned int bufferIndex = 0; bufferIndex < _particleBufferCount; bufferIndex++)
+    {
+        _readbackOffsets[bufferIndex] = _readbackSlotSizeBytes;
+        size_t rangeSizeBytes = 
+            (size_t)_readbackRequest._particleCount * this->GetParticleBufferStride(bufferIndex);
+        _readbackSlotSizeBytes += (rangeSizeBytes + 15) & ~(size_t)15;
+    }
+
+    // the IDs go at the end of the slot
+    _isReadingBackIds = (_particleIdBufferId != 0);
+    _readbackIdOffset = _readbackSlotSizeBytes;
+    if (_isReadingBackIds)
+    {
+        size_t idRangeSizeBytes = (size_t)_readbackRequest._particleCount * sizeof(GLuint);
+        _readbackSlotSizeBytes += (idRangeSizeBytes + 15) & ~(size_t)15;
+    }
+
+    GLbitfield storageFlags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    GLsizeiptr bufferSize = PARTICLE_READBACK_SLOTS * _readbackSlotSizeBytes;
+    _readbackBufferId = GenerateGlBuffer();
+    glBindBuffer(GL_COPY_WRITE_BUFFER, _readbackBufferId);
+    LabelGlObject(GL_BUFFER, _readbackBufferId, "particle readback");
+    glBufferStorage(GL_COPY_WRITE_BUFFER, bufferSize, 0, storageFlags);
+    RecordBoundGlBufferAllocation(GL_COPY_WRITE_BUFFER, "particle readback");
+    _mappedReadback = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, bufferSize, storageFlags);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    _readbackIndex = 0;
+    _updatesSinceReadback = 0;
+    _skippedReadbacks = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Stops the particle readback and deletes its staging buffer.  Copies that are still in 
+    flight are dropped without running the callback.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::ClearParticleReadback()
+{
+    for (unsigned int slotIndex = 0; slotIndex < PARTICLE_READBACK_SLOTS; slotIndex++)
+    {
+        _readbackFences[slotIndex].Reset();
+    }
+    _readbackBufferId.Reset();
+    _mappedReadback = 0;
+    _readbackCallback = ParticleReadbackCallback();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How many particle readbacks were skipped because every staging slot was still in flight.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleManager::GetSkippedReadbackCount() const
+{
+    return (_readbackBufferId == 0) ? 0 : _skippedReadbacks;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How many bytes of the emitter and force field tables were uploaded for the last update, 
+    which includes the whole-table uploads between it and the one before (ex: 
+    SetEmitterTable(...)).  0 when nothing changed.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleManager::GetTableUploadBytes() const
+{
+    return _lastTableUploadBytes;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Runs the readback callback for any slots that the GPU has finished with, then, if a readback
+    is due, copies the requested range into the next slot and fences it.  Like 
+    CopyCountsForReadback(), this comes after the barrier at the end of the update, so the copy
+    sees the shader's writes.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::CopyParticlesForReadback()
+{
+    if (_mappedReadback == 0)
+    {
+        return;
+    }
+
+    // oldest first so that the callback sees the updates in order
+    for (unsigned int slotOffset = 0; slotOffset < PARTICLE_READBACK_SLOTS; slotOffset++)
+    {
+        unsigned int slotIndex = (_readbackIndex + slotOffset) % PARTICLE_READBACK_SLOTS;
+        if (_readbackFences[slotIndex] == 0)
+        {
+            continue;
+        }
+
+        if (!IsGlFenceSignaled(_readbackFences[slotIndex]))
+        {
+            // later slots were copied later, so they can't be done either
+            break;
+        }
+        _readbackFences[slotIndex].Reset();
+
+        ParticleReadbackFrame frame;
+        frame._updateIndex = _readbackUpdateIndices[slotIndex];
+        frame._firstParticle = _readbackRequest._firstParticle;
+        frame._particleCount = _readbackRequest._particleCount;
+        frame._layout = _layout;
+        const unsigned char *slotStart = 
+            (const unsigned char *)_mappedReadback + (slotIndex * _readbackSlotSizeBytes);
+        for (unsigned int bufferIndex = 0; bufferIndex < PARTICLE_READBACK_MAX_BUFFERS; 
+            bufferIndex++)
+        {
+            frame._particleData[bufferIndex] = (bufferIndex < _particleBufferCount) ? 
+                slotStart + _readbackOffsets[bufferIndex] : 0;
+        }
+        frame._particleIds = _isReadingBackIds ? 
+            (const unsigned int *)(slotStart + _readbackIdOffset) : 0;
+        TRACE_SCOPE("particle readback callback");
+        _readbackCallback(frame);
+    }
+
+    _updatesSinceReadback++;
+    if (_updatesSinceReadback < _readbackRequest._updatesBetweenReadbacks)
+    {
+        return;
+    }
+    _updatesSinceReadback = 0;
+
+    // a slot that is still in flight hasn't been handed to the callback yet, so it can't be 
+    // overwritten, and waiting on it would stall
+    unsigned int slotIndex = _readbackIndex;
+    if (_readbackFences[slotIndex] != 0)
+    {
+        _skippedReadbacks++;
+        return;
+    }
+
+    GLintptr slotOffset = slotIndex * _readbackSlotSizeBytes;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, _readbackBufferId);
+    for (unsigned int bufferIndex = 0; bufferIndex < _particleBufferCount; bufferIndex++)
+    {
+        unsigned int stride = this->GetParticleBufferStride(bufferIndex);
+        glBindBuffer(GL_COPY_READ_BUFFER, _particleBufferIds[bufferIndex]);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 
+            (GLintptr)_readbackRequest._firstParticle * stride, 
+            slotOffset + _readbackOffsets[bufferIndex], 
+            (GLsizeiptr)_readbackRequest._particleCount * stride);
+    }
+    if (_isReadingBackIds && _particleIdBufferId != 0)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, _particleIdBufferId);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 
+            (GLintptr)_readbackRequest._firstParticle * sizeof(GLuint), 
+            slotOffset + _readbackIdOffset, 
+            (GLsizeiptr)_readbackRequest._particleCount * sizeof(GLuint));
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    _readbackFences[slotIndex] = InsertGlFence();
+    _readbackUpdateIndices[slotIndex] = _parameterFrameIndex;
+    _readbackIndex = (_readbackIndex + 1) % PARTICLE_READBACK_SLOTS;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Starts saving the whole particle state to a file: every particle buffer, the emitter 
+    table, the dead stacks, the sort's ID tables (if the sort is set up), and the compute 
+    shader's next random seed (see ParticleSnapshotHeader).  Loading the file with 
+    LoadSnapshot(...) picks the simulation up where it was.
+
+    The GPU's buffers are copied into a staging buffer that is laid out like the file, and 
+    fenced, so this doesn't wait on anything.  The file is written out by the first 
+    UpdateSteps(...) after the GPU is done with the copy (or by Cleanup(), whichever is first).
+
+    Note: Like CopyParticlesForReadback(), this should come after an update and not in the 
+    middle of one.
+Parameters:
+    filePath    Overwritten if it exists.
+Returns:
+    False if a snapshot is already being saved or the backend isn't the GPU, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleManager::SaveSnapshot(const std::string &filePath)
+{
+    if (_mappedParameters == 0)
+    {
+        return false;
+    }
+    if (_simulationBackend != PARTICLE_SIMULATION_BACKEND_GPU)
+    {
+        LogPrintf("snapshots aren't supported by the CPU or split particle backends\n");
+        return false;
+    }
+    if (_snapshotFence != 0)
+    {
+        LogPrintf("snapshot: '%s' is still being saved\n", _snapshotFilePath.c_str());
+        return false;
+    }
+
+    GLuint sectionBufferIds[PARTICLE_SNAPSHOT_SECTION_COUNT];
+    size_t sectionSizes[PARTICLE_SNAPSHOT_SECTION_COUNT];
+    this->GetSnapshotSections((unsigned int)_emitters.size(), sectionBufferIds, sectionSizes);
+
+    ParticleSnapshotHeader &header = _snapshotHeader;
+    memset(&header, 0, sizeof(header));
+    header._magic = PARTICLE_SNAPSHOT_MAGIC;
+    header._version = PARTICLE_SNAPSHOT_VERSION;
+    header._headerSizeBytes = sizeof(header);
+    header._layout = (unsigned int)_layout;
+    header._particleCount = _maxParticleCount;
+    header._emitterCount = (unsigned int)_emitters.size();
+    header._emitterSizeBytes = sizeof(ParticleEmitter);
+    header._randomSeed = _stepCounter;
+    size_t fileSizeBytes = sizeof(header);
+    for (unsigned int sectionIndex = 0; sectionIndex < PARTICLE_SNAPSHOT_SECTION_COUNT; 
+        sectionIndex++)
+    {
+        fileSizeBytes = (fileSizeBytes + PARTICLE_SNAPSHOT_ALIGNMENT - 1) & 
+            ~(size_t)(PARTICLE_SNAPSHOT_ALIGNMENT - 1);
+        header._sectionOffsets[sectionIndex] = fileSizeBytes;
+        header._sectionSizes[sectionIndex] = sectionSizes[sectionIndex];
+        fileSizeBytes += sectionSizes[sectionIndex];
+    }
+
+    // the update's barrier already covers the copies (see GetUpdateBarrierBits()), but the 
+    // dead stack rebuild's doesn't, and a save may come right after SetEmitterTable(...)
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    GLbitfield storageFlags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    _snapshotBufferId = GenerateGlBuffer();
+    glBindBuffer(GL_COPY_WRITE_BUFFER, _snapshotBufferId);
+    LabelGlObject(GL_BUFFER, _snapshotBufferId, "particle snapshot");
+    glBufferStorage(GL_COPY_WRITE_BUFFER, fileSizeBytes, 0, storageFlags);
+    RecordBoundGlBufferAllocation(GL_COPY_WRITE_BUFFER, "particle snapshot");
+    _mappedSnapshot = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, fileSizeBytes, storageFlags);
+    for (unsigned int sectionIndex = 0; sectionIndex < PARTICLE_SNAPSHOT_SECTION_COUNT; 
+        sectionIndex++)
+    {
+        if (sectionBufferIds[sectionIndex] == 0 || sectionSizes[sectionIndex] == 0)
+        {
+            continue;
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, sectionBufferIds[sectionIndex]);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 
+            (GLintptr)header._sectionOffsets[sectionIndex], 
+            (GLsizeiptr)sectionSizes[sectionIndex]);
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    _snapshotFence = InsertGlFence();
+
+    // the emitters can change before the file is written, so the table is kept as it is now
+    _snapshotFilePath = filePath;
+    _snapshotEmitters = _emitters;
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    True if SaveSnapshot(...) has started a snapshot, and its file hasn't been written yet.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleManager::IsSnapshotPending() const
+{
+    return _snapshotFence != 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Replaces the whole particle state with a snapshot from SaveSnapshot(...).  The file is 
+    memory-mapped (or found in the asset pack) and loaded with LoadSnapshotData(...).
+
+    Note: Touching the mapped pages reads the file on this thread.  A load that mustn't stall 
+    the frame goes through AsyncLoader.h instead, which reads the file on a worker and 
+    uploads it to a staging buffer a piece per frame.
+Parameters:
+    filePath    Self-explanatory.
+Returns:
+    False if the file couldn't be read or doesn't match the manager (the state is untouched),
+    otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleManager::LoadSnapshot(const std::string &filePath)
+{
+    // a snapshot that ships with the demo (ex: a warmed-up scene) can be in the asset pack
+    MappedFile file;
+    const void *fileData = 0;
+    size_t fileSizeBytes = 0;
+    if (!MapAsset(filePath, &file, &fileData, &fileSizeBytes))
+    {
+        return false;
+    }
+    return this->LoadSnapshotData(fileData, fileSizeBytes, 0, filePath);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Checks that a file is a snapshot of this version and copies out its header.  Touches 
+    nothing but the header, so it is safe to call from any thread.
+Parameters:
+    fileData        The whole file.
+    fileSizeBytes   Self-explanatory.
+    filePath        For the log.
+    putHeaderHere   Self-explanatory.
+Returns:
+    False if the file isn't a snapshot of this version, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleManager::ReadSnapshotHeader(const void *fileData, size_t fileSizeBytes, 
+    const std::string &filePath, ParticleSnapshotHeader *putHeaderHere)
+{
+    ParticleSnapshotHeader &header = *putHeaderHere;
+    if (fileSizeBytes < sizeof(header))
+    {
+        LogPrintf("snapshot: '%s' is too small to be a snapshot\n", filePath.c_str());
+        return false;
+    }
+    memcpy(&header, fileData, sizeof(header));
+    if (header._magic != PARTICLE_SNAPSHOT_MAGIC || 
+        header._version != PARTICLE_SNAPSHOT_VERSION || 
+        header._headerSizeBytes != sizeof(header))
+    {
+        LogPrintf("snapshot: '%s' isn't a version %u particle snapshot\n", filePath.c_str(), 
+            PARTICLE_SNAPSHOT_VERSION);
+        return false;
+    }
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Replaces the whole particle state with a snapshot from SaveSnapshot(...) that is already 
+    in memory.  The file goes to the GPU whole as a staging buffer, and its sections are 
+    copied from there into the manager's buffers, so nothing is parsed or converted on the 
+    CPU.  The emitter table is set like SetEmitterTable(...) would, and the draw groups are 
+    kept if the number of emitters is the same (otherwise there is one group).
+
+    The snapshot must be from a manager with the same layout and pool size.  If the sort is 
+    set up and the snapshot doesn't have the ID tables, the IDs start over.
+
+    Note: The draw commands and live indices aren't saved, so there is nothing to draw until 
+    the next update.
+Parameters:
+    mappedData      The whole file (ex: a mapped view).  Only the header and the emitter 
+                    table are read on the CPU.
+    fileSizeBytes   Self-explanatory.
+    stagingBufferId A buffer that already holds the whole file (see AsyncLoader.h), or 0 to 
+                    hand fileData to glBufferStorage(...) here.  The caller still owns it.
+    filePath        For the log.
+Returns:
+    False if the file doesn't match the manager (the state is untouched), otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleManager::LoadSnapshotData(const void *mappedData, size_t fileSizeBytes, 
+    unsigned int stagingBufferId, const std::string &filePath)
+{
+    if (_mappedParameters == 0)
+    {
+        return false;
+    }
+    if (_simulationBackend != PARTICLE_SIMULATION_BACKEND_GPU)
+    {
+        LogPrintf("snapshots aren't supported by the CPU or split particle backends\n");
+        return false;
+    }
+
+    const unsigned char *fileData = (const unsigned char *)mappedData;
+    ParticleSnapshotHeader header;
+    if (!ReadSnapshotHeader(fileData, fileSizeBytes, filePath, &header))
+    {
+        return false;
+    }
+    if (header._layout != (unsigned int)_layout || header._particleCount != _maxParticleCount)
+    {
+        LogPrintf("snapshot: '%s' is %u particles in layout %u, but the pool is %u in layout "
+            "%u\n", filePath.c_str(), header._particleCount, header._layout, _maxParticleCount, 
+            (unsigned int)_layout);
+        return false;
+    }
+    if (header._emitterSizeBytes != sizeof(ParticleEmitter) || header._emitterCount == 0 || 
+        header._emitterCount > _emitterCapacity)
+    {
+        LogPrintf("snapshot: '%s' has %u emitters, and the emitter capacity is %u\n", 
+            filePath.c_str(), header._emitterCount, _emitterCapacity);
+        return false;
+    }
+
+    // every section must be in the file, and every one that this manager has must be the size
+    // that it has here
+    // Note: The ID tables are the exception.  They are only loaded if both sides have them.
+    GLuint sectionBufferIds[PARTICLE_SNAPSHOT_SECTION_COUNT];
+    size_t sectionSizes[PARTICLE_SNAPSHOT_SECTION_COUNT];
+    this->GetSnapshotSections(header._emitterCount, sectionBufferIds, sectionSizes);
+    bool hasParticleIds = (sectionSizes[PARTICLE_SNAPSHOT_SECTION_PARTICLE_IDS] > 0);
+    for (unsigned int sectionIndex = 0; sectionIndex < PARTICLE_SNAPSHOT_SECTION_COUNT; 
+        sectionIndex++)
+    {
+        unsigned long long sectionOffset = header._sectionOffsets[sectionIndex];
+        unsigned long long sectionSize = header._sectionSizes[sectionIndex];
+        bool isIdTable = (sectionIndex == PARTICLE_SNAPSHOT_SECTION_PARTICLE_IDS || 
+            sectionIndex == PARTICLE_SNAPSHOT_SECTION_PARTICLE_SLOTS);
+        if (sectionOffset > fileSizeBytes || sectionSize > fileSizeBytes - sectionOffset)
+        {
+            LogPrintf("snapshot: '%s' is cut short\n", filePath.c_str());
+            return false;
+        }
+        if (isIdTable)
+        {
+            hasParticleIds = hasParticleIds && (sectionSize == sectionSizes[sectionIndex]);
+        }
+        else if (sectionSize != sectionSizes[sectionIndex])
+        {
+            LogPrintf("snapshot: section %u of '%s' is %llu bytes instead of %llu\n", 
+                sectionIndex, filePath.c_str(), sectionSize, 
+                (unsigned long long)sectionSizes[sectionIndex]);
+            return false;
+        }
+    }
+
+    // the emitter table goes through the same checks as any other
+    // Note: This also rebuilds the dead stacks from the particles that are there now, but 
+    // they are replaced below.
+    // Also Note: The section is aligned, so the table can be read in place.
+    const ParticleEmitter *savedEmitters = (const ParticleEmitter *)
+        (fileData + header._sectionOffsets[PARTICLE_SNAPSHOT_SECTION_EMITTERS]);
+    std::vector<ParticleEmitter> emitters(savedEmitters, savedEmitters + header._emitterCount);
+    std::vector<unsigned int> firstEmitterOfEachGroup(1, 0);
+    if (emitters.size() == _emitters.size())
+    {
+        firstEmitterOfEachGroup = _drawGroupFirstEmitters;
+    }
+    if (!this->SetEmitterTable(emitters, firstEmitterOfEachGroup))
+    {
+        return false;
+    }
+
+    // without a staging buffer, the whole file goes to the driver in one go, straight out of 
+    // the mapped view
+    // Note: The copies that overwrite the dead stacks must come after the rebuild pass's 
+    // writes.
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    GLuint ownStagingBufferId = 0;
+    if (stagingBufferId == 0)
+    {
+        glGenBuffers(1, &ownStagingBufferId);
+        glBindBuffer(GL_COPY_READ_BUFFER, ownStagingBufferId);
+        LabelGlObject(GL_BUFFER, ownStagingBufferId, "particle snapshot staging");
+        glBufferStorage(GL_COPY_READ_BUFFER, fileSizeBytes, fileData, 0);
+    }
+    else
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, stagingBufferId);
+    }
+    for (unsigned int sectionIndex = 0; sectionIndex < PARTICLE_SNAPSHOT_SECTION_COUNT; 
+        sectionIndex++)
+    {
+        bool isIdTable = (sectionIndex == PARTICLE_SNAPSHOT_SECTION_PARTICLE_IDS || 
+            sectionIndex == PARTICLE_SNAPSHOT_SECTION_PARTICLE_SLOTS);
+        if (sectionBufferIds[sectionIndex] == 0 || sectionSizes[sectionIndex] == 0 || 
+            (isIdTable && !hasParticleIds))
+        {
+            continue;
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, sectionBufferIds[sectionIndex]);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 
+            (GLintptr)header._sectionOffsets[sectionIndex], 0, 
+            (GLsizeiptr)sectionSizes[sectionIndex]);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    // the driver keeps the staging buffer around until the copies are done
+    if (ownStagingBufferId != 0)
+    {
+        DeleteGlBuffers(1, &ownStagingBufferId);
+    }
+
+    if (_particleIdBufferId != 0 && !hasParticleIds)
+    {
+        this->InitParticleIds();
+    }
+    this->RebuildActiveMask();
+    _stepCounter = header._randomSeed;
+    _areDeadStacksStale = true;
+    LogPrintf("snapshot: loaded %u particles from '%s'\n", header._particleCount, 
+        filePath.c_str());
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.  For sizing a buffer of keyframes (see CaptureKeyframe(...)).
+Parameters: None
+Returns:
+    How many bytes a keyframe of the state as it is now takes, rounded up to 
+    PARTICLE_SNAPSHOT_ALIGNMENT so that keyframes can be laid end to end.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+size_t ParticleManager::GetKeyframeSizeBytes() const
+{
+    ParticleSnapshotHeader header;
+    GLuint sectionBufferIds[PARTICLE_SNAPSHOT_SECTION_COUNT];
+    size_t sizeBytes = this->LayOutKeyframe(0, &header, sectionBufferIds);
+    return (sizeBytes + PARTICLE_SNAPSHOT_ALIGNMENT - 1) & 
+        ~(size_t)(PARTICLE_SNAPSHOT_ALIGNMENT - 1);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Copies the whole particle state, as SaveSnapshot(...) would, into a buffer of the 
+    caller's on the GPU.  Nothing comes back to the CPU and nothing waits, so this is a 
+    handful of glCopyBufferSubData(...) calls that the GPU does in the time that it takes to 
+    copy the pool once.  The emitter table and the counters that the update's randomness 
+    depends on are kept on the CPU, in the keyframe.
+Parameters:
+    bufferId            At least GetKeyframeSizeBytes() past bufferOffset.
+    bufferOffset        A multiple of PARTICLE_SNAPSHOT_ALIGNMENT.
+    putKeyframeHere     Self-explanatory.
+Returns:
+    False if the state can't be captured (ex: the CPU backend), otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleManager::CaptureKeyframe(unsigned int bufferId, size_t bufferOffset, 
+    ParticleKeyframe *putKeyframeHere)
+{
+    if (_mappedParameters == 0 || bufferId == 0 || 
+        _simulationBackend != PARTICLE_SIMULATION_BACKEND_GPU)
+    {
+        return false;
+    }
+
+    // like SaveSnapshot(...), the dead stack rebuild's writes may not be covered yet
+    GLuint sectionBufferIds[PARTICLE_SNAPSHOT_SECTION_COUNT];
+    ParticleSnapshotHeader &header = putKeyframeHere->_header;
+    this->LayOutKeyframe(bufferOffset, &header, sectionBufferIds);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, bufferId);
+    for (unsigned int sectionIndex = 0; sectionIndex < PARTICLE_SNAPSHOT_SECTION_COUNT; 
+        sectionIndex++)
+    {
+        if (sectionBufferIds[sectionIndex] == 0 || header._sectionSizes[sectionIndex] == 0)
+        {
+            continue;
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, sectionBufferIds[sectionIndex]);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 
+            (GLintptr)header._sectionOffsets[sectionIndex], 
+            (GLsizeiptr)header._sectionSizes[sectionIndex]);
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    putKeyframeHere->_emitters = _emitters;
+    putKeyframeHere->_drawGroupFirstEmitters = _drawGroupFirstEmitters;
+    putKeyframeHere->_emissionRemainders = _emissionRemainders;
+    putKeyframeHere->_emitStepCounter = _emitStepCounter;
+    putKeyframeHere->_simulationTimeSec = _simulationTimeSec;
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Puts the whole particle state back the way that it was when a keyframe was captured, 
+    counters and all, so that the same updates from here run the same way again (as long as 
+    the manager is deterministic, see SetDeterministic(...)).  Like LoadSnapshotData(...), 
+    but the copies come straight from the keyframe's buffer on the GPU.
+
+    Note: Like a snapshot, there is nothing to draw until the next update.
+Parameters:
+    bufferId    The buffer that the keyframe was captured into.
+    keyframe    Self-explanatory.
+Returns:
+    False if the state has changed shape since the capture (ex: the sort was turned on), in 
+    which case the state is untouched, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleManager::RestoreKeyframe(unsigned int bufferId, const ParticleKeyframe &keyframe)
+{
+    if (_mappedParameters == 0 || bufferId == 0 || 
+        _simulationBackend != PARTICLE_SIMULATION_BACKEND_GPU)
+    {
+        return false;
+    }
+
+    // every section that the state has now must have been captured at the size that it is now
+    const ParticleSnapshotHeader &header = keyframe._header;
+    GLuint sectionBufferIds[PARTICLE_SNAPSHOT_SECTION_COUNT];
+    size_t sectionSizes[PARTICLE_SNAPSHOT_SECTION_COUNT];
+    this->GetSnapshotSections(header._emitterCount, sectionBufferIds, sectionSizes);
+    bool isSameShape = (header._layout == (unsigned int)_layout) && 
+        (header._particleCount == _maxParticleCount);
+    for (unsigned int sectionIndex = 0; sectionIndex < PARTICLE_SNAPSHOT_SECTION_COUNT; 
+        sectionIndex++)
+    {
+        if (sectionBufferIds[sectionIndex] != 0 && 
+            header._sectionSizes[sectionIndex] != sectionSizes[sectionIndex])
+        {
+            isSameShape = false;
+        }
+    }
+    if (!isSameShape)
+    {
+        LogPrintf("keyframe: the particle state changed shape since the keyframe\n");
+        return false;
+    }
+
+    // Note: This rebuilds the dead stacks from the particles that are there now, which the 
+    // copies then replace, so they must come after the rebuild pass's writes.
+    if (!this->SetEmitterTable(keyframe._emitters, keyframe._drawGroupFirstEmitters))
+    {
+        return false;
+    }
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_COPY_READ_BUFFER, bufferId);
+    for (unsigned int sectionIndex = 0; sectionIndex < PARTICLE_SNAPSHOT_SECTION_COUNT; 
+        sectionIndex++)
+    {
+        if (sectionBufferIds[sectionIndex] == 0 || sectionSizes[sectionIndex] == 0)
+        {
+            continue;
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, sectionBufferIds[sectionIndex]);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 
+            (GLintptr)header._sectionOffsets[sectionIndex], 0, 
+            (GLsizeiptr)sectionSizes[sectionIndex]);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    this->RebuildActiveMask();
+    _stepCounter = header._randomSeed;
+    if (keyframe._emissionRemainders.size() == _emissionRemainders.size())
+    {
+        _emissionRemainders = keyframe._emissionRemainders;
+    }
+    _emitStepCounter = keyframe._emitStepCounter;
+    _simulationTimeSec = keyframe._simulationTimeSec;
+    _areDeadStacksStale = true;
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Fills in a snapshot header for the state as it is now, for a keyframe at the given 
+    offset in its buffer.  Only the sections that are copies of a buffer get space, since 
+    the keyframe keeps the emitter table on the CPU.
+Parameters:
+    bufferOffset        Where the keyframe starts.
+    putHeaderHere       Self-explanatory.
+    putBufferIdsHere    An array of PARTICLE_SNAPSHOT_SECTION_COUNT (see 
+                        GetSnapshotSections(...)).
+Returns:
+    Where the keyframe ends in its buffer.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+size_t ParticleManager::LayOutKeyframe(size_t bufferOffset, ParticleSnapshotHeader *putHeaderHere, 
+    unsigned int *putBufferIdsHere) const
+{
+    size_t sectionSizes[PARTICLE_SNAPSHOT_SECTION_COUNT];
+    this->GetSnapshotSections((unsigned int)_emitters.size(), putBufferIdsHere, sectionSizes);
+
+    ParticleSnapshotHeader &header = *putHeaderHere;
+    memset(&header, 0, sizeof(header));
+    header._magic = PARTICLE_SNAPSHOT_MAGIC;
+    header._version = PARTICLE_SNAPSHOT_VERSION;
+    header._headerSizeBytes = sizeof(header);
+    header._layout = (unsigned int)_layout;
+    header._particleCount = _maxParticleCount;
+    header._emitterCount = (unsigned int)_emitters.size();
+    header._emitterSizeBytes = sizeof(ParticleEmitter);
+    header._randomSeed = _stepCounter;
+    size_t endOffset = bufferOffset;
+    for (unsigned int sectionIndex = 0; sectionIndex < PARTICLE_SNAPSHOT_SECTION_COUNT; 
+        sectionIndex++)
+    {
+        if (putBufferIdsHere[sectionIndex] == 0)
+        {
+            continue;
+        }
+        endOffset = (endOffset + PARTICLE_SNAPSHOT_ALIGNMENT - 1) & 
+            ~(size_t)(PARTICLE_SNAPSHOT_ALIGNMENT - 1);
+        header._sectionOffsets[sectionIndex] = endOffset;
+        header._sectionSizes[sectionIndex] = sectionSizes[sectionIndex];
+        endOffset += sectionSizes[sectionIndex];
+    }
+    return endOffset;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Writes out the snapshot that SaveSnapshot(...) started, if the GPU is done copying it, 
+    and deletes its staging buffer.  The file is written straight from the persistently 
+    mapped staging buffer.
+Parameters:
+    waitForGpu  If true, waits for the copy instead of trying again on the next update.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::FinishSnapshot(bool waitForGpu)
+{
+    if (_snapshotFence == 0)
+    {
+        return;
+    }
+
+    if (!waitForGpu && !IsGlFenceSignaled(_snapshotFence))
+    {
+        return;
+    }
+    GlFenceWaitResult waitResult = 
+        WaitForGlFence(_snapshotFence, GL_FENCE_WAIT_FOREVER, "particle snapshot");
+    _snapshotFence.Reset();
+
+    // the sections are in order in the file, with zeros between them to keep them aligned
+    FILE *snapshotFile = (waitResult != GL_FENCE_SIGNALED) ? 0 : 
+        fopen(_snapshotFilePath.c_str(), "wb");
+    bool isWritten = (snapshotFile != 0);
+    if (snapshotFile != 0)
+    {
+        static const unsigned char zeros[PARTICLE_SNAPSHOT_ALIGNMENT] = { 0 };
+        const ParticleSnapshotHeader &header = _snapshotHeader;
+        size_t fileOffset = fwrite(&header, 1, sizeof(header), snapshotFile);
+        for (unsigned int sectionIndex = 0; sectionIndex < PARTICLE_SNAPSHOT_SECTION_COUNT; 
+            sectionIndex++)
+        {
+            size_t sectionOffset = (size_t)header._sectionOffsets[sectionIndex];
+            size_t sectionSize = (size_t)header._sectionSizes[sectionIndex];
+            fileOffset += fwrite(zeros, 1, sectionOffset - fileOffset, snapshotFile);
+            const void *sectionData = (sectionIndex == PARTICLE_SNAPSHOT_SECTION_EMITTERS) ? 
+                (const void *)_snapshotEmitters.data() : 
+                (const unsigned char *)_mappedSnapshot + sectionOffset;
+            fileOffset += fwrite(sectionData, 1, sectionSize, snapshotFile);
+        }
+        isWritten = (fileOffset == header._sectionOffsets[PARTICLE_SNAPSHOT_SECTION_COUNT - 1] + 
+            header._sectionSizes[PARTICLE_SNAPSHOT_SECTION_COUNT - 1]);
+        isWritten = (fclose(snapshotFile) == 0) && isWritten;
+    }
+    if (isWritten)
+    {
+        LogPrintf("snapshot: saved %u particles to '%s'\n", _snapshotHeader._particleCount, 
+            _snapshotFilePath.c_str());
+    }
+    else
+    {
+        LogPrintf("snapshot: couldn't write '%s'\n", _snapshotFilePath.c_str());
+    }
+
+    _snapshotBufferId.Reset();
+    _mappedSnapshot = 0;
+    _snapshotEmitters.clear();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Says which buffer each section of a snapshot is a copy of, and how big it is, for the 
+    state as it is now.  The emitter table has no buffer here because it is written from and 
+    read into _emitters.
+Parameters:
+    emitterCount        The dead counts are one per emitter.
+    putBufferIdsHere    An array of PARTICLE_SNAPSHOT_SECTION_COUNT.  0 for a section that
+                        isn't a copy of a buffer.
+    putSizesHere        Same size.  0 for a section that the state doesn't have.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::GetSnapshotSections(unsigned int emitterCount, 
+    unsigned int *putBufferIdsHere, size_t *putSizesHere) const
+{
+    for (unsigned int sectionIndex = 0; sectionIndex < PARTICLE_SNAPSHOT_SECTION_COUNT; 
+        sectionIndex++)
+    {
+        putBufferIdsHere[sectionIndex] = 0;
+        putSizesHere[sectionIndex] = 0;
+    }
+
+    putSizesHere[PARTICLE_SNAPSHOT_SECTION_EMITTERS] = emitterCount * sizeof(ParticleEmitter);
+    for (unsigned int bufferIndex = 0; bufferIndex < _particleBufferCount; bufferIndex++)
+    {
+        unsigned int sectionIndex = PARTICLE_SNAPSHOT_SECTION_PARTICLES_0 + bufferIndex;
+        putBufferIdsHere[sectionIndex] = _particleBufferIds[bufferIndex];
+        putSizesHere[sectionIndex] = 
+            (size_t)_maxParticleCount * this->GetParticleBufferStride(bufferIndex);
+    }
+    putBufferIdsHere[PARTICLE_SNAPSHOT_SECTION_DEAD_COUNTS] = _deadCountBufferId;
+    putSizesHere[PARTICLE_SNAPSHOT_SECTION_DEAD_COUNTS] = emitterCount * sizeof(GLint);
+    putBufferIdsHere[PARTICLE_SNAPSHOT_SECTION_DEAD_INDICES] = _deadIndexBufferId;
+    putSizesHere[PARTICLE_SNAPSHOT_SECTION_DEAD_INDICES] = 
+        (size_t)_maxParticleCount * sizeof(GLuint);
+    if (_particleIdBufferId != 0)
+    {
+        putBufferIdsHere[PARTICLE_SNAPSHOT_SECTION_PARTICLE_IDS] = _particleIdBufferId;
+        putSizesHere[PARTICLE_SNAPSHOT_SECTION_PARTICLE_IDS] = 
+            (size_t)_particleIdCount * sizeof(GLuint);
+        putBufferIdsHere[PARTICLE_SNAPSHOT_SECTION_PARTICLE_SLOTS] = _particleSlotBufferId;
+        putSizesHere[PARTICLE_SNAPSHOT_SECTION_PARTICLE_SLOTS] = 
+            (size_t)_particleIdCount * sizeof(GLuint);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Starts sorting the particles on the GPU every so many updates (see SortParticles()).  
+    Replaces any sort that was already set up.  Must be called after Init(...).
+
+    The sort moves the particles themselves, not just the order that they are drawn in, so it 
+    does two jobs at once.  Alpha blending needs the particles drawn in depth order, and the 
+    update pass reads and writes the pool in order, so particles that are near each other in 
+    the window end up in the same cache lines (that is what the Morton key is for).  The 
+    order is exact right after a sort.  In between, the particles are still in sorted slots, 
+    but the update's stream compaction puts them in the live index buffer in whatever order 
+    its atomics come in, and particles move and respawn, so the draw order drifts until the 
+    next sort.  Sort after every update for an exact draw order.
+
+    The caller decides when to sort so that the sort can be timed on its own, for example:
+        if (particleManager.IsParticleSortDue())
+        {
+            profiler.BeginScope(sortScopeId);
+            particleManager.SortParticles();
+            profiler.EndScope(sortScopeId);
+        }
+Parameters:
+    sortProgramId   shaderParticle.comp generated with GetSortShaderDefines(...).  This object 
+                    takes its own reference and releases it in ClearParticleSort().
+    request         An interval of 0 is treated as 1.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetParticleSort(unsigned int sortProgramId, 
+    const ParticleSortRequest &request)
+{
+    this->ClearParticleSort();
+    if (_simulationBackend != PARTICLE_SIMULATION_BACKEND_GPU)
+    {
+        LogPrintf("the particle sort isn't supported by the CPU or split particle backends\n");
+        return;
+    }
+    if (sortProgramId == 0)
+    {
+        LogPrintf("particle sort: no sort program\n");
+        return;
+    }
+
+    _sortProgramId = ReferenceGlProgram(sortProgramId);
+    _sortRequest = request;
+    if (_sortRequest._updatesBetweenSorts == 0)
+    {
+        _sortRequest._updatesBetweenSorts = 1;
+    }
+
+    // the direction is normalized here so that the shader can map the distance along it 
+    // straight onto the key
+    float directionLength = glm::length(_sortRequest._depthDirection);
+    _sortRequest._depthDirection = (directionLength > 0.0f) ? 
+        (_sortRequest._depthDirection / directionLength) : glm::vec2(0.0f, 1.0f);
+    this->LoadSortProgramInterface();
+
+    // the buffers are sized at the first sort, and again if the pool grows (see Resize(...))
+    _sortPairBufferId = GenerateGlBuffer();
+    _sortScratchBufferId = GenerateGlBuffer();
+    _sortPairCapacity = 0;
+    _sortScratchSizeBytes = 0;
+    _updatesSinceSort = 0;
+
+    // the IDs are kept from an earlier sort, if there was one, so that they stay stable
+    if (_particleIdCount != _maxParticleCount)
+    {
+        this->InitParticleIds();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Stops sorting, releases the sort program, and deletes the sort buffers.  The particles 
+    stay wherever the last sort put them, and their IDs are kept in case the sort is set up 
+    again (see InitParticleIds()).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::ClearParticleSort()
+{
+    _sortProgramId.Reset();
+    _sortPairBufferId.Reset();
+    _sortScratchBufferId.Reset();
+    _sortPairCapacity = 0;
+    _sortScratchSizeBytes = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    True if a sort has been set up (see SetParticleSort(...)) and at least its interval of 
+    updates has run since the last SortParticles().
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleManager::IsParticleSortDue() const
+{
+    return _sortProgramId != 0 && _updatesSinceSort >= _sortRequest._updatesBetweenSorts;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sorts the particles by the key that was given to SetParticleSort(...).  Call it between 
+    UpdateSteps(...) and Render(...).  Runs whether or not a sort is due and starts the 
+    interval over.
+
+    Every slot of the pool gets a 32-bit key: the emitter's index at the top, then an 
+    "inactive" bit, then as much of the position key as is left.  A bitonic sort over the 
+    (key, slot) pairs then keeps each emitter's particles in its own range of the pool (which 
+    the emitters and their dead stacks depend on) with the live ones first, in key order.  The
+    blocks that fit in shared memory are sorted in one dispatch each, and only the compare 
+    distances that are too big for a block take a dispatch of their own, which is 
+    log2(n / block size) of them for the biggest sequence.  For 600,000 particles, that is 
+    about 80 dispatches in all.
+
+    The particles are copied into a scratch buffer and gathered back into their sorted slots, 
+    and the same pass moves their IDs (see InitParticleIds()) and rebuilds the dead stacks.  Last, the live index buffer and the draw 
+    counts are rewritten in slot order, so the draw right after this is in exact key order.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SortParticles()
+{
+    _updatesSinceSort = 0;
+    if (_sortProgramId == 0 || _mappedParameters == 0 || _maxParticleCount == 0)
+    {
+        return;
+    }
+    GlDebugGroup sortGroup("ParticleManager sort");
+
+    // enough bits for the emitter index and for one past it, so that the padding's key is 
+    // bigger than any emitter's
+    unsigned int emitterBits = 1;
+    while ((1u << emitterBits) <= _emitters.size())
+    {
+        emitterBits++;
+    }
+    if (emitterBits > 16)
+    {
+        LogPrintf("particle sort: too many emitters (%u) to fit in the sort key\n", 
+            (unsigned int)_emitters.size());
+        return;
+    }
+
+    // the particles are about to change slots, so the update list is out of date (see 
+    // SetLiveUpdateList(...))
+    _isUpdateListStale = true;
+
+    // a power of 2 keys, and no fewer than one block
+    unsigned int blockSize = _sortWorkGroupSizeX * 2;
+    unsigned int sortCount = blockSize;
+    while (sortCount < _maxParticleCount)
+    {
+        sortCount <<= 1;
+    }
+    if (sortCount > _sortPairCapacity)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, _sortPairBufferId);
+        LabelGlObject(GL_BUFFER, _sortPairBufferId, "particle sort pairs");
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sortCount * 2 * sizeof(GLuint), 0, 
+            GL_DYNAMIC_COPY);
+        RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particle sort pairs");
+        _sortPairCapacity = sortCount;
+    }
+
+    // every particle buffer, one after the other
+    GLuint scratchOffsets[MAX_PARTICLE_BUFFERS] = { 0, 0, 0 };
+    GLuint wordsPerParticle[MAX_PARTICLE_BUFFERS] = { 0, 0, 0 };
+    size_t scratchSizeBytes = 0;
+    for (unsigned int bufferIndex = 0; bufferIndex < _particleBufferCount; bufferIndex++)
+    {
+        unsigned int stride = this->GetParticleBufferStride(bufferIndex);
+        scratchOffsets[bufferIndex] = (GLuint)(scratchSizeBytes / sizeof(GLuint));
+        wordsPerParticle[bufferIndex] = stride / sizeof(GLuint);
+        scratchSizeBytes += (size_t)_maxParticleCount * stride;
+    }
+
+    // and the IDs, which move with their particles
+    if (_particleIdCount != _maxParticleCount)
+    {
+        this->InitParticleIds();
+    }
+    GLuint scratchIdOffset = (GLuint)(scratchSizeBytes / sizeof(GLuint));
+    scratchSizeBytes += (size_t)_maxParticleCount * sizeof(GLuint);
+    if (scratchSizeBytes > _sortScratchSizeBytes)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, _sortScratchBufferId);
+        LabelGlObject(GL_BUFFER, _sortScratchBufferId, "particle sort scratch");
+        glBufferData(GL_SHADER_STORAGE_BUFFER, scratchSizeBytes, 0, GL_DYNAMIC_COPY);
+        RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particle sort scratch");
+        _sortScratchSizeBytes = scratchSizeBytes;
+    }
+
+    // the gather overwrites the particles, so it reads them from a copy
+    // Note: The barrier at the end of UpdateSteps(...) includes GL_BUFFER_UPDATE_BARRIER_BIT, 
+    // so the copies see the update's writes.
+    glBindBuffer(GL_COPY_WRITE_BUFFER, _sortScratchBufferId);
+    for (unsigned int bufferIndex = 0; bufferIndex < _particleBufferCount; bufferIndex++)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, _particleBufferIds[bufferIndex]);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 
+            scratchOffsets[bufferIndex] * sizeof(GLuint), 
+            (GLsizeiptr)_maxParticleCount * this->GetParticleBufferStride(bufferIndex));
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, _particleIdBufferId);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 
+        scratchIdOffset * sizeof(GLuint), (GLsizeiptr)_maxParticleCount * sizeof(GLuint));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    // the gather rebuilds the dead stacks and the last stage rebuilds the draw counts, both 
+    // from nothing
+    GLint zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _deadCountBufferId);
+    glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32I, 0, _emitters.size() * sizeof(GLint), 
+        GL_RED_INTEGER, GL_INT, &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _drawCommandBufferId);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(DrawCommandBufferHeader), 
+        _drawCommandResetData.size() * sizeof(GLuint), _drawCommandResetData.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // the sort program shares the emitter search with the simulation, which takes the pool 
+    // size and the emitter count from the parameter block, so the sort takes a frame slot too
+    unsigned int frameSlot = this->AcquireParameterFrameSlot();
+    SimulationParameters parameters;
+    parameters._deltaTimeSec = 0.0f;
+    parameters._maxParticleCount = _maxParticleCount;
+    parameters._emitterCount = (unsigned int)_emitters.size();
+    parameters._randomSeed = _stepCounter;
+    parameters._frameIndex = _parameterFrameIndex;
+    parameters._passType = SIMULATION_PASS_UPDATE;
+    parameters._rebuildEmitterIndex = 0;
+    parameters._forceFieldCount = (unsigned int)_forceFields.size();
+    parameters._substepCount = 1;
+    parameters._updateParticleEnd = _maxParticleCount;
+    parameters._cpuEmittedCount = 0;
+    parameters._isDeterministic = _isDeterministic ? 1 : 0;
+    parameters._emitStepIndex = _emitStepCounter;
+    parameters._simulationTimeSec = (float)_simulationTimeSec;
+    parameters._emitSpanSec = 0.0f;
+    parameters._isSubFrameEmission = 0;
+    SetPointerParameters(_pointerInput, _pointerEmitterIndex, &parameters);
+    unsigned int blockOffset = (frameSlot * PARAMETER_BLOCKS_PER_FRAME) * _parameterBlockStride;
+    memcpy((unsigned char *)_mappedParameters + blockOffset, &parameters, sizeof(parameters));
+
+    UseGlProgram(_sortProgramId);
+    glBindBufferRange(GL_UNIFORM_BUFFER, PARAMETER_BLOCK_BINDING, _parameterBufferId, 
+        blockOffset, sizeof(parameters));
+    BindGlShaderStorageBuffer(SORT_PAIR_BUFFER_BINDING, _sortPairBufferId);
+    BindGlShaderStorageBuffer(SORT_SCRATCH_BUFFER_BINDING, _sortScratchBufferId);
+    glUniform1ui(_unifLocSortCount, sortCount);
+    glUniform1i(_unifLocSortKeyType, _sortRequest._key);
+    glUniform2f(_unifLocSortDepthDirection, _sortRequest._depthDirection.x, 
+        _sortRequest._depthDirection.y);
+    glUniform1i(_unifLocSortBackToFront, _sortRequest._backToFront ? 1 : 0);
+    glUniform1ui(_unifLocSortEmitterBits, emitterBits);
+    glUniform1uiv(_unifLocSortScratchOffsets, MAX_PARTICLE_BUFFERS, scratchOffsets);
+    glUniform1uiv(_unifLocSortWordsPerParticle, MAX_PARTICLE_BUFFERS, wordsPerParticle);
+    glUniform1ui(_unifLocSortScratchIdOffset, scratchIdOffset);
+
+    unsigned int numKeyWorkGroups = sortCount / _sortWorkGroupSizeX;
+    unsigned int numBlockWorkGroups = sortCount / blockSize;
+    this->DispatchSortStage(SORT_STAGE_KEYS, numKeyWorkGroups);
+
+    // every block from scratch, then each bigger sequence is the global compare distances 
+    // down to a block followed by the rest of them in shared memory
+    glUniform1ui(_unifLocSortK, 0);
+    this->DispatchSortStage(SORT_STAGE_LOCAL, numBlockWorkGroups);
+    for (unsigned int k = blockSize * 2; k <= sortCount; k <<= 1)
+    {
+        glUniform1ui(_unifLocSortK, k);
+        for (unsigned int j = k / 2; j >= blockSize; j /= 2)
+        {
+            glUniform1ui(_unifLocSortJ, j);
+            this->DispatchSortStage(SORT_STAGE_GLOBAL, numBlockWorkGroups);
+        }
+        this->DispatchSortStage(SORT_STAGE_LOCAL, numBlockWorkGroups);
+    }
+
+    unsigned int numParticleWorkGroups = 
+        (_maxParticleCount + _sortWorkGroupSizeX - 1) / _sortWorkGroupSizeX;
+    this->DispatchSortStage(SORT_STAGE_GATHER, numParticleWorkGroups);
+    this->DispatchSortStage(SORT_STAGE_LIVE_INDICES, numParticleWorkGroups);
+    UseGlProgram(0);
+    _parameterFenceRing.FenceSlot(frameSlot);
+    _parameterFrameIndex++;
+
+    // Render(...) and the next update read everything that the sort wrote, the same way that 
+    // they read what the update writes
+    if (_useFullMemoryBarrier)
+    {
+        glMemoryBarrier(GL_ALL_BARRIER_BITS);
+    }
+    else
+    {
+        glMemoryBarrier(_updateBarrierBits);
+    }
+
+    // the particles changed slots
+    this->RebuildActiveMask();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Looks up the sort program's uniforms and work group size.  Called by SetParticleSort(...) 
+    and whenever the sort program is replaced.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::LoadSortProgramInterface()
+{
+    _unifLocSortStage = glGetUniformLocation(_sortProgramId, "uSortStage");
+    _unifLocSortK = glGetUniformLocation(_sortProgramId, "uSortK");
+    _unifLocSortJ = glGetUniformLocation(_sortProgramId, "uSortJ");
+    _unifLocSortCount = glGetUniformLocation(_sortProgramId, "uSortCount");
+    _unifLocSortKeyType = glGetUniformLocation(_sortProgramId, "uSortKeyType");
+    _unifLocSortDepthDirection = glGetUniformLocation(_sortProgramId, "uSortDepthDirection");
+    _unifLocSortBackToFront = glGetUniformLocation(_sortProgramId, "uSortBackToFront");
+    _unifLocSortEmitterBits = glGetUniformLocation(_sortProgramId, "uSortEmitterBits");
+    _unifLocSortScratchOffsets = glGetUniformLocation(_sortProgramId, "uSortScratchOffsets");
+    _unifLocSortWordsPerParticle = glGetUniformLocation(_sortProgramId, "uSortWordsPerParticle");
+    _unifLocSortScratchIdOffset = glGetUniformLocation(_sortProgramId, "uSortScratchIdOffset");
+
+    // same as the simulation's (see LoadProgramInterfaces())
+    GLint programWorkGroupSize[3] = { 0, 0, 0 };
+    glGetProgramiv(_sortProgramId, GL_COMPUTE_LOCAL_WORK_SIZE, programWorkGroupSize);
+    _sortWorkGroupSizeX = (programWorkGroupSize[0] > 0) ? 
+        programWorkGroupSize[0] : DEFAULT_WORK_GROUP_SIZE;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    (Re)creates the two tables that keep track of particles as the sort moves them around: 
+    the ID of the particle in every slot, and the slot of every ID.  Every ID is set to its 
+    slot, on the GPU, so a pool that has never been sorted has the IDs that it would have had
+    all along.  Called by the first SetParticleSort(...) and again when Resize(...) changes 
+    the pool.
+
+    The sort keeps the tables up to date, so anything that needs to know which particle is 
+    which from one frame to the next (ex: a readback that follows particles, or a pass that 
+    keeps per-particle history in a buffer of its own) indexes by ID and looks up the slot.
+    The tables stay bound (see PARTICLE_ID_BUFFER_BINDING), so other shaders can do that too.
+
+    If there is no sort program, the IDs can't be set and would go stale, so the tables are 
+    deleted instead.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::InitParticleIds()
+{
+    _particleIdBufferId.Reset();
+    _particleSlotBufferId.Reset();
+    _particleIdCount = 0;
+    if (_sortProgramId == 0 || _maxParticleCount == 0)
+    {
+        return;
+    }
+
+    GLsizeiptr tableSizeBytes = (GLsizeiptr)_maxParticleCount * sizeof(GLuint);
+    _particleIdBufferId = GenerateGlBuffer();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _particleIdBufferId);
+    LabelGlObject(GL_BUFFER, _particleIdBufferId, "particle IDs");
+    glBufferData(GL_SHADER_STORAGE_BUFFER, tableSizeBytes, 0, GL_DYNAMIC_COPY);
+    RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particle IDs");
+    BindGlShaderStorageBuffer(PARTICLE_ID_BUFFER_BINDING, _particleIdBufferId);
+    _particleSlotBufferId = GenerateGlBuffer();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _particleSlotBufferId);
+    LabelGlObject(GL_BUFFER, _particleSlotBufferId, "particle slots");
+    glBufferData(GL_SHADER_STORAGE_BUFFER, tableSizeBytes, 0, GL_DYNAMIC_COPY);
+    RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particle slots");
+    BindGlShaderStorageBuffer(PARTICLE_SLOT_BUFFER_BINDING, _particleSlotBufferId);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    _particleIdCount = _maxParticleCount;
+
+    // the sort program has a stage for it; it only needs the pool size
+    UseGlProgram(_sortProgramId);
+    glUniform1ui(_unifLocSortCount, _maxParticleCount);
+    this->DispatchSortStage(SORT_STAGE_INIT_IDS, 
+        (_maxParticleCount + _sortWorkGroupSizeX - 1) / _sortWorkGroupSizeX);
+    UseGlProgram(0);
+
+    // the sort's copy of the IDs and any readback of them come after this
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Runs a stage of the sort program, split into rows if it is too big for a single dispatch 
+    (see GetComputeDispatchSize(...)), and puts up a barrier for the next stage.
+
+    Note: The sort program must be bound prior to calling this.
+Parameters:
+    sortStage       One of the SortStage values.
+    numWorkGroups   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::DispatchSortStage(int sortStage, unsigned int numWorkGroups)
+{
+    GLuint numWorkGroupsX = 1;
+    GLuint numWorkGroupsY = 1;
+    GetComputeDispatchSize(numWorkGroups, &numWorkGroupsX, &numWorkGroupsY);
+    glUniform1i(_unifLocSortStage, sortStage);
+    glDispatchCompute(numWorkGroupsX, numWorkGroupsY, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    bufferIndex     Index into _particleBufferIds.
+Returns:
+    How many bytes each particle takes up in that particle buffer in the current layout.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleManager::GetParticleBufferStride(unsigned int bufferIndex) const
+{
+    return Std430BufferStride(GetParticleLayoutDescriptor(_layout), bufferIndex);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Changes an emitter's center, radius, velocity range, emission rate, or lifetime.  Takes 
+    effect on the next Update(...), which uploads it along with any other emitter that 
+    changed since the last one.  The emitter's range of the particle pool is fixed at 
+    Init(...), so its particle count and first particle are ignored.
+Parameters:
+    emitterIndex    In the order given to Init(...).
+    emitter         Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-13-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetEmitter(unsigned int emitterIndex, const ParticleEmitter &emitter)
+{
+    if (emitterIndex >= _emitters.size())
+    {
+        return;
+    }
+
+    ParticleEmitter &storedEmitter = _emitters[emitterIndex];
+    unsigned int particleCount = storedEmitter._particleCount;
+    unsigned int firstParticle = storedEmitter._firstParticle;
+    storedEmitter = emitter;
+    storedEmitter._particleCount = particleCount;
+    storedEmitter._firstParticle = firstParticle;
+    _maxEmitterQuota = this->GetMaxEmitterQuota();
+    this->MarkEmittersDirty(emitterIndex, 1);
+
+    // its particles may be asleep outside of its new bounds
+    this->WakeAllParticles();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The emitters, in the order given to Init(...), with their particle ranges filled in.
+Exception:  Safe
+Creator:    John Cox (8-13-2016)
+-----------------------------------------------------------------------------------------------*/
+const std::vector<ParticleEmitter> &ParticleManager::GetEmitters() const
+{
+    return _emitters;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Replaces the force fields that act on every active particle (see ParticleForceField.h).  
+    Can be called before Init(...) or at any time after it; the next update uses the new 
+    table.  The buffer only grows, so a table that changes every frame (ex: a wind that 
+    gusts) doesn't re-create it, and only the entries that differ from the last table are 
+    uploaded (see FlushDirtyTables()).
+
+    Note: A program built with ParticleKernelVariant::_hasUnrolledForceFields only uses the 
+    first _unrolledForceFieldCount of these.
+Parameters:
+    forceFields     Self-explanatory.  May be empty.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetForceFields(const std::vector<ParticleForceField> &forceFields)
+{
+    // the caller may be handing back GetForceFields(), which can't be compared with itself, 
+    // so all of it is taken to have changed
+    bool isChanged = true;
+    if (&forceFields != &_forceFields)
+    {
+        size_t sharedCount = (forceFields.size() < _forceFields.size()) ? 
+            forceFields.size() : _forceFields.size();
+        isChanged = (forceFields.size() != _forceFields.size());
+        for (size_t forceFieldIndex = 0; forceFieldIndex < sharedCount; forceFieldIndex++)
+        {
+            if (memcmp(&forceFields[forceFieldIndex], &_forceFields[forceFieldIndex], 
+                sizeof(ParticleForceField)) != 0)
+            {
+                this->MarkForceFieldsDirty((unsigned int)forceFieldIndex, 1);
+                isChanged = true;
+            }
+        }
+        if (forceFields.size() > sharedCount)
+        {
+            this->MarkForceFieldsDirty((unsigned int)sharedCount, 
+                (unsigned int)(forceFields.size() - sharedCount));
+        }
+        _forceFields = forceFields;
+    }
+    else
+    {
+        this->MarkForceFieldsDirty(0, (unsigned int)_forceFields.size());
+    }
+    if (_mappedParameters == 0)
+    {
+        // uploaded by Init(...)
+        return;
+    }
+
+    // Note: Mutable storage for the same reason as the emitter table.
+    unsigned int forceFieldCount = (unsigned int)_forceFields.size();
+    if (_forceFieldBufferId == 0 || forceFieldCount > _forceFieldCapacity)
+    {
+        _forceFieldCapacity = (forceFieldCount > 0) ? forceFieldCount : 1;
+        _forceFieldBufferId = GenerateGlBuffer();
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, _forceFieldBufferId);
+        LabelGlObject(GL_BUFFER, _forceFieldBufferId, "particle force fields");
+        glBufferData(GL_SHADER_STORAGE_BUFFER, _forceFieldCapacity * sizeof(ParticleForceField), 
+            0, GL_DYNAMIC_DRAW);
+        RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particle force fields");
+        BindGlShaderStorageBuffer(FORCE_FIELD_BUFFER_BINDING, _forceFieldBufferId);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        // the new buffer has none of the old one's entries
+        this->MarkForceFieldsDirty(0, forceFieldCount);
+    }
+
+    // the particles that were at rest may not be anymore
+    if (isChanged)
+    {
+        this->WakeAllParticles();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The force fields from the last SetForceFields(...).
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+const std::vector<ParticleForceField> &ParticleManager::GetForceFields() const
+{
+    return _forceFields;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Has the update sample a 2D texture of accelerations or velocities at each particle's 
+    position (see ParticleFieldTexture.h), on top of the force fields.  A field of any 
+    complexity costs each particle one filtered texture fetch.  Can be called at any time.
+
+    Note: Only a program built with ParticleKernelVariant::_hasFieldTexture samples the 
+    texture.  The particle manager doesn't own the texture, and it must stay alive until 
+    ClearFieldTexture() or Cleanup().
+Parameters:
+    textureId   A GL_TEXTURE_2D with (at least) 2 float or half float channels, red for X and 
+                green for Y, or a signed normalized texture (ex: BC5) and its scale.  Linear 
+                filtering interpolates between the texels.
+    minCorner   Where the texture's first texel's lower left corner is in window coordinates.
+    maxCorner   Where the last texel's upper right corner is.  Must be greater than minCorner 
+                on both axes.
+    mode        Self-explanatory.
+    response    Scales the acceleration from the texture.  See ParticleFieldTextureMode.
+    valueScale  What the texels are multiplied by to get the field's values (see 
+                ParticleFieldTexture::GetValueScale()).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetFieldTexture(unsigned int textureId, const glm::vec2 &minCorner, 
+    const glm::vec2 &maxCorner, ParticleFieldTextureMode mode, float response, 
+    float valueScale)
+{
+    if (maxCorner.x <= minCorner.x || maxCorner.y <= minCorner.y)
+    {
+        LogPrintf("field texture bounds are empty: (%f, %f) to (%f, %f)\n", 
+            minCorner.x, minCorner.y, maxCorner.x, maxCorner.y);
+        return;
+    }
+
+    _fieldTextureId = textureId;
+    _fieldTextureMin = minCorner;
+    _fieldTextureMax = maxCorner;
+    _fieldTextureMode = mode;
+    _fieldTextureResponse = response;
+    _fieldTextureScale = valueScale;
+    this->ApplyBindlessTextures();
+    this->WakeAllParticles();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Stops sampling the field texture.  A FIELD_TEXTURE program still does the fetch (from no 
+    texture, with a response of 0), so it should be replaced with one that doesn't for the 
+    field to cost nothing at all.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::ClearFieldTexture()
+{
+    _fieldTextureId = 0;
+    this->ApplyBindlessTextures();
+    this->WakeAllParticles();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Has the update keep particles out of the solid parts of a signed distance field (see 
+    ParticleBoundarySdf.h), on top of the emitters' circles.  A particle that ends a step 
+    inside is either recycled or pushed back out to the surface along the field's gradient, 
+    with the part of its velocity into the surface reflected.  Can be called at any time.
+
+    Note: Only a program built with ParticleKernelVariant::_hasSdfBoundary tests the 
+    particles.  The particle manager doesn't own the texture, and it must stay alive until 
+    ClearSdfBoundary() or Cleanup().  A particle that moves more than the solid is thick in a 
+    single step can pass through it, so thin walls need small steps (see 
+    SetSubstepsPerDispatch(...)).
+Parameters:
+    textureId   A GL_TEXTURE_2D of distances (red) in window units, negative inside the solid.
+                Linear filtering interpolates between the texels.
+    width       The texels across, for the gradient.
+    height      Self-explanatory.
+    minCorner   Where the texture's lower left corner is in window coordinates.
+    maxCorner   Where the texture's upper right corner is.  Must be greater than minCorner on 
+                both axes.
+    mode        Self-explanatory.
+    restitution Collisions only.  How much of the speed into the surface comes back out of it: 
+                0 slides along it and 1 bounces perfectly.
+    distanceScale   What the texels are multiplied by to get window units, for a signed 
+                    normalized texture like BC4 (see ParticleBoundarySdf::GetDistanceScale()).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetSdfBoundary(unsigned int textureId, int width, int height, 
+    const glm::vec2 &minCorner, const glm::vec2 &maxCorner, ParticleSdfBoundaryMode mode, 
+    float restitution, float distanceScale)
+{
+    if (width <= 0 || height <= 0 || maxCorner.x <= minCorner.x || maxCorner.y <= minCorner.y)
+    {
+        LogPrintf("SDF boundary is empty: %dx%d texels over (%f, %f) to (%f, %f)\n", width, 
+            height, minCorner.x, minCorner.y, maxCorner.x, maxCorner.y);
+        return;
+    }
+
+    _sdfBoundaryTextureId = textureId;
+    _sdfBoundaryMin = minCorner;
+    _sdfBoundaryMax = maxCorner;
+    _sdfBoundaryTexelSize = glm::vec2(1.0f / width, 1.0f / height);
+    _sdfBoundaryMode = mode;
+    _sdfBoundaryRestitution = restitution;
+    _sdfBoundaryScale = distanceScale;
+    this->ApplyBindlessTextures();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Stops testing the particles against the SDF boundary.  Same as ClearFieldTexture(), a 
+    SDF_BOUNDARY program still does the fetch, so it should be replaced with one that doesn't 
+    for the boundary to cost nothing at all.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::ClearSdfBoundary()
+{
+    _sdfBoundaryTextureId = 0;
+    this->ApplyBindlessTextures();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Has the update stop particles at the line segments in a segment BVH (see 
+    ParticleSegmentBvh.h), on top of the emitters' circles.  A particle whose step crosses a 
+    segment is either recycled or put back at the point where it hit, with the part of its 
+    velocity into the segment reflected.  Can be called at any time.
+
+    Note: Only a program built with ParticleKernelVariant::_hasSegmentBvh tests the 
+    particles.  The particle manager doesn't own the buffers, and they must stay alive until 
+    ClearSegmentBvh() or Cleanup().
+Parameters:
+    segmentBufferId ParticleSegmentBvh::GetSegmentBufferId().
+    nodeBufferId    ParticleSegmentBvh::GetNodeBufferId().
+    segmentCount    ParticleSegmentBvh::GetSegmentCount().
+    mode            Self-explanatory.
+    restitution     Collisions only.  How much of the speed into the segment comes back out of 
+                    it: 0 slides along it and 1 bounces perfectly.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetSegmentBvh(unsigned int segmentBufferId, unsigned int nodeBufferId, 
+    unsigned int segmentCount, ParticleSegmentBvhMode mode, float restitution)
+{
+    if (segmentCount > 0 && (segmentBufferId == 0 || (segmentCount > 1 && nodeBufferId == 0)))
+    {
+        LogPrintf("segment BVH has %u segments but no buffers for them\n", segmentCount);
+        return;
+    }
+
+    _segmentBvhSegmentBufferId = segmentBufferId;
+    _segmentBvhNodeBufferId = nodeBufferId;
+    _segmentBvhSegmentCount = segmentCount;
+    _segmentBvhMode = mode;
+    _segmentBvhRestitution = restitution;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Stops testing the particles against the segment BVH.  A SEGMENT_BVH program then skips the 
+    traversal, but it should still be replaced with one that doesn't have it for the segments 
+    to cost nothing at all.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::ClearSegmentBvh()
+{
+    _segmentBvhSegmentBufferId = 0;
+    _segmentBvhNodeBufferId = 0;
+    _segmentBvhSegmentCount = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Has the emitters whose spawn shape is PARTICLE_SPAWN_IMAGE send their particles out from an 
+    image instead of their disk (see ParticleEmissionImage.h), each one from a pixel picked in 
+    proportion to its brightness and somewhere within that pixel.  The emit pass finds the 
+    pixel with a binary search of the image's CDF, so a particle costs log2(pixels) loads no 
+    matter how complicated the shape is.  Can be called at any time.
+
+    Note: Only a program built with ParticleKernelVariant::_hasEmissionImage reads the image, 
+    and only the GPU backends spawn in it; the CPU backend's particles start in the disk.  The 
+    particle manager doesn't own the buffer, and it must stay alive until 
+    ClearEmissionImage() or Cleanup().  A particle that starts outside its emitter's radius is 
+    recycled on its first update, so the image should fit inside the emitters' circles.
+Parameters:
+    cdfBufferId     ParticleEmissionImage::GetCdfBufferId().
+    width           The image's pixels across.
+    height          Self-explanatory.
+    minCorner       Where the image's lower left corner is in window coordinates.
+    maxCorner       Where the image's upper right corner is.  Must be greater than minCorner 
+                    on both axes.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetEmissionImage(unsigned int cdfBufferId, int width, int height, 
+    const glm::vec2 &minCorner, const glm::vec2 &maxCorner)
+{
+    if (cdfBufferId == 0 || width <= 0 || height <= 0 || maxCorner.x <= minCorner.x || 
+        maxCorner.y <= minCorner.y)
+    {
+        LogPrintf("emission image is empty: %dx%d pixels over (%f, %f) to (%f, %f)\n", width, 
+            height, minCorner.x, minCorner.y, maxCorner.x, maxCorner.y);
+        return;
+    }
+
+    _emissionImageCdfBufferId = cdfBufferId;
+    _emissionImageWidth = width;
+    _emissionImageHeight = height;
+    _emissionImageMin = minCorner;
+    _emissionImageMax = maxCorner;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sends the image's emitters back to their disks.  Same as ClearSegmentBvh(), an 
+    EMISSION_IMAGE program then skips the search, but it should still be replaced with one 
+    that doesn't have it for the image to cost nothing at all.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::ClearEmissionImage()
+{
+    _emissionImageCdfBufferId = 0;
+    _emissionImageWidth = 0;
+    _emissionImageHeight = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Moves the emitters along paths that the compute shader works out from the simulation 
+    time (see ParticleEmitterPath), so that any number of emitters move smoothly without the 
+    CPU changing the emitter table every frame.  Emitter "e" follows paths[e], and the 
+    emitters past the end of the paths stay where they are.  The path is an offset from the 
+    emitter's center, so SetEmitter(...) can still move the whole path.  Can be called before 
+    Init(...) or at any time after it.  The buffers only grow, like the force fields'.
+
+    Note: Only a program built with ParticleKernelVariant::_hasEmitterPaths follows the paths,
+    and only the GPU backends do; the CPU backend's emitters (and the CPU's half of a split) 
+    stay at their centers.
+Parameters:
+    paths       Self-explanatory.  May be empty, which stops every emitter.
+    pathPoints  The spline paths' points, each one an offset from its emitter's center.  
+                Every spline path's run of points must be within them.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetEmitterPaths(const std::vector<ParticleEmitterPath> &paths, 
+    const std::vector<glm::vec2> &pathPoints)
+{
+    for (size_t pathIndex = 0; pathIndex < paths.size(); pathIndex++)
+    {
+        const ParticleEmitterPath &path = paths[pathIndex];
+        if (path._type == PARTICLE_EMITTER_PATH_SPLINE && 
+            ((size_t)path._firstPoint + path._pointCount) > pathPoints.size())
+        {
+            LogPrintf("emitter path %u needs points %u to %u, but there are only %u\n", 
+                (unsigned int)pathIndex, path._firstPoint, 
+                path._firstPoint + path._pointCount - 1, (unsigned int)pathPoints.size());
+            return;
+        }
+    }
+
+    // the caller may be handing back GetEmitterPaths()
+    if (&paths != &_emitterPaths)
+    {
+        _emitterPaths = paths;
+    }
+    if (&pathPoints != &_emitterPathPoints)
+    {
+        _emitterPathPoints = pathPoints;
+    }
+    if (_mappedParameters == 0 || _emitterPaths.empty())
+    {
+        // uploaded by Init(...), or nothing to upload
+        return;
+    }
+
+    // Note: Mutable storage for the same reason as the emitter table.  A table of only 
+    // Lissajous paths still gets a point buffer so that the binding has one.
+    unsigned int pathCount = (unsigned int)_emitterPaths.size();
+    if (_emitterPathBufferId == 0 || pathCount > _emitterPathCapacity)
+    {
+        _emitterPathCapacity = pathCount;
+        _emitterPathBufferId = GenerateGlBuffer();
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, _emitterPathBufferId);
+        LabelGlObject(GL_BUFFER, _emitterPathBufferId, "particle emitter paths");
+        glBufferData(GL_SHADER_STORAGE_BUFFER, 
+            _emitterPathCapacity * sizeof(ParticleEmitterPath), 0, GL_DYNAMIC_DRAW);
+        RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particle emitter paths");
+    }
+    unsigned int pointCount = (unsigned int)_emitterPathPoints.size();
+    if (_emitterPathPointBufferId == 0 || pointCount > _emitterPathPointCapacity)
+    {
+        _emitterPathPointCapacity = (pointCount > 0) ? pointCount : 1;
+        _emitterPathPointBufferId = GenerateGlBuffer();
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, _emitterPathPointBufferId);
+        LabelGlObject(GL_BUFFER, _emitterPathPointBufferId, "particle emitter path points");
+        glBufferData(GL_SHADER_STORAGE_BUFFER, 
+            _emitterPathPointCapacity * sizeof(glm::vec2), 0, GL_DYNAMIC_DRAW);
+        RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particle emitter paths");
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _emitterPathBufferId);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, pathCount * sizeof(ParticleEmitterPath), 
+        _emitterPaths.data());
+    if (pointCount > 0)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, _emitterPathPointBufferId);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, pointCount * sizeof(glm::vec2), 
+            _emitterPathPoints.data());
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The paths from the last SetEmitterPaths(...).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+const std::vector<ParticleEmitterPath> &ParticleManager::GetEmitterPaths() const
+{
+    return _emitterPaths;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Makes emitters emit a number of particles per second instead of per update, so that the 
+    emission doesn't change with the frame rate.  Emitter "e" emits rates[e] particles a 
+    second, and the emitters past the end of the rates, or with a rate of 0, keep the quota 
+    that they were given.  Can be called before Init(...) or at any time after it.
+
+    Each update works out how many particles the time that it covers is worth, carries the 
+    fraction of a particle that is left over to the next update, and puts the whole number in 
+    the emitter's quota (see UpdateEmissionQuotas(...)), so 90 particles a second is 1 on 
+    two of every three updates at 60 updates a second and 3 on every update at 30.  As long 
+    as there are rates, every emitter's particles also come out at random moments of the time 
+    that the update covers and move on by their velocity from there, like the particles of an 
+    emitter with a path (see SetEmitterPaths(...)), so a low frame rate emits a smooth stream 
+    instead of a ring at the emitter each frame.
+
+    Note: The quota that an emitter with a rate reports (see GetEmitters()) is the last 
+    update's, and whatever quota SetEmitter(...) gives it is replaced on the next update.
+Parameters:
+    rates   Self-explanatory.  May be empty, which emits by the quotas.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetEmissionRates(const std::vector<float> &rates)
+{
+    // an emitter that already had a rate keeps its fraction of a particle
+    _emissionRates = rates;
+    _emissionRemainders.resize(_emissionRates.size(), 0.0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The particles that each emitter emits per second (see SetEmissionRates(...)).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+const std::vector<float> &ParticleManager::GetEmissionRates() const
+{
+    return _emissionRates;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Integrates some emitters' particles on only some of the update dispatches, with as many 
+    steps at once as they sat out (see ParticleEmitterSlice), so that systems in the 
+    background cost a fraction of a full update.  Emitter "e" is sliced by slices[e], and the 
+    emitters past the end of the slices are integrated every time.  Emission and the draw 
+    aren't sliced.  Can be called before Init(...) or at any time after it.  The buffer only 
+    grows, like the emitter paths'.
+
+    Note: Only a program built with ParticleKernelVariant::_hasEmitterTimeSlicing slices the 
+    update, and only the GPU backends do.  A sliced emitter's particles don't take part in 
+    the update amortization (see SetUpdateAmortization(...)), since the two would each make 
+    the other's steps wrong.
+Parameters:
+    slices  Self-explanatory.  May be empty, which integrates every emitter every time.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetEmitterUpdateSlices(const std::vector<ParticleEmitterSlice> &slices)
+{
+    // the caller may be handing back the manager's own
+    if (&slices != &_emitterSlices)
+    {
+        _emitterSlices = slices;
+    }
+    if (_mappedParameters == 0 || _emitterSlices.empty())
+    {
+        // uploaded by Init(...), or nothing to upload
+        return;
+    }
+
+    // Note: Mutable storage for the same reason as the emitter table.
+    unsigned int sliceCount = (unsigned int)_emitterSlices.size();
+    if (_emitterSliceBufferId == 0 || sliceCount > _emitterSliceCapacity)
+    {
+        _emitterSliceCapacity = sliceCount;
+        _emitterSliceBufferId = GenerateGlBuffer();
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, _emitterSliceBufferId);
+        LabelGlObject(GL_BUFFER, _emitterSliceBufferId, "particle emitter update slices");
+        glBufferData(GL_SHADER_STORAGE_BUFFER, 
+            _emitterSliceCapacity * sizeof(ParticleEmitterSlice), 0, GL_DYNAMIC_DRAW);
+        RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, 
+            "particle emitter update slices");
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _emitterSliceBufferId);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sliceCount * sizeof(ParticleEmitterSlice), 
+        _emitterSlices.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives emitters children for their particles when they die (see ParticleSubEmitter).  
+    Emitter "e" uses subEmitters[e], and the emitters past the end of them have none.  Can be 
+    called before Init(...) or at any time after it.  The table's buffer only grows, like the 
+    emitter paths'.
+
+    It all stays on the GPU.  The update appends each death that a sub-emitter's trigger covers
+    (where it was and how fast it was going) to a list with an atomic counter, and sizes the 
+    list's indirect dispatch as it goes.  The next UpdateSteps(...) starts with a pass over 
+    that list, one work item per child, which pops the child emitter's dead stack like the 
+    emit pass does.  The cost follows the number of deaths, with nothing read back.
+
+    Note: Only a program built with ParticleKernelVariant::_hasSubEmitters records the deaths, 
+    and only the GPU backends do (in a split, only the GPU's half).  The deterministic mode 
+    doesn't keep the dead stacks, so it has no children.
+    Also Note: The list holds MAX_DEATH_EVENTS deaths per update, and the ones past that don't 
+    have children.
+Parameters:
+    subEmitters     Self-explanatory.  May be empty, which turns them all off.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetSubEmitters(const std::vector<ParticleSubEmitter> &subEmitters)
+{
+    // the caller may be handing back GetSubEmitters()
+    if (&subEmitters != &_subEmitters)
+    {
+        _subEmitters = subEmitters;
+    }
+
+    // the children pass covers this many per death, and the extras don't spawn
+    _subEmitterMaxChildren = 0;
+    for (size_t subEmitterIndex = 0; subEmitterIndex < _subEmitters.size(); subEmitterIndex++)
+    {
+        if (_subEmitters[subEmitterIndex]._childCount > _subEmitterMaxChildren)
+        {
+            _subEmitterMaxChildren = _subEmitters[subEmitterIndex]._childCount;
+        }
+    }
+    if (_mappedParameters == 0 || _subEmitters.empty())
+    {
+        // uploaded by Init(...), or nothing to upload
+        return;
+    }
+
+    // Note: Mutable storage for the same reason as the emitter table.
+    unsigned int subEmitterCount = (unsigned int)_subEmitters.size();
+    if (_subEmitterBufferId == 0 || subEmitterCount > _subEmitterCapacity)
+    {
+        _subEmitterCapacity = subEmitterCount;
+        _subEmitterBufferId = GenerateGlBuffer();
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, _subEmitterBufferId);
+        LabelGlObject(GL_BUFFER, _subEmitterBufferId, "particle sub-emitters");
+        glBufferData(GL_SHADER_STORAGE_BUFFER, 
+            _subEmitterCapacity * sizeof(ParticleSubEmitter), 0, GL_DYNAMIC_DRAW);
+        RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particle sub-emitters");
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _subEmitterBufferId);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, subEmitterCount * sizeof(ParticleSubEmitter), 
+        _subEmitters.data());
+
+    // the death list is only made the first time there are sub-emitters, and starts empty
+    if (_deathEventBufferId == 0)
+    {
+        DeathListHeader emptyDeathList = { 0, 1, 1, 0 };
+        _deathEventBufferId = GenerateGlBuffer();
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, _deathEventBufferId);
+        LabelGlObject(GL_BUFFER, _deathEventBufferId, "particle deaths");
+        glBufferData(GL_SHADER_STORAGE_BUFFER, 
+            sizeof(DeathListHeader) + (MAX_DEATH_EVENTS * DEATH_EVENT_SIZE_BYTES), 0, 
+            GL_DYNAMIC_COPY);
+        RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particle deaths");
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(emptyDeathList), &emptyDeathList);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Lets the particles that come to rest fall asleep, so that the update stops integrating 
+    them, and the steady state only costs what is still moving.  A particle falls asleep when 
+    it has been slower than sleepSpeed for restUpdates updates in a row, and it is then held 
+    still (its velocity is zeroed) until something wakes it.  A sleeping particle is still 
+    alive and still drawn, but the update only reads its bit in the sleep mask, which it 
+    shares with 31 others, and only loads it if the view culling needs to know where it is.
+
+    Everything is woken up by whatever changes the forces or the bounds: SetForceFields(...), 
+    SetEmitter(...), the field texture, and anything that moves the particles around (see 
+    RebuildActiveMask()).  While the pointer pulls (see PublishPointerInput(...)), nothing 
+    sleeps.  A neighbor grid built with sleep (see ParticleNeighborGrid::SetWakeSpeed(...)) 
+    wakes the particles that its interactions push.  Call WakeAllParticles() for anything 
+    else.
+
+    Note: Only a program built with ParticleKernelVariant::_hasSleep has the sleep flags, and 
+    only the GPU's particles sleep.  A sleeping particle doesn't age, so only the particles of 
+    emitters without a lifetime fall asleep.
+    Also Note: An emitter that moves on its own (see SetEmitterPaths(...)) leaves its sleeping 
+    particles where they are until they wake, even if they are then out of its bounds.
+Parameters:
+    sleepSpeed      0 (the default) puts nothing to sleep, and whatever is asleep wakes up on 
+                    the next update.
+    restUpdates     Self-explanatory.  At least 1.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetSleep(float sleepSpeed, unsigned int restUpdates)
+{
+    _sleepSpeed = (sleepSpeed > 0.0f) ? sleepSpeed : 0.0f;
+    _sleepRestUpdates = (restUpdates > 0) ? restUpdates : 1;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Wakes every sleeping particle (see SetSleep(...)) and starts their rest counts over, with 
+    a clear of each buffer instead of a pass.  Does nothing without the sleep buffers.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::WakeAllParticles()
+{
+    if (_sleepMaskBufferId == 0)
+    {
+        return;
+    }
+
+    // the update's atomics on the mask must be done before it is overwritten
+    GLuint zero = 0;
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _sleepMaskBufferId);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, 
+        &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _restCountBufferId);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, 
+        &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Hands the field texture, the SDF boundary, and the speed palette to the shaders as 
+    GL_ARB_bindless_texture handles instead of binding them to their texture units.  Each 
+    texture is made resident once, when it is set, and after that an update or a render only 
+    sets a 64-bit uniform for it, with no glActiveTexture(...) or glBindTexture(...), so the 
+    cost of submitting doesn't grow with how many textures are in play.
+
+    Note: A texture can't have its parameters or storage changed once it has a handle, only 
+    its texels (ex: ParticleFieldTexture::Bake(...) is fine).  The field texture and the SDF 
+    belong to whoever set them, so this applies to them too.  A driver without the extension 
+    keeps binding them the usual way.
+Parameters:
+    isEnabled   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetBindlessTextures(bool isEnabled)
+{
+    if (isEnabled && gGetTextureHandleArb == 0)
+    {
+        if (IsGlExtensionSupported("GL_ARB_bindless_texture"))
+        {
+            gGetTextureHandleArb = (GetTextureHandleArbProc)
+                GetGlFunctionAddress("glGetTextureHandleARB");
+            gMakeTextureHandleResidentArb = (TextureHandleResidencyArbProc)
+                GetGlFunctionAddress("glMakeTextureHandleResidentARB");
+            gMakeTextureHandleNonResidentArb = (TextureHandleResidencyArbProc)
+                GetGlFunctionAddress("glMakeTextureHandleNonResidentARB");
+            gUniformHandleui64Arb = (UniformHandleui64ArbProc)
+                GetGlFunctionAddress("glUniformHandleui64ARB");
+        }
+        if (gGetTextureHandleArb == 0 || gMakeTextureHandleResidentArb == 0 || 
+            gMakeTextureHandleNonResidentArb == 0 || gUniformHandleui64Arb == 0)
+        {
+            LogPrintf("bindless textures need GL_ARB_bindless_texture; the textures will be "
+                "bound to their units\n");
+            gGetTextureHandleArb = 0;
+            return;
+        }
+    }
+
+    _isBindlessTextures = isEnabled;
+    this->ApplyBindlessTextures();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    True if any of the textures are being handed to the shaders by handle (see 
+    SetBindlessTextures(...)), otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleManager::IsBindlessTexturesActive() const
+{
+    return _fieldTextureHandle != 0 || _sdfBoundaryTextureHandle != 0 || 
+        _speedPaletteTextureHandle != 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Makes the handles of the current textures resident, after letting go of the old ones, 
+    which may have been for textures that have since been replaced.  Called whenever one of 
+    the textures changes.  A texture that isn't set, or bindless textures being off, leaves 
+    its handle at 0, which has the update and the render bind it to its unit instead.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::ApplyBindlessTextures()
+{
+    this->ReleaseBindlessTextures();
+    if (!_isBindlessTextures)
+    {
+        return;
+    }
+
+    // the same texture always has the same handle, so one made resident again is the same 
+    // one that was let go
+    if (_fieldTextureId != 0)
+    {
+        _fieldTextureHandle = gGetTextureHandleArb(_fieldTextureId);
+        gMakeTextureHandleResidentArb(_fieldTextureHandle);
+    }
+    if (_sdfBoundaryTextureId != 0)
+    {
+        _sdfBoundaryTextureHandle = gGetTextureHandleArb(_sdfBoundaryTextureId);
+        gMakeTextureHandleResidentArb(_sdfBoundaryTextureHandle);
+    }
+    if (_speedPaletteTextureId != 0)
+    {
+        _speedPaletteTextureHandle = gGetTextureHandleArb(_speedPaletteTextureId);
+        gMakeTextureHandleResidentArb(_speedPaletteTextureHandle);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Makes every resident handle non-resident.  Must be called before a texture with a handle 
+    is deleted.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::ReleaseBindlessTextures()
+{
+    if (_fieldTextureHandle != 0)
+    {
+        gMakeTextureHandleNonResidentArb(_fieldTextureHandle);
+        _fieldTextureHandle = 0;
+    }
+    if (_sdfBoundaryTextureHandle != 0)
+    {
+        gMakeTextureHandleNonResidentArb(_sdfBoundaryTextureHandle);
+        _sdfBoundaryTextureHandle = 0;
+    }
+    if (_speedPaletteTextureHandle != 0)
+    {
+        gMakeTextureHandleNonResidentArb(_speedPaletteTextureHandle);
+        _speedPaletteTextureHandle = 0;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Has Render(...) draw a copy of the particles that the update isn't working on, so that the 
+    draw doesn't have to wait for the update's dispatches to finish.  Normally the update 
+    writes the very buffers that the draw reads right after the barrier, so the two run one 
+    after the other.  Double-buffered, each update first copies what the last one left (the 
+    particles, the live indices, and the draw commands) into one of two copies, and then the 
+    draw reads that copy while the update writes the originals, so a GPU that can run compute 
+    and graphics at the same time can run the two at once.  The next update copies into the 
+    other one, so it doesn't have to wait for this frame's draw either.
+
+    The copy is one update behind, so Render(...) extrapolates it along each particle's 
+    velocity by that update's time on top of its own extrapolation, which puts the particles 
+    where the originals are, give or take whatever the update did besides moving them.  The 
+    end of the update also no longer needs the vertex and element array barriers, since the 
+    draw doesn't read what the update wrote (see GetUpdateBarrierBits()).
+
+    Note: The copies cost another two pools' worth of GPU memory and a copy of the pool (not 
+    just the live part) every update.  Particles that were born or died in the last update 
+    are drawn a frame late.  Only the GPU backend draws the copies, and not with sparse 
+    buffers, which would copy the whole capacity every update.
+Parameters:
+    isEnabled   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetDoubleBufferedRendering(bool isEnabled)
+{
+    if (isEnabled && _bufferAccess == PARTICLE_BUFFER_ACCESS_SPARSE)
+    {
+        LogPrintf("double-buffered rendering isn't supported with sparse particle buffers\n");
+        return;
+    }
+
+    // the last update left out the barriers that a draw of the originals needs
+    if (!isEnabled && this->IsDoubleBufferedRenderingActive())
+    {
+        glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_ELEMENT_ARRAY_BARRIER_BIT);
+    }
+
+    _isDoubleBufferedRendering = isEnabled;
+    _updateBarrierBits = this->GetUpdateBarrierBits();
+    if (!isEnabled)
+    {
+        this->ReleaseRenderCopies();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    True if the next Render(...) will draw a copy (see SetDoubleBufferedRendering(...)), 
+    otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleManager::IsDoubleBufferedRenderingActive() const
+{
+    return _isDoubleBufferedRendering && _renderCopyIndex >= 0 && 
+        _simulationBackend == PARTICLE_SIMULATION_BACKEND_GPU;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Makes both render copies at the current pool size, each with a VAO that is set up like 
+    the manager's own but sources the copy's buffers.  Nothing is copied into them yet.  
+    Leaves them unmade if they won't fit in the GPU memory budget.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::InitRenderCopies()
+{
+    GLsizeiptr particleBytes = 0;
+    for (unsigned int bufferIndex = 0; bufferIndex < _particleBufferCount; bufferIndex++)
+    {
+        particleBytes += (GLsizeiptr)_maxParticleCount * this->GetParticleBufferStride(bufferIndex);
+    }
+    GLsizeiptr liveIndexBytes = (GLsizeiptr)_maxParticleCount * sizeof(GLuint);
+    GLsizeiptr commandBytes = sizeof(DrawCommandBufferHeader) + 
+        (_drawGroupCapacity * sizeof(DrawElementsIndirectCommand));
+    if (WouldExceedGpuMemoryBudget(2 * (particleBytes + liveIndexBytes + commandBytes)))
+    {
+        LogErrorPrintf("double-buffered rendering: the copies won't fit in the GPU memory "
+            "budget\n");
+        _isDoubleBufferedRendering = false;
+        _updateBarrierBits = this->GetUpdateBarrierBits();
+        return;
+    }
+
+    // Note: Like Init(...), the program is bound while the VAOs are set up.
+    const ParticleLayoutDescriptor &layoutDescriptor = GetParticleLayoutDescriptor(_layout);
+    UseGlProgram(_programId);
+    for (unsigned int copyIndex = 0; copyIndex < 2; copyIndex++)
+    {
+        GLuint bufferIds[MAX_PARTICLE_BUFFERS] = { 0 };
+        for (unsigned int bufferIndex = 0; bufferIndex < _particleBufferCount; bufferIndex++)
+        {
+            _renderCopyParticleBufferIds[copyIndex][bufferIndex] = GenerateGlBuffer();
+            bufferIds[bufferIndex] = _renderCopyParticleBufferIds[copyIndex][bufferIndex];
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, bufferIds[bufferIndex]);
+            LabelGlObject(GL_BUFFER, bufferIds[bufferIndex], "particle render copy");
+            glBufferData(GL_SHADER_STORAGE_BUFFER, 
+                (GLsizeiptr)_maxParticleCount * this->GetParticleBufferStride(bufferIndex), 0, 
+                GL_DYNAMIC_COPY);
+            RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particle render copy");
+        }
+
+        _renderCopyLiveIndexBufferIds[copyIndex] = GenerateGlBuffer();
+        GLuint liveIndexBufferId = _renderCopyLiveIndexBufferIds[copyIndex];
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, liveIndexBufferId);
+        LabelGlObject(GL_BUFFER, liveIndexBufferId, "particle render copy live indices");
+        glBufferData(GL_SHADER_STORAGE_BUFFER, liveIndexBytes, 0, GL_DYNAMIC_COPY);
+        RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particle render copy");
+
+        _renderCopyDrawCommandBufferIds[copyIndex] = GenerateGlBuffer();
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, _renderCopyDrawCommandBufferIds[copyIndex]);
+        LabelGlObject(GL_BUFFER, _renderCopyDrawCommandBufferIds[copyIndex], 
+            "particle render copy draw commands");
+        glBufferData(GL_SHADER_STORAGE_BUFFER, commandBytes, 0, GL_DYNAMIC_COPY);
+        RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "particle render copy");
+
+        // the same attributes as Init(...) gives the manager's own VAO
+        _renderCopyVaoIds[copyIndex] = GenerateGlVertexArray();
+        BindGlVertexArray(_renderCopyVaoIds[copyIndex]);
+        DescribeParticleAttributes(layoutDescriptor, bufferIds);
+        glBindBuffer(GL_ARRAY_BUFFER, _drawGroupStyleBufferId);
+        glVertexAttribPointer(DRAW_GROUP_STYLE_ATTRIBUTE, 2, GL_FLOAT, GL_FALSE, 
+            sizeof(glm::vec2), (void *)0);
+        glVertexAttribDivisor(DRAW_GROUP_STYLE_ATTRIBUTE, 1);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, liveIndexBufferId);
+        glBindBuffer(GL_ARRAY_BUFFER, liveIndexBufferId);
+        glVertexAttribIPointer(QUAD_PARTICLE_INDEX_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof(GLuint), 
+            (void *)0);
+        glVertexAttribDivisor(QUAD_PARTICLE_INDEX_ATTRIBUTE, 1);
+        this->ApplyVertexPulling();
+    }
+    BindGlVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    UseGlProgram(0);
+
+    if (CheckGlOutOfMemory("particle render copies"))
+    {
+        this->ReleaseRenderCopies();
+        _isDoubleBufferedRendering = false;
+        _updateBarrierBits = this->GetUpdateBarrierBits();
+        return;
+    }
+    _renderCopyParticleCount = _maxParticleCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Deletes both render copies, so Render(...) draws the originals until the next update 
+    makes them again.  Safe to call when there are none.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::ReleaseRenderCopies()
+{
+    for (unsigned int copyIndex = 0; copyIndex < 2; copyIndex++)
+    {
+        for (unsigned int bufferIndex = 0; bufferIndex < MAX_PARTICLE_BUFFERS; bufferIndex++)
+        {
+            _renderCopyParticleBufferIds[copyIndex][bufferIndex].Reset();
+        }
+        _renderCopyLiveIndexBufferIds[copyIndex].Reset();
+        _renderCopyDrawCommandBufferIds[copyIndex].Reset();
+        _renderCopyVaoIds[copyIndex].Reset();
+    }
+    _renderCopyIndex = -1;
+    _renderCopyLagSec = 0.0f;
+    _renderCopyParticleCount = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Copies what the last update left into the render copy that the last Render(...) didn't 
+    draw, and makes it the one that the next Render(...) draws.  Called at the start of an 
+    update, before any of its dispatches, so the copy waits on the last update (long done) 
+    and the update waits on the copy, but the draw only waits on the copy.
+
+    Note: The copies read what the last update's shader wrote, and the barrier at the end of 
+    UpdateSteps(...) (GL_BUFFER_UPDATE_BARRIER_BIT) already covers that.
+Parameters:
+    updateSec   The simulation time that the update after the copy covers, which the draw 
+                extrapolates the copy by.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::CopyRenderState(float updateSec)
+{
+    if (_renderCopyParticleCount != _maxParticleCount)
+    {
+        this->ReleaseRenderCopies();
+        this->InitRenderCopies();
+        if (_renderCopyParticleCount == 0)
+        {
+            return;
+        }
+    }
+
+    GlDebugGroup copyGroup("render copy");
+    int copyIndex = (_renderCopyIndex == 0) ? 1 : 0;
+    for (unsigned int bufferIndex = 0; bufferIndex < _particleBufferCount; bufferIndex++)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, _particleBufferIds[bufferIndex]);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, _renderCopyParticleBufferIds[copyIndex][bufferIndex]);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, 
+            (GLsizeiptr)_maxParticleCount * this->GetParticleBufferStride(bufferIndex));
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, _liveIndexBufferId);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, _renderCopyLiveIndexBufferIds[copyIndex]);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, 
+        (GLsizeiptr)_maxParticleCount * sizeof(GLuint));
+    glBindBuffer(GL_COPY_READ_BUFFER, _drawCommandBufferId);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, _renderCopyDrawCommandBufferIds[copyIndex]);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, 
+        sizeof(DrawCommandBufferHeader) + 
+        (_drawGroupCapacity * sizeof(DrawElementsIndirectCommand)));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    _renderCopyIndex = copyIndex;
+    _renderCopyLagSec = updateSec;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The sub-emitters from the last SetSubEmitters(...).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+const std::vector<ParticleSubEmitter> &ParticleManager::GetSubEmitters() const
+{
+    return _subEmitters;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.  Every call to UpdateSteps(...) adds its steps, whichever backend runs 
+    them, and Init(...) starts it over.
+Parameters: None
+Returns:
+    The simulation time that the emitter paths are at, in seconds.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+double ParticleManager::GetSimulationTimeSec() const
+{
+    return _simulationTimeSec;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Has an emitter follow the pointer (see PublishPointerInput(...)).  It only emits while the 
+    pointer says so, and otherwise stays where the pointer last was so that its particles carry
+    on.  Can be called at any time.
+Parameters:
+    emitterIndex    Self-explanatory.  -1 for none, which gives the emitter back to its table 
+                    entry.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetPointerEmitter(int emitterIndex)
+{
+    if (emitterIndex >= (int)_emitters.size())
+    {
+        LogPrintf("there is no emitter %d for the pointer to move\n", emitterIndex);
+        return;
+    }
+    _pointerEmitterIndex = (emitterIndex >= 0) ? emitterIndex : -1;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Hands the pointer to the simulation.  The input goes through a lock-free latest-value slot 
+    (see LatestValueSlot.h), so this never waits, and the next UpdateSteps(...) puts the newest 
+    input straight into its parameter block.  There is no buffer upload and no program state, 
+    so the input is in the very next dispatch, whichever frame the CPU is on.
+
+    Note: Only a program built with ParticleKernelVariant::_hasPointerInput reads the pointer,
+    and only the GPU backends do.
+    Also Note: Safe to call from one other thread (ex: an input thread) while this one 
+    updates.  Inputs that come faster than the updates replace each other, which is the point:
+    only where the pointer is now matters.
+Parameters:
+    input   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::PublishPointerInput(const ParticlePointerInput &input)
+{
+    _pointerInputSlot.Publish(input);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.  For measuring the input's latency (see FramePacer::EndFrame(...)).
+Parameters: None
+Returns:
+    The time of the pointer input that the last UpdateSteps(...) took, or 0 if there wasn't a 
+    new one.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+double ParticleManager::GetAppliedPointerInputTimeMs() const
+{
+    return _appliedPointerInputTimeMs;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sends out a burst of particles from an emitter in the next update (see ParticleBurst), on 
+    top of its usual rate.  The CPU's whole cost is a copy of the 32-byte record: the next 
+    UpdateSteps(...) copies the bursts into the persistently mapped burst queue, and a single 
+    indirect dispatch, sized by the queue, pops and spawns every particle of every burst on the
+    GPU.  A burst of ten thousand is ten thousand work items and no loop on the CPU.
+
+    Note: Only a program built with ParticleKernelVariant::_hasBursts has the burst pass, and 
+    only the GPU's emitters burst (in a split, the CPU's emitters' bursts are skipped).
+    Also Note: The deterministic mode doesn't keep the dead stacks, so it has no bursts.
+Parameters:
+    burst   Self-explanatory.
+Returns:
+    False if the burst was dropped: no such emitter, no burst pass (or the fused emit, see 
+    SetFusedEmitUpdate(...)), or MAX_BURSTS_PER_UPDATE are already waiting for the next 
+    update.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleManager::TriggerBurst(const ParticleBurst &burst)
+{
+    if (burst._emitterIndex >= _emitters.size() || burst._count == 0)
+    {
+        return false;
+    }
+    if (!_hasBurstKernel || _isDeterministic || this->IsFusedEmitUpdateActive() || 
+        _simulationBackend == PARTICLE_SIMULATION_BACKEND_CPU)
+    {
+        return false;
+    }
+    if (_pendingBursts.size() >= MAX_BURSTS_PER_UPDATE)
+    {
+        return false;
+    }
+    _pendingBursts.push_back(burst);
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Streams particles from other threads into the pool (see ParticleInjectionRing).  Every 
+    update takes the ring's slots that producers have handed over, dispatches one scatter pass 
+    per slot, which pops each record's pool slot from its emitter's dead stack like a burst 
+    does, and fences the slot so that the producers can have it back once the GPU is done 
+    with it.  The update never waits on the ring, and the ring never reallocates.
+
+    Note: Only a program built with ParticleKernelVariant::_hasInjection has the pass, and 
+    only the GPU's emitters take records (in a split, the CPU's emitters' records are 
+    skipped).  The deterministic mode, the fused emit (see SetFusedEmitUpdate(...)), and the 
+    CPU backend have no dead stacks to pop, so they drop the slots that are handed over, and 
+    the ring counts them (see ParticleInjectionRing::GetDroppedRecordCount()).
+    Also Note: The ring isn't owned.  It must be set back to 0 before it is cleaned up.
+Parameters:
+    ring    0 stops the injection.
+Returns:
+    False if the program can't inject right now (see the note), in which case the ring is 
+    still kept, and its slots are dropped until it can.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleManager::SetInjectionRing(ParticleInjectionRing *ring)
+{
+    _injectionRing = ring;
+    if (ring == 0)
+    {
+        return true;
+    }
+    return _hasInjectionKernel && !_isDeterministic && !this->IsFusedEmitUpdateActive() && 
+        _simulationBackend != PARTICLE_SIMULATION_BACKEND_CPU;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives back the injection ring's slots that were handed over, without dispatching them, 
+    for an update that can't inject (see SetInjectionRing(...)), so that the producers aren't 
+    refused forever and the records don't go out late if the update can inject again.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::DropReadyInjections()
+{
+    if (_injectionRing == 0)
+    {
+        return;
+    }
+
+    _injectionRing->ReclaimSlots();
+    unsigned int slotIndex = 0;
+    unsigned int takenCount = 0;
+    while (takenCount < ParticleInjectionRing::MAX_SLOT_COUNT && 
+        _injectionRing->TakeReadySlot(_workGroupSizeX, &slotIndex))
+    {
+        _injectionRing->DropSlot(slotIndex);
+        takenCount++;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Copies the bursts that were triggered since the last update into the burst queue's slot 
+    for this frame and fills in the slot's indirect dispatch.
+Parameters:
+    frameSlot   The parameter frame that this update acquired.
+Returns:
+    How many bursts there are, or 0 if there is nothing to dispatch.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleManager::WriteBurstQueue(unsigned int frameSlot)
+{
+    unsigned int burstCount = (unsigned int)_pendingBursts.size();
+    if (burstCount == 0 || _mappedBurstQueue == 0 || !_hasBurstKernel)
+    {
+        _pendingBursts.clear();
+        return 0;
+    }
+
+    unsigned int maxBurstCount = 0;
+    for (unsigned int burstIndex = 0; burstIndex < burstCount; burstIndex++)
+    {
+        if (_pendingBursts[burstIndex]._count > maxBurstCount)
+        {
+            maxBurstCount = _pendingBursts[burstIndex]._count;
+        }
+    }
+
+    // the shader loops over a burst that needs more work groups than the device allows in X
+    BurstQueueHeader header;
+    header._numGroupsX = ClampComputeDispatchSizeX(
+        (maxBurstCount + _workGroupSizeX - 1) / _workGroupSizeX);
+    header._numGroupsY = burstCount;
+    header._numGroupsZ = 1;
+    header._burstCount = burstCount;
+
+    // the mapping is coherent, so the writes are visible to any command issued after them
+    unsigned char *slot = (unsigned char *)_mappedBurstQueue + 
+        (frameSlot * _burstQueueSlotStride);
+    memcpy(slot, &header, sizeof(header));
+    memcpy(slot + sizeof(header), _pendingBursts.data(), burstCount * sizeof(ParticleBurst));
+    _pendingBursts.clear();
+    return burstCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The size of the particle pool (every emitter's particles together).
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleManager::GetMaxParticleCount() const
+{
+    return _maxParticleCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The GPU memory behind the particle buffers.  For sparse buffers (see 
+    PARTICLE_BUFFER_ACCESS_SPARSE), only the pages that are committed, and otherwise the 
+    whole pool.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned long long ParticleManager::GetCommittedParticleBytes() const
+{
+    unsigned long long committedBytes = 0;
+    for (unsigned int bufferIndex = 0; bufferIndex < _particleBufferCount; bufferIndex++)
+    {
+        if (_sparsePageSizeBytes == 0)
+        {
+            committedBytes += 
+                (unsigned long long)_maxParticleCount * this->GetParticleBufferStride(bufferIndex);
+            continue;
+        }
+        const std::vector<unsigned char> &committedPages = _committedParticlePages[bufferIndex];
+        for (size_t page = 0; page < committedPages.size(); page++)
+        {
+            committedBytes += committedPages[page] * (unsigned long long)_sparsePageSizeBytes;
+        }
+    }
+    return committedBytes;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Chooses how the particle buffers are allocated.  Must be called before Init(...) to have 
+    any effect.  See AllocateParticleBuffer(...).
+
+    The sparse access is for pools sized for the most that there could ever be (see 
+    SetPoolCapacity(...)), of which only some is in use at a time (ex: a ParticleWorld's 
+    systems).  The pool's addresses are reserved, but only the pages under the emitters' 
+    ranges have memory, and that follows the ranges as SetEmitterTable(...), 
+    MoveParticleRange(...), and Resize(...) change them.  It needs GL_ARB_sparse_buffer and 
+    the GPU backend, and without them it is the GPU only access.
+
+    Note: Only the particles are sparse.  The dead and live indices, the update lists, and 
+    the active mask are still allocated for the whole pool (16 bytes and a bit per particle).
+Parameters:
+    access      Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-12-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetParticleBufferAccess(ParticleBufferAccess access)
+{
+    _bufferAccess = access;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets how many particles each work item of the update pass handles ("work coarsening").  1 
+    is one work item per particle.  Higher values dispatch proportionally fewer work groups, 
+    and the shader's grid-stride loop gives each work item that many particles.  Can be changed
+    at any time.
+Parameters:
+    particlesPerInvocation  Self-explanatory.  0 is treated as 1.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-14-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetParticlesPerInvocation(unsigned int particlesPerInvocation)
+{
+    _particlesPerInvocation = (particlesPerInvocation == 0) ? 1 : particlesPerInvocation;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets how many of UpdateSteps(...)'s steps each update dispatch runs.  Each work item keeps 
+    its particle in registers for all of them, so K substeps per dispatch is K times fewer 
+    loads and stores of the particle buffers and K times fewer dispatches and barriers.  
+    Smaller steps are then cheap enough to buy stability with (ex: strong attractors).  Can be 
+    changed at any time.
+
+    Note: The live particle list is only rebuilt once per dispatch, but only the last one is 
+    drawn anyway.  Particles that leave their emitter's bounds partway through stop there, 
+    just as they would with one dispatch per step.
+Parameters:
+    substepsPerDispatch     Self-explanatory.  0 is treated as 1.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetSubstepsPerDispatch(unsigned int substepsPerDispatch)
+{
+    _substepsPerDispatch = (substepsPerDispatch == 0) ? 1 : substepsPerDispatch;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    See SetSubstepsPerDispatch(...).
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleManager::GetSubstepsPerDispatch() const
+{
+    return _substepsPerDispatch;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Chooses whether the compute shader or worker threads on the CPU run the simulation.  Must 
+    be called before Init(...) to have any effect.
+
+    The CPU backend runs the same emission and update rules as shaderParticle.comp (emission 
+    from the dead stacks, semi-implicit Euler with the force fields, the emitter's circle, and 
+    the lifetime) over its own copy of the particles (see UpdateStepsOnCpu(...)), and then 
+    uploads the particles, the live indices, and the draw commands into the same buffers 
+    that the compute shader would have written.  Render(), the readbacks, and the counts all 
+    work unchanged, and Init(...), UpdateSteps(...), and Render(...) are called the same way.
+
+    Note: Only the particle rules above are on the CPU.  The field texture, the SDF boundary, 
+    the segment BVH, the sort, Resize(...), and the emitter table functions all need the 
+    compute program, so they are ignored or refused, and the kernel variant's integrator and 
+    respawn settings don't apply.
+
+    The split backend runs both at once.  The GPU has the emitters before the split and the CPU
+    has the rest, so each emitter's dead stack is only on one of them, and each update is the 
+    GPU's dispatches, the CPU's threads while those run, a copy of the CPU's part of the 
+    particle buffers, and a small pass that appends the CPU's live particles to the draw 
+    commands.  Given a profiler (see SetSplitProfiler(...)), the split is moved one emitter at 
+    a time toward where both sides take as long, so the pool needs several emitters to be 
+    split finely.  It needs the compute program, the CPU's limits above apply to the whole 
+    pool, and the kernel variant must not have a fixed emitter or a different integrator from
+    the CPU's.
+Parameters:
+    backend         Self-explanatory.
+    cpuWorkerCount  Worker threads besides the one that calls UpdateSteps(...).  0 uses every
+                    hardware thread (see WorkStealingThreadPool::Init(...)).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetSimulationBackend(ParticleSimulationBackend backend, 
+    unsigned int cpuWorkerCount)
+{
+    _simulationBackend = backend;
+    _cpuWorkerCount = cpuWorkerCount;
+
+    // only the GPU backend draws double-buffered (see SetDoubleBufferedRendering(...))
+    _updateBarrierBits = this->GetUpdateBarrierBits();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    See SetSimulationBackend(...).
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleSimulationBackend ParticleManager::GetSimulationBackend() const
+{
+    return _simulationBackend;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Runs the same simulation given the same seed, so that a performance run can be repeated 
+    exactly and two runs can be compared particle for particle (see GetParticleChecksum()).  
+    Must be called before Init(...), like SetSimulationBackend(...).
+
+    The random numbers already only depend on the particle and the seed, and the seed only on 
+    the step, so the seed here just picks where the steps start.  What isn't repeatable is the 
+    dead stacks: a particle's spot on its emitter's stack depends on the order that the 
+    update's atomics come in, so which particle an emit pass pops does too.  In this mode the 
+    update doesn't push onto the stacks, and the emit pass looks at a window of each emitter's 
+    range instead and sends out whichever of its particles are inactive (see 
+    EmitParticlesDeterministic() in shaderParticle.comp).
+
+    Note: The caller must also keep the steps the same, which means running a fixed number of 
+    steps per frame (ex: SimulationClock::BeginUnpacedFrame()) for a fixed number of frames.
+    Also Note: Only the particle state is repeatable.  The order of the live indices still 
+    depends on the atomics, so the draw order isn't, and neither are the neighbor 
+    interactions (see ParticleNeighborGrid.h), which add up the neighbors in whatever order 
+    the grid's atomics put them.  The floating point results are only the same for the same 
+    GPU, driver, and program.
+    Also Also Note: Only the GPU backend can do this.  Init(...) turns it off for the others 
+    and says so.
+Parameters:
+    isDeterministic     Self-explanatory.
+    randomSeed          Picks the run.  The seed is used either way, and 0 is the same run as
+                        the manager has without this.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetDeterministic(bool isDeterministic, unsigned int randomSeed)
+{
+    _isDeterministic = isDeterministic;
+    _randomSeed = randomSeed;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    See SetDeterministic(...).  False if Init(...) turned it off.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleManager::IsDeterministic() const
+{
+    return _isDeterministic;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Hashes every byte of the particle buffers (FNV-1a, 64 bits), so two runs of the 
+    deterministic mode can be compared with one number (see SetDeterministic(...)).
+
+    Note: This reads the whole pool back and waits on the GPU to do it, so it is for the end of
+    a run, not for every frame.
+Parameters: None
+Returns:
+    The hash, or 0 if there are no particle buffers.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned long long ParticleManager::GetParticleChecksum() const
+{
+    if (_particleBufferCount == 0)
+    {
+        return 0;
+    }
+
+    // the last update's shader writes must land before glGetBufferSubData(...) reads them
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    unsigned long long hash = 14695981039346656037ull;
+    LargeHostBuffer bufferBytes;
+    for (unsigned int bufferIndex = 0; bufferIndex < _particleBufferCount; bufferIndex++)
+    {
+        size_t bufferSizeBytes = 
+            (size_t)_maxParticleCount * this->GetParticleBufferStride(bufferIndex);
+        if (!bufferBytes.Allocate(bufferSizeBytes))
+        {
+            break;
+        }
+        const unsigned char *bytes = bufferBytes.GetData();
+        glBindBuffer(GL_COPY_READ_BUFFER, _particleBufferIds[bufferIndex]);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, bufferSizeBytes, bufferBytes.GetData());
+        for (size_t byteIndex = 0; byteIndex < bufferSizeBytes; byteIndex++)
+        {
+            hash ^= bytes[byteIndex];
+            hash *= 1099511628211ull;
+        }
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    return hash;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives the split backend's load balancer (see SetSimulationBackend(...)) a profiler to time 
+    the GPU's part of each update with.  The manager begins and ends the scope in each 
+    UpdateSteps(...), and the caller does everything else with the profiler as usual, 
+    EndFrame() included.  The scope may be nested in one of the caller's own.
+Parameters:
+    profiler    The caller's, which must outlive this object or be replaced.  0 stops the 
+                balancing and leaves the split where it is.
+    gpuScopeId  A scope that nothing else begins or ends (see GpuProfiler::AddScope(...)).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetSplitProfiler(GpuProfiler *profiler, unsigned int gpuScopeId)
+{
+    _splitProfiler = profiler;
+    _splitGpuScopeId = gpuScopeId;
+    _splitUpdatesSinceMove = 0;
+    _splitSampleCount = 0;
+    _splitGpuMsSum = 0.0f;
+    _splitCpuMsSum = 0.0f;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Runs another compute API's kernel (ex: the physics team's CUDA) on the particle buffers 
+    in place at the end of every UpdateSteps(...), after the update's own steps and before 
+    the readbacks, so the readbacks and the next draw see what it did.  The buffers are 
+    registered with the interop on the first update and again whenever they are replaced 
+    (ex: Resize(...)), and acquired and released around each call of the kernel (see 
+    ParticleComputeInterop.h for how that syncs with GL).
+
+    Note: Only the GPU backend runs it.  The CPU backend's particles live in the CPU's arrays 
+    and are copied over the buffers on every update, so the kernel's changes would be lost.
+Parameters:
+    interop     Already initialized.  The caller's, which must outlive this object or be 
+                cleared.
+    kernel      Gets the buffers for each update (see ParticleInteropFrame).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetExternalKernel(ParticleComputeInterop *interop, 
+    const ParticleInteropKernel &kernel)
+{
+    this->ClearExternalKernel();
+    _interop = interop;
+    _interopKernel = kernel;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Stops running the external kernel and unregisters the particle buffers from its interop.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::ClearExternalKernel()
+{
+    if (_interop != 0)
+    {
+        _interop->UnregisterBuffers();
+    }
+    _interop = 0;
+    _interopKernel = ParticleInteropKernel();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Hands the particle buffers to the external kernel for one update (see 
+    SetExternalKernel(...)).  A failed registration is logged by the interop and turns the 
+    kernel off, since every update after it would fail the same way.
+Parameters:
+    stepSec     Self-explanatory.
+    numSteps    The steps that this update ran.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::RunExternalKernel(float stepSec, unsigned int numSteps)
+{
+    static_assert(PARTICLE_INTEROP_MAX_BUFFERS >= MAX_PARTICLE_BUFFERS, 
+        "Every particle buffer must fit in ParticleInteropFrame");
+    if (_interop == 0 || !_interopKernel || 
+        _simulationBackend != PARTICLE_SIMULATION_BACKEND_GPU)
+    {
+        return;
+    }
+
+    unsigned int bufferIds[MAX_PARTICLE_BUFFERS] = { 0, 0, 0 };
+    for (unsigned int bufferIndex = 0; bufferIndex < _particleBufferCount; bufferIndex++)
+    {
+        bufferIds[bufferIndex] = _particleBufferIds[bufferIndex];
+    }
+    if (!_interop->IsRegistered(bufferIds, _particleBufferCount) && 
+        !_interop->RegisterBuffers(bufferIds, _particleBufferCount))
+    {
+        this->ClearExternalKernel();
+        return;
+    }
+
+    ParticleInteropFrame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame._layout = _layout;
+    frame._particleCount = _maxParticleCount;
+    frame._stepSec = stepSec;
+    frame._numSteps = numSteps;
+    frame._bufferCount = _particleBufferCount;
+    for (unsigned int bufferIndex = 0; bufferIndex < _particleBufferCount; bufferIndex++)
+    {
+        frame._bufferSizesBytes[bufferIndex] = 
+            (size_t)_maxParticleCount * this->GetParticleBufferStride(bufferIndex);
+    }
+    frame._stream = _interop->GetStream();
+
+    GlDebugGroup externalGroup("external kernel");
+    if (_interop->Acquire(frame._buffers))
+    {
+        _interopKernel(frame);
+        _interop->Release();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.  With the GPU backend, every particle is the GPU's, and with the CPU 
+    backend, every one is the CPU's.
+Parameters:
+    putGpuCountHere     The particles that the compute shader simulates.
+    putCpuCountHere     The particles that the CPU's threads simulate.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::GetSplitParticleCounts(unsigned int *putGpuCountHere, 
+    unsigned int *putCpuCountHere) const
+{
+    unsigned int gpuCount = _maxParticleCount;
+    if (_simulationBackend != PARTICLE_SIMULATION_BACKEND_GPU)
+    {
+        gpuCount = _cpuFirstParticle;
+    }
+    *putGpuCountHere = gpuCount;
+    *putCpuCountHere = _maxParticleCount - gpuCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets the size of each particle's point sprite.  Only takes effect while 
+    GL_PROGRAM_POINT_SIZE is enabled, because otherwise the vertex shader's gl_PointSize is 
+    ignored and glPointSize(...) is used instead.  Can be changed at any time.
+Parameters:
+    pointSizePixels     Self-explanatory.  Clamped by the driver to GL_POINT_SIZE_RANGE.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetPointSize(float pointSizePixels)
+{
+    _pointSize = pointSizePixels;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Scales the particle color.  1 is opaque white.  With additive blending, a small value lets 
+    many overlapping particles add up to white, so the brightness of a pixel shows the density 
+    of the cloud instead of saturating at the first particle.  Can be changed at any time.
+Parameters:
+    brightness  Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetParticleBrightness(float brightness)
+{
+    _particleBrightness = brightness;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    See SetPointSize(...).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+float ParticleManager::GetPointSize() const
+{
+    return _pointSize;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    See SetParticleBrightness(...).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+float ParticleManager::GetParticleBrightness() const
+{
+    return _particleBrightness;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets how much of what is behind a particle it covers, for a render program built with 
+    shaderParticleOit.frag (see WeightedOitRenderer.h).  The other fragment shaders don't 
+    have an opacity and ignore it.  Can be changed at any time.
+Parameters:
+    opacity     0 is invisible and 1 is opaque.  Clamped to that.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetParticleOpacity(float opacity)
+{
+    _particleOpacity = (opacity < 0.0f) ? 0.0f : ((opacity > 1.0f) ? 1.0f : opacity);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets which viewports the particles are drawn in, for a render program built with 
+    ParticleMultiViewport::GetRenderShaderDefines().  Other programs only have the one 
+    viewport and ignore it.
+Parameters:
+    viewportMask    A bit per viewport, from ParticleMultiViewport::BeginBroadcast(...).  1 
+                    is the usual viewport alone.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetViewportMask(unsigned int viewportMask)
+{
+    _viewportMask = viewportMask;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Flat particles are white, scaled by the brightness.  Speed palette particles take their 
+    color from the palette (see SetSpeedPalette(...)) by how fast they are going, and fast 
+    particles can also be drawn bigger.  Both are worked out in the vertex shader from the 
+    velocity attribute that it already reads for extrapolation, so neither reads any more of 
+    the particle buffers, and there is no per-particle color to store or to update.  Can be 
+    changed at any time.
+
+    If no palette has been set, the first switch to the speed palette makes a default one 
+    (see InitSpeedPalette()).
+Parameters:
+    colorMode   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetColorMode(ParticleColorMode colorMode)
+{
+    _colorMode = colorMode;
+    if (_colorMode == PARTICLE_COLOR_MODE_SPEED_PALETTE && _speedPaletteTextureId == 0)
+    {
+        this->InitSpeedPalette();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Picks the shape that a quad render program (see GetQuadRenderShaderDefines(...)) draws.  
+    The square is 2 triangles.  The octagon is 6 triangles but is drawn around the particle's 
+    circle instead of its bounding box, so it rasterizes ~17% fewer fragments, which is the 
+    better trade once the particles are large enough that the fragments cost more than the 
+    vertices.  Has no effect on a point sprite program.  Can be changed at any time.
+Parameters:
+    quadShape   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetQuadShape(ParticleQuadShape quadShape)
+{
+    _quadShape = quadShape;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Quads are sized in pixels just like point sprites (see SetPointSize(...)), but they are 
+    drawn in window space, so the vertex shader needs the viewport to convert.  Init(...) 
+    takes the current viewport, and the window should call this whenever it is resized.
+Parameters:
+    widthPixels     Self-explanatory.  Values below 1 are treated as 1.
+    heightPixels    Self-explanatory.  Values below 1 are treated as 1.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetViewportSize(int widthPixels, int heightPixels)
+{
+    _viewportWidth = (widthPixels > 0) ? widthPixels : 1;
+    _viewportHeight = (heightPixels > 0) ? heightPixels : 1;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Tells the draw that it is going into a framebuffer that is this fraction of the viewport on
+    each axis (see ScaledRenderTarget.h), so that the point sprites and the quads are sized 
+    in its pixels and cover the same part of the window as they would at full size.  Can be 
+    changed at any time.
+
+    Note: A point sprite can't be smaller than a pixel, so a point that would be is drawn a 
+    pixel across and dimmed by how much more of the window that covers, which keeps the total
+    light of additive blending the same.
+Parameters:
+    renderScale     1 is the viewport itself.  Clamped to (0, 1].
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetRenderScale(float renderScale)
+{
+    _renderScale = (renderScale > 0.0f && renderScale < 1.0f) ? renderScale : 1.0f;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets the camera (see Camera2D.h).  The simulation doesn't change; the render program 
+    draws the particles through the view, and if culling is on, the update's stream compaction 
+    leaves the particles that can't be seen out of the indirect draw, so when zoomed in, the 
+    vertex shader and the rasterizer only pay for the particles on the screen.  The update 
+    itself still covers every live particle.  Takes effect on the next Update(...) or 
+    Render(...).
+
+    Note: With culling on, the live counts (see GetParticleCounts(...) and 
+    GetDrawGroupLiveCount(...)) are the particles that were drawn.  A sort (see 
+    SortParticles()) writes every live particle back into the draw until the next update 
+    culls them again, and the CPU backend doesn't cull.
+Parameters:
+    viewProjection  From window space to clip space.  2D: only X and Y are used.
+    isCulled        Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetView(const glm::mat4 &viewProjection, bool isCulled)
+{
+    _viewProjection = viewProjection;
+    _isViewCulled = isCulled;
+}
+
+// the automatic levels of detail go by the live counts and the GPU profiler's times, which are
+// both a few updates behind (see GetParticleCounts(...)), so after a change of stride they 
+// wait this long for it to show up in them
+static const unsigned int LOD_SETTLE_UPDATES = 8;
+
+// a stride that would only thin out the draw by less than this much isn't worth a change, so a
+// draw that is right at its limit doesn't go back and forth between 2 strides
+static const float LOD_HYSTERESIS = 1.25f;
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    settings    See ParticleLodSettings.
+    lodStride   The stride that the live indices were picked with.
+Returns:
+    How much bigger the drawn particles are to cover the ones that aren't drawn.  The area 
+    goes up by the stride, so the size goes up by its square root.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static float GetLodPointSizeScale(const ParticleLodSettings &settings, unsigned int lodStride)
+{
+    return settings._scalesPointSize ? sqrtf((float)lodStride) : 1.0f;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    settings    See ParticleLodSettings.
+    lodStride   The stride that the live indices were picked with.
+Returns:
+    How much brighter the drawn particles are to make up for the ones that aren't drawn.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static float GetLodBrightnessScale(const ParticleLodSettings &settings, unsigned int lodStride)
+{
+    return settings._scalesPointSize ? 1.0f : (float)lodStride;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Same as GetLodBrightnessScale(...), but for the opacity, which doesn't add up: each drawn 
+    particle covers as much as the stride's worth of particles would have together.
+Parameters:
+    settings    See ParticleLodSettings.
+    lodStride   The stride that the live indices were picked with.
+    opacity     See ParticleManager::SetParticleOpacity(...).
+Returns:
+    The drawn particles' opacity.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static float GetLodOpacity(const ParticleLodSettings &settings, unsigned int lodStride,
+    float opacity)
+{
+    if (settings._scalesPointSize || lodStride <= 1)
+    {
+        return opacity;
+    }
+    return 1.0f - powf(1.0f - opacity, (float)lodStride);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Has the update only draw a stable subset of the particles, 1 in every so many of them 
+    (the "stride"), picked by a hash of their index (see IsParticleInLod(...) in 
+    shaderParticle.comp).  When there are many more particles than pixels, most of the draw is
+    particles landing on top of each other, so thinning them out and making the rest brighter 
+    or bigger (see ParticleLodSettings) looks about the same and keeps the cost of the draw 
+    from growing with the pool.  The simulation still updates every particle.
+
+    The fixed mode always uses its stride.  The pixel density mode picks the stride from the 
+    number of particles that can be seen (see SetView(...)) and the size of the viewport, so 
+    it only thins out a cloud that is small on the screen, and the frame budget mode picks it
+    from the draw's GPU time (see ReportRenderTime(...)).  The stride is only changed between 
+    updates.
+
+    Note: The CPU backend builds the draw on the CPU and always draws every particle.  A sort 
+    (see SetParticleSort(...)) moves the particles to different indices, so a different 
+    subset is drawn after each sort.
+Parameters:
+    settings    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetLevelOfDetail(const ParticleLodSettings &settings)
+{
+    _lodSettings = settings;
+    _lodSettleUpdates = 0;
+    if (_lodSettings._mode != PARTICLE_LOD_FIXED)
+    {
+        // the automatic modes start from drawing everything
+        _lodStride = 1;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Feeds the frame budget level of detail (see SetLevelOfDetail(...)).  Call it once a frame 
+    with the draw's most recent GPU time (ex: GpuProfilerStats::_lastMs of the scope around 
+    Render(...)).
+Parameters:
+    renderMs    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::ReportRenderTime(float renderMs)
+{
+    _lastRenderMs = renderMs;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The level of detail's stride for the most recent update.  1 draws every particle.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleManager::GetLodStride() const
+{
+    return _lodStride;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Has the update spend less time on the particles that aren't drawn: the ones that the 
+    level of detail leaves out (see SetLevelOfDetail(...)) and the ones that the view culls 
+    (see SetView(...)).  They are only integrated on 1 in every amortizationFactor update 
+    dispatches, and with amortizationFactor times the time step when they are, so they end up 
+    about where they would have been, and the update's cost for a large background goes down 
+    by about the factor.  The particles that are drawn are updated every time.
+
+    Which particles are due goes by runs of 32 consecutive indices, in turn, so the 
+    particles that are integrated together are next to each other in the buffers and the 
+    loads and stores stay coalesced.  The importance of a particle is worked out every update:
+    one that is left out by the level of detail costs nothing but its active bit when it isn't
+    due, and one that is culled costs a load to find out that it is still out of view.
+
+    Note: A particle that comes into view is drawn where it was last integrated until its run 
+    comes up, which is at most amortizationFactor - 1 dispatches.  A larger time step is less 
+    accurate (and can step over a narrow boundary), so the factor is limited to 8.
+    Also Note: Only the GPU's particles are amortized.  The CPU backend, and the CPU's part of
+    the split backend, update every particle every time.
+Parameters:
+    amortizationFactor  1 (the default) or 0 updates every particle every time.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetUpdateAmortization(unsigned int amortizationFactor)
+{
+    const unsigned int MAX_UPDATE_AMORTIZATION = 8;
+    if (amortizationFactor < 1)
+    {
+        amortizationFactor = 1;
+    }
+    else if (amortizationFactor > MAX_UPDATE_AMORTIZATION)
+    {
+        amortizationFactor = MAX_UPDATE_AMORTIZATION;
+    }
+    _updateAmortization = amortizationFactor;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The factor from SetUpdateAmortization(...).  1 updates every particle every time.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleManager::GetUpdateAmortization() const
+{
+    return _updateAmortization;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Picks the level of detail's stride for the coming update (see SetLevelOfDetail(...)).
+
+    Both the draw's particle count and its GPU time go down with 1 / stride, so the stride 
+    that would just fit the limit is the current stride times how far over the limit the 
+    draw is.  It is rounded up so that the draw lands under the limit.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::UpdateLodStride()
+{
+    if (_lodSettings._mode == PARTICLE_LOD_OFF || 
+        _simulationBackend == PARTICLE_SIMULATION_BACKEND_CPU)
+    {
+        _lodStride = 1;
+        return;
+    }
+    if (_lodSettings._mode == PARTICLE_LOD_FIXED)
+    {
+        _lodStride = (_lodSettings._fixedStride > 1) ? _lodSettings._fixedStride : 1;
+        return;
+    }
+    if (_lodSettleUpdates > 0)
+    {
+        _lodSettleUpdates--;
+        return;
+    }
+
+    // how many times over its limit the draw is (less than 1 is under it)
+    float overLimit = 1.0f;
+    if (_lodSettings._mode == PARTICLE_LOD_PIXEL_DENSITY)
+    {
+        float pixelCount = (float)_viewportWidth * (float)_viewportHeight;
+        float maxDrawnCount = pixelCount * _lodSettings._maxParticlesPerPixel;
+        overLimit = (maxDrawnCount > 0.0f) ? ((float)_latestLiveCount / maxDrawnCount) : 1.0f;
+    }
+    else if (_lodSettings._mode == PARTICLE_LOD_FRAME_BUDGET)
+    {
+        overLimit = (_lodSettings._renderBudgetMs > 0.0f) ? 
+            (_lastRenderMs / _lodSettings._renderBudgetMs) : 1.0f;
+    }
+
+    unsigned int maxStride = (_lodSettings._maxStride > 1) ? _lodSettings._maxStride : 1;
+    float idealStride = (float)_lodStride * overLimit;
+    idealStride = (idealStride > (float)maxStride) ? (float)maxStride : idealStride;
+    unsigned int newStride = _lodStride;
+    if (idealStride > (float)_lodStride || (idealStride * LOD_HYSTERESIS) < (float)_lodStride)
+    {
+        newStride = (unsigned int)ceilf(idealStride);
+    }
+    newStride = (newStride < 1) ? 1 : newStride;
+    if (newStride != _lodStride)
+    {
+        _lodStride = newStride;
+        _lodSettleUpdates = LOD_SETTLE_UPDATES;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Works out the view's cull margin from the current point size and uploads the view if it 
+    changed, and binds it for the shaders either way.  The frame graph binds a view of its 
+    own, so this is done before every update and every draw.
+
+    The margin is the radius of the biggest point that any draw group can draw, so a particle 
+    isn't culled while any of its point is still on the screen.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::UploadView()
+{
+    if (_viewBufferId == 0)
+    {
+        return;
+    }
+
+    float maxPointSize = _pointSize;
+    float maxGroupScale = 1.0f;
+    for (size_t groupIndex = 0; groupIndex < _drawGroupStyles.size(); groupIndex++)
+    {
+        if (_drawGroupStyles[groupIndex].x > maxGroupScale)
+        {
+            maxGroupScale = _drawGroupStyles[groupIndex].x;
+        }
+    }
+    maxPointSize *= maxGroupScale;
+    if (_colorMode == PARTICLE_COLOR_MODE_SPEED_PALETTE && _fastPointSizeScale > 1.0f)
+    {
+        maxPointSize *= _fastPointSizeScale;
+    }
+    maxPointSize *= GetLodPointSizeScale(_lodSettings, _lodStride);
+
+    // the point size is a diameter in pixels, and a pixel is 2 / viewport size in clip space, 
+    // so the radius in clip space is the size / viewport size
+    // Note: A little extra covers an octagon quad's corners (see GetQuadCorner(...) in 
+    // shaderParticle.vert).
+    ViewParameters view = {};
+    view._viewProjection = _viewProjection;
+    view._cullMargin = glm::vec2(maxPointSize / _viewportWidth, maxPointSize / _viewportHeight) *
+        1.1f;
+    view._isCulled = _isViewCulled ? 1 : 0;
+    view._lodStride = _lodStride;
+    if (memcmp(&view, &_uploadedView, sizeof(view)) != 0)
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, _viewBufferId);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(view), &view);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        _uploadedView = view;
+    }
+    glBindBufferBase(GL_UNIFORM_BUFFER, VIEW_PARAMETERS_BINDING, _viewBufferId);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Uploads the colors of the speed palette.  The first color is for a particle at rest and 
+    the last is for a particle at the max speed (or faster), and the texture's linear filter 
+    blends between them.  Can be called at any time after Init(...).
+Parameters:
+    colors              At least one.  A few is plenty.
+    maxSpeed            The speed, in window space per second, that gets the last color.  
+                        Must be greater than 0.
+    fastPointSizeScale  The point size of a max speed particle relative to one at rest.  1 
+                        keeps every particle the same size.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetSpeedPalette(const std::vector<glm::vec3> &colors, float maxSpeed, 
+    float fastPointSizeScale)
+{
+    if (colors.empty() || maxSpeed <= 0.0f)
+    {
+        LogPrintf("speed palette needs at least one color and a max speed over 0\n");
+        return;
+    }
+
+    // the storage is immutable, so a different size needs a new texture
+    if (_speedPaletteTextureId != 0 && _speedPaletteSize != colors.size())
+    {
+        this->ReleaseBindlessTextures();
+        _speedPaletteTextureId.Reset();
+    }
+    if (_speedPaletteTextureId == 0)
+    {
+        _speedPaletteSize = (unsigned int)colors.size();
+        _speedPaletteTextureId = GenerateGlTexture();
+        glBindTexture(GL_TEXTURE_1D, _speedPaletteTextureId);
+        glTexStorage1D(GL_TEXTURE_1D, 1, GL_RGB8, _speedPaletteSize);
+        RecordGpuAllocation(GPU_MEMORY_TEXTURE, _speedPaletteTextureId, 
+            GetGlTextureSizeBytes(GL_RGB8, _speedPaletteSize, 1), "particle speed palette");
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    }
+    else
+    {
+        glBindTexture(GL_TEXTURE_1D, _speedPaletteTextureId);
+    }
+    glTexSubImage1D(GL_TEXTURE_1D, 0, 0, _speedPaletteSize, GL_RGB, GL_FLOAT, colors.data());
+    glBindTexture(GL_TEXTURE_1D, 0);
+
+    _paletteMaxSpeed = maxSpeed;
+    _fastPointSizeScale = fastPointSizeScale;
+    this->ApplyBindlessTextures();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    A default speed palette: dim blue at rest, through orange, to white at the fastest speed 
+    that any of the emitters can give a particle.  Fast particles are drawn twice as big.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::InitSpeedPalette()
+{
+    float maxSpeed = 0.0f;
+    for (size_t emitterIndex = 0; emitterIndex < _emitters.size(); emitterIndex++)
+    {
+        if (_emitters[emitterIndex]._velocityMax > maxSpeed)
+        {
+            maxSpeed = _emitters[emitterIndex]._velocityMax;
+        }
+    }
+    if (maxSpeed <= 0.0f)
+    {
+        maxSpeed = 1.0f;
+    }
+
+    std::vector<glm::vec3> colors;
+    colors.push_back(glm::vec3(0.1f, 0.2f, 0.8f));
+    colors.push_back(glm::vec3(0.2f, 0.7f, 0.9f));
+    colors.push_back(glm::vec3(1.0f, 0.6f, 0.1f));
+    colors.push_back(glm::vec3(1.0f, 1.0f, 1.0f));
+    this->SetSpeedPalette(colors, maxSpeed, 2.0f);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Uploads the frames of the flipbook that a flipbook render program (see 
+    GetFlipbookRenderShaderDefines(...)) draws the particles with.  A particle shows the 
+    first frame when it is emitted and steps through the rest as it ages, so an emitter with a 
+    lifetime plays the animation over it (see ParticleEmitter::_lifetimeSec).  Particles from 
+    an emitter without one stay on the first frame.
+
+    The frames are layers of a 2D texture array with a full mip chain, so the frame is just a 
+    layer index and no atlas border bleeds into its neighbor at the smaller levels.  The frame 
+    is multiplied by the particle's color, and its alpha is the coverage, the same as the quad 
+    build's round falloff.  Can be called at any time after Init(...).
+Parameters:
+    frameWidth          Self-explanatory.  Powers of 2 keep the mip levels from rounding.
+    frameHeight         Self-explanatory.
+    frameCount          At least 1.
+    rgbaFrames          frameWidth * frameHeight * frameCount RGBA8 pixels, frame after 
+                        frame, with each frame's rows from the bottom up.
+    cyclesPerLifetime   How many times the animation plays over a lifetime.  1 plays it 
+                        once; more loops it.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetFlipbook(int frameWidth, int frameHeight, unsigned int frameCount, 
+    const std::vector<unsigned char> &rgbaFrames, float cyclesPerLifetime)
+{
+    size_t expectedBytes = (size_t)frameWidth * frameHeight * frameCount * 4;
+    if (frameWidth <= 0 || frameHeight <= 0 || frameCount == 0 || 
+        rgbaFrames.size() != expectedBytes || cyclesPerLifetime <= 0.0f)
+    {
+        LogPrintf("flipbook needs at least one %dx%d frame of RGBA pixels and more than 0 "
+            "cycles\n", frameWidth, frameHeight);
+        return;
+    }
+
+    // a level for every halving of the bigger side, down to 1x1
+    unsigned int levelCount = 1;
+    int largerSide = (frameWidth > frameHeight) ? frameWidth : frameHeight;
+    while ((largerSide >> levelCount) > 0)
+    {
+        levelCount++;
+    }
+
+    // the storage is immutable, so a different size needs a new texture
+    if (_flipbookTextureId != 0 && (_flipbookFrameWidth != frameWidth || 
+        _flipbookFrameHeight != frameHeight || _flipbookFrameCount != frameCount))
+    {
+        _flipbookTextureId.Reset();
+    }
+    if (_flipbookTextureId == 0)
+    {
+        _flipbookFrameWidth = frameWidth;
+        _flipbookFrameHeight = frameHeight;
+        _flipbookFrameCount = frameCount;
+        _flipbookLevelCount = levelCount;
+        _flipbookTextureId = GenerateGlTexture();
+        glBindTexture(GL_TEXTURE_2D_ARRAY, _flipbookTextureId);
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, levelCount, GL_RGBA8, frameWidth, frameHeight, 
+            frameCount);
+        RecordGpuAllocation(GPU_MEMORY_TEXTURE, _flipbookTextureId, 
+            GetGlTextureSizeBytes(GL_RGBA8, frameWidth, frameHeight * frameCount, levelCount), 
+            "particle flipbook");
+
+        // the vertex shader already picked the level, so one level is read per particle 
+        // instead of blending two
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    else
+    {
+        glBindTexture(GL_TEXTURE_2D_ARRAY, _flipbookTextureId);
+    }
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, frameWidth, frameHeight, frameCount, 
+        GL_RGBA, GL_UNSIGNED_BYTE, rgbaFrames.data());
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    _flipbookCycles = cyclesPerLifetime;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    A default flipbook: 16 frames of a 32x32 puff that starts as a small, hot core and 
+    spreads into a cooler ring that fades out by the end of the particle's life.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::InitFlipbook()
+{
+    const int frameSize = 32;
+    const unsigned int frameCount = 16;
+    std::vector<unsigned char> pixels((size_t)frameSize * frameSize * frameCount * 4);
+    for (unsigned int frame = 0; frame < frameCount; frame++)
+    {
+        float progress = (float)frame / (float)(frameCount - 1);
+        float ringRadius = 0.15f + (0.65f * progress);
+        float ringWidth = 0.2f + (0.2f * progress);
+        float fade = 1.0f - (progress * progress);
+        glm::vec3 color = glm::vec3(1.0f, 1.0f, 1.0f) + 
+            ((glm::vec3(0.9f, 0.4f, 0.2f) - glm::vec3(1.0f, 1.0f, 1.0f)) * progress);
+        for (int y = 0; y < frameSize; y++)
+        {
+            for (int x = 0; x < frameSize; x++)
+            {
+                // -1 to +1 across the frame, at the texel's center
+                float u = (((float)x + 0.5f) / frameSize) * 2.0f - 1.0f;
+                float v = (((float)y + 0.5f) / frameSize) * 2.0f - 1.0f;
+                float ringDistance = (sqrtf((u * u) + (v * v)) - ringRadius) / ringWidth;
+                float alpha = 1.0f - (ringDistance * ringDistance);
+                alpha = (alpha > 0.0f) ? (alpha * fade) : 0.0f;
+                size_t texel = (((size_t)frame * frameSize + y) * frameSize + x) * 4;
+                pixels[texel + 0] = (unsigned char)(color.r * 255.0f + 0.5f);
+                pixels[texel + 1] = (unsigned char)(color.g * 255.0f + 0.5f);
+                pixels[texel + 2] = (unsigned char)(color.b * 255.0f + 0.5f);
+                pixels[texel + 3] = (unsigned char)(alpha * 255.0f + 0.5f);
+            }
+        }
+    }
+    this->SetFlipbook(frameSize, frameSize, frameCount, pixels, 1.0f);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Splits the emitters into draw groups.  Each group is a run of consecutive emitters, starting
+    with the given emitter and ending before the next group's.  The update still covers every 
+    group with one dispatch, and Render() still draws every group with one call, but each group
+    gets its own draw command, so each group can have its own style and can be hidden (see 
+    SetDrawGroupStyle(...) and SetDrawGroupVisible(...)), and each group's live count is read 
+    back (see GetDrawGroupLiveCount(...)).  Must be called before Init(...) to have any effect.
+    By default, every emitter is in one group.
+Parameters:
+    firstEmitterOfEachGroup     Must start with 0 and increase.  Checked in Init(...).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetDrawGroups(const std::vector<unsigned int> &firstEmitterOfEachGroup)
+{
+    _drawGroupFirstEmitters = firstEmitterOfEachGroup;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Scales a draw group's point size and brightness on top of SetPointSize(...) and 
+    SetParticleBrightness(...).  Both scales start at 1.  Can be changed at any time after 
+    Init(...).
+Parameters:
+    drawGroupIndex      Self-explanatory.
+    pointSizeScale      Self-explanatory.
+    brightnessScale     Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetDrawGroupStyle(unsigned int drawGroupIndex, float pointSizeScale, 
+    float brightnessScale)
+{
+    if (drawGroupIndex >= _drawGroupStyles.size() || _drawGroupStyleBufferId == 0)
+    {
+        LogPrintf("no draw group %u to set the style of\n", drawGroupIndex);
+        return;
+    }
+
+    _drawGroupStyles[drawGroupIndex] = glm::vec2(pointSizeScale, brightnessScale);
+    glBindBuffer(GL_ARRAY_BUFFER, _drawGroupStyleBufferId);
+    glBufferSubData(GL_ARRAY_BUFFER, drawGroupIndex * sizeof(glm::vec2), sizeof(glm::vec2), 
+        &_drawGroupStyles[drawGroupIndex]);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Hides or shows a draw group by setting its draw command's instance count to 0 or 1.  The 
+    group is still simulated, and its particles are still counted.  Takes effect at the next 
+    Update(...).  The density splat also skips hidden groups (see IsLiveSlot(...) in 
+    shaderParticle.comp).
+Parameters:
+    drawGroupIndex      Self-explanatory.
+    isVisible           Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetDrawGroupVisible(unsigned int drawGroupIndex, bool isVisible)
+{
+    if (drawGroupIndex >= _drawGroupLiveCounts.size())
+    {
+        LogPrintf("no draw group %u to show or hide\n", drawGroupIndex);
+        return;
+    }
+
+    unsigned int wordsPerCommand = sizeof(DrawElementsIndirectCommand) / sizeof(GLuint);
+    unsigned int instanceCountWord = (drawGroupIndex * wordsPerCommand) + 
+        (offsetof(DrawElementsIndirectCommand, _instanceCount) / sizeof(GLuint));
+    _drawCommandResetData[instanceCountWord] = isVisible ? 1 : 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.  Only valid after Init(...).
+Parameters: None
+Returns:
+    The number of draw groups (see SetDrawGroups(...)).
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleManager::GetDrawGroupCount() const
+{
+    return (unsigned int)_drawGroupLiveCounts.size();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Like GetParticleCounts(...), this lags a couple of updates behind, but it never stalls.
+Parameters:
+    drawGroupIndex      Self-explanatory.
+Returns:
+    The number of the group's particles that were alive at the end of that update, or 0 if 
+    there is no such group.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleManager::GetDrawGroupLiveCount(unsigned int drawGroupIndex) const
+{
+    if (drawGroupIndex >= _drawGroupLiveCounts.size())
+    {
+        return 0;
+    }
+    return _drawGroupLiveCounts[drawGroupIndex];
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes whole draw groups that are off the screen out of the draw.  Every step's stream 
+    compaction grows each group's bounding box around the particles that it draws, with an 
+    atomic min per side that is only taken when the side moves, and after the last step, a 
+    pass with one work item per group tests the box against the view (see SetView(...)) and 
+    zeroes the indirect command of a group that is entirely off it, so the batched draw skips 
+    the group without the CPU ever reading the bounds.  A group that drew nothing is culled 
+    too.
+
+    This is the per-group counterpart of the view culling, and it works with that off: the 
+    draw still skips the groups that are off the screen, and the ones on it draw everything.  
+    How long each group has been culled comes back with the counts (see 
+    GetDrawGroupOffScreenSec(...)), which is what a caller goes by to update the groups that 
+    nobody can see less often (see ParticleWorld::SetOffScreenThrottle(...)).
+
+    Note: Only a program built with ParticleKernelVariant::_hasDrawGroupCulling has the 
+    bounds, and the CPU backend doesn't cull.  Like the view culling, the live counts of a 
+    culled group are 0, and a sort (see SortParticles()) draws every group until the next 
+    update.
+Parameters:
+    isCulled    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetDrawGroupCulling(bool isCulled)
+{
+    _isDrawGroupCulled = isCulled;
+    if (!isCulled)
+    {
+        _drawGroupCulledSinceSec.assign(_drawGroupCulledSinceSec.size(), -1.0);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Like GetDrawGroupLiveCount(...), this lags a couple of updates behind, but it never stalls.
+Parameters:
+    drawGroupIndex      Self-explanatory.
+Returns:
+    How much simulation time the group has been culled for without a break (see 
+    SetDrawGroupCulling(...)), or 0 if it is on the screen, or hidden, or there is no such 
+    group.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+float ParticleManager::GetDrawGroupOffScreenSec(unsigned int drawGroupIndex) const
+{
+    if (drawGroupIndex >= _drawGroupCulledSinceSec.size() || 
+        _drawGroupCulledSinceSec[drawGroupIndex] < 0.0)
+    {
+        return 0.0f;
+    }
+    return (float)(_simulationTimeSec - _drawGroupCulledSinceSec[drawGroupIndex]);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    True if the update keeps the draw groups' bounds and culls them (see 
+    SetDrawGroupCulling(...)), which needs the program's uniform and the buffer from 
+    Init(...).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleManager::IsDrawGroupCullingActive() const
+{
+    return _isDrawGroupCulled && _unifLocDrawGroupCulled != (unsigned int)-1 && 
+        _drawGroupBoundsBufferId != 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Empties every draw group's bounds, with a clear instead of a pass.  All 1s is past the 
+    end of every side's order (see GetOrderedFloatBits(...) in shaderParticle.comp), so the 
+    first particle that a step draws sets each side.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::ClearDrawGroupBounds()
+{
+    GLuint empty = 0xffffffff;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _drawGroupBoundsBufferId);
+    glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, 0, 
+        _drawGroupLiveCounts.size() * 4 * sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, 
+        &empty);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The first emitter of each draw group, in order (see SetDrawGroups(...)), so a draw 
+    group's emitters run up to the next one's first.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+const std::vector<unsigned int> &ParticleManager::GetDrawGroupFirstEmitters() const
+{
+    return _drawGroupFirstEmitters;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The CPU's view of a particle buffer when the manager was initialized with 
+    PARTICLE_BUFFER_ACCESS_CPU_READBACK.  The data is in the manager's layout (one buffer of 
+    Particle or PackedHalfParticle, or the 3 structure-of-arrays buffers in binding order).
+    
+    Note: The mapping is coherent, but the GPU may still be writing to it.  Wait on a fence 
+    (or glFinish()) after the update before reading.
+Parameters:
+    bufferIndex     Self-explanatory.
+Returns:
+    The mapped pointer, or 0 if the buffer doesn't exist or isn't mapped.
+Exception:  Safe
+Creator:    John Cox (8-12-2016)
+-----------------------------------------------------------------------------------------------*/
+const void *ParticleManager::GetMappedParticleBuffer(unsigned int bufferIndex) const
+{
+    if (bufferIndex >= _particleBufferCount)
+    {
+        return 0;
+    }
+    return _mappedParticleBuffers[bufferIndex];
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Switches between the targeted memory barrier after the compute dispatch and 
+    GL_ALL_BARRIER_BITS.  Both are correct; this exists so that the cost of the two can be 
+    compared on the same run.
+Parameters:
+    useFullBarrier  True to use GL_ALL_BARRIER_BITS, false to use only the necessary bits.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-6-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetFullMemoryBarrier(bool useFullBarrier)
+{
+    _useFullMemoryBarrier = useFullBarrier;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Picks what the update covers.  With the list (the default), each update appends the 
+    particles that are still alive to a list as well as to the live indices, with the indirect 
+    dispatch for that list at its front that every append grows to cover, and the next update 
+    covers that list, plus what the emit pass appended to it, with glDispatchComputeIndirect(...).
+    At 10% occupancy the update is about a tenth of the work, and the CPU never reads the 
+    count.  Without it, every update covers the whole pool and skips the inactive particles one
+    by one.  Kept around for A/B comparisons.
+
+    Note: The list is in whatever order the atomics came in, so unlike the pool, neighboring 
+    work items don't load neighboring particles.  A mostly live pool may be faster without 
+    it.
+    Also Note: Only the GPU backend uses it.
+Parameters:
+    useList     Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetLiveUpdateList(bool useList)
+{
+    _useUpdateList = useList;
+    _isUpdateListStale = true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Has the next update rebuild its list (see SetLiveUpdateList(...)) from the whole pool.
+    For passes outside of the particle manager that bring particles to life, which the list
+    doesn't know about (ex: ParticleNeighborGrid::MergeDenseCells(...)).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::InvalidateUpdateList()
+{
+    _isUpdateListStale = true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Turns the persistent-threads kernel on with the given number of work groups, or off with 
+    0.  Each update is then a single dispatch that does the emit pass, every step, and the 
+    compaction, with the work groups taking one work group's worth of work at a time off of a 
+    queue (see RunPersistentThreads() in shaderParticle.comp).  For small pools (~20000 
+    particles), launching the passes and the barriers between them take longer than the work,
+    so this cuts the latency of a step.  Big pools are better off with the usual passes.
+
+    Pick enough work groups to fill the GPU and no more (ex: a few per compute unit).  More 
+    than that just wait for each other.
+
+    Note: Only used by the GPU backend, with a compute program that was built with 
+    ParticleKernelVariant::_hasPersistentThreads, and not in the deterministic mode, whose 
+    emit pass is different.  Otherwise the update goes on as before.  The update covers the
+    whole pool with the active mask rather than the update list (see SetLiveUpdateList(...)),
+    which is about the same at this size.
+Parameters:
+    workGroupCount  Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetPersistentThreads(unsigned int workGroupCount)
+{
+    _persistentWorkGroupCount = workGroupCount;
+    _isUpdateListStale = true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    True if the next update will use the persistent-threads kernel (see 
+    SetPersistentThreads(...)), otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleManager::IsPersistentThreadsActive() const
+{
+    return _persistentWorkGroupCount > 0 && _hasPersistentKernel && 
+        _simulationBackend == PARTICLE_SIMULATION_BACKEND_GPU && !_isDeterministic;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Turns the fused emit on or off.  With it on, the emit pass is skipped, and the update pass
+    sends the particles out instead: each particle is loaded once, and one that is dead or 
+    that dies in this update takes a number from its emitter with an aggregated atomic (see 
+    ParticleAtomicAggregation), and if the number is under the emitter's quota, it is 
+    respawned in registers, stored once, and appended to the live list like any other (see 
+    UpdateParticle(...) in shaderParticle.comp).  That takes out the emit pass's dispatch, 
+    the barrier after it, the pushes and pops of the dead stacks, and the dead indices' reads 
+    and writes, and a particle that dies and comes back in the same update is stored once 
+    instead of twice.
+
+    The cost is that the update covers the whole pool with the active mask rather than the 
+    update list (see SetLiveUpdateList(...)), since it has to come across the dead particles,
+    and each dead one looks up its emitter.  That is a win when most of the pool is alive and
+    a loss when most of it is dead, which the kernel benchmarks show (see Benchmark.h).  A 
+    particle that is sent out isn't integrated until the next update, where the emit pass's 
+    particles are integrated by the update that follows it.
+
+    Note: Only used by the GPU backend, with a compute program that was built with 
+    ParticleKernelVariant::_hasFusedEmitUpdate, and not in the deterministic mode, whose 
+    emit pass is different, or with the persistent-threads kernel, which already fuses the 
+    passes its own way.  The bursts and the sub-emitters take their particles off of the dead
+    stacks, so they are off while it is on.
+Parameters:
+    isFused     Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetFusedEmitUpdate(bool isFused)
+{
+    _isFusedEmitUpdate = isFused;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    True if the next update will emit in the update pass (see SetFusedEmitUpdate(...)), 
+    otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleManager::IsFusedEmitUpdateActive() const
+{
+    return _isFusedEmitUpdate && _unifLocFusedEmitMode != (unsigned int)-1 && 
+        _simulationBackend == PARTICLE_SIMULATION_BACKEND_GPU && !_isDeterministic && 
+        !this->IsPersistentThreadsActive();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Draws the particles that were still alive at the end of the last Update(...).  The compute 
+    shader wrote their indices into the live index buffer (bound to the VAO as the element 
+    array) and their counts into the indirect draw commands, so the CPU never needs to know how
+    many there are.  However many draw groups there are, this is a single multi-draw call.
+Parameters:
+    extrapolationSec    The vertex shader moves each particle forward along its velocity by 
+                        this much.  Used to smooth out motion when the simulation runs at a 
+                        fixed rate that doesn't line up with the frame rate.  0 draws the 
+                        particles exactly where the simulation left them.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (7-26-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::Render(float extrapolationSec)
+{
+    GlDebugGroup renderGroup("ParticleManager render");
+    this->UploadView();
+    UseGlProgram(_programId);
+
+    // the copy is one update behind the originals, so it is moved forward by that update too
+    bool isDrawingCopy = this->IsDoubleBufferedRenderingActive();
+    GLuint drawCommandBufferId = _drawCommandBufferId;
+    if (isDrawingCopy)
+    {
+        drawCommandBufferId = _renderCopyDrawCommandBufferIds[_renderCopyIndex];
+        extrapolationSec += _renderCopyLagSec;
+    }
+    glUniform1f(_unifLocExtrapolationSec, extrapolationSec);
+
+    // a smaller framebuffer has smaller pixels to be sized in, but a point can't be drawn 
+    // smaller than 1 of them, and then it covers more of the window than it should, so it is 
+    // dimmer by as much (see SetRenderScale(...))
+    float pointSize = _pointSize * GetLodPointSizeScale(_lodSettings, _lodStride);
+    float scaledPointSize = pointSize * _renderScale;
+    float renderScaleBrightness = 1.0f;
+    if (!_isQuadRendering && scaledPointSize < 1.0f)
+    {
+        renderScaleBrightness = scaledPointSize * scaledPointSize;
+    }
+    glUniform1f(_unifLocPointSize, scaledPointSize);
+    glUniform1f(_unifLocParticleBrightness, _particleBrightness * renderScaleBrightness * 
+        GetLodBrightnessScale(_lodSettings, _lodStride));
+    glUniform1f(_unifLocParticleOpacity, GetLodOpacity(_lodSettings, _lodStride, 
+        _particleOpacity));
+    glUniform1i(_unifLocColorMode, _colorMode);
+    glUniform1i(_unifLocViewportMask, (GLint)_viewportMask);
+    if (_colorMode == PARTICLE_COLOR_MODE_SPEED_PALETTE)
+    {
+        glUniform1f(_unifLocPaletteMaxSpeed, _paletteMaxSpeed);
+        glUniform1f(_unifLocFastPointSizeScale, _fastPointSizeScale);
+        if (_speedPaletteTextureHandle != 0)
+        {
+            gUniformHandleui64Arb(_unifLocSpeedPalette, _speedPaletteTextureHandle);
+        }
+        else
+        {
+            glUniform1i(_unifLocSpeedPalette, SPEED_PALETTE_TEXTURE_UNIT);
+            glActiveTexture(GL_TEXTURE0 + SPEED_PALETTE_TEXTURE_UNIT);
+            glBindTexture(GL_TEXTURE_1D, _speedPaletteTextureId);
+        }
+    }
+    if (_isFlipbookRendering)
+    {
+        if (_flipbookTextureId == 0)
+        {
+            this->InitFlipbook();
+        }
+        glUniform1ui(_unifLocFlipbookFrameCount, _flipbookFrameCount);
+        glUniform1f(_unifLocFlipbookCycles, _flipbookCycles);
+        glUniform1f(_unifLocFlipbookFrameSize, 
+            (float)((_flipbookFrameWidth > _flipbookFrameHeight) ? 
+            _flipbookFrameWidth : _flipbookFrameHeight));
+        glUniform1f(_unifLocFlipbookMaxLod, (float)(_flipbookLevelCount - 1));
+        glUniform1i(_unifLocFlipbook, FLIPBOOK_TEXTURE_UNIT);
+        glActiveTexture(GL_TEXTURE0 + FLIPBOOK_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, _flipbookTextureId);
+    }
+    if (isDrawingCopy)
+    {
+        // the vertex pulling and quad builds read the particles and the draw commands as 
+        // shader storage, at the same bindings as the update
+        BindGlVertexArray(_renderCopyVaoIds[_renderCopyIndex]);
+        for (unsigned int bufferIndex = 0; bufferIndex < _particleBufferCount; bufferIndex++)
+        {
+            BindGlShaderStorageBuffer(bufferIndex, 
+                _renderCopyParticleBufferIds[_renderCopyIndex][bufferIndex]);
+        }
+        BindGlShaderStorageBuffer(DRAW_COMMAND_BUFFER_BINDING, drawCommandBufferId);
+    }
+    else
+    {
+        BindGlVertexArray(_vaoId);
+    }
+    if (_isQuadRendering)
+    {
+        this->RenderQuads(drawCommandBufferId);
+    }
+    else
+    {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, drawCommandBufferId);
+        glMultiDrawElementsIndirect(_drawStyle, GL_UNSIGNED_INT, 
+            (void *)sizeof(DrawCommandBufferHeader), (GLsizei)_drawGroupLiveCounts.size(), 0);
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    if (isDrawingCopy)
+    {
+        // the update expects its own buffers where Init(...) put them
+        for (unsigned int bufferIndex = 0; bufferIndex < _particleBufferCount; bufferIndex++)
+        {
+            BindGlShaderStorageBuffer(bufferIndex, _particleBufferIds[bufferIndex]);
+        }
+        BindGlShaderStorageBuffer(DRAW_COMMAND_BUFFER_BINDING, _drawCommandBufferId);
+    }
+    if (_colorMode == PARTICLE_COLOR_MODE_SPEED_PALETTE && _speedPaletteTextureHandle == 0)
+    {
+        glActiveTexture(GL_TEXTURE0 + SPEED_PALETTE_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_1D, 0);
+    }
+    if (_isFlipbookRendering)
+    {
+        glActiveTexture(GL_TEXTURE0 + FLIPBOOK_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // the program and the VAO are left bound, like Update(...)'s program, so the next frame's 
+    // binds of the same ones are skipped (see GlStateCache.h)
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The instanced version of Render()'s draw for a quad render program (see 
+    GetQuadRenderShaderDefines(...)).  Every draw group gets a glDrawArraysInstanced(...)-style
+    indirect command with a vertex for each of the quad's corners and an instance for each of 
+    its live particles, and they are all drawn with one glMultiDrawArraysIndirect(...).
+
+    Only the GPU knows the live counts, so the commands are written in two parts: the CPU 
+    uploads the corners, the visibility, and the base instances (one small upload per frame), 
+    and then each group's live count is copied on the GPU from the "count" of its indexed draw
+    command to the "instance count" of its quad command.  UpdateSteps(...) already puts up a 
+    GL_BUFFER_UPDATE_BARRIER_BIT for the copy.
+
+    Note: The program and the VAO must be bound prior to calling this.
+Parameters:
+    drawCommandBufferId     The indexed draw commands that the counts come from, which are 
+                            the render copy's when rendering is double-buffered.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::RenderQuads(unsigned int drawCommandBufferId)
+{
+    unsigned int numDrawGroups = (unsigned int)_drawGroupLiveCounts.size();
+    unsigned int cornerCount = (_quadShape == PARTICLE_QUAD_SHAPE_OCTAGON) ? 8 : 4;
+    unsigned int wordsPerElementsCommand = sizeof(DrawElementsIndirectCommand) / sizeof(GLuint);
+    unsigned int wordsPerQuadCommand = sizeof(DrawArraysIndirectCommand) / sizeof(GLuint);
+    for (unsigned int groupIndex = 0; groupIndex < numDrawGroups; groupIndex++)
+    {
+        const DrawElementsIndirectCommand *elementsCommand = (const DrawElementsIndirectCommand *)
+            &_drawCommandResetData[groupIndex * wordsPerElementsCommand];
+        DrawArraysIndirectCommand quadCommand = {};
+        quadCommand._count = (elementsCommand->_instanceCount > 0) ? cornerCount : 0;
+        quadCommand._instanceCount = 0;
+        quadCommand._first = 0;
+        quadCommand._baseInstance = elementsCommand->_firstIndex;
+        memcpy(&_quadCommandData[groupIndex * wordsPerQuadCommand], &quadCommand, 
+            sizeof(quadCommand));
+    }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _quadCommandBufferId);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, numDrawGroups * sizeof(DrawArraysIndirectCommand),
+        _quadCommandData.data());
+    glBindBuffer(GL_COPY_READ_BUFFER, drawCommandBufferId);
+    for (unsigned int groupIndex = 0; groupIndex < numDrawGroups; groupIndex++)
+    {
+        GLintptr readOffset = sizeof(DrawCommandBufferHeader) + 
+            (groupIndex * sizeof(DrawElementsIndirectCommand)) + 
+            offsetof(DrawElementsIndirectCommand, _count);
+        GLintptr writeOffset = (groupIndex * sizeof(DrawArraysIndirectCommand)) + 
+            offsetof(DrawArraysIndirectCommand, _instanceCount);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_DRAW_INDIRECT_BUFFER, readOffset, 
+            writeOffset, sizeof(GLuint));
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    // the styles are bound here rather than at Init(...) so that the binding can't be taken by
+    // something else in between
+    BindGlShaderStorageBuffer(DRAW_GROUP_STYLE_BUFFER_BINDING, _drawGroupStyleBufferId);
+    glUniform1i(_unifLocQuadCornerCount, cornerCount);
+    glUniform2f(_unifLocViewportSize, _viewportWidth * _renderScale, 
+        _viewportHeight * _renderScale);
+    GLenum quadDrawStyle = (cornerCount == 4) ? GL_TRIANGLE_STRIP : GL_TRIANGLE_FAN;
+    glMultiDrawArraysIndirect(quadDrawStyle, 0, numDrawGroups, 0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Builds the set of memory barrier bits that must follow the compute dispatch, based on what 
+    reads the compute shader's incoherent writes afterwards.  The readers are declared to a 
+    RenderPassGraph, which works out the bits from how each one reads (see 
+    RenderPassGraph.h), so a new reader is a new pass rather than a bit picked by hand:
+    (1) Render() sources the particle buffer(s) through the VAO's vertex attributes, so vertex 
+    data sourced from buffer objects after the barrier must reflect the shader's writes.
+    (2) The next frame's dispatch reads the same shader storage buffer(s) again.
+    (3) The next Update(...) overwrites the draw command's count, which must not race the 
+    shader's atomic increments.
+    (4) Render() sources the draw command from the GL_DRAW_INDIRECT_BUFFER, and the next 
+    update dispatches from the update list that this one appended to.
+    (5) Render() sources the live indices from the GL_ELEMENT_ARRAY_BUFFER.
+    When rendering is double-buffered (see SetDoubleBufferedRendering(...)), Render() draws 
+    copies that were made with glCopyBufferSubData(...), so (1), (4), and (5) are a copy's 
+    reads instead.
+Parameters: None
+Returns:
+    A bitfield for glMemoryBarrier(...).
+Exception:  Safe
+Creator:    John Cox (8-6-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleManager::GetUpdateBarrierBits() const
+{
+    RenderPassGraph graph;
+    unsigned int particles = graph.AddResource("particles");
+    unsigned int liveIndices = graph.AddResource("live indices");
+    unsigned int drawCommands = graph.AddResource("draw commands");
+    unsigned int updateList = graph.AddResource("update list");
+
+    unsigned int update = graph.AddPass("update");
+    graph.AddAccess(update, particles, RENDER_GRAPH_ACCESS_SHADER_STORAGE_WRITE);
+    graph.AddAccess(update, liveIndices, RENDER_GRAPH_ACCESS_SHADER_STORAGE_WRITE);
+    graph.AddAccess(update, drawCommands, RENDER_GRAPH_ACCESS_SHADER_STORAGE_WRITE);
+    graph.AddAccess(update, updateList, RENDER_GRAPH_ACCESS_SHADER_STORAGE_WRITE);
+
+    // the draw, or the next update's copy of what it draws
+    bool isDrawingCopy = 
+        _isDoubleBufferedRendering && _simulationBackend == PARTICLE_SIMULATION_BACKEND_GPU;
+    unsigned int render = graph.AddPass(isDrawingCopy ? "render copy" : "render");
+    graph.AddAccess(render, particles, isDrawingCopy ? 
+        RENDER_GRAPH_ACCESS_BUFFER_COPY_READ : RENDER_GRAPH_ACCESS_VERTEX_ATTRIB);
+    graph.AddAccess(render, liveIndices, isDrawingCopy ? 
+        RENDER_GRAPH_ACCESS_BUFFER_COPY_READ : RENDER_GRAPH_ACCESS_ELEMENT_ARRAY);
+    graph.AddAccess(render, drawCommands, isDrawingCopy ? 
+        RENDER_GRAPH_ACCESS_BUFFER_COPY_READ : RENDER_GRAPH_ACCESS_INDIRECT_COMMAND);
+
+    unsigned int resetCommands = graph.AddPass("reset draw commands");
+    graph.AddAccess(resetCommands, drawCommands, RENDER_GRAPH_ACCESS_BUFFER_UPDATE);
+
+    unsigned int nextUpdate = graph.AddPass("next update");
+    graph.AddAccess(nextUpdate, updateList, RENDER_GRAPH_ACCESS_INDIRECT_COMMAND);
+    graph.AddAccess(nextUpdate, particles, RENDER_GRAPH_ACCESS_SHADER_STORAGE_WRITE);
+    graph.AddAccess(nextUpdate, liveIndices, RENDER_GRAPH_ACCESS_SHADER_STORAGE_WRITE);
+    graph.AddAccess(nextUpdate, drawCommands, RENDER_GRAPH_ACCESS_SHADER_STORAGE_WRITE);
+    graph.AddAccess(nextUpdate, updateList, RENDER_GRAPH_ACCESS_SHADER_STORAGE_WRITE);
+
+    // all of it lives on into the frames after
+    graph.MarkOutput(particles);
+    graph.MarkOutput(liveIndices);
+    graph.MarkOutput(drawCommands);
+    graph.MarkOutput(updateList);
+    graph.Compile();
+    return graph.GetBarrierBitsAfter(update);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Turns the emitters' rates into this update's quotas (see SetEmissionRates(...)).  Only 
+    the emitters whose quotas changed are marked for upload (see FlushDirtyTables()).
+Parameters:
+    emitSpanSec     The simulation time that this update covers.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::UpdateEmissionQuotas(float emitSpanSec)
+{
+    size_t ratedCount = _emissionRates.size();
+    if (ratedCount > _emitters.size())
+    {
+        ratedCount = _emitters.size();
+    }
+
+    bool isChanged = false;
+    for (size_t emitterIndex = 0; emitterIndex < ratedCount; emitterIndex++)
+    {
+        if (_emissionRates[emitterIndex] <= 0.0f)
+        {
+            continue;
+        }
+
+        // the fraction that is left over is carried in a double, so it never drifts
+        ParticleEmitter &emitter = _emitters[emitterIndex];
+        double emitted = _emissionRemainders[emitterIndex] + 
+            ((double)_emissionRates[emitterIndex] * emitSpanSec);
+        unsigned int emitCount = (unsigned int)emitted;
+        _emissionRemainders[emitterIndex] = emitted - emitCount;
+        if (emitCount > emitter._particleCount)
+        {
+            emitCount = emitter._particleCount;
+        }
+        if (emitCount == emitter._maxParticlesEmittedPerFrame)
+        {
+            continue;
+        }
+
+        emitter._maxParticlesEmittedPerFrame = emitCount;
+        this->MarkEmittersDirty((unsigned int)emitterIndex, 1);
+        isChanged = true;
+    }
+    if (isChanged)
+    {
+        _maxEmitterQuota = this->GetMaxEmitterQuota();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Widens the range of emitters that the next update uploads to cover these.
+Parameters:
+    firstEmitter    Self-explanatory.
+    emitterCount    0 does nothing.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::MarkEmittersDirty(unsigned int firstEmitter, unsigned int emitterCount)
+{
+    if (emitterCount == 0)
+    {
+        return;
+    }
+    if (_dirtyEmitterFirst >= _dirtyEmitterEnd)
+    {
+        _dirtyEmitterFirst = firstEmitter;
+        _dirtyEmitterEnd = firstEmitter + emitterCount;
+        return;
+    }
+    if (firstEmitter < _dirtyEmitterFirst)
+    {
+        _dirtyEmitterFirst = firstEmitter;
+    }
+    if (firstEmitter + emitterCount > _dirtyEmitterEnd)
+    {
+        _dirtyEmitterEnd = firstEmitter + emitterCount;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Widens the range of force fields that the next update uploads to cover these.
+Parameters:
+    firstForceField     Self-explanatory.
+    forceFieldCount     0 does nothing.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::MarkForceFieldsDirty(unsigned int firstForceField, 
+    unsigned int forceFieldCount)
+{
+    if (forceFieldCount == 0)
+    {
+        return;
+    }
+    if (_dirtyForceFieldFirst >= _dirtyForceFieldEnd)
+    {
+        _dirtyForceFieldFirst = firstForceField;
+        _dirtyForceFieldEnd = firstForceField + forceFieldCount;
+        return;
+    }
+    if (firstForceField < _dirtyForceFieldFirst)
+    {
+        _dirtyForceFieldFirst = firstForceField;
+    }
+    if (firstForceField + forceFieldCount > _dirtyForceFieldEnd)
+    {
+        _dirtyForceFieldEnd = firstForceField + forceFieldCount;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Uploads the entries of the emitter and force field tables that changed on the CPU since 
+    the last update, with one glBufferSubData(...) per table that covers all of them, and 
+    takes the count of uploaded bytes for GetTableUploadBytes().  Designers' tweaks and 
+    animated emitters only touch a few entries, so most updates upload a few hundred bytes 
+    or nothing instead of the whole tables.
+
+    Note: The tables stay in mutable storage that is written with glBufferSubData(...) 
+    instead of being persistently mapped, because the kernels of the frames in flight still 
+    read them, and the driver's copy keeps those frames' tables intact without any fences 
+    or copies per frame.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::FlushDirtyTables()
+{
+    // a table may have shrunk since its entries were marked
+    unsigned int emitterEnd = _dirtyEmitterEnd;
+    if (emitterEnd > _emitters.size())
+    {
+        emitterEnd = (unsigned int)_emitters.size();
+    }
+    if (_dirtyEmitterFirst < emitterEnd)
+    {
+        unsigned int sizeBytes = (emitterEnd - _dirtyEmitterFirst) * sizeof(ParticleEmitter);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, _emitterBufferId);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, _dirtyEmitterFirst * sizeof(ParticleEmitter), 
+            sizeBytes, &_emitters[_dirtyEmitterFirst]);
+        _pendingTableUploadBytes += sizeBytes;
+    }
+
+    unsigned int forceFieldEnd = _dirtyForceFieldEnd;
+    if (forceFieldEnd > _forceFields.size())
+    {
+        forceFieldEnd = (unsigned int)_forceFields.size();
+    }
+    if (_dirtyForceFieldFirst < forceFieldEnd)
+    {
+        unsigned int sizeBytes = 
+            (forceFieldEnd - _dirtyForceFieldFirst) * sizeof(ParticleForceField);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, _forceFieldBufferId);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 
+            _dirtyForceFieldFirst * sizeof(ParticleForceField), sizeBytes, 
+            &_forceFields[_dirtyForceFieldFirst]);
+        _pendingTableUploadBytes += sizeBytes;
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    _dirtyEmitterFirst = 0;
+    _dirtyEmitterEnd = 0;
+    _dirtyForceFieldFirst = 0;
+    _dirtyForceFieldEnd = 0;
+    _lastTableUploadBytes = _pendingTableUploadBytes;
+    _pendingTableUploadBytes = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The emit pass is dispatched with enough work items in X for the emitter that can emit the 
+    most particles per frame.
+Parameters: None
+Returns:
+    The largest of the emitters' emission quotas.
+Exception:  Safe
+Creator:    John Cox (8-13-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleManager::GetMaxEmitterQuota() const
+{
+    unsigned int maxQuota = 0;
+    for (size_t emitterIndex = 0; emitterIndex < _emitters.size(); emitterIndex++)
+    {
+        if (_emitters[emitterIndex]._maxParticlesEmittedPerFrame > maxQuota)
+        {
+            maxQuota = _emitters[emitterIndex]._maxParticlesEmittedPerFrame;
+        }
+    }
+    return maxQuota;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Checks if the provided particle has gone outside the circle.
+Parameters:
+    p   A const reference to a Particle object.
+    emitter     The emitter that the particle belongs to.
+Returns:
+    True if the particle's position is outside the circle's boundaries, otherwise false.
+    Exception:  Safe
+Creator:    John Cox (7-2-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleManager::OutOfBounds(const Particle &p, const ParticleEmitter &emitter) const
+{
+    glm::vec2 centerToParticle = p._position - emitter._center;
+    float distSqr = glm::dot(centerToParticle, centerToParticle);
+    if (distSqr > (emitter._radius * emitter._radius))
+    {
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sends the particles out evenly instead of randomly.  Random spawn spots and directions 
+    clump and leave gaps, so a thin spray has to have more particles than it needs just to 
+    hide them.  With this, the emit passes take each particle's spot in the spawn disk, its 
+    speed, and its direction from the R4 sequence (Roberts, 2018), which is the golden ratio's 
+    additive recurrence carried to 4 dimensions.  Any run of consecutive points of it is 
+    spread evenly over all 4 at once, so each update's emissions cover the disk's area and the 
+    circle of directions with no clumps, and the next update's cover them again.
+
+    The GPU's emit passes only do this with a program built with 
+    ParticleKernelVariant::_hasLowDiscrepancyEmission, and that is all that they need.  There, 
+    each emitter's emissions of an update take consecutive points (its dead stack's slots, or 
+    the deterministic window's), shifted by a hash of the update's seed so that the updates 
+    don't all land on the same points.  This turns it on for the CPU backend's emissions (see 
+    EmitParticlesOnCpu()), which take the sequence's points in order.
+
+    Note: Bursts and sub-emitters (see TriggerBurst(...) and SetSubEmitters(...)) still 
+    spawn from the hash, and an emitter with an emission image still takes its spots from the 
+    image (only its speeds and directions are from the sequence).
+Parameters:
+    isEnabled   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::SetLowDiscrepancyEmission(bool isEnabled)
+{
+    _hasLowDiscrepancyEmission = isEnabled;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets the given particle's starting position and velocity.  Does NOT alter the "is active"
+    flag.  That flag is altered during Update(...).
+Parameters:
+    resetThis   Self-explanatory.
+    emitter     The emitter that the particle belongs to.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (7-2-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::ResetParticle(Particle *resetThis, const ParticleEmitter &emitter) const
+{
+    // Note: The hard-coded mod100 is just to prevent the random axis magnitudes from 
+    // getting too crazy different from each other.
+    float newX = (float)(RandomPosAndNeg() % 100);
+    float newY = (float)(RandomPosAndNeg() % 100);
+    glm::vec2 randomVector = glm::normalize(glm::vec2(newX, newY));
+    
+    // hard-coded region of radius 0.1f in window space
+    float radiusVariation = RandomOnRange0to1() * 0.1f; 
+
+    resetThis->_position = emitter._center + (randomVector * radiusVariation);
+    resetThis->_velocity = this->GetNewVelocityVector(emitter);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Generates a new velocity vector between the emitter's minimum and maximum values and in a 
+    random direction.
+Parameters:
+    emitter     Self-explanatory.
+Returns:    
+    A 2D vector whose magnitude is between the initialized "min" and "max" values and whose
+    direction is random.
+Exception:  Safe
+Creator:    John Cox (7-2-2016)
+-----------------------------------------------------------------------------------------------*/
+glm::vec2 ParticleManager::GetNewVelocityVector(const ParticleEmitter &emitter) const
+{
+    // this demo particle "manager" emits in a circle, so get a random 2D direction
+    // Note: The hard-coded mod100 is just to prevent the random axis magnitudes from 
+    // getting too crazy different from each other.
+    float newX = (float)(RandomPosAndNeg() % 100);
+    float newY = (float)(RandomPosAndNeg() % 100);
+    glm::vec2 randomVelocityVector = glm::normalize(glm::vec2(newX, newY));
+    
+    // randomize between the min and max velocities to get a little variation
+    float velocityVariation = RandomOnRange0to1() * (emitter._velocityMax - emitter._velocityMin);
+    float velocityMagnitude = emitter._velocityMin + velocityVariation;
+
+    return randomVelocityVector * velocityMagnitude;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The CPU backend's version of PackParticleFlags(...) in shaderParticle.comp: the "is active"
+    flag in bit 0 and the age as a 16-bit fraction in the high 16 bits.
+Parameters:
+    isActive    Self-explanatory.
+    age         Fraction of the emitter's lifetime.
+Returns:
+    The flags for the structure-of-arrays and half float layouts.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+static int PackCpuParticleFlags(int isActive, float age)
+{
+    float clampedAge = (age < 0.0f) ? 0.0f : ((age > 1.0f) ? 1.0f : age);
+    unsigned int packedAge = (unsigned int)(clampedAge * 65535.0f + 0.5f);
+    return (isActive == 0) ? 0 : (int)((packedAge << 16) | 1);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Replaces the whole pool with the given particles, packed into the current layout, and 
+    rebuilds the dead stacks and the active mask around them.  For the kernel benchmarks (see 
+    Benchmark.cpp), which need inputs of a known shape (ex: every particle dead, or all of 
+    them bunched around the emitter) rather than whatever emission has made so far, and for 
+    the validation (see ParticleValidation.h), which gives the GPU and the CPU backends the 
+    same particles.
+
+    Note: Like LoadSnapshot(...), the particles go through a staging buffer and are copied, so
+    this works with immutable particle buffers.
+    Also Note: The CPU backend keeps its own full precision copy of the particles, and its 
+    dead stacks are rebuilt from that, in the same order as at Init(...).
+Parameters:
+    particles   One for every particle in the pool (see GetMaxParticleCount()).
+Returns:
+    False if the count is wrong or the backend is the split, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleManager::LoadParticles(const std::vector<Particle> &particles)
+{
+    if (_mappedParameters == 0 || particles.size() != _maxParticleCount)
+    {
+        return false;
+    }
+    if (_simulationBackend == PARTICLE_SIMULATION_BACKEND_SPLIT)
+    {
+        LogPrintf("LoadParticles(...) isn't supported by the split particle backend\n");
+        return false;
+    }
+
+    // every particle buffer, one after another, in one staging buffer
+    size_t bufferOffsets[MAX_PARTICLE_BUFFERS] = { 0 };
+    size_t stagingSizeBytes = 0;
+    for (unsigned int bufferIndex = 0; bufferIndex < _particleBufferCount; bufferIndex++)
+    {
+        bufferOffsets[bufferIndex] = stagingSizeBytes;
+        stagingSizeBytes += (size_t)_maxParticleCount * this->GetParticleBufferStride(bufferIndex);
+    }
+    // Note: A member, since the stream client (see ParticleStream.h) loads a whole pool every 
+    // frame, and a fresh allocation of that size would fault in every page every time.
+    if (!_loadStaging.Allocate(stagingSizeBytes))
+    {
+        LogPrintf("couldn't allocate %llu bytes to stage the particles\n", 
+            (unsigned long long)stagingSizeBytes);
+        return false;
+    }
+    unsigned char *staging = _loadStaging.GetData();
+
+    // only one of these is used, depending on the layout, and the packing is the CPU 
+    // backend's (see UpdateCpuParticleChunk(...))
+    Particle *packedParticles = (Particle *)(staging + bufferOffsets[0]);
+    PackedHalfParticle *packedHalfParticles = (PackedHalfParticle *)(staging + bufferOffsets[0]);
+    PackedFixedParticle *packedFixedParticles = 
+        (PackedFixedParticle *)(staging + bufferOffsets[0]);
+    glm::vec2 *positions = (glm::vec2 *)(staging + bufferOffsets[0]);
+    glm::vec2 *velocities = (glm::vec2 *)(staging + bufferOffsets[1]);
+    int *flags = (int *)(staging + bufferOffsets[2]);
+    for (unsigned int particleIndex = 0; particleIndex < _maxParticleCount; particleIndex++)
+    {
+        const Particle &p = particles[particleIndex];
+        if (_layout == PARTICLE_LAYOUT_SOA)
+        {
+            positions[particleIndex] = p._position;
+            velocities[particleIndex] = p._velocity;
+            flags[particleIndex] = PackCpuParticleFlags(p._isActive, p._age);
+        }
+        else if (_layout == PARTICLE_LAYOUT_HALF_FLOAT)
+        {
+            PackedHalfParticle &packed = packedHalfParticles[particleIndex];
+            packed._position = glm::packHalf2x16(p._position);
+            packed._velocity = glm::packHalf2x16(p._velocity);
+            packed._isActive = PackCpuParticleFlags(p._isActive, p._age);
+        }
+        else if (_layout == PARTICLE_LAYOUT_FIXED_POINT)
+        {
+            packedFixedParticles[particleIndex] = PackFixedParticle(p);
+        }
+        else
+        {
+            packedParticles[particleIndex] = p;
+        }
+    }
+
+    // the copies must come after the last update's shader writes
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    GLuint stagingBufferId = 0;
+    glGenBuffers(1, &stagingBufferId);
+    glBindBuffer(GL_COPY_READ_BUFFER, stagingBufferId);
+    LabelGlObject(GL_BUFFER, stagingBufferId, "particle load staging");
+    glBufferStorage(GL_COPY_READ_BUFFER, stagingSizeBytes, staging, 0);
+    for (unsigned int bufferIndex = 0; bufferIndex < _particleBufferCount; bufferIndex++)
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, _particleBufferIds[bufferIndex]);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 
+            (GLintptr)bufferOffsets[bufferIndex], 0, 
+            (GLsizeiptr)_maxParticleCount * this->GetParticleBufferStride(bufferIndex));
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    DeleteGlBuffers(1, &stagingBufferId);
+
+    if (_simulationBackend == PARTICLE_SIMULATION_BACKEND_GPU)
+    {
+        this->RebuildDeadStacks(0, (unsigned int)_emitters.size());
+        this->RebuildActiveMask();
+        return true;
+    }
+
+    for (unsigned int particleIndex = 0; particleIndex < _maxParticleCount; particleIndex++)
+    {
+        const Particle &p = particles[particleIndex];
+        _cpuPositionsX[particleIndex] = p._position.x;
+        _cpuPositionsY[particleIndex] = p._position.y;
+        _cpuVelocitiesX[particleIndex] = p._velocity.x;
+        _cpuVelocitiesY[particleIndex] = p._velocity.y;
+        _cpuAges[particleIndex] = p._age;
+        _cpuIsActive[particleIndex] = p._isActive;
+    }
+    for (size_t emitterIndex = 0; emitterIndex < _emitters.size(); emitterIndex++)
+    {
+        const ParticleEmitter &emitter = _emitters[emitterIndex];
+        std::vector<unsigned int> &deadStack = _cpuDeadStacks[emitterIndex];
+        deadStack.clear();
+        for (unsigned int particleIndex = emitter._firstParticle; 
+            particleIndex < emitter._firstParticle + emitter._particleCount; particleIndex++)
+        {
+            if (_cpuIsActive[particleIndex] == 0)
+            {
+                deadStack.push_back(particleIndex);
+            }
+        }
+    }
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Reads the whole pool back and unpacks it from the current layout, the opposite of 
+    LoadParticles(...).  The particle buffers are what every backend's results end up in, so 
+    this is what the renderer sees, and the GPU and CPU backends can be compared with it (see 
+    ParticleValidation.h).
+
+    Note: This waits on the GPU, like GetParticleChecksum(), so it is for the end of a run.
+    Also Note: The structure-of-arrays and half float layouts keep the age in 16 bits, and the
+    half float layout keeps the position and velocity in 16-bit floats, so they come back at 
+    that precision.
+Parameters:
+    putParticlesHere    Resized to one for every particle in the pool.
+Returns:
+    False if there are no particle buffers, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleManager::ReadParticles(std::vector<Particle> *putParticlesHere) const
+{
+    if (_particleBufferCount == 0)
+    {
+        return false;
+    }
+
+    // the last update's shader writes must land before glGetBufferSubData(...) reads them
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    LargeHostBuffer bufferBytes[MAX_PARTICLE_BUFFERS];
+    for (unsigned int bufferIndex = 0; bufferIndex < _particleBufferCount; bufferIndex++)
+    {
+        size_t bufferSizeBytes = 
+            (size_t)_maxParticleCount * this->GetParticleBufferStride(bufferIndex);
+        if (!bufferBytes[bufferIndex].Allocate(bufferSizeBytes))
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            return false;
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, _particleBufferIds[bufferIndex]);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, bufferSizeBytes, 
+            bufferBytes[bufferIndex].GetData());
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    putParticlesHere->resize(_maxParticleCount);
+    for (unsigned int particleIndex = 0; particleIndex < _maxParticleCount; particleIndex++)
+    {
+        Particle &p = (*putParticlesHere)[particleIndex];
+        if (_layout == PARTICLE_LAYOUT_SOA)
+        {
+            p._position = ((const glm::vec2 *)bufferBytes[0].GetData())[particleIndex];
+            p._velocity = ((const glm::vec2 *)bufferBytes[1].GetData())[particleIndex];
+            int flags = ((const int *)bufferBytes[2].GetData())[particleIndex];
+            p._isActive = flags & 1;
+            p._age = ((unsigned int)flags >> 16) / 65535.0f;
+        }
+        else if (_layout == PARTICLE_LAYOUT_HALF_FLOAT)
+        {
+            const PackedHalfParticle &packed = 
+                ((const PackedHalfParticle *)bufferBytes[0].GetData())[particleIndex];
+            p._position = glm::unpackHalf2x16(packed._position);
+            p._velocity = glm::unpackHalf2x16(packed._velocity);
+            p._isActive = packed._isActive & 1;
+            p._age = ((unsigned int)packed._isActive >> 16) / 65535.0f;
+        }
+        else if (_layout == PARTICLE_LAYOUT_FIXED_POINT)
+        {
+            p = UnpackFixedParticle(
+                ((const PackedFixedParticle *)bufferBytes[0].GetData())[particleIndex]);
+        }
+        else
+        {
+            p = ((const Particle *)bufferBytes[0].GetData())[particleIndex];
+        }
+    }
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Starts the CPU backend's threads, gives it its own copy of the particles and the dead 
+    stacks (all inactive and all full, just like the GPU's at Init(...)), and creates the 
+    upload buffer.
+
+    Each region of the upload buffer holds every particle buffer, the whole live index buffer, 
+    and the draw command buffer, at the same offsets as in the real buffers, so the upload is 
+    a handful of glCopyBufferSubData(...) calls.  The buffer is immutable, write-only, and 
+    persistently and coherently mapped, like the parameter buffer, so the workers write the 
+    particles straight into it.
+
+    Note: Called at the end of Init(...), after the particle buffers and the draw groups exist.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::InitCpuSimulation()
+{
+    this->CleanupCpuSimulation();
+    _cpuThreadPool.Init(_cpuWorkerCount);
+    _cpuSimdLevel = GetBestParticleSimdLevel();
+    _cpuSimdKernel = GetParticleSimdKernel(_cpuSimdLevel);
+    LogPrintf("CPU particle backend: %u threads, %s kernel\n", _cpuThreadPool.GetThreadCount(), 
+        GetParticleSimdLevelName(_cpuSimdLevel));
+
+    _cpuPositionsX.assign(_maxParticleCount, 0.0f);
+    _cpuPositionsY.assign(_maxParticleCount, 0.0f);
+    _cpuVelocitiesX.assign(_maxParticleCount, 0.0f);
+    _cpuVelocitiesY.assign(_maxParticleCount, 0.0f);
+    _cpuAges.assign(_maxParticleCount, 0.0f);
+    _cpuIsActive.assign(_maxParticleCount, 0);
+
+    // the split starts out with half of the emitters on each side, and the balancer moves it 
+    // from there
+    if (_simulationBackend == PARTICLE_SIMULATION_BACKEND_SPLIT)
+    {
+        _cpuFirstEmitter = (unsigned int)_emitters.size() / 2;
+        _cpuFirstParticle = _emitters[_cpuFirstEmitter]._firstParticle;
+        LogPrintf("split particle backend: %u of %u emitters on the GPU\n", _cpuFirstEmitter, 
+            (unsigned int)_emitters.size());
+    }
+    else
+    {
+        _cpuFirstEmitter = 0;
+        _cpuFirstParticle = 0;
+    }
+    _splitUpdatesSinceMove = 0;
+    _splitSampleCount = 0;
+    _splitGpuMsSum = 0.0f;
+    _splitCpuMsSum = 0.0f;
+
+    // Note: Same order as the initial DeadIndices on the GPU, so the emitters pop from the end
+    // of their ranges first either way.  The GPU's emitters in a split have their stacks on 
+    // the GPU.
+    _cpuDeadStacks.resize(_emitters.size());
+    for (size_t emitterIndex = _cpuFirstEmitter; emitterIndex < _emitters.size(); 
+        emitterIndex++)
+    {
+        const ParticleEmitter &emitter = _emitters[emitterIndex];
+        std::vector<unsigned int> &deadStack = _cpuDeadStacks[emitterIndex];
+        deadStack.clear();
+        deadStack.reserve(emitter._particleCount);
+        for (unsigned int particleIndex = 0; particleIndex < emitter._particleCount; 
+            particleIndex++)
+        {
+            deadStack.push_back(emitter._firstParticle + particleIndex);
+        }
+    }
+
+    // enough chunks for the whole pool, which is what the CPU backend and a split with every 
+    // emitter on the CPU need
+    unsigned int chunkCount = 
+        (_maxParticleCount + CPU_PARTICLES_PER_CHUNK - 1) / CPU_PARTICLES_PER_CHUNK;
+    _cpuChunkLiveIndices.resize(chunkCount);
+    _cpuChunkDeadIndices.resize(chunkCount);
+
+    size_t regionSizeBytes = 0;
+    for (unsigned int bufferIndex = 0; bufferIndex < _particleBufferCount; bufferIndex++)
+    {
+        _cpuUploadParticleOffsets[bufferIndex] = regionSizeBytes;
+        regionSizeBytes += (size_t)_maxParticleCount * this->GetParticleBufferStride(bufferIndex);
+    }
+    _cpuUploadLiveIndexOffset = regionSizeBytes;
+    regionSizeBytes += (size_t)_maxParticleCount * sizeof(GLuint);
+    _cpuUploadDrawCommandOffset = regionSizeBytes;
+    regionSizeBytes += sizeof(DrawCommandBufferHeader) + 
+        (_drawGroupCapacity * sizeof(DrawElementsIndirectCommand));
+
+    // every region starts on a cache line, so two threads never write to the same one across 
+    // a region boundary
+    _cpuUploadRegionSizeBytes = ((regionSizeBytes + 63) / 64) * 64;
+
+    GLsizeiptr bufferSize = PARAMETER_FRAMES_IN_FLIGHT * _cpuUploadRegionSizeBytes;
+    GLbitfield storageFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    _cpuUploadBufferId = GenerateGlBuffer();
+    glBindBuffer(GL_COPY_READ_BUFFER, _cpuUploadBufferId);
+    LabelGlObject(GL_BUFFER, _cpuUploadBufferId, "particle CPU upload");
+    glBufferStorage(GL_COPY_READ_BUFFER, bufferSize, 0, storageFlags);
+    RecordBoundGlBufferAllocation(GL_COPY_READ_BUFFER, "particle CPU upload");
+    _mappedCpuUpload = glMapBufferRange(GL_COPY_READ_BUFFER, 0, bufferSize, storageFlags);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    if (_mappedCpuUpload == 0)
+    {
+        LogPrintf("failed to map the CPU particle upload buffer\n");
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Stops the CPU backend's threads and lets go of its particles and its upload buffer.  Safe 
+    to call whether or not the CPU backend was ever started.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::CleanupCpuSimulation()
+{
+    _cpuThreadPool.Cleanup();
+
+    // deleting the buffer also releases the persistent mapping
+    _cpuUploadBufferId.Reset();
+    _mappedCpuUpload = 0;
+
+    // swapped with empty vectors so that the memory is actually given back
+    std::vector<float>().swap(_cpuPositionsX);
+    std::vector<float>().swap(_cpuPositionsY);
+    std::vector<float>().swap(_cpuVelocitiesX);
+    std::vector<float>().swap(_cpuVelocitiesY);
+    std::vector<float>().swap(_cpuAges);
+    std::vector<int>().swap(_cpuIsActive);
+    _cpuDeadStacks.clear();
+    _cpuChunkLiveIndices.clear();
+    _cpuChunkDeadIndices.clear();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    UpdateSteps(...) for the CPU backend (see SetSimulationBackend(...)).  Emits once, runs 
+    every step on every particle across the thread pool, and uploads the results.
+
+    A particle doesn't depend on any other particle, and the emission is done before any of 
+    the steps, so each particle runs all of its steps back to back in one pass (like the 
+    substeps of a dispatch), and the threads only meet once per call.  Each thread writes its 
+    particles into the upload region as it finishes them, while they are still in the cache.
+
+    The uploads are ordinary GL commands, so the draws that come after them see their results 
+    without a memory barrier.
+Parameters:
+    stepSec     The simulation time of each step.
+    numSteps    Self-explanatory.  Not clamped, because nothing here is per step.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::UpdateStepsOnCpu(float stepSec, unsigned int numSteps)
+{
+    if (_mappedCpuUpload == 0)
+    {
+        return;
+    }
+
+    // the region goes with the parameter frame, so the frame's fence says when the GPU has 
+    // finished copying out of it
+    unsigned int frameSlot = this->AcquireParameterFrameSlot();
+    size_t regionOffset = frameSlot * _cpuUploadRegionSizeBytes;
+    unsigned char *uploadRegion = (unsigned char *)_mappedCpuUpload + regionOffset;
+
+    unsigned int emittedCount = this->UpdateCpuParticles(stepSec, numSteps, uploadRegion);
+    unsigned int chunkCount = this->GetCpuChunkCount();
+
+    // each draw group's live particles go into its own range of the live index buffer, which 
+    // starts at its first particle, just like the compute shader's appends
+    // Note: The commands are counted up in a copy here instead of in the mapped region, which
+    // is write-combined memory and very slow to read back.  The copy comes from the frame's 
+    // arena (see FrameArena.h), or from the heap when there is no frame (ex: a benchmark).
+    size_t commandBytes = _drawCommandResetData.size() * sizeof(GLuint);
+    std::vector<GLuint> unframedCommandWords;
+    GLuint *commandWords = GetFrameArena().AllocateArray<GLuint>(_drawCommandResetData.size());
+    if (commandWords == 0)
+    {
+        unframedCommandWords.resize(_drawCommandResetData.size());
+        commandWords = unframedCommandWords.data();
+    }
+    memcpy(commandWords, _drawCommandResetData.data(), commandBytes);
+    DrawElementsIndirectCommand *commands = (DrawElementsIndirectCommand *)commandWords;
+    unsigned int groupCount = (unsigned int)_drawGroupLiveCounts.size();
+    GLuint *liveIndices = (GLuint *)(uploadRegion + _cpuUploadLiveIndexOffset);
+    unsigned int groupIndex = 0;
+    for (unsigned int chunkIndex = 0; chunkIndex < chunkCount; chunkIndex++)
+    {
+        const std::vector<unsigned int> &chunkLiveIndices = _cpuChunkLiveIndices[chunkIndex];
+        for (size_t liveIndex = 0; liveIndex < chunkLiveIndices.size(); liveIndex++)
+        {
+            unsigned int particleIndex = chunkLiveIndices[liveIndex];
+            while (groupIndex + 1 < groupCount && 
+                particleIndex >= commands[groupIndex + 1]._firstIndex)
+            {
+                groupIndex++;
+            }
+            DrawElementsIndirectCommand &command = commands[groupIndex];
+            liveIndices[command._firstIndex + command._count] = particleIndex;
+            command._count++;
+        }
+    }
+
+    DrawCommandBufferHeader drawCommandHeader = { emittedCount, groupCount };
+    memcpy(uploadRegion + _cpuUploadDrawCommandOffset, &drawCommandHeader, 
+        sizeof(drawCommandHeader));
+    memcpy(uploadRegion + _cpuUploadDrawCommandOffset + sizeof(drawCommandHeader), 
+        commandWords, commandBytes);
+
+    // the mapping is coherent, so the writes are visible to the copies
+    glBindBuffer(GL_COPY_READ_BUFFER, _cpuUploadBufferId);
+    for (unsigned int bufferIndex = 0; bufferIndex < _particleBufferCount; bufferIndex++)
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, _particleBufferIds[bufferIndex]);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 
+            regionOffset + _cpuUploadParticleOffsets[bufferIndex], 0, 
+            (GLsizeiptr)_maxParticleCount * this->GetParticleBufferStride(bufferIndex));
+    }
+
+    // only the live part of each group's range
+    glBindBuffer(GL_COPY_WRITE_BUFFER, _liveIndexBufferId);
+    for (groupIndex = 0; groupIndex < groupCount; groupIndex++)
+    {
+        const DrawElementsIndirectCommand &command = commands[groupIndex];
+        if (command._count > 0)
+        {
+            GLintptr firstByte = command._firstIndex * sizeof(GLuint);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 
+                regionOffset + _cpuUploadLiveIndexOffset + firstByte, firstByte, 
+                command._count * sizeof(GLuint));
+        }
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, _drawCommandBufferId);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 
+        regionOffset + _cpuUploadDrawCommandOffset, 0, 
+        sizeof(drawCommandHeader) + commandBytes);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    // marks when the GPU is done with this frame's region
+    _parameterFenceRing.FenceSlot(frameSlot);
+    _parameterFrameIndex++;
+
+    this->CopyCountsForReadback();
+    this->CopyParticlesForReadback();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The part of the update that the CPU and split backends share: emits once, runs every step 
+    on every one of the CPU's particles across the thread pool, writes them into the upload 
+    region, and puts the ones that died back on their dead stacks.  Each chunk's live 
+    particles are left in its list for the caller.
+Parameters:
+    stepSec         See UpdateStepsOnCpu(...).
+    numSteps        Same.
+    uploadRegion    This frame's region of the mapped upload buffer.
+Returns:
+    The number of particles that were emitted.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleManager::UpdateCpuParticles(float stepSec, unsigned int numSteps, 
+    unsigned char *uploadRegion)
+{
+    unsigned int emittedCount = this->EmitParticlesOnCpu(stepSec * numSteps);
+    unsigned int chunkCount = this->GetCpuChunkCount();
+    _cpuThreadPool.ParallelFor(chunkCount, [&](unsigned int chunkIndex)
+    {
+        this->UpdateCpuParticleChunk(chunkIndex, stepSec, numSteps, uploadRegion);
+    });
+
+    // the particles that died go back on their emitters' dead stacks for the next call
+    // Note: This is serial, but it is only the particles that died, and the chunks and their 
+    // lists are in pool order, so it walks forward through the emitters just once.
+    unsigned int emitterIndex = _cpuFirstEmitter;
+    unsigned int emitterCount = (unsigned int)_emitters.size();
+    for (unsigned int chunkIndex = 0; chunkIndex < chunkCount; chunkIndex++)
+    {
+        const std::vector<unsigned int> &deadIndices = _cpuChunkDeadIndices[chunkIndex];
+        for (size_t deadIndex = 0; deadIndex < deadIndices.size(); deadIndex++)
+        {
+            unsigned int particleIndex = deadIndices[deadIndex];
+            while (emitterIndex + 1 < emitterCount && 
+                particleIndex >= _emitters[emitterIndex + 1]._firstParticle)
+            {
+                emitterIndex++;
+            }
+            _cpuDeadStacks[emitterIndex].push_back(particleIndex);
+        }
+    }
+    return emittedCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The CPU backend's version of LowDiscrepancySample(...) and the low-discrepancy half of 
+    SpawnParticle(...) in shaderParticle.comp (see SetLowDiscrepancyEmission(...)).
+Parameters:
+    resetThis       Self-explanatory.
+    emitter         The emitter that the particle belongs to.
+    sequenceIndex   Which point of the sequence to take.
+    shift           Added to every coordinate, in 32-bit fixed point.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static void ResetParticleLowDiscrepancy(Particle *resetThis, const ParticleEmitter &emitter, 
+    unsigned int sequenceIndex, unsigned int shift)
+{
+    static const float TWO_PI = 6.28318530718f;
+
+    // must match R4_STEPS in shaderParticle.comp
+    static const unsigned int R4_STEPS[4] = { 3679390609u, 3152041523u, 2700274806u, 2313257605u };
+    float sample[4];
+    for (int dimension = 0; dimension < 4; dimension++)
+    {
+        unsigned int fixedPoint = (R4_STEPS[dimension] * sequenceIndex) + shift;
+        sample[dimension] = (float)(fixedPoint >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // the square root of the radius makes the spots even over the disk's area, which the 
+    // random spawn's plain fraction of the radius isn't
+    float spawnOffset = sqrtf(sample[0]) * 0.1f;
+    float spawnAngle = sample[1] * TWO_PI;
+    resetThis->_position = emitter._center + 
+        (glm::vec2(cosf(spawnAngle), sinf(spawnAngle)) * spawnOffset);
+    float speed = emitter._velocityMin + 
+        (sample[2] * (emitter._velocityMax - emitter._velocityMin));
+    float directionAngle = sample[3] * TWO_PI;
+    resetThis->_velocity = glm::vec2(cosf(directionAngle), sinf(directionAngle)) * speed;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The CPU backend's emit pass.  Each emitter sends out up to its quota of particles from the
+    top of its dead stack, with a new position and velocity from ResetParticle(...).  With 
+    emission rates, each one comes out at a random moment of the update, like the GPU's (see 
+    SetEmissionRates(...)).
+
+    Note: On the calling thread because the random numbers (see RandomToast.h) are a single 
+    shared generator.  That is at most a few hundred particles per emitter per call.
+Parameters:
+    emitSpanSec     The simulation time that the update covers.
+Returns:
+    The number of particles that were emitted.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleManager::EmitParticlesOnCpu(float emitSpanSec)
+{
+    bool isSubFrameEmission = !_emissionRates.empty();
+    unsigned int emittedCount = 0;
+    for (size_t emitterIndex = _cpuFirstEmitter; emitterIndex < _emitters.size(); 
+        emitterIndex++)
+    {
+        const ParticleEmitter &emitter = _emitters[emitterIndex];
+        std::vector<unsigned int> &deadStack = _cpuDeadStacks[emitterIndex];
+        unsigned int emitCount = emitter._maxParticlesEmittedPerFrame;
+        if (emitCount > deadStack.size())
+        {
+            emitCount = (unsigned int)deadStack.size();
+        }
+
+        for (unsigned int emitIndex = 0; emitIndex < emitCount; emitIndex++)
+        {
+            unsigned int particleIndex = deadStack.back();
+            deadStack.pop_back();
+
+            Particle p;
+            if (_hasLowDiscrepancyEmission)
+            {
+                ResetParticleLowDiscrepancy(&p, emitter, _cpuEmissionSequenceIndex++, 0);
+            }
+            else
+            {
+                this->ResetParticle(&p, emitter);
+            }
+            float ageSec = 0.0f;
+            if (isSubFrameEmission)
+            {
+                ageSec = RandomOnRange0to1() * emitSpanSec;
+                p._position += p._velocity * ageSec;
+            }
+            _cpuPositionsX[particleIndex] = p._position.x;
+            _cpuPositionsY[particleIndex] = p._position.y;
+            _cpuVelocitiesX[particleIndex] = p._velocity.x;
+            _cpuVelocitiesY[particleIndex] = p._velocity.y;
+            _cpuAges[particleIndex] = ageSec;
+            _cpuIsActive[particleIndex] = 1;
+        }
+        emittedCount += emitCount;
+    }
+    return emittedCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    One task of the CPU backend's update: runs every step on one chunk of the pool, lists the 
+    chunk's live and newly dead particles, and writes the chunk into the upload region in the 
+    manager's layout.  Every particle of the chunk is written, live or not, because the region 
+    was last written a few frames ago.
+
+    The update is the same as IntegrateParticle(...) in shaderParticle.comp with the default 
+    semi-implicit Euler integrator: the velocity first, then the position, then the emitter's 
+    circle, then the age.  The chunk is cut at the emitters' boundaries so that each run has 
+    one circle and one lifetime for the SIMD kernel (see ParticleSimdKernels.h).
+
+    Note: Runs on the thread pool, so it only reads what every chunk shares and only writes to
+    its own chunk.
+Parameters:
+    chunkIndex      Self-explanatory.
+    stepSec         See UpdateStepsOnCpu(...).
+    numSteps        Same.
+    uploadRegion    This frame's region of the mapped upload buffer.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::UpdateCpuParticleChunk(unsigned int chunkIndex, float stepSec, 
+    unsigned int numSteps, unsigned char *uploadRegion)
+{
+    unsigned int firstParticle = _cpuFirstParticle + (chunkIndex * CPU_PARTICLES_PER_CHUNK);
+    unsigned int endParticle = firstParticle + CPU_PARTICLES_PER_CHUNK;
+    if (endParticle > _maxParticleCount)
+    {
+        endParticle = _maxParticleCount;
+    }
+    std::vector<unsigned int> &liveIndices = _cpuChunkLiveIndices[chunkIndex];
+    std::vector<unsigned int> &deadIndices = _cpuChunkDeadIndices[chunkIndex];
+    liveIndices.clear();
+    deadIndices.clear();
+
+    // only one of these is used, depending on the layout
+    Particle *particles = (Particle *)(uploadRegion + _cpuUploadParticleOffsets[0]);
+    PackedHalfParticle *packedParticles = 
+        (PackedHalfParticle *)(uploadRegion + _cpuUploadParticleOffsets[0]);
+    PackedFixedParticle *packedFixedParticles = 
+        (PackedFixedParticle *)(uploadRegion + _cpuUploadParticleOffsets[0]);
+    glm::vec2 *positions = (glm::vec2 *)(uploadRegion + _cpuUploadParticleOffsets[0]);
+    glm::vec2 *velocities = (glm::vec2 *)(uploadRegion + _cpuUploadParticleOffsets[1]);
+    int *flags = (int *)(uploadRegion + _cpuUploadParticleOffsets[2]);
+
+    // the emitters are sorted by their first particle (see SetEmitterTable(...)), so the 
+    // chunk is cut into one run per emitter, walking forward
+    ParticleSimdArrays arrays;
+    arrays._positionsX = _cpuPositionsX.data();
+    arrays._positionsY = _cpuPositionsY.data();
+    arrays._velocitiesX = _cpuVelocitiesX.data();
+    arrays._velocitiesY = _cpuVelocitiesY.data();
+    arrays._ages = _cpuAges.data();
+    arrays._isActive = _cpuIsActive.data();
+    unsigned int deadMask[CPU_PARTICLES_PER_CHUNK / 32];
+    unsigned int emitterIndex = _cpuFirstEmitter;
+    unsigned int emitterCount = (unsigned int)_emitters.size();
+    unsigned int runFirstParticle = firstParticle;
+    while (runFirstParticle < endParticle)
+    {
+        while (emitterIndex + 1 < emitterCount && 
+            runFirstParticle >= _emitters[emitterIndex + 1]._firstParticle)
+        {
+            emitterIndex++;
+        }
+        unsigned int runEndParticle = endParticle;
+        if (emitterIndex + 1 < emitterCount && 
+            _emitters[emitterIndex + 1]._firstParticle < runEndParticle)
+        {
+            runEndParticle = _emitters[emitterIndex + 1]._firstParticle;
+        }
+
+        const ParticleEmitter &emitter = _emitters[emitterIndex];
+        ParticleSimdStep step;
+        step._centerX = emitter._center.x;
+        step._centerY = emitter._center.y;
+        step._radiusSqr = emitter._radius * emitter._radius;
+        step._stepSec = stepSec;
+        step._agePerStep = (emitter._lifetimeSec > 0.0f) ? (stepSec / emitter._lifetimeSec) : 
+            0.0f;
+        step._stepCount = numSteps;
+
+        // the forces change the velocities, which the kernels don't
+        unsigned int runCount = runEndParticle - runFirstParticle;
+        if (_forceFields.empty())
+        {
+            _cpuSimdKernel(arrays, runFirstParticle, runCount, step, deadMask);
+        }
+        else
+        {
+            this->StepCpuParticlesWithForces(arrays, runFirstParticle, runCount, step, 
+                deadMask);
+        }
+
+        for (unsigned int particleIndex = runFirstParticle; particleIndex < runEndParticle; 
+            particleIndex++)
+        {
+            unsigned int offset = particleIndex - runFirstParticle;
+            if ((deadMask[offset / 32] & (1u << (offset % 32))) != 0)
+            {
+                deadIndices.push_back(particleIndex);
+            }
+            else if (_cpuIsActive[particleIndex] != 0)
+            {
+                liveIndices.push_back(particleIndex);
+            }
+
+            glm::vec2 position(_cpuPositionsX[particleIndex], _cpuPositionsY[particleIndex]);
+            glm::vec2 velocity(_cpuVelocitiesX[particleIndex], _cpuVelocitiesY[particleIndex]);
+            float age = _cpuAges[particleIndex];
+            int isActive = _cpuIsActive[particleIndex];
+            if (_layout == PARTICLE_LAYOUT_SOA)
+            {
+                positions[particleIndex] = position;
+                velocities[particleIndex] = velocity;
+                flags[particleIndex] = PackCpuParticleFlags(isActive, age);
+            }
+            else if (_layout == PARTICLE_LAYOUT_HALF_FLOAT)
+            {
+                PackedHalfParticle &packed = packedParticles[particleIndex];
+                packed._position = glm::packHalf2x16(position);
+                packed._velocity = glm::packHalf2x16(velocity);
+                packed._isActive = PackCpuParticleFlags(isActive, age);
+            }
+            else if (_layout == PARTICLE_LAYOUT_FIXED_POINT)
+            {
+                Particle p;
+                p._position = position;
+                p._velocity = velocity;
+                p._isActive = isActive;
+                p._age = age;
+                packedFixedParticles[particleIndex] = PackFixedParticle(p);
+            }
+            else
+            {
+                Particle &p = particles[particleIndex];
+                p._position = position;
+                p._velocity = velocity;
+                p._isActive = isActive;
+                p._age = age;
+            }
+        }
+        runFirstParticle = runEndParticle;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The CPU backend's update for when there are force fields, which the SIMD kernels don't do 
+    (see ParticleSimdKernels.h).  Same as the kernels otherwise, and it also writes the new 
+    velocities.  Takes the same arguments as a kernel so that UpdateCpuParticleChunk(...) can 
+    use either one.
+
+    Note: The bounds test is written so that a NaN is out of bounds.  ResetParticle(...)
+    normalizes a random vector that can come out as (0,0), and a particle with a NaN position 
+    would otherwise never die.
+Parameters: See ParticleSimdKernel.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::StepCpuParticlesWithForces(const ParticleSimdArrays &arrays, 
+    unsigned int firstParticle, unsigned int particleCount, const ParticleSimdStep &step, 
+    unsigned int *deadMask) const
+{
+    unsigned int wordCount = (particleCount + 31) / 32;
+    for (unsigned int wordIndex = 0; wordIndex < wordCount; wordIndex++)
+    {
+        deadMask[wordIndex] = 0;
+    }
+
+    glm::vec2 center(step._centerX, step._centerY);
+    for (unsigned int offset = 0; offset < particleCount; offset++)
+    {
+        unsigned int particleIndex = firstParticle + offset;
+        if (arrays._isActive[particleIndex] == 0)
+        {
+            continue;
+        }
+
+        glm::vec2 position(arrays._positionsX[particleIndex], arrays._positionsY[particleIndex]);
+        glm::vec2 velocity(arrays._velocitiesX[particleIndex], 
+            arrays._velocitiesY[particleIndex]);
+        float age = arrays._ages[particleIndex];
+        bool isAlive = true;
+        for (unsigned int stepIndex = 0; isAlive && stepIndex < step._stepCount; stepIndex++)
+        {
+            velocity += this->GetCpuForceFieldAcceleration(position, velocity) * step._stepSec;
+            position += velocity * step._stepSec;
+
+            glm::vec2 centerToParticle = position - center;
+            float distSqr = glm::dot(centerToParticle, centerToParticle);
+            age += step._agePerStep;
+            isAlive = (distSqr <= step._radiusSqr) && (age < 1.0f);
+        }
+
+        arrays._positionsX[particleIndex] = position.x;
+        arrays._positionsY[particleIndex] = position.y;
+        arrays._velocitiesX[particleIndex] = velocity.x;
+        arrays._velocitiesY[particleIndex] = velocity.y;
+        if (isAlive)
+        {
+            arrays._ages[particleIndex] = age;
+        }
+        else
+        {
+            arrays._ages[particleIndex] = 0.0f;
+            arrays._isActive[particleIndex] = 0;
+            deadMask[offset / 32] |= (1u << (offset % 32));
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The CPU backend's version of GetTotalForceFieldAcceleration(...) in shaderParticle.comp.  
+    The math must stay the same as the shader's so that the two backends move the particles 
+    the same way.
+Parameters:
+    position    The particle's.
+    velocity    The particle's, for the drags.
+Returns:
+    The sum of every force field's acceleration on the particle.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+glm::vec2 ParticleManager::GetCpuForceFieldAcceleration(const glm::vec2 &position, 
+    const glm::vec2 &velocity) const
+{
+    glm::vec2 acceleration(0.0f, 0.0f);
+    for (size_t fieldIndex = 0; fieldIndex < _forceFields.size(); fieldIndex++)
+    {
+        const ParticleForceField &field = _forceFields[fieldIndex];
+        if (field._type == PARTICLE_FORCE_FIELD_ATTRACTOR || 
+            field._type == PARTICLE_FORCE_FIELD_VORTEX)
+        {
+            glm::vec2 toCenter = field._center - position;
+            float softenedDistSqr = glm::dot(toCenter, toCenter) + 
+                (field._softeningRadius * field._softeningRadius);
+            float inverseDist = 1.0f / sqrtf(softenedDistSqr);
+            if (field._type == PARTICLE_FORCE_FIELD_ATTRACTOR)
+            {
+                acceleration += toCenter * (field._strength * inverseDist * inverseDist * 
+                    inverseDist);
+            }
+            else
+            {
+                glm::vec2 tangent(-toCenter.y, toCenter.x);
+                acceleration += tangent * (field._strength * inverseDist * inverseDist);
+            }
+        }
+        else if (field._type == PARTICLE_FORCE_FIELD_WIND)
+        {
+            acceleration += field._direction * field._strength;
+        }
+        else if (field._type == PARTICLE_FORCE_FIELD_LINEAR_DRAG)
+        {
+            acceleration += velocity * -field._strength;
+        }
+        else if (field._type == PARTICLE_FORCE_FIELD_QUADRATIC_DRAG)
+        {
+            acceleration += velocity * (-field._strength * glm::length(velocity));
+        }
+    }
+    return acceleration;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How many chunks the CPU's particles make up, which is every particle from the first 
+    particle of the CPU's first emitter on (see UpdateCpuParticleChunk(...)).
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleManager::GetCpuChunkCount() const
+{
+    unsigned int cpuParticleCount = _maxParticleCount - _cpuFirstParticle;
+    return (cpuParticleCount + CPU_PARTICLES_PER_CHUNK - 1) / CPU_PARTICLES_PER_CHUNK;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The CPU's half of a split update (see SetSimulationBackend(...)).  Runs the CPU's emitters
+    just like the CPU backend does, then copies only the CPU's part of each particle buffer 
+    out of the frame's upload region.  The live indices and the draw commands are left for 
+    the append pass, which comes after this on the GPU (see UpdateSteps(...)).
+
+    The time from the start of the emission to the end of the copies is what the balancer 
+    compares with the GPU's (see BalanceSplitSimulation()).
+Parameters:
+    stepSec     See UpdateSteps(...).
+    numSteps    Same.
+    frameSlot   The update's slot of the parameter ring, which is also its upload region.
+Returns:
+    The number of particles that the CPU's emitters emitted.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleManager::UpdateSplitCpuParticles(float stepSec, unsigned int numSteps, 
+    unsigned int frameSlot)
+{
+    if (_mappedCpuUpload == 0 || _cpuFirstParticle >= _maxParticleCount)
+    {
+        _splitLastCpuMs = 0.0f;
+        return 0;
+    }
+
+    std::chrono::high_resolution_clock::time_point start = 
+        std::chrono::high_resolution_clock::now();
+    size_t regionOffset = frameSlot * _cpuUploadRegionSizeBytes;
+    unsigned char *uploadRegion = (unsigned char *)_mappedCpuUpload + regionOffset;
+    unsigned int emittedCount = this->UpdateCpuParticles(stepSec, numSteps, uploadRegion);
+
+    // the mapping is coherent, so the writes are visible to the copies
+    // Note: The GPU's dispatches for this update don't touch the CPU's particles, so the 
+    // copies don't have to wait for them.
+    glBindBuffer(GL_COPY_READ_BUFFER, _cpuUploadBufferId);
+    for (unsigned int bufferIndex = 0; bufferIndex < _particleBufferCount; bufferIndex++)
+    {
+        size_t stride = this->GetParticleBufferStride(bufferIndex);
+        size_t firstByte = _cpuFirstParticle * stride;
+        glBindBuffer(GL_COPY_WRITE_BUFFER, _particleBufferIds[bufferIndex]);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 
+            regionOffset + _cpuUploadParticleOffsets[bufferIndex] + firstByte, firstByte, 
+            (GLsizeiptr)(_maxParticleCount - _cpuFirstParticle) * stride);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    _splitLastCpuMs = std::chrono::duration<float, std::milli>(
+        std::chrono::high_resolution_clock::now() - start).count();
+    return emittedCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The split's load balancer.  Collects the GPU's time for its part of each update from the 
+    profiler (see SetSplitProfiler(...)) and the CPU's from UpdateSplitCpuParticles(...), and 
+    after enough updates, moves the emitter next to the split over to the faster side if that 
+    is predicted to make the slower side faster.
+
+    The prediction assumes that each side's time is proportional to its particles, which is 
+    close enough because each side runs every one of its particles, live or not.  A side with 
+    no particles at all is assumed to cost the same per particle as the other one.
+
+    Note: Does nothing without a profiler, so the split stays where Init(...) put it.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::BalanceSplitSimulation()
+{
+    if (_splitProfiler == 0)
+    {
+        return;
+    }
+
+    // the profiler's times are a few frames old, so the ones right after a move are still 
+    // for the old split
+    _splitUpdatesSinceMove++;
+    if (_splitUpdatesSinceMove <= SPLIT_BALANCE_SETTLE_UPDATES)
+    {
+        return;
+    }
+    GpuProfilerStats gpuStats = {};
+    if (!_splitProfiler->GetStats(_splitGpuScopeId, &gpuStats) || gpuStats._sampleCount == 0)
+    {
+        return;
+    }
+    _splitGpuMsSum += gpuStats._lastMs;
+    _splitCpuMsSum += _splitLastCpuMs;
+    _splitSampleCount++;
+    if (_splitSampleCount < SPLIT_BALANCE_SAMPLE_UPDATES)
+    {
+        return;
+    }
+
+    float gpuMs = _splitGpuMsSum / _splitSampleCount;
+    float cpuMs = _splitCpuMsSum / _splitSampleCount;
+    _splitGpuMsSum = 0.0f;
+    _splitCpuMsSum = 0.0f;
+    _splitSampleCount = 0;
+
+    unsigned int gpuParticleCount = _cpuFirstParticle;
+    unsigned int cpuParticleCount = _maxParticleCount - _cpuFirstParticle;
+    float gpuMsPerParticle = (gpuParticleCount > 0) ? (gpuMs / gpuParticleCount) : 0.0f;
+    float cpuMsPerParticle = (cpuParticleCount > 0) ? (cpuMs / cpuParticleCount) : 0.0f;
+    if (gpuParticleCount == 0)
+    {
+        gpuMsPerParticle = cpuMsPerParticle;
+    }
+    if (cpuParticleCount == 0)
+    {
+        cpuMsPerParticle = gpuMsPerParticle;
+    }
+
+    // a move must beat the current split by a margin, or the noise in the times would move 
+    // the split back and forth between two emitters forever
+    const float minimumGain = 0.05f;
+    float slowestMs = (gpuMs > cpuMs) ? gpuMs : cpuMs;
+    unsigned int emitterCount = (unsigned int)_emitters.size();
+    bool isMovingToCpu = false;
+    bool isMovingToGpu = false;
+    if (gpuMs > cpuMs && _cpuFirstEmitter > 0)
+    {
+        float movedCount = (float)_emitters[_cpuFirstEmitter - 1]._particleCount;
+        float newGpuMs = gpuMs - (movedCount * gpuMsPerParticle);
+        float newCpuMs = cpuMs + (movedCount * cpuMsPerParticle);
+        float newSlowestMs = (newGpuMs > newCpuMs) ? newGpuMs : newCpuMs;
+        isMovingToCpu = newSlowestMs < slowestMs * (1.0f - minimumGain);
+    }
+    else if (cpuMs > gpuMs && _cpuFirstEmitter < emitterCount)
+    {
+        float movedCount = (float)_emitters[_cpuFirstEmitter]._particleCount;
+        float newGpuMs = gpuMs + (movedCount * gpuMsPerParticle);
+        float newCpuMs = cpuMs - (movedCount * cpuMsPerParticle);
+        float newSlowestMs = (newGpuMs > newCpuMs) ? newGpuMs : newCpuMs;
+        isMovingToGpu = newSlowestMs < slowestMs * (1.0f - minimumGain);
+    }
+
+    if (isMovingToCpu)
+    {
+        this->MoveSplitEmitterToCpu();
+    }
+    else if (isMovingToGpu)
+    {
+        this->MoveSplitEmitterToGpu();
+    }
+    if (isMovingToCpu || isMovingToGpu)
+    {
+        _splitUpdatesSinceMove = 0;
+        LogPrintf("particle split: GPU %.2fms, CPU %.2fms; now %u of %u emitters on the GPU\n", 
+            gpuMs, cpuMs, _cpuFirstEmitter, emitterCount);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Hands the GPU's last emitter over to the CPU.  The CPU needs the emitter's particles as 
+    the GPU last left them, so they are read back, which waits for the GPU to finish with 
+    them.  That is one stall per move, and the balancer only moves every so often.  The 
+    emitter's dead stack is rebuilt on the CPU from the particles' flags, and the GPU's copy 
+    of it is left alone, since nothing reads it until the emitter comes back.
+
+    Note: The structure-of-arrays and half float layouts keep the age in 16 bits (see 
+    PackCpuParticleFlags(...)), and the half float layout keeps the position and velocity in
+    16-bit floats, so the CPU gets them back at that precision.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::MoveSplitEmitterToCpu()
+{
+    unsigned int emitterIndex = _cpuFirstEmitter - 1;
+    const ParticleEmitter &emitter = _emitters[emitterIndex];
+    unsigned int firstParticle = emitter._firstParticle;
+    unsigned int particleCount = emitter._particleCount;
+
+    // the last update's writes were shader writes
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    std::vector<unsigned char> bufferBytes[MAX_PARTICLE_BUFFERS];
+    for (unsigned int bufferIndex = 0; bufferIndex < _particleBufferCount; bufferIndex++)
+    {
+        size_t stride = this->GetParticleBufferStride(bufferIndex);
+        bufferBytes[bufferIndex].resize(particleCount * stride);
+        glBindBuffer(GL_COPY_READ_BUFFER, _particleBufferIds[bufferIndex]);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, firstParticle * stride, 
+            particleCount * stride, bufferBytes[bufferIndex].data());
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    std::vector<unsigned int> &deadStack = _cpuDeadStacks[emitterIndex];
+    deadStack.clear();
+    for (unsigned int offset = 0; offset < particleCount; offset++)
+    {
+        glm::vec2 position;
+        glm::vec2 velocity;
+        int isActive = 0;
+        float age = 0.0f;
+        if (_layout == PARTICLE_LAYOUT_SOA)
+        {
+            position = ((const glm::vec2 *)bufferBytes[0].data())[offset];
+            velocity = ((const glm::vec2 *)bufferBytes[1].data())[offset];
+            int flags = ((const int *)bufferBytes[2].data())[offset];
+            isActive = flags & 1;
+            age = ((unsigned int)flags >> 16) / 65535.0f;
+        }
+        else if (_layout == PARTICLE_LAYOUT_HALF_FLOAT)
+        {
+            const PackedHalfParticle &packed = 
+                ((const PackedHalfParticle *)bufferBytes[0].data())[offset];
+            position = glm::unpackHalf2x16(packed._position);
+            velocity = glm::unpackHalf2x16(packed._velocity);
+            isActive = packed._isActive & 1;
+            age = ((unsigned int)packed._isActive >> 16) / 65535.0f;
+        }
+        else if (_layout == PARTICLE_LAYOUT_FIXED_POINT)
+        {
+            Particle p = UnpackFixedParticle(
+                ((const PackedFixedParticle *)bufferBytes[0].data())[offset]);
+            position = p._position;
+            velocity = p._velocity;
+            isActive = p._isActive;
+            age = p._age;
+        }
+        else
+        {
+            const Particle &p = ((const Particle *)bufferBytes[0].data())[offset];
+            position = p._position;
+            velocity = p._velocity;
+            isActive = p._isActive;
+            age = p._age;
+        }
+
+        unsigned int particleIndex = firstParticle + offset;
+        _cpuPositionsX[particleIndex] = position.x;
+        _cpuPositionsY[particleIndex] = position.y;
+        _cpuVelocitiesX[particleIndex] = velocity.x;
+        _cpuVelocitiesY[particleIndex] = velocity.y;
+        _cpuAges[particleIndex] = age;
+        _cpuIsActive[particleIndex] = isActive;
+        if (isActive == 0)
+        {
+            deadStack.push_back(particleIndex);
+        }
+    }
+
+    _cpuFirstEmitter = emitterIndex;
+    _cpuFirstParticle = firstParticle;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Hands the CPU's first emitter over to the GPU.  Every update already copies the CPU's 
+    particles into the particle buffers, so the GPU has them, and only the emitter's dead 
+    stack has to be rebuilt on the GPU (see RebuildDeadStacks(...)).  Nothing waits.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleManager::MoveSplitEmitterToGpu()
+{
+    unsigned int emitterIndex = _cpuFirstEmitter;
+    _cpuDeadStacks[emitterIndex].clear();
+    _cpuFirstEmitter = emitterIndex + 1;
+    _cpuFirstParticle = (_cpuFirstEmitter < _emitters.size()) ? 
+        _emitters[_cpuFirstEmitter]._firstParticle : _maxParticleCount;
+    this->RebuildDeadStacks(emitterIndex, 1);
 }
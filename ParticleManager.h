@@ -1,9 +1,393 @@
 #pragma once
 
 #include "Particle.h"
+#include "ParticleEmitter.h"
+#include "ParticleForceField.h"
+#include "WorkStealingThreadPool.h"
+#include "ParticleSimdKernels.h"
+#include "GpuProfiler.h"
+#include "GlObjects.h"
+#include "GlFenceSync.h"
+#include "ViewParameters.h"
+#include "ParticleComputeInterop.h"
+#include "LatestValueSlot.h"
+#include "LargeHostBuffer.h"
+#include "ParticleInjectionRing.h"
 #include "glm/vec2.hpp"
+#include "glm/vec3.hpp"
+#include "glm/mat4x4.hpp"
 
 #include <vector>
+#include <string>
+#include <functional>
+
+// how the particle buffers are allocated (see ParticleManager::AllocateParticleBuffer(...))
+enum ParticleBufferAccess
+{
+    PARTICLE_BUFFER_ACCESS_GPU_ONLY = 0,
+    PARTICLE_BUFFER_ACCESS_CPU_READBACK,
+    PARTICLE_BUFFER_ACCESS_MUTABLE,
+
+    // the whole pool's address range is reserved with GL_ARB_sparse_buffer, but memory is only
+    // committed for the pages that the emitters' ranges cover (see 
+    // ParticleManager::SetParticleBufferAccess(...))
+    PARTICLE_BUFFER_ACCESS_SPARSE,
+};
+
+// how Render() colors the particles (see ParticleManager::SetColorMode(...))
+enum ParticleColorMode
+{
+    PARTICLE_COLOR_MODE_FLAT = 0,
+    PARTICLE_COLOR_MODE_SPEED_PALETTE,
+};
+
+// the shape of each particle when the render program draws instanced quads (see 
+// ParticleManager::SetQuadShape(...))
+enum ParticleQuadShape
+{
+    PARTICLE_QUAD_SHAPE_SQUARE = 0,
+    PARTICLE_QUAD_SHAPE_OCTAGON,
+};
+
+// which part of the particle pool to copy back to the CPU, and how often (see 
+// ParticleManager::SetParticleReadback(...))
+// Note: Particles are emitted into random slots with random positions and velocities, so a 
+// range of the pool is already a uniform sample of the cloud.  Reading a tenth of the pool is 
+// a 10% subsample at a tenth of the copy and bus cost, with no gather pass.
+struct ParticleReadbackRequest
+{
+    unsigned int _firstParticle;
+    unsigned int _particleCount;            // 0 reads to the end of the pool
+    unsigned int _updatesBetweenReadbacks;  // 1 reads after every UpdateSteps(...)
+};
+
+// a finished readback, as handed to the readback callback
+// Note: The data is in the manager's layout: a Particle, PackedHalfParticle, or 
+// PackedFixedParticle per particle in _particleData[0], or for the structure-of-arrays layout, 
+// positions, velocities, and flags in [0], [1], and [2].  The pointers are only good for the 
+// duration of the callback.
+// Also Note: The sort moves particles between slots (see ParticleManager::SetParticleSort(...)),
+// so the slots of a range aren't the same particles from one readback to the next.  If the 
+// sort was set up before the readback, _particleIds has each slot's stable particle ID, 
+// otherwise it is 0.
+static const unsigned int PARTICLE_READBACK_MAX_BUFFERS = 3;
+struct ParticleReadbackFrame
+{
+    unsigned int _updateIndex;
+    unsigned int _firstParticle;
+    unsigned int _particleCount;
+    ParticleLayout _layout;
+    const void *_particleData[PARTICLE_READBACK_MAX_BUFFERS];
+    const unsigned int *_particleIds;
+};
+typedef std::function<void(const ParticleReadbackFrame &)> ParticleReadbackCallback;
+
+// the file format of ParticleManager::SaveSnapshot(...) and LoadSnapshot(...)
+// Note: The header is followed by the sections that it has the offsets of, and each section 
+// is a raw copy of one of the manager's buffers (or of the emitter table), in the manager's 
+// layout, so a load is a copy straight into the buffers with nothing to parse.  Each section 
+// starts on a PARTICLE_SNAPSHOT_ALIGNMENT boundary.  A section that the state didn't have 
+// (ex: the ID tables without the sort, or the particle buffers that the layout doesn't use) 
+// has a size of 0.
+// Also Note: The version changes whenever this header or the layout of a section (ex: 
+// Particle or ParticleEmitter) does, and older files are refused instead of converted.
+static const unsigned int PARTICLE_SNAPSHOT_MAGIC = 0x50414e53;     // "SNAP" in the file
+static const unsigned int PARTICLE_SNAPSHOT_VERSION = 1;
+static const unsigned int PARTICLE_SNAPSHOT_ALIGNMENT = 256;
+enum ParticleSnapshotSection
+{
+    PARTICLE_SNAPSHOT_SECTION_EMITTERS = 0,
+    PARTICLE_SNAPSHOT_SECTION_PARTICLES_0,
+    PARTICLE_SNAPSHOT_SECTION_PARTICLES_1,
+    PARTICLE_SNAPSHOT_SECTION_PARTICLES_2,
+    PARTICLE_SNAPSHOT_SECTION_DEAD_COUNTS,
+    PARTICLE_SNAPSHOT_SECTION_DEAD_INDICES,
+    PARTICLE_SNAPSHOT_SECTION_PARTICLE_IDS,
+    PARTICLE_SNAPSHOT_SECTION_PARTICLE_SLOTS,
+
+    PARTICLE_SNAPSHOT_SECTION_COUNT,
+};
+struct ParticleSnapshotHeader
+{
+    unsigned int _magic;
+    unsigned int _version;
+    unsigned int _headerSizeBytes;
+    unsigned int _layout;                   // a ParticleLayout
+    unsigned int _particleCount;            // the whole pool
+    unsigned int _emitterCount;
+    unsigned int _emitterSizeBytes;         // sizeof(ParticleEmitter)
+    unsigned int _randomSeed;               // the compute shader's next seed
+    unsigned long long _sectionOffsets[PARTICLE_SNAPSHOT_SECTION_COUNT];
+    unsigned long long _sectionSizes[PARTICLE_SNAPSHOT_SECTION_COUNT];
+};
+
+// a snapshot that stays on the GPU (see ParticleManager::CaptureKeyframe(...))
+// Note: The header's offsets are into the buffer that the keyframe was captured into, and 
+// the emitter table is kept here instead, like the counters that a file doesn't need.
+struct ParticleKeyframe
+{
+    ParticleSnapshotHeader _header;
+    std::vector<ParticleEmitter> _emitters;
+    std::vector<unsigned int> _drawGroupFirstEmitters;
+    std::vector<double> _emissionRemainders;
+    unsigned int _emitStepCounter;
+    double _simulationTimeSec;
+};
+
+// what the particles are sorted by (see ParticleManager::SetParticleSort(...))
+enum ParticleSortKey
+{
+    // a Z-order curve over the window, which puts particles that are near each other on the 
+    // screen near each other in the pool
+    PARTICLE_SORT_KEY_MORTON = 0,
+
+    // the distance along a direction in the window (see ParticleSortRequest)
+    PARTICLE_SORT_KEY_DEPTH,
+};
+
+// how the particles are sorted, and how often
+// Note: The particles are 2D, so "depth" is the distance along a direction in the window 
+// that points away from the viewer (ex: (0, 1) for a view that is tilted so that the top of 
+// the window is farther away).  Front to back is nearest first, which is the order for 
+// opaque particles, and back to front is the order for alpha blending.
+struct ParticleSortRequest
+{
+    ParticleSortKey _key;
+    glm::vec2 _depthDirection;          // only for depth; doesn't need to be normalized
+    bool _backToFront;
+    unsigned int _updatesBetweenSorts;  // 1 sorts after every UpdateSteps(...)
+};
+
+// how the update and emit kernels share the atomics on the dead stacks and the live index 
+// ranges (see AggregatedAtomic in shaderParticle.comp)
+// Note: With aggregation, the work items that want the same counter make one atomic for all 
+// of them instead of one each.  A subgroup (warp or wavefront) is 32 or 64 work items, which 
+// cuts the atomics by that much.  The subgroup flavors need the extensions in their names 
+// (see ParticleManager::IsAtomicAggregationSupported(...)), and the work group flavor goes 
+// through shared memory, so it runs anywhere but costs a few barriers.
+enum ParticleAtomicAggregation
+{
+    // one atomic per particle (the original)
+    PARTICLE_ATOMICS_PER_ITEM = 0,
+    PARTICLE_ATOMICS_WORK_GROUP,
+    PARTICLE_ATOMICS_KHR_SUBGROUP,
+    PARTICLE_ATOMICS_NV_THREAD_GROUP,
+    PARTICLE_ATOMICS_AMD_BALLOT,
+};
+
+// how the update moves the particles through a step (see IntegrateParticle(...) in 
+// shaderParticle.comp)
+// Note: All of them evaluate the forces once per step.  Without forces, they are all the same.
+enum ParticleIntegrator
+{
+    // the velocity is updated first and the position moves with the new one
+    PARTICLE_INTEGRATOR_SEMI_IMPLICIT_EULER = 0,
+
+    // the position moves with the old velocity (the original); gains energy in orbits
+    PARTICLE_INTEGRATOR_EXPLICIT_EULER,
+
+    // second order, so it stays accurate at larger steps than either Euler
+    PARTICLE_INTEGRATOR_VELOCITY_VERLET,
+};
+
+// what happens to a particle that goes into the solid part of an SDF boundary (see 
+// ParticleManager::SetSdfBoundary(...))
+// Note: Must match the SDF_BOUNDARY_* defines in shaderParticle.comp.
+enum ParticleSdfBoundaryMode
+{
+    // it is recycled, just like one that leaves its emitter's circle
+    PARTICLE_SDF_BOUNDARY_KILL = 0,
+
+    // it is put back on the surface and bounces off of it
+    PARTICLE_SDF_BOUNDARY_COLLIDE,
+};
+
+// what happens to a particle whose step crosses one of the segments in a segment BVH (see 
+// ParticleManager::SetSegmentBvh(...))
+// Note: Must match the SEGMENT_BVH_* defines in shaderParticle.comp.
+enum ParticleSegmentBvhMode
+{
+    // it is recycled, just like one that leaves its emitter's circle
+    PARTICLE_SEGMENT_BVH_KILL = 0,
+
+    // it is stopped at the segment and bounces off of it
+    PARTICLE_SEGMENT_BVH_COLLIDE,
+};
+
+// where the particles are simulated (see ParticleManager::SetSimulationBackend(...))
+enum ParticleSimulationBackend
+{
+    // the compute shader (the original)
+    PARTICLE_SIMULATION_BACKEND_GPU = 0,
+
+    // worker threads on the CPU, with the results uploaded into the same buffers that the 
+    // compute shader would have written, so rendering and readbacks don't know the difference
+    PARTICLE_SIMULATION_BACKEND_CPU,
+
+    // the first emitters in the compute shader and the rest on the CPU's threads at the same 
+    // time, with the split moved between emitters until both take about as long
+    PARTICLE_SIMULATION_BACKEND_SPLIT,
+};
+
+// how the draw is thinned out when there are more particles than are worth drawing (see 
+// ParticleManager::SetLevelOfDetail(...))
+enum ParticleLodMode
+{
+    // every particle that can be seen is drawn (the original)
+    PARTICLE_LOD_OFF = 0,
+
+    // 1 in every _fixedStride particles
+    PARTICLE_LOD_FIXED,
+
+    // as few as it takes to have no more than _maxParticlesPerPixel for every pixel of the 
+    // viewport
+    PARTICLE_LOD_PIXEL_DENSITY,
+
+    // as few as it takes to keep the draw's GPU time under _renderBudgetMs (see 
+    // ParticleManager::ReportRenderTime(...))
+    PARTICLE_LOD_FRAME_BUDGET,
+};
+
+// Note: The automatic modes never thin out more than 1 in every _maxStride.  The particles that
+// are drawn make up for the rest by being brighter, which keeps the total light of additive 
+// blending the same, or (with _scalesPointSize) by being bigger, which keeps the area that 
+// opaque particles cover the same.
+struct ParticleLodSettings
+{
+    ParticleLodMode _mode;
+    unsigned int _fixedStride;      // only for fixed
+    float _maxParticlesPerPixel;    // only for pixel density
+    float _renderBudgetMs;          // only for frame budget
+    unsigned int _maxStride;
+    bool _scalesPointSize;
+};
+
+// the mouse (or a touch), as the simulation sees it (see 
+// ParticleManager::PublishPointerInput(...))
+struct ParticlePointerInput
+{
+    glm::vec2 _position;            // window coordinates, after the camera (X and Y in [-1,+1])
+    bool _isEmitting;               // the pointer's emitter sends particles out
+    float _attractorStrength;       // 0 for no attractor, and negative pushes instead
+
+    // when the input happened, on GetPacingClockMs()'s clock (see FramePacing.h), so that its
+    // latency can be measured once the frame that used it is done
+    double _timeMs;
+};
+
+// compile-time constants for a compute shader variant (see 
+// ParticleManager::GetComputeShaderDefines(...))
+// Note: Everything here is baked into the program as "#define" statements, so the compiler 
+// folds it into the kernel instead of loading it from the emitter table every time a particle
+// is updated.  Each combination is its own program, built and cached separately (see 
+// AcquireComputeProgram(...) and ShaderBinaryCache.h).  Start from 
+// ParticleManager::GetDefaultKernelVariant(), which bakes nothing in.
+struct ParticleKernelVariant
+{
+    // there is exactly one emitter, and its center, radius, and velocities are these
+    // Note: The emitter table must still have the emitter (the shader reads its particle 
+    // count, range, and emission quota from there), but SetEmitter(...) can't change the baked
+    // in values.
+    bool _hasFixedEmitter;
+    ParticleEmitter _fixedEmitter;
+
+    // there is one draw group (see ParticleManager::SetDrawGroups(...)), so the shader never 
+    // has to search for a particle's group
+    bool _hasSingleDrawGroup;
+
+    // if false, particles that go out of bounds are deactivated but aren't put back on their 
+    // emitter's dead stack, so each particle is only emitted once (ex: a one-shot burst) and 
+    // the update skips the atomic push
+    // Note: Resize(...) and SetEmitterTable(...) rebuild the dead stacks from the "is active" 
+    // flags, and that brings every dead particle back.
+    bool _respawnParticles;
+
+    // see ParticleManager::GetBestAtomicAggregation()
+    ParticleAtomicAggregation _atomicAggregation;
+
+    // the force field loop has a fixed trip count, which the compiler can unroll, and only the 
+    // first this many force fields are used (see ParticleManager::SetForceFields(...))
+    // Note: A count of 0 takes the force fields out of the kernel entirely.
+    bool _hasUnrolledForceFields;
+    unsigned int _unrolledForceFieldCount;
+
+    // the update samples a field texture (see ParticleManager::SetFieldTexture(...))
+    bool _hasFieldTexture;
+
+    // see ParticleIntegrator
+    ParticleIntegrator _integrator;
+
+    // the update tests the particles against an SDF boundary (see 
+    // ParticleManager::SetSdfBoundary(...))
+    bool _hasSdfBoundary;
+
+    // the update tests the particles against a segment BVH (see 
+    // ParticleManager::SetSegmentBvh(...))
+    bool _hasSegmentBvh;
+
+    // emitters can spawn in an image (see ParticleManager::SetEmissionImage(...))
+    bool _hasEmissionImage;
+
+    // emitters can follow paths (see ParticleManager::SetEmitterPaths(...))
+    bool _hasEmitterPaths;
+
+    // emitters' particles can be integrated on only some updates, with longer steps (see 
+    // ParticleManager::SetEmitterUpdateSlices(...))
+    bool _hasEmitterTimeSlicing;
+
+    // the pointer can move an emitter and attract the particles (see 
+    // ParticleManager::PublishPointerInput(...))
+    bool _hasPointerInput;
+
+    // the program has the burst pass (see ParticleManager::TriggerBurst(...))
+    bool _hasBursts;
+
+    // the update records deaths and a pass spawns their children (see 
+    // ParticleManager::SetSubEmitters(...))
+    bool _hasSubEmitters;
+
+    // the program has the pass that scatters streamed particles into the pool (see 
+    // ParticleManager::SetInjectionRing(...))
+    bool _hasInjection;
+
+    // the update keeps each draw group's bounds, and a pass takes the groups that are off the 
+    // screen out of the draw (see ParticleManager::SetDrawGroupCulling(...))
+    bool _hasDrawGroupCulling;
+
+    // particles that come to rest fall asleep and aren't integrated (see 
+    // ParticleManager::SetSleep(...))
+    bool _hasSleep;
+
+    // the emit passes take each particle's spawn spot, speed, and direction from a 
+    // low-discrepancy sequence instead of from the hash (see 
+    // ParticleManager::SetLowDiscrepancyEmission(...))
+    bool _hasLowDiscrepancyEmission;
+
+    // the update counts each emitter's particle steps into a buffer that 
+    // ParticleCostAttribution binds and reads back (see ParticleCostAttribution.h)
+    bool _hasCostAttribution;
+
+    // the program also has the persistent-threads kernel (see 
+    // ParticleManager::SetPersistentThreads(...))
+    // Note: It makes the particle buffers "coherent", which may cost the other passes a 
+    // little, so it is only worth it for the small pools that use it.
+    bool _hasPersistentThreads;
+
+    // the update pass can also do the emit pass's work (see 
+    // ParticleManager::SetFusedEmitUpdate(...))
+    // Note: Left out of a program that doesn't respawn particles, which has nothing to emit 
+    // them with.
+    bool _hasFusedEmitUpdate;
+
+    // a GLSL file of the user's own that defines "void customUpdate(inout Particle p, float 
+    // dt)", which the update runs on every particle on every substep, after it moves, so a 
+    // behavior costs its arithmetic instead of a pass over the particles of its own
+    // Note: It is spliced into the compute shader by the loader (see InsertShaderDefines(...)
+    // in GenerateShader.h), so each file is a variant like any other, built and cached 
+    // separately.  Empty for none.  Only the GPU backends run it, and the CPU's half of a 
+    // split doesn't.
+    std::string _customUpdateFilePath;
+};
 
 /*-----------------------------------------------------------------------------------------------
 Description:
@@ -25,48 +409,815 @@ public:
         const glm::vec2 center,
         float radius,
         float minVelocity,
-        float maxVelocity);
+        float maxVelocity,
+        ParticleLayout layout);
+    void Init(unsigned int programId,
+        unsigned int computeProgramId,
+        const std::vector<ParticleEmitter> &emitters,
+        ParticleLayout layout);
     void Cleanup();
     void Update(float deltaTimeSec);
+    void UpdateSteps(float stepSec, unsigned int numSteps);
+    void Resize(unsigned int newParticleCount);
+    void ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId);
 
-    void Render();
+    void Render(float extrapolationSec);
+    void SetFullMemoryBarrier(bool useFullBarrier);
+    void SetLiveUpdateList(bool useList);
+    void InvalidateUpdateList();
+    void SetParticleBufferAccess(ParticleBufferAccess access);
+    void SetParticlesPerInvocation(unsigned int particlesPerInvocation);
+    void SetSubstepsPerDispatch(unsigned int substepsPerDispatch);
+    void SetPersistentThreads(unsigned int workGroupCount);
+    bool IsPersistentThreadsActive() const;
+    void SetFusedEmitUpdate(bool isFused);
+    bool IsFusedEmitUpdateActive() const;
+    void SetSimulationBackend(ParticleSimulationBackend backend, unsigned int cpuWorkerCount = 0);
+    ParticleSimulationBackend GetSimulationBackend() const;
+    void SetDeterministic(bool isDeterministic, unsigned int randomSeed);
+    bool IsDeterministic() const;
+    unsigned long long GetParticleChecksum() const;
+    void SetSplitProfiler(GpuProfiler *profiler, unsigned int gpuScopeId);
+    void SetExternalKernel(ParticleComputeInterop *interop, const ParticleInteropKernel &kernel);
+    void ClearExternalKernel();
+    void GetSplitParticleCounts(unsigned int *putGpuCountHere, 
+        unsigned int *putCpuCountHere) const;
+    unsigned int GetSubstepsPerDispatch() const;
+    void SetPointSize(float pointSizePixels);
+    void SetParticleBrightness(float brightness);
+    void SetParticleOpacity(float opacity);
+    void SetViewportMask(unsigned int viewportMask);
+    float GetPointSize() const;
+    float GetParticleBrightness() const;
+    void SetColorMode(ParticleColorMode colorMode);
+    void SetQuadShape(ParticleQuadShape quadShape);
+    void SetViewportSize(int widthPixels, int heightPixels);
+    void SetRenderScale(float renderScale);
+    void SetView(const glm::mat4 &viewProjection, bool isCulled);
+    void SetLevelOfDetail(const ParticleLodSettings &settings);
+    void ReportRenderTime(float renderMs);
+    unsigned int GetLodStride() const;
+    void SetUpdateAmortization(unsigned int amortizationFactor);
+    unsigned int GetUpdateAmortization() const;
+    void SetSpeedPalette(const std::vector<glm::vec3> &colors, float maxSpeed, 
+        float fastPointSizeScale);
+    void SetFlipbook(int frameWidth, int frameHeight, unsigned int frameCount, 
+        const std::vector<unsigned char> &rgbaFrames, float cyclesPerLifetime);
+    void SetDrawGroups(const std::vector<unsigned int> &firstEmitterOfEachGroup);
+    void SetPoolCapacity(unsigned int particleCapacity, unsigned int emitterCapacity, 
+        unsigned int drawGroupCapacity);
+    bool SetEmitterTable(const std::vector<ParticleEmitter> &emitters, 
+        const std::vector<unsigned int> &firstEmitterOfEachGroup);
+    void ClearParticleRange(unsigned int firstParticle, unsigned int particleCount);
+    void MoveParticleRange(unsigned int sourceFirst, unsigned int destinationFirst, 
+        unsigned int particleCount);
+    void SetDrawGroupStyle(unsigned int drawGroupIndex, float pointSizeScale, 
+        float brightnessScale);
+    void SetDrawGroupVisible(unsigned int drawGroupIndex, bool isVisible);
+    unsigned int GetDrawGroupCount() const;
+    unsigned int GetDrawGroupLiveCount(unsigned int drawGroupIndex) const;
+    void SetDrawGroupCulling(bool isCulled);
+    float GetDrawGroupOffScreenSec(unsigned int drawGroupIndex) const;
+    const std::vector<unsigned int> &GetDrawGroupFirstEmitters() const;
+    void SetEmitter(unsigned int emitterIndex, const ParticleEmitter &emitter);
+    const std::vector<ParticleEmitter> &GetEmitters() const;
+    void SetForceFields(const std::vector<ParticleForceField> &forceFields);
+    const std::vector<ParticleForceField> &GetForceFields() const;
+    void SetFieldTexture(unsigned int textureId, const glm::vec2 &minCorner, 
+        const glm::vec2 &maxCorner, ParticleFieldTextureMode mode, float response, 
+        float valueScale = 1.0f);
+    void ClearFieldTexture();
+    void SetSdfBoundary(unsigned int textureId, int width, int height, 
+        const glm::vec2 &minCorner, const glm::vec2 &maxCorner, ParticleSdfBoundaryMode mode, 
+        float restitution, float distanceScale = 1.0f);
+    void ClearSdfBoundary();
+    void SetSegmentBvh(unsigned int segmentBufferId, unsigned int nodeBufferId, 
+        unsigned int segmentCount, ParticleSegmentBvhMode mode, float restitution);
+    void ClearSegmentBvh();
+    void SetEmissionImage(unsigned int cdfBufferId, int width, int height, 
+        const glm::vec2 &minCorner, const glm::vec2 &maxCorner);
+    void ClearEmissionImage();
+    void SetEmitterPaths(const std::vector<ParticleEmitterPath> &paths, 
+        const std::vector<glm::vec2> &pathPoints);
+    const std::vector<ParticleEmitterPath> &GetEmitterPaths() const;
+    void SetEmitterUpdateSlices(const std::vector<ParticleEmitterSlice> &slices);
+    void SetEmissionRates(const std::vector<float> &rates);
+    const std::vector<float> &GetEmissionRates() const;
+    double GetSimulationTimeSec() const;
+    void SetPointerEmitter(int emitterIndex);
+    void PublishPointerInput(const ParticlePointerInput &input);
+    double GetAppliedPointerInputTimeMs() const;
+    bool TriggerBurst(const ParticleBurst &burst);
+    bool SetInjectionRing(ParticleInjectionRing *ring);
+    void SetSubEmitters(const std::vector<ParticleSubEmitter> &subEmitters);
+    const std::vector<ParticleSubEmitter> &GetSubEmitters() const;
+    void SetSleep(float sleepSpeed, unsigned int restUpdates);
+    void SetLowDiscrepancyEmission(bool isEnabled);
+    void WakeAllParticles();
+    void SetBindlessTextures(bool isEnabled);
+    bool IsBindlessTexturesActive() const;
+    void SetDoubleBufferedRendering(bool isEnabled);
+    bool IsDoubleBufferedRenderingActive() const;
+    unsigned int GetMaxParticleCount() const;
+    unsigned long long GetCommittedParticleBytes() const;
+    const void *GetMappedParticleBuffer(unsigned int bufferIndex) const;
+    void GetParticleCounts(unsigned int *putLiveCountHere, 
+        unsigned int *putEmittedCountHere) const;
+    void SetParticleReadback(const ParticleReadbackRequest &request, 
+        const ParticleReadbackCallback &callback);
+    void ClearParticleReadback();
+    unsigned int GetSkippedReadbackCount() const;
+    unsigned int GetTableUploadBytes() const;
+    bool SaveSnapshot(const std::string &filePath);
+    bool IsSnapshotPending() const;
+    bool LoadSnapshot(const std::string &filePath);
+    static bool ReadSnapshotHeader(const void *fileData, size_t fileSizeBytes, 
+        const std::string &filePath, ParticleSnapshotHeader *putHeaderHere);
+    bool LoadSnapshotData(const void *mappedData, size_t fileSizeBytes, 
+        unsigned int stagingBufferId, const std::string &filePath);
+    size_t GetKeyframeSizeBytes() const;
+    bool CaptureKeyframe(unsigned int bufferId, size_t bufferOffset, 
+        ParticleKeyframe *putKeyframeHere);
+    bool RestoreKeyframe(unsigned int bufferId, const ParticleKeyframe &keyframe);
+    bool LoadParticles(const std::vector<Particle> &particles);
+    bool ReadParticles(std::vector<Particle> *putParticlesHere) const;
+    void SetParticleSort(unsigned int sortProgramId, const ParticleSortRequest &request);
+    void ClearParticleSort();
+    bool IsParticleSortDue() const;
+    void SortParticles();
+
+    static const unsigned int DEFAULT_WORK_GROUP_SIZE = 256;
+    static std::string GetComputeShaderDefines(ParticleLayout layout, 
+        unsigned int workGroupSize = DEFAULT_WORK_GROUP_SIZE);
+    static std::string GetComputeShaderDefines(ParticleLayout layout, 
+        unsigned int workGroupSize, const ParticleKernelVariant &variant);
+    static ParticleKernelVariant GetDefaultKernelVariant();
+    static bool IsAtomicAggregationSupported(ParticleAtomicAggregation aggregation);
+    static ParticleAtomicAggregation GetBestAtomicAggregation();
+    static std::string GetRenderShaderDefines(ParticleLayout layout);
+    static std::string GetQuadRenderShaderDefines(ParticleLayout layout);
+    static std::string GetFlipbookRenderShaderDefines(ParticleLayout layout, bool useQuads);
+    static std::string GetSmoothPointRenderShaderDefines(ParticleLayout layout, 
+        bool useVertexPulling);
+    static std::string GetSortShaderDefines(ParticleLayout layout);
+    static unsigned long long EstimateGpuMemory(unsigned int particleCount, 
+        ParticleLayout layout);
+    static unsigned int GetMaxPoolParticleCount(ParticleLayout layout);
 
 private:
-    bool OutOfBounds(const Particle &p) const;
-    void ResetParticle(Particle *resetThis) const;
-    glm::vec2 GetNewVelocityVector() const;
+    void InitParticleBuffers();
+    void ApplyBindlessTextures();
+    void ReleaseBindlessTextures();
+    void InitRenderCopies();
+    void ReleaseRenderCopies();
+    void CopyRenderState(float updateSec);
+    void InitParameterBuffer();
+    void InitBurstQueueBuffer();
+    unsigned int WriteBurstQueue(unsigned int frameSlot);
+    void DropReadyInjections();
+    bool IsDrawGroupCullingActive() const;
+    void ClearDrawGroupBounds();
+    void InitViewBuffer();
+    void UploadView();
+    void UpdateLodStride();
+    void InitCountReadbackBuffer();
+    void InitDrawGroups();
+    void LoadProgramInterfaces();
+    void ApplyVertexPulling();
+    void RenderQuads(unsigned int drawCommandBufferId);
+    void InitSpeedPalette();
+    void InitFlipbook();
+    void CopyCountsForReadback();
+    void CopyParticlesForReadback();
+    void FinishSnapshot(bool waitForGpu);
+    size_t LayOutKeyframe(size_t bufferOffset, ParticleSnapshotHeader *putHeaderHere, 
+        unsigned int *putBufferIdsHere) const;
+    void GetSnapshotSections(unsigned int emitterCount, unsigned int *putBufferIdsHere, 
+        size_t *putSizesHere) const;
+    void LoadSortProgramInterface();
+    void DispatchSortStage(int sortStage, unsigned int numWorkGroups);
+    void InitParticleIds();
+    unsigned int GetParticleBufferStride(unsigned int bufferIndex) const;
+    void AllocateParticleBuffer(unsigned int bufferIndex, size_t sizeBytes, 
+        size_t firstZeroedByte = 0);
+    void CommitParticleBufferPages(unsigned int bufferIndex, unsigned int bufferId, 
+        size_t firstByte, size_t endByte);
+    void CommitParticlePages(unsigned int firstParticle, unsigned int particleCount);
+    void UpdateParticlePageCommitment();
+    unsigned int AcquireParameterFrameSlot();
+    void RebuildDeadStacks(unsigned int firstEmitterIndex, unsigned int emitterCount);
+    void RebuildActiveMask();
+    bool OutOfBounds(const Particle &p, const ParticleEmitter &emitter) const;
+    void ResetParticle(Particle *resetThis, const ParticleEmitter &emitter) const;
+    glm::vec2 GetNewVelocityVector(const ParticleEmitter &emitter) const;
+    unsigned int GetUpdateBarrierBits() const;
+    void UpdateEmissionQuotas(float emitSpanSec);
+    void MarkEmittersDirty(unsigned int firstEmitter, unsigned int emitterCount);
+    void MarkForceFieldsDirty(unsigned int firstForceField, unsigned int forceFieldCount);
+    void FlushDirtyTables();
+    unsigned int GetMaxEmitterQuota() const;
+    void InitCpuSimulation();
+    void CleanupCpuSimulation();
+    void UpdateStepsOnCpu(float stepSec, unsigned int numSteps);
+    unsigned int UpdateCpuParticles(float stepSec, unsigned int numSteps, 
+        unsigned char *uploadRegion);
+    unsigned int EmitParticlesOnCpu(float emitSpanSec);
+    unsigned int GetCpuChunkCount() const;
+    unsigned int UpdateSplitCpuParticles(float stepSec, unsigned int numSteps, 
+        unsigned int frameSlot);
+    void BalanceSplitSimulation();
+    void RunExternalKernel(float stepSec, unsigned int numSteps);
+    void MoveSplitEmitterToCpu();
+    void MoveSplitEmitterToGpu();
+    void UpdateCpuParticleChunk(unsigned int chunkIndex, float stepSec, unsigned int numSteps, 
+        unsigned char *uploadRegion);
+    void StepCpuParticlesWithForces(const ParticleSimdArrays &arrays, 
+        unsigned int firstParticle, unsigned int particleCount, const ParticleSimdStep &step, 
+        unsigned int *deadMask) const;
+    glm::vec2 GetCpuForceFieldAcceleration(const glm::vec2 &position, 
+        const glm::vec2 &velocity) const;
+
+    // no copies; the GL objects are owned (see GlObjects.h), and only one manager can own them
+    ParticleManager(const ParticleManager &);
+    ParticleManager &operator=(const ParticleManager &);
 
-    glm::vec2 _center;
-    float _radiusSqr;   // because radius is never used
-    float _velocityMin;
-    float _velocityDelta;
+    std::vector<ParticleEmitter> _emitters;
 
     // save on the large header inclusion of OpenGL and write out these primitive types instead 
     // of using the OpenGL typedefs
     // Note: IDs are GLuint (unsigned int), draw style is GLenum (unsigned int), GLushort is 
-    // unsigned short.
-    unsigned int _programId;
-    unsigned int _computeProgramId;
-    unsigned int _vaoId;
+    // unsigned short.  The objects that the manager owns are in handles that delete them (see
+    // GlObjects.h), and the ones that belong to someone else are plain IDs.
+    GlProgram _programId;
+    GlProgram _computeProgramId;
+    GlVertexArray _vaoId;
     //unsigned int _arrayBufferId;
     unsigned int _drawStyle;    // GL_TRIANGLES, GL_LINES, etc.
-    unsigned int _sizeBytes;    // useful for glBufferSubData(...)
-    std::vector<Particle> _allParticles;
-    unsigned int _maxParticlesEmittedPerFrame;
+    unsigned int _maxParticleCount;     // every emitter's particles together
+
+    // room that is set aside at Init(...) for SetEmitterTable(...) (see SetPoolCapacity(...))
+    // Note: The particle capacity only matters at Init(...).  Afterwards, the pool is 
+    // _maxParticleCount.
+    unsigned int _poolParticleCapacity;
+    unsigned int _emitterCapacity;
+    unsigned int _drawGroupCapacity;
+
+    // GL_*_BARRIER_BIT flags for after the compute dispatch
+    unsigned int _updateBarrierBits;
+    bool _useFullMemoryBarrier;
+
+    // incremented on every dispatch and used as the seed for the compute shader's random 
+    // numbers
+    unsigned int _stepCounter;
+
+    // see SetDeterministic(...)
+    // Note: The emit step counter moves the deterministic emit pass's window along.
+    bool _isDeterministic;
+    unsigned int _randomSeed;
+    unsigned int _emitStepCounter;
+
+    // the sum of every update's steps since Init(...), which the emitter paths are a function 
+    // of (see SetEmitterPaths(...))
+    double _simulationTimeSec;
+
+
+    // the interleaved layout uses a single buffer, while structure-of-arrays uses one per 
+    // attribute (position, velocity, flags)
+    ParticleLayout _layout;
+    static const unsigned int MAX_PARTICLE_BUFFERS = 3;
+    GlBuffer _particleBufferIds[MAX_PARTICLE_BUFFERS];
+    unsigned int _particleBufferCount;
+    ParticleBufferAccess _bufferAccess;
+    void *_mappedParticleBuffers[MAX_PARTICLE_BUFFERS];
+
+    // only for PARTICLE_BUFFER_ACCESS_SPARSE; which of each particle buffer's pages have 
+    // memory behind them (see CommitParticlePages(...))
+    // Note: The page size is 0 when the buffers aren't sparse.
+    size_t _sparsePageSizeBytes;
+    std::vector<unsigned char> _committedParticlePages[MAX_PARTICLE_BUFFERS];
+
+    // stream compaction
+    // Note: The binding points come after the 3 that the structure-of-arrays layout uses and 
+    // must match shaderParticle.comp.
+    static const unsigned int LIVE_INDEX_BUFFER_BINDING = 3;
+    static const unsigned int DRAW_COMMAND_BUFFER_BINDING = 4;
+    GlBuffer _liveIndexBufferId;
+    GlBuffer _drawCommandBufferId;
+
+    // the update covers the particles that were alive after the last one, plus the ones that 
+    // were just emitted, with an indirect dispatch (see SetLiveUpdateList(...))
+    // Note: The bindings continue from ParticleTrajectoryRecorder's and must match 
+    // shaderParticle.comp.  The update reads the list at _updateListIndex and appends to the 
+    // other one, and then they trade places.  A stale list is rebuilt by the next update.
+    static const unsigned int UPDATE_LIST_IN_BUFFER_BINDING = 34;
+    static const unsigned int UPDATE_LIST_OUT_BUFFER_BINDING = 35;
+    bool _useUpdateList;
+    bool _isUpdateListStale;
+    GlBuffer _updateListBufferIds[2];
+    unsigned int _updateListIndex;
+
+    // the "is active" flags, 1 bit per particle, so that the passes over the whole pool can 
+    // skip the dead particles without loading them (see RebuildActiveMask())
+    // Note: The binding must match shaderParticle.comp.
+    static const unsigned int ACTIVE_MASK_BUFFER_BINDING = 36;
+    GlBuffer _activeMaskBufferId;
+
+    // the emit pass and the update in one dispatch of this many work groups, which take their 
+    // work off of a queue (see SetPersistentThreads(...))
+    // Note: The binding must match shaderParticle.comp.  Only a compute program built with 
+    // ParticleKernelVariant::_hasPersistentThreads has the queue.
+    static const unsigned int PERSISTENT_QUEUE_BUFFER_BINDING = 37;
+    GlBuffer _persistentQueueBufferId;
+    unsigned int _persistentWorkGroupCount;
+    bool _hasPersistentKernel;
+
+    // the update pass sends the dead particles back out itself, and the emit pass is skipped 
+    // (see SetFusedEmitUpdate(...))
+    // Note: The dead stacks aren't kept up in the meantime, so they are rebuilt on the first 
+    // update after it stops, and after a snapshot or keyframe, which may have been taken 
+    // while it was on.  Only a compute program built with 
+    // ParticleKernelVariant::_hasFusedEmitUpdate has the uniform.
+    bool _isFusedEmitUpdate;
+    bool _areDeadStacksStale;
+    unsigned int _unifLocFusedEmitMode;
+
+    // every draw group (a run of consecutive emitters) gets its own indirect draw command and 
+    // its own range of the live index buffer, and Render() draws them all with one 
+    // glMultiDrawElementsIndirect(...) (see SetDrawGroups(...))
+    // Note: The styles are an instanced vertex attribute, and each command's "base instance" 
+    // is its group's index, so each group picks up its own style without a uniform change.
+    // The location must match shaderParticle.vert.
+    static const unsigned int DRAW_GROUP_STYLE_ATTRIBUTE = 3;
+    std::vector<unsigned int> _drawGroupFirstEmitters;
+    std::vector<glm::vec2> _drawGroupStyles;    // X scales the point size, Y the brightness
+    std::vector<unsigned int> _drawGroupLiveCounts;
+    std::vector<unsigned int> _drawCommandResetData;    // what each step starts the commands at
+    GlBuffer _drawGroupStyleBufferId;
+
+    // each draw group's bounds, which the update grows around what it draws, and when each 
+    // group was last seen culled (see SetDrawGroupCulling(...))
+    // Note: The binding must match shaderParticle.comp.  The buffer is only made if the 
+    // compute program has it when Init(...) runs.  A time below 0 is a group on the screen.
+    static const unsigned int DRAW_GROUP_BOUNDS_BUFFER_BINDING = 69;
+    unsigned int _unifLocDrawGroupCulled;
+    bool _isDrawGroupCulled;
+    std::vector<double> _drawGroupCulledSinceSec;
+    GlBuffer _drawGroupBoundsBufferId;
+
+    // the emitter table and the per-emitter stacks of inactive particles
+    static const unsigned int EMITTER_BUFFER_BINDING = 5;
+    static const unsigned int DEAD_COUNT_BUFFER_BINDING = 6;
+    static const unsigned int DEAD_INDEX_BUFFER_BINDING = 7;
+    GlBuffer _emitterBufferId;
+    GlBuffer _deadCountBufferId;
+    GlBuffer _deadIndexBufferId;
+    unsigned int _maxEmitterQuota;
+
+    // the force field table (see SetForceFields(...))
+    // Note: The binding must match shaderParticle.comp.  It is the one that the neighbor grid 
+    // leaves free below the scan's (see ParticleNeighborGrid.h and GpuScan.h).
+    static const unsigned int FORCE_FIELD_BUFFER_BINDING = 21;
+    std::vector<ParticleForceField> _forceFields;
+    GlBuffer _forceFieldBufferId;
+    unsigned int _forceFieldCapacity;
+
+    // the entries of the emitter and force field tables that have changed on the CPU since 
+    // they were last uploaded, as [first, end) (empty when first >= end), which the next 
+    // update uploads with one call per table (see FlushDirtyTables())
+    unsigned int _dirtyEmitterFirst;
+    unsigned int _dirtyEmitterEnd;
+    unsigned int _dirtyForceFieldFirst;
+    unsigned int _dirtyForceFieldEnd;
+
+    // the table bytes uploaded since the last update's flush, and up to and including it 
+    // (see GetTableUploadBytes())
+    unsigned int _pendingTableUploadBytes;
+    unsigned int _lastTableUploadBytes;
+
+    // the texture isn't owned by the particle manager (see SetFieldTexture(...))
+    // Note: The unit must match "uFieldTexture" in shaderParticle.comp.  It isn't the speed 
+    // palette's so that neither has to be bound again between the update and the render.
+    static const unsigned int FIELD_TEXTURE_UNIT = 1;
+    unsigned int _unifLocFieldTextureMin;
+    unsigned int _unifLocFieldTextureInverseSize;
+    unsigned int _unifLocFieldTextureMode;
+    unsigned int _unifLocFieldTextureResponse;
+    unsigned int _unifLocFieldTextureScale;
+    unsigned int _unifLocFieldTexture;
+    unsigned int _fieldTextureId;
+    glm::vec2 _fieldTextureMin;
+    glm::vec2 _fieldTextureMax;
+    ParticleFieldTextureMode _fieldTextureMode;
+    float _fieldTextureResponse;
+    float _fieldTextureScale;
+
+    // same as the field texture
+    // Note: The unit must match "uSdfBoundary" in shaderParticle.comp.
+    static const unsigned int SDF_BOUNDARY_TEXTURE_UNIT = 2;
+    unsigned int _unifLocSdfBoundaryMin;
+    unsigned int _unifLocSdfBoundaryInverseSize;
+    unsigned int _unifLocSdfBoundaryTexelSize;
+    unsigned int _unifLocSdfBoundaryMode;
+    unsigned int _unifLocSdfBoundaryRestitution;
+    unsigned int _unifLocSdfBoundaryScale;
+    unsigned int _unifLocSdfBoundaryTexture;
+    unsigned int _sdfBoundaryTextureId;
+    glm::vec2 _sdfBoundaryMin;
+    glm::vec2 _sdfBoundaryMax;
+    glm::vec2 _sdfBoundaryTexelSize;
+    ParticleSdfBoundaryMode _sdfBoundaryMode;
+    float _sdfBoundaryRestitution;
+    float _sdfBoundaryScale;
+
+    // likewise for the segment BVH's buffers
+    // Note: The bindings must match shaderParticle.comp, and they are the same ones that 
+    // ParticleSegmentBvh builds them at.
+    static const unsigned int SEGMENT_BVH_SEGMENT_BUFFER_BINDING = 27;
+    static const unsigned int SEGMENT_BVH_NODE_BUFFER_BINDING = 28;
+    unsigned int _unifLocSegmentBvhSegmentCount;
+    unsigned int _unifLocSegmentBvhMode;
+    unsigned int _unifLocSegmentBvhRestitution;
+    unsigned int _segmentBvhSegmentBufferId;
+    unsigned int _segmentBvhNodeBufferId;
+    unsigned int _segmentBvhSegmentCount;
+    ParticleSegmentBvhMode _segmentBvhMode;
+    float _segmentBvhRestitution;
+
+    // likewise for the emission image's CDF
+    // Note: The binding must match shaderParticle.comp, and it is the one that 
+    // ParticleEmissionImage builds the CDF's weights at.
+    static const unsigned int EMISSION_IMAGE_CDF_BUFFER_BINDING = 41;
+    unsigned int _unifLocEmissionImagePixelCount;
+    unsigned int _unifLocEmissionImageWidth;
+    unsigned int _unifLocEmissionImageMin;
+    unsigned int _unifLocEmissionImageTexelSize;
+    unsigned int _emissionImageCdfBufferId;
+    int _emissionImageWidth;
+    int _emissionImageHeight;
+    glm::vec2 _emissionImageMin;
+    glm::vec2 _emissionImageMax;
+
+    // the emitter paths (see SetEmitterPaths(...))
+    // Note: The bindings must match shaderParticle.comp.
+    static const unsigned int EMITTER_PATH_BUFFER_BINDING = 42;
+    static const unsigned int EMITTER_PATH_POINT_BUFFER_BINDING = 43;
+    unsigned int _unifLocEmitterPathCount;
+    std::vector<ParticleEmitterPath> _emitterPaths;
+    std::vector<glm::vec2> _emitterPathPoints;
+    GlBuffer _emitterPathBufferId;
+    GlBuffer _emitterPathPointBufferId;
+    unsigned int _emitterPathCapacity;
+    unsigned int _emitterPathPointCapacity;
+
+    // the emitters' update periods and phases (see SetEmitterUpdateSlices(...))
+    // Note: The binding must match shaderParticle.comp.  It comes after the cost 
+    // attribution's (see ParticleCostAttribution.h).
+    static const unsigned int EMITTER_SLICE_BUFFER_BINDING = 66;
+    unsigned int _unifLocEmitterSliceCount;
+    std::vector<ParticleEmitterSlice> _emitterSlices;
+    GlBuffer _emitterSliceBufferId;
+    unsigned int _emitterSliceCapacity;
+
+    // the emitters' particles per second, and the fraction of a particle that each one is 
+    // owed from the updates so far (see SetEmissionRates(...))
+    std::vector<float> _emissionRates;
+    std::vector<double> _emissionRemainders;
+
+    // the bursts that were triggered since the last update, and the persistently mapped queue 
+    // that each update copies them into, one slot per parameter frame, which the parameter 
+    // fences also cover (see TriggerBurst(...))
+    // Note: The binding must match shaderParticle.comp.  Only a compute program built with 
+    // ParticleKernelVariant::_hasBursts has the queue.
+    static const unsigned int BURST_QUEUE_BUFFER_BINDING = 44;
+    static const unsigned int MAX_BURSTS_PER_UPDATE = 256;
+    std::vector<ParticleBurst> _pendingBursts;
+    GlBuffer _burstQueueBufferId;
+    unsigned int _burstQueueSlotStride;
+    void *_mappedBurstQueue;
+    bool _hasBurstKernel;
+
+    // the ring that other threads stream particles into, whose slots each update scatters 
+    // into the pool, one indirect dispatch per slot (see SetInjectionRing(...))
+    // Note: The binding must match shaderParticle.comp.  The ring isn't owned, and only a 
+    // compute program built with ParticleKernelVariant::_hasInjection has the pass.
+    static const unsigned int INJECTION_SLOT_BUFFER_BINDING = 68;
+    ParticleInjectionRing *_injectionRing;
+    bool _hasInjectionKernel;
+
+    // the sub-emitters and the deaths that set them off (see SetSubEmitters(...))
+    // Note: The bindings must match shaderParticle.comp.  The death list starts with the 
+    // indirect dispatch of the pass that spawns the children, which the update sizes as it 
+    // appends, so the CPU never reads how many died.
+    static const unsigned int SUB_EMITTER_BUFFER_BINDING = 45;
+    static const unsigned int DEATH_EVENT_BUFFER_BINDING = 46;
+    static const unsigned int MAX_DEATH_EVENTS = 65536;
+    unsigned int _unifLocSubEmitterCount;
+    unsigned int _unifLocSubEmitterMaxChildren;
+    unsigned int _unifLocMaxDeathEvents;
+    std::vector<ParticleSubEmitter> _subEmitters;
+    unsigned int _subEmitterMaxChildren;
+    GlBuffer _subEmitterBufferId;
+    unsigned int _subEmitterCapacity;
+    GlBuffer _deathEventBufferId;
+
+    // which particles are asleep, and how long each has been slow (see SetSleep(...))
+    // Note: The bindings must match shaderParticle.comp.  The buffers are only made if the 
+    // compute program has them when Init(...) runs.
+    static const unsigned int SLEEP_MASK_BUFFER_BINDING = 47;
+    static const unsigned int REST_COUNT_BUFFER_BINDING = 48;
+    unsigned int _unifLocSleepSpeedSqr;
+    unsigned int _unifLocSleepRestUpdates;
+    float _sleepSpeed;
+    unsigned int _sleepRestUpdates;
+    GlBuffer _sleepMaskBufferId;
+    GlBuffer _restCountBufferId;
+
+    // the pointer (see PublishPointerInput(...))
+    // Note: The input thread only touches the slot.  The rest belong to whichever thread 
+    // updates, which takes the latest input as late as it can, when it fills in the 
+    // parameter block.
+    LatestValueSlot<ParticlePointerInput> _pointerInputSlot;
+    ParticlePointerInput _pointerInput;
+    int _pointerEmitterIndex;
+    double _appliedPointerInputTimeMs;
+
+    // read back from the compute program at Init(...) and when it is replaced
+    unsigned int _workGroupSizeX;
+    unsigned int _particlesPerInvocation;
+    unsigned int _substepsPerDispatch;
+
+
+    // the CPU backend (see SetSimulationBackend(...))
+    // Note: The particles are kept as one array per component so that the update loop reads
+    // each of them straight through.  Every update writes them, in the manager's layout, into 
+    // a region of a persistently mapped upload buffer, along with the live indices and the 
+    // draw commands, and then copies the region into the regular buffers on the GPU.  There is
+    // a region per parameter frame, so the parameter fences also say when a region is free.
+    // A chunk is one task for the thread pool, and each chunk collects its own live and dead 
+    // particles so that the tasks never share a list.  The coasting particles go through the 
+    // widest SIMD kernel that the CPU supports (see ParticleSimdKernels.h).
+    static const unsigned int CPU_PARTICLES_PER_CHUNK = 16384;
+    ParticleSimulationBackend _simulationBackend;
+    unsigned int _cpuWorkerCount;
+    WorkStealingThreadPool _cpuThreadPool;
+    ParticleSimdLevel _cpuSimdLevel;
+    ParticleSimdKernel _cpuSimdKernel;
+    std::vector<float> _cpuPositionsX;
+    std::vector<float> _cpuPositionsY;
+    std::vector<float> _cpuVelocitiesX;
+    std::vector<float> _cpuVelocitiesY;
+    std::vector<float> _cpuAges;
+    std::vector<int> _cpuIsActive;
+    std::vector<std::vector<unsigned int>> _cpuDeadStacks;     // one per emitter
+
+    // the CPU backend's emissions take the points of the sequence in order, across all of its 
+    // emitters (see SetLowDiscrepancyEmission(...))
+    bool _hasLowDiscrepancyEmission;
+    unsigned int _cpuEmissionSequenceIndex;
+    std::vector<std::vector<unsigned int>> _cpuChunkLiveIndices;
+    std::vector<std::vector<unsigned int>> _cpuChunkDeadIndices;
+    GlBuffer _cpuUploadBufferId;
+    void *_mappedCpuUpload;
+    size_t _cpuUploadRegionSizeBytes;
+    size_t _cpuUploadParticleOffsets[MAX_PARTICLE_BUFFERS];
+    size_t _cpuUploadLiveIndexOffset;
+    size_t _cpuUploadDrawCommandOffset;
+
+    // the split backend (see SetSimulationBackend(...))
+    // Note: The CPU has the emitters from _cpuFirstEmitter on, which is every emitter with the
+    // CPU backend, and the particles from _cpuFirstParticle on.  The balancer averages the two
+    // sides' times over a number of updates and then moves at most one emitter.  The GPU's 
+    // times come from the profiler, which is a few frames behind, so the updates right after 
+    // a move are skipped.
+    static const unsigned int SPLIT_BALANCE_SETTLE_UPDATES = 6;
+    static const unsigned int SPLIT_BALANCE_SAMPLE_UPDATES = 30;
+    unsigned int _cpuFirstEmitter;
+    unsigned int _cpuFirstParticle;
+    GpuProfiler *_splitProfiler;
+    unsigned int _splitGpuScopeId;
+    unsigned int _splitUpdatesSinceMove;
+    unsigned int _splitSampleCount;
+    float _splitGpuMsSum;
+    float _splitCpuMsSum;
+    float _splitLastCpuMs;
+
+    // another compute API's kernel on the particle buffers after each update (see 
+    // SetExternalKernel(...))
+    // Note: The interop belongs to the caller.  The manager registers its buffers with it and 
+    // unregisters them before they are deleted, so a resize just registers the new ones.
+    ParticleComputeInterop *_interop;
+    ParticleInteropKernel _interopKernel;
+
+
+    // the compute shader's parameters are in a persistently mapped uniform buffer instead of 
+    // individual uniforms (see InitParameterBuffer())
+    // Note: The block binding must match shaderParticle.comp.  The fences are GLsync, which is 
+    // a pointer, so they are stored as void pointers to keep the OpenGL header out of here.
+    static const unsigned int PARAMETER_BLOCK_BINDING = 0;
+    static const unsigned int PARAMETER_FRAMES_IN_FLIGHT = 3;
+    static const unsigned int MAX_UPDATE_STEPS = 8;
+    // + the emit pass, the split backend's append pass, the draw group culling pass, the 
+    // injection pass, the sub-emitter pass, and the burst pass
+    static const unsigned int PARAMETER_BLOCKS_PER_FRAME = MAX_UPDATE_STEPS + 6;
+    GlBuffer _parameterBufferId;
+    unsigned int _parameterBlockStride;
+    unsigned int _parameterFrameIndex;
+    void *_mappedParameters;
+    GlFenceRing _parameterFenceRing;
+
+    // non-stalling readback of the live and emitted counts (see InitCountReadbackBuffer())
+    // Note: Each slot is a copy of the whole draw command buffer.
+    static const unsigned int COUNT_READBACK_SLOTS = 4;
+    GlBuffer _countReadbackBufferId;
+    unsigned int _countReadbackSlotSizeBytes;
+    unsigned int _countReadbackIndex;
+    void *_mappedCountReadback;
+    GlFence _countReadbackFences[COUNT_READBACK_SLOTS];
+    unsigned int _latestLiveCount;
+    unsigned int _latestEmittedCount;
+
+    // non-stalling readback of a range of the particles (see SetParticleReadback(...))
+    // Note: Each slot holds the range of every particle buffer, one after the other.
+    static const unsigned int PARTICLE_READBACK_SLOTS = 3;
+    ParticleReadbackRequest _readbackRequest;
+    ParticleReadbackCallback _readbackCallback;
+    GlBuffer _readbackBufferId;
+    void *_mappedReadback;
+    size_t _readbackSlotSizeBytes;
+    size_t _readbackOffsets[MAX_PARTICLE_BUFFERS];
+    GlFence _readbackFences[PARTICLE_READBACK_SLOTS];
+    unsigned int _readbackUpdateIndices[PARTICLE_READBACK_SLOTS];
+    unsigned int _readbackIndex;
+    unsigned int _updatesSinceReadback;
+    unsigned int _skippedReadbacks;
+    bool _isReadingBackIds;
+    size_t _readbackIdOffset;
+
+    // a snapshot that is being saved (see SaveSnapshot(...))
+    // Note: The staging buffer is laid out like the file, so the GPU's sections are copied to 
+    // their file offsets.  The emitter table is the CPU's copy from when the save started.
+    GlBuffer _snapshotBufferId;
+    void *_mappedSnapshot;
+    GlFence _snapshotFence;
+    std::string _snapshotFilePath;
+    ParticleSnapshotHeader _snapshotHeader;
+    std::vector<ParticleEmitter> _snapshotEmitters;
+
+    // every particle buffer packed for LoadParticles(...), on large pages if they are on
+    LargeHostBuffer _loadStaging;
+
+    // the GPU sort (see SetParticleSort(...))
+    // Note: The bindings come after the density splat's (see DensitySplatRenderer.h) and must 
+    // match shaderParticle.comp.  The sort program's work group sorts a block of twice its 
+    // size in shared memory, so the work group size is read back from the program as well.
+    static const unsigned int SORT_PAIR_BUFFER_BINDING = 13;
+    static const unsigned int SORT_SCRATCH_BUFFER_BINDING = 14;
+    ParticleSortRequest _sortRequest;
+    GlProgram _sortProgramId;
+    unsigned int _sortWorkGroupSizeX;
+    unsigned int _updatesSinceSort;
+    GlBuffer _sortPairBufferId;
+    unsigned int _sortPairCapacity;
+    GlBuffer _sortScratchBufferId;
+    size_t _sortScratchSizeBytes;
+    unsigned int _unifLocSortStage;
+    unsigned int _unifLocSortK;
+    unsigned int _unifLocSortJ;
+    unsigned int _unifLocSortCount;
+    unsigned int _unifLocSortKeyType;
+    unsigned int _unifLocSortDepthDirection;
+    unsigned int _unifLocSortBackToFront;
+    unsigned int _unifLocSortEmitterBits;
+    unsigned int _unifLocSortScratchOffsets;
+    unsigned int _unifLocSortWordsPerParticle;
+    unsigned int _unifLocSortScratchIdOffset;
+
+    // the indirection between a particle's stable ID and the slot that the sort has put it in
+    // (see InitParticleIds())
+    // Note: The bindings must match shaderParticle.comp.  They stay bound, so other passes can
+    // use the tables too.
+    static const unsigned int PARTICLE_ID_BUFFER_BINDING = 15;
+    static const unsigned int PARTICLE_SLOT_BUFFER_BINDING = 16;
+    GlBuffer _particleIdBufferId;
+    GlBuffer _particleSlotBufferId;
+    unsigned int _particleIdCount;
+
+    // associated with the render program
+    // Note: A render program built with GetRenderShaderDefines(...) reads the particles out of 
+    // the shader storage buffers itself, and the VAO's particle attributes are turned off.
+    bool _isVertexPulling;
+    unsigned int _unifLocExtrapolationSec;
+    unsigned int _unifLocPointSize;
+    unsigned int _unifLocParticleBrightness;
+    unsigned int _unifLocParticleOpacity;
+    float _pointSize;
+    float _particleBrightness;
+    float _particleOpacity;
+
+    // which viewports a broadcasting render program draws in (see ParticleMultiViewport.h)
+    unsigned int _unifLocViewportMask;
+    unsigned int _viewportMask;
+
+    // a render program built with GetQuadRenderShaderDefines(...) draws each live particle as 
+    // an instance of a shared quad (see RenderQuads())
+    // Note: The particle index is an instanced attribute from the live index buffer.  The 
+    // styles are read out of the style buffer by the vertex shader instead, because the 
+    // instance is now the particle and not the draw group.  The location and the binding must
+    // match shaderParticle.vert.
+    static const unsigned int QUAD_PARTICLE_INDEX_ATTRIBUTE = 4;
+    static const unsigned int DRAW_GROUP_STYLE_BUFFER_BINDING = 12;
+    bool _isQuadRendering;
+    ParticleQuadShape _quadShape;
+    unsigned int _unifLocQuadCornerCount;
+    unsigned int _unifLocViewportSize;
+    int _viewportWidth;
+    int _viewportHeight;
+    GlBuffer _quadCommandBufferId;
+    std::vector<unsigned int> _quadCommandData;
+
+    // the speed palette is a small 1D texture that the vertex shader looks up with the speed 
+    // from the velocity attribute that it already has, so it adds nothing per particle (see 
+    // SetColorMode(...))
+    // Note: The unit must match "uSpeedPalette" in shaderParticle.vert.
+    static const unsigned int SPEED_PALETTE_TEXTURE_UNIT = 0;
+    unsigned int _unifLocColorMode;
+    unsigned int _unifLocPaletteMaxSpeed;
+    unsigned int _unifLocFastPointSizeScale;
+    unsigned int _unifLocSpeedPalette;
+    ParticleColorMode _colorMode;
+    GlTexture _speedPaletteTextureId;
+    unsigned int _speedPaletteSize;
+    float _paletteMaxSpeed;
+    float _fastPointSizeScale;
+
+    // resident handles for the textures above, which the shaders are handed as uniforms in 
+    // place of binding them to their units (see SetBindlessTextures(...)); 0 for a texture 
+    // that is bound the usual way
+    bool _isBindlessTextures;
+    unsigned long long _fieldTextureHandle;
+    unsigned long long _sdfBoundaryTextureHandle;
+    unsigned long long _speedPaletteTextureHandle;
+
+    // a render program built with GetFlipbookRenderShaderDefines(...) textures each particle 
+    // with a frame of a texture array, picked by its age (see SetFlipbook(...))
+    // Note: The unit must match "uFlipbook" in shaderParticleFlipbook.frag.  It comes after the
+    // fluid solver's (see StableFluidSolver.h).
+    static const unsigned int FLIPBOOK_TEXTURE_UNIT = 5;
+    bool _isFlipbookRendering;
+    unsigned int _unifLocFlipbookFrameCount;
+    unsigned int _unifLocFlipbookCycles;
+    unsigned int _unifLocFlipbookFrameSize;
+    unsigned int _unifLocFlipbookMaxLod;
+    unsigned int _unifLocFlipbook;
+    GlTexture _flipbookTextureId;
+    int _flipbookFrameWidth;
+    int _flipbookFrameHeight;
+    unsigned int _flipbookFrameCount;
+    unsigned int _flipbookLevelCount;
+    float _flipbookCycles;
+
+    // the state that Render(...) draws when it is double-buffered (see 
+    // SetDoubleBufferedRendering(...)): each update copies what the last one left into one of 
+    // two copies before it starts, and the draw reads that copy while the update works on the 
+    // originals
+    // Note: The index is -1 until an update has made a copy at the current pool size.  The lag
+    // is how far the update that followed the copy moved the simulation along.
+    bool _isDoubleBufferedRendering;
+    int _renderCopyIndex;
+    float _renderCopyLagSec;
+    unsigned int _renderCopyParticleCount;
+    GlBuffer _renderCopyParticleBufferIds[2][MAX_PARTICLE_BUFFERS];
+    GlBuffer _renderCopyLiveIndexBufferIds[2];
+    GlBuffer _renderCopyDrawCommandBufferIds[2];
+    GlVertexArray _renderCopyVaoIds[2];
 
+    // the camera (see SetView(...)), in a small uniform buffer that both the render program 
+    // and the update read
+    // Note: It is only uploaded when something in it changes (see UploadView()), which is not 
+    // every frame, so it isn't worth a ring like the simulation parameters.
+    GlBuffer _viewBufferId;
+    glm::mat4 _viewProjection;
+    bool _isViewCulled;
+    ViewParameters _uploadedView;
 
-    unsigned int _shaderBufferId;
+    // the level of detail (see SetLevelOfDetail(...)), which only changes between updates so 
+    // that the draw's brightness and point size always match the stride that its live indices 
+    // were picked with
+    // Note: The automatic modes go by results that are a few updates late, so after a change 
+    // they wait for the change to show up in them before they change it again.
+    ParticleLodSettings _lodSettings;
 
+    // the framebuffer that Render(...) draws into over the viewport (see SetRenderScale(...))
+    float _renderScale;
+    unsigned int _lodStride;
+    unsigned int _lodSettleUpdates;
+    float _lastRenderMs;
 
-    // these are associated with the compute shader
-    // Note: To be honest, the only one that needs to be kept around in this demo is the one for 
-    // delta time.  That needs to be updated potentially every frame (this demo hard codes it, 
-    // but eh?).  Nevertheless, if the user wants to expand and shrink the circle or move the 
-    // emitter or flucuate how many particles can be emitted per frame, then these uniforms 
-    // could be useful.
-    unsigned int _unifLocDeltaTimeSec;
-    unsigned int _unifLocRadiusSqr;
-    unsigned int _unifLocEmitterCenter;
-    unsigned int _unifLocMaxParticlesEmittedPerFrame;
-    unsigned int _unifLocMaxParticleCount;
+    // the particles that aren't drawn are only integrated on 1 in every this many update 
+    // dispatches, and the phase picks which runs of them are due (see 
+    // SetUpdateAmortization(...))
+    unsigned int _updateAmortization;
+    unsigned int _amortizationPhase;
+    unsigned int _unifLocUpdateAmortization;
+    unsigned int _unifLocAmortizationPhase;
 };
@@ -0,0 +1,524 @@
+#include "ParticleMultiViewport.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "glm/vec4.hpp"
+#include "GlStateCache.h"
+#include "ComputeDeviceCaps.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <math.h>       // floorf
+
+// the insets are this much of the window on each side, with this much of the window's smaller
+// side between them and around them
+static const float INSET_SIZE_FRACTION = 0.3f;
+static const float INSET_MARGIN_FRACTION = 0.02f;
+
+// a thin frame so that an inset doesn't blend into the particles around it
+static const float INSET_BORDER_PIXELS = 2.0f;
+static const float INSET_BORDER_COLOR[4] = { 0.5f, 0.5f, 0.5f, 1.0f };
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleMultiViewport::ParticleMultiViewport() :
+    _viewProjection(1.0f),
+    _isBroadcastSupported(false),
+    _maxViewports(1),
+    _maxViewportSize(4096.0f),
+    _wasScissorEnabled(false),
+    _isActive(false)
+{
+    for (int index = 0; index < 4; index++)
+    {
+        _viewport[index] = 0;
+        _scissorBox[index] = 0;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleMultiViewport::~ParticleMultiViewport()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Asks the context whether it can broadcast a vertex to several viewports, and how many
+    viewports and how big a viewport it has.  The insets can be added before or after this.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleMultiViewport::Init()
+{
+    this->Cleanup();
+    _isBroadcastSupported = IsGlExtensionSupported("GL_NV_viewport_array2");
+    glGetIntegerv(GL_MAX_VIEWPORTS, &_maxViewports);
+    GLint maxViewportDims[2] = { 4096, 4096 };
+    glGetIntegerv(GL_MAX_VIEWPORT_DIMS, maxViewportDims);
+    _maxViewportSize = (float)std::min(maxViewportDims[0], maxViewportDims[1]);
+    if (!_insets.empty())
+    {
+        LogPrintf("multi-viewport: %u insets, %s\n", (unsigned int)_insets.size(),
+            _isBroadcastSupported ? "broadcast in one draw with the window" :
+            "each drawn by itself (no GL_NV_viewport_array2)");
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Forgets what Init() learned about the context.  The insets are kept, since they are
+    settings and not GL objects.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleMultiViewport::Cleanup()
+{
+    _isBroadcastSupported = false;
+    _maxViewports = 1;
+    _isActive = false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Adds an inset below the ones already added.
+Parameters:
+    center  Where the inset looks, in the same space as the particles.
+    zoom    How much bigger than in the window the particles are spread out in the inset.
+            Less than 1 is raised to 1, since an inset that saw more than the window would
+            miss what the view culling left out.
+Returns:
+    False if there are already MAX_INSETS.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleMultiViewport::AddInset(const glm::vec2 &center, float zoom)
+{
+    if (_insets.size() >= MAX_INSETS)
+    {
+        return false;
+    }
+
+    Inset inset;
+    inset._center = center;
+    inset._zoom = (zoom > 1.0f) ? zoom : 1.0f;
+    _insets.push_back(inset);
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    Self-explanatory.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleMultiViewport::GetInsetCount() const
+{
+    return (unsigned int)_insets.size();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.  Only known after Init().
+Parameters: None
+Returns:
+    True if a render program built with GetRenderShaderDefines() can be made.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleMultiViewport::IsBroadcastSupported() const
+{
+    return _isBroadcastSupported;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The vertex shader defines that make a point render program write the viewport mask that
+    BeginBroadcast(...) returns (see PARTICLE_VIEWPORT_MASK in shaderParticle.vert, and
+    ParticleManager::SetViewportMask(...)).  They go in front of any others.
+Parameters: None
+Returns:
+    A string of "#define" statements for AcquireRenderProgram(...).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+std::string ParticleMultiViewport::GetRenderShaderDefines()
+{
+    return "#define PARTICLE_VIEWPORT_MASK\n";
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes the camera's transform, which is what the insets' centers are found with.  Call it
+    whenever the camera changes, along with ParticleManager::SetView(...).
+Parameters:
+    viewProjection  Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleMultiViewport::SetView(const glm::mat4 &viewProjection)
+{
+    _viewProjection = viewProjection;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Clears the insets and sets up one viewport and scissor per view: the rectangles of the
+    window that no inset covers, and then the insets.  The draw that follows, with a program
+    that broadcasts, lands in all of them at once.  EndBroadcast() puts the viewport and the
+    scissor back.
+
+    Does nothing if there are no insets, if the program doesn't broadcast, or if there are
+    more views than the context has viewports (or than the mask has bits).  Then the draw
+    only goes to the window, as usual, and the insets must be drawn one by one (see
+    BeginInset(...)).
+Parameters:
+    isBroadcastProgram  True if the render program was built with GetRenderShaderDefines().
+Returns:
+    The viewport mask for the render program (see ParticleManager::SetViewportMask(...)),
+    which is 1, only the window, if the insets weren't set up.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleMultiViewport::BeginBroadcast(bool isBroadcastProgram)
+{
+    if (!isBroadcastProgram || !_isBroadcastSupported || _insets.empty() || _isActive)
+    {
+        return 1;
+    }
+
+    this->SaveViewportState();
+    std::vector<PixelRect> windowRects;
+    this->FindUncoveredRects(&windowRects);
+    unsigned int viewCount = (unsigned int)(windowRects.size() + _insets.size());
+    if (_viewport[2] <= 0 || _viewport[3] <= 0 || viewCount > (unsigned int)_maxViewports ||
+        viewCount > 32)
+    {
+        return 1;
+    }
+
+    // the clears go by the first scissor only, so they go before the scissors are split up
+    EnableGlCapability(GL_SCISSOR_TEST);
+    for (unsigned int insetIndex = 0; insetIndex < _insets.size(); insetIndex++)
+    {
+        this->ClearInset(this->GetInsetRect(insetIndex));
+    }
+
+    for (unsigned int rectIndex = 0; rectIndex < windowRects.size(); rectIndex++)
+    {
+        const PixelRect &rect = windowRects[rectIndex];
+        glViewportIndexedf(rectIndex, (float)_viewport[0], (float)_viewport[1],
+            (float)_viewport[2], (float)_viewport[3]);
+        glScissorIndexed(rectIndex, (GLint)rect._x, (GLint)rect._y, (GLsizei)rect._width,
+            (GLsizei)rect._height);
+    }
+    for (unsigned int insetIndex = 0; insetIndex < _insets.size(); insetIndex++)
+    {
+        GLuint viewportIndex = (GLuint)(windowRects.size() + insetIndex);
+        PixelRect viewport = this->GetInsetViewport(insetIndex);
+        PixelRect scissor = this->GetInsetRect(insetIndex);
+        glViewportIndexedf(viewportIndex, viewport._x, viewport._y, viewport._width,
+            viewport._height);
+        glScissorIndexed(viewportIndex, (GLint)scissor._x, (GLint)scissor._y,
+            (GLsizei)scissor._width, (GLsizei)scissor._height);
+    }
+    _isActive = true;
+    return (viewCount == 32) ? 0xFFFFFFFFu : ((1u << viewCount) - 1u);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Puts back the viewport and the scissor that BeginBroadcast(...) found.  Does nothing if
+    it didn't set anything up.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleMultiViewport::EndBroadcast()
+{
+    if (!_isActive)
+    {
+        return;
+    }
+    this->RestoreViewportState();
+    _isActive = false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Clears one inset and points the viewport and the scissor at it, for a draw of its own.
+    This is the fallback for a context or a program that doesn't broadcast, and it costs a
+    draw, with a fetch of every particle, per inset.  EndInset() puts the viewport and the
+    scissor back.
+Parameters:
+    insetIndex  Self-explanatory.
+Returns:
+    False if there is no such inset, in which case nothing was changed.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleMultiViewport::BeginInset(unsigned int insetIndex)
+{
+    if (insetIndex >= _insets.size() || _isActive)
+    {
+        return false;
+    }
+
+    this->SaveViewportState();
+    if (_viewport[2] <= 0 || _viewport[3] <= 0)
+    {
+        return false;
+    }
+
+    EnableGlCapability(GL_SCISSOR_TEST);
+    PixelRect scissor = this->GetInsetRect(insetIndex);
+    this->ClearInset(scissor);
+    glScissor((GLint)scissor._x, (GLint)scissor._y, (GLsizei)scissor._width,
+        (GLsizei)scissor._height);
+    PixelRect viewport = this->GetInsetViewport(insetIndex);
+    glViewportIndexedf(0, viewport._x, viewport._y, viewport._width, viewport._height);
+    _isActive = true;
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Puts back the viewport and the scissor that BeginInset(...) found.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleMultiViewport::EndInset()
+{
+    this->EndBroadcast();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleMultiViewport::SaveViewportState()
+{
+    glGetIntegerv(GL_VIEWPORT, _viewport);
+    glGetIntegerv(GL_SCISSOR_BOX, _scissorBox);
+    _wasScissorEnabled = IsGlCapabilityEnabled(GL_SCISSOR_TEST);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Puts back what SaveViewportState() found.  glViewport(...) and glScissor(...) set every
+    viewport and scissor, so the extra ones are put back too.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleMultiViewport::RestoreViewportState()
+{
+    glViewport(_viewport[0], _viewport[1], _viewport[2], _viewport[3]);
+    glScissor(_scissorBox[0], _scissorBox[1], _scissorBox[2], _scissorBox[3]);
+    if (!_wasScissorEnabled)
+    {
+        DisableGlCapability(GL_SCISSOR_TEST);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Where the inset goes in the window's viewport: in the top right corner, and each one
+    after the first below the one before.
+Parameters:
+    insetIndex  Self-explanatory.
+Returns:
+    The inset's pixels.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleMultiViewport::PixelRect ParticleMultiViewport::GetInsetRect(
+    unsigned int insetIndex) const
+{
+    float windowWidth = (float)_viewport[2];
+    float windowHeight = (float)_viewport[3];
+    float margin = floorf(std::min(windowWidth, windowHeight) * INSET_MARGIN_FRACTION);
+    PixelRect rect;
+    rect._width = floorf(windowWidth * INSET_SIZE_FRACTION);
+    rect._height = floorf(windowHeight * INSET_SIZE_FRACTION);
+    rect._x = (float)_viewport[0] + windowWidth - margin - rect._width;
+    rect._y = (float)_viewport[1] + windowHeight -
+        ((float)(insetIndex + 1) * (margin + rect._height));
+    return rect;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The inset's viewport: the window's, times the zoom, moved so that the inset's center
+    lands in the middle of the inset.  Everything past the inset is scissored away.
+
+    The zoom is lowered if the viewport would be bigger than the context allows.
+Parameters:
+    insetIndex  Self-explanatory.
+Returns:
+    The viewport, which is much bigger than the inset.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleMultiViewport::PixelRect ParticleMultiViewport::GetInsetViewport(
+    unsigned int insetIndex) const
+{
+    const Inset &inset = _insets[insetIndex];
+    float windowWidth = (float)_viewport[2];
+    float windowHeight = (float)_viewport[3];
+    float zoom = std::min(inset._zoom, _maxViewportSize / std::max(windowWidth, windowHeight));
+
+    // where the center is in the window's clip space
+    glm::vec4 clipCenter = _viewProjection * glm::vec4(inset._center, 0.0f, 1.0f);
+    glm::vec2 ndcCenter = glm::vec2(clipCenter.x, clipCenter.y) / clipCenter.w;
+
+    PixelRect rect = this->GetInsetRect(insetIndex);
+    PixelRect viewport;
+    viewport._width = windowWidth * zoom;
+    viewport._height = windowHeight * zoom;
+    viewport._x = rect._x + (rect._width * 0.5f) - ((ndcCenter.x + 1.0f) * 0.5f * viewport._width);
+    viewport._y = rect._y + (rect._height * 0.5f) -
+        ((ndcCenter.y + 1.0f) * 0.5f * viewport._height);
+    return viewport;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Clears the inset to the clear color, with a frame around it, so that nothing that was
+    drawn under it shows through.
+
+    Note: The scissor test must be enabled.  This moves the scissor.
+Parameters:
+    insetRect   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleMultiViewport::ClearInset(const PixelRect &insetRect)
+{
+    glScissor((GLint)(insetRect._x - INSET_BORDER_PIXELS),
+        (GLint)(insetRect._y - INSET_BORDER_PIXELS),
+        (GLsizei)(insetRect._width + (2.0f * INSET_BORDER_PIXELS)),
+        (GLsizei)(insetRect._height + (2.0f * INSET_BORDER_PIXELS)));
+    glClearBufferfv(GL_COLOR, 0, INSET_BORDER_COLOR);
+
+    GLfloat clearColor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+    glScissor((GLint)insetRect._x, (GLint)insetRect._y, (GLsizei)insetRect._width,
+        (GLsizei)insetRect._height);
+    glClearBufferfv(GL_COLOR, 0, clearColor);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Splits the part of the window's viewport that the insets (and their frames) don't cover
+    into rectangles.  The insets' edges cut the window into a grid, and each column's
+    uncovered cells are joined into runs, so that the insets down the right side leave one
+    rectangle for the left of the window and one per gap on the right.
+Parameters:
+    putRectsHere    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleMultiViewport::FindUncoveredRects(std::vector<PixelRect> *putRectsHere) const
+{
+    putRectsHere->clear();
+    float left = (float)_viewport[0];
+    float bottom = (float)_viewport[1];
+    float right = left + (float)_viewport[2];
+    float top = bottom + (float)_viewport[3];
+
+    std::vector<PixelRect> covered;
+    std::vector<float> xs;
+    std::vector<float> ys;
+    xs.push_back(left);
+    xs.push_back(right);
+    ys.push_back(bottom);
+    ys.push_back(top);
+    for (unsigned int insetIndex = 0; insetIndex < _insets.size(); insetIndex++)
+    {
+        PixelRect rect = this->GetInsetRect(insetIndex);
+        rect._x = std::max(rect._x - INSET_BORDER_PIXELS, left);
+        rect._y = std::max(rect._y - INSET_BORDER_PIXELS, bottom);
+        rect._width = std::min(rect._x + rect._width + (2.0f * INSET_BORDER_PIXELS), right) -
+            rect._x;
+        rect._height = std::min(rect._y + rect._height + (2.0f * INSET_BORDER_PIXELS), top) -
+            rect._y;
+        covered.push_back(rect);
+        xs.push_back(rect._x);
+        xs.push_back(rect._x + rect._width);
+        ys.push_back(rect._y);
+        ys.push_back(rect._y + rect._height);
+    }
+    std::sort(xs.begin(), xs.end());
+    xs.erase(std::unique(xs.begin(), xs.end()), xs.end());
+    std::sort(ys.begin(), ys.end());
+    ys.erase(std::unique(ys.begin(), ys.end()), ys.end());
+
+    for (size_t column = 0; column + 1 < xs.size(); column++)
+    {
+        float cellCenterX = (xs[column] + xs[column + 1]) * 0.5f;
+        size_t runStart = ys.size();
+        for (size_t row = 0; row + 1 < ys.size(); row++)
+        {
+            float cellCenterY = (ys[row] + ys[row + 1]) * 0.5f;
+            bool isCovered = false;
+            for (size_t coveredIndex = 0; coveredIndex < covered.size(); coveredIndex++)
+            {
+                const PixelRect &rect = covered[coveredIndex];
+                if (cellCenterX > rect._x && cellCenterX < rect._x + rect._width &&
+                    cellCenterY > rect._y && cellCenterY < rect._y + rect._height)
+                {
+                    isCovered = true;
+                    break;
+                }
+            }
+
+            if (!isCovered && runStart == ys.size())
+            {
+                runStart = row;
+            }
+            bool isLastRow = (row + 2 == ys.size());
+            if (runStart != ys.size() && (isCovered || isLastRow))
+            {
+                size_t runEnd = isCovered ? row : (row + 1);
+                PixelRect rect;
+                rect._x = xs[column];
+                rect._y = ys[runStart];
+                rect._width = xs[column + 1] - xs[column];
+                rect._height = ys[runEnd] - ys[runStart];
+                putRectsHere->push_back(rect);
+                runStart = ys.size();
+            }
+        }
+    }
+}
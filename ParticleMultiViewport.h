@@ -0,0 +1,93 @@
+#pragma once
+
+#include "glm/vec2.hpp"
+#include "glm/mat4x4.hpp"
+
+#include <string>
+#include <vector>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Zoomed insets of the same particles, stacked down the right side of the window, each one
+    looking at a point of the simulation with more magnification than the window.  Drawing
+    each inset as its own Render() fetches every particle again for every inset.  With this,
+    a GPU that can broadcast a vertex to several viewports (GL_NV_viewport_array2) draws the
+    window and all of the insets with one draw: the render program (see
+    GetRenderShaderDefines()) writes a viewport mask for every particle instead of one
+    viewport index, and each particle is fetched and transformed once, however many views it
+    lands in.
+
+    Each view's transform is the camera's (see SetView(...)) followed by its own viewport
+    transform, so no view needs a matrix of its own.  An inset's viewport is the window's
+    times its zoom, placed so that its center lands in the middle of the inset, and its
+    scissor is the inset, which cuts the rest of the oversized viewport away.  The window
+    itself is a few viewports that all have the window's transform, one per rectangle of the
+    window that no inset covers, so that the window's particles don't land on top of the
+    insets.  A point that crosses from one of those rectangles to the next is drawn in both,
+    and each scissor keeps its own part.
+
+    Without the extension (or with a render program that doesn't broadcast), the window is
+    drawn as usual and then each inset is drawn by itself on top (see BeginInset(...)).
+
+    Note: Points keep their size in pixels, so an inset shows the particles spread apart
+    instead of bigger.  Quads are sized by the window's viewport, so they grow with the
+    zoom.  The compute shader's view culling only knows about the window, so the insets
+    must look inside it, which they do as long as their centers are in view.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class ParticleMultiViewport
+{
+public:
+    ParticleMultiViewport();
+    ~ParticleMultiViewport();
+    void Init();
+    void Cleanup();
+
+    static const unsigned int MAX_INSETS = 3;
+    bool AddInset(const glm::vec2 &center, float zoom);
+    unsigned int GetInsetCount() const;
+    bool IsBroadcastSupported() const;
+    static std::string GetRenderShaderDefines();
+
+    void SetView(const glm::mat4 &viewProjection);
+    unsigned int BeginBroadcast(bool isBroadcastProgram);
+    void EndBroadcast();
+    bool BeginInset(unsigned int insetIndex);
+    void EndInset();
+
+private:
+    // in the framebuffer's pixels, from the bottom left, like glViewport(...)
+    struct PixelRect
+    {
+        float _x;
+        float _y;
+        float _width;
+        float _height;
+    };
+
+    struct Inset
+    {
+        glm::vec2 _center;
+        float _zoom;
+    };
+
+    void SaveViewportState();
+    void RestoreViewportState();
+    PixelRect GetInsetRect(unsigned int insetIndex) const;
+    PixelRect GetInsetViewport(unsigned int insetIndex) const;
+    void ClearInset(const PixelRect &insetRect);
+    void FindUncoveredRects(std::vector<PixelRect> *putRectsHere) const;
+
+    std::vector<Inset> _insets;
+    glm::mat4 _viewProjection;
+    bool _isBroadcastSupported;
+    int _maxViewports;
+    float _maxViewportSize;
+
+    // the window's viewport, which is what the insets are placed in and zoomed from, and the
+    // scissor state, which the draws change and the ends put back
+    int _viewport[4];
+    int _scissorBox[4];
+    bool _wasScissorEnabled;
+    bool _isActive;
+};
@@ -0,0 +1,1225 @@
+#include "ParticleNeighborGrid.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
+#include "ShaderProgramRegistry.h"
+#include "GpuMemoryLedger.h"
+#include "ComputeDeviceCaps.h"
+#include "Log.h"
+
+#include <math.h>
+
+// must match the GRID_STAGE_* defines in shaderParticle.comp
+enum GridStage
+{
+    GRID_STAGE_COUNT = 0,
+    GRID_STAGE_SCATTER,
+    GRID_STAGE_INTERACT,
+    GRID_STAGE_SPH_GATHER,
+    GRID_STAGE_SPH_DENSITY,
+    GRID_STAGE_SPH_FORCE,
+    GRID_STAGE_BOIDS,
+    GRID_STAGE_DEM_GATHER,
+    GRID_STAGE_DEM_RELAX,
+    GRID_STAGE_DEM_WRITE,
+    GRID_STAGE_QUERY,
+    GRID_STAGE_MERGE,
+    GRID_STAGE_SPLIT,
+};
+
+// the most nearest neighbors that a boid can steer by; must match BOIDS_MAX_NEAREST in
+// shaderParticle.comp
+static const unsigned int BOIDS_MAX_NEAREST = 16;
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.  The grid covers the window ([-1,+1] on both axes) with
+    cells that are 1/100th of it across.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleNeighborGrid::ParticleNeighborGrid() :
+    _gridProgramId(0),
+    _gridWorkGroupSizeX(ParticleManager::DEFAULT_WORK_GROUP_SIZE),
+    _unifLocGridStage(0),
+    _unifLocGridParticleCount(0),
+    _unifLocGridOrigin(0),
+    _unifLocGridCellSize(0),
+    _unifLocGridCellCounts(0),
+    _unifLocInteractionDeltaSec(0),
+    _unifLocRepulsionStrength(0),
+    _unifLocCohesionStrength(0),
+    _unifLocMaxNeighbors(0),
+    _unifLocWakeSpeedSqr(0),
+    _unifLocSphRestDensity(0),
+    _unifLocSphStiffness(0),
+    _unifLocSphViscosity(0),
+    _unifLocBoidsSeparation(0),
+    _unifLocBoidsAlignment(0),
+    _unifLocBoidsCohesion(0),
+    _unifLocBoidsNearestCount(0),
+    _unifLocBoidsMaxSpeed(0),
+    _unifLocDemContactDistance(0),
+    _unifLocDemRelaxation(0),
+    _unifLocDemRestitution(0),
+    _unifLocQueryCount(0),
+    _unifLocMergeDensity(0),
+    _unifLocSplitDensity(0),
+    _unifLocMaxMergeWeight(0),
+    _unifLocMergeEmitterCount(0),
+    _minCorner(-1.0f, -1.0f),
+    _maxCorner(+1.0f, +1.0f),
+    _requestedCellSize(0.02f),
+    _cellSize(0.02f),
+    _cellCountX(0),
+    _cellCountY(0),
+    _isGridBuilt(false),
+    _repulsionStrength(0.5f),
+    _cohesionStrength(0.1f),
+    _maxNeighbors(32),
+    _wakeSpeed(0.0f),
+    _interactionModel(PARTICLE_INTERACTION_PAIRWISE),
+    _sphRestDensity(4.0f),
+    _sphStiffness(0.02f),
+    _sphViscosity(0.1f),
+    _boidsSeparation(0.5f),
+    _boidsAlignment(2.0f),
+    _boidsCohesion(1.0f),
+    _boidsNearestCount(7),
+    _boidsMaxSpeed(0.5f),
+    _demParticleRadius(0.004f),
+    _demRelaxation(1.5f),
+    _demIterationCount(4),
+    _demRestitution(0.5f),
+    _isDeterministic(false),
+    _demProfiler(0),
+    _demScopeId(0),
+    _cellCountBufferId(0),
+    _cellStartBufferId(0),
+    _particleCellBufferId(0),
+    _cellParticleBufferId(0),
+    _particleCapacity(0),
+    _sortedParticleBufferId(0),
+    _sphDensityBufferId(0),
+    _sphCapacity(0),
+    _demCapacity(0),
+    _mergeDensity(0),
+    _splitDensity(0),
+    _maxMergeWeight(0),
+    _isMergeCountStale(false),
+    _mergeCountBufferId(0),
+    _mergeCapacity(0)
+{
+    _demPositionBufferIds[0] = 0;
+    _demPositionBufferIds[1] = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleNeighborGrid::~ParticleNeighborGrid()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes a reference to both programs (see ShaderProgramRegistry.h) and creates the cell
+    buffers.  The particle buffers are created by the first Build(...), which knows the pool
+    size.  The caller may release their own references after this returns.
+Parameters:
+    gridProgramId   shaderParticle.comp generated with GetGridShaderDefines(...).  Must be
+                    built for the same particle layout as the particle manager's program.
+    scanProgramId   shaderScan.comp generated with GpuScan::GetScanShaderDefines(...).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleNeighborGrid::Init(unsigned int gridProgramId, unsigned int scanProgramId)
+{
+    this->Cleanup();
+    if (gridProgramId == 0 || scanProgramId == 0)
+    {
+        LogPrintf("the neighbor grid needs both its grid program and its scan program\n");
+        return;
+    }
+
+    // the device only has to have 8 binding points, and these come after ParticleManager's
+    GLint maxBindings = 0;
+    glGetIntegerv(GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS, &maxBindings);
+    if (maxBindings <= (GLint)GRID_CELL_PARTICLE_BUFFER_BINDING)
+    {
+        LogPrintf("the neighbor grid needs %u shader storage bindings, but there are only %d\n",
+            GRID_CELL_PARTICLE_BUFFER_BINDING + 1, maxBindings);
+        return;
+    }
+
+    _gridProgramId = gridProgramId;
+    AddProgramReference(_gridProgramId);
+    this->LoadProgramInterface();
+    this->InitCellBuffers();
+    _cellScan.Init(scanProgramId);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Releases the programs and deletes the grid buffers.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleNeighborGrid::Cleanup()
+{
+    if (_gridProgramId != 0)
+    {
+        ReleaseProgram(_gridProgramId);
+        _gridProgramId = 0;
+    }
+
+    _cellScan.Cleanup();
+
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _cellCountBufferId);
+    DeleteGlBuffers(1, &_cellCountBufferId);
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _cellStartBufferId);
+    DeleteGlBuffers(1, &_cellStartBufferId);
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _particleCellBufferId);
+    DeleteGlBuffers(1, &_particleCellBufferId);
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _cellParticleBufferId);
+    DeleteGlBuffers(1, &_cellParticleBufferId);
+    _cellCountBufferId = 0;
+    _cellStartBufferId = 0;
+    _particleCellBufferId = 0;
+    _cellParticleBufferId = 0;
+    _particleCapacity = 0;
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _sortedParticleBufferId);
+    DeleteGlBuffers(1, &_sortedParticleBufferId);
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _sphDensityBufferId);
+    DeleteGlBuffers(1, &_sphDensityBufferId);
+    _sortedParticleBufferId = 0;
+    _sphDensityBufferId = 0;
+    _sphCapacity = 0;
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _demPositionBufferIds[0]);
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _demPositionBufferIds[1]);
+    DeleteGlBuffers(2, _demPositionBufferIds);
+    _demPositionBufferIds[0] = 0;
+    _demPositionBufferIds[1] = 0;
+    _demCapacity = 0;
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _mergeCountBufferId);
+    DeleteGlBuffers(1, &_mergeCountBufferId);
+    _mergeCountBufferId = 0;
+    _mergeCapacity = 0;
+    _cellCountX = 0;
+    _cellCountY = 0;
+    _isGridBuilt = false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Switches to a rebuilt program (see ParticleManager::ReplaceProgram(...)).
+Parameters:
+    oldProgramId    Self-explanatory.  Programs that this grid doesn't use are ignored.
+    newProgramId    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleNeighborGrid::ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId)
+{
+    _cellScan.ReplaceProgram(oldProgramId, newProgramId);
+    if (oldProgramId == 0 || newProgramId == 0 || _gridProgramId != oldProgramId)
+    {
+        return;
+    }
+
+    AddProgramReference(newProgramId);
+    ReleaseProgram(_gridProgramId);
+    _gridProgramId = newProgramId;
+    this->LoadProgramInterface();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets the size of the grid's cells, which is also how far the interactions reach.  Can be
+    changed at any time; the cell buffers are made again to fit.
+
+    If the bounds would need more than MAX_GRID_CELLS cells of this size, the cells are made
+    larger until they fit, and that is printed.  GetCellSize() says what was actually used.
+Parameters:
+    cellSize    In window units ([-1,+1] across).  Must be greater than 0.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleNeighborGrid::SetCellSize(float cellSize)
+{
+    if (cellSize <= 0.0f)
+    {
+        LogPrintf("neighbor grid cell size must be greater than 0, not %f\n", cellSize);
+        return;
+    }
+
+    _requestedCellSize = cellSize;
+    if (_gridProgramId != 0)
+    {
+        this->InitCellBuffers();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets the region that the grid covers.  Particles outside of it are put into the edge
+    cells, so they still interact, just less efficiently.  Can be changed at any time.
+Parameters:
+    minCorner   Self-explanatory.
+    maxCorner   Self-explanatory.  Must be greater than minCorner on both axes.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleNeighborGrid::SetBounds(const glm::vec2 &minCorner, const glm::vec2 &maxCorner)
+{
+    if (maxCorner.x <= minCorner.x || maxCorner.y <= minCorner.y)
+    {
+        LogPrintf("neighbor grid bounds are empty: (%f, %f) to (%f, %f)\n",
+            minCorner.x, minCorner.y, maxCorner.x, maxCorner.y);
+        return;
+    }
+
+    _minCorner = minCorner;
+    _maxCorner = maxCorner;
+    if (_gridProgramId != 0)
+    {
+        this->InitCellBuffers();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets the forces for ApplyInteractions(...).  See InteractWithNeighbors() in
+    shaderParticle.comp for how they shape the force.  Can be changed at any time.
+Parameters:
+    repulsionStrength   The acceleration between 2 particles at the same spot.  0 turns
+                        repulsion off.
+    cohesionStrength    How strongly particles farther apart pull together.  0 turns
+                        cohesion off.
+    maxNeighbors        The most neighbors that a single particle interacts with.  Bounds the
+                        cost per particle where the cloud is dense.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleNeighborGrid::SetInteraction(float repulsionStrength, float cohesionStrength,
+    unsigned int maxNeighbors)
+{
+    _repulsionStrength = repulsionStrength;
+    _cohesionStrength = cohesionStrength;
+    _maxNeighbors = maxNeighbors;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets how hard ApplyInteractions(...) has to push a sleeping particle (see 
+    ParticleManager::SetSleep(...)) to wake it up.  A smaller push leaves it asleep and where 
+    it is.  Only a grid program built with wakesSleepingParticles (see 
+    GetGridShaderDefines(...)) knows about sleep.
+Parameters:
+    wakeSpeed   The change in speed that wakes a particle.  0 (the default) wakes nothing.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleNeighborGrid::SetWakeSpeed(float wakeSpeed)
+{
+    _wakeSpeed = (wakeSpeed > 0.0f) ? wakeSpeed : 0.0f;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Chooses what ApplyInteractions(...) does with the neighbors.  Can be changed at any time.
+
+    The SPH model needs a grid program built with hasSphFluid (see GetGridShaderDefines(...))
+    and 2 more shader storage bindings than the pairwise model.  It ignores the neighbor cap
+    (see SetInteraction(...)), since a density that leaves out some of the neighbors is wrong,
+    and the pressure keeps the particles from packing into a cell to begin with.
+
+    The DEM model needs bindings past the gravity tree's, but any grid program has its stages.
+Parameters:
+    model   Self-explanatory.
+Returns:
+    False if the device doesn't have enough bindings for the model, which leaves the model as
+    it was, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleNeighborGrid::SetInteractionModel(ParticleInteractionModel model)
+{
+    if (model == PARTICLE_INTERACTION_SPH)
+    {
+        GLint maxBindings = 0;
+        glGetIntegerv(GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS, &maxBindings);
+        if (maxBindings <= (GLint)SPH_DENSITY_BUFFER_BINDING)
+        {
+            LogPrintf("the SPH fluid needs %u shader storage bindings, but there are only %d\n",
+                SPH_DENSITY_BUFFER_BINDING + 1, maxBindings);
+            return false;
+        }
+    }
+    else if (model == PARTICLE_INTERACTION_DEM)
+    {
+        GLint maxBindings = 0;
+        glGetIntegerv(GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS, &maxBindings);
+        if (maxBindings <= (GLint)DEM_DESTINATION_BUFFER_BINDING)
+        {
+            LogPrintf("the DEM collisions need %u shader storage bindings, but there are only "
+                "%d\n", DEM_DESTINATION_BUFFER_BINDING + 1, maxBindings);
+            return false;
+        }
+    }
+
+    _interactionModel = model;
+    if (_gridProgramId != 0)
+    {
+        this->LoadProgramInterface();
+    }
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets the fluid for the SPH model.  See RunSphStage() in shaderParticle.comp for how they
+    shape the forces.  Can be changed at any time.
+Parameters:
+    restDensity     The density that the fluid settles at, as a weighted count of the
+                    neighbors within a cell size (a particle alone is 1).  More packs the
+                    fluid tighter.
+    stiffness       How hard the pressure pushes back against a density above the rest
+                    density.  Too stiff for the time step and the fluid boils.
+    viscosity       How strongly neighbors pull each other's velocities together.  0 is
+                    inviscid.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleNeighborGrid::SetSphFluid(float restDensity, float stiffness, float viscosity)
+{
+    _sphRestDensity = restDensity;
+    _sphStiffness = (stiffness > 0.0f) ? stiffness : 0.0f;
+    _sphViscosity = (viscosity > 0.0f) ? viscosity : 0.0f;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets the steering for the boids model.  See SteerBoids() in shaderParticle.comp for how
+    they shape the forces.  Can be changed at any time.
+
+    Each boid steers by only its nearest few neighbors (7 is about what a starling in a real
+    flock keeps track of), and it only looks at a few candidates for each of them, so a boid
+    in a packed cell costs no more than any other.
+Parameters:
+    separationStrength  How hard a boid turns away from neighbors that are too close.
+    alignmentStrength   How quickly a boid matches its neighbors' average velocity.
+    cohesionStrength    How hard a boid pulls toward its neighbors' center.
+    nearestCount        How many of the nearest neighbors to steer by.  At most
+                        BOIDS_MAX_NEAREST; 0 turns the steering off.
+    maxSpeed            The fastest that steering leaves a boid going.  0 doesn't cap it.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleNeighborGrid::SetBoidsSteering(float separationStrength, float alignmentStrength,
+    float cohesionStrength, unsigned int nearestCount, float maxSpeed)
+{
+    if (nearestCount > BOIDS_MAX_NEAREST)
+    {
+        LogPrintf("boids can steer by at most %u neighbors, not %u\n", BOIDS_MAX_NEAREST,
+            nearestCount);
+        nearestCount = BOIDS_MAX_NEAREST;
+    }
+
+    _boidsSeparation = separationStrength;
+    _boidsAlignment = alignmentStrength;
+    _boidsCohesion = cohesionStrength;
+    _boidsNearestCount = nearestCount;
+    _boidsMaxSpeed = (maxSpeed > 0.0f) ? maxSpeed : 0.0f;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets the contacts for the DEM model.  See RelaxDemContacts() in shaderParticle.comp for
+    how they shape the corrections.  Can be changed at any time.
+
+    Two particles are in contact when they are closer than 2 radii, which can't be more than
+    the cell size, since the neighbors beyond that aren't in the 3x3 cells.
+Parameters:
+    particleRadius  Self-explanatory.  In window units.
+    relaxation      Scales each iteration's averaged correction.  1 moves each particle by
+                    the average of its contacts' pushes; up to 2 converges faster, and more
+                    than that overshoots.
+    iterationCount  How many Jacobi iterations per ApplyInteractions(...).  More leaves less
+                    overlap in a packed pile.  0 turns the collisions off.
+    restitution     How much of the speed that the correction takes away is given back as a
+                    bounce.  0 is a dead stop and 1 is elastic.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleNeighborGrid::SetDemContact(float particleRadius, float relaxation,
+    unsigned int iterationCount, float restitution)
+{
+    _demParticleRadius = (particleRadius > 0.0f) ? particleRadius : 0.0f;
+    _demRelaxation = (relaxation > 0.0f) ? relaxation : 0.0f;
+    _demIterationCount = iterationCount;
+    _demRestitution = (restitution < 0.0f) ? 0.0f : ((restitution > 1.0f) ? 1.0f : restitution);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives the DEM model a profiler to time its iterations with.  The grid begins and ends the
+    scope around the iterations (not the gather or the write) in each ApplyInteractions(...)
+    and keeps the scope's iteration count up to date (see
+    GpuProfiler::SetScopeIterationCount(...)), so the printed stats include the time per
+    iteration.  The caller does everything else with the profiler as usual.
+Parameters:
+    profiler            The caller's, which must outlive this object or be replaced.  0 stops
+                        the timing.
+    iterationScopeId    A scope that nothing else begins or ends (see
+                        GpuProfiler::AddScope(...)).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleNeighborGrid::SetDemProfiler(GpuProfiler *profiler, unsigned int iterationScopeId)
+{
+    _demProfiler = profiler;
+    _demScopeId = iterationScopeId;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Makes the DEM model give the same result on every run (see
+    ParticleManager::SetDeterministic(...)).  The order of the particles within a cell depends
+    on the order that the GPU ran the count's atomics, so a deterministic grid doesn't cap the
+    neighbors (see SetInteraction(...)), since which ones are left out would change from run
+    to run.  The corrections are always summed in fixed point, so their order doesn't matter.
+Parameters:
+    deterministic   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleNeighborGrid::SetDeterministic(bool deterministic)
+{
+    _isDeterministic = deterministic;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Turns on merging of the particles in crowded cells (see MergeDenseCells(...)), or turns it
+    off with a merge density of 0.  Can be changed at any time.
+
+    The split density is kept at or below the merge density divided by the max weight, so
+    that a cell that has just been split isn't crowded enough to be merged again right away.
+
+    Note: Every particle that was merged stands for others until it is split or dies, so
+    turning merging off leaves them as they are, and turning it back on starts everyone over
+    as single particles.  The weights also stay with the slots of the pool, so anything that
+    moves particles between slots (ex: ParticleManager::SetParticleSort(...)) mixes them up.
+Parameters:
+    mergeDensity    A cell with more particles than this is merged.
+    splitDensity    A representative in a cell with fewer particles than this is split.
+    maxMergeWeight  The most particles that one representative stands for, including itself.
+                    At least 2.
+Returns:
+    False if the device doesn't have enough shader storage bindings for the weights, which
+    leaves merging off, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleNeighborGrid::SetMerging(unsigned int mergeDensity, unsigned int splitDensity,
+    unsigned int maxMergeWeight)
+{
+    GLint maxBindings = 0;
+    glGetIntegerv(GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS, &maxBindings);
+    if (mergeDensity > 0 && maxBindings <= (GLint)MERGE_COUNT_BUFFER_BINDING)
+    {
+        LogPrintf("merging needs %u shader storage bindings, but there are only %d\n",
+            MERGE_COUNT_BUFFER_BINDING + 1, maxBindings);
+        _mergeDensity = 0;
+        return false;
+    }
+
+    if (mergeDensity > 0 && _mergeDensity == 0)
+    {
+        _isMergeCountStale = true;
+    }
+    _mergeDensity = mergeDensity;
+    _maxMergeWeight = (maxMergeWeight < 2) ? 2 : maxMergeWeight;
+    unsigned int maxSplitDensity = mergeDensity / _maxMergeWeight;
+    _splitDensity = (splitDensity > maxSplitDensity) ? maxSplitDensity : splitDensity;
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The cell size that the grid is actually using (see SetCellSize(...)).
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+float ParticleNeighborGrid::GetCellSize() const
+{
+    return _cellSize;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Bins every active particle into the grid.  Must be called after the particles have moved
+    this frame and before anything queries the grid.
+Parameters:
+    maxParticleCount    The size of the particle pool.  The dispatches are sized on the CPU,
+                        so they cover all of it, and the inactive particles are skipped on the
+                        GPU.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleNeighborGrid::Build(unsigned int maxParticleCount)
+{
+    _isGridBuilt = false;
+    if (_gridProgramId == 0 || _cellCountBufferId == 0 || maxParticleCount == 0)
+    {
+        return;
+    }
+    if (maxParticleCount > _particleCapacity)
+    {
+        this->InitParticleBuffers(maxParticleCount);
+    }
+
+    // the update wrote the particles with shader storage writes, and the last frame's grid
+    // atomics must be done before the counts are cleared
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    // the counts are added to, so they start at 0 every frame
+    GLuint zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _cellCountBufferId);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // bound every frame because other passes are free to use these binding points too
+    BindGlShaderStorageBuffer(GRID_CELL_COUNT_BUFFER_BINDING, _cellCountBufferId);
+    BindGlShaderStorageBuffer(GRID_CELL_START_BUFFER_BINDING, _cellStartBufferId);
+    BindGlShaderStorageBuffer(GRID_PARTICLE_CELL_BUFFER_BINDING, _particleCellBufferId);
+    BindGlShaderStorageBuffer(GRID_CELL_PARTICLE_BUFFER_BINDING, _cellParticleBufferId);
+
+    UseGlProgram(_gridProgramId);
+    glUniform1ui(_unifLocGridParticleCount, maxParticleCount);
+    glUniform2f(_unifLocGridOrigin, _minCorner.x, _minCorner.y);
+    glUniform1f(_unifLocGridCellSize, _cellSize);
+    glUniform2i(_unifLocGridCellCounts, _cellCountX, _cellCountY);
+
+    // both particle stages are one particle per work item, with the scan in between
+    // Note: The scan uses its own program, but uniforms are kept with the program, so the grid
+    // program only needs to be put back in use afterwards.
+    unsigned int numParticleWorkGroups =
+        (maxParticleCount + _gridWorkGroupSizeX - 1) / _gridWorkGroupSizeX;
+    this->DispatchGridStage(GRID_STAGE_COUNT, numParticleWorkGroups);
+    _cellScan.ExclusiveScan(_cellCountBufferId, _cellStartBufferId, _cellCountX * _cellCountY);
+    UseGlProgram(_gridProgramId);
+    this->DispatchGridStage(GRID_STAGE_SCATTER, numParticleWorkGroups);
+    UseGlProgram(0);
+
+    _isGridBuilt = true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Runs a batch of spatial queries over the grid from the last Build(...), which must have
+    been this frame, in one dispatch of one work group per query.  The caller binds the
+    queries and the results (see ParticleSpatialQuery.h).
+
+    Note: Run it before anything else moves the particles, so that the grid's cells still
+    match where they are.
+Parameters:
+    queryCount  Self-explanatory.
+Returns:
+    False if the grid hasn't been built, in which case nothing was dispatched.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleNeighborGrid::RunQueries(unsigned int queryCount)
+{
+    if (!_isGridBuilt || queryCount == 0)
+    {
+        return false;
+    }
+
+    // Build(...) left the grid's uniforms in the program
+    UseGlProgram(_gridProgramId);
+    glUniform1ui(_unifLocQueryCount, queryCount);
+    this->DispatchGridStage(GRID_STAGE_QUERY, queryCount);
+    UseGlProgram(0);
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Has every active particle push away from or pull toward its neighbors (see
+    SetInteraction(...)), feel the fluid's pressure and viscosity (see SetSphFluid(...)), or
+    steer with its flock (see SetBoidsSteering(...)), by changing its velocity, or has it
+    collide with the particles that it overlaps (see SetDemContact(...)), which changes its
+    position too.  Uses the grid from the last Build(...), which must have been this frame.
+Parameters:
+    deltaTimeSec        How much simulation time the change in velocity is for.  0 does
+                        nothing.
+    maxParticleCount    Same as for Build(...).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleNeighborGrid::ApplyInteractions(float deltaTimeSec, unsigned int maxParticleCount)
+{
+    if (!_isGridBuilt || deltaTimeSec <= 0.0f || maxParticleCount > _particleCapacity)
+    {
+        return;
+    }
+
+    if (_interactionModel == PARTICLE_INTERACTION_SPH)
+    {
+        this->ApplySphFluid(deltaTimeSec, maxParticleCount);
+        return;
+    }
+    if (_interactionModel == PARTICLE_INTERACTION_BOIDS)
+    {
+        this->ApplyBoidsSteering(deltaTimeSec, maxParticleCount);
+        return;
+    }
+    if (_interactionModel == PARTICLE_INTERACTION_DEM)
+    {
+        this->ApplyDemCollisions(deltaTimeSec, maxParticleCount);
+        return;
+    }
+
+    UseGlProgram(_gridProgramId);
+    glUniform1f(_unifLocInteractionDeltaSec, deltaTimeSec);
+    glUniform1f(_unifLocRepulsionStrength, _repulsionStrength);
+    glUniform1f(_unifLocCohesionStrength, _cohesionStrength);
+    glUniform1ui(_unifLocMaxNeighbors, _maxNeighbors);
+    glUniform1f(_unifLocWakeSpeedSqr, _wakeSpeed * _wakeSpeed);
+
+    // one work item per active particle, but only the GPU knows how many that is
+    this->DispatchGridStage(GRID_STAGE_INTERACT,
+        (maxParticleCount + _gridWorkGroupSizeX - 1) / _gridWorkGroupSizeX);
+    UseGlProgram(0);
+
+    // the new velocities are drawn this frame (through vertex attributes or pulled from the
+    // buffers) and may be read back
+    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT |
+        GL_BUFFER_UPDATE_BARRIER_BIT);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Merges runs of particles in the cells that are more crowded than the merge density into
+    representatives, and splits the representatives whose cells have thinned out, with the
+    grid from the last Build(...) (see SetMerging(...)).  Must be called after every Build(...)
+    while merging is on, since the split stage is also what puts the weight of a
+    representative that died back to 1 before its slot is emitted again.
+
+    The merge is one particle per work item in grid order, where only every few particles of
+    a crowded cell do anything, and the split is one particle per work item over the pool,
+    where only the representatives do anything, so most of the cost is one read per particle.
+
+    Note: Only the GPU backend, outside of the deterministic mode (the dead stacks aren't
+    used) and the fused emit and update (which keeps the dead stacks in the same dispatch),
+    can be merged.  Otherwise this does nothing.
+    Also Note: A representative is drawn as one particle.
+Parameters:
+    particleManager     The particle manager that was just updated.  Its buffers must still
+                        be bound, like for Build(...).  The split particles aren't on its
+                        update list, so the list is rebuilt.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleNeighborGrid::MergeDenseCells(ParticleManager &particleManager)
+{
+    unsigned int maxParticleCount = particleManager.GetMaxParticleCount();
+    if (!_isGridBuilt || _mergeDensity == 0 || (GLint)_unifLocMergeDensity == -1 ||
+        maxParticleCount > _particleCapacity ||
+        particleManager.GetSimulationBackend() != PARTICLE_SIMULATION_BACKEND_GPU ||
+        particleManager.IsDeterministic() || particleManager.IsFusedEmitUpdateActive())
+    {
+        return;
+    }
+    if (maxParticleCount > _mergeCapacity)
+    {
+        this->InitMergeBuffer(maxParticleCount);
+    }
+    if (_isMergeCountStale)
+    {
+        // everyone starts as a single particle
+        GLuint zero = 0;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, _mergeCountBufferId);
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT,
+            &zero);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        _isMergeCountStale = false;
+    }
+    BindGlShaderStorageBuffer(MERGE_COUNT_BUFFER_BINDING, _mergeCountBufferId);
+
+    UseGlProgram(_gridProgramId);
+    glUniform1ui(_unifLocMergeDensity, _mergeDensity);
+    glUniform1ui(_unifLocSplitDensity, _splitDensity);
+    glUniform1ui(_unifLocMaxMergeWeight, _maxMergeWeight);
+    glUniform1ui(_unifLocMergeEmitterCount, (unsigned int)particleManager.GetEmitters().size());
+    unsigned int numWorkGroups = (maxParticleCount + _gridWorkGroupSizeX - 1) / _gridWorkGroupSizeX;
+    this->DispatchGridStage(GRID_STAGE_MERGE, numWorkGroups);
+    this->DispatchGridStage(GRID_STAGE_SPLIT, numWorkGroups);
+    UseGlProgram(0);
+
+    // same as the interactions, and the dead stacks and the active mask are read by the next
+    // emit pass
+    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT |
+        GL_BUFFER_UPDATE_BARRIER_BIT);
+    particleManager.InvalidateUpdateList();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    layout                  Must be the particle manager's layout.
+    workGroupSize           Self-explanatory.
+    wakesSleepingParticles  True if the particle manager's program was built with sleep (see
+                            ParticleKernelVariant::_hasSleep), so the interactions read its 
+                            sleep mask (see SetWakeSpeed(...)).
+    hasSphFluid             True to build in the SPH stages (see SetInteractionModel(...)).
+                            They are left out otherwise, since their shared memory would cost
+                            the other stages occupancy.
+Returns:
+    The defines to give to AcquireComputeProgram(...) for the grid program.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+std::string ParticleNeighborGrid::GetGridShaderDefines(ParticleLayout layout,
+    unsigned int workGroupSize, bool wakesSleepingParticles, bool hasSphFluid)
+{
+    std::string defines = ParticleManager::GetComputeShaderDefines(layout, workGroupSize) +
+        "#define PARTICLE_GRID_PASS\n";
+    if (wakesSleepingParticles)
+    {
+        defines += "#define PARTICLE_SLEEP\n";
+    }
+    if (hasSphFluid)
+    {
+        defines += "#define PARTICLE_SPH\n";
+    }
+    return defines;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Looks up the grid program's uniforms and work group size.  Called by Init(...) and
+    whenever the program is replaced.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleNeighborGrid::LoadProgramInterface()
+{
+    _unifLocGridStage = glGetUniformLocation(_gridProgramId, "uGridStage");
+    _unifLocGridParticleCount = glGetUniformLocation(_gridProgramId, "uGridParticleCount");
+    _unifLocGridOrigin = glGetUniformLocation(_gridProgramId, "uGridOrigin");
+    _unifLocGridCellSize = glGetUniformLocation(_gridProgramId, "uGridCellSize");
+    _unifLocGridCellCounts = glGetUniformLocation(_gridProgramId, "uGridCellCounts");
+    _unifLocInteractionDeltaSec = glGetUniformLocation(_gridProgramId, "uInteractionDeltaSec");
+    _unifLocRepulsionStrength = glGetUniformLocation(_gridProgramId, "uRepulsionStrength");
+    _unifLocCohesionStrength = glGetUniformLocation(_gridProgramId, "uCohesionStrength");
+    _unifLocMaxNeighbors = glGetUniformLocation(_gridProgramId, "uMaxNeighbors");
+    _unifLocWakeSpeedSqr = glGetUniformLocation(_gridProgramId, "uWakeSpeedSqr");
+    _unifLocSphRestDensity = glGetUniformLocation(_gridProgramId, "uSphRestDensity");
+    _unifLocSphStiffness = glGetUniformLocation(_gridProgramId, "uSphStiffness");
+    _unifLocSphViscosity = glGetUniformLocation(_gridProgramId, "uSphViscosity");
+    _unifLocBoidsSeparation = glGetUniformLocation(_gridProgramId, "uBoidsSeparation");
+    _unifLocBoidsAlignment = glGetUniformLocation(_gridProgramId, "uBoidsAlignment");
+    _unifLocBoidsCohesion = glGetUniformLocation(_gridProgramId, "uBoidsCohesion");
+    _unifLocBoidsNearestCount = glGetUniformLocation(_gridProgramId, "uBoidsNearestCount");
+    _unifLocBoidsMaxSpeed = glGetUniformLocation(_gridProgramId, "uBoidsMaxSpeed");
+    _unifLocDemContactDistance = glGetUniformLocation(_gridProgramId, "uDemContactDistance");
+    _unifLocDemRelaxation = glGetUniformLocation(_gridProgramId, "uDemRelaxation");
+    _unifLocDemRestitution = glGetUniformLocation(_gridProgramId, "uDemRestitution");
+    _unifLocQueryCount = glGetUniformLocation(_gridProgramId, "uQueryCount");
+    _unifLocMergeDensity = glGetUniformLocation(_gridProgramId, "uMergeDensity");
+    _unifLocSplitDensity = glGetUniformLocation(_gridProgramId, "uSplitDensity");
+    _unifLocMaxMergeWeight = glGetUniformLocation(_gridProgramId, "uMaxMergeWeight");
+    _unifLocMergeEmitterCount = glGetUniformLocation(_gridProgramId, "uMergeEmitterCount");
+    if (_interactionModel == PARTICLE_INTERACTION_SPH && (GLint)_unifLocSphStiffness == -1)
+    {
+        LogPrintf("the neighbor grid's program doesn't have the SPH stages; see "
+            "GetGridShaderDefines(...)\n");
+    }
+
+    // same as ParticleManager::Init(...); the dispatch must match the program
+    GLint programWorkGroupSize[3] = { 0, 0, 0 };
+    glGetProgramiv(_gridProgramId, GL_COMPUTE_LOCAL_WORK_SIZE, programWorkGroupSize);
+    _gridWorkGroupSizeX = (programWorkGroupSize[0] > 0) ?
+        programWorkGroupSize[0] : ParticleManager::DEFAULT_WORK_GROUP_SIZE;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Fits the cells to the bounds and (re)creates the per-cell buffers.  Every cell is square,
+    so the grid may hang a little past the max corner.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleNeighborGrid::InitCellBuffers()
+{
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _cellCountBufferId);
+    DeleteGlBuffers(1, &_cellCountBufferId);
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _cellStartBufferId);
+    DeleteGlBuffers(1, &_cellStartBufferId);
+    _cellCountBufferId = 0;
+    _cellStartBufferId = 0;
+    _isGridBuilt = false;
+
+    glm::vec2 gridSize = _maxCorner - _minCorner;
+    _cellSize = _requestedCellSize;
+    _cellCountX = (unsigned int)ceilf(gridSize.x / _cellSize);
+    _cellCountY = (unsigned int)ceilf(gridSize.y / _cellSize);
+    while ((unsigned long long)_cellCountX * _cellCountY > MAX_GRID_CELLS)
+    {
+        _cellSize *= 1.25f;
+        _cellCountX = (unsigned int)ceilf(gridSize.x / _cellSize);
+        _cellCountY = (unsigned int)ceilf(gridSize.y / _cellSize);
+    }
+    if (_cellSize != _requestedCellSize)
+    {
+        LogPrintf("neighbor grid cells of %f would be more than %u; using %f instead\n",
+            _requestedCellSize, MAX_GRID_CELLS, _cellSize);
+    }
+
+    // GPU-only, like the splat's tile buffers
+    unsigned int numCells = _cellCountX * _cellCountY;
+    glGenBuffers(1, &_cellCountBufferId);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _cellCountBufferId);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, numCells * sizeof(GLuint), 0, 0);
+    RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "neighbor grid cells");
+    glGenBuffers(1, &_cellStartBufferId);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _cellStartBufferId);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, numCells * sizeof(GLuint), 0, 0);
+    RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "neighbor grid cells");
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    (Re)creates the per-particle buffers.  They must have room for every particle because
+    every particle might be active.
+Parameters:
+    maxParticleCount    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleNeighborGrid::InitParticleBuffers(unsigned int maxParticleCount)
+{
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _particleCellBufferId);
+    DeleteGlBuffers(1, &_particleCellBufferId);
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _cellParticleBufferId);
+    DeleteGlBuffers(1, &_cellParticleBufferId);
+    _particleCellBufferId = 0;
+    _cellParticleBufferId = 0;
+
+    // a cell and a place in the cell for every particle, then every particle's index
+    glGenBuffers(1, &_particleCellBufferId);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _particleCellBufferId);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, maxParticleCount * 2 * sizeof(GLuint), 0, 0);
+    RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "neighbor grid particles");
+    glGenBuffers(1, &_cellParticleBufferId);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _cellParticleBufferId);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, maxParticleCount * sizeof(GLuint), 0, 0);
+    RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "neighbor grid particles");
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    _particleCapacity = maxParticleCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    (Re)creates the SPH stages' per-particle buffers.  Like the grid's own, they must have room
+    for every particle.
+Parameters:
+    maxParticleCount    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleNeighborGrid::InitSphBuffers(unsigned int maxParticleCount)
+{
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _sortedParticleBufferId);
+    DeleteGlBuffers(1, &_sortedParticleBufferId);
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _sphDensityBufferId);
+    DeleteGlBuffers(1, &_sphDensityBufferId);
+    _sortedParticleBufferId = 0;
+    _sphDensityBufferId = 0;
+
+    // a position and velocity for every particle, then a density and pressure
+    glGenBuffers(1, &_sortedParticleBufferId);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _sortedParticleBufferId);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, maxParticleCount * 4 * sizeof(GLfloat), 0, 0);
+    RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "neighbor grid SPH");
+    glGenBuffers(1, &_sphDensityBufferId);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _sphDensityBufferId);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, maxParticleCount * 2 * sizeof(GLfloat), 0, 0);
+    RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "neighbor grid SPH");
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    _sphCapacity = maxParticleCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The SPH model's part of ApplyInteractions(...): gathers the active particles into grid
+    order, works out every particle's density and pressure, and then changes every particle's
+    velocity by the pressure and viscosity forces.  Each stage needs the one before it to be
+    done for every particle, so they are separate dispatches.
+Parameters:
+    deltaTimeSec        Same as for ApplyInteractions(...).
+    maxParticleCount    Same as for ApplyInteractions(...).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleNeighborGrid::ApplySphFluid(float deltaTimeSec, unsigned int maxParticleCount)
+{
+    if ((GLint)_unifLocSphStiffness == -1)
+    {
+        return;
+    }
+    if (maxParticleCount > _sphCapacity)
+    {
+        this->InitSphBuffers(maxParticleCount);
+    }
+
+    BindGlShaderStorageBuffer(GRID_SORTED_PARTICLE_BUFFER_BINDING, _sortedParticleBufferId);
+    BindGlShaderStorageBuffer(SPH_DENSITY_BUFFER_BINDING, _sphDensityBufferId);
+
+    UseGlProgram(_gridProgramId);
+    glUniform1f(_unifLocInteractionDeltaSec, deltaTimeSec);
+    glUniform1f(_unifLocWakeSpeedSqr, _wakeSpeed * _wakeSpeed);
+    glUniform1f(_unifLocSphRestDensity, _sphRestDensity);
+    glUniform1f(_unifLocSphStiffness, _sphStiffness);
+    glUniform1f(_unifLocSphViscosity, _sphViscosity);
+
+    // one work item per active particle, in grid order, like the pairwise interactions
+    unsigned int numWorkGroups = (maxParticleCount + _gridWorkGroupSizeX - 1) / _gridWorkGroupSizeX;
+    this->DispatchGridStage(GRID_STAGE_SPH_GATHER, numWorkGroups);
+    this->DispatchGridStage(GRID_STAGE_SPH_DENSITY, numWorkGroups);
+    this->DispatchGridStage(GRID_STAGE_SPH_FORCE, numWorkGroups);
+    UseGlProgram(0);
+
+    // same as the pairwise interactions
+    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT |
+        GL_BUFFER_UPDATE_BARRIER_BIT);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The boids model's part of ApplyInteractions(...).  A single stage, one particle per work
+    item in grid order: each finds its nearest neighbors and steers by them.
+Parameters:
+    deltaTimeSec        Same as for ApplyInteractions(...).
+    maxParticleCount    Same as for ApplyInteractions(...).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleNeighborGrid::ApplyBoidsSteering(float deltaTimeSec, unsigned int maxParticleCount)
+{
+    if (_boidsNearestCount == 0)
+    {
+        return;
+    }
+
+    UseGlProgram(_gridProgramId);
+    glUniform1f(_unifLocInteractionDeltaSec, deltaTimeSec);
+    glUniform1f(_unifLocWakeSpeedSqr, _wakeSpeed * _wakeSpeed);
+    glUniform1f(_unifLocBoidsSeparation, _boidsSeparation);
+    glUniform1f(_unifLocBoidsAlignment, _boidsAlignment);
+    glUniform1f(_unifLocBoidsCohesion, _boidsCohesion);
+    glUniform1ui(_unifLocBoidsNearestCount, _boidsNearestCount);
+    glUniform1f(_unifLocBoidsMaxSpeed, _boidsMaxSpeed);
+    this->DispatchGridStage(GRID_STAGE_BOIDS,
+        (maxParticleCount + _gridWorkGroupSizeX - 1) / _gridWorkGroupSizeX);
+    UseGlProgram(0);
+
+    // same as the pairwise interactions
+    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT |
+        GL_BUFFER_UPDATE_BARRIER_BIT);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    (Re)creates the DEM stages' 2 copies of the positions.  Like the grid's own buffers, they
+    must have room for every particle.
+Parameters:
+    maxParticleCount    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleNeighborGrid::InitDemBuffers(unsigned int maxParticleCount)
+{
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _demPositionBufferIds[0]);
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _demPositionBufferIds[1]);
+    DeleteGlBuffers(2, _demPositionBufferIds);
+    _demPositionBufferIds[0] = 0;
+    _demPositionBufferIds[1] = 0;
+
+    // a position for every particle in each
+    glGenBuffers(2, _demPositionBufferIds);
+    for (int bufferIndex = 0; bufferIndex < 2; bufferIndex++)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, _demPositionBufferIds[bufferIndex]);
+        glBufferStorage(GL_SHADER_STORAGE_BUFFER, maxParticleCount * 2 * sizeof(GLfloat), 0,
+            0);
+        RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "neighbor grid DEM");
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    _demCapacity = maxParticleCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The DEM model's part of ApplyInteractions(...): gathers the active particles' positions
+    into grid order, runs the Jacobi iterations, and then writes the corrected positions and
+    the bounce back to the particles.  Every iteration needs the one before it to be done for
+    every particle, so each is its own dispatch, and the 2 copies of the positions swap
+    bindings between them instead of being copied.
+Parameters:
+    deltaTimeSec        Same as for ApplyInteractions(...).
+    maxParticleCount    Same as for ApplyInteractions(...).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleNeighborGrid::ApplyDemCollisions(float deltaTimeSec, unsigned int maxParticleCount)
+{
+    if (_demIterationCount == 0 || _demParticleRadius <= 0.0f)
+    {
+        return;
+    }
+    if (maxParticleCount > _demCapacity)
+    {
+        this->InitDemBuffers(maxParticleCount);
+    }
+
+    // the contact distance must stay within the 3x3 cells
+    float contactDistance = 2.0f * _demParticleRadius;
+    if (contactDistance > _cellSize)
+    {
+        contactDistance = _cellSize;
+    }
+
+    UseGlProgram(_gridProgramId);
+    glUniform1f(_unifLocInteractionDeltaSec, deltaTimeSec);
+    glUniform1f(_unifLocWakeSpeedSqr, _wakeSpeed * _wakeSpeed);
+    glUniform1ui(_unifLocMaxNeighbors, _isDeterministic ? 0xFFFFFFFFu : _maxNeighbors);
+    glUniform1f(_unifLocDemContactDistance, contactDistance);
+    glUniform1f(_unifLocDemRelaxation, _demRelaxation);
+    glUniform1f(_unifLocDemRestitution, _demRestitution);
+
+    // one work item per active particle, in grid order, like the pairwise interactions
+    // Note: The gather writes the source, and after every iteration the one that was just
+    // written becomes the source, so the write stage reads the last iteration's.
+    unsigned int numWorkGroups = (maxParticleCount + _gridWorkGroupSizeX - 1) / _gridWorkGroupSizeX;
+    int sourceIndex = 0;
+    BindGlShaderStorageBuffer(DEM_SOURCE_BUFFER_BINDING, _demPositionBufferIds[sourceIndex]);
+    this->DispatchGridStage(GRID_STAGE_DEM_GATHER, numWorkGroups);
+
+    if (_demProfiler != 0)
+    {
+        _demProfiler->SetScopeIterationCount(_demScopeId, _demIterationCount);
+        _demProfiler->BeginScope(_demScopeId);
+    }
+    for (unsigned int iteration = 0; iteration < _demIterationCount; iteration++)
+    {
+        BindGlShaderStorageBuffer(DEM_SOURCE_BUFFER_BINDING,
+            _demPositionBufferIds[sourceIndex]);
+        BindGlShaderStorageBuffer(DEM_DESTINATION_BUFFER_BINDING,
+            _demPositionBufferIds[1 - sourceIndex]);
+        this->DispatchGridStage(GRID_STAGE_DEM_RELAX, numWorkGroups);
+        sourceIndex = 1 - sourceIndex;
+    }
+    if (_demProfiler != 0)
+    {
+        _demProfiler->EndScope(_demScopeId);
+    }
+
+    BindGlShaderStorageBuffer(DEM_SOURCE_BUFFER_BINDING, _demPositionBufferIds[sourceIndex]);
+    this->DispatchGridStage(GRID_STAGE_DEM_WRITE, numWorkGroups);
+    UseGlProgram(0);
+
+    // same as the pairwise interactions
+    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT |
+        GL_BUFFER_UPDATE_BARRIER_BIT);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    (Re)creates the merge stages' weights.  Like the grid's own buffers, they must have room
+    for every particle, and they start at 0 (every particle stands for itself).
+Parameters:
+    maxParticleCount    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleNeighborGrid::InitMergeBuffer(unsigned int maxParticleCount)
+{
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _mergeCountBufferId);
+    DeleteGlBuffers(1, &_mergeCountBufferId);
+    _mergeCountBufferId = 0;
+
+    glGenBuffers(1, &_mergeCountBufferId);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _mergeCountBufferId);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, maxParticleCount * sizeof(GLuint), 0, 0);
+    RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "neighbor grid merging");
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    _mergeCapacity = maxParticleCount;
+    _isMergeCountStale = true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Runs one stage of the grid program, which must be in use, and waits for its writes.  Like
+    the splat's tile stages, the stages are one particle per work item, so a pool that needs 
+    more work groups than the device allows in X is split into a 2D dispatch.
+Parameters:
+    stage           One of the GRID_STAGE_* values.
+    numWorkGroups   The work groups that a 1D dispatch would use.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleNeighborGrid::DispatchGridStage(int stage, unsigned int numWorkGroups)
+{
+    unsigned int numWorkGroupsX = 0;
+    unsigned int numWorkGroupsY = 0;
+    GetComputeDispatchSize(numWorkGroups, &numWorkGroupsX, &numWorkGroupsY);
+    glUniform1i(_unifLocGridStage, stage);
+    glDispatchCompute(numWorkGroupsX, numWorkGroupsY, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
@@ -0,0 +1,236 @@
+#pragma once
+
+#include "ParticleManager.h"
+#include "GpuScan.h"
+#include "glm/vec2.hpp"
+
+#include <string>
+
+// what ApplyInteractions(...) does with the neighbors (see
+// ParticleNeighborGrid::SetInteractionModel(...))
+enum ParticleInteractionModel
+{
+    // short-range repulsion and cohesion between each pair (see SetInteraction(...))
+    PARTICLE_INTERACTION_PAIRWISE = 0,
+
+    // smoothed-particle hydrodynamics: a density pass, then pressure and viscosity forces (see
+    // SetSphFluid(...))
+    PARTICLE_INTERACTION_SPH,
+
+    // flocking: separation, alignment, and cohesion with the nearest few neighbors (see
+    // SetBoidsSteering(...))
+    PARTICLE_INTERACTION_BOIDS,
+
+    // discrete-element collisions: overlapping particles are pushed apart by a few rounds of
+    // position corrections, and bounce off of each other (see SetDemContact(...))
+    PARTICLE_INTERACTION_DEM,
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    A uniform grid of the active particles, built on the GPU every frame, so that particles
+    can find their neighbors without testing every other particle.  At 600,000 particles, the
+    all-pairs approach is hundreds of billions of tests per frame.
+
+    The build is a counting sort of the particle indices by cell: every active particle adds 1
+    to its cell's count, the counts are prefix summed into each cell's range (see GpuScan.h),
+    and every particle writes its index into its cell's range.  Any particle within one cell
+    size of another is then in one of the 3x3 cells around it, so a neighbor query reads only
+    those 9 ranges.  ApplyInteractions(...) is the first such query: short-range repulsion and
+    cohesion, applied to the particles' velocities.
+
+    The grid program is shaderParticle.comp built with PARTICLE_GRID_PASS defined (see
+    GetGridShaderDefines(...)), so it loads particles with the same storage layout code as the
+    update.  It reads and writes the particle buffers through the shader storage bindings that
+    ParticleManager set up, so it must run after the update and while that particle manager is
+    alive.  The grid's own buffers stay bound after Build(...) (see 
+    GRID_CELL_COUNT_BUFFER_BINDING and the rest), so other passes can query the grid too.
+
+    The SPH fluid model (see SetInteractionModel(...)) is 3 more stages of the same program.
+    The active particles are gathered into grid order, so that the density and force stages
+    read their neighbors from one tight array that each work group loads into shared memory a
+    tile at a time (see RunSphStage() in shaderParticle.comp).  The gather itself reads the
+    particle buffers in grid order, which is close to in order once the pool has been sorted
+    along a Morton curve (see ParticleManager::SetParticleSort(...)).
+
+    The boids model (see SetBoidsSteering(...)) is one more stage, which steers every particle
+    by its nearest few neighbors in the 3x3 cells, with its cost capped per particle.
+
+    RunQueries(...) is one more stage, which answers a batch of region counts and nearest
+    particle searches for ParticleSpatialQuery (see ParticleSpatialQuery.h).
+
+    The DEM model (see SetDemContact(...)) is 3 more stages: the active particles' positions
+    are gathered into grid order, a fixed number of Jacobi iterations each push every
+    particle out of the ones that it overlaps, and the result is written back to the
+    particles along with the bounce.  Each iteration reads one copy of the positions and
+    writes the other, so no particle reads a neighbor that another work item is moving, and
+    the copies are swapped between iterations.
+
+    MergeDenseCells(...) is a level of detail for the simulation (see SetMerging(...)): in a
+    cell with more particles than the merge density, runs of a few particles of the same
+    emitter are merged into one representative that stands for all of them, with their mean
+    position and velocity weighted by how many each stood for, so mass and momentum are kept.
+    The others go back onto their emitter's dead stack.  When a representative's cell thins
+    out below the split density, it pops as many particles back off of the stack as it stood
+    for.  A crowded emitter then costs the update a fraction of its particles.
+
+    Note: The cell size is the interaction radius.  Smaller cells mean fewer candidates per
+    query but more cells to clear and scan every frame, and the grid is limited to
+    MAX_GRID_CELLS; a cell size that would need more is made larger (see SetCellSize(...)).
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+class ParticleNeighborGrid
+{
+public:
+    ParticleNeighborGrid();
+    ~ParticleNeighborGrid();
+    void Init(unsigned int gridProgramId, unsigned int scanProgramId);
+    void Cleanup();
+    void ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId);
+
+    void SetCellSize(float cellSize);
+    void SetBounds(const glm::vec2 &minCorner, const glm::vec2 &maxCorner);
+    void SetInteraction(float repulsionStrength, float cohesionStrength,
+        unsigned int maxNeighbors);
+    void SetWakeSpeed(float wakeSpeed);
+    bool SetInteractionModel(ParticleInteractionModel model);
+    void SetSphFluid(float restDensity, float stiffness, float viscosity);
+    void SetBoidsSteering(float separationStrength, float alignmentStrength,
+        float cohesionStrength, unsigned int nearestCount, float maxSpeed);
+    void SetDemContact(float particleRadius, float relaxation, unsigned int iterationCount,
+        float restitution);
+    void SetDemProfiler(GpuProfiler *profiler, unsigned int iterationScopeId);
+    void SetDeterministic(bool deterministic);
+    bool SetMerging(unsigned int mergeDensity, unsigned int splitDensity,
+        unsigned int maxMergeWeight);
+    float GetCellSize() const;
+
+    void Build(unsigned int maxParticleCount);
+    bool RunQueries(unsigned int queryCount);
+    void ApplyInteractions(float deltaTimeSec, unsigned int maxParticleCount);
+    void MergeDenseCells(ParticleManager &particleManager);
+
+    static std::string GetGridShaderDefines(ParticleLayout layout,
+        unsigned int workGroupSize = ParticleManager::DEFAULT_WORK_GROUP_SIZE,
+        bool wakesSleepingParticles = false, bool hasSphFluid = false);
+
+private:
+    void LoadProgramInterface();
+    void InitCellBuffers();
+    void InitParticleBuffers(unsigned int maxParticleCount);
+    void InitSphBuffers(unsigned int maxParticleCount);
+    void ApplySphFluid(float deltaTimeSec, unsigned int maxParticleCount);
+    void ApplyBoidsSteering(float deltaTimeSec, unsigned int maxParticleCount);
+    void InitDemBuffers(unsigned int maxParticleCount);
+    void ApplyDemCollisions(float deltaTimeSec, unsigned int maxParticleCount);
+    void InitMergeBuffer(unsigned int maxParticleCount);
+    void DispatchGridStage(int stage, unsigned int numWorkGroups);
+
+    unsigned int _gridProgramId;
+    unsigned int _gridWorkGroupSizeX;
+    unsigned int _unifLocGridStage;
+    unsigned int _unifLocGridParticleCount;
+    unsigned int _unifLocGridOrigin;
+    unsigned int _unifLocGridCellSize;
+    unsigned int _unifLocGridCellCounts;
+    unsigned int _unifLocInteractionDeltaSec;
+    unsigned int _unifLocRepulsionStrength;
+    unsigned int _unifLocCohesionStrength;
+    unsigned int _unifLocMaxNeighbors;
+    unsigned int _unifLocWakeSpeedSqr;
+    unsigned int _unifLocSphRestDensity;
+    unsigned int _unifLocSphStiffness;
+    unsigned int _unifLocSphViscosity;
+    unsigned int _unifLocBoidsSeparation;
+    unsigned int _unifLocBoidsAlignment;
+    unsigned int _unifLocBoidsCohesion;
+    unsigned int _unifLocBoidsNearestCount;
+    unsigned int _unifLocBoidsMaxSpeed;
+    unsigned int _unifLocDemContactDistance;
+    unsigned int _unifLocDemRelaxation;
+    unsigned int _unifLocDemRestitution;
+    unsigned int _unifLocQueryCount;
+    unsigned int _unifLocMergeDensity;
+    unsigned int _unifLocSplitDensity;
+    unsigned int _unifLocMaxMergeWeight;
+    unsigned int _unifLocMergeEmitterCount;
+
+    // the grid covers [min corner, max corner] with square cells
+    // Note: The requested cell size is kept separately so that changing the bounds doesn't
+    // lose it if it had to be made larger.
+    glm::vec2 _minCorner;
+    glm::vec2 _maxCorner;
+    float _requestedCellSize;
+    float _cellSize;
+    unsigned int _cellCountX;
+    unsigned int _cellCountY;
+    bool _isGridBuilt;
+
+    float _repulsionStrength;
+    float _cohesionStrength;
+    unsigned int _maxNeighbors;
+    float _wakeSpeed;
+
+    ParticleInteractionModel _interactionModel;
+    float _sphRestDensity;
+    float _sphStiffness;
+    float _sphViscosity;
+    float _boidsSeparation;
+    float _boidsAlignment;
+    float _boidsCohesion;
+    unsigned int _boidsNearestCount;
+    float _boidsMaxSpeed;
+    float _demParticleRadius;
+    float _demRelaxation;
+    unsigned int _demIterationCount;
+    float _demRestitution;
+    bool _isDeterministic;
+
+    // the caller's, and the scope that the DEM iterations are timed in (see
+    // SetDemProfiler(...))
+    GpuProfiler *_demProfiler;
+    unsigned int _demScopeId;
+
+    // the bindings continue from ParticleManager's
+    static const unsigned int MAX_GRID_CELLS = 1024 * 1024;
+    static const unsigned int GRID_CELL_COUNT_BUFFER_BINDING = 17;
+    static const unsigned int GRID_CELL_START_BUFFER_BINDING = 18;
+    static const unsigned int GRID_PARTICLE_CELL_BUFFER_BINDING = 19;
+    static const unsigned int GRID_CELL_PARTICLE_BUFFER_BINDING = 20;
+    unsigned int _cellCountBufferId;
+    unsigned int _cellStartBufferId;
+    unsigned int _particleCellBufferId;
+    unsigned int _cellParticleBufferId;
+    unsigned int _particleCapacity;
+
+    // the SPH stages' particles in grid order, and their densities and pressures
+    // Note: Only made for the SPH model, since they are as big as the pool.
+    static const unsigned int GRID_SORTED_PARTICLE_BUFFER_BINDING = 49;
+    static const unsigned int SPH_DENSITY_BUFFER_BINDING = 50;
+    unsigned int _sortedParticleBufferId;
+    unsigned int _sphDensityBufferId;
+    unsigned int _sphCapacity;
+
+    // 2 copies of the DEM stages' positions, in grid order; each iteration reads one and
+    // writes the other
+    // Note: Only made for the DEM model, like the SPH buffers.  They come after the gravity
+    // tree's bindings (see ParticleGravityTree.h).
+    static const unsigned int DEM_SOURCE_BUFFER_BINDING = 57;
+    static const unsigned int DEM_DESTINATION_BUFFER_BINDING = 58;
+    unsigned int _demPositionBufferIds[2];
+    unsigned int _demCapacity;
+
+    // the merge stages' settings (see SetMerging(...)), and how many other particles each
+    // slot of the pool stands for
+    // Note: Only made once merging is on, like the SPH buffers.  0 merge density is off.
+    static const unsigned int MERGE_COUNT_BUFFER_BINDING = 70;
+    unsigned int _mergeDensity;
+    unsigned int _splitDensity;
+    unsigned int _maxMergeWeight;
+    bool _isMergeCountStale;
+    unsigned int _mergeCountBufferId;
+    unsigned int _mergeCapacity;
+
+    // turns the cell counts into the cell starts
+    GpuScan _cellScan;
+};
@@ -0,0 +1,355 @@
+#include "ParticleSegmentBvh.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
+#include "ShaderProgramRegistry.h"
+#include "ComputeDeviceCaps.h"
+#include "Log.h"
+
+// must match the SEGMENT_BVH_STAGE_* defines in shaderSegmentBvh.comp
+enum SegmentBvhStage
+{
+    SEGMENT_BVH_STAGE_KEYS = 0,
+    SEGMENT_BVH_STAGE_SORT,
+    SEGMENT_BVH_STAGE_GATHER,
+    SEGMENT_BVH_STAGE_HIERARCHY,
+    SEGMENT_BVH_STAGE_REFIT,
+};
+
+// must match "Node" in shaderSegmentBvh.comp: 2 vec2s and 2 ints, std430
+static const unsigned int BVH_NODE_SIZE_BYTES = 24;
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleSegmentBvh::ParticleSegmentBvh() :
+    _buildProgramId(0),
+    _buildWorkGroupSizeX(256),
+    _unifLocSegmentBvhStage(0),
+    _unifLocSegmentCount(0),
+    _unifLocSortCount(0),
+    _unifLocSortK(0),
+    _unifLocSortJ(0),
+    _unifLocCenterMin(0),
+    _unifLocCenterInverseSize(0),
+    _segmentBufferId(0),
+    _sortedSegmentBufferId(0),
+    _nodeBufferId(0),
+    _sortPairBufferId(0),
+    _parentBufferId(0),
+    _visitCountBufferId(0),
+    _segmentCapacity(0),
+    _segmentCount(0)
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleSegmentBvh::~ParticleSegmentBvh()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes a reference to the build program (see ShaderProgramRegistry.h).  There are no
+    segments, and so no buffers, until SetSegments(...).  The caller may release their own
+    reference after this returns.
+Parameters:
+    buildProgramId  shaderSegmentBvh.comp.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleSegmentBvh::Init(unsigned int buildProgramId)
+{
+    this->Cleanup();
+    if (buildProgramId == 0)
+    {
+        LogPrintf("the segment BVH needs its build program\n");
+        return;
+    }
+
+    _buildProgramId = buildProgramId;
+    AddProgramReference(_buildProgramId);
+    this->LoadProgramInterface();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Releases the program and deletes the buffers.  A particle manager that was given the
+    segments must be told first (see ParticleManager::ClearSegmentBvh()).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleSegmentBvh::Cleanup()
+{
+    if (_buildProgramId != 0)
+    {
+        ReleaseProgram(_buildProgramId);
+        _buildProgramId = 0;
+    }
+
+    DeleteGlBuffers(1, &_segmentBufferId);
+    DeleteGlBuffers(1, &_sortedSegmentBufferId);
+    DeleteGlBuffers(1, &_nodeBufferId);
+    DeleteGlBuffers(1, &_sortPairBufferId);
+    DeleteGlBuffers(1, &_parentBufferId);
+    DeleteGlBuffers(1, &_visitCountBufferId);
+    _segmentBufferId = 0;
+    _sortedSegmentBufferId = 0;
+    _nodeBufferId = 0;
+    _sortPairBufferId = 0;
+    _parentBufferId = 0;
+    _visitCountBufferId = 0;
+    _segmentCapacity = 0;
+    _segmentCount = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Switches to a rebuilt program (see ParticleManager::ReplaceProgram(...)).  The tree isn't
+    built again until the next SetSegments(...).
+Parameters:
+    oldProgramId    Self-explanatory.  Programs that this BVH doesn't use are ignored.
+    newProgramId    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleSegmentBvh::ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId)
+{
+    if (oldProgramId == 0 || newProgramId == 0 || _buildProgramId != oldProgramId)
+    {
+        return;
+    }
+
+    AddProgramReference(newProgramId);
+    ReleaseProgram(_buildProgramId);
+    _buildProgramId = newProgramId;
+    this->LoadProgramInterface();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Uploads the segments and builds the tree over them on the GPU.  Call it again whenever the
+    segments change.  The buffers only ever grow, so a particle manager that was given them
+    must be given them again if there are more segments than ever before (see
+    ParticleManager::SetSegmentBvh(...)).
+Parameters:
+    segments    In window coordinates, in any order.  Segments of length 0 never stop anything.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleSegmentBvh::SetSegments(const std::vector<ParticleSegment> &segments)
+{
+    if (_buildProgramId == 0)
+    {
+        return;
+    }
+
+    _segmentCount = (unsigned int)segments.size();
+    if (_segmentCount == 0)
+    {
+        return;
+    }
+
+    // a power of 2 keys for the bitonic sort
+    unsigned int sortCount = 1;
+    while (sortCount < _segmentCount)
+    {
+        sortCount <<= 1;
+    }
+
+    // Note: Mutable storage, and it only grows, same as the particle manager's force fields.
+    // The sort pairs are sized for the capacity rounded up, so they are always big enough.
+    if (_segmentCount > _segmentCapacity)
+    {
+        _segmentCapacity = sortCount;
+        unsigned int internalNodeCapacity = (_segmentCapacity > 1) ? (_segmentCapacity - 1) : 1;
+        unsigned int *bufferIds[6] = { &_segmentBufferId, &_sortedSegmentBufferId,
+            &_nodeBufferId, &_sortPairBufferId, &_parentBufferId, &_visitCountBufferId };
+        size_t bufferSizes[6] = {
+            _segmentCapacity * sizeof(ParticleSegment),
+            _segmentCapacity * sizeof(ParticleSegment),
+            internalNodeCapacity * BVH_NODE_SIZE_BYTES,
+            _segmentCapacity * 2 * sizeof(GLuint),
+            (internalNodeCapacity + _segmentCapacity) * sizeof(GLint),
+            internalNodeCapacity * sizeof(GLuint),
+        };
+        for (int bufferIndex = 0; bufferIndex < 6; bufferIndex++)
+        {
+            DeleteGlBuffers(1, bufferIds[bufferIndex]);
+            glGenBuffers(1, bufferIds[bufferIndex]);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, *bufferIds[bufferIndex]);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, bufferSizes[bufferIndex], 0, GL_DYNAMIC_COPY);
+        }
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _segmentBufferId);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, _segmentCount * sizeof(ParticleSegment),
+        segments.data());
+
+    // the refit counts the children that have arrived at each node from 0
+    GLuint zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _visitCountBufferId);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT,
+        &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // the Morton codes cover the box around the centers, so they use all of their bits however
+    // small the segments' part of the window is
+    glm::vec2 centerMin = 0.5f * (segments[0]._start + segments[0]._end);
+    glm::vec2 centerMax = centerMin;
+    for (size_t segmentIndex = 1; segmentIndex < segments.size(); segmentIndex++)
+    {
+        glm::vec2 center = 0.5f * (segments[segmentIndex]._start + segments[segmentIndex]._end);
+        centerMin.x = (center.x < centerMin.x) ? center.x : centerMin.x;
+        centerMin.y = (center.y < centerMin.y) ? center.y : centerMin.y;
+        centerMax.x = (center.x > centerMax.x) ? center.x : centerMax.x;
+        centerMax.y = (center.y > centerMax.y) ? center.y : centerMax.y;
+    }
+    glm::vec2 centerSize = centerMax - centerMin;
+    float inverseSizeX = (centerSize.x > 0.0f) ? (1.0f / centerSize.x) : 0.0f;
+    float inverseSizeY = (centerSize.y > 0.0f) ? (1.0f / centerSize.y) : 0.0f;
+
+    // bound every build because other passes are free to use these binding points too
+    BindGlShaderStorageBuffer(SEGMENT_BUFFER_BINDING, _segmentBufferId);
+    BindGlShaderStorageBuffer(SORTED_SEGMENT_BUFFER_BINDING, _sortedSegmentBufferId);
+    BindGlShaderStorageBuffer(NODE_BUFFER_BINDING, _nodeBufferId);
+    BindGlShaderStorageBuffer(SORT_PAIR_BUFFER_BINDING, _sortPairBufferId);
+    BindGlShaderStorageBuffer(PARENT_BUFFER_BINDING, _parentBufferId);
+    BindGlShaderStorageBuffer(VISIT_COUNT_BUFFER_BINDING, _visitCountBufferId);
+
+    UseGlProgram(_buildProgramId);
+    glUniform1ui(_unifLocSegmentCount, _segmentCount);
+    glUniform1ui(_unifLocSortCount, sortCount);
+    glUniform2f(_unifLocCenterMin, centerMin.x, centerMin.y);
+    glUniform2f(_unifLocCenterInverseSize, inverseSizeX, inverseSizeY);
+    this->DispatchBuildStage(SEGMENT_BVH_STAGE_KEYS, sortCount);
+
+    // every bitonic sequence size, and every compare distance in it
+    for (unsigned int k = 2; k <= sortCount; k <<= 1)
+    {
+        glUniform1ui(_unifLocSortK, k);
+        for (unsigned int j = k / 2; j >= 1; j /= 2)
+        {
+            glUniform1ui(_unifLocSortJ, j);
+            this->DispatchBuildStage(SEGMENT_BVH_STAGE_SORT, sortCount);
+        }
+    }
+    this->DispatchBuildStage(SEGMENT_BVH_STAGE_GATHER, _segmentCount);
+
+    // a single segment is its own tree, and the update tests it without any nodes
+    if (_segmentCount > 1)
+    {
+        this->DispatchBuildStage(SEGMENT_BVH_STAGE_HIERARCHY, _segmentCount - 1);
+        this->DispatchBuildStage(SEGMENT_BVH_STAGE_REFIT, _segmentCount);
+    }
+    UseGlProgram(0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The segments in the tree's order, for ParticleManager::SetSegmentBvh(...), or 0 before the
+    first SetSegments(...).
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleSegmentBvh::GetSegmentBufferId() const
+{
+    return _sortedSegmentBufferId;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The tree's internal nodes, for ParticleManager::SetSegmentBvh(...), or 0 before the first
+    SetSegments(...).
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleSegmentBvh::GetNodeBufferId() const
+{
+    return _nodeBufferId;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How many segments were given to the last SetSegments(...).
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleSegmentBvh::GetSegmentCount() const
+{
+    return _segmentCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Looks up the build program's uniforms and work group size.  Called by Init(...) and
+    whenever the program is replaced.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleSegmentBvh::LoadProgramInterface()
+{
+    _unifLocSegmentBvhStage = glGetUniformLocation(_buildProgramId, "uSegmentBvhStage");
+    _unifLocSegmentCount = glGetUniformLocation(_buildProgramId, "uSegmentCount");
+    _unifLocSortCount = glGetUniformLocation(_buildProgramId, "uSortCount");
+    _unifLocSortK = glGetUniformLocation(_buildProgramId, "uSortK");
+    _unifLocSortJ = glGetUniformLocation(_buildProgramId, "uSortJ");
+    _unifLocCenterMin = glGetUniformLocation(_buildProgramId, "uCenterMin");
+    _unifLocCenterInverseSize = glGetUniformLocation(_buildProgramId, "uCenterInverseSize");
+
+    // Note: This version of glload calls GL_COMPUTE_WORK_GROUP_SIZE by its old name,
+    // GL_COMPUTE_LOCAL_WORK_SIZE (same value).
+    GLint programWorkGroupSize[3] = { 0, 0, 0 };
+    glGetProgramiv(_buildProgramId, GL_COMPUTE_LOCAL_WORK_SIZE, programWorkGroupSize);
+    _buildWorkGroupSizeX = (programWorkGroupSize[0] > 0) ? programWorkGroupSize[0] : 256;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Runs one stage with a work item per item and puts up a barrier for the next stage, which
+    reads what this one wrote.  The last stage's barrier also covers the update's reads.
+Parameters:
+    stage       One of the SEGMENT_BVH_STAGE_* values.
+    itemCount   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleSegmentBvh::DispatchBuildStage(int stage, unsigned int itemCount)
+{
+    unsigned int numWorkGroupsX = 0;
+    unsigned int numWorkGroupsY = 0;
+    GetComputeDispatchSize((itemCount + _buildWorkGroupSizeX - 1) / _buildWorkGroupSizeX,
+        &numWorkGroupsX, &numWorkGroupsY);
+    glUniform1i(_unifLocSegmentBvhStage, stage);
+    glDispatchCompute(numWorkGroupsX, numWorkGroupsY, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "glm/vec2.hpp"
+
+#include <vector>
+
+// a wall for the particles to bounce off of (see ParticleSegmentBvh)
+// Note: Must match "Segment" in shaderSegmentBvh.comp and "BvhSegment" in shaderParticle.comp,
+// which are std430, so this is 16 bytes.
+struct ParticleSegment
+{
+    glm::vec2 _start;
+    glm::vec2 _end;
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Exact collisions against thousands of line segments, for shapes that are too detailed for
+    an SDF boundary's texels (see ParticleBoundarySdf.h).  The segments are put in a linear
+    bounding volume hierarchy on the GPU (see shaderSegmentBvh.comp): they are sorted by the
+    Morton codes of their centers, every internal node finds its range of the sorted list and
+    its split from the codes, and then the boxes are filled in from the leaves up.  The update
+    kernel walks the tree with each particle's step (see ParticleManager::SetSegmentBvh(...)),
+    so a particle costs about log2(segment count) box tests instead of one test per segment.
+
+    The build is 4 + log2(n) * (log2(n) + 1) / 2 dispatches for the n segments rounded up to a
+    power of 2 (about 100 for 8192), and it only needs to be done when the segments change.
+
+    Note: A particle is tested against the segments that its step crosses, so unlike the SDF
+    boundary, a fast particle can't skip through a thin wall.
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+class ParticleSegmentBvh
+{
+public:
+    ParticleSegmentBvh();
+    ~ParticleSegmentBvh();
+    void Init(unsigned int buildProgramId);
+    void Cleanup();
+    void ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId);
+
+    void SetSegments(const std::vector<ParticleSegment> &segments);
+
+    unsigned int GetSegmentBufferId() const;
+    unsigned int GetNodeBufferId() const;
+    unsigned int GetSegmentCount() const;
+
+private:
+    void LoadProgramInterface();
+    void DispatchBuildStage(int stage, unsigned int itemCount);
+
+    unsigned int _buildProgramId;
+    unsigned int _buildWorkGroupSizeX;
+    unsigned int _unifLocSegmentBvhStage;
+    unsigned int _unifLocSegmentCount;
+    unsigned int _unifLocSortCount;
+    unsigned int _unifLocSortK;
+    unsigned int _unifLocSortJ;
+    unsigned int _unifLocCenterMin;
+    unsigned int _unifLocCenterInverseSize;
+
+    // Note: The bindings must match shaderSegmentBvh.comp.  They come after the field bake's
+    // (see ParticleFieldTexture.h), and the update reads the sorted segments and the nodes at
+    // the same bindings (see ParticleManager.h).
+    static const unsigned int SEGMENT_BUFFER_BINDING = 26;
+    static const unsigned int SORTED_SEGMENT_BUFFER_BINDING = 27;
+    static const unsigned int NODE_BUFFER_BINDING = 28;
+    static const unsigned int SORT_PAIR_BUFFER_BINDING = 29;
+    static const unsigned int PARENT_BUFFER_BINDING = 30;
+    static const unsigned int VISIT_COUNT_BUFFER_BINDING = 31;
+    unsigned int _segmentBufferId;
+    unsigned int _sortedSegmentBufferId;
+    unsigned int _nodeBufferId;
+    unsigned int _sortPairBufferId;
+    unsigned int _parentBufferId;
+    unsigned int _visitCountBufferId;
+    unsigned int _segmentCapacity;
+    unsigned int _segmentCount;
+};
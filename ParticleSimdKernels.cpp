@@ -0,0 +1,734 @@
+#include "ParticleSimdKernels.h"
+
+// which kernels this build has
+// Note: The x86 kernels only need the compiler to know the intrinsics.  GCC and Clang also
+// need each kernel marked with its instruction set (see PARTICLE_SIMD_TARGET), and then the
+// rest of the file is still built for the baseline.  VS2015 doesn't have the AVX-512
+// intrinsics yet (VS2017 15.3 does).
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PARTICLE_SIMD_HAS_X86
+#if !defined(_MSC_VER) || (_MSC_VER >= 1911)
+#define PARTICLE_SIMD_HAS_AVX512
+#endif
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM) || defined(_M_ARM64)
+#define PARTICLE_SIMD_HAS_NEON
+#endif
+
+#ifdef PARTICLE_SIMD_HAS_X86
+#ifdef _MSC_VER
+#include <intrin.h>         // __cpuidex, _xgetbv, and every x86 intrinsic
+#define PARTICLE_SIMD_TARGET(instructionSet)
+#else
+#include <cpuid.h>          // __cpuid_count
+#include <immintrin.h>
+#define PARTICLE_SIMD_TARGET(instructionSet) __attribute__((target(instructionSet)))
+#endif
+#endif
+
+#ifdef PARTICLE_SIMD_HAS_NEON
+#include <arm_neon.h>
+#endif
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The kernel for when there is nothing better, and for the tails of the runs that the wider
+    kernels don't fill a register with.  Each particle runs its steps back to back, just like
+    the substeps of IntegrateParticle(...) in shaderParticle.comp, without the forces.
+
+    Note: The bounds test is written so that a NaN is out of bounds.  ParticleManager's
+    ResetParticle(...) normalizes a random vector that can come out as (0,0), and a particle
+    with a NaN position would otherwise never die.  The other kernels' compares do the same.
+Parameters:
+    arrays          See ParticleSimdKernel.
+    firstParticle   Same.
+    beginOffset     The first particle of the run to do, counted from firstParticle.
+    endOffset       One past the last.
+    step            See ParticleSimdKernel.
+    deadMask        Same, but only the bits of this part of the run are set, and none are
+                    cleared.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+static void StepParticleRangeScalar(const ParticleSimdArrays &arrays, unsigned int firstParticle,
+    unsigned int beginOffset, unsigned int endOffset, const ParticleSimdStep &step,
+    unsigned int *deadMask)
+{
+    for (unsigned int offset = beginOffset; offset < endOffset; offset++)
+    {
+        unsigned int particleIndex = firstParticle + offset;
+        if (arrays._isActive[particleIndex] == 0)
+        {
+            continue;
+        }
+
+        float x = arrays._positionsX[particleIndex];
+        float y = arrays._positionsY[particleIndex];
+        float velocityX = arrays._velocitiesX[particleIndex];
+        float velocityY = arrays._velocitiesY[particleIndex];
+        float age = arrays._ages[particleIndex];
+        bool isAlive = true;
+        for (unsigned int stepIndex = 0; isAlive && stepIndex < step._stepCount; stepIndex++)
+        {
+            x = x + (velocityX * step._stepSec);
+            y = y + (velocityY * step._stepSec);
+            float dx = x - step._centerX;
+            float dy = y - step._centerY;
+            float distSqr = (dx * dx) + (dy * dy);
+            age = age + step._agePerStep;
+            isAlive = (distSqr <= step._radiusSqr) && (age < 1.0f);
+        }
+
+        arrays._positionsX[particleIndex] = x;
+        arrays._positionsY[particleIndex] = y;
+        if (isAlive)
+        {
+            arrays._ages[particleIndex] = age;
+        }
+        else
+        {
+            arrays._ages[particleIndex] = 0.0f;
+            arrays._isActive[particleIndex] = 0;
+            deadMask[offset / 32] |= (1u << (offset % 32));
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Clears the mask words for a run (see ParticleSimdKernel).
+Parameters:
+    particleCount   Self-explanatory.
+    deadMask        Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+static void ClearDeadMask(unsigned int particleCount, unsigned int *deadMask)
+{
+    unsigned int wordCount = (particleCount + 31) / 32;
+    for (unsigned int wordIndex = 0; wordIndex < wordCount; wordIndex++)
+    {
+        deadMask[wordIndex] = 0;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The plain C++ kernel (see ParticleSimdKernel).
+Parameters: See ParticleSimdKernel.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+static void StepParticlesScalar(const ParticleSimdArrays &arrays, unsigned int firstParticle,
+    unsigned int particleCount, const ParticleSimdStep &step, unsigned int *deadMask)
+{
+    ClearDeadMask(particleCount, deadMask);
+    StepParticleRangeScalar(arrays, firstParticle, 0, particleCount, step, deadMask);
+}
+
+#ifdef PARTICLE_SIMD_HAS_X86
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The 4-lane SSE4.1 kernel (see ParticleSimdKernel).  A lane that dies keeps the position of
+    the step that it died on and stops moving, but the register keeps going until every lane
+    is dead or the steps run out.  The "is active" flags are the lanes' starting mask, so an
+    inactive particle is never moved.
+
+    Note: SSE4.1 rather than SSE2 for the blends, which pick between the moved and the stopped
+    values in one instruction.
+Parameters: See ParticleSimdKernel.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+PARTICLE_SIMD_TARGET("sse4.1")
+static void StepParticlesSse41(const ParticleSimdArrays &arrays, unsigned int firstParticle,
+    unsigned int particleCount, const ParticleSimdStep &step, unsigned int *deadMask)
+{
+    ClearDeadMask(particleCount, deadMask);
+    const __m128 centerX = _mm_set1_ps(step._centerX);
+    const __m128 centerY = _mm_set1_ps(step._centerY);
+    const __m128 radiusSqr = _mm_set1_ps(step._radiusSqr);
+    const __m128 stepSec = _mm_set1_ps(step._stepSec);
+    const __m128 agePerStep = _mm_set1_ps(step._agePerStep);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i allBits = _mm_set1_epi32(-1);
+
+    unsigned int vectorEnd = particleCount - (particleCount % 4);
+    for (unsigned int offset = 0; offset < vectorEnd; offset += 4)
+    {
+        unsigned int particleIndex = firstParticle + offset;
+        __m128i isActive = _mm_loadu_si128((const __m128i *)(arrays._isActive + particleIndex));
+        __m128 wasActive = _mm_castsi128_ps(
+            _mm_xor_si128(_mm_cmpeq_epi32(isActive, zero), allBits));
+        if (_mm_movemask_ps(wasActive) == 0)
+        {
+            continue;
+        }
+
+        __m128 x = _mm_loadu_ps(arrays._positionsX + particleIndex);
+        __m128 y = _mm_loadu_ps(arrays._positionsY + particleIndex);
+        __m128 velocityX = _mm_loadu_ps(arrays._velocitiesX + particleIndex);
+        __m128 velocityY = _mm_loadu_ps(arrays._velocitiesY + particleIndex);
+        __m128 age = _mm_loadu_ps(arrays._ages + particleIndex);
+        __m128 isAlive = wasActive;
+        for (unsigned int stepIndex = 0; stepIndex < step._stepCount; stepIndex++)
+        {
+            __m128 movedX = _mm_add_ps(x, _mm_mul_ps(velocityX, stepSec));
+            __m128 movedY = _mm_add_ps(y, _mm_mul_ps(velocityY, stepSec));
+            __m128 agedAge = _mm_add_ps(age, agePerStep);
+            x = _mm_blendv_ps(x, movedX, isAlive);
+            y = _mm_blendv_ps(y, movedY, isAlive);
+            age = _mm_blendv_ps(age, agedAge, isAlive);
+
+            __m128 dx = _mm_sub_ps(movedX, centerX);
+            __m128 dy = _mm_sub_ps(movedY, centerY);
+            __m128 distSqr = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+            __m128 isInside = _mm_and_ps(_mm_cmple_ps(distSqr, radiusSqr),
+                _mm_cmplt_ps(agedAge, one));
+            isAlive = _mm_and_ps(isAlive, isInside);
+            if (_mm_movemask_ps(isAlive) == 0)
+            {
+                break;
+            }
+        }
+
+        __m128 hasDied = _mm_andnot_ps(isAlive, wasActive);
+        age = _mm_andnot_ps(hasDied, age);
+        isActive = _mm_and_si128(isActive, _mm_castps_si128(isAlive));
+        _mm_storeu_ps(arrays._positionsX + particleIndex, x);
+        _mm_storeu_ps(arrays._positionsY + particleIndex, y);
+        _mm_storeu_ps(arrays._ages + particleIndex, age);
+        _mm_storeu_si128((__m128i *)(arrays._isActive + particleIndex), isActive);
+        deadMask[offset / 32] |= ((unsigned int)_mm_movemask_ps(hasDied) << (offset % 32));
+    }
+    StepParticleRangeScalar(arrays, firstParticle, vectorEnd, particleCount, step, deadMask);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The SSE4.1 kernel, 8 lanes wide (see StepParticlesSse41(...)).  AVX has the 8-wide float
+    math, and AVX2 adds the 8-wide integer compare for the "is active" flags.
+Parameters: See ParticleSimdKernel.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+PARTICLE_SIMD_TARGET("avx2")
+static void StepParticlesAvx2(const ParticleSimdArrays &arrays, unsigned int firstParticle,
+    unsigned int particleCount, const ParticleSimdStep &step, unsigned int *deadMask)
+{
+    ClearDeadMask(particleCount, deadMask);
+    const __m256 centerX = _mm256_set1_ps(step._centerX);
+    const __m256 centerY = _mm256_set1_ps(step._centerY);
+    const __m256 radiusSqr = _mm256_set1_ps(step._radiusSqr);
+    const __m256 stepSec = _mm256_set1_ps(step._stepSec);
+    const __m256 agePerStep = _mm256_set1_ps(step._agePerStep);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i allBits = _mm256_set1_epi32(-1);
+
+    unsigned int vectorEnd = particleCount - (particleCount % 8);
+    for (unsigned int offset = 0; offset < vectorEnd; offset += 8)
+    {
+        unsigned int particleIndex = firstParticle + offset;
+        __m256i isActive =
+            _mm256_loadu_si256((const __m256i *)(arrays._isActive + particleIndex));
+        __m256 wasActive = _mm256_castsi256_ps(
+            _mm256_xor_si256(_mm256_cmpeq_epi32(isActive, zero), allBits));
+        if (_mm256_movemask_ps(wasActive) == 0)
+        {
+            continue;
+        }
+
+        __m256 x = _mm256_loadu_ps(arrays._positionsX + particleIndex);
+        __m256 y = _mm256_loadu_ps(arrays._positionsY + particleIndex);
+        __m256 velocityX = _mm256_loadu_ps(arrays._velocitiesX + particleIndex);
+        __m256 velocityY = _mm256_loadu_ps(arrays._velocitiesY + particleIndex);
+        __m256 age = _mm256_loadu_ps(arrays._ages + particleIndex);
+        __m256 isAlive = wasActive;
+        for (unsigned int stepIndex = 0; stepIndex < step._stepCount; stepIndex++)
+        {
+            __m256 movedX = _mm256_add_ps(x, _mm256_mul_ps(velocityX, stepSec));
+            __m256 movedY = _mm256_add_ps(y, _mm256_mul_ps(velocityY, stepSec));
+            __m256 agedAge = _mm256_add_ps(age, agePerStep);
+            x = _mm256_blendv_ps(x, movedX, isAlive);
+            y = _mm256_blendv_ps(y, movedY, isAlive);
+            age = _mm256_blendv_ps(age, agedAge, isAlive);
+
+            __m256 dx = _mm256_sub_ps(movedX, centerX);
+            __m256 dy = _mm256_sub_ps(movedY, centerY);
+            __m256 distSqr = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+            __m256 isInside = _mm256_and_ps(_mm256_cmp_ps(distSqr, radiusSqr, _CMP_LE_OQ),
+                _mm256_cmp_ps(agedAge, one, _CMP_LT_OQ));
+            isAlive = _mm256_and_ps(isAlive, isInside);
+            if (_mm256_movemask_ps(isAlive) == 0)
+            {
+                break;
+            }
+        }
+
+        __m256 hasDied = _mm256_andnot_ps(isAlive, wasActive);
+        age = _mm256_andnot_ps(hasDied, age);
+        isActive = _mm256_and_si256(isActive, _mm256_castps_si256(isAlive));
+        _mm256_storeu_ps(arrays._positionsX + particleIndex, x);
+        _mm256_storeu_ps(arrays._positionsY + particleIndex, y);
+        _mm256_storeu_ps(arrays._ages + particleIndex, age);
+        _mm256_storeu_si256((__m256i *)(arrays._isActive + particleIndex), isActive);
+        deadMask[offset / 32] |= ((unsigned int)_mm256_movemask_ps(hasDied) << (offset % 32));
+    }
+    StepParticleRangeScalar(arrays, firstParticle, vectorEnd, particleCount, step, deadMask);
+}
+#endif
+
+#ifdef PARTICLE_SIMD_HAS_AVX512
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The SSE4.1 kernel, 16 lanes wide (see StepParticlesSse41(...)).  AVX-512 compares into mask
+    registers, so the lanes' alive masks are 16-bit integers, the blends are masked moves, and
+    the dead mask comes straight out of the compare.
+Parameters: See ParticleSimdKernel.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+PARTICLE_SIMD_TARGET("avx512f")
+static void StepParticlesAvx512(const ParticleSimdArrays &arrays, unsigned int firstParticle,
+    unsigned int particleCount, const ParticleSimdStep &step, unsigned int *deadMask)
+{
+    ClearDeadMask(particleCount, deadMask);
+    const __m512 centerX = _mm512_set1_ps(step._centerX);
+    const __m512 centerY = _mm512_set1_ps(step._centerY);
+    const __m512 radiusSqr = _mm512_set1_ps(step._radiusSqr);
+    const __m512 stepSec = _mm512_set1_ps(step._stepSec);
+    const __m512 agePerStep = _mm512_set1_ps(step._agePerStep);
+    const __m512 one = _mm512_set1_ps(1.0f);
+    const __m512 zeroFloats = _mm512_setzero_ps();
+    const __m512i zero = _mm512_setzero_si512();
+
+    unsigned int vectorEnd = particleCount - (particleCount % 16);
+    for (unsigned int offset = 0; offset < vectorEnd; offset += 16)
+    {
+        unsigned int particleIndex = firstParticle + offset;
+        __m512i isActive = _mm512_loadu_si512((const void *)(arrays._isActive + particleIndex));
+        __mmask16 wasActive = _mm512_cmpneq_epi32_mask(isActive, zero);
+        if (wasActive == 0)
+        {
+            continue;
+        }
+
+        __m512 x = _mm512_loadu_ps(arrays._positionsX + particleIndex);
+        __m512 y = _mm512_loadu_ps(arrays._positionsY + particleIndex);
+        __m512 velocityX = _mm512_loadu_ps(arrays._velocitiesX + particleIndex);
+        __m512 velocityY = _mm512_loadu_ps(arrays._velocitiesY + particleIndex);
+        __m512 age = _mm512_loadu_ps(arrays._ages + particleIndex);
+        __mmask16 isAlive = wasActive;
+        for (unsigned int stepIndex = 0; stepIndex < step._stepCount; stepIndex++)
+        {
+            __m512 movedX = _mm512_add_ps(x, _mm512_mul_ps(velocityX, stepSec));
+            __m512 movedY = _mm512_add_ps(y, _mm512_mul_ps(velocityY, stepSec));
+            __m512 agedAge = _mm512_add_ps(age, agePerStep);
+            x = _mm512_mask_mov_ps(x, isAlive, movedX);
+            y = _mm512_mask_mov_ps(y, isAlive, movedY);
+            age = _mm512_mask_mov_ps(age, isAlive, agedAge);
+
+            __m512 dx = _mm512_sub_ps(movedX, centerX);
+            __m512 dy = _mm512_sub_ps(movedY, centerY);
+            __m512 distSqr = _mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy));
+            isAlive = _mm512_mask_cmp_ps_mask(isAlive, distSqr, radiusSqr, _CMP_LE_OQ);
+            isAlive = _mm512_mask_cmp_ps_mask(isAlive, agedAge, one, _CMP_LT_OQ);
+            if (isAlive == 0)
+            {
+                break;
+            }
+        }
+
+        __mmask16 hasDied = (__mmask16)(wasActive & ~isAlive);
+        age = _mm512_mask_mov_ps(age, hasDied, zeroFloats);
+        isActive = _mm512_maskz_mov_epi32(isAlive, isActive);
+        _mm512_storeu_ps(arrays._positionsX + particleIndex, x);
+        _mm512_storeu_ps(arrays._positionsY + particleIndex, y);
+        _mm512_storeu_ps(arrays._ages + particleIndex, age);
+        _mm512_storeu_si512((void *)(arrays._isActive + particleIndex), isActive);
+        deadMask[offset / 32] |= ((unsigned int)hasDied << (offset % 32));
+    }
+    StepParticleRangeScalar(arrays, firstParticle, vectorEnd, particleCount, step, deadMask);
+}
+#endif
+
+#ifdef PARTICLE_SIMD_HAS_NEON
+/*-----------------------------------------------------------------------------------------------
+Description:
+    NEON's version of _mm_movemask_ps(...): bit i is set if lane i's mask is set.  ARMv7 has no
+    horizontal add across a whole register, so the lanes' bits are added in pairs.
+Parameters:
+    mask    Each lane is all 1s or all 0s.
+Returns:
+    The lanes' bits.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+static unsigned int GetNeonLaneBits(uint32x4_t mask)
+{
+    static const uint32_t laneBitValues[4] = { 1, 2, 4, 8 };
+    uint32x4_t laneBits = vandq_u32(mask, vld1q_u32(laneBitValues));
+    uint32x2_t pairSums = vpadd_u32(vget_low_u32(laneBits), vget_high_u32(laneBits));
+    pairSums = vpadd_u32(pairSums, pairSums);
+    return vget_lane_u32(pairSums, 0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The SSE4.1 kernel for NEON (see StepParticlesSse41(...)).  The selects are vbslq_f32(...),
+    which is a bitwise blend, so the masks must be all 1s or all 0s per lane, and the compares
+    make them that way.
+Parameters: See ParticleSimdKernel.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+static void StepParticlesNeon(const ParticleSimdArrays &arrays, unsigned int firstParticle,
+    unsigned int particleCount, const ParticleSimdStep &step, unsigned int *deadMask)
+{
+    ClearDeadMask(particleCount, deadMask);
+    const float32x4_t centerX = vdupq_n_f32(step._centerX);
+    const float32x4_t centerY = vdupq_n_f32(step._centerY);
+    const float32x4_t radiusSqr = vdupq_n_f32(step._radiusSqr);
+    const float32x4_t stepSec = vdupq_n_f32(step._stepSec);
+    const float32x4_t agePerStep = vdupq_n_f32(step._agePerStep);
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    const int32x4_t zero = vdupq_n_s32(0);
+
+    unsigned int vectorEnd = particleCount - (particleCount % 4);
+    for (unsigned int offset = 0; offset < vectorEnd; offset += 4)
+    {
+        unsigned int particleIndex = firstParticle + offset;
+        int32x4_t isActive = vld1q_s32(arrays._isActive + particleIndex);
+        uint32x4_t wasActive = vmvnq_u32(vceqq_s32(isActive, zero));
+        if (GetNeonLaneBits(wasActive) == 0)
+        {
+            continue;
+        }
+
+        float32x4_t x = vld1q_f32(arrays._positionsX + particleIndex);
+        float32x4_t y = vld1q_f32(arrays._positionsY + particleIndex);
+        float32x4_t velocityX = vld1q_f32(arrays._velocitiesX + particleIndex);
+        float32x4_t velocityY = vld1q_f32(arrays._velocitiesY + particleIndex);
+        float32x4_t age = vld1q_f32(arrays._ages + particleIndex);
+        uint32x4_t isAlive = wasActive;
+        for (unsigned int stepIndex = 0; stepIndex < step._stepCount; stepIndex++)
+        {
+            // Note: vmulq then vaddq instead of vmlaq, which the compiler is allowed to turn
+            // into a fused multiply-add that rounds differently from the scalar kernel.
+            float32x4_t movedX = vaddq_f32(x, vmulq_f32(velocityX, stepSec));
+            float32x4_t movedY = vaddq_f32(y, vmulq_f32(velocityY, stepSec));
+            float32x4_t agedAge = vaddq_f32(age, agePerStep);
+            x = vbslq_f32(isAlive, movedX, x);
+            y = vbslq_f32(isAlive, movedY, y);
+            age = vbslq_f32(isAlive, agedAge, age);
+
+            float32x4_t dx = vsubq_f32(movedX, centerX);
+            float32x4_t dy = vsubq_f32(movedY, centerY);
+            float32x4_t distSqr = vaddq_f32(vmulq_f32(dx, dx), vmulq_f32(dy, dy));
+            uint32x4_t isInside = vandq_u32(vcleq_f32(distSqr, radiusSqr),
+                vcltq_f32(agedAge, one));
+            isAlive = vandq_u32(isAlive, isInside);
+            if (GetNeonLaneBits(isAlive) == 0)
+            {
+                break;
+            }
+        }
+
+        uint32x4_t hasDied = vbicq_u32(wasActive, isAlive);
+        age = vreinterpretq_f32_u32(vbicq_u32(vreinterpretq_u32_f32(age), hasDied));
+        isActive = vandq_s32(isActive, vreinterpretq_s32_u32(isAlive));
+        vst1q_f32(arrays._positionsX + particleIndex, x);
+        vst1q_f32(arrays._positionsY + particleIndex, y);
+        vst1q_f32(arrays._ages + particleIndex, age);
+        vst1q_s32(arrays._isActive + particleIndex, isActive);
+        deadMask[offset / 32] |= (GetNeonLaneBits(hasDied) << (offset % 32));
+    }
+    StepParticleRangeScalar(arrays, firstParticle, vectorEnd, particleCount, step, deadMask);
+}
+#endif
+
+#ifdef PARTICLE_SIMD_HAS_X86
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    leaf            EAX going in.
+    subleaf         ECX going in.
+    putRegistersHere    EAX, EBX, ECX, and EDX coming out.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+static void GetCpuid(unsigned int leaf, unsigned int subleaf, unsigned int putRegistersHere[4])
+{
+#ifdef _MSC_VER
+    int registers[4] = { 0, 0, 0, 0 };
+    __cpuidex(registers, (int)leaf, (int)subleaf);
+    for (int registerIndex = 0; registerIndex < 4; registerIndex++)
+    {
+        putRegistersHere[registerIndex] = (unsigned int)registers[registerIndex];
+    }
+#else
+    __cpuid_count(leaf, subleaf, putRegistersHere[0], putRegistersHere[1], putRegistersHere[2],
+        putRegistersHere[3]);
+#endif
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Reads XCR0, which says which registers the OS saves when it switches threads.  A CPU may
+    have AVX while the OS doesn't save the upper halves of the registers, and then AVX isn't
+    safe to use.  Only call this if CPUID says that the OS has turned XGETBV on (OSXSAVE).
+Parameters: None
+Returns:
+    XCR0.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+static unsigned long long GetXcr0()
+{
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    unsigned int low = 0;
+    unsigned int high = 0;
+    __asm__ volatile ("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+    return ((unsigned long long)high << 32) | low;
+#endif
+}
+
+// which kernels this CPU and OS can run (see GetSupportedX86Levels())
+static bool sIsX86Detected = false;
+static bool sIsSse41Supported = false;
+static bool sIsAvx2Supported = false;
+static bool sIsAvx512Supported = false;
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Asks CPUID which instruction sets the CPU has, and XCR0 whether the OS saves the registers
+    that they use.  Only done once.
+
+    Note: Not thread-safe the first time, but it only writes the same values each time.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+static void DetectX86Levels()
+{
+    if (sIsX86Detected)
+    {
+        return;
+    }
+    sIsX86Detected = true;
+
+    unsigned int registers[4] = { 0, 0, 0, 0 };
+    GetCpuid(0, 0, registers);
+    unsigned int maxLeaf = registers[0];
+    if (maxLeaf < 1)
+    {
+        return;
+    }
+
+    GetCpuid(1, 0, registers);
+    unsigned int leaf1Ecx = registers[2];
+    sIsSse41Supported = (leaf1Ecx & (1u << 19)) != 0;
+    bool isOsXsaveOn = (leaf1Ecx & (1u << 27)) != 0;
+    bool hasAvx = (leaf1Ecx & (1u << 28)) != 0;
+    if (!isOsXsaveOn || !hasAvx || maxLeaf < 7)
+    {
+        return;
+    }
+
+    // XMM and YMM state for AVX, and also the mask registers and the upper ZMM state for
+    // AVX-512
+    unsigned long long xcr0 = GetXcr0();
+    bool isYmmSaved = (xcr0 & 0x06) == 0x06;
+    bool isZmmSaved = (xcr0 & 0xe6) == 0xe6;
+
+    GetCpuid(7, 0, registers);
+    unsigned int leaf7Ebx = registers[1];
+    sIsAvx2Supported = isYmmSaved && (leaf7Ebx & (1u << 5)) != 0;
+    sIsAvx512Supported = isZmmSaved && (leaf7Ebx & (1u << 16)) != 0;
+}
+#endif
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Checks whether this build has the kernel and this machine can run it.
+Parameters:
+    level   Self-explanatory.
+Returns:
+    True if GetParticleSimdKernel(...) can be called with the level, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+bool IsParticleSimdLevelSupported(ParticleSimdLevel level)
+{
+    if (level == PARTICLE_SIMD_SCALAR)
+    {
+        return true;
+    }
+#ifdef PARTICLE_SIMD_HAS_X86
+    DetectX86Levels();
+    if (level == PARTICLE_SIMD_SSE41)
+    {
+        return sIsSse41Supported;
+    }
+    if (level == PARTICLE_SIMD_AVX2)
+    {
+        return sIsAvx2Supported;
+    }
+#ifdef PARTICLE_SIMD_HAS_AVX512
+    if (level == PARTICLE_SIMD_AVX512)
+    {
+        return sIsAvx512Supported;
+    }
+#endif
+#endif
+#ifdef PARTICLE_SIMD_HAS_NEON
+    if (level == PARTICLE_SIMD_NEON)
+    {
+        return true;
+    }
+#endif
+    return false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Picks the widest kernel that this machine can run.
+Parameters: None
+Returns:
+    See ParticleSimdLevel.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleSimdLevel GetBestParticleSimdLevel()
+{
+    const ParticleSimdLevel preferredLevels[] =
+    {
+        PARTICLE_SIMD_AVX512,
+        PARTICLE_SIMD_AVX2,
+        PARTICLE_SIMD_SSE41,
+        PARTICLE_SIMD_NEON,
+    };
+    unsigned int levelCount = sizeof(preferredLevels) / sizeof(preferredLevels[0]);
+    for (unsigned int levelIndex = 0; levelIndex < levelCount; levelIndex++)
+    {
+        if (IsParticleSimdLevelSupported(preferredLevels[levelIndex]))
+        {
+            return preferredLevels[levelIndex];
+        }
+    }
+    return PARTICLE_SIMD_SCALAR;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    level   Self-explanatory.
+Returns:
+    The level's kernel, or the scalar one if the level isn't supported (see
+    IsParticleSimdLevelSupported(...)).
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleSimdKernel GetParticleSimdKernel(ParticleSimdLevel level)
+{
+    if (!IsParticleSimdLevelSupported(level))
+    {
+        return StepParticlesScalar;
+    }
+#ifdef PARTICLE_SIMD_HAS_X86
+    if (level == PARTICLE_SIMD_SSE41)
+    {
+        return StepParticlesSse41;
+    }
+    if (level == PARTICLE_SIMD_AVX2)
+    {
+        return StepParticlesAvx2;
+    }
+#ifdef PARTICLE_SIMD_HAS_AVX512
+    if (level == PARTICLE_SIMD_AVX512)
+    {
+        return StepParticlesAvx512;
+    }
+#endif
+#endif
+#ifdef PARTICLE_SIMD_HAS_NEON
+    if (level == PARTICLE_SIMD_NEON)
+    {
+        return StepParticlesNeon;
+    }
+#endif
+    return StepParticlesScalar;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    level   Self-explanatory.
+Returns:
+    How many particles the level's kernel does per instruction.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int GetParticleSimdLaneCount(ParticleSimdLevel level)
+{
+    if (level == PARTICLE_SIMD_SSE41 || level == PARTICLE_SIMD_NEON)
+    {
+        return 4;
+    }
+    else if (level == PARTICLE_SIMD_AVX2)
+    {
+        return 8;
+    }
+    else if (level == PARTICLE_SIMD_AVX512)
+    {
+        return 16;
+    }
+    return 1;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    level   Self-explanatory.
+Returns:
+    A short name for logs and the benchmark's CSV.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+const char *GetParticleSimdLevelName(ParticleSimdLevel level)
+{
+    if (level == PARTICLE_SIMD_SSE41)
+    {
+        return "sse4.1";
+    }
+    else if (level == PARTICLE_SIMD_AVX2)
+    {
+        return "avx2";
+    }
+    else if (level == PARTICLE_SIMD_AVX512)
+    {
+        return "avx512";
+    }
+    else if (level == PARTICLE_SIMD_NEON)
+    {
+        return "neon";
+    }
+    return "scalar";
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Vectorized versions of the CPU backend's inner loop (see
+    ParticleManager::SetSimulationBackend(...)): move a run of particles through several steps,
+    test them against their emitter's circle and lifetime, and report the ones that died in a
+    bitmask, 4 to 16 particles per instruction.
+
+    There is one kernel per instruction set, written with intrinsics, and a plain C++ one for
+    everything else.  The x86 kernels are compiled into every build and picked at run time by
+    what the CPU (and the OS, for the wider registers) says it supports, since an instruction
+    that the CPU doesn't have crashes the program.  NEON is part of every ARMv8 CPU and is
+    picked at compile time.
+
+    Note: The kernels are for particles that only coast.  The force fields need a square root
+    and a loop per particle, so ParticleManager keeps its scalar loop for those.
+    Also Note: Every kernel gives bit-for-bit the same results as the scalar one.  The toolset
+    compiles float math to SSE on x86 either way, and there are no fused multiply-adds.
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+
+// the instruction sets that there are kernels for
+// Note: Printed as a name in the benchmark (see GetParticleSimdLevelName(...)).
+enum ParticleSimdLevel
+{
+    PARTICLE_SIMD_SCALAR = 0,   // no intrinsics; 1 particle at a time
+    PARTICLE_SIMD_SSE41,        // 4 particles
+    PARTICLE_SIMD_AVX2,         // 8 particles
+    PARTICLE_SIMD_AVX512,       // 16 particles
+    PARTICLE_SIMD_NEON,         // 4 particles
+    PARTICLE_SIMD_LEVEL_COUNT,
+};
+
+// the particles that a kernel runs over, one array per component, indexed by particle
+// Note: No alignment is needed.
+struct ParticleSimdArrays
+{
+    float *_positionsX;
+    float *_positionsY;
+    float *_velocitiesX;
+    float *_velocitiesY;
+    float *_ages;
+    int *_isActive;
+};
+
+// what a kernel does to every particle of its run, which all belong to the same emitter
+struct ParticleSimdStep
+{
+    float _centerX;
+    float _centerY;
+    float _radiusSqr;
+    float _stepSec;
+    float _agePerStep;          // the step over the emitter's lifetime, or 0 for no lifetime
+    unsigned int _stepCount;
+};
+
+// moves the active particles of [firstParticle, firstParticle + particleCount) through
+// _stepCount steps, stopping each one at the step where it leaves the circle or expires, and
+// deactivates the ones that did
+// Note: Bit i of the mask (word i / 32, bit i % 32) is set if particle firstParticle + i died.
+// The mask needs (particleCount + 31) / 32 words, and the kernel clears them first.
+typedef void(*ParticleSimdKernel)(const ParticleSimdArrays &arrays, unsigned int firstParticle,
+    unsigned int particleCount, const ParticleSimdStep &step, unsigned int *deadMask);
+
+bool IsParticleSimdLevelSupported(ParticleSimdLevel level);
+ParticleSimdLevel GetBestParticleSimdLevel();
+ParticleSimdKernel GetParticleSimdKernel(ParticleSimdLevel level);
+unsigned int GetParticleSimdLaneCount(ParticleSimdLevel level);
+const char *GetParticleSimdLevelName(ParticleSimdLevel level);
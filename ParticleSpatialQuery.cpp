@@ -0,0 +1,388 @@
+#include "ParticleSpatialQuery.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
+#include "GlFenceSync.h"
+#include "Log.h"
+
+#include <string.h>     // memcpy
+
+// must match SpatialQuery in shaderParticle.comp (std430; a vec4 and a uvec4)
+static const size_t SPATIAL_QUERY_SIZE_BYTES = 32;
+
+// must match SPATIAL_QUERY_RESULT_STRIDE in shaderParticle.comp: the count, then an index and
+// a distance for each of the nearest
+static const unsigned int SPATIAL_QUERY_RESULT_STRIDE = 1 + (2 * PARTICLE_QUERY_MAX_NEAREST);
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.  Nothing is queried until Init().
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleSpatialQuery::ParticleSpatialQuery() :
+    _mappedQueries(0),
+    _mappedResults(0),
+    _querySlotSizeBytes(0),
+    _resultSlotSizeBytes(0),
+    _nextSlot(0),
+    _nextQueryId(1)
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleSpatialQuery::~ParticleSpatialQuery()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Creates the ring of query and result slots.  The queries run in the neighbor grid's
+    program, so there is no program of its own.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleSpatialQuery::Init()
+{
+    this->Cleanup();
+
+    // the bindings come after everyone else's
+    GLint maxBindings = 0;
+    glGetIntegerv(GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS, &maxBindings);
+    if (maxBindings <= (GLint)QUERY_RESULT_BUFFER_BINDING)
+    {
+        LogPrintf("the spatial queries need %u shader storage bindings, but there are only %d\n",
+            QUERY_RESULT_BUFFER_BINDING + 1, maxBindings);
+        return;
+    }
+
+    GLint offsetAlignment = 1;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+    offsetAlignment = (offsetAlignment > 0) ? offsetAlignment : 1;
+    size_t querySizeBytes = MAX_QUERIES_PER_BATCH * SPATIAL_QUERY_SIZE_BYTES;
+    _querySlotSizeBytes = ((querySizeBytes + offsetAlignment - 1) / offsetAlignment) *
+        offsetAlignment;
+    size_t resultSizeBytes =
+        MAX_QUERIES_PER_BATCH * SPATIAL_QUERY_RESULT_STRIDE * sizeof(unsigned int);
+    _resultSlotSizeBytes = ((resultSizeBytes + offsetAlignment - 1) / offsetAlignment) *
+        offsetAlignment;
+
+    // the CPU writes the queries and reads the results straight through the mappings, and
+    // the fences keep it off of the slots that the GPU is still using
+    GLbitfield writeFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    GLsizeiptr queryBufferSize = QUERY_SLOTS * _querySlotSizeBytes;
+    _queryBufferId = GenerateGlBuffer();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _queryBufferId);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, queryBufferSize, 0, writeFlags);
+    _mappedQueries = (unsigned char *)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0,
+        queryBufferSize, writeFlags);
+
+    GLbitfield readFlags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    GLsizeiptr resultBufferSize = QUERY_SLOTS * _resultSlotSizeBytes;
+    _resultBufferId = GenerateGlBuffer();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _resultBufferId);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, resultBufferSize, 0, readFlags);
+    _mappedResults = (const unsigned char *)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0,
+        resultBufferSize, readFlags);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Deletes the buffers and fences.  The queued queries and the ones that the GPU hadn't
+    finished are dropped without calling their callbacks.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleSpatialQuery::Cleanup()
+{
+    for (unsigned int slotIndex = 0; slotIndex < QUERY_SLOTS; slotIndex++)
+    {
+        _fences[slotIndex].Reset();
+        _slotQueries[slotIndex].clear();
+    }
+    _queryBufferId.Reset();
+    _resultBufferId.Reset();
+    _mappedQueries = 0;
+    _mappedResults = 0;
+    _nextSlot = 0;
+    _queue.clear();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Queues a count of the active particles in a rectangle (edges included).
+Parameters:
+    minCorner   Self-explanatory.  In the same space as the particles' positions.
+    maxCorner   Self-explanatory.
+    callback    Called from a later Update(...) with the count.
+Returns:
+    The query's ID, which is in its result.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleSpatialQuery::QueueRectangleQuery(const glm::vec2 &minCorner,
+    const glm::vec2 &maxCorner, const ParticleSpatialQueryCallback &callback)
+{
+    return this->Queue(PARTICLE_QUERY_RECTANGLE, minCorner.x, minCorner.y, maxCorner.x,
+        maxCorner.y, 0, callback);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Queues a count of the active particles in a circle (edge included).
+Parameters:
+    center      Self-explanatory.  In the same space as the particles' positions.
+    radius      Self-explanatory.
+    callback    Called from a later Update(...) with the count.
+Returns:
+    The query's ID, which is in its result.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleSpatialQuery::QueueCircleQuery(const glm::vec2 &center, float radius,
+    const ParticleSpatialQueryCallback &callback)
+{
+    return this->Queue(PARTICLE_QUERY_CIRCLE, center.x, center.y, radius, 0.0f, 0, callback);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Queues a search for the nearest few active particles to a point.
+Parameters:
+    point           Self-explanatory.  In the same space as the particles' positions.
+    count           How many to find.  Clamped to PARTICLE_QUERY_MAX_NEAREST.
+    maxDistance     Particles farther away than this aren't found.  0 has no limit.
+    callback        Called from a later Update(...) with the particles, nearest first.
+Returns:
+    The query's ID, which is in its result.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleSpatialQuery::QueueNearestQuery(const glm::vec2 &point, unsigned int count,
+    float maxDistance, const ParticleSpatialQueryCallback &callback)
+{
+    count = (count < PARTICLE_QUERY_MAX_NEAREST) ? count : PARTICLE_QUERY_MAX_NEAREST;
+    maxDistance = (maxDistance > 0.0f) ? maxDistance : 0.0f;
+    return this->Queue(PARTICLE_QUERY_NEAREST, point.x, point.y, maxDistance, 0.0f, count,
+        callback);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How many queries are waiting for a batch.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleSpatialQuery::GetQueuedCount() const
+{
+    return (unsigned int)_queue.size();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How many queries have run on the GPU but haven't had their callbacks called yet.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleSpatialQuery::GetPendingCount() const
+{
+    unsigned int pendingCount = 0;
+    for (unsigned int slotIndex = 0; slotIndex < QUERY_SLOTS; slotIndex++)
+    {
+        pendingCount += (unsigned int)_slotQueries[slotIndex].size();
+    }
+    return pendingCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls the callbacks of every batch that the GPU has finished, and runs the next batch of
+    queued queries if a slot is free.  Call it once a frame, right after the grid is built.
+Parameters:
+    grid    Must have been built this frame.  If it wasn't, the queries stay queued.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleSpatialQuery::Update(ParticleNeighborGrid *grid)
+{
+    if (_mappedQueries == 0 || _mappedResults == 0)
+    {
+        return;
+    }
+
+    this->CollectFinishedSlots();
+    if (_queue.empty())
+    {
+        return;
+    }
+    if (_fences[_nextSlot] != 0)
+    {
+        // the GPU is more than a ring behind; try again next frame rather than wait
+        return;
+    }
+
+    this->RunBatch(grid);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Adds a query to the back of the queue.
+Parameters:
+    type            Self-explanatory.
+    shape0-3        The shape, as SpatialQuery::_shape in shaderParticle.comp has it.
+    nearestCount    0 for the region queries.
+    callback        Self-explanatory.
+Returns:
+    The query's ID.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleSpatialQuery::Queue(ParticleSpatialQueryType type, float shape0,
+    float shape1, float shape2, float shape3, unsigned int nearestCount,
+    const ParticleSpatialQueryCallback &callback)
+{
+    QueuedQuery query;
+    query._queryId = _nextQueryId++;
+    query._type = type;
+    query._shape[0] = shape0;
+    query._shape[1] = shape1;
+    query._shape[2] = shape2;
+    query._shape[3] = shape3;
+    query._params[0] = (unsigned int)type;
+    query._params[1] = nearestCount;
+    query._params[2] = 0;
+    query._params[3] = 0;
+    query._callback = callback;
+    _queue.push_back(query);
+    return query._queryId;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls the callbacks of every batch whose fence has signaled, oldest first, and frees
+    their slots.  Never waits.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleSpatialQuery::CollectFinishedSlots()
+{
+    for (unsigned int slotOffset = 0; slotOffset < QUERY_SLOTS; slotOffset++)
+    {
+        unsigned int slotIndex = (_nextSlot + slotOffset) % QUERY_SLOTS;
+        if (_fences[slotIndex] == 0)
+        {
+            continue;
+        }
+
+        if (!IsGlFenceSignaled(_fences[slotIndex]))
+        {
+            // the later ones can't be done either
+            break;
+        }
+        _fences[slotIndex].Reset();
+
+        // taken out of the slot first, since a callback is free to queue more queries
+        std::vector<QueuedQuery> finishedQueries;
+        finishedQueries.swap(_slotQueries[slotIndex]);
+        const unsigned int *slotResults =
+            (const unsigned int *)(_mappedResults + (slotIndex * _resultSlotSizeBytes));
+        for (size_t queryIndex = 0; queryIndex < finishedQueries.size(); queryIndex++)
+        {
+            const QueuedQuery &query = finishedQueries[queryIndex];
+            const unsigned int *queryResult =
+                slotResults + (queryIndex * SPATIAL_QUERY_RESULT_STRIDE);
+
+            ParticleSpatialQueryResult result;
+            memset(&result, 0, sizeof(result));
+            result._queryId = query._queryId;
+            result._type = query._type;
+            result._count = queryResult[0];
+            if (query._type == PARTICLE_QUERY_NEAREST)
+            {
+                // the GPU never finds more than were asked for, but the mapping is trusted no
+                // further than it has to be
+                result._count = (result._count < query._params[1]) ?
+                    result._count : query._params[1];
+                for (unsigned int nearestIndex = 0; nearestIndex < result._count;
+                    nearestIndex++)
+                {
+                    result._nearestIndices[nearestIndex] = queryResult[1 + (2 * nearestIndex)];
+                    memcpy(&result._nearestDistances[nearestIndex],
+                        &queryResult[2 + (2 * nearestIndex)], sizeof(float));
+                }
+            }
+
+            if (query._callback)
+            {
+                query._callback(result);
+            }
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Writes the front of the queue into the next slot, has the grid run it, and fences it.
+Parameters:
+    grid    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleSpatialQuery::RunBatch(ParticleNeighborGrid *grid)
+{
+    unsigned int slotIndex = _nextSlot;
+    unsigned int queryCount = (unsigned int)_queue.size();
+    queryCount = (queryCount < MAX_QUERIES_PER_BATCH) ? queryCount : MAX_QUERIES_PER_BATCH;
+
+    unsigned char *slotQueries = _mappedQueries + (slotIndex * _querySlotSizeBytes);
+    for (unsigned int queryIndex = 0; queryIndex < queryCount; queryIndex++)
+    {
+        unsigned char *gpuQuery = slotQueries + (queryIndex * SPATIAL_QUERY_SIZE_BYTES);
+        memcpy(gpuQuery, _queue[queryIndex]._shape, sizeof(_queue[queryIndex]._shape));
+        memcpy(gpuQuery + sizeof(_queue[queryIndex]._shape), _queue[queryIndex]._params,
+            sizeof(_queue[queryIndex]._params));
+    }
+
+    BindGlShaderStorageBufferRange(QUERY_BUFFER_BINDING, _queryBufferId,
+        slotIndex * _querySlotSizeBytes, queryCount * SPATIAL_QUERY_SIZE_BYTES);
+    BindGlShaderStorageBufferRange(QUERY_RESULT_BUFFER_BINDING, _resultBufferId,
+        slotIndex * _resultSlotSizeBytes,
+        queryCount * SPATIAL_QUERY_RESULT_STRIDE * sizeof(unsigned int));
+    if (!grid->RunQueries(queryCount))
+    {
+        // the grid wasn't built this frame; the queries wait for one that is
+        return;
+    }
+
+    // the CPU reads the slot through the persistent mapping once the fence has signaled
+    glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+    _fences[slotIndex] = InsertGlFence();
+    _slotQueries[slotIndex].assign(_queue.begin(), _queue.begin() + queryCount);
+    _queue.erase(_queue.begin(), _queue.begin() + queryCount);
+    _nextSlot = (_nextSlot + 1) % QUERY_SLOTS;
+}
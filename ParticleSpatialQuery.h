@@ -0,0 +1,123 @@
+#pragma once
+
+#include "ParticleNeighborGrid.h"
+#include "GlObjects.h"
+
+#include "glm/vec2.hpp"
+
+#include <functional>
+#include <vector>
+
+// what a spatial query asks; must match the SPATIAL_QUERY_* defines in shaderParticle.comp
+enum ParticleSpatialQueryType
+{
+    // how many active particles are in a rectangle or a circle
+    PARTICLE_QUERY_RECTANGLE = 0,
+    PARTICLE_QUERY_CIRCLE,
+
+    // the nearest few active particles to a point
+    PARTICLE_QUERY_NEAREST,
+};
+
+// a finished query, as handed to its callback
+// Note: For a region query, _count is the number of particles inside it.  For a nearest query,
+// it is the number that were found (fewer than asked for if there weren't that many within
+// the max distance), and they are in the arrays, nearest first.  The indices are slots of the
+// pool as of the frame that the query ran, which may not be the same particles by the time
+// that the callback is called (ex: after they have died, or been sorted).
+static const unsigned int PARTICLE_QUERY_MAX_NEAREST = 16;
+struct ParticleSpatialQueryResult
+{
+    unsigned int _queryId;
+    ParticleSpatialQueryType _type;
+    unsigned int _count;
+    unsigned int _nearestIndices[PARTICLE_QUERY_MAX_NEAREST];
+    float _nearestDistances[PARTICLE_QUERY_MAX_NEAREST];
+};
+typedef std::function<void(const ParticleSpatialQueryResult &)> ParticleSpatialQueryCallback;
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Answers questions about where the particles are (how many are in this rectangle or
+    circle, which are the nearest few to this point) on the GPU, so that gameplay and
+    analytics code doesn't have to read back the whole pool, which is megabytes, to ask them.
+
+    Queries are queued on the CPU with a callback, and Update(...) runs every query in the
+    queue as one batch: one dispatch of the neighbor grid's program, with a work group per
+    query, which reads only the grid cells around the query (see
+    ParticleNeighborGrid::RunQueries(...)).  The queries and the results are in a ring of
+    persistently mapped slots with a fence each, like the stats reducer's readback (see
+    ParticleStatsReducer.h), and a later Update(...) calls the callbacks once a batch's fence
+    has signaled, so nothing ever waits on the GPU.  A result costs a few hundred bytes of
+    readback and is usually ready 2 or 3 frames after the query was queued.
+
+    The grid must be built (see ParticleNeighborGrid::Build(...)) in the same frame as, and
+    before, Update(...), and the queries only see particles that are in the grid, which is all
+    of the active ones.
+
+    Note: A region query splits its cells between its work group's work items, so a big
+    region is fine, but a nearest query searches outward from its point on one work item, so
+    it is best kept to regions that aren't packed with particles (or given a max distance).
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class ParticleSpatialQuery
+{
+public:
+    ParticleSpatialQuery();
+    ~ParticleSpatialQuery();
+    void Init();
+    void Cleanup();
+
+    unsigned int QueueRectangleQuery(const glm::vec2 &minCorner, const glm::vec2 &maxCorner,
+        const ParticleSpatialQueryCallback &callback);
+    unsigned int QueueCircleQuery(const glm::vec2 &center, float radius,
+        const ParticleSpatialQueryCallback &callback);
+    unsigned int QueueNearestQuery(const glm::vec2 &point, unsigned int count,
+        float maxDistance, const ParticleSpatialQueryCallback &callback);
+    unsigned int GetQueuedCount() const;
+    unsigned int GetPendingCount() const;
+
+    void Update(ParticleNeighborGrid *grid);
+
+    // one dispatch runs at most this many; the rest wait for the next Update(...)
+    static const unsigned int MAX_QUERIES_PER_BATCH = 64;
+
+private:
+    // a query on the CPU side, waiting for its batch or its result
+    // Note: _shape and _params are the std430 layout of SpatialQuery in shaderParticle.comp.
+    struct QueuedQuery
+    {
+        unsigned int _queryId;
+        ParticleSpatialQueryType _type;
+        float _shape[4];
+        unsigned int _params[4];
+        ParticleSpatialQueryCallback _callback;
+    };
+
+    unsigned int Queue(ParticleSpatialQueryType type, float shape0, float shape1, float shape2,
+        float shape3, unsigned int nearestCount, const ParticleSpatialQueryCallback &callback);
+    void CollectFinishedSlots();
+    void RunBatch(ParticleNeighborGrid *grid);
+
+    // Note: The bindings must match shaderParticle.comp.  They come after the constraint
+    // solver's (see ParticleConstraintSolver.h).
+    static const unsigned int QUERY_BUFFER_BINDING = 61;
+    static const unsigned int QUERY_RESULT_BUFFER_BINDING = 62;
+
+    // 3 frames of GPU latency, plus 1 for the one that is being written
+    // Note: Each slot has its batch's queries and room for their results, and each starts on
+    // a storage buffer offset boundary so that it can be bound on its own.
+    static const unsigned int QUERY_SLOTS = 4;
+    GlBuffer _queryBufferId;
+    GlBuffer _resultBufferId;
+    unsigned char *_mappedQueries;
+    const unsigned char *_mappedResults;
+    size_t _querySlotSizeBytes;
+    size_t _resultSlotSizeBytes;
+    GlFence _fences[QUERY_SLOTS];
+    std::vector<QueuedQuery> _slotQueries[QUERY_SLOTS];
+    unsigned int _nextSlot;
+
+    std::vector<QueuedQuery> _queue;
+    unsigned int _nextQueryId;
+};
@@ -0,0 +1,501 @@
+#include "ParticleStateSharedMemory.h"
+
+#include "ParticleLayoutDescriptor.h"
+#include "Log.h"
+
+#include <string.h>
+
+#ifdef WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// the sequence numbers are read and written by other processes, so they must not need a lock
+static_assert(sizeof(std::atomic<unsigned int>) == sizeof(unsigned int),
+    "The shared memory's atomics must be plain 32-bit words");
+
+// every section starts on a cache line, so no two slots share one
+static const size_t SHM_SECTION_ALIGNMENT = 64;
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    sizeBytes   Self-explanatory.
+Returns:
+    The size rounded up to SHM_SECTION_ALIGNMENT.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static size_t AlignShmSection(size_t sizeBytes)
+{
+    return ((sizeBytes + SHM_SECTION_ALIGNMENT - 1) / SHM_SECTION_ALIGNMENT) *
+        SHM_SECTION_ALIGNMENT;
+}
+
+#ifndef WIN32
+/*-----------------------------------------------------------------------------------------------
+Description:
+    POSIX wants the name of a shared memory object to start with a '/' and have no others.
+Parameters:
+    name    Ex: "particles".
+Returns:
+    Ex: "/particles".
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static std::string GetPosixShmName(const std::string &name)
+{
+    return (!name.empty() && name[0] == '/') ? name : "/" + name;
+}
+#endif
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.  There is no shared memory until Init(...).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleStatePublisher::ParticleStatePublisher() :
+    _data(0),
+    _sizeBytes(0),
+    _nextSlot(0),
+    _mappingHandle(0),
+    _fileDescriptor(-1)
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleStatePublisher::~ParticleStatePublisher()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Creates the shared memory, sized for the slots, and writes the header.  No frame is
+    published until the first Publish(...), so the header's published count is 0 until then.
+Parameters:
+    name        Ex: "particles".  An object that is already there with this name is replaced
+                on POSIX, and opened on Windows.
+    layout      The manager's.
+    capacity    The most particles that a frame will have (ex: the readback's range).
+Returns:
+    False if the shared memory couldn't be created or mapped, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleStatePublisher::Init(const std::string &name, ParticleLayout layout,
+    unsigned int capacity)
+{
+    this->Cleanup();
+
+    const ParticleLayoutDescriptor &layoutDescriptor = GetParticleLayoutDescriptor(layout);
+    unsigned int bufferCount = GetParticleBufferCount(layoutDescriptor);
+    size_t headerSizeBytes = AlignShmSection(sizeof(ParticleStateShmHeader));
+    unsigned int bufferStrides[PARTICLE_STATE_SHM_MAX_BUFFERS] = { 0, 0, 0 };
+    size_t bufferOffsets[PARTICLE_STATE_SHM_MAX_BUFFERS] = { 0, 0, 0 };
+    size_t slotSizeBytes = AlignShmSection(sizeof(ParticleStateShmSlotHeader));
+    for (unsigned int bufferIndex = 0; bufferIndex < bufferCount; bufferIndex++)
+    {
+        bufferStrides[bufferIndex] = Std430BufferStride(layoutDescriptor, bufferIndex);
+        bufferOffsets[bufferIndex] = slotSizeBytes;
+        slotSizeBytes += AlignShmSection((size_t)capacity * bufferStrides[bufferIndex]);
+    }
+    size_t particleIdOffset = slotSizeBytes;
+    slotSizeBytes += AlignShmSection((size_t)capacity * sizeof(unsigned int));
+    size_t sizeBytes = headerSizeBytes + (PARTICLE_STATE_SHM_SLOTS * slotSizeBytes);
+
+#ifdef WIN32
+    unsigned long long size64 = sizeBytes;
+    HANDLE mappingHandle = CreateFileMappingA(INVALID_HANDLE_VALUE, 0, PAGE_READWRITE,
+        (DWORD)(size64 >> 32), (DWORD)(size64 & 0xFFFFFFFF), name.c_str());
+    if (mappingHandle == 0)
+    {
+        LogErrorPrintf("couldn't create shared memory '%s'\n", name.c_str());
+        return false;
+    }
+    _mappingHandle = mappingHandle;
+    _data = MapViewOfFile(mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, sizeBytes);
+#else
+    // a stale object from a run that crashed is replaced rather than reused with its old size
+    std::string posixName = GetPosixShmName(name);
+    shm_unlink(posixName.c_str());
+    _fileDescriptor = shm_open(posixName.c_str(), O_CREAT | O_RDWR, 0644);
+    if (_fileDescriptor < 0)
+    {
+        LogErrorPrintf("couldn't create shared memory '%s'\n", posixName.c_str());
+        return false;
+    }
+    _name = posixName;
+    if (ftruncate(_fileDescriptor, (off_t)sizeBytes) != 0)
+    {
+        LogErrorPrintf("couldn't size shared memory '%s'\n", posixName.c_str());
+        this->Cleanup();
+        return false;
+    }
+    void *data = mmap(0, sizeBytes, PROT_READ | PROT_WRITE, MAP_SHARED, _fileDescriptor, 0);
+    _data = (data != MAP_FAILED) ? data : 0;
+#endif
+    if (_data == 0)
+    {
+        LogErrorPrintf("couldn't map shared memory '%s'\n", name.c_str());
+        this->Cleanup();
+        return false;
+    }
+    _sizeBytes = sizeBytes;
+
+    // Note: The slot headers are zeroed with the rest of the new memory (sequence 0, even).
+    ParticleStateShmHeader *sharedHeader = (ParticleStateShmHeader *)_data;
+    sharedHeader->_magic = PARTICLE_STATE_SHM_MAGIC;
+    sharedHeader->_version = PARTICLE_STATE_SHM_VERSION;
+    sharedHeader->_layout = (unsigned int)layout;
+    sharedHeader->_bufferCount = bufferCount;
+    sharedHeader->_capacity = capacity;
+    sharedHeader->_slotCount = PARTICLE_STATE_SHM_SLOTS;
+    sharedHeader->_padding = 0;
+    sharedHeader->_firstSlotOffset = headerSizeBytes;
+    sharedHeader->_slotSizeBytes = slotSizeBytes;
+    for (unsigned int bufferIndex = 0; bufferIndex < PARTICLE_STATE_SHM_MAX_BUFFERS;
+        bufferIndex++)
+    {
+        sharedHeader->_bufferStrides[bufferIndex] = bufferStrides[bufferIndex];
+        sharedHeader->_bufferOffsets[bufferIndex] = bufferOffsets[bufferIndex];
+    }
+    sharedHeader->_particleIdOffset = particleIdOffset;
+    sharedHeader->_latestSlot.store(0, std::memory_order_relaxed);
+    sharedHeader->_publishedCount.store(0, std::memory_order_release);
+    _nextSlot = 0;
+
+    LogPrintf("publishing particle state to shared memory '%s' (%u particles, %u KB)\n",
+        name.c_str(), capacity, (unsigned int)(sizeBytes / 1024));
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Unmaps and removes the shared memory.  Consumers that still have it mapped keep their
+    mapping until they close it, but nothing more is published to it.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleStatePublisher::Cleanup()
+{
+#ifdef WIN32
+    if (_data != 0)
+    {
+        UnmapViewOfFile(_data);
+    }
+    if (_mappingHandle != 0)
+    {
+        CloseHandle((HANDLE)_mappingHandle);
+    }
+#else
+    if (_data != 0)
+    {
+        munmap(_data, _sizeBytes);
+    }
+    if (_fileDescriptor >= 0)
+    {
+        close(_fileDescriptor);
+    }
+    if (!_name.empty())
+    {
+        shm_unlink(_name.c_str());
+    }
+#endif
+    _name.clear();
+    _data = 0;
+    _sizeBytes = 0;
+    _nextSlot = 0;
+    _mappingHandle = 0;
+    _fileDescriptor = -1;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Copies a finished readback into the next slot, under the slot's seqlock, and then makes
+    it the latest.  Meant to be the readback's callback (see
+    ParticleManager::SetParticleReadback(...)).
+Parameters:
+    frame   Particles past the capacity are left out.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleStatePublisher::Publish(const ParticleReadbackFrame &frame)
+{
+    if (_data == 0)
+    {
+        return;
+    }
+
+    ParticleStateShmHeader *header = (ParticleStateShmHeader *)_data;
+    unsigned char *slotStart = (unsigned char *)_data + header->_firstSlotOffset +
+        (_nextSlot * header->_slotSizeBytes);
+    ParticleStateShmSlotHeader *slot = (ParticleStateShmSlotHeader *)slotStart;
+    unsigned int particleCount = (frame._particleCount < header->_capacity) ?
+        frame._particleCount : header->_capacity;
+
+    // odd while writing; the fence keeps the writes below from being seen before it
+    unsigned int sequence = slot->_sequence.load(std::memory_order_relaxed);
+    slot->_sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->_updateIndex = frame._updateIndex;
+    slot->_firstParticle = frame._firstParticle;
+    slot->_particleCount = particleCount;
+    slot->_hasParticleIds = (frame._particleIds != 0) ? 1 : 0;
+    for (unsigned int bufferIndex = 0; bufferIndex < header->_bufferCount; bufferIndex++)
+    {
+        memcpy(slotStart + header->_bufferOffsets[bufferIndex], frame._particleData[bufferIndex],
+            (size_t)particleCount * header->_bufferStrides[bufferIndex]);
+    }
+    if (frame._particleIds != 0)
+    {
+        memcpy(slotStart + header->_particleIdOffset, frame._particleIds,
+            (size_t)particleCount * sizeof(unsigned int));
+    }
+
+    slot->_sequence.store(sequence + 2, std::memory_order_release);
+    header->_latestSlot.store(_nextSlot, std::memory_order_release);
+    header->_publishedCount.fetch_add(1, std::memory_order_release);
+    _nextSlot = (_nextSlot + 1) % header->_slotCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How many frames have been published, or 0 if there is no shared memory.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleStatePublisher::GetPublishedCount() const
+{
+    if (_data == 0)
+    {
+        return 0;
+    }
+    return ((const ParticleStateShmHeader *)_data)->_publishedCount.load(
+        std::memory_order_acquire);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.  There is no shared memory until Open(...).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleStateSubscriber::ParticleStateSubscriber() :
+    _data(0),
+    _sizeBytes(0),
+    _mappingHandle(0),
+    _fileDescriptor(-1)
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Close() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleStateSubscriber::~ParticleStateSubscriber()
+{
+    this->Close();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Maps a publisher's shared memory, read-only, and checks its header.
+Parameters:
+    name    The name that the publisher was given.
+Returns:
+    False if there is no such shared memory or it isn't a publisher's, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleStateSubscriber::Open(const std::string &name)
+{
+    this->Close();
+
+#ifdef WIN32
+    HANDLE mappingHandle = OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+    if (mappingHandle == 0)
+    {
+        LogErrorPrintf("no shared memory '%s'\n", name.c_str());
+        return false;
+    }
+    _mappingHandle = mappingHandle;
+    _data = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    MEMORY_BASIC_INFORMATION viewInfo;
+    if (_data != 0 && VirtualQuery(_data, &viewInfo, sizeof(viewInfo)) != 0)
+    {
+        _sizeBytes = viewInfo.RegionSize;
+    }
+#else
+    std::string posixName = GetPosixShmName(name);
+    _fileDescriptor = shm_open(posixName.c_str(), O_RDONLY, 0);
+    struct stat fileStats;
+    if (_fileDescriptor < 0 || fstat(_fileDescriptor, &fileStats) != 0)
+    {
+        LogErrorPrintf("no shared memory '%s'\n", posixName.c_str());
+        this->Close();
+        return false;
+    }
+    _sizeBytes = (size_t)fileStats.st_size;
+    void *data = (_sizeBytes > 0) ?
+        mmap(0, _sizeBytes, PROT_READ, MAP_SHARED, _fileDescriptor, 0) : MAP_FAILED;
+    _data = (data != MAP_FAILED) ? data : 0;
+#endif
+
+    const ParticleStateShmHeader *header = (const ParticleStateShmHeader *)_data;
+    if (_data == 0 || _sizeBytes < sizeof(ParticleStateShmHeader) ||
+        header->_magic != PARTICLE_STATE_SHM_MAGIC ||
+        header->_version != PARTICLE_STATE_SHM_VERSION ||
+        header->_firstSlotOffset + (header->_slotCount * header->_slotSizeBytes) > _sizeBytes)
+    {
+        LogErrorPrintf("'%s' isn't particle state shared memory\n", name.c_str());
+        this->Close();
+        return false;
+    }
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Unmaps the shared memory.  The publisher's is left alone.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleStateSubscriber::Close()
+{
+#ifdef WIN32
+    if (_data != 0)
+    {
+        UnmapViewOfFile(_data);
+    }
+    if (_mappingHandle != 0)
+    {
+        CloseHandle((HANDLE)_mappingHandle);
+    }
+#else
+    if (_data != 0)
+    {
+        munmap((void *)_data, _sizeBytes);
+    }
+    if (_fileDescriptor >= 0)
+    {
+        close(_fileDescriptor);
+    }
+#endif
+    _data = 0;
+    _sizeBytes = 0;
+    _mappingHandle = 0;
+    _fileDescriptor = -1;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.  Cheap enough to poll for a new frame.
+Parameters: None
+Returns:
+    How many frames have been published, or 0 if nothing is open.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleStateSubscriber::GetPublishedCount() const
+{
+    if (_data == 0)
+    {
+        return 0;
+    }
+    return ((const ParticleStateShmHeader *)_data)->_publishedCount.load(
+        std::memory_order_acquire);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Hands the latest frame to the reader in place, and then checks the slot's seqlock to see
+    whether the publisher wrote over it in the meantime.
+Parameters:
+    reader  Gets the frame the same way as a readback callback.  The pointers are only good
+            for the duration of the call.
+Returns:
+    True if the reader had a whole frame.  False if nothing has been published yet (the
+    reader isn't called), or if the slot changed while it read (the reader's results must be
+    thrown away; try again).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleStateSubscriber::ReadLatest(const ParticleReadbackCallback &reader) const
+{
+    if (_data == 0)
+    {
+        return false;
+    }
+    const ParticleStateShmHeader *header = (const ParticleStateShmHeader *)_data;
+    if (header->_publishedCount.load(std::memory_order_acquire) == 0)
+    {
+        return false;
+    }
+
+    unsigned int slotIndex = header->_latestSlot.load(std::memory_order_acquire);
+    if (slotIndex >= header->_slotCount)
+    {
+        return false;
+    }
+    const unsigned char *slotStart = (const unsigned char *)_data + header->_firstSlotOffset +
+        (slotIndex * header->_slotSizeBytes);
+    const ParticleStateShmSlotHeader *slot = (const ParticleStateShmSlotHeader *)slotStart;
+    unsigned int sequenceBefore = slot->_sequence.load(std::memory_order_acquire);
+    if ((sequenceBefore & 1) != 0)
+    {
+        return false;
+    }
+
+    ParticleReadbackFrame frame;
+    frame._updateIndex = slot->_updateIndex;
+    frame._firstParticle = slot->_firstParticle;
+    frame._particleCount = (slot->_particleCount < header->_capacity) ?
+        slot->_particleCount : header->_capacity;
+    frame._layout = (ParticleLayout)header->_layout;
+    for (unsigned int bufferIndex = 0; bufferIndex < PARTICLE_READBACK_MAX_BUFFERS;
+        bufferIndex++)
+    {
+        frame._particleData[bufferIndex] = (bufferIndex < header->_bufferCount) ?
+            slotStart + header->_bufferOffsets[bufferIndex] : 0;
+    }
+    frame._particleIds = (slot->_hasParticleIds != 0) ?
+        (const unsigned int *)(slotStart + header->_particleIdOffset) : 0;
+    reader(frame);
+
+    // the reads above must be done before the sequence is read again
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot->_sequence.load(std::memory_order_relaxed) == sequenceBefore;
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "ParticleManager.h"
+
+#include <atomic>
+#include <string>
+#include <stddef.h>
+
+// the layout of the shared memory, which a consumer in another language can read on its own
+// Note: Every offset is from the start of the shared memory, and everything but the sequence
+// numbers and the latest slot is fixed when the publisher creates it, so a consumer only
+// needs to read the header once.  Each slot is its slot header, then the particle buffers in
+// the manager's layout (see ParticleReadbackFrame), then the stable particle IDs.
+static const unsigned int PARTICLE_STATE_SHM_MAGIC = 0x4D485350;   // "PSHM"
+static const unsigned int PARTICLE_STATE_SHM_VERSION = 1;
+static const unsigned int PARTICLE_STATE_SHM_SLOTS = 3;
+static const unsigned int PARTICLE_STATE_SHM_MAX_BUFFERS = 3;
+
+// Note: The sequence is a seqlock.  It is odd while the publisher is writing the slot and even
+// once it is done, so a reader that sees the same even number before and after reading had
+// the whole frame.
+struct ParticleStateShmSlotHeader
+{
+    std::atomic<unsigned int> _sequence;
+    unsigned int _updateIndex;
+    unsigned int _firstParticle;
+    unsigned int _particleCount;
+    unsigned int _hasParticleIds;
+    unsigned int _padding[3];
+};
+
+struct ParticleStateShmHeader
+{
+    unsigned int _magic;
+    unsigned int _version;
+    unsigned int _layout;               // a ParticleLayout
+    unsigned int _bufferCount;
+    unsigned int _capacity;             // particles per slot
+    unsigned int _slotCount;
+    unsigned int _bufferStrides[PARTICLE_STATE_SHM_MAX_BUFFERS];
+    unsigned int _padding;
+    unsigned long long _firstSlotOffset;
+    unsigned long long _slotSizeBytes;
+    unsigned long long _bufferOffsets[PARTICLE_STATE_SHM_MAX_BUFFERS];  // within a slot
+    unsigned long long _particleIdOffset;                               // within a slot
+
+    // the slot of the newest finished frame, and how many frames there have been (0 until
+    // the first one)
+    std::atomic<unsigned int> _latestSlot;
+    std::atomic<unsigned int> _publishedCount;
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Publishes the particle readback (see ParticleManager::SetParticleReadback(...)) to named
+    shared memory (shm_open(...), or CreateFileMapping(...) on Windows), so that any number of
+    processes on the same machine (ex: analytics, a recorder, a second viewer) can read the
+    live particles without a GL context and without a readback of their own.  The GPU's copy
+    is still the manager's one non-stalling readback no matter how many consumers there are.
+
+    Each finished readback is copied into the next of a ring of slots, and then the header's
+    latest slot is pointed at it.  A consumer reads the latest slot in place (see
+    ParticleStateSubscriber).  With 3 slots, the publisher only comes back around to the slot
+    that a consumer is reading after 2 more readbacks, and the slot's seqlock catches a
+    consumer that was slower than that.
+
+    Note: The readback's staging buffer is the driver's memory and can't be put in shared
+    memory itself, so each frame is copied once, on the CPU, in the readback callback.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class ParticleStatePublisher
+{
+public:
+    ParticleStatePublisher();
+    ~ParticleStatePublisher();
+    bool Init(const std::string &name, ParticleLayout layout, unsigned int capacity);
+    void Cleanup();
+    void Publish(const ParticleReadbackFrame &frame);
+    unsigned int GetPublishedCount() const;
+
+private:
+    // no copies; there is only one mapping to close
+    ParticleStatePublisher(const ParticleStatePublisher &);
+    ParticleStatePublisher &operator=(const ParticleStatePublisher &);
+
+    std::string _name;
+    void *_data;
+    size_t _sizeBytes;
+    unsigned int _nextSlot;
+
+    // Note: Windows' handle is a pointer, so it is stored as void * to keep windows.h out of
+    // the header.  Elsewhere, _fileDescriptor is used instead.
+    void *_mappingHandle;
+    int _fileDescriptor;
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The consumer's side of ParticleStatePublisher.  Maps the shared memory read-only and
+    hands the latest frame to a callback without copying it.
+
+    Note: The callback reads the slot while the publisher may be coming around to it, so
+    whatever it worked out must be thrown away if ReadLatest(...) returns false.  A consumer
+    that needs to keep the frame copies it in the callback, and keeps the copy only then.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class ParticleStateSubscriber
+{
+public:
+    ParticleStateSubscriber();
+    ~ParticleStateSubscriber();
+    bool Open(const std::string &name);
+    void Close();
+    unsigned int GetPublishedCount() const;
+    bool ReadLatest(const ParticleReadbackCallback &reader) const;
+
+private:
+    // no copies; there is only one mapping to close
+    ParticleStateSubscriber(const ParticleStateSubscriber &);
+    ParticleStateSubscriber &operator=(const ParticleStateSubscriber &);
+
+    const void *_data;
+    size_t _sizeBytes;
+    void *_mappingHandle;
+    int _fileDescriptor;
+};
@@ -0,0 +1,364 @@
+#include "ParticleStatsReducer.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
+#include "GlFenceSync.h"
+#include "ShaderProgramRegistry.h"
+#include "ComputeDeviceCaps.h"
+#include "Log.h"
+
+// must match the STATS_STAGE_* defines in shaderParticle.comp
+enum StatsStage
+{
+    STATS_STAGE_PARTIALS = 0,
+    STATS_STAGE_FINAL,
+};
+
+// must match StatsPartial in shaderParticle.comp (std430)
+static const size_t STATS_PARTIAL_SIZE_BYTES = 32;
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.  Nothing is reduced until Init(...).  Defaults to a
+    reduction every 30 updates, which is a couple of times a second at 60Hz.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleStatsReducer::ParticleStatsReducer() :
+    _statsProgramId(0),
+    _statsWorkGroupSizeX(ParticleManager::DEFAULT_WORK_GROUP_SIZE),
+    _unifLocStatsStage(0),
+    _unifLocStatsItemCount(0),
+    _partialCapacity(0),
+    _mappedReadback(0),
+    _slotSizeBytes(0),
+    _nextSlot(0),
+    _interval(30),
+    _updatesSinceReduction(0),
+    _hasStats(false)
+{
+    _latestStats = ParticleStats();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleStatsReducer::~ParticleStatsReducer()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes a reference to the stats program (see ShaderProgramRegistry.h) and creates the
+    readback ring.  The partials buffer isn't created until the first reduction, when the
+    pool's size is known.  The caller may release their own reference after this returns.
+Parameters:
+    statsProgramId  shaderParticle.comp generated with GetStatsShaderDefines(...).  Must be
+                    built for the same particle layout as the particle manager's program.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleStatsReducer::Init(unsigned int statsProgramId)
+{
+    this->Cleanup();
+    if (statsProgramId == 0)
+    {
+        LogPrintf("the stats reducer needs its program\n");
+        return;
+    }
+
+    // the bindings come after everyone else's
+    GLint maxBindings = 0;
+    glGetIntegerv(GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS, &maxBindings);
+    if (maxBindings <= (GLint)STATS_RESULT_BUFFER_BINDING)
+    {
+        LogPrintf("the stats reducer needs %u shader storage bindings, but there are only %d\n",
+            STATS_RESULT_BUFFER_BINDING + 1, maxBindings);
+        return;
+    }
+
+    _statsProgramId = statsProgramId;
+    AddProgramReference(_statsProgramId);
+    this->LoadProgramInterface();
+
+    // the final stage writes straight into a slot, so each slot must start on a storage
+    // buffer offset boundary
+    GLint offsetAlignment = 1;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+    offsetAlignment = (offsetAlignment > 0) ? offsetAlignment : 1;
+    _slotSizeBytes = ((sizeof(ParticleStats) + offsetAlignment - 1) / offsetAlignment) *
+        offsetAlignment;
+
+    GLbitfield storageFlags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    GLsizeiptr bufferSize = STATS_READBACK_SLOTS * _slotSizeBytes;
+    _readbackBufferId = GenerateGlBuffer();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _readbackBufferId);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, bufferSize, 0, storageFlags);
+    _mappedReadback = (const unsigned char *)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0,
+        bufferSize, storageFlags);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Releases the program and deletes the buffers and fences.  The last stats are forgotten.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleStatsReducer::Cleanup()
+{
+    for (unsigned int slotIndex = 0; slotIndex < STATS_READBACK_SLOTS; slotIndex++)
+    {
+        _fences[slotIndex].Reset();
+    }
+    _readbackBufferId.Reset();
+    _mappedReadback = 0;
+    _partialBufferId.Reset();
+    _partialCapacity = 0;
+    _nextSlot = 0;
+    _updatesSinceReduction = 0;
+    _hasStats = false;
+    if (_statsProgramId != 0)
+    {
+        ReleaseProgram(_statsProgramId);
+        _statsProgramId = 0;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Switches to a rebuilt program (see ParticleManager::ReplaceProgram(...)).
+Parameters:
+    oldProgramId    Self-explanatory.  Programs that this reducer doesn't use are ignored.
+    newProgramId    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleStatsReducer::ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId)
+{
+    if (oldProgramId == 0 || newProgramId == 0 || _statsProgramId != oldProgramId)
+    {
+        return;
+    }
+
+    AddProgramReference(newProgramId);
+    ReleaseProgram(_statsProgramId);
+    _statsProgramId = newProgramId;
+    this->LoadProgramInterface();
+
+    // the work group size may have changed, and with it the number of partials
+    _partialBufferId.Reset();
+    _partialCapacity = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets how often the reduction runs.  Can be changed at any time.
+Parameters:
+    updatesPerReduction     1 is every update.  0 is treated as 1.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleStatsReducer::SetInterval(unsigned int updatesPerReduction)
+{
+    _interval = (updatesPerReduction > 0) ? updatesPerReduction : 1;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Picks up any reductions that the GPU has finished, and starts a new one if it is due and a
+    slot is free.  Call it once a frame, after the update.
+Parameters:
+    particleCount   The size of the particle pool (see ParticleManager::GetMaxParticleCount()).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleStatsReducer::Update(unsigned int particleCount)
+{
+    if (_statsProgramId == 0 || _mappedReadback == 0)
+    {
+        return;
+    }
+
+    this->CollectFinishedSlots();
+
+    _updatesSinceReduction++;
+    if (_updatesSinceReduction < _interval)
+    {
+        return;
+    }
+    if (_fences[_nextSlot] != 0)
+    {
+        // the GPU is more than a ring behind; try again next frame rather than wait
+        return;
+    }
+
+    _updatesSinceReduction = 0;
+    this->Reduce(particleCount);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    putStatsHere    The most recent stats that the GPU has finished.
+Returns:
+    False if no reduction has finished yet, in which case putStatsHere is left alone.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleStatsReducer::GetLatestStats(ParticleStats *putStatsHere) const
+{
+    if (!_hasStats)
+    {
+        return false;
+    }
+
+    *putStatsHere = _latestStats;
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Puts the stats pass's #defines after the particle layout's (see
+    ParticleManager::GetComputeShaderDefines(...)).  The work groups reduce with subgroup
+    arithmetic if the driver has it.
+Parameters:
+    layout          Must be the particle manager's.
+    workGroupSize   Self-explanatory.
+Returns:
+    A block of #defines for AcquireComputeProgram(...).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+std::string ParticleStatsReducer::GetStatsShaderDefines(ParticleLayout layout,
+    unsigned int workGroupSize)
+{
+    std::string defines = ParticleManager::GetComputeShaderDefines(layout, workGroupSize) +
+        "#define PARTICLE_STATS_PASS\n";
+    if (IsKhrSubgroupSupported(KHR_SUBGROUP_FEATURE_BASIC | KHR_SUBGROUP_FEATURE_ARITHMETIC))
+    {
+        defines += "#define STATS_USE_SUBGROUPS\n";
+    }
+    return defines;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Looks up the stats program's uniforms and work group size.  Called by Init(...) and
+    whenever the program is replaced.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleStatsReducer::LoadProgramInterface()
+{
+    _unifLocStatsStage = glGetUniformLocation(_statsProgramId, "uStatsStage");
+    _unifLocStatsItemCount = glGetUniformLocation(_statsProgramId, "uStatsItemCount");
+
+    // same as ParticleManager::Init(...); the dispatch must match the program
+    GLint programWorkGroupSize[3] = { 0, 0, 0 };
+    glGetProgramiv(_statsProgramId, GL_COMPUTE_LOCAL_WORK_SIZE, programWorkGroupSize);
+    _statsWorkGroupSizeX = (programWorkGroupSize[0] > 0) ?
+        programWorkGroupSize[0] : ParticleManager::DEFAULT_WORK_GROUP_SIZE;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes the newest slot whose fence has signaled as the latest stats and frees every
+    finished slot.  Never waits.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleStatsReducer::CollectFinishedSlots()
+{
+    // oldest first, so the newest finished one is the one that sticks
+    for (unsigned int slotOffset = 0; slotOffset < STATS_READBACK_SLOTS; slotOffset++)
+    {
+        unsigned int slotIndex = (_nextSlot + slotOffset) % STATS_READBACK_SLOTS;
+        if (_fences[slotIndex] == 0)
+        {
+            continue;
+        }
+
+        if (!IsGlFenceSignaled(_fences[slotIndex]))
+        {
+            // the later ones can't be done either
+            break;
+        }
+
+        _latestStats =
+            *(const ParticleStats *)(_mappedReadback + (slotIndex * _slotSizeBytes));
+        _hasStats = true;
+        _fences[slotIndex].Reset();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Runs both stages of the reduction into the next slot and fences it.
+Parameters:
+    particleCount   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleStatsReducer::Reduce(unsigned int particleCount)
+{
+    unsigned int partialCount = (particleCount + _statsWorkGroupSizeX - 1) /
+        _statsWorkGroupSizeX;
+    if (partialCount == 0)
+    {
+        return;
+    }
+    if (partialCount > _partialCapacity)
+    {
+        _partialBufferId = GenerateGlBuffer();
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, _partialBufferId);
+        glBufferStorage(GL_SHADER_STORAGE_BUFFER, partialCount * STATS_PARTIAL_SIZE_BYTES, 0,
+            0);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        _partialCapacity = partialCount;
+    }
+
+    unsigned int slotIndex = _nextSlot;
+    BindGlShaderStorageBuffer(STATS_PARTIAL_BUFFER_BINDING, _partialBufferId);
+    BindGlShaderStorageBufferRange(STATS_RESULT_BUFFER_BINDING, _readbackBufferId,
+        slotIndex * _slotSizeBytes, sizeof(ParticleStats));
+
+    UseGlProgram(_statsProgramId);
+    glUniform1i(_unifLocStatsStage, STATS_STAGE_PARTIALS);
+    glUniform1ui(_unifLocStatsItemCount, particleCount);
+    unsigned int numWorkGroupsX = 0;
+    unsigned int numWorkGroupsY = 0;
+    GetComputeDispatchSize(partialCount, &numWorkGroupsX, &numWorkGroupsY);
+    glDispatchCompute(numWorkGroupsX, numWorkGroupsY, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    glUniform1i(_unifLocStatsStage, STATS_STAGE_FINAL);
+    glUniform1ui(_unifLocStatsItemCount, partialCount);
+    glDispatchCompute(1, 1, 1);
+    UseGlProgram(0);
+
+    // the CPU reads the slot through the persistent mapping once the fence has signaled
+    glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+    _fences[slotIndex] = InsertGlFence();
+    _nextSlot = (_nextSlot + 1) % STATS_READBACK_SLOTS;
+}
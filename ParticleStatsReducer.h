@@ -0,0 +1,93 @@
+#pragma once
+
+#include "ParticleManager.h"
+#include "GlObjects.h"
+
+#include "glm/vec2.hpp"
+
+#include <string>
+
+// what ParticleStatsReducer adds up over the whole pool
+// Note: This is the std430 layout of StatsResultBuffer in shaderParticle.comp, byte for byte.
+struct ParticleStats
+{
+    unsigned int _liveCount;        // every active particle, culled or not
+    unsigned int _emittedCount;     // in the last update before the reduction
+    float _meanSpeed;
+    float _maxSpeed;
+    glm::vec2 _minCorner;           // the live particles' bounding box; 0s if there are none
+    glm::vec2 _maxCorner;
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Adds up a few statistics over every particle on the GPU (see ParticleStats), for the
+    frame stats log and anything else that wants to steer by them, without reading the
+    particles back.
+
+    The reduction is two dispatches of the stats program.  The first has each work group
+    reduce its particles to one partial (with subgroup arithmetic where the driver has it, and
+    a tree in shared memory otherwise) and write it out, and the second is a single work group
+    that reduces the partials to the final ParticleStats.  That is written straight into a
+    ring of persistently mapped slots with a fence each, like the particle manager's count
+    readback, and read on a later frame, once its fence has signaled, so nothing ever waits
+    on the GPU.
+
+    The first dispatch reads every particle, which is most of the cost of reading them for the
+    update, so the reduction only runs every so many updates (see SetInterval(...)).  A few
+    times a second is plenty for a dashboard or a governor.
+
+    The stats program is shaderParticle.comp built with PARTICLE_STATS_PASS defined (see
+    GetStatsShaderDefines(...)), so it loads particles with the same storage layout code as
+    the update.  It reads the particle buffers through the shader storage bindings that
+    ParticleManager set up, so it must run after the update and while that particle manager
+    is alive.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class ParticleStatsReducer
+{
+public:
+    ParticleStatsReducer();
+    ~ParticleStatsReducer();
+    void Init(unsigned int statsProgramId);
+    void Cleanup();
+    void ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId);
+
+    void SetInterval(unsigned int updatesPerReduction);
+    void Update(unsigned int particleCount);
+    bool GetLatestStats(ParticleStats *putStatsHere) const;
+
+    static std::string GetStatsShaderDefines(ParticleLayout layout,
+        unsigned int workGroupSize = ParticleManager::DEFAULT_WORK_GROUP_SIZE);
+
+private:
+    void LoadProgramInterface();
+    void CollectFinishedSlots();
+    void Reduce(unsigned int particleCount);
+
+    unsigned int _statsProgramId;
+    unsigned int _statsWorkGroupSizeX;
+    unsigned int _unifLocStatsStage;
+    unsigned int _unifLocStatsItemCount;
+
+    // the work groups' partials and the final stats
+    // Note: The bindings continue from the persistent threads' queue (see ParticleManager.h)
+    // and must match shaderParticle.comp.
+    static const unsigned int STATS_PARTIAL_BUFFER_BINDING = 38;
+    static const unsigned int STATS_RESULT_BUFFER_BINDING = 39;
+    GlBuffer _partialBufferId;
+    unsigned int _partialCapacity;
+
+    // 3 frames of GPU latency, plus 1 for the one that is being written
+    static const unsigned int STATS_READBACK_SLOTS = 4;
+    GlBuffer _readbackBufferId;
+    const unsigned char *_mappedReadback;
+    size_t _slotSizeBytes;
+    GlFence _fences[STATS_READBACK_SLOTS];
+    unsigned int _nextSlot;
+
+    unsigned int _interval;
+    unsigned int _updatesSinceReduction;
+    ParticleStats _latestStats;
+    bool _hasStats;
+};
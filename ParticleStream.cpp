@@ -0,0 +1,966 @@
+#include "ParticleStream.h"
+
+#include "StreamSockets.h"
+#include "Log.h"
+
+#include <string.h>
+
+// a few viewers, not an audience; also keeps the network thread's select(...) inside
+// FD_SETSIZE
+static const unsigned int STREAM_MAX_CLIENTS = 32;
+
+// how long the network thread waits for something to do, so that it sees Stop() soon
+static const long STREAM_POLL_MICROSECONDS = 2000;
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.  Nothing is sent until Start(...).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleStreamServer::ParticleStreamServer() :
+    _listenSocket(-1),
+    _shift(0),
+    _isStopping(false),
+    _hasCurrent(false),
+    _hasLastSent(false),
+    _lastSentTimeSec(0.0),
+    _sentFrames(0),
+    _droppedFrames(0)
+{
+    memset(&_streamHeader, 0, sizeof(_streamHeader));
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Stop() in the event that the user forgot to call it themselves.  The network thread
+    must be joined before the std::thread is destroyed, or the program is terminated.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleStreamServer::~ParticleStreamServer()
+{
+    this->Stop();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Starts listening for viewers, and starts the network thread.  Frames come in through
+    SubmitFrame(...).
+Parameters:
+    port                Self-explanatory.  Listens on every interface.
+    particleCount       The recorder's (see ParticleTrajectoryRecorder::Start(...)).
+    bitsPerValue        8-16.  Fewer bits are coarser positions and fewer bytes.
+    maxFramesPerSec     The rest are decoded and not sent.
+Returns:
+    False if the parameters are out of range or the port couldn't be listened on, otherwise
+    true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleStreamServer::Start(unsigned short port, unsigned int particleCount,
+    unsigned int bitsPerValue, float maxFramesPerSec)
+{
+    this->Stop();
+    if (particleCount == 0 || maxFramesPerSec <= 0.0f ||
+        bitsPerValue < PARTICLE_STREAM_MIN_BITS || bitsPerValue > PARTICLE_STREAM_MAX_BITS)
+    {
+        LogPrintf("particle stream: needs particles, a frame rate, and %u-%u bits\n",
+            PARTICLE_STREAM_MIN_BITS, PARTICLE_STREAM_MAX_BITS);
+        return false;
+    }
+    if (!StartStreamSockets())
+    {
+        LogPrintf("particle stream: couldn't start the socket library\n");
+        return false;
+    }
+
+    _listenSocket = ListenOnStreamPort(port, STREAM_MAX_CLIENTS);
+    if (_listenSocket == -1)
+    {
+        LogPrintf("particle stream: couldn't listen on port %u\n", (unsigned int)port);
+        StopStreamSockets();
+        return false;
+    }
+
+    _streamHeader._magic = PARTICLE_STREAM_MAGIC;
+    _streamHeader._version = PARTICLE_STREAM_VERSION;
+    _streamHeader._particleCount = particleCount;
+    _streamHeader._bitsPerValue = bitsPerValue;
+    _streamHeader._maxFramesPerSec = maxFramesPerSec;
+    _streamHeader._codec = PARTICLE_TRAJECTORY_CODEC_ZERO_RUN_VARINT;
+    _shift = 16 - bitsPerValue;
+
+    // an X and a Y per particle, and the worst case is 3 bytes per value
+    size_t valueCount = (size_t)particleCount * 2;
+    _values.resize(valueCount);
+    _current.resize(valueCount);
+    _reduced.resize(valueCount);
+    _lastSent.resize(valueCount);
+    _differences.resize(valueCount);
+    _encodedDifferences.resize(valueCount * 3 + 16);
+    _encodedKeyframe.resize(valueCount * 3 + 16);
+    _hasCurrent = false;
+    _hasLastSent = false;
+    _lastSentTimeSec = 0.0;
+    _sentFrames = 0;
+    _droppedFrames = 0;
+
+    _isStopping = false;
+    _networkThread = std::thread(&ParticleStreamServer::NetworkLoop, this);
+    LogPrintf("particle stream: port %u, %u particles at %u bits, up to %.0f frames a second, "
+        "at most %.2f MB/s per viewer\n", (unsigned int)port, particleCount, bitsPerValue,
+        maxFramesPerSec,
+        GetMaxBytesPerSec(particleCount, bitsPerValue, maxFramesPerSec) / (1024.0 * 1024.0));
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Stops the network thread and hangs up on every viewer.  Safe to call more than once.
+
+    Note: The recorder that feeds this must be stopped first, since its writer thread calls
+    SubmitFrame(...).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleStreamServer::Stop()
+{
+    if (_listenSocket == -1)
+    {
+        return;
+    }
+
+    _isStopping = true;
+    _networkThread.join();
+    for (size_t clientIndex = 0; clientIndex < _clients.size(); clientIndex++)
+    {
+        CloseStreamSocket(_clients[clientIndex]._socket);
+    }
+    _clients.clear();
+    CloseStreamSocket(_listenSocket);
+    _listenSocket = -1;
+    StopStreamSockets();
+
+    LogPrintf("particle stream: stopped after %u frames (%u dropped for slow viewers)\n",
+        _sentFrames, _droppedFrames);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    True if Start(...) succeeded and Stop() hasn't been called since, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleStreamServer::IsRunning() const
+{
+    return _listenSocket != -1;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes one of the recorder's frames (see ParticleTrajectoryFrameSink), and if a frame is
+    due, requantizes it and gives it to every viewer that is ready for one.
+
+    Note: Runs on the recorder's writer thread, so the time that this takes is the writer's,
+    and the network is never waited on.
+Parameters:
+    frame       Self-explanatory.
+    encoded     frame._encodedSizeBytes of the recorder's encoded values.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleStreamServer::SubmitFrame(const ParticleTrajectoryFrameHeader &frame,
+    const unsigned char *encoded)
+{
+    if (_listenSocket == -1)
+    {
+        return;
+    }
+
+    // the recorder's differences are from its last frame, so every one of them is applied,
+    // whether or not it is sent
+    size_t valueCount = _current.size();
+    if (!DecodeTrajectoryValues(encoded, frame._encodedSizeBytes, _values.data(), valueCount))
+    {
+        LogPrintf("particle stream: couldn't decode frame %u\n", frame._frameIndex);
+        _hasCurrent = false;
+        return;
+    }
+    if (frame._isKeyframe != 0)
+    {
+        _current.swap(_values);
+        _hasCurrent = true;
+    }
+    else if (!_hasCurrent)
+    {
+        // waiting for the recorder's next keyframe
+        return;
+    }
+    else
+    {
+        for (size_t valueIndex = 0; valueIndex < valueCount; valueIndex++)
+        {
+            _current[valueIndex] = (unsigned short)(_current[valueIndex] + _values[valueIndex]);
+        }
+    }
+
+    double nowSec = GetStreamTimeSec();
+    if (_hasLastSent && (nowSec - _lastSentTimeSec) < (1.0 / _streamHeader._maxFramesPerSec))
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_clients.empty())
+        {
+            // nothing to difference against for whoever connects next
+            _hasLastSent = false;
+            return;
+        }
+    }
+
+    // inactive particles get the one value that no active position shifts to
+    int inactiveValue = -(1 << (_streamHeader._bitsPerValue - 1));
+    int minActiveValue = inactiveValue + 1;
+    for (size_t valueIndex = 0; valueIndex < valueCount; valueIndex++)
+    {
+        int value = inactiveValue;
+        if (_current[valueIndex] != 0x8000)
+        {
+            value = (short)_current[valueIndex] >> _shift;
+            value = (value < minActiveValue) ? minActiveValue : value;
+        }
+        _reduced[valueIndex] = (unsigned short)value;
+    }
+
+    // encoded once for every viewer that has the last frame
+    size_t differencesSizeBytes = 0;
+    if (_hasLastSent)
+    {
+        for (size_t valueIndex = 0; valueIndex < valueCount; valueIndex++)
+        {
+            _differences[valueIndex] =
+                (unsigned short)(_reduced[valueIndex] - _lastSent[valueIndex]);
+        }
+        differencesSizeBytes = EncodeTrajectoryValues(_differences.data(), valueCount,
+            _encodedDifferences.data());
+    }
+
+    // and the keyframe only if someone who is ready for a frame doesn't have the last one
+    bool needsKeyframe = false;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (size_t clientIndex = 0; clientIndex < _clients.size(); clientIndex++)
+        {
+            const Client &client = _clients[clientIndex];
+            needsKeyframe |= (client._pending.empty() &&
+                (!client._hasLastFrame || !_hasLastSent));
+        }
+    }
+    size_t keyframeSizeBytes = 0;
+    if (needsKeyframe)
+    {
+        keyframeSizeBytes = EncodeTrajectoryValues(_reduced.data(), valueCount,
+            _encodedKeyframe.data());
+    }
+
+    ParticleStreamFrameHeader header;
+    header._frameIndex = _sentFrames;
+    header._updateIndex = frame._updateIndex;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (size_t clientIndex = 0; clientIndex < _clients.size(); clientIndex++)
+        {
+            Client &client = _clients[clientIndex];
+            if (!client._pending.empty())
+            {
+                // still sending an older frame, so this one is dropped, and the next one it
+                // gets will be a keyframe
+                client._hasLastFrame = false;
+                _droppedFrames++;
+            }
+            else if (client._hasLastFrame && _hasLastSent)
+            {
+                header._isKeyframe = 0;
+                header._encodedSizeBytes = (unsigned int)differencesSizeBytes;
+                this->AppendFrame(&client, header, _encodedDifferences, differencesSizeBytes);
+            }
+            else if (needsKeyframe)
+            {
+                // Note: A viewer that connected after the check above has to wait for the
+                // next frame.
+                header._isKeyframe = 1;
+                header._encodedSizeBytes = (unsigned int)keyframeSizeBytes;
+                this->AppendFrame(&client, header, _encodedKeyframe, keyframeSizeBytes);
+                client._hasLastFrame = true;
+            }
+        }
+        _sentFrames++;
+    }
+
+    _lastSent.swap(_reduced);
+    _hasLastSent = true;
+    _lastSentTimeSec = nowSec;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How many viewers are connected.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleStreamServer::GetClientCount() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return (unsigned int)_clients.size();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The frames that were given to at least one viewer since Start(...).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleStreamServer::GetSentFrameCount() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _sentFrames;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How many times since Start(...) a frame was skipped for a viewer that was still being sent
+    the last one.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleStreamServer::GetDroppedFrameCount() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _droppedFrames;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The most that one viewer can be sent.  Each value is zigzag-encoded, so it needs one more
+    bit than it has, 7 bits to a byte, and a run of 0s is never more than 2 bytes per value.
+Parameters:
+    particleCount       Self-explanatory.
+    bitsPerValue        Self-explanatory.
+    maxFramesPerSec     Self-explanatory.
+Returns:
+    Bytes a second, headers included.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+double ParticleStreamServer::GetMaxBytesPerSec(unsigned int particleCount,
+    unsigned int bitsPerValue, float maxFramesPerSec)
+{
+    unsigned int bytesPerValue = (bitsPerValue + 1 + 6) / 7;
+    double bytesPerFrame = (double)particleCount * 2.0 * bytesPerValue +
+        sizeof(ParticleStreamFrameHeader);
+    return bytesPerFrame * maxFramesPerSec;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The network thread.  Takes new viewers and sends whatever they have pending until it is
+    told to stop.  Viewers that hang up are dropped.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleStreamServer::NetworkLoop()
+{
+    while (!_isStopping)
+    {
+        // wait until there is a viewer to take or room to send, or a little while
+        fd_set readSockets;
+        fd_set writeSockets;
+        FD_ZERO(&readSockets);
+        FD_ZERO(&writeSockets);
+        FD_SET((StreamSocket)_listenSocket, &readSockets);
+        long long maxSocket = _listenSocket;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (size_t clientIndex = 0; clientIndex < _clients.size(); clientIndex++)
+            {
+                const Client &client = _clients[clientIndex];
+                if (!client._pending.empty())
+                {
+                    FD_SET((StreamSocket)client._socket, &writeSockets);
+                    maxSocket = (client._socket > maxSocket) ? client._socket : maxSocket;
+                }
+            }
+        }
+        timeval timeout;
+        timeout.tv_sec = 0;
+        timeout.tv_usec = STREAM_POLL_MICROSECONDS;
+        select((int)maxSocket + 1, &readSockets, &writeSockets, 0, &timeout);
+
+        this->AcceptClients();
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (size_t clientIndex = 0; clientIndex < _clients.size();)
+        {
+            Client &client = _clients[clientIndex];
+            bool isHungUp = false;
+            while (client._pendingOffset < client._pending.size())
+            {
+                size_t remainingBytes = client._pending.size() - client._pendingOffset;
+                int sentBytes = (int)send((StreamSocket)client._socket,
+                    (const char *)client._pending.data() + client._pendingOffset,
+                    (int)remainingBytes, MSG_NOSIGNAL);
+                if (sentBytes > 0)
+                {
+                    client._pendingOffset += (size_t)sentBytes;
+                }
+                else
+                {
+                    isHungUp = !IsStreamSocketWouldBlock();
+                    break;
+                }
+            }
+            if (client._pendingOffset == client._pending.size())
+            {
+                // ready for the next frame
+                client._pending.clear();
+                client._pendingOffset = 0;
+            }
+
+            if (isHungUp)
+            {
+                CloseStreamSocket(client._socket);
+                _clients.erase(_clients.begin() + clientIndex);
+                LogPrintf("particle stream: a viewer left (%u left)\n",
+                    (unsigned int)_clients.size());
+            }
+            else
+            {
+                clientIndex++;
+            }
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes every viewer that is waiting to connect, and queues the stream header for each.
+    Their first frame will be a keyframe.
+
+    Note: Runs on the network thread.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleStreamServer::AcceptClients()
+{
+    while (true)
+    {
+        StreamSocket clientSocket = accept((StreamSocket)_listenSocket, 0, 0);
+        long long clientSocketId = (long long)clientSocket;
+        if (clientSocketId == -1)
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_clients.size() >= STREAM_MAX_CLIENTS || !SetStreamSocketNonBlocking(clientSocketId))
+        {
+            LogPrintf("particle stream: turned a viewer away\n");
+            CloseStreamSocket(clientSocketId);
+            continue;
+        }
+
+        // the frames are sent whole, so there is nothing to gain from waiting to fill packets
+        SetStreamSocketNoDelay(clientSocketId);
+
+        Client client;
+        client._socket = clientSocketId;
+        client._pending.resize(sizeof(_streamHeader));
+        memcpy(client._pending.data(), &_streamHeader, sizeof(_streamHeader));
+        client._pendingOffset = 0;
+        client._hasLastFrame = false;
+        _clients.push_back(client);
+        LogPrintf("particle stream: a viewer connected (%u now)\n",
+            (unsigned int)_clients.size());
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Queues a frame for one viewer.  The caller holds the lock, and the viewer has nothing
+    pending.
+Parameters:
+    client              Self-explanatory.
+    header              Self-explanatory.
+    encoded             Self-explanatory.
+    encodedSizeBytes    How much of it is the frame.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleStreamServer::AppendFrame(Client *client, const ParticleStreamFrameHeader &header,
+    const std::vector<unsigned char> &encoded, size_t encodedSizeBytes)
+{
+    client->_pending.resize(sizeof(header) + encodedSizeBytes);
+    memcpy(client->_pending.data(), &header, sizeof(header));
+    memcpy(client->_pending.data() + sizeof(header), encoded.data(), encodedSizeBytes);
+    client->_pendingOffset = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.  There is no stream until Connect(...).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleStreamClient::ParticleStreamClient() :
+    _socket(-1),
+    _isConnected(false),
+    _hasNewFrame(false),
+    _receivedFrames(0)
+{
+    memset(&_streamHeader, 0, sizeof(_streamHeader));
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Disconnect() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleStreamClient::~ParticleStreamClient()
+{
+    this->Disconnect();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Connects to a server, reads its stream header, and starts receiving frames.  Waits for
+    the connection, since the viewer has nothing to show without it.
+Parameters:
+    hostAndPort     Ex: "192.168.1.20:7400".
+Returns:
+    False if it couldn't connect or the server isn't a particle stream, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleStreamClient::Connect(const std::string &hostAndPort)
+{
+    this->Disconnect();
+    if (!StartStreamSockets())
+    {
+        LogPrintf("particle stream: couldn't start the socket library\n");
+        return false;
+    }
+    _socket = ConnectStreamSocket(hostAndPort);
+    if (_socket == -1)
+    {
+        LogPrintf("particle stream: couldn't connect to '%s'\n", hostAndPort.c_str());
+        StopStreamSockets();
+        return false;
+    }
+
+    if (!this->ReceiveBytes(&_streamHeader, sizeof(_streamHeader)) ||
+        _streamHeader._magic != PARTICLE_STREAM_MAGIC ||
+        _streamHeader._version != PARTICLE_STREAM_VERSION ||
+        _streamHeader._codec != PARTICLE_TRAJECTORY_CODEC_ZERO_RUN_VARINT ||
+        _streamHeader._particleCount == 0 ||
+        _streamHeader._bitsPerValue < PARTICLE_STREAM_MIN_BITS ||
+        _streamHeader._bitsPerValue > PARTICLE_STREAM_MAX_BITS)
+    {
+        LogPrintf("particle stream: '%s' isn't a particle stream this can read\n",
+            hostAndPort.c_str());
+        CloseStreamSocket(_socket);
+        _socket = -1;
+        StopStreamSockets();
+        return false;
+    }
+
+    size_t valueCount = (size_t)_streamHeader._particleCount * 2;
+    _values.resize(valueCount);
+    _differences.resize(valueCount);
+    _encoded.resize(valueCount * 3 + 16);
+    _latestValues.resize(valueCount);
+    _hasNewFrame = false;
+    _receivedFrames = 0;
+
+    _isConnected = true;
+    _receiveThread = std::thread(&ParticleStreamClient::ReceiveLoop, this);
+    LogPrintf("particle stream: connected to '%s', %u particles at %u bits\n",
+        hostAndPort.c_str(), _streamHeader._particleCount, _streamHeader._bitsPerValue);
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Hangs up and stops the receive thread.  Safe to call more than once.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleStreamClient::Disconnect()
+{
+    if (_socket == -1)
+    {
+        return;
+    }
+
+    // shutting the socket down wakes up the receive thread
+    _isConnected = false;
+#ifdef WIN32
+    shutdown((StreamSocket)_socket, SD_BOTH);
+#else
+    shutdown((StreamSocket)_socket, SHUT_RDWR);
+#endif
+    if (_receiveThread.joinable())
+    {
+        _receiveThread.join();
+    }
+    CloseStreamSocket(_socket);
+    _socket = -1;
+    StopStreamSockets();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    False if it never connected, or if the server hung up, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleStreamClient::IsConnected() const
+{
+    return _isConnected;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    What the server said about the stream when this connected.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+const ParticleStreamHeader &ParticleStreamClient::GetStreamHeader() const
+{
+    return _streamHeader;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Turns the newest frame back into particles.  The velocities and ages aren't sent, so they
+    are 0.
+Parameters:
+    putParticlesHere    Resized to the server's particle count.
+Returns:
+    False if there hasn't been a new frame since the last call, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleStreamClient::TakeLatestFrame(std::vector<Particle> *putParticlesHere)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_hasNewFrame)
+    {
+        return false;
+    }
+    _hasNewFrame = false;
+
+    // a value is the 16-bit one shifted right, so it is put back in the middle of the range
+    // that shifted to it
+    unsigned int shift = 16 - _streamHeader._bitsPerValue;
+    int inactiveValue = -(1 << (_streamHeader._bitsPerValue - 1));
+    float scale = (float)(1 << shift) / 32767.0f;
+    float rounding = (shift > 0) ? 0.5f : 0.0f;
+    putParticlesHere->resize(_streamHeader._particleCount);
+    for (unsigned int particleIndex = 0; particleIndex < _streamHeader._particleCount;
+        particleIndex++)
+    {
+        int x = (short)_latestValues[particleIndex * 2];
+        int y = (short)_latestValues[particleIndex * 2 + 1];
+        Particle &p = (*putParticlesHere)[particleIndex];
+        p._velocity = glm::vec2(0.0f, 0.0f);
+        p._age = 0.0f;
+        if (x == inactiveValue)
+        {
+            p._position = glm::vec2(0.0f, 0.0f);
+            p._isActive = 0;
+        }
+        else
+        {
+            p._position = glm::vec2((x + rounding) * scale, (y + rounding) * scale);
+            p._isActive = 1;
+        }
+    }
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The frames that were received and decoded since Connect(...).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleStreamClient::GetReceivedFrameCount() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _receivedFrames;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The receive thread.  Decodes every frame as it comes in, since each one is a difference
+    from the last, and hands the result to TakeLatestFrame(...).  Stops when the server hangs
+    up or sends something that doesn't decode.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleStreamClient::ReceiveLoop()
+{
+    size_t valueCount = _values.size();
+    bool hasKeyframe = false;
+    while (_isConnected)
+    {
+        ParticleStreamFrameHeader header;
+        if (!this->ReceiveBytes(&header, sizeof(header)) ||
+            header._encodedSizeBytes > _encoded.size() ||
+            !this->ReceiveBytes(_encoded.data(), header._encodedSizeBytes) ||
+            !DecodeTrajectoryValues(_encoded.data(), header._encodedSizeBytes,
+                _differences.data(), valueCount))
+        {
+            break;
+        }
+
+        if (header._isKeyframe != 0)
+        {
+            _values.swap(_differences);
+            hasKeyframe = true;
+        }
+        else if (!hasKeyframe)
+        {
+            // the server always starts with a keyframe, so this shouldn't happen
+            continue;
+        }
+        else
+        {
+            for (size_t valueIndex = 0; valueIndex < valueCount; valueIndex++)
+            {
+                _values[valueIndex] = (unsigned short)(_values[valueIndex] +
+                    _differences[valueIndex]);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _latestValues = _values;
+        _hasNewFrame = true;
+        _receivedFrames++;
+    }
+
+    if (_isConnected)
+    {
+        LogPrintf("particle stream: the server hung up after %u frames\n",
+            this->GetReceivedFrameCount());
+    }
+    _isConnected = false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Waits for exactly so many bytes.
+Parameters:
+    putBytesHere    Self-explanatory.
+    sizeBytes       Self-explanatory.
+Returns:
+    False if the connection closed first, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleStreamClient::ReceiveBytes(void *putBytesHere, size_t sizeBytes)
+{
+    char *bytes = (char *)putBytesHere;
+    size_t receivedBytes = 0;
+    while (receivedBytes < sizeBytes)
+    {
+        int result = (int)recv((StreamSocket)_socket, bytes + receivedBytes,
+            (int)(sizeBytes - receivedBytes), 0);
+        if (result <= 0)
+        {
+            return false;
+        }
+        receivedBytes += (size_t)result;
+    }
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.  Nothing is received until Connect(...).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleStreamGather::ParticleStreamGather()
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Hangs up on every node.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleStreamGather::~ParticleStreamGather()
+{
+    this->Disconnect();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Connects to every node in the list.  A single address is an ordinary viewer.
+Parameters:
+    hostAndPortList     Ex: "node0:7400,node1:7400".
+Returns:
+    False if any node couldn't be reached (and then none are connected), otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleStreamGather::Connect(const std::string &hostAndPortList)
+{
+    this->Disconnect();
+    size_t start = 0;
+    while (start <= hostAndPortList.size())
+    {
+        size_t end = hostAndPortList.find(',', start);
+        if (end == std::string::npos)
+        {
+            end = hostAndPortList.size();
+        }
+        std::string hostAndPort = hostAndPortList.substr(start, end - start);
+        start = end + 1;
+        if (hostAndPort.empty())
+        {
+            continue;
+        }
+
+        ParticleStreamClient *client = new ParticleStreamClient();
+        _clients.push_back(client);
+        if (!client->Connect(hostAndPort))
+        {
+            this->Disconnect();
+            return false;
+        }
+    }
+    return !_clients.empty();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Hangs up on every node.  Safe to call more than once.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleStreamGather::Disconnect()
+{
+    for (size_t clientIndex = 0; clientIndex < _clients.size(); clientIndex++)
+    {
+        delete _clients[clientIndex];
+    }
+    _clients.clear();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The sum of the nodes' particle counts, which is the renderer's pool size.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleStreamGather::GetParticleCount() const
+{
+    unsigned int particleCount = 0;
+    for (size_t clientIndex = 0; clientIndex < _clients.size(); clientIndex++)
+    {
+        particleCount += _clients[clientIndex]->GetStreamHeader()._particleCount;
+    }
+    return particleCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Puts each node's newest frame in its slice of the pool (see
+    ParticleStreamClient::TakeLatestFrame(...)).
+Parameters:
+    putParticlesHere    Resized to GetParticleCount().  The slices of the nodes that haven't
+                        sent anything new are left alone, so it should be the same vector
+                        every time.
+Returns:
+    False if no node has sent a new frame since the last call, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleStreamGather::TakeLatestFrame(std::vector<Particle> *putParticlesHere)
+{
+    putParticlesHere->resize(this->GetParticleCount());
+    bool hasNewFrame = false;
+    size_t firstParticle = 0;
+    for (size_t clientIndex = 0; clientIndex < _clients.size(); clientIndex++)
+    {
+        ParticleStreamClient *client = _clients[clientIndex];
+        if (client->TakeLatestFrame(&_nodeParticles))
+        {
+            for (size_t particleIndex = 0; particleIndex < _nodeParticles.size();
+                particleIndex++)
+            {
+                (*putParticlesHere)[firstParticle + particleIndex] =
+                    _nodeParticles[particleIndex];
+            }
+            hasNewFrame = true;
+        }
+        firstParticle += client->GetStreamHeader()._particleCount;
+    }
+    return hasNewFrame;
+}
@@ -0,0 +1,208 @@
+#pragma once
+
+#include "ParticleTrajectoryRecorder.h"
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+// what goes over the wire, in the byte order of the machine that sent it
+// Note: The server sends a ParticleStreamHeader once, as soon as a viewer connects, and after
+// that a ParticleStreamFrameHeader and its encoded values for every frame that the viewer is
+// sent.  The values are the trajectory recorder's (see ParticleTrajectoryRecorder.h), but
+// requantized to _bitsPerValue bits: each one is the recorder's 16-bit value shifted right by
+// (16 - _bitsPerValue), and an inactive particle is -(2^(_bitsPerValue - 1)), which no active
+// one shifts to.  A keyframe has the values as they are, and every other frame has the
+// difference from the last frame that this viewer was sent (mod 65536), and both are encoded
+// with EncodeTrajectoryValues(...).
+static const unsigned int PARTICLE_STREAM_MAGIC = 0x52545350;   // "PSTR"
+static const unsigned int PARTICLE_STREAM_VERSION = 1;
+static const unsigned int PARTICLE_STREAM_MIN_BITS = 8;
+static const unsigned int PARTICLE_STREAM_MAX_BITS = 16;
+
+struct ParticleStreamHeader
+{
+    unsigned int _magic;
+    unsigned int _version;
+    unsigned int _particleCount;
+    unsigned int _bitsPerValue;
+    float _maxFramesPerSec;
+    unsigned int _codec;                    // a ParticleTrajectoryCodec
+};
+
+struct ParticleStreamFrameHeader
+{
+    unsigned int _frameIndex;               // counts the frames that the server sent anyone
+    unsigned int _updateIndex;              // the recorder's
+    unsigned int _isKeyframe;
+    unsigned int _encodedSizeBytes;
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Streams the particles to remote viewers over TCP (see ParticleStreamClient).  It is fed by
+    a trajectory recorder with no file (see ParticleTrajectoryRecorder::SetFrameSink(...)), so
+    the GPU does the quantizing and the readback is the recorder's, which never waits.
+
+    The recorder's frames are differences from its own last frame, so every one of them is
+    decoded into the current positions, whether or not anyone is sent it.  At most
+    _maxFramesPerSec of them are requantized and sent.  The difference from the last frame that
+    was sent is encoded once and shared by every viewer that got that frame, and a viewer that
+    didn't (it just connected, or a frame was dropped for it) gets a keyframe instead.
+
+    A viewer is only given a frame if it took all of the last one, and otherwise that frame is
+    dropped for it, so a slow viewer costs a little memory and never holds up the recorder,
+    the simulation, or the other viewers.  The bandwidth to each one is bounded by the
+    quantization: a value is never more than ceil((bits + 1) / 7) bytes, which for 2 values
+    per particle is 2N * ceil((bits + 1) / 7) bytes a frame (see GetMaxBytesPerSec(...)).
+
+    Note: TCP instead of UDP or a WebSocket.  UDP would need its own retransmits for the
+    keyframes, and a frame of a million particles is far more than a datagram, and a
+    WebSocket is TCP with a handshake and framing that a native viewer doesn't need.  Dropping
+    whole frames at the sender gets what UDP would have, without the reassembly.
+    Also Note: The sockets are non-blocking, and only the network thread sends, so a frame
+    being handed to the server costs a decode and an encode, and never a wait on the network.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class ParticleStreamServer
+{
+public:
+    ParticleStreamServer();
+    ~ParticleStreamServer();
+    bool Start(unsigned short port, unsigned int particleCount, unsigned int bitsPerValue,
+        float maxFramesPerSec);
+    void Stop();
+    bool IsRunning() const;
+    void SubmitFrame(const ParticleTrajectoryFrameHeader &frame, const unsigned char *encoded);
+    unsigned int GetClientCount() const;
+    unsigned int GetSentFrameCount() const;
+    unsigned int GetDroppedFrameCount() const;
+
+    static double GetMaxBytesPerSec(unsigned int particleCount, unsigned int bitsPerValue,
+        float maxFramesPerSec);
+
+private:
+    // no copies; there is only one socket to close
+    ParticleStreamServer(const ParticleStreamServer &);
+    ParticleStreamServer &operator=(const ParticleStreamServer &);
+
+    struct Client
+    {
+        long long _socket;
+
+        // what hasn't been sent yet; a frame is only added when this is empty
+        std::vector<unsigned char> _pending;
+        size_t _pendingOffset;
+
+        // true if the last frame that was sent to anyone was sent to this one too, so the next
+        // one can be a difference from it
+        bool _hasLastFrame;
+    };
+
+    void NetworkLoop();
+    void AcceptClients();
+    void AppendFrame(Client *client, const ParticleStreamFrameHeader &header,
+        const std::vector<unsigned char> &encoded, size_t encodedSizeBytes);
+
+    // Note: A socket is a pointer-sized integer on Windows and an int elsewhere, so they are
+    // stored as long long, with -1 for none, to keep the socket headers out of this one.
+    long long _listenSocket;
+    ParticleStreamHeader _streamHeader;
+    unsigned int _shift;
+    std::thread _networkThread;
+    std::atomic<bool> _isStopping;
+
+    // the recorder's writer thread is the only one that touches these
+    std::vector<unsigned short> _values;
+    std::vector<unsigned short> _current;
+    std::vector<unsigned short> _reduced;
+    std::vector<unsigned short> _lastSent;
+    std::vector<unsigned short> _differences;
+    std::vector<unsigned char> _encodedDifferences;
+    std::vector<unsigned char> _encodedKeyframe;
+    bool _hasCurrent;
+    bool _hasLastSent;
+    double _lastSentTimeSec;
+
+    // shared with the network thread
+    mutable std::mutex _mutex;
+    std::vector<Client> _clients;
+    unsigned int _sentFrames;
+    unsigned int _droppedFrames;
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The viewer's side of ParticleStreamServer.  Connects, and then a thread receives and
+    decodes every frame that the server sends, and TakeLatestFrame(...) hands the newest one
+    to the render thread as particles, so that the viewer draws them with the same particle
+    manager and render path as the simulation (see ParticleManager::LoadParticles(...)).
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class ParticleStreamClient
+{
+public:
+    ParticleStreamClient();
+    ~ParticleStreamClient();
+    bool Connect(const std::string &hostAndPort);
+    void Disconnect();
+    bool IsConnected() const;
+    const ParticleStreamHeader &GetStreamHeader() const;
+    bool TakeLatestFrame(std::vector<Particle> *putParticlesHere);
+    unsigned int GetReceivedFrameCount() const;
+
+private:
+    // no copies; there is only one socket to close
+    ParticleStreamClient(const ParticleStreamClient &);
+    ParticleStreamClient &operator=(const ParticleStreamClient &);
+
+    void ReceiveLoop();
+    bool ReceiveBytes(void *putBytesHere, size_t sizeBytes);
+
+    long long _socket;
+    ParticleStreamHeader _streamHeader;
+    std::thread _receiveThread;
+    std::atomic<bool> _isConnected;
+
+    // the receive thread's; the values as of the last frame, which the next one is added to
+    std::vector<unsigned short> _values;
+    std::vector<unsigned short> _differences;
+    std::vector<unsigned char> _encoded;
+
+    // handed to the render thread
+    mutable std::mutex _mutex;
+    std::vector<unsigned short> _latestValues;
+    bool _hasNewFrame;
+    unsigned int _receivedFrames;
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The renderer's side of a distributed run (see ParticleDomainShard.h): one
+    ParticleStreamClient per node, and TakeLatestFrame(...) puts each node's newest frame in
+    its own slice of one pool, in the order that the nodes were listed, so that the renderer
+    draws every node's particles as though they were one simulation.  A node that hasn't sent
+    anything new keeps its last frame.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class ParticleStreamGather
+{
+public:
+    ParticleStreamGather();
+    ~ParticleStreamGather();
+    bool Connect(const std::string &hostAndPortList);
+    void Disconnect();
+    unsigned int GetParticleCount() const;
+    bool TakeLatestFrame(std::vector<Particle> *putParticlesHere);
+
+private:
+    // no copies; there is only one of each connection
+    ParticleStreamGather(const ParticleStreamGather &);
+    ParticleStreamGather &operator=(const ParticleStreamGather &);
+
+    // a client has a thread and a mutex, so it can't move around in a vector
+    std::vector<ParticleStreamClient *> _clients;
+    std::vector<Particle> _nodeParticles;
+};
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "ParticleManager.h"
+#include "ShaderProgramRegistry.h"
+
+#include <string>
+#include <vector>
+
+// what the update tests the particles against besides their emitter's circle (see
+// ParticleSystem)
+enum ParticleBoundaryType
+{
+    // only the emitter's circle (the original)
+    PARTICLE_BOUNDARY_EMITTER_RADIUS = 0,
+
+    // see ParticleManager::SetSdfBoundary(...)
+    PARTICLE_BOUNDARY_SDF,
+
+    // see ParticleManager::SetSegmentBvh(...)
+    PARTICLE_BOUNDARY_SEGMENT_BVH,
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    A particle manager whose layout, integrator, and boundary are fixed at compile time.  The
+    compute program is built from a kernel variant that is worked out from the template
+    arguments (see GetKernelVariant()), so the integrator and boundary are baked into the
+    shader, and a feature that the configuration leaves out isn't in the shader at all.  The
+    same layout goes to the manager, whose VAO comes from the layout's descriptor (see
+    Particle.h).
+
+    The setters for a feature only compile for the configurations that have it, so using the
+    SDF setter on a system that was built without an SDF boundary is a compile error instead
+    of a setting that the shader quietly ignores.
+
+    Note: The manager underneath is still the same class for every configuration.  It is 5000
+    lines of GL state, and making all of it a template would mean building all of it once per
+    configuration for the few branches on the layout that it takes per frame.  Anything that
+    doesn't depend on the configuration goes through GetManager().
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+template <ParticleLayout LAYOUT, ParticleIntegrator INTEGRATOR, ParticleBoundaryType BOUNDARY>
+class ParticleSystem
+{
+public:
+    static const ParticleLayout LAYOUT_TYPE = LAYOUT;
+    static const ParticleIntegrator INTEGRATOR_TYPE = INTEGRATOR;
+    static const ParticleBoundaryType BOUNDARY_TYPE = BOUNDARY;
+
+    /*-------------------------------------------------------------------------------------------
+    Description:
+        Self-explanatory.
+    Parameters: None
+    Returns:
+        The default kernel variant with this configuration's integrator and boundary baked in.
+    Exception:  Safe
+    Creator:    John Cox (8-17-2016)
+    -------------------------------------------------------------------------------------------*/
+    static ParticleKernelVariant GetKernelVariant()
+    {
+        ParticleKernelVariant variant = ParticleManager::GetDefaultKernelVariant();
+        variant._integrator = INTEGRATOR;
+        variant._hasSdfBoundary = (BOUNDARY == PARTICLE_BOUNDARY_SDF);
+        variant._hasSegmentBvh = (BOUNDARY == PARTICLE_BOUNDARY_SEGMENT_BVH);
+        return variant;
+    }
+
+    /*-------------------------------------------------------------------------------------------
+    Description:
+        Self-explanatory.
+    Parameters:
+        workGroupSize   The compute shader's "local_size_x" (see WorkGroupTuner.h).
+    Returns:
+        The defines for this configuration's compute program.
+    Exception:  Safe
+    Creator:    John Cox (8-17-2016)
+    -------------------------------------------------------------------------------------------*/
+    static std::string GetComputeShaderDefines(unsigned int workGroupSize)
+    {
+        return ParticleManager::GetComputeShaderDefines(LAYOUT, workGroupSize,
+            GetKernelVariant());
+    }
+
+    /*-------------------------------------------------------------------------------------------
+    Description:
+        Builds (or reuses; see ShaderProgramRegistry.h) the render program and this
+        configuration's compute program and sets up the manager with them.  Needs a current
+        context.
+    Parameters:
+        emitters        See ParticleManager::Init(...).
+        workGroupSize   See GetComputeShaderDefines(...).
+    Returns:
+        False if either program failed to build, in which case nothing was set up.
+    Exception:  Safe
+    Creator:    John Cox (8-17-2016)
+    -------------------------------------------------------------------------------------------*/
+    bool Init(const std::vector<ParticleEmitter> &emitters, unsigned int workGroupSize)
+    {
+        unsigned int renderProgramId = AcquireRenderProgram();
+        unsigned int computeProgramId =
+            AcquireComputeProgram(GetComputeShaderDefines(workGroupSize));
+        bool isBuilt = (renderProgramId != 0 && computeProgramId != 0);
+        if (isBuilt)
+        {
+            _manager.Init(renderProgramId, computeProgramId, emitters, LAYOUT);
+        }
+
+        // the manager holds its own references
+        ReleaseProgram(renderProgramId);
+        ReleaseProgram(computeProgramId);
+        return isBuilt;
+    }
+
+    void Cleanup()
+    {
+        _manager.Cleanup();
+    }
+
+    void Update(float deltaTimeSec)
+    {
+        _manager.Update(deltaTimeSec);
+    }
+
+    void Render(float extrapolationSec)
+    {
+        _manager.Render(extrapolationSec);
+    }
+
+    // see ParticleManager::SetSdfBoundary(...)
+    void SetSdfBoundary(unsigned int textureId, int width, int height,
+        const glm::vec2 &minCorner, const glm::vec2 &maxCorner, ParticleSdfBoundaryMode mode,
+        float restitution)
+    {
+        static_assert(BOUNDARY == PARTICLE_BOUNDARY_SDF,
+            "This particle system was not built with an SDF boundary");
+        _manager.SetSdfBoundary(textureId, width, height, minCorner, maxCorner, mode,
+            restitution);
+    }
+
+    // see ParticleManager::SetSegmentBvh(...)
+    void SetSegmentBvh(unsigned int segmentBufferId, unsigned int nodeBufferId,
+        unsigned int segmentCount, ParticleSegmentBvhMode mode, float restitution)
+    {
+        static_assert(BOUNDARY == PARTICLE_BOUNDARY_SEGMENT_BVH,
+            "This particle system was not built with a segment BVH boundary");
+        _manager.SetSegmentBvh(segmentBufferId, nodeBufferId, segmentCount, mode, restitution);
+    }
+
+    ParticleManager &GetManager()
+    {
+        return _manager;
+    }
+
+    const ParticleManager &GetManager() const
+    {
+        return _manager;
+    }
+
+private:
+    ParticleManager _manager;
+};
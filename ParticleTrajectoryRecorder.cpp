@@ -0,0 +1,753 @@
+#include "ParticleTrajectoryRecorder.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
+#include "GlFenceSync.h"
+#include "ShaderProgramRegistry.h"
+#include "GpuMemoryLedger.h"
+#include "ComputeDeviceCaps.h"
+#include "Log.h"
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.  Nothing is recorded until Init(...) and Start(...).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleTrajectoryRecorder::ParticleTrajectoryRecorder() :
+    _trajectoryProgramId(0),
+    _trajectoryWorkGroupSizeX(ParticleManager::DEFAULT_WORK_GROUP_SIZE),
+    _unifLocTrajectoryParticleCount(0),
+    _unifLocTrajectoryIsKeyframe(0),
+    _lastBufferId(0),
+    _deltaBufferId(0),
+    _isRecording(false),
+    _output(0),
+    _particleCount(0),
+    _framesPerChunk(0),
+    _readbackBufferId(0),
+    _mappedReadback(0),
+    _slotSizeBytes(0),
+    _recordedFrames(0),
+    _droppedFrames(0),
+    _isStopping(false),
+    _fileOffset(0)
+{
+    for (unsigned int slotIndex = 0; slotIndex < TRAJECTORY_SLOTS; slotIndex++)
+    {
+        _fences[slotIndex] = 0;
+        _slotStates[slotIndex] = TRAJECTORY_SLOT_FREE;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.  The writer must
+    be joined before the std::thread is destroyed, or the program is terminated.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleTrajectoryRecorder::~ParticleTrajectoryRecorder()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes a reference to the trajectory program (see ShaderProgramRegistry.h).  The caller may
+    release their own reference after this returns.
+Parameters:
+    trajectoryProgramId     shaderParticle.comp generated with GetTrajectoryShaderDefines(...).
+                            Must be built for the same particle layout as the particle
+                            manager's program.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleTrajectoryRecorder::Init(unsigned int trajectoryProgramId)
+{
+    this->Cleanup();
+    if (trajectoryProgramId == 0)
+    {
+        LogPrintf("the trajectory recorder needs its program\n");
+        return;
+    }
+
+    // the bindings come after everyone else's
+    GLint maxBindings = 0;
+    glGetIntegerv(GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS, &maxBindings);
+    if (maxBindings <= (GLint)TRAJECTORY_DELTA_BUFFER_BINDING)
+    {
+        LogPrintf("the trajectory recorder needs %u shader storage bindings, but there are "
+            "only %d\n", TRAJECTORY_DELTA_BUFFER_BINDING + 1, maxBindings);
+        return;
+    }
+
+    _trajectoryProgramId = trajectoryProgramId;
+    AddProgramReference(_trajectoryProgramId);
+    this->LoadProgramInterface();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Stops any recording and releases the program.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleTrajectoryRecorder::Cleanup()
+{
+    this->Stop();
+    if (_trajectoryProgramId != 0)
+    {
+        ReleaseProgram(_trajectoryProgramId);
+        _trajectoryProgramId = 0;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Switches to a rebuilt program (see ParticleManager::ReplaceProgram(...)).
+Parameters:
+    oldProgramId    Self-explanatory.  Programs that this recorder doesn't use are ignored.
+    newProgramId    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleTrajectoryRecorder::ReplaceProgram(unsigned int oldProgramId,
+    unsigned int newProgramId)
+{
+    if (oldProgramId == 0 || newProgramId == 0 || _trajectoryProgramId != oldProgramId)
+    {
+        return;
+    }
+
+    AddProgramReference(newProgramId);
+    ReleaseProgram(_trajectoryProgramId);
+    _trajectoryProgramId = newProgramId;
+    this->LoadProgramInterface();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives each encoded frame to the sink as well as (or instead of) the file.  Must be set
+    before Start(...), since the writer thread calls it without a lock.
+Parameters:
+    sink    Runs on the writer thread, so it must not touch GL.  An empty one turns it off.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleTrajectoryRecorder::SetFrameSink(const ParticleTrajectoryFrameSink &sink)
+{
+    if (_isRecording)
+    {
+        LogPrintf("trajectory recorder: the frame sink can't change while recording\n");
+        return;
+    }
+    _frameSink = sink;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Opens the file, makes the GPU's buffers and the ring of readback slots, and starts the
+    writer.  The first frame is a keyframe.
+Parameters:
+    filePath            Overwritten if it exists.  Empty for no file, in which case the
+                        frames only go to the sink (see SetFrameSink(...)).
+    maxParticleCount    The particle manager's pool size.
+    framesPerChunk      How often there is a keyframe, and so how far a reader has to decode
+                        to get to any frame.  Keyframes aren't differences, so they are much
+                        bigger than the rest.
+Returns:
+    False if there is no program, the file couldn't be opened, or there is neither a file nor
+    a sink, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleTrajectoryRecorder::Start(const std::string &filePath,
+    unsigned int maxParticleCount, unsigned int framesPerChunk)
+{
+    this->Stop();
+    if (_trajectoryProgramId == 0 || maxParticleCount == 0 || framesPerChunk == 0)
+    {
+        return false;
+    }
+
+    if (filePath.empty() && !_frameSink)
+    {
+        return false;
+    }
+
+    _fileOffset = 0;
+    _chunkIndex.clear();
+    if (!filePath.empty())
+    {
+        _output = fopen(filePath.c_str(), "wb");
+        if (_output == 0)
+        {
+            LogPrintf("trajectory recorder: couldn't open '%s'\n", filePath.c_str());
+            return false;
+        }
+
+        ParticleTrajectoryFileHeader fileHeader;
+        fileHeader._magic = PARTICLE_TRAJECTORY_MAGIC;
+        fileHeader._version = PARTICLE_TRAJECTORY_VERSION;
+        fileHeader._particleCount = maxParticleCount;
+        fileHeader._framesPerChunk = framesPerChunk;
+        fileHeader._codec = PARTICLE_TRAJECTORY_CODEC_ZERO_RUN_VARINT;
+        fileHeader._quantizationScale = 32767;
+        _fileOffset = fwrite(&fileHeader, 1, sizeof(fileHeader), _output);
+    }
+
+    _particleCount = maxParticleCount;
+    _framesPerChunk = framesPerChunk;
+    _slotSizeBytes = (size_t)maxParticleCount * sizeof(GLuint);
+    _recordedFrames = 0;
+    _droppedFrames = 0;
+
+    // the worst case is 3 bytes per value
+    if (!_encodedFrame.Allocate(_slotSizeBytes * 3 / 2 + 16))
+    {
+        LogPrintf("trajectory recorder: couldn't allocate the encoder's buffer\n");
+        if (_output != 0)
+        {
+            fclose(_output);
+            _output = 0;
+        }
+        return false;
+    }
+
+    // a packed X and Y per particle, on both buffers
+    // Note: The last frame's positions start out as whatever is there because the first frame
+    // is a keyframe, which doesn't read them.
+    glGenBuffers(1, &_lastBufferId);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _lastBufferId);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, _slotSizeBytes, 0, 0);
+    RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "trajectory recorder");
+    BindGlShaderStorageBuffer(TRAJECTORY_LAST_BUFFER_BINDING, _lastBufferId);
+    glGenBuffers(1, &_deltaBufferId);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _deltaBufferId);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, _slotSizeBytes, 0, 0);
+    RecordBoundGlBufferAllocation(GL_SHADER_STORAGE_BUFFER, "trajectory recorder");
+    BindGlShaderStorageBuffer(TRAJECTORY_DELTA_BUFFER_BINDING, _deltaBufferId);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // Note: Coherent, so once a slot's fence is signaled, the writer can read it with no
+    // barrier and no unmapping.
+    GLbitfield storageFlags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &_readbackBufferId);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, _readbackBufferId);
+    glBufferStorage(GL_COPY_WRITE_BUFFER, _slotSizeBytes * TRAJECTORY_SLOTS, 0, storageFlags);
+    RecordBoundGlBufferAllocation(GL_COPY_WRITE_BUFFER, "trajectory recorder readback");
+    _mappedReadback = (const unsigned char *)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0,
+        _slotSizeBytes * TRAJECTORY_SLOTS, storageFlags);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    _isStopping = false;
+    _isRecording = true;
+    _writerThread = std::thread(&ParticleTrajectoryRecorder::WriterLoop, this);
+    LogPrintf("trajectory recorder: %u particles to '%s'\n", maxParticleCount,
+        filePath.empty() ? "(sink only)" : filePath.c_str());
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Waits for the frames that were already read to be written, stops the writer, writes the
+    seek index, and closes the file.  Safe to call more than once.
+
+    Note: This one waits on the GPU, since the frames in flight would otherwise be lost.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleTrajectoryRecorder::Stop()
+{
+    if (!_isRecording)
+    {
+        return;
+    }
+
+    this->HandOffFinishedSlots(true);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _isStopping = true;
+    }
+    _condition.notify_all();
+    _writerThread.join();
+
+    if (_output != 0)
+    {
+        this->WriteIndex();
+        fclose(_output);
+        _output = 0;
+    }
+    _isRecording = false;
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, _readbackBufferId);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _readbackBufferId);
+    DeleteGlBuffers(1, &_readbackBufferId);
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _lastBufferId);
+    DeleteGlBuffers(1, &_lastBufferId);
+    ForgetGpuAllocation(GPU_MEMORY_BUFFER, _deltaBufferId);
+    DeleteGlBuffers(1, &_deltaBufferId);
+    _readbackBufferId = 0;
+    _lastBufferId = 0;
+    _deltaBufferId = 0;
+    _mappedReadback = 0;
+    for (unsigned int slotIndex = 0; slotIndex < TRAJECTORY_SLOTS; slotIndex++)
+    {
+        _slotStates[slotIndex] = TRAJECTORY_SLOT_FREE;
+    }
+    _readySlots.clear();
+    _encodedFrame.Free();
+
+    LogPrintf("trajectory recorder: stopped after %u frames (%u dropped), %llu bytes\n",
+        _recordedFrames, _droppedFrames, _fileOffset);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    True if Start(...) was called and Stop() hasn't been since, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleTrajectoryRecorder::IsRecording() const
+{
+    return _isRecording;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Hands the finished frames to the writer, and then quantizes and differences the particles
+    as the last update left them and starts reading them back.  Call after the updates (and
+    anything else that moves the particles) are done for the frame.  Never waits.
+Parameters:
+    updateIndex     Written with the frame so that a reader can line the frames up with the
+                    simulation (ex: the frame count).  Dropped frames show up as gaps in it.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleTrajectoryRecorder::RecordFrame(unsigned int updateIndex)
+{
+    if (!_isRecording)
+    {
+        return;
+    }
+
+    this->HandOffFinishedSlots(false);
+
+    unsigned int freeSlot = TRAJECTORY_SLOTS;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (unsigned int slotIndex = 0; slotIndex < TRAJECTORY_SLOTS; slotIndex++)
+        {
+            if (_slotStates[slotIndex] == TRAJECTORY_SLOT_FREE)
+            {
+                freeSlot = slotIndex;
+                _slotStates[slotIndex] = TRAJECTORY_SLOT_READING;
+                break;
+            }
+        }
+    }
+    if (freeSlot == TRAJECTORY_SLOTS)
+    {
+        // the pass isn't run either, so the GPU's last frame is still the last one recorded
+        _droppedFrames++;
+        return;
+    }
+
+    ParticleTrajectoryFrameHeader &frame = _slotFrames[freeSlot];
+    frame._frameIndex = _recordedFrames;
+    frame._updateIndex = updateIndex;
+    frame._isKeyframe = ((_recordedFrames % _framesPerChunk) == 0) ? 1 : 0;
+    frame._encodedSizeBytes = 0;
+
+    // another recorder (ex: a stream's) may have bound its own buffers here since
+    BindGlShaderStorageBuffer(TRAJECTORY_LAST_BUFFER_BINDING, _lastBufferId);
+    BindGlShaderStorageBuffer(TRAJECTORY_DELTA_BUFFER_BINDING, _deltaBufferId);
+    UseGlProgram(_trajectoryProgramId);
+    glUniform1ui(_unifLocTrajectoryParticleCount, _particleCount);
+    glUniform1ui(_unifLocTrajectoryIsKeyframe, frame._isKeyframe);
+    unsigned int numWorkGroupsX = 0;
+    unsigned int numWorkGroupsY = 0;
+    GetComputeDispatchSize((_particleCount + _trajectoryWorkGroupSizeX - 1) /
+        _trajectoryWorkGroupSizeX, &numWorkGroupsX, &numWorkGroupsY);
+    glDispatchCompute(numWorkGroupsX, numWorkGroupsY, 1);
+    UseGlProgram(0);
+
+    // the copy reads what the pass wrote
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_COPY_READ_BUFFER, _deltaBufferId);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, _readbackBufferId);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0,
+        freeSlot * _slotSizeBytes, _slotSizeBytes);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    _fences[freeSlot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    _readingSlots.push_back(freeSlot);
+    _recordedFrames++;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The frames that were read since Start(...), whether or not they have been written yet.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleTrajectoryRecorder::GetRecordedFrameCount() const
+{
+    return _recordedFrames;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The frames that were skipped since Start(...) because there was no free slot.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleTrajectoryRecorder::GetDroppedFrameCount() const
+{
+    return _droppedFrames;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Puts the trajectory pass's #define after the particle layout's (see
+    ParticleManager::GetComputeShaderDefines(...)).
+Parameters:
+    layout          Must be the particle manager's.
+    workGroupSize   Self-explanatory.
+Returns:
+    A block of #defines for GenerateComputeShaderProgram(...).
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+std::string ParticleTrajectoryRecorder::GetTrajectoryShaderDefines(ParticleLayout layout,
+    unsigned int workGroupSize)
+{
+    return ParticleManager::GetComputeShaderDefines(layout, workGroupSize) +
+        "#define PARTICLE_TRAJECTORY_PASS\n";
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Looks up the trajectory program's uniforms and work group size.  Called by Init(...) and
+    whenever the program is replaced.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleTrajectoryRecorder::LoadProgramInterface()
+{
+    _unifLocTrajectoryParticleCount = glGetUniformLocation(_trajectoryProgramId,
+        "uTrajectoryParticleCount");
+    _unifLocTrajectoryIsKeyframe = glGetUniformLocation(_trajectoryProgramId,
+        "uTrajectoryIsKeyframe");
+
+    // same as ParticleManager::Init(...); the dispatch must match the program
+    GLint programWorkGroupSize[3] = { 0, 0, 0 };
+    glGetProgramiv(_trajectoryProgramId, GL_COMPUTE_LOCAL_WORK_SIZE, programWorkGroupSize);
+    _trajectoryWorkGroupSizeX = (programWorkGroupSize[0] > 0) ?
+        programWorkGroupSize[0] : ParticleManager::DEFAULT_WORK_GROUP_SIZE;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Passes the slots whose reads are done to the writer, oldest first, so that the frames stay
+    in order.  Stops at the first one that isn't done.
+Parameters:
+    waitForGpu  If true, waits for every slot instead of stopping.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleTrajectoryRecorder::HandOffFinishedSlots(bool waitForGpu)
+{
+    bool handedOff = false;
+    while (!_readingSlots.empty())
+    {
+        unsigned int slotIndex = _readingSlots.front();
+        GLsync slotFence = (GLsync)_fences[slotIndex];
+        if (!waitForGpu && !IsGlFenceSignaled(slotFence))
+        {
+            break;
+        }
+        WaitForGlFence(slotFence, GL_FENCE_WAIT_FOREVER, "trajectory readback");
+
+        glDeleteSync(slotFence);
+        _fences[slotIndex] = 0;
+        _readingSlots.pop_front();
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _slotStates[slotIndex] = TRAJECTORY_SLOT_WRITING;
+            _readySlots.push_back(slotIndex);
+        }
+        handedOff = true;
+    }
+    if (handedOff)
+    {
+        _condition.notify_all();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The writer thread.  Writes the ready slots in order until it is told to stop, and after
+    that, until there are none left.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleTrajectoryRecorder::WriterLoop()
+{
+    while (true)
+    {
+        unsigned int slotIndex = 0;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _condition.wait(lock, [this]() { return _isStopping || !_readySlots.empty(); });
+            if (_readySlots.empty())
+            {
+                // stopping, and everything has been written
+                return;
+            }
+            slotIndex = _readySlots.front();
+            _readySlots.pop_front();
+        }
+
+        this->WriteFrame(slotIndex);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _slotStates[slotIndex] = TRAJECTORY_SLOT_FREE;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Encodes one frame's differences (see PARTICLE_TRAJECTORY_CODEC_ZERO_RUN_VARINT), gives it
+    to the sink, and writes it out, and starts a new chunk of the seek index if it is a
+    keyframe.
+
+    Note: Runs on the writer thread.
+Parameters:
+    slotIndex   The slot that the frame was read into.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleTrajectoryRecorder::WriteFrame(unsigned int slotIndex)
+{
+    const unsigned short *values =
+        (const unsigned short *)(_mappedReadback + (slotIndex * _slotSizeBytes));
+    size_t valueCount = _slotSizeBytes / sizeof(unsigned short);
+    unsigned char *encoded = _encodedFrame.GetData();
+    size_t encodedSize = EncodeTrajectoryValues(values, valueCount, encoded);
+
+    ParticleTrajectoryFrameHeader frame = _slotFrames[slotIndex];
+    frame._encodedSizeBytes = (unsigned int)encodedSize;
+    if (_frameSink)
+    {
+        _frameSink(frame, encoded);
+    }
+    if (_output == 0)
+    {
+        return;
+    }
+
+    if (frame._isKeyframe != 0)
+    {
+        ParticleTrajectoryIndexEntry chunk;
+        chunk._fileOffset = _fileOffset;
+        chunk._firstFrameIndex = frame._frameIndex;
+        chunk._frameCount = 0;
+        _chunkIndex.push_back(chunk);
+    }
+    if (!_chunkIndex.empty())
+    {
+        _chunkIndex.back()._frameCount++;
+    }
+    _fileOffset += fwrite(&frame, 1, sizeof(frame), _output);
+    _fileOffset += fwrite(encoded, 1, encodedSize, _output);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Writes the seek index and the trailer after the last frame.  The writer must be stopped.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleTrajectoryRecorder::WriteIndex()
+{
+    ParticleTrajectoryFileTrailer trailer;
+    trailer._indexOffset = _fileOffset;
+    trailer._chunkCount = (unsigned int)_chunkIndex.size();
+    trailer._magic = PARTICLE_TRAJECTORY_MAGIC;
+    if (!_chunkIndex.empty())
+    {
+        _fileOffset += fwrite(_chunkIndex.data(), sizeof(ParticleTrajectoryIndexEntry),
+            _chunkIndex.size(), _output) * sizeof(ParticleTrajectoryIndexEntry);
+    }
+    _fileOffset += fwrite(&trailer, 1, sizeof(trailer), _output);
+    _chunkIndex.clear();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Encodes 16-bit values with PARTICLE_TRAJECTORY_CODEC_ZERO_RUN_VARINT.
+Parameters:
+    values          Each one is taken as a signed 16-bit difference (or keyframe value).
+    valueCount      Self-explanatory.
+    putEncodedHere  Must have room for 3 bytes per value.
+Returns:
+    The encoded size in bytes.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+size_t EncodeTrajectoryValues(const unsigned short *values, size_t valueCount,
+    unsigned char *putEncodedHere)
+{
+    unsigned char *encoded = putEncodedHere;
+    size_t encodedSize = 0;
+    size_t zeroRun = 0;
+    for (size_t valueIndex = 0; valueIndex <= valueCount; valueIndex++)
+    {
+        // zigzag: the sign goes in the low bit
+        unsigned int zigzag = 0;
+        if (valueIndex < valueCount)
+        {
+            int difference = (short)values[valueIndex];
+            zigzag = ((unsigned int)difference << 1) ^ (unsigned int)(difference >> 31);
+            zigzag &= 0xFFFF;
+            if (zigzag == 0)
+            {
+                zeroRun++;
+                continue;
+            }
+        }
+
+        // a value that isn't 0, or the end of the frame, ends the run
+        if (zeroRun > 0)
+        {
+            encoded[encodedSize++] = 0;
+            size_t runValue = zeroRun - 1;
+            while (runValue >= 0x80)
+            {
+                encoded[encodedSize++] = (unsigned char)(runValue | 0x80);
+                runValue >>= 7;
+            }
+            encoded[encodedSize++] = (unsigned char)runValue;
+            zeroRun = 0;
+        }
+        if (valueIndex < valueCount)
+        {
+            while (zigzag >= 0x80)
+            {
+                encoded[encodedSize++] = (unsigned char)(zigzag | 0x80);
+                zigzag >>= 7;
+            }
+            encoded[encodedSize++] = (unsigned char)zigzag;
+        }
+    }
+
+    return encodedSize;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Undoes EncodeTrajectoryValues(...).  The values come back as they went in (differences or
+    keyframe values); adding differences to the last frame is up to the caller.
+Parameters:
+    encoded             Self-explanatory.
+    encodedSizeBytes    Self-explanatory.
+    putValuesHere       Must have room for valueCount values.
+    valueCount          How many values the frame has.
+Returns:
+    False if the data is cut short, runs past valueCount, or has a varint that is too long,
+    otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool DecodeTrajectoryValues(const unsigned char *encoded, size_t encodedSizeBytes,
+    unsigned short *putValuesHere, size_t valueCount)
+{
+    size_t readIndex = 0;
+    size_t valueIndex = 0;
+    while (readIndex < encodedSizeBytes)
+    {
+        bool isZeroRun = (encoded[readIndex] == 0);
+        if (isZeroRun)
+        {
+            readIndex++;
+        }
+
+        // a run's length is at most the values in the frame, which fits in 5 bytes
+        unsigned long long varint = 0;
+        unsigned int shift = 0;
+        bool isComplete = false;
+        while (readIndex < encodedSizeBytes && shift < 35)
+        {
+            unsigned char byte = encoded[readIndex++];
+            varint |= (unsigned long long)(byte & 0x7F) << shift;
+            shift += 7;
+            if ((byte & 0x80) == 0)
+            {
+                isComplete = true;
+                break;
+            }
+        }
+        if (!isComplete)
+        {
+            return false;
+        }
+
+        if (isZeroRun)
+        {
+            unsigned long long runLength = varint + 1;
+            if (runLength > valueCount - valueIndex)
+            {
+                return false;
+            }
+            for (unsigned long long runIndex = 0; runIndex < runLength; runIndex++)
+            {
+                putValuesHere[valueIndex++] = 0;
+            }
+        }
+        else
+        {
+            if (valueIndex == valueCount || varint > 0xFFFF)
+            {
+                return false;
+            }
+            unsigned int zigzag = (unsigned int)varint;
+            unsigned int value = (zigzag >> 1) ^ (0u - (zigzag & 1));
+            putValuesHere[valueIndex++] = (unsigned short)value;
+        }
+    }
+
+    return valueIndex == valueCount;
+}
@@ -0,0 +1,194 @@
+#pragma once
+
+#include "ParticleManager.h"
+#include "LargeHostBuffer.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdio.h>
+
+// the file format of ParticleTrajectoryRecorder
+// Note: The file header is followed by the frames, each one a ParticleTrajectoryFrameHeader
+// and then its encoded particles, and then by the seek index (one entry per chunk) and the
+// trailer, which has the offset of the index.  Every chunk starts with a keyframe, so a
+// reader can seek to the chunk before the frame it wants and decode forward from there
+// without anything before the chunk.
+// Also Note: Every particle is a 16-bit X and a 16-bit Y, each one round(position * 32767)
+// with the position clamped to [-1,+1], or 0x8000 on both axes if the particle is inactive.
+// A keyframe stores them as they are, and every other frame stores the difference from the
+// frame before it (mod 65536).  Each difference is then encoded for the file (see
+// PARTICLE_TRAJECTORY_CODEC_ZERO_RUN_VARINT).
+static const unsigned int PARTICLE_TRAJECTORY_MAGIC = 0x4a415254;   // "TRAJ" in the file
+static const unsigned int PARTICLE_TRAJECTORY_VERSION = 1;
+
+// how the 16-bit values of each frame are packed into the file
+// Note: In the order X0, Y0, X1, Y1..., each value is zigzag-encoded (0, -1, 1, -2... become
+// 0, 1, 2, 3...) so that small differences of either sign are small numbers.  A value that
+// isn't 0 is written as a little-endian base-128 varint (7 bits per byte, high bit set on
+// every byte but the last), whose first byte is never 0.  A run of 0s is a 0 byte followed by
+// a varint of the run's length minus 1.  Particles that don't move, and the inactive ones,
+// cost next to nothing.
+enum ParticleTrajectoryCodec
+{
+    PARTICLE_TRAJECTORY_CODEC_ZERO_RUN_VARINT = 1,
+};
+
+struct ParticleTrajectoryFileHeader
+{
+    unsigned int _magic;
+    unsigned int _version;
+    unsigned int _particleCount;
+    unsigned int _framesPerChunk;
+    unsigned int _codec;                    // a ParticleTrajectoryCodec
+    unsigned int _quantizationScale;        // 32767
+};
+
+struct ParticleTrajectoryFrameHeader
+{
+    unsigned int _frameIndex;               // counts the recorded frames from 0
+    unsigned int _updateIndex;              // whatever the caller gave RecordFrame(...)
+    unsigned int _isKeyframe;
+    unsigned int _encodedSizeBytes;
+};
+
+struct ParticleTrajectoryIndexEntry
+{
+    unsigned long long _fileOffset;         // of the chunk's keyframe's frame header
+    unsigned int _firstFrameIndex;
+    unsigned int _frameCount;
+};
+
+struct ParticleTrajectoryFileTrailer
+{
+    unsigned long long _indexOffset;
+    unsigned int _chunkCount;
+    unsigned int _magic;
+};
+
+// the codec on its own, for whoever else moves these frames around (see ParticleStream.h)
+// Note: The encoded size is never more than 3 bytes per value.
+size_t EncodeTrajectoryValues(const unsigned short *values, size_t valueCount,
+    unsigned char *putEncodedHere);
+bool DecodeTrajectoryValues(const unsigned char *encoded, size_t encodedSizeBytes,
+    unsigned short *putValuesHere, size_t valueCount);
+
+// gets every encoded frame as it is written (see ParticleTrajectoryRecorder::SetFrameSink(...))
+// Note: Runs on the recorder's writer thread, and the data is only good for the call.
+typedef std::function<void(const ParticleTrajectoryFrameHeader &frame,
+    const unsigned char *encoded)> ParticleTrajectoryFrameSink;
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Records every particle's position, frame after frame, to a file small enough to keep up
+    with for a long run.  8 million particles of raw positions at 60Hz would be almost 4GB a
+    second.
+
+    The GPU does the quantizing and the differencing: a pass of the trajectory program turns
+    each position into 16 bits per axis and writes its difference from the last recorded
+    frame (which it also keeps, on the GPU), so the readback is half the size of the raw
+    positions and mostly small numbers.  The differences are copied into a ring of persistently
+    mapped slots and fenced, and once a slot's fence is signaled, a writer thread encodes it
+    and writes it out, straight from the mapped buffer (see the file format above).  Like
+    FrameCapture, a frame with no free slot is dropped and counted rather than waited on, and
+    since the pass isn't run for it, the next frame's differences are from the last frame that
+    was recorded.
+
+    The trajectory program is shaderParticle.comp built with PARTICLE_TRAJECTORY_PASS defined
+    (see GetTrajectoryShaderDefines(...)), so it loads particles with the same storage layout
+    code as the update.  It reads the particle buffers through the shader storage bindings
+    that ParticleManager set up, so it must run after the update and while that particle
+    manager is alive.
+
+    The encoded frames can also go to a sink (see SetFrameSink(...)), with or without a file.
+
+    Note: The pool size is fixed when the recording starts.  Stop() and Start(...) again if
+    the pool is resized.
+    Also Note: The encoding is a simple one that runs on one thread.  If the writer can't keep
+    up with the frame rate, frames are dropped, and the file is still good.  LZ4 or zstd would
+    pack the same differences tighter, and would be another ParticleTrajectoryCodec.
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+class ParticleTrajectoryRecorder
+{
+public:
+    ParticleTrajectoryRecorder();
+    ~ParticleTrajectoryRecorder();
+    void Init(unsigned int trajectoryProgramId);
+    void Cleanup();
+    void ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId);
+    void SetFrameSink(const ParticleTrajectoryFrameSink &sink);
+
+    bool Start(const std::string &filePath, unsigned int maxParticleCount,
+        unsigned int framesPerChunk = 60);
+    void Stop();
+    bool IsRecording() const;
+    void RecordFrame(unsigned int updateIndex);
+    unsigned int GetRecordedFrameCount() const;
+    unsigned int GetDroppedFrameCount() const;
+
+    static std::string GetTrajectoryShaderDefines(ParticleLayout layout,
+        unsigned int workGroupSize = ParticleManager::DEFAULT_WORK_GROUP_SIZE);
+
+private:
+    enum SlotState
+    {
+        TRAJECTORY_SLOT_FREE = 0,
+        TRAJECTORY_SLOT_READING,    // waiting on the GPU
+        TRAJECTORY_SLOT_WRITING,    // with the writer thread
+    };
+
+    void LoadProgramInterface();
+    void HandOffFinishedSlots(bool waitForGpu);
+    void WriterLoop();
+    void WriteFrame(unsigned int slotIndex);
+    void WriteIndex();
+
+    unsigned int _trajectoryProgramId;
+    unsigned int _trajectoryWorkGroupSizeX;
+    unsigned int _unifLocTrajectoryParticleCount;
+    unsigned int _unifLocTrajectoryIsKeyframe;
+
+    // the last recorded frame's quantized positions and this frame's differences
+    // Note: The bindings continue from ParticleSegmentBvh's and must match
+    // shaderParticle.comp.
+    static const unsigned int TRAJECTORY_LAST_BUFFER_BINDING = 32;
+    static const unsigned int TRAJECTORY_DELTA_BUFFER_BINDING = 33;
+    unsigned int _lastBufferId;
+    unsigned int _deltaBufferId;
+
+    // 3 frames of GPU latency, plus 1 for the writer
+    static const unsigned int TRAJECTORY_SLOTS = 4;
+    bool _isRecording;
+    FILE *_output;
+    ParticleTrajectoryFrameSink _frameSink;
+    unsigned int _particleCount;
+    unsigned int _framesPerChunk;
+    unsigned int _readbackBufferId;
+    const unsigned char *_mappedReadback;
+    size_t _slotSizeBytes;
+    void *_fences[TRAJECTORY_SLOTS];
+    std::deque<unsigned int> _readingSlots;
+    unsigned int _recordedFrames;
+    unsigned int _droppedFrames;
+
+    // same handoff as FrameCapture's
+    // Note: The frame headers are filled in by the render thread before the slot is handed
+    // off, and only read by the writer after.
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::thread _writerThread;
+    std::deque<unsigned int> _readySlots;
+    SlotState _slotStates[TRAJECTORY_SLOTS];
+    ParticleTrajectoryFrameHeader _slotFrames[TRAJECTORY_SLOTS];
+    bool _isStopping;
+
+    // only the writer touches these
+    LargeHostBuffer _encodedFrame;
+    std::vector<ParticleTrajectoryIndexEntry> _chunkIndex;
+    unsigned long long _fileOffset;
+};
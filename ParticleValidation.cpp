@@ -0,0 +1,447 @@
+#include "ParticleValidation.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "glm/vec2.hpp"
+#include "glm/detail/func_geometric.hpp"    // glm::length
+#include "glm/detail/func_packing.hpp"      // glm::packHalf2x16
+
+#include "ParticleManager.h"
+#include "ShaderProgramRegistry.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+// big enough to cover many work groups and CPU chunks, small enough that the CPU reference
+// is quick
+static const unsigned int VALIDATION_PARTICLES = 65536;
+
+// half a second at the interactive mode's simulation rate; the substeps must divide the steps
+static const unsigned int VALIDATION_STEPS = 60;
+static const unsigned int VALIDATION_SUBSTEPS = 4;
+static const float VALIDATION_STEP_SEC = 1.0f / 120.0f;
+
+// picks the particles; printed with the results so that a failure can be run again
+static const unsigned int VALIDATION_SEED = 12345;
+
+// the particles start all over the window and the emitter's circle is a little smaller than
+// it, so some start out of bounds, some leave during the run, and some run out of lifetime
+// (they start with ages from 0 to 1, and the run is a quarter of the lifetime)
+static const glm::vec2 VALIDATION_EMITTER_CENTER(0.0f, 0.0f);
+static const float VALIDATION_EMITTER_RADIUS = 0.9f;
+static const float VALIDATION_LIFETIME_SEC = 2.0f;
+
+// how far a position and an age may drift from the reference per step
+// Note: Float positions only differ by the order of operations (ex: fused multiply-adds).
+// Half float positions are rounded to 16 bits on every step, which is up to half of 1/512
+// near the edge of the window.  The structure-of-arrays and half float layouts keep the age
+// in 16 bits (see PackParticleFlags(...) in shaderParticle.comp).  The fixed-point layout 
+// rounds the velocity and the age at random on every step (see PackedFixedParticle in 
+// Particle.h), by up to 1/256th of the window per second and 1/511th, which is right on 
+// average but wanders from the reference, and it moves the particles by the half float 
+// layout's tolerance.
+static const float VALIDATION_FLOAT_POSITION_TOLERANCE_PER_STEP = 2e-5f;
+static const float VALIDATION_HALF_POSITION_TOLERANCE_PER_STEP = 1e-3f;
+static const float VALIDATION_FLOAT_AGE_TOLERANCE_PER_STEP = 1e-6f;
+static const float VALIDATION_PACKED_AGE_TOLERANCE_PER_STEP = 1e-5f;
+static const float VALIDATION_FIXED_AGE_TOLERANCE_PER_STEP = 2e-3f;
+
+// the fast paths of the GPU's update that are each checked against the reference
+enum ValidationPath
+{
+    // the defaults: the live update list, one particle per work item, one step per dispatch
+    VALIDATION_PATH_DEFAULT = 0,
+    VALIDATION_PATH_WHOLE_POOL,
+    VALIDATION_PATH_COARSENED,
+    VALIDATION_PATH_SUBSTEPS,
+    VALIDATION_PATH_FIXED_EMITTER,
+    VALIDATION_PATH_AGGREGATED_ATOMICS,
+    VALIDATION_PATH_FORCES,
+
+    VALIDATION_PATH_COUNT,
+};
+static const char *VALIDATION_PATH_NAMES[VALIDATION_PATH_COUNT] =
+{
+    "default", "whole_pool", "coarsened", "substeps", "fixed_emitter", "aggregated_atomics",
+    "forces"
+};
+static const char *VALIDATION_LAYOUT_NAMES[] = 
+{
+    "interleaved", "soa", "half_float", "fixed_point"
+};
+
+// the result of one comparison
+struct ValidationResult
+{
+    unsigned int _comparedCount;
+    unsigned int _mismatchCount;
+    unsigned int _borderlineCount;
+    float _maxPositionError;
+    float _maxAgeError;
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Makes the validation's pool: positions all over the window, velocities of up to 0.5 in
+    either direction, ages from 0 to 1, and 3 of every 4 particles active.  The generator is
+    the same as the benchmark's, so every machine gets the same particles.
+Parameters:
+    numParticles    Self-explanatory.
+    seed            Self-explanatory.
+Returns:
+    The particles.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static std::vector<Particle> MakeValidationParticles(unsigned int numParticles,
+    unsigned int seed)
+{
+    std::vector<Particle> particles(numParticles);
+    for (unsigned int particleIndex = 0; particleIndex < numParticles; particleIndex++)
+    {
+        float random[6];
+        for (int randomIndex = 0; randomIndex < 6; randomIndex++)
+        {
+            seed = (seed * 1664525u) + 1013904223u;
+            random[randomIndex] = (seed >> 8) / 16777216.0f;
+        }
+
+        Particle &p = particles[particleIndex];
+        p._position = glm::vec2(random[0], random[1]) * 2.0f - 1.0f;
+        p._velocity = (glm::vec2(random[2], random[3]) * 2.0f - 1.0f) * 0.5f;
+        p._age = random[4];
+        p._isActive = (random[5] < 0.75f) ? 1 : 0;
+    }
+    return particles;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Rounds the particles the way that a layout stores them, so that the reference starts from
+    exactly what the GPU loaded instead of from values that the GPU never saw.
+Parameters:
+    layout      Self-explanatory.
+    particles   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static void QuantizeValidationParticles(ParticleLayout layout,
+    std::vector<Particle> *particles)
+{
+    for (size_t particleIndex = 0; particleIndex < particles->size(); particleIndex++)
+    {
+        Particle &p = (*particles)[particleIndex];
+        if (layout == PARTICLE_LAYOUT_HALF_FLOAT)
+        {
+            p._position = glm::unpackHalf2x16(glm::packHalf2x16(p._position));
+            p._velocity = glm::unpackHalf2x16(glm::packHalf2x16(p._velocity));
+        }
+        if (layout == PARTICLE_LAYOUT_FIXED_POINT)
+        {
+            p = UnpackFixedParticle(PackFixedParticle(p));
+        }
+        else if (layout != PARTICLE_LAYOUT_INTERLEAVED)
+        {
+            p._age = floorf((p._age * 65535.0f) + 0.5f) / 65535.0f;
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Builds one of the managers of a comparison: the programs for the layout and kernel
+    variant, the backend, a single emitter with the validation's bounds and lifetime and no
+    emission, and the path's settings.
+Parameters:
+    backend     The GPU for the path under test, or the CPU for the reference.
+    layout      Self-explanatory.
+    path        Self-explanatory.
+    manager     Self-explanatory.
+Returns:
+    False if a program couldn't be built, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static bool InitValidationManager(ParticleSimulationBackend backend, ParticleLayout layout,
+    ValidationPath path, ParticleManager *manager)
+{
+    // the reference always runs the default kernel (the CPU backend doesn't use it anyway)
+    ParticleKernelVariant variant = ParticleManager::GetDefaultKernelVariant();
+
+    // the default variant's emitter has everything zeroed
+    ParticleEmitter emitter = variant._fixedEmitter;
+    emitter._center = VALIDATION_EMITTER_CENTER;
+    emitter._radius = VALIDATION_EMITTER_RADIUS;
+    emitter._velocityMin = 0.05f;
+    emitter._velocityMax = 0.5f;
+    if (backend == PARTICLE_SIMULATION_BACKEND_GPU)
+    {
+        if (path == VALIDATION_PATH_FIXED_EMITTER)
+        {
+            variant._hasFixedEmitter = true;
+            variant._fixedEmitter = emitter;
+        }
+        else if (path == VALIDATION_PATH_AGGREGATED_ATOMICS)
+        {
+            variant._atomicAggregation = ParticleManager::GetBestAtomicAggregation();
+        }
+        else if (path == VALIDATION_PATH_FORCES)
+        {
+            // the CPU backend only has semi-implicit Euler
+            variant._integrator = PARTICLE_INTEGRATOR_SEMI_IMPLICIT_EULER;
+        }
+    }
+
+    GLuint renderProgramId = AcquireRenderProgram();
+    GLuint computeProgramId = AcquireComputeProgram(ParticleManager::GetComputeShaderDefines(
+        layout, ParticleManager::DEFAULT_WORK_GROUP_SIZE, variant));
+    if (renderProgramId == 0 || computeProgramId == 0)
+    {
+        ReleaseProgram(renderProgramId);
+        ReleaseProgram(computeProgramId);
+        return false;
+    }
+
+    manager->SetSimulationBackend(backend);
+    manager->Init(renderProgramId, computeProgramId, VALIDATION_PARTICLES, 0,
+        emitter._center, emitter._radius, emitter._velocityMin, emitter._velocityMax, layout);
+    ReleaseProgram(renderProgramId);
+    ReleaseProgram(computeProgramId);
+
+    ParticleEmitter withLifetime = manager->GetEmitters()[0];
+    withLifetime._lifetimeSec = VALIDATION_LIFETIME_SEC;
+    manager->SetEmitter(0, withLifetime);
+
+    // a gravity well off to one side and some drag, on both sides of the comparison
+    if (path == VALIDATION_PATH_FORCES)
+    {
+        std::vector<ParticleForceField> forceFields(2);
+        forceFields[0]._center = glm::vec2(+0.3f, -0.2f);
+        forceFields[0]._direction = glm::vec2(0.0f, 0.0f);
+        forceFields[0]._strength = 0.5f;
+        forceFields[0]._softeningRadius = 0.1f;
+        forceFields[0]._type = PARTICLE_FORCE_FIELD_ATTRACTOR;
+        forceFields[0]._padding = 0;
+        forceFields[1]._center = glm::vec2(0.0f, 0.0f);
+        forceFields[1]._direction = glm::vec2(0.0f, 0.0f);
+        forceFields[1]._strength = 0.5f;
+        forceFields[1]._softeningRadius = 0.0f;
+        forceFields[1]._type = PARTICLE_FORCE_FIELD_LINEAR_DRAG;
+        forceFields[1]._padding = 0;
+        manager->SetForceFields(forceFields);
+    }
+
+    if (backend == PARTICLE_SIMULATION_BACKEND_GPU)
+    {
+        manager->SetLiveUpdateList(path != VALIDATION_PATH_WHOLE_POOL);
+        manager->SetParticlesPerInvocation((path == VALIDATION_PATH_COARSENED) ? 4 : 1);
+        manager->SetSubstepsPerDispatch(
+            (path == VALIDATION_PATH_SUBSTEPS) ? VALIDATION_SUBSTEPS : 1);
+    }
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Compares the GPU's particles with the reference's (see ParticleValidation.h for what
+    counts as a mismatch).
+Parameters:
+    gpuParticles        Self-explanatory.
+    referenceParticles  Self-explanatory.
+    positionTolerance   Self-explanatory.
+    ageTolerance        Self-explanatory.
+    putResultHere       Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static void CompareValidationParticles(const std::vector<Particle> &gpuParticles,
+    const std::vector<Particle> &referenceParticles, float positionTolerance,
+    float ageTolerance, ValidationResult *putResultHere)
+{
+    ValidationResult result = { 0, 0, 0, 0.0f, 0.0f };
+    float agePerStep = VALIDATION_STEP_SEC / VALIDATION_LIFETIME_SEC;
+    for (size_t particleIndex = 0; particleIndex < referenceParticles.size(); particleIndex++)
+    {
+        const Particle &gpu = gpuParticles[particleIndex];
+        const Particle &reference = referenceParticles[particleIndex];
+        bool isGpuActive = (gpu._isActive != 0);
+        bool isReferenceActive = (reference._isActive != 0);
+        if (!isGpuActive && !isReferenceActive)
+        {
+            continue;
+        }
+
+        // the one that is still alive must have been within a step (plus the drift) of where
+        // the other one died
+        if (isGpuActive != isReferenceActive)
+        {
+            const Particle &alive = isGpuActive ? gpu : reference;
+            float distance = glm::length(alive._position - VALIDATION_EMITTER_CENTER);
+            float stepDistance = glm::length(alive._velocity) * VALIDATION_STEP_SEC;
+            bool isNearEdge = fabsf(distance - VALIDATION_EMITTER_RADIUS) <=
+                (positionTolerance + stepDistance);
+            bool isNearEnd = (1.0f - alive._age) <= (ageTolerance + agePerStep);
+            if (isNearEdge || isNearEnd)
+            {
+                result._borderlineCount++;
+            }
+            else
+            {
+                result._mismatchCount++;
+            }
+            continue;
+        }
+
+        result._comparedCount++;
+        float positionError = glm::length(gpu._position - reference._position);
+        float ageError = fabsf(gpu._age - reference._age);
+        result._maxPositionError = (positionError > result._maxPositionError) ?
+            positionError : result._maxPositionError;
+        result._maxAgeError = (ageError > result._maxAgeError) ? ageError : result._maxAgeError;
+
+        // written so that a NaN is a mismatch
+        if (!(positionError <= positionTolerance) || !(ageError <= ageTolerance))
+        {
+            result._mismatchCount++;
+        }
+    }
+
+    *putResultHere = result;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Runs one path of the GPU's update and the CPU reference from the same particles, compares
+    them, and prints the row.
+Parameters:
+    layout      Self-explanatory.
+    path        Self-explanatory.
+    particles   The pool that both start from.
+Returns:
+    True if the GPU agreed with the reference, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static bool RunValidationCase(ParticleLayout layout, ValidationPath path,
+    const std::vector<Particle> &particles)
+{
+    const char *layoutName = VALIDATION_LAYOUT_NAMES[layout];
+    const char *pathName = VALIDATION_PATH_NAMES[path];
+    ParticleManager gpuManager;
+    ParticleManager referenceManager;
+    if (!InitValidationManager(PARTICLE_SIMULATION_BACKEND_GPU, layout, path, &gpuManager) ||
+        !InitValidationManager(PARTICLE_SIMULATION_BACKEND_CPU, layout, path,
+        &referenceManager))
+    {
+        printf("# %s %s: couldn't build the programs\n", layoutName, pathName);
+        gpuManager.Cleanup();
+        referenceManager.Cleanup();
+        return false;
+    }
+
+    // the reference starts from exactly what the GPU's layout can hold
+    std::vector<Particle> referenceParticles = particles;
+    QuantizeValidationParticles(layout, &referenceParticles);
+    bool isLoaded = gpuManager.LoadParticles(particles) &&
+        referenceManager.LoadParticles(referenceParticles);
+
+    // the reference takes its steps one at a time, so the substeps have to add up the same
+    unsigned int stepsPerUpdate = (path == VALIDATION_PATH_SUBSTEPS) ? VALIDATION_SUBSTEPS : 1;
+    for (unsigned int stepCount = 0; stepCount < VALIDATION_STEPS; stepCount += stepsPerUpdate)
+    {
+        gpuManager.UpdateSteps(VALIDATION_STEP_SEC, stepsPerUpdate);
+    }
+    for (unsigned int stepCount = 0; stepCount < VALIDATION_STEPS; stepCount++)
+    {
+        referenceManager.UpdateSteps(VALIDATION_STEP_SEC, 1);
+    }
+
+    std::vector<Particle> gpuResults;
+    std::vector<Particle> referenceResults;
+    bool isRead = gpuManager.ReadParticles(&gpuResults) &&
+        referenceManager.ReadParticles(&referenceResults);
+    gpuManager.Cleanup();
+    referenceManager.Cleanup();
+    if (!isLoaded || !isRead)
+    {
+        printf("# %s %s: couldn't load or read the particles\n", layoutName, pathName);
+        return false;
+    }
+
+    bool isQuantized = (layout == PARTICLE_LAYOUT_HALF_FLOAT || 
+        layout == PARTICLE_LAYOUT_FIXED_POINT);
+    float positionTolerance = VALIDATION_STEPS * (isQuantized ?
+        VALIDATION_HALF_POSITION_TOLERANCE_PER_STEP :
+        VALIDATION_FLOAT_POSITION_TOLERANCE_PER_STEP);
+    float ageTolerance = VALIDATION_STEPS * ((layout == PARTICLE_LAYOUT_INTERLEAVED) ?
+        VALIDATION_FLOAT_AGE_TOLERANCE_PER_STEP : VALIDATION_PACKED_AGE_TOLERANCE_PER_STEP);
+    if (layout == PARTICLE_LAYOUT_FIXED_POINT)
+    {
+        ageTolerance = VALIDATION_STEPS * VALIDATION_FIXED_AGE_TOLERANCE_PER_STEP;
+    }
+    ValidationResult result;
+    CompareValidationParticles(gpuResults, referenceResults, positionTolerance, ageTolerance,
+        &result);
+    bool isPassed = (result._mismatchCount == 0);
+    printf("%s,%s,%u,%u,%u,%u,%u,%.7f,%.7f,%.7f,%.7f,%s\n",
+        layoutName,
+        pathName,
+        VALIDATION_PARTICLES,
+        VALIDATION_STEPS,
+        result._comparedCount,
+        result._mismatchCount,
+        result._borderlineCount,
+        result._maxPositionError,
+        positionTolerance,
+        result._maxAgeError,
+        ageTolerance,
+        isPassed ? "pass" : "FAIL");
+    fflush(stdout);
+    return isPassed;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Runs every path on every layout and prints the results as CSV.  See ParticleValidation.h.
+Parameters: None
+Returns:
+    0 if the GPU agreed with the reference everywhere, otherwise 1.  Suitable for returning
+    from main(...).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+int RunParticleValidation()
+{
+    printf("# renderer: %s\n", (const char *)glGetString(GL_RENDERER));
+    printf("# version: %s\n", (const char *)glGetString(GL_VERSION));
+    printf("# seed: %u\n", VALIDATION_SEED);
+    printf("layout,path,particles,steps,compared,mismatches,borderline,"
+        "max_position_error,position_tolerance,max_age_error,age_tolerance,result\n");
+
+    std::vector<Particle> particles =
+        MakeValidationParticles(VALIDATION_PARTICLES, VALIDATION_SEED);
+    const ParticleLayout layouts[] =
+    {
+        PARTICLE_LAYOUT_INTERLEAVED,
+        PARTICLE_LAYOUT_SOA,
+        PARTICLE_LAYOUT_HALF_FLOAT,
+        PARTICLE_LAYOUT_FIXED_POINT
+    };
+    unsigned int numLayouts = sizeof(layouts) / sizeof(layouts[0]);
+    unsigned int failedCount = 0;
+    for (unsigned int layoutIndex = 0; layoutIndex < numLayouts; layoutIndex++)
+    {
+        for (int pathIndex = 0; pathIndex < VALIDATION_PATH_COUNT; pathIndex++)
+        {
+            if (!RunValidationCase(layouts[layoutIndex], (ValidationPath)pathIndex, particles))
+            {
+                failedCount++;
+            }
+        }
+    }
+
+    printf("# %u of %u cases failed\n", failedCount, numLayouts * VALIDATION_PATH_COUNT);
+    return (failedCount == 0) ? 0 : 1;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Checks the GPU's particle update against the CPU backend, which is the reference (see
+    ParticleManager::SetSimulationBackend(...)).  The CPU backend's bounds test, lifetime, and
+    integration are plain C++ (see ParticleSimdKernels.h and
+    ParticleManager::StepCpuParticlesWithForces(...)), so they are easy to trust, and every
+    fast path of the compute shader has to agree with them.
+
+    For each layout, and for each of the GPU's fast paths (the live update list or the whole
+    pool, work coarsening, substeps per dispatch, a fixed emitter baked into the kernel,
+    aggregated atomics, and force fields), a GPU manager and a CPU manager are given the same
+    pool of particles from the same seed, both run the same steps, and both pools are read
+    back and compared particle for particle.  One CSV row is printed per case.
+
+    A particle that is alive in both must be within a tolerance of the reference's position
+    and age.  The tolerance grows with the number of steps, and is much bigger for the half
+    float layout, which rounds the position to 16 bits on every step.  A particle that is
+    alive in only one is a mismatch, unless it was close enough to its emitter's edge or to
+    the end of its lifetime that the rounding could have decided it ("borderline").
+
+    Note: Emission is off for the whole run.  The GPU and CPU have different random number
+    generators, so emitted particles could never be compared; the loaded particles already
+    cover the update, the bounds test, and the lifetime.
+    Also Note: The caller must have already created an OpenGL 4.4 context and loaded the
+    functions, like for RunBenchmark().
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+int RunParticleValidation();
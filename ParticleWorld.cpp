@@ -0,0 +1,1056 @@
+#include "ParticleWorld.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <math.h>       // ceilf
+#include <stdio.h>
+
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleWorld::ParticleWorld() :
+    _nextAddSequence(0),
+    _isInitialized(false),
+    _offScreenThrottleSec(0.0f),
+    _offScreenUpdatePeriod(1)
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleWorld::~ParticleWorld()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Creates the shared pool at its full capacity and gives every system that was added so far 
+    its range, in the order that they were added, with one draw group per system.
+Parameters:
+    programId           See ParticleManager::Init(...).
+    computeProgramId    Same.
+    layout              Same.
+    particleCapacity    The size of the pool, which can't change later.  0 (or anything too 
+                        small) is exactly enough for the systems added so far, which leaves no 
+                        room for more.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleWorld::Init(unsigned int programId, unsigned int computeProgramId, 
+    ParticleLayout layout, unsigned int particleCapacity)
+{
+    this->Cleanup();
+
+    unsigned int pendingParticleCount = 0;
+    for (size_t systemId = 0; systemId < _systems.size(); systemId++)
+    {
+        ParticleSystemDescriptor &descriptor = _systems[systemId]._descriptor;
+        if (descriptor._isAlive)
+        {
+            pendingParticleCount += descriptor._particleCount;
+        }
+    }
+    if (particleCapacity < pendingParticleCount)
+    {
+        particleCapacity = pendingParticleCount;
+    }
+    if (particleCapacity == 0)
+    {
+        LogPrintf("particle world has no systems and no room for any\n");
+        return;
+    }
+
+    // the arena hands out ranges first fit, so the systems added so far are packed in order 
+    // from the start of the pool, which is also how the manager lays out its initial emitters
+    _arena.Init(particleCapacity);
+    std::vector<ParticleEmitter> initialEmitters;
+    std::vector<unsigned int> firstEmitterOfEachGroup;
+    for (size_t systemId = 0; systemId < _systems.size(); systemId++)
+    {
+        ParticleWorldSystem &system = _systems[systemId];
+        if (system._descriptor._isAlive)
+        {
+            this->AllocateSystemRange(&system);
+            firstEmitterOfEachGroup.push_back((unsigned int)initialEmitters.size());
+            initialEmitters.insert(initialEmitters.end(), system._emitters.begin(), 
+                system._emitters.end());
+        }
+    }
+
+    // the manager always needs an emitter, so an empty world starts with an idle one
+    if (initialEmitters.empty())
+    {
+        ParticleEmitter idleEmitter;
+        idleEmitter._center = glm::vec2(0.0f, 0.0f);
+        idleEmitter._radius = 0.0f;
+        idleEmitter._velocityMin = 0.0f;
+        idleEmitter._velocityMax = 0.0f;
+        idleEmitter._maxParticlesEmittedPerFrame = 0;
+        idleEmitter._particleCount = 0;
+        idleEmitter._firstParticle = 0;
+        idleEmitter._lifetimeSec = 0.0f;
+        idleEmitter._spawnShape = PARTICLE_SPAWN_DISK;
+        initialEmitters.push_back(idleEmitter);
+    }
+
+    _particleManager.SetPoolCapacity(particleCapacity, MAX_EMITTERS, MAX_SYSTEMS);
+    _particleManager.SetDrawGroups(firstEmitterOfEachGroup);
+    _particleManager.Init(programId, computeProgramId, initialEmitters, layout);
+    _isInitialized = true;
+
+    // the manager has the same layout already, so this only fills in the descriptors
+    this->LayOutSystems();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Cleans up the particle manager.  The systems that are still alive are kept (without their 
+    ranges), so the world can be initialized again.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleWorld::Cleanup()
+{
+    if (_isInitialized)
+    {
+        _particleManager.Cleanup();
+        _isInitialized = false;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Adds a particle system.  Before Init(...), it is laid out at Init(...).  After Init(...), 
+    it takes a free range of the pool (defragmenting first if the free space is in pieces) and 
+    the world is laid out again (see LayOutSystems()).  No buffers are created either way.  
+    After Init(...), must be called between frames, not between Update(...) and Render(...).
+
+    If the pool is full, lower priority systems are evicted and the system may be shrunk to 
+    fit (see MakeRoomForSystem(...)).
+Parameters:
+    emitters        At least one.  The "first particle" of each is ignored.
+    priority        Higher is more important.  Systems of the same priority never evict 
+                    each other.
+    minimumFraction The least of the emitters' particle counts (and emission rates) that the 
+                    system will take if there is no room for all of it.  1 is all or nothing.
+Returns:
+    The system's ID, or INVALID_SYSTEM_ID if there isn't room for it.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleWorld::AddSystem(const std::vector<ParticleEmitter> &emitters, 
+    int priority, float minimumFraction)
+{
+    if (emitters.empty())
+    {
+        LogPrintf("a particle system needs at least one emitter\n");
+        return INVALID_SYSTEM_ID;
+    }
+    if (this->GetLiveEmitterCount() + emitters.size() > MAX_EMITTERS)
+    {
+        LogPrintf("a particle world can have at most %u emitters\n", MAX_EMITTERS);
+        return INVALID_SYSTEM_ID;
+    }
+
+    // removed systems' IDs are used again
+    unsigned int systemId = 0;
+    unsigned int aliveSystems = 0;
+    while (systemId < _systems.size() && _systems[systemId]._descriptor._isAlive)
+    {
+        systemId++;
+    }
+    for (size_t otherId = 0; otherId < _systems.size(); otherId++)
+    {
+        aliveSystems += _systems[otherId]._descriptor._isAlive ? 1 : 0;
+    }
+    if (aliveSystems >= MAX_SYSTEMS)
+    {
+        LogPrintf("a particle world can have at most %u systems\n", MAX_SYSTEMS);
+        return INVALID_SYSTEM_ID;
+    }
+
+    ParticleWorldSystem system;
+    system._emitters = emitters;
+    system._style = glm::vec2(1.0f, 1.0f);
+    system._isVisible = true;
+    system._minimumFraction = (minimumFraction < 0.0f) ? 0.0f : 
+        ((minimumFraction > 1.0f) ? 1.0f : minimumFraction);
+    system._addSequence = _nextAddSequence;
+    system._updatePeriod = 1;
+    system._updatePhase = 0;
+    system._isOffScreenThrottled = false;
+    system._descriptor._firstEmitter = 0;
+    system._descriptor._emitterCount = (unsigned int)emitters.size();
+    system._descriptor._firstParticle = 0;
+    system._descriptor._particleCount = 0;
+    system._descriptor._drawGroup = 0;
+    system._descriptor._isAlive = true;
+    system._descriptor._priority = priority;
+    for (size_t emitterIndex = 0; emitterIndex < emitters.size(); emitterIndex++)
+    {
+        system._descriptor._particleCount += emitters[emitterIndex]._particleCount;
+    }
+    if (system._descriptor._particleCount == 0)
+    {
+        LogPrintf("a particle system needs at least one particle\n");
+        return INVALID_SYSTEM_ID;
+    }
+
+    if (_isInitialized && !this->MakeRoomForSystem(&system))
+    {
+        return INVALID_SYSTEM_ID;
+    }
+    _nextAddSequence++;
+
+    if (systemId == _systems.size())
+    {
+        _systems.push_back(system);
+    }
+    else
+    {
+        _systems[systemId] = system;
+    }
+
+    if (_isInitialized)
+    {
+        this->LayOutSystems();
+    }
+    return systemId;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Removes a particle system.  After Init(...), its particles are zeroed (so none of them are 
+    left alive), its range goes back to the arena, and the world is laid out again.  Must be 
+    called between frames.
+Parameters:
+    systemId    Self-explanatory.
+Returns:
+    True if there was such a system, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleWorld::RemoveSystem(unsigned int systemId)
+{
+    if (systemId >= _systems.size() || !_systems[systemId]._descriptor._isAlive)
+    {
+        LogPrintf("no particle system %u to remove\n", systemId);
+        return false;
+    }
+
+    ParticleSystemDescriptor &descriptor = _systems[systemId]._descriptor;
+    descriptor._isAlive = false;
+    if (_isInitialized)
+    {
+        _particleManager.ClearParticleRange(descriptor._firstParticle, descriptor._particleCount);
+        _arena.Free(descriptor._firstParticle);
+        this->LayOutSystems();
+    }
+    _systems[systemId]._emitters.clear();
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Slides every system down to the start of the pool so that all the free space is in one 
+    range at the end (see ParticleArena::Compact()).  Each moved system's particles are copied
+    on the GPU, live ones included, so nothing visibly changes.  Then the space that was left 
+    behind is zeroed and the world is laid out again at the new ranges.  AddSystem(...) calls 
+    this when it needs to.  Must be called between frames.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleWorld::Defragment()
+{
+    if (!_isInitialized)
+    {
+        return;
+    }
+
+    std::vector<ParticleArenaMove> moves = _arena.Compact();
+    if (moves.empty())
+    {
+        return;
+    }
+
+    // moves only go down, in order, so each move's destination is already free
+    for (size_t moveIndex = 0; moveIndex < moves.size(); moveIndex++)
+    {
+        const ParticleArenaMove &move = moves[moveIndex];
+        _particleManager.MoveParticleRange(move._sourceFirst, move._destinationFirst, 
+            move._count);
+        for (size_t systemId = 0; systemId < _systems.size(); systemId++)
+        {
+            ParticleSystemDescriptor &descriptor = _systems[systemId]._descriptor;
+            if (descriptor._isAlive && descriptor._firstParticle == move._sourceFirst)
+            {
+                descriptor._firstParticle = move._destinationFirst;
+                break;
+            }
+        }
+    }
+
+    // everything past the packed systems still has the old copies of the moved particles
+    const std::vector<ParticleArenaBlock> &freeBlocks = _arena.GetFreeBlocks();
+    for (size_t blockIndex = 0; blockIndex < freeBlocks.size(); blockIndex++)
+    {
+        _particleManager.ClearParticleRange(freeBlocks[blockIndex]._first, 
+            freeBlocks[blockIndex]._count);
+    }
+    this->LayOutSystems();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Updates every system with one dispatch (see ParticleManager::Update(...)).
+Parameters:
+    deltaTimeSec    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleWorld::Update(float deltaTimeSec)
+{
+    this->UpdateSteps(deltaTimeSec, 1);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Updates every system with one emit dispatch and one dispatch per step (see 
+    ParticleManager::UpdateSteps(...)).
+Parameters:
+    stepSec     Self-explanatory.
+    numSteps    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleWorld::UpdateSteps(float stepSec, unsigned int numSteps)
+{
+    if (_isInitialized)
+    {
+        this->UpdateOffScreenThrottle();
+        _particleManager.UpdateSteps(stepSec, numSteps);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Draws every visible system with one multi-draw call (see ParticleManager::Render(...)).
+Parameters:
+    extrapolationSec    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleWorld::Render(float extrapolationSec)
+{
+    if (_isInitialized)
+    {
+        _particleManager.Render(extrapolationSec);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Changes one of a system's emitters.  Like ParticleManager::SetEmitter(...), the particle 
+    count and the first particle can't change.
+Parameters:
+    systemId        Self-explanatory.
+    emitterIndex    Within the system, in the order given to AddSystem(...).
+    emitter         Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleWorld::SetSystemEmitter(unsigned int systemId, unsigned int emitterIndex, 
+    const ParticleEmitter &emitter)
+{
+    if (systemId >= _systems.size() || !_systems[systemId]._descriptor._isAlive || 
+        emitterIndex >= _systems[systemId]._descriptor._emitterCount)
+    {
+        LogPrintf("no emitter %u in particle system %u\n", emitterIndex, systemId);
+        return;
+    }
+
+    // keep the system's copy up to date so that the change survives the next layout
+    ParticleWorldSystem &system = _systems[systemId];
+    ParticleEmitter &kept = system._emitters[emitterIndex];
+    unsigned int particleCount = kept._particleCount;
+    unsigned int firstParticle = kept._firstParticle;
+    kept = emitter;
+    kept._particleCount = particleCount;
+    kept._firstParticle = firstParticle;
+    if (_isInitialized)
+    {
+        _particleManager.SetEmitter(system._descriptor._firstEmitter + emitterIndex, kept);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    See ParticleManager::SetDrawGroupStyle(...).  Kept across layouts.
+Parameters:
+    systemId            Self-explanatory.
+    pointSizeScale      Self-explanatory.
+    brightnessScale     Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleWorld::SetSystemStyle(unsigned int systemId, float pointSizeScale, 
+    float brightnessScale)
+{
+    if (systemId >= _systems.size() || !_systems[systemId]._descriptor._isAlive)
+    {
+        LogPrintf("no particle system %u to set the style of\n", systemId);
+        return;
+    }
+
+    _systems[systemId]._style = glm::vec2(pointSizeScale, brightnessScale);
+    if (_isInitialized)
+    {
+        this->ApplySystemAppearance(_systems[systemId]);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    See ParticleManager::SetDrawGroupVisible(...).  Kept across layouts.
+Parameters:
+    systemId        Self-explanatory.
+    isVisible       Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleWorld::SetSystemVisible(unsigned int systemId, bool isVisible)
+{
+    if (systemId >= _systems.size() || !_systems[systemId]._descriptor._isAlive)
+    {
+        LogPrintf("no particle system %u to show or hide\n", systemId);
+        return;
+    }
+
+    _systems[systemId]._isVisible = isVisible;
+    if (_isInitialized)
+    {
+        this->ApplySystemAppearance(_systems[systemId]);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Has a system's particles integrated on only 1 in every so many updates, by that many 
+    steps at once, and balances the phases again (see BalanceUpdateSlices()).  Kept across 
+    layouts.  Emission and the draw still happen every frame.
+
+    Note: The world's compute program must be built with 
+    ParticleKernelVariant::_hasEmitterTimeSlicing, or every system is updated every time.
+Parameters:
+    systemId        Self-explanatory.
+    updatePeriod    1 is every update.  Rounded down to a power of 2, up to 
+                    MAX_UPDATE_PERIOD.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleWorld::SetSystemUpdatePeriod(unsigned int systemId, unsigned int updatePeriod)
+{
+    if (systemId >= _systems.size() || !_systems[systemId]._descriptor._isAlive)
+    {
+        LogPrintf("no particle system %u to time-slice\n", systemId);
+        return;
+    }
+
+    unsigned int period = 1;
+    while ((period * 2) <= updatePeriod && (period * 2) <= MAX_UPDATE_PERIOD)
+    {
+        period *= 2;
+    }
+    _systems[systemId]._updatePeriod = period;
+    if (_isInitialized)
+    {
+        this->BalanceUpdateSlices();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Has every system that has been off the screen for at least afterSec integrated on only 1 
+    in every updatePeriod updates (or its own period, if that is longer), until it comes back 
+    on the screen, when it goes back to its own period on the next update.  The phases are 
+    balanced again whenever a system goes either way (see BalanceUpdateSlices()).
+
+    Note: Goes by ParticleManager::GetDrawGroupOffScreenSec(...), so the world's manager must 
+    have draw group culling on (see ParticleManager::SetDrawGroupCulling(...)), and its 
+    program must be built with ParticleKernelVariant::_hasEmitterTimeSlicing for the period 
+    to do anything.  A throttled system is still drawn (and culled) every frame, so it is 
+    seen as soon as it comes back.
+Parameters:
+    afterSec        0 turns the throttle off.
+    updatePeriod    Rounded down to a power of 2, up to MAX_UPDATE_PERIOD.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleWorld::SetOffScreenThrottle(float afterSec, unsigned int updatePeriod)
+{
+    unsigned int period = 1;
+    while ((period * 2) <= updatePeriod && (period * 2) <= MAX_UPDATE_PERIOD)
+    {
+        period *= 2;
+    }
+    _offScreenThrottleSec = (afterSec > 0.0f) ? afterSec : 0.0f;
+    _offScreenUpdatePeriod = period;
+
+    // everything goes back to its own period now, and the throttle picks its systems again 
+    // on the next update
+    bool wasThrottled = false;
+    for (size_t systemId = 0; systemId < _systems.size(); systemId++)
+    {
+        wasThrottled = wasThrottled || _systems[systemId]._isOffScreenThrottled;
+        _systems[systemId]._isOffScreenThrottled = false;
+    }
+    if (_isInitialized && wasThrottled)
+    {
+        this->BalanceUpdateSlices();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    One more than the highest system ID so far.  Some of those may have been removed (see 
+    ParticleSystemDescriptor::_isAlive).
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleWorld::GetSystemCount() const
+{
+    return (unsigned int)_systems.size();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    systemId    Must be less than GetSystemCount().
+Returns:
+    Where the system's emitters and particles are right now.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+const ParticleSystemDescriptor &ParticleWorld::GetSystem(unsigned int systemId) const
+{
+    return _systems[systemId]._descriptor;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    See ParticleManager::GetDrawGroupLiveCount(...).
+Parameters:
+    systemId    Self-explanatory.
+Returns:
+    The number of the system's particles that were alive a couple of updates ago, or 0 if 
+    there is no such system.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleWorld::GetSystemLiveCount(unsigned int systemId) const
+{
+    if (systemId >= _systems.size() || !_systems[systemId]._descriptor._isAlive)
+    {
+        return 0;
+    }
+    return _particleManager.GetDrawGroupLiveCount(_systems[systemId]._descriptor._drawGroup);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    For keeping an eye on fragmentation.
+Parameters: None
+Returns:
+    The allocator of the pool's ranges.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+const ParticleArena &ParticleWorld::GetArena() const
+{
+    return _arena;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    For everything that isn't per-system (point size, readback, the density splat, etc.).
+    
+    Note: Don't call Resize(...) on it.  The pool's size belongs to the arena.
+Parameters: None
+Returns:
+    The particle manager that holds every system.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleManager &ParticleWorld::GetParticleManager()
+{
+    return _particleManager;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The number of emitters of every system that is still alive.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleWorld::GetLiveEmitterCount() const
+{
+    unsigned int emitterCount = 0;
+    for (size_t systemId = 0; systemId < _systems.size(); systemId++)
+    {
+        if (_systems[systemId]._descriptor._isAlive)
+        {
+            emitterCount += _systems[systemId]._descriptor._emitterCount;
+        }
+    }
+    return emitterCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives a new system its range of the pool.  If the free space isn't enough for all of it, 
+    the systems with a lower priority are evicted, the lowest priority and then the oldest 
+    first, until it is.  If evicting all of them wouldn't be enough, the system is shrunk to 
+    what that would free, as long as that is at least its minimum.  The size is settled 
+    before anything is evicted, and nothing more is evicted than that size needs, so nothing 
+    is evicted unless the system will then fit.  Defragments first if the free space is there 
+    in total but in pieces.
+Parameters:
+    system  Its particle count, priority, and minimum must already be filled in.
+Returns:
+    False if there is no room for even the system's minimum, in which case nothing was 
+    evicted.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleWorld::MakeRoomForSystem(ParticleWorldSystem *system)
+{
+    ParticleSystemDescriptor &descriptor = system->_descriptor;
+    unsigned int neededCount = descriptor._particleCount;
+
+    // every emitter needs a particle
+    unsigned int minimumCount = (unsigned int)ceilf(neededCount * system->_minimumFraction);
+    minimumCount = std::min(std::max(minimumCount, descriptor._emitterCount), neededCount);
+
+    unsigned int evictableCount = 0;
+    for (size_t otherId = 0; otherId < _systems.size(); otherId++)
+    {
+        const ParticleSystemDescriptor &other = _systems[otherId]._descriptor;
+        if (other._isAlive && other._priority < descriptor._priority)
+        {
+            evictableCount += other._particleCount;
+        }
+    }
+    if (_arena.GetFreeCount() + evictableCount < minimumCount)
+    {
+        LogPrintf("no room in the particle pool for %u more particles\n", minimumCount);
+        return false;
+    }
+
+    // shrunk to what evicting every lower priority would free, and no further
+    unsigned int roomCount = _arena.GetFreeCount() + evictableCount;
+    if (roomCount < neededCount)
+    {
+        this->ShrinkSystem(system, std::max(roomCount, minimumCount));
+    }
+    unsigned int grantedCount = descriptor._particleCount;
+    if (grantedCount > roomCount)
+    {
+        LogPrintf("no room in the particle pool for %u more particles\n", grantedCount);
+        return false;
+    }
+
+    while (_arena.GetFreeCount() < grantedCount)
+    {
+        unsigned int evictId = INVALID_SYSTEM_ID;
+        for (size_t otherId = 0; otherId < _systems.size(); otherId++)
+        {
+            const ParticleWorldSystem &other = _systems[otherId];
+            if (!other._descriptor._isAlive || other._descriptor._priority >= descriptor._priority)
+            {
+                continue;
+            }
+            if (evictId == INVALID_SYSTEM_ID || 
+                other._descriptor._priority < _systems[evictId]._descriptor._priority || 
+                (other._descriptor._priority == _systems[evictId]._descriptor._priority && 
+                other._addSequence < _systems[evictId]._addSequence))
+            {
+                evictId = (unsigned int)otherId;
+            }
+        }
+        if (evictId == INVALID_SYSTEM_ID)
+        {
+            break;
+        }
+        LogPrintf("particle world: evicted system %u (priority %d) for one of priority %d\n", 
+            evictId, _systems[evictId]._descriptor._priority, descriptor._priority);
+        this->RemoveSystem(evictId);
+    }
+
+    if (grantedCount < neededCount)
+    {
+        LogPrintf("particle world: a system of priority %d got %u of its %u particles\n", 
+            descriptor._priority, grantedCount, neededCount);
+    }
+
+    // the free space may be there in total but in pieces
+    if (_arena.GetLargestFreeBlock() < descriptor._particleCount && 
+        _arena.GetFreeCount() >= descriptor._particleCount)
+    {
+        this->Defragment();
+    }
+    if (!this->AllocateSystemRange(system))
+    {
+        LogPrintf("no room in the particle pool for %u more particles\n", 
+            descriptor._particleCount);
+        return false;
+    }
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Scales down each of the system's emitters, its particle count and its emission rate 
+    alike, so that the particles live as long as they would have, and there are just fewer 
+    of them.  Every emitter keeps at least 1 particle, and what rounding leaves over (or 
+    what the 1s take) is spread over the emitters a particle at a time, so the counts add up 
+    to exactly the new count.
+Parameters:
+    system          Self-explanatory.
+    particleCount   What the system's emitters should add up to.  At least the emitter 
+                    count.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleWorld::ShrinkSystem(ParticleWorldSystem *system, unsigned int particleCount)
+{
+    unsigned int requestedCount = system->_descriptor._particleCount;
+    if (requestedCount == 0 || particleCount >= requestedCount)
+    {
+        return;
+    }
+
+    std::vector<unsigned int> originalCounts(system->_emitters.size());
+    unsigned int totalCount = 0;
+    for (size_t emitterIndex = 0; emitterIndex < system->_emitters.size(); emitterIndex++)
+    {
+        ParticleEmitter &emitter = system->_emitters[emitterIndex];
+        originalCounts[emitterIndex] = emitter._particleCount;
+        unsigned long long scaledCount = 
+            ((unsigned long long)emitter._particleCount * particleCount) / requestedCount;
+        emitter._particleCount = std::max((unsigned int)scaledCount, 1u);
+        if (emitter._maxParticlesEmittedPerFrame > 0)
+        {
+            unsigned long long scaledRate = 
+                ((unsigned long long)emitter._maxParticlesEmittedPerFrame * particleCount) / 
+                requestedCount;
+            emitter._maxParticlesEmittedPerFrame = std::max((unsigned int)scaledRate, 1u);
+        }
+        totalCount += emitter._particleCount;
+    }
+
+    // a pass over the emitters can only change the total by 1 per emitter, and stops when a 
+    // pass can't change it at all
+    bool isChanging = true;
+    while (totalCount != particleCount && isChanging)
+    {
+        isChanging = false;
+        for (size_t emitterIndex = 0; emitterIndex < system->_emitters.size() && 
+            totalCount != particleCount; emitterIndex++)
+        {
+            ParticleEmitter &emitter = system->_emitters[emitterIndex];
+            if (totalCount < particleCount && 
+                emitter._particleCount < originalCounts[emitterIndex])
+            {
+                emitter._particleCount++;
+                totalCount++;
+                isChanging = true;
+            }
+            else if (totalCount > particleCount && emitter._particleCount > 1)
+            {
+                emitter._particleCount--;
+                totalCount--;
+                isChanging = true;
+            }
+        }
+    }
+    system->_descriptor._particleCount = totalCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes a range of the pool for the system and gives each of its emitters its part of it.
+Parameters:
+    system  Its particle count must already be filled in.
+Returns:
+    True if the arena had a free range big enough, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ParticleWorld::AllocateSystemRange(ParticleWorldSystem *system)
+{
+    unsigned int firstParticle = 0;
+    if (!_arena.Allocate(system->_descriptor._particleCount, &firstParticle))
+    {
+        return false;
+    }
+    system->_descriptor._firstParticle = firstParticle;
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Builds the manager's emitter table and draw groups from the live systems, in the order of 
+    their ranges (which the shader's searches need), and hands them over in one go (see 
+    ParticleManager::SetEmitterTable(...)).  Then puts back each system's style and visibility,
+    since the draw groups may have been renumbered.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleWorld::LayOutSystems()
+{
+    // (first particle, system ID), sorted
+    std::vector<std::pair<unsigned int, unsigned int> > rangeOrder;
+    for (size_t systemId = 0; systemId < _systems.size(); systemId++)
+    {
+        if (_systems[systemId]._descriptor._isAlive)
+        {
+            rangeOrder.push_back(std::make_pair(_systems[systemId]._descriptor._firstParticle, 
+                (unsigned int)systemId));
+        }
+    }
+    std::sort(rangeOrder.begin(), rangeOrder.end());
+
+    std::vector<ParticleEmitter> emitterTable;
+    std::vector<unsigned int> firstEmitterOfEachGroup;
+    for (size_t rangeIndex = 0; rangeIndex < rangeOrder.size(); rangeIndex++)
+    {
+        ParticleWorldSystem &system = _systems[rangeOrder[rangeIndex].second];
+        system._descriptor._firstEmitter = (unsigned int)emitterTable.size();
+        system._descriptor._drawGroup = (unsigned int)rangeIndex;
+        firstEmitterOfEachGroup.push_back(system._descriptor._firstEmitter);
+
+        unsigned int nextParticle = system._descriptor._firstParticle;
+        for (size_t emitterIndex = 0; emitterIndex < system._emitters.size(); emitterIndex++)
+        {
+            system._emitters[emitterIndex]._firstParticle = nextParticle;
+            nextParticle += system._emitters[emitterIndex]._particleCount;
+            emitterTable.push_back(system._emitters[emitterIndex]);
+        }
+    }
+
+    _particleManager.SetEmitterTable(emitterTable, firstEmitterOfEachGroup);
+    for (size_t rangeIndex = 0; rangeIndex < rangeOrder.size(); rangeIndex++)
+    {
+        this->ApplySystemAppearance(_systems[rangeOrder[rangeIndex].second]);
+    }
+
+    // the emitters may have moved in the table
+    this->BalanceUpdateSlices();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Picks each time-sliced system's phase so that every update integrates about the same 
+    number of particles, and hands every emitter its system's period and phase (see 
+    ParticleManager::SetEmitterUpdateSlices(...)).
+
+    The updates repeat every MAX_UPDATE_PERIOD, so each update in the cycle has a load: the 
+    particles of the systems that are due on it.  The systems that update every time load 
+    all of them alike.  Then, biggest first, each sliced system takes the phase whose updates 
+    have the least load at their busiest, which is the greedy way to keep the busiest update 
+    as light as it can be.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleWorld::BalanceUpdateSlices()
+{
+    unsigned long long updateLoads[MAX_UPDATE_PERIOD] = { 0 };
+
+    // (particle count, system ID), sorted, so the biggest is last
+    std::vector<std::pair<unsigned int, unsigned int> > slicedSystems;
+    unsigned int emitterTableSize = 0;
+    for (size_t systemId = 0; systemId < _systems.size(); systemId++)
+    {
+        ParticleWorldSystem &system = _systems[systemId];
+        if (!system._descriptor._isAlive)
+        {
+            continue;
+        }
+        emitterTableSize = std::max(emitterTableSize, 
+            system._descriptor._firstEmitter + system._descriptor._emitterCount);
+        system._updatePhase = 0;
+        if (this->GetEffectiveUpdatePeriod(system) > 1)
+        {
+            slicedSystems.push_back(std::make_pair(system._descriptor._particleCount, 
+                (unsigned int)systemId));
+            continue;
+        }
+        for (unsigned int update = 0; update < MAX_UPDATE_PERIOD; update++)
+        {
+            updateLoads[update] += system._descriptor._particleCount;
+        }
+    }
+    std::sort(slicedSystems.begin(), slicedSystems.end());
+
+    for (size_t sliceIndex = slicedSystems.size(); sliceIndex > 0; sliceIndex--)
+    {
+        ParticleWorldSystem &system = _systems[slicedSystems[sliceIndex - 1].second];
+        unsigned int period = this->GetEffectiveUpdatePeriod(system);
+        unsigned int bestOffset = 0;
+        unsigned long long bestPeakLoad = 0;
+        for (unsigned int offset = 0; offset < period; offset++)
+        {
+            unsigned long long peakLoad = 0;
+            for (unsigned int update = offset; update < MAX_UPDATE_PERIOD; update += period)
+            {
+                peakLoad = std::max(peakLoad, updateLoads[update]);
+            }
+            if (offset == 0 || peakLoad < bestPeakLoad)
+            {
+                bestOffset = offset;
+                bestPeakLoad = peakLoad;
+            }
+        }
+        for (unsigned int update = bestOffset; update < MAX_UPDATE_PERIOD; update += period)
+        {
+            updateLoads[update] += system._descriptor._particleCount;
+        }
+
+        // due where (update + phase) is a multiple of the period, which is update == offset
+        system._updatePhase = (period - bestOffset) % period;
+    }
+
+    // without any sliced systems, the update doesn't read the slices at all
+    std::vector<ParticleEmitterSlice> slices;
+    if (!slicedSystems.empty())
+    {
+        ParticleEmitterSlice everyUpdate = { 1, 0 };
+        slices.assign(emitterTableSize, everyUpdate);
+        for (size_t sliceIndex = 0; sliceIndex < slicedSystems.size(); sliceIndex++)
+        {
+            const ParticleWorldSystem &system = _systems[slicedSystems[sliceIndex].second];
+            unsigned int firstEmitter = system._descriptor._firstEmitter;
+            for (unsigned int emitterIndex = firstEmitter; 
+                emitterIndex < firstEmitter + system._descriptor._emitterCount; emitterIndex++)
+            {
+                slices[emitterIndex]._period = this->GetEffectiveUpdatePeriod(system);
+                slices[emitterIndex]._phase = system._updatePhase;
+            }
+        }
+    }
+    _particleManager.SetEmitterUpdateSlices(slices);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Throttles the systems that have been off the screen for long enough, and lets go of the 
+    ones that came back (see SetOffScreenThrottle(...)).  The phases are only balanced again 
+    if one of them changed, so an update where nothing comes or goes costs a lookup per 
+    system.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleWorld::UpdateOffScreenThrottle()
+{
+    if (_offScreenThrottleSec <= 0.0f)
+    {
+        return;
+    }
+
+    bool isChanged = false;
+    for (size_t systemId = 0; systemId < _systems.size(); systemId++)
+    {
+        ParticleWorldSystem &system = _systems[systemId];
+        if (!system._descriptor._isAlive)
+        {
+            continue;
+        }
+        bool isThrottled = _particleManager.GetDrawGroupOffScreenSec(
+            system._descriptor._drawGroup) >= _offScreenThrottleSec;
+        if (isThrottled != system._isOffScreenThrottled)
+        {
+            system._isOffScreenThrottled = isThrottled;
+            isChanged = true;
+        }
+    }
+    if (isChanged)
+    {
+        this->BalanceUpdateSlices();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    system  Self-explanatory.
+Returns:
+    The system's own update period, or the off-screen period if it is throttled and that is 
+    longer.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int ParticleWorld::GetEffectiveUpdatePeriod(const ParticleWorldSystem &system) const
+{
+    if (system._isOffScreenThrottled && _offScreenUpdatePeriod > system._updatePeriod)
+    {
+        return _offScreenUpdatePeriod;
+    }
+    return system._updatePeriod;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Hands a system's style and visibility to its draw group.
+Parameters:
+    system  Must be alive and laid out.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ParticleWorld::ApplySystemAppearance(const ParticleWorldSystem &system)
+{
+    unsigned int drawGroup = system._descriptor._drawGroup;
+    _particleManager.SetDrawGroupStyle(drawGroup, system._style.x, system._style.y);
+    _particleManager.SetDrawGroupVisible(drawGroup, system._isVisible);
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "ParticleManager.h"
+#include "ParticleArena.h"
+#include "glm/vec2.hpp"
+
+#include <vector>
+
+// where one particle system lives in the world's shared pool and emitter table
+// Note: The ranges are filled in when the system gets its part of the pool, and they change 
+// whenever the world is laid out again (systems added, removed, or defragmented).
+struct ParticleSystemDescriptor
+{
+    unsigned int _firstEmitter;
+    unsigned int _emitterCount;
+    unsigned int _firstParticle;
+    unsigned int _particleCount;
+    unsigned int _drawGroup;
+    bool _isAlive;
+
+    // when the pool is full, a new system takes the room of systems with a lower priority 
+    // (see ParticleWorld::AddSystem(...))
+    int _priority;
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Runs several particle systems as if they were one.  Each system is a set of emitters that 
+    would otherwise have had its own ParticleManager, and with one manager per system, every 
+    system costs its own program binds, uniform updates, dispatches, and memory barriers every 
+    frame, so the GPU is serialized once per system.
+
+    Instead, the world gives every system's emitters to a single ParticleManager.  The 
+    manager's particle buffers are the shared pool that every system's particles live in, its 
+    emitter table plus the descriptors here say which part belongs to which system, and each 
+    system is one of the manager's draw groups (see ParticleManager::SetDrawGroups(...)).  An 
+    update is one emit dispatch and one dispatch per step with one barrier each, and a render 
+    is one glMultiDrawElementsIndirect(...) with a command per system, however many systems 
+    there are.
+
+    The pool is created once, at its full capacity, and a ParticleArena hands out its ranges.  
+    Systems can be added and removed at any time between frames without creating or deleting 
+    any buffers: a removed system's range is zeroed and given back to the arena, a new system
+    takes a free range, and when the free space is in pieces that are each too small, the 
+    systems are slid down to the start of the pool with glCopyBufferSubData(...) (see 
+    Defragment()).
+
+    When the pool is full, systems are admitted by priority: a new system evicts systems of 
+    a lower priority, the lowest and then the oldest first, until it fits, and if it still 
+    doesn't, it is given a smaller share of particles, down to the minimum it was added with, 
+    instead of being refused.  An important effect keeps its particles under pressure 
+    without the pool being sized for every effect at once.
+
+    Systems in the background don't need a full update every frame.  Each system can be given 
+    an update period, and its particles are then only integrated on 1 in every that many 
+    updates, by that many steps at once (see ParticleManager::SetEmitterUpdateSlices(...)).  
+    The systems' phases are picked so that about the same number of particles is integrated 
+    on every update, so the update's cost stays flat instead of spiking on the updates where 
+    many systems would otherwise line up.  It is all the same dispatch either way.
+
+    With the manager's draw group culling on, the systems that are off the screen aren't 
+    drawn (see ParticleManager::SetDrawGroupCulling(...)), and with an off-screen throttle, 
+    the ones that have been off it for long enough are given a longer period until they come 
+    back (see SetOffScreenThrottle(...)), so both the draw and the update go by what can be 
+    seen.
+
+    Note: System IDs stay the same for the life of the system, and the IDs of removed systems 
+    are used again.  An evicted system is removed like any other, so GetSystem(...) says 
+    whether a system is still alive.
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+class ParticleWorld
+{
+public:
+    ParticleWorld();
+    ~ParticleWorld();
+    void Init(unsigned int programId, unsigned int computeProgramId, ParticleLayout layout,
+        unsigned int particleCapacity = 0);
+    void Cleanup();
+    unsigned int AddSystem(const std::vector<ParticleEmitter> &emitters, int priority = 0, 
+        float minimumFraction = 1.0f);
+    bool RemoveSystem(unsigned int systemId);
+    void Defragment();
+    void Update(float deltaTimeSec);
+    void UpdateSteps(float stepSec, unsigned int numSteps);
+    void Render(float extrapolationSec);
+
+    void SetSystemEmitter(unsigned int systemId, unsigned int emitterIndex, 
+        const ParticleEmitter &emitter);
+    void SetSystemStyle(unsigned int systemId, float pointSizeScale, float brightnessScale);
+    void SetSystemVisible(unsigned int systemId, bool isVisible);
+    void SetSystemUpdatePeriod(unsigned int systemId, unsigned int updatePeriod);
+    void SetOffScreenThrottle(float afterSec, unsigned int updatePeriod);
+    unsigned int GetSystemCount() const;
+    const ParticleSystemDescriptor &GetSystem(unsigned int systemId) const;
+    unsigned int GetSystemLiveCount(unsigned int systemId) const;
+    const ParticleArena &GetArena() const;
+    ParticleManager &GetParticleManager();
+
+    // AddSystem(...) returns this if the system couldn't be added
+    static const unsigned int INVALID_SYSTEM_ID = 0xffffffff;
+
+    // the room set aside in the manager's emitter table and draw commands
+    static const unsigned int MAX_SYSTEMS = 64;
+    static const unsigned int MAX_EMITTERS = 256;
+
+    // the longest update period, which is also how many updates the phases are balanced over
+    // Note: A power of 2, like every period, so that each period divides it.
+    static const unsigned int MAX_UPDATE_PERIOD = 8;
+
+private:
+    struct ParticleWorldSystem
+    {
+        ParticleSystemDescriptor _descriptor;
+        std::vector<ParticleEmitter> _emitters;
+        glm::vec2 _style;
+        bool _isVisible;
+
+        // the least of its particle count that it can be shrunk to, and when it was added, 
+        // for the oldest-first eviction
+        float _minimumFraction;
+        unsigned int _addSequence;
+
+        // integrated on 1 in every _updatePeriod updates, the ones where (update + _updatePhase)
+        // is a multiple of the period (see ParticleEmitterSlice)
+        unsigned int _updatePeriod;
+        unsigned int _updatePhase;
+
+        // off the screen for long enough that it is updated with the off-screen period (see 
+        // SetOffScreenThrottle(...))
+        bool _isOffScreenThrottled;
+    };
+
+    unsigned int GetLiveEmitterCount() const;
+    bool MakeRoomForSystem(ParticleWorldSystem *system);
+    void ShrinkSystem(ParticleWorldSystem *system, unsigned int particleCount);
+    bool AllocateSystemRange(ParticleWorldSystem *system);
+    void LayOutSystems();
+    void BalanceUpdateSlices();
+    void UpdateOffScreenThrottle();
+    unsigned int GetEffectiveUpdatePeriod(const ParticleWorldSystem &system) const;
+    void ApplySystemAppearance(const ParticleWorldSystem &system);
+
+    std::vector<ParticleWorldSystem> _systems;
+    ParticleArena _arena;
+    ParticleManager _particleManager;
+    unsigned int _nextAddSequence;
+    bool _isInitialized;
+
+    // 0 seconds turns the throttle off
+    float _offScreenThrottleSec;
+    unsigned int _offScreenUpdatePeriod;
+};
@@ -1,8 +1,17 @@
 #include "RandomToast.h"
-#include <climits>
+#include <cmath>
+
+// SSE2 is always there on x64 and nearly always there on x86
+#if defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define RANDOM_TOAST_USE_SSE2
+#include <emmintrin.h>
+#endif
 
 // initial values for xorshf96()
-static unsigned long x = 123456789, y = 362436069, z = 521288629;
+// Note: 32 bits on every platform.  This was unsigned long, which is 32 bits on Windows and 64 
+// on Linux, so the two got different sequences (and only Linux got the 64-bit ones that the 
+// period below isn't for).
+static unsigned int x = 123456789, y = 362436069, z = 521288629;
 
 /*-----------------------------------------------------------------------------------------------
 Description:
@@ -16,17 +25,17 @@ Description:
     old, I might as well get a newer and faster generator.
     http://stackoverflow.com/questions/22600100/why-are-stdshuffle-methods-being-deprecated-in-c14
 
-    The algorithm operates on all of the 64bits in the long integer.  It is positive if stuck 
-    into an unsigned long but can be negative if stuck into a signed long because the most 
+    The algorithm operates on 32-bit words, which is what its shifts and its period are for.  
+    It is positive as an unsigned int but can be negative as a signed int because the most 
     significant bit (the signed bit) might be 1.
 Parameters: None
 Returns:    
-    A decently chaotic unsigned long (64bit) number.
+    A decently chaotic unsigned 32-bit number.
 Exception:  Safe
 Creator:    Some online dude named Marsaglia (unknown date).
 -----------------------------------------------------------------------------------------------*/
-static unsigned long xorshf96(void) {          //period 2^96-1
-    unsigned long t;
+static unsigned int xorshf96(void) {          //period 2^96-1
+    unsigned int t;
     x ^= x << 16;
     x ^= x >> 5;
     x ^= x << 1;
@@ -39,13 +48,17 @@ static unsigned long xorshf96(void) {          //period 2^96-1
     return z;
 }
 
-// used for fast (faster than dividing, at least) reduction to the range [0,+1]
-static const float INVERSE_UNSIGNED_LONG = 1.0f / ULONG_MAX;
+// used for fast (faster than dividing, at least) reduction of 24 bits to the range [0,+1)
+static const float INVERSE_2_TO_24 = 1.0f / 16777216.0f;
 
 
 /*-----------------------------------------------------------------------------------------------
 Description:
-    Generates a random positve float on the range [0,+1].
+    Generates a random positve float on the range [0,+1).
+
+    Only the top 24 bits are used, like RandomGenerator::NextOnRange0to1().  The whole number 
+    times 1 / ULONG_MAX (as this used to be) rounds to exactly 1.0f about once in 2^25 tries, 
+    and the float's 24 bits of mantissa can't hold the rest anyway.
 Parameters: None
 Returns:    
     See description.
@@ -54,13 +67,13 @@ Creator:    John Cox (7-2-2016)
 -----------------------------------------------------------------------------------------------*/
 float RandomOnRange0to1()
 {
-    return ((float)xorshf96() * INVERSE_UNSIGNED_LONG);
+    return ((float)(xorshf96() >> 8) * INVERSE_2_TO_24);
 }
 
 /*-----------------------------------------------------------------------------------------------
 Description:
     A simple encapsulation for Marsaglia xorshf96() that generates a positive random long integer
-    without exposing how.
+    without exposing how.  Only 32 bits, on every platform.
 Parameters: None
 Returns:
     See description.
@@ -75,7 +88,8 @@ unsigned long Random()
 /*-----------------------------------------------------------------------------------------------
 Description:
     A simple encapsulation for Marsaglia xorshf96() that generates a random long integer without
-    exposing how and may be positive or negative.
+    exposing how and may be positive or negative.  Only 32 bits, on every platform, so it is 
+    negative half of the time even where a long is 64 bits.
 Parameters: None
 Returns:
     See description.
@@ -84,7 +98,7 @@ Creator:    John Cox (7-2-2016)
 -----------------------------------------------------------------------------------------------*/
 long RandomPosAndNeg()
 {
-    return (long)(xorshf96());
+    return (long)(int)(xorshf96());
 }
 
 /*-----------------------------------------------------------------------------------------------
@@ -106,3 +120,132 @@ glm::vec3 RandomColor()
     ret.z = RandomOnRange0to1();
     return ret;
 }
+
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    seed    See Seed(...).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-12-2016)
+-----------------------------------------------------------------------------------------------*/
+RandomGenerator::RandomGenerator(unsigned int seed)
+{
+    this->Seed(seed);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Restarts all 4 streams from the given seed.  
+
+    The seed is spread out over the 16 words of state with the "splitmix" mixing function so 
+    that similar seeds (ex: thread index 0, 1, 2...) still give unrelated streams and so that no
+    stream ends up with the all-zero state (xorshift's one bad state, which it never leaves).
+Parameters:
+    seed    Any value, including 0.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-12-2016)
+-----------------------------------------------------------------------------------------------*/
+void RandomGenerator::Seed(unsigned int seed)
+{
+    unsigned int mixState = seed;
+    unsigned int *allStateWords[] = { _x, _y, _z, _w };
+    for (int wordIndex = 0; wordIndex < 4; wordIndex++)
+    {
+        for (int laneIndex = 0; laneIndex < NUM_LANES; laneIndex++)
+        {
+            mixState += 0x9e3779b9;
+            unsigned int mixed = mixState;
+            mixed = (mixed ^ (mixed >> 16)) * 0x85ebca6b;
+            mixed = (mixed ^ (mixed >> 13)) * 0xc2b2ae35;
+            mixed = mixed ^ (mixed >> 16);
+
+            // still zero is still bad
+            allStateWords[wordIndex][laneIndex] = (mixed == 0) ? 0x6c078965 : mixed;
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Fills an array with random floats on the range [0,+1).  With SSE2, 4 numbers are generated 
+    at once, one from each stream.  Any leftovers (or everything, without SSE2) come from 
+    NextOnRange0to1().
+Parameters:
+    fillThis    Self-explanatory.
+    count       The number of floats to write.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-12-2016)
+-----------------------------------------------------------------------------------------------*/
+void RandomGenerator::FillUniform(float *fillThis, size_t count)
+{
+    size_t fillIndex = 0;
+
+#ifdef RANDOM_TOAST_USE_SSE2
+    __m128i x = _mm_load_si128((const __m128i *)_x);
+    __m128i y = _mm_load_si128((const __m128i *)_y);
+    __m128i z = _mm_load_si128((const __m128i *)_z);
+    __m128i w = _mm_load_si128((const __m128i *)_w);
+    const __m128 scale = _mm_set1_ps(1.0f / 16777216.0f);
+    for (; fillIndex + NUM_LANES <= count; fillIndex += NUM_LANES)
+    {
+        // same steps as NextUint(), just 4 wide
+        __m128i t = _mm_xor_si128(x, _mm_slli_epi32(x, 11));
+        x = y;
+        y = z;
+        z = w;
+        w = _mm_xor_si128(_mm_xor_si128(w, _mm_srli_epi32(w, 19)), 
+            _mm_xor_si128(t, _mm_srli_epi32(t, 8)));
+
+        // the top 24 bits fit in a signed int, so the signed conversion is fine
+        __m128 floats = _mm_cvtepi32_ps(_mm_srli_epi32(w, 8));
+        _mm_storeu_ps(fillThis + fillIndex, _mm_mul_ps(floats, scale));
+    }
+    _mm_store_si128((__m128i *)_x, x);
+    _mm_store_si128((__m128i *)_y, y);
+    _mm_store_si128((__m128i *)_z, z);
+    _mm_store_si128((__m128i *)_w, w);
+#endif
+
+    for (; fillIndex < count; fillIndex++)
+    {
+        fillThis[fillIndex] = this->NextOnRange0to1();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Fills an array with unit vectors in uniformly random directions.  The random angles are 
+    generated in bulk by FillUniform(...) (written into the output array's memory to avoid a 
+    temporary buffer), then turned into vectors.
+
+    Note: Normalizing a random (x,y) pair, as ParticleManager::ResetParticle(...) does, favors 
+    the diagonals and can divide by zero.  Going through an angle doesn't.
+Parameters:
+    fillThis    Self-explanatory.
+    count       The number of vectors to write.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-12-2016)
+-----------------------------------------------------------------------------------------------*/
+void RandomGenerator::FillUnitVectors(glm::vec2 *fillThis, size_t count)
+{
+    static const float TWO_PI = 6.28318530718f;
+
+    // glm::vec2 is two tightly packed floats, so the second half of the output can hold the 
+    // angles until they are needed 
+    // Note: This only works going front to back.  Vector i overwrites floats 2i and 2i+1, and 
+    // the angle for vector j is at float (count + j), so by the time an angle's float is 
+    // overwritten, that angle has already been read.
+    float *angles = (float *)fillThis + count;
+    this->FillUniform(angles, count);
+    for (size_t vectorIndex = 0; vectorIndex < count; vectorIndex++)
+    {
+        float angle = angles[vectorIndex] * TWO_PI;
+        fillThis[vectorIndex] = glm::vec2(cosf(angle), sinf(angle));
+    }
+}
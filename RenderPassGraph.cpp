@@ -0,0 +1,572 @@
+#include "RenderPassGraph.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "OpenGlErrorHandling.h"
+#include "Log.h"
+
+#include <algorithm>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    access  Self-explanatory.
+Returns:
+    True if the access is a write that doesn't go through GL's usual ordering, so whatever
+    touches the resource next needs a barrier.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static bool IsIncoherentWrite(RenderGraphAccess access)
+{
+    return access == RENDER_GRAPH_ACCESS_SHADER_STORAGE_WRITE ||
+        access == RENDER_GRAPH_ACCESS_IMAGE_WRITE ||
+        access == RENDER_GRAPH_ACCESS_ATOMIC_COUNTER;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    access  Self-explanatory.
+Returns:
+    True if the access changes the resource, whether or not it is incoherent.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static bool IsWrite(RenderGraphAccess access)
+{
+    return IsIncoherentWrite(access) ||
+        access == RENDER_GRAPH_ACCESS_BUFFER_UPDATE ||
+        access == RENDER_GRAPH_ACCESS_TEXTURE_UPDATE ||
+        access == RENDER_GRAPH_ACCESS_FRAMEBUFFER;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The glMemoryBarrier(...) bit that makes a shader's writes visible to the given kind of
+    access.  The bit is named for the consumer, not the producer.
+Parameters:
+    access  Self-explanatory.
+Returns:
+    A single bit of a glMemoryBarrier(...) bitfield.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static unsigned int GetAccessBarrierBit(RenderGraphAccess access)
+{
+    switch (access)
+    {
+    case RENDER_GRAPH_ACCESS_SHADER_STORAGE_READ:
+    case RENDER_GRAPH_ACCESS_SHADER_STORAGE_WRITE:
+        return GL_SHADER_STORAGE_BARRIER_BIT;
+    case RENDER_GRAPH_ACCESS_IMAGE_READ:
+    case RENDER_GRAPH_ACCESS_IMAGE_WRITE:
+        return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+    case RENDER_GRAPH_ACCESS_ATOMIC_COUNTER:
+        return GL_ATOMIC_COUNTER_BARRIER_BIT;
+    case RENDER_GRAPH_ACCESS_VERTEX_ATTRIB:
+        return GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT;
+    case RENDER_GRAPH_ACCESS_ELEMENT_ARRAY:
+        return GL_ELEMENT_ARRAY_BARRIER_BIT;
+    case RENDER_GRAPH_ACCESS_INDIRECT_COMMAND:
+        return GL_COMMAND_BARRIER_BIT;
+    case RENDER_GRAPH_ACCESS_UNIFORM:
+        return GL_UNIFORM_BARRIER_BIT;
+    case RENDER_GRAPH_ACCESS_TEXTURE_FETCH:
+        return GL_TEXTURE_FETCH_BARRIER_BIT;
+    case RENDER_GRAPH_ACCESS_BUFFER_COPY_READ:
+    case RENDER_GRAPH_ACCESS_BUFFER_UPDATE:
+        return GL_BUFFER_UPDATE_BARRIER_BIT;
+    case RENDER_GRAPH_ACCESS_TEXTURE_UPDATE:
+        return GL_TEXTURE_UPDATE_BARRIER_BIT;
+    case RENDER_GRAPH_ACCESS_FRAMEBUFFER:
+        return GL_FRAMEBUFFER_BARRIER_BIT;
+    case RENDER_GRAPH_ACCESS_CLIENT_MAPPED:
+        return GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT;
+    default:
+        return GL_ALL_BARRIER_BITS;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Ensures that the graph starts empty.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+RenderPassGraph::RenderPassGraph() :
+    _isCompiled(false),
+    _transientHeapSizeBytes(0)
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Forgets every pass and resource, so that the graph can be built again (ex: when a pass
+    is turned on or off).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void RenderPassGraph::Clear()
+{
+    _resourceNames.clear();
+    _isOutput.clear();
+    _passes.clear();
+    _isCompiled = false;
+    _transientSizeBytes.clear();
+    _transientOffsets.clear();
+    _transientHeapSizeBytes = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Adds something that passes read and write (ex: a buffer or a texture).  The graph only
+    needs to tell resources apart, so it doesn't hold the GL object.
+Parameters:
+    name    For the log.
+Returns:
+    The resource's index, for AddAccess(...) and MarkOutput(...).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int RenderPassGraph::AddResource(const std::string &name)
+{
+    _resourceNames.push_back(name);
+    _isOutput.push_back(false);
+    _transientSizeBytes.push_back(0);
+    _transientOffsets.push_back(0);
+    _isCompiled = false;
+    return (unsigned int)(_resourceNames.size() - 1);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Adds a buffer that only the graph's passes use, so that its memory can be shared with
+    other transient buffers that aren't live at the same time (see Compile()).
+Parameters:
+    name        For the log.
+    sizeBytes   Self-explanatory.  Must be more than 0.
+Returns:
+    The resource's index, for AddAccess(...) and GetTransientBufferOffset(...).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int RenderPassGraph::AddTransientBuffer(const std::string &name, size_t sizeBytes)
+{
+    unsigned int resourceIndex = this->AddResource(name);
+    _transientSizeBytes[resourceIndex] = sizeBytes;
+    return resourceIndex;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Adds a pass after the ones that are already there.
+Parameters:
+    name        Also the debug group that Execute() runs it in.
+    execute     Issues the pass's GL commands.  May be empty for a graph that is only used to
+                work out barriers (see GetBarrierBits(...)).
+Returns:
+    The pass's index, for AddAccess(...).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int RenderPassGraph::AddPass(const std::string &name,
+    const std::function<void()> &execute)
+{
+    Pass pass;
+    pass._name = name;
+    pass._execute = execute;
+    pass._isCulled = false;
+    pass._barrierBits = 0;
+    _passes.push_back(pass);
+    _isCompiled = false;
+    return (unsigned int)(_passes.size() - 1);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Declares that a pass touches a resource in a certain way.  A pass that touches the same
+    resource in two ways (ex: a compute shader that writes the draw commands that are then
+    dispatched indirectly) declares both.
+Parameters:
+    passIndex       From AddPass(...).
+    resourceIndex   From AddResource(...).
+    access          Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void RenderPassGraph::AddAccess(unsigned int passIndex, unsigned int resourceIndex,
+    RenderGraphAccess access)
+{
+    if (passIndex >= _passes.size() || resourceIndex >= _resourceNames.size())
+    {
+        LogErrorPrintf("render graph: no pass %u or resource %u\n", passIndex, resourceIndex);
+        return;
+    }
+    ResourceAccess resourceAccess = { resourceIndex, access };
+    _passes[passIndex]._accesses.push_back(resourceAccess);
+    _isCompiled = false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Marks a resource as wanted after the graph is done (ex: the back buffer, or particles that
+    the next frame picks up), so the passes that write it aren't culled.
+Parameters:
+    resourceIndex   From AddResource(...).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void RenderPassGraph::MarkOutput(unsigned int resourceIndex)
+{
+    if (resourceIndex < _isOutput.size())
+    {
+        _isOutput[resourceIndex] = true;
+        _isCompiled = false;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Culls the passes that don't matter and works out each live pass's barrier bits.
+
+    The culling goes backwards from the outputs: a pass is live if it writes something that
+    is still needed (or writes nothing at all), and then everything that it touches is needed
+    from the passes before it.
+
+    The barriers go forwards over the live passes.  Each resource remembers whether its last
+    write was a shader's and which bits have gone in since, and a pass gets the bit for each
+    of its accesses to a resource that still needs one.  Since glMemoryBarrier(...) covers
+    every write before it, the bits that a pass gets then count for every resource.
+
+    Last, the transient buffers are placed in the heap (see PlaceTransientBuffers()).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void RenderPassGraph::Compile()
+{
+    std::vector<bool> isNeeded = _isOutput;
+    for (size_t passIndex = _passes.size(); passIndex > 0; passIndex--)
+    {
+        Pass &pass = _passes[passIndex - 1];
+        bool hasWrite = false;
+        bool isLive = false;
+        for (size_t accessIndex = 0; accessIndex < pass._accesses.size(); accessIndex++)
+        {
+            const ResourceAccess &access = pass._accesses[accessIndex];
+            if (IsWrite(access._access))
+            {
+                hasWrite = true;
+                isLive = isLive || isNeeded[access._resourceIndex];
+            }
+        }
+        pass._isCulled = hasWrite && !isLive;
+        if (pass._isCulled)
+        {
+            continue;
+        }
+        for (size_t accessIndex = 0; accessIndex < pass._accesses.size(); accessIndex++)
+        {
+            isNeeded[pass._accesses[accessIndex]._resourceIndex] = true;
+        }
+    }
+
+    std::vector<bool> hasShaderWrite(_resourceNames.size(), false);
+    std::vector<unsigned int> bitsSinceWrite(_resourceNames.size(), 0);
+    for (size_t passIndex = 0; passIndex < _passes.size(); passIndex++)
+    {
+        Pass &pass = _passes[passIndex];
+        pass._barrierBits = 0;
+        if (pass._isCulled)
+        {
+            continue;
+        }
+
+        for (size_t accessIndex = 0; accessIndex < pass._accesses.size(); accessIndex++)
+        {
+            const ResourceAccess &access = pass._accesses[accessIndex];
+            unsigned int bit = GetAccessBarrierBit(access._access);
+            if (hasShaderWrite[access._resourceIndex] &&
+                (bitsSinceWrite[access._resourceIndex] & bit) == 0)
+            {
+                pass._barrierBits |= bit;
+            }
+        }
+        for (size_t resourceIndex = 0; resourceIndex < bitsSinceWrite.size(); resourceIndex++)
+        {
+            bitsSinceWrite[resourceIndex] |= pass._barrierBits;
+        }
+
+        // a later GL write doesn't clear a shader write, since it may only cover part of it
+        for (size_t accessIndex = 0; accessIndex < pass._accesses.size(); accessIndex++)
+        {
+            const ResourceAccess &access = pass._accesses[accessIndex];
+            if (IsIncoherentWrite(access._access))
+            {
+                hasShaderWrite[access._resourceIndex] = true;
+                bitsSinceWrite[access._resourceIndex] = 0;
+            }
+        }
+    }
+
+    this->PlaceTransientBuffers();
+    _isCompiled = true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives every transient buffer an offset in the heap.  A buffer is live from the first live
+    pass that touches it to the last one, and two buffers may only overlap in the heap if
+    their lifetimes don't.
+
+    The biggest buffers go first, each at the lowest offset that clears every buffer already
+    placed that is live at the same time.  That isn't always the smallest heap, but it is
+    close for the few buffers that a frame has, and it is the same every time for the same
+    graph.  Buffers that no live pass touches get no space.
+
+    Note: The offsets are aligned for glBindBufferRange(...) on the shader storage target,
+    which is the strictest of the targets that scratch is bound to.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void RenderPassGraph::PlaceTransientBuffers()
+{
+    _transientHeapSizeBytes = 0;
+    std::vector<unsigned int> transientIndices;
+    std::vector<size_t> firstPass(_resourceNames.size(), _passes.size());
+    std::vector<size_t> lastPass(_resourceNames.size(), 0);
+    for (size_t passIndex = 0; passIndex < _passes.size(); passIndex++)
+    {
+        const Pass &pass = _passes[passIndex];
+        for (size_t accessIndex = 0; !pass._isCulled && accessIndex < pass._accesses.size();
+            accessIndex++)
+        {
+            unsigned int resourceIndex = pass._accesses[accessIndex]._resourceIndex;
+            firstPass[resourceIndex] = std::min(firstPass[resourceIndex], passIndex);
+            lastPass[resourceIndex] = passIndex;
+        }
+    }
+    for (unsigned int resourceIndex = 0; resourceIndex < _resourceNames.size(); resourceIndex++)
+    {
+        _transientOffsets[resourceIndex] = 0;
+        if (_transientSizeBytes[resourceIndex] > 0 && firstPass[resourceIndex] < _passes.size())
+        {
+            transientIndices.push_back(resourceIndex);
+        }
+    }
+    if (transientIndices.empty())
+    {
+        return;
+    }
+
+    // biggest first; the index breaks ties so that the order doesn't depend on the sort
+    for (size_t sortedIndex = 1; sortedIndex < transientIndices.size(); sortedIndex++)
+    {
+        for (size_t index = sortedIndex; index > 0; index--)
+        {
+            unsigned int before = transientIndices[index - 1];
+            unsigned int after = transientIndices[index];
+            if (_transientSizeBytes[before] >= _transientSizeBytes[after])
+            {
+                break;
+            }
+            transientIndices[index - 1] = after;
+            transientIndices[index] = before;
+        }
+    }
+
+    GLint offsetAlignment = 0;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+    size_t alignment = (offsetAlignment > 0) ? (size_t)offsetAlignment : 256;
+    for (size_t placeIndex = 0; placeIndex < transientIndices.size(); placeIndex++)
+    {
+        unsigned int resourceIndex = transientIndices[placeIndex];
+        size_t sizeBytes = _transientSizeBytes[resourceIndex];
+
+        // try the start of the heap and then the end of each buffer that is in the way,
+        // lowest first, until one fits; the end of the highest one always does
+        size_t offset = 0;
+        bool isMoved = true;
+        while (isMoved)
+        {
+            isMoved = false;
+            for (size_t placedIndex = 0; placedIndex < placeIndex; placedIndex++)
+            {
+                unsigned int placed = transientIndices[placedIndex];
+                bool isLiveTogether = firstPass[placed] <= lastPass[resourceIndex] &&
+                    firstPass[resourceIndex] <= lastPass[placed];
+                size_t placedEnd = _transientOffsets[placed] + _transientSizeBytes[placed];
+                if (isLiveTogether && _transientOffsets[placed] < offset + sizeBytes &&
+                    offset < placedEnd)
+                {
+                    offset = ((placedEnd + alignment - 1) / alignment) * alignment;
+                    isMoved = true;
+                }
+            }
+        }
+        _transientOffsets[resourceIndex] = offset;
+        _transientHeapSizeBytes = std::max(_transientHeapSizeBytes, offset + sizeBytes);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Runs the live passes in order, each in a debug group of its own, with its barrier in
+    front of it.
+
+    Note: Compile() must be called after the last change to the graph.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void RenderPassGraph::Execute() const
+{
+    if (!_isCompiled)
+    {
+        LogErrorPrintf("render graph: executed without compiling\n");
+        return;
+    }
+
+    for (size_t passIndex = 0; passIndex < _passes.size(); passIndex++)
+    {
+        const Pass &pass = _passes[passIndex];
+        if (pass._isCulled)
+        {
+            continue;
+        }
+        if (pass._barrierBits != 0)
+        {
+            glMemoryBarrier(pass._barrierBits);
+        }
+        if (pass._execute)
+        {
+            GlDebugGroup passGroup(pass._name.c_str());
+            pass._execute();
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The number of passes, culled or not.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int RenderPassGraph::GetPassCount() const
+{
+    return (unsigned int)_passes.size();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    passIndex   From AddPass(...).
+Returns:
+    A reference to the name that the pass was added with.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+const std::string &RenderPassGraph::GetPassName(unsigned int passIndex) const
+{
+    return _passes[passIndex]._name;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    passIndex   From AddPass(...).
+Returns:
+    True if Compile() found that nothing needs what the pass writes, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool RenderPassGraph::IsPassCulled(unsigned int passIndex) const
+{
+    return _passes[passIndex]._isCulled;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    passIndex   From AddPass(...).
+Returns:
+    The bits of the glMemoryBarrier(...) that goes in right before the pass, or 0 if none
+    does (or the pass is culled).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int RenderPassGraph::GetBarrierBits(unsigned int passIndex) const
+{
+    return _passes[passIndex]._barrierBits;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    For code that puts in one barrier at the end of its own pass and leaves what comes after
+    to others (ex: ParticleManager::UpdateSteps(...)): every bit that any later pass needs.
+    Only right if nothing after the given pass reads what another pass after it wrote with a
+    shader, so that every bit is for the given pass's writes (or ones before it).
+Parameters:
+    passIndex   From AddPass(...).
+Returns:
+    The union of the barrier bits of every pass after it.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int RenderPassGraph::GetBarrierBitsAfter(unsigned int passIndex) const
+{
+    unsigned int barrierBits = 0;
+    for (size_t laterIndex = passIndex + 1; laterIndex < _passes.size(); laterIndex++)
+    {
+        barrierBits |= _passes[laterIndex]._barrierBits;
+    }
+    return barrierBits;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How many bytes the heap must be for every transient buffer to fit where Compile() put it.
+    0 if there are none.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+size_t RenderPassGraph::GetTransientHeapSizeBytes() const
+{
+    return _transientHeapSizeBytes;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    resourceIndex   From AddTransientBuffer(...).
+Returns:
+    Where the buffer starts in the heap.  Aligned for glBindBufferRange(...).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+size_t RenderPassGraph::GetTransientBufferOffset(unsigned int resourceIndex) const
+{
+    return _transientOffsets[resourceIndex];
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// how a pass touches a resource, which is all that the graph needs to know to work out the
+// barriers (see RenderPassGraph::AddAccess(...))
+// Note: Only the shader writes (storage, image, and atomic counter) are incoherent, so only
+// they need a glMemoryBarrier(...) before whatever reads or writes the resource next.  The
+// other writes are ordinary GL commands, which GL keeps in order by itself.
+enum RenderGraphAccess
+{
+    RENDER_GRAPH_ACCESS_SHADER_STORAGE_READ = 0,
+    RENDER_GRAPH_ACCESS_SHADER_STORAGE_WRITE,   // also for read-modify-write
+    RENDER_GRAPH_ACCESS_IMAGE_READ,
+    RENDER_GRAPH_ACCESS_IMAGE_WRITE,
+    RENDER_GRAPH_ACCESS_ATOMIC_COUNTER,
+    RENDER_GRAPH_ACCESS_VERTEX_ATTRIB,
+    RENDER_GRAPH_ACCESS_ELEMENT_ARRAY,
+    RENDER_GRAPH_ACCESS_INDIRECT_COMMAND,       // indirect draws and dispatches
+    RENDER_GRAPH_ACCESS_UNIFORM,
+    RENDER_GRAPH_ACCESS_TEXTURE_FETCH,
+    RENDER_GRAPH_ACCESS_BUFFER_COPY_READ,       // the source of glCopyBufferSubData(...) and co.
+    RENDER_GRAPH_ACCESS_BUFFER_UPDATE,          // glBufferSubData(...), a copy's destination
+    RENDER_GRAPH_ACCESS_TEXTURE_UPDATE,         // glTexSubImage*(...), glGetTexImage(...)
+    RENDER_GRAPH_ACCESS_FRAMEBUFFER,            // drawn to or blended with
+    RENDER_GRAPH_ACCESS_CLIENT_MAPPED,          // read by the CPU through a persistent mapping
+    RENDER_GRAPH_ACCESS_COUNT,
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    A small frame graph: each pass says which resources it reads and writes and how, and the
+    graph works out which passes matter and exactly which barrier bits each one needs, so
+    nobody has to place glMemoryBarrier(...) calls by hand and get them either wrong or too
+    big as passes are added.
+
+    A barrier bit goes in before a pass only if one of the resources that it touches was last
+    written by a shader (see RenderGraphAccess), and only the bit for the way that the pass
+    touches it (ex: an indirect draw of a command that a compute shader wrote needs
+    GL_COMMAND_BARRIER_BIT and nothing else).  A barrier covers every write before it, so a
+    bit that is already in since a resource's last write isn't put in again.  Passes whose
+    writes nobody reads, and that don't write an output (see MarkOutput(...)), are culled.
+
+    Note: The passes run in the order that they were added.  Each one only depends on the
+    passes before it, so that is always a valid order, and it is the order that the caller
+    would have submitted them in anyway; GL doesn't gain anything from a different one.
+    Also Note: A pass that writes nothing is never culled, since the graph can't see what it
+    does (ex: a readback through a callback).  A resource that a live pass touches in any way
+    keeps its producers alive, because a write may only be to part of it.
+
+    Transient buffers (see AddTransientBuffer(...)) are scratch that only lives from the first
+    live pass that touches it to the last one.  Compile() packs them into one heap, and two
+    that are never live at the same time may get the same bytes, so the heap is only as big as
+    the most that is live at once instead of the sum of them.  The caller makes the heap (see
+    GetTransientHeapSizeBytes()) and binds each buffer as a range of it.
+    Also Note: Only buffers alias.  GL 4.4 can't put a texture in memory of the caller's
+    choosing, so textures stay ordinary resources.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class RenderPassGraph
+{
+public:
+    RenderPassGraph();
+    void Clear();
+
+    unsigned int AddResource(const std::string &name);
+    unsigned int AddTransientBuffer(const std::string &name, size_t sizeBytes);
+    unsigned int AddPass(const std::string &name,
+        const std::function<void()> &execute = std::function<void()>());
+    void AddAccess(unsigned int passIndex, unsigned int resourceIndex, RenderGraphAccess access);
+    void MarkOutput(unsigned int resourceIndex);
+
+    void Compile();
+    void Execute() const;
+
+    unsigned int GetPassCount() const;
+    const std::string &GetPassName(unsigned int passIndex) const;
+    bool IsPassCulled(unsigned int passIndex) const;
+    unsigned int GetBarrierBits(unsigned int passIndex) const;
+    unsigned int GetBarrierBitsAfter(unsigned int passIndex) const;
+    size_t GetTransientHeapSizeBytes() const;
+    size_t GetTransientBufferOffset(unsigned int resourceIndex) const;
+
+private:
+    struct ResourceAccess
+    {
+        unsigned int _resourceIndex;
+        RenderGraphAccess _access;
+    };
+
+    struct Pass
+    {
+        std::string _name;
+        std::function<void()> _execute;
+        std::vector<ResourceAccess> _accesses;
+        bool _isCulled;
+        unsigned int _barrierBits;
+    };
+
+    std::vector<std::string> _resourceNames;
+    std::vector<bool> _isOutput;
+    std::vector<Pass> _passes;
+    bool _isCompiled;
+
+    // 0 for resources that aren't transient
+    std::vector<size_t> _transientSizeBytes;
+    std::vector<size_t> _transientOffsets;
+    size_t _transientHeapSizeBytes;
+
+    void PlaceTransientBuffers();
+};
@@ -0,0 +1,465 @@
+#include "RngBenchmark.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "glm/vec2.hpp"
+#include "glm/detail/func_geometric.hpp"    // glm::normalize
+
+#include "RandomToast.h"
+#include "ParticleManager.h"
+#include "ShaderProgramRegistry.h"
+#include "GlStateCache.h"
+#include "GpuProfiler.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>     // memset
+#include <chrono>
+#include <vector>
+
+// must match RNG_BENCHMARK_BINS in shaderParticle.comp
+static const unsigned int RNG_BENCHMARK_BINS = 256;
+
+// the binding comes after everyone else's (see EMITTER_SLICE_BUFFER_BINDING in
+// ParticleManager.h) and must match shaderParticle.comp
+static const unsigned int RNG_BENCHMARK_BUFFER_BINDING = 67;
+
+// enough that a CPU generator takes tens of milliseconds and each bucket expects 65536
+static const unsigned int RNG_BENCHMARK_CPU_SAMPLES = 1 << 24;
+static const unsigned int RNG_BENCHMARK_CPU_BLOCK = 4096;
+
+// the same number of numbers on the GPU, with enough work items to fill it
+static const unsigned int RNG_BENCHMARK_GPU_INVOCATIONS = 1 << 18;
+static const unsigned int RNG_BENCHMARK_GPU_SAMPLES_PER_INVOCATION = 64;
+static const unsigned int RNG_BENCHMARK_GPU_WARMUP_RUNS = 3;
+static const unsigned int RNG_BENCHMARK_GPU_MEASURED_RUNS = 20;
+
+// the chi-square that 255 degrees of freedom only go over 0.1% of the time
+static const double RNG_BENCHMARK_CHI_SQUARE_LIMIT = 330.52;
+
+// must match the start of RngBenchmarkBuffer in shaderParticle.comp
+struct RngBenchmarkCounts
+{
+    unsigned int _uniformBins[RNG_BENCHMARK_BINS];
+    unsigned int _directionBins[RNG_BENCHMARK_BINS];
+    unsigned int _outOfRangeCount;
+    unsigned int _padding[3];
+};
+
+// what one generator did
+struct RngBenchmarkResult
+{
+    double _samplesPerSec;
+    unsigned long long _sampleCount;
+    unsigned long long _outOfRangeCount;
+    std::vector<unsigned long long> _uniformBins;
+    std::vector<unsigned long long> _directionBins;
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Counts a number into its bucket of [0,1), or as out of range.
+Parameters:
+    value           Self-explanatory.
+    result          Its buckets and out of range count are added to.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static void BinUniform(float value, RngBenchmarkResult *result)
+{
+    if (value < 0.0f || value >= 1.0f)
+    {
+        result->_outOfRangeCount++;
+    }
+    unsigned int bin = (value <= 0.0f) ? 0 : (unsigned int)(value * RNG_BENCHMARK_BINS);
+    if (bin >= RNG_BENCHMARK_BINS)
+    {
+        bin = RNG_BENCHMARK_BINS - 1;
+    }
+    result->_uniformBins[bin]++;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Counts a direction into its bucket of the circle, by its angle.
+Parameters:
+    direction       Needn't be normalized, but mustn't be 0.
+    result          Its direction buckets are added to.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static void BinDirection(const glm::vec2 &direction, RngBenchmarkResult *result)
+{
+    static const double TWO_PI = 6.28318530717958647692;
+    double turn = (atan2((double)direction.y, (double)direction.x) / TWO_PI) + 0.5;
+    unsigned int bin = (unsigned int)(turn * RNG_BENCHMARK_BINS);
+    if (bin >= RNG_BENCHMARK_BINS)
+    {
+        bin = RNG_BENCHMARK_BINS - 1;
+    }
+    result->_directionBins[bin]++;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Pearson's chi-square of buckets that should all be equally full.
+Parameters:
+    bins    Self-explanatory.
+Returns:
+    The sum over the buckets of (observed - expected)^2 / expected.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static double GetChiSquare(const std::vector<unsigned long long> &bins)
+{
+    unsigned long long total = 0;
+    for (size_t binIndex = 0; binIndex < bins.size(); binIndex++)
+    {
+        total += bins[binIndex];
+    }
+    if (total == 0)
+    {
+        return 0.0;
+    }
+
+    double expected = (double)total / bins.size();
+    double chiSquare = 0.0;
+    for (size_t binIndex = 0; binIndex < bins.size(); binIndex++)
+    {
+        double difference = (double)bins[binIndex] - expected;
+        chiSquare += (difference * difference) / expected;
+    }
+    return chiSquare;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    A result with empty buckets.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static RngBenchmarkResult MakeRngBenchmarkResult()
+{
+    RngBenchmarkResult result;
+    result._samplesPerSec = 0.0;
+    result._sampleCount = 0;
+    result._outOfRangeCount = 0;
+    result._uniformBins.assign(RNG_BENCHMARK_BINS, 0);
+    result._directionBins.assign(RNG_BENCHMARK_BINS, 0);
+    return result;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Times a CPU generator that fills a block of floats at a time, over
+    RNG_BENCHMARK_CPU_SAMPLES numbers.  One number of each block is read so that the blocks
+    can't be optimized out.
+Parameters:
+    fillBlock       Writes RNG_BENCHMARK_CPU_BLOCK numbers to the array that it is given.
+    result          Its rate and sample count are set.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+template <typename FillBlock>
+static void TimeCpuRng(FillBlock fillBlock, RngBenchmarkResult *result)
+{
+    std::vector<float> block(RNG_BENCHMARK_CPU_BLOCK);
+    volatile float sink = 0.0f;
+    std::chrono::high_resolution_clock::time_point start =
+        std::chrono::high_resolution_clock::now();
+    for (unsigned int blockStart = 0; blockStart < RNG_BENCHMARK_CPU_SAMPLES;
+        blockStart += RNG_BENCHMARK_CPU_BLOCK)
+    {
+        fillBlock(block.data());
+        sink = sink + block[(blockStart / RNG_BENCHMARK_CPU_BLOCK) % RNG_BENCHMARK_CPU_BLOCK];
+    }
+    double elapsedSec = std::chrono::duration<double>(
+        std::chrono::high_resolution_clock::now() - start).count();
+    result->_sampleCount = RNG_BENCHMARK_CPU_SAMPLES;
+    result->_samplesPerSec = (elapsedSec > 0.0) ? RNG_BENCHMARK_CPU_SAMPLES / elapsedSec : 0.0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The global generator that the CPU backend emits with (see RandomToast.h).  Its directions
+    are made the way that ParticleManager::ResetParticle(...) makes them.
+Parameters: None
+Returns:
+    See RngBenchmarkResult.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static RngBenchmarkResult RunScalarGlobalRng()
+{
+    RngBenchmarkResult result = MakeRngBenchmarkResult();
+    TimeCpuRng([](float *fillThis)
+    {
+        for (unsigned int index = 0; index < RNG_BENCHMARK_CPU_BLOCK; index++)
+        {
+            fillThis[index] = RandomOnRange0to1();
+        }
+    }, &result);
+
+    for (unsigned int sampleIndex = 0; sampleIndex < RNG_BENCHMARK_CPU_SAMPLES; sampleIndex++)
+    {
+        BinUniform(RandomOnRange0to1(), &result);
+
+        // same as ResetParticle(...), except that the point in the middle, which it would
+        // divide by 0 on, is tried again
+        glm::vec2 point(0.0f, 0.0f);
+        while (point.x == 0.0f && point.y == 0.0f)
+        {
+            point = glm::vec2((float)(RandomPosAndNeg() % 100), (float)(RandomPosAndNeg() % 100));
+        }
+        BinDirection(glm::normalize(point), &result);
+    }
+    return result;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    A RandomGenerator, one number at a time.
+Parameters: None
+Returns:
+    See RngBenchmarkResult.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static RngBenchmarkResult RunScalarGeneratorRng()
+{
+    static const float TWO_PI = 6.28318530718f;
+    RngBenchmarkResult result = MakeRngBenchmarkResult();
+    RandomGenerator generator(1);
+    TimeCpuRng([&generator](float *fillThis)
+    {
+        for (unsigned int index = 0; index < RNG_BENCHMARK_CPU_BLOCK; index++)
+        {
+            fillThis[index] = generator.NextOnRange0to1();
+        }
+    }, &result);
+
+    generator.Seed(2);
+    for (unsigned int sampleIndex = 0; sampleIndex < RNG_BENCHMARK_CPU_SAMPLES; sampleIndex++)
+    {
+        BinUniform(generator.NextOnRange0to1(), &result);
+        float angle = generator.NextOnRange0to1() * TWO_PI;
+        BinDirection(glm::vec2(cosf(angle), sinf(angle)), &result);
+    }
+    return result;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    A RandomGenerator, in bulk (SSE2 where it is there).
+Parameters: None
+Returns:
+    See RngBenchmarkResult.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static RngBenchmarkResult RunSimdGeneratorRng()
+{
+    RngBenchmarkResult result = MakeRngBenchmarkResult();
+    RandomGenerator generator(1);
+    TimeCpuRng([&generator](float *fillThis)
+    {
+        generator.FillUniform(fillThis, RNG_BENCHMARK_CPU_BLOCK);
+    }, &result);
+
+    generator.Seed(2);
+    std::vector<float> numbers(RNG_BENCHMARK_CPU_BLOCK);
+    std::vector<glm::vec2> directions(RNG_BENCHMARK_CPU_BLOCK);
+    for (unsigned int blockStart = 0; blockStart < RNG_BENCHMARK_CPU_SAMPLES;
+        blockStart += RNG_BENCHMARK_CPU_BLOCK)
+    {
+        generator.FillUniform(numbers.data(), RNG_BENCHMARK_CPU_BLOCK);
+        generator.FillUnitVectors(directions.data(), RNG_BENCHMARK_CPU_BLOCK);
+        for (unsigned int index = 0; index < RNG_BENCHMARK_CPU_BLOCK; index++)
+        {
+            BinUniform(numbers[index], &result);
+            BinDirection(directions[index], &result);
+        }
+    }
+    return result;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The compute shader's generator, as the emission uses it.  Timed with GPU timer queries
+    over several runs without binning, then run once more with binning and read back.
+Parameters:
+    putResultHere   Self-explanatory.
+Returns:
+    False if the program or its buffer couldn't be made, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static bool RunGpuRng(RngBenchmarkResult *putResultHere)
+{
+    *putResultHere = MakeRngBenchmarkResult();
+
+    GLint maxBindings = 0;
+    glGetIntegerv(GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS, &maxBindings);
+    if (maxBindings <= (GLint)RNG_BENCHMARK_BUFFER_BINDING)
+    {
+        printf("# the GPU generator needs %u shader storage bindings, but there are only %d\n",
+            RNG_BENCHMARK_BUFFER_BINDING + 1, maxBindings);
+        return false;
+    }
+
+    unsigned int workGroupSize = ParticleManager::DEFAULT_WORK_GROUP_SIZE;
+    unsigned int programId = AcquireComputeProgram(ParticleManager::GetComputeShaderDefines(
+        PARTICLE_LAYOUT_INTERLEAVED, workGroupSize) + "#define PARTICLE_RNG_BENCHMARK_PASS\n");
+    if (programId == 0)
+    {
+        return false;
+    }
+    GLint unifLocSamplesPerInvocation =
+        glGetUniformLocation(programId, "uRngSamplesPerInvocation");
+    GLint unifLocSeed = glGetUniformLocation(programId, "uRngSeed");
+    GLint unifLocIsBinning = glGetUniformLocation(programId, "uRngIsBinning");
+
+    size_t bufferSizeBytes = sizeof(RngBenchmarkCounts) +
+        (RNG_BENCHMARK_GPU_INVOCATIONS * sizeof(float));
+    RngBenchmarkCounts zeroCounts;
+    memset(&zeroCounts, 0, sizeof(zeroCounts));
+    GlBuffer bufferId = GenerateGlBuffer();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, bufferId);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, bufferSizeBytes, 0, GL_DYNAMIC_READ);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zeroCounts), &zeroCounts);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    UseGlProgram(programId);
+    BindGlShaderStorageBuffer(RNG_BENCHMARK_BUFFER_BINDING, bufferId);
+    glUniform1ui(unifLocSamplesPerInvocation, RNG_BENCHMARK_GPU_SAMPLES_PER_INVOCATION);
+    glUniform1ui(unifLocIsBinning, 0);
+    GLuint numWorkGroups = RNG_BENCHMARK_GPU_INVOCATIONS / workGroupSize;
+
+    GpuProfiler profiler;
+    profiler.Init(0);
+    unsigned int rngScopeId = profiler.AddScope("rng");
+    for (unsigned int runCount = 0; runCount < RNG_BENCHMARK_GPU_WARMUP_RUNS; runCount++)
+    {
+        glUniform1ui(unifLocSeed, runCount);
+        glDispatchCompute(numWorkGroups, 1, 1);
+    }
+    glFinish();
+    for (unsigned int runCount = 0; runCount < RNG_BENCHMARK_GPU_MEASURED_RUNS; runCount++)
+    {
+        glUniform1ui(unifLocSeed, RNG_BENCHMARK_GPU_WARMUP_RUNS + runCount);
+        profiler.BeginScope(rngScopeId);
+        glDispatchCompute(numWorkGroups, 1, 1);
+        profiler.EndScope(rngScopeId);
+        profiler.EndFrame();
+    }
+    glFinish();
+    profiler.EndFrame();
+    profiler.EndFrame();
+    GpuProfilerStats stats = {};
+    profiler.GetStats(rngScopeId, &stats);
+    profiler.Cleanup();
+
+    unsigned long long sampleCount = (unsigned long long)RNG_BENCHMARK_GPU_INVOCATIONS *
+        RNG_BENCHMARK_GPU_SAMPLES_PER_INVOCATION;
+    putResultHere->_sampleCount = sampleCount;
+    putResultHere->_samplesPerSec = (stats._avgMs > 0.0f) ?
+        sampleCount / (stats._avgMs / 1000.0) : 0.0;
+
+    // a seed that wasn't timed, like the CPU generators' statistics
+    glUniform1ui(unifLocSeed, 0xb5297a4d);
+    glUniform1ui(unifLocIsBinning, 1);
+    glDispatchCompute(numWorkGroups, 1, 1);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    RngBenchmarkCounts counts;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, bufferId);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(counts), &counts);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    for (unsigned int binIndex = 0; binIndex < RNG_BENCHMARK_BINS; binIndex++)
+    {
+        putResultHere->_uniformBins[binIndex] = counts._uniformBins[binIndex];
+        putResultHere->_directionBins[binIndex] = counts._directionBins[binIndex];
+    }
+    putResultHere->_outOfRangeCount = counts._outOfRangeCount;
+
+    BindGlShaderStorageBuffer(RNG_BENCHMARK_BUFFER_BINDING, 0);
+    UseGlProgram(0);
+    ReleaseProgram(programId);
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Prints one row of the table.
+Parameters:
+    generatorName   Self-explanatory.
+    result          Self-explanatory.
+    isBaseline      True for a generator that is only there to compare against and is known 
+                    to fail, whose failure is printed as "known_bad" instead of "FAIL".
+Returns:
+    True if the generator passed (see RngBenchmark.h).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static bool PrintRngBenchmarkRow(const char *generatorName, const RngBenchmarkResult &result,
+    bool isBaseline)
+{
+    double uniformChiSquare = GetChiSquare(result._uniformBins);
+    double directionChiSquare = GetChiSquare(result._directionBins);
+    bool isPassed = result._outOfRangeCount == 0 &&
+        uniformChiSquare < RNG_BENCHMARK_CHI_SQUARE_LIMIT &&
+        directionChiSquare < RNG_BENCHMARK_CHI_SQUARE_LIMIT;
+    printf("%s,%llu,%.1f,%.1f,%llu,%.1f,%s\n",
+        generatorName,
+        result._sampleCount,
+        result._samplesPerSec / 1e6,
+        uniformChiSquare,
+        result._outOfRangeCount,
+        directionChiSquare,
+        isPassed ? "pass" : (isBaseline ? "known_bad" : "FAIL"));
+    fflush(stdout);
+    return isPassed;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Runs every generator and prints the results as CSV.  See RngBenchmark.h.
+Parameters: None
+Returns:
+    0 if every generator but the baseline passed, otherwise 1.  Suitable for returning from 
+    main(...).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+int RunRngBenchmark()
+{
+    printf("# renderer: %s\n", (const char *)glGetString(GL_RENDERER));
+    printf("# chi-square limit: %.2f (255 degrees of freedom, p = 0.001)\n",
+        RNG_BENCHMARK_CHI_SQUARE_LIMIT);
+    printf("generator,samples,million_per_sec,uniform_chi_square,out_of_range,"
+        "direction_chi_square,result\n");
+
+    // the old generator's directions are biased toward the square's corners, so it is the 
+    // baseline and doesn't count
+    unsigned int failedCount = 0;
+    PrintRngBenchmarkRow("scalar_global", RunScalarGlobalRng(), true);
+    failedCount += 
+        PrintRngBenchmarkRow("scalar_generator", RunScalarGeneratorRng(), false) ? 0 : 1;
+    failedCount += PrintRngBenchmarkRow("simd_generator", RunSimdGeneratorRng(), false) ? 0 : 1;
+    RngBenchmarkResult gpuResult;
+    if (RunGpuRng(&gpuResult))
+    {
+        failedCount += PrintRngBenchmarkRow("gpu_pcg_hash", gpuResult, false) ? 0 : 1;
+    }
+    else
+    {
+        failedCount++;
+    }
+
+    printf("# %u generators failed\n", failedCount);
+    return (failedCount == 0) ? 0 : 1;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Measures each of the program's random number generators for speed and checks that its
+    numbers are fit for emission, so that the fastest one that is still correct can be picked.
+    One CSV row is printed per generator:
+
+    scalar_global       RandomOnRange0to1() (see RandomToast.h), with the directions that the
+                        CPU backend's ResetParticle(...) makes (a normalized random point in a
+                        square)
+    scalar_generator    RandomGenerator::NextOnRange0to1(), one at a time, with directions
+                        from a random angle
+    simd_generator      RandomGenerator::FillUniform(...) and FillUnitVectors(...), 4 at once
+                        with SSE2
+    gpu_pcg_hash        the compute shader's RandomOnRange0to1(...) and RandomDirection(...),
+                        seeded per work item like the emission's
+
+    The rate is numbers per second, with the numbers written to memory (on the GPU, summed into
+    a register) and nothing else.  The statistics are from a separate run that isn't timed: a
+    chi-square test of the numbers in 256 equal buckets of [0,1), a count of the numbers that
+    were outside of [0,1) (ex: exactly 1.0), and a chi-square test of the directions' angles
+    in 256 equal buckets of the circle.  A generator passes if it has no numbers out of range
+    and both of its chi-squares are under the 0.1% critical value for 255 degrees of freedom,
+    so a correct generator fails about 1 run in 500.
+
+    scalar_global is the baseline: a normalized point in a square crowds the directions toward
+    the corners, so it always fails the direction test.  Its result says "known_bad" instead 
+    of "FAIL", and it doesn't count against the return value.
+
+    Note: The caller must have already created an OpenGL 4.4 context and loaded the functions,
+    like for RunBenchmark().
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+int RunRngBenchmark();
@@ -0,0 +1,663 @@
+#include "ScaledRenderTarget.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
+#include "BloomFilter.h"
+#include "ShaderProgramRegistry.h"
+#include "GpuMemoryLedger.h"
+#include "OpenGlErrorHandling.h"
+#include "Log.h"
+
+const float ScaledRenderTarget::MIN_SCALE = 0.5f;
+const float ScaledRenderTarget::MAX_TRAIL_FADE = 0.99f;
+
+// must match the binding of uImage in shaderUpscale.frag and of uPrevious in 
+// shaderTrailFade.frag
+static const unsigned int UPSCALE_TEXTURE_UNIT = 0;
+
+// must match the binding of uBloom in shaderUpscale.frag
+static const unsigned int UPSCALE_BLOOM_TEXTURE_UNIT = 1;
+
+// how much of the difference between a pixel and its neighbors the sharpen adds back
+static const float UPSCALE_SHARPNESS = 0.5f;
+
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ScaledRenderTarget::ScaledRenderTarget() :
+    _upscaleProgramId(0),
+    _unifLocSharpness(0),
+    _unifLocInverseWindowSize(0),
+    _unifLocIsMonochrome(0),
+    _unifLocBloomIntensity(0),
+    _trailFadeProgramId(0),
+    _unifLocTrailFade(0),
+    _upscale(SCALED_RENDER_UPSCALE_BILINEAR),
+    _format(SCALED_RENDER_FORMAT_RGBA8),
+    _emptyVaoId(0),
+    _depthRenderbufferId(0),
+    _current(0),
+    _trailFade(0.0f),
+    _bloom(0),
+    _bloomIntensity(0.0f),
+    _hasDepth(false),
+    _windowWidth(0),
+    _windowHeight(0),
+    _width(0),
+    _height(0),
+    _scale(1.0f),
+    _isActive(false)
+{
+    _framebufferIds[0] = 0;
+    _framebufferIds[1] = 0;
+    _colorTextureIds[0] = 0;
+    _colorTextureIds[1] = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ScaledRenderTarget::~ScaledRenderTarget()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes a reference to the upscale and trail fade programs (see ShaderProgramRegistry.h).
+    The framebuffer isn't created until the scale goes below 1, the format changes, or trails
+    are turned on.  The caller may release their own references after this returns.
+Parameters:
+    upscaleProgramId    shaderDensityResolve.vert (for its fullscreen triangle) and
+                        shaderUpscale.frag.
+    trailFadeProgramId  shaderDensityResolve.vert and shaderTrailFade.frag.
+    windowWidth         The window's width in pixels.
+    windowHeight        The window's height in pixels.
+    hasDepth            True if what is drawn into it needs a depth buffer.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ScaledRenderTarget::Init(unsigned int upscaleProgramId, unsigned int trailFadeProgramId,
+    int windowWidth, int windowHeight, bool hasDepth)
+{
+    this->Cleanup();
+
+    _upscaleProgramId = upscaleProgramId;
+    AddProgramReference(_upscaleProgramId);
+    _unifLocSharpness = glGetUniformLocation(_upscaleProgramId, "uSharpness");
+    _unifLocInverseWindowSize = glGetUniformLocation(_upscaleProgramId, "uInverseWindowSize");
+    _unifLocIsMonochrome = glGetUniformLocation(_upscaleProgramId, "uIsMonochrome");
+    _unifLocBloomIntensity = glGetUniformLocation(_upscaleProgramId, "uBloomIntensity");
+    _trailFadeProgramId = trailFadeProgramId;
+    AddProgramReference(_trailFadeProgramId);
+    _unifLocTrailFade = glGetUniformLocation(_trailFadeProgramId, "uFade");
+    glGenVertexArrays(1, &_emptyVaoId);
+    _hasDepth = hasDepth;
+    _windowWidth = windowWidth;
+    _windowHeight = windowHeight;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Releases the programs and deletes the framebuffers and the VAO.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ScaledRenderTarget::Cleanup()
+{
+    this->DeleteFramebuffer();
+    if (_emptyVaoId != 0)
+    {
+        DeleteGlVertexArrays(1, &_emptyVaoId);
+        _emptyVaoId = 0;
+    }
+    ReleaseProgram(_upscaleProgramId);
+    _upscaleProgramId = 0;
+    ReleaseProgram(_trailFadeProgramId);
+    _trailFadeProgramId = 0;
+    _isActive = false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Re-creates the framebuffer for the new window size, if the scale or the format calls for 
+    one.
+Parameters:
+    windowWidth     The window's width in pixels.
+    windowHeight    The window's height in pixels.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ScaledRenderTarget::Resize(int windowWidth, int windowHeight)
+{
+    if (windowWidth == _windowWidth && windowHeight == _windowHeight)
+    {
+        return;
+    }
+
+    _windowWidth = windowWidth;
+    _windowHeight = windowHeight;
+    if (this->NeedsFramebuffer())
+    {
+        this->InitFramebuffer();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Switches to a rebuilt program (see ShaderProgramRegistry.h).
+Parameters:
+    oldProgramId    Self-explanatory.  Programs that this target doesn't use are ignored.
+    newProgramId    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ScaledRenderTarget::ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId)
+{
+    if (oldProgramId == 0 || newProgramId == 0)
+    {
+        return;
+    }
+
+    if (_upscaleProgramId == oldProgramId)
+    {
+        AddProgramReference(newProgramId);
+        ReleaseProgram(_upscaleProgramId);
+        _upscaleProgramId = newProgramId;
+        _unifLocSharpness = glGetUniformLocation(_upscaleProgramId, "uSharpness");
+        _unifLocInverseWindowSize = glGetUniformLocation(_upscaleProgramId, 
+            "uInverseWindowSize");
+        _unifLocIsMonochrome = glGetUniformLocation(_upscaleProgramId, "uIsMonochrome");
+        _unifLocBloomIntensity = glGetUniformLocation(_upscaleProgramId, "uBloomIntensity");
+    }
+    if (_trailFadeProgramId == oldProgramId)
+    {
+        AddProgramReference(newProgramId);
+        ReleaseProgram(_trailFadeProgramId);
+        _trailFadeProgramId = newProgramId;
+        _unifLocTrailFade = glGetUniformLocation(_trailFadeProgramId, "uFade");
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets the size of the framebuffer as a fraction of the window on each axis.  The
+    framebuffer is (re)created here, not in Begin(), so that a frame doesn't pay for it.  Can
+    be changed at any time outside of Begin() and End().
+Parameters:
+    scale   Clamped to [MIN_SCALE, 1].
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ScaledRenderTarget::SetScale(float scale)
+{
+    scale = (scale < MIN_SCALE) ? MIN_SCALE : ((scale > 1.0f) ? 1.0f : scale);
+    if (scale == _scale || _isActive)
+    {
+        return;
+    }
+
+    _scale = scale;
+    if (this->NeedsFramebuffer())
+    {
+        this->InitFramebuffer();
+    }
+    else
+    {
+        // the draw goes straight to the window, so the memory can go back
+        this->DeleteFramebuffer();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    See SetScale(...).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+float ScaledRenderTarget::GetScale() const
+{
+    return _scale;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.  Can be changed at any time.
+Parameters:
+    upscale     Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ScaledRenderTarget::SetUpscale(ScaledRenderUpscale upscale)
+{
+    _upscale = upscale;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets the framebuffer's color format and (re)creates or deletes the framebuffer to match.
+    Can be changed at any time outside of Begin() and End().
+Parameters:
+    format  Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ScaledRenderTarget::SetFormat(ScaledRenderFormat format)
+{
+    if (format == _format || _isActive)
+    {
+        return;
+    }
+
+    _format = format;
+    if (this->NeedsFramebuffer())
+    {
+        this->InitFramebuffer();
+    }
+    else
+    {
+        this->DeleteFramebuffer();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    See SetFormat(...).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ScaledRenderFormat ScaledRenderTarget::GetFormat() const
+{
+    return _format;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Turns motion trails on or off.  Each frame, what was drawn the frame before is multiplied
+    by the fade, so a trail is roughly 1 / (1 - fade) frames long.  Turning them on creates
+    the second color texture (and the framebuffer, if there wasn't one), so it can be changed
+    at any time outside of Begin() and End().
+
+    Note: The fade is per frame, not per second, so trails are shorter in time at higher frame
+    rates.
+Parameters:
+    fade    0 turns trails off.  Anything else is clamped to (0, MAX_TRAIL_FADE].
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ScaledRenderTarget::SetTrailFade(float fade)
+{
+    fade = (fade < 0.0f) ? 0.0f : ((fade > MAX_TRAIL_FADE) ? MAX_TRAIL_FADE : fade);
+    if (fade == _trailFade || _isActive)
+    {
+        return;
+    }
+
+    bool hadTrails = this->HasTrails();
+    _trailFade = fade;
+    if (this->HasTrails() == hadTrails)
+    {
+        // only the fade changed, so the textures (and the trails in them) are kept
+        return;
+    }
+
+    if (this->NeedsFramebuffer())
+    {
+        this->InitFramebuffer();
+    }
+    else
+    {
+        this->DeleteFramebuffer();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    True if trails are on, in which case Begin() fills the framebuffer with the faded last
+    frame and the caller must not clear its color.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ScaledRenderTarget::HasTrails() const
+{
+    return _trailFade > 0.0f;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Turns the glow on or off.  When it is on, End() runs the bloom filter over the framebuffer
+    and the upscale adds the glow to it, and the draw goes through the framebuffer at every
+    scale.  Can be changed at any time outside of Begin() and End().
+Parameters:
+    bloom       Not owned, and must outlive this target (or be replaced first).  0 turns the
+                glow off.
+    intensity   How much of the glow is added.  0 (or less) also turns it off.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ScaledRenderTarget::SetBloom(BloomFilter *bloom, float intensity)
+{
+    if (_isActive)
+    {
+        return;
+    }
+
+    bool neededFramebuffer = this->NeedsFramebuffer();
+    _bloom = (intensity > 0.0f) ? bloom : 0;
+    _bloomIntensity = (_bloom != 0) ? intensity : 0.0f;
+    if (this->NeedsFramebuffer() == neededFramebuffer)
+    {
+        return;
+    }
+
+    if (this->NeedsFramebuffer())
+    {
+        this->InitFramebuffer();
+    }
+    else
+    {
+        this->DeleteFramebuffer();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Redirects the draw into the framebuffer and sets the viewport to its size.  The caller
+    clears it as it would the window, except for the color if there are trails (see
+    HasTrails()), which Begin() has already filled with the faded last frame.
+Parameters: None
+Returns:
+    False if the scale is 1, the format is RGBA8, and there are no trails and no glow, in
+    which case nothing was changed and the draw goes straight to the window.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ScaledRenderTarget::Begin()
+{
+    if (_framebufferIds[0] == 0 || _width <= 0 || _height <= 0)
+    {
+        return false;
+    }
+
+    unsigned int previous = _current;
+    if (this->HasTrails())
+    {
+        _current = 1 - _current;
+    }
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _framebufferIds[_current]);
+    glViewport(0, 0, _width, _height);
+    _isActive = true;
+
+    if (this->HasTrails())
+    {
+        // the fade writes every pixel
+        GlDebugGroup fadeGroup("trail fade");
+        GLboolean isBlendEnabled = IsGlCapabilityEnabled(GL_BLEND);
+        GLboolean isDepthTestEnabled = IsGlCapabilityEnabled(GL_DEPTH_TEST);
+        DisableGlCapability(GL_BLEND);
+        DisableGlCapability(GL_DEPTH_TEST);
+
+        UseGlProgram(_trailFadeProgramId);
+        glUniform1f(_unifLocTrailFade, _trailFade);
+        glActiveTexture(GL_TEXTURE0 + UPSCALE_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, _colorTextureIds[previous]);
+        BindGlVertexArray(_emptyVaoId);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        BindGlVertexArray(0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        UseGlProgram(0);
+
+        if (isBlendEnabled)
+        {
+            EnableGlCapability(GL_BLEND);
+        }
+        if (isDepthTestEnabled)
+        {
+            EnableGlCapability(GL_DEPTH_TEST);
+        }
+    }
+
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Stretches the framebuffer over the window and puts the window and its viewport back.  Does
+    nothing if Begin() didn't redirect the draw.
+
+    Note: The upscale writes every pixel of the window, so blending and the depth test are
+    turned off for it and then put back the way they were.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ScaledRenderTarget::End()
+{
+    if (!_isActive)
+    {
+        return;
+    }
+    _isActive = false;
+    GlDebugGroup postGroup("post: bloom and upscale");
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glViewport(0, 0, _windowWidth, _windowHeight);
+
+    GLboolean isBlendEnabled = IsGlCapabilityEnabled(GL_BLEND);
+    GLboolean isDepthTestEnabled = IsGlCapabilityEnabled(GL_DEPTH_TEST);
+    DisableGlCapability(GL_BLEND);
+    DisableGlCapability(GL_DEPTH_TEST);
+
+    // the bloom filter reads the finished image, so it runs after the draw and before the
+    // upscale that adds it in
+    unsigned int bloomTextureId = 0;
+    if (_bloom != 0)
+    {
+        _bloom->Apply(_colorTextureIds[_current], _width, _height);
+        bloomTextureId = _bloom->GetTextureId();
+    }
+
+    UseGlProgram(_upscaleProgramId);
+    glUniform1f(_unifLocBloomIntensity, (bloomTextureId != 0) ? _bloomIntensity : 0.0f);
+    glActiveTexture(GL_TEXTURE0 + UPSCALE_BLOOM_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, bloomTextureId);
+    glUniform1f(_unifLocSharpness,
+        (_upscale == SCALED_RENDER_UPSCALE_SHARPEN) ? UPSCALE_SHARPNESS : 0.0f);
+    glUniform2f(_unifLocInverseWindowSize, 1.0f / _windowWidth, 1.0f / _windowHeight);
+    glUniform1i(_unifLocIsMonochrome, (_format == SCALED_RENDER_FORMAT_R16F) ? 1 : 0);
+    glActiveTexture(GL_TEXTURE0 + UPSCALE_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, _colorTextureIds[_current]);
+    BindGlVertexArray(_emptyVaoId);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    BindGlVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0 + UPSCALE_BLOOM_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    UseGlProgram(0);
+
+    if (isBlendEnabled)
+    {
+        EnableGlCapability(GL_BLEND);
+    }
+    if (isDepthTestEnabled)
+    {
+        EnableGlCapability(GL_DEPTH_TEST);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    True if the draw should go through the framebuffer, which is whenever it differs from the
+    window in size or in format, or it keeps trails or adds a glow.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ScaledRenderTarget::NeedsFramebuffer() const
+{
+    return _upscaleProgramId != 0 && 
+        (_scale < 1.0f || _format != SCALED_RENDER_FORMAT_RGBA8 || this->HasTrails() || 
+        _bloom != 0);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    (Re)creates the framebuffer at the current scale of the window.  The color is a texture in
+    the current format with a linear filter, which is the bilinear part of the upscale, and the
+    depth (if any) is a renderbuffer, since nothing reads it.  There is never a stencil.  With
+    trails, there is a second framebuffer with its own color and the same depth, and both
+    colors start out black.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ScaledRenderTarget::InitFramebuffer()
+{
+    this->DeleteFramebuffer();
+
+    // a minimized window reports 0x0
+    _width = (int)((_windowWidth * _scale) + 0.5f);
+    _height = (int)((_windowHeight * _scale) + 0.5f);
+    if (_width <= 0 || _height <= 0)
+    {
+        return;
+    }
+
+    GLenum internalFormat = GL_RGBA8;
+    if (_format == SCALED_RENDER_FORMAT_R11G11B10F)
+    {
+        internalFormat = GL_R11F_G11F_B10F;
+    }
+    else if (_format == SCALED_RENDER_FORMAT_R16F)
+    {
+        internalFormat = GL_R16F;
+    }
+    else if (_format == SCALED_RENDER_FORMAT_RGB565)
+    {
+        internalFormat = GL_RGB565;
+    }
+
+    if (_hasDepth)
+    {
+        glGenRenderbuffers(1, &_depthRenderbufferId);
+        glBindRenderbuffer(GL_RENDERBUFFER, _depthRenderbufferId);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, _width, _height);
+        RecordGpuAllocation(GPU_MEMORY_RENDERBUFFER, _depthRenderbufferId, 
+            GetGlTextureSizeBytes(GL_DEPTH_COMPONENT24, _width, _height), "render target");
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    }
+
+    unsigned int framebufferCount = this->HasTrails() ? 2 : 1;
+    GLenum status = GL_FRAMEBUFFER_COMPLETE;
+    for (unsigned int index = 0; index < framebufferCount; index++)
+    {
+        glGenTextures(1, &_colorTextureIds[index]);
+        glBindTexture(GL_TEXTURE_2D, _colorTextureIds[index]);
+        glTexStorage2D(GL_TEXTURE_2D, 1, internalFormat, _width, _height);
+        RecordGpuAllocation(GPU_MEMORY_TEXTURE, _colorTextureIds[index], 
+            GetGlTextureSizeBytes(internalFormat, _width, _height), "render target");
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        // texture storage starts out undefined, and the first trail fade reads it
+        float black[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        glClearTexImage(_colorTextureIds[index], 0, GL_RGBA, GL_FLOAT, black);
+
+        glGenFramebuffers(1, &_framebufferIds[index]);
+        glBindFramebuffer(GL_FRAMEBUFFER, _framebufferIds[index]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+            _colorTextureIds[index], 0);
+        if (_hasDepth)
+        {
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER,
+                _depthRenderbufferId);
+        }
+        status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (status != GL_FRAMEBUFFER_COMPLETE)
+        {
+            break;
+        }
+    }
+    _current = 0;
+
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        LogPrintf("scaled render target: framebuffer incomplete (0x%x); drawing at full size\n",
+            status);
+        this->DeleteFramebuffer();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.  Begin() doesn't redirect anything until InitFramebuffer() runs again.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ScaledRenderTarget::DeleteFramebuffer()
+{
+    for (unsigned int index = 0; index < 2; index++)
+    {
+        if (_framebufferIds[index] != 0)
+        {
+            glDeleteFramebuffers(1, &_framebufferIds[index]);
+            _framebufferIds[index] = 0;
+        }
+        if (_colorTextureIds[index] != 0)
+        {
+            ForgetGpuAllocation(GPU_MEMORY_TEXTURE, _colorTextureIds[index]);
+            glDeleteTextures(1, &_colorTextureIds[index]);
+            _colorTextureIds[index] = 0;
+        }
+    }
+    if (_depthRenderbufferId != 0)
+    {
+        ForgetGpuAllocation(GPU_MEMORY_RENDERBUFFER, _depthRenderbufferId);
+        glDeleteRenderbuffers(1, &_depthRenderbufferId);
+        _depthRenderbufferId = 0;
+    }
+    _width = 0;
+    _height = 0;
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+class BloomFilter;
+
+// how ScaledRenderTarget stretches its image over the window
+enum ScaledRenderUpscale
+{
+    // the texture's linear filter, and nothing else
+    SCALED_RENDER_UPSCALE_BILINEAR = 0,
+
+    // bilinear, then an unsharp mask to win back some of the edges that the smaller image lost
+    SCALED_RENDER_UPSCALE_SHARPEN,
+};
+
+// the scaled render target's color format
+// Note: Additive particles are mostly fill and blend bandwidth, and these are all smaller (or
+// no bigger) than RGBA8 per pixel.  None of them have alpha, which nothing reads back.
+enum ScaledRenderFormat
+{
+    // the same as the window, so the target is skipped entirely at a scale of 1
+    SCALED_RENDER_FORMAT_RGBA8 = 0,
+
+    // 32 bits of float color, so additive particles that are each too dim for 8 bits still add
+    // up, and bright overlaps go past 1 until the upscale clamps them
+    SCALED_RENDER_FORMAT_R11G11B10F,
+
+    // 16 bits of float brightness and no color, for density only; the upscale draws it as grey
+    SCALED_RENDER_FORMAT_R16F,
+
+    // 16 bits of color, for a cheap preview
+    SCALED_RENDER_FORMAT_RGB565,
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    An offscreen framebuffer that is a fraction of the window's size, for when filling the
+    window's pixels costs more than the frame has (ex: a 4K window full of big, overlapping
+    particles).  The particles are drawn into it between Begin() and End(), and End()
+    stretches it over the window with a fullscreen triangle.  The fill cost goes down with the
+    square of the scale, and the particle count doesn't change.
+
+    At a scale of 1 and in RGBA8, Begin() doesn't redirect anything and End() does nothing, so
+    a target that the frame budget governor (see FrameBudgetGovernor.h) never turns down costs
+    nothing.  In any other format (see ScaledRenderFormat), the draw goes through it at every
+    scale.
+
+    It also keeps motion trails (see SetTrailFade(...)).  Two color textures take turns: Begin()
+    fades the last frame's into the other one with a fullscreen triangle, instead of the
+    caller's clear, and the particles are drawn on top.  The cost is a read and a write per
+    pixel no matter how long the trails are or how many particles there are, and no history of
+    positions is kept anywhere.  Trails are in window pixels, so they smear when the camera
+    moves, and they start over when the framebuffer is re-created.
+
+    It can also add a glow around the bright parts (see SetBloom(...)) as part of the upscale.
+
+    Note: Whatever is drawn into it must size itself for the smaller framebuffer (see
+    ParticleManager::SetRenderScale(...)).  Things drawn after End() (ex: the frame graph) go
+    straight to the window at full resolution.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class ScaledRenderTarget
+{
+public:
+    ScaledRenderTarget();
+    ~ScaledRenderTarget();
+    void Init(unsigned int upscaleProgramId, unsigned int trailFadeProgramId, int windowWidth,
+        int windowHeight, bool hasDepth);
+    void Cleanup();
+    void Resize(int windowWidth, int windowHeight);
+    void ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId);
+
+    void SetScale(float scale);
+    float GetScale() const;
+    void SetUpscale(ScaledRenderUpscale upscale);
+    void SetFormat(ScaledRenderFormat format);
+    ScaledRenderFormat GetFormat() const;
+    void SetTrailFade(float fade);
+    bool HasTrails() const;
+    void SetBloom(BloomFilter *bloom, float intensity);
+    bool Begin();
+    void End();
+
+    // below half of the window on each axis, the particles turn into blocks
+    static const float MIN_SCALE;
+
+    // any closer to 1 and the trails never really go away
+    static const float MAX_TRAIL_FADE;
+
+private:
+    bool NeedsFramebuffer() const;
+    void InitFramebuffer();
+    void DeleteFramebuffer();
+
+    unsigned int _upscaleProgramId;
+    unsigned int _unifLocSharpness;
+    unsigned int _unifLocInverseWindowSize;
+    unsigned int _unifLocIsMonochrome;
+    unsigned int _unifLocBloomIntensity;
+    unsigned int _trailFadeProgramId;
+    unsigned int _unifLocTrailFade;
+    ScaledRenderUpscale _upscale;
+    ScaledRenderFormat _format;
+
+    // the fullscreen triangle has no vertex attributes, but the core profile still needs a VAO
+    // bound to draw
+    unsigned int _emptyVaoId;
+
+    // the second is only made for trails; the depth buffer is shared, since it is cleared
+    // every frame
+    unsigned int _framebufferIds[2];
+    unsigned int _colorTextureIds[2];
+    unsigned int _depthRenderbufferId;
+    unsigned int _current;
+    float _trailFade;
+
+    // not owned; see SetBloom(...)
+    BloomFilter *_bloom;
+    float _bloomIntensity;
+    bool _hasDepth;
+    int _windowWidth;
+    int _windowHeight;
+    int _width;
+    int _height;
+    float _scale;
+
+    // true between a Begin() that redirected the draw and its End()
+    bool _isActive;
+};
@@ -0,0 +1,344 @@
+#include "SceneConfig.h"
+
+#include "Log.h"
+
+#include <fstream>
+#include <string>
+#include <sys/stat.h>
+#include <stdlib.h>
+
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    text    Self-explanatory.
+Returns:
+    The text without the spaces and tabs at either end.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static std::string TrimSpaces(const std::string &text)
+{
+    size_t first = text.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos)
+    {
+        return std::string();
+    }
+    size_t last = text.find_last_not_of(" \t\r\n");
+    return text.substr(first, (last - first) + 1);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Reads a number, all of it, so that a typo like "0.5x" is caught instead of read as 0.5.
+Parameters:
+    text                Self-explanatory.
+    putValueHere        Self-explanatory.
+Returns:
+    True if the whole text was a number, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static bool ParseFloat(const std::string &text, float *putValueHere)
+{
+    char *end = 0;
+    float value = strtof(text.c_str(), &end);
+    if (text.empty() || *end != '\0')
+    {
+        return false;
+    }
+    *putValueHere = value;
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The same as ParseFloat(...), but for a count or a size that can't be negative.
+Parameters:
+    text                Self-explanatory.
+    putValueHere        Self-explanatory.
+Returns:
+    True if the whole text was a whole number, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static bool ParseUnsigned(const std::string &text, unsigned int *putValueHere)
+{
+    char *end = 0;
+    long value = strtol(text.c_str(), &end, 10);
+    if (text.empty() || *end != '\0' || value < 0)
+    {
+        return false;
+    }
+    *putValueHere = (unsigned int)value;
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The scene that the demo ran before there was a config file: 1 emitter up and to the right
+    of the middle of a 500x500 window.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+SceneConfig GetDefaultSceneConfig()
+{
+    SceneConfig config;
+    config._particleCount = 0;
+    config._particleLayout = PARTICLE_LAYOUT_SOA;
+    config._maxParticlesEmittedPerFrame = 200;
+    config._lifetimeSec = 0.0f;
+    config._emitterCenter = glm::vec2(+0.3f, +0.3f);
+    config._emitterRadius = 1.1f;
+    config._minVelocity = 0.05f;
+    config._maxVelocity = 0.6f;
+    config._windowWidth = 500;
+    config._windowHeight = 500;
+    config._pointSize = 0.0f;
+    config._brightness = 0.0f;
+    return config;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets one value by its "section.key" name (see SceneConfig.h).
+Parameters:
+    key         Ex: "emitter.radius".
+    value       The text after the '=', without the spaces around it.
+    config      Only the one value is changed, and only if it could be read.
+Returns:
+    True if the key was known and the value was good, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool SetSceneConfigValue(const std::string &key, const std::string &value,
+    SceneConfig *config)
+{
+    unsigned int count = 0;
+    float number = 0.0f;
+    if (key == "particles.count")
+    {
+        return ParseUnsigned(value, &config->_particleCount);
+    }
+    else if (key == "particles.layout")
+    {
+        if (value == "interleaved")
+        {
+            config->_particleLayout = PARTICLE_LAYOUT_INTERLEAVED;
+        }
+        else if (value == "soa")
+        {
+            config->_particleLayout = PARTICLE_LAYOUT_SOA;
+        }
+        else if (value == "half_float")
+        {
+            config->_particleLayout = PARTICLE_LAYOUT_HALF_FLOAT;
+        }
+        else if (value == "fixed_point")
+        {
+            config->_particleLayout = PARTICLE_LAYOUT_FIXED_POINT;
+        }
+        else
+        {
+            return false;
+        }
+        return true;
+    }
+    else if (key == "particles.emit_per_frame")
+    {
+        return ParseUnsigned(value, &config->_maxParticlesEmittedPerFrame);
+    }
+    else if (key == "particles.lifetime")
+    {
+        return ParseFloat(value, &config->_lifetimeSec) && config->_lifetimeSec >= 0.0f;
+    }
+    else if (key == "emitter.center_x")
+    {
+        return ParseFloat(value, &config->_emitterCenter.x);
+    }
+    else if (key == "emitter.center_y")
+    {
+        return ParseFloat(value, &config->_emitterCenter.y);
+    }
+    else if (key == "emitter.radius")
+    {
+        return ParseFloat(value, &config->_emitterRadius);
+    }
+    else if (key == "emitter.min_velocity")
+    {
+        return ParseFloat(value, &config->_minVelocity);
+    }
+    else if (key == "emitter.max_velocity")
+    {
+        return ParseFloat(value, &config->_maxVelocity);
+    }
+    else if (key == "window.width" || key == "window.height")
+    {
+        // a window has to have some size
+        if (!ParseUnsigned(value, &count) || count == 0)
+        {
+            return false;
+        }
+        int *size = (key == "window.width") ? &config->_windowWidth : &config->_windowHeight;
+        *size = (int)count;
+        return true;
+    }
+    else if (key == "render.point_size" || key == "render.brightness")
+    {
+        if (!ParseFloat(value, &number) || number < 0.0f)
+        {
+            return false;
+        }
+        float *setting = (key == "render.point_size") ? &config->_pointSize :
+            &config->_brightness;
+        *setting = number;
+        return true;
+    }
+
+    return false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Reads a scene file (see SceneConfig.h) over the config's current values, so the keys that
+    the file leaves out keep what they had.  Lines that can't be read are reported with their
+    line numbers and skipped; the rest of the file still counts.
+Parameters:
+    filePath        Self-explanatory.
+    putConfigHere   Self-explanatory.
+Returns:
+    False if the file couldn't be opened, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool LoadSceneConfig(const std::string &filePath, SceneConfig *putConfigHere)
+{
+    std::ifstream configFile(filePath.c_str());
+    if (!configFile.is_open())
+    {
+        LogErrorPrintf("can't open scene config '%s'\n", filePath.c_str());
+        return false;
+    }
+
+    std::string section;
+    std::string line;
+    unsigned int lineNumber = 0;
+    while (std::getline(configFile, line))
+    {
+        lineNumber++;
+        size_t commentStart = line.find_first_of("#;");
+        if (commentStart != std::string::npos)
+        {
+            line.erase(commentStart);
+        }
+        line = TrimSpaces(line);
+        if (line.empty())
+        {
+            continue;
+        }
+
+        if (line[0] == '[' && line[line.size() - 1] == ']')
+        {
+            section = TrimSpaces(line.substr(1, line.size() - 2));
+            continue;
+        }
+
+        size_t equalsAt = line.find('=');
+        if (equalsAt == std::string::npos)
+        {
+            LogErrorPrintf("%s(%u): expected 'key = value'\n", filePath.c_str(), lineNumber);
+            continue;
+        }
+        std::string key = section + "." + TrimSpaces(line.substr(0, equalsAt));
+        std::string value = TrimSpaces(line.substr(equalsAt + 1));
+        if (!SetSceneConfigValue(key, value, putConfigHere))
+        {
+            LogErrorPrintf("%s(%u): bad value '%s' for '%s'\n", filePath.c_str(), lineNumber,
+                value.c_str(), key.c_str());
+        }
+    }
+
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets one value from a command line assignment.
+Parameters:
+    assignment  Ex: "emitter.radius=0.8".
+    config      Self-explanatory.
+Returns:
+    True if the value was set, otherwise false (and the reason is logged).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ApplySceneConfigOverride(const std::string &assignment, SceneConfig *config)
+{
+    size_t equalsAt = assignment.find('=');
+    if (equalsAt == std::string::npos)
+    {
+        LogErrorPrintf("expected 'section.key=value', not '%s'\n", assignment.c_str());
+        return false;
+    }
+    std::string key = TrimSpaces(assignment.substr(0, equalsAt));
+    std::string value = TrimSpaces(assignment.substr(equalsAt + 1));
+    if (!SetSceneConfigValue(key, value, config))
+    {
+        LogErrorPrintf("bad value '%s' for '%s'\n", value.c_str(), key.c_str());
+        return false;
+    }
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.  Cheap enough to ask a few times a second, which is how the demo notices
+    that the scene file was saved.
+Parameters:
+    filePath        Self-explanatory.
+    putTimeHere     The file's modification time.
+Returns:
+    False if the file isn't there right now (ex: an editor is replacing it), otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool GetSceneConfigFileTime(const std::string &filePath, long long *putTimeHere)
+{
+    struct stat fileStats;
+    if (stat(filePath.c_str(), &fileStats) != 0)
+    {
+        return false;
+    }
+    *putTimeHere = (long long)fileStats.st_mtime;
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives an emitter the scene's emitter parameters.  The pool's particle ranges are left
+    alone, since ParticleManager owns those (see ParticleManager::SetEmitter(...)).
+Parameters:
+    config          Self-explanatory.
+    emitterCount    The emission is shared between this many emitters that are all the same
+                    (ex: the split simulation cuts the one emitter into several).
+    emitter         Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ApplySceneConfigToEmitter(const SceneConfig &config, unsigned int emitterCount,
+    ParticleEmitter *emitter)
+{
+    emitterCount = (emitterCount > 0) ? emitterCount : 1;
+    emitter->_center = config._emitterCenter;
+    emitter->_radius = config._emitterRadius;
+    emitter->_velocityMin = config._minVelocity;
+    emitter->_velocityMax = config._maxVelocity;
+    emitter->_maxParticlesEmittedPerFrame =
+        (config._maxParticlesEmittedPerFrame + emitterCount - 1) / emitterCount;
+    emitter->_lifetimeSec = config._lifetimeSec;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Particle.h"
+#include "ParticleEmitter.h"
+#include "glm/vec2.hpp"
+
+#include <string>
+#include <vector>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The demo's scene: how big the particle pool is, what its one emitter does, and how big the
+    window is.  It starts out as the values that used to be hard-coded in Init(), can be
+    loaded from an INI file ("--config scene.ini"), and any value can be overridden from the
+    command line ("--set emitter.radius=0.8").
+
+    The file is a few sections with "key = value" lines, and '#' or ';' starts a comment:
+
+        [particles]
+        count = 600000              # 0 for the demo's default
+        layout = soa                # interleaved, soa, half_float, or fixed_point
+        emit_per_frame = 200
+        lifetime = 0                # seconds; 0 for no limit
+        [emitter]
+        center_x = 0.3
+        center_y = 0.3
+        radius = 1.1
+        min_velocity = 0.05
+        max_velocity = 0.6
+        [window]
+        width = 500
+        height = 500
+        [render]
+        point_size = 0              # 0 for the render mode's default
+        brightness = 0              # 0 for the render mode's default
+
+    Note: The values that are only uniforms or emitter parameters can change while the demo
+    runs (see ApplySceneConfigToEmitter(...)).  The particle count changes the size of the
+    pool, which the GPU backend can do in place (see ParticleManager::Resize(...)).  The
+    layout and the window size are only read at startup.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+struct SceneConfig
+{
+    unsigned int _particleCount;
+    ParticleLayout _particleLayout;
+    unsigned int _maxParticlesEmittedPerFrame;
+    float _lifetimeSec;
+
+    glm::vec2 _emitterCenter;
+    float _emitterRadius;
+    float _minVelocity;
+    float _maxVelocity;
+
+    int _windowWidth;
+    int _windowHeight;
+
+    float _pointSize;
+    float _brightness;
+};
+
+SceneConfig GetDefaultSceneConfig();
+bool LoadSceneConfig(const std::string &filePath, SceneConfig *putConfigHere);
+bool SetSceneConfigValue(const std::string &key, const std::string &value,
+    SceneConfig *config);
+bool ApplySceneConfigOverride(const std::string &assignment, SceneConfig *config);
+bool GetSceneConfigFileTime(const std::string &filePath, long long *putTimeHere);
+void ApplySceneConfigToEmitter(const SceneConfig &config, unsigned int emitterCount,
+    ParticleEmitter *emitter);
@@ -0,0 +1,297 @@
+#include "ShaderBinaryCache.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
+
+#include <fstream>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+
+// identifies the file as one of ours (and catches truncated or foreign files early)
+static const unsigned int PROGRAM_CACHE_MAGIC = 0x4e494250;   // "PBIN"
+
+// set by SetShaderSourceDump(...)
+static bool gIsShaderSourceDumpEnabled = false;
+
+// written at the start of each cache file
+struct ProgramCacheFileHeader
+{
+    unsigned int _magic;
+    unsigned int _binaryFormat;
+    unsigned int _binaryLength;
+};
+
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    64-bit FNV-1a.  Not cryptographic, but fast, simple, and plenty to tell shader sources
+    apart.
+Parameters:
+    data    Self-explanatory.
+    hash    The running hash.  Start with the FNV offset basis.
+Returns:
+    The updated hash.
+Exception:  Safe
+Creator:    John Cox (8-11-2016)
+-----------------------------------------------------------------------------------------------*/
+static unsigned long long HashFnv1a(const std::string &data, unsigned long long hash)
+{
+    for (size_t charIndex = 0; charIndex < data.size(); charIndex++)
+    {
+        hash ^= (unsigned char)data[charIndex];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    name    GL_VENDOR, GL_RENDERER, or GL_VERSION.
+Returns:
+    The string, or an empty string if the context doesn't report one.
+Exception:  Safe
+Creator:    John Cox (8-11-2016)
+-----------------------------------------------------------------------------------------------*/
+static std::string GetGlString(GLenum name)
+{
+    const GLubyte *str = glGetString(name);
+    return (str == 0) ? std::string() : std::string((const char *)str);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Makes the cache key for a program from everything that goes into it: the source of every
+    shader stage (in order, with defines already inserted) and the identity of the driver.
+Parameters:
+    allShaderSource     The source of every stage, concatenated.
+Returns:
+    A 16-character hex string.
+Exception:  Safe
+Creator:    John Cox (8-11-2016)
+-----------------------------------------------------------------------------------------------*/
+std::string MakeProgramCacheKey(const std::string &allShaderSource)
+{
+    unsigned long long hash = 14695981039346656037ULL;
+    hash = HashFnv1a(allShaderSource, hash);
+    hash = HashFnv1a(GetGlString(GL_VENDOR), hash);
+    hash = HashFnv1a(GetGlString(GL_RENDERER), hash);
+    hash = HashFnv1a(GetGlString(GL_VERSION), hash);
+
+    char hexStr[17];
+    snprintf(hexStr, sizeof(hexStr), "%016llx", hash);
+    return std::string(hexStr);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    cacheKey    From MakeProgramCacheKey(...).
+Returns:
+    The file path for the program's cached binary.
+Exception:  Safe
+Creator:    John Cox (8-11-2016)
+-----------------------------------------------------------------------------------------------*/
+static std::string GetCacheFilePath(const std::string &cacheKey)
+{
+    return "shaderCache_" + cacheKey + ".bin";
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Tries to create a program from a previously saved binary.
+Parameters:
+    cacheKey    From MakeProgramCacheKey(...).
+Returns:
+    The OpenGL ID of the linked program, or 0 if there is no cached binary or if the driver
+    rejected it (in which case the stale file should be overwritten by SaveProgramBinary(...)
+    after compiling).
+Exception:  Safe
+Creator:    John Cox (8-11-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int LoadCachedProgramBinary(const std::string &cacheKey)
+{
+    if (!glext_ARB_get_program_binary)
+    {
+        return 0;
+    }
+
+    std::ifstream cacheFile(GetCacheFilePath(cacheKey).c_str(), std::ios::binary);
+    if (!cacheFile.is_open())
+    {
+        return 0;
+    }
+
+    ProgramCacheFileHeader header;
+    cacheFile.read((char *)&header, sizeof(header));
+    if (!cacheFile || header._magic != PROGRAM_CACHE_MAGIC || header._binaryLength == 0)
+    {
+        return 0;
+    }
+
+    std::vector<char> binary(header._binaryLength);
+    cacheFile.read(binary.data(), header._binaryLength);
+    if (!cacheFile)
+    {
+        return 0;
+    }
+
+    GLuint programId = glCreateProgram();
+    glProgramBinary(programId, header._binaryFormat, binary.data(), header._binaryLength);
+
+    // the driver is allowed to reject a binary for any reason (ex: hardware change), and it
+    // says so through the link status
+    GLint isLinked = GL_FALSE;
+    glGetProgramiv(programId, GL_LINK_STATUS, &isLinked);
+    if (isLinked == GL_FALSE)
+    {
+        DeleteGlProgram(programId);
+        return 0;
+    }
+
+    return programId;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Retrieves a linked program's binary and writes it to the cache.  For best results, the
+    program should have had GL_PROGRAM_BINARY_RETRIEVABLE_HINT set before it was linked.
+Parameters:
+    programId   A successfully linked program.
+    cacheKey    From MakeProgramCacheKey(...).
+Returns:
+    True if the binary was written, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-11-2016)
+-----------------------------------------------------------------------------------------------*/
+bool SaveProgramBinary(unsigned int programId, const std::string &cacheKey)
+{
+    if (!glext_ARB_get_program_binary)
+    {
+        return false;
+    }
+
+    GLint binaryLength = 0;
+    glGetProgramiv(programId, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+    if (binaryLength <= 0)
+    {
+        return false;
+    }
+
+    std::vector<char> binary(binaryLength);
+    GLenum binaryFormat = 0;
+    GLsizei bytesWritten = 0;
+    glGetProgramBinary(programId, binaryLength, &bytesWritten, &binaryFormat, binary.data());
+    if (bytesWritten <= 0)
+    {
+        return false;
+    }
+
+    std::ofstream cacheFile(GetCacheFilePath(cacheKey).c_str(), std::ios::binary | std::ios::trunc);
+    if (!cacheFile.is_open())
+    {
+        return false;
+    }
+
+    ProgramCacheFileHeader header;
+    header._magic = PROGRAM_CACHE_MAGIC;
+    header._binaryFormat = binaryFormat;
+    header._binaryLength = (unsigned int)bytesWritten;
+    cacheFile.write((const char *)&header, sizeof(header));
+    cacheFile.write(binary.data(), bytesWritten);
+    return cacheFile.good();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Makes the key for a variant's SPIR-V module.  Unlike MakeProgramCacheKey(...), the driver
+    isn't part of it, since the same module is good on any driver.
+Parameters:
+    shaderSource    The source with its defines already inserted.
+Returns:
+    A 16-character hex string.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+std::string MakeSpirvKey(const std::string &shaderSource)
+{
+    unsigned long long hash = HashFnv1a(shaderSource, 14695981039346656037ULL);
+    char hexStr[17];
+    snprintf(hexStr, sizeof(hexStr), "%016llx", hash);
+    return std::string(hexStr);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Reads a variant's offline-compiled SPIR-V module, if there is one.
+Parameters:
+    spirvKey        From MakeSpirvKey(...).
+    putModuleHere   Self-explanatory.
+Returns:
+    True if the file was there and looked like SPIR-V, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool LoadSpirvModule(const std::string &spirvKey, std::vector<char> *putModuleHere)
+{
+    std::ifstream moduleFile(("shaderSpirv_" + spirvKey + ".spv").c_str(),
+        std::ios::binary | std::ios::ate);
+    if (!moduleFile.is_open())
+    {
+        return false;
+    }
+
+    // a module is whole words, starting with the magic number
+    std::streamoff sizeBytes = moduleFile.tellg();
+    if (sizeBytes < 20 || (sizeBytes % 4) != 0)
+    {
+        return false;
+    }
+    putModuleHere->resize((size_t)sizeBytes);
+    moduleFile.seekg(0);
+    moduleFile.read(putModuleHere->data(), sizeBytes);
+    unsigned int magic = 0;
+    memcpy(&magic, putModuleHere->data(), sizeof(magic));
+    return moduleFile.good() && magic == 0x07230203;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Turns on writing out the source of every compute variant that is compiled from GLSL, for
+    the offline SPIR-V step (see DumpShaderSource(...)).
+Parameters:
+    isEnabled   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void SetShaderSourceDump(bool isEnabled)
+{
+    gIsShaderSourceDumpEnabled = isEnabled;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Writes a variant's source as "shaderSource_<key>.comp" if the dump is on.  Does nothing
+    otherwise.
+Parameters:
+    spirvKey        From MakeSpirvKey(...).
+    shaderSource    The source with its defines already inserted.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void DumpShaderSource(const std::string &spirvKey, const std::string &shaderSource)
+{
+    if (!gIsShaderSourceDumpEnabled)
+    {
+        return;
+    }
+
+    std::ofstream sourceFile(("shaderSource_" + spirvKey + ".comp").c_str(),
+        std::ios::binary | std::ios::trunc);
+    sourceFile.write(shaderSource.data(), shaderSource.size());
+}
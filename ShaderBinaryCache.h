@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Compiling and linking GLSL is a visible chunk of startup on some drivers, and the result is
+    the same every time as long as the shader source and the driver don't change.  These
+    functions save a linked program's binary (glGetProgramBinary(...)) to disk and load it back
+    on the next launch (glProgramBinary(...)) so that a warm start skips GLSL compilation.
+
+    The cache key is a hash of the full shader source (after any "#define" blocks are inserted)
+    plus GL_VENDOR, GL_RENDERER, and GL_VERSION.  A driver update changes the version string
+    and so invalidates the cache automatically.  If the driver still rejects a binary, the load
+    fails gracefully and the caller compiles as usual.
+
+    Cached binaries are stored in the working directory as "shaderCache_<key>.bin".
+Creator:    John Cox (8-11-2016)
+-----------------------------------------------------------------------------------------------*/
+std::string MakeProgramCacheKey(const std::string &allShaderSource);
+unsigned int LoadCachedProgramBinary(const std::string &cacheKey);
+bool SaveProgramBinary(unsigned int programId, const std::string &cacheKey);
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The binary cache only helps once a driver has compiled the GLSL, so the first start on a
+    new driver still pays for all of it.  A compute variant can instead be compiled to SPIR-V
+    offline (GL_ARB_gl_spirv), and then the driver only has to do its backend compile.
+
+    SPIR-V doesn't depend on the driver, so its key is a hash of the source alone (after the
+    "#define" blocks are inserted).  With the source dump on (see SetShaderSourceDump(...)),
+    every compute variant that is compiled from GLSL is written out as
+    "shaderSource_<key>.comp", which is the exact source with every define already in it, and
+    the offline step compiles each one with:
+
+        glslangValidator -G -o shaderSpirv_<key>.spv shaderSource_<key>.comp
+
+    After that, GenerateComputeShaderProgram(...) loads "shaderSpirv_<key>.spv" in place of
+    compiling, and anything without a module, or on a driver without the extension, is
+    compiled from GLSL as before.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+std::string MakeSpirvKey(const std::string &shaderSource);
+bool LoadSpirvModule(const std::string &spirvKey, std::vector<char> *putModuleHere);
+void SetShaderSourceDump(bool isEnabled);
+void DumpShaderSource(const std::string &spirvKey, const std::string &shaderSource);
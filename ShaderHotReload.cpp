@@ -0,0 +1,507 @@
+#include "ShaderHotReload.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
+#include "GenerateShader.h"
+#include "ShaderProgramRegistry.h"
+#include "Log.h"
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string.h>
+#include <sys/stat.h>
+#include <stdio.h>
+
+// GL_ARB_parallel_shader_compile and GL_KHR_parallel_shader_compile share this value, and this
+// version of glload is older than both
+static const GLenum COMPLETION_STATUS = 0x91B1;
+
+// without GL_COMPLETION_STATUS, this many frames go by after a build starts before its status 
+// is asked for
+static const unsigned int FRAMES_BEFORE_STATUS_QUERY = 3;
+
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+ShaderHotReloader::ShaderHotReloader() :
+    _pollIntervalMs(0),
+    _hasChangedFiles(false),
+    _isRunning(false),
+    _hasCompletionStatus(false),
+    _framesSinceBuildStart(0)
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.  The watcher 
+    thread must be joined before the std::thread is destroyed, or the program is terminated.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+ShaderHotReloader::~ShaderHotReloader()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Finds the shader files of every registered program, and every file that they include, and 
+    starts the watcher thread.  Call this after the programs have been acquired; files that 
+    only later programs use aren't watched.
+Parameters:
+    pollIntervalMs  How long the watcher thread sleeps between looking at the files.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ShaderHotReloader::Init(unsigned int pollIntervalMs)
+{
+    this->Cleanup();
+
+    // the sources were already read when the programs were built, so this doesn't read them 
+    // again
+    std::set<std::string> watchedFiles;
+    std::vector<unsigned int> programIds = GetRegisteredProgramIds();
+    for (size_t programIndex = 0; programIndex < programIds.size(); programIndex++)
+    {
+        RegisteredProgramSource source;
+        GetRegisteredProgramSource(programIds[programIndex], &source);
+        std::vector<std::string> dependencies;
+        if (source._isCompute)
+        {
+            ReadShaderSource(source._compFilePath, &dependencies);
+            AddDefinedIncludeDependencies(source._shaderDefines, &dependencies);
+        }
+        else
+        {
+            std::vector<std::string> fragDependencies;
+            ReadShaderSource(source._vertFilePath, &dependencies);
+            ReadShaderSource(source._fragFilePath, &fragDependencies);
+            dependencies.insert(dependencies.end(), fragDependencies.begin(), 
+                fragDependencies.end());
+        }
+        watchedFiles.insert(dependencies.begin(), dependencies.end());
+    }
+    _watchedFiles.assign(watchedFiles.begin(), watchedFiles.end());
+
+    // core profiles only list extensions one at a time
+    _hasCompletionStatus = false;
+    GLint extensionCount = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    for (GLint extensionIndex = 0; extensionIndex < extensionCount; extensionIndex++)
+    {
+        const char *extensionName = (const char *)glGetStringi(GL_EXTENSIONS, extensionIndex);
+        if (strcmp(extensionName, "GL_ARB_parallel_shader_compile") == 0 || 
+            strcmp(extensionName, "GL_KHR_parallel_shader_compile") == 0)
+        {
+            _hasCompletionStatus = true;
+        }
+    }
+    LogPrintf("shader hot reload: watching %u file(s), %s\n", (unsigned int)_watchedFiles.size(),
+        _hasCompletionStatus ? "parallel compile" : "no parallel compile extension");
+
+    _pollIntervalMs = pollIntervalMs;
+    _fileModifiedTimes.clear();
+    _fileContents.clear();
+    _changedFiles.clear();
+    _hasChangedFiles = false;
+    _framesSinceBuildStart = 0;
+    _isRunning = true;
+    _watcherThread = std::thread(&ShaderHotReloader::WatcherThreadLoop, this);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Stops the watcher thread and throws away any builds that haven't finished.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ShaderHotReloader::Cleanup()
+{
+    _isRunning = false;
+    if (_watcherThread.joinable())
+    {
+        _watcherThread.join();
+    }
+
+    for (size_t buildIndex = 0; buildIndex < _builds.size(); buildIndex++)
+    {
+        ProgramBuild &build = _builds[buildIndex];
+        for (unsigned int shaderIndex = 0; shaderIndex < build._shaderCount; shaderIndex++)
+        {
+            glDetachShader(build._newProgramId, build._shaderIds[shaderIndex]);
+            glDeleteShader(build._shaderIds[shaderIndex]);
+        }
+        DeleteGlProgram(build._newProgramId);
+    }
+    _builds.clear();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Call once per frame, before anything is updated or drawn.  Checks on the builds that are 
+    in progress without waiting for them, and once every one of them is done, hands back the 
+    ones that built.  If nothing is being built and files have changed, it starts building 
+    every program that uses them.
+Parameters:
+    putSwapsHere    Cleared, then filled with the programs to swap in, if any.  The caller 
+                    owns one reference to each new program (see ShaderProgramSwap).
+Returns:
+    True if there are programs to swap in, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ShaderHotReloader::Update(std::vector<ShaderProgramSwap> *putSwapsHere)
+{
+    putSwapsHere->clear();
+
+    if (!_builds.empty())
+    {
+        // swap all or nothing so that, for example, a render program and the compute program 
+        // from the same edit (maybe a change to a shared struct) start on the same frame
+        _framesSinceBuildStart++;
+        for (size_t buildIndex = 0; buildIndex < _builds.size(); buildIndex++)
+        {
+            if (!this->IsBuildDone(_builds[buildIndex]))
+            {
+                return false;
+            }
+        }
+
+        for (size_t buildIndex = 0; buildIndex < _builds.size(); buildIndex++)
+        {
+            ProgramBuild &build = _builds[buildIndex];
+            if (this->FinishBuild(&build))
+            {
+                ReplaceRegisteredProgram(build._oldProgramId, build._newProgramId);
+                ShaderProgramSwap swap;
+                swap._oldProgramId = build._oldProgramId;
+                swap._newProgramId = build._newProgramId;
+                putSwapsHere->push_back(swap);
+            }
+        }
+        _builds.clear();
+        return !putSwapsHere->empty();
+    }
+
+    if (!_hasChangedFiles)
+    {
+        return false;
+    }
+
+    // copy them out so that the watcher thread isn't held up by the shader builds
+    std::map<std::string, std::string> fileContents;
+    std::set<std::string> changedFiles;
+    {
+        std::lock_guard<std::mutex> lock(_fileMutex);
+        fileContents = _fileContents;
+        changedFiles.swap(_changedFiles);
+        _hasChangedFiles = false;
+    }
+    this->StartBuilds(fileContents, changedFiles);
+    return false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The watcher thread.  Reads every watched file, then keeps reading whichever ones change 
+    until the reloader is stopped.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ShaderHotReloader::WatcherThreadLoop()
+{
+    while (_isRunning)
+    {
+        for (size_t fileIndex = 0; fileIndex < _watchedFiles.size(); fileIndex++)
+        {
+            this->ReadFileIfChanged(_watchedFiles[fileIndex]);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(_pollIntervalMs));
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Reads the file if its modification time is different than the last time it was read.  The
+    first read only records the file; it doesn't count as a change.  Only call this from the 
+    watcher thread.
+
+    Note: An editor may still be writing the file when it is read.  The build will fail and 
+    print its log, and the next write changes the modification time again, so the file is read
+    again.
+Parameters:
+    filePath    Self-explanatory.
+Returns:
+    True if the file changed and was read, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ShaderHotReloader::ReadFileIfChanged(const std::string &filePath)
+{
+    struct stat fileStats;
+    if (stat(filePath.c_str(), &fileStats) != 0)
+    {
+        // maybe it is being replaced; try again next time
+        return false;
+    }
+
+    long long modifiedTime = (long long)fileStats.st_mtime;
+    std::map<std::string, long long>::iterator found = _fileModifiedTimes.find(filePath);
+    bool isFirstRead = (found == _fileModifiedTimes.end());
+    if (!isFirstRead && found->second == modifiedTime)
+    {
+        return false;
+    }
+    _fileModifiedTimes[filePath] = modifiedTime;
+
+    std::ifstream shaderFile(filePath.c_str());
+    std::stringstream shaderData;
+    shaderData << shaderFile.rdbuf();
+    shaderFile.close();
+
+    std::lock_guard<std::mutex> lock(_fileMutex);
+    _fileContents[filePath] = shaderData.str();
+    if (!isFirstRead)
+    {
+        LogPrintf("shader hot reload: '%s' changed\n", filePath.c_str());
+        _changedFiles.insert(filePath);
+        _hasChangedFiles = true;
+    }
+    return !isFirstRead;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    dependencies    From ReadShaderSource(...).
+    changedFiles    Self-explanatory.
+Returns:
+    True if any of the dependencies changed, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static bool HasChangedDependency(const std::vector<std::string> &dependencies, 
+    const std::set<std::string> &changedFiles)
+{
+    for (size_t depIndex = 0; depIndex < dependencies.size(); depIndex++)
+    {
+        if (changedFiles.count(dependencies[depIndex]) != 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Starts building every registered program that uses one of the changed files, whether it 
+    is one of the program's own files or one that they include.
+Parameters:
+    fileContents    Every watched file that has been read.
+    changedFiles    The files that changed since the last builds were started.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ShaderHotReloader::StartBuilds(const std::map<std::string, std::string> &fileContents, 
+    const std::set<std::string> &changedFiles)
+{
+    // the loader's copies of the files that changed are replaced, which drops the sources 
+    // that included them, and every other program's source is still where it was, so nothing 
+    // is read from disk here
+    std::set<std::string>::const_iterator changedItr = changedFiles.begin();
+    for (; changedItr != changedFiles.end(); ++changedItr)
+    {
+        std::map<std::string, std::string>::const_iterator changedFile = 
+            fileContents.find(*changedItr);
+        if (changedFile != fileContents.end())
+        {
+            UpdateShaderFile(changedFile->first, changedFile->second);
+        }
+    }
+
+    std::vector<unsigned int> programIds = GetRegisteredProgramIds();
+    for (size_t programIndex = 0; programIndex < programIds.size(); programIndex++)
+    {
+        RegisteredProgramSource source;
+        GetRegisteredProgramSource(programIds[programIndex], &source);
+        if (source._isCompute)
+        {
+            std::vector<std::string> dependencies;
+            std::string computeFile = ReadShaderSource(source._compFilePath, &dependencies);
+            AddDefinedIncludeDependencies(source._shaderDefines, &dependencies);
+            if (!HasChangedDependency(dependencies, changedFiles))
+            {
+                continue;
+            }
+
+            // each variant gets the same defines that it was first built with
+            std::string computeSource = InsertShaderDefines(computeFile, source._shaderDefines);
+            const std::string *sources[2] = { &computeSource, 0 };
+            const unsigned int shaderTypes[2] = { GL_COMPUTE_SHADER, 0 };
+            this->StartBuild(programIds[programIndex], sources, shaderTypes, 1, 
+                source._compFilePath + " (" + source._shaderDefines + ")");
+        }
+        else
+        {
+            std::vector<std::string> vertDependencies;
+            std::vector<std::string> fragDependencies;
+            std::string vertFile = ReadShaderSource(source._vertFilePath, &vertDependencies);
+            std::string fragFile = ReadShaderSource(source._fragFilePath, &fragDependencies);
+            if (!HasChangedDependency(vertDependencies, changedFiles) && 
+                !HasChangedDependency(fragDependencies, changedFiles))
+            {
+                continue;
+            }
+
+            // the defines only go into the vertex shader (see AcquireRenderProgram(...))
+            std::string vertSource = InsertShaderDefines(vertFile, source._shaderDefines);
+            const std::string *sources[2] = { &vertSource, &fragFile };
+            const unsigned int shaderTypes[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+            this->StartBuild(programIds[programIndex], sources, shaderTypes, 2, 
+                source._vertFilePath + " + " + source._fragFilePath);
+        }
+    }
+    _framesSinceBuildStart = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Compiles the shaders and links them into a new program without asking how it went.  The 
+    driver is free to do the work on its own threads until someone asks.
+Parameters:
+    oldProgramId    The program that this one will replace.
+    sources         The source of each shader.
+    shaderTypes     GL_VERTEX_SHADER, etc., one for each source.
+    shaderCount     How many of the sources and types are used.
+    description     For the messages.
+Returns:
+    True if the build was started, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ShaderHotReloader::StartBuild(unsigned int oldProgramId, const std::string *sources[2], 
+    const unsigned int shaderTypes[2], unsigned int shaderCount, 
+    const std::string &description)
+{
+    ProgramBuild build;
+    build._oldProgramId = oldProgramId;
+    build._newProgramId = glCreateProgram();
+    build._shaderCount = shaderCount;
+    build._description = description;
+    if (build._newProgramId == 0)
+    {
+        LogPrintf("shader hot reload: could not create a program for %s\n", description.c_str());
+        return false;
+    }
+
+    for (unsigned int shaderIndex = 0; shaderIndex < shaderCount; shaderIndex++)
+    {
+        GLuint shaderId = glCreateShader(shaderTypes[shaderIndex]);
+        const GLchar *bytes[] = { sources[shaderIndex]->c_str() };
+        const GLint strLengths[] = { (int)sources[shaderIndex]->length() };
+        glShaderSource(shaderId, 1, bytes, strLengths);
+        glCompileShader(shaderId);
+        glAttachShader(build._newProgramId, shaderId);
+        build._shaderIds[shaderIndex] = shaderId;
+    }
+    glLinkProgram(build._newProgramId);
+
+    _builds.push_back(build);
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Checks if a build is done without waiting for it.
+Parameters:
+    build   Self-explanatory.
+Returns:
+    True if asking for the build's status won't wait for the driver, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ShaderHotReloader::IsBuildDone(const ProgramBuild &build) const
+{
+    if (!_hasCompletionStatus)
+    {
+        return _framesSinceBuildStart >= FRAMES_BEFORE_STATUS_QUERY;
+    }
+
+    // the program can't finish linking until its shaders have finished compiling
+    GLint isDone = GL_FALSE;
+    glGetProgramiv(build._newProgramId, COMPLETION_STATUS, &isDone);
+    return isDone == GL_TRUE;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Checks how a finished build went and cleans up its shaders.  The whole log of a shader or 
+    program that failed is printed (see GetShaderInfoLog(...)), and the failed program is 
+    deleted.
+Parameters:
+    build   Must be done (see IsBuildDone(...)).
+Returns:
+    True if the new program is ready to use, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ShaderHotReloader::FinishBuild(ProgramBuild *build)
+{
+    bool isBuilt = true;
+    for (unsigned int shaderIndex = 0; shaderIndex < build->_shaderCount; shaderIndex++)
+    {
+        GLuint shaderId = build->_shaderIds[shaderIndex];
+        GLint isCompiled = 0;
+        glGetShaderiv(shaderId, GL_COMPILE_STATUS, &isCompiled);
+        if (isCompiled == GL_FALSE)
+        {
+            LogPrintf("shader hot reload: %s failed to compile:\n%s\n", 
+                build->_description.c_str(), GetShaderInfoLog(shaderId).c_str());
+            isBuilt = false;
+        }
+        glDetachShader(build->_newProgramId, shaderId);
+        glDeleteShader(shaderId);
+    }
+
+    if (isBuilt)
+    {
+        GLint isLinked = 0;
+        glGetProgramiv(build->_newProgramId, GL_LINK_STATUS, &isLinked);
+        if (isLinked == GL_FALSE)
+        {
+            LogPrintf("shader hot reload: %s failed to link:\n%s\n", 
+                build->_description.c_str(), GetProgramInfoLog(build->_newProgramId).c_str());
+            isBuilt = false;
+        }
+    }
+
+    if (!isBuilt)
+    {
+        LogPrintf("shader hot reload: keeping program %u\n", build->_oldProgramId);
+        DeleteGlProgram(build->_newProgramId);
+        build->_newProgramId = 0;
+        return false;
+    }
+
+    LogPrintf("shader hot reload: %s rebuilt (program %u -> %u)\n", build->_description.c_str(), 
+        build->_oldProgramId, build->_newProgramId);
+    return true;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// a program that was rebuilt from changed shader files
+// Note: The reloader gives the caller one reference to the new program (see 
+// ShaderProgramRegistry.h).  Hand the swap to everything that might hold the old program (see 
+// ParticleManager::ReplaceProgram(...)), and then release the new program.
+struct ShaderProgramSwap
+{
+    unsigned int _oldProgramId;
+    unsigned int _newProgramId;
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Rebuilds the registered programs when their shader files change so that the shaders can be
+    tuned while the demo runs, without restarting and re-initializing everything.
+
+    A background thread checks the shader files' modification times a few times a second and 
+    reads any file that changed, so no file I/O happens on the render thread.  Once per frame, 
+    before anything is drawn, Update(...) takes the new source and starts building every 
+    registered program that uses a changed file (see GetRegisteredProgramIds()).  The build is 
+    only started: shaders are compiled and the program is linked, but nothing that waits for 
+    the result (glGetShaderiv(...), glGetProgramiv(...) with GL_LINK_STATUS) is called until 
+    the driver says that it is done.  Later frames check on it, and when every program in the 
+    batch is done, the ones that built are swapped in at the top of a frame, all at once, and 
+    the ones that failed print their logs and leave the old program running.
+
+    Note: GL_ARB_parallel_shader_compile (and GL_KHR_parallel_shader_compile) adds 
+    GL_COMPLETION_STATUS, which can be asked for without waiting.  Without either extension, 
+    the build is given a few frames before its status is asked for.  Desktop drivers compile 
+    on their own threads, so that's normally long enough, but if it isn't, that one query 
+    waits for the rest of the compile.
+    Also Note: A second thread with a shared context would also keep compiling off of the 
+    render thread, but freeglut has no way to make one, and creating one through 
+    wglCreateContextAttribsARB(...) would tie this "barebones" demo to Windows.
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+class ShaderHotReloader
+{
+public:
+    ShaderHotReloader();
+    ~ShaderHotReloader();
+    void Init(unsigned int pollIntervalMs = 250);
+    void Cleanup();
+
+    bool Update(std::vector<ShaderProgramSwap> *putSwapsHere);
+
+private:
+    // one program that is being built
+    struct ProgramBuild
+    {
+        unsigned int _oldProgramId;
+        unsigned int _newProgramId;
+        unsigned int _shaderIds[2];
+        unsigned int _shaderCount;
+        std::string _description;
+    };
+
+    void WatcherThreadLoop();
+    bool ReadFileIfChanged(const std::string &filePath);
+    void StartBuilds(const std::map<std::string, std::string> &fileContents, 
+        const std::set<std::string> &changedFiles);
+    bool StartBuild(unsigned int oldProgramId, const std::string *sources[2], 
+        const unsigned int shaderTypes[2], unsigned int shaderCount, 
+        const std::string &description);
+    bool IsBuildDone(const ProgramBuild &build) const;
+    bool FinishBuild(ProgramBuild *build);
+
+    // the watcher thread's state
+    // Note: The watched files are set before the thread starts and never change after.  Only 
+    // the watcher thread writes the modification times.  The file contents and the 
+    // changed files are shared with the render thread, so they are behind the mutex, and the
+    // render thread holds it only long enough to copy them out.
+    unsigned int _pollIntervalMs;
+    std::vector<std::string> _watchedFiles;
+    std::map<std::string, long long> _fileModifiedTimes;
+    std::mutex _fileMutex;
+    std::map<std::string, std::string> _fileContents;
+    std::set<std::string> _changedFiles;
+    std::atomic<bool> _hasChangedFiles;
+    std::atomic<bool> _isRunning;
+    std::thread _watcherThread;
+
+    // the render thread's state
+    bool _hasCompletionStatus;
+    unsigned int _framesSinceBuildStart;
+    std::vector<ProgramBuild> _builds;
+};
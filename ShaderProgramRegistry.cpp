@@ -0,0 +1,406 @@
+#include "ShaderProgramRegistry.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
+#include "GenerateShader.h"
+#include "ShaderVariantManifest.h"
+#include "OpenGlErrorHandling.h"
+#include "Log.h"
+
+#include <map>
+#include <stdio.h>
+
+// everything that the registry knows about a program
+struct RegisteredProgram
+{
+    std::string _key;
+    RegisteredProgramSource _source;
+    unsigned int _referenceCount;
+};
+
+// program ID -> registration, and key -> program ID
+// Note: One registry per thread, since OpenGL has a context per thread and program IDs only 
+// mean something in the context that made them (see MultiGpuSimulation.h).
+static thread_local std::map<unsigned int, RegisteredProgram> gRegisteredPrograms;
+static thread_local std::map<std::string, unsigned int> gProgramIdsByKey;
+
+// key -> a compute program that is still building (see PrefetchComputeProgram(...))
+static thread_local std::map<std::string, PendingShaderProgram> gPendingPrograms;
+
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Names a program in frame capture tools after its shaders, and for a compute program, the 
+    pass that it was built for (the "#define ..._PASS" in its defines, if it has one), since 
+    most of them are shaderParticle.comp.
+Parameters:
+    programId   Self-explanatory.
+    source      What the program was built from.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static void LabelRegisteredProgram(unsigned int programId, const RegisteredProgramSource &source)
+{
+#ifdef GL_DEBUG_MARKERS_ENABLED
+    if (!source._isCompute)
+    {
+        std::string label = source._vertFilePath + " + " + source._fragFilePath;
+        LabelGlObject(GL_PROGRAM, programId, label.c_str());
+        return;
+    }
+
+    std::string label = source._compFilePath;
+    size_t passEnd = source._shaderDefines.find("_PASS\n");
+    if (passEnd != std::string::npos)
+    {
+        size_t passStart = source._shaderDefines.rfind(' ', passEnd) + 1;
+        label += " " + source._shaderDefines.substr(passStart, passEnd + 5 - passStart);
+    }
+    LabelGlObject(GL_PROGRAM, programId, label.c_str());
+#else
+    (void)programId;
+    (void)source;
+#endif
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Looks up a program by its key and takes a reference to it if it is already registered.
+Parameters:
+    key     Identifies the program's source (see the Acquire*Program(...) functions).
+Returns:
+    The program's ID, or 0 if no program with that key is registered.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+static unsigned int AcquireExistingProgram(const std::string &key)
+{
+    std::map<std::string, unsigned int>::iterator found = gProgramIdsByKey.find(key);
+    if (found == gProgramIdsByKey.end())
+    {
+        return 0;
+    }
+
+    gRegisteredPrograms[found->second]._referenceCount++;
+    return found->second;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Registers a newly built program with a single reference, and adds it to the shader 
+    variant manifest if one is being recorded (see ShaderVariantManifest.h).  A program that 
+    failed to build (ID 0) is not registered, so that the next acquire tries again.
+Parameters:
+    key         Self-explanatory.
+    source      What the program was built from.
+    programId   Self-explanatory.
+Returns:
+    The program ID.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+static unsigned int RegisterNewProgram(const std::string &key, 
+    const RegisteredProgramSource &source, unsigned int programId)
+{
+    if (programId == 0)
+    {
+        return 0;
+    }
+
+    RegisteredProgram registration;
+    registration._key = key;
+    registration._source = source;
+    registration._referenceCount = 1;
+    gRegisteredPrograms[programId] = registration;
+    gProgramIdsByKey[key] = programId;
+    LabelRegisteredProgram(programId, source);
+    RecordShaderVariant(key);
+    return programId;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gets a reference to the render program made from the given vertex and fragment shaders, 
+    building it the first time (see GenerateVertexShaderProgram(...)).  Each set of vertex 
+    shader defines is its own program.
+Parameters:
+    vertFilePath        Self-explanatory.
+    fragFilePath        Self-explanatory.
+    vertShaderDefines   Self-explanatory.
+Returns:
+    The program's ID, or 0 if it couldn't be built.  Give it to ReleaseProgram(...) when done.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int AcquireRenderProgram(const std::string &vertFilePath, 
+    const std::string &fragFilePath, const std::string &vertShaderDefines)
+{
+    std::string key = "render|" + vertFilePath + "|" + fragFilePath + "|" + vertShaderDefines;
+    unsigned int programId = AcquireExistingProgram(key);
+    if (programId != 0)
+    {
+        return programId;
+    }
+
+    RegisteredProgramSource source;
+    source._isCompute = false;
+    source._vertFilePath = vertFilePath;
+    source._fragFilePath = fragFilePath;
+    source._shaderDefines = vertShaderDefines;
+    return RegisterNewProgram(key, source, 
+        GenerateVertexShaderProgram(vertFilePath, fragFilePath, vertShaderDefines));
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gets a reference to the compute program made from the given file and defines, building it 
+    the first time (see GenerateComputeShaderProgram(...)).  Each combination of file and 
+    defines is its own program.
+Parameters:
+    shaderDefines   Self-explanatory.
+    compFilePath    Self-explanatory.
+Returns:
+    The program's ID, or 0 if it couldn't be built.  Give it to ReleaseProgram(...) when done.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int AcquireComputeProgram(const std::string &shaderDefines, 
+    const std::string &compFilePath)
+{
+    std::string key = "compute|" + compFilePath + "|" + shaderDefines;
+    unsigned int programId = AcquireExistingProgram(key);
+    if (programId != 0)
+    {
+        return programId;
+    }
+
+    RegisteredProgramSource source;
+    source._isCompute = true;
+    source._compFilePath = compFilePath;
+    source._shaderDefines = shaderDefines;
+    std::map<std::string, PendingShaderProgram>::iterator pending = gPendingPrograms.find(key);
+    if (pending != gPendingPrograms.end())
+    {
+        programId = FinishComputeShaderProgram(&pending->second);
+        gPendingPrograms.erase(pending);
+        return RegisterNewProgram(key, source, programId);
+    }
+    return RegisterNewProgram(key, source, 
+        GenerateComputeShaderProgram(shaderDefines, compFilePath));
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Starts building a compute program that will be acquired later (see 
+    BeginComputeShaderProgram(...)), so that the driver can compile it while the caller gets 
+    on with other things.  The acquire waits for whatever is left.  A program that is already
+    registered or already building is left alone.
+Parameters:
+    shaderDefines   Same as for AcquireComputeProgram(...).
+    compFilePath    Same as for AcquireComputeProgram(...).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void PrefetchComputeProgram(const std::string &shaderDefines, const std::string &compFilePath)
+{
+    std::string key = "compute|" + compFilePath + "|" + shaderDefines;
+    if (gProgramIdsByKey.find(key) != gProgramIdsByKey.end() || 
+        gPendingPrograms.find(key) != gPendingPrograms.end())
+    {
+        return;
+    }
+    BeginComputeShaderProgram(shaderDefines, compFilePath, &gPendingPrograms[key]);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes another reference to a program that the caller was given.  Used by ParticleManager 
+    and the renderers so that they don't depend on the caller keeping its own reference.
+Parameters:
+    programId   Must have come from one of the Acquire*Program(...) functions.  0 is ignored.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void AddProgramReference(unsigned int programId)
+{
+    if (programId == 0)
+    {
+        return;
+    }
+
+    std::map<unsigned int, RegisteredProgram>::iterator found = gRegisteredPrograms.find(programId);
+    if (found == gRegisteredPrograms.end())
+    {
+        LogPrintf("program %u is not in the registry; it won't be shared\n", programId);
+        return;
+    }
+    found->second._referenceCount++;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives up a reference to a program.  The program is deleted when the last reference is 
+    released.  If it was replaced (see ReplaceRegisteredProgram(...)), its key already belongs
+    to the new program and is left alone.
+Parameters:
+    programId   Self-explanatory.  0 is ignored.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ReleaseProgram(unsigned int programId)
+{
+    if (programId == 0)
+    {
+        return;
+    }
+
+    std::map<unsigned int, RegisteredProgram>::iterator found = gRegisteredPrograms.find(programId);
+    if (found == gRegisteredPrograms.end())
+    {
+        LogPrintf("released program %u is not in the registry\n", programId);
+        return;
+    }
+
+    found->second._referenceCount--;
+    if (found->second._referenceCount == 0)
+    {
+        DeleteGlProgram(programId);
+        std::map<std::string, unsigned int>::iterator keyed = 
+            gProgramIdsByKey.find(found->second._key);
+        if (keyed != gProgramIdsByKey.end() && keyed->second == programId)
+        {
+            gProgramIdsByKey.erase(keyed);
+        }
+        gRegisteredPrograms.erase(found);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    programId   Self-explanatory.
+Returns:
+    How many references there are to the program, or 0 if it isn't registered.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int GetProgramReferenceCount(unsigned int programId)
+{
+    std::map<unsigned int, RegisteredProgram>::const_iterator found = 
+        gRegisteredPrograms.find(programId);
+    return (found == gRegisteredPrograms.end()) ? 0 : found->second._referenceCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Lists the programs that an acquire would hand out.  Programs that were replaced but are 
+    still held by someone are left out.
+Parameters: None
+Returns:
+    The IDs of the current programs.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+std::vector<unsigned int> GetRegisteredProgramIds()
+{
+    std::vector<unsigned int> programIds;
+    std::map<std::string, unsigned int>::const_iterator itr = gProgramIdsByKey.begin();
+    for (; itr != gProgramIdsByKey.end(); itr++)
+    {
+        programIds.push_back(itr->second);
+    }
+    return programIds;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    programId       Self-explanatory.
+    putSourceHere   Filled in if the program is registered.
+Returns:
+    True if the program is registered, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+bool GetRegisteredProgramSource(unsigned int programId, RegisteredProgramSource *putSourceHere)
+{
+    std::map<unsigned int, RegisteredProgram>::const_iterator found = 
+        gRegisteredPrograms.find(programId);
+    if (found == gRegisteredPrograms.end())
+    {
+        return false;
+    }
+    *putSourceHere = found->second._source;
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Puts a rebuilt program in the place of the program that it was rebuilt from.  The new 
+    program gets the old one's key and source and a single reference, which belongs to the 
+    caller.  The old program loses its key but keeps its references, so everything that holds 
+    it keeps working until it switches over and releases it.
+Parameters:
+    oldProgramId    Must be registered.
+    newProgramId    Must not already be registered.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void ReplaceRegisteredProgram(unsigned int oldProgramId, unsigned int newProgramId)
+{
+    std::map<unsigned int, RegisteredProgram>::iterator found = 
+        gRegisteredPrograms.find(oldProgramId);
+    if (found == gRegisteredPrograms.end() || newProgramId == 0 || 
+        gRegisteredPrograms.find(newProgramId) != gRegisteredPrograms.end())
+    {
+        LogPrintf("can't replace program %u with program %u\n", oldProgramId, newProgramId);
+        return;
+    }
+
+    RegisteredProgram registration;
+    registration._key = found->second._key;
+    registration._source = found->second._source;
+    registration._referenceCount = 1;
+    gRegisteredPrograms[newProgramId] = registration;
+    gProgramIdsByKey[registration._key] = newProgramId;
+    LabelRegisteredProgram(newProgramId, registration._source);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Deletes every program that is still registered.  Call this last, after everything that 
+    holds a reference has been cleaned up.  Any program still registered at that point was 
+    leaked by someone, so it is reported.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+void CleanupShaderProgramRegistry()
+{
+    std::map<unsigned int, RegisteredProgram>::iterator itr = gRegisteredPrograms.begin();
+    for (; itr != gRegisteredPrograms.end(); itr++)
+    {
+        LogPrintf("program %u ('%s') still had %u reference(s) at cleanup\n", itr->first, 
+            itr->second._key.c_str(), itr->second._referenceCount);
+        DeleteGlProgram(itr->first);
+    }
+    gRegisteredPrograms.clear();
+    gProgramIdsByKey.clear();
+
+    // prefetched and never acquired
+    std::map<std::string, PendingShaderProgram>::iterator pending = gPendingPrograms.begin();
+    for (; pending != gPendingPrograms.end(); pending++)
+    {
+        LogPrintf("program '%s' was prefetched but never used\n", pending->first.c_str());
+        DeleteGlProgram(FinishComputeShaderProgram(&pending->second));
+    }
+    gPendingPrograms.clear();
+}
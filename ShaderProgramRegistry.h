@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// what a registered program was built from, so that it can be built again (see 
+// ShaderHotReload.h)
+// Note: A compute program only has the compute file path, and a render program only has the 
+// vertex and fragment file paths.  A render program's defines go into its vertex shader.
+struct RegisteredProgramSource
+{
+    bool _isCompute;
+    std::string _vertFilePath;
+    std::string _fragFilePath;
+    std::string _compFilePath;
+    std::string _shaderDefines;
+};
+
+// shares compiled programs between everything that uses the same shaders
+// Note: Each program is built once per unique set of shader files (and, for compute, "#define" 
+// statements) and then handed out with a reference count.  Whoever acquires or adds a 
+// reference to a program releases it when done, and the program is deleted when the last 
+// reference is released.  ParticleManager and the other renderers take their own reference to 
+// the programs that they are given, so the caller can release its reference right after 
+// initializing them.
+// Also Note: This is a "barebones" program, so the registry is global state, just like the 
+// context.  Each thread has its own, since each thread has its own current context (see 
+// MultiGpuSimulation.h); the display's thread is the only one that most of the program sees.
+unsigned int AcquireRenderProgram(const std::string &vertFilePath = "shaderParticle.vert",
+    const std::string &fragFilePath = "shaderParticle.frag", 
+    const std::string &vertShaderDefines = "");
+unsigned int AcquireComputeProgram(const std::string &shaderDefines = "", 
+    const std::string &compFilePath = "shaderParticle.comp");
+void PrefetchComputeProgram(const std::string &shaderDefines = "", 
+    const std::string &compFilePath = "shaderParticle.comp");
+void AddProgramReference(unsigned int programId);
+void ReleaseProgram(unsigned int programId);
+unsigned int GetProgramReferenceCount(unsigned int programId);
+void CleanupShaderProgramRegistry();
+
+// for rebuilding programs while the demo runs
+// Note: ReplaceRegisteredProgram(...) registers the new program under the old one's source 
+// with a single reference (the caller's), so every later acquire gets the new program.  The 
+// old program stays alive until everything that holds it has released it.
+std::vector<unsigned int> GetRegisteredProgramIds();
+bool GetRegisteredProgramSource(unsigned int programId, RegisteredProgramSource *putSourceHere);
+void ReplaceRegisteredProgram(unsigned int oldProgramId, unsigned int newProgramId);
@@ -0,0 +1,423 @@
+#include "ShaderVariantManifest.h"
+
+#include "ComputeDeviceCaps.h"
+#include "GenerateShader.h"
+#include "ParticleManager.h"
+#include "ShaderProgramRegistry.h"
+
+#include <mutex>
+#include <set>
+#include <stdio.h>
+
+// set by SetShaderVariantManifest(...), with the keys that are already in the file
+// Note: The multi-GPU simulation builds programs on threads of its own (see
+// MultiGpuSimulation.h), so the recording is locked.
+static std::mutex gManifestMutex;
+static std::string gManifestPath;
+static std::set<std::string> gManifestKeys;
+
+// the work group sizes that the built-in variants cover, which are the benchmark's (see
+// SetBenchmarkSweepAxis(...) in Benchmark.h)
+static const unsigned int BUILT_IN_WORK_GROUP_SIZES[] = { 64, 128, 256, 512, 1024 };
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Puts a registry key on one line (see the manifest's description in the header).
+Parameters:
+    registryKey     Self-explanatory.
+Returns:
+    The key with its newlines and backslashes escaped.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static std::string EscapeManifestLine(const std::string &registryKey)
+{
+    std::string line;
+    line.reserve(registryKey.size() + 16);
+    for (size_t charIndex = 0; charIndex < registryKey.size(); charIndex++)
+    {
+        char c = registryKey[charIndex];
+        if (c == '\n')
+        {
+            line += "\\n";
+        }
+        else if (c == '\\')
+        {
+            line += "\\\\";
+        }
+        else
+        {
+            line += c;
+        }
+    }
+    return line;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The reverse of EscapeManifestLine(...).
+Parameters:
+    line    A manifest line without its end of line.
+Returns:
+    The registry key.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static std::string UnescapeManifestLine(const std::string &line)
+{
+    std::string registryKey;
+    registryKey.reserve(line.size());
+    for (size_t charIndex = 0; charIndex < line.size(); charIndex++)
+    {
+        if (line[charIndex] == '\\' && charIndex + 1 < line.size())
+        {
+            charIndex++;
+            registryKey += (line[charIndex] == 'n') ? '\n' : line[charIndex];
+        }
+        else
+        {
+            registryKey += line[charIndex];
+        }
+    }
+    return registryKey;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Splits a registry key, "compute|<file>|<defines>" or "render|<vert>|<frag>|<defines>",
+    into its variant.  The defines are last, so they may have '|' in them.
+Parameters:
+    registryKey     Self-explanatory.
+    putVariantHere  Self-explanatory.
+Returns:
+    False if the key isn't in either form.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static bool ParseRegistryKey(const std::string &registryKey, ShaderVariant *putVariantHere)
+{
+    size_t firstBar = registryKey.find('|');
+    if (firstBar == std::string::npos)
+    {
+        return false;
+    }
+    std::string kind = registryKey.substr(0, firstBar);
+    size_t secondBar = registryKey.find('|', firstBar + 1);
+    if (secondBar == std::string::npos)
+    {
+        return false;
+    }
+
+    *putVariantHere = ShaderVariant();
+    if (kind == "compute")
+    {
+        putVariantHere->_isCompute = true;
+        putVariantHere->_compFilePath =
+            registryKey.substr(firstBar + 1, secondBar - firstBar - 1);
+        putVariantHere->_shaderDefines = registryKey.substr(secondBar + 1);
+        return true;
+    }
+    size_t thirdBar = registryKey.find('|', secondBar + 1);
+    if (kind != "render" || thirdBar == std::string::npos)
+    {
+        return false;
+    }
+    putVariantHere->_isCompute = false;
+    putVariantHere->_vertFilePath = registryKey.substr(firstBar + 1, secondBar - firstBar - 1);
+    putVariantHere->_fragFilePath = registryKey.substr(secondBar + 1, thirdBar - secondBar - 1);
+    putVariantHere->_shaderDefines = registryKey.substr(thirdBar + 1);
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Reads the keys in a manifest.  A missing file has none.
+Parameters:
+    filePath        Self-explanatory.
+    putKeysHere     Self-explanatory.  In the order of the file.
+Returns:
+    False if the file couldn't be opened.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static bool ReadManifestKeys(const std::string &filePath, std::vector<std::string> *putKeysHere)
+{
+    FILE *manifestFile = fopen(filePath.c_str(), "r");
+    if (manifestFile == 0)
+    {
+        return false;
+    }
+
+    // the defines can make a line longer than any fixed buffer, so it is read in pieces
+    std::string line;
+    char piece[1024];
+    while (fgets(piece, sizeof(piece), manifestFile) != 0)
+    {
+        line += piece;
+        if (line.empty() || line[line.size() - 1] != '\n')
+        {
+            continue;
+        }
+        line.erase(line.size() - 1);
+        if (!line.empty() && line[line.size() - 1] == '\r')
+        {
+            line.erase(line.size() - 1);
+        }
+        if (!line.empty() && line.compare(0, 2, "//") != 0)
+        {
+            putKeysHere->push_back(UnescapeManifestLine(line));
+        }
+        line.clear();
+    }
+    if (!line.empty() && line.compare(0, 2, "//") != 0)
+    {
+        putKeysHere->push_back(UnescapeManifestLine(line));
+    }
+    fclose(manifestFile);
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Has every program that the registry builds from now on added to the manifest, unless it
+    is already there.  The file is made if it doesn't exist.
+Parameters:
+    filePath    Self-explanatory.  Empty to stop recording.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void SetShaderVariantManifest(const std::string &filePath)
+{
+    std::vector<std::string> keys;
+    if (!filePath.empty())
+    {
+        ReadManifestKeys(filePath, &keys);
+    }
+
+    std::lock_guard<std::mutex> lock(gManifestMutex);
+    gManifestPath = filePath;
+    gManifestKeys.clear();
+    gManifestKeys.insert(keys.begin(), keys.end());
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Adds a program to the manifest, if there is one and the program isn't in it yet.  Called
+    by the registry for every program that it builds.
+Parameters:
+    registryKey     Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void RecordShaderVariant(const std::string &registryKey)
+{
+    std::lock_guard<std::mutex> lock(gManifestMutex);
+    if (gManifestPath.empty() || !gManifestKeys.insert(registryKey).second)
+    {
+        return;
+    }
+
+    FILE *manifestFile = fopen(gManifestPath.c_str(), "a");
+    if (manifestFile == 0)
+    {
+        return;
+    }
+    fprintf(manifestFile, "%s\n", EscapeManifestLine(registryKey).c_str());
+    fclose(manifestFile);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.  Lines that aren't registry keys are skipped.
+Parameters:
+    filePath        Self-explanatory.
+    putVariantsHere Self-explanatory.  Added to, in the order of the file.
+Returns:
+    False if the file couldn't be opened.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool ReadShaderVariantManifest(const std::string &filePath,
+    std::vector<ShaderVariant> *putVariantsHere)
+{
+    std::vector<std::string> keys;
+    if (!ReadManifestKeys(filePath, &keys))
+    {
+        return false;
+    }
+    for (size_t keyIndex = 0; keyIndex < keys.size(); keyIndex++)
+    {
+        ShaderVariant variant;
+        if (ParseRegistryKey(keys[keyIndex], &variant))
+        {
+            putVariantsHere->push_back(variant);
+        }
+    }
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The variants that don't need a manifest: for every layout, the update with the default
+    kernel at every work group size that the device supports, the sort, and the point and
+    quad render programs.  These are what the benchmark and the work group tuner pick between
+    (see WorkGroupTuner.h), so they are the ones most likely to be needed on a new machine.
+Parameters: None
+Returns:
+    Self-explanatory.  Needs the context, for the supported work group sizes.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+std::vector<ShaderVariant> GetBuiltInShaderVariants()
+{
+    const ParticleLayout layouts[] =
+    {
+        PARTICLE_LAYOUT_INTERLEAVED, PARTICLE_LAYOUT_SOA, PARTICLE_LAYOUT_HALF_FLOAT, 
+        PARTICLE_LAYOUT_FIXED_POINT
+    };
+    unsigned int layoutCount = sizeof(layouts) / sizeof(layouts[0]);
+    unsigned int sizeCount = sizeof(BUILT_IN_WORK_GROUP_SIZES) / sizeof(unsigned int);
+
+    std::vector<ShaderVariant> variants;
+    for (unsigned int layoutIndex = 0; layoutIndex < layoutCount; layoutIndex++)
+    {
+        ParticleLayout layout = layouts[layoutIndex];
+        ShaderVariant variant = ShaderVariant();
+        variant._isCompute = true;
+        variant._compFilePath = "shaderParticle.comp";
+        for (unsigned int sizeIndex = 0; sizeIndex < sizeCount; sizeIndex++)
+        {
+            if (IsComputeWorkGroupSizeSupported(BUILT_IN_WORK_GROUP_SIZES[sizeIndex]))
+            {
+                variant._shaderDefines = ParticleManager::GetComputeShaderDefines(layout,
+                    BUILT_IN_WORK_GROUP_SIZES[sizeIndex]);
+                variants.push_back(variant);
+            }
+        }
+        variant._shaderDefines = ParticleManager::GetSortShaderDefines(layout);
+        variants.push_back(variant);
+
+        variant = ShaderVariant();
+        variant._isCompute = false;
+        variant._vertFilePath = "shaderParticle.vert";
+        variant._fragFilePath = "shaderParticle.frag";
+        variant._shaderDefines = ParticleManager::GetRenderShaderDefines(layout);
+        variants.push_back(variant);
+        variant._fragFilePath = "shaderParticleQuad.frag";
+        variant._shaderDefines = ParticleManager::GetQuadRenderShaderDefines(layout);
+        variants.push_back(variant);
+    }
+
+    // the default point program has no defines
+    ShaderVariant variant = ShaderVariant();
+    variant._isCompute = false;
+    variant._vertFilePath = "shaderParticle.vert";
+    variant._fragFilePath = "shaderParticle.frag";
+    variants.push_back(variant);
+    return variants;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Builds one variant through the registry and lets it go again right away, so that it is
+    deleted and the next acquire builds it again.
+Parameters:
+    variant     Self-explanatory.
+    putIsFromCacheHere  True if the build was a load from the binary cache.
+Returns:
+    False if it couldn't be built.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static bool BuildShaderVariant(const ShaderVariant &variant, bool *putIsFromCacheHere)
+{
+    size_t recordCount = GetShaderBuildRecords().size();
+    unsigned int programId = variant._isCompute ?
+        AcquireComputeProgram(variant._shaderDefines, variant._compFilePath) :
+        AcquireRenderProgram(variant._vertFilePath, variant._fragFilePath,
+        variant._shaderDefines);
+    const std::vector<ShaderBuildRecord> &records = GetShaderBuildRecords();
+    *putIsFromCacheHere = (records.size() > recordCount) && records.back()._isFromCache;
+    ReleaseProgram(programId);
+    return programId != 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Builds every variant in the manifest and every built-in one (see
+    GetBuiltInShaderVariants()), so that the binary cache has all of them, and prints the
+    cache's coverage.  Meant to be run once on the machine that the demo will run on (ex: at
+    install time), with its context current.
+
+    The first pass builds them all, with the compute ones handed to the driver up front so
+    that it can compile them in parallel (see PrefetchComputeProgram(...)), and counts how
+    many were already cached.  The second pass builds them again, and since the first pass
+    deleted them, every one that the cache really holds now is a cache load.  That is the
+    coverage, and anything under 100% is a variant that would compile on the frame path:
+    either it failed to build, or the driver doesn't give out binaries for it.
+Parameters:
+    manifestPath    The manifest (see SetShaderVariantManifest(...)).  Empty for just the
+                    built-in variants.
+Returns:
+    0 if every variant is in the cache, otherwise 1.  Suitable for returning from main(...),
+    so that an installer can tell.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+int PrecompileShaderVariants(const std::string &manifestPath)
+{
+    std::vector<ShaderVariant> variants;
+    if (!manifestPath.empty() && !ReadShaderVariantManifest(manifestPath, &variants))
+    {
+        printf("# couldn't read the shader variant manifest '%s'\n", manifestPath.c_str());
+        return 1;
+    }
+    size_t manifestCount = variants.size();
+    std::vector<ShaderVariant> builtInVariants = GetBuiltInShaderVariants();
+    variants.insert(variants.end(), builtInVariants.begin(), builtInVariants.end());
+    printf("# precompiling %u shader variants (%u from the manifest, %u built in)\n",
+        (unsigned int)variants.size(), (unsigned int)manifestCount,
+        (unsigned int)builtInVariants.size());
+
+    for (size_t variantIndex = 0; variantIndex < variants.size(); variantIndex++)
+    {
+        if (variants[variantIndex]._isCompute)
+        {
+            PrefetchComputeProgram(variants[variantIndex]._shaderDefines,
+                variants[variantIndex]._compFilePath);
+        }
+    }
+
+    unsigned int wasCachedCount = 0;
+    unsigned int failedCount = 0;
+    for (size_t variantIndex = 0; variantIndex < variants.size(); variantIndex++)
+    {
+        bool isFromCache = false;
+        if (!BuildShaderVariant(variants[variantIndex], &isFromCache))
+        {
+            const ShaderVariant &variant = variants[variantIndex];
+            printf("# failed: %s\n", variant._isCompute ? variant._compFilePath.c_str() :
+                (variant._vertFilePath + " + " + variant._fragFilePath).c_str());
+            failedCount++;
+        }
+        wasCachedCount += isFromCache ? 1 : 0;
+    }
+
+    unsigned int cachedCount = 0;
+    for (size_t variantIndex = 0; variantIndex < variants.size(); variantIndex++)
+    {
+        bool isFromCache = false;
+        BuildShaderVariant(variants[variantIndex], &isFromCache);
+        cachedCount += isFromCache ? 1 : 0;
+    }
+
+    unsigned int variantCount = (unsigned int)variants.size();
+    printf("# %u were already cached, %u compiled now, %u failed\n", wasCachedCount,
+        variantCount - wasCachedCount - failedCount, failedCount);
+    printf("# cache coverage: %u of %u (%.1f%%)\n", cachedCount, variantCount,
+        (variantCount > 0) ? (100.0 * cachedCount / variantCount) : 100.0);
+    CleanupShaderProgramRegistry();
+    return (cachedCount == variantCount) ? 0 : 1;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// one program that the manifest lists, in the same terms as the registry's acquires (see
+// ShaderProgramRegistry.h)
+struct ShaderVariant
+{
+    bool _isCompute;
+    std::string _vertFilePath;
+    std::string _fragFilePath;
+    std::string _compFilePath;
+    std::string _shaderDefines;
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Every combination of the feature flags (layouts, work group sizes, integrators,
+    boundaries, and so on) is its own program, and only the ones that have been built on this
+    driver are in the binary cache (see ShaderBinaryCache.h).  The first run that turns on a
+    new combination compiles it, and if that happens after startup (ex: the governor changes
+    the work group size, or a scene file turns on the SDF boundary), it hitches the frame.
+
+    The manifest is a text file of every variant that has been used, one per line.  A run
+    with SetShaderVariantManifest(...) adds each program that the registry builds to it, if
+    it isn't already there.  Nothing in it depends on the GPU or the driver, so it can be
+    collected by running the demo's configurations anywhere (ex: in a test pass) and shipped
+    with the shaders.  Then PrecompileShaderVariants(...), run once on the target machine
+    (ex: by the installer), builds every variant in it, plus the built-in ones that the
+    benchmark's sweep can pick (every layout and supported work group size), so that every
+    one of them is in the cache before the first frame.
+
+    Each line is the registry's key for the program (ex: "compute|shaderParticle.comp|
+    #define ..."), with the defines' newlines and backslashes escaped as "\n" and "\\", so
+    the defines come back byte for byte, which they must, since the binary cache's key is a
+    hash of the source that they are inserted into.  Lines that start with "//" are comments.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void SetShaderVariantManifest(const std::string &filePath);
+void RecordShaderVariant(const std::string &registryKey);
+bool ReadShaderVariantManifest(const std::string &filePath,
+    std::vector<ShaderVariant> *putVariantsHere);
+std::vector<ShaderVariant> GetBuiltInShaderVariants();
+int PrecompileShaderVariants(const std::string &manifestPath);
@@ -0,0 +1,736 @@
+#include "SharedTextureOutput.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GpuMemoryLedger.h"
+#include "Log.h"
+
+#include <string.h>
+
+// the same switch as EglHeadlessWindow's, since there is nothing to export with without EGL
+#if !defined(WIN32) && !defined(EGL_HEADLESS_DISABLED)
+#define SHARED_TEXTURE_HAS_EGL
+#endif
+
+#ifdef WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <d3d11_1.h>
+#include <dxgi1_2.h>
+#pragma comment(lib, "d3d11.lib")
+
+// WGL_NV_DX_interop2, which glload doesn't load unless the WGL extensions are loaded as well
+#ifndef WGL_ACCESS_WRITE_DISCARD_NV
+#define WGL_ACCESS_WRITE_DISCARD_NV 0x0002
+#endif
+typedef HANDLE (WINAPI *DxOpenDeviceNvProc)(void *dxDevice);
+typedef BOOL (WINAPI *DxCloseDeviceNvProc)(HANDLE device);
+typedef HANDLE (WINAPI *DxRegisterObjectNvProc)(HANDLE device, void *dxObject, GLuint name,
+    GLenum type, GLenum access);
+typedef BOOL (WINAPI *DxUnregisterObjectNvProc)(HANDLE device, HANDLE object);
+typedef BOOL (WINAPI *DxLockObjectsNvProc)(HANDLE device, GLint count, HANDLE *objects);
+static DxOpenDeviceNvProc gDxOpenDeviceNv = 0;
+static DxCloseDeviceNvProc gDxCloseDeviceNv = 0;
+static DxRegisterObjectNvProc gDxRegisterObjectNv = 0;
+static DxUnregisterObjectNvProc gDxUnregisterObjectNv = 0;
+static DxLockObjectsNvProc gDxLockObjectsNv = 0;
+static DxLockObjectsNvProc gDxUnlockObjectsNv = 0;
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#endif
+
+#ifdef SHARED_TEXTURE_HAS_EGL
+// Build note: Also need to link libEGL.
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <stdint.h>     // uintptr_t
+static PFNEGLCREATEIMAGEKHRPROC gEglCreateImage = 0;
+static PFNEGLDESTROYIMAGEKHRPROC gEglDestroyImage = 0;
+static PFNEGLEXPORTDMABUFIMAGEQUERYMESAPROC gEglExportDmaBufQuery = 0;
+static PFNEGLEXPORTDMABUFIMAGEMESAPROC gEglExportDmaBuf = 0;
+static PFNEGLCREATESYNCKHRPROC gEglCreateSync = 0;
+static PFNEGLDESTROYSYNCKHRPROC gEglDestroySync = 0;
+static PFNEGLDUPNATIVEFENCEFDANDROIDPROC gEglDupNativeFenceFd = 0;
+#endif
+
+#ifndef MSG_NOSIGNAL
+// a consumer that hangs up must not take the process with it (SIGPIPE)
+#define MSG_NOSIGNAL 0
+#endif
+
+// a few compositors, not an audience
+static const unsigned int SHARED_TEXTURE_MAX_CONSUMERS = 16;
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.  Nothing is shared until Init(...).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+SharedTextureOutput::SharedTextureOutput() :
+    _isActive(false),
+    _width(0),
+    _height(0),
+    _slotCount(0),
+    _nextSlot(0),
+    _publishedCount(0),
+    _skippedCount(0),
+    _dmaBufFourcc(0),
+    _hasNativeFence(false),
+    _listenSocket(-1),
+    _d3dDevice(0),
+    _d3dTexture(0),
+    _keyedMutex(0),
+    _sharedHandle(0),
+    _interopDevice(0),
+    _interopObject(0)
+{
+    for (unsigned int slot = 0; slot < SHARED_TEXTURE_SLOTS; slot++)
+    {
+        _textureIds[slot] = 0;
+        _framebufferIds[slot] = 0;
+        _eglImages[slot] = 0;
+        _dmaBufFds[slot] = -1;
+        _dmaBufStrides[slot] = 0;
+        _dmaBufOffsets[slot] = 0;
+        _dmaBufModifiers[slot] = 0;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+SharedTextureOutput::~SharedTextureOutput()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Checks for the extensions and opens the way for consumers: the Unix socket on Linux, and
+    the D3D11 device and its interop with GL on Windows.  The textures are made by the first
+    PublishFrame(...), at the frame's size.  The GL context must be current.
+
+    Note: On Windows, the D3D11 device is on the default adapter, which must be the GPU that
+    the GL context is on for the interop to open it.
+Parameters:
+    name    What the consumers open (see SharedTextureOutput).  Ex: "particles".
+Returns:
+    False if this platform, context, or driver can't share a texture, which is logged.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool SharedTextureOutput::Init(const std::string &name)
+{
+    this->Cleanup();
+    _name = name;
+
+#if defined(WIN32)
+    gDxOpenDeviceNv = (DxOpenDeviceNvProc)wglGetProcAddress("wglDXOpenDeviceNV");
+    gDxCloseDeviceNv = (DxCloseDeviceNvProc)wglGetProcAddress("wglDXCloseDeviceNV");
+    gDxRegisterObjectNv = (DxRegisterObjectNvProc)wglGetProcAddress("wglDXRegisterObjectNV");
+    gDxUnregisterObjectNv =
+        (DxUnregisterObjectNvProc)wglGetProcAddress("wglDXUnregisterObjectNV");
+    gDxLockObjectsNv = (DxLockObjectsNvProc)wglGetProcAddress("wglDXLockObjectsNV");
+    gDxUnlockObjectsNv = (DxLockObjectsNvProc)wglGetProcAddress("wglDXUnlockObjectsNV");
+    if (gDxOpenDeviceNv == 0 || gDxCloseDeviceNv == 0 || gDxRegisterObjectNv == 0 ||
+        gDxUnregisterObjectNv == 0 || gDxLockObjectsNv == 0 || gDxUnlockObjectsNv == 0)
+    {
+        LogPrintf("shared texture output: the driver doesn't have WGL_NV_DX_interop2\n");
+        return false;
+    }
+
+    ID3D11Device *device = 0;
+    HRESULT result = D3D11CreateDevice(0, D3D_DRIVER_TYPE_HARDWARE, 0, 0, 0, 0,
+        D3D11_SDK_VERSION, &device, 0, 0);
+    if (FAILED(result))
+    {
+        LogPrintf("shared texture output: no D3D11 device (0x%08x)\n", (unsigned int)result);
+        return false;
+    }
+    _d3dDevice = device;
+    _interopDevice = gDxOpenDeviceNv(device);
+    if (_interopDevice == 0)
+    {
+        LogPrintf("shared texture output: GL couldn't open the D3D11 device\n");
+        this->Cleanup();
+        return false;
+    }
+    LogPrintf("shared texture output: sharing the frames as \"Local\\%s\"\n", _name.c_str());
+#elif defined(SHARED_TEXTURE_HAS_EGL)
+    EGLDisplay display = eglGetCurrentDisplay();
+    if (eglGetCurrentContext() == EGL_NO_CONTEXT)
+    {
+        LogPrintf("shared texture output: the context isn't EGL's (see \"--headless\")\n");
+        return false;
+    }
+    const char *extensions = eglQueryString(display, EGL_EXTENSIONS);
+    if (extensions == 0 || strstr(extensions, "EGL_KHR_gl_texture_2D_image") == 0 ||
+        strstr(extensions, "EGL_MESA_image_dma_buf_export") == 0)
+    {
+        LogPrintf("shared texture output: the driver doesn't export textures as DMA-BUFs\n");
+        return false;
+    }
+    gEglCreateImage = (PFNEGLCREATEIMAGEKHRPROC)eglGetProcAddress("eglCreateImageKHR");
+    gEglDestroyImage = (PFNEGLDESTROYIMAGEKHRPROC)eglGetProcAddress("eglDestroyImageKHR");
+    gEglExportDmaBufQuery = (PFNEGLEXPORTDMABUFIMAGEQUERYMESAPROC)eglGetProcAddress(
+        "eglExportDMABUFImageQueryMESA");
+    gEglExportDmaBuf =
+        (PFNEGLEXPORTDMABUFIMAGEMESAPROC)eglGetProcAddress("eglExportDMABUFImageMESA");
+    if (gEglCreateImage == 0 || gEglDestroyImage == 0 || gEglExportDmaBufQuery == 0 ||
+        gEglExportDmaBuf == 0)
+    {
+        LogPrintf("shared texture output: the driver doesn't export textures as DMA-BUFs\n");
+        return false;
+    }
+
+    // without a fence to hand over, the consumer relies on the driver's implicit sync
+    gEglCreateSync = (PFNEGLCREATESYNCKHRPROC)eglGetProcAddress("eglCreateSyncKHR");
+    gEglDestroySync = (PFNEGLDESTROYSYNCKHRPROC)eglGetProcAddress("eglDestroySyncKHR");
+    gEglDupNativeFenceFd = (PFNEGLDUPNATIVEFENCEFDANDROIDPROC)eglGetProcAddress(
+        "eglDupNativeFenceFDANDROID");
+    _hasNativeFence = strstr(extensions, "EGL_ANDROID_native_fence_sync") != 0 &&
+        gEglCreateSync != 0 && gEglDestroySync != 0 && gEglDupNativeFenceFd != 0;
+
+    std::string socketPath = "/tmp/" + _name + ".sock";
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path))
+    {
+        LogPrintf("shared texture output: the name '%s' is too long\n", _name.c_str());
+        return false;
+    }
+    strcpy(address.sun_path, socketPath.c_str());
+
+    // a socket left behind by a run that crashed would make the bind fail
+    unlink(socketPath.c_str());
+    _listenSocket = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (_listenSocket == -1 ||
+        bind(_listenSocket, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(_listenSocket, (int)SHARED_TEXTURE_MAX_CONSUMERS) != 0 ||
+        fcntl(_listenSocket, F_SETFL, fcntl(_listenSocket, F_GETFL, 0) | O_NONBLOCK) != 0)
+    {
+        LogPrintf("shared texture output: couldn't listen on '%s' (%s)\n", socketPath.c_str(),
+            strerror(errno));
+        this->Cleanup();
+        return false;
+    }
+    LogPrintf("shared texture output: sharing the frames on '%s'%s\n", socketPath.c_str(),
+        _hasNativeFence ? "" : " (with implicit sync)");
+#else
+    LogPrintf("shared texture output: this build has neither EGL nor WGL_NV_DX_interop2\n");
+    return false;
+#endif
+
+    _isActive = true;
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Deletes the textures, hangs up on the consumers, and closes the device or the socket.
+    The GL context must be current.  Safe to call more than once.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void SharedTextureOutput::Cleanup()
+{
+    this->DestroySlots();
+
+#ifdef WIN32
+    if (_interopDevice != 0)
+    {
+        gDxCloseDeviceNv(_interopDevice);
+        _interopDevice = 0;
+    }
+    if (_d3dDevice != 0)
+    {
+        ((ID3D11Device *)_d3dDevice)->Release();
+        _d3dDevice = 0;
+    }
+#else
+    for (size_t consumerIndex = 0; consumerIndex < _consumerSockets.size(); consumerIndex++)
+    {
+        close(_consumerSockets[consumerIndex]);
+    }
+    _consumerSockets.clear();
+    if (_listenSocket != -1)
+    {
+        close(_listenSocket);
+        _listenSocket = -1;
+        unlink(("/tmp/" + _name + ".sock").c_str());
+    }
+#endif
+
+    _isActive = false;
+    _nextSlot = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    True from a successful Init(...) until Cleanup().
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool SharedTextureOutput::IsActive() const
+{
+    return _isActive;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Blits the default framebuffer into the next shared texture and hands it to the
+    consumers.  Called once everything for the frame has been drawn, before the swap.  A new
+    size makes new textures, which the consumers pick up from the next message (or, on
+    Windows, by opening the name again).
+Parameters:
+    width   The window's.
+    height  The window's.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void SharedTextureOutput::PublishFrame(int width, int height)
+{
+    if (!_isActive || width <= 0 || height <= 0)
+    {
+        return;
+    }
+
+#ifndef WIN32
+    // nobody to copy the frame for
+    this->AcceptConsumers();
+    if (_consumerSockets.empty())
+    {
+        return;
+    }
+#endif
+
+    if (width != _width || height != _height)
+    {
+        this->DestroySlots();
+        if (!this->CreateSlots(width, height))
+        {
+            LogPrintf("shared texture output: couldn't share a %dx%d texture; stopping\n",
+                width, height);
+            this->Cleanup();
+            return;
+        }
+    }
+
+    unsigned int slot = _nextSlot;
+#ifdef WIN32
+    // key 0 on both sides, so that this waits for nothing if a consumer has the frame
+    IDXGIKeyedMutex *keyedMutex = (IDXGIKeyedMutex *)_keyedMutex;
+    if (keyedMutex->AcquireSync(0, 0) != S_OK)
+    {
+        _skippedCount++;
+        return;
+    }
+    HANDLE interopObject = _interopObject;
+    gDxLockObjectsNv(_interopDevice, 1, &interopObject);
+#endif
+
+    // flipped, so that the first row is the top one, as the consumers expect
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _framebufferIds[slot]);
+    glBlitFramebuffer(0, 0, width, height, 0, height, width, 0, GL_COLOR_BUFFER_BIT,
+        GL_NEAREST);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+#if defined(WIN32)
+    // unlocking flushes the blit and makes D3D's next use of the texture wait for it
+    gDxUnlockObjectsNv(_interopDevice, 1, &interopObject);
+    keyedMutex->ReleaseSync(0);
+#elif defined(SHARED_TEXTURE_HAS_EGL)
+    // the fence has to be flushed to the GPU before it has a file descriptor
+    int fenceFd = -1;
+    if (_hasNativeFence)
+    {
+        EGLDisplay display = eglGetCurrentDisplay();
+        EGLint syncAttribs[] = { EGL_NONE };
+        EGLSyncKHR sync = gEglCreateSync(display, EGL_SYNC_NATIVE_FENCE_ANDROID, syncAttribs);
+        glFlush();
+        if (sync != EGL_NO_SYNC_KHR)
+        {
+            fenceFd = gEglDupNativeFenceFd(display, sync);
+            gEglDestroySync(display, sync);
+        }
+    }
+    else
+    {
+        glFlush();
+    }
+    this->SendFrame(slot, fenceFd);
+    if (fenceFd >= 0)
+    {
+        close(fenceFd);
+    }
+#endif
+
+    _nextSlot = (slot + 1) % _slotCount;
+    _publishedCount++;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How many frames were shared (with at least one consumer, on Linux).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int SharedTextureOutput::GetPublishedCount() const
+{
+    return _publishedCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    How many frames a consumer missed because it had the texture (Windows) or hadn't read
+    the messages before it (Linux).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int SharedTextureOutput::GetSkippedCount() const
+{
+    return _skippedCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Makes the shared textures and a framebuffer for each one to blit into.
+Parameters:
+    width   Self-explanatory.
+    height  Self-explanatory.
+Returns:
+    False if any of it failed, in which case whatever was made is left for DestroySlots().
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool SharedTextureOutput::CreateSlots(int width, int height)
+{
+    _width = width;
+    _height = height;
+    _nextSlot = 0;
+
+#if defined(WIN32)
+    // one texture, which the keyed mutex takes turns on
+    _slotCount = 1;
+    D3D11_TEXTURE2D_DESC description;
+    memset(&description, 0, sizeof(description));
+    description.Width = width;
+    description.Height = height;
+    description.MipLevels = 1;
+    description.ArraySize = 1;
+    description.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    description.SampleDesc.Count = 1;
+    description.Usage = D3D11_USAGE_DEFAULT;
+    description.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+    description.MiscFlags =
+        D3D11_RESOURCE_MISC_SHARED_NTHANDLE | D3D11_RESOURCE_MISC_SHARED_KEYEDMUTEX;
+    ID3D11Texture2D *texture = 0;
+    if (FAILED(((ID3D11Device *)_d3dDevice)->CreateTexture2D(&description, 0, &texture)))
+    {
+        return false;
+    }
+    _d3dTexture = texture;
+
+    // the name is ASCII, so each char widens as it is
+    std::string sharedName = "Local\\" + _name;
+    std::wstring wideSharedName(sharedName.begin(), sharedName.end());
+    IDXGIResource1 *resource = 0;
+    HANDLE sharedHandle = 0;
+    if (FAILED(texture->QueryInterface(__uuidof(IDXGIResource1), (void **)&resource)))
+    {
+        return false;
+    }
+    HRESULT result = resource->CreateSharedHandle(0,
+        DXGI_SHARED_RESOURCE_READ | DXGI_SHARED_RESOURCE_WRITE, wideSharedName.c_str(),
+        &sharedHandle);
+    resource->Release();
+    if (FAILED(result))
+    {
+        return false;
+    }
+    _sharedHandle = sharedHandle;
+    IDXGIKeyedMutex *keyedMutex = 0;
+    if (FAILED(texture->QueryInterface(__uuidof(IDXGIKeyedMutex), (void **)&keyedMutex)))
+    {
+        return false;
+    }
+    _keyedMutex = keyedMutex;
+
+    glGenTextures(1, &_textureIds[0]);
+    _interopObject = gDxRegisterObjectNv(_interopDevice, texture, _textureIds[0],
+        GL_TEXTURE_2D, WGL_ACCESS_WRITE_DISCARD_NV);
+    if (_interopObject == 0)
+    {
+        return false;
+    }
+    RecordGpuAllocation(GPU_MEMORY_TEXTURE, _textureIds[0],
+        GetGlTextureSizeBytes(GL_RGBA8, width, height), "shared texture output");
+
+    // the texture is only GL's while it is locked, and no consumer has it yet
+    HANDLE interopObject = _interopObject;
+    keyedMutex->AcquireSync(0, INFINITE);
+    gDxLockObjectsNv(_interopDevice, 1, &interopObject);
+    glGenFramebuffers(1, &_framebufferIds[0]);
+    glBindFramebuffer(GL_FRAMEBUFFER, _framebufferIds[0]);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+        _textureIds[0], 0);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    gDxUnlockObjectsNv(_interopDevice, 1, &interopObject);
+    keyedMutex->ReleaseSync(0);
+    return status == GL_FRAMEBUFFER_COMPLETE;
+#elif defined(SHARED_TEXTURE_HAS_EGL)
+    _slotCount = SHARED_TEXTURE_SLOTS;
+    EGLDisplay display = eglGetCurrentDisplay();
+    EGLContext context = eglGetCurrentContext();
+    for (unsigned int slot = 0; slot < _slotCount; slot++)
+    {
+        glGenTextures(1, &_textureIds[slot]);
+        glBindTexture(GL_TEXTURE_2D, _textureIds[slot]);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        RecordGpuAllocation(GPU_MEMORY_TEXTURE, _textureIds[slot],
+            GetGlTextureSizeBytes(GL_RGBA8, width, height), "shared texture output");
+
+        glGenFramebuffers(1, &_framebufferIds[slot]);
+        glBindFramebuffer(GL_FRAMEBUFFER, _framebufferIds[slot]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+            _textureIds[slot], 0);
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (status != GL_FRAMEBUFFER_COMPLETE)
+        {
+            return false;
+        }
+
+        // the image keeps the texture's storage, so the DMA-BUF is the texture itself
+        EGLint imageAttribs[] = { EGL_GL_TEXTURE_LEVEL_KHR, 0, EGL_NONE };
+        EGLImageKHR image = gEglCreateImage(display, context, EGL_GL_TEXTURE_2D_KHR,
+            (EGLClientBuffer)(uintptr_t)_textureIds[slot], imageAttribs);
+        if (image == EGL_NO_IMAGE_KHR)
+        {
+            return false;
+        }
+        _eglImages[slot] = image;
+
+        int fourcc = 0;
+        int planeCount = 0;
+        EGLuint64KHR modifier = 0;
+        if (!gEglExportDmaBufQuery(display, image, &fourcc, &planeCount, &modifier) ||
+            planeCount != 1)
+        {
+            return false;
+        }
+        EGLint stride = 0;
+        EGLint offset = 0;
+        if (!gEglExportDmaBuf(display, image, &_dmaBufFds[slot], &stride, &offset))
+        {
+            return false;
+        }
+        _dmaBufFourcc = fourcc;
+        _dmaBufStrides[slot] = stride;
+        _dmaBufOffsets[slot] = offset;
+        _dmaBufModifiers[slot] = modifier;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Deletes the shared textures and whatever was made to share them.  Safe to call more than
+    once.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void SharedTextureOutput::DestroySlots()
+{
+#ifdef WIN32
+    if (_interopObject != 0)
+    {
+        gDxUnregisterObjectNv(_interopDevice, _interopObject);
+        _interopObject = 0;
+    }
+    if (_keyedMutex != 0)
+    {
+        ((IDXGIKeyedMutex *)_keyedMutex)->Release();
+        _keyedMutex = 0;
+    }
+    if (_sharedHandle != 0)
+    {
+        CloseHandle(_sharedHandle);
+        _sharedHandle = 0;
+    }
+    if (_d3dTexture != 0)
+    {
+        ((ID3D11Texture2D *)_d3dTexture)->Release();
+        _d3dTexture = 0;
+    }
+#endif
+
+    for (unsigned int slot = 0; slot < SHARED_TEXTURE_SLOTS; slot++)
+    {
+#ifdef SHARED_TEXTURE_HAS_EGL
+        if (_dmaBufFds[slot] >= 0)
+        {
+            close(_dmaBufFds[slot]);
+            _dmaBufFds[slot] = -1;
+        }
+        if (_eglImages[slot] != 0)
+        {
+            gEglDestroyImage(eglGetCurrentDisplay(), _eglImages[slot]);
+            _eglImages[slot] = 0;
+        }
+#endif
+        if (_framebufferIds[slot] != 0)
+        {
+            glDeleteFramebuffers(1, &_framebufferIds[slot]);
+            _framebufferIds[slot] = 0;
+        }
+        if (_textureIds[slot] != 0)
+        {
+            ForgetGpuAllocation(GPU_MEMORY_TEXTURE, _textureIds[slot]);
+            glDeleteTextures(1, &_textureIds[slot]);
+            _textureIds[slot] = 0;
+        }
+    }
+    _slotCount = 0;
+    _width = 0;
+    _height = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes in the consumers that have connected since the last frame, without waiting for any.
+    Windows' consumers open the texture by name instead, so this does nothing there.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void SharedTextureOutput::AcceptConsumers()
+{
+#ifndef WIN32
+    while (_listenSocket != -1)
+    {
+        int consumerSocket = accept(_listenSocket, 0, 0);
+        if (consumerSocket == -1)
+        {
+            return;
+        }
+        if (_consumerSockets.size() >= SHARED_TEXTURE_MAX_CONSUMERS)
+        {
+            close(consumerSocket);
+            continue;
+        }
+        fcntl(consumerSocket, F_SETFL, fcntl(consumerSocket, F_GETFL, 0) | O_NONBLOCK);
+        _consumerSockets.push_back(consumerSocket);
+        LogPrintf("shared texture output: consumer %u connected\n",
+            (unsigned int)_consumerSockets.size());
+    }
+#endif
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sends a frame's message, with the slot's DMA-BUF and the fence attached, to every
+    consumer.  A consumer whose socket is full misses the frame, and one that hung up is
+    dropped.  Linux only.
+Parameters:
+    slot        Self-explanatory.
+    fenceFd     The frame's sync_file, or -1 for none.  Still the caller's to close.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void SharedTextureOutput::SendFrame(unsigned int slot, int fenceFd)
+{
+#ifndef WIN32
+    SharedTextureFrameMessage message;
+    memset(&message, 0, sizeof(message));
+    message._magic = SHARED_TEXTURE_MAGIC;
+    message._version = SHARED_TEXTURE_VERSION;
+    message._frameIndex = _publishedCount;
+    message._slot = slot;
+    message._width = (unsigned int)_width;
+    message._height = (unsigned int)_height;
+    message._fourcc = (unsigned int)_dmaBufFourcc;
+    message._stride = (unsigned int)_dmaBufStrides[slot];
+    message._offset = (unsigned int)_dmaBufOffsets[slot];
+    message._hasFence = (fenceFd >= 0) ? 1 : 0;
+    message._modifier = _dmaBufModifiers[slot];
+
+    // the kernel gives each consumer its own copies of the descriptors
+    int fds[2] = { _dmaBufFds[slot], fenceFd };
+    unsigned int fdCount = (fenceFd >= 0) ? 2 : 1;
+    struct iovec messageVector;
+    messageVector.iov_base = &message;
+    messageVector.iov_len = sizeof(message);
+    char control[CMSG_SPACE(2 * sizeof(int))];
+    memset(control, 0, sizeof(control));
+    struct msghdr header;
+    memset(&header, 0, sizeof(header));
+    header.msg_iov = &messageVector;
+    header.msg_iovlen = 1;
+    header.msg_control = control;
+    header.msg_controllen = CMSG_SPACE(fdCount * sizeof(int));
+    struct cmsghdr *controlHeader = CMSG_FIRSTHDR(&header);
+    controlHeader->cmsg_level = SOL_SOCKET;
+    controlHeader->cmsg_type = SCM_RIGHTS;
+    controlHeader->cmsg_len = CMSG_LEN(fdCount * sizeof(int));
+    memcpy(CMSG_DATA(controlHeader), fds, fdCount * sizeof(int));
+
+    size_t consumerIndex = 0;
+    while (consumerIndex < _consumerSockets.size())
+    {
+        if (sendmsg(_consumerSockets[consumerIndex], &header, MSG_DONTWAIT | MSG_NOSIGNAL) >= 0)
+        {
+            consumerIndex++;
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            _skippedCount++;
+            consumerIndex++;
+        }
+        else
+        {
+            close(_consumerSockets[consumerIndex]);
+            _consumerSockets.erase(_consumerSockets.begin() + consumerIndex);
+            LogPrintf("shared texture output: a consumer hung up\n");
+        }
+    }
+#endif
+}
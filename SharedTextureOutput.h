@@ -0,0 +1,113 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// what a consumer gets with each frame on Linux (see SharedTextureOutput)
+// Note: Sent on the output's Unix socket with SCM_RIGHTS, with the slot's DMA-BUF as the first
+// file descriptor and, if _hasFence is 1, a sync_file that signals when the GPU has finished
+// the frame as the second.  The rows start at the top, like a window system's buffers.
+static const unsigned int SHARED_TEXTURE_MAGIC = 0x58545348;   // "HSTX"
+static const unsigned int SHARED_TEXTURE_VERSION = 1;
+static const unsigned int SHARED_TEXTURE_SLOTS = 3;
+struct SharedTextureFrameMessage
+{
+    unsigned int _magic;
+    unsigned int _version;
+    unsigned int _frameIndex;
+    unsigned int _slot;
+    unsigned int _width;
+    unsigned int _height;
+    unsigned int _fourcc;               // a DRM_FORMAT_* (ex: DRM_FORMAT_ABGR8888)
+    unsigned int _stride;
+    unsigned int _offset;
+    unsigned int _hasFence;
+    unsigned long long _modifier;       // a DRM_FORMAT_MOD_*
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Hands each finished frame to other processes on the same GPU (ex: OBS, a compositor) as a
+    shared texture, so that they get it without a window grab, a readback, or any copy
+    through the CPU.  The frame is blitted into a texture that the OS lets other processes
+    open, and the consumer samples it in place.
+
+    - Linux: Each of SHARED_TEXTURE_SLOTS textures is exported as a DMA-BUF through an
+      EGLImage (EGL_MESA_image_dma_buf_export), and every frame goes out on a Unix socket
+      ("/tmp/<name>.sock") as a SharedTextureFrameMessage with the slot's DMA-BUF and a
+      sync_file fence (EGL_ANDROID_native_fence_sync) attached.  Without the fence
+      extension, the frame relies on the driver's implicit sync on the DMA-BUF.  The slots go
+      around in turn, so a consumer has 2 more frames to finish with a slot before it is drawn
+      over, the same as ParticleStatePublisher's slots.
+    - Windows: One D3D11 texture, shared by name ("Local\<name>") through an NT handle, is
+      written through WGL_NV_DX_interop2, and the texture's keyed mutex (key 0 on both sides)
+      keeps the frame from being written while a consumer has it.
+
+    Nothing waits on a consumer: a frame that finds the keyed mutex held, or a socket that is
+    full, is skipped for that consumer and counted.  On Linux, with no consumers connected,
+    the blit is skipped too.
+
+    Note: The frame is blitted from the default framebuffer, after everything has been drawn
+    (see FrameCapture), instead of every renderer being pointed at the shared texture.  That
+    is one copy on the GPU, in exchange for leaving the render passes alone.
+    Also Note: On Linux, the context must be EGL's (see EglHeadlessWindow), since a GLX
+    context has nothing to export its textures with, and Init(...) fails without it.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class SharedTextureOutput
+{
+public:
+    SharedTextureOutput();
+    ~SharedTextureOutput();
+    bool Init(const std::string &name);
+    void Cleanup();
+
+    bool IsActive() const;
+    void PublishFrame(int width, int height);
+    unsigned int GetPublishedCount() const;
+    unsigned int GetSkippedCount() const;
+
+private:
+    // no copies; the textures and the socket are only closed once
+    SharedTextureOutput(const SharedTextureOutput &);
+    SharedTextureOutput &operator=(const SharedTextureOutput &);
+
+    bool CreateSlots(int width, int height);
+    void DestroySlots();
+    void AcceptConsumers();
+    void SendFrame(unsigned int slot, int fenceFd);
+
+    std::string _name;
+    bool _isActive;
+    int _width;
+    int _height;
+    unsigned int _slotCount;
+    unsigned int _nextSlot;
+    unsigned int _textureIds[SHARED_TEXTURE_SLOTS];
+    unsigned int _framebufferIds[SHARED_TEXTURE_SLOTS];
+    unsigned int _publishedCount;
+    unsigned int _skippedCount;
+
+    // Linux
+    // Note: EGL's handles are pointers, so these are stored as void * to keep EGL out of the
+    // header.
+    void *_eglImages[SHARED_TEXTURE_SLOTS];
+    int _dmaBufFds[SHARED_TEXTURE_SLOTS];
+    int _dmaBufFourcc;
+    int _dmaBufStrides[SHARED_TEXTURE_SLOTS];
+    int _dmaBufOffsets[SHARED_TEXTURE_SLOTS];
+    unsigned long long _dmaBufModifiers[SHARED_TEXTURE_SLOTS];
+    bool _hasNativeFence;
+    int _listenSocket;
+    std::vector<int> _consumerSockets;
+
+    // Windows
+    // Note: The D3D11 interfaces and the interop's handles are pointers, so these are stored
+    // as void * to keep windows.h and d3d11.h out of the header.
+    void *_d3dDevice;
+    void *_d3dTexture;
+    void *_keyedMutex;
+    void *_sharedHandle;
+    void *_interopDevice;
+    void *_interopObject;
+};
@@ -0,0 +1,183 @@
+#include "SimulationClock.h"
+
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.  Defaults to 120Hz with up to 4 steps per frame.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-9-2016)
+-----------------------------------------------------------------------------------------------*/
+SimulationClock::SimulationClock() :
+    _isFirstFrame(true),
+    _stepSec(1.0f / 120.0f),
+    _maxStepsPerFrame(4),
+    _accumulatorSec(0.0f),
+    _frameSec(0.0f),
+    _droppedSteps(0)
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets the simulation rate and restarts timing.  The first BeginFrame() after this only
+    starts the clock and won't run any steps.
+Parameters:
+    stepSec             The fixed simulation time step.  Ex: 1/120 for 120Hz.
+    maxStepsPerFrame    If a frame needs more steps than this to catch up, the rest of the
+                        accumulated time is dropped.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-9-2016)
+-----------------------------------------------------------------------------------------------*/
+void SimulationClock::Init(float stepSec, unsigned int maxStepsPerFrame)
+{
+    _stepSec = stepSec;
+    _maxStepsPerFrame = maxStepsPerFrame;
+    _accumulatorSec = 0.0f;
+    _frameSec = 0.0f;
+    _droppedSteps = 0;
+    _isFirstFrame = true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Measures the real time since the previous call, adds it to the accumulator, and takes out
+    as many whole steps as there are (up to the maximum).
+Parameters: None
+Returns:
+    The number of fixed steps that the simulation should run this frame.  May be 0 if the
+    frame rate is higher than the simulation rate.
+Exception:  Safe
+Creator:    John Cox (8-9-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int SimulationClock::BeginFrame()
+{
+    Clock::time_point now = Clock::now();
+    if (_isFirstFrame)
+    {
+        _isFirstFrame = false;
+        _lastFrameTime = now;
+        _frameSec = 0.0f;
+        return 0;
+    }
+
+    std::chrono::duration<float> elapsed = now - _lastFrameTime;
+    _lastFrameTime = now;
+    _frameSec = elapsed.count();
+    _accumulatorSec += _frameSec;
+
+    unsigned int numSteps = (unsigned int)(_accumulatorSec / _stepSec);
+    if (numSteps > _maxStepsPerFrame)
+    {
+        // drop the time that can't be caught up on rather than simulating it later
+        _droppedSteps += numSteps - _maxStepsPerFrame;
+        numSteps = _maxStepsPerFrame;
+        _accumulatorSec = 0.0f;
+    }
+    else
+    {
+        _accumulatorSec -= numSteps * _stepSec;
+    }
+
+    return numSteps;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Like BeginFrame(), except that every frame gets the most steps, however little real time 
+    went by.  For running the simulation as fast as the GPU can go instead of in real time.  
+    The real time is still measured for GetFrameSec().
+Parameters: None
+Returns:
+    The maximum steps per frame (see Init(...)).
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int SimulationClock::BeginUnpacedFrame()
+{
+    Clock::time_point now = Clock::now();
+    _frameSec = _isFirstFrame ? 0.0f : std::chrono::duration<float>(now - _lastFrameTime).count();
+    _isFirstFrame = false;
+    _lastFrameTime = now;
+
+    // nothing is left over to extrapolate by
+    _accumulatorSec = 0.0f;
+    return _maxStepsPerFrame;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Changes the simulation rate without restarting timing.  The time that was already 
+    accumulated carries over and is spent in steps of the new length, so the simulation keeps 
+    up with real time through the change; only the number of steps that it takes to do so 
+    changes.
+Parameters:
+    stepSec     Self-explanatory.  Must be greater than 0.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void SimulationClock::SetStepSec(float stepSec)
+{
+    _stepSec = stepSec;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The fixed simulation time step.
+Exception:  Safe
+Creator:    John Cox (8-9-2016)
+-----------------------------------------------------------------------------------------------*/
+float SimulationClock::GetStepSec() const
+{
+    return _stepSec;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The real time between the last two calls to BeginFrame().
+Exception:  Safe
+Creator:    John Cox (8-9-2016)
+-----------------------------------------------------------------------------------------------*/
+float SimulationClock::GetFrameSec() const
+{
+    return _frameSec;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    How far into the next simulation step the current frame is.  The renderer can extrapolate
+    positions by (alpha * step) to smooth out motion when the frame rate and the simulation
+    rate don't line up.
+Parameters: None
+Returns:
+    A value on the range [0,1).
+Exception:  Safe
+Creator:    John Cox (8-9-2016)
+-----------------------------------------------------------------------------------------------*/
+float SimulationClock::GetInterpolationAlpha() const
+{
+    return _accumulatorSec / _stepSec;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The total number of steps that were dropped because frames took too long.
+Exception:  Safe
+Creator:    John Cox (8-9-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int SimulationClock::GetDroppedStepCount() const
+{
+    return _droppedSteps;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <chrono>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Decouples the simulation rate from the frame rate.  Every frame, the real time since the
+    last frame is measured with a high-resolution clock and added to an accumulator, and the
+    accumulator is spent in whole, fixed-length simulation steps.  Whatever is left over (less
+    than one step) carries over to the next frame and is also reported as a fraction of a step
+    so that the renderer can extrapolate particles forward by that much and avoid stutter.
+
+    If the frame took so long that more than the maximum number of steps would be needed, the
+    extra time is thrown away.  The simulation then slows down gracefully instead of spiraling
+    into ever longer frames trying to catch up.
+Creator:    John Cox (8-9-2016)
+-----------------------------------------------------------------------------------------------*/
+class SimulationClock
+{
+public:
+    SimulationClock();
+    void Init(float stepSec, unsigned int maxStepsPerFrame);
+    unsigned int BeginFrame();
+    unsigned int BeginUnpacedFrame();
+    void SetStepSec(float stepSec);
+
+    float GetStepSec() const;
+    float GetFrameSec() const;
+    float GetInterpolationAlpha() const;
+    unsigned int GetDroppedStepCount() const;
+
+private:
+    typedef std::chrono::high_resolution_clock Clock;
+
+    Clock::time_point _lastFrameTime;
+    bool _isFirstFrame;
+    float _stepSec;
+    unsigned int _maxStepsPerFrame;
+    float _accumulatorSec;
+    float _frameSec;
+    unsigned int _droppedSteps;
+};
@@ -0,0 +1,492 @@
+#include "SoakMonitor.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
+#include "GlFenceSync.h"
+#include "GpuMemoryLedger.h"
+#include "Log.h"
+
+#include <stdio.h>
+
+#ifdef WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#endif
+
+const float SoakMonitor::MAX_FRAME_DRIFT = 0.25f;
+const float SoakMonitor::MAX_STALL_RISE = 0.05f;
+
+// the kinds of object that the census counts, in the order of _censusLimits
+static const unsigned int CENSUS_KIND_COUNT = 6;
+static const char *CENSUS_KIND_NAMES[CENSUS_KIND_COUNT] =
+{
+    "buffers", "vertex arrays", "textures", "framebuffers", "queries", "programs"
+};
+
+// the names past the highest live one that the census also asks about
+static const unsigned int CENSUS_MARGIN = 1024;
+
+// what has to not rise steadily: the 6 object counts, then the GPU and host memory
+static const unsigned int GROWTH_METRIC_COUNT = CENSUS_KIND_COUNT + 2;
+static const char *GROWTH_METRIC_NAMES[GROWTH_METRIC_COUNT] =
+{
+    "buffers", "vertex arrays", "textures", "framebuffers", "queries", "programs",
+    "GPU memory (bytes)", "host resident memory (bytes)"
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    kindIndex   An index into CENSUS_KIND_NAMES.
+    name        Self-explanatory.
+Returns:
+    True if the name is a live object of that kind in the current context.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static bool IsLiveGlObject(unsigned int kindIndex, GLuint name)
+{
+    switch (kindIndex)
+    {
+    case 0: return glIsBuffer(name) == GL_TRUE;
+    case 1: return glIsVertexArray(name) == GL_TRUE;
+    case 2: return glIsTexture(name) == GL_TRUE;
+    case 3: return glIsFramebuffer(name) == GL_TRUE;
+    case 4: return glIsQuery(name) == GL_TRUE;
+    case 5: return glIsProgram(name) == GL_TRUE;
+    default: return false;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The process's resident memory, or 0 if the platform won't say.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static unsigned long long GetHostResidentBytes()
+{
+#ifdef WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+        return counters.WorkingSetSize;
+    }
+    return 0;
+#else
+    // the second number is the resident set, in pages
+    unsigned long long totalPages = 0;
+    unsigned long long residentPages = 0;
+    FILE *statmFile = fopen("/proc/self/statm", "r");
+    if (statmFile == 0)
+    {
+        return 0;
+    }
+    int fieldCount = fscanf(statmFile, "%llu %llu", &totalPages, &residentPages);
+    fclose(statmFile);
+    if (fieldCount != 2)
+    {
+        return 0;
+    }
+    return residentPages * (unsigned long long)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    sample          Self-explanatory.
+    metricIndex     An index into GROWTH_METRIC_NAMES.
+Returns:
+    The metric's value in the sample.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static unsigned long long GetGrowthMetric(const SoakSample &sample, unsigned int metricIndex)
+{
+    switch (metricIndex)
+    {
+    case 0: return sample._bufferCount;
+    case 1: return sample._vertexArrayCount;
+    case 2: return sample._textureCount;
+    case 3: return sample._framebufferCount;
+    case 4: return sample._queryCount;
+    case 5: return sample._programCount;
+    case 6: return sample._gpuMemoryBytes;
+    case 7: return sample._hostResidentBytes;
+    default: return 0;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.  Nothing is watched until Start(...).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+SoakMonitor::SoakMonitor() :
+    _isRunning(false),
+    _hasFailed(false),
+    _durationHours(0.0),
+    _sampleIntervalSec(60.0),
+    _frameCount(0),
+    _frameMsSum(0.0),
+    _lastStallCount(0),
+    _frameDriftSampleCount(0),
+    _stallRiseSampleCount(0)
+{
+    for (unsigned int kindIndex = 0; kindIndex < CENSUS_KIND_COUNT; kindIndex++)
+    {
+        _censusLimits[kindIndex] = CENSUS_MARGIN;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Turns on the delete check and starts the clock.  Call with the context current, right
+    before the frame loop.
+Parameters:
+    durationHours       How long the soak runs before EndFrame() says to stop.
+    sampleIntervalSec   How often to sample.  A minute is plenty for a run of hours, and
+                        short enough that GROWTH_SAMPLES of them fail a leak within minutes
+                        of the warmup.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void SoakMonitor::Start(double durationHours, double sampleIntervalSec)
+{
+    _isRunning = true;
+    _hasFailed = false;
+    _durationHours = durationHours;
+    _sampleIntervalSec = (sampleIntervalSec > 0.0) ? sampleIntervalSec : 60.0;
+    _samples.clear();
+    _frameCount = 0;
+    _frameMsSum = 0.0;
+    _frameDriftSampleCount = 0;
+    _stallRiseSampleCount = 0;
+
+    SetGlDeleteCheckEnabled(true);
+    GlFenceStallStats stallStats;
+    GetGlFenceStallStats(&stallStats);
+    _lastStallCount = stallStats._stallCount;
+
+    _startTime = std::chrono::steady_clock::now();
+    _lastSampleTime = _startTime;
+    _lastFrameTime = _startTime;
+    LogPrintf("soak: %.2f hours, a sample every %.0f seconds\n", _durationHours,
+        _sampleIntervalSec);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Times the frame that just ended, and samples and checks for growth if it is time.  Call
+    once per frame, after the frame.
+Parameters: None
+Returns:
+    False once the soak has run for its duration or has failed, in which case the caller
+    should stop.  True otherwise, and if the soak isn't running.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool SoakMonitor::EndFrame()
+{
+    if (!_isRunning)
+    {
+        return true;
+    }
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    _frameMsSum += std::chrono::duration<double, std::milli>(now - _lastFrameTime).count();
+    _lastFrameTime = now;
+    _frameCount++;
+
+    double sinceSampleSec = std::chrono::duration<double>(now - _lastSampleTime).count();
+    if (sinceSampleSec >= _sampleIntervalSec)
+    {
+        SoakSample sample;
+        this->TakeSample(&sample);
+        _samples.push_back(sample);
+        _lastSampleTime = now;
+        LogPrintf("soak %6.2fh: objects %u/%u/%u/%u/%u/%u (buf/vao/tex/fbo/query/prog), "
+            "GPU %.1fMB, host %.1fMB, %.3fms/frame, %.4f stalls/frame\n",
+            sample._elapsedHours, sample._bufferCount, sample._vertexArrayCount,
+            sample._textureCount, sample._framebufferCount, sample._queryCount,
+            sample._programCount, sample._gpuMemoryBytes / (1024.0 * 1024.0),
+            sample._hostResidentBytes / (1024.0 * 1024.0), sample._avgFrameMs,
+            sample._fenceStallsPerFrame);
+        this->CheckSamples();
+    }
+
+    double elapsedHours = std::chrono::duration<double>(now - _startTime).count() / 3600.0;
+    if (_hasFailed || elapsedHours >= _durationHours)
+    {
+        _isRunning = false;
+        return false;
+    }
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Call after the cleanup, with the context still current.  Counts the deletes that the
+    cleanup got wrong, reports whatever is still alive, and logs whether the soak passed.
+Parameters: None
+Returns:
+    True if the soak passed.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool SoakMonitor::Finish()
+{
+    _isRunning = false;
+
+    SoakSample leftovers;
+    this->TakeSample(&leftovers);
+    unsigned int leftoverCounts[CENSUS_KIND_COUNT] =
+    {
+        leftovers._bufferCount, leftovers._vertexArrayCount, leftovers._textureCount,
+        leftovers._framebufferCount, leftovers._queryCount, leftovers._programCount
+    };
+    for (unsigned int kindIndex = 0; kindIndex < CENSUS_KIND_COUNT; kindIndex++)
+    {
+        if (leftoverCounts[kindIndex] > 0)
+        {
+            LogPrintf("soak: %u %s still alive after the cleanup\n", leftoverCounts[kindIndex],
+                CENSUS_KIND_NAMES[kindIndex]);
+        }
+    }
+    if (leftovers._badDeleteCount > 0 && !_hasFailed)
+    {
+        this->Fail("the cleanup deleted objects that weren't alive");
+    }
+    SetGlDeleteCheckEnabled(false);
+
+    if (_hasFailed)
+    {
+        LogErrorPrintf("SOAK FAILED after %.2f hours\n", leftovers._elapsedHours);
+        return false;
+    }
+    LogPrintf("soak passed: %.2f hours, %u samples\n", leftovers._elapsedHours,
+        (unsigned int)_samples.size());
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    True between Start(...) and the EndFrame() that says to stop.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool SoakMonitor::IsRunning() const
+{
+    return _isRunning;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    True if any check has failed since Start(...).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool SoakMonitor::HasFailed() const
+{
+    return _hasFailed;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    Every sample since Start(...), oldest first.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+const std::vector<SoakSample> &SoakMonitor::GetSamples() const
+{
+    return _samples;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Counts the objects and reads the totals, and takes the frame times and the stalls since
+    the last sample.
+Parameters:
+    putSampleHere   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void SoakMonitor::TakeSample(SoakSample *putSampleHere)
+{
+    unsigned int counts[CENSUS_KIND_COUNT];
+    for (unsigned int kindIndex = 0; kindIndex < CENSUS_KIND_COUNT; kindIndex++)
+    {
+        counts[kindIndex] = 0;
+        unsigned int highestLiveName = 0;
+        for (GLuint name = 1; name < _censusLimits[kindIndex]; name++)
+        {
+            if (IsLiveGlObject(kindIndex, name))
+            {
+                counts[kindIndex]++;
+                highestLiveName = name;
+            }
+        }
+        if (highestLiveName + CENSUS_MARGIN > _censusLimits[kindIndex])
+        {
+            _censusLimits[kindIndex] = highestLiveName + CENSUS_MARGIN;
+        }
+    }
+
+    SoakSample &sample = *putSampleHere;
+    sample._elapsedHours = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - _startTime).count() / 3600.0;
+    sample._bufferCount = counts[0];
+    sample._vertexArrayCount = counts[1];
+    sample._textureCount = counts[2];
+    sample._framebufferCount = counts[3];
+    sample._queryCount = counts[4];
+    sample._programCount = counts[5];
+    sample._gpuMemoryBytes = GetGpuMemoryUsed();
+    sample._hostResidentBytes = GetHostResidentBytes();
+    sample._frameCount = _frameCount;
+    sample._avgFrameMs = (_frameCount > 0) ? (float)(_frameMsSum / _frameCount) : 0.0f;
+
+    GlFenceStallStats stallStats;
+    GetGlFenceStallStats(&stallStats);
+    sample._fenceStallsPerFrame = (_frameCount > 0) ?
+        (float)(stallStats._stallCount - _lastStallCount) / _frameCount : 0.0f;
+    _lastStallCount = stallStats._stallCount;
+    sample._badDeleteCount = GetBadGlDeleteCount();
+
+    _frameCount = 0;
+    _frameMsSum = 0.0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Fails the soak if the newest sample shows any of the problems in the class description.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void SoakMonitor::CheckSamples()
+{
+    const SoakSample &newest = _samples.back();
+    if (newest._badDeleteCount > 0)
+    {
+        this->Fail("objects were deleted that weren't alive (see the log for which)");
+        return;
+    }
+    if (_samples.size() <= WARMUP_SAMPLES)
+    {
+        return;
+    }
+
+    char reason[256];
+    for (unsigned int metricIndex = 0; metricIndex < GROWTH_METRIC_COUNT; metricIndex++)
+    {
+        if (this->HasRisenSteadily(metricIndex))
+        {
+            const SoakSample &oldest = _samples[_samples.size() - GROWTH_SAMPLES];
+            snprintf(reason, sizeof(reason), "%s rose at each of the last %u samples "
+                "(%llu -> %llu)", GROWTH_METRIC_NAMES[metricIndex], GROWTH_SAMPLES - 1,
+                GetGrowthMetric(oldest, metricIndex), GetGrowthMetric(newest, metricIndex));
+            this->Fail(reason);
+            return;
+        }
+    }
+
+    // the first sample after the warmup is the baseline
+    const SoakSample &baseline = _samples[WARMUP_SAMPLES];
+    bool isFrameDrifting = newest._avgFrameMs > baseline._avgFrameMs * (1.0f + MAX_FRAME_DRIFT);
+    _frameDriftSampleCount = isFrameDrifting ? _frameDriftSampleCount + 1 : 0;
+    if (_frameDriftSampleCount >= GROWTH_SAMPLES)
+    {
+        snprintf(reason, sizeof(reason), "the frame time has been more than %.0f%% over its "
+            "first %.3fms for %u samples (now %.3fms)", MAX_FRAME_DRIFT * 100.0f,
+            baseline._avgFrameMs, GROWTH_SAMPLES, newest._avgFrameMs);
+        this->Fail(reason);
+        return;
+    }
+
+    bool isStallRising =
+        newest._fenceStallsPerFrame > baseline._fenceStallsPerFrame + MAX_STALL_RISE;
+    _stallRiseSampleCount = isStallRising ? _stallRiseSampleCount + 1 : 0;
+    if (_stallRiseSampleCount >= GROWTH_SAMPLES)
+    {
+        snprintf(reason, sizeof(reason), "the fence stalls have been more than %.2f per frame "
+            "over the first %.4f for %u samples (now %.4f)", MAX_STALL_RISE,
+            baseline._fenceStallsPerFrame, GROWTH_SAMPLES, newest._fenceStallsPerFrame);
+        this->Fail(reason);
+        return;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.  Only the samples after the warmup count.
+Parameters:
+    metricIndex     An index into GROWTH_METRIC_NAMES.
+Returns:
+    True if the metric went up from each of the last GROWTH_SAMPLES samples to the next.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool SoakMonitor::HasRisenSteadily(unsigned int metricIndex) const
+{
+    if (_samples.size() < WARMUP_SAMPLES + GROWTH_SAMPLES)
+    {
+        return false;
+    }
+
+    size_t firstIndex = _samples.size() - GROWTH_SAMPLES;
+    for (size_t sampleIndex = firstIndex + 1; sampleIndex < _samples.size(); sampleIndex++)
+    {
+        if (GetGrowthMetric(_samples[sampleIndex], metricIndex) <=
+            GetGrowthMetric(_samples[sampleIndex - 1], metricIndex))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Fails the soak loudly.  Only the first reason is kept; the soak stops at the next
+    EndFrame().
+Parameters:
+    reason  Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void SoakMonitor::Fail(const char *reason)
+{
+    if (_hasFailed)
+    {
+        return;
+    }
+    _hasFailed = true;
+    LogErrorPrintf("SOAK FAILURE: %s\n", reason);
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <vector>
+#include <chrono>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    One look at the things that a long run must not let grow.  The object counts are of what
+    is alive in the context right now, by kind.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+struct SoakSample
+{
+    double _elapsedHours;
+    unsigned int _bufferCount;
+    unsigned int _vertexArrayCount;
+    unsigned int _textureCount;
+    unsigned int _framebufferCount;
+    unsigned int _queryCount;
+    unsigned int _programCount;
+    unsigned long long _gpuMemoryBytes;     // see GpuMemoryLedger.h
+    unsigned long long _hostResidentBytes;  // 0 if the platform won't say
+    unsigned int _frameCount;               // since the last sample
+    float _avgFrameMs;
+    float _fenceStallsPerFrame;
+    unsigned long long _badDeleteCount;     // see SetGlDeleteCheckEnabled(...)
+};
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Watches a run that goes on for hours ("--soak 8") for the slow problems that a benchmark
+    never runs long enough to see: GL objects and GPU and host memory that only ever go up,
+    frames that get slower, and fence stalls that get more frequent.  Each one is a small
+    cost that adds up over uptime, and none of them shows up in a single frame.
+
+    Every sample interval, it counts the live buffers, vertex arrays, textures, framebuffers,
+    queries, and programs in the context (by asking glIs*(...) about every name up to past the
+    highest one that it has seen), and takes the GPU memory ledger's total, the process's
+    resident memory, the average frame time, and the fence stalls per frame.  It also turns
+    on the delete check (see SetGlDeleteCheckEnabled(...)), so a Cleanup() that deletes
+    something twice is caught when it does.
+
+    The soak fails loudly, with a log line that says what and by how much, if
+        - an object count or a memory total rose at every one of the last GROWTH_SAMPLES
+          samples (a leak on a path that runs all the time, like an Init() that is repeated
+          without a Cleanup() and leaks its VAO every time),
+        - the average frame time stays more than MAX_FRAME_DRIFT over the first sample's for
+          GROWTH_SAMPLES samples in a row,
+        - the fence stalls per frame stay more than MAX_STALL_RISE over the first sample's for
+          GROWTH_SAMPLES samples in a row, or
+        - anything was deleted that wasn't alive.
+    The first WARMUP_SAMPLES samples aren't held against it, since the caches and pools fill
+    up then.  Finish(...) also looks for objects that are still alive after the cleanup,
+    which it reports but doesn't fail on, since some are the driver's own business.
+
+    Note: The census is a few thousand cheap driver calls once a minute, so it doesn't show
+    up in the frame times that it measures.  A leak on a path that only runs once in a
+    while, like a resize, needs something that runs it over and over (ex: "--replay-input"
+    of a session that does) to rise at every sample.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class SoakMonitor
+{
+public:
+    SoakMonitor();
+    void Start(double durationHours, double sampleIntervalSec);
+    bool EndFrame();
+    bool Finish();
+
+    bool IsRunning() const;
+    bool HasFailed() const;
+    const std::vector<SoakSample> &GetSamples() const;
+
+    // see the class description
+    static const unsigned int WARMUP_SAMPLES = 2;
+    static const unsigned int GROWTH_SAMPLES = 6;
+    static const float MAX_FRAME_DRIFT;
+    static const float MAX_STALL_RISE;
+
+private:
+    void TakeSample(SoakSample *putSampleHere);
+    void CheckSamples();
+    bool HasRisenSteadily(unsigned int metricIndex) const;
+    void Fail(const char *reason);
+
+    bool _isRunning;
+    bool _hasFailed;
+    double _durationHours;
+    double _sampleIntervalSec;
+    std::chrono::steady_clock::time_point _startTime;
+    std::chrono::steady_clock::time_point _lastSampleTime;
+    std::chrono::steady_clock::time_point _lastFrameTime;
+
+    // since the last sample
+    unsigned int _frameCount;
+    double _frameMsSum;
+    unsigned long long _lastStallCount;
+
+    // how far up each kind's names go, which the census asks about
+    // Note: Past the highest live name that the last census found, plus some, so that names
+    // that are handed out higher and higher are still found.
+    unsigned int _censusLimits[6];
+
+    std::vector<SoakSample> _samples;
+    unsigned int _frameDriftSampleCount;
+    unsigned int _stallRiseSampleCount;
+};
@@ -0,0 +1,441 @@
+#include "StableFluidSolver.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
+#include "ShaderProgramRegistry.h"
+#include "GpuMemoryLedger.h"
+#include "OpenGlErrorHandling.h"
+#include "Log.h"
+
+// must match the FLUID_STAGE_* defines in shaderStableFluid.comp
+enum StableFluidStage
+{
+    FLUID_STAGE_ADVECT = 0,
+    FLUID_STAGE_CURL,
+    FLUID_STAGE_CONFINE,
+    FLUID_STAGE_DIVERGENCE,
+    FLUID_STAGE_JACOBI,
+    FLUID_STAGE_PROJECT,
+};
+
+// must match WORK_GROUP_SIZE in shaderStableFluid.comp, which is the tile's width and height
+static const int FLUID_WORK_GROUP_SIZE = 8;
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+StableFluidSolver::StableFluidSolver() :
+    _solverProgramId(0),
+    _unifLocFluidStage(0),
+    _unifLocFluidGridSize(0),
+    _unifLocFluidDeltaSec(0),
+    _unifLocFluidCellSize(0),
+    _unifLocFluidMinCorner(0),
+    _unifLocFluidVelocityRetention(0),
+    _unifLocFluidVorticityStrength(0),
+    _unifLocFluidForceCount(0),
+    _unifLocFluidForceCircles(0),
+    _unifLocFluidForceAccelerations(0),
+    _velocityTextureId(0),
+    _advectedTextureId(0),
+    _curlTextureId(0),
+    _divergenceTextureId(0),
+    _pressureIndex(0),
+    _width(0),
+    _height(0),
+    _minCorner(-1.0f, -1.0f),
+    _maxCorner(+1.0f, +1.0f),
+    _jacobiIterations(30),
+    _vorticityStrength(2.0f),
+    _velocityRetention(0.5f),
+    _forceCount(0)
+{
+    _pressureTextureIds[0] = 0;
+    _pressureTextureIds[1] = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+StableFluidSolver::~StableFluidSolver()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Creates the grid's textures, with the fluid at rest, and takes a reference to the solver
+    program (see ShaderProgramRegistry.h).  The caller may release their own reference after
+    this returns.
+Parameters:
+    solverProgramId shaderStableFluid.comp.
+    width           The cells across.  Smoke looks good at far lower resolution than the
+                    particles; 128 over the window is plenty.
+    height          Self-explanatory.
+    minCorner       Where the grid's lower left corner is in window coordinates.  The edges
+                    of the grid are walls.
+    maxCorner       Where the grid's upper right corner is.  Must be greater than minCorner on
+                    both axes.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void StableFluidSolver::Init(unsigned int solverProgramId, int width, int height,
+    const glm::vec2 &minCorner, const glm::vec2 &maxCorner)
+{
+    this->Cleanup();
+    if (solverProgramId == 0)
+    {
+        LogPrintf("the stable fluid solver needs its program\n");
+        return;
+    }
+    if (width <= 1 || height <= 1)
+    {
+        LogPrintf("stable fluid grid must be at least 2x2, not %dx%d\n", width, height);
+        return;
+    }
+    if (maxCorner.x <= minCorner.x || maxCorner.y <= minCorner.y)
+    {
+        LogPrintf("stable fluid bounds are empty: (%f, %f) to (%f, %f)\n",
+            minCorner.x, minCorner.y, maxCorner.x, maxCorner.y);
+        return;
+    }
+
+    _width = width;
+    _height = height;
+    _minCorner = minCorner;
+    _maxCorner = maxCorner;
+
+    // 32-bit floats, since the pressure iterations add up lots of small differences
+    // Note: Only the velocity is ever read through a sampler (by the advection and by the
+    // particles), but they all clamp and filter the same way for simplicity.
+    unsigned int *textureIds[6] = { &_velocityTextureId, &_advectedTextureId, &_curlTextureId,
+        &_divergenceTextureId, &_pressureTextureIds[0], &_pressureTextureIds[1] };
+    GLenum formats[6] = { GL_RG32F, GL_RG32F, GL_R32F, GL_R32F, GL_R32F, GL_R32F };
+    GLenum clearFormats[6] = { GL_RG, GL_RG, GL_RED, GL_RED, GL_RED, GL_RED };
+    float zeros[2] = { 0.0f, 0.0f };
+    for (int textureIndex = 0; textureIndex < 6; textureIndex++)
+    {
+        glGenTextures(1, textureIds[textureIndex]);
+        glBindTexture(GL_TEXTURE_2D, *textureIds[textureIndex]);
+        glTexStorage2D(GL_TEXTURE_2D, 1, formats[textureIndex], width, height);
+        RecordGpuAllocation(GPU_MEMORY_TEXTURE, *textureIds[textureIndex],
+            GetGlTextureSizeBytes(formats[textureIndex], width, height), "stable fluid");
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glClearTexImage(*textureIds[textureIndex], 0, clearFormats[textureIndex], GL_FLOAT,
+            zeros);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    _pressureIndex = 0;
+
+    _solverProgramId = solverProgramId;
+    AddProgramReference(_solverProgramId);
+    this->LoadProgramInterface();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Releases the program and deletes the textures.  A particle manager that was given the
+    velocity texture must be told first (see ParticleManager::ClearFieldTexture()).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void StableFluidSolver::Cleanup()
+{
+    if (_solverProgramId != 0)
+    {
+        ReleaseProgram(_solverProgramId);
+        _solverProgramId = 0;
+    }
+
+    unsigned int *textureIds[6] = { &_velocityTextureId, &_advectedTextureId, &_curlTextureId,
+        &_divergenceTextureId, &_pressureTextureIds[0], &_pressureTextureIds[1] };
+    for (int textureIndex = 0; textureIndex < 6; textureIndex++)
+    {
+        if (*textureIds[textureIndex] != 0)
+        {
+            ForgetGpuAllocation(GPU_MEMORY_TEXTURE, *textureIds[textureIndex]);
+            glDeleteTextures(1, textureIds[textureIndex]);
+            *textureIds[textureIndex] = 0;
+        }
+    }
+    _width = 0;
+    _height = 0;
+    _forceCount = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Switches to a rebuilt program (see ParticleManager::ReplaceProgram(...)).  The fluid
+    carries on from where it was.
+Parameters:
+    oldProgramId    Self-explanatory.  Programs that this solver doesn't use are ignored.
+    newProgramId    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void StableFluidSolver::ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId)
+{
+    if (oldProgramId == 0 || newProgramId == 0 || _solverProgramId != oldProgramId)
+    {
+        return;
+    }
+
+    AddProgramReference(newProgramId);
+    ReleaseProgram(_solverProgramId);
+    _solverProgramId = newProgramId;
+    this->LoadProgramInterface();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sets how the fluid is solved.  Can be changed at any time.
+Parameters:
+    jacobiIterations    How many pressure iterations per step.  The cost is one pass over the
+                        grid each; more leave less divergence behind, which shows as particles
+                        bunching up or spreading out where they shouldn't.  At least 1.
+    vorticityStrength   How hard the small swirls are kept going.  0 turns the confinement
+                        off, and much over 5 makes the flow boil.
+    velocityRetention   The fraction of the fluid's speed that is left after a second with
+                        nothing pushing it.  Between 0 and 1.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void StableFluidSolver::SetSolver(unsigned int jacobiIterations, float vorticityStrength,
+    float velocityRetention)
+{
+    if (jacobiIterations == 0 || vorticityStrength < 0.0f || velocityRetention < 0.0f ||
+        velocityRetention > 1.0f)
+    {
+        LogPrintf("stable fluid settings out of range: %u iterations, %f vorticity, "
+            "%f retention\n", jacobiIterations, vorticityStrength, velocityRetention);
+        return;
+    }
+
+    _jacobiIterations = jacobiIterations;
+    _vorticityStrength = vorticityStrength;
+    _velocityRetention = velocityRetention;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Pushes on the fluid during the next Step(...), in a smooth blob around the position.  The
+    forces only last for one step, so a steady jet needs one every step.  Past MAX_FORCES in
+    one step, the rest are dropped.
+Parameters:
+    position        In window coordinates.
+    acceleration    In window units per second squared at the center, and less out to about
+                    the radius.  It is scaled by the step's length, so it pushes the same
+                    however long the steps are.
+    radius          In window units.  Must be greater than 0.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void StableFluidSolver::AddForce(const glm::vec2 &position, const glm::vec2 &acceleration,
+    float radius)
+{
+    if (_forceCount >= MAX_FORCES || radius <= 0.0f)
+    {
+        return;
+    }
+
+    _forceCircles[(_forceCount * 3) + 0] = position.x;
+    _forceCircles[(_forceCount * 3) + 1] = position.y;
+    _forceCircles[(_forceCount * 3) + 2] = radius;
+    _forceAccelerations[(_forceCount * 2) + 0] = acceleration.x;
+    _forceAccelerations[(_forceCount * 2) + 1] = acceleration.y;
+    _forceCount++;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Moves the fluid on by a step: advection with the forces, vorticity confinement, and
+    the pressure projection.  Call it before the particle update that samples the velocity.
+Parameters:
+    deltaTimeSec    How much simulation time the step is for.  The advection is stable for
+                    any step, but the fluid only looks right if the flow moves no more than
+                    a few cells in one.  0 does nothing.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void StableFluidSolver::Step(float deltaTimeSec)
+{
+    if (_solverProgramId == 0 || deltaTimeSec <= 0.0f)
+    {
+        return;
+    }
+    GlDebugGroup fluidGroup("stable fluid");
+
+    glm::vec2 cellSize = (_maxCorner - _minCorner) / glm::vec2((float)_width, (float)_height);
+    UseGlProgram(_solverProgramId);
+    glUniform2i(_unifLocFluidGridSize, _width, _height);
+    glUniform1f(_unifLocFluidDeltaSec, deltaTimeSec);
+    glUniform2f(_unifLocFluidCellSize, cellSize.x, cellSize.y);
+    glUniform2f(_unifLocFluidMinCorner, _minCorner.x, _minCorner.y);
+    glUniform1f(_unifLocFluidVelocityRetention, _velocityRetention);
+    glUniform1f(_unifLocFluidVorticityStrength, _vorticityStrength);
+    glUniform1i(_unifLocFluidForceCount, _forceCount);
+    if (_forceCount > 0)
+    {
+        glUniform3fv(_unifLocFluidForceCircles, _forceCount, _forceCircles);
+        glUniform2fv(_unifLocFluidForceAccelerations, _forceCount, _forceAccelerations);
+    }
+    _forceCount = 0;
+
+    // the velocity, back-traced through the sampler, into the other velocity texture
+    glActiveTexture(GL_TEXTURE0 + FLUID_VELOCITY_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, _velocityTextureId);
+    glBindImageTexture(FLUID_DESTINATION_VECTOR_IMAGE_UNIT, _advectedTextureId, 0, GL_FALSE, 0,
+        GL_WRITE_ONLY, GL_RG32F);
+    this->DispatchFluidStage(FLUID_STAGE_ADVECT);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // the confinement needs every cell's curl before it can find the peaks, and it writes the
+    // velocity back into the texture that the particles sample
+    glBindImageTexture(FLUID_SOURCE_VECTOR_IMAGE_UNIT, _advectedTextureId, 0, GL_FALSE, 0,
+        GL_READ_ONLY, GL_RG32F);
+    glBindImageTexture(FLUID_DESTINATION_SCALAR_IMAGE_UNIT, _curlTextureId, 0, GL_FALSE, 0,
+        GL_WRITE_ONLY, GL_R32F);
+    this->DispatchFluidStage(FLUID_STAGE_CURL);
+    glBindImageTexture(FLUID_AUX_SCALAR_IMAGE_UNIT, _curlTextureId, 0, GL_FALSE, 0,
+        GL_READ_ONLY, GL_R32F);
+    glBindImageTexture(FLUID_DESTINATION_VECTOR_IMAGE_UNIT, _velocityTextureId, 0, GL_FALSE, 0,
+        GL_WRITE_ONLY, GL_RG32F);
+    this->DispatchFluidStage(FLUID_STAGE_CONFINE);
+
+    glBindImageTexture(FLUID_SOURCE_VECTOR_IMAGE_UNIT, _velocityTextureId, 0, GL_FALSE, 0,
+        GL_READ_ONLY, GL_RG32F);
+    glBindImageTexture(FLUID_DESTINATION_SCALAR_IMAGE_UNIT, _divergenceTextureId, 0, GL_FALSE,
+        0, GL_WRITE_ONLY, GL_R32F);
+    this->DispatchFluidStage(FLUID_STAGE_DIVERGENCE);
+
+    // the pressure from the last step is most of the way to this step's
+    glBindImageTexture(FLUID_AUX_SCALAR_IMAGE_UNIT, _divergenceTextureId, 0, GL_FALSE, 0,
+        GL_READ_ONLY, GL_R32F);
+    for (unsigned int iteration = 0; iteration < _jacobiIterations; iteration++)
+    {
+        glBindImageTexture(FLUID_SOURCE_SCALAR_IMAGE_UNIT, _pressureTextureIds[_pressureIndex],
+            0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+        glBindImageTexture(FLUID_DESTINATION_SCALAR_IMAGE_UNIT,
+            _pressureTextureIds[1 - _pressureIndex], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        this->DispatchFluidStage(FLUID_STAGE_JACOBI);
+        _pressureIndex = 1 - _pressureIndex;
+    }
+
+    glBindImageTexture(FLUID_AUX_SCALAR_IMAGE_UNIT, _pressureTextureIds[_pressureIndex], 0,
+        GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glBindImageTexture(FLUID_DESTINATION_VECTOR_IMAGE_UNIT, _velocityTextureId, 0, GL_FALSE, 0,
+        GL_READ_WRITE, GL_RG32F);
+    this->DispatchFluidStage(FLUID_STAGE_PROJECT);
+    UseGlProgram(0);
+
+    // the update reads it through a sampler
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The fluid's velocity (RG32F, window units per second), for
+    ParticleManager::SetFieldTexture(...) in velocity mode, or 0 before Init(...).  It is the
+    same texture for every step.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int StableFluidSolver::GetVelocityTextureId() const
+{
+    return _velocityTextureId;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    Self-explanatory.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+const glm::vec2 &StableFluidSolver::GetMinCorner() const
+{
+    return _minCorner;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    Self-explanatory.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+const glm::vec2 &StableFluidSolver::GetMaxCorner() const
+{
+    return _maxCorner;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.  Called at initialization and after a hot reload.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void StableFluidSolver::LoadProgramInterface()
+{
+    _unifLocFluidStage = glGetUniformLocation(_solverProgramId, "uFluidStage");
+    _unifLocFluidGridSize = glGetUniformLocation(_solverProgramId, "uFluidGridSize");
+    _unifLocFluidDeltaSec = glGetUniformLocation(_solverProgramId, "uFluidDeltaSec");
+    _unifLocFluidCellSize = glGetUniformLocation(_solverProgramId, "uFluidCellSize");
+    _unifLocFluidMinCorner = glGetUniformLocation(_solverProgramId, "uFluidMinCorner");
+    _unifLocFluidVelocityRetention =
+        glGetUniformLocation(_solverProgramId, "uFluidVelocityRetention");
+    _unifLocFluidVorticityStrength =
+        glGetUniformLocation(_solverProgramId, "uFluidVorticityStrength");
+    _unifLocFluidForceCount = glGetUniformLocation(_solverProgramId, "uFluidForceCount");
+    _unifLocFluidForceCircles =
+        glGetUniformLocation(_solverProgramId, "uFluidForceCircles");
+    _unifLocFluidForceAccelerations =
+        glGetUniformLocation(_solverProgramId, "uFluidForceAccelerations");
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Runs one stage over every cell and puts up a barrier for the next stage, which reads what
+    this one wrote.
+Parameters:
+    stage   One of the FLUID_STAGE_* values.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void StableFluidSolver::DispatchFluidStage(int stage)
+{
+    glUniform1i(_unifLocFluidStage, stage);
+    glDispatchCompute((_width + FLUID_WORK_GROUP_SIZE - 1) / FLUID_WORK_GROUP_SIZE,
+        (_height + FLUID_WORK_GROUP_SIZE - 1) / FLUID_WORK_GROUP_SIZE, 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+}
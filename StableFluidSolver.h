@@ -0,0 +1,98 @@
+#pragma once
+
+#include "glm/vec2.hpp"
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    A low-resolution 2D grid of smoke-like fluid, solved in compute every frame (see
+    shaderStableFluid.comp), whose velocity carries the particles along.  The particle update
+    samples the velocity texture as a field texture in velocity mode (see
+    ParticleManager::SetFieldTexture(...)), so the fluid costs each particle one texture fetch
+    and the grid costs the same however many particles there are.  Millions of tracer
+    particles get swirling motion for the price of a 128x128 grid.
+
+    Each Step(...) is Stam's stable fluids: the velocity is advected by itself (back-traced
+    through a linear sampler), the pushes from AddForce(...) are added, vorticity
+    confinement puts back the small swirls that the advection smooths away, and a pressure
+    projection takes away the divergence.  The pressure is solved with Jacobi iterations,
+    starting from the last step's pressure, which changes slowly enough that a few dozen
+    iterations keep the flow close to divergence-free.
+
+    The velocity is in window units per second, so the particles can take it as it is.
+
+    Note: Unlike the particle passes, this is its own shader file, since it never touches the
+    particles.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class StableFluidSolver
+{
+public:
+    StableFluidSolver();
+    ~StableFluidSolver();
+    void Init(unsigned int solverProgramId, int width, int height, const glm::vec2 &minCorner,
+        const glm::vec2 &maxCorner);
+    void Cleanup();
+    void ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId);
+
+    void SetSolver(unsigned int jacobiIterations, float vorticityStrength,
+        float velocityRetention);
+    void AddForce(const glm::vec2 &position, const glm::vec2 &acceleration, float radius);
+    void Step(float deltaTimeSec);
+
+    unsigned int GetVelocityTextureId() const;
+    const glm::vec2 &GetMinCorner() const;
+    const glm::vec2 &GetMaxCorner() const;
+
+    // must match MAX_FLUID_FORCES in shaderStableFluid.comp
+    static const int MAX_FORCES = 8;
+
+private:
+    void LoadProgramInterface();
+    void DispatchFluidStage(int stage);
+
+    unsigned int _solverProgramId;
+    unsigned int _unifLocFluidStage;
+    unsigned int _unifLocFluidGridSize;
+    unsigned int _unifLocFluidDeltaSec;
+    unsigned int _unifLocFluidCellSize;
+    unsigned int _unifLocFluidMinCorner;
+    unsigned int _unifLocFluidVelocityRetention;
+    unsigned int _unifLocFluidVorticityStrength;
+    unsigned int _unifLocFluidForceCount;
+    unsigned int _unifLocFluidForceCircles;
+    unsigned int _unifLocFluidForceAccelerations;
+
+    // Note: The units must match shaderStableFluid.comp.  The texture unit comes after the
+    // emission image's (see ParticleEmissionImage.h).  The image units are the same as the
+    // SDF boundary's and the bloom's, which bind their own before every pass, like this does.
+    static const unsigned int FLUID_VELOCITY_TEXTURE_UNIT = 4;
+    static const unsigned int FLUID_SOURCE_VECTOR_IMAGE_UNIT = 2;
+    static const unsigned int FLUID_SOURCE_SCALAR_IMAGE_UNIT = 3;
+    static const unsigned int FLUID_AUX_SCALAR_IMAGE_UNIT = 4;
+    static const unsigned int FLUID_DESTINATION_VECTOR_IMAGE_UNIT = 5;
+    static const unsigned int FLUID_DESTINATION_SCALAR_IMAGE_UNIT = 6;
+
+    // the velocity that the particles sample is always in _velocityTextureId after a step; the
+    // advection writes the other one and the confinement writes it back
+    // Note: The pressure ping-pongs between 2 textures, and _pressureIndex is the one that has
+    // the last step's, which starts the next step's iterations.
+    unsigned int _velocityTextureId;
+    unsigned int _advectedTextureId;
+    unsigned int _curlTextureId;
+    unsigned int _divergenceTextureId;
+    unsigned int _pressureTextureIds[2];
+    int _pressureIndex;
+    int _width;
+    int _height;
+    glm::vec2 _minCorner;
+    glm::vec2 _maxCorner;
+
+    unsigned int _jacobiIterations;
+    float _vorticityStrength;
+    float _velocityRetention;
+
+    // cleared by every Step(...)
+    int _forceCount;
+    float _forceCircles[MAX_FORCES * 3];
+    float _forceAccelerations[MAX_FORCES * 2];
+};
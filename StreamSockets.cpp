@@ -0,0 +1,229 @@
+#include "StreamSockets.h"
+
+#include <chrono>
+#include <string.h>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Windows needs its socket library started before the first socket, and as many cleanups
+    as there were starts.  Nothing to do elsewhere.
+Parameters: None
+Returns:
+    False if the socket library wouldn't start, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool StartStreamSockets()
+{
+#ifdef WIN32
+    WSADATA wsaData;
+    return WSAStartup(MAKEWORD(2, 2), &wsaData) == 0;
+#else
+    return true;
+#endif
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Undoes one StartStreamSockets().
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void StopStreamSockets()
+{
+#ifdef WIN32
+    WSACleanup();
+#endif
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    socketId    As stored by the classes (see StreamSockets.h).  -1 is ignored.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void CloseStreamSocket(long long socketId)
+{
+    if (socketId == -1)
+    {
+        return;
+    }
+#ifdef WIN32
+    closesocket((StreamSocket)socketId);
+#else
+    close((StreamSocket)socketId);
+#endif
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Makes sends and accepts return right away instead of waiting on the network.
+Parameters:
+    socketId    Self-explanatory.
+Returns:
+    False if it couldn't, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool SetStreamSocketNonBlocking(long long socketId)
+{
+#ifdef WIN32
+    u_long isNonBlocking = 1;
+    return ioctlsocket((StreamSocket)socketId, FIONBIO, &isNonBlocking) == 0;
+#else
+    int flags = fcntl((StreamSocket)socketId, F_GETFL, 0);
+    return flags != -1 && fcntl((StreamSocket)socketId, F_SETFL, flags | O_NONBLOCK) != -1;
+#endif
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Sends small writes right away instead of waiting to fill packets, since everything that
+    the streams send is a whole frame or batch at a time.
+Parameters:
+    socketId    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void SetStreamSocketNoDelay(long long socketId)
+{
+    int isNoDelay = 1;
+    setsockopt((StreamSocket)socketId, IPPROTO_TCP, TCP_NODELAY, (const char *)&isNoDelay,
+        sizeof(isNoDelay));
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    True if the last failed socket call on this thread only failed because a non-blocking
+    socket wasn't ready, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool IsStreamSocketWouldBlock()
+{
+#ifdef WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Makes a non-blocking socket that listens for connections on every interface.
+Parameters:
+    port        Self-explanatory.
+    backlog     How many connections can wait to be accepted.
+Returns:
+    The socket, or -1 if the port couldn't be listened on.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+long long ListenOnStreamPort(unsigned short port, unsigned int backlog)
+{
+    StreamSocket listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    long long listenSocketId = (long long)listenSocket;
+    if (listenSocketId == -1)
+    {
+        return -1;
+    }
+
+    // so that a restart doesn't have to wait out the last run's connections
+    int isReused = 1;
+    setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, (const char *)&isReused,
+        sizeof(isReused));
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(listenSocket, (const sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(listenSocket, (int)backlog) != 0 ||
+        !SetStreamSocketNonBlocking(listenSocketId))
+    {
+        CloseStreamSocket(listenSocketId);
+        return -1;
+    }
+    return listenSocketId;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Connects to a listening socket, and waits for the connection.  The socket is left
+    blocking.
+Parameters:
+    hostAndPort     Ex: "192.168.1.20:7400".
+Returns:
+    The socket, or -1 if the address isn't host:port, the host couldn't be found, or nothing
+    there would take the connection.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+long long ConnectStreamSocket(const std::string &hostAndPort)
+{
+    size_t colonIndex = hostAndPort.rfind(':');
+    if (colonIndex == std::string::npos || colonIndex == 0)
+    {
+        return -1;
+    }
+    std::string host = hostAndPort.substr(0, colonIndex);
+    std::string port = hostAndPort.substr(colonIndex + 1);
+
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    addrinfo *addresses = 0;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0)
+    {
+        return -1;
+    }
+    long long connectedSocketId = -1;
+    for (addrinfo *address = addresses; address != 0 && connectedSocketId == -1;
+        address = address->ai_next)
+    {
+        StreamSocket connectSocket = socket(address->ai_family, address->ai_socktype,
+            address->ai_protocol);
+        long long connectSocketId = (long long)connectSocket;
+        if (connectSocketId == -1)
+        {
+            continue;
+        }
+        if (connect(connectSocket, address->ai_addr, (int)address->ai_addrlen) == 0)
+        {
+            connectedSocketId = connectSocketId;
+        }
+        else
+        {
+            CloseStreamSocket(connectSocketId);
+        }
+    }
+    freeaddrinfo(addresses);
+    return connectedSocketId;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    Seconds since some fixed point, for the frame rate cap.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+double GetStreamTimeSec()
+{
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
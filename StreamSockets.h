@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+
+// the little bit of BSD sockets and Winsock that the TCP streams need, for the .cpp files that
+// talk to the network (see ParticleStream.h and ParticleDomainShard.h)
+// Note: A socket is a pointer-sized integer on Windows and an int elsewhere, so the classes
+// store them as long long, with -1 for none, to keep these headers out of their own headers.
+#ifdef WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef SOCKET StreamSocket;
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+typedef int StreamSocket;
+#endif
+
+#ifndef MSG_NOSIGNAL
+// a peer that hangs up must not take the process with it (SIGPIPE), and where there is no
+// such flag, there is no such signal either
+#define MSG_NOSIGNAL 0
+#endif
+
+bool StartStreamSockets();
+void StopStreamSockets();
+void CloseStreamSocket(long long socketId);
+bool SetStreamSocketNonBlocking(long long socketId);
+void SetStreamSocketNoDelay(long long socketId);
+bool IsStreamSocketWouldBlock();
+long long ListenOnStreamPort(unsigned short port, unsigned int backlog);
+long long ConnectStreamSocket(const std::string &hostAndPort);
+double GetStreamTimeSec();
@@ -0,0 +1,180 @@
+#include "TextureCompression.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "Log.h"
+
+#include <math.h>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Encodes one channel of one 4x4 block as a signed BC4 block: the largest and smallest
+    values as the endpoints, which puts the block in the mode with 6 steps between them, and
+    the nearest of the 8 values for each texel.
+Parameters:
+    values          The 16 texels of the block, row by row, already divided by the scale.
+    putBlockHere    8 bytes.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static void EncodeSignedBc4Block(const float *values, unsigned char *putBlockHere)
+{
+    float minValue = values[0];
+    float maxValue = values[0];
+    for (int texelIndex = 1; texelIndex < 16; texelIndex++)
+    {
+        minValue = (values[texelIndex] < minValue) ? values[texelIndex] : minValue;
+        maxValue = (values[texelIndex] > maxValue) ? values[texelIndex] : maxValue;
+    }
+
+    // rounded outward so that the endpoints cover the block; -128 is also -1, so it isn't used
+    int red0 = (int)ceilf(maxValue * 127.0f);
+    int red1 = (int)floorf(minValue * 127.0f);
+    red0 = (red0 > 127) ? 127 : ((red0 < -127) ? -127 : red0);
+    red1 = (red1 > 127) ? 127 : ((red1 < -127) ? -127 : red1);
+
+    // red0 > red1 is the mode with 6 steps in between; with them equal, the block is flat and
+    // every index is 0
+    float palette[8];
+    palette[0] = red0 / 127.0f;
+    palette[1] = red1 / 127.0f;
+    for (int step = 2; step < 8; step++)
+    {
+        palette[step] = (((8 - step) * red0) + ((step - 1) * red1)) / (7.0f * 127.0f);
+    }
+
+    unsigned long long bits = (unsigned long long)(unsigned char)(signed char)red0 |
+        ((unsigned long long)(unsigned char)(signed char)red1 << 8);
+    if (red0 > red1)
+    {
+        for (int texelIndex = 0; texelIndex < 16; texelIndex++)
+        {
+            unsigned long long nearestIndex = 0;
+            float nearestDistance = fabsf(values[texelIndex] - palette[0]);
+            for (int paletteIndex = 1; paletteIndex < 8; paletteIndex++)
+            {
+                float distance = fabsf(values[texelIndex] - palette[paletteIndex]);
+                if (distance < nearestDistance)
+                {
+                    nearestDistance = distance;
+                    nearestIndex = paletteIndex;
+                }
+            }
+            bits |= nearestIndex << (16 + (3 * texelIndex));
+        }
+    }
+
+    for (int byteIndex = 0; byteIndex < 8; byteIndex++)
+    {
+        putBlockHere[byteIndex] = (unsigned char)(bits >> (8 * byteIndex));
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Encodes a texture as signed RGTC blocks, in the order that
+    glCompressedTexSubImage2D(...) takes them: blocks row by row from the first row of
+    texels, and for BC5, each block's red half before its green half.  The blocks that hang
+    over the right or top edge repeat the edge texels.
+Parameters:
+    texels          Row by row, X first, with the channels of each texel together.  Must
+                    be width * height * channelCount values.
+    width           Self-explanatory.
+    height          Self-explanatory.
+    channelCount    1 (BC4) or 2 (BC5).
+    scale           The texels are divided by this, and anything past +/-1 after that is
+                    clamped.
+    putBlocksHere   Replaced.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void EncodeSignedRgtcBlocks(const float *texels, int width, int height, int channelCount,
+    float scale, std::vector<unsigned char> *putBlocksHere)
+{
+    int blocksX = (width + 3) / 4;
+    int blocksY = (height + 3) / 4;
+    putBlocksHere->resize((size_t)blocksX * blocksY * channelCount * 8);
+    float inverseScale = 1.0f / scale;
+
+    unsigned char *block = putBlocksHere->data();
+    float values[16];
+    for (int blockY = 0; blockY < blocksY; blockY++)
+    {
+        for (int blockX = 0; blockX < blocksX; blockX++)
+        {
+            for (int channel = 0; channel < channelCount; channel++)
+            {
+                for (int texelIndex = 0; texelIndex < 16; texelIndex++)
+                {
+                    int x = (blockX * 4) + (texelIndex % 4);
+                    int y = (blockY * 4) + (texelIndex / 4);
+                    x = (x < width) ? x : (width - 1);
+                    y = (y < height) ? y : (height - 1);
+                    float value = texels[(((y * width) + x) * channelCount) + channel] *
+                        inverseScale;
+                    values[texelIndex] = (value > 1.0f) ? 1.0f :
+                        ((value < -1.0f) ? -1.0f : value);
+                }
+                EncodeSignedBc4Block(values, block);
+                block += 8;
+            }
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Compresses a texture on the CPU and makes a filtered RGTC texture from it, clamped at
+    the edges like the textures that it stands in for.  The scale is the largest magnitude
+    among the texels, so the full range of the format is used.
+Parameters:
+    texels          See EncodeSignedRgtcBlocks(...).
+    width           Self-explanatory.
+    height          Self-explanatory.
+    channelCount    1 (GL_COMPRESSED_SIGNED_RED_RGTC1) or 2 (GL_COMPRESSED_SIGNED_RG_RGTC2).
+    putScaleHere    What the sampled values must be multiplied by.
+Returns:
+    The new texture, which the caller owns, or 0 if the channel count isn't 1 or 2.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int CreateSignedRgtcTexture(const float *texels, int width, int height,
+    int channelCount, float *putScaleHere)
+{
+    if (channelCount != 1 && channelCount != 2)
+    {
+        LogPrintf("RGTC only has 1 and 2 channel formats, not %d\n", channelCount);
+        return 0;
+    }
+
+    // an all-0 texture is still a texture, just with any scale
+    float scale = 0.0f;
+    size_t valueCount = (size_t)width * height * channelCount;
+    for (size_t valueIndex = 0; valueIndex < valueCount; valueIndex++)
+    {
+        float magnitude = fabsf(texels[valueIndex]);
+        scale = (magnitude > scale) ? magnitude : scale;
+    }
+    scale = (scale > 0.0f) ? scale : 1.0f;
+
+    std::vector<unsigned char> blocks;
+    EncodeSignedRgtcBlocks(texels, width, height, channelCount, scale, &blocks);
+
+    GLenum format = (channelCount == 1) ?
+        GL_COMPRESSED_SIGNED_RED_RGTC1 : GL_COMPRESSED_SIGNED_RG_RGTC2;
+    GLuint textureId = 0;
+    glGenTextures(1, &textureId);
+    glBindTexture(GL_TEXTURE_2D, textureId);
+    glTexStorage2D(GL_TEXTURE_2D, 1, format, width, height);
+    glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format,
+        (GLsizei)blocks.size(), blocks.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    *putScaleHere = scale;
+    return textureId;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <vector>
+
+// block-compressed copies of the static textures that the update samples per particle (see
+// TextureCompression.cpp)
+// Note: RGTC (BC4 for 1 channel, BC5 for 2) keeps each 4x4 block as 2 endpoints and a 3-bit
+// index per texel, so a fetch is 8 bytes a block for BC4 and 16 for BC5, against 32 and 64
+// for the same blocks of R16F and RG16F, and a cache line holds 4 times as many texels.
+// The formats are signed and normalized, so the texels are divided by the largest magnitude
+// among them on the way in, and the sampler's results must be multiplied by it again.
+// Also Note: Each block's values are spread over 8 steps between its own smallest and
+// largest, so a smooth field loses little, but a block with both a spike and a plateau in
+// it loses the plateau's detail.  The compression is a CPU pass at load time, not for
+// textures that change every frame.
+void EncodeSignedRgtcBlocks(const float *texels, int width, int height, int channelCount,
+    float scale, std::vector<unsigned char> *putBlocksHere);
+unsigned int CreateSignedRgtcTexture(const float *texels, int width, int height,
+    int channelCount, float *putScaleHere);
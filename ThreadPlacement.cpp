@@ -0,0 +1,404 @@
+#include "ThreadPlacement.h"
+
+#include "Log.h"
+
+#include <atomic>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// what SetThreadPlacement(...) was given, with the GPU's node already looked up
+// Note: Only written before the workers start, so it isn't locked (see ThreadPlacement.h).
+static ThreadPlacementSettings gThreadPlacement = { -1, THREAD_PRIORITY_LEVEL_DEFAULT, -1 };
+
+// every worker places itself, so a refusal is only logged by the first one
+static std::atomic<bool> gIsWorkerFailureLogged(false);
+
+#ifdef __linux__
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Reads one of the kernel's CPU lists (ex: "0-7,16-23") into a set.
+Parameters:
+    filePath        Ex: /sys/devices/system/node/node1/cpulist
+    putCpusHere     Cleared first.
+Returns:
+    False if the file couldn't be read or had no CPUs in it, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static bool ReadCpuList(const std::string &filePath, cpu_set_t *putCpusHere)
+{
+    CPU_ZERO(putCpusHere);
+    FILE *listFile = fopen(filePath.c_str(), "r");
+    if (listFile == 0)
+    {
+        return false;
+    }
+    char line[1024] = { 0 };
+    bool isRead = (fgets(line, sizeof(line), listFile) != 0);
+    fclose(listFile);
+    if (!isRead)
+    {
+        return false;
+    }
+
+    // each entry is a CPU or a range, separated by commas
+    int cpuCount = 0;
+    const char *cursor = line;
+    while (*cursor >= '0' && *cursor <= '9')
+    {
+        char *end = 0;
+        long first = strtol(cursor, &end, 10);
+        long last = first;
+        if (*end == '-')
+        {
+            last = strtol(end + 1, &end, 10);
+        }
+        for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+        {
+            CPU_SET((int)cpu, putCpusHere);
+            cpuCount++;
+        }
+        cursor = (*end == ',') ? (end + 1) : end;
+    }
+    return cpuCount > 0;
+}
+#endif
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Keeps the calling thread on one logical processor.
+Parameters:
+    core    Self-explanatory.
+Returns:
+    False if the OS refused (ex: there is no such processor), otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static bool PinCurrentThread(int core)
+{
+#ifdef WIN32
+    // Note: Windows splits more than 64 processors into groups of up to 64.
+    GROUP_AFFINITY affinity;
+    ZeroMemory(&affinity, sizeof(affinity));
+    affinity.Group = (WORD)(core / 64);
+    affinity.Mask = (KAFFINITY)1 << (core % 64);
+    return SetThreadGroupAffinity(GetCurrentThread(), &affinity, 0) != 0;
+#elif defined(__linux__)
+    if (core >= CPU_SETSIZE)
+    {
+        return false;
+    }
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(core, &cpus);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+#else
+    (void)core;
+    return false;
+#endif
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Keeps the calling thread on the processors of one NUMA node.
+Parameters:
+    node    Self-explanatory.
+Returns:
+    False if the OS doesn't know the node or refused, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static bool MoveCurrentThreadToNumaNode(int node)
+{
+#ifdef WIN32
+    GROUP_AFFINITY affinity;
+    ZeroMemory(&affinity, sizeof(affinity));
+    if (!GetNumaNodeProcessorMaskEx((USHORT)node, &affinity) || affinity.Mask == 0)
+    {
+        return false;
+    }
+    return SetThreadGroupAffinity(GetCurrentThread(), &affinity, 0) != 0;
+#elif defined(__linux__)
+    cpu_set_t cpus;
+    char filePath[64];
+    snprintf(filePath, sizeof(filePath), "/sys/devices/system/node/node%d/cpulist", node);
+    if (!ReadCpuList(filePath, &cpus))
+    {
+        return false;
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+#else
+    (void)node;
+    return false;
+#endif
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Raises the calling thread's priority above the rest of the process's (and, for realtime,
+    above every ordinary thread on the machine).
+Parameters:
+    level   Self-explanatory.
+Returns:
+    The level that the thread got, which is lower than the one asked for if the OS refused.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static ThreadPriorityLevel RaiseCurrentThreadPriority(ThreadPriorityLevel level)
+{
+#ifdef WIN32
+    if (level == THREAD_PRIORITY_LEVEL_REALTIME)
+    {
+        // the multimedia class scheduler lives in avrt.dll, which is loaded here instead of
+        // linked so that the build doesn't need another library
+        typedef HANDLE(WINAPI *SetMmThreadCharacteristicsFunction)(LPCWSTR, LPDWORD);
+        HMODULE avrtModule = LoadLibraryA("avrt.dll");
+        SetMmThreadCharacteristicsFunction setMmThreadCharacteristics = (avrtModule == 0) ? 0 :
+            (SetMmThreadCharacteristicsFunction)GetProcAddress(avrtModule,
+            "AvSetMmThreadCharacteristicsW");
+        DWORD taskIndex = 0;
+        if (setMmThreadCharacteristics != 0 &&
+            setMmThreadCharacteristics(L"Games", &taskIndex) != 0)
+        {
+            return THREAD_PRIORITY_LEVEL_REALTIME;
+        }
+        level = THREAD_PRIORITY_LEVEL_HIGH;
+    }
+    if (level == THREAD_PRIORITY_LEVEL_HIGH &&
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST))
+    {
+        return THREAD_PRIORITY_LEVEL_HIGH;
+    }
+#elif defined(__linux__)
+    if (level == THREAD_PRIORITY_LEVEL_REALTIME)
+    {
+        // the lowest realtime priority is still above every SCHED_OTHER thread, and leaves
+        // the kernel's own realtime threads above this one
+        sched_param param;
+        param.sched_priority = sched_get_priority_min(SCHED_FIFO) + 1;
+        if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0)
+        {
+            return THREAD_PRIORITY_LEVEL_REALTIME;
+        }
+        level = THREAD_PRIORITY_LEVEL_HIGH;
+    }
+
+    // Note: Linux's nice is per thread, by the thread's ID.
+    if (level == THREAD_PRIORITY_LEVEL_HIGH &&
+        setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), -10) == 0)
+    {
+        return THREAD_PRIORITY_LEVEL_HIGH;
+    }
+#else
+    (void)level;
+#endif
+    return THREAD_PRIORITY_LEVEL_DEFAULT;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    level   Self-explanatory.
+Returns:
+    For the log.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static const char *GetThreadPriorityLevelName(ThreadPriorityLevel level)
+{
+    switch (level)
+    {
+    case THREAD_PRIORITY_LEVEL_HIGH:
+        return "high";
+    case THREAD_PRIORITY_LEVEL_REALTIME:
+        return "realtime";
+    default:
+        return "default";
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes the settings that PlaceGlThread() and PlaceWorkerThread() use, and looks up the
+    GPU's node now if the workers are to go there.
+Parameters:
+    settings    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void SetThreadPlacement(const ThreadPlacementSettings &settings)
+{
+    gThreadPlacement = settings;
+    gIsWorkerFailureLogged = false;
+    if (gThreadPlacement._workerNumaNode == NUMA_NODE_NEAREST_GPU)
+    {
+        gThreadPlacement._workerNumaNode = FindGpuNumaNode();
+        if (gThreadPlacement._workerNumaNode < 0)
+        {
+            LogPrintf("thread placement: the GPU's NUMA node isn't known, so the workers can "
+                "go anywhere\n");
+        }
+        else
+        {
+            LogPrintf("thread placement: the GPU is on NUMA node %d\n",
+                gThreadPlacement._workerNumaNode);
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    Settings that leave every thread to the OS.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ThreadPlacementSettings GetDefaultThreadPlacement()
+{
+    ThreadPlacementSettings settings;
+    settings._glThreadCore = -1;
+    settings._glThreadPriority = THREAD_PRIORITY_LEVEL_DEFAULT;
+    settings._workerNumaNode = -1;
+    return settings;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Pins the calling thread, which must be the GL thread, to its core and raises its priority,
+    if the settings say to, and logs what it got.  Called once, after the context is made,
+    since the driver starts its own threads with the context, and a new thread takes its
+    affinity (and on Linux, its realtime policy) from the thread that starts it.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void PlaceGlThread()
+{
+    if (gThreadPlacement._glThreadCore >= 0)
+    {
+        if (PinCurrentThread(gThreadPlacement._glThreadCore))
+        {
+            LogPrintf("thread placement: the GL thread is pinned to core %d\n",
+                gThreadPlacement._glThreadCore);
+        }
+        else
+        {
+            LogPrintf("thread placement: couldn't pin the GL thread to core %d\n",
+                gThreadPlacement._glThreadCore);
+        }
+    }
+
+    if (gThreadPlacement._glThreadPriority != THREAD_PRIORITY_LEVEL_DEFAULT)
+    {
+        ThreadPriorityLevel level = RaiseCurrentThreadPriority(gThreadPlacement._glThreadPriority);
+        if (level != gThreadPlacement._glThreadPriority)
+        {
+            LogPrintf("thread placement: the GL thread asked for %s priority and got %s "
+                "(the privilege may be missing)\n",
+                GetThreadPriorityLevelName(gThreadPlacement._glThreadPriority),
+                GetThreadPriorityLevelName(level));
+        }
+        else
+        {
+            LogPrintf("thread placement: the GL thread is at %s priority\n",
+                GetThreadPriorityLevelName(level));
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Moves the calling thread, which is a worker that was just started, onto the settings'
+    NUMA node, so that it shares a memory controller with the GPU's PCIe root and the GL
+    thread's buffers.  On Linux, the GL thread's core is also taken out of the worker's set
+    (unless it is the only core there), since a worker preempting the GL thread is what this
+    is meant to stop.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void PlaceWorkerThread()
+{
+    int node = gThreadPlacement._workerNumaNode;
+    if (node < 0)
+    {
+        return;
+    }
+
+    bool isPlaced = MoveCurrentThreadToNumaNode(node);
+#ifdef __linux__
+    if (isPlaced && gThreadPlacement._glThreadCore >= 0 &&
+        gThreadPlacement._glThreadCore < CPU_SETSIZE)
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        pthread_getaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (CPU_ISSET(gThreadPlacement._glThreadCore, &cpus) && CPU_COUNT(&cpus) > 1)
+        {
+            CPU_CLR(gThreadPlacement._glThreadCore, &cpus);
+            pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        }
+    }
+#endif
+    if (!isPlaced && !gIsWorkerFailureLogged.exchange(true))
+    {
+        LogPrintf("thread placement: couldn't move the workers to NUMA node %d\n", node);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Finds the NUMA node that the GPU is attached to.  On Linux, that is the first DRM card's
+    PCI device's node.  Windows only says this through the display adapter's device
+    properties, which aren't worth a dependency here, so it is unknown there and the node
+    must be given by number.
+Parameters: None
+Returns:
+    The node, or -1 if it isn't known (including machines that aren't NUMA, where the kernel
+    says -1 too).
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+int FindGpuNumaNode()
+{
+#ifdef __linux__
+    for (int cardIndex = 0; cardIndex < 8; cardIndex++)
+    {
+        char filePath[64];
+        snprintf(filePath, sizeof(filePath), "/sys/class/drm/card%d/device/numa_node",
+            cardIndex);
+        FILE *nodeFile = fopen(filePath, "r");
+        if (nodeFile == 0)
+        {
+            continue;
+        }
+        int node = -1;
+        int fieldCount = fscanf(nodeFile, "%d", &node);
+        fclose(nodeFile);
+        if (fieldCount == 1)
+        {
+            return node;
+        }
+    }
+#endif
+    return -1;
+}
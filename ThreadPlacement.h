@@ -0,0 +1,41 @@
+#pragma once
+
+// how far above the other threads the GL thread runs (see PlaceGlThread())
+enum ThreadPriorityLevel
+{
+    THREAD_PRIORITY_LEVEL_DEFAULT = 0,
+
+    // the highest priority that an ordinary process can give itself (above normal on Windows,
+    // a nice of -10 on Linux, which needs CAP_SYS_NICE or a raised RLIMIT_NICE)
+    THREAD_PRIORITY_LEVEL_HIGH,
+
+    // the multimedia class scheduler's "Games" task on Windows, SCHED_FIFO on Linux (which
+    // needs CAP_SYS_NICE or a raised RLIMIT_RTPRIO); falls back to high if it is refused
+    THREAD_PRIORITY_LEVEL_REALTIME,
+};
+
+// a _workerNumaNode that picks the node that the GPU is attached to (see FindGpuNumaNode())
+static const int NUMA_NODE_NEAREST_GPU = -2;
+
+// where the GL thread and the workers run
+// Note: The defaults leave everything to the OS, which is how the demo ran before this.
+struct ThreadPlacementSettings
+{
+    int _glThreadCore;                      // a logical processor, or -1 for any
+    ThreadPriorityLevel _glThreadPriority;
+    int _workerNumaNode;                    // a node, NUMA_NODE_NEAREST_GPU, or -1 for any
+};
+
+// keeps the GL thread on one core and ahead of the workers, and the workers on the NUMA node
+// nearest the GPU, to take the OS's migrations and the workers' preemptions out of the frame
+// time (see ThreadPlacement.cpp)
+// Note: SetThreadPlacement(...) must come before any worker starts, since each worker places
+// itself with PlaceWorkerThread() when it starts (see WorkStealingThreadPool.h,
+// FramePrepPipeline.h, and AsyncLoader.h), and the settings aren't locked.
+// Also Note: Anything that the OS refuses (ex: realtime without the privilege) is logged and
+// left as it was, so asking for too much is never fatal.
+void SetThreadPlacement(const ThreadPlacementSettings &settings);
+ThreadPlacementSettings GetDefaultThreadPlacement();
+void PlaceGlThread();
+void PlaceWorkerThread();
+int FindGpuNumaNode();
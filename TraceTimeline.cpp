@@ -0,0 +1,402 @@
+#include "TraceTimeline.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "MpscRing.h"
+#include "Log.h"
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <set>
+#include <stdio.h>
+#include <thread>
+
+// what goes through the ring; the writer turns each one into a line of JSON
+enum TraceEventType
+{
+    TRACE_EVENT_COMPLETE = 0,   // a scope, with its duration
+    TRACE_EVENT_FRAME,          // an instant across every track
+};
+struct TraceEvent
+{
+    const char *_name;
+    long long _beginNs;
+    long long _durationNs;
+    unsigned int _threadId;
+    unsigned int _type;
+};
+
+// 512KB, which is several seconds of even a busy frame's scopes between drains
+// Note: Like the log, a full ring drops the event and counts it rather than waiting.
+static const unsigned int TRACE_RING_SIZE = 16384;
+static MpscRing<TraceEvent, TRACE_RING_SIZE> gTraceRing;
+
+// the writer thread sleeps this long between drains
+static const unsigned int TRACE_WRITER_SLEEP_MS = 20;
+static std::atomic<bool> gIsTraceRunning(false);
+static std::thread gTraceWriterThread;
+static FILE *gTraceFile = 0;
+static std::chrono::steady_clock::time_point gTraceStart;
+
+// the GPU's track is thread 0, and every CPU thread gets the next number the first time that it
+// records something
+static const unsigned int TRACE_GPU_THREAD_ID = 0;
+static std::atomic<unsigned int> gNextTraceThreadId(1);
+static thread_local unsigned int tTraceThreadId = 0;
+static std::mutex gTraceNameMutex;
+static std::map<unsigned int, std::string> gTraceThreadNames;
+static std::set<std::string> gInternedTraceNames;
+
+// the GPU's timestamps are on its own clock, so the offset to the trace's clock is measured at
+// the start and every so often after that, in case the two drift apart
+// Note: Only the render thread touches these.
+static const unsigned int TRACE_GPU_CALIBRATION_FRAMES = 120;
+static long long gGpuToTraceOffsetNs = 0;
+static bool gIsGpuClockCalibrated = false;
+static unsigned int gFramesSinceCalibration = 0;
+
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The calling thread's track in the trace.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static unsigned int GetTraceThreadId()
+{
+    if (tTraceThreadId == 0)
+    {
+        tTraceThreadId = gNextTraceThreadId.fetch_add(1, std::memory_order_relaxed);
+    }
+    return tTraceThreadId;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Measures how far the GPU's timestamp clock is from the trace's by reading the GPU's time
+    between two reads of the CPU's, and taking the middle.
+
+    Note: glGetInteger64v(GL_TIMESTAMP, ...) is a round trip to the driver, though not a wait
+    on the GPU, which is why this only runs every so often.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static void CalibrateGpuClock()
+{
+    long long cpuBeforeNs = GetTraceTimeNs();
+    GLint64 gpuNs = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuNs);
+    long long cpuAfterNs = GetTraceTimeNs();
+    gGpuToTraceOffsetNs = ((cpuBeforeNs + cpuAfterNs) / 2) - (long long)gpuNs;
+    gIsGpuClockCalibrated = true;
+    gFramesSinceCalibration = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Writes every event in the ring to the file.  Only call this from one thread at a time (the
+    writer thread, or StopTrace() after the writer thread has been joined).
+
+    Note: Every event starts with the comma that separates it from the one before, since the
+    file starts with one that needs no comma (see StartTrace(...)).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static void DrainTrace()
+{
+    TraceEvent event;
+    while (gTraceRing.TryPop(&event))
+    {
+        // Chrome's trace format is in microseconds
+        double beginUs = (double)event._beginNs / 1000.0;
+        if (event._type == TRACE_EVENT_FRAME)
+        {
+            fprintf(gTraceFile, ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,"
+                "\"tid\":%u,\"ts\":%.3f}", event._name, event._threadId, beginUs);
+        }
+        else
+        {
+            fprintf(gTraceFile, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                "\"ts\":%.3f,\"dur\":%.3f}", event._name, event._threadId, beginUs,
+                (double)event._durationNs / 1000.0);
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The writer thread.  Drains the ring and sleeps until the trace is stopped.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static void TraceWriterThreadLoop()
+{
+    while (gIsTraceRunning)
+    {
+        DrainTrace();
+        std::this_thread::sleep_for(std::chrono::milliseconds(TRACE_WRITER_SLEEP_MS));
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Opens the file and starts the writer thread.  Scopes are recorded from here until
+    StopTrace().  The GPU's track starts at the first TraceFrameMark(), since measuring its
+    clock needs the GL context.
+Parameters:
+    filePath    Overwritten if it exists.
+Returns:
+    False if a trace is already running or the file couldn't be opened, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool StartTrace(const std::string &filePath)
+{
+    if (gIsTraceRunning)
+    {
+        return false;
+    }
+
+    gTraceFile = fopen(filePath.c_str(), "w");
+    if (gTraceFile == 0)
+    {
+        LogPrintf("trace: couldn't open '%s'\n", filePath.c_str());
+        return false;
+    }
+
+    // anything left in the ring from an earlier trace is on that trace's clock
+    TraceEvent staleEvent;
+    while (gTraceRing.TryPop(&staleEvent))
+    {
+    }
+
+    fprintf(gTraceFile, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+        "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"particles\"}}");
+    gTraceStart = std::chrono::steady_clock::now();
+    gIsGpuClockCalibrated = false;
+    gIsTraceRunning = true;
+    gTraceWriterThread = std::thread(TraceWriterThreadLoop);
+    LogPrintf("trace: writing to '%s'\n", filePath.c_str());
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Stops the writer thread, writes whatever is left in the ring and the tracks' names, and
+    closes the file.  Safe to call more than once.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void StopTrace()
+{
+    if (!gIsTraceRunning)
+    {
+        return;
+    }
+
+    gIsTraceRunning = false;
+    gTraceWriterThread.join();
+    DrainTrace();
+
+    fprintf(gTraceFile, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+        "\"args\":{\"name\":\"GPU\"}}", TRACE_GPU_THREAD_ID);
+    {
+        std::lock_guard<std::mutex> lock(gTraceNameMutex);
+        std::map<unsigned int, std::string>::const_iterator itr = gTraceThreadNames.begin();
+        for (; itr != gTraceThreadNames.end(); itr++)
+        {
+            fprintf(gTraceFile, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                "\"tid\":%u,\"args\":{\"name\":\"%s\"}}", itr->first, itr->second.c_str());
+        }
+    }
+    fprintf(gTraceFile, "\n]}\n");
+    fclose(gTraceFile);
+    gTraceFile = 0;
+
+    LogPrintf("trace: stopped (%u events dropped)\n", gTraceRing.GetDroppedItemCount());
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.  Safe from any thread.
+Parameters: None
+Returns:
+    True if StartTrace(...) was called and StopTrace() hasn't been since, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool IsTracing()
+{
+    return gIsTraceRunning.load(std::memory_order_relaxed);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.  Safe from any thread.
+Parameters: None
+Returns:
+    Nanoseconds since StartTrace(...) on the trace's clock.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+long long GetTraceTimeNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - gTraceStart).count();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Records a scope on the calling thread's track that started at the given time and ends now.
+    Safe from any thread; never blocks or allocates (except for the thread's first event).
+Parameters:
+    name        Must outlive the trace (ex: a string literal or InternTraceName(...)).
+    beginNs     From GetTraceTimeNs().
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void TraceCpuEvent(const char *name, long long beginNs)
+{
+    if (!IsTracing())
+    {
+        return;
+    }
+
+    TraceEvent event;
+    event._name = name;
+    event._beginNs = beginNs;
+    event._durationNs = GetTraceTimeNs() - beginNs;
+    event._threadId = GetTraceThreadId();
+    event._type = TRACE_EVENT_COMPLETE;
+    gTraceRing.TryPush(event);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Records a scope on the GPU's track from a pair of GL_TIMESTAMP results (see GpuProfiler),
+    moved onto the trace's clock with the last calibration.  Scopes before the first
+    calibration, or from before the trace started, are skipped.
+
+    Note: Render thread only.
+Parameters:
+    name        Must outlive the trace (ex: a string literal or InternTraceName(...)).
+    gpuBeginNs  Self-explanatory.
+    gpuEndNs    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void TraceGpuEvent(const char *name, unsigned long long gpuBeginNs, unsigned long long gpuEndNs)
+{
+    if (!IsTracing() || !gIsGpuClockCalibrated)
+    {
+        return;
+    }
+
+    long long beginNs = (long long)gpuBeginNs + gGpuToTraceOffsetNs;
+    if (beginNs < 0)
+    {
+        return;
+    }
+
+    TraceEvent event;
+    event._name = name;
+    event._beginNs = beginNs;
+    event._durationNs = (long long)(gpuEndNs - gpuBeginNs);
+    event._threadId = TRACE_GPU_THREAD_ID;
+    event._type = TRACE_EVENT_COMPLETE;
+    gTraceRing.TryPush(event);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Marks the end of a frame across every track, and measures the GPU's clock again if it is
+    due.  Call once per frame through TRACE_FRAME().
+
+    Note: Render thread only, with the GL context current.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void TraceFrameMark()
+{
+    if (!IsTracing())
+    {
+        return;
+    }
+
+    if (!gIsGpuClockCalibrated || ++gFramesSinceCalibration >= TRACE_GPU_CALIBRATION_FRAMES)
+    {
+        CalibrateGpuClock();
+    }
+
+    TraceEvent event;
+    event._name = "frame";
+    event._beginNs = GetTraceTimeNs();
+    event._durationNs = 0;
+    event._threadId = GetTraceThreadId();
+    event._type = TRACE_EVENT_FRAME;
+    gTraceRing.TryPush(event);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Names the calling thread's track.  May be called before the trace starts, and the name is
+    kept for every trace after.
+Parameters:
+    name    Self-explanatory.  Copied.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void SetTraceThreadName(const char *name)
+{
+    std::lock_guard<std::mutex> lock(gTraceNameMutex);
+    gTraceThreadNames[GetTraceThreadId()] = name;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Keeps a copy of a name that isn't a string literal (ex: a GPU profiler scope's) for as
+    long as the program runs, so that events can point at it.  Call when the name is made,
+    not per event, since this locks.
+Parameters:
+    name    Self-explanatory.
+Returns:
+    A pointer to the copy.  The same name always gets the same copy.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+const char *InternTraceName(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(gTraceNameMutex);
+    return gInternedTraceNames.insert(name).first->c_str();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The events that didn't fit in the ring since the program started.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int GetDroppedTraceEventCount()
+{
+    return gTraceRing.GetDroppedItemCount();
+}
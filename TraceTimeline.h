@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string>
+
+// a timeline of CPU and GPU scopes for hitch investigations (see TraceTimeline.cpp), written as
+// Chrome trace JSON that chrome://tracing and Perfetto can open
+// Note: TRACE_SCOPE("name") times the rest of the enclosing scope on the calling thread.  The
+// name must be a string literal (or InternTraceName(...)), since only the pointer is kept.
+// Between StartTrace(...) and StopTrace(), each scope puts one event into a lock-free ring, and
+// a writer thread does the formatting and the file writes.  Otherwise a scope costs a check of
+// one flag.  The GPU profiler's scopes go on a "GPU" track of their own, moved onto the CPU's
+// clock (see TraceGpuEvent(...)).
+// Also Note: Defining PARTICLE_NO_TRACING compiles the scopes out entirely.  Defining
+// TRACY_ENABLE (with Tracy's client on the include path) also sends every scope and frame to
+// Tracy, whether or not a trace file is being written; the GPU track is only in the file.
+#if defined(TRACY_ENABLE) && !defined(PARTICLE_NO_TRACING)
+#include "tracy/Tracy.hpp"
+#define TRACE_TRACY_ZONE(name) ZoneScopedN(name)
+#define TRACE_TRACY_FRAME() FrameMark
+#else
+#define TRACE_TRACY_ZONE(name)
+#define TRACE_TRACY_FRAME()
+#endif
+
+bool StartTrace(const std::string &filePath);
+void StopTrace();
+bool IsTracing();
+long long GetTraceTimeNs();
+void TraceCpuEvent(const char *name, long long beginNs);
+void TraceGpuEvent(const char *name, unsigned long long gpuBeginNs, unsigned long long gpuEndNs);
+void TraceFrameMark();
+void SetTraceThreadName(const char *name);
+const char *InternTraceName(const std::string &name);
+unsigned int GetDroppedTraceEventCount();
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Records an event for the time from its construction to its destruction, if a trace was
+    running when it was constructed.  Use it through TRACE_SCOPE(...).
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name) :
+        _name(name),
+        _beginNs(IsTracing() ? GetTraceTimeNs() : -1)
+    {
+    }
+
+    ~TraceScope()
+    {
+        if (_beginNs >= 0)
+        {
+            TraceCpuEvent(_name, _beginNs);
+        }
+    }
+
+private:
+    TraceScope(const TraceScope &);
+    TraceScope &operator=(const TraceScope &);
+
+    const char *_name;
+    long long _beginNs;
+};
+
+// the line number keeps two scopes in the same function from colliding
+#define TRACE_CONCATENATE_INNER(a, b) a##b
+#define TRACE_CONCATENATE(a, b) TRACE_CONCATENATE_INNER(a, b)
+#ifdef PARTICLE_NO_TRACING
+#define TRACE_SCOPE(name)
+#define TRACE_FRAME()
+#else
+#define TRACE_SCOPE(name) \
+    TRACE_TRACY_ZONE(name); \
+    TraceScope TRACE_CONCATENATE(traceScope, __LINE__)(name)
+#define TRACE_FRAME() \
+    TRACE_TRACY_FRAME(); \
+    TraceFrameMark()
+#endif
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "glm/mat4x4.hpp"
+#include "glm/vec2.hpp"
+
+// the uniform buffer binding point of the "ViewParameters" block in shaderParticle.vert and
+// shaderParticle.comp
+// Note: Binding point 0 is the simulation's parameter block (see ParticleManager).
+static const unsigned int VIEW_PARAMETERS_BINDING = 1;
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Where the camera is looking, for the shaders that draw the particles and for the update
+    pass that decides which of them get drawn (see ParticleManager::SetView(...)).  The
+    simulation is still in window space ([-1,+1] on both axes); this only changes what part of
+    it ends up on the screen.
+
+    Note: Must match the "ViewParameters" block in shaderParticle.vert and shaderParticle.comp
+    under std140 rules.  A mat4 is 4 vec4 columns, so it is 64 bytes, and the rest fills out
+    one more vec4.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+struct ViewParameters
+{
+    // from window space (where the particles are) to clip space
+    glm::mat4 _viewProjection;
+
+    // how far outside of clip space's [-1,+1] a particle's center can be and still put some of
+    // its point on the screen, in clip space units on each axis
+    glm::vec2 _cullMargin;
+
+    // 1 if the update leaves the particles that can't be seen out of the draw, otherwise 0
+    unsigned int _isCulled;
+
+    // the update only draws 1 in every this many particles (see 
+    // ParticleManager::SetLevelOfDetail(...)); 0 and 1 both draw every particle
+    unsigned int _lodStride;
+};
+
+static_assert(sizeof(ViewParameters) == 80, "ViewParameters must match the std140 block size");
@@ -0,0 +1,306 @@
+#include "WeightedOitRenderer.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
+#include "ShaderProgramRegistry.h"
+#include "GpuMemoryLedger.h"
+#include "OpenGlErrorHandling.h"
+#include "Log.h"
+
+// must match the bindings of uOitAccumulation and uOitRevealage in shaderOitComposite.frag
+static const unsigned int OIT_ACCUMULATION_TEXTURE_UNIT = 0;
+static const unsigned int OIT_REVEALAGE_TEXTURE_UNIT = 1;
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+WeightedOitRenderer::WeightedOitRenderer() :
+    _compositeProgramId(0),
+    _emptyVaoId(0),
+    _framebufferId(0),
+    _accumulationTextureId(0),
+    _revealageTextureId(0),
+    _width(0),
+    _height(0),
+    _previousFramebufferId(0),
+    _wasBlendEnabled(false),
+    _wasDepthTestEnabled(false),
+    _isActive(false)
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+WeightedOitRenderer::~WeightedOitRenderer()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes a reference to the composite program (see ShaderProgramRegistry.h).  The targets
+    aren't made until the first Begin(), when the viewport's size is known.  The caller may
+    release their own reference after this returns.
+Parameters:
+    compositeProgramId  shaderDensityResolve.vert (the fullscreen triangle) with
+                        shaderOitComposite.frag.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void WeightedOitRenderer::Init(unsigned int compositeProgramId)
+{
+    this->Cleanup();
+    if (compositeProgramId == 0)
+    {
+        LogPrintf("the weighted OIT renderer needs its composite program\n");
+        return;
+    }
+
+    _compositeProgramId = compositeProgramId;
+    AddProgramReference(_compositeProgramId);
+    glGenVertexArrays(1, &_emptyVaoId);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Releases the program and deletes the targets and the VAO.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void WeightedOitRenderer::Cleanup()
+{
+    this->DeleteTargets();
+    if (_emptyVaoId != 0)
+    {
+        DeleteGlVertexArrays(1, &_emptyVaoId);
+        _emptyVaoId = 0;
+    }
+    ReleaseProgram(_compositeProgramId);
+    _compositeProgramId = 0;
+    _isActive = false;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Switches to a rebuilt program (see ShaderProgramRegistry.h).
+Parameters:
+    oldProgramId    Self-explanatory.  Programs that this renderer doesn't use are ignored.
+    newProgramId    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void WeightedOitRenderer::ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId)
+{
+    if (oldProgramId == 0 || newProgramId == 0 || _compositeProgramId != oldProgramId)
+    {
+        return;
+    }
+
+    AddProgramReference(newProgramId);
+    ReleaseProgram(_compositeProgramId);
+    _compositeProgramId = newProgramId;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Redirects the draw into the targets, clears them, and sets up their blends: the
+    accumulation adds (1, 1), and the revealage multiplies by what each fragment lets through
+    (0, 1 - source).  The depth test is turned off, since every fragment counts, and
+    End() puts it and the blending back the way they were.
+
+    The targets are (re)created first if the viewport's size has changed since the last frame.
+Parameters: None
+Returns:
+    False if there is no composite program or the targets couldn't be made, in which case
+    nothing was changed and the draw goes to the frame as it would without this.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+bool WeightedOitRenderer::Begin()
+{
+    if (_compositeProgramId == 0 || _isActive)
+    {
+        return false;
+    }
+
+    GLint viewport[4] = { 0, 0, 0, 0 };
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    if (viewport[2] != _width || viewport[3] != _height || _framebufferId == 0)
+    {
+        this->InitTargets(viewport[2], viewport[3]);
+    }
+    if (_framebufferId == 0)
+    {
+        return false;
+    }
+
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &_previousFramebufferId);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _framebufferId);
+    glViewport(0, 0, _width, _height);
+    _isActive = true;
+
+    // nothing has been added up yet, and all of the background shows through
+    float zeros[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    float ones[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    glClearBufferfv(GL_COLOR, 0, zeros);
+    glClearBufferfv(GL_COLOR, 1, ones);
+
+    _wasBlendEnabled = IsGlCapabilityEnabled(GL_BLEND);
+    _wasDepthTestEnabled = IsGlCapabilityEnabled(GL_DEPTH_TEST);
+    EnableGlCapability(GL_BLEND);
+    DisableGlCapability(GL_DEPTH_TEST);
+    glBlendEquation(GL_FUNC_ADD);
+    SetGlBlendFunci(0, GL_ONE, GL_ONE);
+    SetGlBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+    return true;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Puts back the framebuffer and the viewport that Begin() found and blends the weighted
+    average color over them by the coverage.  Does nothing if Begin() didn't redirect the
+    draw.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void WeightedOitRenderer::End()
+{
+    if (!_isActive)
+    {
+        return;
+    }
+    _isActive = false;
+    GlDebugGroup compositeGroup("weighted OIT composite");
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, (GLuint)_previousFramebufferId);
+    glViewport(0, 0, _width, _height);
+
+    // frame = average * (1 - revealage) + frame * revealage
+    SetGlBlendFunc(GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA);
+    UseGlProgram(_compositeProgramId);
+    glActiveTexture(GL_TEXTURE0 + OIT_ACCUMULATION_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, _accumulationTextureId);
+    glActiveTexture(GL_TEXTURE0 + OIT_REVEALAGE_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, _revealageTextureId);
+    BindGlVertexArray(_emptyVaoId);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    BindGlVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0 + OIT_ACCUMULATION_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    UseGlProgram(0);
+
+    if (!_wasBlendEnabled)
+    {
+        DisableGlCapability(GL_BLEND);
+    }
+    if (_wasDepthTestEnabled)
+    {
+        EnableGlCapability(GL_DEPTH_TEST);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    (Re)creates the targets and their framebuffer at the given size.  The accumulation is
+    RGBA16F, since the weights go well past 1, and the revealage is R16F, since a product of
+    many small factors needs more than 8 bits to not round to 0.  Neither is filtered, since
+    the composite reads them a texel per pixel.
+Parameters:
+    width   Self-explanatory.
+    height  Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void WeightedOitRenderer::InitTargets(int width, int height)
+{
+    this->DeleteTargets();
+
+    // a minimized window reports 0x0
+    _width = width;
+    _height = height;
+    if (_width <= 0 || _height <= 0)
+    {
+        return;
+    }
+
+    unsigned int *textureIds[2] = { &_accumulationTextureId, &_revealageTextureId };
+    GLenum internalFormats[2] = { GL_RGBA16F, GL_R16F };
+    for (unsigned int targetIndex = 0; targetIndex < 2; targetIndex++)
+    {
+        glGenTextures(1, textureIds[targetIndex]);
+        glBindTexture(GL_TEXTURE_2D, *textureIds[targetIndex]);
+        glTexStorage2D(GL_TEXTURE_2D, 1, internalFormats[targetIndex], _width, _height);
+        RecordGpuAllocation(GPU_MEMORY_TEXTURE, *textureIds[targetIndex],
+            GetGlTextureSizeBytes(internalFormats[targetIndex], _width, _height),
+            "weighted OIT");
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    glGenFramebuffers(1, &_framebufferId);
+    glBindFramebuffer(GL_FRAMEBUFFER, _framebufferId);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+        _accumulationTextureId, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D,
+        _revealageTextureId, 0);
+    GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, drawBuffers);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        LogPrintf("weighted OIT: framebuffer incomplete (0x%x); drawing without it\n", status);
+        this->DeleteTargets();
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.  The next Begin() makes them again.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void WeightedOitRenderer::DeleteTargets()
+{
+    if (_framebufferId != 0)
+    {
+        glDeleteFramebuffers(1, &_framebufferId);
+        _framebufferId = 0;
+    }
+    unsigned int *textureIds[2] = { &_accumulationTextureId, &_revealageTextureId };
+    for (unsigned int targetIndex = 0; targetIndex < 2; targetIndex++)
+    {
+        if (*textureIds[targetIndex] != 0)
+        {
+            ForgetGpuAllocation(GPU_MEMORY_TEXTURE, *textureIds[targetIndex]);
+            glDeleteTextures(1, textureIds[targetIndex]);
+            *textureIds[targetIndex] = 0;
+        }
+    }
+    _width = 0;
+    _height = 0;
+}
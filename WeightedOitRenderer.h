@@ -0,0 +1,68 @@
+#pragma once
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Translucent, colored particles without sorting them, by weighted blended order-independent
+    transparency (McGuire and Bavoil, 2013).  Blending translucent particles in the usual way
+    only looks right if they are drawn back to front, which means sorting every particle
+    every frame.  This instead draws them in any order into 2 offscreen targets with blends
+    that don't care about order, and then composites those over the frame in one fullscreen
+    pass.
+
+    Between Begin() and End(), the particles are drawn with a render program built with
+    shaderParticleOit.frag, which writes each fragment's color and opacity, times a weight,
+    into an accumulation target (RGBA16F, added up), and how much of the background it lets
+    through into a revealage target (R16F, multiplied together).  End() divides the
+    accumulation by its total weight, which is the weighted average color of everything that
+    landed on the pixel, and blends that over the frame by how much of the frame is covered.
+    The cost is the 2 targets' bandwidth and the fullscreen pass, the same at any particle
+    count, instead of a sort that grows with it.
+
+    The result is an approximation: the weight favors the nearer and more opaque fragments,
+    so overlapping particles of different colors mix by weight instead of strictly by depth.
+    In 2D, every particle is at the same depth, so the only ordering there is to get is
+    between particles of different opacities, and the average is what a sort would give for
+    particles that are all alike.
+
+    The targets are made the size of the viewport that Begin() finds, so this works inside a
+    scaled render target (see ScaledRenderTarget.h) as well as straight to the window, and
+    End() composites into whatever framebuffer was bound before.  They are only re-created
+    when that size changes.
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+class WeightedOitRenderer
+{
+public:
+    WeightedOitRenderer();
+    ~WeightedOitRenderer();
+    void Init(unsigned int compositeProgramId);
+    void Cleanup();
+    void ReplaceProgram(unsigned int oldProgramId, unsigned int newProgramId);
+
+    bool Begin();
+    void End();
+
+private:
+    void InitTargets(int width, int height);
+    void DeleteTargets();
+
+    unsigned int _compositeProgramId;
+
+    // the fullscreen triangle has no vertex attributes, but the core profile still needs a VAO
+    // bound to draw
+    unsigned int _emptyVaoId;
+
+    unsigned int _framebufferId;
+    unsigned int _accumulationTextureId;
+    unsigned int _revealageTextureId;
+    int _width;
+    int _height;
+
+    // what Begin() found, for End() to put back
+    int _previousFramebufferId;
+    bool _wasBlendEnabled;
+    bool _wasDepthTestEnabled;
+
+    // true between a Begin() that redirected the draw and its End()
+    bool _isActive;
+};
@@ -0,0 +1,173 @@
+#include "WorkGroupTuner.h"
+
+#include "glload/include/glload/gl_4_4.h"
+#include "glm/vec2.hpp"
+
+#include "GpuProfiler.h"
+#include "ParticleManager.h"
+#include "ShaderBinaryCache.h"
+#include "ShaderProgramRegistry.h"
+#include "ComputeDeviceCaps.h"
+#include "Log.h"
+
+#include <fstream>
+#include <string>
+#include <stdio.h>
+
+// enough frames to fill the pool (the emission rate below fills it in 50) and then to get a
+// steady average
+static const unsigned int TUNING_WARMUP_FRAMES = 60;
+static const unsigned int TUNING_MEASURED_FRAMES = 100;
+static const float TUNING_STEP_SEC = 1.0f / 120.0f;
+
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    layout      Self-explanatory.
+Returns:
+    The path of the file that holds the tuned work group size for this GPU and layout.
+Exception:  Safe
+Creator:    John Cox (8-13-2016)
+-----------------------------------------------------------------------------------------------*/
+static std::string GetTuningFilePath(ParticleLayout layout)
+{
+    // the program cache key already covers the GPU and driver, so reuse it
+    std::string cacheKey = MakeProgramCacheKey("work group size, layout " +
+        std::to_string((int)layout));
+    return "workGroupSize_" + cacheKey + ".txt";
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Runs the particle update with the given work group size and measures the GPU time.
+Parameters:
+    workGroupSize   Self-explanatory.
+    layout          Self-explanatory.
+    numParticles    Self-explanatory.
+Returns:
+    The average GPU time of the update in milliseconds, or a negative number if the programs
+    couldn't be created.
+Exception:  Safe
+Creator:    John Cox (8-13-2016)
+-----------------------------------------------------------------------------------------------*/
+static float TimeWorkGroupSize(unsigned int workGroupSize, ParticleLayout layout,
+    unsigned int numParticles)
+{
+    // every candidate shares the render program, but each work group size is its own compute 
+    // program
+    GLuint particleProgramId = AcquireRenderProgram();
+    GLuint computeProgramId = AcquireComputeProgram(
+        ParticleManager::GetComputeShaderDefines(layout, workGroupSize));
+    if (particleProgramId == 0 || computeProgramId == 0)
+    {
+        ReleaseProgram(particleProgramId);
+        ReleaseProgram(computeProgramId);
+        return -1.0f;
+    }
+
+    ParticleManager particleManager;
+    particleManager.Init(particleProgramId,
+        computeProgramId,
+        numParticles,
+        numParticles / 50,
+        glm::vec2(+0.3f, +0.3f),
+        1.1f,
+        0.05f,
+        0.6f,
+        layout);
+
+    // the particle manager has its own references now
+    ReleaseProgram(particleProgramId);
+    ReleaseProgram(computeProgramId);
+
+    GpuProfiler profiler;
+    profiler.Init(0);
+    unsigned int updateScopeId = profiler.AddScope("update");
+
+    for (unsigned int frameCount = 0; frameCount < TUNING_WARMUP_FRAMES; frameCount++)
+    {
+        particleManager.UpdateSteps(TUNING_STEP_SEC, 1);
+    }
+    glFinish();
+
+    for (unsigned int frameCount = 0; frameCount < TUNING_MEASURED_FRAMES; frameCount++)
+    {
+        profiler.BeginScope(updateScopeId);
+        particleManager.UpdateSteps(TUNING_STEP_SEC, 1);
+        profiler.EndScope(updateScopeId);
+        profiler.EndFrame();
+    }
+    glFinish();
+
+    // collect the frames that are still in the profiler's ring
+    profiler.EndFrame();
+    profiler.EndFrame();
+
+    GpuProfilerStats stats = {};
+    profiler.GetStats(updateScopeId, &stats);
+
+    profiler.Cleanup();
+    particleManager.Cleanup();
+    return stats._avgMs;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Reads the tuned work group size from the file if there is one and otherwise times every
+    candidate size and saves the fastest.
+Parameters:
+    layout          The particle layout that the compute shader will be generated for.
+    numParticles    How many particles to time with.  Should be representative.
+    forceRetune     If true, ignores any saved result.
+Returns:
+    The work group size to give to ParticleManager::GetComputeShaderDefines(...).  Falls back
+    to ParticleManager::DEFAULT_WORK_GROUP_SIZE if nothing could be timed.
+Exception:  Safe
+Creator:    John Cox (8-13-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int GetTunedWorkGroupSize(ParticleLayout layout, unsigned int numParticles,
+    bool forceRetune)
+{
+    std::string filePath = GetTuningFilePath(layout);
+    if (!forceRetune)
+    {
+        std::ifstream tuningFile(filePath.c_str());
+        unsigned int savedSize = 0;
+        if (tuningFile >> savedSize && savedSize > 0)
+        {
+            return savedSize;
+        }
+    }
+
+    const unsigned int candidateSizes[] = { 64, 128, 256, 512, 1024 };
+    unsigned int numCandidates = sizeof(candidateSizes) / sizeof(candidateSizes[0]);
+    unsigned int bestSize = ParticleManager::DEFAULT_WORK_GROUP_SIZE;
+    float bestMs = -1.0f;
+    for (unsigned int candidateIndex = 0; candidateIndex < numCandidates; candidateIndex++)
+    {
+        unsigned int workGroupSize = candidateSizes[candidateIndex];
+        if (!IsComputeWorkGroupSizeSupported(workGroupSize))
+        {
+            continue;
+        }
+
+        float updateMs = TimeWorkGroupSize(workGroupSize, layout, numParticles);
+        LogPrintf("work group size %u: %.4f ms\n", workGroupSize, updateMs);
+        if (updateMs > 0.0f && (bestMs < 0.0f || updateMs < bestMs))
+        {
+            bestMs = updateMs;
+            bestSize = workGroupSize;
+        }
+    }
+
+    if (bestMs > 0.0f)
+    {
+        std::ofstream tuningFile(filePath.c_str(), std::ios::trunc);
+        tuningFile << bestSize << "\n";
+    }
+
+    LogPrintf("using work group size %u\n", bestSize);
+    return bestSize;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "Particle.h"
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The compute shader's best work group size depends on the GPU (wavefront vs warp width,
+    register file size, and the like), so rather than guess, this times the particle update
+    with each of the candidate sizes (64, 128, 256, 512, 1024, limited by what the device
+    supports) and picks the fastest.
+
+    Tuning takes a couple of seconds, so the winner is saved to a file keyed by the GPU
+    (GL_VENDOR, GL_RENDERER, GL_VERSION) and the particle layout, and later runs on the same
+    GPU and driver just read the file.
+
+    The caller must have already created an OpenGL 4.4 context and loaded the functions.
+Creator:    John Cox (8-13-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int GetTunedWorkGroupSize(ParticleLayout layout, unsigned int numParticles,
+    bool forceRetune);
@@ -0,0 +1,274 @@
+#include "WorkStealingThreadPool.h"
+
+#include "ThreadPlacement.h"
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives members default values.  There are no workers until Init(...), and until then
+    ParallelFor(...) runs every task on the calling thread.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+WorkStealingThreadPool::WorkStealingThreadPool() :
+    _task(0),
+    _generation(0),
+    _busyWorkerCount(0),
+    _isStopping(false)
+{
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Calls Cleanup() in the event that the user forgot to call it themselves.  The workers must
+    be joined before the std::threads are destroyed, or the program is terminated.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+WorkStealingThreadPool::~WorkStealingThreadPool()
+{
+    this->Cleanup();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Starts the workers.  They sleep until there is a ParallelFor(...) to help with.
+Parameters:
+    workerCount     Threads besides the one that calls ParallelFor(...).  0 is one less than
+                    the number of hardware threads, so that the calling thread gets the last
+                    one.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void WorkStealingThreadPool::Init(unsigned int workerCount)
+{
+    this->Cleanup();
+    if (workerCount == 0)
+    {
+        // Note: hardware_concurrency() is allowed to say 0 if it doesn't know, and then the
+        // calling thread does everything.
+        unsigned int hardwareThreadCount = std::thread::hardware_concurrency();
+        workerCount = (hardwareThreadCount > 1) ? (hardwareThreadCount - 1) : 0;
+    }
+
+    // Note: The workers start out having seen generation 0, so that one that is slow to start
+    // still wakes up for the first ParallelFor(...).
+    _isStopping = false;
+    _busyWorkerCount = 0;
+    _generation = 0;
+    for (unsigned int queueIndex = 0; queueIndex < workerCount + 1; queueIndex++)
+    {
+        _queues.push_back(std::unique_ptr<TaskQueue>(new TaskQueue()));
+    }
+    for (unsigned int workerIndex = 0; workerIndex < workerCount; workerIndex++)
+    {
+        _workers.push_back(std::thread(&WorkStealingThreadPool::WorkerLoop, this, workerIndex));
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Wakes the workers up to stop, and waits for them.  Safe to call more than once.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void WorkStealingThreadPool::Cleanup()
+{
+    {
+        std::lock_guard<std::mutex> lock(_controlMutex);
+        _isStopping = true;
+    }
+    _startCondition.notify_all();
+    for (size_t workerIndex = 0; workerIndex < _workers.size(); workerIndex++)
+    {
+        _workers[workerIndex].join();
+    }
+    _workers.clear();
+    _queues.clear();
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters: None
+Returns:
+    The number of threads that ParallelFor(...) runs tasks on, counting the calling thread.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+unsigned int WorkStealingThreadPool::GetThreadCount() const
+{
+    return (unsigned int)_workers.size() + 1;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Runs task(0) through task(taskCount - 1) across the workers and the calling thread, and
+    returns once all of them are done.  The tasks may run in any order and at the same time,
+    so they must not write to anything that another task touches.
+
+    Note: Not re-entrant.  A task must not call ParallelFor(...) itself.
+Parameters:
+    taskCount   0 does nothing.
+    task        Called with the task's index.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void WorkStealingThreadPool::ParallelFor(unsigned int taskCount,
+    const std::function<void(unsigned int)> &task)
+{
+    if (taskCount == 0)
+    {
+        return;
+    }
+    if (_workers.empty())
+    {
+        for (unsigned int taskIndex = 0; taskIndex < taskCount; taskIndex++)
+        {
+            task(taskIndex);
+        }
+        return;
+    }
+
+    // one contiguous run of tasks per queue
+    unsigned int queueCount = (unsigned int)_queues.size();
+    for (unsigned int queueIndex = 0; queueIndex < queueCount; queueIndex++)
+    {
+        unsigned int firstTask = (unsigned int)(((size_t)taskCount * queueIndex) / queueCount);
+        unsigned int endTask =
+            (unsigned int)(((size_t)taskCount * (queueIndex + 1)) / queueCount);
+        TaskQueue &queue = *_queues[queueIndex];
+        std::lock_guard<std::mutex> lock(queue._mutex);
+        for (unsigned int taskIndex = firstTask; taskIndex < endTask; taskIndex++)
+        {
+            queue._taskIndices.push_back(taskIndex);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_controlMutex);
+        _task = &task;
+        _busyWorkerCount = (unsigned int)_workers.size();
+        _generation++;
+    }
+    _startCondition.notify_all();
+
+    // the calling thread's queue is the last one
+    this->RunTasks(queueCount - 1);
+
+    // every queue is empty now, but the workers may still be on their last tasks
+    std::unique_lock<std::mutex> lock(_controlMutex);
+    _finishCondition.wait(lock, [this]() { return _busyWorkerCount == 0; });
+    _task = 0;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    A worker thread.  Sleeps until ParallelFor(...) starts a new generation of tasks, helps
+    until there are no tasks left to take, and reports that it is done.
+
+    Note: ParallelFor(...) doesn't return until every worker has reported, so no worker can
+    miss a generation.
+Parameters:
+    queueIndex  The worker's own queue.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void WorkStealingThreadPool::WorkerLoop(unsigned int queueIndex)
+{
+    PlaceWorkerThread();
+    unsigned int seenGeneration = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_controlMutex);
+            _startCondition.wait(lock,
+                [&]() { return _isStopping || _generation != seenGeneration; });
+            if (_isStopping)
+            {
+                return;
+            }
+            seenGeneration = _generation;
+        }
+
+        this->RunTasks(queueIndex);
+
+        bool isLastWorker = false;
+        {
+            std::lock_guard<std::mutex> lock(_controlMutex);
+            _busyWorkerCount--;
+            isLastWorker = (_busyWorkerCount == 0);
+        }
+        if (isLastWorker)
+        {
+            _finishCondition.notify_one();
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Runs tasks until there are none left to take from any queue.
+Parameters:
+    queueIndex  The running thread's own queue.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+void WorkStealingThreadPool::RunTasks(unsigned int queueIndex)
+{
+    unsigned int taskIndex = 0;
+    while (this->TakeTask(queueIndex, &taskIndex))
+    {
+        (*_task)(taskIndex);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Takes the next task off the front of the thread's own queue, or if that is empty, steals
+    one off the back of another queue.  The victims are tried starting with the next queue
+    over, so the thieves don't all pile onto the same one.
+Parameters:
+    queueIndex          The running thread's own queue.
+    putTaskIndexHere    Self-explanatory.
+Returns:
+    False if every queue was empty, otherwise true.
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+bool WorkStealingThreadPool::TakeTask(unsigned int queueIndex, unsigned int *putTaskIndexHere)
+{
+    {
+        TaskQueue &ownQueue = *_queues[queueIndex];
+        std::lock_guard<std::mutex> lock(ownQueue._mutex);
+        if (!ownQueue._taskIndices.empty())
+        {
+            *putTaskIndexHere = ownQueue._taskIndices.front();
+            ownQueue._taskIndices.pop_front();
+            return true;
+        }
+    }
+
+    unsigned int queueCount = (unsigned int)_queues.size();
+    for (unsigned int offset = 1; offset < queueCount; offset++)
+    {
+        TaskQueue &victimQueue = *_queues[(queueIndex + offset) % queueCount];
+        std::lock_guard<std::mutex> lock(victimQueue._mutex);
+        if (!victimQueue._taskIndices.empty())
+        {
+            *putTaskIndexHere = victimQueue._taskIndices.back();
+            victimQueue._taskIndices.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
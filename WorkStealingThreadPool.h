@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    A small pool of worker threads for splitting a loop into tasks (see ParallelFor(...)).
+    Used by the particle manager's CPU backend (see ParticleManager::SetSimulationBackend(...)).
+
+    Every thread, including the one that called ParallelFor(...), has its own queue of task
+    indices.  The tasks are dealt out as one contiguous run per queue, so a thread works
+    through neighboring tasks (and neighboring memory) in order.  A thread whose queue runs dry
+    steals from the far end of another thread's queue instead of going idle, so a thread that
+    got the slow tasks, or that the OS took away for a while, doesn't hold up the rest.
+
+    Note: The queues are locked, not lock-free.  A task is meant to be thousands of items of
+    work, so a lock per task is nothing next to the task itself.
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+class WorkStealingThreadPool
+{
+public:
+    WorkStealingThreadPool();
+    ~WorkStealingThreadPool();
+    void Init(unsigned int workerCount);
+    void Cleanup();
+
+    unsigned int GetThreadCount() const;
+    void ParallelFor(unsigned int taskCount, const std::function<void(unsigned int)> &task);
+
+private:
+    struct TaskQueue
+    {
+        std::mutex _mutex;
+        std::deque<unsigned int> _taskIndices;
+    };
+
+    void WorkerLoop(unsigned int queueIndex);
+    void RunTasks(unsigned int queueIndex);
+    bool TakeTask(unsigned int queueIndex, unsigned int *putTaskIndexHere);
+
+    // one queue per worker, and the calling thread's is the last one
+    // Note: Held by pointer because a mutex can't be moved when the vector grows.
+    std::vector<std::thread> _workers;
+    std::vector<std::unique_ptr<TaskQueue>> _queues;
+
+    // the workers sleep on the start condition until the generation changes, and the caller
+    // sleeps on the finish condition until every worker has run out of tasks
+    std::mutex _controlMutex;
+    std::condition_variable _startCondition;
+    std::condition_variable _finishCondition;
+    const std::function<void(unsigned int)> *_task;
+    unsigned int _generation;
+    unsigned int _busyWorkerCount;
+    bool _isStopping;
+};
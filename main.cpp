@@ -7,124 +7,3056 @@
 // is, so don't put in an "Additional Library Directories" entry for it).
 // Build note: Also need to link glload/lib/glloadD.lib.
 #include "glload/include/glload/gl_4_4.h"
+#include "GlStateCache.h"
 #include "glload/include/glload/gl_load.hpp"
 
-// Build note: Must be included after OpenGL code (in this case, glload).
-// Build note: Also need to link freeglut/lib/freeglutD.lib.  However, the linker will try to 
-// find "freeglut.lib" (note the lack of "D") instead unless the following preprocessor 
-// directives are set either here or in the source-building command line (VS has a
-// "Preprocessor" section under "C/C++" for preprocessor definitions).
-// Build note: Also need to link winmm.lib (VS seems to know where it is, so don't put in an 
-// "Additional Library Directories" entry).
-#define FREEGLUT_STATIC
-#define _LIB
-#define FREEGLUT_LIB_PRAGMAS 0
-#include "freeglut/include/GL/freeglut.h"
-
 // this linking approach is very useful for portable, crude, barebones demo code, but it is 
 // better to link through the project building properties
 #pragma comment(lib, "glload/lib/glloadD.lib")
 #pragma comment(lib, "opengl32.lib")            // needed for glload::LoadFunctions()
-#pragma comment(lib, "freeglut/lib/freeglutD.lib")
-#ifdef WIN32
-#pragma comment(lib, "winmm.lib")               // Windows-specific; freeglut needs it
-#endif
 
-// for printf(...)
-#include <stdio.h>
+// the window, its context, and its events (see AppWindow.h)
+// Note: freeglut is included, and linked, in GlutAppWindow.cpp.
+#include "GlutAppWindow.h"
+#include "EglHeadlessWindow.h"
+
+// for LogPrintf(...), which is printf(...) without blocking
+#include "Log.h"
 
 // for basic OpenGL stuff
 #include "OpenGlErrorHandling.h"
+#include "ShaderProgramRegistry.h"
 #include "GenerateShader.h"
+#include "ShaderBinaryCache.h"
+#include "AssetPack.h"
 #include "ParticleManager.h"
+#include "GpuProfiler.h"
+#include "GpuHardwareCounters.h"
+#include "ParticleCostAttribution.h"
+#include "SimulationClock.h"
+#include "Benchmark.h"
+#include "ParticleValidation.h"
+#include "RngBenchmark.h"
+#include "WorkGroupTuner.h"
+#include "FrameStatsLog.h"
+#include "FrameGraphOverlay.h"
+#include "DensitySplatRenderer.h"
+#include "DensitySurfaceRenderer.h"
+#include "WeightedOitRenderer.h"
+#include "OverdrawVisualizer.h"
+#include "ParticleMultiViewport.h"
+#include "ParticleNeighborGrid.h"
+#include "ParticleGravityTree.h"
+#include "ParticleConstraintSolver.h"
+#include "ParticleSpatialQuery.h"
+#include "StableFluidSolver.h"
+#include "ParticleFieldTexture.h"
+#include "ParticleBoundarySdf.h"
+#include "ParticleSegmentBvh.h"
+#include "ShaderHotReload.h"
+#include "FramePrepPipeline.h"
+#include "FramePacing.h"
+#include "FrameCapture.h"
+#include "ParticleTrajectoryRecorder.h"
+#include "ParticleStatsReducer.h"
+#include "ParticleHeatmapExporter.h"
+#include "Camera2D.h"
+#include "FrameBudgetGovernor.h"
+#include "ScaledRenderTarget.h"
+#include "BloomFilter.h"
+#include "TraceTimeline.h"
+#include "GpuMemoryLedger.h"
+#include "SceneConfig.h"
+#include "InputEventLog.h"
+#include "SoakMonitor.h"
+#include "GpuClockMonitor.h"
+#include "ShaderVariantManifest.h"
+#include "MultiGpuSimulation.h"
+#include "ParticleStateSharedMemory.h"
+#include "ParticleStream.h"
+#include "ParticleEmissionImage.h"
+#include "GlCommandList.h"
+#include "FrameArena.h"
+#include "AllocationCounter.h"
+#include "WorkStealingThreadPool.h"
+#include "AsyncLoader.h"
+#include "MappedFile.h"
+#include "GlObjects.h"
+#include "ThreadPlacement.h"
+#include "LargeHostBuffer.h"
+#include "ParticleKeyframeRing.h"
+#include "ParticleInjectionRing.h"
+#include "ParticleDomainShard.h"
+#include "SharedTextureOutput.h"
+
+#include <string.h>     // strcmp, memset
+#include <stdlib.h>     // atoi, atof
+#include <memory>
+#include <math.h>       // fabsf
+#include <chrono>
+#include <thread>
+#include <atomic>
+
+
+ParticleManager gParticleManager;
+
+// made in main(), and the frame loop there runs until this says to stop
+// Note: "--headless" makes an EGL context with no window (see EglHeadlessWindow.h), and 
+// "--frames" stops the loop after that many frames, which a headless run needs to ever end.
+AppWindow *gAppWindow = 0;
+unsigned int gMaxFrameCount = 0;
+
+// set by "--compute-only" to skip drawing and swapping, so every frame is all simulation
+// Note: The steps aren't tied to real time unless "--real-time" says so; every frame runs the 
+// clock's most steps, as fast as the GPU takes them.  "--preview-every 10" still draws every 
+// 10th frame to see that it's working.  The throughput is printed every few seconds.
+bool gComputeOnly = false;
+bool gComputeOnlyRealTime = false;
+unsigned int gPreviewInterval = 0;
+std::chrono::high_resolution_clock::time_point gThroughputStart;
+unsigned int gThroughputStepCount = 0;
+
+// set by "--deterministic" to run the same simulation every time (see 
+// ParticleManager::SetDeterministic(...)), and "--seed 7" picks which one
+// Note: The steps aren't tied to real time either, like "--compute-only", and the particle 
+// checksum is printed at the end, so two runs with the same "--frames" can be compared.
+bool gDeterministic = false;
+unsigned int gRandomSeed = 0;
+
+// set by "--persistent 32" to run the small configuration with the persistent-threads kernel 
+// and that many work groups (see ParticleManager::SetPersistentThreads(...))
+unsigned int gPersistentWorkGroupCount = 0;
+
+// set by "--fused-emit" to send the particles out in the update pass instead of the emit pass 
+// (see ParticleManager::SetFusedEmitUpdate(...))
+bool gUseFusedEmit = false;
+
+// set by "--custom-update shaderCustomSwirl.glsl" to run that file's customUpdate(...) on 
+// every particle in the update (see ParticleKernelVariant::_customUpdateFilePath)
+std::string gCustomUpdateFilePath;
+
+// set by "--lod 4" to draw 1 in every 4 particles, by "--lod-density 2" to draw no more than 2 
+// particles per pixel, or by "--lod-budget 1.5" to keep the draw under 1.5ms of GPU time (see 
+// ParticleManager::SetLevelOfDetail(...))
+ParticleLodMode gLodMode = PARTICLE_LOD_OFF;
+float gLodValue = 0.0f;
+
+// set by "--amortize 4" to only integrate the particles that aren't drawn (the level of 
+// detail leaves them out, or the view culls them) every 4th update (see 
+// ParticleManager::SetUpdateAmortization(...))
+unsigned int gUpdateAmortization = 1;
+
+// turns the emission, the level of detail, the simulation rate, and the splat resolution down 
+// when the GPU's update and render times go over the budget, and back up when they fit again
+// (see FrameBudgetGovernor.h); "--frame-budget 10" sets the budget and "--no-governor" turns 
+// it off
+// Note: It is off when the run has to be repeatable ("--deterministic") or isn't paced to the
+// display ("--compute-only").  An explicit "--lod" mode keeps the level of detail for itself.
+bool gUseGovernor = true;
+float gFrameBudgetMs = 12.0f;
+const unsigned int SIMULATION_STEPS_PER_SECOND = 120;
+FrameBudgetGovernor gFrameBudgetGovernor;
+float gEmissionScale = 1.0f;
+std::vector<unsigned int> gBaseEmitCounts;
+
+// the particles are drawn into a framebuffer this fraction of the window's size and stretched 
+// over it (see ScaledRenderTarget.h); "--render-scale 0.75" starts it there, the governor 
+// turns it down from there, and "--sharpen" sharpens the stretch
+// Note: The density splat has its own smaller image instead (see 
+// DensitySplatRenderer::SetResolutionScale(...)).
+ScaledRenderTarget gScaledRenderTarget;
+float gBaseRenderScale = 1.0f;
+float gRenderScale = 1.0f;
+bool gSharpenUpscale = false;
+
+// "--target-format r11g11b10f" (or "r16f" or "rgb565") draws the particles into a smaller 
+// color format than the window's RGBA8 (see ScaledRenderFormat), at every render scale
+ScaledRenderFormat gScaledRenderFormat = SCALED_RENDER_FORMAT_RGBA8;
+
+// "--trails 0.9" leaves motion trails behind the particles by fading each frame into the next 
+// instead of clearing it (see ScaledRenderTarget::SetTrailFade(...)), and the 'm' key toggles 
+// them (at 0.9 if there was no "--trails")
+float gTrailFade = 0.0f;
+
+// "--bloom 0.8" adds that much of a glow around the bright parts of the scaled render target's 
+// image (see BloomFilter.h), and "--bloom-threshold 0.5" sets how bright they must be
+BloomFilter gBloomFilter;
+float gBloomIntensity = 0.0f;
+float gBloomThreshold = 0.5f;
+
+// set by "--capture capture.y4m" to record from the start, and toggled with the 'r' key (see 
+// FrameCapture.h)
+// Note: A file that doesn't end in ".y4m" (ex: "capture.mp4") is encoded by ffmpeg.
+FrameCapture gFrameCapture;
+std::string gCapturePath = "capture.y4m";
+bool gCaptureAtStart = false;
+
+// set by "--shared-output particles" to hand every frame to other processes (ex: OBS, a 
+// compositor) as a shared texture, with no readback (see SharedTextureOutput.h)
+SharedTextureOutput gSharedTextureOutput;
+std::string gSharedOutputName;
+
+// set by "--load-snapshot particles.snap" to start from a saved state instead of an empty 
+// pool, and the 'p' key saves the state to the same file (see ParticleManager::SaveSnapshot(...))
+std::string gSnapshotPath = "particles.snap";
+bool gLoadSnapshotAtStart = false;
+
+// the 'o' key loads the snapshot again without stalling the frame: the file is read on a 
+// worker and uploaded a piece at a time, in at most "--load-budget 2" milliseconds of each 
+// frame (see AsyncLoader.h), and "--load-workers 0" reads it on the GL thread instead
+AsyncLoader gAsyncLoader;
+float gAsyncLoadBudgetMs = 2.0f;
+unsigned int gAsyncLoadWorkerCount = 1;
+
+// set by "--gl-core 2", "--gl-priority high" (or "realtime"), and "--worker-numa-node 1" (or 
+// "gpu") to keep the GL thread on one core and ahead of the workers, and the workers near 
+// the GPU (see ThreadPlacement.h); "--frame-log" logs the frame time's jitter to compare
+ThreadPlacementSettings gThreadPlacementSettings = GetDefaultThreadPlacement();
+
+// set by "--large-pages" to put the big CPU-side buffers (particle staging and readback, the 
+// trajectory encoder, the capture's planes, the async snapshot) on the OS's large pages, 
+// with a fallback to ordinary ones (see LargeHostBuffer.h)
+bool gUseLargePages = false;
+
+// set by "--keyframes 32 30" to keep a keyframe of the particles in video memory every 30 
+// updates, 32 of them, and the '[' key rewinds a second's worth of updates (see 
+// ParticleKeyframeRing.h); the replay is the same as the first run with "--deterministic"
+ParticleKeyframeRing gParticleKeyframeRing;
+unsigned int gKeyframeCount = 0;
+unsigned int gUpdatesPerKeyframe = 30;
+static const unsigned int KEYFRAME_REWIND_UPDATES = 60;
+
+// set by "--record-trajectory particles.traj" to record every particle's position from the 
+// start, and toggled with the 'j' key (see ParticleTrajectoryRecorder.h)
+// Note: Its program isn't built until the first recording (see StartTrajectoryRecording()).
+ParticleTrajectoryRecorder gParticleTrajectoryRecorder;
+std::string gTrajectoryPath = "particles.traj";
+bool gRecordTrajectoryAtStart = false;
+std::string gTrajectoryShaderDefines;
+bool gIsTrajectoryRecorderReady = false;
+
+// the whole pool's live count, speeds, and bounding box, reduced on the GPU every 
+// "--stats-every 30" updates and written to the frame stats log (see ParticleStatsReducer.h)
+ParticleStatsReducer gParticleStatsReducer;
+unsigned int gStatsInterval = 30;
+
+// set by "--heatmap heatmap.npy" to export a "--heatmap-size 256" square histogram of the 
+// particles over the window every "--heatmap-every 1" seconds (see ParticleHeatmapExporter.h)
+ParticleHeatmapExporter gParticleHeatmapExporter;
+std::string gHeatmapPath;
+int gHeatmapSize = 256;
+float gHeatmapIntervalSec = 1.0f;
+
+// set by "--publish-state particles" to put every readback of the whole pool in shared memory 
+// by that name for other processes on this machine (see ParticleStateSharedMemory.h)
+ParticleStatePublisher gParticleStatePublisher;
+std::string gPublishStateName;
+
+// set by "--stream-server 7400" to stream the particles to remote viewers, "--stream-bits 12" 
+// bits per axis at up to "--stream-fps 30" frames a second (see ParticleStream.h), and by 
+// "--stream-client host:7400" to be one of those viewers instead of simulating, or with a 
+// comma list of a distributed run's nodes, to draw all of them together
+// Note: The stream is fed by a recorder of its own, with no file, so that the 'j' key's 
+// recordings don't start or stop it.
+ParticleStreamServer gParticleStreamServer;
+ParticleTrajectoryRecorder gParticleStreamRecorder;
+unsigned short gStreamPort = 0;
+unsigned int gStreamBits = 12;
+float gStreamFps = 30.0f;
+ParticleStreamGather gParticleStreamGather;
+std::string gStreamClientAddress;
+std::vector<Particle> gStreamedParticles;
+
+// set by "--trace trace.json" to write a timeline of the CPU's and the GPU's scopes from start 
+// to exit (see TraceTimeline.h)
+std::string gTracePath;
+
+// how long each phase of startup took, from the start of main() to the end of the first 
+// frame, which is printed once that frame is on screen (see MarkStartupPhase(...))
+std::chrono::high_resolution_clock::time_point gStartupStart;
+std::chrono::high_resolution_clock::time_point gStartupPhaseStart;
+std::string gStartupBreakdown;
+bool gIsStartupDone = false;
+
+// set by "--gpu-memory-budget 512" to hold everything that is tracked in the GPU memory 
+// ledger to 512MB (see GpuMemoryLedger.h); 0 only holds it to what the device has free
+unsigned int gGpuMemoryBudgetMb = 0;
+
+// the scene that Init() builds (see SceneConfig.h): the defaults, then "--config scene.ini", 
+// then every "--set section.key=value" in order
+// Note: With a config file, the frame prep worker checks the file a few times a second, and 
+// when it is saved, the worker reads it again and Display() applies what changed.  The GL 
+// thread's copy is what was last applied, and the worker only touches the file's time.
+std::string gSceneConfigPath;
+std::vector<std::string> gSceneConfigOverrides;
+SceneConfig gSceneConfig;
+long long gPrepSceneConfigTime = 0;
+
+// set by "--gpus 2" to split the particles across that many GPUs; the display's GPU runs 
+// gParticleManager, and each other one runs a pool like it (see MultiGpuSimulation.h)
+unsigned int gGpuCount = 1;
+MultiGpuSimulation gMultiGpuSimulation;
+
+// how the particles are blended into the frame
+// Note: Every particle is at the same depth, so the depth test never rejects anything and 
+// opaque white points carry no information about how many particles landed on a pixel.  The 
+// additive mode skips depth entirely and lets overlapping particles add up, so dense areas 
+// glow.  The opaque mode is the original depth-tested look and is kept for comparison.  The 
+// density splat mode skips the rasterizer and counts particles per pixel in a compute shader 
+// (see DensitySplatRenderer.h).  The weighted OIT mode draws translucent, colored particles 
+// that cover what is behind them, in any order, with no sort (see WeightedOitRenderer.h).
+enum ParticleRenderMode
+{
+    PARTICLE_RENDER_MODE_ADDITIVE = 0,
+    PARTICLE_RENDER_MODE_OPAQUE_DEPTH_TESTED,
+    PARTICLE_RENDER_MODE_DENSITY_SPLAT,
+    PARTICLE_RENDER_MODE_WEIGHTED_OIT,
+};
+ParticleRenderMode gRenderMode = PARTICLE_RENDER_MODE_ADDITIVE;
+DensitySplatRenderer gDensitySplatRenderer;
+WeightedOitRenderer gWeightedOitRenderer;
+
+// set by "--surface" to draw the density splat as a shaded liquid surface instead of as 
+// brightness, and by "--contours" to also outline it with marching squares (see 
+// DensitySurfaceRenderer.h)
+// Note: The splat is made at a fraction of the render scale, since the blur smooths it anyway 
+// and everything after the splat goes with its pixels.
+bool gUseDensitySurface = false;
+bool gDrawSurfaceContours = false;
+const float DENSITY_SURFACE_RESOLUTION_SCALE = 0.25f;
+DensitySurfaceRenderer gDensitySurfaceRenderer;
+
+// set by "--overdraw" to draw a heat map of how many fragments landed on each pixel in place of 
+// the particles (see OverdrawVisualizer.h), and by "--pipeline-stats" to print how many 
+// invocations and primitives the update and the render cost (see 
+// GpuProfiler::EnablePipelineStatistics(...))
+// Note: The density splat doesn't rasterize the particles, so it has no overdraw to show.
+bool gShowOverdraw = false;
+bool gUsePipelineStatistics = false;
+OverdrawVisualizer gOverdrawVisualizer;
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    renderMode  Self-explanatory.
+Returns:
+    True if the render mode needs a depth buffer, otherwise false.
+Exception:  Safe
+Creator:    John Cox (8-15-2016)
+-----------------------------------------------------------------------------------------------*/
+static bool RenderModeNeedsDepth(ParticleRenderMode renderMode)
+{
+    return renderMode == PARTICLE_RENDER_MODE_OPAQUE_DEPTH_TESTED;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    renderMode  Self-explanatory.
+Returns:
+    True if the level of detail should make up for the particles that it doesn't draw with 
+    bigger ones instead of brighter ones (see ParticleLodSettings), which is whenever the 
+    particles don't add up: an opaque particle can't get brighter, and a translucent one's 
+    color is averaged.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static bool RenderModeScalesPointSize(ParticleRenderMode renderMode)
+{
+    return renderMode == PARTICLE_RENDER_MODE_OPAQUE_DEPTH_TESTED || 
+        renderMode == PARTICLE_RENDER_MODE_WEIGHTED_OIT;
+}
+
+// GPU timing of each pass, printed every few seconds
+GpuProfiler gGpuProfiler;
+unsigned int gUpdateScopeId;
+unsigned int gRenderScopeId;
+unsigned int gSortScopeId;
+unsigned int gInteractScopeId;
+unsigned int gGravityScopeId;
+unsigned int gConstraintScopeId;
+unsigned int gFluidScopeId;
+unsigned int gStatsScopeId;
+unsigned int gDemScopeId = 0;
+
+// set by "--hw-counters" to sample the GPU's own counters over the update and the render, 
+// printed with the GPU timings (see GpuHardwareCounters.h), and by "--hw-counter-filter 
+// l3,occupancy" to pick which ones
+// Note: Without the flag, or without a driver that has counters, there are no counters and 
+// the scopes do nothing.
+bool gUseHardwareCounters = false;
+std::string gHardwareCounterFilter;
+GpuHardwareCounters gHardwareCounters;
+unsigned int gUpdateCounterScopeId = 0;
+unsigned int gRenderCounterScopeId = 0;
+
+// set by "--cost-attribution" to count each emitter's particle steps in the update and print 
+// which emitters and systems the update's time goes to, with the GPU timings (see 
+// ParticleCostAttribution.h)
+bool gUseCostAttribution = false;
+ParticleCostAttribution gParticleCostAttribution;
+
+// set by "--low-discrepancy-emission" to spread each update's emissions evenly over the spawn 
+// disk and the directions instead of randomly (see ParticleManager::SetLowDiscrepancyEmission(...))
+bool gUseLowDiscrepancyEmission = false;
+
+// set by "--emit-rate 12000" to emit that many particles a second, whatever the frame rate, 
+// shared between the emitters in proportion to their quotas, and spread over each frame's 
+// time instead of in a ring at the emitter (see ParticleManager::SetEmissionRates(...))
+float gEmissionRatePerSec = 0.0f;
+
+// set by "--inset x y zoom" (up to 3 times) to draw zoomed views of the same particles down 
+// the right side of the window, which go with the window's draw if the GPU can broadcast the 
+// points to several viewports (see ParticleMultiViewport.h)
+// Note: Only the plain point and additive modes have insets.  The other render modes' 
+// targets don't have the window's clear color to put behind them.
+ParticleMultiViewport gParticleMultiViewport;
+bool gIsInsetBroadcast = false;
+
+// set by "--shared-windows 2" to show the particles in more windows (ex: on other monitors), 
+// which draw the same buffers with the main window's context, so the simulation is stepped 
+// once and each one only costs its own draw and swap (see AppWindow::AddSharedWindow(...))
+// Note: Only the point, additive, and opaque render modes draw in them.  They have the main 
+// window's camera, stretched to their size.
+unsigned int gSharedWindowCount = 0;
+
+// kept between frames so that taking the driver's performance warnings doesn't allocate
+std::vector<DebugMessage> gDebugPerformanceMessages;
+
+// runs the simulation at a fixed rate regardless of the frame rate
+SimulationClock gSimulationClock;
+
+// set by "--retune" to time the compute work group sizes again instead of using the saved one
+bool gForceRetune = false;
+
+// set by "--vertex-pulling" to have the particle vertex shader read the particle buffers 
+// itself instead of through vertex attributes (see ParticleManager::GetRenderShaderDefines(...))
+bool gUseVertexPulling = false;
+
+// set by "--quads" to draw each particle as an instanced quad instead of a point sprite (see 
+// ParticleManager::GetQuadRenderShaderDefines(...))
+bool gUseQuads = false;
+
+// set by "--smooth-points" to antialias the point sprites' edges in the fragment shader 
+// instead of with MSAA (see ParticleManager::GetSmoothPointRenderShaderDefines(...))
+bool gUseSmoothPoints = false;
+
+// set by "--flipbook" to texture each particle with an animated flipbook that steps through its
+// frames as the particle ages (see ParticleManager::GetFlipbookRenderShaderDefines(...))
+bool gUseFlipbook = false;
+
+// set by "--sort" to sort the particles along a Morton curve every so often, which keeps 
+// particles that are near each other in the window near each other in the particle buffers 
+// (see ParticleManager::SetParticleSort(...))
+bool gSortParticles = false;
+
+// set by "--interact" to have nearby particles push each other apart and pull each other 
+// together, with a grid to find the neighbors (see ParticleNeighborGrid.h)
+bool gUseParticleInteractions = false;
+ParticleNeighborGrid gParticleNeighborGrid;
+
+// set by "--sph" to make the interactions a smoothed-particle hydrodynamics fluid instead of 
+// the pairwise push and pull (see ParticleNeighborGrid::SetInteractionModel(...))
+// Note: It also turns on the interactions and the Morton sort, which keeps the grid's gather 
+// reading the particle buffers close to in order.
+bool gUseSphFluid = false;
+
+// set by "--boids" to make the interactions flocking, where each particle steers by its 
+// nearest few neighbors (see ParticleNeighborGrid::SetBoidsSteering(...)); also turns on the 
+// interactions
+bool gUseBoids = false;
+
+// set by "--dem" to make the interactions collisions, where overlapping particles are pushed 
+// apart and bounce (see ParticleNeighborGrid::SetDemContact(...)); also turns on the 
+// interactions
+bool gUseDem = false;
+
+// set by "--gravity" to have every particle pull on every other, with a tree built over them 
+// every frame so that the far ones pull a whole node at a time (see ParticleGravityTree.h)
+bool gUseGravityTree = false;
+ParticleGravityTree gParticleGravityTree;
+
+// set by "--ropes" to link some of the particles into chains that are solved on the GPU after 
+// every update and drawn as ribbons (see ParticleConstraintSolver.h)
+bool gUseConstraints = false;
+ParticleConstraintSolver gParticleConstraintSolver;
+
+// set by "--forces" to have a gravity well, a vortex, and drag act on the particles (see 
+// ParticleForceField.h)
+bool gUseForceFields = false;
+
+// set by "--field-texture" to bake the well and the vortex into a small texture that the 
+// update samples instead of evaluating them per particle (see ParticleFieldTexture.h)
+bool gUseFieldTexture = false;
+ParticleFieldTexture gParticleFieldTexture;
+
+// set by "--fluid-grid" to have a small grid of smoke, stirred by a couple of circling jets, 
+// carry the particles along (see StableFluidSolver.h); it takes the place of the field 
+// texture if both are set
+bool gUseFluidGrid = false;
+StableFluidSolver gStableFluidSolver;
+
+// set by "--queries" to count the particles around the pointer a couple of times a second, 
+// and find the nearest few to it, with spatial queries over the neighbor grid (see 
+// ParticleSpatialQuery.h); the grid is built for them even without the interactions
+bool gUseSpatialQueries = false;
+ParticleSpatialQuery gParticleSpatialQuery;
+static const unsigned int SPATIAL_QUERY_INTERVAL_FRAMES = 30;
+
+// set by "--merge-dense" to merge the particles in crowded cells of the neighbor grid into 
+// fewer, heavier ones, and split them again when the crowd thins out (see 
+// ParticleNeighborGrid::SetMerging(...)); the grid is built for it even without the 
+// interactions
+bool gMergeDenseCells = false;
+
+// set by "--sdf-boundary" to keep the particles in a rounded box with a couple of obstacles in 
+// it (see ParticleBoundarySdf.h)
+bool gUseSdfBoundary = false;
+ParticleBoundarySdf gParticleBoundarySdf;
+
+// set by "--compressed-textures" to have the update sample BC4 and BC5 copies of the SDF 
+// boundary and the field texture, which don't change after they are made (see 
+// TextureCompression.h)
+bool gUseCompressedTextures = false;
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Makes the "--sdf-boundary" shape: everything outside of a box with rounded corners that 
+    almost fills the window is solid, and so are 2 discs inside of it, off to the side of the 
+    emitter.
+Parameters:
+    width       The texels across the window.
+    height      Self-explanatory.
+Returns:
+    A mask for ParticleBoundarySdf::SetShape(...).
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+static std::vector<unsigned char> MakeDemoBoundaryMask(int width, int height)
+{
+    const float boxHalfSize = 0.95f;
+    const float cornerRadius = 0.25f;
+    const glm::vec2 discCenters[2] = { glm::vec2(-0.4f, -0.3f), glm::vec2(+0.6f, -0.5f) };
+    const float discRadii[2] = { 0.2f, 0.12f };
+
+    std::vector<unsigned char> mask(width * height, 0);
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            // the texel's center in window coordinates
+            glm::vec2 position(((x + 0.5f) / width) * 2.0f - 1.0f, 
+                ((y + 0.5f) / height) * 2.0f - 1.0f);
+
+            // a rounded box is a smaller box grown by the corner radius
+            float cornerX = fabsf(position.x) - (boxHalfSize - cornerRadius);
+            float cornerY = fabsf(position.y) - (boxHalfSize - cornerRadius);
+            cornerX = (cornerX > 0.0f) ? cornerX : 0.0f;
+            cornerY = (cornerY > 0.0f) ? cornerY : 0.0f;
+            bool isSolid = ((cornerX * cornerX) + (cornerY * cornerY)) > 
+                (cornerRadius * cornerRadius);
+
+            for (int discIndex = 0; discIndex < 2; discIndex++)
+            {
+                glm::vec2 toDisc = discCenters[discIndex] - position;
+                float distSqr = (toDisc.x * toDisc.x) + (toDisc.y * toDisc.y);
+                isSolid = isSolid || (distSqr < (discRadii[discIndex] * discRadii[discIndex]));
+            }
+            mask[(y * width) + x] = isSolid ? 1 : 0;
+        }
+    }
+    return mask;
+}
+
+// set by "--segments" to scatter a grid of small polygonal pegs for the particles to bounce 
+// off of (see ParticleSegmentBvh.h)
+bool gUseSegmentBvh = false;
+ParticleSegmentBvh gParticleSegmentBvh;
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Makes the "--segments" shape: a 16x16 grid of pegs across the window, each a 16-sided 
+    polygon, with none of them near the emitter so that no particle starts inside one.  That 
+    is a few thousand segments, which is far more than the update could test one at a time.
+Parameters:
+    clearCenter     Where to leave room for the emitter.
+    clearRadius     Self-explanatory.
+Returns:
+    Segments for ParticleSegmentBvh::SetSegments(...).
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+static std::vector<ParticleSegment> MakeDemoSegments(const glm::vec2 &clearCenter, 
+    float clearRadius)
+{
+    const int pegsPerSide = 16;
+    const int sidesPerPeg = 16;
+    const float pegRadius = 0.025f;
+    const float twoPi = 6.28318530718f;
+
+    std::vector<ParticleSegment> segments;
+    segments.reserve(pegsPerSide * pegsPerSide * sidesPerPeg);
+    for (int y = 0; y < pegsPerSide; y++)
+    {
+        for (int x = 0; x < pegsPerSide; x++)
+        {
+            // every other row is shifted by half a peg, like a pachinko board
+            float shift = (y % 2 == 0) ? 0.0f : 0.5f;
+            glm::vec2 pegCenter(((x + 0.25f + shift) / pegsPerSide) * 1.8f - 0.9f, 
+                ((y + 0.5f) / pegsPerSide) * 1.8f - 0.9f);
+            glm::vec2 toClearCenter = clearCenter - pegCenter;
+            float clearDist = clearRadius + pegRadius;
+            if (((toClearCenter.x * toClearCenter.x) + (toClearCenter.y * toClearCenter.y)) < 
+                (clearDist * clearDist))
+            {
+                continue;
+            }
+
+            for (int side = 0; side < sidesPerPeg; side++)
+            {
+                float startAngle = (twoPi * side) / sidesPerPeg;
+                float endAngle = (twoPi * (side + 1)) / sidesPerPeg;
+                ParticleSegment segment;
+                segment._start = pegCenter + 
+                    (pegRadius * glm::vec2(cosf(startAngle), sinf(startAngle)));
+                segment._end = pegCenter + (pegRadius * glm::vec2(cosf(endAngle), sinf(endAngle)));
+                segments.push_back(segment);
+            }
+        }
+    }
+    return segments;
+}
+
+// set by "--emit-image logo.ppm" to start the particles on the image's bright pixels instead 
+// of in a disk (see ParticleEmissionImage.h)
+std::string gEmissionImagePath;
+ParticleEmissionImage gParticleEmissionImage;
+
+// set by "--cpu" to simulate the particles on the CPU's threads instead of in the compute 
+// shader (see ParticleManager::SetSimulationBackend(...))
+bool gUseCpuSimulation = false;
+
+// set by "--split" to simulate some of the emitters in the compute shader and the rest on the 
+// CPU's threads at the same time, with the split balanced by the profiler's times (see 
+// ParticleManager::SetSplitProfiler(...))
+bool gUseSplitSimulation = false;
+unsigned int gSplitGpuScopeId = 0;
+
+// set by "--frame-log" to write every frame's CPU time and particle counts to a CSV file
+bool gLogFrameStats = false;
+FrameStatsLog gFrameStatsLog;
+
+// set by "--record-input session.input" to record the window's input and the scene config's 
+// changes, frame by frame, and by "--replay-input session.input" to run them again instead of 
+// the window's (see InputEventLog.h)
+// Note: A replay starts from the recorded scene and, if the recording was "--deterministic", 
+// with its seed, and it stops after the recorded number of frames.  The other flags aren't 
+// recorded, so they have to be the same, and the orbit ("--orbit") keeps going around the 
+// center that it started with through a replayed scene change.
+std::string gInputRecordPath;
+std::string gInputReplayPath;
+InputEventLog gInputEventLog;
+
+// set by "--soak 8" to run for 8 hours and fail if anything grows that shouldn't (see 
+// SoakMonitor.h), and by "--soak-interval 60" to sample every 60 seconds
+// Note: The run's exit code is 2 if the soak failed, so a script can tell.
+double gSoakHours = 0.0;
+double gSoakIntervalSec = 60.0;
+SoakMonitor gSoakMonitor;
+
+// set by "--power-save 30" to cap the frame rate at 30 with sleeps instead of spinning (see 
+// FrameRateLimiter in FramePacing.h), and by "--idle-fps 5" for the rate while the window 
+// is minimized or covered
+// Note: While the window can't be seen, or no one has touched the keyboard or the mouse for 
+// POWER_SAVE_UNTOUCHED_SEC, the simulation also takes half as many steps of twice the 
+// length, unless the governor owns the step or the run is deterministic or a replay.  The 
+// GPU's power is sampled (see GpuClockMonitor.h), where it can be read, and the energy per 
+// displayed frame is logged every POWER_SAVE_REPORT_SEC.
+float gPowerSaveFps = 0.0f;
+float gIdleFps = 5.0f;
+FrameRateLimiter gFrameRateLimiter;
+GpuClockMonitor gPowerMonitor;
+double gLastInputTimeMs = 0.0;
+bool gIsCoarseStepping = false;
+double gPowerSumW = 0.0;
+unsigned int gPowerSampleCount = 0;
+double gPowerReportStartMs = 0.0;
+unsigned int gPowerReportFrameCount = 0;
+const double POWER_SAVE_UNTOUCHED_SEC = 30.0;
+const double POWER_SAVE_REPORT_SEC = 10.0;
+const unsigned int POWER_SAVE_SAMPLE_FRAMES = 30;
+unsigned int gFrameIndex = 0;
+
+// a graph of the recent frame times, toggled with the 'g' key
+// Note: The overlay borrows a program, so that program is kept here for cleanup.
+FrameGraphOverlay gFrameGraphOverlay;
+bool gShowFrameGraph = false;
+
+// rebuilds the programs when their shader files are saved (see ShaderHotReload.h)
+ShaderHotReloader gShaderHotReloader;
+
+// set by "--orbit" to move every emitter's center around a small circle, a few seconds a lap
+bool gOrbitEmitters = false;
+
+// set by "--emitter-paths" to have the compute shader move the emitters along figure 8s and a 
+// spline loop instead, with no per-frame work on the CPU (see ParticleEmitterPath)
+bool gUseEmitterPaths = false;
+
+// set by "--mouse" to make the first emitter follow the mouse and send particles out, with the 
+// right button pulling the particles in and the middle one pushing them away (see 
+// ParticlePointerInput)
+// Note: The mouse goes straight into the next dispatch's parameter block, with nothing 
+// queued, so the frames in flight are the only lag.  "--low-latency" cuts those to 1.
+bool gUsePointerInput = false;
+ParticlePointerInput gPointerInput;
+
+// set by "--bursts" to send a burst out of every emitter when the space bar is pressed (see 
+// ParticleManager::TriggerBurst(...))
+bool gUseBursts = false;
+
+// set by "--sub-emitters" to turn every other emitter into fireworks: its particles burst into
+// sparks from the next emitter when they expire or leave (see ParticleSubEmitter)
+bool gUseSubEmitters = false;
+
+// set by "--inject" to stream a spiral of particles into the first emitter from a thread of 
+// its own, about a million a second, through the injection ring (see 
+// ParticleManager::SetInjectionRing(...))
+bool gUseInjection = false;
+ParticleInjectionRing gParticleInjectionRing;
+std::thread gInjectionThread;
+std::atomic<bool> gIsInjectionStopping(false);
+
+// set by "--shard 1 node0:7500,node1:7500" to simulate the second of two slabs of a run that 
+// is split across machines, handing the particles that leave it to the neighbors and taking 
+// theirs in through the injection ring (see ParticleDomainShard.h)
+bool gUseDomainShard = false;
+ParticleDomainSettings gDomainSettings = GetDefaultParticleDomainSettings();
+ParticleDomainShard gParticleDomainShard;
+
+// set by "--cull-draw-groups" to take a draw group whose bounds are off the screen out of the 
+// draw as a whole (see ParticleManager::SetDrawGroupCulling(...))
+bool gCullDrawGroups = false;
+
+// set by "--sleep" to let the particles that come to rest fall asleep and skip their updates 
+// until something pushes them (see ParticleManager::SetSleep(...))
+bool gUseSleep = false;
+
+// set by "--sparse-capacity 100000000" to reserve room in the pool for that many particles 
+// while only the emitters' particles get memory (see PARTICLE_BUFFER_ACCESS_SPARSE)
+unsigned int gSparsePoolCapacity = 0;
+
+// set by "--bindless" to hand the particle manager's textures to its shaders as resident 
+// handles instead of binding them every frame (see ParticleManager::SetBindlessTextures(...))
+bool gUseBindlessTextures = false;
+
+// set by "--double-buffer" to draw a copy of the last update's particles while the next update 
+// works on the originals (see ParticleManager::SetDoubleBufferedRendering(...))
+bool gUseDoubleBufferedRendering = false;
+
+// cleared by "--no-gl-state-cache" to make every bind and enable that the state cache would 
+// skip, for comparing the frame's CPU time with and without it (see GlStateCache.h)
+bool gUseGlStateCache = true;
+
+// set by "--dump-shader-sources" to write out every compute variant's source for the offline 
+// SPIR-V step (see ShaderBinaryCache.h)
+bool gDumpShaderSources = false;
+
+// set by "--shader-variants file" to add every program that this run builds to a manifest, 
+// which "--precompile-shaders" then builds into the binary cache (see ShaderVariantManifest.h)
+std::string gShaderVariantsPath;
+
+// set by "--asset-pack file" to load the shaders, the emission image, and the snapshot from one 
+// mapped pack before looking on the disk, and by "--write-asset-pack file" to write one of 
+// everything that this run loaded (see AssetPack.h)
+std::string gAssetPackPath;
+std::string gWriteAssetPackPath;
+
+// works out the next frame's emitters and stats on a worker while the GPU draws this one (see 
+// FramePrepPipeline.h), unless "--no-prep-thread" puts it back on the GL thread
+// Note: The worker has its own copy of the emitters as they were at the end of Init(), and 
+// only it touches the copy.  It is also the only one to push to the frame stats log, which 
+// only allows one producer.
+bool gUseFramePrepThread = true;
+FramePrepPipeline gFramePrepPipeline;
+std::vector<ParticleEmitter> gPrepBaseEmitters;
+float gSimulationTimeSec = 0.0f;
+bool gHasFinishedSample = false;
+FrameSample gFinishedSample;
+
+// set by "--prep-record-threads 4" to split the frame prep's per-emitter work across that many 
+// threads besides the prep worker, each recording its emitters' changes into its own command 
+// list for the GL thread (see GlCommandList.h)
+unsigned int gPrepRecordThreadCount = 0;
+WorkStealingThreadPool gPrepThreadPool;
+
+// set by "--count-allocations" to log every frame after the warm-up that allocates from the 
+// heap on any thread, which a frame in the steady state shouldn't (see FrameArena.h)
+// Note: Only the first few frames are logged, so that a leak doesn't flood the log, but all 
+// of them are counted for the summary at the end.
+bool gCountAllocations = false;
+const unsigned int ALLOCATION_COUNT_WARMUP_FRAMES = 120;
+const unsigned int ALLOCATING_FRAMES_LOGGED = 10;
+unsigned int gAllocatingFrameCount = 0;
+unsigned long long gSteadyStateAllocationCount = 0;
+
+// set by "--vsync", "--no-vsync", and "--adaptive-vsync", and cycled with the 'v' key
+SwapIntervalMode gSwapIntervalMode = SWAP_INTERVAL_DRIVER_DEFAULT;
+
+// set to 1 frame by "--low-latency", and cycled with the 'l' key (see FramePacing.h)
+// Note: "--uncapped" turns vsync off and leaves this at no cap, for the most throughput.
+FramePacer gFramePacer;
+unsigned int gMaxFramesInFlight = 0;
+
+// dragging with the left mouse button pans, the wheel zooms about the mouse, 'z' and 'x' zoom 
+// about the middle of the window, and '0' goes back to the whole window
+// Note: With culling on (toggled with the 'k' key), the particles that are off the screen are 
+// still updated but are left out of the draw.
+Camera2D gCamera;
+bool gCullOffscreenParticles = true;
+bool gIsPanning = false;
+int gPanLastX = 0;
+int gPanLastY = 0;
+
+// one emitter's new values, recorded by the frame prep and applied on the GL thread
+struct PreparedEmitter
+{
+    unsigned int _emitterIndex;
+    ParticleEmitter _emitter;
+};
+
+// the governor's scale, which is defined with the rest of the governor below
+ParticleEmitter ScaleEmission(unsigned int emitterIndex, const ParticleEmitter &emitter);
+void ApplyEmissionRates();
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Gives the particle manager an emitter that the frame prep worked out, with the governor's 
+    emission scale.  Called by the GL thread when it executes the prep's command lists.
+Parameters:
+    prepared    Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static void ApplyPreparedEmitter(const PreparedEmitter &prepared)
+{
+    gParticleManager.SetEmitter(prepared._emitterIndex, 
+        ScaleEmission(prepared._emitterIndex, prepared._emitter));
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Prepares a frame's parameters for the GL thread (see FramePrepPipeline.h).  Runs on the 
+    frame prep worker, so it makes no GL calls.
+
+    With "--orbit", every emitter's center is put on its spot of a circle around where it 
+    started, the emitters spread out evenly around it.  The emitters are split into one 
+    contiguous run per thread of the prep's pool, and each run records into its own command 
+    list, so the GL thread applies them in emitter order however the threads ran.  The 
+    finished frame's sample, if there is one, is logged and turned into the frame graph's next 
+    point.
+Parameters:
+    input       Self-explanatory.
+    output      Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-16-2016)
+-----------------------------------------------------------------------------------------------*/
+static void PrepareFrame(const FramePrepInput &input, FramePrepOutput *output)
+{
+    TRACE_SCOPE("PrepareFrame");
+    const float orbitRadius = 0.3f;
+    const float orbitPeriodSec = 8.0f;
+    const float twoPi = 6.28318530718f;
+
+    output->_frameIndex = input._frameIndex;
+    unsigned int taskCount = gPrepThreadPool.GetThreadCount();
+    output->_commandLists.resize(taskCount);
+    for (unsigned int taskIndex = 0; taskIndex < taskCount; taskIndex++)
+    {
+        output->_commandLists[taskIndex].Reset();
+    }
+    if (gOrbitEmitters)
+    {
+        unsigned int emitterCount = (unsigned int)gPrepBaseEmitters.size();
+        float lapAngle = twoPi * fmodf(input._simulationTimeSec, orbitPeriodSec) / orbitPeriodSec;
+        gPrepThreadPool.ParallelFor(taskCount, [&](unsigned int taskIndex)
+        {
+            GlCommandList &commands = output->_commandLists[taskIndex];
+            unsigned int firstEmitter = (emitterCount * taskIndex) / taskCount;
+            unsigned int endEmitter = (emitterCount * (taskIndex + 1)) / taskCount;
+            for (unsigned int emitterIndex = firstEmitter; emitterIndex < endEmitter; 
+                emitterIndex++)
+            {
+                PreparedEmitter prepared;
+                prepared._emitterIndex = emitterIndex;
+                prepared._emitter = gPrepBaseEmitters[emitterIndex];
+                float angle = lapAngle + ((twoPi * emitterIndex) / emitterCount);
+                prepared._emitter._center += orbitRadius * glm::vec2(cosf(angle), sinf(angle));
+                commands.RecordCall<PreparedEmitter, ApplyPreparedEmitter>(prepared);
+            }
+        });
+    }
+
+    // the scene file is checked every so often, and when it was saved, it is read here so that
+    // the GL thread only has to apply it
+    const unsigned int framesPerSceneCheck = 30;
+    // Note: A replay's changes come from its log instead.
+    output->_hasSceneConfig = false;
+    long long sceneConfigTime = 0;
+    if (!gSceneConfigPath.empty() && !gInputEventLog.IsReplaying() && 
+        (input._frameIndex % framesPerSceneCheck) == 0 && 
+        GetSceneConfigFileTime(gSceneConfigPath, &sceneConfigTime) && 
+        sceneConfigTime != gPrepSceneConfigTime)
+    {
+        gPrepSceneConfigTime = sceneConfigTime;
+        output->_sceneConfig = GetDefaultSceneConfig();
+        if (LoadSceneConfig(gSceneConfigPath, &output->_sceneConfig))
+        {
+            for (size_t overrideIndex = 0; overrideIndex < gSceneConfigOverrides.size(); 
+                overrideIndex++)
+            {
+                ApplySceneConfigOverride(gSceneConfigOverrides[overrideIndex], 
+                    &output->_sceneConfig);
+            }
+            output->_hasSceneConfig = true;
+
+            // the orbit goes around the new center from now on
+            unsigned int emitterCount = (unsigned int)gPrepBaseEmitters.size();
+            for (unsigned int emitterIndex = 0; emitterIndex < emitterCount; emitterIndex++)
+            {
+                ApplySceneConfigToEmitter(output->_sceneConfig, emitterCount, 
+                    &gPrepBaseEmitters[emitterIndex]);
+            }
+        }
+    }
+
+    output->_hasFrameGraphSample = input._hasFinishedSample;
+    output->_frameGraphSampleMs = 0.0f;
+    if (input._hasFinishedSample)
+    {
+        gFrameStatsLog.Push(input._finishedSample);
+        output->_frameGraphSampleMs = 
+            input._finishedSample._cpuDisplayMs + input._finishedSample._swapMs;
+    }
+}
+
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Draws at a fraction of the window's size, with the density splat's image if that is how 
+    the particles are drawn, and otherwise with the scaled render target.
+Parameters:
+    renderScale     See ScaledRenderTarget::SetScale(...).
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void SetRenderScale(float renderScale)
+{
+    if (gRenderMode == PARTICLE_RENDER_MODE_DENSITY_SPLAT)
+    {
+        gDensitySplatRenderer.SetResolutionScale(gUseDensitySurface ? 
+            (renderScale * DENSITY_SURFACE_RESOLUTION_SCALE) : renderScale);
+    }
+    else
+    {
+        gScaledRenderTarget.SetScale(renderScale);
+        renderScale = gScaledRenderTarget.GetScale();
+    }
+    gRenderScale = renderScale;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Ends a phase of startup, which began where the last one ended (or at the start of main()), 
+    and adds it to the breakdown that PrintStartupBreakdown() prints.  If a trace is running 
+    (see TraceTimeline.h), the phase goes on the timeline too.
+Parameters:
+    phaseName   Must be a string literal.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void MarkStartupPhase(const char *phaseName)
+{
+    std::chrono::high_resolution_clock::time_point now = 
+        std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::milli> phaseMs = now - gStartupPhaseStart;
+    gStartupPhaseStart = now;
+
+    char phaseText[128];
+    snprintf(phaseText, sizeof(phaseText), "    %-24s %8.1fms\n", phaseName, phaseMs.count());
+    gStartupBreakdown += phaseText;
+    if (IsTracing())
+    {
+        long long beginNs = GetTraceTimeNs() - (long long)(phaseMs.count() * 1000000.0);
+        TraceCpuEvent(phaseName, (beginNs > 0) ? beginNs : 0);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Prints each phase of startup, the shader builds within them (which are the usual 
+    suspects), and the time to the first frame.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void PrintStartupBreakdown()
+{
+    unsigned int compiledCount = 0;
+    unsigned int cachedCount = 0;
+    unsigned int spirvCount = 0;
+    float buildMs = 0.0f;
+    const std::vector<ShaderBuildRecord> &records = GetShaderBuildRecords();
+    for (size_t recordIndex = 0; recordIndex < records.size(); recordIndex++)
+    {
+        const ShaderBuildRecord &record = records[recordIndex];
+        if (record._isFromCache)
+        {
+            cachedCount++;
+        }
+        else if (record._isFromSpirv)
+        {
+            spirvCount++;
+        }
+        else
+        {
+            compiledCount++;
+        }
+        buildMs += record._fileReadMs + record._cacheLoadMs + record._vertexCompileMs + 
+            record._fragmentCompileMs + record._computeCompileMs + record._linkMs;
+    }
+
+    std::chrono::duration<double, std::milli> totalMs = gStartupPhaseStart - gStartupStart;
+    LogPrintf("startup:\n%s", gStartupBreakdown.c_str());
+    LogPrintf("    %-24s %8.1fms (%u compiled, %u from SPIR-V, %u cached; prefetched ones "
+        "overlap the phases)\n", "shader builds", buildMs, compiledCount, spirvCount, 
+        cachedCount);
+    LogPrintf("    %-24s %8.1fms\n", "time to first frame", totalMs.count());
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The "--inject" producer, which stands in for an outside feed (ex: a sensor, a network 
+    stream).  Writes a slot's worth of a turning spiral straight into the injection ring about 
+    60 times a second, and if every slot is busy, skips that batch instead of waiting.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static void RunInjectionProducer()
+{
+    SetTraceThreadName("particle injection");
+    PlaceWorkerThread();
+    const float armCount = 3.0f;
+    const float maxRadius = 0.6f;
+    const float outwardSpeed = 0.2f;
+    unsigned int batchIndex = 0;
+    while (!gIsInjectionStopping.load())
+    {
+        unsigned int slotIndex = 0;
+        ParticleInjectionRecord *records = gParticleInjectionRing.BeginWrite(&slotIndex);
+        if (records != 0)
+        {
+            unsigned int recordCount = gParticleInjectionRing.GetRecordsPerSlot();
+            float turn = batchIndex * 0.05f;
+            for (unsigned int recordIndex = 0; recordIndex < recordCount; recordIndex++)
+            {
+                float t = (float)recordIndex / recordCount;
+                float arm = (float)(recordIndex % (unsigned int)armCount);
+                float angle = turn + (t * 12.0f) + (arm * (6.2831853f / armCount));
+                glm::vec2 direction(cosf(angle), sinf(angle));
+                records[recordIndex]._position = direction * (t * maxRadius);
+                records[recordIndex]._velocity = direction * outwardSpeed;
+            }
+            gParticleInjectionRing.EndWrite(slotIndex, 0, recordCount);
+        }
+        batchIndex++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(16));
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Starts a trajectory recording of the whole pool.  The recorder's program is only built the 
+    first time, since most runs never record.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void StartTrajectoryRecording()
+{
+    if (!gIsTrajectoryRecorderReady)
+    {
+        GLuint trajectoryProgramId = AcquireComputeProgram(gTrajectoryShaderDefines);
+        gParticleTrajectoryRecorder.Init(trajectoryProgramId);
+        ReleaseProgram(trajectoryProgramId);
+        gIsTrajectoryRecorderReady = true;
+    }
+    gParticleTrajectoryRecorder.Start(gTrajectoryPath, gParticleManager.GetMaxParticleCount());
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Degrades the particle pool until the particle manager's estimate of it fits in the GPU 
+    memory budget (see GpuMemoryLedger.h).  Half floats go first, since the particles look 
+    the same at this scale and only the precision of the velocities is lost (unless the 
+    fixed-point layout, which is smaller still, was asked for), and then the pool is halved 
+    until it fits.  A pool that won't fit even at the minimum is left at the
+    minimum, and the particle manager refuses it.
+Parameters:
+    putLayoutHere           In: the layout that was asked for.  Out: the one that fits.
+    putParticleCountHere    In: the pool that was asked for.  Out: the one that fits.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+static void FitParticlePoolToGpuMemory(ParticleLayout *putLayoutHere, 
+    unsigned int *putParticleCountHere)
+{
+    const unsigned int minParticleCount = 1024;
+    ParticleLayout layout = *putLayoutHere;
+    unsigned int particleCount = *putParticleCountHere;
+
+    // a pool bigger than one buffer can address is cut down to what one can, budget or not, 
+    // since the pool isn't split across buffers (see ParticleManager::GetMaxPoolParticleCount(...))
+    unsigned int maxPoolParticleCount = ParticleManager::GetMaxPoolParticleCount(layout);
+    if (particleCount > maxPoolParticleCount)
+    {
+        LogPrintf("particle pool capped at %u particles, the most that one buffer can hold in "
+            "layout %d (asked for %u)\n", maxPoolParticleCount, (int)layout, particleCount);
+        particleCount = maxPoolParticleCount;
+    }
+    if (layout != PARTICLE_LAYOUT_HALF_FLOAT && layout != PARTICLE_LAYOUT_FIXED_POINT && 
+        WouldExceedGpuMemoryBudget(ParticleManager::EstimateGpuMemory(particleCount, layout)))
+    {
+        layout = PARTICLE_LAYOUT_HALF_FLOAT;
+    }
+    while (particleCount > minParticleCount && 
+        WouldExceedGpuMemoryBudget(ParticleManager::EstimateGpuMemory(particleCount, layout)))
+    {
+        particleCount /= 2;
+    }
+
+    if (layout != *putLayoutHere || particleCount != *putParticleCountHere)
+    {
+        LogPrintf("particle pool degraded to fit the GPU memory budget: %u particles in "
+            "layout %d (asked for %u in layout %d)\n", particleCount, (int)layout, 
+            *putParticleCountHere, (int)*putLayoutHere);
+    }
+    *putLayoutHere = layout;
+    *putParticleCountHere = particleCount;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Governs window creation, the initial OpenGL configuration (face culling, depth mask, even
+    though this is a 2D demo and that stuff won't be of concern), the creation of geometry, and
+    the creation of a texture.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (3-7-2016)
+-----------------------------------------------------------------------------------------------*/
+void Init()
+{
+    TRACE_SCOPE("Init");
+    glEnable(GL_CULL_FACE);
+    glCullFace(GL_BACK);
+    glFrontFace(GL_CCW);
+
+    if (RenderModeNeedsDepth(gRenderMode))
+    {
+        EnableGlCapability(GL_DEPTH_TEST);
+        glDepthMask(GL_TRUE);
+        glDepthFunc(GL_LEQUAL);
+        glDepthRange(0.0f, 1.0f);
+    }
+    else
+    {
+        DisableGlCapability(GL_DEPTH_TEST);
+        glDepthMask(GL_FALSE);
+    }
+
+    if (gRenderMode == PARTICLE_RENDER_MODE_ADDITIVE)
+    {
+        // color += particle color; the frame buffer clamps at white
+        EnableGlCapability(GL_BLEND);
+        SetGlBlendFunc(GL_ONE, GL_ONE);
+        glBlendEquation(GL_FUNC_ADD);
+    }
+
+    // let the vertex shader set the point size (see ParticleManager::SetPointSize(...))
+    glEnable(GL_PROGRAM_POINT_SIZE);
+
+    // before anything is built, so that every variant is written out
+    SetShaderSourceDump(gDumpShaderSources);
+    SetShaderVariantManifest(gShaderVariantsPath);
+
+    // before anything is loaded, so that all of it comes from the pack
+    if (!gAssetPackPath.empty())
+    {
+        OpenAssetPack(gAssetPackPath);
+    }
+
+    // the compute shader must be generated for the same particle layout that the particle 
+    // manager is initialized with
+    // Note: PARTICLE_LAYOUT_INTERLEAVED (24 bytes/particle), PARTICLE_LAYOUT_SOA (20), 
+    // PARTICLE_LAYOUT_HALF_FLOAT (12), or PARTICLE_LAYOUT_FIXED_POINT (8).
+    ParticleLayout particleLayout = gSceneConfig._particleLayout;
+
+    // all values are in windows space (X and Y limited to [-1,+1])
+    // Note: Toy with the values in a scene file (see SceneConfig.h).
+    // Note: Without a count in the scene, "--persistent" runs the small one, where the 
+    // launches cost more than the work.
+    unsigned int totalParticles = gSceneConfig._particleCount;
+    if (totalParticles == 0)
+    {
+        totalParticles = (gPersistentWorkGroupCount > 0) ? 20000 : 600000;
+    }
+
+    // everything below is built for the layout, so it must be settled first
+    SetGpuMemoryBudget(gGpuMemoryBudgetMb * 1024ull * 1024ull);
+    FitParticlePoolToGpuMemory(&particleLayout, &totalParticles);
+
+    // the first run on a GPU times the candidate work group sizes (see WorkGroupTuner.h)
+    unsigned int workGroupSize = GetTunedWorkGroupSize(particleLayout, totalParticles, 
+        gForceRetune);
+    unsigned int maxParticlesEmittedPerFrame = gSceneConfig._maxParticlesEmittedPerFrame;
+    glm::vec2 center = gSceneConfig._emitterCenter;
+    float radius = gSceneConfig._emitterRadius;
+    float minVelocity = gSceneConfig._minVelocity;
+    float maxVelocity = gSceneConfig._maxVelocity;
+
+    // the demo's one emitter never changes shape and is drawn as one group, so bake it into 
+    // the update kernel (see ParticleKernelVariant), and share the atomics as widely as the 
+    // device allows
+    // Note: The split needs several emitters to move between the GPU and the CPU, so it cuts 
+    // the one emitter into 16 that are the same but for their share of the pool.
+    // Also Note: A scene file can move the emitter while the demo runs, so it isn't baked.
+    ParticleKernelVariant kernelVariant = ParticleManager::GetDefaultKernelVariant();
+    kernelVariant._hasFixedEmitter = !gUseSplitSimulation && gSceneConfigPath.empty();
+    kernelVariant._fixedEmitter._center = center;
+    kernelVariant._fixedEmitter._radius = radius;
+    kernelVariant._fixedEmitter._velocityMin = minVelocity;
+    kernelVariant._fixedEmitter._velocityMax = maxVelocity;
+    kernelVariant._hasSingleDrawGroup = true;
+    kernelVariant._atomicAggregation = ParticleManager::GetBestAtomicAggregation();
+    LogPrintf("particle atomic aggregation: %d\n", (int)kernelVariant._atomicAggregation);
+
+    // the force fields don't change in number, so the loop over them is unrolled, and without
+    // them it isn't in the kernel at all
+    // Note: With a field texture, the well and the vortex are baked into it instead, and only 
+    // the drag, which depends on each particle's velocity, is left in the loop.
+    std::vector<ParticleForceField> forceFields;
+    std::vector<ParticleForceField> bakedForceFields;
+    std::vector<ParticleForceField> &positionForceFields = 
+        gUseFieldTexture ? bakedForceFields : forceFields;
+    if (gUseForceFields || gUseFieldTexture)
+    {
+        ParticleForceField forceField;
+        forceField._direction = glm::vec2(0.0f, 0.0f);
+        forceField._padding = 0;
+
+        // a well off to the side of the emitter that bends the spray around it
+        forceField._type = PARTICLE_FORCE_FIELD_ATTRACTOR;
+        forceField._center = glm::vec2(-0.3f, -0.2f);
+        forceField._strength = 0.05f;
+        forceField._softeningRadius = 0.05f;
+        positionForceFields.push_back(forceField);
+
+        // a swirl around the emitter itself
+        forceField._type = PARTICLE_FORCE_FIELD_VORTEX;
+        forceField._center = center;
+        forceField._strength = 0.1f;
+        forceField._softeningRadius = 0.1f;
+        positionForceFields.push_back(forceField);
+
+        // and enough drag that the fastest particles don't just shoot straight out
+        forceField._type = PARTICLE_FORCE_FIELD_LINEAR_DRAG;
+        forceField._center = glm::vec2(0.0f, 0.0f);
+        forceField._strength = 0.3f;
+        forceField._softeningRadius = 0.0f;
+        forceFields.push_back(forceField);
+    }
+    kernelVariant._hasUnrolledForceFields = true;
+    kernelVariant._unrolledForceFieldCount = (unsigned int)forceFields.size();
+    kernelVariant._hasFieldTexture = gUseFieldTexture || gUseFluidGrid;
+
+    // the well pulls hard near its center, and Verlet keeps the orbits around it from gaining 
+    // energy at 120 steps per second
+    // Note: The CPU's half of a split only has semi-implicit Euler, and both halves must move 
+    // the particles the same way.
+    if ((gUseForceFields || gUseFieldTexture) && !gUseSplitSimulation)
+    {
+        kernelVariant._integrator = PARTICLE_INTEGRATOR_VELOCITY_VERLET;
+    }
+    kernelVariant._hasSdfBoundary = gUseSdfBoundary;
+    kernelVariant._hasSegmentBvh = gUseSegmentBvh;
+    kernelVariant._hasEmissionImage = !gEmissionImagePath.empty();
+    kernelVariant._hasEmitterPaths = gUseEmitterPaths;
+    kernelVariant._hasPointerInput = gUsePointerInput;
+    kernelVariant._hasBursts = gUseBursts;
+    kernelVariant._hasSubEmitters = gUseSubEmitters;
+    kernelVariant._hasInjection = gUseInjection || gUseDomainShard;
+    kernelVariant._hasDrawGroupCulling = gCullDrawGroups;
+    kernelVariant._hasSleep = gUseSleep;
+    kernelVariant._hasPersistentThreads = (gPersistentWorkGroupCount > 0);
+    kernelVariant._hasFusedEmitUpdate = gUseFusedEmit;
+    kernelVariant._customUpdateFilePath = gCustomUpdateFilePath;
+    kernelVariant._hasCostAttribution = gUseCostAttribution;
+    kernelVariant._hasLowDiscrepancyEmission = gUseLowDiscrepancyEmission;
+
+    // every compute program that startup needs is handed to the driver now, and it compiles 
+    // them while the render programs build and the particle pool is set up; each acquire below
+    // only waits for whatever is left (see PrefetchComputeProgram(...))
+    // Note: The update program is the biggest by far, so it goes first.
+    if (!gUseCpuSimulation)
+    {
+        PrefetchComputeProgram(ParticleManager::GetComputeShaderDefines(particleLayout, 
+            workGroupSize, kernelVariant));
+    }
+    if (gUseSdfBoundary)
+    {
+        PrefetchComputeProgram("", "shaderJumpFlood.comp");
+    }
+    if (gUseSegmentBvh)
+    {
+        PrefetchComputeProgram("", "shaderSegmentBvh.comp");
+    }
+    if (!gEmissionImagePath.empty() && !gUseCpuSimulation)
+    {
+        PrefetchComputeProgram(ParticleEmissionImage::GetWeightShaderDefines(workGroupSize));
+        PrefetchComputeProgram(GpuScan::GetScanShaderDefines(GpuScan::DEFAULT_WORK_GROUP_SIZE, 
+            GpuScan::IsSubgroupScanSupported()), "shaderScan.comp");
+    }
+    if (gUseFieldTexture)
+    {
+        PrefetchComputeProgram(ParticleFieldTexture::GetBakeShaderDefines(workGroupSize));
+    }
+    if (gRenderMode == PARTICLE_RENDER_MODE_DENSITY_SPLAT)
+    {
+        PrefetchComputeProgram(
+            DensitySplatRenderer::GetSplatShaderDefines(particleLayout, workGroupSize));
+    }
+    if (gBloomIntensity > 0.0f)
+    {
+        PrefetchComputeProgram("", "shaderBloom.comp");
+    }
+    if (gUseFluidGrid)
+    {
+        PrefetchComputeProgram("", "shaderStableFluid.comp");
+    }
+    if (gSortParticles)
+    {
+        PrefetchComputeProgram(ParticleManager::GetSortShaderDefines(particleLayout));
+    }
+    if (gUseParticleInteractions)
+    {
+        PrefetchComputeProgram(
+            ParticleNeighborGrid::GetGridShaderDefines(particleLayout, workGroupSize, 
+                gUseSleep, gUseSphFluid));
+    }
+    if (gUseGravityTree)
+    {
+        PrefetchComputeProgram(
+            ParticleGravityTree::GetGravityTreeShaderDefines(particleLayout, workGroupSize));
+    }
+    if (gUseConstraints)
+    {
+        PrefetchComputeProgram(
+            ParticleConstraintSolver::GetConstraintShaderDefines(particleLayout, workGroupSize));
+    }
+    PrefetchComputeProgram(
+        ParticleStatsReducer::GetStatsShaderDefines(particleLayout, workGroupSize));
+    if (!gHeatmapPath.empty())
+    {
+        PrefetchComputeProgram(
+            ParticleHeatmapExporter::GetHeatmapShaderDefines(particleLayout, workGroupSize));
+    }
+    if (gUseDomainShard)
+    {
+        PrefetchComputeProgram(
+            ParticleDomainShard::GetMigrationShaderDefines(particleLayout, workGroupSize));
+    }
+    MarkStartupPhase("compute prefetch");
+
+    // the frame graph needs the attribute version of the render program either way
+    // Note: The weighted OIT mode's fragment shader writes both of its targets instead of the 
+    // color, and has no round quad of its own, so its quads are square.  It has no flipbook 
+    // either, so "--flipbook" is ignored with it.  The overdraw's fragment shader counts every 
+    // fragment in place of either, and a flipbook wouldn't change the count.
+    const char *particleFragFilePath = (gRenderMode == PARTICLE_RENDER_MODE_WEIGHTED_OIT) ? 
+        "shaderParticleOit.frag" : "shaderParticle.frag";
+    bool hasOwnFragShader = gRenderMode == PARTICLE_RENDER_MODE_WEIGHTED_OIT || gShowOverdraw;
+    if (gShowOverdraw)
+    {
+        particleFragFilePath = "shaderParticleOverdraw.frag";
+    }
+    // the fixed-point layout has no vertex attributes, so the manager's points must be pulled
+    if (particleLayout == PARTICLE_LAYOUT_FIXED_POINT)
+    {
+        gUseVertexPulling = true;
+    }
+
+    // the partly covered pixels only add up right with additive blending, and the quads and 
+    // the flipbook have round edges of their own
+    if (gUseSmoothPoints && (gRenderMode != PARTICLE_RENDER_MODE_ADDITIVE || hasOwnFragShader))
+    {
+        LogPrintf("smooth points are only drawn in the additive render mode\n");
+        gUseSmoothPoints = false;
+    }
+    GLuint particleProgramId = AcquireRenderProgram();
+    GLuint managerProgramId = particleProgramId;
+    if (gUseFlipbook && !hasOwnFragShader)
+    {
+        managerProgramId = AcquireRenderProgram("shaderParticle.vert", 
+            "shaderParticleFlipbook.frag", 
+            ParticleManager::GetFlipbookRenderShaderDefines(particleLayout, gUseQuads));
+    }
+    else if (gUseQuads)
+    {
+        managerProgramId = AcquireRenderProgram("shaderParticle.vert", 
+            hasOwnFragShader ? particleFragFilePath : "shaderParticleQuad.frag",
+            ParticleManager::GetQuadRenderShaderDefines(particleLayout));
+    }
+    else if (gUseSmoothPoints)
+    {
+        managerProgramId = AcquireRenderProgram("shaderParticle.vert", 
+            "shaderParticleSmooth.frag", 
+            ParticleManager::GetSmoothPointRenderShaderDefines(particleLayout, 
+            gUseVertexPulling));
+    }
+    else if (gUseVertexPulling)
+    {
+        managerProgramId = AcquireRenderProgram("shaderParticle.vert", particleFragFilePath, 
+            ParticleManager::GetRenderShaderDefines(particleLayout));
+    }
+    else if (hasOwnFragShader)
+    {
+        managerProgramId = AcquireRenderProgram("shaderParticle.vert", particleFragFilePath);
+    }
+    else
+    {
+        AddProgramReference(managerProgramId);
+    }
+    gParticleMultiViewport.Init();
+    if (gParticleMultiViewport.GetInsetCount() > 0 && (hasOwnFragShader || 
+        gRenderMode == PARTICLE_RENDER_MODE_DENSITY_SPLAT))
+    {
+        LogPrintf("insets are only drawn in the point and additive render modes\n");
+    }
+    else if (gParticleMultiViewport.GetInsetCount() > 0 && 
+        gParticleMultiViewport.IsBroadcastSupported() && !gUseFlipbook && !gUseQuads)
+    {
+        GLuint broadcastProgramId = AcquireRenderProgram("shaderParticle.vert", 
+            particleFragFilePath, ParticleMultiViewport::GetRenderShaderDefines() + 
+            (gUseVertexPulling ? ParticleManager::GetRenderShaderDefines(particleLayout) : ""));
+        if (broadcastProgramId != 0)
+        {
+            ReleaseProgram(managerProgramId);
+            managerProgramId = broadcastProgramId;
+            gIsInsetBroadcast = true;
+        }
+    }
+    MarkStartupPhase("render programs");
+
+    // the CPU backend doesn't need the update program
+    GLuint computeProgramId = 0;
+    gParticleManager.SetDeterministic(gDeterministic, gRandomSeed);
+    gParticleManager.SetPersistentThreads(gPersistentWorkGroupCount);
+    gParticleManager.SetFusedEmitUpdate(gUseFusedEmit);
+    if (gSparsePoolCapacity > 0)
+    {
+        gParticleManager.SetParticleBufferAccess(PARTICLE_BUFFER_ACCESS_SPARSE);
+        gParticleManager.SetPoolCapacity(gSparsePoolCapacity, 0, 0);
+    }
+    if (gUseCpuSimulation)
+    {
+        gParticleManager.SetSimulationBackend(PARTICLE_SIMULATION_BACKEND_CPU);
+    }
+    else
+    {
+        if (gUseSplitSimulation)
+        {
+            gParticleManager.SetSimulationBackend(PARTICLE_SIMULATION_BACKEND_SPLIT);
+        }
+        computeProgramId = AcquireComputeProgram(ParticleManager::GetComputeShaderDefines(
+            particleLayout, workGroupSize, kernelVariant));
+    }
+    if (gUseSplitSimulation && !gUseCpuSimulation)
+    {
+        const unsigned int splitEmitterCount = 16;
+        ParticleEmitter emitter;
+        emitter._center = center;
+        emitter._radius = radius;
+        emitter._velocityMin = minVelocity;
+        emitter._velocityMax = maxVelocity;
+        emitter._maxParticlesEmittedPerFrame = 
+            (maxParticlesEmittedPerFrame + splitEmitterCount - 1) / splitEmitterCount;
+        emitter._particleCount = totalParticles / splitEmitterCount;
+        emitter._firstParticle = 0;
+        emitter._lifetimeSec = 0.0f;
+        emitter._spawnShape = PARTICLE_SPAWN_DISK;
+        std::vector<ParticleEmitter> emitters(splitEmitterCount, emitter);
+        gParticleManager.Init(managerProgramId, computeProgramId, emitters, particleLayout);
+    }
+    else
+    {
+        gParticleManager.Init(managerProgramId,
+            computeProgramId,
+            totalParticles,
+            maxParticlesEmittedPerFrame,
+            center,
+            radius, 
+            minVelocity, 
+            maxVelocity,
+            particleLayout);
+    }
+
+    // the particle manager takes its own references to the programs (see 
+    // ShaderProgramRegistry.h), so this function only holds on to the render program for the 
+    // frame graph
+    ReleaseProgram(managerProgramId);
+    ReleaseProgram(computeProgramId);
+    gParticleManager.SetForceFields(forceFields);
+    if (gUseCostAttribution)
+    {
+        gParticleCostAttribution.Init((unsigned int)gParticleManager.GetEmitters().size());
+    }
+    MarkStartupPhase("particle pool");
+
+    if (gUseSdfBoundary)
+    {
+        // 256x256 over the window is about 2 pixels per texel, and the fastest particles move 
+        // less than a texel per step, so they can't skip through the walls
+        GLuint jumpFloodProgramId = AcquireComputeProgram("", "shaderJumpFlood.comp");
+        gParticleBoundarySdf.Init(jumpFloodProgramId, 256, 256, glm::vec2(-1.0f, -1.0f), 
+            glm::vec2(+1.0f, +1.0f));
+        ReleaseProgram(jumpFloodProgramId);
+        gParticleBoundarySdf.SetShape(MakeDemoBoundaryMask(256, 256));
+        if (gUseCompressedTextures)
+        {
+            gParticleBoundarySdf.Compress();
+        }
+        gParticleManager.SetSdfBoundary(gParticleBoundarySdf.GetTextureId(), 
+            gParticleBoundarySdf.GetWidth(), gParticleBoundarySdf.GetHeight(), 
+            gParticleBoundarySdf.GetMinCorner(), gParticleBoundarySdf.GetMaxCorner(), 
+            PARTICLE_SDF_BOUNDARY_COLLIDE, 0.5f, gParticleBoundarySdf.GetDistanceScale());
+    }
+
+    if (gUseSegmentBvh)
+    {
+        // the emitter's particles start within 0.1 of its center (see SPAWN_RADIUS in 
+        // shaderParticle.comp)
+        GLuint segmentBvhProgramId = AcquireComputeProgram("", "shaderSegmentBvh.comp");
+        gParticleSegmentBvh.Init(segmentBvhProgramId);
+        ReleaseProgram(segmentBvhProgramId);
+        gParticleSegmentBvh.SetSegments(MakeDemoSegments(center, 0.15f));
+        gParticleManager.SetSegmentBvh(gParticleSegmentBvh.GetSegmentBufferId(), 
+            gParticleSegmentBvh.GetNodeBufferId(), gParticleSegmentBvh.GetSegmentCount(), 
+            PARTICLE_SEGMENT_BVH_COLLIDE, 0.7f);
+    }
+
+    // the CPU backend only spawns in the disk, so there is nothing to build for it
+    if (!gEmissionImagePath.empty() && !gUseCpuSimulation)
+    {
+        GLuint weightProgramId = AcquireComputeProgram(
+            ParticleEmissionImage::GetWeightShaderDefines(workGroupSize));
+        GLuint scanProgramId = AcquireComputeProgram(GpuScan::GetScanShaderDefines(
+            GpuScan::DEFAULT_WORK_GROUP_SIZE, GpuScan::IsSubgroupScanSupported()), 
+            "shaderScan.comp");
+        gParticleEmissionImage.Init(weightProgramId, scanProgramId);
+        ReleaseProgram(weightProgramId);
+        ReleaseProgram(scanProgramId);
+
+        int imageWidth = 0;
+        int imageHeight = 0;
+        std::vector<unsigned char> imagePixels;
+        if (ParticleEmissionImage::LoadNetpbmFile(gEmissionImagePath, &imageWidth, 
+            &imageHeight, &imagePixels) && 
+            gParticleEmissionImage.UploadImage(imageWidth, imageHeight, imagePixels, 0.05f))
+        {
+            // the image's longer side spans most of the emitter's disk, and it keeps its shape
+            float halfSize = radius * 0.7f;
+            float aspect = (float)imageWidth / (float)imageHeight;
+            glm::vec2 halfExtent = (aspect >= 1.0f) ? 
+                glm::vec2(halfSize, halfSize / aspect) : glm::vec2(halfSize * aspect, halfSize);
+            gParticleManager.SetEmissionImage(gParticleEmissionImage.GetCdfBufferId(), 
+                imageWidth, imageHeight, center - halfExtent, center + halfExtent);
+
+            unsigned int emitterCount = (unsigned int)gParticleManager.GetEmitters().size();
+            for (unsigned int emitterIndex = 0; emitterIndex < emitterCount; emitterIndex++)
+            {
+                ParticleEmitter emitter = gParticleManager.GetEmitters()[emitterIndex];
+                emitter._spawnShape = PARTICLE_SPAWN_IMAGE;
+                gParticleManager.SetEmitter(emitterIndex, emitter);
+            }
+        }
+    }
+
+    // without a lifetime, the slowest particles take over 20 seconds to get out of the circle
+    if (gSceneConfig._lifetimeSec > 0.0f)
+    {
+        unsigned int emitterCount = (unsigned int)gParticleManager.GetEmitters().size();
+        for (unsigned int emitterIndex = 0; emitterIndex < emitterCount; emitterIndex++)
+        {
+            ParticleEmitter emitter = gParticleManager.GetEmitters()[emitterIndex];
+            emitter._lifetimeSec = gSceneConfig._lifetimeSec;
+            gParticleManager.SetEmitter(emitterIndex, emitter);
+        }
+    }
+
+    // every other emitter traces a figure 8, each a little further along it than the last, 
+    // and the rest take turns around a rounded square
+    if (gUseEmitterPaths)
+    {
+        std::vector<glm::vec2> pathPoints;
+        pathPoints.push_back(glm::vec2(-0.3f, -0.3f));
+        pathPoints.push_back(glm::vec2(+0.3f, -0.3f));
+        pathPoints.push_back(glm::vec2(+0.3f, +0.3f));
+        pathPoints.push_back(glm::vec2(-0.3f, +0.3f));
+
+        unsigned int emitterCount = (unsigned int)gParticleManager.GetEmitters().size();
+        std::vector<ParticleEmitterPath> paths(emitterCount);
+        for (unsigned int emitterIndex = 0; emitterIndex < emitterCount; emitterIndex++)
+        {
+            float stagger = (float)emitterIndex / (float)emitterCount;
+            ParticleEmitterPath &path = paths[emitterIndex];
+            path._amplitude = glm::vec2(0.3f, 0.15f);
+            path._angularFrequency = glm::vec2(0.8f, 1.6f);
+            path._phase = glm::vec2(stagger * 6.2831853f, stagger * 12.5663706f);
+            path._type = PARTICLE_EMITTER_PATH_LISSAJOUS;
+            path._firstPoint = 0;
+            path._pointCount = (unsigned int)pathPoints.size();
+            path._periodSec = 6.0f;
+            if ((emitterIndex % 2) == 1)
+            {
+                path._phase = glm::vec2(stagger, 0.0f);
+                path._type = PARTICLE_EMITTER_PATH_SPLINE;
+            }
+        }
+        gParticleManager.SetEmitterPaths(paths, pathPoints);
+    }
+
+    // the sparks' emitters don't emit on their own, and they cover the whole window, so the 
+    // sparks live wherever their parents died, for a second
+    if (gUseSubEmitters)
+    {
+        unsigned int emitterCount = (unsigned int)gParticleManager.GetEmitters().size();
+        std::vector<ParticleSubEmitter> subEmitters(emitterCount);
+        for (unsigned int emitterIndex = 0; emitterIndex + 1 < emitterCount; emitterIndex += 2)
+        {
+            ParticleEmitter sparkEmitter = gParticleManager.GetEmitters()[emitterIndex + 1];
+            sparkEmitter._maxParticlesEmittedPerFrame = 0;
+            sparkEmitter._radius = 2.0f;
+            sparkEmitter._lifetimeSec = 1.0f;
+            gParticleManager.SetEmitter(emitterIndex + 1, sparkEmitter);
+
+            ParticleSubEmitter &subEmitter = subEmitters[emitterIndex];
+            subEmitter._childEmitterIndex = emitterIndex + 1;
+            subEmitter._childCount = 8;
+            subEmitter._triggers = 
+                PARTICLE_SUB_EMITTER_ON_EXPIRED | PARTICLE_SUB_EMITTER_ON_LEFT_BOUNDS;
+            subEmitter._inheritVelocity = 0.25f;
+            subEmitter._velocityMin = 0.05f;
+            subEmitter._velocityMax = 0.2f;
+            subEmitter._radius = 0.005f;
+            subEmitter._padding = 0;
+        }
+        gParticleManager.SetSubEmitters(subEmitters);
+    }
+
+    // a particle that has been slower than 1% of the window per second for half a second 
+    // (at 60 updates a second) falls asleep
+    if (gUseSleep)
+    {
+        gParticleManager.SetSleep(0.01f, 30);
+    }
+    gParticleManager.SetDrawGroupCulling(gCullDrawGroups);
+    gParticleManager.SetLowDiscrepancyEmission(gUseLowDiscrepancyEmission);
+
+    // the textures that are set after this get their handles as they are set
+    if (gUseBindlessTextures)
+    {
+        gParticleManager.SetBindlessTextures(true);
+    }
+    if (gUseDoubleBufferedRendering)
+    {
+        gParticleManager.SetDoubleBufferedRendering(true);
+    }
+
+    // the first emitter waits where it is until the mouse moves
+    if (gUsePointerInput)
+    {
+        gPointerInput._position = gParticleManager.GetEmitters()[0]._center;
+        gPointerInput._isEmitting = true;
+        gPointerInput._attractorStrength = 0.0f;
+        gPointerInput._timeMs = 0.0;
+        gParticleManager.SetPointerEmitter(0);
+        gParticleManager.PublishPointerInput(gPointerInput);
+    }
+
+    // the simulation clock runs at most 4 steps a frame (see SimulationClock::Init(...) below), 
+    // so they all go out in one dispatch
+    gParticleManager.SetSubstepsPerDispatch(4);
+
+    if (gUseFieldTexture)
+    {
+        // 128x128 over the window is a texel every 2 pixels at the default window size, and 
+        // the well's softening radius is several texels across
+        GLuint bakeProgramId = AcquireComputeProgram(
+            ParticleFieldTexture::GetBakeShaderDefines(workGroupSize));
+        gParticleFieldTexture.Init(bakeProgramId, 128, 128, glm::vec2(-1.0f, -1.0f), 
+            glm::vec2(+1.0f, +1.0f));
+        ReleaseProgram(bakeProgramId);
+        gParticleFieldTexture.Bake(bakedForceFields);
+        if (gUseCompressedTextures)
+        {
+            gParticleFieldTexture.Compress();
+        }
+        gParticleManager.SetFieldTexture(gParticleFieldTexture.GetTextureId(), 
+            gParticleFieldTexture.GetMinCorner(), gParticleFieldTexture.GetMaxCorner(), 
+            PARTICLE_FIELD_TEXTURE_ACCELERATION, 1.0f, gParticleFieldTexture.GetValueScale());
+    }
+
+    if (gUseFluidGrid)
+    {
+        // 128x128 over the window, like the field texture; the particles catch up to the 
+        // fluid's speed within about a quarter of a second
+        GLuint fluidProgramId = AcquireComputeProgram("", "shaderStableFluid.comp");
+        gStableFluidSolver.Init(fluidProgramId, 128, 128, glm::vec2(-1.0f, -1.0f), 
+            glm::vec2(+1.0f, +1.0f));
+        ReleaseProgram(fluidProgramId);
+        gStableFluidSolver.SetSolver(30, 2.0f, 0.5f);
+        gParticleManager.SetFieldTexture(gStableFluidSolver.GetVelocityTextureId(), 
+            gStableFluidSolver.GetMinCorner(), gStableFluidSolver.GetMaxCorner(), 
+            PARTICLE_FIELD_TEXTURE_VELOCITY, 4.0f);
+    }
+
+    if (gRenderMode == PARTICLE_RENDER_MODE_ADDITIVE)
+    {
+        // 600,000 particles in a 500x500 window is a few particles per pixel on average and 
+        // many more near the emitter, so each one only contributes a little
+        gParticleManager.SetPointSize(1.0f);
+        gParticleManager.SetParticleBrightness(0.15f);
+        if (gUseQuads)
+        {
+            // a 1-pixel quad is all edge; bigger and dimmer gives about the same total light
+            gParticleManager.SetPointSize(4.0f);
+            gParticleManager.SetParticleBrightness(0.03f);
+        }
+        if (gUseFlipbook)
+        {
+            // big enough for the frames to be seen, which also puts them a few mip levels down
+            gParticleManager.SetPointSize(8.0f);
+            gParticleManager.SetParticleBrightness(0.03f);
+        }
+    }
+    else if (gRenderMode == PARTICLE_RENDER_MODE_DENSITY_SPLAT)
+    {
+        GLuint splatProgramId = AcquireComputeProgram(
+            DensitySplatRenderer::GetSplatShaderDefines(particleLayout, workGroupSize));
+        GLuint resolveProgramId = AcquireRenderProgram("shaderDensityResolve.vert", 
+            "shaderDensityResolve.frag");
+        gDensitySplatRenderer.Init(splatProgramId, resolveProgramId, 
+            gAppWindow->GetWidth(), gAppWindow->GetHeight());
+        ReleaseProgram(splatProgramId);
+        ReleaseProgram(resolveProgramId);
+        gDensitySplatRenderer.SetExposure(0.15f);
+        if (gUseDensitySurface)
+        {
+            GLuint surfaceProgramId = AcquireComputeProgram("", "shaderDensitySurface.comp");
+            GLuint shadeProgramId = AcquireRenderProgram("shaderDensityResolve.vert", 
+                "shaderDensitySurface.frag");
+            GLuint contourProgramId = gDrawSurfaceContours ? 
+                AcquireRenderProgram("shaderDensityContour.vert", "shaderParticle.frag") : 0;
+            gDensitySurfaceRenderer.Init(surfaceProgramId, shadeProgramId, contourProgramId);
+            ReleaseProgram(surfaceProgramId);
+            ReleaseProgram(shadeProgramId);
+            if (contourProgramId != 0)
+            {
+                ReleaseProgram(contourProgramId);
+            }
+
+            // a few particles per pixel, once they are spread out by the blur, is enough to 
+            // join a fluid's particles up into one body
+            gDensitySurfaceRenderer.SetThreshold(0.5f);
+        }
+    }
+    else if (gRenderMode == PARTICLE_RENDER_MODE_WEIGHTED_OIT)
+    {
+        // full color, since the composite averages it instead of adding it up, and a few 
+        // overlapping particles to cover the background
+        GLuint compositeProgramId = AcquireRenderProgram("shaderDensityResolve.vert", 
+            "shaderOitComposite.frag");
+        gWeightedOitRenderer.Init(compositeProgramId);
+        ReleaseProgram(compositeProgramId);
+        gParticleManager.SetPointSize(2.0f);
+        gParticleManager.SetParticleBrightness(1.0f);
+        gParticleManager.SetParticleOpacity(0.2f);
+    }
+    if (gShowOverdraw && gRenderMode != PARTICLE_RENDER_MODE_DENSITY_SPLAT)
+    {
+        GLuint heatProgramId = AcquireRenderProgram("shaderDensityResolve.vert", 
+            "shaderOverdrawHeat.frag");
+        gOverdrawVisualizer.Init(heatProgramId);
+        ReleaseProgram(heatProgramId);
+    }
+
+    // the scene's point size and brightness, if it has them, replace the render mode's
+    if (gSceneConfig._pointSize > 0.0f)
+    {
+        gParticleManager.SetPointSize(gSceneConfig._pointSize);
+    }
+    if (gSceneConfig._brightness > 0.0f)
+    {
+        gParticleManager.SetParticleBrightness(gSceneConfig._brightness);
+    }
+
+    // the other GPUs draw the same pool from the same scene, with the display's look
+    if (gGpuCount > 1)
+    {
+        unsigned int deviceCount = MultiGpuSimulation::GetDeviceCount();
+        unsigned int shardCount = ((deviceCount < gGpuCount) ? deviceCount : gGpuCount);
+        shardCount = (shardCount > 0) ? shardCount - 1 : 0;
+        if (gRenderMode != PARTICLE_RENDER_MODE_ADDITIVE)
+        {
+            LogPrintf("multi-GPU: only the additive render mode can be split; using 1 GPU\n");
+        }
+        else if (shardCount == 0)
+        {
+            LogPrintf("multi-GPU: asked for %u GPUs, but there is only 1; using 1 GPU\n", 
+                gGpuCount);
+        }
+        else
+        {
+            MultiGpuShardSettings shardSettings;
+            shardSettings._particleCount = gParticleManager.GetMaxParticleCount();
+            shardSettings._layout = particleLayout;
+            ApplySceneConfigToEmitter(gSceneConfig, 1, &shardSettings._emitter);
+            shardSettings._pointSize = gParticleManager.GetPointSize();
+            shardSettings._brightness = gParticleManager.GetParticleBrightness();
+            shardSettings._useQuads = gUseQuads;
+            shardSettings._width = gAppWindow->GetWidth();
+            shardSettings._height = gAppWindow->GetHeight();
+            GLuint compositeProgramId = AcquireRenderProgram("shaderDensityResolve.vert", 
+                "shaderMultiGpuComposite.frag");
+            if (!gMultiGpuSimulation.Init(compositeProgramId, shardCount, shardSettings))
+            {
+                LogPrintf("multi-GPU: using 1 GPU\n");
+            }
+            ReleaseProgram(compositeProgramId);
+        }
+    }
+
+    // the upscale's fullscreen triangle is the same as the density resolve's
+    GLuint upscaleProgramId = AcquireRenderProgram("shaderDensityResolve.vert", 
+        "shaderUpscale.frag");
+    GLuint trailFadeProgramId = AcquireRenderProgram("shaderDensityResolve.vert", 
+        "shaderTrailFade.frag");
+    gScaledRenderTarget.Init(upscaleProgramId, trailFadeProgramId, gAppWindow->GetWidth(), 
+        gAppWindow->GetHeight(), RenderModeNeedsDepth(gRenderMode));
+    ReleaseProgram(upscaleProgramId);
+    ReleaseProgram(trailFadeProgramId);
+    gScaledRenderTarget.SetUpscale(
+        gSharpenUpscale ? SCALED_RENDER_UPSCALE_SHARPEN : SCALED_RENDER_UPSCALE_BILINEAR);
+    gScaledRenderTarget.SetFormat(gScaledRenderFormat);
+    gScaledRenderTarget.SetTrailFade(gTrailFade);
+    if (gBloomIntensity > 0.0f)
+    {
+        GLuint bloomProgramId = AcquireComputeProgram("", "shaderBloom.comp");
+        gBloomFilter.Init(bloomProgramId);
+        ReleaseProgram(bloomProgramId);
+        gBloomFilter.SetThreshold(gBloomThreshold);
+        gScaledRenderTarget.SetBloom(&gBloomFilter, gBloomIntensity);
+    }
+    SetRenderScale(gBaseRenderScale);
+
+    if (gLodMode != PARTICLE_LOD_OFF)
+    {
+        // additive particles make up for the ones that aren't drawn with brightness, and 
+        // opaque ones with size
+        // Note: The density splat goes by the same live indices, and it makes up for them 
+        // with its exposure (see DensitySplatRenderer::SetLodStride(...)).
+        ParticleLodSettings lodSettings;
+        lodSettings._mode = gLodMode;
+        lodSettings._fixedStride = (unsigned int)gLodValue;
+        lodSettings._maxParticlesPerPixel = gLodValue;
+        lodSettings._renderBudgetMs = gLodValue;
+        lodSettings._maxStride = 64;
+        lodSettings._scalesPointSize = RenderModeScalesPointSize(gRenderMode);
+        gParticleManager.SetLevelOfDetail(lodSettings);
+    }
+    gParticleManager.SetUpdateAmortization(gUpdateAmortization);
+
+    // the merge weights stay with the slots of the pool, so the sort would move the particles 
+    // out from under them (see ParticleNeighborGrid::SetMerging(...))
+    if (gMergeDenseCells && gSortParticles)
+    {
+        LogPrintf("\"--merge-dense\" turns off the sort\n");
+        gSortParticles = false;
+    }
+
+    if (gSortParticles)
+    {
+        // the particles don't move far in half a second at 120 updates per second
+        ParticleSortRequest sortRequest;
+        sortRequest._key = PARTICLE_SORT_KEY_MORTON;
+        sortRequest._depthDirection = glm::vec2(0.0f, 1.0f);
+        sortRequest._backToFront = false;
+        sortRequest._updatesBetweenSorts = 60;
+        GLuint sortProgramId = AcquireComputeProgram(
+            ParticleManager::GetSortShaderDefines(particleLayout));
+        gParticleManager.SetParticleSort(sortProgramId, sortRequest);
+        ReleaseProgram(sortProgramId);
+    }
+
+    if (gUseParticleInteractions || gUseSpatialQueries || gMergeDenseCells)
+    {
+        // 100x100 cells over the window; the emitter packs particles much tighter than that 
+        // near its center, so the neighbor cap does most of the limiting there
+        GLuint gridProgramId = AcquireComputeProgram(
+            ParticleNeighborGrid::GetGridShaderDefines(particleLayout, workGroupSize, 
+                gUseSleep, gUseSphFluid));
+        GLuint scanProgramId = AcquireComputeProgram(
+            GpuScan::GetScanShaderDefines(GpuScan::DEFAULT_WORK_GROUP_SIZE,
+            GpuScan::IsSubgroupScanSupported()), "shaderScan.comp");
+        gParticleNeighborGrid.SetBounds(glm::vec2(-1.0f, -1.0f), glm::vec2(+1.0f, +1.0f));
+        gParticleNeighborGrid.SetCellSize(0.02f);
+        gParticleNeighborGrid.SetInteraction(0.5f, 0.1f, 32);
+        gParticleNeighborGrid.SetWakeSpeed(gUseSleep ? 0.01f : 0.0f);
+        if (gUseSphFluid)
+        {
+            // a smoothing radius of 1 cell; the rest density is about 4 neighbors' worth
+            gParticleNeighborGrid.SetSphFluid(4.0f, 0.02f, 0.1f);
+            gParticleNeighborGrid.SetInteractionModel(PARTICLE_INTERACTION_SPH);
+        }
+        else if (gUseBoids)
+        {
+            // the 7 nearest, and no faster than half the window per second
+            gParticleNeighborGrid.SetBoidsSteering(0.5f, 2.0f, 1.0f, 7, 0.5f);
+            gParticleNeighborGrid.SetInteractionModel(PARTICLE_INTERACTION_BOIDS);
+        }
+        else if (gUseDem)
+        {
+            // particles 2/5 of a cell across, relaxed 4 times per frame, with a soft bounce
+            gParticleNeighborGrid.SetDemContact(0.004f, 1.5f, 4, 0.5f);
+            gParticleNeighborGrid.SetDeterministic(gDeterministic);
+            gParticleNeighborGrid.SetInteractionModel(PARTICLE_INTERACTION_DEM);
+        }
+        if (gMergeDenseCells)
+        {
+            // a few dozen particles in a cell is crowded, 8 at most in one, and a cell with 
+            // fewer than 4 is split back out
+            gParticleNeighborGrid.SetMerging(32, 4, 8);
+        }
+        gParticleNeighborGrid.Init(gridProgramId, scanProgramId);
+        ReleaseProgram(gridProgramId);
+        ReleaseProgram(scanProgramId);
+    }
+    if (gUseSpatialQueries)
+    {
+        gParticleSpatialQuery.Init();
+    }
+
+    if (gUseGravityTree)
+    {
+        // weak enough that the emitters' particles drift together over a few seconds instead 
+        // of collapsing into a point, and softened to about a pixel
+        GLuint treeProgramId = AcquireComputeProgram(
+            ParticleGravityTree::GetGravityTreeShaderDefines(particleLayout, workGroupSize));
+        gParticleGravityTree.SetBounds(glm::vec2(-1.0f, -1.0f), glm::vec2(+1.0f, +1.0f));
+        gParticleGravityTree.SetGravity(1e-7f, 0.01f, 0.5f);
+        gParticleGravityTree.Init(treeProgramId);
+        ReleaseProgram(treeProgramId);
+    }
+
+    if (gUseConstraints)
+    {
+        // 256 ropes of 16 particles each from the front of the pool, with links about 2 
+        // pixels long; whichever emitter those particles come from, the ropes stream out of it
+        GLuint solverProgramId = AcquireComputeProgram(
+            ParticleConstraintSolver::GetConstraintShaderDefines(particleLayout, workGroupSize));
+        GLuint ribbonProgramId = AcquireRenderProgram("shaderParticle.vert", 
+            particleFragFilePath, 
+            ParticleConstraintSolver::GetRibbonRenderShaderDefines(particleLayout));
+        const unsigned int ROPE_COUNT = 256;
+        const unsigned int ROPE_PARTICLE_COUNT = 16;
+        unsigned int ropeParticleIndices[ROPE_PARTICLE_COUNT];
+        for (unsigned int ropeIndex = 0; ropeIndex < ROPE_COUNT; ropeIndex++)
+        {
+            if ((ropeIndex + 1) * ROPE_PARTICLE_COUNT > gParticleManager.GetMaxParticleCount())
+            {
+                break;
+            }
+            for (unsigned int link = 0; link < ROPE_PARTICLE_COUNT; link++)
+            {
+                ropeParticleIndices[link] = (ropeIndex * ROPE_PARTICLE_COUNT) + link;
+            }
+            gParticleConstraintSolver.AddChain(ropeParticleIndices, ROPE_PARTICLE_COUNT, 
+                0.005f);
+        }
+        gParticleConstraintSolver.SetSolver(8, 1.0f);
+        gParticleConstraintSolver.SetRibbonStyle(2.0f, 0.5f);
+        gParticleConstraintSolver.Init(solverProgramId, ribbonProgramId);
+        ReleaseProgram(solverProgramId);
+        ReleaseProgram(ribbonProgramId);
+    }
+
+    // the 'j' key can start a recording at any time, but the recorder isn't set up until then
+    gTrajectoryShaderDefines = 
+        ParticleTrajectoryRecorder::GetTrajectoryShaderDefines(particleLayout, workGroupSize);
+
+    GLuint statsProgramId = AcquireComputeProgram(
+        ParticleStatsReducer::GetStatsShaderDefines(particleLayout, workGroupSize));
+    gParticleStatsReducer.Init(statsProgramId);
+    ReleaseProgram(statsProgramId);
+    gParticleStatsReducer.SetInterval(gStatsInterval);
+
+    // an export can only be asked for at startup
+    if (!gHeatmapPath.empty())
+    {
+        GLuint heatmapProgramId = AcquireComputeProgram(
+            ParticleHeatmapExporter::GetHeatmapShaderDefines(particleLayout, workGroupSize));
+        gParticleHeatmapExporter.Init(heatmapProgramId);
+        ReleaseProgram(heatmapProgramId);
+    }
+
+    // the manager's one readback feeds every consumer, however many there are
+    if (!gPublishStateName.empty() && gParticleStatePublisher.Init(gPublishStateName, 
+        particleLayout, gParticleManager.GetMaxParticleCount()))
+    {
+        ParticleReadbackRequest readbackRequest;
+        readbackRequest._firstParticle = 0;
+        readbackRequest._particleCount = 0;
+        readbackRequest._updatesBetweenReadbacks = 1;
+        gParticleManager.SetParticleReadback(readbackRequest, 
+            [](const ParticleReadbackFrame &frame) { gParticleStatePublisher.Publish(frame); });
+    }
+    if (gStreamPort != 0 && gParticleStreamServer.Start(gStreamPort, 
+        gParticleManager.GetMaxParticleCount(), gStreamBits, gStreamFps))
+    {
+        GLuint trajectoryProgramId = AcquireComputeProgram(gTrajectoryShaderDefines);
+        gParticleStreamRecorder.Init(trajectoryProgramId);
+        ReleaseProgram(trajectoryProgramId);
+        gParticleStreamRecorder.SetFrameSink([](const ParticleTrajectoryFrameHeader &frame, 
+            const unsigned char *encoded) { gParticleStreamServer.SubmitFrame(frame, encoded); });
+        gParticleStreamRecorder.Start("", gParticleManager.GetMaxParticleCount());
+    }
+    MarkStartupPhase("features");
+
+    // 120Hz simulation, and give up on catching up after 4 steps in one frame
+    gSimulationClock.Init(1.0f / SIMULATION_STEPS_PER_SECOND, 4);
+
+    gGpuProfiler.Init(300);
+    gUpdateScopeId = gGpuProfiler.AddScope("update");
+    gRenderScopeId = gGpuProfiler.AddScope("render");
+    gSortScopeId = gGpuProfiler.AddScope("sort");
+    gInteractScopeId = gGpuProfiler.AddScope("interact");
+    gGravityScopeId = gGpuProfiler.AddScope("gravity");
+    gConstraintScopeId = gGpuProfiler.AddScope("ropes");
+    gFluidScopeId = gGpuProfiler.AddScope("fluid");
+    gStatsScopeId = gGpuProfiler.AddScope("stats");
+    if (gUseHardwareCounters)
+    {
+        gHardwareCounters.SetCounterFilter(gHardwareCounterFilter);
+        gHardwareCounters.Init(300);
+        gUpdateCounterScopeId = gHardwareCounters.AddScope("update");
+        gRenderCounterScopeId = gHardwareCounters.AddScope("render");
+    }
+    if (gUsePipelineStatistics)
+    {
+        // the update's compute invocations and the render's vertices and fragments
+        gGpuProfiler.EnablePipelineStatistics(gUpdateScopeId);
+        gGpuProfiler.EnablePipelineStatistics(gRenderScopeId);
+    }
+    if (gUseParticleInteractions && gUseDem)
+    {
+        // inside the interact scope, around only the iterations
+        gDemScopeId = gGpuProfiler.AddScope("dem relax");
+        gParticleNeighborGrid.SetDemProfiler(&gGpuProfiler, gDemScopeId);
+    }
+    if (gParticleManager.GetSimulationBackend() == PARTICLE_SIMULATION_BACKEND_SPLIT)
+    {
+        // inside the update scope; the update's GPU time is the slower of the two sides
+        gSplitGpuScopeId = gGpuProfiler.AddScope("update gpu part");
+        gParticleManager.SetSplitProfiler(&gGpuProfiler, gSplitGpuScopeId);
+    }
+
+    // the last 240 frames with 50ms at the top; the line in the middle-ish is 60fps
+    // Note: The graph draws with the same program as the particles.
+    gFrameGraphOverlay.Init(particleProgramId, 240, 50.0f);
+    ReleaseProgram(particleProgramId);
+
+    // every program has been acquired by now, so every shader file that they use is watched
+    gShaderHotReloader.Init();
+
+    // the snapshot has its own emitter table, so it must come before the worker's copy
+    if (gLoadSnapshotAtStart)
+    {
+        gParticleManager.LoadSnapshot(gSnapshotPath);
+    }
+
+    // the emitters are done changing, so the worker's copy can be taken
+    gPrepBaseEmitters = gParticleManager.GetEmitters();
+    if (gPrepRecordThreadCount > 0)
+    {
+        gPrepThreadPool.Init(gPrepRecordThreadCount);
+    }
+    gFramePrepPipeline.Init(PrepareFrame, gUseFramePrepThread);
+    gAsyncLoader.Init(gAsyncLoadWorkerCount);
+    if (gKeyframeCount > 0)
+    {
+        gParticleKeyframeRing.Init(&gParticleManager, gKeyframeCount, gUpdatesPerKeyframe);
+    }
+
+    // 8 slots of 16K records is a little over 2 frames of the producer's batches in flight
+    if ((gUseInjection || gUseDomainShard) && gParticleInjectionRing.Init(8, 16384))
+    {
+        if (!gParticleManager.SetInjectionRing(&gParticleInjectionRing))
+        {
+            LogPrintf("injection: this simulation can't inject (deterministic, fused emit, or "
+                "CPU), so the streamed particles are dropped\n");
+        }
+        if (gUseInjection)
+        {
+            gInjectionThread = std::thread(RunInjectionProducer);
+        }
+    }
+
+    // after the ring, since the shard's network thread starts writing arrivals into it
+    if (gUseDomainShard)
+    {
+        GLuint migrationProgramId = AcquireComputeProgram(
+            ParticleDomainShard::GetMigrationShaderDefines(particleLayout, workGroupSize));
+        gParticleDomainShard.Init(migrationProgramId, gDomainSettings, 
+            &gParticleInjectionRing);
+        ReleaseProgram(migrationProgramId);
+    }
+
+    // the governor scales the emission from where it is now, and it has its own copy of the 
+    // counts because the worker's copy is only for the worker
+    gBaseEmitCounts.clear();
+    for (size_t emitterIndex = 0; emitterIndex < gPrepBaseEmitters.size(); emitterIndex++)
+    {
+        gBaseEmitCounts.push_back(gPrepBaseEmitters[emitterIndex]._maxParticlesEmittedPerFrame);
+    }
+    ApplyEmissionRates();
+    gUseGovernor = gUseGovernor && !gDeterministic && !gComputeOnly;
+    if (gUseGovernor)
+    {
+        gFrameBudgetGovernor.Init(gFrameBudgetMs, SIMULATION_STEPS_PER_SECOND);
+        LogPrintf("frame budget governor: %.1fms of update and render\n", gFrameBudgetMs);
+    }
+
+    if (gLogFrameStats)
+    {
+        gFrameStatsLog.Init("frameStats.csv");
+    }
+
+    // everything that startup allocated, and an out-of-memory that wasn't caught closer to 
+    // where it happened
+    CheckGlOutOfMemory("startup");
+    PrintGpuMemoryReport();
+    MarkStartupPhase("profiling and logs");
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Self-explanatory.
+Parameters:
+    emitterIndex    Self-explanatory.
+    emitter         The emitter with the emission that it was set up with.
+Returns:
+    A copy of the emitter with the governor's emission scale (see ApplyGovernorKnobs(...)).  An
+    emitter that emits at all still emits at least 1 particle a frame.
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+ParticleEmitter ScaleEmission(unsigned int emitterIndex, const ParticleEmitter &emitter)
+{
+    ParticleEmitter scaled = emitter;
+    if (emitterIndex < gBaseEmitCounts.size() && gBaseEmitCounts[emitterIndex] > 0)
+    {
+        unsigned int emitCount = 
+            (unsigned int)((gBaseEmitCounts[emitterIndex] * gEmissionScale) + 0.5f);
+        scaled._maxParticlesEmittedPerFrame = (emitCount > 0) ? emitCount : 1;
+    }
+    return scaled;
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Shares "--emit-rate" out between the emitters in proportion to the quotas that they were 
+    set up with (so the sparks' emitters, with none, get none), with the governor's emission 
+    scale (see ApplyGovernorKnobs(...)).  Does nothing without a rate, which leaves the 
+    emitters on their quotas per frame.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ApplyEmissionRates()
+{
+    if (gEmissionRatePerSec <= 0.0f)
+    {
+        return;
+    }
+
+    unsigned int totalEmitCount = 0;
+    for (size_t emitterIndex = 0; emitterIndex < gBaseEmitCounts.size(); emitterIndex++)
+    {
+        totalEmitCount += gBaseEmitCounts[emitterIndex];
+    }
+    if (totalEmitCount == 0)
+    {
+        return;
+    }
+
+    std::vector<float> rates(gBaseEmitCounts.size());
+    for (size_t emitterIndex = 0; emitterIndex < gBaseEmitCounts.size(); emitterIndex++)
+    {
+        rates[emitterIndex] = gEmissionRatePerSec * gEmissionScale * 
+            ((float)gBaseEmitCounts[emitterIndex] / (float)totalEmitCount);
+    }
+    gParticleManager.SetEmissionRates(rates);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Puts the frame budget governor's knobs into effect (see FrameBudgetGovernor.h).
+Parameters:
+    knobs   Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ApplyGovernorKnobs(const FrameBudgetKnobs &knobs)
+{
+    if (knobs._emissionScale != gEmissionScale)
+    {
+        gEmissionScale = knobs._emissionScale;
+        unsigned int emitterCount = (unsigned int)gParticleManager.GetEmitters().size();
+        for (unsigned int emitterIndex = 0; emitterIndex < emitterCount; emitterIndex++)
+        {
+            gParticleManager.SetEmitter(emitterIndex, 
+                ScaleEmission(emitterIndex, gParticleManager.GetEmitters()[emitterIndex]));
+        }
+        ApplyEmissionRates();
+    }
+
+    // an explicit level of detail mode is left alone
+    if (gLodMode == PARTICLE_LOD_OFF)
+    {
+        ParticleLodSettings lodSettings;
+        lodSettings._mode = (knobs._lodStride > 1) ? PARTICLE_LOD_FIXED : PARTICLE_LOD_OFF;
+        lodSettings._fixedStride = knobs._lodStride;
+        lodSettings._maxParticlesPerPixel = 0.0f;
+        lodSettings._renderBudgetMs = 0.0f;
+        lodSettings._maxStride = knobs._lodStride;
+        lodSettings._scalesPointSize = RenderModeScalesPointSize(gRenderMode);
+        gParticleManager.SetLevelOfDetail(lodSettings);
+    }
+
+    gSimulationClock.SetStepSec(1.0f / knobs._stepsPerSecond);
+    SetRenderScale(gBaseRenderScale * knobs._resolutionScale);
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Puts a scene file that was saved while the demo runs into effect (see SceneConfig.h).  
+    Only the values that are different from the last scene are applied, so a pool that 
+    "--gpu-memory-budget" shrank stays that way unless the count in the file changes.
+
+    The emitter's parameters and the point size and brightness are uploads, and they take 
+    effect on this frame.  A new particle count resizes the pool in place, which the CPU and 
+    split backends can't do.  The layout and the window size need a restart, which is logged.
+Parameters:
+    config  Self-explanatory.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ApplySceneConfigChanges(const SceneConfig &config)
+{
+    SceneConfig oldConfig = gSceneConfig;
+    gSceneConfig = config;
+    LogPrintf("scene config '%s' changed\n", gSceneConfigPath.c_str());
+
+    if (config._emitterCenter != oldConfig._emitterCenter || 
+        config._emitterRadius != oldConfig._emitterRadius || 
+        config._minVelocity != oldConfig._minVelocity || 
+        config._maxVelocity != oldConfig._maxVelocity || 
+        config._maxParticlesEmittedPerFrame != oldConfig._maxParticlesEmittedPerFrame || 
+        config._lifetimeSec != oldConfig._lifetimeSec)
+    {
+        // the governor scales the new emission from now on
+        unsigned int emitterCount = (unsigned int)gParticleManager.GetEmitters().size();
+        for (unsigned int emitterIndex = 0; emitterIndex < emitterCount; emitterIndex++)
+        {
+            ParticleEmitter emitter = gParticleManager.GetEmitters()[emitterIndex];
+            ApplySceneConfigToEmitter(config, emitterCount, &emitter);
+            if (emitterIndex < gBaseEmitCounts.size())
+            {
+                gBaseEmitCounts[emitterIndex] = emitter._maxParticlesEmittedPerFrame;
+            }
+            gParticleManager.SetEmitter(emitterIndex, ScaleEmission(emitterIndex, emitter));
+        }
+        ApplyEmissionRates();
+    }
+
+    // 0 means the render mode's default, which was already replaced, so it is left as it is
+    if (config._pointSize != oldConfig._pointSize && config._pointSize > 0.0f)
+    {
+        gParticleManager.SetPointSize(config._pointSize);
+    }
+    if (config._brightness != oldConfig._brightness && config._brightness > 0.0f)
+    {
+        gParticleManager.SetParticleBrightness(config._brightness);
+    }
+
+    if (config._particleCount != oldConfig._particleCount && config._particleCount > 0)
+    {
+        gParticleManager.Resize(config._particleCount);
+        LogPrintf("particle pool: %u\n", gParticleManager.GetMaxParticleCount());
+    }
+
+    if (config._particleLayout != oldConfig._particleLayout || 
+        config._windowWidth != oldConfig._windowWidth || 
+        config._windowHeight != oldConfig._windowHeight)
+    {
+        LogPrintf("the particle layout and the window size take effect on the next run\n");
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Every SPATIAL_QUERY_INTERVAL_FRAMES frames, queues a count of the particles within 0.1 of
+    the pointer and a search for the nearest 4 to it, whose callbacks log the results a few
+    frames later.  Called right before the spatial queries run.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void QueuePointerQueries()
+{
+    if ((gFrameIndex % SPATIAL_QUERY_INTERVAL_FRAMES) != 0)
+    {
+        return;
+    }
+
+    glm::vec2 point = gPointerInput._position;
+    gParticleSpatialQuery.QueueCircleQuery(point, 0.1f, 
+        [point](const ParticleSpatialQueryResult &result)
+    {
+        LogPrintf("query %u: %u particles within 0.1 of (%.3f, %.3f)\n", result._queryId, 
+            result._count, point.x, point.y);
+    });
+    gParticleSpatialQuery.QueueNearestQuery(point, 4, 0.0f, 
+        [](const ParticleSpatialQueryResult &result)
+    {
+        if (result._count == 0)
+        {
+            LogPrintf("query %u: no particles near the pointer\n", result._queryId);
+            return;
+        }
+        LogPrintf("query %u: nearest particle %u at %.4f, farthest of the %u at %.4f\n", 
+            result._queryId, result._nearestIndices[0], result._nearestDistances[0], 
+            result._count, result._nearestDistances[result._count - 1]);
+    });
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    With "--power-save", sleeps until the frame is due, at the idle rate if the window can't 
+    be seen, and switches the simulation to fewer, longer steps while the window is unseen or 
+    untouched (see gPowerSaveFps).  Every so many frames it samples the GPU's power, and every 
+    POWER_SAVE_REPORT_SEC it logs the frame rate and the energy per displayed frame, which is 
+    what a cap is for.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void PacePowerSaveFrame()
+{
+    if (!gFrameRateLimiter.IsEnabled())
+    {
+        return;
+    }
+
+    bool isIdle = !gAppWindow->IsVisible();
+    gFrameRateLimiter.WaitForNextFrame(isIdle);
+
+    double nowMs = GetPacingClockMs();
+    bool isUntouched = (nowMs - gLastInputTimeMs) > POWER_SAVE_UNTOUCHED_SEC * 1000.0;
+    bool isCoarseStepping = (isIdle || isUntouched) && !gUseGovernor && !gDeterministic && 
+        !gInputEventLog.IsReplaying();
+    if (isCoarseStepping != gIsCoarseStepping)
+    {
+        gIsCoarseStepping = isCoarseStepping;
+        float stepsPerSecond = isCoarseStepping ? 
+            (SIMULATION_STEPS_PER_SECOND / 2.0f) : (float)SIMULATION_STEPS_PER_SECOND;
+        gSimulationClock.SetStepSec(1.0f / stepsPerSecond);
+        LogPrintf("power save: %s, %.0f steps a second\n", 
+            isIdle ? "idle" : (isUntouched ? "untouched" : "active"), stepsPerSecond);
+    }
+
+    GpuClockSample clockSample;
+    if ((gFrameIndex % POWER_SAVE_SAMPLE_FRAMES) == 0 && gPowerMonitor.Sample(&clockSample) && 
+        clockSample._powerW >= 0.0f)
+    {
+        gPowerSumW += clockSample._powerW;
+        gPowerSampleCount++;
+    }
+    gPowerReportFrameCount++;
+    double reportSec = (nowMs - gPowerReportStartMs) / 1000.0;
+    if (reportSec >= POWER_SAVE_REPORT_SEC)
+    {
+        double framesPerSecond = gPowerReportFrameCount / reportSec;
+        if (gPowerSampleCount > 0)
+        {
+            double averageW = gPowerSumW / gPowerSampleCount;
+            LogPrintf("power save: %.1f fps%s, GPU %.1f W, %.1f mJ per frame\n", 
+                framesPerSecond, isIdle ? " (idle)" : "", averageW, 
+                averageW * 1000.0 / framesPerSecond);
+        }
+        else
+        {
+            LogPrintf("power save: %.1f fps%s, GPU power unknown\n", framesPerSecond, 
+                isIdle ? " (idle)" : "");
+        }
+        gPowerSumW = 0.0;
+        gPowerSampleCount = 0;
+        gPowerReportStartMs = nowMs;
+        gPowerReportFrameCount = 0;
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Draws the particles again in each of the shared windows (see gSharedWindowCount), after 
+    the main window's frame, and swaps each one.  Nothing is simulated or uploaded again, 
+    so each window only costs its own draw.  Hidden and closed windows are skipped.
+Parameters:
+    extrapolationSec    The main window's, so that all of the windows show the same moment.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void RenderSharedWindows(float extrapolationSec)
+{
+    unsigned int sharedWindowCount = gAppWindow->GetSharedWindowCount();
+    if (sharedWindowCount == 0 || gRenderMode == PARTICLE_RENDER_MODE_DENSITY_SPLAT || 
+        gRenderMode == PARTICLE_RENDER_MODE_WEIGHTED_OIT || gShowOverdraw)
+    {
+        return;
+    }
+    TRACE_SCOPE("RenderSharedWindows");
+
+    // the shared windows draw straight into their own framebuffers, at full size
+    GLbitfield clearBits = GL_COLOR_BUFFER_BIT;
+    if (RenderModeNeedsDepth(gRenderMode))
+    {
+        clearBits |= GL_DEPTH_BUFFER_BIT;
+    }
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    gParticleManager.SetViewportMask(1);
+    gParticleManager.SetRenderScale(1.0f);
+    for (unsigned int sharedIndex = 0; sharedIndex < sharedWindowCount; sharedIndex++)
+    {
+        int width = 0;
+        int height = 0;
+        if (!gAppWindow->BeginSharedWindow(sharedIndex, &width, &height))
+        {
+            continue;
+        }
+        glViewport(0, 0, width, height);
+        gParticleManager.SetViewportSize(width, height);
+        glClear(clearBits);
+        gParticleManager.Render(extrapolationSec);
+        gAppWindow->EndSharedWindow();
+    }
+
+    // the main window's size, as Reshape(...) left it
+    glViewport(0, 0, gAppWindow->GetWidth(), gAppWindow->GetHeight());
+    gParticleManager.SetViewportSize(gAppWindow->GetWidth(), gAppWindow->GetHeight());
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    This is the rendering function.  It tells OpenGL to clear out some color and depth buffers,
+    to set up the data to draw, to draw than stuff, and to report any errors that it came across.
+    This is not a user-called function.
+
+    This is called once per pass of the frame loop in main(), after the window's events.
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (2-13-2016)
+-----------------------------------------------------------------------------------------------*/
+void Display()
+{
+    TRACE_SCOPE("Display");
+
+    // the waits for the frame's deadline and for the GPU are before the frame's timing 
+    // starts, so they show up as their own column instead of as CPU time
+    {
+        TRACE_SCOPE("WaitForFrameDeadline");
+        PacePowerSaveFrame();
+    }
+    {
+        TRACE_SCOPE("WaitForFrameSlot");
+        gFramePacer.WaitForFrameSlot();
+    }
+    std::chrono::high_resolution_clock::time_point displayStart = 
+        std::chrono::high_resolution_clock::now();
+    unsigned long long allocationCountAtStart = GetHeapAllocationCount();
+    GetFrameArena().BeginFrame();
+
+    // the top of the frame is the only place where programs are swapped, so a frame never 
+    // mixes old and new shaders
+    std::vector<ShaderProgramSwap> programSwaps;
+    if (gShaderHotReloader.Update(&programSwaps))
+    {
+        for (size_t swapIndex = 0; swapIndex < programSwaps.size(); swapIndex++)
+        {
+            const ShaderProgramSwap &swap = programSwaps[swapIndex];
+            gParticleManager.ReplaceProgram(swap._oldProgramId, swap._newProgramId);
+            gDensitySplatRenderer.ReplaceProgram(swap._oldProgramId, swap._newProgramId);
+            gDensitySurfaceRenderer.ReplaceProgram(swap._oldProgramId, swap._newProgramId);
+            gWeightedOitRenderer.ReplaceProgram(swap._oldProgramId, swap._newProgramId);
+            gOverdrawVisualizer.ReplaceProgram(swap._oldProgramId, swap._newProgramId);
+            gParticleNeighborGrid.ReplaceProgram(swap._oldProgramId, swap._newProgramId);
+            gParticleGravityTree.ReplaceProgram(swap._oldProgramId, swap._newProgramId);
+            gParticleConstraintSolver.ReplaceProgram(swap._oldProgramId, swap._newProgramId);
+            gParticleTrajectoryRecorder.ReplaceProgram(swap._oldProgramId, swap._newProgramId);
+            gParticleStreamRecorder.ReplaceProgram(swap._oldProgramId, swap._newProgramId);
+            gParticleStatsReducer.ReplaceProgram(swap._oldProgramId, swap._newProgramId);
+            gParticleHeatmapExporter.ReplaceProgram(swap._oldProgramId, swap._newProgramId);
+            gParticleDomainShard.ReplaceProgram(swap._oldProgramId, swap._newProgramId);
+            gParticleFieldTexture.ReplaceProgram(swap._oldProgramId, swap._newProgramId);
+            gParticleBoundarySdf.ReplaceProgram(swap._oldProgramId, swap._newProgramId);
+            gBloomFilter.ReplaceProgram(swap._oldProgramId, swap._newProgramId);
+            gStableFluidSolver.ReplaceProgram(swap._oldProgramId, swap._newProgramId);
+            gParticleSegmentBvh.ReplaceProgram(swap._oldProgramId, swap._newProgramId);
+            gParticleEmissionImage.ReplaceProgram(swap._oldProgramId, swap._newProgramId);
+            gFrameGraphOverlay.ReplaceProgram(swap._oldProgramId, swap._newProgramId);
+            gScaledRenderTarget.ReplaceProgram(swap._oldProgramId, swap._newProgramId);
+            ReleaseProgram(swap._newProgramId);
+        }
+    }
+
+    // the loads in flight (ex: the 'o' key's snapshot) get their share of the frame before 
+    // anything else is issued, so a snapshot's emitter table is in place for this frame
+    gAsyncLoader.RunGlSteps(gAsyncLoadBudgetMs);
+
+    // the previous frame started this one's CPU work on the worker before it swapped, so 
+    // usually it is already done and this doesn't wait
+    const FramePrepOutput *prepared = gFramePrepPipeline.TakePrepared();
+    if (prepared != 0)
+    {
+        if (prepared->_hasSceneConfig)
+        {
+            gInputEventLog.RecordSceneConfig(gFrameIndex, prepared->_sceneConfig);
+            ApplySceneConfigChanges(prepared->_sceneConfig);
+        }
+        ExecuteGlCommandLists(prepared->_commandLists);
+        if (prepared->_hasFrameGraphSample)
+        {
+            gFrameGraphOverlay.AddSample(prepared->_frameGraphSampleMs);
+        }
+    }
+
+    bool isRenderFrame = !gComputeOnly || 
+        (gPreviewInterval != 0 && (gFrameIndex % gPreviewInterval) == 0);
+
+    // the clear and the particles go into the scaled render target, if it is smaller than the 
+    // window, and it is stretched over the window right after the particles
+    bool isScaledRender = isRenderFrame && gRenderMode != PARTICLE_RENDER_MODE_DENSITY_SPLAT && 
+        gScaledRenderTarget.Begin();
+    gParticleManager.SetRenderScale(isScaledRender ? gScaledRenderTarget.GetScale() : 1.0f);
+    // Note: With trails, the target already holds the faded last frame, so only the depth is 
+    // cleared.
+    if (isRenderFrame)
+    {
+        GLbitfield clearBits = 
+            (isScaledRender && gScaledRenderTarget.HasTrails()) ? 0 : GL_COLOR_BUFFER_BIT;
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        if (RenderModeNeedsDepth(gRenderMode))
+        {
+            glClearDepth(1.0f);
+            clearBits |= GL_DEPTH_BUFFER_BIT;
+        }
+        if (clearBits != 0)
+        {
+            glClear(clearBits);
+        }
+    }
+
+    // run however many fixed steps of simulation time have passed since the last frame
+    unsigned int numSteps = ((gComputeOnly && !gComputeOnlyRealTime) || gDeterministic) ? 
+        gSimulationClock.BeginUnpacedFrame() : gSimulationClock.BeginFrame();
+    gParticleManager.SetView(gCamera.GetViewProjection(), gCullOffscreenParticles);
+    gParticleMultiViewport.SetView(gCamera.GetViewProjection());
+
+    // a stream's viewer has nothing to simulate, and an update with no time in it only 
+    // rebuilds the draw lists around the particles that were received
+    if (!gStreamClientAddress.empty())
+    {
+        numSteps = 0;
+        if (gParticleStreamGather.TakeLatestFrame(&gStreamedParticles) && 
+            gParticleManager.LoadParticles(gStreamedParticles))
+        {
+            gParticleManager.UpdateSteps(0.0f, 1);
+        }
+    }
+    // the fluid moves first, so that the update carries the particles along with this frame's 
+    // flow; two jets circle the middle of the window in opposite directions and stir it up
+    if (gUseFluidGrid && numSteps > 0)
+    {
+        float jetAngle = (float)gSimulationTimeSec * 0.7f;
+        glm::vec2 jetOffset(cosf(jetAngle) * 0.4f, sinf(jetAngle) * 0.4f);
+        glm::vec2 jetAcceleration(-jetOffset.y * 2.5f, jetOffset.x * 2.5f);
+        gGpuProfiler.BeginScope(gFluidScopeId);
+        gStableFluidSolver.AddForce(jetOffset, jetAcceleration, 0.08f);
+        gStableFluidSolver.AddForce(-jetOffset, jetAcceleration, 0.08f);
+        gStableFluidSolver.Step(numSteps * gSimulationClock.GetStepSec());
+        gGpuProfiler.EndScope(gFluidScopeId);
+    }
+    gGpuProfiler.BeginScope(gUpdateScopeId);
+    gHardwareCounters.BeginScope(gUpdateCounterScopeId);
+    gParticleCostAttribution.BeginUpdate();
+    gParticleManager.UpdateSteps(gSimulationClock.GetStepSec(), numSteps);
+    gParticleKeyframeRing.RecordUpdate(gSimulationClock.GetStepSec(), numSteps);
+    gParticleCostAttribution.EndUpdate(numSteps);
+    gHardwareCounters.EndScope(gUpdateCounterScopeId);
+    gGpuProfiler.EndScope(gUpdateScopeId);
+    gMultiGpuSimulation.Update(gSimulationClock.GetStepSec(), numSteps, 
+        gCamera.GetViewProjection(), gCullOffscreenParticles);
+    gSimulationTimeSec += numSteps * gSimulationClock.GetStepSec();
+
+    // only on the frames that it is due, so the profiler's sort times are for whole sorts
+    if (gParticleManager.IsParticleSortDue())
+    {
+        gGpuProfiler.BeginScope(gSortScopeId);
+        gParticleManager.SortParticles();
+        gGpuProfiler.EndScope(gSortScopeId);
+    }
+
+    // the grid is rebuilt from wherever the updates left the particles, and the interactions 
+    // make up for all of this frame's steps at once
+    // Note: The queries run before the interactions, while the grid's cells still match where 
+    // the particles are.
+    // Also Note: The merge goes last, after everything that reads the grid, since it moves 
+    // particles and kills some of them.
+    if ((gUseParticleInteractions || gUseSpatialQueries || gMergeDenseCells) && numSteps > 0)
+    {
+        gGpuProfiler.BeginScope(gInteractScopeId);
+        gParticleNeighborGrid.Build(gParticleManager.GetMaxParticleCount());
+        if (gUseSpatialQueries)
+        {
+            QueuePointerQueries();
+            gParticleSpatialQuery.Update(&gParticleNeighborGrid);
+        }
+        if (gUseParticleInteractions)
+        {
+            gParticleNeighborGrid.ApplyInteractions(numSteps * gSimulationClock.GetStepSec(), 
+                gParticleManager.GetMaxParticleCount());
+        }
+        if (gMergeDenseCells)
+        {
+            gParticleNeighborGrid.MergeDenseCells(gParticleManager);
+        }
+        gGpuProfiler.EndScope(gInteractScopeId);
+    }
+
+    // same as the interactions; the tree is built over wherever they left the particles
+    if (gUseGravityTree && numSteps > 0)
+    {
+        gGpuProfiler.BeginScope(gGravityScopeId);
+        gParticleGravityTree.Build(gParticleManager.GetMaxParticleCount());
+        gParticleGravityTree.ApplyGravity(numSteps * gSimulationClock.GetStepSec(), 
+            gParticleManager.GetMaxParticleCount());
+        gGpuProfiler.EndScope(gGravityScopeId);
+    }
+
+    // last, so that nothing pulls the ropes apart again before they are drawn
+    if (gUseConstraints && numSteps > 0)
+    {
+        gGpuProfiler.BeginScope(gConstraintScopeId);
+        gParticleConstraintSolver.Solve(numSteps * gSimulationClock.GetStepSec(), 
+            gParticleManager.GetMaxParticleCount());
+        gGpuProfiler.EndScope(gConstraintScopeId);
+    }
+
+    // after everything that moved them, so that a particle is handed over in the frame that 
+    // it leaves, and before the recorders, so that the stream doesn't show it on both nodes
+    gParticleDomainShard.MigrateParticles(gParticleManager);
+
+    // where the particles are after everything that moved them this frame
+    gParticleTrajectoryRecorder.RecordFrame(gFrameIndex);
+    gParticleStreamRecorder.RecordFrame(gFrameIndex);
+    gParticleHeatmapExporter.RecordFrame(gParticleManager.GetMaxParticleCount(), 
+        gSimulationTimeSec);
+
+    // only does anything every so many frames, so the profiler's stats times are mostly 0
+    gGpuProfiler.BeginScope(gStatsScopeId);
+    gParticleStatsReducer.Update(gParticleManager.GetMaxParticleCount());
+    gGpuProfiler.EndScope(gStatsScopeId);
+
+    // this handles its own bindings and cleans up when it is done
+    // Note: Draw the particles where they would be at this point between simulation steps.
+    if (isRenderFrame)
+    {
+        float extrapolationSec = 
+            gSimulationClock.GetInterpolationAlpha() * gSimulationClock.GetStepSec();
+        if (gUsePipelineStatistics)
+        {
+            // the pixels that the particles are drawn to, so that the fragments can be printed 
+            // per pixel
+            GLint viewport[4] = { 0, 0, 0, 0 };
+            glGetIntegerv(GL_VIEWPORT, viewport);
+            gGpuProfiler.SetScopePixelCount(gRenderScopeId, 
+                (unsigned long long)viewport[2] * (unsigned long long)viewport[3]);
+        }
+        gGpuProfiler.BeginScope(gRenderScopeId);
+        gHardwareCounters.BeginScope(gRenderCounterScopeId);
+        if (gRenderMode == PARTICLE_RENDER_MODE_DENSITY_SPLAT)
+        {
+            gDensitySplatRenderer.SetLodStride(gParticleManager.GetLodStride());
+            if (gUseDensitySurface)
+            {
+                if (gDensitySplatRenderer.Splat(extrapolationSec, 
+                    gParticleManager.GetMaxParticleCount()))
+                {
+                    gDensitySurfaceRenderer.Render(gDensitySplatRenderer);
+                }
+            }
+            else
+            {
+                gDensitySplatRenderer.Render(extrapolationSec, 
+                    gParticleManager.GetMaxParticleCount());
+            }
+        }
+        else
+        {
+            // the ribbons are translucent along with the particles in the weighted OIT mode, 
+            // but the overdraw only counts the particles, since the ribbons have their own 
+            // fragment shader
+            bool isOverdrawRender = gShowOverdraw && gOverdrawVisualizer.Begin();
+            bool isOitRender = !isOverdrawRender && 
+                gRenderMode == PARTICLE_RENDER_MODE_WEIGHTED_OIT && gWeightedOitRenderer.Begin();
+            bool isInsetRender = gRenderMode != PARTICLE_RENDER_MODE_WEIGHTED_OIT && 
+                !gShowOverdraw;
+            unsigned int viewportMask = isInsetRender ? 
+                gParticleMultiViewport.BeginBroadcast(gIsInsetBroadcast) : 1;
+            gParticleManager.SetViewportMask(viewportMask);
+            gParticleManager.Render(extrapolationSec);
+            gParticleMultiViewport.EndBroadcast();
+
+            // without the broadcast, each inset costs a draw of its own
+            for (unsigned int insetIndex = 0; isInsetRender && viewportMask == 1 && 
+                insetIndex < gParticleMultiViewport.GetInsetCount(); insetIndex++)
+            {
+                if (gParticleMultiViewport.BeginInset(insetIndex))
+                {
+                    gParticleManager.Render(extrapolationSec);
+                    gParticleMultiViewport.EndInset();
+                }
+            }
+            if (isOverdrawRender)
+            {
+                gOverdrawVisualizer.End();
+            }
+            gParticleConstraintSolver.RenderRibbons(extrapolationSec);
+            if (isOitRender)
+            {
+                gWeightedOitRenderer.End();
+            }
+            gMultiGpuSimulation.Composite();
+            gScaledRenderTarget.End();
+        }
+        gHardwareCounters.EndScope(gRenderCounterScopeId);
+        gGpuProfiler.EndScope(gRenderScopeId);
+    }
+
+    // the driver's performance warnings are printed with the GPU timings
+    gDebugPerformanceMessages.clear();
+    TakeDebugPerformanceMessages(&gDebugPerformanceMessages);
+    for (size_t messageIndex = 0; messageIndex < gDebugPerformanceMessages.size(); messageIndex++)
+    {
+        const DebugMessage &message = gDebugPerformanceMessages[messageIndex];
+        gGpuProfiler.AddDriverMessage(message._id, message._text);
+    }
+    gGpuProfiler.EndFrame();
+    gHardwareCounters.EndFrame();
+
+    // the frame budget level of detail and the governor go by the GPU's recent times
+    GpuProfilerStats updateStats;
+    GpuProfilerStats renderStats;
+    bool hasUpdateStats = gGpuProfiler.GetStats(gUpdateScopeId, &updateStats);
+    bool hasRenderStats = isRenderFrame && gGpuProfiler.GetStats(gRenderScopeId, &renderStats);
+    if (hasRenderStats)
+    {
+        gParticleManager.ReportRenderTime(renderStats._lastMs);
+    }
+    if (gUseCostAttribution && hasUpdateStats && (gFrameIndex % 300) == 0)
+    {
+        // on the profiler's print interval, so that it lands with the GPU timings
+        gParticleCostAttribution.PrintReport(gParticleManager.GetDrawGroupFirstEmitters(), 
+            updateStats._avgMs);
+    }
+    if (gUseGovernor && gFrameBudgetGovernor.Update(hasUpdateStats ? updateStats._lastMs : 0.0f,
+        hasRenderStats ? renderStats._lastMs : 0.0f))
+    {
+        ApplyGovernorKnobs(gFrameBudgetGovernor.GetKnobs());
+        LogPrintf("frame budget governor: level %u of %u (%.2fms)\n", 
+            gFrameBudgetGovernor.GetLevel(), gFrameBudgetGovernor.GetLevelCount() - 1, 
+            gFrameBudgetGovernor.GetSmoothedMs());
+    }
+
+    if (gShowFrameGraph && isRenderFrame)
+    {
+        gFrameGraphOverlay.Render();
+    }
+
+    // everything that was drawn, overlay and all
+    if (isRenderFrame)
+    {
+        gFrameCapture.CaptureFrame();
+        gSharedTextureOutput.PublishFrame(gAppWindow->GetWidth(), gAppWindow->GetHeight());
+    }
+
+    // everything for the GPU has been issued, so the worker can get the next frame ready 
+    // while this thread waits in the swap
+    // Note: The last frame's sample is the newest one with its swap time.  This frame's isn't 
+    // done until after the swap.
+    FramePrepInput prepInput;
+    prepInput._frameIndex = gFrameIndex + 1;
+    prepInput._simulationTimeSec = gSimulationTimeSec;
+    prepInput._hasFinishedSample = gHasFinishedSample;
+    prepInput._finishedSample = gFinishedSample;
+    gFramePrepPipeline.Submit(prepInput);
+    GetFrameArena().EndFrame();
+
+    // tell the GPU to swap out the displayed buffer with the one that was just rendered
+    // Note: The swap is timed separately because that's where the driver blocks when the GPU 
+    // is behind (or on vsync), so it tells a different story than the CPU work before it.
+    std::chrono::high_resolution_clock::time_point swapStart = 
+        std::chrono::high_resolution_clock::now();
+    if (isRenderFrame)
+    {
+        TRACE_SCOPE("SwapBuffers");
+        gAppWindow->SwapBuffers();
+        RenderSharedWindows(gSimulationClock.GetInterpolationAlpha() * 
+            gSimulationClock.GetStepSec());
+    }
+    else
+    {
+        // nothing else sends the frame's commands off, and the GPU would sit idle until the 
+        // next frame's fences did
+        glFlush();
+    }
+    TRACE_FRAME();
+    std::chrono::high_resolution_clock::time_point swapEnd = 
+        std::chrono::high_resolution_clock::now();
+    if (!gIsStartupDone)
+    {
+        MarkStartupPhase("first frame");
+        PrintStartupBreakdown();
+        gIsStartupDone = true;
+    }
+    gFramePacer.EndFrame(gParticleManager.GetAppliedPointerInputTimeMs());
 
+    FrameSample sample;
+    sample._frameIndex = gFrameIndex++;
+    sample._pacingWaitMs = gFramePacer.GetLastWaitMs();
+    sample._cpuDisplayMs = 
+        std::chrono::duration<float, std::milli>(swapStart - displayStart).count();
+    sample._swapMs = std::chrono::duration<float, std::milli>(swapEnd - swapStart).count();
+    gParticleManager.GetParticleCounts(&sample._particlesAlive, &sample._particlesEmitted);
+    sample._renderScale = gRenderScale;
+    ParticleStats particleStats = {};
+    gParticleStatsReducer.GetLatestStats(&particleStats);
+    sample._statsLiveCount = particleStats._liveCount;
+    sample._meanSpeed = particleStats._meanSpeed;
+    sample._maxSpeed = particleStats._maxSpeed;
+    sample._boundsMinX = particleStats._minCorner.x;
+    sample._boundsMinY = particleStats._minCorner.y;
+    sample._boundsMaxX = particleStats._maxCorner.x;
+    sample._boundsMaxY = particleStats._maxCorner.y;
+    sample._inputLatencyMs = gFramePacer.GetLastInputLatencyMs();
+    sample._tableUploadBytes = gParticleManager.GetTableUploadBytes();
+    gFinishedSample = sample;
+    gHasFinishedSample = true;
 
-ParticleManager gParticleManager;
+    // the frame is counted through its swap and stats, which are part of the frame path too
+    if (gCountAllocations && sample._frameIndex >= ALLOCATION_COUNT_WARMUP_FRAMES)
+    {
+        unsigned long long allocationCount = GetHeapAllocationCount() - allocationCountAtStart;
+        if (allocationCount > 0)
+        {
+            gAllocatingFrameCount++;
+            gSteadyStateAllocationCount += allocationCount;
+            if (gAllocatingFrameCount <= ALLOCATING_FRAMES_LOGGED)
+            {
+                LogPrintf("frame %u made %llu heap allocations\n", sample._frameIndex, 
+                    allocationCount);
+            }
+        }
+    }
 
+    if (gComputeOnly)
+    {
+        // the steps were issued, not necessarily done, but over a few seconds with the 
+        // parameter ring's fences holding the CPU back, it's the same thing
+        gThroughputStepCount += numSteps;
+        float throughputSec = std::chrono::duration<float>(swapEnd - gThroughputStart).count();
+        if (throughputSec >= 5.0f)
+        {
+            float stepsPerSec = gThroughputStepCount / throughputSec;
+            LogPrintf("compute only: %.1f steps/sec, %.1f million particle steps/sec\n", 
+                stepsPerSec, 
+                (stepsPerSec * gParticleManager.GetMaxParticleCount()) / 1000000.0f);
+            gThroughputStart = swapEnd;
+            gThroughputStepCount = 0;
+        }
+    }
+}
 
-/*-----------------------------------------------------------------------------------------------
-Description:
-    Governs window creation, the initial OpenGL configuration (face culling, depth mask, even
-    though this is a 2D demo and that stuff won't be of concern), the creation of geometry, and
-    the creation of a texture.
-Parameters:
-    argc    (From main(...)) The number of char * items in argv.  For glut's initialization.
-    argv    (From main(...)) A collection of argument strings.  For glut's initialization.
-Returns:
-    False if something went wrong during initialization, otherwise true;
-Exception:  Safe
-Creator:    John Cox (3-7-2016)
------------------------------------------------------------------------------------------------*/
-void Init()
+// what the steps of LoadSnapshotAsync(...) share
+// Note: The loader only destroys it on the GL thread, so it can own the staging buffer.
+struct AsyncSnapshotLoad
 {
-    glEnable(GL_CULL_FACE);
-    glCullFace(GL_BACK);
-    glFrontFace(GL_CCW);
+    std::string _filePath;
+    MappedFile _file;
+    const void *_data;
+    size_t _sizeBytes;
+    GlBuffer _stagingBuffer;
+    size_t _uploadedBytes;
 
-    glEnable(GL_DEPTH_TEST);
-    glDepthMask(GL_TRUE);
-    glDepthFunc(GL_LEQUAL);
-    glDepthRange(0.0f, 1.0f);
+    // the file, if it was read instead of mapped (see LargeHostBuffer::ReadFile(...))
+    LargeHostBuffer _fileCopy;
+};
 
-    GLuint particleProgramId = GenerateVertexShaderProgram();
-    GLuint computeProgramId = GenerateComputeShaderProgram();
-
-    // all values are in windows space (X and Y limited to [-1,+1])
-    // Note: Toy with the values as you will.
-    //unsigned int totalParticles = 20000;
-    unsigned int totalParticles = 600000;
-    unsigned int maxParticlesEmittedPerFrame = 200;
-    glm::vec2 center = glm::vec2(+0.3f, +0.3f);
-    float radius = 1.1f;
-    float minVelocity = 0.05f;
-    float maxVelocity = 0.6f;
-    gParticleManager.Init(particleProgramId,
-        computeProgramId,
-        totalParticles,
-        maxParticlesEmittedPerFrame,
-        center,
-        radius, 
-        minVelocity, 
-        maxVelocity);
-}
+// how much of the file goes to the staging buffer per step; a few of these fit in the budget
+static const size_t ASYNC_SNAPSHOT_UPLOAD_PIECE_BYTES = 4 * 1024 * 1024;
 
 /*-----------------------------------------------------------------------------------------------
 Description:
-    This is the rendering function.  It tells OpenGL to clear out some color and depth buffers,
-    to set up the data to draw, to draw than stuff, and to report any errors that it came across.
-    This is not a user-called function.
+    Starts loading a snapshot (see ParticleManager::LoadSnapshotData(...)) on the async 
+    loader.  A worker maps the file and touches every page of it, so it is read from the 
+    disk there, then the GL thread copies it into a staging buffer a piece per step, and 
+    then the snapshot is loaded from the staging buffer, which only leaves the GPU's copies 
+    and the emitter table for the frame that it finishes on.
 
-    This function is registered with glutDisplayFunc(...) during glut's initialization.
-Parameters: None
+    Note: The frame prep's emitters (see gPrepBaseEmitters) aren't changed, so the snapshot 
+    is meant to be one of this scene's.
+Parameters:
+    filePath    Self-explanatory.
 Returns:    None
 Exception:  Safe
-Creator:    John Cox (2-13-2016)
+Creator:    John Cox (8-17-2016)
 -----------------------------------------------------------------------------------------------*/
-void Display()
+void LoadSnapshotAsync(const std::string &filePath)
 {
-    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-    glClearDepth(1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    std::shared_ptr<AsyncSnapshotLoad> load(new AsyncSnapshotLoad);
+    load->_filePath = filePath;
+    load->_data = 0;
+    load->_sizeBytes = 0;
+    load->_uploadedBytes = 0;
 
-    // in the absence of an actual timer, use a hard-coded delta time
-    gParticleManager.Update(0.01f);
+    std::vector<AsyncLoadStep> steps(3);
+    steps[0]._thread = ASYNC_LOAD_ON_WORKER;
+    steps[0]._run = [load]()
+    {
+        // with large pages on, a file that isn't in the asset pack is read onto them in one 
+        // go, which is the page-in below without a fault per page
+        ParticleSnapshotHeader header;
+        bool isOnLargePages = LargeHostBuffer::IsLargePagesEnabled() && 
+            !FindAsset(load->_filePath, &load->_data, &load->_sizeBytes);
+        if (isOnLargePages)
+        {
+            if (!load->_fileCopy.ReadFile(load->_filePath))
+            {
+                return ASYNC_LOAD_STEP_FAILED;
+            }
+            load->_data = load->_fileCopy.GetData();
+            load->_sizeBytes = load->_fileCopy.GetSizeBytes();
+        }
+        else if (!MapAsset(load->_filePath, &load->_file, &load->_data, &load->_sizeBytes))
+        {
+            return ASYNC_LOAD_STEP_FAILED;
+        }
+        if (!ParticleManager::ReadSnapshotHeader(load->_data, load->_sizeBytes, 
+            load->_filePath, &header))
+        {
+            return ASYNC_LOAD_STEP_FAILED;
+        }
 
-    // this handles its own bindings and cleans up when it is done
-    gParticleManager.Render();
+        // a byte of every page is enough to make the OS read it
+        const volatile unsigned char *fileData = (const volatile unsigned char *)load->_data;
+        for (size_t byteIndex = 0; byteIndex < load->_sizeBytes; byteIndex += 4096)
+        {
+            (void)fileData[byteIndex];
+        }
+        return ASYNC_LOAD_STEP_DONE;
+    };
 
-    // tell the GPU to swap out the displayed buffer with the one that was just rendered
-    glutSwapBuffers();
+    steps[1]._thread = ASYNC_LOAD_ON_GL_THREAD;
+    steps[1]._run = [load]()
+    {
+        if (load->_stagingBuffer == 0)
+        {
+            GLuint bufferId = 0;
+            glGenBuffers(1, &bufferId);
+            load->_stagingBuffer.Reset(bufferId);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, bufferId);
+            LabelGlObject(GL_BUFFER, bufferId, "async particle snapshot staging");
+            glBufferStorage(GL_COPY_WRITE_BUFFER, load->_sizeBytes, 0, GL_DYNAMIC_STORAGE_BIT);
+        }
+        else
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, load->_stagingBuffer);
+        }
+
+        size_t pieceBytes = load->_sizeBytes - load->_uploadedBytes;
+        if (pieceBytes > ASYNC_SNAPSHOT_UPLOAD_PIECE_BYTES)
+        {
+            pieceBytes = ASYNC_SNAPSHOT_UPLOAD_PIECE_BYTES;
+        }
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)load->_uploadedBytes, 
+            (GLsizeiptr)pieceBytes, (const unsigned char *)load->_data + load->_uploadedBytes);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        load->_uploadedBytes += pieceBytes;
+        return (load->_uploadedBytes < load->_sizeBytes) ? 
+            ASYNC_LOAD_STEP_AGAIN : ASYNC_LOAD_STEP_DONE;
+    };
+
+    steps[2]._thread = ASYNC_LOAD_ON_GL_THREAD;
+    steps[2]._run = [load]()
+    {
+        bool isLoaded = gParticleManager.LoadSnapshotData(load->_data, load->_sizeBytes, 
+            load->_stagingBuffer, load->_filePath);
+        if (isLoaded)
+        {
+            // the updates before the snapshot didn't lead to it
+            gParticleKeyframeRing.Clear();
+        }
+        return isLoaded ? ASYNC_LOAD_STEP_DONE : ASYNC_LOAD_STEP_FAILED;
+    };
 
-    // tell glut to call this display() function again on the next iteration of the main loop
-    // Note: https://www.opengl.org/discussion_boards/showthread.php/168717-I-dont-understand-what-glutPostRedisplay()-does
-    // Also Note: This display() function will also be registered to run if the window is moved
-    // or if the viewport is resized.  If glutPostRedisplay() is not called, then as long as the
-    // window stays put and doesn't resize, display() won't be called again (tested with 
-    // debugging).
-    // Also Also Note: It doesn't matter where this is called in this function.  It sets a flag
-    // for glut's main loop and doesn't actually call the registered display function, but I 
-    // got into the habbit of calling it at the end.
-    glutPostRedisplay();
+    gAsyncLoader.Submit("snapshot " + filePath, steps);
 }
 
 /*-----------------------------------------------------------------------------------------------
@@ -132,8 +3064,8 @@ Description:
     Tell's OpenGL to resize the viewport based on the arguments provided.  This is an 
     opportunity to call glViewport or glScissor to keep up with the change in size.
     
-    This is not a user-called function.  It is registered with glutReshapeFunc(...) during 
-    glut's initialization.
+    This is not a user-called function.  It is the window's resize handler (see 
+    AppWindow::SetResizeHandler(...)).
 Parameters:
     w   The width of the window in pixels.
     h   The height of the window in pixels.
@@ -144,14 +3076,33 @@ Creator:    John Cox (2-13-2016)
 void Reshape(int w, int h)
 {
     glViewport(0, 0, w, h);
+
+    // instanced quads are sized in pixels, and so are the camera's pans
+    gParticleManager.SetViewportSize(w, h);
+    gParticleConstraintSolver.SetViewportSize(w, h);
+    gCamera.SetWindowSize(w, h);
+
+    // the density image is one texel per pixel, and the scaled render target's pixels are a 
+    // fraction of the window's
+    gDensitySplatRenderer.Resize(w, h);
+    gScaledRenderTarget.Resize(w, h);
+
+    // a video can't change size partway through
+    // Note: The window's first resize is to the size that it already was.
+    if (gFrameCapture.IsCapturing() && 
+        (w != gFrameCapture.GetWidth() || h != gFrameCapture.GetHeight()))
+    {
+        LogPrintf("frame capture: the window was resized, so the capture was stopped\n");
+        gFrameCapture.Stop();
+    }
 }
 
 /*-----------------------------------------------------------------------------------------------
 Description:
     Executes when the user presses a key on the keyboard.
 
-    This is not a user-called function.  It is registered with glutKeyboardFunc(...) during
-    glut's initialization.
+    This is not a user-called function.  It is the window's key handler (see 
+    AppWindow::SetKeyHandler(...)).
 
     Note: Although the x and y arguments are for the mouse's current position, this function does
     not respond to mouse presses.
@@ -166,15 +3117,218 @@ Creator:    John Cox (2-13-2016)
 void Keyboard(unsigned char key, int x, int y)
 {
     // this statement is mostly to get ride of an "unreferenced parameter" warning
-    printf("keyboard: x = %d, y = %d\n", x, y);
+    LogPrintf("keyboard: x = %d, y = %d\n", x, y);
     switch (key)
     {
     case 27:
     {
         // ESC key
-        glutLeaveMainLoop();
+        // Note: The frame loop stops before the next frame, and cleans up while the context 
+        // is still there.
+        gAppWindow->RequestClose();
         return;
     }
+    case 'b':
+    {
+        // toggle between the targeted memory barrier and GL_ALL_BARRIER_BITS for A/B timing
+        static bool useFullBarrier = false;
+        useFullBarrier = !useFullBarrier;
+        gParticleManager.SetFullMemoryBarrier(useFullBarrier);
+        LogPrintf("memory barrier after update: %s\n", useFullBarrier ? "GL_ALL_BARRIER_BITS" : "targeted");
+        break;
+    }
+    case 'u':
+    {
+        // toggle between updating the live particles and updating the whole pool for A/B timing
+        static bool useLiveUpdateList = true;
+        useLiveUpdateList = !useLiveUpdateList;
+        gParticleManager.SetLiveUpdateList(useLiveUpdateList);
+        LogPrintf("update covers: %s\n", useLiveUpdateList ? "live particles" : "whole pool");
+        break;
+    }
+    case 'g':
+    {
+        gShowFrameGraph = !gShowFrameGraph;
+        break;
+    }
+    case 'd':
+    {
+        // cycle the debug output's filter: low -> medium -> high -> everything -> low ...
+        GLenum minimumSeverity = GetDebugMinimumSeverity();
+        switch (minimumSeverity)
+        {
+        case GL_DEBUG_SEVERITY_LOW_ARB: minimumSeverity = GL_DEBUG_SEVERITY_MEDIUM_ARB; break;
+        case GL_DEBUG_SEVERITY_MEDIUM_ARB: minimumSeverity = GL_DEBUG_SEVERITY_HIGH_ARB; break;
+        case GL_DEBUG_SEVERITY_HIGH_ARB: minimumSeverity = GL_DEBUG_SEVERITY_NOTIFICATION; break;
+        default:
+            minimumSeverity = GL_DEBUG_SEVERITY_LOW_ARB;
+            break;
+        }
+        SetDebugMinimumSeverity(minimumSeverity);
+        LogPrintf("debug output minimum severity: 0x%x\n", minimumSeverity);
+        break;
+    }
+    case '+':
+    case '-':
+    {
+        // grow or shrink the particle pool in place
+        unsigned int particleCount = gParticleManager.GetMaxParticleCount();
+        particleCount = (key == '+') ? (particleCount * 2) : (particleCount / 2);
+        gParticleManager.Resize(particleCount);
+        LogPrintf("particle pool: %u\n", gParticleManager.GetMaxParticleCount());
+        break;
+    }
+    case 'c':
+    {
+        // toggle between flat white particles and coloring them by speed
+        static bool useSpeedPalette = false;
+        useSpeedPalette = !useSpeedPalette;
+        gParticleManager.SetColorMode(useSpeedPalette ? 
+            PARTICLE_COLOR_MODE_SPEED_PALETTE : PARTICLE_COLOR_MODE_FLAT);
+        LogPrintf("particle color: %s\n", useSpeedPalette ? "speed palette" : "flat");
+        break;
+    }
+    case 'q':
+    {
+        // toggle the instanced quads between squares and octagons (only matters with "--quads")
+        static bool useOctagons = false;
+        useOctagons = !useOctagons;
+        gParticleManager.SetQuadShape(useOctagons ? 
+            PARTICLE_QUAD_SHAPE_OCTAGON : PARTICLE_QUAD_SHAPE_SQUARE);
+        LogPrintf("particle quads: %s\n", useOctagons ? "octagons" : "squares");
+        break;
+    }
+    case 'v':
+    {
+        // driver default -> immediate -> vsync -> adaptive -> driver default ...
+        // Note: Going back to the driver default doesn't change the interval; it takes a new 
+        // window for that.
+        gSwapIntervalMode = (SwapIntervalMode)((gSwapIntervalMode + 1) % SWAP_INTERVAL_MODE_COUNT);
+        SetSwapInterval(gSwapIntervalMode);
+        LogPrintf("swap interval: %s\n", GetSwapIntervalModeName(gSwapIntervalMode));
+        break;
+    }
+    case 'r':
+    {
+        if (gFrameCapture.IsCapturing())
+        {
+            gFrameCapture.Stop();
+        }
+        else
+        {
+            gFrameCapture.Start(gAppWindow->GetWidth(), gAppWindow->GetHeight(), gCapturePath, 
+                60);
+        }
+        break;
+    }
+    case 'p':
+    {
+        // written out a frame or two later, when the GPU is done copying it
+        gParticleManager.SaveSnapshot(gSnapshotPath);
+        break;
+    }
+    case 'o':
+    {
+        // spread over the next few frames instead of stalling this one
+        LoadSnapshotAsync(gSnapshotPath);
+        break;
+    }
+    case '[':
+    {
+        float secondsRemoved = 0.0f;
+        if (gParticleKeyframeRing.Rewind(KEYFRAME_REWIND_UPDATES, &secondsRemoved))
+        {
+            gSimulationTimeSec -= secondsRemoved;
+            LogPrintf("rewound %.2f seconds (%u updates left to rewind)\n", secondsRemoved, 
+                gParticleKeyframeRing.GetRewindableUpdateCount());
+        }
+        break;
+    }
+    case 'j':
+    {
+        if (gParticleTrajectoryRecorder.IsRecording())
+        {
+            gParticleTrajectoryRecorder.Stop();
+        }
+        else
+        {
+            StartTrajectoryRecording();
+        }
+        break;
+    }
+    case 'l':
+    {
+        // no cap -> 1 frame in flight -> 2 frames in flight -> no cap ...
+        gMaxFramesInFlight = (gMaxFramesInFlight + 1) % 3;
+        gFramePacer.SetMaxFramesInFlight(gMaxFramesInFlight);
+        LogPrintf("max frames in flight: %u (0 is no cap)\n", gMaxFramesInFlight);
+        break;
+    }
+    case 't':
+    {
+        // toggle the density splat's tile binning for A/B timing (only matters with "--splat")
+        static bool useTileBinning = true;
+        useTileBinning = !useTileBinning;
+        gDensitySplatRenderer.SetTileBinning(useTileBinning);
+        LogPrintf("density splat: %s\n", useTileBinning ? "tile binned" : "direct");
+        break;
+    }
+    case 'z':
+    {
+        gCamera.ZoomAt(1.25f, gAppWindow->GetWidth() / 2, gAppWindow->GetHeight() / 2);
+        break;
+    }
+    case 'x':
+    {
+        gCamera.ZoomAt(0.8f, gAppWindow->GetWidth() / 2, gAppWindow->GetHeight() / 2);
+        break;
+    }
+    case '0':
+    {
+        gCamera.Reset();
+        break;
+    }
+    case 'k':
+    {
+        gCullOffscreenParticles = !gCullOffscreenParticles;
+        LogPrintf("off-screen culling: %s\n", gCullOffscreenParticles ? "on" : "off");
+        break;
+    }
+    case 'm':
+    {
+        // trails go through the scaled render target, which the density splat doesn't use
+        float trailFade = (gTrailFade > 0.0f) ? gTrailFade : 0.9f;
+        gScaledRenderTarget.SetTrailFade(gScaledRenderTarget.HasTrails() ? 0.0f : trailFade);
+        LogPrintf("trails: %s\n", gScaledRenderTarget.HasTrails() ? "on" : "off");
+        break;
+    }
+    case ' ':
+    {
+        // a fast ring out of every emitter, from whatever its dead stack has left
+        if (!gUseBursts)
+        {
+            break;
+        }
+        const std::vector<ParticleEmitter> &emitters = gParticleManager.GetEmitters();
+        unsigned int burstCount = 0;
+        for (unsigned int emitterIndex = 0; emitterIndex < emitters.size(); emitterIndex++)
+        {
+            ParticleBurst burst;
+            burst._offset = glm::vec2(0.0f, 0.0f);
+            burst._radius = 0.02f;
+            burst._emitterIndex = emitterIndex;
+            burst._velocityMin = emitters[emitterIndex]._velocityMax;
+            burst._velocityMax = emitters[emitterIndex]._velocityMax * 2.0f;
+            burst._count = emitters[emitterIndex]._particleCount / 4;
+            burst._padding = 0;
+            if (gParticleManager.TriggerBurst(burst))
+            {
+                burstCount++;
+            }
+        }
+        LogPrintf("bursts: %u of %u emitters\n", burstCount, (unsigned int)emitters.size());
+        break;
+    }
     default:
         break;
     }
@@ -182,27 +3336,194 @@ void Keyboard(unsigned char key, int x, int y)
 
 /*-----------------------------------------------------------------------------------------------
 Description:
-    I don't know what this does, but I've kept it around since early times, and this was the 
-    comment given with it:
-    
-    "Called before FreeGLUT is initialized. It should return the FreeGLUT display mode flags 
-    that you want to use. The initial value are the standard ones used by the framework. You can 
-    modify it or just return you own set.  This function can also set the width/height of the 
-    window. The initial value of these variables is the default, but you can change it."
+    Starts and stops panning with the left mouse button.  With "--mouse", the right button 
+    pulls the particles toward the mouse while it is down, and the middle one pushes them 
+    away.
+
+    This is not a user-called function.  It is the window's mouse button handler (see 
+    AppWindow::SetMouseButtonHandler(...)).
 Parameters:
-    displayMode     ??
-    width           ??
-    height          ??
-Returns:
-    ??what??
+    button  0 is the left button, 1 the middle, and 2 the right.
+    isDown  True if it was pressed, false if it was released.
+    x       The horizontal window coordinates of the mouse.
+    y       The vertical window coordinates of the mouse.
+Returns:    None
 Exception:  Safe
-Creator:    John Cox (2-13-2016)
+Creator:    John Cox (8-17-2016)
 -----------------------------------------------------------------------------------------------*/
-unsigned int Defaults(unsigned int displayMode, int &width, int &height) 
+void MouseButton(int button, bool isDown, int x, int y)
 {
-    // this statement is mostly to get ride of an "unreferenced parameter" warning
-    printf("Defaults: width = %d, height = %d\n", width, height);
-    return displayMode; 
+    if (button == 0)
+    {
+        gIsPanning = isDown;
+        gPanLastX = x;
+        gPanLastY = y;
+    }
+    else if (gUsePointerInput && (button == 1 || button == 2))
+    {
+        float strength = (button == 2) ? 2.0f : -2.0f;
+        gPointerInput._attractorStrength = isDown ? strength : 0.0f;
+        gPointerInput._position = gCamera.WindowToWorld(x, y);
+        gPointerInput._timeMs = GetPacingClockMs();
+        gParticleManager.PublishPointerInput(gPointerInput);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Pans the camera by however far the mouse moved while the left button is down.  With 
+    "--mouse", it also moves the pointer's emitter and attractor to the mouse, whether or not 
+    a button is down.
+
+    This is not a user-called function.  It is the window's mouse move handler (see 
+    AppWindow::SetMouseMoveHandler(...)).
+Parameters:
+    x   The horizontal window coordinates of the mouse.
+    y   The vertical window coordinates of the mouse.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void MouseMove(int x, int y)
+{
+    if (gIsPanning)
+    {
+        gCamera.Pan((float)(x - gPanLastX), (float)(y - gPanLastY));
+        gPanLastX = x;
+        gPanLastY = y;
+    }
+    if (gUsePointerInput)
+    {
+        gPointerInput._position = gCamera.WindowToWorld(x, y);
+        gPointerInput._timeMs = GetPacingClockMs();
+        gParticleManager.PublishPointerInput(gPointerInput);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Zooms the camera about the mouse, a quarter per wheel step.
+
+    This is not a user-called function.  It is the window's mouse wheel handler (see 
+    AppWindow::SetMouseWheelHandler(...)).
+Parameters:
+    wheelSteps  Positive is away from the user (zoom in).
+    x           The horizontal window coordinates of the mouse.
+    y           The vertical window coordinates of the mouse.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void MouseWheel(int wheelSteps, int x, int y)
+{
+    float zoomFactor = (wheelSteps > 0) ? 1.25f : 0.8f;
+    int stepCount = (wheelSteps > 0) ? wheelSteps : -wheelSteps;
+    for (int step = 0; step < stepCount; step++)
+    {
+        gCamera.ZoomAt(zoomFactor, x, y);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    The window's handlers (see AppWindow.h).  Each one records the event for the frame that 
+    is next, if the input is being recorded, and passes it on to the demo's handler above.  A 
+    replay's input comes from its log instead (see ReplayInputEvents()), so the window's keys 
+    and mouse are ignored while it runs, but its resizes still go through, since the 
+    viewport has to be the window's real size.
+Parameters: See the demo's handlers.
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void WindowResized(int w, int h)
+{
+    gInputEventLog.Record(gFrameIndex, INPUT_EVENT_RESIZE, w, h);
+    Reshape(w, h);
+}
+
+void WindowKey(unsigned char key, int x, int y)
+{
+    gLastInputTimeMs = GetPacingClockMs();
+    if (!gInputEventLog.IsReplaying())
+    {
+        gInputEventLog.Record(gFrameIndex, INPUT_EVENT_KEY, key, x, y);
+        Keyboard(key, x, y);
+    }
+}
+
+void WindowMouseButton(int button, bool isDown, int x, int y)
+{
+    gLastInputTimeMs = GetPacingClockMs();
+    if (!gInputEventLog.IsReplaying())
+    {
+        gInputEventLog.Record(gFrameIndex, INPUT_EVENT_MOUSE_BUTTON, button, isDown ? 1 : 0, 
+            x, y);
+        MouseButton(button, isDown, x, y);
+    }
+}
+
+void WindowMouseMove(int x, int y)
+{
+    gLastInputTimeMs = GetPacingClockMs();
+    if (!gInputEventLog.IsReplaying())
+    {
+        gInputEventLog.Record(gFrameIndex, INPUT_EVENT_MOUSE_MOVE, x, y);
+        MouseMove(x, y);
+    }
+}
+
+void WindowMouseWheel(int wheelSteps, int x, int y)
+{
+    gLastInputTimeMs = GetPacingClockMs();
+    if (!gInputEventLog.IsReplaying())
+    {
+        gInputEventLog.Record(gFrameIndex, INPUT_EVENT_MOUSE_WHEEL, wheelSteps, x, y);
+        MouseWheel(wheelSteps, x, y);
+    }
+}
+
+/*-----------------------------------------------------------------------------------------------
+Description:
+    Runs the replay's events for the next frame through the demo's handlers, in the order 
+    that they were recorded, right where the window's own events would have been handled.  
+    Does nothing if there is no replay.
+
+    The recorded resizes are skipped, since the replay's window is already the size that the 
+    recording started with and can't be made to change.  A scene config change is put into 
+    effect the way a saved scene file is (see ApplySceneConfigChanges(...)).
+Parameters: None
+Returns:    None
+Exception:  Safe
+Creator:    John Cox (8-17-2016)
+-----------------------------------------------------------------------------------------------*/
+void ReplayInputEvents()
+{
+    InputEvent event;
+    while (gInputEventLog.TakeEvent(gFrameIndex, &event))
+    {
+        const int *values = event._record._values;
+        switch (event._record._type)
+        {
+        case INPUT_EVENT_KEY:
+            Keyboard((unsigned char)values[0], values[1], values[2]);
+            break;
+        case INPUT_EVENT_MOUSE_BUTTON:
+            MouseButton(values[0], values[1] != 0, values[2], values[3]);
+            break;
+        case INPUT_EVENT_MOUSE_MOVE:
+            MouseMove(values[0], values[1]);
+            break;
+        case INPUT_EVENT_MOUSE_WHEEL:
+            MouseWheel(values[0], values[1], values[2]);
+            break;
+        case INPUT_EVENT_SCENE_CONFIG:
+            ApplySceneConfigChanges(event._sceneConfig);
+            break;
+        default:
+            break;
+        }
+    }
 }
 
 /*-----------------------------------------------------------------------------------------------
@@ -220,7 +3541,90 @@ Creator:    John Cox (2-13-2016)
 -----------------------------------------------------------------------------------------------*/
 void CleanupAll()
 {
+    // first, because the worker pushes to the frame stats log
+    gFramePrepPipeline.Cleanup();
+    gAsyncLoader.Cleanup();
+    gParticleKeyframeRing.Cleanup();
+    if (gInjectionThread.joinable())
+    {
+        gIsInjectionStopping.store(true);
+        gInjectionThread.join();
+        LogPrintf("injection: %llu particles dispatched, %llu dropped, %llu batches refused\n", 
+            gParticleInjectionRing.GetInjectedRecordCount(), 
+            gParticleInjectionRing.GetDroppedRecordCount(), 
+            gParticleInjectionRing.GetRefusedWriteCount());
+    }
+    gParticleDomainShard.Cleanup();
+    gParticleManager.SetInjectionRing(0);
+    gParticleInjectionRing.Cleanup();
+    LargeHostBuffer::LogLargePageUse();
+    gInputEventLog.Record(gFrameIndex, INPUT_EVENT_END, 0);
+    gInputEventLog.Cleanup();
+    gPrepThreadPool.Cleanup();
+    gFrameCapture.Stop();
+    if (gSharedTextureOutput.IsActive())
+    {
+        LogPrintf("shared texture output: %u frames shared, %u skipped by consumers\n", 
+            gSharedTextureOutput.GetPublishedCount(), gSharedTextureOutput.GetSkippedCount());
+    }
+    gSharedTextureOutput.Cleanup();
+    gParticleTrajectoryRecorder.Cleanup();
+
+    // the recorder's writer feeds the server, so it stops first
+    gParticleStreamRecorder.Cleanup();
+    gParticleStreamServer.Stop();
+    gParticleStreamGather.Disconnect();
+    gParticleStatsReducer.Cleanup();
+    gParticleHeatmapExporter.Cleanup();
+    StopTrace();
+    gFramePacer.Cleanup();
+    gFrameRateLimiter.Cleanup();
+    gPowerMonitor.Cleanup();
+    gShaderHotReloader.Cleanup();
+    gFrameStatsLog.Cleanup();
+    gFrameGraphOverlay.Cleanup();
+    gDensitySplatRenderer.Cleanup();
+    gDensitySurfaceRenderer.Cleanup();
+    gWeightedOitRenderer.Cleanup();
+    gOverdrawVisualizer.Cleanup();
+    gParticleMultiViewport.Cleanup();
+    gScaledRenderTarget.SetBloom(0, 0.0f);
+    gScaledRenderTarget.Cleanup();
+    gBloomFilter.Cleanup();
+    gParticleSpatialQuery.Cleanup();
+    gParticleNeighborGrid.Cleanup();
+    gParticleGravityTree.Cleanup();
+    gParticleConstraintSolver.Cleanup();
+    gGpuProfiler.Cleanup();
+    gHardwareCounters.Cleanup();
+    gParticleCostAttribution.Cleanup();
+    gMultiGpuSimulation.Cleanup();
     gParticleManager.Cleanup();
+    gParticleStatePublisher.Cleanup();
+    gParticleFieldTexture.Cleanup();
+    gStableFluidSolver.Cleanup();
+    gParticleBoundarySdf.Cleanup();
+    gParticleSegmentBvh.Cleanup();
+    gParticleEmissionImage.Cleanup();
+    CleanupShaderProgramRegistry();
+    GetFrameArena().Cleanup();
+    if (gCountAllocations)
+    {
+        LogPrintf("heap allocations: %u frames after the first %u allocated, %llu in all\n", 
+            gAllocatingFrameCount, ALLOCATION_COUNT_WARMUP_FRAMES, gSteadyStateAllocationCount);
+    }
+
+    // how much the state cache saved over the run (or would have, with "--no-gl-state-cache")
+    unsigned long long issuedStateCallCount = 0;
+    unsigned long long redundantStateCallCount = 0;
+    GetGlStateCacheCounts(&issuedStateCallCount, &redundantStateCallCount);
+    LogPrintf("GL state cache: %llu calls made, %llu redundant\n", issuedStateCallCount, 
+        redundantStateCallCount);
+    CleanupDebugOutput();
+    CloseAssetPack();
+
+    // last so that everything above can still log
+    CleanupLog();
 }
 
 /*-----------------------------------------------------------------------------------------------
@@ -236,54 +3640,1071 @@ Creator:    John Cox (2-13-2016)
 -----------------------------------------------------------------------------------------------*/
 int main(int argc, char *argv[])
 {
-    glutInit(&argc, argv);
+    // the arguments that aren't ours (ex: glut's "-display") are skipped over, and the window 
+    // system isn't started until after this, so "--headless" never needs one
+    // Note: "--benchmark" runs the particle pipeline through a fixed set of configurations in 
+    // a hidden window, prints the timings as CSV, and exits (see Benchmark.h).  "--sweep" 
+    // runs a grid of particle counts, layouts, work group sizes, and primitives instead, 
+    // writes a report, and compares it with a baseline; "--sweep-set layouts=soa,half_float"
+    // or "--sweep-set baseline=sweep.csv" changes the grid (see SetBenchmarkSweepAxis(...)).  
+    // "--validate" runs every fast path of the GPU's update next to the CPU backend from the 
+    // same particles, prints how far apart they ended up, and fails if they don't agree (see 
+    // ParticleValidation.h).  "--rng-benchmark" times the CPU's and the GPU's random number 
+    // generators and tests their numbers and directions for uniformity (see RngBenchmark.h).  
+    // "--retune" times the compute work group sizes again even if a result was saved.  
+    // "--frame-log" writes per-frame timings and particle counts to frameStats.csv and logs 
+    // the frame time's jitter at the end, to compare "--gl-core 2", "--gl-priority high" (or 
+    // "realtime"), and "--worker-numa-node gpu" (or a node) against the OS's placement.  
+    // "--opaque" draws opaque, depth-tested particles instead of additive ones, "--splat" 
+    // draws them with the compute shader density splat, and "--oit" draws them translucent 
+    // with weighted blended order-independent transparency.  "--vertex-pulling" has the particle 
+    // vertex shader read the particle buffers itself, and "--quads" draws each particle as 
+    // an instanced quad.  "--smooth-points" draws round point sprites whose edges are 
+    // antialiased.  "--flipbook" textures them with an animation that plays over their 
+    // lifetimes (so it goes with "--lifetime").  "--sort" sorts the particles on the GPU 
+    // every so often, 
+    // "--interact" has nearby particles push and pull on each other, and "--forces" adds a 
+    // gravity well, a vortex, and drag.  "--field-texture" does the same, but with the well 
+    // and the vortex baked into a texture.  "--lifetime" recycles particles after 4 seconds 
+    // whether or not they made it out, and "--sdf-boundary" bounces them around inside a box 
+    // with obstacles, and "--compressed-textures" has those two sample block compressed 
+    // copies of their textures.  "--segments" bounces them off of a grid of pegs made of a 
+    // few thousand line segments.  "--emit-image logo.ppm" starts the particles on the 
+    // bright pixels of a binary PGM or PPM image instead of in a disk.  "--cpu" runs the 
+    // particle simulation on the CPU's threads instead of the GPU, and "--split" runs it on 
+    // both at once and balances them.  "--orbit" moves the emitters around in circles on the 
+    // CPU, and "--emitter-paths" moves them along figure 8s and a spline on the GPU.  
+    // "--mouse" has the first emitter follow the mouse, and the right and middle buttons pull 
+    // and push.  
+    // "--bursts" sends a burst out of every emitter when the space bar is pressed.  
+    // "--sub-emitters" makes every other emitter's particles burst into sparks when they die.  
+    // "--inject" streams a spiral of particles into the first emitter from another thread.  
+    // "--cull-draw-groups" skips the draw of any draw group whose bounds are off the screen.  
+    // "--shared-output particles" shares each frame with compositors as a texture.  
+    // "--sleep" lets the particles that come to rest stop being updated until they are pushed.  
+    // "--sparse-capacity 100000000" reserves a pool that big but only commits what is used.  
+    // "--bindless" gives the shaders their textures by handle instead of binding them.  
+    // "--double-buffer" draws the last update's particles while the next update runs.  
+    // "--dump-shader-sources" writes out each compute variant for compiling to SPIR-V.  
+    // "--shader-variants variants.txt" adds each program that the run builds to a manifest, 
+    // and "--precompile-shaders --shader-variants variants.txt" builds all of them (and the 
+    // layouts and work group sizes that the sweep picks from) into the binary cache, prints 
+    // its coverage, and exits, which is for running once at install time.  
+    // "--no-gl-state-cache" makes the redundant GL state changes that are otherwise skipped.  
+    // "--count-allocations" logs the frames after the warm-up that allocate from the heap.  
+    // "--sph" makes the particles a fluid, with pressure and viscosity over the neighbor grid.  
+    // "--boids" makes them a flock that steers by separation, alignment, and cohesion.  
+    // "--dem" makes them collide, with overlaps pushed apart by a few Jacobi iterations.  
+    // "--gravity" has every particle pull on every other through a Barnes-Hut tree.  
+    // "--fluid-grid" carries the particles along with a small grid of smoke that is stirred up.  
+    // "--ropes" links some of the particles into chains that are drawn as ribbons.  
+    // "--queries" logs how many particles are around the pointer, and the nearest few to it.  
+    // "--merge-dense" merges the particles in crowded cells into fewer, heavier ones.  
+    // "--surface" draws the splat as a shaded liquid surface (best with "--sph"), and 
+    // "--contours" outlines it too.  
+    // "--overdraw" draws a heat map of how many particles cover each pixel in their place, 
+    // and "--pipeline-stats" prints the shader invocations and primitives of each frame.  
+    // "--hw-counters" prints the GPU's memory, cache, occupancy, and ALU counters for the 
+    // update and the render, and "--hw-counter-filter l3,occupancy" picks others by name; 
+    // "--sweep-set counters=default" adds them to the sweep's report.  The sweep's report 
+    // has the GPU's clocks and temperature too; "--sweep-set throttle=discard" measures a 
+    // throttled cell again, and "--sweep-set stabilize=60" waits for the clocks to settle.  
+    // "--cost-attribution" prints which emitters and systems the update's time goes to.  
+    // "--low-discrepancy-emission" spreads the emissions evenly instead of randomly.  
+    // "--emit-rate 12000" emits 12000 particles a second at any frame rate.  
+    // "--inset 0.2 0.5 4" draws a view of (0.2, 0.5) at 4x zoom in the window's corner; up to 
+    // 3 of them are stacked down the right side.  "--shared-windows 2" shows the particles in 
+    // 2 more windows, to the right of the main one, without simulating them again.  
+    // "--record-input session.input" records the keys, the mouse, and the scene's changes, 
+    // and "--replay-input session.input" runs them again, frame for frame, with or without 
+    // "--headless".  "--soak 8" runs for 8 hours and fails, with exit code 2, if GL objects, 
+    // GPU or host memory, the frame time, or the fence stalls keep going up; 
+    // "--soak-interval 60" is how many seconds apart it looks.  
+    // "--power-save 30" caps the frame rate at 30 by sleeping, drops to "--idle-fps 5" while 
+    // the window is minimized or covered, takes fewer simulation steps while no one is 
+    // touching it, and logs the GPU's energy per frame.  
+    // "--write-asset-pack file" packs every shader and image that the run loaded into one file, 
+    // and "--asset-pack file" loads them from it.  
+    // "--no-prep-thread" does each frame's CPU work on the GL thread instead of on a worker 
+    // while the GPU is busy, and "--prep-record-threads 4" splits that work across 4 more 
+    // threads that record it as command lists for the GL thread.  "--vsync", "--no-vsync", 
+    // and "--adaptive-vsync" set the swap interval instead of leaving it to the driver, 
+    // "--low-latency" only lets the CPU get 1 frame ahead of the GPU, and "--uncapped" turns 
+    // vsync off and lets the driver queue as many frames as it likes.  "--headless" 
+    // runs without a window or a display (see EglHeadlessWindow.h), and "--frames 1000" stops 
+    // after 1000 frames.  "--compute-only" runs the simulation as fast as it will go without 
+    // drawing it, unless "--real-time" keeps it to the clock, and "--preview-every 10" draws 
+    // every 10th frame anyway.  "--capture capture.y4m" records a video from the first 
+    // frame, and "--load-snapshot particles.snap" starts from a state that was saved with 
+    // the 'p' key, which the 'o' key loads again, reading it on "--load-workers 1" worker 
+    // threads and uploading it in "--load-budget 2" milliseconds a frame.  "--large-pages" 
+    // puts the big staging and readback buffers on the OS's large pages.  "--keyframes 32 30" 
+    // keeps 32 keyframes, one every 30 updates, in video memory for the '[' key to rewind to.  
+    // "--record-trajectory particles.traj" records every particle's position, 
+    // every frame.  "--deterministic" runs the same simulation every time, which "--seed 7" 
+    // picks, and prints a checksum of the particles at the end.  "--persistent 32" runs a 
+    // small pool with one dispatch of 32 persistent work groups per update.  "--fused-emit" 
+    // emits in the update pass, without the emit pass or the dead stacks.  
+    // "--custom-update shaderCustomSwirl.glsl" adds that file's behavior to the update.  
+    // "--lod 4" only 
+    // draws 1 in every 4 particles, and "--lod-density 2" and "--lod-budget 1.5" thin out 
+    // the draw as needed to stay under 2 particles per pixel or 1.5ms.  "--amortize 4" only 
+    // updates the particles that aren't drawn every 4th time.  "--frame-budget 10" 
+    // has the governor hold the update and the render to 10ms of GPU time, and 
+    // "--no-governor" leaves everything as it was set up.  "--render-scale 0.75" draws the 
+    // particles at 3/4 of the window's size and stretches them over it, and "--sharpen" 
+    // sharpens the stretch.  "--target-format r11g11b10f" (or "r16f" or "rgb565") draws the 
+    // particles into that color format instead of the window's.  "--trails 0.9" leaves motion 
+    // trails that keep 90% of the last frame each frame.  "--bloom 0.8" adds a glow around 
+    // everything brighter than "--bloom-threshold" (0.5 by default).  "--stats-every 30" 
+    // reduces the particle stats for the frame log every 30 updates.  "--heatmap heatmap.npy" 
+    // exports a histogram of where the particles are to heatmap_000000.npy and so on, 
+    // "--heatmap-size 128" cells square (256 by default) and every "--heatmap-every 0.5" 
+    // seconds (1 by default); a path that doesn't end in ".npy" gets raw float32 grids, one 
+    // after another.  "--trace trace.json" writes a timeline of the CPU and GPU scopes for 
+    // chrome://tracing.  "--gpu-memory-budget 512" holds the GPU memory that is tracked to 
+    // 512MB and shrinks the particle pool to fit.  "--config scene.ini" reads the particle 
+    // pool, the emitter, and the window size from a file (see SceneConfig.h) and applies its 
+    // changes while the demo runs, and "--set emitter.radius=0.8" overrides one of its values.
+    // "--gpus 2" runs another pool of particles on a second GPU and adds its image to the 
+    // display's (see MultiGpuSimulation.h).  "--publish-state particles" puts the particles in
+    // shared memory named "particles" every update for other processes to read (see 
+    // ParticleStateSharedMemory.h).  "--stream-server 7400" streams the particles to viewers 
+    // on TCP port 7400, quantized to "--stream-bits 10" bits per axis (12 by default) and at 
+    // most "--stream-fps 20" frames a second (30 by default), and "--stream-client 
+    // host:7400" connects to one and draws what it sends instead of simulating (see 
+    // ParticleStream.h).  "--shard 0 a:7500,b:7500" makes this node 0 of a run that is split 
+    // into slabs across the listed machines, each with its own pool, and hands the particles 
+    // that cross a slab's side to its neighbor (see ParticleDomainShard.h).  Each node puts 
+    // its emitter in its own slab with "--set emitter.center_x=-0.5" and streams with 
+    // "--stream-server", and "--stream-client a:7400,b:7400" draws all of them together.
+    // The slabs don't exchange halos, so "--shard" refuses to start with "--interact", 
+    // "--sph", "--boids", "--dem", "--gravity", or "--ropes".
+    // "--gl-debug" and "--no-gl-debug" turn GL debug output on or off (by default it is only 
+    // on in debug builds), and "--gl-debug-sync" turns it on and makes it synchronous.
+    bool benchmarkMode = false;
+    bool sweepMode = false;
+    bool validateMode = false;
+    bool rngBenchmarkMode = false;
+    bool precompileMode = false;
+    BenchmarkSweepSettings sweepSettings = GetDefaultBenchmarkSweepSettings();
+    bool useHeadless = false;
+#ifdef _DEBUG
+    bool useDebugOutput = true;
+#else
+    bool useDebugOutput = false;
+#endif
+    bool useSynchronousDebugOutput = false;
+    for (int argIndex = 1; argIndex < argc; argIndex++)
+    {
+        if (strcmp(argv[argIndex], "--benchmark") == 0)
+        {
+            benchmarkMode = true;
+        }
+        else if (strcmp(argv[argIndex], "--sweep") == 0)
+        {
+            benchmarkMode = true;
+            sweepMode = true;
+        }
+        else if (strcmp(argv[argIndex], "--validate") == 0)
+        {
+            benchmarkMode = true;
+            validateMode = true;
+        }
+        else if (strcmp(argv[argIndex], "--rng-benchmark") == 0)
+        {
+            benchmarkMode = true;
+            rngBenchmarkMode = true;
+        }
+        else if (strcmp(argv[argIndex], "--precompile-shaders") == 0)
+        {
+            benchmarkMode = true;
+            precompileMode = true;
+        }
+        else if (strcmp(argv[argIndex], "--sweep-set") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            if (!SetBenchmarkSweepAxis(argv[argIndex], &sweepSettings))
+            {
+                LogPrintf("bad sweep setting '%s'\n", argv[argIndex]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[argIndex], "--retune") == 0)
+        {
+            gForceRetune = true;
+        }
+        else if (strcmp(argv[argIndex], "--frame-log") == 0)
+        {
+            gLogFrameStats = true;
+        }
+        else if (strcmp(argv[argIndex], "--opaque") == 0)
+        {
+            gRenderMode = PARTICLE_RENDER_MODE_OPAQUE_DEPTH_TESTED;
+        }
+        else if (strcmp(argv[argIndex], "--splat") == 0)
+        {
+            gRenderMode = PARTICLE_RENDER_MODE_DENSITY_SPLAT;
+        }
+        else if (strcmp(argv[argIndex], "--surface") == 0)
+        {
+            gRenderMode = PARTICLE_RENDER_MODE_DENSITY_SPLAT;
+            gUseDensitySurface = true;
+        }
+        else if (strcmp(argv[argIndex], "--contours") == 0)
+        {
+            gRenderMode = PARTICLE_RENDER_MODE_DENSITY_SPLAT;
+            gUseDensitySurface = true;
+            gDrawSurfaceContours = true;
+        }
+        else if (strcmp(argv[argIndex], "--oit") == 0)
+        {
+            gRenderMode = PARTICLE_RENDER_MODE_WEIGHTED_OIT;
+        }
+        else if (strcmp(argv[argIndex], "--vertex-pulling") == 0)
+        {
+            gUseVertexPulling = true;
+        }
+        else if (strcmp(argv[argIndex], "--quads") == 0)
+        {
+            gUseQuads = true;
+        }
+        else if (strcmp(argv[argIndex], "--smooth-points") == 0)
+        {
+            gUseSmoothPoints = true;
+        }
+        else if (strcmp(argv[argIndex], "--flipbook") == 0)
+        {
+            gUseFlipbook = true;
+        }
+        else if (strcmp(argv[argIndex], "--overdraw") == 0)
+        {
+            gShowOverdraw = true;
+        }
+        else if (strcmp(argv[argIndex], "--pipeline-stats") == 0)
+        {
+            gUsePipelineStatistics = true;
+        }
+        else if (strcmp(argv[argIndex], "--hw-counters") == 0)
+        {
+            gUseHardwareCounters = true;
+        }
+        else if (strcmp(argv[argIndex], "--hw-counter-filter") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gUseHardwareCounters = true;
+            gHardwareCounterFilter = argv[argIndex];
+        }
+        else if (strcmp(argv[argIndex], "--cost-attribution") == 0)
+        {
+            gUseCostAttribution = true;
+        }
+        else if (strcmp(argv[argIndex], "--low-discrepancy-emission") == 0)
+        {
+            gUseLowDiscrepancyEmission = true;
+        }
+        else if (strcmp(argv[argIndex], "--emit-rate") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gEmissionRatePerSec = (float)atof(argv[argIndex]);
+        }
+        else if (strcmp(argv[argIndex], "--shared-windows") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gSharedWindowCount = (unsigned int)atoi(argv[argIndex]);
+        }
+        else if (strcmp(argv[argIndex], "--inset") == 0 && (argIndex + 3) < argc)
+        {
+            glm::vec2 insetCenter((float)atof(argv[argIndex + 1]), 
+                (float)atof(argv[argIndex + 2]));
+            float insetZoom = (float)atof(argv[argIndex + 3]);
+            argIndex += 3;
+            if (!gParticleMultiViewport.AddInset(insetCenter, insetZoom))
+            {
+                LogPrintf("at most %u insets; ignoring the rest\n", 
+                    ParticleMultiViewport::MAX_INSETS);
+            }
+        }
+        else if (strcmp(argv[argIndex], "--sort") == 0)
+        {
+            gSortParticles = true;
+        }
+        else if (strcmp(argv[argIndex], "--interact") == 0)
+        {
+            gUseParticleInteractions = true;
+        }
+        else if (strcmp(argv[argIndex], "--sph") == 0)
+        {
+            gUseSphFluid = true;
+            gUseParticleInteractions = true;
+            gSortParticles = true;
+        }
+        else if (strcmp(argv[argIndex], "--boids") == 0)
+        {
+            gUseBoids = true;
+            gUseParticleInteractions = true;
+        }
+        else if (strcmp(argv[argIndex], "--dem") == 0)
+        {
+            gUseDem = true;
+            gUseParticleInteractions = true;
+        }
+        else if (strcmp(argv[argIndex], "--gravity") == 0)
+        {
+            gUseGravityTree = true;
+        }
+        else if (strcmp(argv[argIndex], "--ropes") == 0)
+        {
+            gUseConstraints = true;
+        }
+        else if (strcmp(argv[argIndex], "--queries") == 0)
+        {
+            gUseSpatialQueries = true;
+        }
+        else if (strcmp(argv[argIndex], "--merge-dense") == 0)
+        {
+            gMergeDenseCells = true;
+        }
+        else if (strcmp(argv[argIndex], "--forces") == 0)
+        {
+            gUseForceFields = true;
+        }
+        else if (strcmp(argv[argIndex], "--field-texture") == 0)
+        {
+            gUseFieldTexture = true;
+        }
+        else if (strcmp(argv[argIndex], "--fluid-grid") == 0)
+        {
+            gUseFluidGrid = true;
+        }
+        else if (strcmp(argv[argIndex], "--lifetime") == 0)
+        {
+            // the same as setting it in the scene, so a later "--set" can still change it
+            gSceneConfigOverrides.push_back("particles.lifetime=4");
+        }
+        else if (strcmp(argv[argIndex], "--sdf-boundary") == 0)
+        {
+            gUseSdfBoundary = true;
+        }
+        else if (strcmp(argv[argIndex], "--compressed-textures") == 0)
+        {
+            gUseCompressedTextures = true;
+        }
+        else if (strcmp(argv[argIndex], "--segments") == 0)
+        {
+            gUseSegmentBvh = true;
+        }
+        else if (strcmp(argv[argIndex], "--emit-image") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gEmissionImagePath = argv[argIndex];
+        }
+        else if (strcmp(argv[argIndex], "--cpu") == 0)
+        {
+            gUseCpuSimulation = true;
+        }
+        else if (strcmp(argv[argIndex], "--split") == 0)
+        {
+            gUseSplitSimulation = true;
+        }
+        else if (strcmp(argv[argIndex], "--orbit") == 0)
+        {
+            gOrbitEmitters = true;
+        }
+        else if (strcmp(argv[argIndex], "--emitter-paths") == 0)
+        {
+            gUseEmitterPaths = true;
+        }
+        else if (strcmp(argv[argIndex], "--mouse") == 0)
+        {
+            gUsePointerInput = true;
+        }
+        else if (strcmp(argv[argIndex], "--bursts") == 0)
+        {
+            gUseBursts = true;
+        }
+        else if (strcmp(argv[argIndex], "--sub-emitters") == 0)
+        {
+            gUseSubEmitters = true;
+        }
+        else if (strcmp(argv[argIndex], "--inject") == 0)
+        {
+            gUseInjection = true;
+        }
+        else if (strcmp(argv[argIndex], "--shard") == 0 && (argIndex + 2) < argc)
+        {
+            gUseDomainShard = true;
+            gDomainSettings._nodeIndex = (unsigned int)atoi(argv[argIndex + 1]);
+            std::string addressList = argv[argIndex + 2];
+            gDomainSettings._nodeAddresses.clear();
+            size_t start = 0;
+            while (start < addressList.size())
+            {
+                size_t end = addressList.find(',', start);
+                if (end == std::string::npos)
+                {
+                    end = addressList.size();
+                }
+                gDomainSettings._nodeAddresses.push_back(
+                    addressList.substr(start, end - start));
+                start = end + 1;
+            }
+            argIndex += 2;
+        }
+        else if (strcmp(argv[argIndex], "--cull-draw-groups") == 0)
+        {
+            gCullDrawGroups = true;
+        }
+        else if (strcmp(argv[argIndex], "--sleep") == 0)
+        {
+            gUseSleep = true;
+        }
+        else if (strcmp(argv[argIndex], "--sparse-capacity") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gSparsePoolCapacity = (unsigned int)strtoul(argv[argIndex], 0, 10);
+        }
+        else if (strcmp(argv[argIndex], "--bindless") == 0)
+        {
+            gUseBindlessTextures = true;
+        }
+        else if (strcmp(argv[argIndex], "--double-buffer") == 0)
+        {
+            gUseDoubleBufferedRendering = true;
+        }
+        else if (strcmp(argv[argIndex], "--count-allocations") == 0)
+        {
+            gCountAllocations = true;
+        }
+        else if (strcmp(argv[argIndex], "--no-gl-state-cache") == 0)
+        {
+            gUseGlStateCache = false;
+        }
+        else if (strcmp(argv[argIndex], "--dump-shader-sources") == 0)
+        {
+            gDumpShaderSources = true;
+        }
+        else if (strcmp(argv[argIndex], "--shader-variants") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gShaderVariantsPath = argv[argIndex];
+        }
+        else if (strcmp(argv[argIndex], "--asset-pack") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gAssetPackPath = argv[argIndex];
+        }
+        else if (strcmp(argv[argIndex], "--write-asset-pack") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gWriteAssetPackPath = argv[argIndex];
+        }
+        else if (strcmp(argv[argIndex], "--no-prep-thread") == 0)
+        {
+            gUseFramePrepThread = false;
+        }
+        else if (strcmp(argv[argIndex], "--prep-record-threads") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gPrepRecordThreadCount = (unsigned int)strtoul(argv[argIndex], 0, 10);
+        }
+        else if (strcmp(argv[argIndex], "--headless") == 0)
+        {
+            useHeadless = true;
+        }
+        else if (strcmp(argv[argIndex], "--frames") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gMaxFrameCount = (unsigned int)atoi(argv[argIndex]);
+        }
+        else if (strcmp(argv[argIndex], "--compute-only") == 0)
+        {
+            gComputeOnly = true;
+        }
+        else if (strcmp(argv[argIndex], "--real-time") == 0)
+        {
+            gComputeOnlyRealTime = true;
+        }
+        else if (strcmp(argv[argIndex], "--preview-every") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gPreviewInterval = (unsigned int)atoi(argv[argIndex]);
+        }
+        else if (strcmp(argv[argIndex], "--capture") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gCapturePath = argv[argIndex];
+            gCaptureAtStart = true;
+        }
+        else if (strcmp(argv[argIndex], "--shared-output") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gSharedOutputName = argv[argIndex];
+        }
+        else if (strcmp(argv[argIndex], "--load-snapshot") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gSnapshotPath = argv[argIndex];
+            gLoadSnapshotAtStart = true;
+        }
+        else if (strcmp(argv[argIndex], "--gl-core") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gThreadPlacementSettings._glThreadCore = atoi(argv[argIndex]);
+        }
+        else if (strcmp(argv[argIndex], "--gl-priority") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            if (strcmp(argv[argIndex], "high") == 0)
+            {
+                gThreadPlacementSettings._glThreadPriority = THREAD_PRIORITY_LEVEL_HIGH;
+            }
+            else if (strcmp(argv[argIndex], "realtime") == 0)
+            {
+                gThreadPlacementSettings._glThreadPriority = THREAD_PRIORITY_LEVEL_REALTIME;
+            }
+            else
+            {
+                LogPrintf("unknown GL thread priority '%s'; expected high or realtime\n", 
+                    argv[argIndex]);
+            }
+        }
+        else if (strcmp(argv[argIndex], "--worker-numa-node") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gThreadPlacementSettings._workerNumaNode = (strcmp(argv[argIndex], "gpu") == 0) ? 
+                NUMA_NODE_NEAREST_GPU : atoi(argv[argIndex]);
+        }
+        else if (strcmp(argv[argIndex], "--large-pages") == 0)
+        {
+            gUseLargePages = true;
+        }
+        else if (strcmp(argv[argIndex], "--keyframes") == 0 && (argIndex + 2) < argc)
+        {
+            gKeyframeCount = (unsigned int)strtoul(argv[argIndex + 1], 0, 10);
+            gUpdatesPerKeyframe = (unsigned int)strtoul(argv[argIndex + 2], 0, 10);
+            argIndex += 2;
+        }
+        else if (strcmp(argv[argIndex], "--load-budget") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gAsyncLoadBudgetMs = (float)atof(argv[argIndex]);
+        }
+        else if (strcmp(argv[argIndex], "--load-workers") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gAsyncLoadWorkerCount = (unsigned int)strtoul(argv[argIndex], 0, 10);
+        }
+        else if (strcmp(argv[argIndex], "--record-trajectory") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gTrajectoryPath = argv[argIndex];
+            gRecordTrajectoryAtStart = true;
+        }
+        else if (strcmp(argv[argIndex], "--soak") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gSoakHours = atof(argv[argIndex]);
+        }
+        else if (strcmp(argv[argIndex], "--soak-interval") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gSoakIntervalSec = atof(argv[argIndex]);
+        }
+        else if (strcmp(argv[argIndex], "--power-save") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gPowerSaveFps = (float)atof(argv[argIndex]);
+        }
+        else if (strcmp(argv[argIndex], "--idle-fps") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gIdleFps = (float)atof(argv[argIndex]);
+        }
+        else if (strcmp(argv[argIndex], "--record-input") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gInputRecordPath = argv[argIndex];
+        }
+        else if (strcmp(argv[argIndex], "--replay-input") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gInputReplayPath = argv[argIndex];
+        }
+        else if (strcmp(argv[argIndex], "--deterministic") == 0)
+        {
+            gDeterministic = true;
+        }
+        else if (strcmp(argv[argIndex], "--seed") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gRandomSeed = (unsigned int)atoi(argv[argIndex]);
+        }
+        else if (strcmp(argv[argIndex], "--persistent") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gPersistentWorkGroupCount = (unsigned int)atoi(argv[argIndex]);
+        }
+        else if (strcmp(argv[argIndex], "--fused-emit") == 0)
+        {
+            gUseFusedEmit = true;
+        }
+        else if (strcmp(argv[argIndex], "--custom-update") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gCustomUpdateFilePath = argv[argIndex];
+        }
+        else if (strcmp(argv[argIndex], "--render-scale") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gBaseRenderScale = (float)atof(argv[argIndex]);
+        }
+        else if (strcmp(argv[argIndex], "--sharpen") == 0)
+        {
+            gSharpenUpscale = true;
+        }
+        else if (strcmp(argv[argIndex], "--target-format") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            if (strcmp(argv[argIndex], "r11g11b10f") == 0)
+            {
+                gScaledRenderFormat = SCALED_RENDER_FORMAT_R11G11B10F;
+            }
+            else if (strcmp(argv[argIndex], "r16f") == 0)
+            {
+                gScaledRenderFormat = SCALED_RENDER_FORMAT_R16F;
+            }
+            else if (strcmp(argv[argIndex], "rgb565") == 0)
+            {
+                gScaledRenderFormat = SCALED_RENDER_FORMAT_RGB565;
+            }
+            else
+            {
+                gScaledRenderFormat = SCALED_RENDER_FORMAT_RGBA8;
+            }
+        }
+        else if (strcmp(argv[argIndex], "--trails") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gTrailFade = (float)atof(argv[argIndex]);
+        }
+        else if (strcmp(argv[argIndex], "--bloom") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gBloomIntensity = (float)atof(argv[argIndex]);
+        }
+        else if (strcmp(argv[argIndex], "--bloom-threshold") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gBloomThreshold = (float)atof(argv[argIndex]);
+        }
+        else if (strcmp(argv[argIndex], "--stats-every") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gStatsInterval = (unsigned int)atoi(argv[argIndex]);
+        }
+        else if (strcmp(argv[argIndex], "--heatmap") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gHeatmapPath = argv[argIndex];
+        }
+        else if (strcmp(argv[argIndex], "--heatmap-size") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gHeatmapSize = atoi(argv[argIndex]);
+        }
+        else if (strcmp(argv[argIndex], "--heatmap-every") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gHeatmapIntervalSec = (float)atof(argv[argIndex]);
+        }
+        else if (strcmp(argv[argIndex], "--trace") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gTracePath = argv[argIndex];
+        }
+        else if (strcmp(argv[argIndex], "--gpu-memory-budget") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gGpuMemoryBudgetMb = (unsigned int)atoi(argv[argIndex]);
+        }
+        else if (strcmp(argv[argIndex], "--config") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gSceneConfigPath = argv[argIndex];
+        }
+        else if (strcmp(argv[argIndex], "--set") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gSceneConfigOverrides.push_back(argv[argIndex]);
+        }
+        else if (strcmp(argv[argIndex], "--publish-state") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gPublishStateName = argv[argIndex];
+        }
+        else if (strcmp(argv[argIndex], "--stream-server") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gStreamPort = (unsigned short)atoi(argv[argIndex]);
+        }
+        else if (strcmp(argv[argIndex], "--stream-bits") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gStreamBits = (unsigned int)atoi(argv[argIndex]);
+        }
+        else if (strcmp(argv[argIndex], "--stream-fps") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gStreamFps = (float)atof(argv[argIndex]);
+        }
+        else if (strcmp(argv[argIndex], "--stream-client") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gStreamClientAddress = argv[argIndex];
+        }
+        else if (strcmp(argv[argIndex], "--gpus") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gGpuCount = (unsigned int)atoi(argv[argIndex]);
+        }
+        else if (strcmp(argv[argIndex], "--no-governor") == 0)
+        {
+            gUseGovernor = false;
+        }
+        else if (strcmp(argv[argIndex], "--frame-budget") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gFrameBudgetMs = (float)atof(argv[argIndex]);
+        }
+        else if (strcmp(argv[argIndex], "--lod") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gLodMode = PARTICLE_LOD_FIXED;
+            gLodValue = (float)atof(argv[argIndex]);
+        }
+        else if (strcmp(argv[argIndex], "--lod-density") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gLodMode = PARTICLE_LOD_PIXEL_DENSITY;
+            gLodValue = (float)atof(argv[argIndex]);
+        }
+        else if (strcmp(argv[argIndex], "--lod-budget") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gLodMode = PARTICLE_LOD_FRAME_BUDGET;
+            gLodValue = (float)atof(argv[argIndex]);
+        }
+        else if (strcmp(argv[argIndex], "--amortize") == 0 && (argIndex + 1) < argc)
+        {
+            argIndex++;
+            gUpdateAmortization = (unsigned int)atoi(argv[argIndex]);
+        }
+        else if (strcmp(argv[argIndex], "--vsync") == 0)
+        {
+            gSwapIntervalMode = SWAP_INTERVAL_VSYNC;
+        }
+        else if (strcmp(argv[argIndex], "--no-vsync") == 0)
+        {
+            gSwapIntervalMode = SWAP_INTERVAL_IMMEDIATE;
+        }
+        else if (strcmp(argv[argIndex], "--adaptive-vsync") == 0)
+        {
+            gSwapIntervalMode = SWAP_INTERVAL_ADAPTIVE;
+        }
+        else if (strcmp(argv[argIndex], "--low-latency") == 0)
+        {
+            gMaxFramesInFlight = 1;
+        }
+        else if (strcmp(argv[argIndex], "--uncapped") == 0)
+        {
+            gSwapIntervalMode = SWAP_INTERVAL_IMMEDIATE;
+            gMaxFramesInFlight = 0;
+        }
+        else if (strcmp(argv[argIndex], "--gl-debug") == 0)
+        {
+            useDebugOutput = true;
+        }
+        else if (strcmp(argv[argIndex], "--no-gl-debug") == 0)
+        {
+            useDebugOutput = false;
+        }
+        else if (strcmp(argv[argIndex], "--gl-debug-sync") == 0)
+        {
+            useDebugOutput = true;
+            useSynchronousDebugOutput = true;
+        }
+    }
+
+    // a pair of particles on either side of a slab boundary would never see each other, so 
+    // the interactions, the gravity tree's pulls, and the ropes' links would be wrong along 
+    // every boundary (see ParticleDomainShard.h)
+    if (gUseDomainShard && (gUseParticleInteractions || gUseGravityTree || gUseConstraints))
+    {
+        LogPrintf("--shard can't be used with anything that needs the neighbors across a slab "
+            "boundary (--interact, --sph, --boids, --dem, --gravity, --ropes)\n");
+        return 1;
+    }
 
-    int width = 500;
-    int height = 500;
-    unsigned int displayMode = GLUT_DOUBLE | GLUT_ALPHA | GLUT_DEPTH | GLUT_STENCIL;
-    displayMode = Defaults(displayMode, width, height);
+    // the window's size comes from the scene, so it is settled before there is a window
+    gSceneConfig = GetDefaultSceneConfig();
+    if (!gSceneConfigPath.empty())
+    {
+        if (!LoadSceneConfig(gSceneConfigPath, &gSceneConfig))
+        {
+            return 1;
+        }
+        GetSceneConfigFileTime(gSceneConfigPath, &gPrepSceneConfigTime);
+    }
+    for (size_t overrideIndex = 0; overrideIndex < gSceneConfigOverrides.size(); overrideIndex++)
+    {
+        ApplySceneConfigOverride(gSceneConfigOverrides[overrideIndex], &gSceneConfig);
+    }
 
-    glutInitDisplayMode(displayMode);
-    glutInitContextVersion(4, 4);
-    glutInitContextProfile(GLUT_CORE_PROFILE);
+    // a replay starts where the recording did, and runs as many frames
+    if (!gInputReplayPath.empty())
+    {
+        if (!gInputEventLog.OpenReplay(gInputReplayPath))
+        {
+            return 1;
+        }
+        gSceneConfig = gInputEventLog.GetStartSceneConfig();
+        if (gInputEventLog.GetHeader()._isDeterministic != 0)
+        {
+            gDeterministic = true;
+            gRandomSeed = gInputEventLog.GetHeader()._randomSeed;
+        }
+        if (gMaxFrameCount == 0)
+        {
+            gMaxFrameCount = gInputEventLog.GetFrameCount();
+        }
+        if (!gInputRecordPath.empty())
+        {
+            LogPrintf("input log: a replay isn't recorded again\n");
+            gInputRecordPath.clear();
+        }
+    }
 
-    // enable this for automatic message reporting (see OpenGlErrorHandling.cpp)
-#define DEBUG
-#ifdef DEBUG
-    glutInitContextFlags(GLUT_DEBUG);
-#endif
+    // a viewer's pool is the server's, and it only has what it is sent
+    if (!gStreamClientAddress.empty())
+    {
+        if (!gParticleStreamGather.Connect(gStreamClientAddress))
+        {
+            return 1;
+        }
+        gSceneConfig._particleCount = gParticleStreamGather.GetParticleCount();
+        gSceneConfig._maxParticlesEmittedPerFrame = 0;
+        gSceneConfig._lifetimeSec = 0.0f;
+        gSceneConfig._minVelocity = 0.0f;
+        gSceneConfig._maxVelocity = 0.0f;
+    }
+
+    // glutInit(...) would fail without a display, so it isn't called at all for "--headless"
+    gStartupStart = std::chrono::high_resolution_clock::now();
+    gStartupPhaseStart = gStartupStart;
+    std::unique_ptr<AppWindow> appWindow;
+    if (useHeadless)
+    {
+        appWindow.reset(new EglHeadlessWindow());
+    }
+    else
+    {
+        appWindow.reset(new GlutAppWindow(&argc, argv));
+    }
+    gAppWindow = appWindow.get();
 
-    glutInitWindowSize(width, height);
-    glutInitWindowPosition(300, 200);
-    int window = glutCreateWindow(argv[0]);
+    AppWindowSettings windowSettings;
+    windowSettings._title = argv[0];
+    windowSettings._width = gSceneConfig._windowWidth;
+    windowSettings._height = gSceneConfig._windowHeight;
+    windowSettings._positionX = 300;
+    windowSettings._positionY = 200;
+    windowSettings._glMajorVersion = 4;
+    windowSettings._glMinorVersion = 4;
+    windowSettings._hasDepthBuffer = RenderModeNeedsDepth(gRenderMode);
+
+    // automatic message reporting (see OpenGlErrorHandling.cpp)
+    // Note: Debug output would skew the benchmark, so it never gets a debug context.
+    if (benchmarkMode)
+    {
+        useDebugOutput = false;
+    }
+    windowSettings._isDebugContext = useDebugOutput;
+    if (!gAppWindow->Create(windowSettings))
+    {
+        LogPrintf("couldn't create a window\n");
+        return 0;
+    }
 
+    MarkStartupPhase("window and context");
     glload::LoadTest glLoadGood = glload::LoadFunctions();
     // ??check return value??
-
-    glutSetOption(GLUT_ACTION_ON_WINDOW_CLOSE, GLUT_ACTION_CONTINUE_EXECUTION);
+    InvalidateGlStateCache();
+    SetGlStateCacheEnabled(gUseGlStateCache);
+    MarkStartupPhase("GL functions");
 
     if (!glload::IsVersionGEQ(3, 3))
     {
-        printf("Your OpenGL version is %i, %i. You must have at least OpenGL 3.3 to run this tutorial.\n",
+        LogPrintf("Your OpenGL version is %i, %i. You must have at least OpenGL 3.3 to run this tutorial.\n",
             glload::GetMajorVersion(), glload::GetMinorVersion());
-        glutDestroyWindow(window);
+        gAppWindow->Destroy();
         return 0;
     }
 
-    if (glext_ARB_debug_output)
+    if (benchmarkMode)
+    {
+        // nothing is drawn to the window, so get it out of the way
+        gAppWindow->Hide();
+        int benchmarkResult = 0;
+        if (validateMode)
+        {
+            benchmarkResult = RunParticleValidation();
+        }
+        else if (rngBenchmarkMode)
+        {
+            benchmarkResult = RunRngBenchmark();
+        }
+        else if (precompileMode)
+        {
+            benchmarkResult = PrecompileShaderVariants(gShaderVariantsPath);
+        }
+        else
+        {
+            benchmarkResult = sweepMode ? RunBenchmarkSweep(sweepSettings) : RunBenchmark();
+        }
+        gAppWindow->Destroy();
+        return benchmarkResult;
+    }
+
+    // from here on, console output is printed by the log's writer thread
+    // Note: The benchmark doesn't start the log.  It prints its CSV with printf(...) and its 
+    // output must stay in order.
+    InitLog();
+    if (useDebugOutput)
     {
-        glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS_ARB);
-        glDebugMessageCallbackARB(DebugFunc, (void*)15);
+        InitDebugOutput(useSynchronousDebugOutput);
     }
 
+    // the shared windows sit to the right of the main one, one after the other
+    for (unsigned int sharedIndex = 0; sharedIndex < gSharedWindowCount; sharedIndex++)
+    {
+        AppWindowSettings sharedSettings = windowSettings;
+        sharedSettings._positionX += (int)(sharedIndex + 1) * windowSettings._width;
+        if (!gAppWindow->AddSharedWindow(sharedSettings))
+        {
+            LogPrintf("couldn't create shared window %u\n", sharedIndex);
+            break;
+        }
+    }
+
+    // the context (and the driver's threads) exist by now, and the workers start in Init()
+    SetThreadPlacement(gThreadPlacementSettings);
+    PlaceGlThread();
+    LargeHostBuffer::EnableLargePages(gUseLargePages);
+
+    // before Init() so that the startup (shader builds and all) is on the timeline
+    SetTraceThreadName("render");
+    if (!gTracePath.empty())
+    {
+        StartTrace(gTracePath);
+    }
+    MarkStartupPhase("log and debug output");
+
     Init();
+    if (!gWriteAssetPackPath.empty())
+    {
+        std::vector<std::string> assetPaths = GetLoadedShaderFiles();
+        if (!gEmissionImagePath.empty())
+        {
+            assetPaths.push_back(gEmissionImagePath);
+        }
+        if (gLoadSnapshotAtStart)
+        {
+            assetPaths.push_back(gSnapshotPath);
+        }
+        WriteAssetPack(gWriteAssetPackPath, assetPaths);
+    }
+    if (!SetSwapInterval(gSwapIntervalMode))
+    {
+        gSwapIntervalMode = SWAP_INTERVAL_DRIVER_DEFAULT;
+    }
+    LogPrintf("swap interval: %s\n", GetSwapIntervalModeName(gSwapIntervalMode));
+    gFramePacer.Init(gMaxFramesInFlight);
+    if (gPowerSaveFps > 0.0f)
+    {
+        gFrameRateLimiter.Init(gPowerSaveFps, gIdleFps);
+        gPowerMonitor.Init();
+        gLastInputTimeMs = GetPacingClockMs();
+        gPowerReportStartMs = gLastInputTimeMs;
+    }
+    gThroughputStart = std::chrono::high_resolution_clock::now();
+    if (gCaptureAtStart)
+    {
+        gFrameCapture.Start(gAppWindow->GetWidth(), gAppWindow->GetHeight(), gCapturePath, 60);
+    }
+    if (!gSharedOutputName.empty())
+    {
+        gSharedTextureOutput.Init(gSharedOutputName);
+    }
+    if (gRecordTrajectoryAtStart)
+    {
+        StartTrajectoryRecording();
+    }
+    if (!gHeatmapPath.empty())
+    {
+        gParticleHeatmapExporter.Start(gHeatmapPath, gHeatmapSize, gHeatmapSize, 
+            gHeatmapIntervalSec, glm::vec2(-1.0f, -1.0f), glm::vec2(+1.0f, +1.0f));
+    }
+
+    if (!gInputRecordPath.empty())
+    {
+        InputEventLogHeader inputLogHeader;
+        memset(&inputLogHeader, 0, sizeof(inputLogHeader));
+        inputLogHeader._isDeterministic = gDeterministic ? 1 : 0;
+        inputLogHeader._randomSeed = gRandomSeed;
+        gInputEventLog.StartRecording(gInputRecordPath, inputLogHeader, gSceneConfig);
+    }
 
-    glutDisplayFunc(Display);
-    glutReshapeFunc(Reshape);
-    glutKeyboardFunc(Keyboard);
-    glutMainLoop();
+    gCamera.SetWindowSize(gAppWindow->GetWidth(), gAppWindow->GetHeight());
+    gAppWindow->SetResizeHandler(WindowResized);
+    gAppWindow->SetKeyHandler(WindowKey);
+    gAppWindow->SetMouseButtonHandler(WindowMouseButton);
+    gAppWindow->SetMouseMoveHandler(WindowMouseMove);
+    gAppWindow->SetMouseWheelHandler(WindowMouseWheel);
+    if (gSoakHours > 0.0)
+    {
+        gSoakMonitor.Start(gSoakHours, gSoakIntervalSec);
+    }
+
+    // the frame loop: the window's events, then a frame, until the window says to stop
+    // Note: The events are handled before the frame so that a key press or a resize shows up 
+    // in the frame right after it.
+    while (gAppWindow->PollEvents())
+    {
+        ReplayInputEvents();
+        Display();
+        if (gMaxFrameCount != 0 && gFrameIndex >= gMaxFrameCount)
+        {
+            gAppWindow->RequestClose();
+        }
+        if (!gSoakMonitor.EndFrame())
+        {
+            gAppWindow->RequestClose();
+        }
+    }
+
+    if (gParticleManager.IsDeterministic())
+    {
+        LogPrintf("particle checksum after %u frames (seed %u): %016llx\n", gFrameIndex, 
+            gRandomSeed, gParticleManager.GetParticleChecksum());
+    }
 
+    // the context is still around (unless the window's close button took it, see 
+    // GlutAppWindow.h), so the GPU memory is cleaned up before the window goes
     CleanupAll();
+    bool hasSoakPassed = (gSoakHours <= 0.0) || gSoakMonitor.Finish();
+    gAppWindow->Destroy();
+    gAppWindow = 0;
 
-    return 0;
+    return hasSoakPassed ? 0 : 2;
 }
\ No newline at end of file
@@ -0,0 +1,19 @@
+// an example of a custom update (see ParticleKernelVariant::_customUpdateFilePath), for
+// "--custom-update shaderCustomSwirl.glsl"
+// Note: Spliced into shaderParticle.comp just ahead of the update, so it can use Particle and
+// anything else declared before that.  It runs on every substep of every live particle.
+
+// how fast the velocity turns, in radians per second, at the center of the window, falling
+// off with the distance from it
+const float SWIRL_RATE = 3.0f;
+
+// turns each particle's velocity around the center of the window, more so near it, and
+// slows it a little, so the particles curl into a whirlpool
+void customUpdate(inout Particle p, float dt)
+{
+    float angle = SWIRL_RATE * dt / (1.0f + (4.0f * dot(p._position, p._position)));
+    float c = cos(angle);
+    float s = sin(angle);
+    p._velocity = vec2((c * p._velocity.x) - (s * p._velocity.y),
+        (s * p._velocity.x) + (c * p._velocity.y)) * (1.0f - (0.1f * dt));
+}
@@ -0,0 +1,19 @@
+#version 440
+
+// the density surface's contour lines (see DensitySurfaceRenderer.h), pulled by the vertex ID
+// out of what the marching squares pass in shaderDensitySurface.comp wrote, 2 end points per 
+// line
+// Note: The binding must match CONTOUR_VERTEX_BUFFER_BINDING in DensitySurfaceRenderer.h.
+layout (std430, binding = 64) readonly buffer ContourVertexBuffer {
+    vec2 ContourVertices[];
+};
+
+// the lines are drawn with shaderParticle.frag, which takes the color from here
+// Note: Must have the same name as its corresponding "in" item in the frag shader.
+smooth out vec3 particleColor;
+
+void main()
+{
+    particleColor = vec3(1.0f, 1.0f, 1.0f);
+    gl_Position = vec4(ContourVertices[gl_VertexID], 0.0f, 1.0f);
+}
@@ -0,0 +1,21 @@
+#version 440
+
+// how many particles landed on each pixel (see the splat pass in shaderParticle.comp)
+layout (r32ui, binding = 0) uniform readonly uimage2D uDensityImage;
+
+// how bright a single particle is
+// Note: The tone map is 1 - e^(-density * exposure), so a pixel gets brighter with every 
+// particle but approaches white instead of clipping to it.
+uniform float uExposure;
+
+// the density image's size over the window's (see DensitySplatRenderer::SetResolutionScale(...))
+uniform vec2 uResolutionScale = vec2(1.0f, 1.0f);
+
+out vec4 finalFragColor;
+
+void main()
+{
+    uint density = imageLoad(uDensityImage, ivec2(gl_FragCoord.xy * uResolutionScale)).r;
+    float brightness = 1.0f - exp(-float(density) * uExposure);
+    finalFragColor = vec4(brightness, brightness, brightness, 1.0f);
+}
@@ -0,0 +1,10 @@
+#version 440
+
+// a single triangle that covers the whole window, made from nothing but the vertex ID
+// Note: Vertices 0, 1, and 2 land at (-1,-1), (3,-1), and (-1,3).  The parts outside the 
+// window are clipped, and there is no diagonal seam like there would be with 2 triangles.
+void main()
+{
+    vec2 pos = vec2(float((gl_VertexID & 1) * 4) - 1.0f, float((gl_VertexID & 2) * 2) - 1.0f);
+    gl_Position = vec4(pos, 0.0f, 1.0f);
+}
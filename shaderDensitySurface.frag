@@ -0,0 +1,52 @@
+#version 440
+
+// the blurred density field, in particles per pixel of the window (see 
+// DensitySurfaceRenderer.h)
+// Note: The binding must match SURFACE_FIELD_TEXTURE_UNIT in DensitySurfaceRenderer.h.
+layout (binding = 0) uniform sampler2D uSurfaceField;
+
+// where the surface is, in the field's units
+uniform float uThreshold = 1.0f;
+
+// the field covers the viewport, so a fragment's coordinate over the viewport's size is its 
+// texture coordinate
+uniform vec2 uInverseViewportSize = vec2(1.0f, 1.0f);
+
+out vec4 finalFragColor;
+
+void main()
+{
+    // the linear filter stretches the low-resolution field into a smooth one
+    vec2 texCoord = gl_FragCoord.xy * uInverseViewportSize;
+    float field = texture(uSurfaceField, texCoord).r;
+
+    // the edge is faded over about a pixel, however steep the field is there
+    float edgeWidth = max(fwidth(field), 0.0001f);
+    float coverage = clamp(((field - uThreshold) / edgeWidth) + 0.5f, 0.0f, 1.0f);
+    if (coverage <= 0.0f)
+    {
+        finalFragColor = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        return;
+    }
+
+    // the field as a height, in thresholds so that the look doesn't change with the threshold, 
+    // with the normal from its slope a texel to either side
+    vec2 texelSize = 1.0f / vec2(textureSize(uSurfaceField, 0));
+    float left = texture(uSurfaceField, texCoord - vec2(texelSize.x, 0.0f)).r;
+    float right = texture(uSurfaceField, texCoord + vec2(texelSize.x, 0.0f)).r;
+    float below = texture(uSurfaceField, texCoord - vec2(0.0f, texelSize.y)).r;
+    float above = texture(uSurfaceField, texCoord + vec2(0.0f, texelSize.y)).r;
+    vec2 slope = vec2(right - left, above - below) / uThreshold;
+    vec3 normal = normalize(vec3(-slope, 1.0f));
+
+    // deep water is darker than the shallows at the edge, and a light from the top left gives 
+    // it a diffuse shade and a highlight
+    float depth = clamp(((field / uThreshold) - 1.0f) * 0.25f, 0.0f, 1.0f);
+    vec3 baseColor = mix(vec3(0.3f, 0.7f, 1.0f), vec3(0.05f, 0.2f, 0.5f), depth);
+    vec3 lightDirection = normalize(vec3(-0.4f, 0.6f, 0.7f));
+    float diffuse = max(dot(normal, lightDirection), 0.0f);
+    vec3 halfway = normalize(lightDirection + vec3(0.0f, 0.0f, 1.0f));
+    float specular = pow(max(dot(normal, halfway), 0.0f), 32.0f);
+    vec3 color = (baseColor * (0.35f + (0.65f * diffuse))) + vec3(0.6f * specular);
+    finalFragColor = vec4(color * coverage, 1.0f);
+}
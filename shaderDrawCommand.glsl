@@ -0,0 +1,12 @@
+// one draw group's indirect draw command, as glMultiDrawElementsIndirect(...) reads it
+// Note: Must match DrawElementsIndirectCommand in ParticleManager.cpp.  Included by 
+// shaderParticle.comp, which writes the commands, and by shaderParticle.vert, which finds a 
+// particle's draw group in them (see ReadShaderSource(...) in GenerateShader.h).
+struct DrawCommand
+{
+    uint _count;
+    uint _instanceCount;    // 0 if the group is hidden
+    uint _firstIndex;
+    int _baseVertex;
+    uint _baseInstance;
+};
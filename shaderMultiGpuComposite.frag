@@ -0,0 +1,16 @@
+#version 440
+
+// one of the other GPUs' particle images (see MultiGpuSimulation.h), drawn over this GPU's 
+// particles with additive blending
+// Note: The binding must match COMPOSITE_TEXTURE_UNIT in MultiGpuSimulation.cpp.
+layout (binding = 0) uniform sampler2D uImage;
+
+// 1 / the viewport's size in pixels, so the image covers the viewport whatever its size
+uniform vec2 uInverseViewportSize = vec2(1.0f, 1.0f);
+
+out vec4 finalFragColor;
+
+void main()
+{
+    finalFragColor = vec4(texture(uImage, gl_FragCoord.xy * uInverseViewportSize).rgb, 0.0f);
+}
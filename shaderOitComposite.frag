@@ -0,0 +1,34 @@
+#version 440
+
+// the weighted blended transparency's targets (see WeightedOitRenderer.h and 
+// shaderParticleOit.frag)
+// Note: The bindings must match the OIT_*_TEXTURE_UNIT values in WeightedOitRenderer.cpp.  
+// Both targets are the size of the framebuffer that this draws into, so each pixel reads its 
+// own texel.
+layout (binding = 0) uniform sampler2D uOitAccumulation;
+layout (binding = 1) uniform sampler2D uOitRevealage;
+
+// blended over the frame with (1 - alpha, alpha), so the alpha is the revealage: how much of 
+// what was already there shows through
+out vec4 finalFragColor;
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float revealage = texelFetch(uOitRevealage, pixel, 0).r;
+    if (revealage >= 1.0f)
+    {
+        // no particle covered the pixel
+        discard;
+    }
+
+    // a pixel with many bright, heavily weighted fragments can overflow half floats, and then 
+    // the average is just as well white
+    vec4 accumulation = texelFetch(uOitAccumulation, pixel, 0);
+    if (isinf(max(max(abs(accumulation.r), abs(accumulation.g)), abs(accumulation.b))))
+    {
+        accumulation.rgb = vec3(accumulation.a);
+    }
+    vec3 averageColor = accumulation.rgb / max(accumulation.a, 1e-5f);
+    finalFragColor = vec4(averageColor, revealage);
+}
@@ -0,0 +1,34 @@
+#version 440
+
+// how many fragments landed on each pixel (see OverdrawVisualizer.h)
+// Note: The binding must match OVERDRAW_COUNT_TEXTURE_UNIT in OverdrawVisualizer.cpp.  The 
+// target is the size of the framebuffer that this draws into, so each pixel reads its own 
+// texel.
+layout (binding = 0) uniform sampler2D uOverdrawCount;
+
+// the count that is white (see OverdrawVisualizer::SetMaxOverdraw(...))
+uniform float uMaxOverdraw = 32.0f;
+
+out vec4 finalFragColor;
+
+void main()
+{
+    float count = texelFetch(uOverdrawCount, ivec2(gl_FragCoord.xy), 0).r;
+    if (count < 0.5f)
+    {
+        // nothing was drawn here
+        discard;
+    }
+
+    // on a log scale, so that 1, 2, 4, 8... are evenly spaced, since the difference between 1 
+    // and 2 particles matters as much as between 16 and 32
+    float heat = clamp(log2(count) / log2(uMaxOverdraw), 0.0f, 1.0f);
+    vec3 blue = vec3(0.0f, 0.1f, 0.6f);
+    vec3 green = vec3(0.0f, 0.8f, 0.2f);
+    vec3 yellow = vec3(1.0f, 0.9f, 0.0f);
+    vec3 white = vec3(1.0f);
+    vec3 color = (heat < 0.33f) ? mix(blue, green, heat / 0.33f) : 
+        (heat < 0.67f) ? mix(green, yellow, (heat - 0.33f) / 0.34f) : 
+        mix(yellow, white, (heat - 0.67f) / 0.33f);
+    finalFragColor = vec4(color, 1.0f);
+}
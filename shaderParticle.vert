@@ -1,5 +1,230 @@
 #version 440
 
+// each draw group is its own command in the quads' multi-draw, so the command's index is the 
+// group (see ParticleManager::GetQuadRenderShaderDefines(...)); it doesn't pick a buffer, 
+// since the pool isn't chunked
+// Note: Extensions must be turned on before anything else in the shader.
+#ifdef PARTICLE_DRAW_PARAMETERS
+#extension GL_ARB_shader_draw_parameters : require
+#endif
+
+// same as in shaderParticle.comp, for the speed palette
+#ifdef GL_ARB_bindless_texture
+#extension GL_ARB_bindless_texture : enable
+#endif
+
+// the insets' broadcast (see ParticleMultiViewport.h)
+#ifdef PARTICLE_VIEWPORT_MASK
+#extension GL_NV_viewport_array2 : require
+#endif
+
+#ifdef PARTICLE_VERTEX_PULLING
+// "vertex pulling": the particle is read straight out of the same shader storage buffers that 
+// the compute shader writes, instead of through vertex attributes
+// Note: ParticleManager::GetRenderShaderDefines(...) inserts this along with the same 
+// PARTICLE_LAYOUT_* define that the compute shader was built with, and the declarations must 
+// match the ones in shaderParticle.comp.  The structures' members are generated (see 
+// GetGlslMembersDefine(...) in ParticleLayoutDescriptor.h), so only the buffers are written 
+// out here.  The draw is indexed by the live index buffer, so 
+// gl_VertexID is already the particle's index in the pool.
+#ifdef PARTICLE_LAYOUT_SOA
+layout (std430, binding = 0) readonly buffer PositionBuffer {
+    vec2 AllPositions[];
+};
+
+layout (std430, binding = 1) readonly buffer VelocityBuffer {
+    vec2 AllVelocities[];
+};
+
+// Note: The flags array is only declared for the flipbook, which needs the age that is in its
+// high bits.  The draw only goes over the live index buffer, so every particle that it pulls 
+// is active, and the other builds only load the hot arrays.
+#ifdef PARTICLE_FLIPBOOK
+layout (std430, binding = 2) readonly buffer FlagsBuffer {
+    int AllFlags[];
+};
+#endif
+#elif defined(PARTICLE_LAYOUT_HALF_FLOAT)
+struct PackedHalfParticle
+{
+    PACKED_HALF_PARTICLE_MEMBERS
+};
+
+layout (std430, binding = 0) readonly buffer ParticleBuffer {
+    PackedHalfParticle AllParticles[];
+};
+#elif defined(PARTICLE_LAYOUT_FIXED_POINT)
+struct PackedFixedParticle
+{
+    PACKED_FIXED_PARTICLE_MEMBERS
+};
+
+layout (std430, binding = 0) readonly buffer ParticleBuffer {
+    PackedFixedParticle AllParticles[];
+};
+#else
+struct Particle
+{
+    PARTICLE_MEMBERS
+};
+
+layout (std430, binding = 0) readonly buffer ParticleBuffer {
+    Particle AllParticles[];
+};
+#endif
+
+// the same 3 values that the attributes give the other build, and the age, which has no 
+// attribute (see Particle.h)
+vec2 pos;
+vec2 vel;
+int isActive;
+float age;
+
+void PullParticle(uint index)
+{
+#ifdef PARTICLE_LAYOUT_SOA
+    pos = AllPositions[index];
+    vel = AllVelocities[index];
+    isActive = 1;
+#ifdef PARTICLE_FLIPBOOK
+    age = float(uint(AllFlags[index]) >> 16) / 65535.0f;
+#else
+    age = 0.0f;
+#endif
+#elif defined(PARTICLE_LAYOUT_HALF_FLOAT)
+    PackedHalfParticle packed = AllParticles[index];
+    pos = unpackHalf2x16(packed._position);
+    vel = unpackHalf2x16(packed._velocity);
+    isActive = packed._isActive & 1;
+    age = float(uint(packed._isActive) >> 16) / 65535.0f;
+#elif defined(PARTICLE_LAYOUT_FIXED_POINT)
+    // must match LoadParticle(...) in shaderParticle.comp
+    PackedFixedParticle packed = AllParticles[index];
+    int position = int(packed._position);
+    int motion = int(packed._motion);
+    pos = vec2(bitfieldExtract(position, 0, 16), bitfieldExtract(position, 16, 16)) / 32768.0f;
+    vel = vec2(bitfieldExtract(motion, 10, 11), bitfieldExtract(motion, 21, 11)) / 256.0f;
+    isActive = motion & 1;
+    age = float(bitfieldExtract(packed._motion, 1, 9)) / 511.0f;
+#else
+    Particle p = AllParticles[index];
+    pos = p._position;
+    vel = p._velocity;
+    isActive = p._isActive;
+    age = p._age;
+#endif
+}
+
+#ifdef PARTICLE_QUADS
+// instanced quads: every instance is a live particle and every vertex is a corner of its quad,
+// so the rasterizer isn't limited to GL_POINT_SIZE_RANGE and the shape can fit the particle 
+// more tightly than a square
+// Note: ParticleManager::GetQuadRenderShaderDefines(...) inserts this along with the vertex 
+// pulling define.  The particle's index comes from the live index buffer as an instanced 
+// attribute, and each draw group's command starts at its range of the live index buffer with 
+// its "base instance".
+layout (location = 4) in uint quadParticleIndex;
+
+// must match DrawCommandBuffer in shaderParticle.comp
+#include "shaderDrawCommand.glsl"
+
+layout (std430, binding = 4) readonly buffer DrawCommandBuffer {
+    uint EmittedCount;
+    uint DrawGroupCount;
+    DrawCommand DrawCommands[];
+};
+
+// the same styles that the other builds take as an instanced attribute, which is taken by 
+// the particle index here
+// Note: The binding must match DRAW_GROUP_STYLE_BUFFER_BINDING in ParticleManager.h.
+layout (std430, binding = 12) readonly buffer DrawGroupStyleBuffer {
+    vec2 DrawGroupStyles[];
+};
+
+vec2 drawGroupStyle;
+
+// 4 is a square drawn as a triangle strip and 8 is an octagon drawn as a triangle fan (see 
+// ParticleQuadShape in ParticleManager.h)
+uniform int uQuadCornerCount = 4;
+
+// converts the point size from pixels to clip space
+uniform vec2 uViewportSize = vec2(1.0f, 1.0f);
+
+// where the vertex is relative to the particle, with the particle's circle at radius 1
+// Note: Must have the same name as its corresponding "in" item in the frag shader.
+smooth out vec2 quadCoord;
+
+// the same search as FindDrawGroup(...) in shaderParticle.comp; a group's range of the pool 
+// and of the live index buffer are the same, so the particle index works as the slot
+// Note: Only for drivers without gl_DrawIDARB, which already knows the group.
+uint FindDrawGroup(uint particleIndex)
+{
+    uint low = 0;
+    uint high = DrawGroupCount - 1;
+    while (low < high)
+    {
+        uint middle = (low + high + 1) / 2;
+        if (DrawCommands[middle]._firstIndex <= particleIndex)
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle - 1;
+        }
+    }
+    return low;
+}
+
+// counterclockwise, because back faces may be culled
+vec2 GetQuadCorner(int corner)
+{
+    if (uQuadCornerCount == 4)
+    {
+        // strip order: bottom left, bottom right, top left, top right
+        return vec2(((corner & 1) != 0) ? +1.0f : -1.0f, ((corner & 2) != 0) ? +1.0f : -1.0f);
+    }
+
+    // the octagon's edges touch the circle, so its corners are out at 1 / cos(22.5 degrees), 
+    // and it still covers ~17% less than the square
+    float angle = (float(corner) + 0.5f) * (6.2831853f / 8.0f);
+    return vec2(cos(angle), sin(angle)) * 1.0823922f;
+}
+#endif
+
+#ifdef PARTICLE_RIBBONS
+// the constraint solver's chains drawn as ribbons (see ParticleConstraintSolver.h): every 
+// segment is 6 vertices (2 triangles) and each vertex pulls the particles it needs by its 
+// segment instead of by the live index
+// Note: ParticleConstraintSolver::GetRibbonRenderShaderDefines(...) inserts this along with 
+// the vertex pulling define.  Each segment is the particle before it in the chain, its 2 
+// ends, and the particle after it, so that each end is widened across the chain's direction 
+// there and the segments on either side of it meet.  The binding must match 
+// RIBBON_SEGMENT_BUFFER_BINDING in ParticleConstraintSolver.h.
+layout (std430, binding = 60) readonly buffer RibbonSegmentBuffer {
+    uvec4 RibbonSegments[];
+};
+
+// the ribbon's width in pixels, which, like the point size, is the same at any zoom
+uniform float uRibbonWidth = 1.0f;
+
+// converts the width from pixels to clip space
+uniform vec2 uViewportSize = vec2(1.0f, 1.0f);
+
+// the ribbons have no draw groups
+const vec2 drawGroupStyle = vec2(1.0f, 1.0f);
+
+// which end of the segment each vertex is at (0 or 1) and which side of the chain (-1 or +1)
+// Note: Counterclockwise, like the quads.
+const ivec2 RibbonCorners[6] = ivec2[6](
+    ivec2(0, -1), ivec2(1, -1), ivec2(0, +1), ivec2(0, +1), ivec2(1, -1), ivec2(1, +1));
+
+// the chain's direction at the vertex's end and whether the segment's other end is active
+vec2 ribbonTangent;
+int isRibbonOtherEndActive;
+#endif
+
+#else
 // position in window space (both X and Y on the range [-1,+1])
 layout (location = 0) in vec2 pos;  
 
@@ -7,13 +232,214 @@ layout (location = 0) in vec2 pos;
 // seconds)
 layout (location = 1) in vec2 vel;  
 
+// 0 if the particle is dead and waiting to be re-emitted, otherwise 1
+// Note: This is an integer attribute and is set up with glVertexAttribIPointer(...).  Sending 
+// it through the float path would convert it to a float.
+layout (location = 2) in int isActive;
+#endif
+
+#if !defined(PARTICLE_QUADS) && !defined(PARTICLE_RIBBONS)
+// the particle's draw group's scales for the point size (X) and the brightness (Y)
+// Note: An instanced attribute that each of ParticleManager's indirect draw commands picks 
+// with its "base instance", so every draw group of a single multi-draw has its own style.  
+// Programs that leave the attribute disabled (ex: the frame graph) set its current value to 
+// (1, 1).
+layout (location = 3) in vec2 drawGroupStyle;
+#endif
+
+// how far past the last simulation step this frame is (see SimulationClock)
+uniform float uExtrapolationSec;
+
+// where the camera is looking (see ParticleManager::SetView(...))
+// Note: Must match "ViewParameters" in ViewParameters.h.  Programs that draw in window space 
+// (ex: the frame graph) bind an identity view of their own.  The cull values and the level of
+// detail are only for the compute shader.
+layout (std140, binding = 1) uniform ViewParameters {
+    mat4 uViewProjection;
+    vec2 uCullMargin;
+    uint uIsViewCulled;
+    uint uLodStride;
+};
+
+// the size of the point sprite in pixels
+// Note: Only used while GL_PROGRAM_POINT_SIZE is enabled.  It has a default value so that 
+// programs that don't set it (ex: the frame graph) still draw 1-pixel points.
+uniform float uPointSize = 1.0f;
+
+// scales the particle color; additive blending uses a small value so that dense areas build up
+uniform float uParticleBrightness = 1.0f;
+
+// 0 is flat white and 1 is the speed palette (see ParticleColorMode in ParticleManager.h)
+// Note: The default is flat so that programs that don't set it (ex: the frame graph) don't 
+// need a palette.
+uniform int uColorMode = 0;
+
+// the speed palette, from at rest (left) to uPaletteMaxSpeed and faster (right)
+// Note: The binding must match SPEED_PALETTE_TEXTURE_UNIT in ParticleManager.h.
+layout (binding = 0) uniform sampler1D uSpeedPalette;
+uniform float uPaletteMaxSpeed = 1.0f;
+
+// the point size of a max speed particle relative to one at rest
+uniform float uFastPointSizeScale = 1.0f;
+
+#ifdef PARTICLE_VIEWPORT_MASK
+// every viewport that the particle is drawn in, which is all of them, since the scissors sort
+// out which view gets which part of it (see ParticleMultiViewport::BeginBroadcast(...))
+uniform int uViewportMask = 1;
+#endif
+
+#ifdef PARTICLE_FLIPBOOK
+// the flipbook's frames are layers of a texture array, and the particle steps through them as
+// it ages (see ParticleManager::SetFlipbook(...))
+// Note: ParticleManager::GetFlipbookRenderShaderDefines(...) inserts this along with the 
+// vertex pulling define, since the age is only in the particle buffers.
+uniform uint uFlipbookFrameCount = 1;
+uniform float uFlipbookCycles = 1.0f;
+
+// the bigger side of a frame in texels, and the smallest mip level's index
+uniform float uFlipbookFrameSize = 1.0f;
+uniform float uFlipbookMaxLod = 0.0f;
+
+// the layer (X) and the mip level (Y), which are the same for every fragment of the particle, 
+// and whether the frame is laid over quadCoord (Z = 1) or gl_PointCoord (Z = 0)
+// Note: Must have the same name as its corresponding "in" item in the frag shader.
+flat out vec3 flipbookFrame;
+
+#ifndef PARTICLE_QUADS
+// the point sprite build doesn't use it, but shaderParticleFlipbook.frag reads it
+smooth out vec2 quadCoord;
+#endif
+#endif
+
+#ifdef PARTICLE_SMOOTH_POINTS
+// the particle's radius in pixels, which shaderParticleSmooth.frag needs to find its edge in 
+// gl_PointCoord (see ParticleManager::GetSmoothPointRenderShaderDefines(...))
+flat out float pointRadius;
+#endif
+
 // must have the same name as its corresponding "in" item in the frag shader
 smooth out vec3 particleColor;
 
 void main()
 {
-    // hard code a white particle color
-    particleColor = vec3(1.0f, 1.0f, 1.0f);
-	gl_Position = vec4(pos, -1.0f, 1.0f);
+#ifdef PARTICLE_VIEWPORT_MASK
+    gl_ViewportMask[0] = uViewportMask;
+#endif
+#ifdef PARTICLE_QUADS
+    PullParticle(quadParticleIndex);
+#ifdef PARTICLE_DRAW_PARAMETERS
+    drawGroupStyle = DrawGroupStyles[gl_DrawIDARB];
+#else
+    drawGroupStyle = DrawGroupStyles[FindDrawGroup(quadParticleIndex)];
+#endif
+    quadCoord = vec2(0.0f, 0.0f);
+#elif defined(PARTICLE_RIBBONS)
+    // the neighbors first, since each pull overwrites the last one's values
+    // Note: The tangent is between the extrapolated positions, like the ends themselves.
+    uvec4 segment = RibbonSegments[uint(gl_VertexID) / 6u];
+    ivec2 ribbonCorner = RibbonCorners[gl_VertexID % 6];
+    bool isEndB = (ribbonCorner.x == 1);
+    PullParticle(isEndB ? segment.w : segment.z);
+    ribbonTangent = pos + (vel * uExtrapolationSec);
+    PullParticle(isEndB ? segment.y : segment.x);
+    ribbonTangent -= pos + (vel * uExtrapolationSec);
+    PullParticle(isEndB ? segment.y : segment.z);
+    isRibbonOtherEndActive = isActive;
+    PullParticle(isEndB ? segment.z : segment.y);
+#elif defined(PARTICLE_VERTEX_PULLING)
+    PullParticle(uint(gl_VertexID));
+#endif
+
+    // white, unless the color comes from the speed
+    // Note: The velocity is already here for the extrapolation, so this costs a length and a 
+    // texture lookup, but it doesn't read anything more per particle.
+    vec3 color = vec3(1.0f, 1.0f, 1.0f);
+    float sizeScale = 1.0f;
+    if (uColorMode == 1)
+    {
+        float speedFraction = clamp(length(vel) / uPaletteMaxSpeed, 0.0f, 1.0f);
+        
+        // the first and last texel centers, not the texture's edges, are at rest and max 
+        // speed, so that both ends get their exact colors
+        float paletteSize = float(textureSize(uSpeedPalette, 0));
+        float paletteCoord = (0.5f + (speedFraction * (paletteSize - 1.0f))) / paletteSize;
+        color = textureLod(uSpeedPalette, paletteCoord, 0.0f).rgb;
+        sizeScale = mix(1.0f, uFastPointSizeScale, speedFraction);
+    }
+    particleColor = color * (uParticleBrightness * drawGroupStyle.y);
+    gl_PointSize = uPointSize * drawGroupStyle.x * sizeScale;
+
+#ifdef PARTICLE_SMOOTH_POINTS
+    // a round particle with an edge that fades over a pixel, in a sprite that is a pixel 
+    // wider so that the fade has room on both sides of the edge
+    // Note: A particle smaller than 1.5 pixels is drawn 1.5 pixels wide and that much dimmer,
+    // so it still lands on its neighboring pixels in proportion as it moves between them, 
+    // instead of popping from one pixel to the next like a hard 1-pixel point.
+    float radius = 0.5f * gl_PointSize;
+    pointRadius = max(radius, 0.75f);
+    particleColor *= (radius * radius) / (pointRadius * pointRadius);
+    gl_PointSize = (2.0f * pointRadius) + 1.0f;
+#endif
+
+#ifdef PARTICLE_FLIPBOOK
+    // the frame from how far through the animation the age is, and the mip level whose texels
+    // are about the size of the particle's pixels
+    // Note: Picked here, once per particle, so the fragment shader does a textureLod(...) with
+    // no derivatives, and a small particle reads a few texels of a small level instead of 
+    // skipping over the big one, which is what keeps the texture cache hits up.
+    float frameCount = float(uFlipbookFrameCount);
+    float layer = min(floor(fract(age * uFlipbookCycles) * frameCount), frameCount - 1.0f);
+    float lod = clamp(log2(uFlipbookFrameSize / max(gl_PointSize, 1.0f)), 0.0f, 
+        uFlipbookMaxLod);
+#ifdef PARTICLE_QUADS
+    flipbookFrame = vec3(layer, lod, 1.0f);
+#else
+    flipbookFrame = vec3(layer, lod, 0.0f);
+    quadCoord = vec2(0.0f, 0.0f);
+#endif
+#endif
+
+#ifdef PARTICLE_RIBBONS
+    // a segment with a dead end is moved out of the clip volume whole, since a triangle with 
+    // only some of its corners outside would still be drawn as a sliver
+    isActive &= isRibbonOtherEndActive;
+#endif
+    if (isActive == 0)
+    {
+        // vertex shaders can't discard, so put inactive particles outside of the clip volume 
+        // and let the clipper throw them away before they ever reach the rasterizer
+        // Note: The compute shader only hands live particles to the draw call, so this is just
+        // a safety net.
+        gl_Position = vec4(2.0f, 2.0f, 2.0f, 1.0f);
+    }
+    else
+    {
+        // the simulation runs in fixed steps, so move the particle along its velocity by 
+        // however much of the next step has already passed
+        vec2 drawPos = pos + (vel * uExtrapolationSec);
+        vec2 clipPos = (uViewProjection * vec4(drawPos, 0.0f, 1.0f)).xy;
+#ifdef PARTICLE_QUADS
+        // the point size is a diameter in pixels, and a pixel is 2 / viewport size in clip 
+        // space, so the radius in clip space is the point size / viewport size
+        // Note: The corner is added after the view so that the quads stay the same number of 
+        // pixels at any zoom, just like point sprites.
+        quadCoord = GetQuadCorner(gl_VertexID);
+        clipPos += quadCoord * (gl_PointSize / uViewportSize);
+#elif defined(PARTICLE_RIBBONS)
+        // across the chain's direction in pixels, so that a squashed view doesn't skew it, 
+        // and half of the width to each side, which is width / viewport size in clip space 
+        // (see the quads above)
+        vec2 pixelTangent = (uViewProjection * vec4(ribbonTangent, 0.0f, 0.0f)).xy * 
+            uViewportSize;
+        vec2 pixelNormal = vec2(-pixelTangent.y, pixelTangent.x);
+        float normalLengthSqr = dot(pixelNormal, pixelNormal);
+        if (normalLengthSqr > 0.0f)
+        {
+            pixelNormal *= inversesqrt(normalLengthSqr);
+        }
+        clipPos += pixelNormal * (float(ribbonCorner.y) * uRibbonWidth / uViewportSize);
+#endif
+        gl_Position = vec4(clipPos, -1.0f, 1.0f);
+    }
 }
 
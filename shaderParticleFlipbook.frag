@@ -0,0 +1,34 @@
+#version 440
+
+smooth in vec3 particleColor;
+
+// where the fragment is relative to the particle, with the particle's circle at radius 1 (see 
+// PARTICLE_QUADS in shaderParticle.vert); only written by the quad build
+smooth in vec2 quadCoord;
+
+// the layer and the mip level that the vertex shader picked for the particle, and whether it 
+// is a quad (see PARTICLE_FLIPBOOK in shaderParticle.vert)
+flat in vec3 flipbookFrame;
+
+// the flipbook's frames, one per layer
+// Note: The binding must match FLIPBOOK_TEXTURE_UNIT in ParticleManager.h.
+layout (binding = 5) uniform sampler2DArray uFlipbook;
+
+// same as shaderParticle.frag
+out vec4 finalFragColor;
+
+void main()
+{
+    // gl_PointCoord's origin is the sprite's top left, but the frames' rows go from the bottom 
+    // up, like the quad's corners
+    vec2 frameCoord = vec2(gl_PointCoord.x, 1.0f - gl_PointCoord.y);
+    if (flipbookFrame.z != 0.0f)
+    {
+        frameCoord = (quadCoord * 0.5f) + 0.5f;
+    }
+
+    // the frame's color tints the particle's, and its alpha is the coverage, like the quad's 
+    // round falloff in shaderParticleQuad.frag
+    vec4 texel = textureLod(uFlipbook, vec3(frameCoord, flipbookFrame.x), flipbookFrame.y);
+    finalFragColor = vec4(particleColor * texel.rgb * texel.a, texel.a);
+}
\ No newline at end of file
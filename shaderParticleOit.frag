@@ -0,0 +1,34 @@
+#version 440
+
+smooth in vec3 particleColor;
+
+// how much of what is behind the particle it covers (see ParticleManager::SetParticleOpacity(...))
+// Note: The ribbons' program (see ParticleConstraintSolver.h) doesn't set it, so they get the 
+// default.
+uniform float uParticleOpacity = 0.25f;
+
+// weighted blended order-independent transparency (McGuire and Bavoil, "Weighted Blended 
+// Order-Independent Transparency", 2013); see WeightedOitRenderer.h
+// Note: The accumulation target adds up every fragment's premultiplied color and opacity, 
+// each times a weight, and the revealage target multiplies together how much of the 
+// background every fragment lets through.  Both blends are commutative, so the draw order 
+// doesn't matter and nothing is sorted.
+layout (location = 0) out vec4 oitAccumulation;
+layout (location = 1) out float oitRevealage;
+
+void main()
+{
+    float alpha = uParticleOpacity;
+
+    // nearer fragments count for more, so the average leans toward what is in front, and more 
+    // opaque ones count for more, so a faint particle can't wash out a solid one (equation 10 
+    // of the paper, with the depth from the depth range instead of the view space)
+    // Note: In 2D, every particle is at the same depth, so only the opacity changes the weight, 
+    // and the result is exact.
+    float depthFalloff = 1.0f - (gl_FragCoord.z * 0.9f);
+    float weight = clamp(pow(min(1.0f, alpha * 10.0f) + 0.01f, 3.0f) * 1e8f * 
+        depthFalloff * depthFalloff * depthFalloff, 1e-2f, 3e3f);
+
+    oitAccumulation = vec4(particleColor * alpha, alpha) * weight;
+    oitRevealage = alpha;
+}
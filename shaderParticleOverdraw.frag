@@ -0,0 +1,11 @@
+#version 440
+
+// every fragment adds 1 to the count target (see OverdrawVisualizer.h)
+// Note: Nothing is discarded, not even outside a quad's circle, since a fragment that the 
+// usual fragment shaders discard is still shaded and costs the same.
+out vec4 finalFragColor;
+
+void main()
+{
+    finalFragColor = vec4(1.0f, 0.0f, 0.0f, 0.0f);
+}
@@ -0,0 +1,25 @@
+#version 440
+
+smooth in vec3 particleColor;
+
+// where the fragment is relative to the particle, with the particle's circle at radius 1 (see 
+// PARTICLE_QUADS in shaderParticle.vert)
+smooth in vec2 quadCoord;
+
+// same as shaderParticle.frag
+out vec4 finalFragColor;
+
+void main()
+{
+    // a soft round particle instead of the quad's hard corners
+    // Note: (1 - r^2)^2 is 1 in the middle, 0 at the edge, and flat at both ends, so there is no
+    // visible ring at the edge and no sqrt(...).
+    float distanceSquared = dot(quadCoord, quadCoord);
+    if (distanceSquared > 1.0f)
+    {
+        discard;
+    }
+    float falloff = 1.0f - distanceSquared;
+    falloff *= falloff;
+    finalFragColor = vec4(particleColor * falloff, falloff);
+}
@@ -0,0 +1,27 @@
+#version 440
+
+smooth in vec3 particleColor;
+
+// the particle's radius in pixels (see PARTICLE_SMOOTH_POINTS in shaderParticle.vert), which
+// is half a pixel inside the sprite's edge
+flat in float pointRadius;
+
+// same as shaderParticle.frag
+out vec4 finalFragColor;
+
+void main()
+{
+    // how much of the pixel the particle covers, from how far the pixel's center is from the
+    // particle's, which fades from 1 to 0 over the pixel that straddles the edge
+    // Note: That is the "analytic" antialiasing: a box filter over the pixel, approximated by
+    // a smoothstep across it, which looks about like 4x MSAA on a round edge but costs one
+    // sample per pixel and no resolve.
+    float spriteSize = (2.0f * pointRadius) + 1.0f;
+    float distancePixels = length(gl_PointCoord - vec2(0.5f, 0.5f)) * spriteSize;
+    float coverage = 1.0f - smoothstep(pointRadius - 0.5f, pointRadius + 0.5f, distancePixels);
+    if (coverage <= 0.0f)
+    {
+        discard;
+    }
+    finalFragColor = vec4(particleColor * coverage, coverage);
+}
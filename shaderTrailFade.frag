@@ -0,0 +1,20 @@
+#version 440
+
+// the scaled render target's last frame (see ScaledRenderTarget::SetTrailFade(...)), which is 
+// the same size as this one
+// Note: The binding must match UPSCALE_TEXTURE_UNIT in ScaledRenderTarget.cpp.
+layout (binding = 0) uniform sampler2D uPrevious;
+
+// how much of the last frame is left after a frame
+uniform float uFade = 0.9f;
+
+out vec4 finalFragColor;
+
+void main()
+{
+    vec3 previous = texelFetch(uPrevious, ivec2(gl_FragCoord.xy), 0).rgb;
+
+    // in an 8-bit target, a dim pixel's fade rounds right back to where it was (ex: 3 * 0.9 
+    // rounds to 3), so it would never go black without a little taken off as well
+    finalFragColor = vec4(max((previous * uFade) - (1.0f / 255.0f), vec3(0.0f)), 1.0f);
+}
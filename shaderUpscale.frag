@@ -0,0 +1,45 @@
+#version 440
+
+// the scaled render target's color (see ScaledRenderTarget.h), with a linear filter
+// Note: The binding must match UPSCALE_TEXTURE_UNIT in ScaledRenderTarget.cpp.
+layout (binding = 0) uniform sampler2D uImage;
+
+// 1 / the window's size in pixels, which turns the window's pixels into texture coordinates
+uniform vec2 uInverseWindowSize = vec2(1.0f, 1.0f);
+
+// 0 is a plain bilinear stretch; more adds back that much of the difference between each 
+// pixel and its neighbors in the image (an "unsharp mask")
+uniform float uSharpness = 0.0f;
+
+// the bloom filter's glow (see BloomFilter.h), at half of the image's size or less, and how 
+// much of it is added; 0 is none
+// Note: The binding must match UPSCALE_BLOOM_TEXTURE_UNIT in ScaledRenderTarget.cpp.
+layout (binding = 1) uniform sampler2D uBloom;
+uniform float uBloomIntensity = 0.0f;
+
+// true if the image is a single channel of brightness (R16F), which is drawn as grey
+uniform bool uIsMonochrome = false;
+
+out vec4 finalFragColor;
+
+void main()
+{
+    vec2 texCoord = gl_FragCoord.xy * uInverseWindowSize;
+    vec3 color = texture(uImage, texCoord).rgb;
+    if (uSharpness > 0.0f)
+    {
+        // the 4 neighbors are a whole pixel of the image away, not of the window
+        vec2 texel = 1.0f / vec2(textureSize(uImage, 0));
+        vec3 blurred = 0.25f * (
+            texture(uImage, texCoord + vec2(texel.x, 0.0f)).rgb + 
+            texture(uImage, texCoord - vec2(texel.x, 0.0f)).rgb + 
+            texture(uImage, texCoord + vec2(0.0f, texel.y)).rgb + 
+            texture(uImage, texCoord - vec2(0.0f, texel.y)).rgb);
+        color = max(color + ((color - blurred) * uSharpness), vec3(0.0f));
+    }
+    if (uBloomIntensity > 0.0f)
+    {
+        color += textureLod(uBloom, texCoord, 0.0f).rgb * uBloomIntensity;
+    }
+    finalFragColor = vec4(uIsMonochrome ? color.rrr : color, 1.0f);
+}